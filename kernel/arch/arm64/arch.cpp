@@ -182,6 +182,24 @@ void arch_idle() {
     __asm__ volatile("wfi");
 }
 
+bool arch_idle_wakes_on_write() {
+    return true;
+}
+
+void arch_idle_wait(volatile uint32_t* word, uint32_t mask) {
+    // The exclusive load arms the monitor, so a store to the word from
+    // another cpu clears it and generates the event that ends the wfe.
+    uint32_t value;
+    __asm__ volatile("ldaxr %w[value], [%[word]]"
+                     : [value] "=r"(value)
+                     : [word] "r"(word)
+                     : "memory");
+    if (value & mask)
+        return;
+    __asm__ volatile("wfe" ::
+                         : "memory");
+}
+
 // Switch to user mode, set the user stack pointer to user_stack_top, put the svc stack pointer to
 // the top of the kernel stack.
 void arch_enter_uspace(uintptr_t pc, uintptr_t sp, uintptr_t arg1, uintptr_t arg2) {
@@ -20,6 +20,7 @@ static arm64_cache_info_t cache_info[SMP_MAX_CPUS];
 uint32_t arm64_zva_size = 32;
 uint32_t arm64_icache_size = 32;
 uint32_t arm64_dcache_size = 32;
+uint32_t arm64_asid_bits = 16;
 
 static void parse_ccsid(arm64_cache_desc_t* desc, uint64_t ccsid) {
     desc->write_through = BIT(ccsid, 31) > 0;
@@ -230,9 +231,11 @@ void arm64_feature_init() {
     // read the cache info for each cpu
     arm64_get_cache_info(&(cache_info[cpu]));
 
-    // check to make sure implementation supports 16 bit asids
+    // use 16 bit asids unless some cpu only implements 8
     uint64_t mmfr0 = ARM64_READ_SYSREG(ID_AA64MMFR0_EL1);
-    ASSERT((mmfr0 & ARM64_MMFR0_ASIDBITS_MASK) == ARM64_MMFR0_ASIDBITS_16);
+    if ((mmfr0 & ARM64_MMFR0_ASIDBITS_MASK) != ARM64_MMFR0_ASIDBITS_16) {
+        arm64_asid_bits = 8;
+    }
 }
 
 static void print_feature() {
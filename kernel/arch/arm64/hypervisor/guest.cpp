@@ -91,6 +91,11 @@ zx_status_t Guest::SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
     return traps_.InsertTrap(kind, addr, len, fbl::move(port), key);
 }
 
+zx_status_t Guest::GetDirtyPages(zx_vaddr_t addr, size_t len, uint64_t* bitmap) {
+    // TODO: Use the hardware dirty state of stage 2 descriptors, from ARMv8.1.
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
 zx_status_t Guest::AllocVpid(uint8_t* vpid) {
     fbl::AutoLock lock(&vcpu_mutex_);
     return vpid_allocator_.AllocId(vpid);
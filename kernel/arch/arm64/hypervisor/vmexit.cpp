@@ -14,7 +14,6 @@
 #include <arch/hypervisor.h>
 #include <dev/psci.h>
 #include <dev/timer/arm_generic.h>
-#include <vm/fault.h>
 #include <vm/physmap.h>
 #include <zircon/syscalls/hypervisor.h>
 #include <zircon/syscalls/port.h>
@@ -190,15 +189,9 @@ static zx_status_t handle_system_instruction(uint32_t iss, uint64_t* hcr, GuestS
     return ZX_ERR_NOT_SUPPORTED;
 }
 
-static zx_status_t handle_page_fault(zx_vaddr_t guest_paddr,
-                                     hypervisor::GuestPhysicalAddressSpace* gpas) {
-    uint pf_flags = VMM_PF_FLAG_HW_FAULT | VMM_PF_FLAG_WRITE | VMM_PF_FLAG_INSTRUCTION;
-    return vmm_guest_page_fault_handler(guest_paddr, pf_flags, gpas->aspace());
-}
-
 static zx_status_t handle_instruction_abort(GuestState* guest_state,
                                             hypervisor::GuestPhysicalAddressSpace* gpas) {
-    zx_status_t status = handle_page_fault(guest_state->hpfar_el2, gpas);
+    zx_status_t status = gpas->PageFault(guest_state->hpfar_el2);
     if (status != ZX_OK) {
         dprintf(CRITICAL, "Unhandled instruction abort %#lx\n",
                 guest_state->hpfar_el2);
@@ -215,7 +208,7 @@ static zx_status_t handle_data_abort(uint32_t iss, GuestState* guest_state,
     zx_status_t status = traps->FindTrap(ZX_GUEST_TRAP_BELL, guest_paddr, &trap);
     switch (status) {
     case ZX_ERR_NOT_FOUND:
-        status = handle_page_fault(guest_paddr, gpas);
+        status = gpas->PageFault(guest_paddr);
         if (status != ZX_OK) {
             dprintf(CRITICAL, "Unhandled data abort %#lx\n", guest_paddr);
         }
@@ -225,6 +218,7 @@ static zx_status_t handle_data_abort(uint32_t iss, GuestState* guest_state,
     default:
         return status;
     }
+    gpas->CountTrapFault();
     next_pc(guest_state);
 
     // Combine the lower bits of FAR_EL2 with HPFAR_EL2 to get the exact IPA.
@@ -237,6 +231,7 @@ static zx_status_t handle_data_abort(uint32_t iss, GuestState* guest_state,
         packet->key = trap->key();
         packet->type = ZX_PKT_TYPE_GUEST_BELL;
         packet->guest_bell.addr = guest_paddr;
+        packet->guest_bell.count = trap->CountAccess();
         if (trap->HasPort())
             return trap->Queue(*packet, nullptr);
         // If there was no port for the range, then return to user-space.
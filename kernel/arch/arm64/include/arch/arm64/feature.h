@@ -25,6 +25,9 @@ extern uint32_t arm64_zva_size;
 extern uint32_t arm64_icache_size;
 extern uint32_t arm64_dcache_size;
 
+/* number of ASID bits implemented by every cpu */
+extern uint32_t arm64_asid_bits;
+
 // call on every cpu to initialize the feature set
 void arm64_feature_init(void);
 
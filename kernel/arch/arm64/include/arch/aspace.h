@@ -8,6 +8,7 @@
 #pragma once
 
 #include <arch/arm64/mmu.h>
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
 #include <vm/arch_vm_aspace.h>
@@ -58,6 +59,9 @@ private:
 
     void FreePageTable(void* vaddr, paddr_t paddr, uint page_size_shift) TA_REQ(lock_);
 
+    zx_status_t SplitLargePage(vaddr_t vaddr, uint index_shift, uint page_size_shift,
+                               vaddr_t index, volatile pte_t* page_table) TA_REQ(lock_);
+
     ssize_t MapPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
                          paddr_t paddr_in, size_t size_in, pte_t attrs,
                          uint index_shift, uint page_size_shift,
@@ -94,8 +98,14 @@ private:
 
     fbl::Mutex lock_;
 
+    // The kernel ASID, or the VMID for a guest aspace.  User aspaces get
+    // their ASID from |asid_context_| instead.
     uint16_t asid_ = MMU_ARM64_UNUSED_ASID;
 
+    // ASID and allocator generation of a user aspace, or 0 if it has not yet
+    // been switched to.
+    fbl::atomic<uint64_t> asid_context_{0};
+
     // Pointer to the translation table.
     paddr_t tt_phys_ = 0;
     volatile pte_t* tt_virt_ = nullptr;
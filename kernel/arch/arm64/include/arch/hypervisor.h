@@ -40,6 +40,8 @@ public:
     hypervisor::TrapMap* Traps() { return &traps_; }
     uint8_t Vmid() const { return vmid_; }
 
+    zx_status_t GetDirtyPages(zx_vaddr_t addr, size_t len, uint64_t* bitmap);
+
     zx_status_t AllocVpid(uint8_t* vpid);
     zx_status_t FreeVpid(uint8_t vpid);
 
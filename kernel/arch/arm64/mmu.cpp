@@ -6,6 +6,7 @@
 // https://opensource.org/licenses/MIT
 
 #include <arch/arm64/el2_state.h>
+#include <arch/arm64/feature.h>
 #include <arch/arm64/mmu.h>
 #include <arch/aspace.h>
 #include <arch/mmu.h>
@@ -19,7 +20,10 @@
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
+#include <kernel/auto_lock.h>
+#include <kernel/cpu.h>
 #include <kernel/mutex.h>
+#include <lib/counters.h>
 #include <lib/heap.h>
 #include <lib/ktrace.h>
 #include <rand.h>
@@ -61,69 +65,177 @@ pte_t* arm64_get_kernel_ptable() {
     return arm64_kernel_translation_table;
 }
 
+KCOUNTER(asid_switch_fast, "kernel.mmu.asid.switch_fast");
+KCOUNTER(asid_rollovers, "kernel.mmu.asid.rollovers");
+KCOUNTER(asid_rollover_flushes, "kernel.mmu.asid.rollover_flushes");
+
 namespace {
 
+// User aspaces are given an ASID lazily, the first time they are switched to
+// in each generation of the allocator.  An aspace's ASID context holds the
+// ASID in its low bits and the generation it was allocated in above them.
+// When the ASIDs run out the generation is bumped and every CPU flushes its
+// local TLB the next time it switches.  Aspaces then pick up new ASIDs as they
+// run again, so the number of aspaces is not limited by the ASID width.  The
+// ASIDs live on each CPU at the rollover stay reserved, so those CPUs can keep
+// running without reallocating.
 class AsidAllocator {
 public:
-    AsidAllocator() { bitmap_.Reset(MMU_ARM64_MAX_USER_ASID + 1); }
+    AsidAllocator() { bitmap_.Reset(kMaxAsids); }
     ~AsidAllocator() = default;
 
-    zx_status_t Alloc(uint16_t* asid);
-    zx_status_t Free(uint16_t asid);
+    // Return the ASID to run the aspace owning |context| with on this CPU,
+    // allocating one if it doesn't have one from the current generation.
+    // Must be called with interrupts disabled.
+    uint16_t Switch(fbl::atomic<uint64_t>* context);
+
+    static uint16_t ContextAsid(uint64_t context) { return context & kAsidMask; }
 
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(AsidAllocator);
 
-    fbl::Mutex lock_;
-    uint16_t last_ TA_GUARDED(lock_) = MMU_ARM64_FIRST_USER_ASID - 1;
+    static constexpr uint kGenerationShift = 16;
+    static constexpr uint64_t kAsidMask = (1ul << kGenerationShift) - 1;
+    static constexpr size_t kMaxAsids = 1ul << MMU_ARM64_ASID_BITS;
+    static_assert(MMU_ARM64_ASID_BITS <= kGenerationShift, "");
+
+    bool IsCurrent(uint64_t context) const {
+        return ((context ^ generation_.load()) >> kGenerationShift) == 0;
+    }
+
+    uint64_t NewAsidLocked(uint64_t context) TA_REQ(lock_);
+    void RolloverLocked() TA_REQ(lock_);
+    bool UpdateReservedLocked(uint64_t context, uint64_t new_context) TA_REQ(lock_);
+
+    SpinLock lock_;
+
+    // The current generation, in the bits above kGenerationShift.  Starting
+    // at one means a context of 0 is never current.
+    fbl::atomic<uint64_t> generation_{1ul << kGenerationShift};
+
+    // The context each CPU is running, or 0 if a rollover has happened since
+    // it last switched.
+    fbl::atomic<uint64_t> active_[SMP_MAX_CPUS];
 
-    bitmap::RawBitmapGeneric<bitmap::FixedStorage<MMU_ARM64_MAX_USER_ASID + 1>> bitmap_ TA_GUARDED(lock_);
+    // The context each CPU was running at the last rollover.
+    uint64_t reserved_[SMP_MAX_CPUS] TA_GUARDED(lock_) = {};
 
-    static_assert(MMU_ARM64_ASID_BITS <= 16, "");
+    // CPUs that have to flush their TLB before running a new ASID.
+    cpu_mask_t flush_pending_ TA_GUARDED(lock_) = 0;
+
+    size_t last_ TA_GUARDED(lock_) = MMU_ARM64_FIRST_USER_ASID;
+
+    // ASIDs handed out in the current generation.
+    bitmap::RawBitmapGeneric<bitmap::FixedStorage<kMaxAsids>> bitmap_ TA_GUARDED(lock_);
 };
 
-zx_status_t AsidAllocator::Alloc(uint16_t* asid) {
-    uint16_t new_asid;
+uint16_t AsidAllocator::Switch(fbl::atomic<uint64_t>* context) {
+    DEBUG_ASSERT(arch_ints_disabled());
+    const cpu_num_t cpu = arch_curr_cpu_num();
+
+    // If the aspace's ASID is from the current generation and there hasn't
+    // been a rollover since this CPU last switched, just take it.  A rollover
+    // racing with us clears |active_|, failing the exchange.
+    uint64_t current = context->load();
+    uint64_t old_active = active_[cpu].load();
+    if (old_active != 0 && IsCurrent(current) &&
+        active_[cpu].compare_exchange_strong(&old_active, current, fbl::memory_order_seq_cst,
+                                             fbl::memory_order_seq_cst)) {
+        kcounter_add(asid_switch_fast, 1);
+        return ContextAsid(current);
+    }
 
-    // use the bitmap allocator to allocate ids in the range of
-    // [MMU_ARM64_FIRST_USER_ASID, MMU_ARM64_MAX_USER_ASID]
-    // start the search from the last found id + 1 and wrap when hitting the end of the range
-    {
-        fbl::AutoLock al(&lock_);
-
-        size_t val;
-        bool notfound = bitmap_.Get(last_ + 1, MMU_ARM64_MAX_USER_ASID + 1, &val);
-        if (unlikely(notfound)) {
-            // search again from the start
-            notfound = bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, MMU_ARM64_MAX_USER_ASID + 1, &val);
-            if (unlikely(notfound)) {
-                TRACEF("ARM64: out of ASIDs\n");
-                return ZX_ERR_NO_MEMORY;
-            }
-        }
-        bitmap_.SetOne(val);
+    AutoSpinLockNoIrqSave guard(&lock_);
+
+    current = context->load();
+    if (!IsCurrent(current)) {
+        current = NewAsidLocked(current);
+        context->store(current);
+        // Make sure page table updates made by anyone who saw the old context
+        // are visible to walks under the new ASID.
+        DSB;
+    }
+
+    const cpu_mask_t cpu_bit = cpu_num_to_mask(cpu);
+    if (flush_pending_ & cpu_bit) {
+        flush_pending_ &= ~cpu_bit;
+        __asm__ volatile("tlbi vmalle1; dsb nsh; isb" ::: "memory");
+        kcounter_add(asid_rollover_flushes, 1);
+    }
+
+    active_[cpu].store(current);
+    return ContextAsid(current);
+}
+
+uint64_t AsidAllocator::NewAsidLocked(uint64_t context) {
+    const size_t num_asids = 1ul << arm64_asid_bits;
+    DEBUG_ASSERT(num_asids <= kMaxAsids);
 
-        DEBUG_ASSERT(val <= UINT16_MAX);
+    if (context != 0) {
+        const uint16_t old_asid = ContextAsid(context);
+        const uint64_t new_context = generation_.load() | old_asid;
+
+        // An ASID that was running at the rollover is reserved for its owner.
+        if (UpdateReservedLocked(context, new_context)) {
+            return new_context;
+        }
 
-        new_asid = (uint16_t)val;
-        last_ = new_asid;
+        // Otherwise try to hold on to the same ASID.
+        if (!bitmap_.GetOne(old_asid)) {
+            bitmap_.SetOne(old_asid);
+            return new_context;
+        }
     }
 
-    LTRACEF("new asid %#x\n", new_asid);
+    // Search from the last allocation, then from the start of the range, and
+    // roll over if both fail.
+    size_t val;
+    if (bitmap_.Get(last_, num_asids, &val) &&
+        bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, num_asids, &val)) {
+        RolloverLocked();
+        __UNUSED bool full = bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, num_asids, &val);
+        // At most one ASID per CPU survives a rollover.
+        DEBUG_ASSERT(!full);
+    }
+    bitmap_.SetOne(val);
+    last_ = val;
 
-    *asid = new_asid;
+    LTRACEF("new asid %#zx\n", val);
 
-    return ZX_OK;
+    return generation_.load() | val;
 }
 
-zx_status_t AsidAllocator::Free(uint16_t asid) {
-    LTRACEF("free asid %#x\n", asid);
+void AsidAllocator::RolloverLocked() {
+    generation_.fetch_add(1ul << kGenerationShift);
+    bitmap_.ClearAll();
 
-    fbl::AutoLock al(&lock_);
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; ++cpu) {
+        uint64_t context = active_[cpu].exchange(0);
+        // A CPU that hasn't switched since the previous rollover is still
+        // running what it had then.
+        if (context == 0) {
+            context = reserved_[cpu];
+        }
+        if (context != 0) {
+            bitmap_.SetOne(ContextAsid(context));
+        }
+        reserved_[cpu] = context;
+    }
 
-    bitmap_.ClearOne(asid);
+    flush_pending_ = static_cast<cpu_mask_t>(~0u);
+    last_ = MMU_ARM64_FIRST_USER_ASID;
+    kcounter_add(asid_rollovers, 1);
+}
 
-    return ZX_OK;
+bool AsidAllocator::UpdateReservedLocked(uint64_t context, uint64_t new_context) {
+    bool hit = false;
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; ++cpu) {
+        if (reserved_[cpu] == context) {
+            reserved_[cpu] = new_context;
+            hit = true;
+        }
+    }
+    return hit;
 }
 
 AsidAllocator asid;
@@ -453,15 +565,72 @@ void ArmArchVmAspace::FlushTLBEntry(vaddr_t vaddr, bool terminal) {
             ARM64_TLBI(vaae1is, vaddr >> 12);
         }
     } else {
-        // flush this address for the specific asid
+        // An aspace that has never been switched to can't have anything in
+        // the TLB.
+        const uint64_t context = asid_context_.load();
+        if (context == 0) {
+            return;
+        }
+
+        // flush this address for the specific asid.  If the ASID is from an
+        // old generation this may also hit its new owner, which is harmless.
+        const vaddr_t user_asid = AsidAllocator::ContextAsid(context);
         if (terminal) {
-            ARM64_TLBI(vale1is, vaddr >> 12 | (vaddr_t)asid_ << 48);
+            ARM64_TLBI(vale1is, vaddr >> 12 | user_asid << 48);
         } else {
-            ARM64_TLBI(vae1is, vaddr >> 12 | (vaddr_t)asid_ << 48);
+            ARM64_TLBI(vae1is, vaddr >> 12 | user_asid << 48);
         }
     }
 }
 
+// Replace the block mapping at |page_table[index]| with a table of next level
+// entries covering the same range with the same attributes, so that part of
+// the block can be unmapped or protected.
+// NOTE: caller must DSB afterwards to ensure TLB entries are flushed
+zx_status_t ArmArchVmAspace::SplitLargePage(vaddr_t vaddr, uint index_shift, uint page_size_shift,
+                                            vaddr_t index, volatile pte_t* page_table) {
+    DEBUG_ASSERT(index_shift > page_size_shift);
+
+    const pte_t pte = page_table[index];
+    DEBUG_ASSERT((pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK);
+
+    paddr_t page_table_paddr;
+    zx_status_t ret = AllocPageTable(&page_table_paddr, page_size_shift);
+    if (ret) {
+        TRACEF("failed to allocate page table\n");
+        return ret;
+    }
+
+    const uint next_index_shift = index_shift - (page_size_shift - 3);
+    const pte_t descriptor = (next_index_shift > page_size_shift) ? MMU_PTE_L012_DESCRIPTOR_BLOCK
+                                                                  : MMU_PTE_L3_DESCRIPTOR_PAGE;
+    const pte_t attrs = pte & ~(MMU_PTE_OUTPUT_ADDR_MASK | MMU_PTE_DESCRIPTOR_MASK);
+    const paddr_t paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
+
+    volatile pte_t* next_page_table =
+        static_cast<volatile pte_t*>(paddr_to_physmap(page_table_paddr));
+    const size_t count = 1UL << (page_size_shift - 3);
+    for (size_t i = 0; i < count; i++) {
+        next_page_table[i] = (paddr + (i << next_index_shift)) | attrs | descriptor;
+    }
+
+    LTRACEF("split block pte %p[%#" PRIxPTR "] %#" PRIx64 " into table %#" PRIxPTR "\n",
+            page_table, index, pte, page_table_paddr);
+
+    // break before make: the block has to be invalidated and flushed before
+    // the table can be put in its place
+    page_table[index] = MMU_PTE_DESCRIPTOR_INVALID;
+    DMB_ISHST;
+    FlushTLBEntry(vaddr, true);
+
+    page_table[index] = page_table_paddr | MMU_PTE_L012_DESCRIPTOR_TABLE;
+
+    // ensure that the update is observable from hardware page table walkers
+    DMB_ISHST;
+
+    return ZX_OK;
+}
+
 // NOTE: caller must DSB afterwards to ensure TLB entries are flushed
 ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
                                         size_t size, uint index_shift,
@@ -490,6 +659,16 @@ ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
 
         pte = page_table[index];
 
+        // only unmapping part of a block, break it up first
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            zx_status_t status = SplitLargePage(vaddr, index_shift, page_size_shift, index,
+                                                page_table);
+            if (status != ZX_OK)
+                return status;
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
@@ -654,6 +833,16 @@ int ArmArchVmAspace::ProtectPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
         index = vaddr_rel >> index_shift;
         pte = page_table[index];
 
+        // only protecting part of a block, break it up first
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            ret = SplitLargePage(vaddr, index_shift, page_size_shift, index, page_table);
+            if (ret != 0) {
+                goto err;
+            }
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
@@ -1010,8 +1199,7 @@ zx_status_t ArmArchVmAspace::Init(vaddr_t base, size_t size, uint flags) {
             DEBUG_ASSERT(base + size <= 1UL << MMU_GUEST_SIZE_SHIFT);
         } else {
             DEBUG_ASSERT(base + size <= 1UL << MMU_USER_SIZE_SHIFT);
-            if (asid.Alloc(&asid_) != ZX_OK)
-                return ZX_ERR_NO_MEMORY;
+            // The ASID is assigned when the aspace is first switched to.
         }
 
         base_ = base;
@@ -1055,9 +1243,11 @@ zx_status_t ArmArchVmAspace::Destroy() {
         __UNUSED zx_status_t status = arm64_el2_tlbi_vmid(vttbr);
         DEBUG_ASSERT(status == ZX_OK);
     } else {
-        ARM64_TLBI(ASIDE1IS, asid_);
-        asid.Free(asid_);
-        asid_ = MMU_ARM64_UNUSED_ASID;
+        // The ASID itself stays allocated until the next rollover.
+        const uint64_t context = asid_context_.load();
+        if (context != 0) {
+            ARM64_TLBI(ASIDE1IS, AsidAllocator::ContextAsid(context));
+        }
     }
 
     return ZX_OK;
@@ -1074,7 +1264,7 @@ void ArmArchVmAspace::ContextSwitch(ArmArchVmAspace* old_aspace, ArmArchVmAspace
         DEBUG_ASSERT((aspace->flags_ & (ARCH_ASPACE_FLAG_KERNEL | ARCH_ASPACE_FLAG_GUEST)) == 0);
 
         tcr = MMU_TCR_FLAGS_USER;
-        ttbr = ((uint64_t)aspace->asid_ << 48) | aspace->tt_phys_;
+        ttbr = ((uint64_t)asid.Switch(&aspace->asid_context_) << 48) | aspace->tt_phys_;
         ARM64_WRITE_SYSREG(ttbr0_el1, ttbr);
 
         if (TRACE_CONTEXT_SWITCH)
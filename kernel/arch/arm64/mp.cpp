@@ -83,6 +83,21 @@ zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t i
     return interrupt_send_ipi(mask, ipi);
 }
 
+uint arch_mp_cpu_distance(cpu_num_t a, cpu_num_t b) {
+    if (a == b) {
+        return MP_CPU_DISTANCE_SAME;
+    }
+    if (a >= arm_num_cpus || b >= arm_num_cpus) {
+        return MP_CPU_DISTANCE_REMOTE;
+    }
+
+    // cpus within a cluster share the L2
+    if (arm64_cpu_cluster_ids[a] == arm64_cpu_cluster_ids[b]) {
+        return MP_CPU_DISTANCE_CLUSTER;
+    }
+    return MP_CPU_DISTANCE_REMOTE;
+}
+
 void arm64_init_percpu_early(void) {
     // slow lookup the current cpu id and setup the percpu structure
     uint cpu = arch_curr_cpu_num_slow();
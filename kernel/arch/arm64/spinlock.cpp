@@ -12,38 +12,61 @@
 // implementing the locks themselves.  Without this, the header-level
 // annotations cause Clang to detect violations.
 
+namespace {
+
+constexpr uint32_t kNextTicket = 1u << 16;
+
+uint16_t serving(uint32_t tickets) {
+    return static_cast<uint16_t>(tickets);
+}
+
+uint16_t next(uint32_t tickets) {
+    return static_cast<uint16_t>(tickets >> 16);
+}
+
+} // namespace
+
 void arch_spin_lock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
-    unsigned long val = arch_curr_cpu_num() + 1;
-    uint64_t temp;
-
-    __asm__ volatile(
-        "sevl;"
-        "1: wfe;"
-        "ldaxr   %[temp], [%[lock]];"
-        "cbnz    %[temp], 1b;"
-        "stxr    %w[temp], %[val], [%[lock]];"
-        "cbnz    %w[temp], 1b;"
-        : [temp] "=&r"(temp)
-        : [lock] "r"(&lock->value), [val] "r"(val)
-        : "cc", "memory");
+    const uint32_t tickets = __atomic_fetch_add(&lock->tickets, kNextTicket, __ATOMIC_ACQUIRE);
+    const uint32_t ticket = next(tickets);
+
+    if (serving(tickets) != ticket) {
+        // Sleep in wfe until our ticket comes up. The exclusive load of the
+        // low half arms the monitor, so the holder's store in
+        // arch_spin_unlock() is what wakes us.
+        uint32_t temp;
+        __asm__ volatile(
+            "sevl;"
+            "1: wfe;"
+            "ldaxrh  %w[temp], [%[lock]];"
+            "eor     %w[temp], %w[temp], %w[ticket];"
+            "cbnz    %w[temp], 1b;"
+            : [temp] "=&r"(temp)
+            : [lock] "r"(&lock->tickets), [ticket] "r"(ticket)
+            : "cc", "memory");
+    }
+
+    __atomic_store_n(&lock->holder, arch_curr_cpu_num() + 1, __ATOMIC_RELAXED);
 }
 
 int arch_spin_trylock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
-    unsigned long val = arch_curr_cpu_num() + 1;
-    uint64_t out;
-
-    __asm__ volatile(
-        "ldaxr   %[out], [%[lock]];"
-        "cbnz    %[out], 1f;"
-        "stxr    %w[out], %[val], [%[lock]];"
-        "1:"
-        : [out] "=&r"(out)
-        : [lock] "r"(&lock->value), [val] "r"(val)
-        : "cc", "memory");
-
-    return (int)out;
+    uint32_t tickets = __atomic_load_n(&lock->tickets, __ATOMIC_RELAXED);
+    if (serving(tickets) != next(tickets))
+        return 1;
+    if (!__atomic_compare_exchange_n(&lock->tickets, &tickets, tickets + kNextTicket, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 1;
+
+    __atomic_store_n(&lock->holder, arch_curr_cpu_num() + 1, __ATOMIC_RELAXED);
+    return 0;
 }
 
 void arch_spin_unlock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
-    __atomic_store_n(&lock->value, 0UL, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&lock->holder, 0u, __ATOMIC_RELAXED);
+
+    // Only the holder moves the low half on, so a plain store of it is
+    // enough and cannot disturb tickets being taken from the high half.
+    // The tickets are little endian, with the low half first.
+    uint16_t* owner = reinterpret_cast<uint16_t*>(&lock->tickets);
+    __atomic_store_n(owner, static_cast<uint16_t>(*owner + 1), __ATOMIC_RELEASE);
 }
@@ -29,3 +29,7 @@ zx_status_t arch_copy_to_user(void* dst, const void* src, size_t len) {
     return _arm64_user_copy(dst, src, len,
                             &get_current_thread()->arch.data_fault_resume);
 }
+
+zx_status_t arch_copy_from_user_nontemporal(void* dst, const void* src, size_t len) {
+    return arch_copy_from_user(dst, src, len);
+}
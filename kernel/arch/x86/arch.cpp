@@ -66,6 +66,21 @@ void arch_init(void) {
     x86_processor_trace_init();
 }
 
+bool arch_idle_wakes_on_write() {
+    return x86_feature_test(X86_FEATURE_MON);
+}
+
+void arch_idle_wait(volatile uint32_t* word, uint32_t mask) {
+    // Arm the monitor before looking at the word, so a store landing
+    // between the check and the mwait still ends the wait. Interrupts are
+    // enabled in the idle thread, and also end it.
+    __asm__ volatile("monitor" ::"a"(word), "c"(0), "d"(0));
+    if (*word & mask)
+        return;
+    __asm__ volatile("mwait" ::"a"(0), "c"(0)
+                     : "memory");
+}
+
 void arch_enter_uspace(uintptr_t entry_point, uintptr_t sp,
                        uintptr_t arg1, uintptr_t arg2) {
     LTRACEF("entry %#" PRIxPTR " user stack %#" PRIxPTR "\n", entry_point, sp);
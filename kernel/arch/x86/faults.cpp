@@ -331,6 +331,16 @@ static void x86_iframe_process_pending_signals(x86_iframe_t* frame) {
 
 /* top level x86 exception handler for most exceptions and irqs */
 void x86_exception_handler(x86_iframe_t* frame) {
+    // A page fault in x86_copy_from_user_nofault() is not handled, so that
+    // it can be used from an interrupt handler.
+    if (unlikely(frame->vector == X86_INT_PAGE_FAULT)) {
+        thread_t* current_thread = get_current_thread();
+        if (unlikely(current_thread->arch.page_fault_nofault_resume)) {
+            frame->ip = (uintptr_t)current_thread->arch.page_fault_nofault_resume;
+            return;
+        }
+    }
+
     // are we recursing?
     if (unlikely(arch_in_int_handler()) && frame->vector != X86_INT_NMI) {
         exception_die(frame, "recursion in interrupt handler\n");
@@ -420,6 +430,13 @@ void x86_exception_handler(x86_iframe_t* frame) {
         /* no return */
         break;
     }
+    case X86_INT_VMX_POSTED_INTERRUPT: {
+        // The notification for an interrupt posted to a VCPU, which arrived
+        // while the VCPU was not running. The VCPU picks up the interrupt
+        // when it is next resumed.
+        apic_issue_eoi();
+        break;
+    }
     case X86_INT_APIC_PMI: {
         apic_pmi_interrupt_handler(frame);
         // Note: apic_pmi_interrupt_handler calls apic_issue_eoi().
@@ -6,11 +6,25 @@
 
 #include <arch/x86/apic.h>
 #include <arch/x86/feature.h>
+#include <hypervisor/cpu.h>
 #include <zircon/syscalls/hypervisor.h>
 
+#include "vcpu_priv.h"
 #include "vmx_cpu_state_priv.h"
 
-static void ignore_msr(VmxPage* msr_bitmaps_page, uint32_t msr) {
+// x2APIC MSRs, from Volume 3, Section 10.12.1.2.
+static const uint32_t kX2ApicMsrTpr = 0x808;
+static const uint32_t kX2ApicMsrPpr = 0x80a;
+static const uint32_t kX2ApicMsrEoi = 0x80b;
+static const uint32_t kX2ApicMsrIsr0 = 0x810;
+static const uint32_t kX2ApicMsrIrr0 = 0x820;
+static const uint32_t kX2ApicMsrSelfIpi = 0x83f;
+
+static zx_status_t invept_task(void* context, cpu_num_t cpu_num) {
+    return invept(InvEpt::SINGLE_CONTEXT, *static_cast<uint64_t*>(context));
+}
+
+static void ignore_msr_access(VmxPage* msr_bitmaps_page, uint32_t msr, bool reads, bool writes) {
     // From Volume 3, Section 24.6.9.
     uint8_t* msr_bitmaps = msr_bitmaps_page->VirtualAddress<uint8_t>();
     if (msr >= 0xc0000000)
@@ -21,11 +35,32 @@ static void ignore_msr(VmxPage* msr_bitmaps_page, uint32_t msr) {
     uint8_t msr_bit = msr_low % 8;
 
     // Ignore reads to the MSR.
-    msr_bitmaps[msr_byte] &= (uint8_t) ~(1 << msr_bit);
+    if (reads)
+        msr_bitmaps[msr_byte] &= (uint8_t) ~(1 << msr_bit);
 
     // Ignore writes to the MSR.
     msr_bitmaps += 2 << 10;
-    msr_bitmaps[msr_byte] &= (uint8_t) ~(1 << msr_bit);
+    if (writes)
+        msr_bitmaps[msr_byte] &= (uint8_t) ~(1 << msr_bit);
+}
+
+static void ignore_msr(VmxPage* msr_bitmaps_page, uint32_t msr) {
+    ignore_msr_access(msr_bitmaps_page, msr, true, true);
+}
+
+// From Volume 3, Section 29.5: With virtual-interrupt delivery, accesses to
+// the x2APIC registers it maintains are virtualized rather than causing a VM
+// exit, as long as the MSR bitmaps allow them. The other registers are still
+// emulated by vmexit.cpp.
+static void ignore_virtualized_apic_msrs(VmxPage* msr_bitmaps_page) {
+    ignore_msr(msr_bitmaps_page, kX2ApicMsrTpr);
+    ignore_msr_access(msr_bitmaps_page, kX2ApicMsrPpr, true, false);
+    ignore_msr_access(msr_bitmaps_page, kX2ApicMsrEoi, false, true);
+    for (uint32_t i = 0; i < 8; i++) {
+        ignore_msr_access(msr_bitmaps_page, kX2ApicMsrIsr0 + i, true, false);
+        ignore_msr_access(msr_bitmaps_page, kX2ApicMsrIrr0 + i, true, false);
+    }
+    ignore_msr_access(msr_bitmaps_page, kX2ApicMsrSelfIpi, false, true);
 }
 
 // static
@@ -64,6 +99,13 @@ zx_status_t Guest::Create(fbl::RefPtr<VmObject> physmem, fbl::unique_ptr<Guest>*
     ignore_msr(&guest->msr_bitmaps_page_, X86_MSR_IA32_TSC_ADJUST);
     ignore_msr(&guest->msr_bitmaps_page_, X86_MSR_IA32_TSC_AUX);
 
+    guest->apic_virtualization_ = apic_virtualization_supported();
+    if (guest->apic_virtualization_)
+        ignore_virtualized_apic_msrs(&guest->msr_bitmaps_page_);
+
+    EptInfo ept_info;
+    guest->dirty_tracking_ = ept_info.accessed_dirty;
+
     // Setup VPID allocator
     fbl::AutoLock lock(&guest->vcpu_mutex_);
     status = guest->vpid_allocator_.Init();
@@ -107,6 +149,23 @@ zx_status_t Guest::SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
     return traps_.InsertTrap(kind, addr, len, fbl::move(port), key);
 }
 
+zx_status_t Guest::GetDirtyPages(zx_vaddr_t addr, size_t len, uint64_t* bitmap) {
+    if (!dirty_tracking_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    ArchVmAspace& aspace = gpas_->aspace()->arch_aspace();
+    zx_status_t status = aspace.HarvestDirty(addr, len / PAGE_SIZE, bitmap);
+    if (status != ZX_OK)
+        return status;
+
+    // From Volume 3, Section 28.3.3: Translations cached with the dirty flag
+    // set are used without setting it again, so a CPU which ran a VCPU of
+    // this guest must drop them before the next write is seen.
+    uint64_t eptp = ept_pointer(aspace.arch_table_phys(), true);
+    hypervisor::percpu_exec(invept_task, &eptp);
+    return ZX_OK;
+}
+
 zx_status_t Guest::AllocVpid(uint16_t* vpid) {
     fbl::AutoLock lock(&vcpu_mutex_);
     return vpid_allocator_.AllocId(vpid);
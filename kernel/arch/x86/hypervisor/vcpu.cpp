@@ -8,9 +8,12 @@
 
 #include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/mp.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <hypervisor/cpu.h>
 #include <kernel/mp.h>
+#include <lib/counters.h>
 #include <vm/fault.h>
 #include <vm/pmm.h>
 #include <vm/vm_object.h>
@@ -28,6 +31,10 @@ static constexpr uint32_t kInterruptInfoDeliverErrorCode = 1u << 11;
 static constexpr uint32_t kInterruptTypeHardwareException = 3u << 8;
 static constexpr uint16_t kBaseProcessorVpid = 1;
 
+KCOUNTER(interrupts_posted, "kernel.hypervisor.interrupts.posted");
+KCOUNTER(interrupts_notified, "kernel.hypervisor.interrupts.notified");
+KCOUNTER(interrupts_kicked, "kernel.hypervisor.interrupts.kicked");
+
 static zx_status_t vmptrld(paddr_t pa) {
     uint8_t err;
 
@@ -206,6 +213,49 @@ zx_status_t AutoVmcs::SetControl(VmcsField32 controls, uint64_t true_msr, uint64
     return ZX_OK;
 }
 
+bool PostedInterruptDescriptor::Post(uint8_t vector) {
+    __atomic_fetch_or(&pir[vector / 64], 1ul << (vector % 64), __ATOMIC_SEQ_CST);
+    uint64_t old_control = __atomic_fetch_or(&control, kPostedInterruptOutstanding,
+                                             __ATOMIC_SEQ_CST);
+    return (old_control & kPostedInterruptOutstanding) == 0;
+}
+
+bool PostedInterruptDescriptor::Pending() const {
+    return (__atomic_load_n(&control, __ATOMIC_SEQ_CST) & kPostedInterruptOutstanding) != 0;
+}
+
+uint8_t PostedInterruptDescriptor::Drain(uint32_t* virtual_apic) {
+    // Clear the notification first, so that an interrupt posted after we have
+    // looked at its bit sends another one.
+    uint64_t old_control = __atomic_fetch_and(&control, ~kPostedInterruptOutstanding,
+                                              __ATOMIC_SEQ_CST);
+    if ((old_control & kPostedInterruptOutstanding) == 0)
+        return 0;
+
+    // The IRR is eight 32-bit registers, each at the start of 16 bytes.
+    uint32_t* irr = virtual_apic + kApicIrrOffset / sizeof(uint32_t);
+    uint8_t highest = 0;
+    for (size_t i = 0; i < fbl::count_of(pir); i++) {
+        uint64_t posted = __atomic_exchange_n(&pir[i], 0, __ATOMIC_SEQ_CST);
+        if (posted == 0)
+            continue;
+        irr[i * 8] |= static_cast<uint32_t>(posted);
+        irr[i * 8 + 4] |= static_cast<uint32_t>(posted >> 32);
+        highest = static_cast<uint8_t>(i * 64 + 63 - __builtin_clzl(posted));
+    }
+    return highest;
+}
+
+bool apic_virtualization_supported() {
+    // From Volume 3, Appendix A.3: The upper 32 bits of the capability MSRs
+    // are the controls that may be set.
+    uint32_t procbased_ctls2 = kProcbasedCtls2ApicRegVirt | kProcbasedCtls2VirtIntDelivery;
+    uint64_t procbased_msr = read_msr(X86_MSR_IA32_VMX_PROCBASED_CTLS2);
+    uint64_t pinbased_msr = read_msr(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS);
+    return (BITS_SHIFT(procbased_msr, 63, 32) & procbased_ctls2) == procbased_ctls2 &&
+           (BITS_SHIFT(pinbased_msr, 63, 32) & kPinbasedCtlsPostedInterrupts) != 0;
+}
+
 AutoPin::AutoPin(uint16_t vpid)
     : prev_cpu_mask_(get_current_thread()->cpu_affinity), thread_(hypervisor::pin_thread(vpid)) {}
 
@@ -213,14 +263,17 @@ AutoPin::~AutoPin() {
     thread_set_cpu_affinity(thread_, prev_cpu_mask_);
 }
 
-static uint64_t ept_pointer(paddr_t pml4_address) {
+uint64_t ept_pointer(paddr_t pml4_address, bool accessed_dirty) {
     return
         // Physical address of the PML4 page, page aligned.
         pml4_address |
         // Use write back memory.
         VMX_MEMORY_TYPE_WRITE_BACK << 0 |
         // Page walk length of 4 (defined as N minus 1).
-        3u << 3;
+        3u << 3 |
+        // Whether the processor sets the accessed and dirty flags in EPT
+        // entries.
+        (accessed_dirty ? 1u << 6 : 0u);
 }
 
 struct MsrListEntry {
@@ -250,8 +303,13 @@ static void edit_msr_list(VmxPage* msr_list_page, size_t index, uint32_t msr, ui
 }
 
 zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t entry,
-                      paddr_t msr_bitmaps_address, paddr_t pml4_address, VmxState* vmx_state,
-                      VmxPage* host_msr_page, VmxPage* guest_msr_page) {
+                      paddr_t msr_bitmaps_address, paddr_t pml4_address,
+                      bool ept_accessed_dirty, VmxState* vmx_state,
+                      VmxPage* host_msr_page, VmxPage* guest_msr_page,
+                      paddr_t virtual_apic_address, paddr_t posted_interrupt_address) {
+    // If we were given a posted-interrupt descriptor, use APIC virtualization.
+    const bool apic_virtualization = posted_interrupt_address != 0;
+
     zx_status_t status = vmclear(vmcs_address);
     if (status != ZX_OK)
         return status;
@@ -283,15 +341,36 @@ zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t entry,
                     kProcbasedCtls2Invpcid,
                     0);
 
+    if (apic_virtualization) {
+        status = vmcs.SetControl(VmcsField32::PROCBASED_CTLS2,
+                                 read_msr(X86_MSR_IA32_VMX_PROCBASED_CTLS2),
+                                 vmcs.Read(VmcsField32::PROCBASED_CTLS2),
+                                 // Read x2APIC registers from the virtual-APIC
+                                 // page.
+                                 kProcbasedCtls2ApicRegVirt |
+                                     // Deliver interrupts from the virtual-APIC
+                                     // page, and virtualize EOIs.
+                                     kProcbasedCtls2VirtIntDelivery,
+                                 0);
+        if (status != ZX_OK)
+            return status;
+    }
+
     // Setup pin-based VMCS controls.
+    uint32_t pinbased_ctls =
+        // External interrupts cause a VM exit.
+        kPinbasedCtlsExtIntExiting |
+        // Non-maskable interrupts cause a VM exit.
+        kPinbasedCtlsNmiExiting;
+    if (apic_virtualization) {
+        // The notification vector delivers posted interrupts, rather than
+        // causing a VM exit.
+        pinbased_ctls |= kPinbasedCtlsPostedInterrupts;
+    }
     status = vmcs.SetControl(VmcsField32::PINBASED_CTLS,
                              read_msr(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS),
                              read_msr(X86_MSR_IA32_VMX_PINBASED_CTLS),
-                             // External interrupts cause a VM exit.
-                             kPinbasedCtlsExtIntExiting |
-                                 // Non-maskable interrupts cause a VM exit.
-                                 kPinbasedCtlsNmiExiting,
-                             0);
+                             pinbased_ctls, 0);
     if (status != ZX_OK)
         return status;
 
@@ -408,12 +487,30 @@ zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t entry,
     // treated as guest-physical addresses. Guest-physical addresses are
     // translated by traversing a set of EPT paging structures to produce
     // physical addresses that are used to access memory.
-    const auto eptp = ept_pointer(pml4_address);
+    const auto eptp = ept_pointer(pml4_address, ept_accessed_dirty);
     vmcs.Write(VmcsField64::EPT_POINTER, eptp);
 
     // Setup MSR handling.
     vmcs.Write(VmcsField64::MSR_BITMAPS_ADDRESS, msr_bitmaps_address);
 
+    // From Volume 3, Section 29.1: The TPR shadow, and with APIC
+    // virtualization the rest of the virtual APIC, live in the virtual-APIC
+    // page.
+    vmcs.Write(VmcsField64::VIRTUAL_APIC_ADDRESS, virtual_apic_address);
+    vmcs.Write(VmcsField32::TPR_THRESHOLD, 0);
+    if (apic_virtualization) {
+        // From Volume 3, Section 29.1.2: No vector causes a VM exit on EOI,
+        // as we do nothing with EOIs.
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_0, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_1, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_2, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_3, 0);
+        vmcs.Write(VmcsField16::GUEST_INTERRUPT_STATUS, 0);
+        vmcs.Write(VmcsField16::POSTED_INTERRUPT_NOTIFICATION_VECTOR,
+                   X86_INT_VMX_POSTED_INTERRUPT);
+        vmcs.Write(VmcsField64::POSTED_INTERRUPT_DESC_ADDRESS, posted_interrupt_address);
+    }
+
     edit_msr_list(host_msr_page, 0, X86_MSR_IA32_KERNEL_GS_BASE,
                   read_msr(X86_MSR_IA32_KERNEL_GS_BASE));
     edit_msr_list(host_msr_page, 1, X86_MSR_IA32_STAR, read_msr(X86_MSR_IA32_STAR));
@@ -636,13 +733,30 @@ zx_status_t Vcpu::Create(Guest* guest, zx_vaddr_t entry, fbl::unique_ptr<Vcpu>*
     status = vcpu->vmcs_page_.Alloc(vmx_info, 0);
     if (status != ZX_OK)
         return status;
+
+    status = vcpu->virtual_apic_page_.Alloc(vmx_info, 0);
+    if (status != ZX_OK)
+        return status;
+    vcpu->local_apic_state_.virtual_apic = vcpu->virtual_apic_page_.VirtualAddress<uint32_t>();
+
+    paddr_t posted_interrupt_address = 0;
+    if (guest->ApicVirtualization()) {
+        status = vcpu->posted_interrupt_page_.Alloc(vmx_info, 0);
+        if (status != ZX_OK)
+            return status;
+        vcpu->local_apic_state_.posted_interrupts =
+            vcpu->posted_interrupt_page_.VirtualAddress<PostedInterruptDescriptor>();
+        posted_interrupt_address = vcpu->posted_interrupt_page_.PhysicalAddress();
+    }
     auto_call.cancel();
 
     VmxRegion* region = vcpu->vmcs_page_.VirtualAddress<VmxRegion>();
     region->revision_id = vmx_info.revision_id;
     zx_paddr_t table = gpas->aspace()->arch_aspace().arch_table_phys();
     status = vmcs_init(vcpu->vmcs_page_.PhysicalAddress(), vpid, entry, guest->MsrBitmapsAddress(),
-                       table, &vcpu->vmx_state_, &vcpu->host_msr_page_, &vcpu->guest_msr_page_);
+                       table, guest->DirtyTracking(), &vcpu->vmx_state_, &vcpu->host_msr_page_,
+                       &vcpu->guest_msr_page_,
+                       vcpu->virtual_apic_page_.PhysicalAddress(), posted_interrupt_address);
     if (status != ZX_OK)
         return status;
 
@@ -686,12 +800,30 @@ static zx_status_t local_apic_maybe_interrupt(AutoVmcs* vmcs, LocalApicState* lo
     return ZX_OK;
 }
 
+// Moves the interrupts posted while the VCPU was not running into the
+// virtual-APIC page, and requests the delivery of the highest.
+static void drain_posted_interrupts(AutoVmcs* vmcs, LocalApicState* local_apic_state) {
+    uint8_t vector = local_apic_state->posted_interrupts->Drain(local_apic_state->virtual_apic);
+    if (vector == 0)
+        return;
+    // From Volume 3, Section 29.1.2: The low byte of the guest interrupt status
+    // is RVI, the highest vector requesting service.
+    uint16_t status = vmcs->Read(VmcsField16::GUEST_INTERRUPT_STATUS);
+    if (vector > (status & UINT8_MAX)) {
+        vmcs->Write(VmcsField16::GUEST_INTERRUPT_STATUS,
+                    static_cast<uint16_t>((status & ~UINT8_MAX) | vector));
+    }
+}
+
 zx_status_t Vcpu::Resume(zx_port_packet_t* packet) {
     if (!hypervisor::check_pinned_cpu_invariant(vpid_, thread_))
         return ZX_ERR_BAD_STATE;
     zx_status_t status;
     do {
         AutoVmcs vmcs(vmcs_page_.PhysicalAddress());
+        // The PCID our aspace runs with on this CPU may have changed since
+        // the last exit, so refresh the CR3 we return to.
+        vmcs.Write(VmcsFieldXX::HOST_CR3, x86_get_cr3());
         status = local_apic_maybe_interrupt(&vmcs, &local_apic_state_);
         if (status != ZX_OK) {
             return status;
@@ -706,6 +838,12 @@ zx_status_t Vcpu::Resume(zx_port_packet_t* packet) {
         pvclock_update_system_time(&pvclock_state_, guest_->AddressSpace());
 
         running_.store(true);
+        if (local_apic_state_.posted_interrupts != nullptr) {
+            // Interrupts posted from here on send a notification, which is
+            // held pending while interrupts are disabled, and taken by the
+            // VCPU once it has been entered.
+            drain_posted_interrupts(&vmcs, &local_apic_state_);
+        }
         status = vmx_enter(&vmx_state_);
         running_.store(false);
         if (x86_feature_test(X86_FEATURE_XSAVE)) {
@@ -741,11 +879,26 @@ void vmx_exit(VmxState* vmx_state) {
 }
 
 zx_status_t Vcpu::Interrupt(uint32_t vector) {
+    PostedInterruptDescriptor* posted_interrupts = local_apic_state_.posted_interrupts;
+    if (posted_interrupts != nullptr && vector >= X86_INT_PLATFORM_BASE && vector <= X86_INT_MAX) {
+        kcounter_add(interrupts_posted, 1u);
+        // If a notification is outstanding, it will deliver this interrupt too.
+        if (!posted_interrupts->Post(static_cast<uint8_t>(vector)))
+            return ZX_OK;
+        if (!local_apic_state_.interrupt_tracker.Signal() && running_.load()) {
+            // The VCPU takes the interrupt without a VM exit.
+            kcounter_add(interrupts_notified, 1u);
+            x86_send_ipi_vector(hypervisor::cpu_of(vpid_), X86_INT_VMX_POSTED_INTERRUPT);
+        }
+        return ZX_OK;
+    }
+
     bool signaled = false;
     zx_status_t status = local_apic_state_.interrupt_tracker.Interrupt(vector, &signaled);
     if (status != ZX_OK) {
         return status;
     } else if (!signaled && running_.load()) {
+        kcounter_add(interrupts_kicked, 1u);
         mp_reschedule(MP_IPI_TARGET_MASK, cpu_num_to_mask(hypervisor::cpu_of(vpid_)), 0);
     }
     return ZX_OK;
@@ -26,6 +26,8 @@ static const uint32_t kProcbasedCtls2Rdtscp             = 1u << 3;
 static const uint32_t kProcbasedCtls2x2Apic             = 1u << 4;
 static const uint32_t kProcbasedCtls2Vpid               = 1u << 5;
 static const uint32_t kProcbasedCtls2UnrestrictedGuest  = 1u << 7;
+static const uint32_t kProcbasedCtls2ApicRegVirt        = 1u << 8;
+static const uint32_t kProcbasedCtls2VirtIntDelivery    = 1u << 9;
 static const uint32_t kProcbasedCtls2Invpcid            = 1u << 12;
 
 // PROCBASED_CTLS flags.
@@ -43,6 +45,7 @@ static const uint32_t kProcbasedCtlsProcbasedCtls2      = 1u << 31;
 // PINBASED_CTLS flags.
 static const uint32_t kPinbasedCtlsExtIntExiting        = 1u << 0;
 static const uint32_t kPinbasedCtlsNmiExiting           = 1u << 3;
+static const uint32_t kPinbasedCtlsPostedInterrupts     = 1u << 7;
 
 // EXIT_CTLS flags.
 static const uint32_t kExitCtls64bitMode                = 1u << 9;
@@ -84,11 +87,20 @@ static const uint32_t kGuestXxAccessRightsDefault       = kGuestXxAccessRightsTy
 static const uint32_t kInterruptibilityStiBlocking      = 1u << 0;
 static const uint32_t kInterruptibilityMovSsBlocking    = 1u << 1;
 
+// Virtual-APIC page offsets, from Volume 3, Section 29.1.
+static const size_t kApicPprOffset                      = 0x0a0;
+static const size_t kApicIrrOffset                      = 0x200;
+
+// Posted-interrupt descriptor control flags.
+static const uint64_t kPostedInterruptOutstanding       = 1u << 0;
+
 // VMCS fields.
 enum class VmcsField16 : uint64_t {
     VPID                                                = 0x0000,
+    POSTED_INTERRUPT_NOTIFICATION_VECTOR                = 0x0002,
     GUEST_CS_SELECTOR                                   = 0x0802,
     GUEST_TR_SELECTOR                                   = 0x080e,
+    GUEST_INTERRUPT_STATUS                              = 0x0810,
     HOST_ES_SELECTOR                                    = 0x0c00,
     HOST_CS_SELECTOR                                    = 0x0c02,
     HOST_SS_SELECTOR                                    = 0x0c04,
@@ -103,7 +115,13 @@ enum class VmcsField64 : uint64_t {
     EXIT_MSR_STORE_ADDRESS                              = 0x2006,
     EXIT_MSR_LOAD_ADDRESS                               = 0x2008,
     ENTRY_MSR_LOAD_ADDRESS                              = 0x200a,
+    VIRTUAL_APIC_ADDRESS                                = 0x2012,
+    POSTED_INTERRUPT_DESC_ADDRESS                       = 0x2016,
     EPT_POINTER                                         = 0x201a,
+    EOI_EXIT_BITMAP_0                                   = 0x201c,
+    EOI_EXIT_BITMAP_1                                   = 0x201e,
+    EOI_EXIT_BITMAP_2                                   = 0x2020,
+    EOI_EXIT_BITMAP_3                                   = 0x2022,
     GUEST_PHYSICAL_ADDRESS                              = 0x2400,
     LINK_POINTER                                        = 0x2800,
     GUEST_IA32_PAT                                      = 0x2804,
@@ -125,6 +143,7 @@ enum class VmcsField32 : uint64_t {
     ENTRY_MSR_LOAD_COUNT                                = 0x4014,
     ENTRY_INTERRUPTION_INFORMATION                      = 0x4016,
     ENTRY_EXCEPTION_ERROR_CODE                          = 0x4018,
+    TPR_THRESHOLD                                       = 0x401c,
     PROCBASED_CTLS2                                     = 0x401e,
     INSTRUCTION_ERROR                                   = 0x4400,
     EXIT_REASON                                         = 0x4402,
@@ -199,6 +218,33 @@ enum class VmcsFieldXX : uint64_t {
 
 // clang-format on
 
+// From Volume 3, Section 29.6: An interrupt is posted to a VCPU by setting its
+// bit in |pir|, and then the outstanding-notification bit in |control|. If the
+// VCPU is running when it receives the notification vector, the processor
+// moves the posted interrupts into the virtual-APIC page without a VM exit.
+struct PostedInterruptDescriptor {
+    uint64_t pir[4];
+    uint64_t control;
+    uint64_t reserved[3];
+
+    // Posts |vector|, and returns whether a notification must be sent, which
+    // is not the case while an earlier one is still outstanding.
+    bool Post(uint8_t vector);
+    // Returns whether there are posted interrupts the VCPU has not taken.
+    bool Pending() const;
+    // Moves the posted interrupts into the IRR of |virtual_apic|, and returns
+    // the highest vector moved, or 0 if there were none.
+    uint8_t Drain(uint32_t* virtual_apic);
+} __ALIGNED(64);
+static_assert(sizeof(PostedInterruptDescriptor) == 64, "");
+
+// Returns whether the processor supports virtual-interrupt delivery and
+// posted interrupts, which we use together or not at all.
+bool apic_virtualization_supported();
+
+// Returns the EPT pointer for the EPT whose PML4 page is at |pml4_address|.
+uint64_t ept_pointer(paddr_t pml4_address, bool accessed_dirty);
+
 // Loads a VMCS within a given scope.
 class AutoVmcs : public hypervisor::StateInvalidator {
 public:
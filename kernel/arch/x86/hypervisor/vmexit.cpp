@@ -19,9 +19,9 @@
 #include <fbl/canary.h>
 #include <hypervisor/interrupt_tracker.h>
 #include <kernel/auto_lock.h>
+#include <lib/counters.h>
 #include <platform.h>
 #include <platform/pc/timer.h>
-#include <vm/fault.h>
 #include <vm/physmap.h>
 #include <vm/pmm.h>
 #include <zircon/syscalls/hypervisor.h>
@@ -50,6 +50,19 @@ static const char kHypVendorId[] = "KVMKVMKVM\0\0\0";
 static const size_t kHypVendorIdLength = 12;
 static_assert(sizeof(kHypVendorId) - 1 == kHypVendorIdLength, "");
 
+KCOUNTER(exits_external_interrupt, "kernel.hypervisor.exits.external_interrupt");
+KCOUNTER(exits_interrupt_window, "kernel.hypervisor.exits.interrupt_window");
+KCOUNTER(exits_cpuid, "kernel.hypervisor.exits.cpuid");
+KCOUNTER(exits_hlt, "kernel.hypervisor.exits.hlt");
+KCOUNTER(exits_io, "kernel.hypervisor.exits.io");
+KCOUNTER(exits_rdmsr, "kernel.hypervisor.exits.rdmsr");
+KCOUNTER(exits_wrmsr, "kernel.hypervisor.exits.wrmsr");
+KCOUNTER(exits_wrmsr_x2apic, "kernel.hypervisor.exits.wrmsr.x2apic");
+KCOUNTER(exits_wrmsr_tsc_deadline, "kernel.hypervisor.exits.wrmsr.tsc_deadline");
+KCOUNTER(exits_ept_violation, "kernel.hypervisor.exits.ept_violation");
+KCOUNTER(exits_xsetbv, "kernel.hypervisor.exits.xsetbv");
+KCOUNTER(exits_other, "kernel.hypervisor.exits.other");
+
 extern "C" void x86_call_external_interrupt_handler(uint64_t vector);
 
 ExitInfo::ExitInfo(const AutoVmcs& vmcs) {
@@ -289,10 +302,25 @@ static zx_status_t handle_cpuid(const ExitInfo& exit_info, AutoVmcs* vmcs,
     }
 }
 
+// Returns whether the virtual APIC has an interrupt to deliver once the guest
+// enables interrupts, see Volume 3, Section 29.2.1.
+static bool virtual_interrupt_pending(const AutoVmcs& vmcs,
+                                      const LocalApicState* local_apic_state) {
+    uint8_t rvi = static_cast<uint8_t>(vmcs.Read(VmcsField16::GUEST_INTERRUPT_STATUS));
+    uint32_t vppr = local_apic_state->virtual_apic[kApicPprOffset / sizeof(uint32_t)];
+    return (rvi & 0xf0) > (vppr & 0xf0);
+}
+
 static zx_status_t handle_hlt(const ExitInfo& exit_info, AutoVmcs* vmcs,
                               LocalApicState* local_apic_state) {
     next_rip(exit_info, vmcs);
-    return local_apic_state->interrupt_tracker.Wait(vmcs);
+    PostedInterruptDescriptor* posted_interrupts = local_apic_state->posted_interrupts;
+    if (posted_interrupts == nullptr)
+        return local_apic_state->interrupt_tracker.Wait(vmcs);
+    if (posted_interrupts->Pending() || virtual_interrupt_pending(*vmcs, local_apic_state))
+        return ZX_OK;
+    return local_apic_state->interrupt_tracker.Wait(
+        vmcs, [posted_interrupts] { return posted_interrupts->Pending(); });
 }
 
 static zx_status_t handle_io_instruction(const ExitInfo& exit_info, AutoVmcs* vmcs,
@@ -451,6 +479,15 @@ static void deadline_callback(timer_t* timer, zx_time_t now, void* arg) {
         update_timer(local_apic_state, lvt_deadline(local_apic_state));
     }
     uint8_t vector = local_apic_state->lvt_timer & LVT_TIMER_VECTOR_MASK;
+    PostedInterruptDescriptor* posted_interrupts = local_apic_state->posted_interrupts;
+    if (posted_interrupts != nullptr && vector >= X86_INT_PLATFORM_BASE) {
+        // The timer fires on the CPU the VCPU is pinned to, so the VCPU is not
+        // running, and takes the interrupt when it is resumed. There is no
+        // need to inject it, or to wait for an interrupt window.
+        posted_interrupts->Post(vector);
+        local_apic_state->interrupt_tracker.Signal();
+        return;
+    }
     local_apic_state->interrupt_tracker.Interrupt(vector, nullptr);
 }
 
@@ -624,6 +661,7 @@ static zx_status_t handle_wrmsr(const ExitInfo& exit_info, AutoVmcs* vmcs, Guest
         next_rip(exit_info, vmcs);
         return ZX_OK;
     case X86_MSR_IA32_TSC_DEADLINE: {
+        kcounter_add(exits_wrmsr_tsc_deadline, 1u);
         if ((local_apic_state->lvt_timer & LVT_TIMER_MODE_MASK) != LVT_TIMER_MODE_TSC_DEADLINE)
             return ZX_ERR_INVALID_ARGS;
         next_rip(exit_info, vmcs);
@@ -632,6 +670,7 @@ static zx_status_t handle_wrmsr(const ExitInfo& exit_info, AutoVmcs* vmcs, Guest
         return ZX_OK;
     }
     case kX2ApicMsrBase... kX2ApicMsrMax:
+        kcounter_add(exits_wrmsr_x2apic, 1u);
         return handle_apic_wrmsr(exit_info, vmcs, guest_state, local_apic_state, packet);
     case kKvmSystemTimeMsrOld:
     case kKvmSystemTimeMsr:
@@ -733,6 +772,7 @@ static zx_status_t handle_trap(const ExitInfo& exit_info, AutoVmcs* vmcs, zx_vad
         packet->key = trap->key();
         packet->type = ZX_PKT_TYPE_GUEST_BELL;
         packet->guest_bell.addr = guest_paddr;
+        packet->guest_bell.count = trap->CountAccess();
         if (trap->HasPort())
             return trap->Queue(*packet, vmcs);
         // If there was no port for the range, then return to user-space.
@@ -765,6 +805,7 @@ static zx_status_t handle_ept_violation(const ExitInfo& exit_info, AutoVmcs* vmc
         break;
     case ZX_OK:
     default:
+        gpas->CountTrapFault();
         return status;
     }
 
@@ -773,12 +814,9 @@ static zx_status_t handle_ept_violation(const ExitInfo& exit_info, AutoVmcs* vmc
     if (guest_paddr >= gpas->size())
         return ZX_ERR_OUT_OF_RANGE;
 
-    EptViolationInfo ept_violation_info(exit_info.exit_qualification);
-    // By default, we mark EPT PTEs as RWX. This is so we can avoid faulting
-    // again if the guest requests additional permissions, and so that we can
-    // avoid use of INVEPT.
-    uint pf_flags = VMM_PF_FLAG_HW_FAULT | VMM_PF_FLAG_WRITE | VMM_PF_FLAG_INSTRUCTION;
-    status = vmm_guest_page_fault_handler(guest_paddr, pf_flags, gpas->aspace());
+    // The EPT PTEs are marked RWX, so that we can avoid use of INVEPT when
+    // the guest requests additional permissions.
+    status = gpas->PageFault(guest_paddr);
     if (status != ZX_OK) {
         dprintf(CRITICAL, "Unhandled EPT violation %#lx\n",
                 exit_info.guest_physical_address);
@@ -823,38 +861,49 @@ zx_status_t vmexit_handler(AutoVmcs* vmcs, GuestState* guest_state,
 
     switch (exit_info.exit_reason) {
     case ExitReason::EXTERNAL_INTERRUPT:
+        kcounter_add(exits_external_interrupt, 1u);
         return handle_external_interrupt(vmcs, local_apic_state);
     case ExitReason::INTERRUPT_WINDOW:
+        kcounter_add(exits_interrupt_window, 1u);
         LTRACEF("handling interrupt window\n\n");
         return handle_interrupt_window(vmcs, local_apic_state);
     case ExitReason::CPUID:
+        kcounter_add(exits_cpuid, 1u);
         LTRACEF("handling CPUID instruction\n\n");
         return handle_cpuid(exit_info, vmcs, guest_state);
     case ExitReason::HLT:
+        kcounter_add(exits_hlt, 1u);
         LTRACEF("handling HLT instruction\n\n");
         return handle_hlt(exit_info, vmcs, local_apic_state);
     case ExitReason::IO_INSTRUCTION:
+        kcounter_add(exits_io, 1u);
         return handle_io_instruction(exit_info, vmcs, guest_state, traps, packet);
     case ExitReason::RDMSR:
+        kcounter_add(exits_rdmsr, 1u);
         LTRACEF("handling RDMSR instruction %#" PRIx64 "\n\n", guest_state->rcx);
         return handle_rdmsr(exit_info, vmcs, guest_state, local_apic_state);
     case ExitReason::WRMSR:
+        kcounter_add(exits_wrmsr, 1u);
         LTRACEF("handling WRMSR instruction %#" PRIx64 "\n\n", guest_state->rcx);
         return handle_wrmsr(exit_info, vmcs, guest_state, local_apic_state, pvclock, gpas, packet);
     case ExitReason::ENTRY_FAILURE_GUEST_STATE:
     case ExitReason::ENTRY_FAILURE_MSR_LOADING:
+        kcounter_add(exits_other, 1u);
         LTRACEF("handling VM entry failure\n\n");
         return ZX_ERR_BAD_STATE;
     case ExitReason::EPT_VIOLATION:
+        kcounter_add(exits_ept_violation, 1u);
         LTRACEF("handling EPT violation\n\n");
         return handle_ept_violation(exit_info, vmcs, gpas, traps, packet);
     case ExitReason::XSETBV:
+        kcounter_add(exits_xsetbv, 1u);
         LTRACEF("handling XSETBV instruction\n\n");
         return handle_xsetbv(exit_info, vmcs, guest_state);
     case ExitReason::EXCEPTION:
         // Currently all exceptions except NMI delivered to guest directly. NMI causes vmexit
         // and handled by host via IDT as any other interrupt/exception.
     default:
+        kcounter_add(exits_other, 1u);
         dprintf(CRITICAL, "Unhandled VM exit %u (%s)\n", static_cast<uint32_t>(exit_info.exit_reason),
                 exit_reason_name(exit_info.exit_reason));
         return ZX_ERR_NOT_SUPPORTED;
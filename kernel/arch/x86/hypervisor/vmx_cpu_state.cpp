@@ -44,6 +44,20 @@ static zx_status_t vmxoff() {
     return err ? ZX_ERR_INTERNAL : ZX_OK;
 }
 
+zx_status_t invept(InvEpt invalidation, uint64_t eptp) {
+    uint8_t err;
+    // From Volume 3, Section 30.3: The INVEPT descriptor.
+    uint64_t descriptor[] = {eptp, 0};
+
+    __asm__ volatile(
+        "invept %[descriptor], %[invalidation];" VMX_ERR_CHECK(err)
+        : [err] "=r"(err)
+        : [descriptor] "m"(descriptor), [invalidation] "r"(static_cast<uint64_t>(invalidation))
+        : "cc", "memory");
+
+    return err ? ZX_ERR_INTERNAL : ZX_OK;
+}
+
 VmxInfo::VmxInfo() {
     // From Volume 3, Appendix A.1.
     uint64_t basic_info = read_msr(X86_MSR_IA32_VMX_BASIC);
@@ -66,6 +80,7 @@ EptInfo::EptInfo() {
         BIT_SHIFT(ept_info, 25) &&
         // All-context INVEPT type is supported.
         BIT_SHIFT(ept_info, 26);
+    accessed_dirty = BIT_SHIFT(ept_info, 21);
 }
 
 zx_status_t VmxPage::Alloc(const VmxInfo& vmx_info, uint8_t fill) {
@@ -46,6 +46,7 @@ struct EptInfo {
     bool page_walk_4;
     bool write_back;
     bool invept;
+    bool accessed_dirty;
 
     EptInfo();
 };
@@ -55,6 +56,14 @@ struct VmxRegion {
     uint32_t revision_id;
 };
 
+enum class InvEpt : uint64_t {
+    SINGLE_CONTEXT = 1,
+    ALL_CONTEXT = 2,
+};
+
+// Invalidates the EPT translations cached by the current CPU.
+zx_status_t invept(InvEpt invalidation, uint64_t eptp);
+
 zx_status_t alloc_vmx_state();
 zx_status_t free_vmx_state();
 bool cr_is_invalid(uint64_t cr_value, uint32_t fixed0_msr, uint32_t fixed1_msr);
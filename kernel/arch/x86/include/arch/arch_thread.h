@@ -45,6 +45,10 @@ struct arch_thread {
 
     /* if non-NULL, address to return to on page fault */
     void *page_fault_resume;
+
+    /* as above, but the fault is not handled at all: set while copying from
+     * user memory in an interrupt handler, where faults cannot be serviced */
+    void *page_fault_nofault_resume;
 };
 
 static inline void x86_set_suspended_general_regs(struct arch_thread *thread,
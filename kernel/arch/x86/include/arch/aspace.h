@@ -40,6 +40,7 @@ private:
     bool supports_page_size(PageTableLevel level) final;
     IntermediatePtFlags intermediate_flags() final;
     PtFlags terminal_flags(PageTableLevel level, uint flags) final;
+    PtFlags dirty_flag() final;
     PtFlags split_flags(PageTableLevel level, PtFlags flags) final;
     void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
@@ -62,6 +63,7 @@ private:
     bool supports_page_size(PageTableLevel level) final;
     IntermediatePtFlags intermediate_flags() final;
     PtFlags terminal_flags(PageTableLevel level, uint flags) final;
+    PtFlags dirty_flag() final;
     PtFlags split_flags(PageTableLevel level, PtFlags flags) final;
     void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
@@ -86,6 +88,12 @@ public:
     zx_status_t Protect(vaddr_t vaddr, size_t count, uint mmu_flags) override;
     zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) override;
 
+    // See X86PageTableBase::HarvestDirtyPages.
+    zx_status_t HarvestDirty(vaddr_t vaddr, size_t count, uint64_t* bitmap);
+
+    void DeferInvalidations() override;
+    void FlushPendingInvalidations() override;
+
     vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                      vaddr_t end, uint next_region_mmu_flags,
                      vaddr_t align, size_t size, uint mmu_flags) override;
@@ -96,11 +104,18 @@ public:
 
     int active_cpus() { return active_cpus_.load(); }
 
+    // Called for every invalidation of this aspace's TLB entries, before the
+    // set of active CPUs is sampled to send IPIs to.  CPUs outside that set
+    // compare the generation when they next switch to this aspace.
+    void BumpTlbGeneration() { tlb_generation_.fetch_add(1); }
+
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
     static void ContextSwitch(X86ArchVmAspace* from, X86ArchVmAspace* to);
 
 private:
+    static ulong AssignPcid(X86ArchVmAspace* aspace);
+
     // Test the vaddr against the address space's range.
     bool IsValidVaddr(vaddr_t vaddr) {
         return (vaddr >= base_ && vaddr <= base_ + size_ - 1);
@@ -129,6 +144,12 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    // Unique id of this aspace, used to recognize its PCID on each CPU.
+    uint64_t id_ = 0;
+
+    // Count of TLB invalidations issued against this aspace.
+    fbl::atomic<uint64_t> tlb_generation_{0};
 };
 
 using ArchVmAspace = X86ArchVmAspace;
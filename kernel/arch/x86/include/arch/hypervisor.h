@@ -23,6 +23,7 @@
 #include <zircon/types.h>
 
 class VmObject;
+struct PostedInterruptDescriptor;
 struct VmxInfo;
 
 class VmxPage : public hypervisor::Page {
@@ -46,6 +47,10 @@ public:
     hypervisor::GuestPhysicalAddressSpace* AddressSpace() const { return gpas_.get(); }
     hypervisor::TrapMap* Traps() { return &traps_; }
     zx_paddr_t MsrBitmapsAddress() const { return msr_bitmaps_page_.PhysicalAddress(); }
+    bool ApicVirtualization() const { return apic_virtualization_; }
+    bool DirtyTracking() const { return dirty_tracking_; }
+
+    zx_status_t GetDirtyPages(zx_vaddr_t addr, size_t len, uint64_t* bitmap);
 
     zx_status_t AllocVpid(uint16_t* vpid);
     zx_status_t FreeVpid(uint16_t vpid);
@@ -54,6 +59,8 @@ private:
     fbl::unique_ptr<hypervisor::GuestPhysicalAddressSpace> gpas_;
     hypervisor::TrapMap traps_;
     VmxPage msr_bitmaps_page_;
+    bool apic_virtualization_ = false;
+    bool dirty_tracking_ = false;
 
     fbl::Mutex vcpu_mutex_;
     // TODO(alexlegg): Find a good place for this constant to live (max vcpus).
@@ -66,8 +73,13 @@ private:
 struct LocalApicState {
     // Timer for APIC timer.
     timer_t timer;
-    // Tracks pending interrupts.
+    // Tracks pending interrupts. With APIC virtualization, this only tracks
+    // exceptions, and external interrupts are posted instead.
     hypervisor::InterruptTracker<X86_INT_COUNT> interrupt_tracker;
+    // With APIC virtualization, where external interrupts are posted.
+    PostedInterruptDescriptor* posted_interrupts = nullptr;
+    // The virtual-APIC page.
+    uint32_t* virtual_apic = nullptr;
     // LVT timer configuration
     uint32_t lvt_timer = LVT_MASKED; // Initial state is masked (Vol 3 Section 10.12.5.1).
     uint32_t lvt_initial_count;
@@ -106,6 +118,8 @@ private:
     VmxPage host_msr_page_;
     VmxPage guest_msr_page_;
     VmxPage vmcs_page_;
+    VmxPage virtual_apic_page_;
+    VmxPage posted_interrupt_page_;
 
     Vcpu(Guest* guest, uint16_t vpid, const thread_t* thread);
 };
@@ -10,15 +10,21 @@
 #include <arch/x86.h>
 #include <kernel/atomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <zircon/compiler.h>
 #include <zircon/thread_annotations.h>
 
 __BEGIN_CDECLS
 
-#define SPIN_LOCK_INITIAL_VALUE (spin_lock_t){0}
+#define SPIN_LOCK_INITIAL_VALUE (spin_lock_t){0, 0}
 
+/* a ticket lock: the high half of |tickets| is the next ticket to hand out and
+ * the low half the ticket being served, so cpus take the lock in the order they
+ * asked for it. */
 typedef struct TA_CAP("mutex") spin_lock {
-    unsigned long value;
+    uint32_t tickets;
+    /* cpu number + 1 of the holder, 0 if not held */
+    uint32_t holder;
 } spin_lock_t;
 
 typedef x86_flags_t spin_lock_saved_state_t;
@@ -33,14 +39,21 @@ static inline void arch_spin_lock_init(spin_lock_t *lock)
     *lock = SPIN_LOCK_INITIAL_VALUE;
 }
 
+/* the number of cpus holding or waiting for the lock */
+static inline uint arch_spin_lock_queue_len(spin_lock_t *lock)
+{
+    uint32_t tickets = __atomic_load_n(&lock->tickets, __ATOMIC_RELAXED);
+    return (uint16_t)((tickets >> 16) - tickets);
+}
+
 static inline bool arch_spin_lock_held(spin_lock_t *lock)
 {
-    return __atomic_load_n(&lock->value, __ATOMIC_RELAXED) != 0;
+    return arch_spin_lock_queue_len(lock) != 0;
 }
 
 static inline uint arch_spin_lock_holder_cpu(spin_lock_t *lock)
 {
-    return (uint)__atomic_load_n(&lock->value, __ATOMIC_RELAXED) - 1;
+    return __atomic_load_n(&lock->holder, __ATOMIC_RELAXED) - 1;
 }
 
 /* flags are unused on x86 */
@@ -96,6 +96,7 @@ void x86_init_percpu(uint cpu_num);
 void x86_set_local_apic_id(uint32_t apic_id);
 
 int x86_apic_id_to_cpu_num(uint32_t apic_id);
+uint32_t x86_cpu_num_to_apic_id(cpu_num_t cpu_num);
 
 // Allocate all of the necessary structures for all of the APs to run.
 zx_status_t x86_allocate_ap_structures(uint32_t *apic_ids, uint8_t cpu_count);
@@ -129,6 +130,8 @@ static void arch_set_in_int_handler(bool in_irq)
 void x86_ipi_generic_handler(void);
 void x86_ipi_reschedule_handler(void);
 void x86_ipi_halt_handler(void) __NO_RETURN;
+// Sends an IPI with an arbitrary |vector| to |cpu|, if it is up.
+void x86_send_ipi_vector(cpu_num_t cpu, uint8_t vector);
 void x86_secondary_entry(volatile int *aps_still_booting, thread_t *thread);
 
 __END_CDECLS
@@ -21,4 +21,20 @@ zx_status_t _x86_copy_to_or_from_user(
         size_t len,
         void **fault_return);
 
+/* As above, but bypasses the cache for the writes to dst.  Used by
+ * arch_copy_from_user_nontemporal(). */
+
+zx_status_t _x86_copy_to_or_from_user_nontemporal(
+        void *dst,
+        const void *src,
+        size_t len,
+        void **fault_return);
+
+/* Copies from user memory without servicing page faults: any fault, even
+ * on a page which is merely not present yet, fails the copy with
+ * ZX_ERR_INVALID_ARGS.  Safe to call from an interrupt handler, such as
+ * the PMI handler when it walks a user stack. */
+
+zx_status_t x86_copy_from_user_nofault(void *dst, const void *src, size_t len);
+
 __END_CDECLS
@@ -374,6 +374,19 @@ uint8_t apic_io_fetch_irq_vector(uint32_t global_irq) {
     return vector;
 }
 
+void apic_io_configure_irq_dst(
+    uint32_t global_irq,
+    uint8_t dst) {
+    struct io_apic* io_apic = apic_io_resolve_global_irq(global_irq);
+
+    AutoSpinLock guard(&lock);
+
+    uint64_t reg = apic_io_read_redirection_entry(io_apic, global_irq);
+    reg &= ~IO_APIC_RTE_DST(0xff);
+    reg |= IO_APIC_RTE_DST(dst);
+    apic_io_write_redirection_entry(io_apic, global_irq, reg);
+}
+
 void apic_io_mask_isa_irq(uint8_t isa_irq, bool mask) {
     ASSERT(isa_irq < NUM_ISA_IRQS);
     uint32_t global_irq = isa_irq;
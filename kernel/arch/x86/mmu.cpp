@@ -17,6 +17,8 @@
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
 #include <kernel/mp.h>
+#include <lib/counters.h>
+#include <lib/ktrace.h>
 #include <vm/arch_vm_aspace.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
@@ -25,6 +27,14 @@
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(tlb_shootdowns, "kernel.mmu.tlb.shootdowns");
+KCOUNTER(tlb_ipis_sent, "kernel.mmu.tlb.ipis_sent");
+KCOUNTER(tlb_shootdowns_local, "kernel.mmu.tlb.shootdowns_local");
+KCOUNTER(tlb_shootdowns_batched, "kernel.mmu.tlb.shootdowns_batched");
+KCOUNTER(pcid_switch_noflush, "kernel.mmu.pcid.switch_noflush");
+KCOUNTER(pcid_switch_flush, "kernel.mmu.pcid.switch_flush");
+KCOUNTER(pcid_evictions, "kernel.mmu.pcid.evictions");
+
 /* Default address width including virtual/physical address.
  * newer versions fetched below */
 uint8_t g_vaddr_width = 48;
@@ -33,6 +43,29 @@ uint8_t g_paddr_width = 32;
 /* True if the system supports 1GB pages */
 static bool supports_huge_pages = false;
 
+/* True if CR4.PCIDE is set and aspace switches keep each other's TLB entries */
+static bool use_pcid = false;
+
+/* PCIDs are handed out per CPU from a small set of slots, so that each CPU
+ * keeps the TLB entries of the last few user aspaces it ran.  Slot i is PCID
+ * i + 1; PCID 0 is used with the kernel page tables.  An aspace that has had
+ * invalidations skipped on this CPU since it last ran here (see
+ * x86_tlb_invalidate_page) has its PCID flushed when it is switched back to. */
+static constexpr uint kNumPcidSlots = 6;
+struct PcidSlot {
+    uint64_t aspace_id;
+    uint64_t tlb_generation;
+};
+struct PcidCpuState {
+    PcidSlot slot[kNumPcidSlots];
+    uint next_victim;
+} __CPU_ALIGN;
+static PcidCpuState pcid_state[SMP_MAX_CPUS];
+
+/* Source of X86ArchVmAspace ids, which are never reused so a stale PcidSlot
+ * can never match a new aspace. */
+static fbl::atomic<uint64_t> next_aspace_id(1);
+
 /* top level kernel page tables, initialized in start.S */
 volatile pt_entry_t pml4[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE);
 volatile pt_entry_t pdp[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE); /* temporary */
@@ -135,7 +168,7 @@ static void TlbInvalidatePage_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
     TlbInvalidatePage_context* context = (TlbInvalidatePage_context*)raw_context;
 
-    ulong cr3 = x86_get_cr3();
+    ulong cr3 = x86_get_cr3() & X86_CR3_BASE_MASK;
     if (context->target_cr3 != cr3 && !context->pending->contains_global) {
         /* This invalidation doesn't apply to this CPU, ignore it */
         return;
@@ -175,7 +208,7 @@ static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvali
         return;
     }
 
-    ulong cr3 = pt ? pt->phys() : x86_get_cr3();
+    ulong cr3 = pt ? pt->phys() : x86_get_cr3() & X86_CR3_BASE_MASK;
     struct TlbInvalidatePage_context task_context = {
         .target_cr3 = cr3, .pending = pending,
     };
@@ -184,16 +217,51 @@ static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvali
      * other CPU will become active in it after this load, or will have left it
      * just before this load.  In the former case, it is becoming active after
      * the write to the page table, so it will see the change.  In the latter
-     * case, it will get a spurious request to flush. */
+     * case, it will get a spurious request to flush.
+     *
+     * With PCIDs, CPUs that have left the aspace may still hold its entries.
+     * Bumping the generation before sampling the active set guarantees that a
+     * CPU either gets the IPI or sees the new generation when it switches
+     * back, and flushes the aspace's PCID then. */
     mp_ipi_target_t target;
     cpu_mask_t target_mask = 0;
     if (pending->contains_global || pt == nullptr) {
         target = MP_IPI_TARGET_ALL;
     } else {
+        X86ArchVmAspace* aspace = static_cast<X86ArchVmAspace*>(pt->ctx());
+        aspace->BumpTlbGeneration();
         target = MP_IPI_TARGET_MASK;
-        target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->active_cpus();
+        target_mask = aspace->active_cpus();
     }
 
+    if (target == MP_IPI_TARGET_MASK) {
+        // If no other CPU is running in the aspace there is nobody to
+        // interrupt, so skip the cross-CPU machinery entirely.  CPUs that
+        // switch to the aspace later pick the change up when they load CR3.
+        spin_lock_saved_state_t state;
+        arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+        const cpu_mask_t local_mask = cpu_num_to_mask(arch_curr_cpu_num());
+        if ((target_mask & ~local_mask) == 0) {
+            if (target_mask & local_mask) {
+                TlbInvalidatePage_task(&task_context);
+            }
+            arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+            ktrace_probe2("tlb shootdown local", pending->count, pending->full_shootdown);
+            kcounter_add(tlb_shootdowns_local, 1);
+            pending->clear();
+            return;
+        }
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    }
+
+    const cpu_mask_t remote_mask = (target == MP_IPI_TARGET_ALL ? mp_get_online_mask() : target_mask) &
+                                   ~cpu_num_to_mask(arch_curr_cpu_num());
+    const uint32_t ipis = __builtin_popcount(remote_mask);
+    ktrace_probe2("tlb shootdown", pending->count, ipis);
+    kcounter_add(tlb_shootdowns, 1);
+    kcounter_add(tlb_ipis_sent, ipis);
+
     mp_sync_exec(target, target_mask, TlbInvalidatePage_task, &task_context);
     pending->clear();
 }
@@ -276,6 +344,10 @@ X86PageTableBase::PtFlags X86PageTableMmu::terminal_flags(PageTableLevel level,
     return terminal_flags;
 }
 
+X86PageTableBase::PtFlags X86PageTableMmu::dirty_flag() {
+    return X86_MMU_PG_D;
+}
+
 X86PageTableBase::PtFlags X86PageTableMmu::split_flags(PageTableLevel level,
                                                        X86PageTableBase::PtFlags flags) {
     DEBUG_ASSERT(level != PML4_L && level != PT_L);
@@ -397,6 +469,12 @@ X86PageTableBase::PtFlags X86PageTableEpt::terminal_flags(PageTableLevel level,
     return terminal_flags;
 }
 
+X86PageTableBase::PtFlags X86PageTableEpt::dirty_flag() {
+    // Only set by the processor if accessed and dirty flags are enabled in the
+    // EPT pointer.
+    return X86_EPT_D;
+}
+
 X86PageTableBase::PtFlags X86PageTableEpt::split_flags(PageTableLevel level,
                                                        X86PageTableBase::PtFlags flags) {
     DEBUG_ASSERT(level != PML4_L && level != PT_L);
@@ -442,6 +520,7 @@ void x86_mmu_early_init() {
     uint8_t paddr_width = x86_physical_address_width();
 
     supports_huge_pages = x86_feature_test(X86_FEATURE_HUGE_PAGE);
+    use_pcid = x86_feature_test(X86_FEATURE_PCID);
 
     /* if we got something meaningful, override the defaults.
      * some combinations of cpu on certain emulators seems to return
@@ -519,6 +598,7 @@ zx_status_t X86ArchVmAspace::Init(vaddr_t base, size_t size, uint mmu_flags) {
     flags_ = mmu_flags;
     base_ = base;
     size_ = size;
+    id_ = next_aspace_id.fetch_add(1);
     if (mmu_flags & ARCH_ASPACE_FLAG_KERNEL) {
         X86PageTableMmu* mmu = new (page_table_storage_) X86PageTableMmu();
         pt_ = mmu;
@@ -600,21 +680,81 @@ zx_status_t X86ArchVmAspace::Protect(vaddr_t vaddr, size_t count, uint mmu_flags
     return pt_->ProtectPages(vaddr, count, mmu_flags);
 }
 
+void X86ArchVmAspace::DeferInvalidations() {
+    canary_.Assert();
+
+    pt_->DeferInvalidations();
+}
+
+void X86ArchVmAspace::FlushPendingInvalidations() {
+    canary_.Assert();
+
+    // All but one of the shootdowns that were held back have been avoided.
+    size_t batched = pt_->FlushDeferredInvalidations();
+    if (batched > 1) {
+        ktrace_probe2("tlb shootdowns batched", static_cast<uint32_t>(batched), 0);
+        kcounter_add(tlb_shootdowns_batched, batched - 1);
+    }
+}
+
+// Pick the PCID |aspace| runs with on this CPU and return the PCID bits for
+// CR3, including X86_CR3_NOFLUSH if the entries cached under it are still
+// valid.  Must be called after this CPU has been added to the aspace's active
+// set.
+ulong X86ArchVmAspace::AssignPcid(X86ArchVmAspace* aspace) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    PcidCpuState* state = &pcid_state[arch_curr_cpu_num()];
+    const uint64_t generation = aspace->tlb_generation_.load();
+
+    for (uint i = 0; i < kNumPcidSlots; ++i) {
+        PcidSlot* slot = &state->slot[i];
+        if (slot->aspace_id != aspace->id_) {
+            continue;
+        }
+        if (slot->tlb_generation == generation) {
+            kcounter_add(pcid_switch_noflush, 1);
+            return (i + 1) | X86_CR3_NOFLUSH;
+        }
+        // Some invalidation skipped this CPU while the aspace wasn't running
+        // here.
+        slot->tlb_generation = generation;
+        kcounter_add(pcid_switch_flush, 1);
+        return i + 1;
+    }
+
+    // Take over the next slot round-robin; loading CR3 without NOFLUSH drops
+    // whatever the previous owner left behind.
+    const uint i = state->next_victim;
+    state->next_victim = (i + 1) % kNumPcidSlots;
+    if (state->slot[i].aspace_id != 0) {
+        kcounter_add(pcid_evictions, 1);
+    }
+    state->slot[i].aspace_id = aspace->id_;
+    state->slot[i].tlb_generation = generation;
+    kcounter_add(pcid_switch_flush, 1);
+    return i + 1;
+}
+
 void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace* aspace) {
     cpu_mask_t cpu_bit = cpu_num_to_mask(arch_curr_cpu_num());
     if (aspace != nullptr) {
         aspace->canary_.Assert();
         paddr_t phys = aspace->pt_phys();
         LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
-        x86_set_cr3(phys);
 
         if (old_aspace != nullptr) {
             old_aspace->active_cpus_.fetch_and(~cpu_bit);
         }
+        // Join the active set before sampling the TLB generation, see
+        // x86_tlb_invalidate_page.
         aspace->active_cpus_.fetch_or(cpu_bit);
+        x86_set_cr3(use_pcid ? phys | AssignPcid(aspace) : phys);
     } else {
         LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
-        x86_set_cr3(kernel_pt_phys);
+        // The kernel mappings are global, so there is nothing under PCID 0
+        // that needs flushing.
+        x86_set_cr3(use_pcid ? kernel_pt_phys | X86_CR3_NOFLUSH : kernel_pt_phys);
         if (old_aspace != nullptr) {
             old_aspace->active_cpus_.fetch_and(~cpu_bit);
         }
@@ -636,6 +776,13 @@ zx_status_t X86ArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flag
     return pt_->QueryVaddr(vaddr, paddr, mmu_flags);
 }
 
+zx_status_t X86ArchVmAspace::HarvestDirty(vaddr_t vaddr, size_t count, uint64_t* bitmap) {
+    if (!IsValidVaddr(vaddr))
+        return ZX_ERR_INVALID_ARGS;
+
+    return pt_->HarvestDirtyPages(vaddr, count, bitmap);
+}
+
 void x86_mmu_percpu_init(void) {
     ulong cr0 = x86_get_cr0();
     /* Set write protect bit in CR0*/
@@ -650,6 +797,10 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    // Setting PCIDE faults if CR3 holds a non-zero PCID, which can't be the
+    // case yet since PCIDs are only assigned once this is set.
+    if (x86_feature_test(X86_FEATURE_PCID))
+        cr4 |= X86_CR4_PCIDE;
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
@@ -204,6 +204,31 @@ int x86_apic_id_to_cpu_num(uint32_t apic_id) {
     return -1;
 }
 
+uint32_t x86_cpu_num_to_apic_id(cpu_num_t cpu_num) {
+    return (cpu_num == 0) ? bp_percpu.apic_id : ap_percpus[cpu_num - 1].apic_id;
+}
+
+uint arch_mp_cpu_distance(cpu_num_t a, cpu_num_t b) {
+    if (a == b) {
+        return MP_CPU_DISTANCE_SAME;
+    }
+    if (a >= x86_num_cpus || b >= x86_num_cpus) {
+        return MP_CPU_DISTANCE_REMOTE;
+    }
+
+    x86_cpu_topology_t topo_a, topo_b;
+    x86_cpu_topology_decode(x86_cpu_num_to_apic_id(a), &topo_a);
+    x86_cpu_topology_decode(x86_cpu_num_to_apic_id(b), &topo_b);
+
+    if (topo_a.package_id != topo_b.package_id) {
+        return MP_CPU_DISTANCE_REMOTE;
+    }
+    if (topo_a.core_id == topo_b.core_id) {
+        return MP_CPU_DISTANCE_SMT;
+    }
+    return MP_CPU_DISTANCE_CLUSTER;
+}
+
 zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t ipi) {
     uint8_t vector = 0;
     switch (ipi) {
@@ -257,6 +282,14 @@ zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t i
     return ZX_OK;
 }
 
+void x86_send_ipi_vector(cpu_num_t cpu, uint8_t vector) {
+    DEBUG_ASSERT(cpu < x86_num_cpus);
+    struct x86_percpu* percpu = cpu == 0 ? &bp_percpu : &ap_percpus[cpu - 1];
+    if (percpu->apic_id != INVALID_APIC_ID) {
+        apic_send_ipi(vector, (uint8_t)percpu->apic_id, DELIVERY_MODE_FIXED);
+    }
+}
+
 void x86_ipi_generic_handler(void) {
     LTRACEF("cpu %u\n", arch_curr_cpu_num());
     mp_mbx_generic_irq();
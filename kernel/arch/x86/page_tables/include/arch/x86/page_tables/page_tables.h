@@ -9,6 +9,7 @@
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
 #include <hwreg/bitfields.h>
+#include <list.h>
 
 typedef uint64_t pt_entry_t;
 #define PRIxPTE PRIx64
@@ -50,6 +51,10 @@ struct PendingTlbInvalidation {
     // bit set.
     void enqueue(vaddr_t v, PageTableLevel level, bool is_global_page, bool is_terminal);
 
+    // Fold the invalidations queued in |other| into this one, escalating to a
+    // full shootdown if they do not fit.
+    void merge(const PendingTlbInvalidation& other);
+
     // Clear the list of pending invalidations
     void clear();
 
@@ -87,6 +92,25 @@ public:
 
     zx_status_t QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags);
 
+    // Clear the dirty bits of the pages mapped in [vaddr, vaddr + count *
+    // PAGE_SIZE), setting bit i of |bitmap| if page i was dirty.  A dirty
+    // large page sets the bits of all of the pages it maps.  The bits of clean
+    // pages are left as they were.  The TLBs may still hold translations with
+    // the dirty bit set, through which writes will not set it again, so the
+    // caller must invalidate them.
+    zx_status_t HarvestDirtyPages(vaddr_t vaddr, size_t count, uint64_t* bitmap);
+
+    // Hold back the TLB invalidations generated by the calling thread's
+    // changes to these page tables, along with the release of any page tables
+    // they unlinked, until FlushDeferredInvalidations() is called.  Changes
+    // made by other threads in the meantime are invalidated as usual.  The
+    // caller must not free anything that was unmapped while deferring until
+    // after the flush.
+    void DeferInvalidations();
+    // Issue the held back invalidations as a single shootdown.  Returns the
+    // number of shootdowns that were folded into it.
+    size_t FlushDeferredInvalidations();
+
 protected:
     // Initialize an empty page table, assigning this given context to it.
     zx_status_t Init(void* ctx);
@@ -109,6 +133,9 @@ protected:
     virtual IntermediatePtFlags intermediate_flags() = 0;
     // Return the hardware flags to use on terminal page table entries
     virtual PtFlags terminal_flags(PageTableLevel level, uint flags) = 0;
+    // Return the hardware flag the processor sets on terminal entries when
+    // the page they map is written to.
+    virtual PtFlags dirty_flag() = 0;
     // Return the hardware flags to use on smaller pages after a splitting a
     // large page with flags |flags|.
     virtual PtFlags split_flags(PageTableLevel level, PtFlags flags) = 0;
@@ -168,6 +195,9 @@ private:
                              enum PageTableLevel* ret_level,
                              volatile pt_entry_t** mapping) TA_REQ(lock_);
 
+    void HarvestDirty(volatile pt_entry_t* table, PageTableLevel level, vaddr_t vaddr,
+                      vaddr_t end, vaddr_t base, uint64_t* bitmap) TA_REQ(lock_);
+
     zx_status_t SplitLargePage(PageTableLevel level, vaddr_t vaddr,
                                volatile pt_entry_t* pte, ConsistencyManager* cm) TA_REQ(lock_);
 
@@ -181,4 +211,12 @@ private:
 
     // low lock to protect the mmu code
     fbl::Mutex lock_;
+
+    // The thread whose invalidations are currently being deferred, if any.
+    const struct thread* defer_thread_ TA_GUARDED(lock_) = nullptr;
+    // Invalidations and page table pages held back for |defer_thread_|, and
+    // the number of shootdowns that were folded into them.
+    PendingTlbInvalidation deferred_tlb_ TA_GUARDED(lock_);
+    list_node deferred_free_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(deferred_free_);
+    size_t deferred_count_ TA_GUARDED(lock_) = 0;
 };
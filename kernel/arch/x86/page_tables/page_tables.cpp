@@ -12,6 +12,8 @@
 #include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
+#include <kernel/thread.h>
+#include <string.h>
 #include <trace.h>
 #include <vm/physmap.h>
 #include <vm/pmm.h>
@@ -105,6 +107,23 @@ void PendingTlbInvalidation::enqueue(vaddr_t v, PageTableLevel level, bool is_gl
     count++;
 }
 
+void PendingTlbInvalidation::merge(const PendingTlbInvalidation& other) {
+    if (other.contains_global) {
+        contains_global = true;
+    }
+
+    if (full_shootdown || other.full_shootdown ||
+        count + other.count > fbl::count_of(item)) {
+        // The items are ignored once this is a full shootdown, but keep the
+        // count non-zero so the invalidation is still issued.
+        full_shootdown = true;
+        count = fbl::min(count + other.count, static_cast<uint>(fbl::count_of(item)));
+        return;
+    }
+    memcpy(&item[count], other.item, other.count * sizeof(item[0]));
+    count += other.count;
+}
+
 void PendingTlbInvalidation::clear() {
     count = 0;
     full_shootdown = false;
@@ -227,7 +246,21 @@ void X86PageTableBase::ConsistencyManager::Finish() {
         // invalidations.
         mb();
     }
-    pt_->TlbInvalidate(&tlb_);
+    if (pt_->defer_thread_ == get_current_thread()) {
+        // Hand the invalidations and the page tables they protect over to the
+        // deferred batch; they are dealt with in FlushDeferredInvalidations().
+        if (tlb_.count > 0 || tlb_.full_shootdown) {
+            pt_->deferred_tlb_.merge(tlb_);
+            pt_->deferred_count_++;
+            tlb_.clear();
+        }
+        list_node_t* node;
+        while ((node = list_remove_head(&to_free_)) != nullptr) {
+            list_add_tail(&pt_->deferred_free_, node);
+        }
+    } else {
+        pt_->TlbInvalidate(&tlb_);
+    }
     pt_ = nullptr;
 }
 
@@ -1016,6 +1049,83 @@ zx_status_t X86PageTableBase::QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mm
     return ZX_OK;
 }
 
+// Walks the entries of |table| which map [vaddr, end), clearing the dirty
+// bits of terminal entries and recording them in |bitmap|, whose first bit is
+// for |base|.
+void X86PageTableBase::HarvestDirty(volatile pt_entry_t* table, PageTableLevel level,
+                                    vaddr_t vaddr, vaddr_t end, vaddr_t base,
+                                    uint64_t* bitmap) {
+    const size_t ps = page_size(level);
+    const PtFlags dirty = dirty_flag();
+    uint index = vaddr_to_index(level, vaddr);
+    for (; index != NO_OF_PT_ENTRIES && vaddr < end; ++index) {
+        vaddr_t next = fbl::min((vaddr & ~(ps - 1)) + ps, end);
+        volatile pt_entry_t* e = table + index;
+        pt_entry_t pt_val = *e;
+        if (!IS_PAGE_PRESENT(pt_val)) {
+            vaddr = next;
+            continue;
+        }
+        if (level != PT_L && !IS_LARGE_PAGE(pt_val)) {
+            HarvestDirty(get_next_table_from_entry(pt_val), lower_level(level), vaddr, next,
+                         base, bitmap);
+            vaddr = next;
+            continue;
+        }
+        // The processor may be setting the accessed bit concurrently.
+        if ((pt_val & dirty) &&
+            (__atomic_fetch_and(const_cast<pt_entry_t*>(e), ~dirty, __ATOMIC_RELAXED) & dirty)) {
+            for (; vaddr < next; vaddr += PAGE_SIZE) {
+                size_t page = (vaddr - base) / PAGE_SIZE;
+                bitmap[page / 64] |= 1ul << (page % 64);
+            }
+        }
+        vaddr = next;
+    }
+}
+
+zx_status_t X86PageTableBase::HarvestDirtyPages(vaddr_t vaddr, size_t count, uint64_t* bitmap) {
+    canary_.Assert();
+
+    LTRACEF("aspace %p, vaddr %#" PRIxPTR " count %#zx\n", this, vaddr, count);
+
+    if (!check_vaddr(vaddr))
+        return ZX_ERR_INVALID_ARGS;
+    if (count == 0)
+        return ZX_OK;
+
+    fbl::AutoLock a(&lock_);
+    HarvestDirty(virt_, top_level(), vaddr, vaddr + count * PAGE_SIZE, vaddr, bitmap);
+    return ZX_OK;
+}
+
+void X86PageTableBase::DeferInvalidations() {
+    fbl::AutoLock a(&lock_);
+    DEBUG_ASSERT(defer_thread_ == nullptr);
+    defer_thread_ = get_current_thread();
+}
+
+size_t X86PageTableBase::FlushDeferredInvalidations() {
+    list_node to_free = LIST_INITIAL_VALUE(to_free);
+    size_t count;
+    {
+        fbl::AutoLock a(&lock_);
+        DEBUG_ASSERT(defer_thread_ == get_current_thread());
+        defer_thread_ = nullptr;
+
+        TlbInvalidate(&deferred_tlb_);
+        count = deferred_count_;
+        deferred_count_ = 0;
+        list_move(&deferred_free_, &to_free);
+    }
+
+    // As in ~ConsistencyManager, release the page tables outside the lock.
+    if (!list_is_empty(&to_free)) {
+        pmm_free(&to_free);
+    }
+    return count;
+}
+
 void X86PageTableBase::Destroy(vaddr_t base, size_t size) {
     canary_.Assert();
 
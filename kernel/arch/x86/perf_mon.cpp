@@ -41,9 +41,11 @@
 #include <arch/mmu.h>
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
+#include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/perf_mon.h>
+#include <arch/x86/user_copy.h>
 #include <assert.h>
 #include <dev/pci_common.h>
 #include <err.h>
@@ -157,7 +159,7 @@ static_assert(1
 static uint64_t kGlobalCtrlWritableBits;
 static uint64_t kFixedCounterCtrlWritableBits;
 
-static constexpr size_t kMaxRecordSize = sizeof(cpuperf_pc_record_t);
+static constexpr size_t kMaxRecordSize = sizeof(cpuperf_callchain_record_t);
 
 // Commented out values represent currently unsupported features.
 // They remain present for documentation purposes.
@@ -576,6 +578,61 @@ static cpuperf_record_header_t* x86_perfmon_write_pc_record(
     return reinterpret_cast<cpuperf_record_header_t*>(rec);
 }
 
+// Follows the frame pointers from |fp|, storing up to |max_frames| return
+// addresses in |frames|. Returns the number stored.
+// User stacks are read without servicing page faults, as we're in the PMI
+// handler. Kernel stacks are only followed while they stay within the
+// current thread's stack.
+static unsigned x86_perfmon_walk_stack(uint64_t fp, bool user,
+                                       uint64_t* frames, unsigned max_frames) {
+    const thread_t* thread = get_current_thread();
+    const uint64_t stack_base = reinterpret_cast<uint64_t>(thread->stack);
+    const uint64_t stack_top = stack_base + thread->stack_size;
+
+    unsigned n = 0;
+    while (n < max_frames && (fp & 7) == 0) {
+        // The caller's frame pointer, then the return address.
+        uint64_t fp_and_ra[2];
+        if (user) {
+            if (x86_copy_from_user_nofault(fp_and_ra, reinterpret_cast<void*>(fp),
+                                           sizeof(fp_and_ra)) != ZX_OK)
+                break;
+        } else {
+            if (fp < stack_base || fp > stack_top - sizeof(fp_and_ra))
+                break;
+            memcpy(fp_and_ra, reinterpret_cast<void*>(fp), sizeof(fp_and_ra));
+        }
+        if (fp_and_ra[1] == 0)
+            break;
+        frames[n++] = fp_and_ra[1];
+        // Stacks grow down, so a caller's frame is above its callee's.
+        // This also stops us going round in circles.
+        if (fp_and_ra[0] <= fp)
+            break;
+        fp = fp_and_ra[0];
+    }
+    return n;
+}
+
+static cpuperf_record_header_t* x86_perfmon_write_callchain_record(
+        cpuperf_record_header_t* hdr,
+        cpuperf_event_id_t event, uint64_t cr3, const x86_iframe_t* frame) {
+    auto rec = reinterpret_cast<cpuperf_callchain_record_t*>(hdr);
+    x86_perfmon_write_header(&rec->header, CPUPERF_RECORD_CALLCHAIN, event);
+    const thread_t* thread = get_current_thread();
+    bool user = SELECTOR_PL(frame->cs) != 0;
+    rec->flags = user ? 0 : CPUPERF_CALLCHAIN_FLAG_KERNEL;
+    rec->aspace = cr3;
+    rec->pid = thread->user_pid;
+    rec->tid = thread->user_tid;
+    rec->frames[0] = frame->ip;
+    unsigned n = 1 + x86_perfmon_walk_stack(frame->rbp, user, &rec->frames[1],
+                                            CPUPERF_MAX_CALLCHAIN_FRAMES - 1);
+    rec->num_frames = static_cast<uint16_t>(n);
+    return reinterpret_cast<cpuperf_record_header_t*>(
+        reinterpret_cast<char*>(rec) + CPUPERF_CALLCHAIN_RECORD_SIZE(n));
+}
+
 zx_status_t x86_ipm_get_properties(zx_x86_ipm_properties_t* props) {
     fbl::AutoLock al(&perfmon_lock);
 
@@ -801,7 +858,7 @@ static zx_status_t x86_ipm_verify_misc_config(
             }
             // Currently we only support the MCHBAR counters.
             // They cannot provide pc. We ignore the OS/USER bits.
-            if (config->misc_flags[i] & IPM_CONFIG_FLAG_PC) {
+            if (config->misc_flags[i] & (IPM_CONFIG_FLAG_PC | IPM_CONFIG_FLAG_CALLCHAIN)) {
                 TRACEF("Invalid bits (0x%x) in |misc_flags[%u]|\n",
                        config->misc_flags[i], i);
                 return ZX_ERR_INVALID_ARGS;
@@ -1733,7 +1790,7 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
 
     const uint64_t status = read_msr(IA32_PERF_GLOBAL_STATUS);
     uint64_t bits_to_clear = 0;
-    uint64_t cr3 = x86_get_cr3();
+    uint64_t cr3 = x86_get_cr3() & X86_CR3_BASE_MASK;
 
     LTRACEF("cpu %u: status 0x%" PRIx64 "\n", cpu, status);
 
@@ -1769,7 +1826,9 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
             } else if (state->programmable_flags[i] & IPM_CONFIG_FLAG_TIMEBASE) {
                 continue;
             }
-            if (state->programmable_flags[i] & IPM_CONFIG_FLAG_PC) {
+            if (state->programmable_flags[i] & IPM_CONFIG_FLAG_CALLCHAIN) {
+                next = x86_perfmon_write_callchain_record(next, id, cr3, frame);
+            } else if (state->programmable_flags[i] & IPM_CONFIG_FLAG_PC) {
                 next = x86_perfmon_write_pc_record(next, id, cr3, frame->ip);
             } else {
                 next = x86_perfmon_write_tick_record(next, id);
@@ -1793,7 +1852,9 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
             } else if (state->fixed_flags[i] & IPM_CONFIG_FLAG_TIMEBASE) {
                 continue;
             }
-            if (state->fixed_flags[i] & IPM_CONFIG_FLAG_PC) {
+            if (state->fixed_flags[i] & IPM_CONFIG_FLAG_CALLCHAIN) {
+                next = x86_perfmon_write_callchain_record(next, id, cr3, frame);
+            } else if (state->fixed_flags[i] & IPM_CONFIG_FLAG_PC) {
                 next = x86_perfmon_write_pc_record(next, id, cr3, frame->ip);
             } else {
                 next = x86_perfmon_write_tick_record(next, id);
@@ -132,11 +132,12 @@ zx_status_t x86_bringup_aps(uint32_t* apic_ids, uint32_t count) {
 
     // The docs recommend waiting 200us for cores to boot.  We do a bit more
     // work before the cores report in, so wait longer (up to 1 second).
-    for (int tries_left = 200;
+    // Poll finely so the boot cpu moves on as soon as the last one is up.
+    for (int tries_left = 10000;
          aps_still_booting != 0 && tries_left > 0;
          --tries_left) {
 
-        thread_sleep_relative(ZX_MSEC(5));
+        thread_sleep_relative(ZX_USEC(100));
     }
 
     uint failed_aps;
@@ -0,0 +1,67 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <arch/arch_ops.h>
+#include <arch/ops.h>
+#include <arch/spinlock.h>
+
+// We need to disable thread safety analysis in this file, since we're
+// implementing the locks themselves.  Without this, the header-level
+// annotations cause Clang to detect violations.
+
+namespace {
+
+constexpr uint32_t kNextTicket = 1u << 16;
+
+uint16_t serving(uint32_t tickets) {
+    return static_cast<uint16_t>(tickets);
+}
+
+uint16_t next(uint32_t tickets) {
+    return static_cast<uint16_t>(tickets >> 16);
+}
+
+} // namespace
+
+void arch_spin_lock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    const uint16_t ticket =
+        next(__atomic_fetch_add(&lock->tickets, kNextTicket, __ATOMIC_ACQUIRE));
+
+    // Every waiter reads the line until its turn comes, so back off in
+    // proportion to the number of cpus ahead rather than polling flat out.
+    for (;;) {
+        const uint16_t ahead =
+            static_cast<uint16_t>(ticket - serving(__atomic_load_n(&lock->tickets,
+                                                                   __ATOMIC_ACQUIRE)));
+        if (ahead == 0)
+            break;
+        for (uint i = 0; i < ahead; i++)
+            arch_spinloop_pause();
+    }
+
+    __atomic_store_n(&lock->holder, arch_curr_cpu_num() + 1, __ATOMIC_RELAXED);
+}
+
+int arch_spin_trylock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    uint32_t tickets = __atomic_load_n(&lock->tickets, __ATOMIC_RELAXED);
+    if (serving(tickets) != next(tickets))
+        return 1;
+    if (!__atomic_compare_exchange_n(&lock->tickets, &tickets, tickets + kNextTicket, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 1;
+
+    __atomic_store_n(&lock->holder, arch_curr_cpu_num() + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void arch_spin_unlock(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    __atomic_store_n(&lock->holder, 0u, __ATOMIC_RELAXED);
+
+    // Only the holder moves the low half on, so a plain store of it is
+    // enough and cannot disturb tickets being taken from the high half.
+    uint16_t* owner = reinterpret_cast<uint16_t*>(&lock->tickets);
+    __atomic_store_n(owner, static_cast<uint16_t>(*owner + 1), __ATOMIC_RELEASE);
+}
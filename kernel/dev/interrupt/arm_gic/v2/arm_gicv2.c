@@ -237,6 +237,30 @@ static zx_status_t gic_get_interrupt_config(unsigned int vector,
     return ZX_OK;
 }
 
+static zx_status_t gic_set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    // Only SPIs can be routed, and only to the 8 cpu interfaces a GICv2
+    // has.  As in gic_send_ipi, cpu numbers are cpu interface numbers.
+    if ((vector >= max_irqs) || (vector < GIC_BASE_SPI))
+        return ZX_ERR_INVALID_ARGS;
+    if (cpu >= 8)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    // Each ITARGETSR register holds the target cpu masks of 4 interrupts.
+    uint32_t reg_ndx = vector / 4;
+    uint32_t shift = (vector % 4) * 8;
+
+    spin_lock_saved_state_t state;
+    spin_lock_save(&gicd_lock, &state, GICD_LOCK_FLAGS);
+    uint32_t reg_val = GICREG(0, GICD_ITARGETSR(reg_ndx));
+    reg_val &= ~(0xffu << shift);
+    reg_val |= (1u << cpu) << shift;
+    GICREG(0, GICD_ITARGETSR(reg_ndx)) = reg_val;
+    gicd_itargetsr[reg_ndx] = reg_val;
+    spin_unlock_restore(&gicd_lock, state, GICD_LOCK_FLAGS);
+
+    return ZX_OK;
+}
+
 static unsigned int gic_remap_interrupt(unsigned int vector) {
     return vector;
 }
@@ -328,6 +352,7 @@ static const struct pdev_interrupt_ops gic_ops = {
     .unmask = gic_unmask_interrupt,
     .configure = gic_configure_interrupt,
     .get_config = gic_get_interrupt_config,
+    .set_affinity = gic_set_interrupt_affinity,
     .is_valid = gic_is_valid_interrupt,
     .remap = gic_remap_interrupt,
     .send_ipi = gic_send_ipi,
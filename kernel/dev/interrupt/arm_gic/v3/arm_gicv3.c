@@ -262,6 +262,23 @@ static zx_status_t gic_get_interrupt_config(unsigned int vector,
     return ZX_OK;
 }
 
+static zx_status_t gic_set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    LTRACEF("vector %u, cpu %u\n", vector, cpu);
+
+    // Only SPIs can be routed.
+    if (vector < 32 || vector >= gic_max_int)
+        return ZX_ERR_INVALID_ARGS;
+    if (cpu >= arch_max_num_cpus())
+        return ZX_ERR_INVALID_ARGS;
+
+    // Route to the affinity of |cpu|: its cluster in Aff1, its core in Aff0.
+    uint64_t val = ((uint64_t)(arch_cpu_num_to_cluster_id(cpu) & 0xff) << 8) |
+                   (arch_cpu_num_to_cpu_id(cpu) & 0xff);
+    GICREG64(0, GICD_IROUTER(vector)) = val;
+
+    return ZX_OK;
+}
+
 static unsigned int gic_remap_interrupt(unsigned int vector) {
     LTRACEF("vector %u\n", vector);
     return vector;
@@ -357,6 +374,7 @@ static const struct pdev_interrupt_ops gic_ops = {
     .unmask = gic_unmask_interrupt,
     .configure = gic_configure_interrupt,
     .get_config = gic_get_interrupt_config,
+    .set_affinity = gic_set_interrupt_affinity,
     .is_valid = gic_is_valid_interrupt,
     .remap = gic_remap_interrupt,
     .send_ipi = gic_send_ipi,
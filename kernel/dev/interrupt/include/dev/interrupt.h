@@ -38,6 +38,10 @@ zx_status_t get_interrupt_config(unsigned int vector,
                                  enum interrupt_trigger_mode* tm,
                                  enum interrupt_polarity* pol);
 
+// Route the specified interrupt vector to |cpu|.  Vectors which cannot be
+// steered, such as per-cpu interrupts, return ZX_ERR_NOT_SUPPORTED.
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_num_t cpu);
+
 typedef void (*int_handler)(void* arg);
 
 zx_status_t register_int_handler(unsigned int vector, int_handler handler, void* arg);
@@ -10,7 +10,7 @@
 #include <endian.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/ref_counted.h>
-#include <fbl/intrusive_single_list.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <dev/pci_common.h>
 
 class PciReg8 {
@@ -51,7 +51,7 @@ private:
 
 /* PciConfig supplies the factory for creating the appropriate pci config
  * object based on the address space of the pci device. */
-class PciConfig : public fbl::SinglyLinkedListable<fbl::RefPtr<PciConfig>>
+class PciConfig : public fbl::WAVLTreeContainable<fbl::RefPtr<PciConfig>>
                 , public fbl::RefCounted<PciConfig> {
 public:
     // Standard PCI configuration space values. Offsets from PCI Firmware Spec ch 6.
@@ -122,6 +122,31 @@ public:
     inline uintptr_t base() const { return base_; }
     inline PciAddrSpace addr_space() const { return addr_space_; }
 
+    // WAVLTree properties
+    uintptr_t GetKey() const { return base_; }
+
+    /** Read the vendor and device id of a function with a single config access
+     * and without creating a config object for it, so that scans can cheaply
+     * skip the many functions which are not present.
+     *
+     * @return the device id in the upper 16 bits and the vendor id in the lower
+     * 16 bits.  Absent functions read as all ones.
+     */
+    static uint32_t ProbeId(uintptr_t base, PciAddrSpace addr_type);
+
+    /** Snapshot the read-only identification fields of the header (ids, class
+     * codes, header type, capabilities pointer and interrupt pin) so that
+     * ReadCached() can serve them without touching the hardware.  Must be
+     * called before the config is shared with other threads.
+     */
+    void CacheReadOnlyFields();
+
+    // Reads which are served from the shadow of read-only fields when the
+    // register falls entirely within it, and from the hardware otherwise.
+    uint8_t ReadCached(const PciReg8 addr) const;
+    uint16_t ReadCached(const PciReg16 addr) const;
+    uint32_t ReadCached(const PciReg32 addr) const;
+
     // Virtuals
     void DumpConfig(uint16_t len) const;
     virtual uint8_t Read(const PciReg8 addr) const = 0;
@@ -137,4 +162,13 @@ protected:
         : addr_space_(addr_space), base_(base) {}
     const PciAddrSpace addr_space_;
     const uintptr_t base_;
+
+private:
+    void CacheBytes(uint16_t offset, uint width);
+    bool IsCached(uint16_t offset, uint width) const;
+
+    // One bit per byte of the standard header held in |shadow_|.
+    static_assert(kStdCfgEnd <= 64, "shadow valid mask is too small");
+    uint64_t shadow_valid_ = 0;
+    uint8_t shadow_[kStdCfgEnd] = {};
 };
@@ -71,6 +71,12 @@ public:
                                uint func_id,
                                paddr_t* out_cfg_phys = nullptr);
 
+    // Read the vendor and device id of a function (device id in the upper 16
+    // bits) without creating a config object for it.  Returns
+    // ZX_ERR_OUT_OF_RANGE if the function lies outside of config space, and
+    // ZX_ERR_NOT_FOUND if nothing is present there.
+    zx_status_t ProbeFunction(uint bus_id, uint dev_id, uint func_id, uint32_t* out_id);
+
     // Address space (PIO and MMIO) allocation management
     //
     // Note: Internally, regions held for MMIO address space allocation are
@@ -180,8 +186,12 @@ public:
     static void        ShutdownDriver();
 
     // Debug/ASSERT routine, used by devices and bridges to assert that the
-    // rescan lock is currently being held.
-    bool RescanLockIsHeld() const { return bus_rescan_lock_.IsHeld(); };
+    // rescan lock is currently being held.  While the roots are being scanned
+    // in parallel, the lock is held on behalf of the scan threads by the
+    // thread waiting for them.
+    bool RescanLockIsHeld() const {
+        return bus_rescan_lock_.IsHeld() || parallel_scan_active_;
+    };
 
 private:
     friend class PcieDebugConsole;
@@ -225,6 +235,9 @@ private:
     bool     IsOperational() const { smp_mb(); return state_ == State::OPERATIONAL; }
 
     zx_status_t AllocBookkeeping();
+    bool        GetConfigAddr(uint bus_id, uint dev_id, uint func_id,
+                              uintptr_t* out_addr, paddr_t* out_cfg_phys);
+    void        ScanRootsLocked();
     void        ForeachRoot(ForeachRootCallback cbk, void* ctx);
     void        ForeachDevice(ForeachDeviceCallback cbk, void* ctx);
     bool        ForeachDownstreamDevice(const fbl::RefPtr<PcieUpstreamNode>& upstream,
@@ -244,7 +257,10 @@ private:
     fbl::Mutex                         bus_rescan_lock_;
     mutable fbl::Mutex                 start_lock_;
     RootCollection                      roots_;
-    fbl::SinglyLinkedList<fbl::RefPtr<PciConfig>> configs_;
+    volatile bool                       parallel_scan_active_ = false;
+
+    fbl::Mutex                         configs_lock_;
+    fbl::WAVLTree<uintptr_t, fbl::RefPtr<PciConfig>> configs_;
 
     bool                                is_mmio_ = true;
     RegionAllocator::RegionPool::RefPtr region_bookkeeping_;
@@ -175,6 +175,81 @@ fbl::RefPtr<PciConfig> PciConfig::Create(uintptr_t base, PciAddrSpace addr_type)
     return cfg;
 }
 
+uint32_t PciConfig::ProbeId(uintptr_t base, PciAddrSpace addr_type) {
+    if (addr_type == PciAddrSpace::PIO) {
+        uint32_t val;
+        zx_status_t status = Pci::PioCfgRead(static_cast<uint32_t>(base), &val, 32u);
+        DEBUG_ASSERT(status == ZX_OK);
+        return val;
+    }
+
+    return LE32(*reinterpret_cast<const volatile uint32_t*>(base));
+}
+
+void PciConfig::CacheBytes(uint16_t offset, uint width) {
+    DEBUG_ASSERT(offset + width <= kStdCfgEnd);
+
+    uint32_t val;
+    switch (width) {
+    case 1u: val = Read(PciReg8(offset)); break;
+    case 2u: val = Read(PciReg16(offset)); break;
+    default: val = Read(PciReg32(offset)); break;
+    }
+
+    for (uint i = 0; i < width; i++) {
+        shadow_[offset + i] = static_cast<uint8_t>(val >> (i * 8));
+        shadow_valid_ |= 1ull << (offset + i);
+    }
+}
+
+bool PciConfig::IsCached(uint16_t offset, uint width) const {
+    if (offset + width > kStdCfgEnd)
+        return false;
+
+    uint64_t mask = ((1ull << width) - 1) << offset;
+    return (shadow_valid_ & mask) == mask;
+}
+
+void PciConfig::CacheReadOnlyFields() {
+    // Nothing is cached for an absent function; it may show up later.
+    uint32_t id = Read(PciReg32(kVendorId.offset()));
+    if ((id & 0xFFFF) == PCIE_INVALID_VENDOR_ID)
+        return;
+
+    // Vendor and device id, then revision, program interface and class codes.
+    CacheBytes(kVendorId.offset(), 4u);
+    CacheBytes(kRevisionId.offset(), 4u);
+    CacheBytes(kHeaderType.offset(), 1u);
+    CacheBytes(kCapabilitiesPtr.offset(), 1u);
+    CacheBytes(kInterruptPin.offset(), 1u);
+
+    // Bridges keep their prefetchable limit where a device's subsystem ids are.
+    if ((shadow_[kHeaderType.offset()] & PCI_HEADER_TYPE_MASK) == PCI_HEADER_TYPE_STANDARD)
+        CacheBytes(kSubsystemVendorId.offset(), 4u);
+}
+
+uint8_t PciConfig::ReadCached(const PciReg8 addr) const {
+    if (IsCached(addr.offset(), 1u))
+        return shadow_[addr.offset()];
+    return Read(addr);
+}
+
+uint16_t PciConfig::ReadCached(const PciReg16 addr) const {
+    if (IsCached(addr.offset(), 2u))
+        return static_cast<uint16_t>(shadow_[addr.offset()] |
+                                     (shadow_[addr.offset() + 1] << 8));
+    return Read(addr);
+}
+
+uint32_t PciConfig::ReadCached(const PciReg32 addr) const {
+    if (IsCached(addr.offset(), 4u))
+        return static_cast<uint32_t>(shadow_[addr.offset()]) |
+               (static_cast<uint32_t>(shadow_[addr.offset() + 1]) << 8) |
+               (static_cast<uint32_t>(shadow_[addr.offset() + 2]) << 16) |
+               (static_cast<uint32_t>(shadow_[addr.offset() + 3]) << 24);
+    return Read(addr);
+}
+
 void PciConfig::DumpConfig(uint16_t len) const {
     printf("%u bytes of raw config (base %s:%#" PRIxPTR ")\n",
            len, (addr_space_ == PciAddrSpace::MMIO) ? "MMIO" : "PIO", base_);
@@ -10,6 +10,7 @@
 #include <dev/pcie_device.h>
 #include <dev/pcie_root.h>
 #include <inttypes.h>
+#include <kernel/thread.h>
 #include <vm/vm_aspace.h>
 #include <lib/pci/pio.h>
 #include <lk/init.h>
@@ -18,6 +19,7 @@
 #include <fbl/auto_lock.h>
 #include <fbl/limits.h>
 #include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
 #include <trace.h>
 
 using fbl::AutoLock;
@@ -105,10 +107,7 @@ zx_status_t PcieBusDriver::RescanDevices() {
     AutoLock lock(&bus_rescan_lock_);
 
     // Scan each root looking for for devices and other bridges.
-    ForeachRoot([](const fbl::RefPtr<PcieRoot>& root, void* ctx) -> bool {
-                     root->ScanDownstream();
-                     return true;
-                   }, nullptr);
+    ScanRootsLocked();
 
     // Attempt to allocate any unallocated BARs
     ForeachRoot([](const fbl::RefPtr<PcieRoot>& root, void* ctx) -> bool {
@@ -119,6 +118,51 @@ zx_status_t PcieBusDriver::RescanDevices() {
     return ZX_OK;
 }
 
+void PcieBusDriver::ScanRootsLocked() {
+    DEBUG_ASSERT(bus_rescan_lock_.IsHeld());
+
+    // Roots manage disjoint ranges of busses, so each one is scanned on a
+    // thread of its own.  Most of the time spent enumerating is spent waiting
+    // on config accesses, which lets systems with many roots scan them all in
+    // roughly the time it takes to scan the largest.
+    struct ScanWorker : public fbl::SinglyLinkedListable<fbl::unique_ptr<ScanWorker>> {
+        fbl::RefPtr<PcieRoot> root;
+        thread_t* thread = nullptr;
+    };
+    fbl::SinglyLinkedList<fbl::unique_ptr<ScanWorker>> workers;
+
+    parallel_scan_active_ = true;
+    ForeachRoot([](const fbl::RefPtr<PcieRoot>& root, void* ctx) -> bool {
+        auto workers = static_cast<fbl::SinglyLinkedList<fbl::unique_ptr<ScanWorker>>*>(ctx);
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<ScanWorker> worker(new (&ac) ScanWorker());
+        if (ac.check()) {
+            worker->root = root;
+            worker->thread = thread_create("pcie-scan", [](void* arg) -> int {
+                static_cast<ScanWorker*>(arg)->root->ScanDownstream();
+                return 0;
+            }, worker.get(), DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        }
+
+        // Fall back on scanning in place if we could not get a thread.
+        if (!ac.check() || (worker->thread == nullptr)) {
+            root->ScanDownstream();
+            return true;
+        }
+
+        thread_resume(worker->thread);
+        workers->push_front(fbl::move(worker));
+        return true;
+    }, &workers);
+
+    while (!workers.is_empty()) {
+        auto worker = workers.pop_front();
+        thread_join(worker->thread, nullptr, ZX_TIME_INFINITE);
+    }
+    parallel_scan_active_ = false;
+}
+
 bool PcieBusDriver::IsNotStarted(bool allow_quirks_phase) const {
     AutoLock start_lock(&start_lock_);
 
@@ -153,10 +197,7 @@ zx_status_t PcieBusDriver::StartBusDriver() {
         AutoLock lock(&bus_rescan_lock_);
 
         // Scan each root looking for for devices and other bridges.
-        ForeachRoot([](const fbl::RefPtr<PcieRoot>& root, void* ctx) -> bool {
-                         root->ScanDownstream();
-                         return true;
-                       }, nullptr);
+        ScanRootsLocked();
 
         if (!AdvanceState(State::STARTING_SCANNING, State::STARTING_RUNNING_QUIRKS))
             return ZX_ERR_BAD_STATE;
@@ -484,66 +525,103 @@ void PcieBusDriver::ShutdownDriver() {
  *  ECAM support
  *
  ******************************************************************************/
-/* TODO(cja): The bus driver owns all configs as well as devices so the
- * lifecycle of both are already dependent. Should this still return a refptr?
- */
-const PciConfig* PcieBusDriver::GetConfig(uint bus_id,
-                                        uint dev_id,
-                                        uint func_id,
-                                        paddr_t* out_cfg_phys) {
+bool PcieBusDriver::GetConfigAddr(uint bus_id,
+                                  uint dev_id,
+                                  uint func_id,
+                                  uintptr_t* out_addr,
+                                  paddr_t* out_cfg_phys) {
     DEBUG_ASSERT(bus_id  < PCIE_MAX_BUSSES);
     DEBUG_ASSERT(dev_id  < PCIE_MAX_DEVICES_PER_BUS);
     DEBUG_ASSERT(func_id < PCIE_MAX_FUNCTIONS_PER_DEVICE);
+    DEBUG_ASSERT(out_addr);
 
-    uintptr_t addr;
-    if (is_mmio_) {
-        // Find the region which would contain this bus_id, if any.
-        // add does not overlap with any already defined regions.
-        AutoLock ecam_region_lock(&ecam_region_lock_);
-        auto iter = ecam_regions_.upper_bound(static_cast<uint8_t>(bus_id));
-        --iter;
-
-        if (out_cfg_phys) {
-            *out_cfg_phys = 0;
-        }
+    if (out_cfg_phys) {
+        *out_cfg_phys = 0;
+    }
 
-        if (!iter.IsValid()) {
-            return nullptr;
-        }
+    if (!is_mmio_) {
+        *out_addr = Pci::PciBdfAddr(static_cast<uint8_t>(bus_id), static_cast<uint8_t>(dev_id),
+                                    static_cast<uint8_t>(func_id), 0);
+        return true;
+    }
 
-        if ((bus_id < iter->ecam().bus_start) ||
-                (bus_id > iter->ecam().bus_end)) {
-            return nullptr;
-        }
+    // Find the region which would contain this bus_id, if any.
+    // add does not overlap with any already defined regions.
+    AutoLock ecam_region_lock(&ecam_region_lock_);
+    auto iter = ecam_regions_.upper_bound(static_cast<uint8_t>(bus_id));
+    --iter;
 
-        bus_id -= iter->ecam().bus_start;
-        size_t offset = (static_cast<size_t>(bus_id)  << 20) |
-            (static_cast<size_t>(dev_id)  << 15) |
-            (static_cast<size_t>(func_id) << 12);
+    if (!iter.IsValid()) {
+        return false;
+    }
 
-        if (out_cfg_phys) {
-            *out_cfg_phys = iter->ecam().phys_base + offset;
-        }
+    if ((bus_id < iter->ecam().bus_start) ||
+            (bus_id > iter->ecam().bus_end)) {
+        return false;
+    }
 
-        // TODO(cja): Move to a BDF based associative container for better lookup time
-        // and insert or find behavior.
-        addr = reinterpret_cast<uintptr_t>(static_cast<uint8_t*>(iter->vaddr()) + offset);
-    } else {
-        addr = Pci::PciBdfAddr(static_cast<uint8_t>(bus_id), static_cast<uint8_t>(dev_id),
-                               static_cast<uint8_t>(func_id), 0);
+    bus_id -= iter->ecam().bus_start;
+    size_t offset = (static_cast<size_t>(bus_id)  << 20) |
+        (static_cast<size_t>(dev_id)  << 15) |
+        (static_cast<size_t>(func_id) << 12);
+
+    if (out_cfg_phys) {
+        *out_cfg_phys = iter->ecam().phys_base + offset;
+    }
+
+    *out_addr = reinterpret_cast<uintptr_t>(static_cast<uint8_t*>(iter->vaddr()) + offset);
+    return true;
+}
+
+zx_status_t PcieBusDriver::ProbeFunction(uint bus_id,
+                                         uint dev_id,
+                                         uint func_id,
+                                         uint32_t* out_id) {
+    DEBUG_ASSERT(out_id);
+
+    uintptr_t addr;
+    if (!GetConfigAddr(bus_id, dev_id, func_id, &addr, nullptr)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // A single 32-bit access fetches both ids.  Absent functions read as all
+    // ones, so there is no need to go on to the device id for them.
+    *out_id = PciConfig::ProbeId(addr, (is_mmio_) ? PciAddrSpace::MMIO : PciAddrSpace::PIO);
+    if ((*out_id & 0xFFFF) == PCIE_INVALID_VENDOR_ID) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    return ZX_OK;
+}
+
+/* TODO(cja): The bus driver owns all configs as well as devices so the
+ * lifecycle of both are already dependent. Should this still return a refptr?
+ */
+const PciConfig* PcieBusDriver::GetConfig(uint bus_id,
+                                        uint dev_id,
+                                        uint func_id,
+                                        paddr_t* out_cfg_phys) {
+    uintptr_t addr;
+    if (!GetConfigAddr(bus_id, dev_id, func_id, &addr, out_cfg_phys)) {
+        return nullptr;
     }
 
-    auto cfg_iter = configs_.find_if([addr](const PciConfig& cfg) {
-                                        return (cfg.base() == addr);
-                                        });
     /* An entry for this bdf config has been found in cache, return it */
+    AutoLock configs_lock(&configs_lock_);
+    auto cfg_iter = configs_.find(addr);
     if (cfg_iter.IsValid()) {
         return &(*cfg_iter);
     }
 
-    // Nothing found, create a new PciConfig for this address
+    // Nothing found, create a new PciConfig for this address and snapshot its
+    // read-only fields before anyone else can see it.
     auto cfg = PciConfig::Create(addr, (is_mmio_) ? PciAddrSpace::MMIO : PciAddrSpace::PIO);
-    configs_.push_front(cfg);
+    if (cfg == nullptr) {
+        return nullptr;
+    }
+
+    cfg->CacheReadOnlyFields();
+    configs_.insert(cfg);
     return cfg.get();
 }
 
@@ -71,20 +71,31 @@ void PcieUpstreamNode::ScanDownstream() {
 
     for (uint dev_id = 0; dev_id < PCIE_MAX_DEVICES_PER_BUS; ++dev_id) {
         for (uint func_id = 0; func_id < PCIE_MAX_FUNCTIONS_PER_DEVICE; ++func_id) {
-            /* If we can find the config, and it has a valid vendor ID, go ahead
-             * and scan it looking for a valid function. */
-            auto cfg = driver().GetConfig(managed_bus_id_, dev_id, func_id);
-            if (cfg == nullptr) {
+            /* Probe the function's ids with a single config read.  Most of the
+             * functions on a bus are absent, and there is no point in setting
+             * up config state for them. */
+            uint32_t id;
+            zx_status_t status = driver().ProbeFunction(managed_bus_id_, dev_id, func_id, &id);
+            if (status == ZX_ERR_OUT_OF_RANGE) {
                 TRACEF("Warning: bus being scanned is outside ecam region!\n");
                 return;
             }
 
-            uint16_t vendor_id = cfg->Read(PciConfig::kVendorId);
-            bool good_device = cfg && (vendor_id != PCIE_INVALID_VENDOR_ID);
+            bool good_device = (status == ZX_OK);
+            const PciConfig* cfg = nullptr;
             if (good_device) {
-                uint16_t device_id = cfg->Read(PciConfig::kDeviceId);
                 LTRACEF("found valid device %04x:%04x at %02x:%02x.%01x\n",
-                        vendor_id, device_id, managed_bus_id_, dev_id, func_id);
+                        id & 0xFFFF, id >> 16, managed_bus_id_, dev_id, func_id);
+
+                cfg = driver().GetConfig(managed_bus_id_, dev_id, func_id);
+                if (cfg == nullptr) {
+                    TRACEF("Failed to fetch config for device %02x:%02x.%01x\n",
+                           managed_bus_id_, dev_id, func_id);
+                    good_device = false;
+                }
+            }
+
+            if (good_device) {
                 /* Don't scan the function again if we have already discovered
                  * it.  If this function happens to be a bridge, go ahead and
                  * look under it for new devices. */
@@ -112,7 +123,8 @@ void PcieUpstreamNode::ScanDownstream() {
              * config's header type indicates that this is not a multi-function
              * device, then just move on to the next device. */
             if (!func_id &&
-               (!good_device || !(cfg->Read(PciConfig::kHeaderType) & PCI_HEADER_TYPE_MULTI_FN)))
+               (!good_device ||
+                !(cfg->ReadCached(PciConfig::kHeaderType) & PCI_HEADER_TYPE_MULTI_FN)))
                 break;
         }
     }
@@ -133,7 +145,7 @@ fbl::RefPtr<PcieDevice> PcieUpstreamNode::ScanDevice(const PciConfig* cfg,
     LTRACEF("Scanning new function at %02x:%02x.%01x\n", managed_bus_id_, dev_id, func_id);
 
     /* Is there an actual device here? */
-    uint16_t vendor_id = cfg->Read(PciConfig::kVendorId);
+    uint16_t vendor_id = cfg->ReadCached(PciConfig::kVendorId);
     if (vendor_id == PCIE_INVALID_VENDOR_ID) {
         LTRACEF("Bad vendor ID (0x%04hx) when looking for PCIe device at %02x:%02x.%01x\n",
                 vendor_id, managed_bus_id_, dev_id, func_id);
@@ -142,7 +154,7 @@ fbl::RefPtr<PcieDevice> PcieUpstreamNode::ScanDevice(const PciConfig* cfg,
 
     // Create the either a PcieBridge or a PcieDevice based on the configuration
     // header type.
-    uint8_t header_type = cfg->Read(PciConfig::kHeaderType) & PCI_HEADER_TYPE_MASK;
+    uint8_t header_type = cfg->ReadCached(PciConfig::kHeaderType) & PCI_HEADER_TYPE_MASK;
     if (header_type == PCI_HEADER_TYPE_PCI_BRIDGE) {
         uint secondary_id = cfg->Read(PciConfig::kSecondaryBusId);
         return PcieBridge::Create(*this, dev_id, func_id, secondary_id);
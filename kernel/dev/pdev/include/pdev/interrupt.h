@@ -29,6 +29,7 @@ struct pdev_interrupt_ops {
     zx_status_t (*get_config)(unsigned int vector,
                               enum interrupt_trigger_mode* tm,
                               enum interrupt_polarity* pol);
+    zx_status_t (*set_affinity)(unsigned int vector, cpu_num_t cpu);
     bool (*is_valid)(unsigned int vector, uint32_t flags);
     unsigned int (*remap)(unsigned int vector);
     zx_status_t (*send_ipi)(cpu_mask_t target, mp_ipi_t ipi);
@@ -64,6 +64,10 @@ static zx_status_t default_get_config(unsigned int vector,
     return ZX_ERR_NOT_CONFIGURED;
 }
 
+static zx_status_t default_set_affinity(unsigned int vector, cpu_num_t cpu) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
 static bool default_is_valid(unsigned int vector, uint32_t flags) {
     return false;
 }
@@ -95,6 +99,7 @@ static const struct pdev_interrupt_ops default_ops = {
     .unmask = default_unmask,
     .configure = default_configure,
     .get_config = default_get_config,
+    .set_affinity = default_set_affinity,
     .is_valid = default_is_valid,
     .remap = default_remap,
     .send_ipi = default_send_ipi,
@@ -125,6 +130,10 @@ zx_status_t get_interrupt_config(unsigned int vector, enum interrupt_trigger_mod
     return intr_ops->get_config(vector, tm, pol);
 }
 
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    return intr_ops->set_affinity(vector, cpu);
+}
+
 bool is_valid_interrupt(unsigned int vector, uint32_t flags) {
     return intr_ops->is_valid(vector, flags);
 }
@@ -249,6 +249,17 @@ uint64_t ticks_per_second(void)
     return u64_mul_u32_fp32_64(1000 * 1000 * 1000, cntpct_per_ns);
 }
 
+bool platform_usermode_ticks_to_time(struct fp_32_64* ns_per_tick)
+{
+    // zx_ticks_get() reads the virtual counter, which is only known to
+    // match current_time() when the kernel uses it too.
+    if (reg_procs != &cntv_procs) {
+        return false;
+    }
+    *ns_per_tick = ns_per_cntpct;
+    return true;
+}
+
 static uint32_t abs_int32(int32_t a)
 {
     return (a > 0) ? a : -a;
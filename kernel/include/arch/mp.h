@@ -42,4 +42,9 @@ zx_status_t arch_mp_cpu_unplug(cpu_num_t cpu_id);
 
 void arch_mp_init_percpu(void);
 
+/* return one of the MP_CPU_DISTANCE_* values for the pair of cpus. this is how
+ * each architecture describes its cache topology to the scheduler domains.
+ */
+uint arch_mp_cpu_distance(cpu_num_t a, cpu_num_t b);
+
 __END_CDECLS
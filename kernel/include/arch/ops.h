@@ -63,6 +63,13 @@ void arch_flush_state_and_halt(event_t *flush_done) __NO_RETURN;
 
 void arch_idle(void);
 
+/* Whether the cpu can sleep in arch_idle_wait() and be woken by a store. */
+bool arch_idle_wakes_on_write(void);
+
+/* Like arch_idle(), but also ends when another cpu writes to |*word|. Returns
+ * at once if any of |mask| is already set in it. May return spuriously. */
+void arch_idle_wait(volatile uint32_t *word, uint32_t mask);
+
 /* function to call in spinloops to idle */
 static void arch_spinloop_pause(void);
 /* function to call when an event happens that may trigger the exit from
@@ -40,4 +40,19 @@ zx_status_t arch_copy_from_user(void *dst, const void *src, size_t len);
  */
 zx_status_t arch_copy_to_user(void *dst, const void *src, size_t len);
 
+/*
+ * @brief Copy data from userspace into kernelspace, bypassing the cache
+ *
+ * Like arch_copy_from_user(), but a hint that dst will not be read again
+ * soon, for copies large enough to evict everything else from the cache.
+ * Architectures without non-temporal stores just copy normally.
+ *
+ * @param dst The destination buffer.
+ * @param src The source buffer.
+ * @param len The number of bytes to copy.
+ *
+ * @return ZX_OK on success
+ */
+zx_status_t arch_copy_from_user_nontemporal(void *dst, const void *src, size_t len);
+
 __END_CDECLS
@@ -19,6 +19,19 @@ static_assert(SMP_MAX_CPUS <= sizeof(cpu_mask_t) * CHAR_BIT, "");
 #define INVALID_CPU ((cpu_num_t)-1)
 #define CPU_MASK_ALL ((cpu_mask_t)-1)
 
+// relative cache topology distance between two cpus, smaller is closer
+enum {
+    MP_CPU_DISTANCE_SAME = 0,    // the same logical cpu
+    MP_CPU_DISTANCE_SMT = 1,     // hardware threads of the same core
+    MP_CPU_DISTANCE_CLUSTER = 2, // same package or cluster, sharing the last level cache
+    MP_CPU_DISTANCE_REMOTE = 3,  // different package or cluster
+};
+
+// scheduler domains are the sets of cpus at or closer than each distance
+#define SCHED_DOMAIN_SMT MP_CPU_DISTANCE_SMT
+#define SCHED_DOMAIN_LLC MP_CPU_DISTANCE_CLUSTER
+#define NUM_SCHED_DOMAINS (MP_CPU_DISTANCE_CLUSTER + 1)
+
 static inline bool is_valid_cpu_num(cpu_num_t num) {
     return (num < SMP_MAX_CPUS);
 }
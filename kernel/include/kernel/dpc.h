@@ -14,6 +14,11 @@ __BEGIN_CDECLS
 
 #define DPC_THREAD_PRIORITY HIGH_PRIORITY
 
+/* dpc priorities: queued high priority dpcs all run before any normal ones */
+#define DPC_PRIORITY_NORMAL 0
+#define DPC_PRIORITY_HIGH   1
+#define NUM_DPC_PRIORITIES  2
+
 struct dpc;
 typedef void (*dpc_func_t)(struct dpc*);
 
@@ -22,6 +27,12 @@ typedef struct dpc {
 
     dpc_func_t func;
     void* arg;
+
+    /* one of DPC_PRIORITY_*, looked at when the dpc is queued */
+    uint32_t priority;
+
+    /* when the dpc was last queued, for the latency stats */
+    zx_time_t queued;
 } dpc_t;
 
 #define DPC_INITIAL_VALUE                   \
@@ -29,6 +40,8 @@ typedef struct dpc {
         .node = LIST_INITIAL_CLEARED_VALUE, \
         .func = 0,                          \
         .arg = 0,                           \
+        .priority = DPC_PRIORITY_NORMAL,    \
+        .queued = 0,                        \
     }
 
 /* initializes dpc for the current cpu */
@@ -45,4 +58,9 @@ zx_status_t dpc_queue_thread_locked(dpc_t* dpc);
 /* Moves pending dpcs for the given CPU to the caller's CPU */
 void dpc_transition_off_cpu(uint cpu);
 
+/* dequeue a dpc, and if it has already started running wait for it to return */
+/* once this returns, the dpc may be freed so long as nothing queues it again */
+/* must not be called from a dpc, or with interrupts disabled */
+void dpc_cancel_sync(dpc_t* dpc);
+
 __END_CDECLS
@@ -0,0 +1,79 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+/* Statistics for contended kernel locks, kept in a small open addressed table
+ * keyed by lock address. The uncontended paths never touch it.
+ *
+ * Contended mutexes are always counted. Building with LOCK_PROFILING=1
+ * (ENABLE_LOCK_PROFILING=true) adds contended spinlocks, a wait time histogram,
+ * the call sites that waited, and a TAG_LOCK_CONTEND ktrace record per
+ * contended acquisition; without it none of that code is compiled in. */
+
+#ifndef LOCK_PROFILING
+#define LOCK_PROFILING 0
+#endif
+
+#define LOCKSTAT_KIND_MUTEX 1u
+#define LOCKSTAT_KIND_SPINLOCK 2u
+
+#define LOCKSTAT_TABLE_SIZE 256
+
+/* bucket 0 counts waits under 2^(LOCKSTAT_HISTOGRAM_SHIFT + 1) ns, bucket i
+ * counts waits in [2^(i + LOCKSTAT_HISTOGRAM_SHIFT), 2^(i + LOCKSTAT_HISTOGRAM_SHIFT + 1)),
+ * and the last bucket also takes everything longer */
+#define LOCKSTAT_HISTOGRAM_BUCKETS 16
+#define LOCKSTAT_HISTOGRAM_SHIFT 8
+
+#define LOCKSTAT_MAX_CALLERS 4
+
+typedef struct lockstat_entry {
+    uint64_t lock;          /* address of the lock, 0 if the slot is free */
+    uint32_t kind;          /* LOCKSTAT_KIND_* */
+    uint32_t reserved;
+    uint64_t contended;     /* acquisitions that missed the fast path */
+    uint64_t spin_acquired; /* contended acquisitions satisfied by spinning */
+    uint64_t blocked;       /* contended acquisitions that blocked */
+    uint64_t blocked_ns;    /* total time spent blocked */
+#if LOCK_PROFILING
+    uint64_t wait_ns;       /* total time from contention to acquisition */
+    uint64_t wait_histogram[LOCKSTAT_HISTOGRAM_BUCKETS];
+    uint64_t caller[LOCKSTAT_MAX_CALLERS]; /* first call sites to contend */
+    uint64_t caller_count[LOCKSTAT_MAX_CALLERS];
+    uint64_t other_callers; /* contended acquisitions from any other call site */
+    uint64_t spin_queued;   /* cpus found holding or waiting for a contended spinlock */
+#endif
+} lockstat_entry_t;
+
+/* Returns the entry for |lock|, claiming a slot if it has none yet. Locks that
+ * do not find a slot share a catch-all entry whose |lock| is 0. A slot stays
+ * assigned to an address after the lock is destroyed, so a reused address
+ * inherits the old counts. */
+lockstat_entry_t* lockstat_get(const void* lock, uint32_t kind);
+
+#if LOCK_PROFILING
+/* Accounts one contended acquisition of |e| by |caller| that waited |wait|. */
+void lockstat_record_wait(lockstat_entry_t* e, zx_duration_t wait, uintptr_t caller);
+#endif
+
+/* Copies out slot |index| of the table, where index LOCKSTAT_TABLE_SIZE is the
+ * catch-all entry. Returns false if the slot is unused. The copy is not atomic
+ * with respect to concurrent updates. */
+bool lockstat_read(size_t index, lockstat_entry_t* out);
+
+/* Clears all statistics. */
+void lockstat_reset(void);
+
+__END_CDECLS
@@ -7,6 +7,7 @@
 
 #include <arch/ops.h>
 #include <kernel/align.h>
+#include <kernel/dpc.h>
 #include <kernel/event.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
@@ -24,24 +25,66 @@ struct percpu {
     /* per cpu preemption timer */
     timer_t preempt_timer;
 
+    /* set while the current thread runs without an armed preemption timer because
+     * nothing else was queued on this cpu, and the time it started doing so.
+     */
+    bool tickless;
+    zx_time_t tickless_start;
+
     /* per cpu run queue and bitmap to indicate which queues are non empty */
     struct list_node run_queue[NUM_PRIORITIES];
     uint32_t run_queue_bitmap;
 
+    /* deadline class threads with budget remaining, sorted by absolute deadline.
+     * always run ahead of the priority run queues.
+     */
+    struct list_node deadline_queue;
+    /* sum of the utilization of the deadline threads admitted on this cpu */
+    uint32_t deadline_utilization;
+
+    /* number of threads sitting in the run queues, used by the load balancer */
+    uint32_t run_queue_len;
+
+    /* last time the periodic load balancer ran on this cpu */
+    zx_time_t last_balance;
+
+    /* scheduler domains: the cpus sharing each level of the cache topology with
+     * this one, indexed by SCHED_DOMAIN_*. filled in when the cpu becomes active.
+     */
+    cpu_mask_t sched_domain[NUM_SCHED_DOMAINS];
+
     /* thread/cpu level statistics */
     struct cpu_stats stats;
 
     /* per cpu idle thread */
     thread_t idle_thread;
 
+    /* the thread_t currently running on this cpu, as an integer. written by the
+     * scheduler, and read without the thread lock by contended mutex waiters
+     * deciding whether the holder is worth spinning on. */
+    volatile uint64_t running_thread;
+
+    /* idle wakeup word, see IDLE_STATE_*. kept on its own cache line since the
+     * idle thread sleeps in arch_idle_wait() until the line is written. */
+    volatile uint32_t idle_state __CPU_ALIGN;
+
+    /* set while a reschedule IPI sent to this cpu has not yet been taken */
+    volatile uint32_t reschedule_ipi_pending;
+
     /* kernel counters arena */
     uint64_t* counters;
 
-    /* dpc context */
-    list_node_t dpc_list;
+    /* dpc context, with a queue per DPC_PRIORITY_* */
+    list_node_t dpc_list[NUM_DPC_PRIORITIES];
     event_t dpc_event;
+    /* the dpc the dpc thread is running, NULL if none. set under the dpc lock */
+    dpc_t* dpc_running;
 } __CPU_ALIGN;
 
+/* percpu.idle_state bits */
+#define IDLE_STATE_POLLING (1u << 0) /* the idle thread is waiting on the word */
+#define IDLE_STATE_WAKE    (1u << 1) /* a reschedule has been asked of the idle thread */
+
 /* the kernel per-cpu structure */
 extern struct percpu percpu[SMP_MAX_CPUS];
 
@@ -38,4 +38,19 @@ bool sched_unblock_list(struct list_node* list) __WARN_UNUSED_RESULT;
 
 void sched_transition_off_cpu(cpu_num_t old_cpu);
 
+/* deadline utilization is a fixed point fraction of a cpu */
+#define SCHED_DEADLINE_UTILIZATION_ONE (1u << 20)
+
+/* move a thread into the deadline scheduling class, where it receives |capacity| worth
+ * of cpu time in every |period|, no later than |deadline| into the period. admission
+ * control picks a cpu in the thread's affinity mask with room for the reservation, or
+ * fails with ZX_ERR_NO_RESOURCES. a |capacity| of zero returns the thread to the
+ * priority based scheduler.
+ */
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                               zx_duration_t period);
+
+/* drop the deadline reservation of a thread, if it has one. thread lock must be held */
+void sched_clear_deadline(thread_t* t);
+
 __END_CDECLS
@@ -14,10 +14,20 @@
 
 __BEGIN_CDECLS
 
+#if LOCK_PROFILING
+/* slow path of spin_lock() that times the wait, see kernel/lockstat.h */
+void spin_lock_contended(spin_lock_t* lock) TA_ACQ(lock);
+#endif
+
 /* interrupts should already be disabled */
-static inline void spin_lock(spin_lock_t* lock) TA_ACQ(lock) {
+static inline void spin_lock(spin_lock_t* lock) TA_ACQ(lock) TA_NO_THREAD_SAFETY_ANALYSIS {
     DEBUG_ASSERT(arch_ints_disabled());
+#if LOCK_PROFILING
+    if (unlikely(arch_spin_trylock(lock)))
+        spin_lock_contended(lock);
+#else
     arch_spin_lock(lock);
+#endif
 }
 
 /* Returns 0 on success, non-0 on failure */
@@ -38,6 +48,11 @@ static inline bool spin_lock_held(spin_lock_t* lock) {
     return arch_spin_lock_held(lock);
 }
 
+/* how many cpus hold or are waiting for the spin lock */
+static inline uint spin_lock_queue_len(spin_lock_t* lock) {
+    return arch_spin_lock_queue_len(lock);
+}
+
 /* which cpu currently holds the spin lock */
 /* returns UINT_MAX if not held */
 static inline uint spin_lock_holder_cpu(spin_lock_t* lock) {
@@ -20,16 +20,32 @@ struct cpu_stats {
     ulong preempts;
     ulong yields;
 
+    /* load balancer migrations */
+    ulong balance_steals; /* threads pulled onto this cpu while it was going idle */
+    ulong balance_pushes; /* threads pushed from this cpu to an idle cpu */
+    ulong direct_switches; /* wakees queued to run in place of a waker about to block */
+
     /* cpu level interrupts and exceptions */
     ulong interrupts;  /* hardware interrupts, minus timer interrupts or inter-processor interrupts */
     ulong timer_ints;  /* timer interrupts */
     ulong timers;      /* timer callbacks */
+    ulong timers_coalesced; /* timers folded into the deadline of an already queued timer */
+    ulong ticks_skipped;    /* preemption ticks not taken while a thread ran alone */
     ulong perf_ints;   /* performance monitor interrupts */
     ulong syscalls;
 
     /* inter-processor interrupts */
     ulong reschedule_ipis;
     ulong generic_ipis;
+    ulong reschedule_ipis_sent;       /* sent from this cpu */
+    ulong reschedule_ipis_suppressed; /* not sent, the target already had one pending */
+    ulong idle_wakes;                 /* idle cpus woken from this cpu by a store */
+
+    /* deferred procedure calls */
+    ulong dpcs;
+    ulong dpc_batches;          /* wakeups of the dpc thread */
+    zx_duration_t dpc_latency;  /* total time from queueing to running */
+    zx_duration_t dpc_max_latency;
 };
 
 __END_CDECLS
@@ -41,3 +57,8 @@ __END_CDECLS
     do {                                                                           \
         __atomic_fetch_add(&get_local_percpu()->stats.name, 1u, __ATOMIC_RELAXED); \
     } while (0)
+
+#define CPU_STATS_ADD(name, n)                                                       \
+    do {                                                                             \
+        __atomic_fetch_add(&get_local_percpu()->stats.name, (n), __ATOMIC_RELAXED); \
+    } while (0)
@@ -13,6 +13,7 @@
 #include <debug.h>
 #include <kernel/cpu.h>
 #include <kernel/spinlock.h>
+#include <kernel/timer.h>
 #include <kernel/wait.h>
 #include <list.h>
 #include <sys/types.h>
@@ -59,6 +60,7 @@ typedef void (*thread_tls_callback_t)(void* tls_value);
 #define THREAD_FLAG_REAL_TIME                (1 << 3)
 #define THREAD_FLAG_IDLE                     (1 << 4)
 #define THREAD_FLAG_DEBUG_STACK_BOUNDS_CHECK (1 << 5)
+#define THREAD_FLAG_DEADLINE                 (1 << 6)
 
 #define THREAD_SIGNAL_KILL                   (1 << 0)
 #define THREAD_SIGNAL_SUSPEND                (1 << 1)
@@ -78,6 +80,37 @@ typedef void (*thread_tls_callback_t)(void* tls_value);
 
 struct vmm_aspace;
 
+/* deadline scheduling parameters and state, only meaningful while THREAD_FLAG_DEADLINE
+ * is set. every period the thread is given capacity worth of cpu time, which it is
+ * guaranteed to receive within deadline of the start of the period.
+ */
+struct thread_deadline {
+    zx_duration_t capacity;
+    zx_duration_t deadline;
+    zx_duration_t period;
+
+    /* fraction of the admitting cpu reserved by capacity / deadline */
+    uint32_t utilization;
+    /* cpu the reservation was admitted on */
+    cpu_num_t cpu;
+
+    /* state of the current period */
+    zx_time_t abs_deadline;
+    zx_time_t period_end;
+    zx_duration_t budget;
+
+    /* queued in the cpu's deadline queue */
+    bool queued;
+    /* runnable, but out of budget until replenish_timer fires */
+    bool throttled;
+    timer_t replenish_timer;
+
+    /* number of periods that ended before the capacity was delivered. not reset when
+     * the thread leaves the deadline class.
+     */
+    uint64_t misses;
+};
+
 typedef struct thread {
     int magic;
     struct list_node thread_list_node;
@@ -95,6 +128,36 @@ typedef struct thread {
      * left the scheduler. */
     zx_duration_t runtime_ns;
 
+    /* Pages this thread has had decompressed out of VMOs' compressed page
+     * stores, and the time spent doing so.  Page faults look at the change
+     * to attribute decompression to the faulting address space. */
+    uint64_t vm_decompressed_pages;
+    zx_duration_t vm_decompress_ns;
+
+    /* When the thread last went into a run queue, or 0 if it is not waiting
+     * in one, and the total time it has spent waiting there. */
+    zx_time_t ready_since;
+    zx_duration_t queue_ns;
+
+    /* Part of runtime_ns spent handling the thread's syscalls and the page
+     * faults it took in user mode. */
+    zx_duration_t kernel_ns;
+
+    /* Times the thread was switched out while still runnable, other than by
+     * yielding.  yielding tells sched_resched_internal() about the latter. */
+    uint64_t preemptions;
+    bool yielding;
+
+    /* Set while the thread wakes threads it is about to block waiting on,
+     * so the scheduler can run one of them here in its place.  See
+     * AutoSyncWakeup. */
+    bool sync_wakeup;
+
+    /* Page faults this thread has taken and the time spent handling them,
+     * including any time spent blocked. */
+    uint64_t page_faults;
+    zx_duration_t page_fault_ns;
+
     /* priority: in the range of [MIN_PRIORITY, MAX_PRIORITY], from low to high.
      * base_priority is set at creation time, and can be tuned with thread_set_priority().
      * priority_boost is a signed value that is moved around within a range by the scheduler.
@@ -108,6 +171,9 @@ typedef struct thread {
     int priority_boost;
     int inheirited_priority;
 
+    /* deadline scheduling class, see sched_set_deadline() */
+    struct thread_deadline deadline;
+
     /* current cpu the thread is either running on or in the ready queue, undefined otherwise */
     cpu_num_t curr_cpu;
     cpu_num_t last_cpu;      /* last cpu the thread ran on, INVALID_CPU if it's never run */
@@ -128,6 +194,10 @@ typedef struct thread {
     /* number of mutexes we currently hold */
     int mutexes_held;
 
+    /* set while a thread blocked in zx_futex_wait_owned() lends us its priority;
+     * keeps the inheirited priority in place when mutexes_held drops to zero */
+    bool futex_priority_held;
+
     /* pointer to the kernel address space this thread is associated with */
     struct vmm_aspace* aspace;
 
@@ -269,6 +339,24 @@ zx_status_t thread_sleep_relative(zx_duration_t delay);
 /* return the number of nanoseconds a thread has been running for */
 zx_duration_t thread_runtime(const thread_t* t);
 
+/* a snapshot of a thread's time accounting, see thread_get_runtime_stats() */
+struct thread_runtime_stats {
+    zx_duration_t runtime_ns;
+    zx_duration_t queue_ns;
+    zx_duration_t kernel_ns;
+    uint64_t preemptions;
+    uint64_t page_faults;
+    zx_duration_t page_fault_ns;
+};
+
+/* fill in |stats| for a thread, counting the time it has been running or
+ * waiting to run since it was last scheduled */
+void thread_get_runtime_stats(const thread_t* t, struct thread_runtime_stats* stats);
+
+/* return the number of nanoseconds the current thread has been running for.
+ * cheaper than thread_runtime(), since it needs no lock */
+zx_duration_t thread_current_runtime(void);
+
 /* deliver a kill signal to a thread */
 void thread_kill(thread_t* t);
 
@@ -296,6 +384,10 @@ static inline bool thread_is_realtime(thread_t* t) {
     return (t->flags & THREAD_FLAG_REAL_TIME) && t->base_priority > DEFAULT_PRIORITY;
 }
 
+static inline bool thread_is_deadline(const thread_t* t) {
+    return !!(t->flags & THREAD_FLAG_DEADLINE);
+}
+
 static inline bool thread_is_idle(thread_t* t) {
     return !!(t->flags & THREAD_FLAG_IDLE);
 }
@@ -309,7 +401,18 @@ static inline bool thread_is_real_time_or_idle(thread_t* t) {
 thread_t* get_current_thread(void);
 void set_current_thread(thread_t*);
 
-/* scheduler lock */
+/* scheduler lock
+ *
+ * Guards the run queues, every wait queue (and so events, mutexes and
+ * futex wakeups), thread state transitions and the per-cpu preemption
+ * timers. It is taken with interrupts disabled and is always the innermost
+ * lock: nothing else may be acquired while holding it except the timer
+ * queue lock and per-cpu spinlocks that never take it themselves. Mutexes,
+ * futex bucket locks and dispatcher locks are all taken before it.
+ *
+ * Paths that only observe state, such as waiting on or signaling an event
+ * that is already signaled, should test first and skip it.
+ */
 extern spin_lock_t thread_lock;
 
 #define THREAD_LOCK(state)         \
@@ -416,4 +519,27 @@ private:
     spin_lock_saved_state_t state_;
 };
 
+// Marks the wakeups made in its scope as ones the current thread is about
+// to block waiting on, as when a request is written to a channel before
+// waiting for the reply.  The scheduler may then queue a woken thread to run
+// next on this cpu, switching to it directly when the current thread blocks,
+// rather than waking another cpu to run it while this one goes idle.
+class AutoSyncWakeup {
+public:
+    explicit AutoSyncWakeup(bool enable = true)
+        : thread_(get_current_thread()), prev_(thread_->sync_wakeup) {
+        thread_->sync_wakeup = prev_ || enable;
+    }
+
+    ~AutoSyncWakeup() {
+        thread_->sync_wakeup = prev_;
+    }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(AutoSyncWakeup);
+
+private:
+    thread_t* const thread_;
+    const bool prev_;
+};
+
 #endif // __cplusplus
@@ -11,6 +11,7 @@
 #include <kernel/percpu.h>
 
 #include <zircon/compiler.h>
+#include <zircon/types.h>
 
 __BEGIN_CDECLS
 
@@ -20,8 +21,9 @@ __BEGIN_CDECLS
 //   - after N seconds how many outstanding <x> things are allocated?
 //   - up to this point has <Y> ever happened?
 //
-// Currently the only query interface to the counters is the console
-// k counters command. Issue 'k counters help' to learn what it can do.
+// The counters can be queried with the console k counters command; issue
+// 'k counters help' to learn what it can do. They are also published to
+// userspace as VMO files in /boot/kernel/counters, see <zircon/kcounters.h>.
 //
 // Kernel counters public API:
 // 1- define a new counter.
@@ -94,3 +96,16 @@ static inline void kcounter_add(const struct k_counter_desc* var,
 }
 
 __END_CDECLS
+
+#ifdef __cplusplus
+
+#include <fbl/ref_ptr.h>
+
+class VmObject;
+
+// Creates the VMOs that publish the counters to userspace: the descriptors,
+// and the arena itself, whose pages are shared with the kernel.
+zx_status_t kcounters_to_vmos(fbl::RefPtr<VmObject>* desc_vmo,
+                              fbl::RefPtr<VmObject>* arena_vmo);
+
+#endif // __cplusplus
@@ -60,8 +60,17 @@ static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint
 } while (0)
 
 void ktrace_name(uint32_t tag, uint32_t id, uint32_t arg, const char* name);
+// Whether to trace this occurrence of a frequent event, such as a syscall,
+// which may be sampled (see KTRACE_ACTION_SET_SAMPLING).  Events with
+// begin and end records should use one answer for both.  Always false if
+// |tag|'s group is not being traced, so callers can skip the records.
+bool ktrace_sample(uint32_t tag);
 int ktrace_read_user(void* ptr, uint32_t off, uint32_t len);
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr);
+// Record that boot has reached the phase |name|, a string that must outlive
+// the trace.  Phases reached before tracing is set up are recorded with
+// their original timestamps once it is.
+void ktrace_boot_phase(const char* name);
 #else
 static inline void* ktrace_open(uint32_t tag) { return NULL; }
 static inline void ktrace_tiny(uint32_t tag, uint32_t arg) {}
@@ -69,6 +78,7 @@ static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint
 static inline void ktrace_probe0(const char* name) {}
 static inline void ktrace_probe2(const char* name, uint32_t arg0, uint32_t arg1) {}
 static inline void ktrace_name(uint32_t tag, uint32_t id, uint32_t arg, const char* name) {}
+static inline bool ktrace_sample(uint32_t tag) { return false; }
 static inline ssize_t ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
     if ((len == 0) && (off == 0)) {
         return 0;
@@ -79,6 +89,7 @@ static inline ssize_t ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
 static inline zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
     return ZX_ERR_NOT_SUPPORTED;
 }
+static inline void ktrace_boot_phase(const char* name) {}
 #endif
 
 #define KTRACE_DEFAULT_BUFSIZE 32 // MB
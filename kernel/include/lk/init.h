@@ -43,10 +43,18 @@ enum lk_init_flags {
     LK_INIT_FLAG_ALL_CPUS        = LK_INIT_FLAG_PRIMARY_CPU | LK_INIT_FLAG_SECONDARY_CPUS,
     LK_INIT_FLAG_CPU_SUSPEND     = 0x4,
     LK_INIT_FLAG_CPU_RESUME      = 0x8,
+    // The hook can run after boot rather than at its level: it is called on
+    // a worker thread, in level order with the other deferred hooks, once
+    // userboot has started.  Honored for primary cpu hooks at
+    // LK_INIT_LEVEL_THREADING and above.
+    LK_INIT_FLAG_DEFERRED        = 0x10,
 };
 
 void lk_init_level(enum lk_init_flags flags, uint start_level, uint stop_level);
 
+// Starts the worker thread which runs the deferred hooks.
+void lk_init_deferred(void);
+
 static inline void lk_primary_cpu_init_level(uint start_level, uint stop_level)
 {
     lk_init_level(LK_INIT_FLAG_PRIMARY_CPU, start_level, stop_level);
@@ -76,4 +84,8 @@ struct lk_init_struct {
 #define LK_INIT_HOOK(_name, _hook, _level) \
     LK_INIT_HOOK_FLAGS(_name, _hook, _level, LK_INIT_FLAG_PRIMARY_CPU)
 
+#define LK_INIT_HOOK_DEFERRED(_name, _hook, _level) \
+    LK_INIT_HOOK_FLAGS(_name, _hook, _level,      \
+                       LK_INIT_FLAG_PRIMARY_CPU | LK_INIT_FLAG_DEFERRED)
+
 __END_CDECLS
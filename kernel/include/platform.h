@@ -45,6 +45,12 @@ uint64_t ticks_per_second(void);
 /* high-precision timer current_ticks */
 uint64_t current_ticks(void);
 
+/* If current_time() is the counter that usermode reads for zx_ticks_get()
+ * multiplied by a constant, returns true and sets |ns_per_tick| to that
+ * constant.  The vDSO uses it to compute current_time() itself. */
+struct fp_32_64;
+bool platform_usermode_ticks_to_time(struct fp_32_64* ns_per_tick);
+
 /* super early platform initialization, before almost everything */
 void platform_early_init(void);
 
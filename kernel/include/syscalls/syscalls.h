@@ -5,6 +5,13 @@
 #pragma once
 
 #include <sys/types.h>
+#include <zircon/syscalls/object.h>
+
+// Building with SYSCALL_PROFILING=1 (ENABLE_SYSCALL_PROFILING=true) times
+// every system call; without it none of that code is compiled in.
+#ifndef SYSCALL_PROFILING
+#define SYSCALL_PROFILING 0
+#endif
 
 struct syscall_result {
     // The assembler relies on the fact that the ABI will return this in
@@ -15,3 +22,10 @@ struct syscall_result {
 };
 
 struct syscall_result unknown_syscall(uint64_t syscall_num, uint64_t ip);
+
+#if SYSCALL_PROFILING
+// Copies out the statistics for system call |num|.  Returns false if there
+// is no such system call or it has not been called.  The copy is not atomic
+// with respect to concurrent calls.
+bool syscall_stats_read(uint32_t num, zx_info_syscall_stats_t* out);
+#endif
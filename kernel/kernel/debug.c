@@ -125,11 +125,25 @@ static int cmd_threadstats(int argc, const cmd_args* argv, uint32_t flags) {
                current_time() - percpu[i].stats.idle_time);
         printf("\treschedules: %lu\n", percpu[i].stats.reschedules);
         printf("\treschedule_ipis: %lu\n", percpu[i].stats.reschedule_ipis);
+        printf("\treschedule_ipis_sent: %lu\n", percpu[i].stats.reschedule_ipis_sent);
+        printf("\treschedule_ipis_suppressed: %lu\n",
+               percpu[i].stats.reschedule_ipis_suppressed);
+        printf("\tidle_wakes: %lu\n", percpu[i].stats.idle_wakes);
         printf("\tcontext_switches: %lu\n", percpu[i].stats.context_switches);
         printf("\tpreempts: %lu\n", percpu[i].stats.preempts);
         printf("\tyields: %lu\n", percpu[i].stats.yields);
+        printf("\tbalance steals: %lu\n", percpu[i].stats.balance_steals);
+        printf("\tbalance pushes: %lu\n", percpu[i].stats.balance_pushes);
+        printf("\tdirect switches: %lu\n", percpu[i].stats.direct_switches);
         printf("\ttimer interrupts: %lu\n", percpu[i].stats.timer_ints);
         printf("\ttimers: %lu\n", percpu[i].stats.timers);
+        printf("\ttimers coalesced: %lu\n", percpu[i].stats.timers_coalesced);
+        printf("\tticks skipped: %lu\n", percpu[i].stats.ticks_skipped);
+        printf("\tdpcs: %lu\n", percpu[i].stats.dpcs);
+        printf("\tdpc batches: %lu\n", percpu[i].stats.dpc_batches);
+        printf("\tdpc average latency: %" PRIu64 "\n",
+               percpu[i].stats.dpcs ? percpu[i].stats.dpc_latency / percpu[i].stats.dpcs : 0);
+        printf("\tdpc max latency: %" PRIu64 "\n", percpu[i].stats.dpc_max_latency);
     }
 
     return 0;
@@ -13,10 +13,30 @@
 #include <kernel/event.h>
 #include <kernel/percpu.h>
 #include <kernel/spinlock.h>
+#include <kernel/thread.h>
+#include <platform.h>
 #include <lk/init.h>
 
 static spin_lock_t dpc_lock = SPIN_LOCK_INITIAL_VALUE;
 
+/* how long the dpc thread runs dpcs back to back before yielding */
+#define DPC_BATCH_BUDGET ZX_USEC(500)
+
+/* queues the dpc on the current cpu, returning whether the queues were empty */
+static bool dpc_enqueue_locked(struct percpu* cpu, dpc_t* dpc) {
+    DEBUG_ASSERT(dpc->priority < NUM_DPC_PRIORITIES);
+
+    bool was_empty = true;
+    for (uint i = 0; i < NUM_DPC_PRIORITIES; i++) {
+        if (!list_is_empty(&cpu->dpc_list[i]))
+            was_empty = false;
+    }
+
+    dpc->queued = current_time();
+    list_add_tail(&cpu->dpc_list[dpc->priority], &dpc->node);
+    return was_empty;
+}
+
 zx_status_t dpc_queue(dpc_t* dpc, bool reschedule) {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
@@ -32,12 +52,14 @@ zx_status_t dpc_queue(dpc_t* dpc, bool reschedule) {
 
     struct percpu* cpu = get_local_percpu();
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&cpu->dpc_list, &dpc->node);
+    // put the dpc at the tail of its queue. the worker drains the queues
+    // before unsignaling the event, so only the first dpc needs to wake it.
+    bool signal = dpc_enqueue_locked(cpu, dpc);
 
     spin_unlock_irqrestore(&dpc_lock, state);
 
-    event_signal(&cpu->dpc_event, reschedule);
+    if (signal)
+        event_signal(&cpu->dpc_event, reschedule);
 
     return ZX_OK;
 }
@@ -56,9 +78,9 @@ zx_status_t dpc_queue_thread_locked(dpc_t* dpc) {
 
     struct percpu* cpu = get_local_percpu();
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&cpu->dpc_list, &dpc->node);
-    event_signal_thread_locked(&cpu->dpc_event);
+    // put the dpc at the tail of its queue and signal the worker if idle
+    if (dpc_enqueue_locked(cpu, dpc))
+        event_signal_thread_locked(&cpu->dpc_event);
 
     spin_unlock(&dpc_lock);
 
@@ -74,18 +96,48 @@ void dpc_transition_off_cpu(uint cpu_id) {
     uint cur_cpu = arch_curr_cpu_num();
     DEBUG_ASSERT(cpu_id != cur_cpu);
 
-    list_node_t* src_list = &percpu[cpu_id].dpc_list;
-    list_node_t* dst_list = &percpu[cur_cpu].dpc_list;
+    for (uint i = 0; i < NUM_DPC_PRIORITIES; i++) {
+        list_node_t* src_list = &percpu[cpu_id].dpc_list[i];
+        list_node_t* dst_list = &percpu[cur_cpu].dpc_list[i];
 
-    dpc_t* dpc;
-    while ((dpc = list_remove_head_type(src_list, dpc_t, node))) {
-        list_add_tail(dst_list, &dpc->node);
+        dpc_t* dpc;
+        while ((dpc = list_remove_head_type(src_list, dpc_t, node))) {
+            list_add_tail(dst_list, &dpc->node);
+        }
     }
     spin_unlock_irqrestore(&dpc_lock, state);
 
     event_signal(&percpu[cur_cpu].dpc_event, false);
 }
 
+void dpc_cancel_sync(dpc_t* dpc) {
+    DEBUG_ASSERT(dpc);
+    DEBUG_ASSERT(!arch_ints_disabled());
+
+    for (;;) {
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&dpc_lock, state);
+
+        if (list_in_list(&dpc->node))
+            list_delete(&dpc->node);
+
+        bool running = false;
+        for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+            if (__atomic_load_n(&percpu[i].dpc_running, __ATOMIC_ACQUIRE) == dpc)
+                running = true;
+        }
+
+        spin_unlock_irqrestore(&dpc_lock, state);
+
+        if (!running)
+            return;
+
+        // the dpc thread took it off the queue before we could; wait for
+        // it to return.
+        thread_yield();
+    }
+}
+
 static int dpc_thread(void* arg) {
     dpc_t dpc_local;
 
@@ -94,7 +146,6 @@ static int dpc_thread(void* arg) {
 
     struct percpu* cpu = get_local_percpu();
     event_t* event = &cpu->dpc_event;
-    list_node_t* list = &cpu->dpc_list;
 
     arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
@@ -103,24 +154,47 @@ static int dpc_thread(void* arg) {
         __UNUSED zx_status_t err = event_wait(event);
         DEBUG_ASSERT(err == ZX_OK);
 
-        spin_lock_irqsave(&dpc_lock, state);
+        cpu->stats.dpc_batches++;
+        zx_time_t batch_start = current_time();
 
-        // pop a dpc off the list, make a local copy.
-        dpc_t* dpc = list_remove_head_type(list, dpc_t, node);
+        // run dpcs, high priority ones first, until the queues are empty
+        for (;;) {
+            spin_lock_irqsave(&dpc_lock, state);
 
-        // if the list is now empty, unsignal the event so we block until it is
-        if (!dpc) {
-            event_unsignal(event);
-            dpc_local.func = NULL;
-        } else {
-           dpc_local = *dpc;
-        }
+            // pop a dpc off the list, make a local copy.
+            dpc_t* dpc = NULL;
+            for (int i = NUM_DPC_PRIORITIES - 1; i >= 0 && !dpc; i--)
+                dpc = list_remove_head_type(&cpu->dpc_list[i], dpc_t, node);
 
-        spin_unlock_irqrestore(&dpc_lock, state);
+            // if the list is now empty, unsignal the event so we block until it is
+            if (!dpc) {
+                event_unsignal(event);
+                spin_unlock_irqrestore(&dpc_lock, state);
+                break;
+            }
+
+            dpc_local = *dpc;
+            __atomic_store_n(&cpu->dpc_running, dpc, __ATOMIC_RELAXED);
+
+            spin_unlock_irqrestore(&dpc_lock, state);
+
+            zx_duration_t latency = current_time() - dpc_local.queued;
+            cpu->stats.dpcs++;
+            cpu->stats.dpc_latency += latency;
+            if (latency > cpu->stats.dpc_max_latency)
+                cpu->stats.dpc_max_latency = latency;
 
-        // call the dpc
-        if (dpc_local.func)
+            // call the dpc
             dpc_local.func(&dpc_local);
+
+            __atomic_store_n(&cpu->dpc_running, NULL, __ATOMIC_RELEASE);
+
+            // let other threads at this priority in if the batch runs long
+            if (current_time() - batch_start >= DPC_BATCH_BUDGET) {
+                thread_yield();
+                batch_start = current_time();
+            }
+        }
     }
 
     return 0;
@@ -135,7 +209,9 @@ void dpc_init_for_cpu(void) {
         return;
     }
 
-    list_initialize(&cpu->dpc_list);
+    for (uint i = 0; i < NUM_DPC_PRIORITIES; i++)
+        list_initialize(&cpu->dpc_list[i]);
+    cpu->dpc_running = NULL;
     event_init(&cpu->dpc_event, false, 0);
 
     char name[10];
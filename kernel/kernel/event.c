@@ -70,6 +70,11 @@ static zx_status_t event_wait_worker(event_t* e, zx_time_t deadline,
     DEBUG_ASSERT(e->magic == EVENT_MAGIC);
     DEBUG_ASSERT(!arch_in_int_handler());
 
+    /* a signaled event without autounsignal lets everyone through, so there
+     * is no state to change and no need for the thread lock */
+    if (!(e->flags & EVENT_FLAG_AUTOUNSIGNAL) && __atomic_load_n(&e->signaled, __ATOMIC_ACQUIRE))
+        return ZX_OK;
+
     THREAD_LOCK(state);
 
     current_thread->interruptable = interruptable;
@@ -138,6 +143,12 @@ static int event_signal_internal(event_t* e, bool reschedule, zx_status_t wait_r
                                  bool thread_lock_held) TA_NO_THREAD_SAFETY_ANALYSIS {
     DEBUG_ASSERT(e->magic == EVENT_MAGIC);
 
+    // Signaling an event that is already signaled and stays that way wakes
+    // nobody, since no thread can be waiting on it. Racing with an unsignal
+    // is no different to having signaled just before it.
+    if (!(e->flags & EVENT_FLAG_AUTOUNSIGNAL) && __atomic_load_n(&e->signaled, __ATOMIC_ACQUIRE))
+        return 0;
+
     // conditionally acquire/release the thread lock
     // NOTE: using the manual spinlock grab/release instead of THREAD_LOCK because
     // the state variable needs to exit in either path.
@@ -160,7 +171,7 @@ static int event_signal_internal(event_t* e, bool reschedule, zx_status_t wait_r
             }
         } else {
             /* release all threads and remain signaled */
-            e->signaled = true;
+            __atomic_store_n(&e->signaled, true, __ATOMIC_RELEASE);
             wake_count = wait_queue_wake_all(&e->wait, reschedule, wait_result);
         }
     }
@@ -239,7 +250,7 @@ int event_signal_thread_locked(event_t* e) {
 zx_status_t event_unsignal(event_t* e) {
     DEBUG_ASSERT(e->magic == EVENT_MAGIC);
 
-    e->signaled = false;
+    __atomic_store_n(&e->signaled, false, __ATOMIC_RELAXED);
 
     return ZX_OK;
 }
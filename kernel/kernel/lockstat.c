@@ -0,0 +1,189 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/lockstat.h>
+
+#include <debug.h>
+#include <inttypes.h>
+#include <kernel/atomic.h>
+#include <kernel/spinlock.h>
+#include <lib/ktrace.h>
+#include <platform.h>
+#include <string.h>
+
+#define LOCKSTAT_MAX_PROBE 8
+
+static lockstat_entry_t lockstat_table[LOCKSTAT_TABLE_SIZE];
+/* catches locks that did not find a slot in the table */
+static lockstat_entry_t lockstat_overflow;
+
+lockstat_entry_t* lockstat_get(const void* lock, uint32_t kind) {
+    uint64_t key = (uintptr_t)lock;
+    uint64_t hash = (key >> 3) * 0x9e3779b97f4a7c15ull;
+    for (uint i = 0; i < LOCKSTAT_MAX_PROBE; i++) {
+        lockstat_entry_t* e = &lockstat_table[(hash + i) % LOCKSTAT_TABLE_SIZE];
+        uint64_t cur = atomic_load_u64_relaxed(&e->lock);
+        if (cur == key)
+            return e;
+        if (cur == 0) {
+            if (atomic_cmpxchg_u64(&e->lock, &cur, key)) {
+                e->kind = kind;
+                return e;
+            }
+            if (cur == key)
+                return e;
+        }
+    }
+    return &lockstat_overflow;
+}
+
+#if LOCK_PROFILING
+
+static uint lockstat_histogram_bucket(zx_duration_t wait) {
+    uint64_t scaled = (uint64_t)wait >> (LOCKSTAT_HISTOGRAM_SHIFT + 1);
+    if (scaled == 0)
+        return 0;
+    uint bucket = (uint)(64 - __builtin_clzll(scaled));
+    return bucket < LOCKSTAT_HISTOGRAM_BUCKETS ? bucket : LOCKSTAT_HISTOGRAM_BUCKETS - 1;
+}
+
+void lockstat_record_wait(lockstat_entry_t* e, zx_duration_t wait, uintptr_t caller) {
+    atomic_add_u64_relaxed(&e->wait_ns, wait);
+    atomic_add_u64_relaxed(&e->wait_histogram[lockstat_histogram_bucket(wait)], 1);
+
+    // the first few call sites to contend get a slot of their own, the rest
+    // are lumped together
+    uint i;
+    for (i = 0; i < LOCKSTAT_MAX_CALLERS; i++) {
+        uint64_t cur = atomic_load_u64_relaxed(&e->caller[i]);
+        if (cur == 0 && atomic_cmpxchg_u64(&e->caller[i], &cur, caller))
+            cur = caller;
+        if (cur == caller) {
+            atomic_add_u64_relaxed(&e->caller_count[i], 1);
+            break;
+        }
+    }
+    if (i == LOCKSTAT_MAX_CALLERS)
+        atomic_add_u64_relaxed(&e->other_callers, 1);
+
+    ktrace(TAG_LOCK_CONTEND, (uint32_t)e->lock, (uint32_t)caller,
+           wait > UINT32_MAX ? UINT32_MAX : (uint32_t)wait, e->kind);
+}
+
+/* out of line slow path of spin_lock(), reached when the trylock fails */
+void spin_lock_contended(spin_lock_t* lock) TA_NO_THREAD_SAFETY_ANALYSIS {
+    uintptr_t caller = (uintptr_t)__builtin_return_address(0);
+    zx_time_t start = current_time();
+    uint queued = spin_lock_queue_len(lock);
+    arch_spin_lock(lock);
+    zx_duration_t wait = current_time() - start;
+
+    lockstat_entry_t* e = lockstat_get(lock, LOCKSTAT_KIND_SPINLOCK);
+    atomic_add_u64_relaxed(&e->contended, 1);
+    atomic_add_u64_relaxed(&e->spin_acquired, 1);
+    atomic_add_u64_relaxed(&e->spin_queued, queued);
+    lockstat_record_wait(e, wait, caller);
+}
+
+#endif // LOCK_PROFILING
+
+bool lockstat_read(size_t index, lockstat_entry_t* out) {
+    if (index > LOCKSTAT_TABLE_SIZE)
+        return false;
+    const lockstat_entry_t* e =
+        index == LOCKSTAT_TABLE_SIZE ? &lockstat_overflow : &lockstat_table[index];
+    memcpy(out, e, sizeof(*out));
+    return out->lock != 0 || out->contended != 0;
+}
+
+void lockstat_reset(void) {
+    memset(lockstat_table, 0, sizeof(lockstat_table));
+    memset(&lockstat_overflow, 0, sizeof(lockstat_overflow));
+}
+
+#if WITH_LIB_CONSOLE
+#include <lib/console.h>
+
+static const char* lockstat_kind_name(uint32_t kind) {
+    switch (kind) {
+    case LOCKSTAT_KIND_MUTEX:
+        return "mutex";
+    case LOCKSTAT_KIND_SPINLOCK:
+        return "spin";
+    default:
+        return "?";
+    }
+}
+
+static zx_duration_t lockstat_wait_ns(const lockstat_entry_t* e) {
+#if LOCK_PROFILING
+    return e->wait_ns;
+#else
+    return e->blocked_ns;
+#endif
+}
+
+static void lockstat_print(const lockstat_entry_t* e) {
+    printf("%#18" PRIx64 " %5s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %14" PRIu64 "\n",
+           e->lock, lockstat_kind_name(e->kind), e->contended, e->spin_acquired,
+           e->blocked, lockstat_wait_ns(e) / 1000);
+#if LOCK_PROFILING
+    for (uint i = 0; i < LOCKSTAT_MAX_CALLERS && e->caller[i] != 0; i++)
+        printf("%25s caller %#" PRIx64 ": %" PRIu64 "\n", "", e->caller[i], e->caller_count[i]);
+    if (e->other_callers != 0)
+        printf("%25s other callers: %" PRIu64 "\n", "", e->other_callers);
+    if (e->kind == LOCKSTAT_KIND_SPINLOCK && e->contended != 0)
+        printf("%25s queue length: %" PRIu64 ".%02" PRIu64 "\n", "",
+               e->spin_queued / e->contended, e->spin_queued * 100 / e->contended % 100);
+#endif
+}
+
+static int cmd_lockstat(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc > 1 && !strcmp(argv[1].str, "reset")) {
+        lockstat_reset();
+        return 0;
+    }
+    if (argc > 1) {
+        printf("usage:\n");
+        printf("%s         : show contended locks, most time waited first\n", argv[0].str);
+        printf("%s reset   : clear the statistics\n", argv[0].str);
+        return -1;
+    }
+
+    printf("%18s %5s %10s %10s %10s %14s\n", "lock", "kind", "contended", "spun", "blocked",
+           LOCK_PROFILING ? "waited usec" : "blocked usec");
+
+    // selection sort by wait time on a snapshot, so that the table can keep
+    // changing underneath us
+    static lockstat_entry_t snapshot[LOCKSTAT_TABLE_SIZE];
+    memcpy(snapshot, lockstat_table, sizeof(snapshot));
+    for (uint i = 0; i < LOCKSTAT_TABLE_SIZE; i++) {
+        uint best = i;
+        for (uint j = i + 1; j < LOCKSTAT_TABLE_SIZE; j++) {
+            if (lockstat_wait_ns(&snapshot[j]) > lockstat_wait_ns(&snapshot[best]))
+                best = j;
+        }
+        if (best != i) {
+            lockstat_entry_t tmp = snapshot[i];
+            snapshot[i] = snapshot[best];
+            snapshot[best] = tmp;
+        }
+        if (snapshot[i].lock == 0)
+            continue;
+        lockstat_print(&snapshot[i]);
+    }
+    if (lockstat_overflow.contended != 0) {
+        printf("(untracked)\n");
+        lockstat_print(&lockstat_overflow);
+    }
+    return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("lockstat", "contended kernel lock statistics", &cmd_lockstat)
+STATIC_COMMAND_END(lockstat);
+
+#endif // WITH_LIB_CONSOLE
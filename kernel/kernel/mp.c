@@ -47,6 +47,14 @@ void mp_init(void) {
     }
 }
 
+/* Asks the idle thread of |cpu| to reschedule. Returns true if it is waiting
+ * in arch_idle_wait() and the store alone will wake it, false if it needs an
+ * IPI. Pairs with the loop in idle_thread_routine(). */
+static bool mp_wake_idle_cpu(cpu_num_t cpu) {
+    uint32_t old = __atomic_fetch_or(&percpu[cpu].idle_state, IDLE_STATE_WAKE, __ATOMIC_SEQ_CST);
+    return old & IDLE_STATE_POLLING;
+}
+
 void mp_reschedule(mp_ipi_target_t target, cpu_mask_t mask, uint flags) {
     const cpu_num_t local_cpu = arch_curr_cpu_num();
 
@@ -75,7 +83,30 @@ void mp_reschedule(mp_ipi_target_t target, cpu_mask_t mask, uint flags) {
 
         LTRACEF("local %u, post mask target now 0x%x\n", local_cpu, mask);
 
-        arch_mp_send_ipi(MP_IPI_TARGET_MASK, mask, MP_IPI_RESCHEDULE);
+        cpu_mask_t ipi_mask = 0;
+        for (cpu_num_t cpu = 0; mask != 0; cpu++) {
+            const cpu_mask_t cpu_mask = cpu_num_to_mask(cpu);
+            if ((mask & cpu_mask) == 0)
+                continue;
+            mask &= ~cpu_mask;
+
+            if ((mp.idle_cpus & cpu_mask) && mp_wake_idle_cpu(cpu)) {
+                CPU_STATS_INC(idle_wakes);
+                continue;
+            }
+
+            /* one IPI is enough to get a cpu into the scheduler */
+            if (__atomic_exchange_n(&percpu[cpu].reschedule_ipi_pending, 1, __ATOMIC_ACQ_REL)) {
+                CPU_STATS_INC(reschedule_ipis_suppressed);
+                continue;
+            }
+            ipi_mask |= cpu_mask;
+        }
+
+        if (ipi_mask != 0) {
+            CPU_STATS_ADD(reschedule_ipis_sent, __builtin_popcount(ipi_mask));
+            arch_mp_send_ipi(MP_IPI_TARGET_MASK, ipi_mask, MP_IPI_RESCHEDULE);
+        }
         break;
     }
 }
@@ -326,6 +357,8 @@ static zx_status_t mp_unplug_cpu_mask_single_locked(cpu_num_t cpu_id) {
     timer_transition_off_cpu(cpu_id);
     /* Move the CPU's DPCs to the current CPU. */
     dpc_transition_off_cpu(cpu_id);
+    /* Any reschedule IPI it had pending is lost with it. */
+    __atomic_store_n(&percpu[cpu_id].reschedule_ipi_pending, 0, __ATOMIC_RELEASE);
 
     status = platform_mp_cpu_unplug(cpu_id);
     if (status != ZX_OK) {
@@ -384,8 +417,30 @@ void mp_set_curr_cpu_online(bool online) {
     }
 }
 
+/* build the scheduler domains of |cpu| out of the arch's view of the cache topology.
+ * the topology is static, so every cpu the system could bring up is included and
+ * users mask the result against the active set. the boot cpu may become active
+ * before the rest of the cpus are enumerated, so each cpu also adds itself to the
+ * domains of the cpus near it.
+ */
+static void mp_init_sched_domains(cpu_num_t cpu) {
+    struct percpu* c = &percpu[cpu];
+
+    for (cpu_num_t i = 0; i < arch_max_num_cpus(); i++) {
+        uint distance = arch_mp_cpu_distance(cpu, i);
+        for (uint level = distance; level < NUM_SCHED_DOMAINS; level++) {
+            atomic_or((volatile int*)&c->sched_domain[level], cpu_num_to_mask(i));
+            atomic_or((volatile int*)&percpu[i].sched_domain[level], cpu_num_to_mask(cpu));
+        }
+    }
+
+    LTRACEF("cpu %u: smt %#x llc %#x\n", cpu,
+            c->sched_domain[SCHED_DOMAIN_SMT], c->sched_domain[SCHED_DOMAIN_LLC]);
+}
+
 void mp_set_curr_cpu_active(bool active) {
     if (active) {
+        mp_init_sched_domains(arch_curr_cpu_num());
         atomic_or((volatile int*)&mp.active_cpus, cpu_num_to_mask(arch_curr_cpu_num()));
     } else {
         atomic_and((volatile int*)&mp.active_cpus, ~cpu_num_to_mask(arch_curr_cpu_num()));
@@ -417,6 +472,7 @@ void mp_mbx_reschedule_irq(void) {
     LTRACEF("cpu %u\n", cpu);
 
     CPU_STATS_INC(reschedule_ipis);
+    __atomic_store_n(&get_local_percpu()->reschedule_ipi_pending, 0, __ATOMIC_RELEASE);
 
     if (mp.active_cpus & cpu_num_to_mask(cpu))
         thread_preempt_set_pending();
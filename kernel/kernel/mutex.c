@@ -20,14 +20,60 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/lockstat.h>
+#include <kernel/mp.h>
+#include <kernel/percpu.h>
 #include <kernel/sched.h>
 #include <kernel/thread.h>
 #include <lib/ktrace.h>
+#include <platform.h>
 #include <trace.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
+/* upper bound on how long a contended mutex_acquire spins on a running holder
+ * before giving up and blocking */
+#define MUTEX_SPIN_MAX_NS ZX_USEC(10)
+
+/* is |holder| running on some cpu right now? racy by nature, which is fine for
+ * deciding whether to keep spinning. does not dereference |holder|, which may
+ * have exited by the time we look. */
+static bool mutex_holder_running(uintptr_t holder) {
+    cpu_mask_t online = mp_get_online_mask();
+    for (cpu_num_t cpu = 0; online != 0; cpu++, online >>= 1) {
+        if ((online & 1) && atomic_load_u64_relaxed(&percpu[cpu].running_thread) == holder)
+            return true;
+    }
+    return false;
+}
+
+/* spin for a bounded time while the holder is running on another cpu, since
+ * most critical sections finish well before a block and wakeup would. stop once
+ * a waiter has queued: the release then hands the mutex straight to it. */
+static bool mutex_spin(mutex_t* m, thread_t* ct) {
+    zx_time_t deadline = 0;
+    for (;;) {
+        uintptr_t val = mutex_val(m);
+        if (val == 0) {
+            uintptr_t oldval = 0;
+            if (atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct))
+                return true;
+            continue;
+        }
+        if ((val & MUTEX_FLAG_QUEUED) || !mutex_holder_running(val))
+            return false;
+
+        zx_time_t now = current_time();
+        if (deadline == 0) {
+            deadline = now + MUTEX_SPIN_MAX_NS;
+        } else if (now >= deadline) {
+            return false;
+        }
+        arch_spinloop_pause();
+    }
+}
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -68,6 +114,10 @@ void mutex_acquire(mutex_t* m) TA_NO_THREAD_SAFETY_ANALYSIS {
 
     thread_t* ct = get_current_thread();
     uintptr_t oldval;
+    lockstat_entry_t* stat = NULL;
+#if LOCK_PROFILING
+    zx_time_t contend_start = 0;
+#endif
 
 retry:
     // fast path: assume its unheld, try to grab it
@@ -84,6 +134,24 @@ retry:
               ct, ct->name, m);
 #endif
 
+    // the first time through, try spinning on the holder before blocking
+    if (stat == NULL) {
+        stat = lockstat_get(m, LOCKSTAT_KIND_MUTEX);
+        atomic_add_u64_relaxed(&stat->contended, 1);
+#if LOCK_PROFILING
+        contend_start = current_time();
+#endif
+        if (mutex_spin(m, ct)) {
+            atomic_add_u64_relaxed(&stat->spin_acquired, 1);
+            ct->mutexes_held++;
+#if LOCK_PROFILING
+            lockstat_record_wait(stat, current_time() - contend_start,
+                                 (uintptr_t)__builtin_return_address(0));
+#endif
+            return;
+        }
+    }
+
     // we contended with someone else, will probably need to block
     THREAD_LOCK(state);
 
@@ -107,6 +175,7 @@ retry:
     sched_inheirit_priority(mutex_holder(m), ct->effec_priority, &unused);
 
     // we have signalled that we're blocking, so drop into the wait queue
+    zx_time_t block_start = current_time();
     zx_status_t ret = wait_queue_block(&m->wait, ZX_TIME_INFINITE);
     if (unlikely(ret < ZX_OK)) {
         // mutexes are not interruptable and cannot time out, so it
@@ -121,6 +190,13 @@ retry:
     // record that we hold it
     ct->mutexes_held++;
 
+    zx_time_t now = current_time();
+    atomic_add_u64_relaxed(&stat->blocked, 1);
+    atomic_add_u64_relaxed(&stat->blocked_ns, now - block_start);
+#if LOCK_PROFILING
+    lockstat_record_wait(stat, now - contend_start, (uintptr_t)__builtin_return_address(0));
+#endif
+
     THREAD_UNLOCK(state);
 }
 
@@ -24,6 +24,7 @@ MODULE_SRCS := \
 	$(LOCAL_DIR)/dpc.c \
 	$(LOCAL_DIR)/event.c \
 	$(LOCAL_DIR)/init.c \
+	$(LOCAL_DIR)/lockstat.c \
 	$(LOCAL_DIR)/mp.c \
 	$(LOCAL_DIR)/mutex.c \
 	$(LOCAL_DIR)/percpu.c \
@@ -6,15 +6,18 @@
 // https://opensource.org/licenses/MIT
 #include <kernel/sched.h>
 
+#include <arch/mp.h>
 #include <assert.h>
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
 #include <lib/ktrace.h>
 #include <list.h>
+#include <lk/init.h>
 #include <platform.h>
 #include <printf.h>
 #include <string.h>
@@ -26,6 +29,12 @@
 /* disable priority boosting */
 #define NO_BOOST 0
 
+/* disable the run queue load balancer */
+#define NO_BALANCE 0
+
+/* keep the preemption timer running even when a thread has the cpu to itself */
+#define NO_TICKLESS 0
+
 #define MAX_PRIORITY_ADJ 4 /* +/- priority levels from the base priority */
 
 /* ktraces just local to this file */
@@ -52,7 +61,37 @@
 /* threads get 10ms to run before they use up their time slice and the scheduler is invoked */
 #define THREAD_INITIAL_TIME_SLICE ZX_MSEC(10)
 
+/* minimum time between periodic load balancing passes on a cpu */
+#define SCHED_BALANCE_INTERVAL ZX_MSEC(20)
+
+/* bounds on deadline class parameters. the period is capped so a full budget always fits
+ * in a preemption timer, and floored to keep replenishment interrupts reasonable.
+ */
+#define SCHED_DEADLINE_MIN_PERIOD ZX_USEC(100)
+#define SCHED_DEADLINE_MAX_PERIOD ZX_MSEC(500)
+
+/* fraction of each cpu that may be reserved by deadline threads, leaving the rest for the
+ * priority based threads so they cannot be starved outright.
+ */
+#define SCHED_DEADLINE_MAX_UTILIZATION (SCHED_DEADLINE_UTILIZATION_ONE / 10 * 8)
+
+/* reasons a thread changed run queues, reported in TAG_THREAD_MIGRATE */
+enum sched_migrate_reason {
+    SCHED_MIGRATE_WAKEUP,
+    SCHED_MIGRATE_AFFINITY,
+    SCHED_MIGRATE_HOTPLUG,
+    SCHED_MIGRATE_STEAL,
+    SCHED_MIGRATE_PUSH,
+};
+
+/* run a thread woken by one about to block on it in the waker's place, see
+ * AutoSyncWakeup. set by kernel.sched.direct-switch.
+ */
+static bool sched_direct_switch = true;
+
 static bool local_migrate_if_needed(thread_t* curr_thread);
+static void sched_stop_tickless(struct percpu* c, zx_time_t now);
+static void sched_timer_tick(timer_t* t, zx_time_t now, void* arg);
 
 /* compute the effective priority of a thread */
 static void compute_effec_priority(thread_t* t) {
@@ -141,13 +180,36 @@ static cpu_mask_t rand_cpu(cpu_mask_t mask) {
     }
 }
 
+/* return the cpus in |idle_mask| whose whole core is idle, i.e. none of their smt
+ * siblings are running anything.
+ */
+static cpu_mask_t idle_core_mask(cpu_mask_t idle_mask) {
+    cpu_mask_t busy_mask = mp_get_active_mask() & ~mp_get_idle_mask();
+    cpu_mask_t result = 0;
+
+    for (cpu_mask_t m = idle_mask; m; m &= m - 1) {
+        cpu_num_t i = lowest_cpu_set(m);
+        if ((percpu[i].sched_domain[SCHED_DOMAIN_SMT] & busy_mask) == 0)
+            result |= cpu_num_to_mask(i);
+    }
+    return result;
+}
+
 /* find a cpu to wake up */
 static cpu_mask_t find_cpu_mask(thread_t* t) {
+    /* deadline threads stay on the cpu their reservation was admitted on */
+    if (unlikely(thread_is_deadline(t))) {
+        cpu_mask_t deadline_cpu_mask = cpu_num_to_mask(t->deadline.cpu);
+        if (deadline_cpu_mask & t->cpu_affinity & mp_get_active_mask())
+            return deadline_cpu_mask;
+    }
+
     /* get the last cpu the thread ran on */
     cpu_mask_t last_ran_cpu_mask = cpu_num_to_mask(t->last_cpu);
 
     /* the current cpu */
-    cpu_mask_t curr_cpu_mask = cpu_num_to_mask(arch_curr_cpu_num());
+    cpu_num_t curr_cpu = arch_curr_cpu_num();
+    cpu_mask_t curr_cpu_mask = cpu_num_to_mask(curr_cpu);
 
     /* the thread's affinity mask */
     cpu_mask_t cpu_affinity = t->cpu_affinity;
@@ -160,20 +222,38 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
     cpu_mask_t active_cpu_mask = mp_get_active_mask();
     idle_cpu_mask &= cpu_affinity;
     if (idle_cpu_mask != 0) {
-        if (idle_cpu_mask & curr_cpu_mask) {
-            /* the current cpu is idle and within our affinity mask, so run it here */
-            return curr_cpu_mask;
-        }
-
         if (last_ran_cpu_mask & idle_cpu_mask) {
             DEBUG_ASSERT(last_ran_cpu_mask & mp_get_active_mask());
-            /* the last core it ran on is idle and isn't the current cpu */
+            /* the last core it ran on is idle, its cache is likely still warm */
             return last_ran_cpu_mask;
         }
 
-        /* pick an idle_cpu */
+        /* look for an idle cpu sharing the last level cache with the cpu the thread last ran
+         * on, or with the waker if it has never run. a cpu whose smt siblings are all idle
+         * gets the whole core to itself, so try those first.
+         */
+        cpu_num_t home_cpu = is_valid_cpu_num(t->last_cpu) ? t->last_cpu : curr_cpu;
+        cpu_mask_t llc_idle_mask = idle_cpu_mask & percpu[home_cpu].sched_domain[SCHED_DOMAIN_LLC];
+        if (llc_idle_mask != 0) {
+            cpu_mask_t core_mask = idle_core_mask(llc_idle_mask);
+            if (core_mask & curr_cpu_mask)
+                return curr_cpu_mask;
+            if (core_mask != 0)
+                return rand_cpu(core_mask);
+            if (llc_idle_mask & curr_cpu_mask)
+                return curr_cpu_mask;
+            return rand_cpu(llc_idle_mask);
+        }
+
+        if (idle_cpu_mask & curr_cpu_mask) {
+            /* the current cpu is idle and within our affinity mask, so run it here */
+            return curr_cpu_mask;
+        }
+
+        /* pick an idle_cpu, preferring one with a whole core to itself */
         DEBUG_ASSERT((idle_cpu_mask & mp_get_active_mask()) == idle_cpu_mask);
-        return rand_cpu(idle_cpu_mask);
+        cpu_mask_t core_mask = idle_core_mask(idle_cpu_mask);
+        return rand_cpu(core_mask ? core_mask : idle_cpu_mask);
     }
 
     /* no idle cpus in our affinity mask */
@@ -200,12 +280,92 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
     return mask;
 }
 
+static void deadline_replenish(timer_t* timer, zx_time_t now, void* arg);
+
+/* start a new period if the current one has ended */
+static void deadline_update_period(thread_t* t, zx_time_t now) {
+    struct thread_deadline* dl = &t->deadline;
+    if (now < dl->period_end)
+        return;
+
+    /* a runnable thread with budget left at the end of its period did not get its capacity */
+    if (dl->budget > 0 && dl->period_end != 0 &&
+        (t->state == THREAD_READY || t->state == THREAD_RUNNING)) {
+        dl->misses++;
+    }
+
+    /* periods run back to back while the thread keeps up, and restart from now if it
+     * slept through one or more of them.
+     */
+    zx_time_t start = (now - dl->period_end < dl->period) ? dl->period_end : now;
+    dl->abs_deadline = start + dl->deadline;
+    dl->period_end = start + dl->period;
+    dl->budget = dl->capacity;
+}
+
+/* deadline threads with budget go in the cpu's deadline queue and others wait for their
+ * replenish timer. returns true if the thread was handled here.
+ */
+static bool insert_deadline_thread(cpu_num_t cpu, thread_t* t) {
+    if (likely(!thread_is_deadline(t)))
+        return false;
+
+    struct thread_deadline* dl = &t->deadline;
+    zx_time_t now = current_time();
+    deadline_update_period(t, now);
+
+    if (dl->budget == 0) {
+        /* the last of the budget went by after the deadline */
+        if (now > dl->abs_deadline)
+            dl->misses++;
+
+        dl->throttled = true;
+        timer_cancel(&dl->replenish_timer);
+        timer_set_oneshot(&dl->replenish_timer, dl->period_end, deadline_replenish, t);
+        return true;
+    }
+
+    /* keep the queue sorted by absolute deadline, fifo among equal deadlines */
+    struct list_node* queue = &percpu[cpu].deadline_queue;
+    thread_t* entry;
+    thread_t* next = NULL;
+    list_for_every_entry (queue, entry, thread_t, queue_node) {
+        if (dl->abs_deadline < entry->deadline.abs_deadline) {
+            next = entry;
+            break;
+        }
+    }
+    if (next) {
+        list_add_before(&next->queue_node, &t->queue_node);
+    } else {
+        list_add_tail(queue, &t->queue_node);
+    }
+    dl->queued = true;
+    percpu[cpu].run_queue_len++;
+
+    mp_set_cpu_busy(cpu);
+    return true;
+}
+
+/* start the clock on the time |t| waits to run. a thread that is only being moved
+ * between queues keeps the time it started waiting. */
+static inline void mark_ready(thread_t* t) {
+    if (t->ready_since == 0 && !thread_is_idle(t))
+        t->ready_since = current_time();
+}
+
 /* run queue manipulation */
 static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
+    mark_ready(t);
+
+    if (insert_deadline_thread(cpu, t))
+        return;
+
     list_add_head(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
     percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    percpu[cpu].run_queue_len++;
 
     /* mark the cpu as busy since the run queue now has at least one item in it */
     mp_set_cpu_busy(cpu);
@@ -214,21 +374,81 @@ static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
 static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
+    mark_ready(t);
+
+    if (insert_deadline_thread(cpu, t))
+        return;
+
     list_add_tail(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
     percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    percpu[cpu].run_queue_len++;
 
     /* mark the cpu as busy since the run queue now has at least one item in it */
     mp_set_cpu_busy(cpu);
 }
 
+/* pull a thread out of the run queue of the cpu it is waiting on. |pri| is the
+ * priority queue it was inserted into, which may differ from its current effective
+ * priority if that is in the process of being changed.
+ */
+static void remove_from_run_queue(thread_t* t, int pri) {
+    /* throttled deadline threads are not in any queue */
+    if (thread_is_deadline(t) && t->deadline.throttled) {
+        timer_cancel(&t->deadline.replenish_timer);
+        t->deadline.throttled = false;
+        return;
+    }
+
+    DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
+    DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
+
+    list_delete(&t->queue_node);
+
+    struct percpu* c = &percpu[t->curr_cpu];
+    DEBUG_ASSERT(c->run_queue_len > 0);
+    c->run_queue_len--;
+    if (t->deadline.queued) {
+        t->deadline.queued = false;
+        return;
+    }
+    if (list_is_empty(&c->run_queue[pri])) {
+        c->run_queue_bitmap &= ~(1u << pri);
+    }
+}
+
+/* return the index of the highest priority non empty queue in a run queue bitmap */
+static uint highest_run_queue(uint32_t bitmap) {
+    DEBUG_ASSERT(bitmap != 0);
+    return HIGHEST_PRIORITY - __builtin_clz(bitmap) -
+           (sizeof(bitmap) * CHAR_BIT - NUM_PRIORITIES);
+}
+
+static void trace_migration(thread_t* t, cpu_num_t from, cpu_num_t to,
+                            enum sched_migrate_reason reason) {
+    ktrace(TAG_THREAD_MIGRATE, (uint32_t)t->user_tid, (from << 16) | to, reason,
+           (uint32_t)(uintptr_t)t);
+}
+
 static thread_t* sched_get_top_thread(cpu_num_t cpu) {
     /* pop the head of the highest priority queue with any threads
-     * queued up on the passed in cpu.
+     * queued up on the passed in cpu. deadline threads run ahead of all of them.
      */
     struct percpu* c = &percpu[cpu];
+    if (unlikely(!list_is_empty(&c->deadline_queue))) {
+        thread_t* newthread = list_remove_head_type(&c->deadline_queue, thread_t, queue_node);
+
+        DEBUG_ASSERT(newthread->deadline.queued);
+        DEBUG_ASSERT(newthread->curr_cpu == cpu);
+        newthread->deadline.queued = false;
+
+        DEBUG_ASSERT(c->run_queue_len > 0);
+        c->run_queue_len--;
+
+        return newthread;
+    }
+
     if (likely(c->run_queue_bitmap)) {
-        uint highest_queue = HIGHEST_PRIORITY - __builtin_clz(c->run_queue_bitmap) -
-                             (sizeof(c->run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
+        uint highest_queue = highest_run_queue(c->run_queue_bitmap);
 
         thread_t* newthread = list_remove_head_type(&c->run_queue[highest_queue], thread_t, queue_node);
 
@@ -238,6 +458,8 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) {
                          newthread->cpu_affinity, cpu);
         DEBUG_ASSERT(newthread->curr_cpu == cpu);
 
+        DEBUG_ASSERT(c->run_queue_len > 0);
+        c->run_queue_len--;
         if (list_is_empty(&c->run_queue[highest_queue]))
             c->run_queue_bitmap &= ~(1u << highest_queue);
 
@@ -255,6 +477,7 @@ void sched_init_thread(thread_t* t, int priority) {
     t->priority_boost = 0;
     t->inheirited_priority = -1;
     compute_effec_priority(t);
+    timer_init(&t->deadline.replenish_timer);
 }
 
 void sched_block(void) {
@@ -274,7 +497,8 @@ void sched_block(void) {
 /* find a cpu to run the thread on, put it in the run queue for that cpu, and accumulate a list
  * of cpus we'll need to reschedule, including the local cpu.
  */
-static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* accum_cpu_mask) {
+static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* accum_cpu_mask,
+                                enum sched_migrate_reason reason) {
     /* find a core to run it on */
     cpu_mask_t cpu = find_cpu_mask(t);
     cpu_num_t cpu_num;
@@ -288,6 +512,9 @@ static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* ac
         *accum_cpu_mask |= cpu_num_to_mask(cpu_num);
     }
 
+    if (t->last_cpu != INVALID_CPU && t->last_cpu != cpu_num)
+        trace_migration(t, t->last_cpu, cpu_num, reason);
+
     t->curr_cpu = cpu_num;
     if (t->remaining_time_slice > 0) {
         insert_in_run_queue_head(cpu_num, t);
@@ -296,6 +523,177 @@ static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* ac
     }
 }
 
+/* find the highest priority thread queued on |victim| that is allowed to run on |cpu|.
+ * each queue is walked from the tail so the thread the victim would run next stays put.
+ */
+static thread_t* find_movable_thread(cpu_num_t victim, cpu_num_t cpu) {
+    struct percpu* c = &percpu[victim];
+    cpu_mask_t cpu_mask = cpu_num_to_mask(cpu);
+
+    uint32_t bitmap = c->run_queue_bitmap;
+    while (bitmap) {
+        uint pri = highest_run_queue(bitmap);
+        bitmap &= ~(1u << pri);
+
+        thread_t* t = list_peek_tail_type(&c->run_queue[pri], thread_t, queue_node);
+        for (; t; t = list_prev_type(&c->run_queue[pri], &t->queue_node, thread_t, queue_node)) {
+            if ((t->cpu_affinity & cpu_mask) && !thread_is_deadline(t))
+                return t;
+        }
+    }
+    return NULL;
+}
+
+/* move a thread sitting in another cpu's run queue over to |cpu|'s run queue */
+static void move_queued_thread(thread_t* t, cpu_num_t cpu, enum sched_migrate_reason reason) {
+    DEBUG_ASSERT(t->state == THREAD_READY);
+    DEBUG_ASSERT(t->cpu_affinity & cpu_num_to_mask(cpu));
+
+    remove_from_run_queue(t, t->effec_priority);
+    trace_migration(t, t->curr_cpu, cpu, reason);
+
+    t->curr_cpu = cpu;
+    if (t->remaining_time_slice > 0) {
+        insert_in_run_queue_head(cpu, t);
+    } else {
+        insert_in_run_queue_tail(cpu, t);
+    }
+}
+
+/* how much work |cpu| could take off of |victim|. moving a thread off its
+ * package or cluster throws away its cache footprint, so a remote cpu has to be
+ * queued one thread deeper before it is worth stealing from.
+ */
+static uint32_t balance_load(cpu_num_t victim, cpu_num_t cpu, uint distance) {
+    uint32_t len = percpu[victim].run_queue_len;
+    if (distance >= MP_CPU_DISTANCE_REMOTE && len > 0)
+        len--;
+    return len;
+}
+
+/* called on a cpu that is about to go idle. pull a runnable thread off of the most
+ * loaded cpu, preferring cpus that share a cache with this one.
+ * returns true if a thread was placed in the local run queue.
+ */
+static bool balance_steal(cpu_num_t cpu) {
+    cpu_mask_t candidates = mp_get_active_mask() & ~mp_get_idle_mask() & ~cpu_num_to_mask(cpu);
+
+    while (candidates) {
+        cpu_num_t busiest = INVALID_CPU;
+        uint32_t busiest_load = 0;
+        uint busiest_distance = MP_CPU_DISTANCE_REMOTE + 1;
+
+        for (cpu_mask_t m = candidates; m; m &= m - 1) {
+            cpu_num_t i = lowest_cpu_set(m);
+            if (percpu[i].run_queue_len == 0)
+                continue;
+
+            uint distance = arch_mp_cpu_distance(cpu, i);
+            uint32_t load = balance_load(i, cpu, distance);
+            if (load > busiest_load || (load == busiest_load && distance < busiest_distance)) {
+                busiest = i;
+                busiest_load = load;
+                busiest_distance = distance;
+            }
+        }
+
+        if (busiest_load == 0)
+            return false;
+
+        thread_t* t = find_movable_thread(busiest, cpu);
+        if (t) {
+            move_queued_thread(t, cpu, SCHED_MIGRATE_STEAL);
+            CPU_STATS_INC(balance_steals);
+            return true;
+        }
+
+        /* nothing on that cpu is allowed to run here, try the next busiest */
+        candidates &= ~cpu_num_to_mask(busiest);
+    }
+
+    return false;
+}
+
+/* called periodically on a busy cpu. hand queued threads off to idle cpus that are
+ * allowed to run them, closest cpus first. the thread at the head of the local run
+ * queue is always left behind to run here.
+ */
+static void balance_push(cpu_num_t cpu, zx_time_t now) {
+    struct percpu* c = &percpu[cpu];
+    if (now - c->last_balance < SCHED_BALANCE_INTERVAL)
+        return;
+    c->last_balance = now;
+
+    cpu_mask_t idle = mp_get_idle_mask() & mp_get_active_mask() & ~cpu_num_to_mask(cpu);
+    cpu_mask_t accum_cpu_mask = 0;
+    while (idle && c->run_queue_len > 1) {
+        cpu_num_t target = INVALID_CPU;
+        uint target_distance = MP_CPU_DISTANCE_REMOTE + 1;
+        for (cpu_mask_t m = idle; m; m &= m - 1) {
+            cpu_num_t i = lowest_cpu_set(m);
+            uint distance = arch_mp_cpu_distance(cpu, i);
+            if (distance < target_distance) {
+                target = i;
+                target_distance = distance;
+            }
+        }
+        idle &= ~cpu_num_to_mask(target);
+
+        thread_t* t = find_movable_thread(cpu, target);
+        if (!t)
+            continue;
+
+        move_queued_thread(t, target, SCHED_MIGRATE_PUSH);
+        CPU_STATS_INC(balance_pushes);
+        accum_cpu_mask |= cpu_num_to_mask(target);
+    }
+
+    if (accum_cpu_mask)
+        mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+}
+
+/* if the current thread is waking |t| just before blocking to wait on it, queue |t| to run
+ * next on this cpu rather than waking another cpu for it while this one goes idle. the
+ * waker's block then switches straight to |t| without an ipi, and with whatever the
+ * waker left in the cache. returns false if |t| should be placed as usual.
+ */
+static bool direct_switch_insert(thread_t* t) {
+    thread_t* current_thread = get_current_thread();
+    if (!sched_direct_switch || !current_thread->sync_wakeup || arch_in_int_handler())
+        return false;
+
+    /* only when |t| would run next. deadline threads stay on their admitted cpu, and
+     * real time wakers have no preemption timer to share the cpu by if they go on running.
+     */
+    cpu_num_t curr_cpu = arch_curr_cpu_num();
+    struct percpu* c = &percpu[curr_cpu];
+    if (thread_is_deadline(t) || thread_is_real_time_or_idle(current_thread) ||
+        !(t->cpu_affinity & cpu_num_to_mask(curr_cpu)) || !mp_is_cpu_active(curr_cpu) ||
+        c->run_queue_len != 0)
+        return false;
+
+    if (t->last_cpu != INVALID_CPU && t->last_cpu != curr_cpu)
+        trace_migration(t, t->last_cpu, curr_cpu, SCHED_MIGRATE_WAKEUP);
+
+    t->curr_cpu = curr_cpu;
+    insert_in_run_queue_head(curr_cpu, t);
+    CPU_STATS_INC(direct_switches);
+
+    /* the waker should block shortly, but if it goes on running instead the preemption
+     * timer has to be running for |t| to get a turn.
+     */
+    if (c->tickless) {
+        zx_time_t now = current_time();
+        sched_stop_tickless(c, now);
+
+        zx_time_t slice_end = current_thread->last_started_running +
+                              current_thread->remaining_time_slice;
+        timer_reset_oneshot_local(&c->preempt_timer, MAX(now, slice_end), sched_timer_tick,
+                                  NULL);
+    }
+    return true;
+}
+
 bool sched_unblock(thread_t* t) {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -309,12 +707,18 @@ bool sched_unblock(thread_t* t) {
     /* stuff the new thread in the run queue */
     t->state = THREAD_READY;
 
+    /* no local reschedule, the waker is about to block and will switch to it */
+    if (direct_switch_insert(t))
+        return false;
+
     bool local_resched = false;
     cpu_mask_t mask = 0;
-    find_cpu_and_insert(t, &local_resched, &mask);
+    find_cpu_and_insert(t, &local_resched, &mask, SCHED_MIGRATE_WAKEUP);
 
+    /* deadline threads preempt anything, including real time threads */
     if (mask)
-        mp_reschedule(MP_IPI_TARGET_MASK, mask, 0);
+        mp_reschedule(MP_IPI_TARGET_MASK, mask,
+                      thread_is_deadline(t) ? MP_RESCHEDULE_FLAG_REALTIME : 0);
     return local_resched;
 }
 
@@ -337,7 +741,8 @@ bool sched_unblock_list(struct list_node* list) {
 
         /* stuff the new thread in the run queue */
         t->state = THREAD_READY;
-        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+        if (!direct_switch_insert(t))
+            find_cpu_and_insert(t, &local_resched, &accum_cpu_mask, SCHED_MIGRATE_WAKEUP);
     }
 
     if (accum_cpu_mask)
@@ -375,7 +780,12 @@ void sched_yield(void) {
     current_thread->remaining_time_slice = 0;
     deboost_thread(current_thread, false);
 
+    /* a deadline thread yielding is done with its work for this period */
+    if (thread_is_deadline(current_thread))
+        current_thread->deadline.budget = 0;
+
     current_thread->state = THREAD_READY;
+    current_thread->yielding = true;
 
     if (local_migrate_if_needed(current_thread))
         return;
@@ -412,6 +822,10 @@ void sched_preempt(void) {
         } else {
             insert_in_run_queue_tail(curr_cpu, current_thread);
         }
+
+        /* spread any backlog on this cpu out to idle cpus */
+        if (!NO_BALANCE)
+            balance_push(curr_cpu, current_time());
     }
 
     sched_resched_internal();
@@ -461,7 +875,7 @@ static void migrate_current_thread(thread_t* current_thread) {
 
     // current thread, so just shove ourself into another cpu's queue and reschedule locally
     current_thread->state = THREAD_READY;
-    find_cpu_and_insert(current_thread, &local_resched, &accum_cpu_mask);
+    find_cpu_and_insert(current_thread, &local_resched, &accum_cpu_mask, SCHED_MIGRATE_AFFINITY);
     if (accum_cpu_mask)
         mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
     sched_resched_internal();
@@ -483,7 +897,7 @@ void sched_transition_off_cpu(cpu_num_t old_cpu) {
         // Threads pinned to old_cpu can't run anywhere else, so put them
         // into a temporary list and deal with them later.
         if (t->cpu_affinity != pinned_mask) {
-            find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+            find_cpu_and_insert(t, &local_resched, &accum_cpu_mask, SCHED_MIGRATE_HOTPLUG);
             DEBUG_ASSERT(!local_resched);
         } else {
             DEBUG_ASSERT(!list_in_list(&t->queue_node));
@@ -550,17 +964,9 @@ void sched_migrate(thread_t* t) {
         }
 
         // it's sitting in a run queue somewhere, so pull it out of that one and find a new home
-        DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
-        list_delete(&t->queue_node);
-
-        DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
-
-        struct percpu* c = &percpu[t->curr_cpu];
-        if (list_is_empty(&c->run_queue[t->effec_priority])) {
-            c->run_queue_bitmap &= ~(1u << t->effec_priority);
-        }
+        remove_from_run_queue(t, t->effec_priority);
 
-        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask, SCHED_MIGRATE_AFFINITY);
         break;
     default:
         // the other states do not matter, exit
@@ -588,6 +994,10 @@ void sched_inheirit_priority(thread_t* t, int pri, bool *local_resched) {
     if (pri >= 0 && pri <= t->inheirited_priority)
         return;
 
+    // a priority inheirited through a futex is kept until the futex is released
+    if (pri < 0 && t->futex_priority_held)
+        return;
+
     // adjust the priority and remember the old value
     t->inheirited_priority = pri;
     int old_ep = t->effec_priority;
@@ -612,15 +1022,7 @@ void sched_inheirit_priority(thread_t* t, int pri, bool *local_resched) {
         break;
     case THREAD_READY:
         // it's sitting in a run queue somewhere, remove and add back to the proper queue on that cpu
-        DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
-        list_delete(&t->queue_node);
-
-        DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
-
-        struct percpu* c = &percpu[t->curr_cpu];
-        if (list_is_empty(&c->run_queue[old_ep])) {
-            c->run_queue_bitmap &= ~(1u << old_ep);
-        }
+        remove_from_run_queue(t, old_ep);
 
         if (t->effec_priority > old_ep) {
             insert_in_run_queue_head(t->curr_cpu, t);
@@ -645,6 +1047,154 @@ void sched_inheirit_priority(thread_t* t, int pri, bool *local_resched) {
     }
 }
 
+/* timer callback that starts the next period of a throttled deadline thread */
+static void deadline_replenish(timer_t* timer, zx_time_t now, void* arg) TA_NO_THREAD_SAFETY_ANALYSIS {
+    thread_t* t = (thread_t*)arg;
+
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    /* sched_clear_deadline may be cancelling us while holding the thread lock */
+    if (timer_trylock_or_cancel(timer, &thread_lock))
+        return;
+
+    if (thread_is_deadline(t) && t->deadline.throttled) {
+        t->deadline.throttled = false;
+        deadline_update_period(t, now);
+
+        bool local_resched = false;
+        cpu_mask_t accum_cpu_mask = 0;
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask, SCHED_MIGRATE_WAKEUP);
+        if (accum_cpu_mask)
+            mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, MP_RESCHEDULE_FLAG_REALTIME);
+        if (local_resched)
+            thread_preempt_set_pending();
+    }
+
+    spin_unlock(&thread_lock);
+}
+
+void sched_clear_deadline(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if (!thread_is_deadline(t))
+        return;
+
+    struct thread_deadline* dl = &t->deadline;
+    percpu[dl->cpu].deadline_utilization -= dl->utilization;
+
+    if (t->state == THREAD_READY) {
+        /* pull it out of the deadline queue while it still looks like a deadline thread */
+        remove_from_run_queue(t, t->effec_priority);
+        t->flags &= ~THREAD_FLAG_DEADLINE;
+        bool local_resched = false;
+        cpu_mask_t accum_cpu_mask = 0;
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask, SCHED_MIGRATE_AFFINITY);
+        if (accum_cpu_mask)
+            mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, 0);
+    } else {
+        t->flags &= ~THREAD_FLAG_DEADLINE;
+    }
+
+    timer_cancel(&dl->replenish_timer);
+    dl->throttled = false;
+    dl->utilization = 0;
+    dl->budget = 0;
+}
+
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t deadline,
+                               zx_duration_t period) {
+    if (capacity != 0) {
+        if (deadline > period || capacity > deadline)
+            return ZX_ERR_INVALID_ARGS;
+        if (period < SCHED_DEADLINE_MIN_PERIOD || period > SCHED_DEADLINE_MAX_PERIOD)
+            return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    /* admission is based on density, which is sufficient for edf with deadlines shorter
+     * than or equal to the period.
+     */
+    uint64_t utilization = capacity * SCHED_DEADLINE_UTILIZATION_ONE / (deadline ? deadline : 1);
+
+    THREAD_LOCK(state);
+
+    if (capacity == 0) {
+        sched_clear_deadline(t);
+        THREAD_UNLOCK(state);
+        return ZX_OK;
+    }
+
+    /* the thread's current reservation, if any, does not count against itself */
+    uint32_t old_utilization = 0;
+    cpu_num_t old_cpu = INVALID_CPU;
+    if (thread_is_deadline(t)) {
+        old_utilization = t->deadline.utilization;
+        old_cpu = t->deadline.cpu;
+    }
+
+    /* pick the cpu with the most room left */
+    cpu_num_t best_cpu = INVALID_CPU;
+    uint32_t best_utilization = SCHED_DEADLINE_MAX_UTILIZATION;
+    cpu_mask_t candidates = t->cpu_affinity & mp_get_active_mask();
+    for (cpu_mask_t m = candidates; m; m &= m - 1) {
+        cpu_num_t i = lowest_cpu_set(m);
+        uint32_t used = percpu[i].deadline_utilization - ((i == old_cpu) ? old_utilization : 0);
+        if (used + utilization <= SCHED_DEADLINE_MAX_UTILIZATION &&
+            (best_cpu == INVALID_CPU || used < best_utilization)) {
+            best_cpu = i;
+            best_utilization = used;
+        }
+    }
+
+    if (best_cpu == INVALID_CPU) {
+        THREAD_UNLOCK(state);
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    /* leave whatever queue the thread is in before it changes class */
+    bool ready = (t->state == THREAD_READY);
+    if (ready)
+        remove_from_run_queue(t, t->effec_priority);
+    if (old_cpu != INVALID_CPU)
+        percpu[old_cpu].deadline_utilization -= old_utilization;
+
+    struct thread_deadline* dl = &t->deadline;
+    dl->capacity = capacity;
+    dl->deadline = deadline;
+    dl->period = period;
+    dl->utilization = (uint32_t)utilization;
+    dl->cpu = best_cpu;
+    /* start a fresh period the next time the thread is queued */
+    dl->period_end = 0;
+    dl->budget = 0;
+    percpu[best_cpu].deadline_utilization += dl->utilization;
+    t->flags |= THREAD_FLAG_DEADLINE;
+
+    if (ready) {
+        bool local_resched = false;
+        cpu_mask_t accum_cpu_mask = 0;
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask, SCHED_MIGRATE_AFFINITY);
+        if (accum_cpu_mask)
+            mp_reschedule(MP_IPI_TARGET_MASK, accum_cpu_mask, MP_RESCHEDULE_FLAG_REALTIME);
+        if (local_resched)
+            sched_reschedule();
+    } else if (t == get_current_thread()) {
+        /* go through the scheduler to pick up a budget and deadline */
+        sched_reschedule();
+    }
+
+    THREAD_UNLOCK(state);
+    return ZX_OK;
+}
+
+/* the preemption timer is being rearmed, account for the ticks it did not take */
+static void sched_stop_tickless(struct percpu* c, zx_time_t now) {
+    if (!c->tickless)
+        return;
+
+    c->tickless = false;
+    c->stats.ticks_skipped += (now - c->tickless_start) / THREAD_INITIAL_TIME_SLICE;
+}
+
 /* preemption timer that is set whenever a thread is scheduled */
 static void sched_timer_tick(timer_t* t, zx_time_t now, void* arg) {
     /* if the preemption timer went off on the idle or a real time thread, ignore it */
@@ -652,6 +1202,20 @@ static void sched_timer_tick(timer_t* t, zx_time_t now, void* arg) {
     if (unlikely(thread_is_real_time_or_idle(current_thread)))
         return;
 
+    /* deadline threads run until their budget for the period is used up */
+    if (unlikely(thread_is_deadline(current_thread))) {
+        DEBUG_ASSERT(now > current_thread->last_started_running);
+        zx_time_t delta = now - current_thread->last_started_running;
+        if (delta >= current_thread->deadline.budget) {
+            current_thread->deadline.budget = 0;
+            thread_preempt_set_pending();
+        } else {
+            timer_set_oneshot(t, current_thread->last_started_running + current_thread->deadline.budget,
+                              sched_timer_tick, NULL);
+        }
+        return;
+    }
+
     LOCAL_KTRACE2("timer_tick", (uint32_t)current_thread->user_tid, current_thread->remaining_time_slice);
 
     /* did this tick complete the time slice? */
@@ -661,6 +1225,16 @@ static void sched_timer_tick(timer_t* t, zx_time_t now, void* arg) {
         /* we completed the time slice, do not restart it and let the scheduler run */
         current_thread->remaining_time_slice = 0;
 
+        /* if nothing else is queued here there is no one to hand the cpu to, so let the
+         * timer lapse. it is restarted when another thread is queued on this cpu.
+         */
+        struct percpu* c = get_local_percpu();
+        if (!NO_TICKLESS && c->run_queue_len == 0) {
+            c->tickless = true;
+            c->tickless_start = now;
+            return;
+        }
+
         /* set a timer to go off on the time slice interval from now */
         timer_set_oneshot(t, now + THREAD_INITIAL_TIME_SLICE, sched_timer_tick, NULL);
 
@@ -702,6 +1276,10 @@ void sched_resched_internal(void) {
 
     CPU_STATS_INC(reschedules);
 
+    /* if this cpu is about to go idle, look for queued work elsewhere first */
+    if (!NO_BALANCE && percpu[cpu].run_queue_len == 0 && mp_is_cpu_active(cpu))
+        balance_steal(cpu);
+
     /* pick a new thread to run */
     thread_t* newthread = sched_get_top_thread(cpu);
 
@@ -710,13 +1288,28 @@ void sched_resched_internal(void) {
     newthread->state = THREAD_RUNNING;
 
     thread_t* oldthread = current_thread;
+    const bool yielded = oldthread->yielding;
+    oldthread->yielding = false;
 
     LOCAL_KTRACE2("resched old pri", (uint32_t)oldthread->user_tid, effec_priority(oldthread));
     LOCAL_KTRACE2("resched new pri", (uint32_t)newthread->user_tid, effec_priority(newthread));
 
     /* if it's the same thread as we're already running, exit */
-    if (newthread == oldthread)
+    if (newthread == oldthread) {
+        /* it never stopped running, so it did not wait */
+        newthread->ready_since = 0;
+
+        /* a thread that had the cpu to itself may have company now, restart its time slice */
+        if (unlikely(percpu[cpu].tickless) && percpu[cpu].run_queue_len > 0) {
+            zx_time_t now = current_time();
+            sched_stop_tickless(&percpu[cpu], now);
+
+            zx_time_t slice_end = newthread->last_started_running + newthread->remaining_time_slice;
+            timer_reset_oneshot_local(&percpu[cpu].preempt_timer, MAX(now, slice_end),
+                                      sched_timer_tick, NULL);
+        }
         return;
+    }
 
     zx_time_t now = current_time();
 
@@ -724,7 +1317,18 @@ void sched_resched_internal(void) {
     DEBUG_ASSERT(now >= oldthread->last_started_running);
     zx_duration_t old_runtime = now - oldthread->last_started_running;
     oldthread->runtime_ns += old_runtime;
+    if (oldthread->state == THREAD_READY && !yielded && !thread_is_idle(oldthread))
+        oldthread->preemptions++;
     oldthread->remaining_time_slice -= MIN(old_runtime, oldthread->remaining_time_slice);
+    if (thread_is_deadline(oldthread)) {
+        oldthread->deadline.budget -= MIN(old_runtime, oldthread->deadline.budget);
+
+        /* ran out of budget after being requeued, park it until it is replenished */
+        if (oldthread->deadline.budget == 0 && oldthread->deadline.queued) {
+            remove_from_run_queue(oldthread, oldthread->effec_priority);
+            insert_deadline_thread(oldthread->curr_cpu, oldthread);
+        }
+    }
 
     /* set up quantum for the new thread if it was consumed */
     if (newthread->remaining_time_slice == 0) {
@@ -732,12 +1336,17 @@ void sched_resched_internal(void) {
     }
 
     newthread->last_started_running = now;
+    if (newthread->ready_since != 0) {
+        newthread->queue_ns += now - newthread->ready_since;
+        newthread->ready_since = 0;
+    }
 
     /* mark the cpu ownership of the threads */
     if (oldthread->state != THREAD_READY)
         oldthread->curr_cpu = INVALID_CPU;
     newthread->last_cpu = cpu;
     newthread->curr_cpu = cpu;
+    atomic_store_u64(&percpu[cpu].running_thread, (uintptr_t)newthread);
 
     /* if we selected the idle thread the cpu's run queue must be empty, so mark the
      * cpu as idle */
@@ -753,6 +1362,8 @@ void sched_resched_internal(void) {
 
     CPU_STATS_INC(context_switches);
 
+    sched_stop_tickless(&percpu[cpu], now);
+
     if (thread_is_idle(oldthread)) {
         percpu[cpu].stats.idle_time += now - oldthread->last_started_running;
     }
@@ -771,18 +1382,32 @@ void sched_resched_internal(void) {
                                  cpu, oldthread, oldthread->name, newthread, newthread->name);
             timer_cancel(&percpu[cpu].preempt_timer);
         }
+    } else if (!NO_TICKLESS && !thread_is_deadline(newthread) && percpu[cpu].run_queue_len == 0) {
+        /* nothing to share the cpu with, run without a preemption timer until something
+         * is queued on this cpu.
+         */
+        TRACE_CONTEXT_SWITCH("tickless, cpu %u, old %p (%s), new %p (%s)\n",
+                             cpu, oldthread, oldthread->name, newthread, newthread->name);
+        if (!thread_is_real_time_or_idle(oldthread))
+            timer_cancel(&percpu[cpu].preempt_timer);
+        percpu[cpu].tickless = true;
+        percpu[cpu].tickless_start = now;
     } else {
         /* set up a one shot timer to handle the remaining time slice on this thread */
         TRACE_CONTEXT_SWITCH("start preempt, cpu %u, old %p (%s), new %p (%s)\n",
                              cpu, oldthread, oldthread->name, newthread, newthread->name);
 
+        /* deadline threads are preempted when they exhaust their budget */
+        zx_duration_t slice = thread_is_deadline(newthread) ? newthread->deadline.budget
+                                                            : newthread->remaining_time_slice;
+
         /* make sure the time slice is reasonable */
-        DEBUG_ASSERT(newthread->remaining_time_slice > 0 && newthread->remaining_time_slice < ZX_SEC(1));
+        DEBUG_ASSERT(slice > 0 && slice < ZX_SEC(1));
 
         /* use a special version of the timer set api that lets it reset an existing timer efficiently, given
          * that we cannot possibly race with our own timer because interrupts are disabled.
          */
-        timer_reset_oneshot_local(&percpu[cpu].preempt_timer, now + newthread->remaining_time_slice, sched_timer_tick, NULL);
+        timer_reset_oneshot_local(&percpu[cpu].preempt_timer, now + slice, sched_timer_tick, NULL);
     }
 
     /* set some optional target debug leds */
@@ -830,9 +1455,17 @@ void sched_resched_internal(void) {
     final_context_switch(oldthread, newthread);
 }
 
+static void sched_direct_switch_init(uint level) {
+    sched_direct_switch = cmdline_get_bool("kernel.sched.direct-switch", true);
+}
+
+LK_INIT_HOOK(sched_direct_switch, sched_direct_switch_init, LK_INIT_LEVEL_THREADING);
+
 void sched_init_early(void) {
     /* initialize the run queues */
-    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++)
+    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
         for (unsigned int i = 0; i < NUM_PRIORITIES; i++)
             list_initialize(&percpu[cpu].run_queue[i]);
+        list_initialize(&percpu[cpu].deadline_queue);
+    }
 }
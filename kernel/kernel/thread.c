@@ -488,7 +488,7 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread, int retcode
     /* must be put at top scope in this function to force the compiler to keep it from
      * reusing the stack before the function exits
      */
-    dpc_t free_dpc;
+    dpc_t free_dpc = DPC_INITIAL_VALUE;
 
     /* enter the dead state */
     current_thread->state = THREAD_DEATH;
@@ -534,6 +534,7 @@ void thread_forget(thread_t* t) {
     __UNUSED thread_t* current_thread = get_current_thread();
     DEBUG_ASSERT(current_thread != t);
 
+    sched_clear_deadline(t);
     list_delete(&t->thread_list_node);
     THREAD_UNLOCK(state);
 
@@ -563,6 +564,9 @@ void thread_exit(int retcode) {
 
     THREAD_LOCK(state);
 
+    /* give back any deadline reservation and stop its replenish timer */
+    sched_clear_deadline(current_thread);
+
     thread_exit_locked(current_thread, retcode);
 }
 
@@ -752,8 +756,22 @@ void thread_process_pending_signals(void) {
 }
 
 __NO_RETURN static int idle_thread_routine(void* arg) {
-    for (;;)
-        arch_idle();
+    if (!arch_idle_wakes_on_write()) {
+        for (;;)
+            arch_idle();
+    }
+
+    /* the idle thread is pinned, so its percpu never changes */
+    struct percpu* c = &percpu[arch_curr_cpu_num()];
+    for (;;) {
+        /* advertise that a store to idle_state is enough to wake us, see
+         * mp_reschedule(). a waker that missed this sends an IPI instead. */
+        __atomic_fetch_or(&c->idle_state, IDLE_STATE_POLLING, __ATOMIC_SEQ_CST);
+        arch_idle_wait(&c->idle_state, IDLE_STATE_WAKE);
+        uint32_t state = __atomic_exchange_n(&c->idle_state, 0, __ATOMIC_SEQ_CST);
+        if (state & IDLE_STATE_WAKE)
+            thread_reschedule();
+    }
 }
 
 /**
@@ -958,6 +976,51 @@ zx_duration_t thread_runtime(const thread_t* t) {
     return runtime;
 }
 
+/**
+ * @brief Take a snapshot of a thread's time accounting.
+ *
+ * Like thread_runtime(), this takes the thread_lock so that the time the
+ * thread has been running, or waiting in a run queue, since it was last
+ * scheduled can be included.
+ */
+void thread_get_runtime_stats(const thread_t* t, struct thread_runtime_stats* stats) {
+    THREAD_LOCK(state);
+
+    zx_time_t now = current_time();
+    stats->runtime_ns = t->runtime_ns;
+    if (t->state == THREAD_RUNNING) {
+        stats->runtime_ns += now - t->last_started_running;
+    }
+    stats->queue_ns = t->queue_ns;
+    if (t->ready_since != 0) {
+        stats->queue_ns += now - t->ready_since;
+    }
+    stats->kernel_ns = t->kernel_ns;
+    stats->preemptions = t->preemptions;
+    stats->page_faults = t->page_faults;
+    stats->page_fault_ns = t->page_fault_ns;
+
+    THREAD_UNLOCK(state);
+}
+
+/**
+ * @brief Return the number of nanoseconds the current thread has been running for.
+ *
+ * Only the current cpu updates the running thread's runtime, so disabling
+ * interrupts is enough to read it consistently.
+ */
+zx_duration_t thread_current_runtime(void) {
+    spin_lock_saved_state_t irqstate;
+    arch_interrupt_save(&irqstate, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    const thread_t* t = get_current_thread();
+    zx_duration_t runtime = t->runtime_ns + (current_time() - t->last_started_running);
+
+    arch_interrupt_restore(irqstate, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    return runtime;
+}
+
 /**
  * @brief Construct a thread t around the current running state
  *
@@ -88,6 +88,7 @@ static void insert_timer_in_queue(uint cpu, timer_t* timer,
             timer->slack = entry->scheduled_time - timer->scheduled_time;
             timer->scheduled_time = entry->scheduled_time;
             list_add_after(&entry->node, &timer->node);
+            CPU_STATS_INC(timers_coalesced);
             return;
         }
 
@@ -149,6 +150,7 @@ static void insert_timer_in_queue(uint cpu, timer_t* timer,
         timer->slack = entry->scheduled_time - timer->scheduled_time;
         timer->scheduled_time = entry->scheduled_time;
         list_add_after(&entry->node, &timer->node);
+        CPU_STATS_INC(timers_coalesced);
         return;
     }
 
@@ -323,8 +325,12 @@ bool timer_cancel(timer_t* timer) {
         if (unlikely(oldhead == timer)) {
             timer_t* newhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
             if (newhead) {
-                LTRACEF("setting new timer to %" PRIu64 "\n", newhead->scheduled_time);
-                platform_set_oneshot_timer(newhead->scheduled_time);
+                /* a new head that was coalesced with the old one already has the
+                 * hw timer set for it */
+                if (newhead->scheduled_time != timer->scheduled_time) {
+                    LTRACEF("setting new timer to %" PRIu64 "\n", newhead->scheduled_time);
+                    platform_set_oneshot_timer(newhead->scheduled_time);
+                }
             } else {
                 LTRACEF("clearing old hw timer, nothing in the queue\n");
                 platform_stop_timer();
@@ -880,4 +880,4 @@ static void kernel_shell_init(uint level)
     }
 }
 
-LK_INIT_HOOK(kernel_shell, kernel_shell_init, LK_INIT_LEVEL_USER);
+LK_INIT_HOOK_DEFERRED(kernel_shell, kernel_shell_init, LK_INIT_LEVEL_USER);
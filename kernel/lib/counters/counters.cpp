@@ -6,6 +6,7 @@
 
 #include <lib/counters.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <arch/ops.h>
@@ -19,11 +20,16 @@
 
 #include <fbl/alloc_checker.h>
 #include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
 
 #include <lk/init.h>
 
 #include <lib/console.h>
 
+#include <vm/vm_object_paged.h>
+
+#include <zircon/kcounters.h>
+
 // The arena is allocated in kernel.ld linker script.
 extern uint64_t kcounters_arena[];
 
@@ -77,6 +83,46 @@ static void counters_init(unsigned level) {
     }
 }
 
+zx_status_t kcounters_to_vmos(fbl::RefPtr<VmObject>* desc_vmo,
+                              fbl::RefPtr<VmObject>* arena_vmo) {
+    const size_t num_counters = get_num_counters();
+    const size_t desc_size = sizeof(kcounters_desc_t) + num_counters * sizeof(kcounters_name_t);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[desc_size]());
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    auto desc = reinterpret_cast<kcounters_desc_t*>(buf.get());
+    desc->magic = KCOUNTERS_DESC_MAGIC;
+    desc->max_cpus = SMP_MAX_CPUS;
+    desc->num_counters = static_cast<uint32_t>(num_counters);
+    for (size_t ix = 0; ix != num_counters; ++ix) {
+        strlcpy(desc->names[ix].name, kcountdesc_begin[ix].name, sizeof(desc->names[ix].name));
+    }
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, ROUNDUP(desc_size, PAGE_SIZE),
+                                               &vmo);
+    if (status != ZX_OK)
+        return status;
+    size_t written;
+    status = vmo->Write(desc, 0, desc_size, &written);
+    if (status != ZX_OK)
+        return status;
+    vmo->set_name(KCOUNTERS_DESC_VMO_NAME, sizeof(KCOUNTERS_DESC_VMO_NAME) - 1);
+    *desc_vmo = fbl::move(vmo);
+
+    // kernel.ld gives the arena whole pages, so userspace sees the live
+    // values and nothing else.
+    const size_t arena_size = ROUNDUP(num_counters * SMP_MAX_CPUS * sizeof(uint64_t), PAGE_SIZE);
+    status = VmObjectPaged::CreateFromROData(kcounters_arena, arena_size, &vmo);
+    if (status != ZX_OK)
+        return status;
+    vmo->set_name(KCOUNTERS_ARENA_VMO_NAME, sizeof(KCOUNTERS_ARENA_VMO_NAME) - 1);
+    *arena_vmo = fbl::move(vmo);
+    return ZX_OK;
+}
+
 static void dump_counter(const k_counter_desc* desc) {
     size_t counter_index = kcounter_index(desc);
 
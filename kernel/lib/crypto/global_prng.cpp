@@ -6,11 +6,15 @@
 
 #include <lib/crypto/global_prng.h>
 
+#include <arch/ops.h>
 #include <assert.h>
 #include <ctype.h>
 #include <err.h>
 #include <explicit-memory/bytes.h>
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
+#include <fbl/auto_call.h>
 #include <kernel/auto_lock.h>
 #include <kernel/cmdline.h>
 #include <kernel/mutex.h>
@@ -33,11 +37,57 @@ namespace GlobalPRNG {
 
 static PRNG* kGlobalPrng = nullptr;
 
+// Bytes a per-CPU PRNG may produce before it is reseeded from the global PRNG.
+static constexpr size_t kPerCpuReseedBytes = 1u << 20;
+
+struct PerCpuPRNG {
+    PRNG* prng;
+    // Bytes drawn since the last reseed.
+    fbl::atomic<size_t> drawn;
+    // Value of |gGeneration| at the last reseed.
+    fbl::atomic<uint64_t> generation;
+};
+
+static PerCpuPRNG gPerCpu[SMP_MAX_CPUS];
+static fbl::atomic<bool> gPerCpuReady;
+// Incremented whenever entropy is added to the global PRNG after boot.
+static fbl::atomic<uint64_t> gGeneration;
+
 PRNG* GetInstance() {
     ASSERT(kGlobalPrng);
     return kGlobalPrng;
 }
 
+void AddEntropy(const void* data, size_t size) {
+    GetInstance()->AddEntropy(data, size);
+    gGeneration.fetch_add(1);
+}
+
+static void Reseed(PerCpuPRNG* cpu, uint64_t generation) {
+    uint8_t seed[PRNG::kMinEntropy];
+    kGlobalPrng->Draw(seed, sizeof(seed));
+    cpu->prng->AddEntropy(seed, sizeof(seed));
+    mandatory_memset(seed, 0, sizeof(seed));
+    cpu->drawn.store(0);
+    cpu->generation.store(generation);
+}
+
+void DrawPerCpu(void* out, size_t size) {
+    if (!gPerCpuReady.load()) {
+        GetInstance()->Draw(out, size);
+        return;
+    }
+    // Migrating to another CPU after this point is harmless; each per-CPU
+    // PRNG is thread-safe and merely uncontended in the common case.
+    PerCpuPRNG* cpu = &gPerCpu[arch_curr_cpu_num()];
+    uint64_t generation = gGeneration.load();
+    if (cpu->generation.load() != generation ||
+        cpu->drawn.fetch_add(size) + size > kPerCpuReseedBytes) {
+        Reseed(cpu, generation);
+    }
+    cpu->prng->Draw(out, size);
+}
+
 // Returns true if the kernel cmdline provided at least PRNG::kMinEntropy bytes
 // of entropy, and false otherwise.
 //
@@ -167,6 +217,23 @@ static void BecomeThreadSafe(uint level) {
     GetInstance()->BecomeThreadSafe();
 }
 
+// Instantiates the per-CPU PRNGs, each seeded from the global PRNG.  If any
+// allocation fails, |DrawPerCpu| keeps using the global PRNG.
+static void PerCpuSeed(uint level) {
+    uint8_t seed[PRNG::kMinEntropy];
+    auto cleanup = fbl::MakeAutoCall([&] { mandatory_memset(seed, 0, sizeof(seed)); });
+    for (PerCpuPRNG& cpu : gPerCpu) {
+        kGlobalPrng->Draw(seed, sizeof(seed));
+        fbl::AllocChecker ac;
+        cpu.prng = new (&ac) PRNG(seed, sizeof(seed));
+        if (!ac.check()) {
+            printf("WARNING: Failed to allocate per-CPU PRNGs.\n");
+            return;
+        }
+    }
+    gPerCpuReady.store(true);
+}
+
 } //namespace GlobalPRNG
 
 } // namespace crypto
@@ -177,3 +244,6 @@ LK_INIT_HOOK(global_prng_seed, crypto::GlobalPRNG::EarlyBootSeed,
 
 LK_INIT_HOOK(global_prng_thread_safe, crypto::GlobalPRNG::BecomeThreadSafe,
              LK_INIT_LEVEL_THREADING - 1)
+
+LK_INIT_HOOK(global_prng_per_cpu, crypto::GlobalPRNG::PerCpuSeed,
+             LK_INIT_LEVEL_THREADING)
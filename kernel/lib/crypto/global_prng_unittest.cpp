@@ -7,6 +7,7 @@
 #include <lib/crypto/global_prng.h>
 
 #include <stdint.h>
+#include <string.h>
 #include <unittest.h>
 
 namespace crypto {
@@ -24,10 +25,30 @@ bool identical(void*) {
     END_TEST;
 }
 
+bool per_cpu_draw(void*) {
+    BEGIN_TEST;
+
+    uint8_t zeros[32] = {0};
+    uint8_t out1[32] = {0};
+    uint8_t out2[32] = {0};
+    GlobalPRNG::DrawPerCpu(out1, sizeof(out1));
+    GlobalPRNG::DrawPerCpu(out2, sizeof(out2));
+    EXPECT_NE(0, memcmp(out1, zeros, sizeof(out1)), "draw did not fill buffer");
+    EXPECT_NE(0, memcmp(out1, out2, sizeof(out1)), "draws repeated");
+
+    // Adding entropy forces a reseed, after which draws still differ.
+    GlobalPRNG::AddEntropy(zeros, sizeof(zeros));
+    GlobalPRNG::DrawPerCpu(out1, sizeof(out1));
+    EXPECT_NE(0, memcmp(out1, out2, sizeof(out1)), "draws repeated after reseed");
+
+    END_TEST;
+}
+
 } // namespace
 
 UNITTEST_START_TESTCASE(global_prng_tests)
 UNITTEST("Identical", identical)
+UNITTEST("PerCpuDraw", per_cpu_draw)
 UNITTEST_END_TESTCASE(global_prng_tests, "global_prng",
                       "Validate global PRNG singleton",
                       nullptr, nullptr);
@@ -16,6 +16,17 @@ namespace GlobalPRNG {
 // guaranteed to be non-null.
 PRNG* GetInstance();
 
+// Mixes |size| bytes of entropy at |data| into the global PRNG and schedules
+// every per-CPU PRNG to reseed from it before its next draw.
+void AddEntropy(const void* data, size_t size);
+
+// Fills |out| with |size| bytes from the calling CPU's PRNG.  Per-CPU PRNGs are
+// seeded from the global PRNG and reseeded from it after a bounded amount of
+// output, so that frequent draws from many threads do not all contend on the
+// global instance.  Before the per-CPU PRNGs exist, this draws from the global
+// PRNG.  May block; |size| MUST NOT be greater than PRNG::kMaxDrawLen.
+void DrawPerCpu(void* out, size_t size);
+
 } //namespace GlobalPRNG
 
 } // namespace crypto
@@ -8,30 +8,38 @@
 
 #include <err.h>
 #include <dev/udisplay.h>
+#include <kernel/atomic.h>
+#include <kernel/cmdline.h>
+#include <kernel/mp.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
 #include <lib/io.h>
 #include <lib/version.h>
 #include <lk/init.h>
 #include <platform.h>
+#include <pow2.h>
+#include <stdlib.h>
 #include <string.h>
 #include <vm/vm.h>
 #include <zircon/types.h>
 
+// The log starts out in a static buffer of this size.  kernel.dlog.size-kb
+// may ask for a larger one, which replaces it once the heap is up.
 #define DLOG_SIZE (128u * 1024u)
-#define DLOG_MASK (DLOG_SIZE - 1u)
+#define DLOG_MAX_SIZE (16u * 1024u * 1024u)
 
-static_assert((DLOG_SIZE & DLOG_MASK) == 0u, "must be power of two");
+static_assert((DLOG_SIZE & (DLOG_SIZE - 1u)) == 0u, "must be power of two");
 static_assert(DLOG_MAX_RECORD <= DLOG_SIZE, "wat");
 static_assert((DLOG_MAX_RECORD & 3) == 0, "E_DONT_DO_THAT");
 
 static uint8_t DLOG_DATA[DLOG_SIZE];
 
 static dlog_t DLOG = {
-    .lock = SPIN_LOCK_INITIAL_VALUE,
     .head = 0,
+    .commit = 0,
     .tail = 0,
     .data = DLOG_DATA,
+    .size = DLOG_SIZE,
     .event = EVENT_INITIAL_VALUE(DLOG.event, 0, EVENT_FLAG_AUTOUNSIGNAL),
 
     .readers_lock = MUTEX_INITIAL_VALUE(DLOG.readers_lock),
@@ -58,15 +66,34 @@ static dlog_t DLOG = {
 // Tail indicates the oldest message in the debug log to read
 // from, Head indicates the next space in the debug log to write
 // a new message to.  They are clipped to the actual buffer by
-// DLOG_MASK.
+// the log size (a power of two) minus one.
 //
 //       T                     T
 //  [....XXXX....]  [XX........XX]
 //           H         H
+//
+// There is no lock.  A writer reserves its space by moving head forward
+// with a compare-and-swap, first moving tail past as many old records as
+// it needs to make room.  Once it has copied its record in it waits for
+// any writer which reserved space before it to commit, then moves commit
+// past its own record.  Interrupts are off from reservation to commit, so
+// the wait is only ever for a writer running on another cpu.
+//
+// Readers never block writers.  They copy records out of [tail, commit)
+// and then check that tail has not passed the record they copied; if it
+// has, a writer may have overwritten it, and the copy is thrown away.
 
 
 #define ALIGN4(n) (((n) + 3) & (~3))
 
+static inline size_t dlog_mask(const dlog_t* log) {
+    return log->size - 1u;
+}
+
+static inline bool dlog_lapped(uint64_t tail, uint64_t rtail) {
+    return (int64_t)(tail - rtail) > 0;
+}
+
 zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     dlog_t* log = &DLOG;
 
@@ -99,18 +126,35 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     }
 
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    // Discard records at tail until there is enough
-    // space for the new record.
-    while ((log->head - log->tail) > (DLOG_SIZE - wiresize)) {
-        uint32_t header = *((uint32_t*) (log->data + (log->tail & DLOG_MASK)));
-        log->tail += DLOG_HDR_GET_FIFOLEN(header);
+    // Reserve space for the new record, discarding records at tail until
+    // there is enough of it.  Tail is loaded first: it never passes head, so
+    // a head loaded after it is never behind it.
+    uint64_t head;
+    for (;;) {
+        uint64_t tail = atomic_load_u64(&log->tail);
+        head = atomic_load_u64(&log->head);
+        if ((head + wiresize - tail) > log->size) {
+            if (tail == atomic_load_u64(&log->commit)) {
+                // The oldest record is still being written.
+                arch_spinloop_pause();
+            } else {
+                // If another writer moves tail first, this reads a stale
+                // header, but the compare-and-swap then fails.
+                uint32_t header = *((volatile uint32_t*) (log->data + (tail & dlog_mask(log))));
+                atomic_cmpxchg_u64(&log->tail, &tail, tail + DLOG_HDR_GET_FIFOLEN(header));
+            }
+            continue;
+        }
+        if (atomic_cmpxchg_u64(&log->head, &head, head + wiresize)) {
+            break;
+        }
     }
 
-    size_t offset = (log->head & DLOG_MASK);
+    size_t offset = (head & dlog_mask(log));
 
-    size_t fifospace = DLOG_SIZE - offset;
+    size_t fifospace = log->size - offset;
 
     if (fifospace >= wiresize) {
         // everything fits in one write, simple case!
@@ -129,7 +173,12 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
         memcpy(log->data + offset, ptr, fifospace);
         memcpy(log->data, ptr + fifospace, len - fifospace);
     }
-    log->head += wiresize;
+
+    // Publish the record once everything reserved before it is published.
+    while (atomic_load_u64(&log->commit) != head) {
+        arch_spinloop_pause();
+    }
+    atomic_store_u64(&log->commit, head + wiresize);
 
     // Need to check this before re-releasing the log lock, since we may
     // re-enable interrupts while doing that.  If interrupts are enabled when we
@@ -143,7 +192,7 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     // C2: Running this thread, evaluate arch_curr_cpu_num() -> C2
     bool holding_thread_lock = spin_lock_holder_cpu(&thread_lock) == arch_curr_cpu_num();
 
-    spin_unlock_irqrestore(&log->lock, state);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     // if we happen to be called from within the global thread lock, use a
     // special version of event signal
@@ -156,55 +205,100 @@ zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
     return ZX_OK;
 }
 
-// TODO: support reading multiple messages at a time
-// TODO: filter with flags
-zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, size_t* _actual) {
-    // must be room for worst-case read
-    if (len < DLOG_MAX_RECORD) {
-        return ZX_ERR_BUFFER_TOO_SMALL;
-    }
-
+// Copies records starting at the reader's position into |ptr|, up to
+// |max_records| of them or as many as fit in |len| bytes.  Each record is
+// padded to a 4-byte boundary with zeroes.  |last_len| is set to the unpadded
+// length of the last record copied.
+static size_t dlog_copy_records(dlog_reader_t* rdr, void* ptr, size_t len,
+                                size_t max_records, size_t* last_len) {
     dlog_t* log = rdr->log;
-    zx_status_t status = ZX_ERR_SHOULD_WAIT;
-
-    spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
-
-    size_t rtail = rdr->tail;
-
-    // If the read-tail is not within the range of log-tail..log-head
-    // this reader has been lapped by a writer and we reset our read-tail
-    // to the current log-tail.
-    //
-    if ((log->head - log->tail) < (log->head - rtail)) {
-        rtail = log->tail;
-    }
-
-    if (rtail != log->head) {
-        size_t offset = (rtail & DLOG_MASK);
-        uint32_t header = *((uint32_t*) (log->data + offset));
+    uint64_t rtail = rdr->tail;
+    size_t offset = 0;
+
+    while (max_records > 0) {
+        uint64_t commit = atomic_load_u64(&log->commit);
+
+        // If the read-tail is no longer within the range of log-tail..
+        // log-commit this reader has been lapped by a writer and we reset
+        // our read-tail to the current log-tail.
+        uint64_t tail = atomic_load_u64(&log->tail);
+        if (dlog_lapped(tail, rtail)) {
+            rtail = tail;
+        }
+        if (rtail == commit) {
+            break;
+        }
 
+        size_t roffset = (rtail & dlog_mask(log));
+        uint32_t header = *((volatile uint32_t*) (log->data + roffset));
         size_t actual = DLOG_HDR_GET_READLEN(header);
-        size_t fifospace = DLOG_SIZE - offset;
+        if (ALIGN4(actual) > (len - offset)) {
+            // If this record was overwritten under us, its length is junk;
+            // check before giving up on it.
+            atomic_fence_acquire();
+            if (dlog_lapped(atomic_load_u64(&log->tail), rtail)) {
+                continue;
+            }
+            break;
+        }
 
+        size_t fifospace = log->size - roffset;
         if (fifospace >= actual) {
-            memcpy(ptr, log->data + offset, actual);
+            memcpy(ptr + offset, log->data + roffset, actual);
         } else {
-            memcpy(ptr, log->data + offset, fifospace);
-            memcpy(ptr + fifospace, log->data, actual - fifospace);
+            memcpy(ptr + offset, log->data + roffset, fifospace);
+            memcpy(ptr + offset + fifospace, log->data, actual - fifospace);
+        }
+
+        // A writer moves tail past a record before it overwrites any of it,
+        // so if tail has not passed the record now, the copy is intact.
+        atomic_fence_acquire();
+        if (dlog_lapped(atomic_load_u64(&log->tail), rtail)) {
+            continue;
         }
 
-        *_actual = actual;
-        status = ZX_OK;
+        memset(ptr + offset + actual, 0, ALIGN4(actual) - actual);
+        offset += ALIGN4(actual);
+        *last_len = actual;
+        max_records--;
 
         rtail += DLOG_HDR_GET_FIFOLEN(header);
     }
 
     rdr->tail = rtail;
+    return offset;
+}
+
+// TODO: filter with flags
+zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, size_t* _actual) {
+    // must be room for worst-case read
+    if (len < DLOG_MAX_RECORD) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
+    size_t actual;
+    if (dlog_copy_records(rdr, ptr, len, 1u, &actual) == 0) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+
+    *_actual = actual;
+    return ZX_OK;
+}
 
-    spin_unlock_irqrestore(&log->lock, state);
+zx_status_t dlog_read_multiple(dlog_reader_t* rdr, void* ptr, size_t len, size_t* _actual) {
+    // must be room for worst-case read
+    if (len < DLOG_MAX_RECORD) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
 
-    return status;
+    size_t last_len;
+    size_t actual = dlog_copy_records(rdr, ptr, len, SIZE_MAX, &last_len);
+    if (actual == 0) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+
+    *_actual = actual;
+    return ZX_OK;
 }
 
 void dlog_reader_init(dlog_reader_t* rdr, void (*notify)(void*), void* cookie) {
@@ -217,13 +311,8 @@ void dlog_reader_init(dlog_reader_t* rdr, void (*notify)(void*), void* cookie) {
     mutex_acquire(&log->readers_lock);
     list_add_tail(&log->readers, &rdr->node);
 
-    bool do_notify = false;
-
-    spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
-    rdr->tail = log->tail;
-    do_notify = (log->tail != log->head);
-    spin_unlock_irqrestore(&log->lock, state);
+    rdr->tail = atomic_load_u64(&log->tail);
+    bool do_notify = (rdr->tail != atomic_load_u64(&log->commit));
 
     // simulate notify callback for events that arrived
     // before we were initialized
@@ -352,9 +441,52 @@ void dlog_bluescreen_init(void) {
     }
 }
 
+// Moves the log into a buffer of the size asked for on the command line,
+// if that is larger than the one it booted with.  This runs before any other
+// cpu is started and with interrupts off, so nothing else can be touching
+// the log.
+static void dlog_resize(void) {
+    dlog_t* log = &DLOG;
+
+    uint64_t size = cmdline_get_uint64("kernel.dlog.size-kb", DLOG_SIZE / 1024u) * 1024u;
+    if (size <= log->size) {
+        return;
+    }
+    if (size > DLOG_MAX_SIZE) {
+        size = DLOG_MAX_SIZE;
+    }
+    size = 1ul << log2_ulong_ceil(size);
+
+    if (mp_get_online_mask() != cpu_num_to_mask(arch_curr_cpu_num())) {
+        printf("dlog: too late to resize the debuglog\n");
+        return;
+    }
+
+    uint8_t* data = malloc(size);
+    if (data == NULL) {
+        printf("dlog: failed to allocate a %" PRIu64 " byte debuglog\n", size);
+        return;
+    }
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    // Positions are absolute, so every byte of every record moves to the
+    // same position in the new buffer.
+    for (uint64_t pos = log->tail; pos != log->commit; pos++) {
+        data[pos & (size - 1u)] = ((uint8_t*)log->data)[pos & dlog_mask(log)];
+    }
+    log->data = data;
+    log->size = size;
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
 static void dlog_init_hook(uint level) {
     thread_t* rthread;
 
+    dlog_resize();
+
     if ((rthread = thread_create("debuglog-notifier", debuglog_notifier, NULL,
                                  HIGH_PRIORITY - 1, DEFAULT_STACK_SIZE)) != NULL) {
         thread_resume(rthread);
@@ -21,12 +21,16 @@ typedef struct dlog_record dlog_record_t;
 typedef struct dlog_reader dlog_reader_t;
 
 struct dlog {
-    spin_lock_t lock;
-
-    size_t head;
-    size_t tail;
+    // Writers reserve space at |head|, fill in their record, and then
+    // publish it by moving |commit| past it, in the order they reserved.
+    // Readers only look at records in [tail, commit).  All three only ever
+    // increase, and are updated with atomic operations rather than a lock.
+    uint64_t head;
+    uint64_t commit;
+    uint64_t tail;
 
     void* data;
+    size_t size;
 
     bool panic;
 
@@ -40,7 +44,7 @@ struct dlog_reader {
     struct list_node node;
 
     dlog_t* log;
-    size_t tail;
+    uint64_t tail;
 
     void (*notify)(void* cookie);
     void *cookie;
@@ -78,6 +82,12 @@ void dlog_reader_destroy(dlog_reader_t* rdr);
 zx_status_t dlog_write(uint32_t flags, const void* ptr, size_t len);
 zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, size_t* actual);
 
+// Copies as many whole records as fit in |len| bytes to |ptr|.  Each record
+// starts at a 4-byte aligned offset, its length rounded up to a multiple of 4
+// (with the padding zeroed) after the one before it.  Fails with
+// ZX_ERR_SHOULD_WAIT if there were no records to read.
+zx_status_t dlog_read_multiple(dlog_reader_t* rdr, void* ptr, size_t len, size_t* actual);
+
 // used by sys_debug_write()
 void dlog_serial_write(const char* data, size_t len);
 
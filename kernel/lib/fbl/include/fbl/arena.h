@@ -34,6 +34,9 @@ public:
     zx_status_t Init(const char* name, size_t ob_size, size_t max_count);
     void* Alloc();
     void Free(void* addr);
+    // Unlike Alloc() and Free(), in_range() may be called without holding
+    // the lock that serializes them; it observes some recent value of the
+    // allocation boundary.
     bool in_range(void* addr) const {
         return data_.InRange(static_cast<char*>(addr));
     }
@@ -82,9 +85,11 @@ private:
         void Push(void* p);
 
         // Returns true if |addr| could have been returned by Pop and has
-        // not been reclaimed by Push.
+        // not been reclaimed by Push. Safe to call concurrently with
+        // Pop and Push.
         bool InRange(void* addr) const {
-            return (addr >= start_ && addr < top_);
+            return (addr >= start_ &&
+                    addr < __atomic_load_n(&top_, __ATOMIC_ACQUIRE));
         }
 
         // The lowest address of the memory managed by this Pool.
@@ -105,6 +110,7 @@ private:
         size_t slot_size_;
         char* start_;
         char* top_;           // |start|..|top| contains all allocated slots.
+                              // Written atomically; see InRange().
         char* committed_;     // |start|..|mapped| is committed.
         char* committed_max_; // Largest committed_ value seen.
         char* end_;           // |mapped|..|end| is not committed.
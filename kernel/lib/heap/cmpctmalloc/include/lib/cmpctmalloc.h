@@ -19,6 +19,16 @@ void* cmpct_realloc(void*, size_t);
 void cmpct_free(void*);
 void* cmpct_memalign(size_t size, size_t alignment);
 
+// Allocates up to |count| blocks of |size| bytes into |ptrs| under a single
+// acquisition of the heap lock, and returns how many it got. |size| must be
+// non-zero and well below the large allocation threshold.
+size_t cmpct_alloc_batch(size_t size, void** ptrs, size_t count);
+// Frees |count| blocks under a single acquisition of the heap lock.
+void cmpct_free_batch(void** ptrs, size_t count);
+// The number of bytes usable at |payload|, which is at least the size it was
+// allocated with.
+size_t cmpct_usable_size(const void* payload);
+
 void cmpct_init(void);
 void cmpct_dump(bool panic_time);
 void cmpct_get_info(size_t* size_bytes, size_t* free_bytes);
@@ -15,11 +15,15 @@
 #include <err.h>
 #include <list.h>
 #include <arch/ops.h>
+#include <kernel/align.h>
 #include <kernel/spinlock.h>
+#include <vm/page.h>
+#include <vm/physmap.h>
 #include <vm/vm.h>
 #include <vm/pmm.h>
 #include <lib/cmpctmalloc.h>
 #include <lib/console.h>
+#include <inttypes.h>
 
 #define LOCAL_TRACE 0
 
@@ -38,13 +42,402 @@ static bool heap_trace = false;
 #define heap_trace (false)
 #endif
 
+/* allocations of at least this size bypass cmpctmalloc and get whole pages
+ * straight from the pmm, so that big, often short lived buffers (channel
+ * messages, fifo buffers) neither fragment the heap nor grow it for good.
+ * the first page is flagged VM_PAGE_FLAG_HEAP_LARGE and records the page
+ * count, which is how free() tells them apart. */
+#define HEAP_LARGE_THRESHOLD (8 * PAGE_SIZE)
+
+/* recently freed large chunks, reused by allocations of the same page count
+ * before going back to the pmm. */
+#define HEAP_LARGE_CACHE_SIZE 8
+#define HEAP_LARGE_CACHE_MAX_PAGES 256
+
+/* large allocation size histogram, by power of two pages from
+ * HEAP_LARGE_THRESHOLD up, the last bucket taking everything bigger */
+#define HEAP_LARGE_BUCKETS 6
+
+static struct {
+    spin_lock_t lock;
+
+    size_t cached;
+    size_t cached_pages;
+    struct {
+        void *ptr;
+        size_t pages;
+    } cache[HEAP_LARGE_CACHE_SIZE];
+
+    /* statistics */
+    size_t pages_in_use;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t cache_hits;
+    uint64_t failures;   /* fell back to cmpctmalloc */
+    uint64_t buckets[HEAP_LARGE_BUCKETS];
+} heap_large;
+
+static size_t heap_large_pages(void *ptr)
+{
+    if (!IS_PAGE_ALIGNED((uintptr_t)ptr) || !is_physmap_addr(ptr))
+        return 0;
+    const vm_page_t *p = paddr_to_vm_page(physmap_to_paddr(ptr));
+    if (!p || p->state != VM_PAGE_STATE_HEAP || !(p->flags & VM_PAGE_FLAG_HEAP_LARGE))
+        return 0;
+    return p->heap.large_pages;
+}
+
+static uint heap_large_bucket(size_t pages)
+{
+    uint bucket = 0;
+    for (size_t limit = 2 * HEAP_LARGE_THRESHOLD / PAGE_SIZE;
+         pages >= limit && bucket < HEAP_LARGE_BUCKETS - 1; limit *= 2)
+        bucket++;
+    return bucket;
+}
+
+/* returns NULL if the pages can't be had, for the caller to fall back on
+ * cmpctmalloc */
+static void *heap_large_alloc(size_t size)
+{
+    const size_t pages = ROUNDUP(size, PAGE_SIZE) / PAGE_SIZE;
+
+    void *ptr = NULL;
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&heap_large.lock, state);
+    for (size_t i = heap_large.cached; i-- > 0;) {
+        if (heap_large.cache[i].pages == pages) {
+            ptr = heap_large.cache[i].ptr;
+            heap_large.cache[i] = heap_large.cache[--heap_large.cached];
+            heap_large.cached_pages -= pages;
+            heap_large.cache_hits++;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&heap_large.lock, state);
+
+    if (!ptr) {
+        ptr = heap_page_alloc(pages);
+        if (!ptr) {
+            spin_lock_irqsave(&heap_large.lock, state);
+            heap_large.failures++;
+            spin_unlock_irqrestore(&heap_large.lock, state);
+            return NULL;
+        }
+        vm_page_t *p = paddr_to_vm_page(physmap_to_paddr(ptr));
+        p->flags |= VM_PAGE_FLAG_HEAP_LARGE;
+        p->heap.large_pages = pages;
+    }
+
+    spin_lock_irqsave(&heap_large.lock, state);
+    heap_large.allocs++;
+    heap_large.pages_in_use += pages;
+    heap_large.buckets[heap_large_bucket(pages)]++;
+    spin_unlock_irqrestore(&heap_large.lock, state);
+
+    return ptr;
+}
+
+static void heap_large_release(void *ptr, size_t pages)
+{
+    vm_page_t *p = paddr_to_vm_page(physmap_to_paddr(ptr));
+    p->flags &= ~VM_PAGE_FLAG_HEAP_LARGE;
+    heap_page_free(ptr, pages);
+}
+
+static void heap_large_free(void *ptr, size_t pages)
+{
+    void *evict = NULL;
+    size_t evict_pages = 0;
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&heap_large.lock, state);
+    heap_large.frees++;
+    heap_large.pages_in_use -= pages;
+    if (pages <= HEAP_LARGE_CACHE_MAX_PAGES) {
+        /* make room by evicting the oldest chunk, at the front */
+        if (heap_large.cached > 0 &&
+            (heap_large.cached == HEAP_LARGE_CACHE_SIZE ||
+             heap_large.cached_pages + pages > HEAP_LARGE_CACHE_MAX_PAGES)) {
+            evict = heap_large.cache[0].ptr;
+            evict_pages = heap_large.cache[0].pages;
+            heap_large.cached--;
+            heap_large.cached_pages -= evict_pages;
+            memmove(&heap_large.cache[0], &heap_large.cache[1],
+                    heap_large.cached * sizeof(heap_large.cache[0]));
+        }
+        if (heap_large.cached < HEAP_LARGE_CACHE_SIZE &&
+            heap_large.cached_pages + pages <= HEAP_LARGE_CACHE_MAX_PAGES) {
+            heap_large.cache[heap_large.cached].ptr = ptr;
+            heap_large.cache[heap_large.cached].pages = pages;
+            heap_large.cached++;
+            heap_large.cached_pages += pages;
+            ptr = NULL;
+        }
+    }
+    spin_unlock_irqrestore(&heap_large.lock, state);
+
+    if (evict)
+        heap_large_release(evict, evict_pages);
+    if (ptr)
+        heap_large_release(ptr, pages);
+}
+
+/* return every cached large chunk to the pmm */
+static void heap_large_flush(void)
+{
+    for (;;) {
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&heap_large.lock, state);
+        if (heap_large.cached == 0) {
+            spin_unlock_irqrestore(&heap_large.lock, state);
+            return;
+        }
+        heap_large.cached--;
+        void *ptr = heap_large.cache[heap_large.cached].ptr;
+        size_t pages = heap_large.cache[heap_large.cached].pages;
+        heap_large.cached_pages -= pages;
+        spin_unlock_irqrestore(&heap_large.lock, state);
+
+        heap_large_release(ptr, pages);
+    }
+}
+
+static void heap_large_dump(void)
+{
+    printf("\tlarge allocations (>= %zu bytes):\n", (size_t)HEAP_LARGE_THRESHOLD);
+    printf("\t\tin use %zu pages, cached %zu chunks %zu pages\n",
+           heap_large.pages_in_use, heap_large.cached, heap_large.cached_pages);
+    printf("\t\tallocs %" PRIu64 " frees %" PRIu64 " cache hits %" PRIu64
+           " cmpctmalloc fallbacks %" PRIu64 "\n",
+           heap_large.allocs, heap_large.frees, heap_large.cache_hits, heap_large.failures);
+    size_t pages = HEAP_LARGE_THRESHOLD / PAGE_SIZE;
+    for (uint i = 0; i < HEAP_LARGE_BUCKETS; i++, pages *= 2) {
+        if (i < HEAP_LARGE_BUCKETS - 1) {
+            printf("\t\t%4zu-%4zu pages: %" PRIu64 "\n", pages, 2 * pages - 1,
+                   heap_large.buckets[i]);
+        } else {
+            printf("\t\t%4zu+     pages: %" PRIu64 "\n", pages, heap_large.buckets[i]);
+        }
+    }
+}
+
+/* per cpu caches of small free blocks in front of cmpctmalloc, so that the
+ * common small allocations don't all serialize on the heap lock. each cpu
+ * keeps a magazine of blocks per size class, refilled from and flushed back to
+ * cmpctmalloc in batches. the blocks stay allocated as far as cmpctmalloc is
+ * concerned, so they are only returned to it by a flush or heap_trim(). */
+#define HEAP_CACHE_MAGAZINE_SIZE 16
+#define HEAP_CACHE_BATCH (HEAP_CACHE_MAGAZINE_SIZE / 2)
+
+static const size_t heap_cache_class_size[] = {
+    32, 64, 96, 128, 192, 256, 384, 512,
+};
+#define HEAP_CACHE_CLASSES countof(heap_cache_class_size)
+#define HEAP_CACHE_MAX_SIZE (heap_cache_class_size[HEAP_CACHE_CLASSES - 1])
+
+struct heap_cache_magazine {
+    size_t count;
+    void *blocks[HEAP_CACHE_MAGAZINE_SIZE];
+
+    /* statistics */
+    uint64_t hits;      /* allocations satisfied from the magazine */
+    uint64_t refills;   /* allocations that had to refill it */
+    uint64_t frees;     /* frees into the magazine */
+    uint64_t flushes;   /* times a full magazine was flushed */
+};
+
+struct heap_cache {
+    /* only ever contended by heap_trim() on another cpu */
+    spin_lock_t lock;
+    struct heap_cache_magazine mag[HEAP_CACHE_CLASSES];
+} __CPU_ALIGN;
+
+static struct heap_cache heap_caches[SMP_MAX_CPUS];
+
+/* smallest class that fits an allocation of |size|, or -1 */
+static int heap_cache_class_for_alloc(size_t size)
+{
+    for (uint i = 0; i < HEAP_CACHE_CLASSES; i++) {
+        if (size <= heap_cache_class_size[i])
+            return i;
+    }
+    return -1;
+}
+
+/* class a freed block of |usable| bytes can be handed out again from, or -1
+ * if it is too far from any class to be worth caching */
+static int heap_cache_class_for_free(size_t usable)
+{
+    for (int i = HEAP_CACHE_CLASSES - 1; i >= 0; i--) {
+        if (usable >= heap_cache_class_size[i])
+            return (usable < 2 * heap_cache_class_size[i]) ? i : -1;
+    }
+    return -1;
+}
+
+/* disables interrupts, which keeps us on this cpu, and locks its cache */
+static struct heap_cache *heap_cache_lock(spin_lock_saved_state_t *state)
+    TA_NO_THREAD_SAFETY_ANALYSIS
+{
+    arch_interrupt_save(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    struct heap_cache *cache = &heap_caches[arch_curr_cpu_num()];
+    spin_lock(&cache->lock);
+    return cache;
+}
+
+static void heap_cache_unlock(struct heap_cache *cache, spin_lock_saved_state_t state)
+    TA_NO_THREAD_SAFETY_ANALYSIS
+{
+    spin_unlock(&cache->lock);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
+static void *heap_cache_refill(uint cls)
+{
+    void *blocks[HEAP_CACHE_BATCH];
+    size_t count = cmpct_alloc_batch(heap_cache_class_size[cls], blocks, HEAP_CACHE_BATCH);
+    if (count == 0)
+        return NULL;
+
+    /* keep the first block for the caller and stash the rest on whichever cpu
+     * we are on now, which need not be the one that missed */
+    spin_lock_saved_state_t state;
+    struct heap_cache *cache = heap_cache_lock(&state);
+    struct heap_cache_magazine *mag = &cache->mag[cls];
+    mag->refills++;
+    size_t i = 1;
+    while (i < count && mag->count < HEAP_CACHE_MAGAZINE_SIZE)
+        mag->blocks[mag->count++] = blocks[i++];
+    heap_cache_unlock(cache, state);
+
+    if (i < count)
+        cmpct_free_batch(&blocks[i], count - i);
+    return blocks[0];
+}
+
+static void *heap_cache_alloc(size_t size)
+{
+    if (size >= HEAP_LARGE_THRESHOLD) {
+        void *ptr = heap_large_alloc(size);
+        if (ptr)
+            return ptr;
+        return cmpct_alloc(size);
+    }
+
+    int cls = heap_cache_class_for_alloc(size);
+    if (cls < 0 || size == 0)
+        return cmpct_alloc(size);
+
+    void *ptr = NULL;
+    spin_lock_saved_state_t state;
+    struct heap_cache *cache = heap_cache_lock(&state);
+    struct heap_cache_magazine *mag = &cache->mag[cls];
+    if (likely(mag->count > 0)) {
+        ptr = mag->blocks[--mag->count];
+        mag->hits++;
+    }
+    heap_cache_unlock(cache, state);
+
+    if (likely(ptr))
+        return ptr;
+    return heap_cache_refill(cls);
+}
+
+static void heap_cache_free(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    size_t large_pages = heap_large_pages(ptr);
+    if (large_pages) {
+        heap_large_free(ptr, large_pages);
+        return;
+    }
+
+    int cls = heap_cache_class_for_free(cmpct_usable_size(ptr));
+    if (cls < 0) {
+        cmpct_free(ptr);
+        return;
+    }
+
+    void *flush[HEAP_CACHE_BATCH];
+    size_t flush_count = 0;
+    spin_lock_saved_state_t state;
+    struct heap_cache *cache = heap_cache_lock(&state);
+    struct heap_cache_magazine *mag = &cache->mag[cls];
+    if (unlikely(mag->count == HEAP_CACHE_MAGAZINE_SIZE)) {
+        /* full, so hand the coldest half back to cmpctmalloc */
+        flush_count = HEAP_CACHE_BATCH;
+        memcpy(flush, mag->blocks, sizeof(flush));
+        memmove(mag->blocks, mag->blocks + flush_count,
+                (mag->count - flush_count) * sizeof(void *));
+        mag->count -= flush_count;
+        mag->flushes++;
+    }
+    mag->blocks[mag->count++] = ptr;
+    mag->frees++;
+    heap_cache_unlock(cache, state);
+
+    if (flush_count)
+        cmpct_free_batch(flush, flush_count);
+}
+
+/* return every cached block on every cpu to cmpctmalloc */
+static void heap_cache_flush_all(void)
+{
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        struct heap_cache *cache = &heap_caches[cpu];
+        for (uint cls = 0; cls < HEAP_CACHE_CLASSES; cls++) {
+            void *blocks[HEAP_CACHE_MAGAZINE_SIZE];
+            spin_lock_saved_state_t state;
+            spin_lock_irqsave(&cache->lock, state);
+            struct heap_cache_magazine *mag = &cache->mag[cls];
+            size_t count = mag->count;
+            memcpy(blocks, mag->blocks, count * sizeof(void *));
+            mag->count = 0;
+            spin_unlock_irqrestore(&cache->lock, state);
+
+            if (count)
+                cmpct_free_batch(blocks, count);
+        }
+    }
+}
+
+/* racy sums across cpus, good enough for a debug dump */
+static void heap_cache_dump(void)
+{
+    printf("\tper cpu cache:\n");
+    printf("\t%6s %8s %12s %12s %12s %12s\n",
+           "size", "cached", "hits", "refills", "frees", "flushes");
+    for (uint cls = 0; cls < HEAP_CACHE_CLASSES; cls++) {
+        size_t cached = 0;
+        uint64_t hits = 0, refills = 0, frees = 0, flushes = 0;
+        for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+            const struct heap_cache_magazine *mag = &heap_caches[cpu].mag[cls];
+            cached += mag->count;
+            hits += mag->hits;
+            refills += mag->refills;
+            frees += mag->frees;
+            flushes += mag->flushes;
+        }
+        printf("\t%6zu %8zu %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+               heap_cache_class_size[cls], cached, hits, refills, frees, flushes);
+    }
+}
+
 void heap_init(void)
 {
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++)
+        spin_lock_init(&heap_caches[cpu].lock);
+    spin_lock_init(&heap_large.lock);
     cmpct_init();
 }
 
 void heap_trim(void)
 {
+    heap_cache_flush_all();
+    heap_large_flush();
     cmpct_trim();
 }
 
@@ -54,7 +447,7 @@ void *malloc(size_t size)
 
     LTRACEF("size %zu\n", size);
 
-    void *ptr = cmpct_alloc(size);
+    void *ptr = heap_cache_alloc(size);
     if (unlikely(heap_trace))
         printf("caller %p malloc %zu -> %p\n", __GET_CALLER(), size, ptr);
 
@@ -71,7 +464,11 @@ void *memalign(size_t boundary, size_t size)
 
     LTRACEF("boundary %zu, size %zu\n", boundary, size);
 
-    void *ptr = cmpct_memalign(size, boundary);
+    void *ptr = NULL;
+    if (size >= HEAP_LARGE_THRESHOLD && boundary <= PAGE_SIZE)
+        ptr = heap_large_alloc(size);
+    if (!ptr)
+        ptr = cmpct_memalign(size, boundary);
     if (unlikely(heap_trace))
         printf("caller %p memalign %zu, %zu -> %p\n", __GET_CALLER(), boundary, size, ptr);
 
@@ -90,7 +487,7 @@ void *calloc(size_t count, size_t size)
 
     size_t realsize = count * size;
 
-    void *ptr = cmpct_alloc(realsize);
+    void *ptr = heap_cache_alloc(realsize);
     if (likely(ptr))
         memset(ptr, 0, realsize);
     if (unlikely(heap_trace))
@@ -104,7 +501,24 @@ void *realloc(void *ptr, size_t size)
 
     LTRACEF("ptr %p, size %zu\n", ptr, size);
 
-    void *ptr2 = cmpct_realloc(ptr, size);
+    void *ptr2;
+    size_t large_pages = ptr ? heap_large_pages(ptr) : 0;
+    if (large_pages || size >= HEAP_LARGE_THRESHOLD) {
+        /* moving into, out of or between large allocations */
+        if (large_pages && size >= HEAP_LARGE_THRESHOLD && size <= large_pages * PAGE_SIZE) {
+            ptr2 = ptr;
+        } else {
+            size_t old_size = large_pages ? large_pages * PAGE_SIZE :
+                              ptr ? cmpct_usable_size(ptr) : 0;
+            ptr2 = heap_cache_alloc(size);
+            if (ptr2 && ptr) {
+                memcpy(ptr2, ptr, MIN(size, old_size));
+                heap_cache_free(ptr);
+            }
+        }
+    } else {
+        ptr2 = cmpct_realloc(ptr, size);
+    }
     if (unlikely(heap_trace))
         printf("caller %p realloc %p, %zu -> %p\n", __GET_CALLER(), ptr, size, ptr2);
 
@@ -123,16 +537,28 @@ void free(void *ptr)
     if (unlikely(heap_trace))
         printf("caller %p free %p\n", __GET_CALLER(), ptr);
 
-    cmpct_free(ptr);
+    heap_cache_free(ptr);
 }
 
 static void heap_dump(bool panic_time)
 {
     cmpct_dump(panic_time);
+
+    /* how much of what cmpctmalloc holds is sitting free in its lists */
+    size_t size, free;
+    cmpct_get_info(&size, &free);
+    printf("\tfragmentation: %zu of %zu bytes free (%zu%%)\n",
+           free, size, size ? free * 100 / size : 0);
+
+    heap_cache_dump();
+    heap_large_dump();
 }
 
 void heap_get_info(size_t *size_bytes, size_t *free_bytes) {
     cmpct_get_info(size_bytes, free_bytes);
+    /* racy, like the rest of the stats */
+    *size_bytes += (heap_large.pages_in_use + heap_large.cached_pages) * PAGE_SIZE;
+    *free_bytes += heap_large.cached_pages * PAGE_SIZE;
 }
 
 static void heap_test(void)
@@ -7,12 +7,15 @@
 #include <hypervisor/guest_physical_address_space.h>
 
 #include <arch/mmu.h>
+#include <lib/counters.h>
 #include <vm/arch_vm_aspace.h>
 #include <vm/fault.h>
 #include <vm/vm_object_physical.h>
 #include <fbl/alloc_checker.h>
 
 static constexpr uint kPfFlags = VMM_PF_FLAG_WRITE | VMM_PF_FLAG_SW_FAULT;
+static constexpr uint kGuestPfFlags =
+    VMM_PF_FLAG_HW_FAULT | VMM_PF_FLAG_WRITE | VMM_PF_FLAG_INSTRUCTION;
 static constexpr uint kMmuFlags =
     ARCH_MMU_FLAG_CACHED |
     ARCH_MMU_FLAG_PERM_READ |
@@ -28,6 +31,8 @@ static constexpr uint kGuestMmuFlags =
     ARCH_MMU_FLAG_PERM_READ |
     ARCH_MMU_FLAG_PERM_WRITE;
 
+KCOUNTER(guest_page_faults, "kernel.hypervisor.page_faults");
+
 namespace {
 
 // Locate a VMO for a given vaddr.
@@ -79,12 +84,22 @@ zx_status_t GuestPhysicalAddressSpace::Create(fbl::RefPtr<VmObject> guest_phys_m
     if (status != ZX_OK)
         return status;
 
+    // Map the pages of the VMO which are already committed, so that the guest
+    // doesn't take a fault on each of them. Physically contiguous runs are
+    // mapped with large pages where they are suitably aligned, which takes
+    // pressure off the TLB. Pages committed later are faulted in on demand.
+    status = mapping->MapRange(0, guest_phys_mem->size(), /* commit */ false);
+    if (status != ZX_OK) {
+        mapping->Destroy();
+        return status;
+    }
+
     *_gpas = fbl::move(gpas);
     return ZX_OK;
 }
 
 GuestPhysicalAddressSpace::GuestPhysicalAddressSpace(fbl::RefPtr<VmObject> guest_phys_mem)
-    : guest_phys_mem_(guest_phys_mem) {}
+    : guest_phys_mem_(guest_phys_mem), page_faults_(0u), trap_faults_(0u) {}
 
 GuestPhysicalAddressSpace::~GuestPhysicalAddressSpace() {
     // VmAspace maintains a circular reference with it's root VMAR. We need to
@@ -141,6 +156,18 @@ zx_status_t GuestPhysicalAddressSpace::GetPage(vaddr_t guest_paddr, paddr_t* hos
     return vmo->Lookup(offset, PAGE_SIZE, kPfFlags, guest_lookup_page, host_paddr);
 }
 
+zx_status_t GuestPhysicalAddressSpace::PageFault(vaddr_t guest_paddr) {
+    page_faults_.fetch_add(1u, fbl::memory_order_relaxed);
+    kcounter_add(guest_page_faults, 1u);
+    // By default, we mark the PTEs as RWX. This is so we can avoid faulting
+    // again if the guest requests additional permissions.
+    return vmm_guest_page_fault_handler(guest_paddr, kGuestPfFlags, paspace_);
+}
+
+void GuestPhysicalAddressSpace::GetStats(zx_info_guest_stats_t* stats) const {
+    stats->page_faults = page_faults_.load(fbl::memory_order_relaxed);
+    stats->trap_faults = trap_faults_.load(fbl::memory_order_relaxed);
+}
 
 zx_status_t GuestPhysicalAddressSpace::CreateGuestPtr(zx_vaddr_t guest_paddr, size_t size,
                                                       const char* name, GuestPtr* guest_ptr) {
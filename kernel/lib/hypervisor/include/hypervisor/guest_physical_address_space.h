@@ -8,6 +8,8 @@
 
 #include <vm/vm_aspace.h>
 #include <vm/vm_object.h>
+#include <zircon/syscalls/object.h>
+#include <fbl/atomic.h>
 #include <fbl/limits.h>
 #include <fbl/unique_ptr.h>
 
@@ -68,12 +70,19 @@ public:
     zx_status_t MapInterruptController(vaddr_t guest_paddr, paddr_t host_paddr, size_t size);
     zx_status_t UnmapRange(vaddr_t guest_paddr, size_t size);
     zx_status_t GetPage(vaddr_t guest_paddr, paddr_t* host_paddr);
+    // Handles a fault taken by the guest on guest physical memory, which
+    // was not claimed by a trap.
+    zx_status_t PageFault(vaddr_t guest_paddr);
+    void CountTrapFault() { trap_faults_.fetch_add(1u, fbl::memory_order_relaxed); }
+    void GetStats(zx_info_guest_stats_t* stats) const;
     zx_status_t CreateGuestPtr(zx_vaddr_t guest_paddr, size_t size, const char* name,
                                GuestPtr* guest_ptr);
 
 private:
     fbl::RefPtr<VmAspace> paspace_;
     fbl::RefPtr<VmObject> guest_phys_mem_;
+    fbl::atomic<uint64_t> page_faults_;
+    fbl::atomic<uint64_t> trap_faults_;
 
     explicit GuestPhysicalAddressSpace(fbl::RefPtr<VmObject> guest_phys_mem);
 };
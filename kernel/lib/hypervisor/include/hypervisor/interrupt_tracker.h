@@ -62,15 +62,27 @@ public:
         if (status != ZX_OK) {
             return status;
         }
-        int threads_unblocked = event_signal(&event_, true);
+        bool threads_unblocked = Signal();
         if (signaled != nullptr) {
-            *signaled = threads_unblocked > 0;
+            *signaled = threads_unblocked;
         }
         return ZX_OK;
     }
 
+    // Signals any waiters, for an interrupt delivered by other means, and
+    // returns whether there were any.
+    bool Signal() {
+        return event_signal(&event_, true) > 0;
+    }
+
     // Waits for an interrupt.
     zx_status_t Wait(StateInvalidator* invalidator) {
+        return Wait(invalidator, [] { return false; });
+    }
+
+    // Waits for an interrupt, or for |pending| to return true after a signal.
+    template <typename F>
+    zx_status_t Wait(StateInvalidator* invalidator, F pending) {
         if (invalidator != nullptr) {
             invalidator->Invalidate();
         }
@@ -79,7 +91,7 @@ public:
             if (status != ZX_OK) {
                 return ZX_ERR_CANCELED;
             }
-        } while (!Pending());
+        } while (!Pending() && !pending());
         return ZX_OK;
     }
 
@@ -7,14 +7,19 @@
 #pragma once
 
 #include <fbl/arena.h>
+#include <fbl/atomic.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/ref_ptr.h>
 #include <hypervisor/state_invalidator.h>
+#include <kernel/spinlock.h>
 #include <object/port_dispatcher.h>
 #include <object/semaphore.h>
 
 namespace hypervisor {
 
+// The number of packets a trap may have queued at once.
+static constexpr size_t kMaxPacketsPerRange = 256;
+
 // Blocks on allocation if the arena is empty.
 class BlockingPortAllocator final : public PortAllocator {
 public:
@@ -24,10 +29,23 @@ public:
     PortPacket* AllocBlocking();
     virtual void Free(PortPacket* port_packet) override;
 
+    // Records that a bell packet for |addr| has been queued, until it is
+    // dequeued and freed.
+    void AddQueuedBell(zx_vaddr_t addr);
+    // Returns whether a bell packet for |addr| is queued. Once the packet is
+    // dequeued, the bell is seen as not queued, so a bell that finds one
+    // queued need not queue another: whoever dequeues it has yet to look at
+    // the state the bell is about.
+    bool IsBellQueued(zx_vaddr_t addr);
+
 private:
     Semaphore semaphore_;
     fbl::TypedArena<PortPacket, fbl::Mutex> arena_;
 
+    SpinLock bell_lock_;
+    size_t num_queued_bells_ TA_GUARDED(bell_lock_) = 0;
+    zx_vaddr_t queued_bells_[kMaxPacketsPerRange] TA_GUARDED(bell_lock_);
+
     PortPacket* Alloc() override;
 };
 
@@ -38,7 +56,11 @@ public:
          uint64_t key);
 
     zx_status_t Init();
+    // Queues |packet| on the port of the trap. A bell packet is coalesced
+    // with a queued packet for the same address, rather than queued again.
     zx_status_t Queue(const zx_port_packet_t& packet, StateInvalidator* invalidator);
+    // Counts an access to the trap, and returns the number of accesses so far.
+    uint64_t CountAccess() { return accesses_.fetch_add(1u) + 1u; }
 
     zx_vaddr_t GetKey() const { return addr_; }
     bool Contains(zx_vaddr_t val) const { return val >= addr_ && val < addr_ + len_; }
@@ -55,6 +77,7 @@ private:
     const size_t len_;
     const fbl::RefPtr<PortDispatcher> port_;
     const uint64_t key_; // Key for packets in this port range.
+    fbl::atomic<uint64_t> accesses_;
     BlockingPortAllocator port_allocator_;
 };
 
@@ -8,10 +8,13 @@
 
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
+#include <kernel/auto_lock.h>
+#include <lib/counters.h>
 #include <zircon/syscalls/hypervisor.h>
 #include <zircon/types.h>
 
-static constexpr size_t kMaxPacketsPerRange = 256;
+KCOUNTER(bells_queued, "kernel.hypervisor.bells.queued");
+KCOUNTER(bells_coalesced, "kernel.hypervisor.bells.coalesced");
 
 namespace hypervisor {
 
@@ -33,14 +36,39 @@ PortPacket* BlockingPortAllocator::Alloc() {
 }
 
 void BlockingPortAllocator::Free(PortPacket* port_packet) {
+    if (port_packet->packet.type == ZX_PKT_TYPE_GUEST_BELL) {
+        AutoSpinLock lock(&bell_lock_);
+        for (size_t i = 0; i < num_queued_bells_; i++) {
+            if (queued_bells_[i] == port_packet->packet.guest_bell.addr) {
+                queued_bells_[i] = queued_bells_[--num_queued_bells_];
+                break;
+            }
+        }
+    }
     arena_.Delete(port_packet);
     if (semaphore_.Post() > 0)
         thread_reschedule();
 }
 
+void BlockingPortAllocator::AddQueuedBell(zx_vaddr_t addr) {
+    AutoSpinLock lock(&bell_lock_);
+    // There is a packet for each queued bell, so this can't overflow.
+    DEBUG_ASSERT(num_queued_bells_ < kMaxPacketsPerRange);
+    queued_bells_[num_queued_bells_++] = addr;
+}
+
+bool BlockingPortAllocator::IsBellQueued(zx_vaddr_t addr) {
+    AutoSpinLock lock(&bell_lock_);
+    for (size_t i = 0; i < num_queued_bells_; i++) {
+        if (queued_bells_[i] == addr)
+            return true;
+    }
+    return false;
+}
+
 Trap::Trap(uint32_t kind, zx_vaddr_t addr, size_t len, fbl::RefPtr<PortDispatcher> port,
                      uint64_t key)
-    : kind_(kind), addr_(addr), len_(len), port_(fbl::move(port)), key_(key) {
+    : kind_(kind), addr_(addr), len_(len), port_(fbl::move(port)), key_(key), accesses_(0u) {
     (void) key_;
 }
 
@@ -49,6 +77,13 @@ zx_status_t Trap::Init() {
 }
 
 zx_status_t Trap::Queue(const zx_port_packet_t& packet, StateInvalidator* invalidator) {
+    const bool bell = packet.type == ZX_PKT_TYPE_GUEST_BELL;
+    if (bell && port_ != nullptr && port_allocator_.IsBellQueued(packet.guest_bell.addr)) {
+        // Nothing blocks, so the caller's state stays valid.
+        kcounter_add(bells_coalesced, 1u);
+        return ZX_OK;
+    }
+
     if (invalidator != nullptr)
         invalidator->Invalidate();
     if (port_ == nullptr)
@@ -57,6 +92,10 @@ zx_status_t Trap::Queue(const zx_port_packet_t& packet, StateInvalidator* invali
     if (port_packet == nullptr)
         return ZX_ERR_NO_MEMORY;
     port_packet->packet = packet;
+    if (bell) {
+        kcounter_add(bells_queued, 1u);
+        port_allocator_.AddQueuedBell(packet.guest_bell.addr);
+    }
     zx_status_t status = port_->Queue(port_packet, ZX_SIGNAL_NONE, 0);
     if (status != ZX_OK)
         port_allocator_.Free(port_packet);
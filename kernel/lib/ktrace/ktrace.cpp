@@ -7,10 +7,13 @@
 #include <debug.h>
 #include <err.h>
 #include <platform.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <arch/ops.h>
 #include <arch/user_copy.h>
+#include <fbl/atomic.h>
+#include <kernel/align.h>
 #include <kernel/cmdline.h>
 #include <vm/vm_aspace.h>
 #include <lib/ktrace.h>
@@ -76,84 +79,162 @@ static void ktrace_report_probes(void) {
     }
 }
 
+// Records are written into a buffer for each cpu, so that cpus don't
+// contend for the offset of the next record.  The buffer for each cpu is
+// divided into blocks, and records never straddle a block: a record which
+// doesn't fit in what is left of a block is preceded by a pad record which
+// fills it up.  So every block starts with a record, which lets the buffer
+// be used as a ring.
+//
+// Name records, which events refer to, go into a shared metadata buffer
+// instead so that they can be read before any events.
+//
+// Reads see the metadata buffer followed by each cpu's buffer in turn, from
+// its oldest record to its newest.
+static constexpr uint32_t kBlockSize = 4096;
+
+typedef struct ktrace_cpu_buffer {
+    // the number of bytes written, including padding, since the last rewind
+    fbl::atomic<uint64_t> head;
+
+    // counts events which can be sampled
+    fbl::atomic<uint32_t> sample_count;
+
+    // the buffer, a multiple of kBlockSize in size
+    uint8_t* buffer;
+    uint32_t size;
+} __CPU_ALIGN ktrace_cpu_buffer_t;
+
 typedef struct ktrace_state {
-    // where the next record will be written
+    // where the next metadata record will be written
     int offset;
 
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // KTRACE_MODE_*
+    int mode;
 
-    // offset where tracing was stopped, 0 if tracing active
-    uint32_t marker;
+    // record one in this many sampled events, 0 or 1 == all
+    int sample_rate;
+
+    // size of the metadata buffer, at the start of the trace buffer
+    uint32_t bufsize;
 
     // raw trace buffer
     uint8_t* buffer;
+
+    // the rest of the trace buffer, divided between the cpus
+    ktrace_cpu_buffer_t* cpus;
+    uint32_t num_cpus;
+
+    // bit n set == probe n disabled
+    int probe_disabled[(KTRACE_MAX_PROBE + 1) / 32];
 } ktrace_state_t;
 
 static ktrace_state_t KTRACE_STATE;
 
-int ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
-    ktrace_state_t* ks = &KTRACE_STATE;
+static ktrace_cpu_buffer_t KTRACE_CPUS[SMP_MAX_CPUS];
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
-    if (ks->marker) {
-        max = ks->marker;
-    } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
+// Calls |func(data, len)| for each part of the trace, in the order they are
+// read.
+template <typename Func>
+static void ktrace_for_each_part(ktrace_state_t* ks, Func func) {
+    func(ks->buffer, atomic_load(&ks->offset));
+
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        ktrace_cpu_buffer_t* cb = &ks->cpus[i];
+        uint64_t head = cb->head.load(fbl::memory_order_acquire);
+        if (head <= cb->size) {
+            func(cb->buffer, static_cast<uint32_t>(head));
+        } else {
+            // The ring has wrapped: the oldest records start in the block
+            // after the one being written.
+            uint32_t end = static_cast<uint32_t>(head % cb->size);
+            uint32_t start = ROUNDUP(end, kBlockSize);
+            func(cb->buffer + start, cb->size - start);
+            func(cb->buffer, end);
         }
     }
+}
+
+int ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
+    ktrace_state_t* ks = &KTRACE_STATE;
 
     // null read is a query for trace buffer size
     if (ptr == nullptr) {
-        return max;
+        uint32_t total = 0;
+        ktrace_for_each_part(ks, [&total](const uint8_t* data, uint32_t size) {
+            total += size;
+        });
+        return total;
     }
 
-    // constrain read to available buffer
-    if (off >= max) {
-        return 0;
+    // copy out the parts of the trace which overlap [off, off + len)
+    uint8_t* out = static_cast<uint8_t*>(ptr);
+    uint32_t pos = 0;
+    uint32_t actual = 0;
+    bool fault = false;
+    ktrace_for_each_part(ks, [&](const uint8_t* data, uint32_t size) {
+        if (!fault && actual < len && off < pos + size) {
+            uint32_t skip = off > pos ? off - pos : 0;
+            uint32_t n = size - skip;
+            if (n > len - actual) {
+                n = len - actual;
+            }
+            if (arch_copy_to_user(out + actual, data + skip, n) != ZX_OK) {
+                fault = true;
+            }
+            actual += n;
+            off += n;
+        }
+        pos += size;
+    });
+    if (fault) {
+        return ZX_ERR_INVALID_ARGS;
     }
-    if (len > (max - off)) {
-        len = max - off;
+    return actual;
+}
+
+static void ktrace_rewind(ktrace_state_t* ks) {
+    // roll back to just after the metadata
+    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        ks->cpus[i].head.store(0, fbl::memory_order_release);
     }
+}
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != ZX_OK) {
+static zx_status_t ktrace_set_probe(ktrace_state_t* ks, uint32_t num, bool enable) {
+    if (num == 0 || num > KTRACE_MAX_PROBE) {
         return ZX_ERR_INVALID_ARGS;
     }
-    return len;
+    int bit = 1 << (num % 32);
+    if (enable) {
+        atomic_and(&ks->probe_disabled[num / 32], ~bit);
+    } else {
+        atomic_or(&ks->probe_disabled[num / 32], bit);
+    }
+    return ZX_OK;
 }
 
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->cpus == nullptr) {
+        // disabled by ktrace.bufsize=0
+        return ZX_ERR_NOT_SUPPORTED;
+    }
     switch (action) {
     case KTRACE_ACTION_START:
         options = KTRACE_GRP_TO_MASK(options);
-        ks->marker = 0;
         atomic_store(&ks->grpmask, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
         ktrace_report_live_processes();
         ktrace_report_live_threads();
         break;
-    case KTRACE_ACTION_STOP: {
+    case KTRACE_ACTION_STOP:
         atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
-        } else {
-            ks->marker = n;
-        }
         break;
-    }
     case KTRACE_ACTION_REWIND:
-        // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+        ktrace_rewind(ks);
         ktrace_report_syscalls(kt_syscall_info);
         ktrace_report_probes();
         break;
@@ -163,6 +244,9 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
         if ((probe = ktrace_find_probe((const char*) ptr)) != nullptr) {
             return probe->num;
         }
+        if (probe_number > KTRACE_MAX_PROBE) {
+            return ZX_ERR_NO_RESOURCES;
+        }
         probe = (ktrace_probe_info_t*) calloc(sizeof(*probe) + ZX_MAX_NAME_LEN, 1);
         if (probe == nullptr) {
             return ZX_ERR_NO_MEMORY;
@@ -172,6 +256,23 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
         ktrace_add_probe(probe);
         return probe->num;
     }
+    case KTRACE_ACTION_SET_GROUPS:
+        // unlike KTRACE_ACTION_START, 0 means no groups
+        atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(options));
+        break;
+    case KTRACE_ACTION_ENABLE_PROBE:
+        return ktrace_set_probe(ks, options, true);
+    case KTRACE_ACTION_DISABLE_PROBE:
+        return ktrace_set_probe(ks, options, false);
+    case KTRACE_ACTION_SET_SAMPLING:
+        atomic_store(&ks->sample_rate, (int)options);
+        break;
+    case KTRACE_ACTION_SET_MODE:
+        if (options != KTRACE_MODE_ONESHOT && options != KTRACE_MODE_RING) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        atomic_store(&ks->mode, (int)options);
+        break;
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -180,6 +281,8 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
 
 int trace_not_ready = 0;
 
+static void ktrace_report_boot_phases(void);
+
 void ktrace_init(unsigned level) {
     ktrace_state_t* ks = &KTRACE_STATE;
 
@@ -193,6 +296,16 @@ void ktrace_init(unsigned level) {
 
     mb *= (1024*1024);
 
+    // a sixteenth of the buffer holds the metadata, the rest is divided
+    // evenly between the cpus
+    uint32_t meta_size = ROUNDUP(mb / 16, kBlockSize);
+    uint32_t num_cpus = arch_max_num_cpus();
+    uint32_t cpu_size = ROUNDDOWN((mb - meta_size) / num_cpus, kBlockSize);
+    if (cpu_size == 0) {
+        dprintf(INFO, "ktrace: buffer too small for %u cpus\n", num_cpus);
+        return;
+    }
+
     zx_status_t status;
     VmAspace* aspace = VmAspace::kernel_aspace();
     if ((status = aspace->Alloc("ktrace", mb, (void**)&ks->buffer, 0, VmAspace::VMM_FLAG_COMMIT,
@@ -201,21 +314,18 @@ void ktrace_init(unsigned level) {
         return;
     }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
+    ks->bufsize = meta_size;
+    ks->num_cpus = num_cpus;
+    ks->cpus = KTRACE_CPUS;
+    for (uint32_t i = 0; i < ks->num_cpus; i++) {
+        ks->cpus[i].buffer = ks->buffer + ks->bufsize + i * cpu_size;
+        ks->cpus[i].size = cpu_size;
+    }
 
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
+    ks->mode = cmdline_get_bool("ktrace.ring", false) ? KTRACE_MODE_RING : KTRACE_MODE_ONESHOT;
+    ks->sample_rate = cmdline_get_uint32("ktrace.sample", 0);
 
-    // register all static probes
-    {
-        fbl::AutoLock lock(&probe_list_lock);
-        for (auto probe = __start_ktrace_probe;
-             probe != __stop_ktrace_probe;
-             ++probe) {
-            ktrace_add_probe(*probe);
-        }
-    }
+    dprintf(INFO, "ktrace: buffer at %p (%u bytes, %u per cpu)\n", ks->buffer, mb, cpu_size);
 
     // write metadata to the first two event slots
     uint64_t n = ktrace_ticks_per_ms();
@@ -225,16 +335,28 @@ void ktrace_init(unsigned level) {
     rec[1].tag = TAG_TICKS_PER_MS;
     rec[1].a = (uint32_t)n;
     rec[1].b = (uint32_t)(n >> 32);
+    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+
+    // register all static probes
+    {
+        fbl::AutoLock lock(&probe_list_lock);
+        for (auto probe = __start_ktrace_probe;
+             probe != __stop_ktrace_probe;
+             ++probe) {
+            ktrace_add_probe(*probe);
+        }
+    }
 
     // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
     ktrace_report_syscalls(kt_syscall_info);
-    ktrace_report_probes();
     atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
 
     // report names of existing threads
     ktrace_report_live_threads();
 
+    // record the boot phases reached before now
+    ktrace_report_boot_phases();
+
     // Report an event for "tracing is all set up now".  This also
     // serves to ensure that there will be at least one static probe
     // entry so that the __{start,stop}_ktrace_probe symbols above
@@ -242,16 +364,66 @@ void ktrace_init(unsigned level) {
     ktrace_probe0("ktrace_ready");
 }
 
+// Reserves |len| bytes for a record in the current cpu's buffer.
+// Returns null if the buffer is full and isn't a ring.
+static void* ktrace_reserve(ktrace_state_t* ks, uint32_t len) {
+    ktrace_cpu_buffer_t* cb = &ks->cpus[arch_curr_cpu_num()];
+    const bool ring = atomic_load(&ks->mode) == KTRACE_MODE_RING;
+
+    uint64_t head = cb->head.load(fbl::memory_order_relaxed);
+    uint64_t pos;
+    do {
+        // skip to the next block if the record doesn't fit in this one
+        pos = head;
+        uint32_t block_left = kBlockSize - static_cast<uint32_t>(pos % kBlockSize);
+        if (block_left < len) {
+            pos += block_left;
+        }
+        if (!ring && pos + len > cb->size) {
+            return nullptr;
+        }
+    } while (!cb->head.compare_exchange_weak(&head, pos + len, fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed));
+
+    if (pos != head) {
+        uint32_t* pad = reinterpret_cast<uint32_t*>(cb->buffer + head % cb->size);
+        *pad = TAG_PAD(static_cast<uint32_t>(pos - head));
+    }
+    return cb->buffer + pos % cb->size;
+}
+
+static bool ktrace_enabled(ktrace_state_t* ks, uint32_t tag) {
+    if (!(tag & atomic_load(&ks->grpmask))) {
+        return false;
+    }
+    if (unlikely(KTRACE_GROUP(tag) & KTRACE_GRP_PROBE)) {
+        uint32_t num = KTRACE_EVENT(tag) & KTRACE_MAX_PROBE;
+        if (atomic_load(&ks->probe_disabled[num / 32]) & (1 << (num % 32))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ktrace_sample(uint32_t tag) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    if (!(tag & atomic_load(&ks->grpmask))) {
+        return false;
+    }
+    uint32_t rate = static_cast<uint32_t>(atomic_load(&ks->sample_rate));
+    if (rate <= 1) {
+        return true;
+    }
+    ktrace_cpu_buffer_t* cb = &ks->cpus[arch_curr_cpu_num()];
+    return cb->sample_count.fetch_add(1, fbl::memory_order_relaxed) % rate == 0;
+}
+
 void ktrace_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
-    if (tag & atomic_load(&ks->grpmask)) {
+    if (ktrace_enabled(ks, tag)) {
         tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
+        ktrace_header_t* hdr = (ktrace_header_t*) ktrace_reserve(ks, KTRACE_HDRSIZE);
+        if (hdr) {
             hdr->ts = ktrace_timestamp();
             hdr->tag = tag;
             hdr->tid = arg;
@@ -261,18 +433,14 @@ void ktrace_tiny(uint32_t tag, uint32_t arg) {
 
 void* ktrace_open(uint32_t tag) {
     ktrace_state_t* ks = &KTRACE_STATE;
-    if (!(tag & atomic_load(&ks->grpmask))) {
+    if (!ktrace_enabled(ks, tag)) {
         return nullptr;
     }
 
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
+    ktrace_header_t* hdr = (ktrace_header_t*) ktrace_reserve(ks, KTRACE_LEN(tag));
+    if (hdr == nullptr) {
         return nullptr;
     }
-
-    ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
     hdr->ts = ktrace_timestamp();
     hdr->tag = tag;
     hdr->tid = (uint32_t)get_current_thread()->user_tid;
@@ -287,18 +455,21 @@ static void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char*
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
-            rec->tag = tag;
-            rec->id = id;
-            rec->arg = arg;
-            memcpy(rec->name, name, len);
-            rec->name[len] = 0;
-        }
+        // names which don't fit are dropped, leaving room for any shorter
+        // ones which follow
+        int off = atomic_load(&ks->offset);
+        do {
+            if (off + KTRACE_LEN(tag) > ks->bufsize) {
+                return;
+            }
+        } while (!atomic_cmpxchg(&ks->offset, &off, off + KTRACE_LEN(tag)));
+
+        ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
+        rec->tag = tag;
+        rec->id = id;
+        rec->arg = arg;
+        memcpy(rec->name, name, len);
+        rec->name[len] = 0;
     }
 }
 
@@ -306,4 +477,72 @@ void ktrace_name(uint32_t tag, uint32_t id, uint32_t arg, const char* name) {
     ktrace_name_etc(tag, id, arg, name, false);
 }
 
+// Boot phases are probe events named for the phase, with the cpu as the
+// first argument.  Phases reached before ktrace_init has set up the buffer
+// are kept here, with their original timestamps, and recorded once it has.
+static constexpr uint32_t kMaxEarlyBootPhases = 32;
+
+static struct {
+    const char* name;
+    uint64_t ts;
+    uint32_t cpu;
+} early_boot_phases[kMaxEarlyBootPhases];
+static uint32_t early_boot_phase_count;
+static fbl::atomic<bool> boot_phases_live;
+
+static void ktrace_boot_phase_etc(const char* name, uint64_t ts, uint32_t cpu) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    uint32_t num;
+    {
+        fbl::AutoLock lock(&probe_list_lock);
+        ktrace_probe_info_t* probe = ktrace_find_probe(name);
+        if (probe == nullptr) {
+            if (probe_number > KTRACE_MAX_PROBE) {
+                return;
+            }
+            probe = (ktrace_probe_info_t*) calloc(sizeof(*probe), 1);
+            if (probe == nullptr) {
+                return;
+            }
+            probe->name = name;
+            ktrace_add_probe(probe);
+        }
+        num = probe->num;
+    }
+
+    uint32_t tag = TAG_PROBE_24(num);
+    if (!ktrace_enabled(ks, tag)) {
+        return;
+    }
+    ktrace_header_t* hdr = (ktrace_header_t*) ktrace_reserve(ks, KTRACE_LEN(tag));
+    if (hdr == nullptr) {
+        return;
+    }
+    hdr->ts = ts;
+    hdr->tag = tag;
+    hdr->tid = (uint32_t)get_current_thread()->user_tid;
+    uint32_t* args = (uint32_t*)(hdr + 1);
+    args[0] = cpu;
+    args[1] = 0;
+}
+
+static void ktrace_report_boot_phases(void) {
+    for (uint32_t i = 0; i < early_boot_phase_count; i++) {
+        ktrace_boot_phase_etc(early_boot_phases[i].name, early_boot_phases[i].ts,
+                              early_boot_phases[i].cpu);
+    }
+    boot_phases_live.store(true);
+}
+
+void ktrace_boot_phase(const char* name) {
+    uint64_t ts = ktrace_timestamp();
+    uint32_t cpu = arch_curr_cpu_num();
+    if (boot_phases_live.load()) {
+        ktrace_boot_phase_etc(name, ts, cpu);
+    } else if (early_boot_phase_count < kMaxEarlyBootPhases) {
+        // only the boot cpu gets here, one phase at a time
+        early_boot_phases[early_boot_phase_count++] = {name, ts, cpu};
+    }
+}
+
 LK_INIT_HOOK(ktrace, ktrace_init, LK_INIT_LEVEL_USER);
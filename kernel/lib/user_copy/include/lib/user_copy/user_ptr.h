@@ -115,6 +115,18 @@ public:
         return arch_copy_from_user(dst, ptr_ + offset, len);
     }
 
+    // As copy_array_from_user(), but hints that |dst| will not be read again soon, so should
+    // not be brought into the cache.
+    zx_status_t copy_array_from_user_nontemporal(typename fbl::remove_const<T>::type* dst,
+                                                 size_t count) const {
+        static_assert(Policy & kIn, "can only copy from user for kIn or kInOut user_ptr");
+        size_t len;
+        if (mul_overflow(count, internal::type_size<T>(), &len)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        return arch_copy_from_user_nontemporal(dst, ptr_, len);
+    }
+
 private:
     // It is very important that this class only wrap the pointer type itself
     // and not include any other members so as not to break the ABI between
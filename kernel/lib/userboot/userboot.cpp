@@ -17,6 +17,8 @@
 #include <kernel/cmdline.h>
 #include <vm/vm_object_paged.h>
 #include <lib/console.h>
+#include <lib/counters.h>
+#include <lib/ktrace.h>
 #include <lib/vdso.h>
 #include <lk/init.h>
 #include <mexec.h>
@@ -181,6 +183,8 @@ enum bootstrap_handle_index {
     BOOTSTRAP_JOB,
     BOOTSTRAP_VMAR_ROOT,
     BOOTSTRAP_CRASHLOG,
+    BOOTSTRAP_COUNTERS_DESC,
+    BOOTSTRAP_COUNTERS_ARENA,
 #if ENABLE_ENTROPY_COLLECTOR_TEST
     BOOTSTRAP_ENTROPY_FILE,
 #endif
@@ -240,9 +244,17 @@ static fbl::unique_ptr<MessagePacket> prepare_bootstrap_message() {
         case BOOTSTRAP_CRASHLOG:
             info = PA_HND(PA_VMO_KERNEL_FILE, 0);
             break;
+        case BOOTSTRAP_COUNTERS_DESC:
+            info = PA_HND(PA_VMO_KERNEL_FILE, 1);
+            break;
+        case BOOTSTRAP_COUNTERS_ARENA:
+            info = PA_HND(PA_VMO_KERNEL_FILE, 2);
+            break;
 #if ENABLE_ENTROPY_COLLECTOR_TEST
+        // The kernel file VMOs are numbered without gaps, since devmgr
+        // stops looking at the first one missing.
         case BOOTSTRAP_ENTROPY_FILE:
-            info = PA_HND(PA_VMO_KERNEL_FILE, 1);
+            info = PA_HND(PA_VMO_KERNEL_FILE, 3);
             break;
 #endif
         case BOOTSTRAP_HANDLES:
@@ -307,6 +319,12 @@ static zx_status_t attempt_userboot() {
     if (status != ZX_OK)
         return status;
 
+    fbl::RefPtr<VmObject> counters_desc_vmo;
+    fbl::RefPtr<VmObject> counters_arena_vmo;
+    status = kcounters_to_vmos(&counters_desc_vmo, &counters_arena_vmo);
+    if (status != ZX_OK)
+        return status;
+
     // Prepare the bootstrap message packet.  This puts its data (the
     // kernel command line) in place, and allocates space for its handles.
     // We'll fill in the handles as we create things.
@@ -325,6 +343,12 @@ static zx_status_t attempt_userboot() {
     if (status == ZX_OK)
         status = get_vmo_handle(crashlog_vmo, true, nullptr,
                                 &handles[BOOTSTRAP_CRASHLOG]);
+    if (status == ZX_OK)
+        status = get_vmo_handle(counters_desc_vmo, true, nullptr,
+                                &handles[BOOTSTRAP_COUNTERS_DESC]);
+    if (status == ZX_OK)
+        status = get_vmo_handle(counters_arena_vmo, true, nullptr,
+                                &handles[BOOTSTRAP_COUNTERS_ARENA]);
     if (status == ZX_OK)
         status = get_resource_handle(&handles[BOOTSTRAP_RESOURCE_ROOT]);
 
@@ -411,6 +435,7 @@ static zx_status_t attempt_userboot() {
     dprintf(SPEW, "userboot: %-23s @ %#" PRIxPTR "\n", "entry point", entry);
 
     // Start the process's initial thread.
+    ktrace_boot_phase("boot_userboot");
     status = thread->Start(entry, sp, static_cast<uintptr_t>(hv), vdso_base,
                            /* initial_thread= */ true);
     if (status != ZX_OK) {
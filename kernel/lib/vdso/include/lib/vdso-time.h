@@ -0,0 +1,56 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+// This file is used both in the kernel and in the vDSO implementation.
+// So it must be compatible with both the kernel and userland header
+// environments.  It must use only the basic types so that struct
+// layouts match exactly in both contexts.
+
+// The clock data has a page to itself, since unlike the rest of the vDSO
+// image it changes after boot.  Variant vDSOs are copy-on-write clones of
+// the main one, and must keep reading the page the kernel updates rather
+// than getting a copy of it when something else in the same page is
+// modified.
+#define VDSO_TIME_ALIGN 4096
+#define VDSO_TIME_SIZE 4096
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+// This struct contains what the vDSO needs to read ZX_CLOCK_MONOTONIC and
+// ZX_CLOCK_UTC without entering the kernel.
+//
+// |utc_offset| is changed by zx_clock_adjust().  Readers must load |seq|,
+// then the data, then |seq| again, and retry if it was odd or changed.
+struct vdso_time {
+    // Incremented before and after each update.
+    uint32_t seq;
+
+    // Nonzero if ZX_CLOCK_MONOTONIC is zx_ticks_get() times
+    // |ns_per_tick|.  Otherwise the vDSO must ask the kernel.
+    uint32_t ticks_to_mono_valid;
+
+    // Nanoseconds per tick as a 32.64 fixed point number, the same as the
+    // kernel's struct fp_32_64.
+    struct {
+        uint32_t l0;
+        uint32_t l32;
+        uint32_t l64;
+    } ns_per_tick;
+
+    uint32_t reserved;
+
+    // ZX_CLOCK_UTC minus ZX_CLOCK_MONOTONIC.
+    int64_t utc_offset;
+};
+
+static_assert(sizeof(vdso_time) <= VDSO_TIME_SIZE,
+              "vdso_time does not fit in its page");
+
+#endif // __ASSEMBLER__
@@ -24,6 +24,9 @@ public:
         return instance_->RoDso::valid_code_mapping(vmo_offset, size);
     }
 
+    // Publishes a new ZX_CLOCK_UTC offset to the vDSO's clock data.
+    static void SetUtcOffset(int64_t offset);
+
     // Given VmAspace::vdso_code_mapping_, return the vDSO base address or 0.
     static uintptr_t base_address(const fbl::RefPtr<VmMapping>& code_mapping);
 
@@ -6,10 +6,14 @@
 
 #include <lib/vdso.h>
 #include <lib/vdso-constants.h>
+#include <lib/vdso-time.h>
 
 #include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <fbl/type_support.h>
 #include <kernel/cmdline.h>
+#include <lib/fixed_point.h>
 #include <object/handle.h>
 #include <platform.h>
 #include <vm/pmm.h>
@@ -200,6 +204,12 @@ void blacklist_##category##_syscalls(VDsoDynSymWindow& dynsym_window, \
 #undef SYSCALL_IN_CATEGORY_END
 #undef SYSCALL_CATEGORY_END
 
+// The kernel's mapping of the vDSO's clock data, which lasts forever.
+KernelVmoWindow<vdso_time>* time_window;
+
+// Serializes updates to the clock data.
+fbl::Mutex time_lock;
+
 } // anonymous namespace
 
 const VDso* VDso::instance_ = NULL;
@@ -239,7 +249,8 @@ const VDso* VDso::Create() {
 
     // If ticks_per_second has not been calibrated, it will return 0. In this
     // case, use soft_ticks instead.
-    if (per_second == 0 || cmdline_get_bool("vdso.soft_ticks", false)) {
+    const bool soft_ticks = per_second == 0 || cmdline_get_bool("vdso.soft_ticks", false);
+    if (soft_ticks) {
         // Make zx_ticks_per_second return nanoseconds per second.
         constants_window.data()->ticks_per_second = ZX_SEC(1);
 
@@ -248,6 +259,23 @@ const VDso* VDso::Create() {
         REDIRECT_SYSCALL(dynsym_window, zx_ticks_get, soft_ticks_get);
     }
 
+    // Map the clock data, which the kernel keeps updating after boot.
+    static_assert(VDSO_DATA_TIME_SIZE == VDSO_TIME_SIZE,
+                  "gen-rodso-code.sh is suspect");
+    static_assert(VDSO_DATA_TIME % PAGE_SIZE == 0,
+                  "vDSO clock data is not page-aligned");
+    time_window = new (&ac) KernelVmoWindow<vdso_time>(
+        "vDSO clock data", vdso->vmo()->vmo(), VDSO_DATA_TIME);
+    ASSERT(ac.check());
+    fp_32_64 ns_per_tick;
+    if (!soft_ticks && platform_usermode_ticks_to_time(&ns_per_tick)) {
+        vdso_time* time = time_window->data();
+        time->ns_per_tick.l0 = ns_per_tick.l0;
+        time->ns_per_tick.l32 = ns_per_tick.l32;
+        time->ns_per_tick.l64 = ns_per_tick.l64;
+        time->ticks_to_mono_valid = 1;
+    }
+
     for (size_t v = static_cast<size_t>(Variant::FULL) + 1;
          v < static_cast<size_t>(Variant::COUNT);
          ++v)
@@ -257,6 +285,19 @@ const VDso* VDso::Create() {
     return instance_;
 }
 
+// static
+void VDso::SetUtcOffset(int64_t offset) {
+    fbl::AutoLock lock(&time_lock);
+    vdso_time* time = time_window->data();
+
+    // See vdso-time.h for how the vDSO reads this.
+    const uint32_t seq = time->seq;
+    __atomic_store_n(&time->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&time->utc_offset, offset, __ATOMIC_RELAXED);
+    __atomic_store_n(&time->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
 uintptr_t VDso::base_address(const fbl::RefPtr<VmMapping>& code_mapping) {
     return code_mapping ? code_mapping->base() - VDSO_CODE_START : 0;
 }
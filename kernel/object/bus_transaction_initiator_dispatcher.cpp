@@ -0,0 +1,245 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/bus_transaction_initiator_dispatcher.h>
+
+#include <zircon/rights.h>
+#include <zircon/syscalls/iommu.h>
+#include <zxcpp/new.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+
+#include <assert.h>
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#define LOCAL_TRACE 0
+
+using fbl::AutoLock;
+
+zx_status_t PinnedMemoryObject::Create(fbl::RefPtr<Iommu> iommu, uint64_t bti_id,
+                                       fbl::RefPtr<VmObject> vmo, uint64_t offset, uint64_t size,
+                                       uint32_t perms, fbl::unique_ptr<PinnedMemoryObject>* out) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(size) && size > 0);
+
+    fbl::AllocChecker ac;
+    const size_t page_count = size / PAGE_SIZE;
+    fbl::unique_ptr<Mapping[]> mappings(new (&ac) Mapping[page_count]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    fbl::unique_ptr<PinnedMemoryObject> pmo(new (&ac) PinnedMemoryObject(
+        fbl::move(iommu), bti_id, fbl::move(vmo), offset, size, perms,
+        fbl::Array<Mapping>(mappings.release(), page_count)));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    // Physical VMOs are always resident, paged ones have to be held there.
+    if (pmo->vmo_->is_paged()) {
+        uint64_t committed;
+        zx_status_t status = pmo->vmo_->CommitRange(offset, size, &committed);
+        if (status != ZX_OK)
+            return status;
+        status = pmo->vmo_->Pin(offset, size);
+        if (status != ZX_OK)
+            return status;
+        pmo->pinned_ = true;
+    }
+
+    zx_status_t status = pmo->MapRange();
+    if (status != ZX_OK)
+        return status;
+
+    *out = fbl::move(pmo);
+    return ZX_OK;
+}
+
+PinnedMemoryObject::PinnedMemoryObject(fbl::RefPtr<Iommu> iommu, uint64_t bti_id,
+                                       fbl::RefPtr<VmObject> vmo, uint64_t offset,
+                                       uint64_t size, uint32_t perms,
+                                       fbl::Array<Mapping> mappings)
+    : iommu_(fbl::move(iommu)), bti_id_(bti_id), vmo_(fbl::move(vmo)), offset_(offset),
+      size_(size), perms_(perms), mappings_(fbl::move(mappings)) {
+}
+
+PinnedMemoryObject::~PinnedMemoryObject() {
+    for (size_t i = 0; i < mapping_count_; ++i) {
+        zx_status_t status = iommu_->Unmap(bti_id_, mappings_[i].base, mappings_[i].len);
+        // The mappings were made by the same IOMMU, unmapping them cannot fail.
+        ASSERT(status == ZX_OK);
+    }
+    if (pinned_)
+        vmo_->Unpin(offset_, size_);
+}
+
+zx_status_t PinnedMemoryObject::MapRange() {
+    uint64_t mapped = 0;
+    while (mapped < size_) {
+        DEBUG_ASSERT(mapping_count_ < mappings_.size());
+        dev_vaddr_t vaddr;
+        size_t len;
+        zx_status_t status = iommu_->Map(bti_id_, vmo_, offset_ + mapped, size_ - mapped,
+                                         perms_, &vaddr, &len);
+        if (status != ZX_OK)
+            return status;
+        mappings_[mapping_count_++] = {vaddr, len};
+        mapped += len;
+    }
+    return ZX_OK;
+}
+
+void PinnedMemoryObject::GetAddrs(dev_vaddr_t* addrs) const {
+    size_t page = 0;
+    const size_t page_count = size_ / PAGE_SIZE;
+    for (size_t i = 0; i < mapping_count_; ++i) {
+        for (size_t off = 0; off < mappings_[i].len && page < page_count; off += PAGE_SIZE)
+            addrs[page++] = mappings_[i].base + off;
+    }
+}
+
+zx_status_t BusTransactionInitiatorDispatcher::Create(fbl::RefPtr<Iommu> iommu, uint64_t bti_id,
+                                                      fbl::RefPtr<Dispatcher>* dispatcher,
+                                                      zx_rights_t* rights) {
+    if (!iommu->IsValidBusTxnId(bti_id))
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) BusTransactionInitiatorDispatcher(fbl::move(iommu), bti_id);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = ZX_DEFAULT_BTI_RIGHTS;
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+BusTransactionInitiatorDispatcher::BusTransactionInitiatorDispatcher(fbl::RefPtr<Iommu> iommu,
+                                                                     uint64_t bti_id)
+    : iommu_(fbl::move(iommu)), bti_id_(bti_id) {}
+
+BusTransactionInitiatorDispatcher::~BusTransactionInitiatorDispatcher() {
+    DEBUG_ASSERT(pinned_.is_empty());
+    DEBUG_ASSERT(cached_.is_empty());
+}
+
+void BusTransactionInitiatorDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    // Nobody can unpin the ranges any more, so give them all up. The lists
+    // are destroyed after the lock is dropped, as that unmaps and unpins.
+    PmoList pinned;
+    PmoList cached;
+    {
+        AutoLock lock(get_lock());
+        closed_ = true;
+        pinned.swap(pinned_);
+        cached.swap(cached_);
+        pinned_count_ = 0;
+        cached_count_ = 0;
+    }
+}
+
+zx_status_t BusTransactionInitiatorDispatcher::Pin(fbl::RefPtr<VmObject> vmo, uint64_t offset,
+                                                   uint64_t size, uint32_t options,
+                                                   dev_vaddr_t* addrs) {
+    canary_.Assert();
+
+    uint32_t perms = 0;
+    if (options & ZX_BTI_PERM_READ)
+        perms |= IOMMU_FLAG_PERM_READ;
+    if (options & ZX_BTI_PERM_WRITE)
+        perms |= IOMMU_FLAG_PERM_WRITE;
+    if (options & ZX_BTI_PERM_EXECUTE)
+        perms |= IOMMU_FLAG_PERM_EXECUTE;
+    const bool cacheable = (options & ZX_BTI_CACHE) != 0;
+
+    {
+        AutoLock lock(get_lock());
+        if (closed_)
+            return ZX_ERR_BAD_STATE;
+
+        auto match = [&](const PinnedMemoryObject& pmo) {
+            return pmo.Matches(vmo.get(), offset, size, perms);
+        };
+        auto iter = pinned_.find_if(match);
+        if (!iter.IsValid()) {
+            iter = cached_.find_if(match);
+            if (iter.IsValid()) {
+                pinned_.push_front(cached_.erase(iter));
+                --cached_count_;
+                ++pinned_count_;
+                ++cache_hits_;
+                iter = pinned_.begin();
+            }
+        }
+        if (iter.IsValid()) {
+            iter->pin_count++;
+            iter->cacheable |= cacheable;
+            iter->GetAddrs(addrs);
+            return ZX_OK;
+        }
+    }
+
+    fbl::unique_ptr<PinnedMemoryObject> pmo;
+    zx_status_t status = PinnedMemoryObject::Create(iommu_, bti_id_, fbl::move(vmo), offset,
+                                                    size, perms, &pmo);
+    if (status != ZX_OK)
+        return status;
+    pmo->pin_count = 1;
+    pmo->cacheable = cacheable;
+    pmo->GetAddrs(addrs);
+
+    AutoLock lock(get_lock());
+    if (closed_)
+        return ZX_ERR_BAD_STATE;
+    pinned_.push_front(fbl::move(pmo));
+    ++pinned_count_;
+    return ZX_OK;
+}
+
+zx_status_t BusTransactionInitiatorDispatcher::Unpin(dev_vaddr_t base_addr, uint64_t size) {
+    canary_.Assert();
+
+    // Destroyed after the lock is dropped.
+    fbl::unique_ptr<PinnedMemoryObject> released;
+
+    AutoLock lock(get_lock());
+    auto iter = pinned_.find_if([&](const PinnedMemoryObject& pmo) {
+        return pmo.base_addr() == base_addr && pmo.size() == size;
+    });
+    if (!iter.IsValid())
+        return ZX_ERR_INVALID_ARGS;
+    if (--iter->pin_count > 0)
+        return ZX_OK;
+
+    auto pmo = pinned_.erase(iter);
+    --pinned_count_;
+    if (!pmo->cacheable) {
+        released = fbl::move(pmo);
+        return ZX_OK;
+    }
+    cached_.push_front(fbl::move(pmo));
+    if (++cached_count_ > kMaxCachedPins) {
+        released = cached_.pop_back();
+        --cached_count_;
+    }
+    return ZX_OK;
+}
+
+void BusTransactionInitiatorDispatcher::GetInfo(zx_info_bti_t* info) {
+    canary_.Assert();
+
+    info->minimum_contiguity = iommu_->minimum_contiguity(bti_id_);
+    info->aspace_size = iommu_->aspace_size(bti_id_);
+
+    AutoLock lock(get_lock());
+    info->pinned = pinned_count_;
+    info->cached = cached_count_;
+    info->cache_hits = cache_hits_;
+}
@@ -13,6 +13,7 @@
 #include <trace.h>
 
 #include <kernel/event.h>
+#include <kernel/thread.h>
 #include <platform.h>
 #include <object/handle.h>
 #include <object/message_packet.h>
@@ -169,6 +170,43 @@ zx_status_t ChannelDispatcher::Read(uint32_t* msg_size,
     return rv;
 }
 
+zx_status_t ChannelDispatcher::ReadMany(size_t count,
+                                        uint32_t* msg_sizes,
+                                        uint32_t* msg_handle_counts,
+                                        MessageList* msgs) {
+    canary_.Assert();
+    DEBUG_ASSERT(count > 0);
+
+    AutoLock lock(get_lock());
+
+    if (messages_.is_empty())
+        return other_ ? ZX_ERR_SHOULD_WAIT : ZX_ERR_PEER_CLOSED;
+
+    size_t read = 0;
+    for (; read < count && !messages_.is_empty(); ++read) {
+        const MessagePacket& front = messages_.front();
+        if (front.data_size() > msg_sizes[read] ||
+            front.num_handles() > msg_handle_counts[read]) {
+            break;
+        }
+        msg_sizes[read] = front.data_size();
+        msg_handle_counts[read] = front.num_handles();
+        msgs->push_back(messages_.pop_front());
+        message_count_--;
+    }
+
+    if (read == 0) {
+        msg_sizes[0] = messages_.front().data_size();
+        msg_handle_counts[0] = messages_.front().num_handles();
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
+    if (messages_.is_empty())
+        UpdateStateLocked(ZX_CHANNEL_READABLE, 0u);
+
+    return ZX_OK;
+}
+
 zx_status_t ChannelDispatcher::Write(fbl::unique_ptr<MessagePacket> msg) {
     canary_.Assert();
 
@@ -180,7 +218,24 @@ zx_status_t ChannelDispatcher::Write(fbl::unique_ptr<MessagePacket> msg) {
         return ZX_ERR_PEER_CLOSED;
     }
 
-    if (other_->WriteSelf(fbl::move(msg)) > 0)
+    if (other_->WriteSelf(fbl::move(msg), messages_.is_empty()) > 0)
+        thread_reschedule();
+
+    return ZX_OK;
+}
+
+zx_status_t ChannelDispatcher::WriteMany(MessageList* msgs) {
+    canary_.Assert();
+
+    AutoLock lock(get_lock());
+    if (!other_)
+        return ZX_ERR_PEER_CLOSED;
+
+    int woken = 0;
+    while (!msgs->is_empty())
+        woken += other_->WriteSelf(msgs->pop_front());
+
+    if (woken > 0)
         thread_reschedule();
 
     return ZX_OK;
@@ -216,7 +271,10 @@ zx_status_t ChannelDispatcher::Call(fbl::unique_ptr<MessagePacket> msg,
         // waiter to the list.
         waiters_.push_back(waiter);
 
-        // (1) Write outbound message to opposing endpoint.
+        // (1) Write outbound message to opposing endpoint. We wait for the
+        // reply straight after, so a server thread woken by it can run here
+        // in our place.
+        AutoSyncWakeup sync_wakeup;
         other_->WriteSelf(fbl::move(msg));
     }
 
@@ -260,7 +318,7 @@ zx_status_t ChannelDispatcher::ResumeInterruptedCall(MessageWaiter* waiter,
     return status;
 }
 
-int ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
+int ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg, bool writer_idle) {
     canary_.Assert();
 
     if (!waiters_.is_empty()) {
@@ -273,6 +331,9 @@ int ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
             // Remove waiter from list.
             if (waiter.get_txid() == txid) {
                 waiters_.erase(waiter);
+                // A replying thread with nothing else to read is done for
+                // now, so the caller can take over its cpu.
+                AutoSyncWakeup sync_wakeup(writer_idle);
                 // we return how many threads have been woken up, or zero.
                 return waiter.Deliver(fbl::move(msg));
             }
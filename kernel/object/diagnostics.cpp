@@ -13,10 +13,12 @@
 #include <lib/console.h>
 #include <lib/ktrace.h>
 #include <fbl/auto_lock.h>
+#include <fbl/vector.h>
 #include <object/handle.h>
 #include <object/job_dispatcher.h>
 #include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <object/vm_object_dispatcher.h>
 #include <pretty/sizes.h>
 #include <zircon/types.h>
@@ -60,7 +62,7 @@ static void DumpProcessListKeyMap() {
 }
 
 static const char* ObjectTypeToString(zx_obj_type_t type) {
-    static_assert(ZX_OBJ_TYPE_LAST == 24, "need to update switch below");
+    static_assert(ZX_OBJ_TYPE_LAST == 25, "need to update switch below");
 
     switch (type) {
         case ZX_OBJ_TYPE_PROCESS: return "process";
@@ -82,6 +84,8 @@ static const char* ObjectTypeToString(zx_obj_type_t type) {
         case ZX_OBJ_TYPE_VCPU: return "vcpu";
         case ZX_OBJ_TYPE_TIMER: return "timer";
         case ZX_OBJ_TYPE_IOMMU: return "iommu";
+        case ZX_OBJ_TYPE_PAGER: return "pager";
+        case ZX_OBJ_TYPE_BTI: return "bti";
         default: return "???";
     }
 }
@@ -409,6 +413,11 @@ public:
             usage.scaled_shared_bytes +=
                 committed_pages * PAGE_SIZE / share_count;
         }
+
+        size_t compressed_bytes;
+        usage.compressed_pages += map->vmo()->CompressedPagesInRange(
+            map->object_offset(), map->size(), &compressed_bytes);
+        usage.compressed_bytes += compressed_bytes;
         return true;
     }
 
@@ -423,6 +432,231 @@ zx_status_t VmAspace::GetMemoryUsage(vm_usage_t* usage) {
         return ZX_ERR_INTERNAL;
     }
     *usage = vc.usage;
+
+    fbl::AutoLock a(&lock_);
+    usage->zero_mapped_pages = zero_mapped_pages_.load(fbl::memory_order_relaxed);
+    usage->decompress_faults = fault_stats_.decompress_faults;
+    usage->decompress_ns = fault_stats_.decompress_ns;
+    return ZX_OK;
+}
+
+void AddTaskRuntime(zx_info_task_runtime_t* total, const zx_info_task_runtime_t& runtime) {
+    total->cpu_time += runtime.cpu_time;
+    total->queue_time += runtime.queue_time;
+    total->kernel_time += runtime.kernel_time;
+    total->preemptions += runtime.preemptions;
+    total->page_faults += runtime.page_faults;
+    total->page_fault_time += runtime.page_fault_time;
+}
+
+void ProcessDispatcher::GetRuntime(zx_info_task_runtime_t* info) const {
+    fbl::AutoLock lock(&state_lock_);
+    *info = exited_runtime_;
+    for (const auto& thread : thread_list_) {
+        zx_info_task_runtime_t runtime;
+        thread.GetRuntime(&runtime);
+        AddTaskRuntime(info, runtime);
+    }
+}
+
+namespace {
+// Sums the time accounting of the direct children of a job; each child job
+// sums its own children.
+class RuntimeCounter final : public JobEnumerator {
+public:
+    bool OnJob(JobDispatcher* job) final {
+        zx_info_task_runtime_t runtime;
+        job->GetRuntime(&runtime);
+        AddTaskRuntime(&total, runtime);
+        return true;
+    }
+
+    bool OnProcess(ProcessDispatcher* process) final {
+        zx_info_task_runtime_t runtime;
+        process->GetRuntime(&runtime);
+        AddTaskRuntime(&total, runtime);
+        return true;
+    }
+
+    zx_info_task_runtime_t total = {};
+};
+} // namespace
+
+void JobDispatcher::GetRuntime(zx_info_task_runtime_t* info) {
+    // A child which exits after this is read is missed until the next call,
+    // rather than counted twice.
+    {
+        fbl::AutoLock lock(get_lock());
+        *info = exited_runtime_;
+    }
+
+    RuntimeCounter counter;
+    EnumerateChildren(&counter, /* recurse */ false);
+    AddTaskRuntime(info, counter.total);
+}
+
+namespace {
+// A job or process in a snapshot of a job tree.
+struct TaskTreeNode {
+    fbl::RefPtr<Dispatcher> task;
+    uint32_t depth;
+};
+
+// Takes references to a job and to every job and process under it, in the
+// order JobDispatcher::EnumerateChildren() visits them. Nothing is looked at
+// beyond the shape of the tree, so each job's lock is only held for as long
+// as it takes to list its children.
+class TaskTreeCollector final : public JobEnumerator {
+public:
+    explicit TaskTreeCollector(fbl::Vector<TaskTreeNode>* nodes) : nodes_(nodes) {}
+
+    bool OnJob(JobDispatcher* job) final {
+        return Add(fbl::WrapRefPtr(job), /* is_job */ true);
+    }
+
+    bool OnProcess(ProcessDispatcher* process) final {
+        return Add(fbl::WrapRefPtr(process), /* is_job */ false);
+    }
+
+    bool Add(fbl::RefPtr<Dispatcher> task, bool is_job) {
+        // Tasks come in pre order, so the parent is the last job on the path
+        // from the root which has not been left yet.
+        const zx_koid_t parent_koid = task->get_related_koid();
+        while (!path_.is_empty() && path_[path_.size() - 1] != parent_koid) {
+            path_.pop_back();
+        }
+        const uint32_t depth = static_cast<uint32_t>(path_.size());
+
+        fbl::AllocChecker ac;
+        if (is_job) {
+            path_.push_back(task->get_koid(), &ac);
+            if (!ac.check()) {
+                return false;
+            }
+        }
+        nodes_->push_back(TaskTreeNode{fbl::move(task), depth}, &ac);
+        return ac.check();
+    }
+
+private:
+    fbl::Vector<TaskTreeNode>* const nodes_;
+    // The koids of the jobs from the root to the one last visited.
+    fbl::Vector<zx_koid_t> path_;
+};
+
+// Writes the entries of a snapshot of a job tree.
+class TaskNodeWriter {
+public:
+    // NOTE: Code outside of the syscall layer should not typically know about
+    // user_ptrs; do not use this pattern as an example.
+    TaskNodeWriter(user_out_ptr<zx_info_task_node_t> nodes, size_t max)
+        : nodes_(nodes), max_(max) {}
+
+    zx_status_t Write(const zx_info_task_node_t& entry) {
+        available_++;
+        if (nelem_ < max_) {
+            if (nodes_.copy_array_to_user(&entry, 1, nelem_) != ZX_OK) {
+                return ZX_ERR_INVALID_ARGS;
+            }
+            nelem_++;
+        }
+        return ZX_OK;
+    }
+
+    size_t nelem() const { return nelem_; }
+    size_t available() const { return available_; }
+
+private:
+    const user_out_ptr<zx_info_task_node_t> nodes_;
+    const size_t max_;
+
+    size_t nelem_ = 0;
+    size_t available_ = 0;
+};
+
+zx_info_task_node_t TaskToNodeEntry(const Dispatcher* task, uint32_t depth) {
+    zx_info_task_node_t entry = {};
+    entry.koid = task->get_koid();
+    entry.parent_koid = task->get_related_koid();
+    entry.type = task->get_type();
+    entry.depth = depth;
+    task->get_name(entry.name);
+    return entry;
+}
+
+// Writes the entries for a process and its threads.
+zx_status_t WriteProcessNodes(ProcessDispatcher* process, uint32_t depth,
+                              TaskNodeWriter* writer) {
+    zx_info_task_node_t entry = TaskToNodeEntry(process, depth);
+    process->GetRuntime(&entry.runtime);
+    zx_info_task_stats_t stats;
+    if (process->GetStats(&stats) == ZX_OK) {
+        entry.mem_private_bytes = stats.mem_private_bytes;
+        entry.mem_shared_bytes = stats.mem_shared_bytes;
+        entry.mem_scaled_shared_bytes = stats.mem_scaled_shared_bytes;
+    }
+    zx_status_t status = writer->Write(entry);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::Array<fbl::RefPtr<ThreadDispatcher>> threads;
+    status = process->GetThreads(&threads);
+    if (status != ZX_OK) {
+        return status;
+    }
+    for (const auto& thread : threads) {
+        entry = TaskToNodeEntry(thread.get(), depth + 1);
+        zx_info_thread_t info;
+        if (thread->GetInfoForUserspace(&info) == ZX_OK) {
+            entry.state = info.state;
+            entry.wait_exception_port_type = info.wait_exception_port_type;
+        }
+        thread->GetRuntime(&entry.runtime);
+        status = writer->Write(entry);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+} // namespace
+
+// NOTE: Code outside of the syscall layer should not typically know about
+// user_ptrs; do not use this pattern as an example.
+zx_status_t GetJobTree(JobDispatcher* job,
+                       user_out_ptr<zx_info_task_node_t> nodes, size_t max,
+                       size_t* actual, size_t* available) {
+    DEBUG_ASSERT(job != nullptr);
+    DEBUG_ASSERT(actual != nullptr);
+    DEBUG_ASSERT(available != nullptr);
+    *actual = 0;
+    *available = 0;
+
+    // List the whole tree first, and only then gather the stats, which can
+    // be slow, with no job locked.
+    fbl::Vector<TaskTreeNode> tasks;
+    TaskTreeCollector collector(&tasks);
+    if (!collector.Add(fbl::WrapRefPtr(job), /* is_job */ true) ||
+        !job->EnumerateChildren(&collector, /* recurse */ true)) {
+        // TaskTreeCollector only returns false when it runs out of memory.
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    TaskNodeWriter writer(nodes, max);
+    for (const auto& node : tasks) {
+        zx_status_t status;
+        if (auto process = DownCastDispatcher<ProcessDispatcher>(node.task.get())) {
+            status = WriteProcessNodes(process, node.depth, &writer);
+        } else {
+            status = writer.Write(TaskToNodeEntry(node.task.get(), node.depth));
+        }
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    *actual = writer.nelem();
+    *available = writer.available();
     return ZX_OK;
 }
 
@@ -555,6 +789,7 @@ zx_info_vmo_t VmoToInfoEntry(const VmObject* vmo,
         (vmo->is_paged() ? ZX_INFO_VMO_TYPE_PAGED : ZX_INFO_VMO_TYPE_PHYSICAL) |
         (vmo->is_cow_clone() ? ZX_INFO_VMO_IS_COW_CLONE : 0);
     entry.committed_bytes = vmo->AllocatedPages() * PAGE_SIZE;
+    entry.zero_mapped_bytes = vmo->zero_mapped_pages() * PAGE_SIZE;
     if (is_handle) {
         entry.flags |= ZX_INFO_VMO_VIA_HANDLE;
         entry.handle_rights = handle_rights;
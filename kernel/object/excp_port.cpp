@@ -239,8 +239,10 @@ zx_status_t ExceptionPort::SendPacketWorker(uint32_t type, zx_koid_t pid, zx_koi
     zx_status_t status = port_->Queue(iopk, 0, 0);
     if (status != ZX_OK) {
         iopk->Free();
+        return status;
     }
-    return status;
+    exceptions_.fetch_add(1);
+    return ZX_OK;
 }
 
 zx_status_t ExceptionPort::SendPacket(ThreadDispatcher* thread, uint32_t type) {
@@ -251,6 +253,47 @@ zx_status_t ExceptionPort::SendPacket(ThreadDispatcher* thread, uint32_t type) {
     return SendPacketWorker(type, pid, tid);
 }
 
+void ExceptionPort::OnExceptionResponse(zx_duration_t response_time) {
+    canary_.Assert();
+
+    responses_.fetch_add(1);
+    total_response_time_.fetch_add(response_time);
+    zx_duration_t max = max_response_time_.load();
+    while (response_time > max &&
+           !max_response_time_.compare_exchange_weak(&max, response_time,
+                                                     fbl::memory_order_relaxed,
+                                                     fbl::memory_order_relaxed)) {
+    }
+}
+
+void ExceptionPort::GetStats(zx_info_exception_port_stats_t* stats) const {
+    canary_.Assert();
+
+    *stats = {};
+    stats->key = port_key_;
+    switch (type_) {
+    case Type::DEBUGGER:
+        stats->type = ZX_EXCEPTION_PORT_TYPE_DEBUGGER;
+        break;
+    case Type::THREAD:
+        stats->type = ZX_EXCEPTION_PORT_TYPE_THREAD;
+        break;
+    case Type::PROCESS:
+        stats->type = ZX_EXCEPTION_PORT_TYPE_PROCESS;
+        break;
+    case Type::JOB:
+        stats->type = ZX_EXCEPTION_PORT_TYPE_JOB;
+        break;
+    default:
+        stats->type = ZX_EXCEPTION_PORT_TYPE_NONE;
+        break;
+    }
+    stats->exceptions = exceptions_.load();
+    stats->responses = responses_.load();
+    stats->total_response_time = total_response_time_.load();
+    stats->max_response_time = max_response_time_.load();
+}
+
 void ExceptionPort::BuildReport(zx_exception_report_t* report, uint32_t type) {
     memset(report, 0, sizeof(*report));
     report->header.size = sizeof(*report);
@@ -8,6 +8,8 @@
 
 #include <string.h>
 
+#include <vm/vm_aspace.h>
+#include <vm/vm_object_paged.h>
 #include <zircon/rights.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
@@ -20,6 +22,9 @@ zx_status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t o
                                    fbl::RefPtr<Dispatcher>* dispatcher0,
                                    fbl::RefPtr<Dispatcher>* dispatcher1,
                                    zx_rights_t* rights) {
+    if (options & ~ZX_FIFO_CREATE_MASK)
+        return ZX_ERR_INVALID_ARGS;
+
     // count and elemsize must be nonzero
     // count must be a power of two
     // total size must be <= kMaxSizeBytes
@@ -35,21 +40,36 @@ zx_status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t o
         return ZX_ERR_NO_MEMORY;
     auto holder1 = holder0;
 
-    auto data0 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
+    fbl::unique_ptr<uint8_t[]> data0;
+    fbl::unique_ptr<uint8_t[]> data1;
+    fbl::unique_ptr<SharedRing> shared0;
+    fbl::unique_ptr<SharedRing> shared1;
+
+    if (options & ZX_FIFO_SHARED) {
+        zx_status_t status = CreateSharedRing(count, elemsize, &shared0);
+        if (status != ZX_OK)
+            return status;
+        status = CreateSharedRing(count, elemsize, &shared1);
+        if (status != ZX_OK)
+            return status;
+    } else {
+        data0.reset(new (&ac) uint8_t[count * elemsize]);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        data1.reset(new (&ac) uint8_t[count * elemsize]);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+    }
 
     auto fifo0 = fbl::AdoptRef(new (&ac) FifoDispatcher(fbl::move(holder0), options, count,
-                                                        elemsize, fbl::move(data0)));
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
-
-    auto data1 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
+                                                        elemsize, fbl::move(data0),
+                                                        fbl::move(shared0)));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
     auto fifo1 = fbl::AdoptRef(new (&ac) FifoDispatcher(fbl::move(holder1), options, count,
-                                                        elemsize, fbl::move(data1)));
+                                                        elemsize, fbl::move(data1),
+                                                        fbl::move(shared1)));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
@@ -62,12 +82,75 @@ zx_status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t o
     return ZX_OK;
 }
 
+// static
+zx_status_t FifoDispatcher::CreateSharedRing(uint32_t count, uint32_t elemsize,
+                                             fbl::unique_ptr<SharedRing>* out) {
+    static_assert(kMaxSizeBytes <= PAGE_SIZE, "shared ring data must fit in one page");
+    const size_t vmo_size = 2 * PAGE_SIZE;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<SharedRing> ring(new (&ac) SharedRing());
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, vmo_size, &ring->vmo);
+    if (status != ZX_OK)
+        return status;
+
+    // The kernel touches the ring with the dispatcher lock held, so it must
+    // never fault; pinning also stops the peers from decommitting it.
+    uint64_t committed;
+    status = ring->vmo->CommitRange(0, vmo_size, &committed);
+    if (status != ZX_OK)
+        return status;
+    status = ring->vmo->Pin(0, vmo_size);
+    if (status != ZX_OK)
+        return status;
+
+    status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+        0 /* ignored */, vmo_size, 0 /* align pow2 */, 0 /* vmar flags */,
+        ring->vmo, 0, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE, "fifo_shared",
+        &ring->mapping);
+    if (status != ZX_OK) {
+        ring->vmo->Unpin(0, vmo_size);
+        return status;
+    }
+    status = ring->mapping->MapRange(0, vmo_size, true);
+    if (status != ZX_OK) {
+        ring->mapping->Destroy();
+        ring->mapping.reset();
+        ring->vmo->Unpin(0, vmo_size);
+        return status;
+    }
+
+    ring->header = reinterpret_cast<zx_fifo_shared_header_t*>(ring->mapping->base());
+    ring->header->head = 0u;
+    ring->header->tail = 0u;
+    ring->header->elem_count = count;
+    ring->header->elem_size = elemsize;
+    ring->header->data_offset = PAGE_SIZE;
+
+    *out = fbl::move(ring);
+    return ZX_OK;
+}
+
+FifoDispatcher::SharedRing::~SharedRing() {
+    if (mapping) {
+        mapping->Destroy();
+        vmo->Unpin(0, 2 * PAGE_SIZE);
+    }
+}
+
 FifoDispatcher::FifoDispatcher(fbl::RefPtr<PeerHolder<FifoDispatcher>> holder,
                                uint32_t /*options*/, uint32_t count, uint32_t elem_size,
-                               fbl::unique_ptr<uint8_t[]> data)
+                               fbl::unique_ptr<uint8_t[]> buffer,
+                               fbl::unique_ptr<SharedRing> shared)
     : PeeredDispatcher(fbl::move(holder), ZX_FIFO_WRITABLE),
       elem_count_(count), elem_size_(elem_size), mask_(count - 1),
-      peer_koid_(0u), head_(0u), tail_(0u), data_(fbl::move(data)) {
+      peer_koid_(0u), head_(0u), tail_(0u), buffer_(fbl::move(buffer)),
+      shared_(fbl::move(shared)) {
+    data_ = shared_ ? reinterpret_cast<uint8_t*>(shared_->mapping->base() + PAGE_SIZE)
+                    : buffer_.get();
 }
 
 FifoDispatcher::~FifoDispatcher() {
@@ -121,6 +204,77 @@ void FifoDispatcher::OnPeerZeroHandlesLocked() TA_NO_THREAD_SAFETY_ANALYSIS {
     UpdateStateLocked(ZX_FIFO_WRITABLE, ZX_FIFO_PEER_CLOSED);
 }
 
+bool FifoDispatcher::LoadIndicesLocked(uint32_t* head, uint32_t* tail)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (!shared_) {
+        *head = head_;
+        *tail = tail_;
+        return true;
+    }
+    *head = __atomic_load_n(&shared_->header->head, __ATOMIC_ACQUIRE);
+    *tail = __atomic_load_n(&shared_->header->tail, __ATOMIC_ACQUIRE);
+    return (*head - *tail) <= elem_count_;
+}
+
+void FifoDispatcher::StoreHeadLocked(uint32_t head) TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (shared_) {
+        __atomic_store_n(&shared_->header->head, head, __ATOMIC_RELEASE);
+    } else {
+        head_ = head;
+    }
+}
+
+void FifoDispatcher::StoreTailLocked(uint32_t tail) TA_NO_THREAD_SAFETY_ANALYSIS {
+    if (shared_) {
+        __atomic_store_n(&shared_->header->tail, tail, __ATOMIC_RELEASE);
+    } else {
+        tail_ = tail;
+    }
+}
+
+void FifoDispatcher::RefreshSignalsLocked() TA_NO_THREAD_SAFETY_ANALYSIS {
+    uint32_t head, tail;
+    if (!LoadIndicesLocked(&head, &tail))
+        return;
+
+    uint32_t used = head - tail;
+    if (used == 0) {
+        UpdateStateLocked(ZX_FIFO_READABLE, 0u);
+    } else {
+        UpdateStateLocked(0u, ZX_FIFO_READABLE);
+    }
+    if (other_) {
+        if (used == elem_count_) {
+            other_->UpdateStateLocked(ZX_FIFO_WRITABLE, 0u);
+        } else {
+            other_->UpdateStateLocked(0u, ZX_FIFO_WRITABLE);
+        }
+    }
+}
+
+zx_status_t FifoDispatcher::GetSharedVmo(uint32_t which, fbl::RefPtr<VmObject>* vmo)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    canary_.Assert();
+
+    if (!shared_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    switch (which) {
+    case ZX_FIFO_SHARED_READ:
+        *vmo = shared_->vmo;
+        return ZX_OK;
+    case ZX_FIFO_SHARED_WRITE: {
+        AutoLock lock(get_lock());
+        if (!other_)
+            return ZX_ERR_PEER_CLOSED;
+        *vmo = other_->shared_->vmo;
+        return ZX_OK;
+    }
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+}
+
 zx_status_t FifoDispatcher::WriteFromUser(user_in_ptr<const uint8_t> ptr, size_t len, uint32_t* actual) {
     canary_.Assert();
 
@@ -128,6 +282,15 @@ zx_status_t FifoDispatcher::WriteFromUser(user_in_ptr<const uint8_t> ptr, size_t
     if (!other_)
         return ZX_ERR_PEER_CLOSED;
 
+    // A zero-length write on a shared fifo tells us the peers moved the
+    // indices themselves.
+    if (shared_ && len == 0) {
+        other_->RefreshSignalsLocked();
+        RefreshSignalsLocked();
+        *actual = 0u;
+        return ZX_OK;
+    }
+
     return other_->WriteSelfLocked(ptr, len, actual);
 }
 
@@ -139,10 +302,14 @@ zx_status_t FifoDispatcher::WriteSelfLocked(user_in_ptr<const uint8_t> ptr, size
     if (count == 0)
         return ZX_ERR_OUT_OF_RANGE;
 
-    uint32_t old_head = head_;
+    uint32_t head, tail;
+    if (!LoadIndicesLocked(&head, &tail))
+        return ZX_ERR_BAD_STATE;
+
+    uint32_t old_head = head;
 
     // total number of available empty slots in the fifo
-    size_t avail = elem_count_ - (head_ - tail_);
+    size_t avail = elem_count_ - (head - tail);
 
     if (avail == 0)
         return ZX_ERR_SHOULD_WAIT;
@@ -153,7 +320,7 @@ zx_status_t FifoDispatcher::WriteSelfLocked(user_in_ptr<const uint8_t> ptr, size
         count = avail;
 
     while (count > 0) {
-        uint32_t offset = (head_ & mask_);
+        uint32_t offset = (head & mask_);
 
         // number of slots from target to end, inclusive
         uint32_t n = elem_count_ - offset;
@@ -161,30 +328,31 @@ zx_status_t FifoDispatcher::WriteSelfLocked(user_in_ptr<const uint8_t> ptr, size
         // number of slots we can actually copy
         size_t to_copy = (count > n) ? n : count;
 
+        // nothing is published until the copy completes, so a fault
+        // needs no roll back
         zx_status_t status = ptr.copy_array_from_user(&data_[offset * elem_size_],
                                                       to_copy * elem_size_);
-        if (status != ZX_OK) {
-            // roll back, in case this is the second copy
-            head_ = old_head;
+        if (status != ZX_OK)
             return ZX_ERR_INVALID_ARGS;
-        }
 
         // adjust head and count
         // due to size limitations on fifo, to_copy will always fit in a u32
-        head_ += static_cast<uint32_t>(to_copy);
+        head += static_cast<uint32_t>(to_copy);
         count -= to_copy;
         ptr = ptr.byte_offset(to_copy * elem_size_);
     }
 
+    StoreHeadLocked(head);
+
     // if was empty, we've become readable
     if (was_empty)
         UpdateStateLocked(0u, ZX_FIFO_READABLE);
 
     // if now full, we're no longer writable
-    if (elem_count_ == (head_ - tail_))
+    if (elem_count_ == (head - tail))
         other_->UpdateStateLocked(ZX_FIFO_WRITABLE, 0u);
 
-    *actual = (head_ - old_head);
+    *actual = (head - old_head);
     return ZX_OK;
 }
 
@@ -192,16 +360,29 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
     TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
 
+    if (shared_ && bytelen == 0) {
+        AutoLock lock(get_lock());
+        RefreshSignalsLocked();
+        if (other_)
+            other_->RefreshSignalsLocked();
+        *actual = 0u;
+        return ZX_OK;
+    }
+
     size_t count = bytelen / elem_size_;
     if (count == 0)
         return ZX_ERR_OUT_OF_RANGE;
 
     AutoLock lock(get_lock());
 
-    uint32_t old_tail = tail_;
+    uint32_t head, tail;
+    if (!LoadIndicesLocked(&head, &tail))
+        return ZX_ERR_BAD_STATE;
+
+    uint32_t old_tail = tail;
 
     // total number of available entries to read from the fifo
-    size_t avail = (head_ - tail_);
+    size_t avail = (head - tail);
 
     if (avail == 0)
         return ZX_ERR_SHOULD_WAIT;
@@ -212,7 +393,7 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
         count = avail;
 
     while (count > 0) {
-        uint32_t offset = (tail_ & mask_);
+        uint32_t offset = (tail & mask_);
 
         // number of slots from target to end, inclusive
         uint32_t n = elem_count_ - offset;
@@ -220,29 +401,30 @@ zx_status_t FifoDispatcher::ReadToUser(user_out_ptr<uint8_t> ptr, size_t bytelen
         // number of slots we can actually copy
         size_t to_copy = (count > n) ? n : count;
 
+        // nothing is consumed until the copy completes, so a fault
+        // needs no roll back
         zx_status_t status = ptr.copy_array_to_user(&data_[offset * elem_size_],
                                                     to_copy * elem_size_);
-        if (status != ZX_OK) {
-            // roll back, in case this is the second copy
-            tail_ = old_tail;
+        if (status != ZX_OK)
             return ZX_ERR_INVALID_ARGS;
-        }
 
         // adjust tail and count
         // due to size limitations on fifo, to_copy will always fit in a u32
-        tail_ += static_cast<uint32_t>(to_copy);
+        tail += static_cast<uint32_t>(to_copy);
         count -= to_copy;
         ptr = ptr.byte_offset(to_copy * elem_size_);
     }
 
+    StoreTailLocked(tail);
+
     // if we were full, we have become writable
     if (was_full && other_)
         other_->UpdateStateLocked(0u, ZX_FIFO_WRITABLE);
 
     // if we've become empty, we're no longer readable
-    if ((head_ - tail_) == 0)
+    if ((head - tail) == 0)
         UpdateStateLocked(ZX_FIFO_READABLE, 0u);
 
-    *actual = (tail_ - old_tail);
+    *actual = (tail - old_tail);
     return ZX_OK;
 }
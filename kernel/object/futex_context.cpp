@@ -8,6 +8,7 @@
 
 #include <assert.h>
 #include <lib/user_copy/user_ptr.h>
+#include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <object/thread_dispatcher.h>
 #include <trace.h>
@@ -26,10 +27,31 @@ FutexContext::~FutexContext() {
 
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
-    DEBUG_ASSERT(futex_table_.is_empty());
+    for (auto& bucket : buckets_) {
+        AutoLock lock(&bucket.lock);
+        DEBUG_ASSERT(bucket.futex_table.is_empty());
+    }
+}
+
+FutexContext::Bucket* FutexContext::GetBucket(uintptr_t futex_key) {
+    // Fibonacci hashing, so that futexes laid out at a regular stride (for
+    // example, one per element of an array of structs) still spread over
+    // all of the buckets.
+    uint64_t hash = static_cast<uint64_t>(futex_key >> 2) * 0x9e3779b97f4a7c15ull;
+    return &buckets_[hash >> (64 - kNumBucketsShift)];
+}
+
+// Called by a thread waking the waiters of a futex it was named the owner
+// of. The inheirited priority is not dropped here: the caller holds a
+// bucket lock, and releasing it (the last mutex the thread holds) undoes
+// the inheritance.
+static void ReleaseFutexPriority() {
+    AutoThreadLock lock;
+    get_current_thread()->futex_priority_held = false;
 }
 
-zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline) {
+zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline,
+                                    ThreadDispatcher* owner) {
     LTRACE_ENTRY;
 
     uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
@@ -42,27 +64,42 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     // If a FutexWake() operation could occur between them, a userland mutex
     // operation built on top of futexes would have a race condition that
     // could miss wakeups.
-    lock_.Acquire();
+    Bucket* bucket = GetBucket(futex_key);
+    bucket->lock.Acquire();
 
     int value;
     zx_status_t result = value_ptr.copy_from_user(&value);
     if (result != ZX_OK) {
-        lock_.Release();
+        bucket->lock.Release();
         return result;
     }
     if (value != current_value) {
-        lock_.Release();
+        bucket->lock.Release();
         return ZX_ERR_BAD_STATE;
     }
 
     FutexNode node;
     node.set_hash_key(futex_key);
+    node.set_owner(owner);
     node.SetAsSingletonList();
 
-    QueueNodesLocked(&node);
+    QueueNodesLocked(bucket, &node);
+
+    ThreadDispatcher* current = ThreadDispatcher::GetCurrent();
+    if (owner) {
+        AutoThreadLock lock;
+        current->BlockOnFutexOwnerLocked(owner);
+    }
+    auto unblock = fbl::MakeAutoCall([owner, current]() {
+        if (owner) {
+            AutoThreadLock lock;
+            current->UnblockFromFutexOwnerLocked();
+        }
+    });
 
-    // Block current thread.  This releases lock_ and does not reacquire it.
-    result = node.BlockThread(&lock_, deadline);
+    // Block current thread.  This releases the bucket lock and does not
+    // reacquire it.
+    result = node.BlockThread(&bucket->lock, deadline);
     if (result == ZX_OK) {
         DEBUG_ASSERT(!node.IsInQueue());
         // All the work necessary for removing us from the hash table was done by FutexWake()
@@ -75,8 +112,7 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     //
     // We need to ensure that the thread's node is removed from the wait
     // queue, because FutexWake() probably didn't do that.
-    AutoLock lock(&lock_);
-    if (UnqueueNodeLocked(&node)) {
+    if (UnqueueNode(&node)) {
         return result;
     }
     // The current thread was not found on the wait queue.  This means
@@ -111,22 +147,26 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
-    AutoLock lock(&lock_);
+    Bucket* bucket = GetBucket(futex_key);
+    AutoLock lock(&bucket->lock);
 
-    FutexNode* node = futex_table_.erase(futex_key);
+    FutexNode* node = bucket->futex_table.erase(futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
     }
     DEBUG_ASSERT(node->GetKey() == futex_key);
 
+    if (node->owner() == ThreadDispatcher::GetCurrent())
+        ReleaseFutexPriority();
+
     bool any_woken = false;
     FutexNode* remaining_waiters =
         FutexNode::WakeThreads(node, count, futex_key, &any_woken);
 
     if (remaining_waiters) {
         DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
-        futex_table_.insert(remaining_waiters);
+        bucket->futex_table.insert(remaining_waiters);
     }
 
     if (any_woken) {
@@ -138,34 +178,52 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
 }
 
 zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t wake_count, int current_value,
-                                       user_in_ptr<const int> requeue_ptr, uint32_t requeue_count) {
+                                       user_in_ptr<const int> requeue_ptr, uint32_t requeue_count)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACE_ENTRY;
 
     if ((requeue_ptr.get() == nullptr) && requeue_count)
         return ZX_ERR_INVALID_ARGS;
 
-    AutoLock lock(&lock_);
+    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
+    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
+    Bucket* wake_bucket = GetBucket(wake_key);
+    Bucket* requeue_bucket = GetBucket(requeue_key);
+
+    // Take both bucket locks, lowest-addressed bucket first, so that
+    // requeues running in opposite directions cannot deadlock.
+    Bucket* first = wake_bucket < requeue_bucket ? wake_bucket : requeue_bucket;
+    Bucket* second = wake_bucket < requeue_bucket ? requeue_bucket : wake_bucket;
+    first->lock.Acquire();
+    if (second != first)
+        second->lock.Acquire();
+    auto unlock = fbl::MakeAutoCall([first, second]() TA_NO_THREAD_SAFETY_ANALYSIS {
+        if (second != first)
+            second->lock.Release();
+        first->lock.Release();
+    });
 
     int value;
     zx_status_t result = wake_ptr.copy_from_user(&value);
     if (result != ZX_OK) return result;
     if (value != current_value) return ZX_ERR_BAD_STATE;
 
-    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
-    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
     if (wake_key == requeue_key) return ZX_ERR_INVALID_ARGS;
     if (wake_key % sizeof(int) || requeue_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
     // This must happen before RemoveFromHead() calls set_hash_key() on
-    // nodes below, because operations on futex_table_ look at the GetKey
+    // nodes below, because operations on futex_table look at the GetKey
     // field of the list head nodes for wake_key and requeue_key.
-    FutexNode* node = futex_table_.erase(wake_key);
+    FutexNode* node = wake_bucket->futex_table.erase(wake_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
     }
 
+    if (node->owner() == ThreadDispatcher::GetCurrent())
+        ReleaseFutexPriority();
+
     bool any_woken = false;
     if (wake_count > 0) {
         node = FutexNode::WakeThreads(node, wake_count, wake_key, &any_woken);
@@ -181,26 +239,26 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
 
             // now requeue our nodes to requeue_ptr mutex
             DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
-            QueueNodesLocked(requeue_head);
+            QueueNodesLocked(requeue_bucket, requeue_head);
         }
     }
 
     // add any remaining nodes back to wake_key futex
     if (node != nullptr) {
         DEBUG_ASSERT(node->GetKey() == wake_key);
-        futex_table_.insert(node);
+        wake_bucket->futex_table.insert(node);
     }
 
     if (any_woken) {
-        lock.release();
+        unlock.call();
         thread_reschedule();
     }
 
     return ZX_OK;
 }
 
-void FutexContext::QueueNodesLocked(FutexNode* head) {
-    DEBUG_ASSERT(lock_.IsHeld());
+void FutexContext::QueueNodesLocked(Bucket* bucket, FutexNode* head) {
+    DEBUG_ASSERT(bucket->lock.IsHeld());
 
     FutexNode::HashTable::iterator iter;
 
@@ -208,29 +266,38 @@ void FutexContext::QueueNodesLocked(FutexNode* head) {
     // succeeds, then the current thread is first to block on this futex and we
     // are finished.  If the insert fails, then there is already a thread
     // waiting on this futex.  Add ourselves to that thread's list.
-    if (!futex_table_.insert_or_find(head, &iter))
+    if (!bucket->futex_table.insert_or_find(head, &iter))
         iter->AppendList(head);
 }
 
 // This attempts to unqueue a thread (which may or may not be waiting on a
 // futex), given its FutexNode.  This returns whether the FutexNode was
 // found and removed from a futex wait queue.
-bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
-    DEBUG_ASSERT(lock_.IsHeld());
-
-    if (!node->IsInQueue())
-        return false;
-
-    // Note: When UnqueueNode() is called from FutexWait(), it might be
-    // tempting to reuse the futex key that was passed to FutexWait().
-    // However, that could be out of date if the thread was requeued by
-    // FutexRequeue(), so we need to re-get the hash table key here.
-    uintptr_t futex_key = node->GetKey();
-
-    FutexNode* old_head = futex_table_.erase(futex_key);
-    DEBUG_ASSERT(old_head);
-    FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
-    if (new_head)
-        futex_table_.insert(new_head);
-    return true;
+bool FutexContext::UnqueueNode(FutexNode* node) {
+    for (;;) {
+        // Note: When UnqueueNode() is called from FutexWait(), it might be
+        // tempting to reuse the futex key that was passed to FutexWait().
+        // However, that could be out of date if the thread was requeued by
+        // FutexRequeue(), so we need to re-get the hash table key here.
+        //
+        // The key only changes with the lock of the bucket it hashes to
+        // held, so once we hold that lock and the key still matches, the
+        // node cannot move under us. If it moved before we got the lock,
+        // try again with the new key.
+        uintptr_t futex_key = node->GetKey();
+        Bucket* bucket = GetBucket(futex_key);
+        AutoLock lock(&bucket->lock);
+        if (node->GetKey() != futex_key)
+            continue;
+
+        if (!node->IsInQueue())
+            return false;
+
+        FutexNode* old_head = bucket->futex_table.erase(futex_key);
+        DEBUG_ASSERT(old_head);
+        FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
+        if (new_head)
+            bucket->futex_table.insert(new_head);
+        return true;
+    }
 }
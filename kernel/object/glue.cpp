@@ -185,6 +185,7 @@ static void object_glue_init(uint level) TA_NO_THREAD_SAFETY_ANALYSIS {
     root_job = JobDispatcher::CreateRootJob();
     policy_manager = PolicyManager::Create();
     PortDispatcher::Init();
+    ProcessDispatcher::Init();
     // Be sure to update kernel_cmdline.md if any of these defaults change.
     oom_init(cmdline_get_bool("kernel.oom.enable", true),
              ZX_SEC(cmdline_get_uint64("kernel.oom.sleep-sec", 1)),
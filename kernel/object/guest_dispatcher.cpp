@@ -7,9 +7,11 @@
 #include <object/guest_dispatcher.h>
 
 #include <arch/hypervisor.h>
+#include <hypervisor/guest_physical_address_space.h>
 #include <vm/vm_object.h>
 #include <zircon/rights.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/array.h>
 
 // static
 zx_status_t GuestDispatcher::Create(fbl::RefPtr<VmObject> physmem,
@@ -40,3 +42,40 @@ zx_status_t GuestDispatcher::SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
     canary_.Assert();
     return guest_->SetTrap(kind, addr, len, fbl::move(port), key);
 }
+
+zx_status_t GuestDispatcher::GetDirtyPages(zx_vaddr_t addr, size_t len,
+                                           user_out_ptr<void> user_bitmap, size_t bitmap_size) {
+    canary_.Assert();
+
+    if (!IS_PAGE_ALIGNED(addr) || !IS_PAGE_ALIGNED(len))
+        return ZX_ERR_INVALID_ARGS;
+    if (SIZE_MAX - len < addr || addr + len > guest_->AddressSpace()->size())
+        return ZX_ERR_OUT_OF_RANGE;
+    const size_t num_pages = len / PAGE_SIZE;
+    const size_t num_bytes = (num_pages + 7) / 8;
+    if (bitmap_size < num_bytes)
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    if (num_pages == 0)
+        return ZX_OK;
+
+    const size_t num_words = (num_pages + 63) / 64;
+    fbl::AllocChecker ac;
+    fbl::Array<uint64_t> bitmap(new (&ac) uint64_t[num_words](), num_words);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    zx_status_t status = guest_->GetDirtyPages(addr, len, bitmap.get());
+    if (status != ZX_OK)
+        return status;
+
+    // The words are little-endian, so their bytes are in the order of the
+    // pages.
+    status = user_bitmap.copy_array_to_user(bitmap.get(), num_bytes);
+    if (status != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    return ZX_OK;
+}
+
+void GuestDispatcher::GetStats(zx_info_guest_stats_t* stats) const {
+    canary_.Assert();
+    guest_->AddressSpace()->GetStats(stats);
+}
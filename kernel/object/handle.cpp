@@ -198,11 +198,15 @@ void Handle::Delete() {
 
 Handle* Handle::FromU32(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
     Handle* handle = IndexToHandle(value & kHandleIndexMask);
-    {
-        AutoLock lock(&mutex_);
-        if (unlikely(!arena_.in_range(handle)))
-            return nullptr;
-    }
+    // The range check does not need |mutex_|: callers hold the owning
+    // process's handle table lock, so a handle that belongs to the caller
+    // cannot be freed underneath us. A slot racing with another process's
+    // alloc or free may be read stale, but then its base value will not
+    // match and the lookup fails as it would have with the lock held.
+    // Skipping the global lock keeps lookups in different processes from
+    // serializing on each other.
+    if (unlikely(!arena_.in_range(handle)))
+        return nullptr;
     return likely(handle->base_value() == value) ? handle : nullptr;
 }
 
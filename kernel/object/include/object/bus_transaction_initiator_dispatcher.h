@@ -0,0 +1,119 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <dev/iommu.h>
+#include <fbl/array.h>
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/ref_ptr.h>
+#include <fbl/unique_ptr.h>
+#include <object/dispatcher.h>
+#include <vm/vm_object.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/types.h>
+
+#include <sys/types.h>
+
+// A range of a VMO held in memory and mapped for one bus transaction
+// initiator. Unmapped and released when destroyed.
+class PinnedMemoryObject final
+    : public fbl::DoublyLinkedListable<fbl::unique_ptr<PinnedMemoryObject>> {
+public:
+    // |offset| and |size| must be page aligned, and |size| non-zero.
+    static zx_status_t Create(fbl::RefPtr<Iommu> iommu, uint64_t bti_id,
+                              fbl::RefPtr<VmObject> vmo, uint64_t offset, uint64_t size,
+                              uint32_t perms, fbl::unique_ptr<PinnedMemoryObject>* out);
+    ~PinnedMemoryObject();
+
+    bool Matches(const VmObject* vmo, uint64_t offset, uint64_t size, uint32_t perms) const {
+        return vmo_.get() == vmo && offset_ == offset && size_ == size && perms_ == perms;
+    }
+
+    dev_vaddr_t base_addr() const { return mappings_[0].base; }
+    uint64_t size() const { return size_; }
+
+    // Writes the device address of each page of the range to |addrs|.
+    void GetAddrs(dev_vaddr_t* addrs) const;
+
+    // Pins outstanding, over pins of the same range.
+    uint32_t pin_count = 0;
+    // Whether the mapping is kept once |pin_count| drops to zero.
+    bool cacheable = false;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PinnedMemoryObject);
+
+private:
+    struct Mapping {
+        dev_vaddr_t base;
+        size_t len;
+    };
+
+    PinnedMemoryObject(fbl::RefPtr<Iommu> iommu, uint64_t bti_id, fbl::RefPtr<VmObject> vmo,
+                       uint64_t offset, uint64_t size, uint32_t perms,
+                       fbl::Array<Mapping> mappings);
+
+    zx_status_t MapRange();
+
+    const fbl::RefPtr<Iommu> iommu_;
+    const uint64_t bti_id_;
+    const fbl::RefPtr<VmObject> vmo_;
+    const uint64_t offset_;
+    const uint64_t size_;
+    const uint32_t perms_;
+    bool pinned_ = false;
+
+    // At most one mapping per page, the IOMMU may map more at once.
+    fbl::Array<Mapping> mappings_;
+    size_t mapping_count_ = 0;
+};
+
+// A device, or other agent issuing bus transactions, as the IOMMU sees it.
+// Hands out device addresses for ranges of VMOs, which stay valid until they
+// are unpinned or the last handle to the BTI is closed.
+class BusTransactionInitiatorDispatcher final : public SoloDispatcher {
+public:
+    static zx_status_t Create(fbl::RefPtr<Iommu> iommu, uint64_t bti_id,
+                              fbl::RefPtr<Dispatcher>* dispatcher, zx_rights_t* rights);
+
+    ~BusTransactionInitiatorDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_BTI; }
+    void on_zero_handles() final;
+
+    // Pins the pages [offset, offset + size) of |vmo|, maps them, and writes the
+    // device address of each page to |addrs|, which has room for all of them.
+    // |options| holds ZX_BTI_PERM_* and ZX_BTI_CACHE flags. Pinning a range
+    // which is already pinned, or cached, with the same permissions reuses it.
+    zx_status_t Pin(fbl::RefPtr<VmObject> vmo, uint64_t offset, uint64_t size,
+                    uint32_t options, dev_vaddr_t* addrs);
+
+    // Undoes one Pin() of the range of |size| bytes at |base_addr|.
+    zx_status_t Unpin(dev_vaddr_t base_addr, uint64_t size);
+
+    void GetInfo(zx_info_bti_t* info);
+
+private:
+    BusTransactionInitiatorDispatcher(fbl::RefPtr<Iommu> iommu, uint64_t bti_id);
+
+    using PmoList = fbl::DoublyLinkedList<fbl::unique_ptr<PinnedMemoryObject>>;
+
+    // Unpinned ranges kept mapped for ZX_BTI_CACHE, the oldest are dropped past this.
+    static constexpr size_t kMaxCachedPins = 16;
+
+    fbl::Canary<fbl::magic("BTID")> canary_;
+
+    const fbl::RefPtr<Iommu> iommu_;
+    const uint64_t bti_id_;
+
+    PmoList pinned_ TA_GUARDED(get_lock());
+    // Most recently unpinned first.
+    PmoList cached_ TA_GUARDED(get_lock());
+    size_t pinned_count_ TA_GUARDED(get_lock()) = 0;
+    size_t cached_count_ TA_GUARDED(get_lock()) = 0;
+    uint64_t cache_hits_ TA_GUARDED(get_lock()) = 0;
+    bool closed_ TA_GUARDED(get_lock()) = false;
+};
@@ -23,6 +23,8 @@ class ChannelDispatcher final : public PeeredDispatcher<ChannelDispatcher> {
 public:
     class MessageWaiter;
 
+    using MessageList = fbl::DoublyLinkedList<fbl::unique_ptr<MessagePacket>>;
+
     static zx_status_t Create(fbl::RefPtr<Dispatcher>* dispatcher0,
                               fbl::RefPtr<Dispatcher>* dispatcher1, zx_rights_t* rights);
 
@@ -45,8 +47,24 @@ public:
                      fbl::unique_ptr<MessagePacket>* msg,
                      bool may_disard);
 
+    // Read up to |count| messages from this endpoint's message queue in one go, stopping early
+    // at the first message that does not fit in the limits at the same position in |msg_sizes|
+    // and |msg_handle_counts|.  The messages read are appended to |msgs|.  Returns ZX_OK if any
+    // message was read.  If the first message doesn't fit, returns ZX_ERR_BUFFER_TOO_SMALL and
+    // leaves the message queued, with its size and handle count in the first entries of
+    // |msg_sizes| and |msg_handle_counts|.
+    zx_status_t ReadMany(size_t count,
+                         uint32_t* msg_sizes,
+                         uint32_t* msg_handle_counts,
+                         MessageList* msgs);
+
     // Write to the opposing endpoint's message queue.
     zx_status_t Write(fbl::unique_ptr<MessagePacket> msg) TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // Write every message in |msgs| to the opposing endpoint's message queue, in order and
+    // without interleaving other writers.  On failure nothing is written and |msgs| is left
+    // intact, still owning its handles, so that the caller can return them.
+    zx_status_t WriteMany(MessageList* msgs) TA_NO_THREAD_SAFETY_ANALYSIS;
     zx_status_t Call(fbl::unique_ptr<MessagePacket> msg,
                      zx_time_t deadline, bool* return_handles,
                      fbl::unique_ptr<MessagePacket>* reply) TA_NO_THREAD_SAFETY_ANALYSIS;
@@ -93,14 +111,16 @@ public:
     };
 
 private:
-    using MessageList = fbl::DoublyLinkedList<fbl::unique_ptr<MessagePacket>>;
     using WaiterList = fbl::DoublyLinkedList<MessageWaiter*>;
 
     void RemoveWaiter(MessageWaiter* waiter);
 
     explicit ChannelDispatcher(fbl::RefPtr<PeerHolder<ChannelDispatcher>> holder);
     void Init(fbl::RefPtr<ChannelDispatcher> other);
-    int WriteSelf(fbl::unique_ptr<MessagePacket> msg) TA_REQ(get_lock());
+    // |writer_idle| says the writing end has nothing left to read, so a
+    // thread replying to a call on it is likely to wait next.
+    int WriteSelf(fbl::unique_ptr<MessagePacket> msg, bool writer_idle = false)
+        TA_REQ(get_lock());
     zx_status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask) TA_REQ(get_lock());
     void OnPeerZeroHandlesLocked();
 
@@ -11,6 +11,7 @@
 #include <zircon/types.h>
 #include <fbl/ref_ptr.h>
 
+class JobDispatcher;
 class ProcessDispatcher;
 class VmAspace;
 
@@ -44,7 +45,21 @@ zx_status_t GetProcessVmosViaHandles(ProcessDispatcher* process,
                                      user_out_ptr<zx_info_vmo_t> vmos, size_t max,
                                      size_t* actual, size_t* available);
 
+// Writes an entry for |job| and for every job, process and thread under it
+// into |nodes|, which must point to enough memory for |max| entries, in the
+// order walk_job_tree() visits them. The number of entries written is
+// returned via |actual|, and the number entries that could have been written
+// is returned via |available|.
+// NOTE: Code outside of the syscall layer should not typically know about
+// user_ptrs; do not use this pattern as an example.
+zx_status_t GetJobTree(JobDispatcher* job,
+                       user_out_ptr<zx_info_task_node_t> nodes, size_t max,
+                       size_t* actual, size_t* available);
+
 // Prints (with the supplied prefix) the number of mapped, committed bytes for
 // each process in the system whose page count > |min_pages|. Does not take
 // sharing into account, and does not count unmapped VMOs.
 void DumpProcessMemoryUsage(const char* prefix, size_t min_pages);
+
+// Adds the times and counts in |runtime| to |total|.
+void AddTaskRuntime(zx_info_task_runtime_t* total, const zx_info_task_runtime_t& runtime);
@@ -59,6 +59,8 @@ DECLARE_DISPTAG(GuestDispatcher, ZX_OBJ_TYPE_GUEST)
 DECLARE_DISPTAG(VcpuDispatcher, ZX_OBJ_TYPE_VCPU)
 DECLARE_DISPTAG(TimerDispatcher, ZX_OBJ_TYPE_TIMER)
 DECLARE_DISPTAG(IommuDispatcher, ZX_OBJ_TYPE_IOMMU)
+DECLARE_DISPTAG(PagerDispatcher, ZX_OBJ_TYPE_PAGER)
+DECLARE_DISPTAG(BusTransactionInitiatorDispatcher, ZX_OBJ_TYPE_BTI)
 
 #undef DECLARE_DISPTAG
 
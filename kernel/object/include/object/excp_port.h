@@ -13,8 +13,10 @@
 #include <object/dispatcher.h>
 
 #include <zircon/syscalls/exception.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/syscalls/port.h>
 #include <zircon/types.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
@@ -59,6 +61,14 @@ public:
     static void BuildArchReport(zx_exception_report_t* report, uint32_t type,
                                 const arch_exception_context_t* arch_context);
 
+    // Called when the handler responds to a report sent by SendPacket(),
+    // |response_time| after it was sent.
+    void OnExceptionResponse(zx_duration_t response_time);
+
+    // Fills in the counters for ZX_INFO_PORT_EXCEPTION_STATS. Doesn't take
+    // |lock_|, so it can be called with the port's lock held.
+    void GetStats(zx_info_exception_port_stats_t* stats) const;
+
 private:
     friend class PortDispatcher;
 
@@ -105,6 +115,12 @@ private:
 
     fbl::Mutex lock_;
 
+    // For GetStats().
+    fbl::atomic<uint64_t> exceptions_{0};
+    fbl::atomic<uint64_t> responses_{0};
+    fbl::atomic<zx_duration_t> total_response_time_{0};
+    fbl::atomic<zx_duration_t> max_response_time_{0};
+
     // NOTE: The DoublyLinkedListNodeState is guarded by |port_|'s lock,
     // and should only be touched using port_->LinkExceptionPort()
     // or port_->UnlinkExceptionPort(). This goes for ::InContainer(), too.
@@ -9,11 +9,14 @@
 #include <stdint.h>
 
 #include <object/dispatcher.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_object.h>
 
 #include <zircon/types.h>
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
+#include <fbl/unique_ptr.h>
 #include <lib/user_copy/user_ptr.h>
 
 class FifoDispatcher final : public PeeredDispatcher<FifoDispatcher> {
@@ -34,14 +37,43 @@ public:
     zx_status_t WriteFromUser(user_in_ptr<const uint8_t> src, size_t len, uint32_t* actual);
     zx_status_t ReadToUser(user_out_ptr<uint8_t> dst, size_t len, uint32_t* actual);
 
+    // Returns the VMO holding the ring this endpoint reads from
+    // (ZX_FIFO_SHARED_READ) or writes to (ZX_FIFO_SHARED_WRITE), or
+    // ZX_ERR_NOT_SUPPORTED if the fifo was not created with ZX_FIFO_SHARED.
+    zx_status_t GetSharedVmo(uint32_t which, fbl::RefPtr<VmObject>* vmo);
+
 private:
+    // A ZX_FIFO_SHARED ring: a header page followed by the elements, pinned
+    // and mapped into the kernel so it can be accessed under the lock.
+    struct SharedRing {
+        ~SharedRing();
+
+        fbl::RefPtr<VmObject> vmo;
+        fbl::RefPtr<VmMapping> mapping;
+        zx_fifo_shared_header_t* header = nullptr;
+    };
+
+    static zx_status_t CreateSharedRing(uint32_t count, uint32_t elemsize,
+                                        fbl::unique_ptr<SharedRing>* out);
+
     FifoDispatcher(fbl::RefPtr<PeerHolder<FifoDispatcher>> holder,
                    uint32_t options, uint32_t elem_count, uint32_t elem_size,
-                   fbl::unique_ptr<uint8_t[]> data);
+                   fbl::unique_ptr<uint8_t[]> buffer, fbl::unique_ptr<SharedRing> shared);
     void Init(fbl::RefPtr<FifoDispatcher> other);
     zx_status_t WriteSelfLocked(user_in_ptr<const uint8_t> ptr, size_t len, uint32_t* actual);
     zx_status_t UserSignalSelfLocked(uint32_t clear_mask, uint32_t set_mask);
 
+    // head_ and tail_ live in the shared header for ZX_FIFO_SHARED fifos,
+    // where the peers can change them at any time. These load a consistent
+    // pair and fail if userspace left the ring in an impossible state.
+    bool LoadIndicesLocked(uint32_t* head, uint32_t* tail);
+    void StoreHeadLocked(uint32_t head);
+    void StoreTailLocked(uint32_t tail);
+
+    // Recomputes the signals that depend on this endpoint's ring after the
+    // peers updated it directly.
+    void RefreshSignalsLocked();
+
     void OnPeerZeroHandlesLocked();
 
     fbl::Canary<fbl::magic("FIFO")> canary_;
@@ -53,7 +85,10 @@ private:
     fbl::RefPtr<FifoDispatcher> other_ TA_GUARDED(get_lock());
     uint32_t head_ TA_GUARDED(get_lock());
     uint32_t tail_ TA_GUARDED(get_lock());
-    fbl::unique_ptr<uint8_t[]> data_ TA_GUARDED(get_lock());
+    // Either |buffer_| or |shared_| owns the memory |data_| points to.
+    fbl::unique_ptr<uint8_t[]> buffer_ TA_GUARDED(get_lock());
+    const fbl::unique_ptr<SharedRing> shared_;
+    uint8_t* data_ TA_GUARDED(get_lock());
 
     static constexpr uint32_t kMaxSizeBytes = PAGE_SIZE;
 };
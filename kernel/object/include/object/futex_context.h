@@ -11,6 +11,8 @@
 #include <fbl/mutex.h>
 #include <object/futex_node.h>
 
+class ThreadDispatcher;
+
 // FutexContext is a class that encapsulates support for futex operations.
 // FutexContext uses a hash table keyed on the futex address (a pointer to integer in userspace)
 // to contain all active futexes.
@@ -23,6 +25,8 @@
 // When the thread at the head of the futex's blocked thread list is resumed,
 // The FutexNode for the new head of the blocked thread list is set as the hash table value
 // for the futex.
+// The table is split into buckets by futex address, each with its own lock, so that
+// operations on unrelated futexes in the same process do not contend.
 class FutexContext {
 public:
     FutexContext();
@@ -33,7 +37,11 @@ public:
     // Otherwise it will block the current thread until the |deadline| passes,
     // or until the thread is woken by a FutexWake or FutexRequeue operation
     // on the same |value_ptr| futex.
-    zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline);
+    // If |owner| is not null, it is the thread holding the lock the futex
+    // implements, and it inherits the current thread's priority until it
+    // releases the futex by waking its waiters.
+    zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline,
+                          ThreadDispatcher* owner = nullptr);
 
     // FutexWake will wake up to |count| number of threads blocked on the |value_ptr| futex.
     zx_status_t FutexWake(user_in_ptr<const int> value_ptr, uint32_t count);
@@ -51,14 +59,23 @@ private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
 
-    void QueueNodesLocked(FutexNode* head) TA_REQ(lock_);
+    // A shard of the futex table. A FutexNode's queue membership and key
+    // are protected by the lock of the bucket its key hashes to.
+    struct Bucket {
+        fbl::Mutex lock;
+        FutexNode::HashTable futex_table TA_GUARDED(lock);
+    };
+
+    static constexpr size_t kNumBucketsShift = 4;
+    static constexpr size_t kNumBuckets = 1u << kNumBucketsShift;
+
+    Bucket* GetBucket(uintptr_t futex_key);
 
-    bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
+    static void QueueNodesLocked(Bucket* bucket, FutexNode* head) TA_REQ(bucket->lock);
 
-    // protects futex_table_
-    fbl::Mutex lock_;
+    // Removes |node| from its wait queue if it is still on one, taking the
+    // lock of whichever bucket it is queued in. Returns whether it was found.
+    bool UnqueueNode(FutexNode* node);
 
-    // Hash table for futexes in this context.
-    // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
-    FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+    Bucket buckets_[kNumBuckets];
 };
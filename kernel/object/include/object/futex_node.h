@@ -13,6 +13,8 @@
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/mutex.h>
 
+class ThreadDispatcher;
+
 // Node for linked list of threads blocked on a futex
 // Intended to be embedded within a ThreadDispatcher Instance
 class FutexNode : public fbl::SinglyLinkedListable<FutexNode*> {
@@ -44,12 +46,18 @@ public:
     // This must be called with |mutex| held and returns without |mutex| held.
     zx_status_t BlockThread(fbl::Mutex* mutex, zx_time_t deadline) TA_REL(mutex);
 
+    // The key may be read without the bucket lock by
+    // FutexContext::UnqueueNode(), so it is accessed atomically.
     void set_hash_key(uintptr_t key) {
-        hash_key_ = key;
+        __atomic_store_n(&hash_key_, key, __ATOMIC_RELAXED);
     }
 
+    // The thread this node's waiter named as the futex owner, if any.
+    void set_owner(ThreadDispatcher* owner) { owner_ = owner; }
+    ThreadDispatcher* owner() const { return owner_; }
+
     // Trait implementation for fbl::HashTable
-    uintptr_t GetKey() const { return hash_key_; }
+    uintptr_t GetKey() const { return __atomic_load_n(&hash_key_, __ATOMIC_RELAXED); }
     static size_t GetHash(uintptr_t key) { return (key >> 3); }
 
 private:
@@ -62,7 +70,9 @@ private:
 
     // hash_key_ contains the futex address.  This field has two roles:
     //  * It is used by FutexWait() to determine which queue to remove the
-    //    thread from when a wait operation times out.
+    //    thread from when a wait operation times out.  It is left intact
+    //    when the thread is woken, so that FutexWait() locks the same
+    //    bucket that the waker held.
     //  * Additionally, when this FutexNode is the head of a futex wait
     //    queue, this field is used by the HashTable (because it uses
     //    intrusive SinglyLinkedLists).
@@ -78,4 +88,6 @@ private:
     //  * When the thread is not waiting on a futex, queue_next_ is null.
     FutexNode* queue_prev_ = nullptr;
     FutexNode* queue_next_ = nullptr;
+
+    ThreadDispatcher* owner_ = nullptr;
 };
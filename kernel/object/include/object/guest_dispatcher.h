@@ -7,7 +7,9 @@
 #pragma once
 
 #include <zircon/syscalls/hypervisor.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/types.h>
+#include <lib/user_copy/user_ptr.h>
 #include <object/port_dispatcher.h>
 
 class Guest;
@@ -25,6 +27,9 @@ public:
 
     zx_status_t SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
                         fbl::RefPtr<PortDispatcher> port, uint64_t key);
+    void GetStats(zx_info_guest_stats_t* stats) const;
+    zx_status_t GetDirtyPages(zx_vaddr_t addr, size_t len, user_out_ptr<void> bitmap,
+                              size_t bitmap_size);
 
 private:
     fbl::Canary<fbl::magic("GSTD")> canary_;
@@ -6,12 +6,18 @@
 
 #pragma once
 
+#include <arch/ops.h>
+#include <kernel/dpc.h>
 #include <kernel/event.h>
+#include <kernel/spinlock.h>
+#include <lib/user_copy/user_ptr.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/types.h>
 #include <fbl/atomic.h>
 #include <fbl/mutex.h>
 #include <fbl/vector.h>
 #include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
 #include <sys/types.h>
 
 #define SIGNAL_MASK(signal) (1ul << (signal))
@@ -29,13 +35,27 @@ public:
     // Signal the IRQ from non-IRQ state in response to a user-land request.
     zx_status_t UserSignal(uint32_t slot, zx_time_t timestamp);
     zx_status_t WaitForInterrupt(uint64_t* out_slots);
+    // Delivers the interrupts to |port| as packets with |key|, instead of
+    // to WaitForInterrupt().
+    zx_status_t BindPort(fbl::RefPtr<PortDispatcher> port, uint64_t key);
+    // Unmasks the level triggered interrupts of |slots|, which are masked
+    // when they fire, once their packet has been handled.
+    zx_status_t Ack(uint64_t slots);
     zx_status_t GetTimeStamp(uint32_t slot, zx_time_t* out_timestamp);
+    // Routes the interrupt bound to |slot| to |cpu|.
+    zx_status_t SetAffinity(uint32_t slot, cpu_num_t cpu);
+    // Reports how many times each bound interrupt fired on each cpu.
+    zx_status_t GetStats(user_out_ptr<zx_info_interrupt_stats_t> stats, size_t max,
+                         size_t* actual, size_t* available);
 
 protected:
     virtual void MaskInterrupt(uint32_t vector) = 0;
     virtual void UnmaskInterrupt(uint32_t vector) = 0;
     virtual zx_status_t RegisterInterruptHandler(uint32_t vector, void* data) = 0;
     virtual void UnregisterInterruptHandler(uint32_t vector) = 0;
+    virtual zx_status_t SetInterruptAffinity(uint32_t vector, cpu_num_t cpu) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
 
     zx_status_t AddSlotLocked(uint32_t slot, uint32_t vector, uint32_t flags) TA_REQ(get_lock());
 
@@ -44,10 +64,12 @@ protected:
 
     void on_zero_handles() final;
 
-    int Signal(uint64_t signals, bool reschedule) {
-        signals_.fetch_or(signals);
-        return event_signal_etc(&event_, reschedule, ZX_OK);
-    }
+    int Signal(uint64_t signals, bool reschedule);
+
+    // Called from the irq handlers of subclasses. Hands the Signal() off to
+    // a high priority dpc, so the handler returns without touching the
+    // port or the waiters.
+    void DeferSignal(uint64_t signals);
 
     // slot used for canceling wait on last handle closed
     static constexpr uint64_t INTERRUPT_CANCEL_MASK = SIGNAL_MASK(63);
@@ -63,9 +85,20 @@ protected:
         uint16_t vector;
         uint16_t slot;
         uint32_t flags;
+        // Number of times the interrupt fired on each cpu, each written
+        // only by that cpu's handler.
+        volatile uint64_t counts[SMP_MAX_CPUS];
     };
 
+    // Called from the irq handlers of subclasses.
+    static void CountInterrupt(Interrupt* interrupt) {
+        interrupt->counts[arch_curr_cpu_num()]++;
+    }
+
 private:
+    bool IsBoundToPort();
+    static void SignalDpc(dpc_t* dpc);
+
     // interrupts bound to this dispatcher
     fbl::Vector<Interrupt> interrupts_;
 
@@ -77,4 +110,13 @@ private:
     fbl::atomic<uint64_t> signals_;
     // the signaled slots most recently returned from WaitForInterrupt()
     fbl::atomic<uint64_t> reported_signals_;
+    // slots signaled by DeferSignal() that signal_dpc_ has yet to pass on
+    fbl::atomic<uint64_t> deferred_signals_;
+    dpc_t signal_dpc_;
+
+    // Signal() is called in interrupt context, so the port is guarded by
+    // a spinlock.
+    SpinLock port_lock_;
+    fbl::RefPtr<PortDispatcher> port_ TA_GUARDED(port_lock_);
+    PortPacket port_packet_;
 };
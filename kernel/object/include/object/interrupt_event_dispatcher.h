@@ -26,6 +26,7 @@ protected:
     void UnmaskInterrupt(uint32_t vector) final;
     zx_status_t RegisterInterruptHandler(uint32_t vector, void* data) final;
     void UnregisterInterruptHandler(uint32_t vector) final;
+    zx_status_t SetInterruptAffinity(uint32_t vector, cpu_num_t cpu) final;
 
 private:
     explicit InterruptEventDispatcher() {}
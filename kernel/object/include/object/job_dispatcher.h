@@ -92,6 +92,10 @@ public:
     void RemoveChildProcess(ProcessDispatcher* process);
     void Kill();
 
+    // Sums the time accounting of every thread in the job's tree of
+    // processes, including those which have exited.
+    void GetRuntime(zx_info_task_runtime_t* info);
+
     // Set policy. |mode| is is either ZX_JOB_POL_RELATIVE or ZX_JOB_POL_ABSOLUTE and
     // in_policy is an array of |count| elements.
     zx_status_t SetPolicy(uint32_t mode, const zx_policy_basic* in_policy, size_t policy_count);
@@ -195,6 +199,10 @@ private:
 
     pol_cookie_t policy_ TA_GUARDED(get_lock());
 
+    // Time accounting of the processes and jobs which have left |procs_|
+    // and |jobs_|.
+    zx_info_task_runtime_t exited_runtime_ TA_GUARDED(get_lock()) = {};
+
     fbl::RefPtr<ExceptionPort> exception_port_ TA_GUARDED(get_lock());
 
     // Global list of JobDispatchers, ordered by relative importance. Used to
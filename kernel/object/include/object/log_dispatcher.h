@@ -7,6 +7,7 @@
 #pragma once
 
 #include <lib/debuglog.h>
+#include <lib/user_copy/user_ptr.h>
 #include <object/dispatcher.h>
 
 #include <zircon/types.h>
@@ -24,8 +25,14 @@ public:
 
     zx_status_t Write(uint32_t flags, const void* ptr, size_t len);
     zx_status_t Read(uint32_t flags, void* ptr, size_t len, size_t* actual);
+    // Copies out as many whole records as fit in |len|, each padded to a
+    // 4-byte boundary. Fails with ZX_ERR_SHOULD_WAIT only if there were none.
+    zx_status_t ReadMultiple(user_out_ptr<void> ptr, size_t len, size_t* actual);
 
 private:
+    // Size of the on-stack buffer ReadMultiple copies records through.
+    static constexpr size_t kReadMultipleChunk = 4 * DLOG_MAX_RECORD;
+
     explicit LogDispatcher(uint32_t flags);
 
     static void Notify(void* cookie);
@@ -20,6 +20,9 @@ public:
     zx_status_t WriteStream(user_in_ptr<const void> src, size_t len, size_t* written);
     zx_status_t WriteDatagram(user_in_ptr<const void> src, size_t len, size_t* written);
     size_t Read(user_out_ptr<void> dst, size_t len, bool datagram);
+    // Reads up to |count| datagrams, each into a slot of |slot_size| bytes
+    // led by a zx_socket_datagram_t. Returns the number read.
+    size_t ReadDatagrams(user_out_ptr<void> dst, size_t slot_size, size_t count);
     bool is_full() const;
     bool is_empty() const;
     size_t size() const { return size_; }
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <list.h>
 #include <stdint.h>
 
 #include <lib/user_copy/user_ptr.h>
@@ -21,6 +22,7 @@ static_assert(ZX_CHANNEL_MAX_MSG_BYTES == kMaxMessageSize, "");
 static_assert(ZX_CHANNEL_MAX_MSG_HANDLES == kMaxMessageHandles, "");
 
 class Handle;
+class VmAspace;
 
 class MessagePacket : public fbl::DoublyLinkedListable<fbl::unique_ptr<MessagePacket>> {
 public:
@@ -34,13 +36,24 @@ public:
                               uint32_t num_handles,
                               fbl::unique_ptr<MessagePacket>* msg);
 
+    // Like the user Create(), but when |data| is page aligned and large enough, the
+    // whole pages of the buffer are moved out of |aspace| into the packet instead of
+    // being copied. Moved pages of the caller's buffer read as zero afterwards, even if
+    // the packet is never delivered. Falls back to copying when the pages can't be moved.
+    static zx_status_t CreateByMove(VmAspace* aspace, user_in_ptr<const void> data,
+                                    uint32_t data_size, uint32_t num_handles,
+                                    fbl::unique_ptr<MessagePacket>* msg);
+
     uint32_t data_size() const { return data_size_; }
 
     // Copies the packet's |data_size()| bytes to |buf|.
     // Returns an error if |buf| points to a bad user address.
-    zx_status_t CopyDataTo(user_out_ptr<void> buf) const {
-        return buf.copy_array_to_user(data(), data_size_);
-    }
+    zx_status_t CopyDataTo(user_out_ptr<void> buf) const;
+
+    // Same as CopyDataTo(), but pages moved in by CreateByMove() are handed straight to
+    // the mapping backing |buf| in |aspace| where possible. The packet's data is
+    // undefined afterwards.
+    zx_status_t MoveDataTo(VmAspace* aspace, user_out_ptr<void> buf);
 
     uint32_t num_handles() const { return num_handles_; }
     Handle* const* handles() const { return handles_; }
@@ -54,31 +67,49 @@ public:
         if (data_size_ < sizeof(zx_txid_t)) {
             return 0;
         } else {
-            return *(reinterpret_cast<const zx_txid_t*>(data()));
+            return *(reinterpret_cast<const zx_txid_t*>(loaned_size_ ? loaned_data(0) : data()));
         }
     }
 
 private:
-    MessagePacket(uint32_t data_size, uint32_t num_handles, Handle** handles);
+    MessagePacket(uint32_t data_size, uint32_t num_handles, Handle** handles,
+                  uint32_t cache_cpu);
     ~MessagePacket();
 
     // Allocates a new packet that can hold the specified amount of
     // data/handles.
     static zx_status_t NewPacket(uint32_t data_size, uint32_t num_handles,
-                                 fbl::unique_ptr<MessagePacket>* msg);
+                                 fbl::unique_ptr<MessagePacket>* msg,
+                                 uint32_t loaned_size = 0u);
 
-    // Create() uses malloc(), so we must delete using free().
-    static void operator delete(void* ptr) {
-        free(ptr);
-    }
+    // Packets come either from a per-cpu packet cache or from malloc(), so
+    // they must be returned to wherever |cache_cpu_| says they came from.
+    static void operator delete(void* ptr);
     friend class fbl::unique_ptr<MessagePacket>;
 
+    // |cache_cpu_| value for packets allocated with malloc().
+    static constexpr uint32_t kNoCache = UINT32_MAX;
+
     // Handles and data are stored in the same buffer: num_handles_ Handle*
-    // entries first, then the data buffer.
+    // entries first, then the data buffer. When pages have been loaned to the
+    // packet, the buffer only holds the bytes past |loaned_size_|.
     void* data() const { return static_cast<void*>(handles_ + num_handles_); }
 
+    // Kernel address of the |index|th loaned page.
+    void* loaned_data(size_t index) const;
+
+    // Copies the loaned pages from |index| onwards, then the inline tail.
+    zx_status_t CopyDataFrom(size_t index, user_out_ptr<void> buf) const;
+
     Handle** const handles_;
     const uint32_t data_size_;
     const uint16_t num_handles_;
     bool owns_handles_;
+
+    // Not touched by the destructor; operator delete reads it afterwards.
+    const uint32_t cache_cpu_;
+
+    // Whole pages moved out of the sender's buffer, in order.
+    list_node loaned_pages_ = LIST_INITIAL_VALUE(loaned_pages_);
+    uint32_t loaned_size_ = 0u;
 };
@@ -0,0 +1,89 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+#include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <vm/page_source.h>
+#include <vm/vm_object_paged.h>
+#include <zircon/types.h>
+
+#include <sys/types.h>
+
+class PagerDispatcher;
+
+// The page source of one VMO created by a pager. Page requests for the VMO are
+// turned into ZX_PKT_TYPE_PAGE_REQUEST packets on the port it was created with.
+class PagerSource final : public PageSource,
+                          public fbl::DoublyLinkedListable<fbl::RefPtr<PagerSource>> {
+public:
+    PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                uint64_t key);
+    ~PagerSource() final;
+
+    // PageSource overrides.
+    zx_status_t GetPages(uint64_t offset, uint64_t len) final;
+    void OnZeroChildren(uint64_t children) final;
+    void OnDetach() final;
+
+    // Called once the VMO exists, before anybody else can see it.
+    void SetVmo(VmObjectPaged* vmo);
+
+    // Returns the VMO if it is |vmo| and still alive.
+    fbl::RefPtr<VmObjectPaged> GetVmoIf(const VmObject* vmo);
+
+    // The pager is going away, cut the VMO off.
+    void Close();
+
+private:
+    zx_status_t QueuePacket(uint16_t command, uint64_t offset, uint64_t len);
+
+    fbl::Mutex lock_;
+    // raw so that the VMO can go away while the pager still knows about it, the VMO
+    // tells us in OnDetach() before it is destroyed
+    VmObjectPaged* vmo_ TA_GUARDED(lock_) = nullptr;
+    fbl::RefPtr<PagerDispatcher> pager_ TA_GUARDED(lock_);
+
+    const fbl::RefPtr<PortDispatcher> port_;
+    const uint64_t key_;
+};
+
+class PagerDispatcher final : public SoloDispatcher {
+public:
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                              zx_rights_t* rights);
+
+    ~PagerDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_PAGER; }
+    void on_zero_handles() final;
+
+    // Create a VMO of |size| bytes whose pages are requested on |port| with |key|.
+    zx_status_t CreateSource(fbl::RefPtr<PortDispatcher> port, uint64_t key, uint64_t size,
+                             fbl::RefPtr<VmObject>* vmo);
+
+    // Move the pages of |aux_vmo| at |aux_offset| into |vmo| at |offset|. |vmo| must
+    // have been created by this pager.
+    zx_status_t SupplyPages(const fbl::RefPtr<VmObject>& vmo, uint64_t offset, uint64_t len,
+                            const fbl::RefPtr<VmObject>& aux_vmo, uint64_t aux_offset);
+
+private:
+    friend class PagerSource;
+
+    PagerDispatcher();
+
+    // Called by a source whose VMO went away.
+    void ReleaseSource(PagerSource* source);
+
+    fbl::Canary<fbl::magic("PGRD")> canary_;
+
+    fbl::DoublyLinkedList<fbl::RefPtr<PagerSource>> sources_ TA_GUARDED(get_lock());
+    bool closed_ TA_GUARDED(get_lock()) = false;
+};
@@ -6,10 +6,13 @@
 
 #pragma once
 
+#include <kernel/spinlock.h>
+#include <lib/user_copy/user_ptr.h>
 #include <object/dispatcher.h>
 #include <object/semaphore.h>
 #include <object/state_observer.h>
 
+#include <zircon/syscalls/object.h>
 #include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 #include <fbl/canary.h>
@@ -67,8 +70,8 @@
 //   Note that the object no longer has a |w| to the observer
 //   but the observer still owns the port via |rc|.
 //
-//   For repeating ports |w| is always valid until the wait is
-//   canceled.
+//   For repeating and edge-triggered ports |w| is always valid until
+//   the wait is canceled.
 //
 //   The |o1| pointer is used to destroy the port observer only
 //   when cancellation happens and the port still owns the packet.
@@ -110,8 +113,10 @@ struct PortPacket final : public fbl::DoublyLinkedListable<PortPacket*> {
 // callbacks.
 class PortObserver final : public StateObserver {
 public:
-    PortObserver(uint32_t type, const Handle* handle, fbl::RefPtr<PortDispatcher> port,
-                 uint64_t key, zx_signals_t signals);
+    // If |edge| is true, packets are only queued when one of |signals|
+    // becomes asserted, and report just the newly asserted signals.
+    PortObserver(uint32_t type, bool edge, const Handle* handle,
+                 fbl::RefPtr<PortDispatcher> port, uint64_t key, zx_signals_t signals);
     ~PortObserver() = default;
 
 private:
@@ -130,7 +135,11 @@ private:
     Flags MaybeQueue(zx_signals_t new_state, uint64_t count);
 
     const uint32_t type_;
+    const bool edge_;
     const zx_signals_t trigger_;
+    // The trigger signals which were asserted as of the last state change,
+    // for edge-triggered observers.
+    zx_signals_t asserted_;
     PortPacket packet_;
 
     fbl::RefPtr<PortDispatcher> const port_;
@@ -150,7 +159,21 @@ public:
 
     zx_status_t Queue(PortPacket* port_packet, zx_signals_t observed, uint64_t count);
     zx_status_t QueueUser(const zx_port_packet_t& packet);
+    // Queues the packet of an interrupt object bound to this port, and can
+    // be called from interrupt context. While the packet is still queued,
+    // |slots| are added to it instead.
+    void QueueInterrupt(PortPacket* port_packet, uint64_t slots, zx_time_t timestamp);
+    // Removes the packet of an interrupt object if it is queued.
+    void RemoveInterrupt(PortPacket* port_packet);
     zx_status_t Dequeue(zx_time_t deadline, zx_port_packet_t* packet);
+    // Waits until at least one packet is queued and then atomically dequeues
+    // up to |max| of them into |packets|, which may be null to discard them.
+    zx_status_t DequeueMany(zx_time_t deadline, zx_port_packet_t* packets, size_t max,
+                            size_t* actual);
+
+    // Copies out one record for each exception port bound to this port.
+    zx_status_t GetExceptionStats(user_out_ptr<zx_info_exception_port_stats_t> stats,
+                                  size_t max, size_t* actual, size_t* available);
 
     // Decides who is going to destroy the observer. If it returns |true| it
     // is the duty of the caller. If it is false it is the duty of the port.
@@ -182,4 +205,8 @@ private:
     bool zero_handles_ TA_GUARDED(get_lock());
     fbl::DoublyLinkedList<PortPacket*> packets_ TA_GUARDED(get_lock());
     fbl::DoublyLinkedList<fbl::RefPtr<ExceptionPort>> eports_ TA_GUARDED(get_lock());
+    // Packets of interrupt objects, which are queued from interrupt context
+    // and so cannot take get_lock(). They are dequeued before |packets_|.
+    SpinLock interrupt_lock_;
+    fbl::DoublyLinkedList<PortPacket*> interrupt_packets_ TA_GUARDED(interrupt_lock_);
 };
@@ -52,6 +52,17 @@ public:
         }
     };
 
+    // Traits to belong in the reaper's queue of dead processes.
+    struct ReaperListTraits {
+        static fbl::DoublyLinkedListNodeState<fbl::RefPtr<ProcessDispatcher>>& node_state(
+            ProcessDispatcher& obj) {
+            return obj.dll_reaper_;
+        }
+    };
+
+    // Starts the thread which releases the resources of dead processes.
+    static void Init();
+
     static ProcessDispatcher* GetCurrent() {
         ThreadDispatcher* current = ThreadDispatcher::GetCurrent();
         DEBUG_ASSERT(current);
@@ -191,6 +202,9 @@ public:
     // Syscall helpers
     zx_status_t GetInfo(zx_info_process_t* info);
     zx_status_t GetStats(zx_info_task_stats_t* stats);
+    void GetHandleStats(zx_info_process_handle_stats_t* stats);
+    // Sums the time accounting of the process's threads, living and exited.
+    void GetRuntime(zx_info_task_runtime_t* info) const;
     // NOTE: Code outside of the syscall layer should not typically know about
     // user_ptrs; do not use this pattern as an example.
     zx_status_t GetAspaceMaps(user_out_ptr<zx_info_maps_t> maps, size_t max,
@@ -199,6 +213,9 @@ public:
                         size_t* actual, size_t* available);
 
     zx_status_t GetThreads(fbl::Array<zx_koid_t>* threads);
+    // References to the threads, for callers which look at each thread
+    // and so must not do it under |state_lock_|.
+    zx_status_t GetThreads(fbl::Array<fbl::RefPtr<ThreadDispatcher>>* threads);
 
     // exception handling support
     zx_status_t SetExceptionPort(fbl::RefPtr<ExceptionPort> eport);
@@ -252,6 +269,11 @@ public:
         return vdso_code_address_;
     }
 
+    // As above, but returns 0 rather than taking a lock to compute it.
+    uintptr_t cached_vdso_code_address() const {
+        return vdso_code_address_;
+    }
+
 private:
     // compute the vdso code address and store in vdso_code_address_
     uintptr_t cache_vdso_code_address();
@@ -282,6 +304,11 @@ private:
     void SetStateLocked(State) TA_REQ(state_lock_);
     void FinishDeadTransition();
 
+    // Releases the handle table and address space of a dead process and
+    // signals waiters.  Runs on the reaper thread unless it is not running.
+    void ReapDead();
+    static int ReaperThread(void* arg);
+
     // Kill all threads
     void KillAllThreadsLocked() TA_REQ(state_lock_);
 
@@ -298,18 +325,28 @@ private:
     fbl::DoublyLinkedListNodeState<ProcessDispatcher*> dll_job_raw_;
     fbl::SinglyLinkedListNodeState<fbl::RefPtr<ProcessDispatcher>> dll_job_;
 
+    // Node in the reaper's queue, and when the process was queued.
+    fbl::DoublyLinkedListNodeState<fbl::RefPtr<ProcessDispatcher>> dll_reaper_;
+    zx_time_t dead_time_ = 0;
+
     uint32_t handle_rand_ = 0;
 
     // list of threads in this process
     using ThreadList = fbl::DoublyLinkedList<ThreadDispatcher*, ThreadDispatcher::ThreadListTraits>;
     ThreadList thread_list_ TA_GUARDED(state_lock_);
 
+    // Time accounting of the threads which have left |thread_list_|.
+    zx_info_task_runtime_t exited_runtime_ TA_GUARDED(state_lock_) = {};
+
     // our address space
     fbl::RefPtr<VmAspace> aspace_;
 
     // our list of handles
     mutable fbl::Mutex handle_table_lock_; // protects |handles_|.
     fbl::DoublyLinkedList<Handle*> handles_ TA_GUARDED(handle_table_lock_);
+    // Number of entries in |handles_| per object type, so that
+    // ZX_INFO_PROCESS_HANDLE_STATS does not have to walk the list.
+    uint32_t handle_type_counts_[ZX_OBJ_TYPE_LAST] TA_GUARDED(handle_table_lock_) = {};
 
     FutexContext futex_context_;
 
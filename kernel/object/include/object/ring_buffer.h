@@ -0,0 +1,59 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+
+#include <lib/user_copy/user_ptr.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+#include <fbl/ref_ptr.h>
+#include <fbl/unique_ptr.h>
+
+// A byte ring backed by a committed, pinned VMO that is mapped into the
+// kernel. It stands in for MBufChain on ZX_SOCKET_RING sockets. The first
+// page of the VMO holds a zx_socket_ring_header_t and the data follows, so
+// a reader can map the VMO and consume bytes without a syscall.
+//
+// The kernel's copy of the positions is authoritative. The header mirrors
+// them for the benefit of mappings, and the only value ever read back from
+// it is a read position advanced from userspace, which SyncReadPos() clamps
+// to the data actually present.
+class RingBuffer {
+public:
+    // |order| is log2 of the data size.
+    static zx_status_t Create(uint32_t order, fbl::unique_ptr<RingBuffer>* out);
+
+    ~RingBuffer();
+
+    zx_status_t WriteStream(user_in_ptr<const void> src, size_t len, size_t* written);
+    size_t Read(user_out_ptr<void> dst, size_t len);
+    bool is_full() const { return size() == data_size_; }
+    bool is_empty() const { return size() == 0; }
+    size_t size() const { return static_cast<size_t>(write_pos_ - read_pos_); }
+
+    // Picks up a read position advanced through a mapping of the VMO.
+    void SyncReadPos();
+
+    const fbl::RefPtr<VmObject>& vmo() const { return vmo_; }
+
+private:
+    RingBuffer(fbl::RefPtr<VmObject> vmo, fbl::RefPtr<VmMapping> mapping, size_t data_size);
+
+    // Copies between |data_| and user memory, splitting at the wrap point.
+    zx_status_t CopyIn(uint64_t pos, user_in_ptr<const void> src, size_t len);
+    zx_status_t CopyOut(uint64_t pos, user_out_ptr<void> dst, size_t len);
+
+    fbl::RefPtr<VmObject> vmo_;
+    fbl::RefPtr<VmMapping> mapping_;
+    zx_socket_ring_header_t* header_;
+    char* data_;
+    const size_t data_size_;
+    uint64_t read_pos_ = 0u;
+    uint64_t write_pos_ = 0u;
+};
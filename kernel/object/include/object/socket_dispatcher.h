@@ -12,12 +12,14 @@
 #include <object/dispatcher.h>
 #include <object/handle.h>
 #include <object/mbuf.h>
+#include <object/ring_buffer.h>
 
 #include <zircon/types.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_single_list.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
+#include <fbl/unique_ptr.h>
 
 constexpr size_t kControlMsgSize = 1024;
 
@@ -47,6 +49,12 @@ public:
 
     zx_status_t Read(user_out_ptr<void> dst, size_t len, size_t* nread);
 
+    // Reads datagrams into consecutive slots of 1 << |slot_order| bytes,
+    // as many as are queued or as fit in |len|. |nread| is the size of the
+    // slots filled.
+    zx_status_t ReadDatagrams(user_out_ptr<void> dst, size_t len, uint32_t slot_order,
+                              size_t* nread);
+
     zx_status_t ReadControl(user_out_ptr<void> dst, size_t len, size_t* nread);
 
     // On success, share takes ownership of h
@@ -59,21 +67,28 @@ public:
 
     zx_status_t CheckShareable(SocketDispatcher* to_send);
 
+    // Returns the VMO backing this endpoint's receive ring, or
+    // ZX_ERR_NOT_SUPPORTED if the socket was not created with ZX_SOCKET_RING.
+    zx_status_t GetRingVmo(fbl::RefPtr<VmObject>* vmo);
+
 private:
     // The control_msg must be either nullptr or an allocation of
     // size kControlMsgSize.
     SocketDispatcher(fbl::RefPtr<PeerHolder<SocketDispatcher>> holder,
                      zx_signals_t starting_signals, uint32_t flags,
-                     fbl::unique_ptr<char[]> control_msg);
+                     fbl::unique_ptr<char[]> control_msg, fbl::unique_ptr<RingBuffer> ring);
     void Init(fbl::RefPtr<SocketDispatcher> other);
     zx_status_t WriteSelfLocked(user_in_ptr<const void> src, size_t len, size_t* nwritten) TA_REQ(get_lock());
     zx_status_t WriteControlSelfLocked(user_in_ptr<const void> src, size_t len) TA_REQ(get_lock());
     zx_status_t UserSignalSelfLocked(uint32_t clear_mask, uint32_t set_mask) TA_REQ(get_lock());
     zx_status_t ShutdownOtherLocked(uint32_t how) TA_REQ(get_lock());
     zx_status_t ShareSelfLocked(Handle* h) TA_REQ(get_lock());
+    void UpdateSignalsAfterReadLocked(bool was_full) TA_REQ(get_lock());
+    zx_status_t EmptyReadStatusLocked() const TA_REQ(get_lock());
 
-    bool is_full() const TA_REQ(get_lock()) { return data_.is_full(); }
-    bool is_empty() const TA_REQ(get_lock()) { return data_.is_empty(); }
+    bool is_full() const TA_REQ(get_lock()) { return ring_ ? ring_->is_full() : data_.is_full(); }
+    bool is_empty() const TA_REQ(get_lock()) { return ring_ ? ring_->is_empty() : data_.is_empty(); }
+    size_t size() const TA_REQ(get_lock()) { return ring_ ? ring_->size() : data_.size(); }
 
     fbl::Canary<fbl::magic("SOCK")> canary_;
 
@@ -82,6 +97,8 @@ private:
 
     // The shared |get_lock()| protects all members below.
     MBufChain data_ TA_GUARDED(get_lock());
+    // Replaces |data_| for ZX_SOCKET_RING sockets.
+    const fbl::unique_ptr<RingBuffer> ring_;
     fbl::unique_ptr<char[]> control_msg_ TA_GUARDED(get_lock());
     size_t control_msg_len_ TA_GUARDED(get_lock());
     fbl::RefPtr<SocketDispatcher> other_ TA_GUARDED(get_lock());
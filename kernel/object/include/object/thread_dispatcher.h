@@ -105,6 +105,21 @@ public:
     zx_status_t Suspend();
     zx_status_t Resume();
 
+    // Moves the thread into the deadline scheduling class, or back out of it
+    // when |capacity| is zero.
+    zx_status_t SetDeadline(zx_duration_t capacity, zx_duration_t deadline,
+                            zx_duration_t period);
+
+    // Restricts the thread to running on the cpus in |cpu_mask|.
+    zx_status_t SetAffinity(cpu_mask_t cpu_mask);
+
+    // Priority inheritance for zx_futex_wait_owned(). Called with
+    // thread_lock held, before the current thread blocks behind |owner| and
+    // after it wakes. Blocking lends the current thread's priority to
+    // |owner| and to the owners |owner| is itself blocked behind.
+    void BlockOnFutexOwnerLocked(ThreadDispatcher* owner);
+    void UnblockFromFutexOwnerLocked();
+
     // accessors
     ProcessDispatcher* process() const { return process_.get(); }
 
@@ -132,6 +147,11 @@ public:
                                          ExceptionStatus* out_estatus);
     // Called when an exception handler is finished processing the exception.
     zx_status_t MarkExceptionHandled(ExceptionStatus estatus);
+    // As MarkExceptionHandled, but first writes |buffer| as the thread's
+    // |state_kind| state, unless |buffer_len| is zero. Neither happens unless
+    // both can.
+    zx_status_t ResumeFromException(ExceptionStatus estatus, zx_thread_state_topic_t state_kind,
+                                    const void* buffer, size_t buffer_len);
     // Called when exception port |eport| is removed.
     // If the thread is waiting for the associated exception handler, continue
     // exception processing as if the exception port had not been installed.
@@ -150,6 +170,9 @@ public:
     // Fetch per thread stats for userspace.
     zx_status_t GetStatsForUserspace(zx_info_thread_stats_t* info);
 
+    // Fetch the thread's time accounting for userspace.
+    void GetRuntime(zx_info_task_runtime_t* info) const;
+
     // For debugger usage.
     zx_status_t ReadState(zx_thread_state_topic_t state_kind, void* buffer, size_t buffer_len);
     zx_status_t WriteState(zx_thread_state_topic_t state_kind, const void* buffer,
@@ -180,6 +203,10 @@ private:
     // change states of the object, do what is appropriate for the state transition
     void SetStateLocked(State) TA_REQ(state_lock_);
 
+    zx_status_t MarkExceptionHandledLocked(ExceptionStatus estatus) TA_REQ(state_lock_);
+    zx_status_t WriteStateLocked(zx_thread_state_topic_t state_kind, const void* buffer,
+                                 size_t buffer_len) TA_REQ(state_lock_);
+
     fbl::Canary<fbl::magic("THRD")> canary_;
 
     // The containing process holds a list of all its threads.
@@ -207,11 +234,13 @@ private:
     // The exception port of the handler the thread is waiting for a response from.
     fbl::RefPtr<ExceptionPort> exception_wait_port_ TA_GUARDED(state_lock_);
     const zx_exception_report_t* exception_report_ TA_GUARDED(state_lock_);
+    // When the report was sent to |exception_wait_port_|.
+    zx_time_t exception_sent_time_ TA_GUARDED(state_lock_) = 0;
     event_t exception_event_ =
         EVENT_INITIAL_VALUE(exception_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
 
     // cleanup dpc structure
-    dpc_t cleanup_dpc_ = {LIST_INITIAL_CLEARED_VALUE, nullptr, nullptr};
+    dpc_t cleanup_dpc_ = {LIST_INITIAL_CLEARED_VALUE, nullptr, nullptr, DPC_PRIORITY_NORMAL, 0};
 
     // Used to protect thread name read/writes
     mutable SpinLock name_lock_;
@@ -230,6 +259,11 @@ private:
     // in order to suspend a thread.
     ChannelDispatcher::MessageWaiter channel_waiter_;
 
+    // The thread this one is blocked behind in zx_futex_wait_owned(), or
+    // null. Guarded by thread_lock. The waiting syscall holds a reference
+    // to it for as long as this is set.
+    ThreadDispatcher* blocked_futex_owner_ = nullptr;
+
     // LK thread structure
     // put last to ease debugging since this is a pretty large structure
     // (~1.5K on x86_64).
@@ -40,6 +40,16 @@ public:
 
     zx_status_t Unmap(vaddr_t base, size_t len);
 
+    // Apply one of the ZX_VMAR_OP_* hints to the mappings in a range.
+    zx_status_t RangeOp(uint32_t op, vaddr_t base, size_t len);
+
+    // Run the operations of a zx_vmar_batch() call.  |vmos| holds the VMO
+    // to map for each ZX_VMAR_BATCH_MAP operation.  The arguments of every
+    // operation are checked before any is run.  On return the addr of each
+    // completed map is the address of the new mapping.
+    zx_status_t Batch(zx_vmar_batch_op_t* ops, fbl::RefPtr<VmObject>* vmos, size_t count,
+                      size_t* completed);
+
     const fbl::RefPtr<VmAddressRegion>& vmar() const { return vmar_; }
 
     // Check if the given flags define an allowed combination of RWX
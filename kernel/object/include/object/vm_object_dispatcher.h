@@ -43,6 +43,12 @@ public:
 
     zx_status_t SetMappingCachePolicy(uint32_t cache_policy);
 
+    zx_status_t GetNumaNode(uint32_t* node);
+    zx_status_t SetNumaNode(uint32_t node);
+
+    zx_status_t GetMergeable(bool* mergeable);
+    zx_status_t SetMergeable(bool mergeable);
+
     const fbl::RefPtr<VmObject>& vmo() const { return vmo_; }
 
 private:
@@ -6,7 +6,15 @@
 
 #include <object/interrupt_dispatcher.h>
 
-InterruptDispatcher::InterruptDispatcher() : signals_(0) {
+#include <fbl/auto_lock.h>
+#include <kernel/auto_lock.h>
+#include <platform.h>
+
+InterruptDispatcher::InterruptDispatcher()
+    : signals_(0),
+      deferred_signals_(0),
+      signal_dpc_({LIST_INITIAL_CLEARED_VALUE, &SignalDpc, this, DPC_PRIORITY_HIGH, 0}),
+      port_packet_(nullptr, nullptr) {
     event_init(&event_, false, EVENT_FLAG_AUTOUNSIGNAL);
     reported_signals_.store(0);
     memset(slot_map_, 0xff, sizeof(slot_map_));
@@ -31,6 +39,8 @@ zx_status_t InterruptDispatcher::AddSlotLocked(uint32_t slot, uint32_t vector, u
     interrupt.flags = flags;
     interrupt.vector = static_cast<uint16_t>(vector);
     interrupt.slot = static_cast<uint16_t>(slot);
+    for (auto& count : interrupt.counts)
+        count = 0;
 
     fbl::AllocChecker ac;
     interrupts_.push_back(interrupt, &ac);
@@ -50,8 +60,75 @@ zx_status_t InterruptDispatcher::AddSlotLocked(uint32_t slot, uint32_t vector, u
     return ZX_OK;
 }
 
+int InterruptDispatcher::Signal(uint64_t signals, bool reschedule) {
+    {
+        AutoSpinLock guard(&port_lock_);
+        if (port_) {
+            port_->QueueInterrupt(&port_packet_, signals, current_time());
+            return 0;
+        }
+    }
+    signals_.fetch_or(signals);
+    return event_signal_etc(&event_, reschedule, ZX_OK);
+}
+
+void InterruptDispatcher::DeferSignal(uint64_t signals) {
+    deferred_signals_.fetch_or(signals);
+    // If the dpc is already queued it will pick these up when it runs.
+    dpc_queue(&signal_dpc_, true);
+}
+
+// static
+void InterruptDispatcher::SignalDpc(dpc_t* dpc) {
+    auto thiz = reinterpret_cast<InterruptDispatcher*>(dpc->arg);
+    uint64_t signals = thiz->deferred_signals_.exchange(0);
+    if (signals)
+        thiz->Signal(signals, true);
+}
+
+bool InterruptDispatcher::IsBoundToPort() {
+    AutoSpinLock guard(&port_lock_);
+    return port_ != nullptr;
+}
+
+zx_status_t InterruptDispatcher::BindPort(fbl::RefPtr<PortDispatcher> port, uint64_t key) {
+    {
+        AutoSpinLock guard(&port_lock_);
+        if (port_)
+            return ZX_ERR_ALREADY_BOUND;
+        port_packet_.packet.key = key;
+        port_packet_.packet.type = ZX_PKT_TYPE_INTERRUPT;
+        port_packet_.packet.status = ZX_OK;
+        port_ = fbl::move(port);
+
+        // Interrupts which fired before now are delivered to the port.
+        uint64_t signals = signals_.exchange(0);
+        if (signals)
+            port_->QueueInterrupt(&port_packet_, signals, current_time());
+    }
+
+    // Have any thread in WaitForInterrupt() return.
+    event_signal_etc(&event_, true, ZX_OK);
+    return ZX_OK;
+}
+
+zx_status_t InterruptDispatcher::Ack(uint64_t slots) {
+    if (!IsBoundToPort())
+        return ZX_ERR_BAD_STATE;
+
+    fbl::AutoLock lock(get_lock());
+    for (const auto& interrupt : interrupts_) {
+        if ((interrupt.flags & INTERRUPT_UNMASK_PREWAIT) && (slots & SIGNAL_MASK(interrupt.slot)))
+            UnmaskInterrupt(interrupt.vector);
+    }
+    return ZX_OK;
+}
+
 zx_status_t InterruptDispatcher::WaitForInterrupt(uint64_t* out_slots) {
     while (true) {
+        if (IsBoundToPort())
+            return ZX_ERR_BAD_STATE;
+
         uint64_t signals = signals_.exchange(0);
         if (signals) {
             if (signals & INTERRUPT_CANCEL_MASK)
@@ -101,6 +178,52 @@ zx_status_t InterruptDispatcher::GetTimeStamp(uint32_t slot, zx_time_t* out_time
     }
 }
 
+zx_status_t InterruptDispatcher::SetAffinity(uint32_t slot, cpu_num_t cpu) {
+    if (slot > ZX_INTERRUPT_MAX_SLOTS || cpu >= arch_max_num_cpus())
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AutoLock lock(get_lock());
+
+    uint8_t index = slot_map_[slot];
+    if (index == 0xff)
+        return ZX_ERR_NOT_FOUND;
+
+    const Interrupt& interrupt = interrupts_[index];
+    if (interrupt.flags & INTERRUPT_VIRTUAL)
+        return ZX_ERR_BAD_STATE;
+
+    return SetInterruptAffinity(interrupt.vector, cpu);
+}
+
+zx_status_t InterruptDispatcher::GetStats(user_out_ptr<zx_info_interrupt_stats_t> stats,
+                                          size_t max, size_t* actual, size_t* available) {
+    fbl::AutoLock lock(get_lock());
+
+    // One record for each cpu of each interrupt which is not virtual.
+    const cpu_num_t num_cpus = arch_max_num_cpus();
+    size_t count = 0;
+    size_t avail = 0;
+    for (const auto& interrupt : interrupts_) {
+        if (interrupt.flags & INTERRUPT_VIRTUAL)
+            continue;
+        for (cpu_num_t cpu = 0; cpu < num_cpus; cpu++) {
+            if (avail++ >= max)
+                continue;
+            zx_info_interrupt_stats_t info = {};
+            info.slot = interrupt.slot;
+            info.cpu = cpu;
+            info.count = interrupt.counts[cpu];
+            if (stats.copy_array_to_user(&info, 1, count) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+            count++;
+        }
+    }
+
+    *actual = count;
+    *available = avail;
+    return ZX_OK;
+}
+
 zx_status_t InterruptDispatcher::UserSignal(uint32_t slot, zx_time_t timestamp) {
     if (slot > ZX_INTERRUPT_MAX_SLOTS)
         return ZX_ERR_INVALID_ARGS;
@@ -128,6 +251,17 @@ void InterruptDispatcher::on_zero_handles() {
             UnregisterInterruptHandler(interrupt.vector);
         }
     }
+    // No more irqs can defer a signal, so once any dpc already queued is
+    // done with us the dispatcher can go.
+    dpc_cancel_sync(&signal_dpc_);
+
+    fbl::RefPtr<PortDispatcher> port;
+    {
+        AutoSpinLock guard(&port_lock_);
+        port = fbl::move(port_);
+    }
+    if (port)
+        port->RemoveInterrupt(&port_packet_);
 
     Signal(INTERRUPT_CANCEL_MASK, true);
 }
@@ -117,6 +117,7 @@ zx_status_t InterruptEventDispatcher::Bind(uint32_t slot, uint32_t vector, uint3
 
 void InterruptEventDispatcher::IrqHandler(void* ctx) {
     Interrupt* interrupt = reinterpret_cast<Interrupt*>(ctx);
+    CountInterrupt(interrupt);
 
     // only record timestamp if this is the first IRQ since we started waiting
     zx_time_t zero_timestamp = 0;
@@ -128,7 +129,7 @@ void InterruptEventDispatcher::IrqHandler(void* ctx) {
     if (interrupt->flags & INTERRUPT_MASK_POSTWAIT)
         mask_interrupt(interrupt->vector);
 
-    thiz->Signal(SIGNAL_MASK(interrupt->slot), true);
+    thiz->DeferSignal(SIGNAL_MASK(interrupt->slot));
 }
 
 void InterruptEventDispatcher::MaskInterrupt(uint32_t vector) {
@@ -145,3 +146,7 @@ zx_status_t InterruptEventDispatcher::RegisterInterruptHandler(uint32_t vector,
 void InterruptEventDispatcher::UnregisterInterruptHandler(uint32_t vector) {
     register_int_handler(vector, nullptr, nullptr);
 }
+
+zx_status_t InterruptEventDispatcher::SetInterruptAffinity(uint32_t vector, cpu_num_t cpu) {
+    return set_interrupt_affinity(vector, cpu);
+}
@@ -18,6 +18,7 @@
 #include <fbl/auto_lock.h>
 #include <fbl/mutex.h>
 
+#include <object/diagnostics.h>
 #include <object/process_dispatcher.h>
 
 #include <platform.h>
@@ -232,12 +233,16 @@ bool JobDispatcher::AddChildJob(JobDispatcher* job) {
 void JobDispatcher::RemoveChildProcess(ProcessDispatcher* process) {
     canary_.Assert();
 
+    zx_info_task_runtime_t runtime;
+    process->GetRuntime(&runtime);
+
     AutoLock lock(get_lock());
     // The process dispatcher can call us in its destructor, Kill(),
     // or RemoveThread().
     if (!ProcessDispatcher::JobListTraitsRaw::node_state(*process).InContainer())
         return;
     procs_.erase(*process);
+    AddTaskRuntime(&exited_runtime_, runtime);
     --process_count_;
     UpdateSignalsDecrementLocked();
 }
@@ -245,10 +250,14 @@ void JobDispatcher::RemoveChildProcess(ProcessDispatcher* process) {
 void JobDispatcher::RemoveChildJob(JobDispatcher* job) {
     canary_.Assert();
 
+    zx_info_task_runtime_t runtime;
+    job->GetRuntime(&runtime);
+
     AutoLock lock(get_lock());
     if (!JobDispatcher::ListTraitsRaw::node_state(*job).InContainer())
         return;
     jobs_.erase(*job);
+    AddTaskRuntime(&exited_runtime_, runtime);
     --job_count_;
     UpdateSignalsDecrementLocked();
 }
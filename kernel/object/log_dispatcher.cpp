@@ -10,7 +10,10 @@
 #include <zircon/syscalls/log.h>
 
 #include <err.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 
@@ -72,3 +75,39 @@ zx_status_t LogDispatcher::Read(uint32_t flags, void* ptr, size_t len, size_t* a
 
     return status;
 }
+
+zx_status_t LogDispatcher::ReadMultiple(user_out_ptr<void> ptr, size_t len, size_t* actual) {
+    canary_.Assert();
+
+    if (!(flags_ & ZX_LOG_FLAG_READABLE))
+        return ZX_ERR_BAD_STATE;
+
+    if (len < DLOG_MAX_RECORD)
+        return ZX_ERR_BUFFER_TOO_SMALL;
+
+    fbl::AutoLock lock(get_lock());
+
+    // Records are copied out of the log a bounce buffer at a time, rather
+    // than one at a time.
+    char buf[kReadMultipleChunk];
+    size_t offset = 0;
+    while (len - offset >= DLOG_MAX_RECORD) {
+        size_t chunk;
+        zx_status_t status = dlog_read_multiple(&reader_, buf,
+                                                fbl::min(sizeof(buf), len - offset), &chunk);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            UpdateStateLocked(ZX_CHANNEL_READABLE, 0);
+            if (offset > 0)
+                break;
+        }
+        if (status != ZX_OK)
+            return status;
+
+        if (ptr.byte_offset(offset).copy_array_to_user(buf, chunk) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        offset += chunk;
+    }
+
+    *actual = offset;
+    return ZX_OK;
+}
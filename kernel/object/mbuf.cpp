@@ -72,6 +72,21 @@ size_t MBufChain::Read(user_out_ptr<void> dst, size_t len, bool datagram) {
     return pos;
 }
 
+size_t MBufChain::ReadDatagrams(user_out_ptr<void> dst, size_t slot_size, size_t count) {
+    size_t n = 0;
+    while (n < count && !tail_.is_empty()) {
+        user_out_ptr<void> slot = dst.byte_offset(n * slot_size);
+        zx_socket_datagram_t header;
+        header.size = tail_.front().pkt_len_;
+        header.actual = static_cast<uint32_t>(
+            Read(slot.byte_offset(sizeof(header)), slot_size - sizeof(header), true));
+        if (slot.copy_array_to_user(&header, sizeof(header)) != ZX_OK)
+            break;
+        n++;
+    }
+    return n;
+}
+
 zx_status_t MBufChain::WriteDatagram(user_in_ptr<const void> src,
                                      size_t len, size_t* written) {
     if (len + size_ > kSizeMax)
@@ -10,12 +10,61 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <arch/ops.h>
+#include <fbl/slab_allocator.h>
+#include <lib/counters.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_aspace.h>
 #include <zxcpp/new.h>
 #include <object/handle.h>
 
+// Below this size copying the payload is cheaper than remapping it.
+static constexpr uint32_t kMinLoanSize = 16384u;
+
+KCOUNTER(channel_pages_loaned, "kernel.channel.pages_loaned");
+KCOUNTER(channel_pages_supplied, "kernel.channel.pages_supplied");
+KCOUNTER(packet_cache_hit, "kernel.channel.packet_cache.hit");
+KCOUNTER(packet_cache_miss, "kernel.channel.packet_cache.miss");
+KCOUNTER(packet_cache_full, "kernel.channel.packet_cache.full");
+
+namespace {
+
+// Packets whose handles and inline data fit in this much space after the
+// MessagePacket header come from the per-cpu packet caches rather than the
+// heap.  This covers a few hundred bytes of payload and a handful of handles.
+constexpr size_t kCachedPacketPayloadSize = 512u + 8u * sizeof(Handle*);
+
+// Each cpu's cache may grow to this many 16k slabs before packets spill back
+// onto the heap.
+constexpr size_t kMaxSlabsPerCpu = 16u;
+
+struct CachedPacket;
+using CachedPacketAllocatorTraits = fbl::ManualDeleteSlabAllocatorTraits<CachedPacket*>;
+using CachedPacketAllocator = fbl::SlabAllocator<CachedPacketAllocatorTraits>;
+
+struct CachedPacket : public fbl::SlabAllocated<CachedPacketAllocatorTraits> {
+    alignas(uint64_t) char storage[sizeof(MessagePacket) + kCachedPacketPayloadSize];
+};
+
+// Packets are returned to the cache of the cpu that allocated them, so the
+// cache's lock is only ever contended by cross-cpu frees and migrations; it
+// never touches the global heap lock except to grow by a slab.
+struct PacketCache {
+    PacketCache() : allocator(kMaxSlabsPerCpu) {}
+
+    CachedPacketAllocator allocator;
+};
+
+PacketCache packet_caches[SMP_MAX_CPUS];
+
+} // namespace
+
 // static
 zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
-                                     fbl::unique_ptr<MessagePacket>* msg) {
+                                     fbl::unique_ptr<MessagePacket>* msg,
+                                     uint32_t loaned_size) {
     // Although the API uses uint32_t, we pack the handle count into a smaller
     // field internally. Make sure it fits.
     static_assert(kMaxMessageHandles <= UINT16_MAX, "");
@@ -23,16 +72,32 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
         return ZX_ERR_OUT_OF_RANGE;
     }
 
+    DEBUG_ASSERT(loaned_size <= data_size);
+
     // Allocate space for the MessagePacket object followed by num_handles
-    // Handle*s followed by data_size bytes.
-    // TODO(dbort): Use mbuf-style memory for data_size, ideally allocating from
-    // somewhere other than the heap. Lets us better track and isolate channel
-    // memory usage.
-    char* ptr = static_cast<char*>(malloc(sizeof(MessagePacket) +
-                                          num_handles * sizeof(Handle*) +
-                                          data_size));
+    // Handle*s followed by the data_size bytes that aren't held in loaned pages.
+    // Small packets come from the current cpu's packet cache; the rest, and
+    // any that don't fit once the cache is full, come from the heap.
+    const size_t payload_size = num_handles * sizeof(Handle*) + (data_size - loaned_size);
+    uint32_t cache_cpu = kNoCache;
+    char* ptr = nullptr;
+    if (payload_size <= kCachedPacketPayloadSize) {
+        const cpu_num_t cpu = arch_curr_cpu_num();
+        CachedPacket* cached = packet_caches[cpu].allocator.New();
+        if (cached != nullptr) {
+            kcounter_add(packet_cache_hit, 1u);
+            cache_cpu = cpu;
+            ptr = cached->storage;
+        } else {
+            kcounter_add(packet_cache_full, 1u);
+        }
+    }
     if (ptr == nullptr) {
-        return ZX_ERR_NO_MEMORY;
+        kcounter_add(packet_cache_miss, 1u);
+        ptr = static_cast<char*>(malloc(sizeof(MessagePacket) + payload_size));
+        if (ptr == nullptr) {
+            return ZX_ERR_NO_MEMORY;
+        }
     }
 
     // The storage space for the Handle*s is not initialized because
@@ -41,7 +106,8 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
     // of the object.
     msg->reset(new (ptr) MessagePacket(
         data_size, num_handles,
-        reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket))));
+        reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket)), cache_cpu));
+    (*msg)->loaned_size_ = loaned_size;
     return ZX_OK;
 }
 
@@ -76,7 +142,115 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size,
     return ZX_OK;
 }
 
+// static
+zx_status_t MessagePacket::CreateByMove(VmAspace* aspace, user_in_ptr<const void> data,
+                                        uint32_t data_size, uint32_t num_handles,
+                                        fbl::unique_ptr<MessagePacket>* msg) {
+    const vaddr_t va = reinterpret_cast<vaddr_t>(data.get());
+    const uint32_t loaned_size = ROUNDDOWN(data_size, PAGE_SIZE);
+    if (data_size < kMinLoanSize || data_size > kMaxMessageSize || !IS_PAGE_ALIGNED(va)) {
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    fbl::RefPtr<VmAddressRegionOrMapping> region = aspace->FindRegion(va);
+    fbl::RefPtr<VmMapping> mapping = region ? region->as_vm_mapping() : nullptr;
+    if (!mapping || va + loaned_size < va || va + loaned_size > mapping->base() + mapping->size()) {
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    zx_status_t status = NewPacket(data_size, num_handles, msg, loaned_size);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Copy the tail first so that a fault doesn't leave the sender's pages taken.
+    const uint32_t tail_size = data_size - loaned_size;
+    if (tail_size > 0u) {
+        if (data.byte_offset(loaned_size).copy_array_from_user((*msg)->data(), tail_size) != ZX_OK) {
+            msg->reset();
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+
+    status = mapping->TakePages(va - mapping->base(), loaned_size, &(*msg)->loaned_pages_);
+    if (status != ZX_OK) {
+        // Nothing was taken; shared, pinned or partly committed buffers take the slow path.
+        msg->reset();
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    kcounter_add(channel_pages_loaned, loaned_size / PAGE_SIZE);
+    return ZX_OK;
+}
+
+void* MessagePacket::loaned_data(size_t index) const {
+    vm_page_t* page;
+    list_for_every_entry (&loaned_pages_, page, vm_page_t, free.node) {
+        if (index-- == 0) {
+            return paddr_to_physmap(vm_page_to_paddr(page));
+        }
+    }
+    return nullptr;
+}
+
+zx_status_t MessagePacket::CopyDataFrom(size_t index, user_out_ptr<void> buf) const {
+    size_t offset = 0;
+    vm_page_t* page;
+    list_for_every_entry (&loaned_pages_, page, vm_page_t, free.node) {
+        if (index > 0) {
+            index--;
+            continue;
+        }
+        const void* src = paddr_to_physmap(vm_page_to_paddr(page));
+        zx_status_t status = buf.byte_offset(offset).copy_array_to_user(src, PAGE_SIZE);
+        if (status != ZX_OK) {
+            return status;
+        }
+        offset += PAGE_SIZE;
+    }
+
+    const size_t tail_size = data_size_ - loaned_size_;
+    if (tail_size == 0u) {
+        return ZX_OK;
+    }
+    return buf.byte_offset(offset).copy_array_to_user(data(), tail_size);
+}
+
+zx_status_t MessagePacket::CopyDataTo(user_out_ptr<void> buf) const {
+    if (loaned_size_ == 0u) {
+        return buf.copy_array_to_user(data(), data_size_);
+    }
+    return CopyDataFrom(0, buf);
+}
+
+zx_status_t MessagePacket::MoveDataTo(VmAspace* aspace, user_out_ptr<void> buf) {
+    const vaddr_t va = reinterpret_cast<vaddr_t>(buf.get());
+    if (loaned_size_ == 0u || !IS_PAGE_ALIGNED(va)) {
+        return CopyDataTo(buf);
+    }
+
+    fbl::RefPtr<VmAddressRegionOrMapping> region = aspace->FindRegion(va);
+    fbl::RefPtr<VmMapping> mapping = region ? region->as_vm_mapping() : nullptr;
+    if (!mapping || va + loaned_size_ < va ||
+        va + loaned_size_ > mapping->base() + mapping->size()) {
+        return CopyDataTo(buf);
+    }
+
+    // SupplyPages() consumes pages from the head of the list, so whatever it
+    // didn't get to is still in order and can be copied.
+    const size_t count = loaned_size_ / PAGE_SIZE;
+    mapping->SupplyPages(va - mapping->base(), loaned_size_, &loaned_pages_);
+    const size_t supplied = count - list_length(&loaned_pages_);
+    kcounter_add(channel_pages_supplied, supplied);
+
+    return CopyDataFrom(0, buf.byte_offset(supplied * PAGE_SIZE));
+}
+
 MessagePacket::~MessagePacket() {
+    if (!list_is_empty(&loaned_pages_)) {
+        pmm_free(&loaned_pages_);
+    }
+
     if (owns_handles_) {
         for (size_t ix = 0; ix != num_handles_; ++ix) {
             // Delete the handle via HandleOwner dtor.
@@ -86,8 +260,26 @@ MessagePacket::~MessagePacket() {
 }
 
 MessagePacket::MessagePacket(uint32_t data_size,
-                             uint32_t num_handles, Handle** handles)
+                             uint32_t num_handles, Handle** handles,
+                             uint32_t cache_cpu)
     : handles_(handles), data_size_(data_size),
       // NewPacket ensures that num_handles fits in 16 bits.
-      num_handles_(static_cast<uint16_t>(num_handles)), owns_handles_(false) {
+      num_handles_(static_cast<uint16_t>(num_handles)), owns_handles_(false),
+      cache_cpu_(cache_cpu) {
+}
+
+// static
+void MessagePacket::operator delete(void* ptr) {
+    // As with fbl::SlabAllocated, this reads a member of the object after it has
+    // been destroyed; that is fine only because the destructor leaves
+    // |cache_cpu_| alone.
+    const uint32_t cache_cpu = static_cast<MessagePacket*>(ptr)->cache_cpu_;
+    if (cache_cpu == kNoCache) {
+        free(ptr);
+        return;
+    }
+
+    DEBUG_ASSERT(cache_cpu < SMP_MAX_CPUS);
+    static_assert(offsetof(CachedPacket, storage) == 0, "");
+    packet_caches[cache_cpu].allocator.Delete(reinterpret_cast<CachedPacket*>(ptr));
 }
@@ -0,0 +1,226 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/pager_dispatcher.h>
+
+#include <zircon/rights.h>
+#include <zircon/syscalls/port.h>
+#include <zxcpp/new.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+
+#include <assert.h>
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#define LOCAL_TRACE 0
+
+using fbl::AutoLock;
+
+PagerSource::PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                         uint64_t key)
+    : pager_(fbl::move(pager)), port_(fbl::move(port)), key_(key) {
+}
+
+PagerSource::~PagerSource() {
+    DEBUG_ASSERT(vmo_ == nullptr);
+}
+
+zx_status_t PagerSource::QueuePacket(uint16_t command, uint64_t offset, uint64_t len) {
+    auto port_packet = PortDispatcher::DefaultPortAllocator()->Alloc();
+    if (!port_packet)
+        return ZX_ERR_NO_MEMORY;
+
+    port_packet->packet.key = key_;
+    port_packet->packet.type = ZX_PKT_TYPE_PAGE_REQUEST;
+    port_packet->packet.status = ZX_OK;
+    port_packet->packet.page_request.command = command;
+    port_packet->packet.page_request.offset = offset;
+    port_packet->packet.page_request.length = len;
+
+    zx_status_t status = port_->Queue(port_packet, 0u, 0u);
+    if (status != ZX_OK)
+        port_packet->Free();
+    return status;
+}
+
+zx_status_t PagerSource::GetPages(uint64_t offset, uint64_t len) {
+    LTRACEF("key %#" PRIx64 " offset %#" PRIx64 " len %#" PRIx64 "\n", key_, offset, len);
+
+    return QueuePacket(ZX_PAGER_VMO_READ, offset, len);
+}
+
+void PagerSource::OnZeroChildren(uint64_t children) {
+    LTRACEF("key %#" PRIx64 " children %" PRIu64 "\n", key_, children);
+
+    // best effort like COMPLETE, a pager that misses it finds out when it next
+    // makes and drops a clone
+    QueuePacket(ZX_PAGER_VMO_ZERO_CHILDREN, children, 0);
+}
+
+void PagerSource::OnDetach() {
+    fbl::RefPtr<PagerDispatcher> pager;
+    {
+        AutoLock a(&lock_);
+        vmo_ = nullptr;
+        pager = fbl::move(pager_);
+    }
+
+    // let the pager know it can drop whatever state it keeps for the VMO, this is
+    // best effort since the port may be full or gone
+    QueuePacket(ZX_PAGER_VMO_COMPLETE, 0, 0);
+
+    if (pager)
+        pager->ReleaseSource(this);
+}
+
+void PagerSource::SetVmo(VmObjectPaged* vmo) {
+    AutoLock a(&lock_);
+    DEBUG_ASSERT(vmo_ == nullptr);
+    vmo_ = vmo;
+}
+
+fbl::RefPtr<VmObjectPaged> PagerSource::GetVmoIf(const VmObject* vmo) {
+    AutoLock a(&lock_);
+    if (vmo_ == nullptr || vmo_ != vmo)
+        return nullptr;
+    return fbl::internal::MakeRefPtrUpgradeFromRaw(vmo_, lock_);
+}
+
+void PagerSource::Close() {
+    fbl::RefPtr<PagerDispatcher> pager;
+    fbl::RefPtr<VmObjectPaged> vmo;
+    {
+        AutoLock a(&lock_);
+        pager = fbl::move(pager_);
+        if (vmo_ != nullptr) {
+            // a VMO that is already being destroyed calls OnDetach() shortly
+            vmo = fbl::internal::MakeRefPtrUpgradeFromRaw(vmo_, lock_);
+            if (vmo)
+                vmo_ = nullptr;
+        }
+    }
+
+    // the VMO drops its reference to us here and won't call OnDetach()
+    if (vmo)
+        vmo->DetachSource();
+}
+
+zx_status_t PagerDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                                    zx_rights_t* rights) {
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) PagerDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = ZX_DEFAULT_PAGER_RIGHTS;
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+PagerDispatcher::PagerDispatcher() {
+}
+
+PagerDispatcher::~PagerDispatcher() {
+    DEBUG_ASSERT(sources_.is_empty());
+}
+
+void PagerDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    fbl::DoublyLinkedList<fbl::RefPtr<PagerSource>> sources;
+    {
+        AutoLock a(get_lock());
+        closed_ = true;
+        sources.swap(sources_);
+    }
+
+    // nothing supplies pages for these VMOs anymore, threads waiting on them
+    // fail with ZX_ERR_BAD_STATE
+    while (!sources.is_empty())
+        sources.pop_front()->Close();
+}
+
+zx_status_t PagerDispatcher::CreateSource(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                                          uint64_t size, fbl::RefPtr<VmObject>* vmo_out) {
+    canary_.Assert();
+
+    fbl::AllocChecker ac;
+    auto source = fbl::AdoptRef(new (&ac) PagerSource(fbl::WrapRefPtr(this), fbl::move(port),
+                                                      key));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    fbl::RefPtr<VmObjectPaged> vmo;
+    zx_status_t status = VmObjectPaged::CreateExternal(source, size, &vmo);
+    if (status != ZX_OK) {
+        // the source never had a VMO, drop our reference cycle by hand
+        source->Close();
+        return status;
+    }
+    source->SetVmo(vmo.get());
+
+    bool closed;
+    {
+        AutoLock a(get_lock());
+        // the last handle may have been closed by another thread meanwhile
+        closed = closed_;
+        if (!closed)
+            sources_.push_back(source);
+    }
+    if (closed) {
+        source->Close();
+        return ZX_ERR_BAD_STATE;
+    }
+
+    *vmo_out = fbl::move(vmo);
+    return ZX_OK;
+}
+
+zx_status_t PagerDispatcher::SupplyPages(const fbl::RefPtr<VmObject>& vmo, uint64_t offset,
+                                         uint64_t len, const fbl::RefPtr<VmObject>& aux_vmo,
+                                         uint64_t aux_offset) {
+    canary_.Assert();
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len) || !IS_PAGE_ALIGNED(aux_offset))
+        return ZX_ERR_INVALID_ARGS;
+    if (len == 0)
+        return ZX_OK;
+
+    fbl::RefPtr<VmObjectPaged> pager_vmo;
+    {
+        AutoLock a(get_lock());
+        for (auto& source : sources_) {
+            pager_vmo = source.GetVmoIf(vmo.get());
+            if (pager_vmo)
+                break;
+        }
+    }
+    if (!pager_vmo)
+        return ZX_ERR_INVALID_ARGS;
+
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    zx_status_t status = aux_vmo->TakePages(aux_offset, len, &pages);
+    if (status != ZX_OK)
+        return status;
+
+    return pager_vmo->SupplyPagerPages(offset, len, &pages);
+}
+
+void PagerDispatcher::ReleaseSource(PagerSource* source) {
+    fbl::RefPtr<PagerSource> ref;
+    {
+        AutoLock a(get_lock());
+        // the list was already handed to on_zero_handles() if the pager is closing
+        if (!closed_ && source->InContainer())
+            ref = sources_.erase(*source);
+    }
+}
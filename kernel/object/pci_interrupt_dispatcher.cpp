@@ -25,6 +25,7 @@ pcie_irq_handler_retval_t PciInterruptDispatcher::IrqThunk(const PcieDevice& dev
     DEBUG_ASSERT(ctx);
 
     Interrupt* interrupt = reinterpret_cast<Interrupt*>(ctx);
+    CountInterrupt(interrupt);
 
     // only record timestamp if this is the first IRQ since we started waiting
     zx_time_t zero_timestamp = 0;
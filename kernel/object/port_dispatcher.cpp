@@ -14,6 +14,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/arena.h>
 #include <fbl/auto_lock.h>
+#include <kernel/auto_lock.h>
 #include <object/excp_port.h>
 #include <object/handle.h>
 #include <zircon/compiler.h>
@@ -87,10 +88,12 @@ size_t PortPacket::DiagnosticAllocationCount() {
     return port_allocator.DiagnosticCount();
 }
 
-PortObserver::PortObserver(uint32_t type, const Handle* handle, fbl::RefPtr<PortDispatcher> port,
-                           uint64_t key, zx_signals_t signals)
+PortObserver::PortObserver(uint32_t type, bool edge, const Handle* handle,
+                           fbl::RefPtr<PortDispatcher> port, uint64_t key, zx_signals_t signals)
     : type_(type),
+      edge_(edge),
       trigger_(signals),
+      asserted_(0u),
       packet_(handle, nullptr),
       port_(fbl::move(port)) {
 
@@ -143,10 +146,17 @@ void PortObserver::OnRemoved() {
 
 StateObserver::Flags PortObserver::MaybeQueue(zx_signals_t new_state, uint64_t count) {
     // Always called with the object state lock being held.
-    if ((trigger_ & new_state) == 0u)
+    zx_signals_t observed = new_state;
+    if (edge_) {
+        // Only the trigger signals which were not asserted before count.
+        // If a packet is already queued they are merged into it.
+        observed = trigger_ & new_state & ~asserted_;
+        asserted_ = trigger_ & new_state;
+    }
+    if ((trigger_ & observed) == 0u)
         return 0;
 
-    auto status = port_->Queue(&packet_, new_state, count);
+    auto status = port_->Queue(&packet_, observed, count);
 
     if ((type_ == ZX_PKT_TYPE_SIGNAL_ONE) || (status < 0))
         return kNeedRemoval;
@@ -250,36 +260,85 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
     return ZX_OK;
 }
 
+void PortDispatcher::QueueInterrupt(PortPacket* port_packet, uint64_t slots,
+                                    zx_time_t timestamp) {
+    canary_.Assert();
+
+    AutoSpinLock guard(&interrupt_lock_);
+    if (port_packet->InContainer()) {
+        port_packet->packet.interrupt.slots |= slots;
+        return;
+    }
+    port_packet->packet.interrupt.slots = slots;
+    port_packet->packet.interrupt.timestamp = timestamp;
+    interrupt_packets_.push_back(port_packet);
+    // The woken thread runs when the interrupt handler returns.
+    sema_.Post();
+}
+
+void PortDispatcher::RemoveInterrupt(PortPacket* port_packet) {
+    canary_.Assert();
+
+    AutoSpinLock guard(&interrupt_lock_);
+    if (port_packet->InContainer())
+        interrupt_packets_.erase(*port_packet);
+}
+
 zx_status_t PortDispatcher::Dequeue(zx_time_t deadline, zx_port_packet_t* out_packet) {
+    size_t actual;
+    return DequeueMany(deadline, out_packet, 1u, &actual);
+}
+
+zx_status_t PortDispatcher::DequeueMany(zx_time_t deadline, zx_port_packet_t* out_packets,
+                                        size_t max, size_t* actual) {
     canary_.Assert();
+    DEBUG_ASSERT(max > 0u);
 
     while (true) {
         {
             AutoLock al(get_lock());
 
-            PortPacket* port_packet = packets_.pop_front();
-            if (port_packet == nullptr)
-                goto wait;
-
-            if (out_packet != nullptr)
-                *out_packet = port_packet->packet;
-
-            PortObserver* observer = port_packet->observer;
+            size_t count = 0u;
+            {
+                AutoSpinLock guard(&interrupt_lock_);
+                while (count < max) {
+                    PortPacket* port_packet = interrupt_packets_.pop_front();
+                    if (port_packet == nullptr)
+                        break;
+                    // The packet belongs to the interrupt object.
+                    if (out_packets != nullptr)
+                        out_packets[count] = port_packet->packet;
+                    ++count;
+                }
+            }
+            while (count < max) {
+                PortPacket* port_packet = packets_.pop_front();
+                if (port_packet == nullptr)
+                    break;
+
+                if (out_packets != nullptr)
+                    out_packets[count] = port_packet->packet;
+                ++count;
+
+                PortObserver* observer = port_packet->observer;
+
+                if (observer) {
+                    // Deleting the observer under the lock is fine because
+                    // the reference that holds to this PortDispatcher is by
+                    // construction not the last one. We need to do this under
+                    // the lock because another thread can call CanReap().
+                    delete observer;
+                } else if (port_packet->is_ephemeral()) {
+                    port_packet->Free();
+                }
+            }
 
-            if (observer) {
-                // Deleting the observer under the lock is fine because
-                // the reference that holds to this PortDispatcher is by
-                // construction not the last one. We need to do this under
-                // the lock because another thread can call CanReap().
-                delete observer;
-            } else if (port_packet->is_ephemeral()) {
-                port_packet->Free();
+            if (count > 0u) {
+                *actual = count;
+                return ZX_OK;
             }
         }
 
-        return ZX_OK;
-
-wait:
         zx_status_t st = sema_.Wait(deadline, nullptr);
         if (st != ZX_OK)
             return st;
@@ -309,6 +368,7 @@ zx_status_t PortDispatcher::MakeObserver(uint32_t options, Handle* handle, uint6
         return ZX_ERR_NOT_SUPPORTED;
 
     uint32_t type;
+    bool edge = false;
     switch (options) {
         case ZX_WAIT_ASYNC_ONCE:
             type = ZX_PKT_TYPE_SIGNAL_ONE;
@@ -316,13 +376,17 @@ zx_status_t PortDispatcher::MakeObserver(uint32_t options, Handle* handle, uint6
         case ZX_WAIT_ASYNC_REPEATING:
             type = ZX_PKT_TYPE_SIGNAL_REP;
             break;
+        case ZX_WAIT_ASYNC_EDGE:
+            type = ZX_PKT_TYPE_SIGNAL_REP;
+            edge = true;
+            break;
         default:
             return ZX_ERR_INVALID_ARGS;
     }
 
     fbl::AllocChecker ac;
-    auto observer = new (&ac) PortObserver(type, handle, fbl::RefPtr<PortDispatcher>(this), key,
-                                           signals);
+    auto observer = new (&ac) PortObserver(type, edge, handle, fbl::RefPtr<PortDispatcher>(this),
+                                           key, signals);
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
@@ -376,6 +440,28 @@ bool PortDispatcher::CancelQueued(const void* handle, uint64_t key) {
 }
 
 
+zx_status_t PortDispatcher::GetExceptionStats(user_out_ptr<zx_info_exception_port_stats_t> stats,
+                                              size_t max, size_t* actual, size_t* available) {
+    canary_.Assert();
+
+    AutoLock al(get_lock());
+    size_t count = 0;
+    size_t avail = 0;
+    for (const auto& eport : eports_) {
+        if (avail++ >= max)
+            continue;
+        zx_info_exception_port_stats_t info;
+        eport.GetStats(&info);
+        if (stats.copy_array_to_user(&info, 1, count) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        count++;
+    }
+
+    *actual = count;
+    *available = avail;
+    return ZX_OK;
+}
+
 void PortDispatcher::LinkExceptionPort(ExceptionPort* eport) {
     canary_.Assert();
 
@@ -20,6 +20,7 @@
 #include <vm/vm_aspace.h>
 #include <vm/vm_object.h>
 
+#include <lib/counters.h>
 #include <lib/crypto/global_prng.h>
 #include <lib/ktrace.h>
 
@@ -35,11 +36,27 @@
 
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
+#include <fbl/intrusive_double_list.h>
 
 using fbl::AutoLock;
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(process_reap_count, "kernel.process.reap.count");
+// Total time from entering State::DEAD until resources were released.
+KCOUNTER(process_reap_latency_us, "kernel.process.reap.latency_us");
+
+namespace {
+
+// Dead processes waiting for the reaper thread.
+fbl::Mutex reaper_lock;
+fbl::DoublyLinkedList<fbl::RefPtr<ProcessDispatcher>,
+                      ProcessDispatcher::ReaperListTraits> reaper_queue TA_GUARDED(reaper_lock);
+bool reaper_running TA_GUARDED(reaper_lock) = false;
+event_t reaper_event = EVENT_INITIAL_VALUE(reaper_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+} // namespace
+
 static zx_handle_t map_handle_to_value(const Handle* handle, uint32_t mixer) {
     // Ensure that the last bit of the result is not zero, and make sure
     // we don't lose any base_value bits or make the result negative
@@ -278,8 +295,11 @@ void ProcessDispatcher::RemoveThread(ThreadDispatcher* t) {
         // we're going to check for state and possibly transition below
         AutoLock state_lock(&state_lock_);
 
-        // remove the thread from our list
+        // remove the thread from our list, keeping its time accounting
         DEBUG_ASSERT(t != nullptr);
+        zx_info_task_runtime_t runtime;
+        t->GetRuntime(&runtime);
+        AddTaskRuntime(&exited_runtime_, runtime);
         thread_list_.erase(*t);
 
         // if this was the last thread, transition directly to DEAD state
@@ -330,13 +350,62 @@ void ProcessDispatcher::SetStateLocked(State s) {
     }
 }
 
+void ProcessDispatcher::Init() {
+    thread_t* t = thread_create("reaper", ReaperThread, nullptr,
+                                DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+    if (t == nullptr) {
+        printf("process: failed to create reaper thread\n");
+        return;
+    }
+    {
+        AutoLock lock(&reaper_lock);
+        reaper_running = true;
+    }
+    thread_detach_and_resume(t);
+}
+
+int ProcessDispatcher::ReaperThread(void* arg) {
+    for (;;) {
+        event_wait(&reaper_event);
+        for (;;) {
+            fbl::RefPtr<ProcessDispatcher> process;
+            {
+                AutoLock lock(&reaper_lock);
+                process = reaper_queue.pop_front();
+            }
+            if (!process)
+                break;
+            process->ReapDead();
+        }
+    }
+    return 0;
+}
+
 // Finish processing of the transition to State::DEAD. Some things need to be done
 // outside of holding |state_lock_|. Beware this is called from several places
 // including on_zero_handles().
 void ProcessDispatcher::FinishDeadTransition() {
     DEBUG_ASSERT(!completely_dead_);
     completely_dead_ = true;
+    dead_time_ = current_time();
 
+    // Closing every handle and unmapping the whole address space takes a
+    // while for large processes, and killing a job does it for each of its
+    // processes in turn.  Hand the work to the reaper thread so neither the
+    // last exiting thread nor the killer waits for it.  Callers all hold a
+    // reference, so wrapping |this| is safe.
+    {
+        AutoLock lock(&reaper_lock);
+        if (reaper_running) {
+            reaper_queue.push_back(fbl::WrapRefPtr(this));
+            event_signal(&reaper_event, false);
+            return;
+        }
+    }
+    ReapDead();
+}
+
+void ProcessDispatcher::ReapDead() {
     // clean up the handle table
     LTRACEF_LEVEL(2, "cleaning up handle table on proc %p\n", this);
 
@@ -347,6 +416,7 @@ void ProcessDispatcher::FinishDeadTransition() {
             handle.set_process_id(0u);
         }
         to_clean.swap(handles_);
+        memset(handle_type_counts_, 0, sizeof(handle_type_counts_));
     }
 
     // zx-1544: Here is where if we're the last holder of a handle of one of
@@ -371,6 +441,10 @@ void ProcessDispatcher::FinishDeadTransition() {
     uint32_t koid = static_cast<uint32_t>(get_koid());
     ktrace(TAG_PROC_EXIT, koid, 0, 0, 0);
 
+    kcounter_add(process_reap_count, 1u);
+    kcounter_add(process_reap_latency_us,
+                 static_cast<uint64_t>((current_time() - dead_time_) / ZX_USEC(1)));
+
     // Call job_->RemoveChildProcess(this) outside of |state_lock_|. Otherwise
     // we risk a deadlock as we have |state_lock_| and RemoveChildProcess grabs
     // the job's |lock_|, whereas JobDispatcher::EnumerateChildren obtains the
@@ -413,6 +487,7 @@ void ProcessDispatcher::AddHandle(HandleOwner handle) {
 
 void ProcessDispatcher::AddHandleLocked(HandleOwner handle) {
     handle->set_process_id(get_koid());
+    handle_type_counts_[handle->dispatcher()->get_type()]++;
     handles_.push_front(handle.release());
 }
 
@@ -427,6 +502,7 @@ HandleOwner ProcessDispatcher::RemoveHandleLocked(zx_handle_t handle_value) {
         return nullptr;
 
     handle->set_process_id(0u);
+    handle_type_counts_[handle->dispatcher()->get_type()]--;
     handles_.erase(*handle);
 
     return HandleOwner(handle);
@@ -521,9 +597,21 @@ zx_status_t ProcessDispatcher::GetStats(zx_info_task_stats_t* stats) {
     stats->mem_private_bytes = usage.private_pages * PAGE_SIZE;
     stats->mem_shared_bytes = usage.shared_pages * PAGE_SIZE;
     stats->mem_scaled_shared_bytes = usage.scaled_shared_bytes;
+    stats->mem_compressed_bytes = usage.compressed_pages * PAGE_SIZE;
+    stats->mem_compressed_storage_bytes = usage.compressed_bytes;
+    stats->mem_zero_mapped_bytes = usage.zero_mapped_pages * PAGE_SIZE;
+    stats->decompress_faults = usage.decompress_faults;
+    stats->decompress_fault_time = usage.decompress_ns;
     return ZX_OK;
 }
 
+void ProcessDispatcher::GetHandleStats(zx_info_process_handle_stats_t* stats) {
+    DEBUG_ASSERT(stats != nullptr);
+    AutoLock lock(&handle_table_lock_);
+    static_assert(sizeof(stats->handle_count) == sizeof(handle_type_counts_), "");
+    memcpy(stats->handle_count, handle_type_counts_, sizeof(stats->handle_count));
+}
+
 zx_status_t ProcessDispatcher::GetAspaceMaps(
     user_out_ptr<zx_info_maps_t> maps, size_t max,
     size_t* actual, size_t* available) {
@@ -578,6 +666,25 @@ zx_status_t ProcessDispatcher::GetThreads(fbl::Array<zx_koid_t>* out_threads) {
     return ZX_OK;
 }
 
+zx_status_t ProcessDispatcher::GetThreads(
+    fbl::Array<fbl::RefPtr<ThreadDispatcher>>* out_threads) {
+    AutoLock lock(&state_lock_);
+    size_t n = thread_list_.size_slow();
+    fbl::Array<fbl::RefPtr<ThreadDispatcher>> threads;
+    fbl::AllocChecker ac;
+    threads.reset(new (&ac) fbl::RefPtr<ThreadDispatcher>[n], n);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    size_t i = 0;
+    for (auto& thread : thread_list_) {
+        threads[i] = fbl::WrapRefPtr(&thread);
+        ++i;
+    }
+    DEBUG_ASSERT(i == n);
+    *out_threads = fbl::move(threads);
+    return ZX_OK;
+}
+
 zx_status_t ProcessDispatcher::SetExceptionPort(fbl::RefPtr<ExceptionPort> eport) {
     LTRACE_ENTRY_OBJ;
     bool debugger = false;
@@ -0,0 +1,146 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/ring_buffer.h>
+
+#include <err.h>
+#include <trace.h>
+
+#include <lib/counters.h>
+#include <vm/vm_aspace.h>
+#include <vm/vm_object_paged.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+
+#define LOCAL_TRACE 0
+
+KCOUNTER(ring_buffer_created, "kernel.socket.ring.created");
+
+// static
+zx_status_t RingBuffer::Create(uint32_t order, fbl::unique_ptr<RingBuffer>* out) {
+    if (order < ZX_SOCKET_RING_MIN_ORDER || order > ZX_SOCKET_RING_MAX_ORDER)
+        return ZX_ERR_INVALID_ARGS;
+
+    const size_t data_size = 1ul << order;
+    const size_t vmo_size = PAGE_SIZE + data_size;
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, VmObjectPaged::kLargePages,
+                                               vmo_size, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    // Commit and pin everything up front. The kernel copies through its own
+    // mapping while holding the socket lock, so it must never fault, and the
+    // pin keeps a VMO handle holder from decommitting or resizing the ring.
+    uint64_t committed;
+    status = vmo->CommitRange(0, vmo_size, &committed);
+    if (status != ZX_OK)
+        return status;
+    status = vmo->Pin(0, vmo_size);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmMapping> mapping;
+    status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+        0 /* ignored */, vmo_size, 0 /* align pow2 */, 0 /* vmar flags */,
+        vmo, 0, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE, "socket_ring", &mapping);
+    if (status != ZX_OK) {
+        vmo->Unpin(0, vmo_size);
+        return status;
+    }
+    status = mapping->MapRange(0, vmo_size, true);
+    if (status != ZX_OK) {
+        mapping->Destroy();
+        vmo->Unpin(0, vmo_size);
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<RingBuffer> ring(new (&ac) RingBuffer(fbl::move(vmo), fbl::move(mapping),
+                                                          data_size));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    kcounter_add(ring_buffer_created, 1);
+    *out = fbl::move(ring);
+    return ZX_OK;
+}
+
+RingBuffer::RingBuffer(fbl::RefPtr<VmObject> vmo, fbl::RefPtr<VmMapping> mapping,
+                       size_t data_size)
+    : vmo_(fbl::move(vmo)), mapping_(fbl::move(mapping)),
+      header_(reinterpret_cast<zx_socket_ring_header_t*>(mapping_->base())),
+      data_(reinterpret_cast<char*>(mapping_->base() + PAGE_SIZE)),
+      data_size_(data_size) {
+    header_->write_pos = 0u;
+    header_->read_pos = 0u;
+    header_->data_offset = PAGE_SIZE;
+    header_->data_size = data_size_;
+}
+
+RingBuffer::~RingBuffer() {
+    mapping_->Destroy();
+    vmo_->Unpin(0, PAGE_SIZE + data_size_);
+}
+
+void RingBuffer::SyncReadPos() {
+    uint64_t pos = __atomic_load_n(&header_->read_pos, __ATOMIC_ACQUIRE);
+    // Anything outside the unread window is a stale or bogus value from
+    // userspace; ignore it rather than trusting it.
+    if (pos > read_pos_ && pos <= write_pos_)
+        read_pos_ = pos;
+}
+
+zx_status_t RingBuffer::CopyIn(uint64_t pos, user_in_ptr<const void> src, size_t len) {
+    size_t off = static_cast<size_t>(pos & (data_size_ - 1));
+    size_t first = fbl::min(len, data_size_ - off);
+    if (src.copy_array_from_user(data_ + off, first) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    if (first < len &&
+        src.byte_offset(first).copy_array_from_user(data_, len - first) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    return ZX_OK;
+}
+
+zx_status_t RingBuffer::CopyOut(uint64_t pos, user_out_ptr<void> dst, size_t len) {
+    size_t off = static_cast<size_t>(pos & (data_size_ - 1));
+    size_t first = fbl::min(len, data_size_ - off);
+    if (dst.copy_array_to_user(data_ + off, first) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    if (first < len &&
+        dst.byte_offset(first).copy_array_to_user(data_, len - first) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    return ZX_OK;
+}
+
+zx_status_t RingBuffer::WriteStream(user_in_ptr<const void> src, size_t len, size_t* written) {
+    size_t copy_len = fbl::min(len, data_size_ - size());
+    if (copy_len == 0)
+        return ZX_ERR_SHOULD_WAIT;
+
+    zx_status_t status = CopyIn(write_pos_, src, copy_len);
+    if (status != ZX_OK)
+        return status;
+
+    write_pos_ += copy_len;
+    // Publish the data before the position that covers it.
+    __atomic_store_n(&header_->write_pos, write_pos_, __ATOMIC_RELEASE);
+
+    *written = copy_len;
+    return ZX_OK;
+}
+
+size_t RingBuffer::Read(user_out_ptr<void> dst, size_t len) {
+    size_t copy_len = fbl::min(len, size());
+    if (copy_len == 0 || CopyOut(read_pos_, dst, copy_len) != ZX_OK)
+        return 0u;
+
+    read_pos_ += copy_len;
+    __atomic_store_n(&header_->read_pos, read_pos_, __ATOMIC_RELEASE);
+    return copy_len;
+}
@@ -38,6 +38,13 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
     if (flags & ~ZX_SOCKET_CREATE_MASK)
         return ZX_ERR_INVALID_ARGS;
 
+    // Rings carry a byte stream; there is nowhere to keep datagram boundaries.
+    const bool ring = flags & ZX_SOCKET_RING;
+    if (ring && (flags & ZX_SOCKET_DATAGRAM))
+        return ZX_ERR_INVALID_ARGS;
+    if (!ring && (flags & ZX_SOCKET_RING_ORDER_MASK))
+        return ZX_ERR_INVALID_ARGS;
+
     fbl::AllocChecker ac;
 
     zx_signals_t starting_signals = ZX_SOCKET_WRITABLE;
@@ -61,18 +68,36 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
             return ZX_ERR_NO_MEMORY;
     }
 
+    fbl::unique_ptr<RingBuffer> ring0;
+    fbl::unique_ptr<RingBuffer> ring1;
+
+    if (ring) {
+        uint32_t order = ZX_SOCKET_RING_ORDER_GET(flags);
+        if (order == 0)
+            order = ZX_SOCKET_RING_DEFAULT_ORDER;
+
+        zx_status_t status = RingBuffer::Create(order, &ring0);
+        if (status != ZX_OK)
+            return status;
+        status = RingBuffer::Create(order, &ring1);
+        if (status != ZX_OK)
+            return status;
+    }
+
     auto holder0 = fbl::AdoptRef(new (&ac) PeerHolder<SocketDispatcher>());
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
     auto holder1 = holder0;
 
     auto socket0 = fbl::AdoptRef(new (&ac) SocketDispatcher(fbl::move(holder0), starting_signals,
-                                                            flags, fbl::move(control0)));
+                                                            flags, fbl::move(control0),
+                                                            fbl::move(ring0)));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
     auto socket1 = fbl::AdoptRef(new (&ac) SocketDispatcher(fbl::move(holder1), starting_signals,
-                                                            flags, fbl::move(control1)));
+                                                            flags, fbl::move(control1),
+                                                            fbl::move(ring1)));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
@@ -87,10 +112,12 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
 
 SocketDispatcher::SocketDispatcher(fbl::RefPtr<PeerHolder<SocketDispatcher>> holder,
                                    zx_signals_t starting_signals, uint32_t flags,
-                                   fbl::unique_ptr<char[]> control_msg)
+                                   fbl::unique_ptr<char[]> control_msg,
+                                   fbl::unique_ptr<RingBuffer> ring)
     : PeeredDispatcher(fbl::move(holder), starting_signals),
       flags_(flags),
       peer_koid_(0u),
+      ring_(fbl::move(ring)),
       control_msg_(fbl::move(control_msg)),
       control_msg_len_(0),
       read_disabled_(false) {
@@ -282,6 +309,15 @@ zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_
                                               size_t* written) TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
 
+    if (ring_) {
+        // The reader may have drained the ring through its mapping since we
+        // last looked.
+        bool was_full = is_full();
+        ring_->SyncReadPos();
+        if (other_ && was_full && !is_full())
+            other_->UpdateStateLocked(0u, ZX_SOCKET_WRITABLE);
+    }
+
     if (is_full())
         return ZX_ERR_SHOULD_WAIT;
 
@@ -289,7 +325,9 @@ zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_
 
     size_t st = 0u;
     zx_status_t status;
-    if (flags_ & ZX_SOCKET_DATAGRAM) {
+    if (ring_) {
+        status = ring_->WriteStream(src, len, &st);
+    } else if (flags_ & ZX_SOCKET_DATAGRAM) {
         status = data_.WriteDatagram(src, len, &st);
     } else {
         status = data_.WriteStream(src, len, &st);
@@ -317,29 +355,82 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
 
     AutoLock lock(get_lock());
 
+    bool was_full = is_full();
+
+    if (ring_)
+        ring_->SyncReadPos();
+
     // Just query for bytes outstanding.
     if (!dst && len == 0) {
-        *nread = data_.size();
+        // For rings this is also how a reader that consumed data through a
+        // mapping makes the freed space visible to the writer.
+        if (ring_)
+            UpdateSignalsAfterReadLocked(was_full);
+        *nread = size();
         return ZX_OK;
     }
 
     if (len != (size_t)((uint32_t)len))
         return ZX_ERR_INVALID_ARGS;
 
-    if (is_empty()) {
-        if (!other_)
-            return ZX_ERR_PEER_CLOSED;
-        // If reading is disabled on our end and we're empty, we'll never become readable again.
-        // Return a different error to let the caller know.
-        if (read_disabled_)
-            return ZX_ERR_BAD_STATE;
-        return ZX_ERR_SHOULD_WAIT;
+    if (is_empty())
+        return EmptyReadStatusLocked();
+
+    size_t st;
+    if (ring_) {
+        st = ring_->Read(dst, len);
+    } else {
+        st = data_.Read(dst, len, flags_ & ZX_SOCKET_DATAGRAM);
     }
 
+    UpdateSignalsAfterReadLocked(was_full);
+
+    *nread = st;
+    return ZX_OK;
+}
+
+zx_status_t SocketDispatcher::ReadDatagrams(user_out_ptr<void> dst, size_t len,
+                                            uint32_t slot_order,
+                                            size_t* nread) TA_NO_THREAD_SAFETY_ANALYSIS {
+    canary_.Assert();
+
+    LTRACE_ENTRY;
+
+    if (!(flags_ & ZX_SOCKET_DATAGRAM))
+        return ZX_ERR_BAD_STATE;
+
+    if (slot_order < ZX_SOCKET_SLOT_MIN_ORDER || slot_order > ZX_SOCKET_SLOT_MAX_ORDER)
+        return ZX_ERR_INVALID_ARGS;
+
+    const size_t slot_size = size_t{1} << slot_order;
+    const size_t slots = len / slot_size;
+    if (slots == 0)
+        return ZX_ERR_BUFFER_TOO_SMALL;
+
+    AutoLock lock(get_lock());
+
+    if (is_empty())
+        return EmptyReadStatusLocked();
+
     bool was_full = is_full();
+    size_t count = data_.ReadDatagrams(dst, slot_size, slots);
+    UpdateSignalsAfterReadLocked(was_full);
+
+    *nread = count * slot_size;
+    return ZX_OK;
+}
 
-    auto st = data_.Read(dst, len, flags_ & ZX_SOCKET_DATAGRAM);
+zx_status_t SocketDispatcher::EmptyReadStatusLocked() const {
+    if (!other_)
+        return ZX_ERR_PEER_CLOSED;
+    // If reading is disabled on our end and we're empty, we'll never become readable again.
+    // Return a different error to let the caller know.
+    if (read_disabled_)
+        return ZX_ERR_BAD_STATE;
+    return ZX_ERR_SHOULD_WAIT;
+}
 
+void SocketDispatcher::UpdateSignalsAfterReadLocked(bool was_full) {
     if (is_empty()) {
         uint32_t set_mask = 0u;
         if (read_disabled_)
@@ -347,11 +438,8 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
         UpdateStateLocked(ZX_SOCKET_READABLE, set_mask);
     }
 
-    if (other_ && was_full && (st > 0))
+    if (other_ && was_full && !is_full())
         other_->UpdateStateLocked(0u, ZX_SOCKET_WRITABLE);
-
-    *nread = static_cast<size_t>(st);
-    return ZX_OK;
 }
 
 zx_status_t SocketDispatcher::ReadControl(user_out_ptr<void> dst, size_t len,
@@ -391,6 +479,16 @@ zx_status_t SocketDispatcher::CheckShareable(SocketDispatcher* to_send) {
     return ZX_OK;
 }
 
+zx_status_t SocketDispatcher::GetRingVmo(fbl::RefPtr<VmObject>* vmo) {
+    canary_.Assert();
+
+    if (!ring_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    *vmo = ring_->vmo();
+    return ZX_OK;
+}
+
 zx_status_t SocketDispatcher::Share(Handle* h) TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
 
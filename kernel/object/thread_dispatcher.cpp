@@ -16,7 +16,12 @@
 #include <arch/debugger.h>
 #include <arch/exception.h>
 
+#include <kernel/auto_lock.h>
+#include <kernel/mp.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
 #include <vm/vm_address_region.h>
@@ -40,6 +45,67 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(kstack_cache_hit, "kernel.thread.kstack_cache.hit");
+KCOUNTER(kstack_cache_miss, "kernel.thread.kstack_cache.miss");
+
+namespace {
+
+// Setting up the vmo, vmar and mapping of a kernel stack, and tearing them
+// down again, is most of the cost of creating a thread. So the stacks of
+// destroyed threads are kept, still mapped and faulted in, for the next
+// threads created on the same cpu.
+constexpr size_t kStackCacheDepth = 8u;
+
+struct KernelStack {
+    fbl::RefPtr<VmMapping> mapping;
+    fbl::RefPtr<VmAddressRegion> vmar;
+};
+
+struct StackCache {
+    SpinLock lock;
+    size_t count TA_GUARDED(lock) = 0u;
+    KernelStack stacks[kStackCacheDepth] TA_GUARDED(lock);
+};
+
+// Indexed by cpu, then by whether the stacks are unsafe stacks.
+StackCache stack_caches[SMP_MAX_CPUS][2];
+
+bool TakeCachedStack(bool unsafe, fbl::RefPtr<VmMapping>* out_kstack_mapping,
+                     fbl::RefPtr<VmAddressRegion>* out_kstack_vmar) {
+    StackCache& cache = stack_caches[arch_curr_cpu_num()][unsafe];
+    AutoSpinLock guard(&cache.lock);
+    if (cache.count == 0u)
+        return false;
+    KernelStack& stack = cache.stacks[--cache.count];
+    *out_kstack_mapping = fbl::move(stack.mapping);
+    *out_kstack_vmar = fbl::move(stack.vmar);
+    return true;
+}
+
+// Caches the stack, or frees it if this cpu's cache is full. The thread
+// that ran on it must be gone.
+void ReleaseStack(bool unsafe, fbl::RefPtr<VmMapping> kstack_mapping,
+                  fbl::RefPtr<VmAddressRegion> kstack_vmar) {
+    if (!kstack_vmar)
+        return;
+
+    if (kstack_mapping) {
+        StackCache& cache = stack_caches[arch_curr_cpu_num()][unsafe];
+        AutoSpinLock guard(&cache.lock);
+        if (cache.count < kStackCacheDepth) {
+            KernelStack& stack = cache.stacks[cache.count++];
+            stack.mapping = fbl::move(kstack_mapping);
+            stack.vmar = fbl::move(kstack_vmar);
+            return;
+        }
+    }
+
+    kstack_mapping.reset();
+    kstack_vmar->Destroy();
+}
+
+} // namespace
+
 // static
 zx_status_t ThreadDispatcher::Create(fbl::RefPtr<ProcessDispatcher> process, uint32_t flags,
                                      fbl::StringPiece name,
@@ -87,18 +153,10 @@ ThreadDispatcher::~ThreadDispatcher() {
         DEBUG_ASSERT_MSG(false, "bad state %s, this %p\n", StateToString(state_), this);
     }
 
-    // free the kernel stack
-    kstack_mapping_.reset();
-    if (kstack_vmar_) {
-        kstack_vmar_->Destroy();
-        kstack_vmar_.reset();
-    }
+    // hand the kernel stack on to the next thread, or free it
+    ReleaseStack(false, fbl::move(kstack_mapping_), fbl::move(kstack_vmar_));
 #if __has_feature(safe_stack)
-    unsafe_kstack_mapping_.reset();
-    if (unsafe_kstack_vmar_) {
-        unsafe_kstack_vmar_->Destroy();
-        unsafe_kstack_vmar_.reset();
-    }
+    ReleaseStack(true, fbl::move(unsafe_kstack_mapping_), fbl::move(unsafe_kstack_vmar_));
 #endif
 
     event_destroy(&exception_event_);
@@ -111,6 +169,12 @@ zx_status_t allocate_stack(const fbl::RefPtr<VmAddressRegion>& vmar, bool unsafe
                            fbl::RefPtr<VmAddressRegion>* out_kstack_vmar) {
     LTRACEF("allocating %s stack\n", unsafe ? "unsafe" : "safe");
 
+    if (TakeCachedStack(unsafe, out_kstack_mapping, out_kstack_vmar)) {
+        kcounter_add(kstack_cache_hit, 1u);
+        return ZX_OK;
+    }
+    kcounter_add(kstack_cache_miss, 1u);
+
     // Create a VMO for our stack
     fbl::RefPtr<VmObject> stack_vmo;
     zx_status_t status = VmObjectPaged::Create(0, DEFAULT_STACK_SIZE, &stack_vmo);
@@ -370,6 +434,69 @@ zx_status_t ThreadDispatcher::Suspend() {
     return thread_suspend(&thread_);
 }
 
+zx_status_t ThreadDispatcher::SetDeadline(zx_duration_t capacity, zx_duration_t deadline,
+                                          zx_duration_t period) {
+    canary_.Assert();
+
+    LTRACE_ENTRY_OBJ;
+
+    AutoLock lock(&state_lock_);
+
+    if (state_ == State::DYING || state_ == State::DEAD)
+        return ZX_ERR_BAD_STATE;
+
+    return sched_set_deadline(&thread_, capacity, deadline, period);
+}
+
+zx_status_t ThreadDispatcher::SetAffinity(cpu_mask_t cpu_mask) {
+    canary_.Assert();
+
+    LTRACE_ENTRY_OBJ;
+
+    AutoLock lock(&state_lock_);
+
+    if (state_ == State::DYING || state_ == State::DEAD)
+        return ZX_ERR_BAD_STATE;
+
+    // A deadline reservation is bound to the cpu it was admitted on, so it
+    // must be released before the thread can be moved.
+    if (thread_is_deadline(&thread_))
+        return ZX_ERR_BAD_STATE;
+
+    if (!(cpu_mask & mp_get_active_mask()))
+        return ZX_ERR_INVALID_ARGS;
+
+    thread_set_cpu_affinity(&thread_, cpu_mask);
+    return ZX_OK;
+}
+
+// Bounds the walk along a chain of futex owners. Userspace can form a
+// cycle with a lock ordering bug, and the walk happens with thread_lock held.
+static constexpr int kMaxFutexOwnerChain = 16;
+
+void ThreadDispatcher::BlockOnFutexOwnerLocked(ThreadDispatcher* owner) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(this == GetCurrent());
+    DEBUG_ASSERT(blocked_futex_owner_ == nullptr);
+
+    blocked_futex_owner_ = owner;
+
+    // Discard the local reschedule flag because we're just about to block anyway.
+    bool unused;
+    int priority = thread_.effec_priority;
+    for (int depth = 0; owner != nullptr && depth < kMaxFutexOwnerChain; ++depth) {
+        owner->thread_.futex_priority_held = true;
+        sched_inheirit_priority(&owner->thread_, priority, &unused);
+        owner = owner->blocked_futex_owner_;
+    }
+}
+
+void ThreadDispatcher::UnblockFromFutexOwnerLocked() {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(this == GetCurrent());
+    blocked_futex_owner_ = nullptr;
+}
+
 zx_status_t ThreadDispatcher::Resume() {
     canary_.Assert();
 
@@ -658,6 +785,7 @@ zx_status_t ThreadDispatcher::ExceptionHandlerExchange(
         // For OnExceptionPortRemoval in case the port is unbound.
         DEBUG_ASSERT(exception_wait_port_ == nullptr);
         exception_wait_port_ = eport;
+        exception_sent_time_ = current_time();
 
         exception_status_ = ExceptionStatus::UNPROCESSED;
     }
@@ -715,6 +843,31 @@ zx_status_t ThreadDispatcher::MarkExceptionHandled(ExceptionStatus estatus) {
                  estatus != ExceptionStatus::UNPROCESSED);
 
     AutoLock lock(&state_lock_);
+    return MarkExceptionHandledLocked(estatus);
+}
+
+zx_status_t ThreadDispatcher::ResumeFromException(ExceptionStatus estatus,
+                                                  zx_thread_state_topic_t state_kind,
+                                                  const void* buffer, size_t buffer_len) {
+    canary_.Assert();
+
+    LTRACEF("obj %p, estatus %d, state_kind %u\n", this, static_cast<int>(estatus), state_kind);
+    DEBUG_ASSERT(estatus != ExceptionStatus::IDLE &&
+                 estatus != ExceptionStatus::UNPROCESSED);
+
+    AutoLock lock(&state_lock_);
+    if (!InExceptionLocked() || exception_status_ != ExceptionStatus::UNPROCESSED)
+        return ZX_ERR_BAD_STATE;
+
+    if (buffer_len != 0) {
+        zx_status_t status = WriteStateLocked(state_kind, buffer, buffer_len);
+        if (status != ZX_OK)
+            return status;
+    }
+    return MarkExceptionHandledLocked(estatus);
+}
+
+zx_status_t ThreadDispatcher::MarkExceptionHandledLocked(ExceptionStatus estatus) {
     if (!InExceptionLocked())
         return ZX_ERR_BAD_STATE;
 
@@ -731,6 +884,7 @@ zx_status_t ThreadDispatcher::MarkExceptionHandled(ExceptionStatus estatus) {
         return ZX_ERR_BAD_STATE;
 
     exception_status_ = estatus;
+    exception_wait_port_->OnExceptionResponse(current_time() - exception_sent_time_);
     event_signal(&exception_event_, true);
     return ZX_OK;
 }
@@ -866,9 +1020,25 @@ zx_status_t ThreadDispatcher::GetStatsForUserspace(zx_info_thread_stats_t* info)
     *info = {};
 
     info->total_runtime = runtime_ns();
+    info->deadline_misses = thread_.deadline.misses;
     return ZX_OK;
 }
 
+void ThreadDispatcher::GetRuntime(zx_info_task_runtime_t* info) const {
+    canary_.Assert();
+
+    thread_runtime_stats stats;
+    thread_get_runtime_stats(&thread_, &stats);
+
+    *info = {};
+    info->cpu_time = stats.runtime_ns;
+    info->queue_time = stats.queue_ns;
+    info->kernel_time = stats.kernel_ns;
+    info->preemptions = stats.preemptions;
+    info->page_faults = stats.page_faults;
+    info->page_fault_time = stats.page_fault_ns;
+}
+
 zx_status_t ThreadDispatcher::GetExceptionReport(zx_exception_report_t* report) {
     canary_.Assert();
 
@@ -910,6 +1080,16 @@ zx_status_t ThreadDispatcher::ReadState(zx_thread_state_topic_t state_kind,
                 static_cast<zx_thread_state_single_step_t>(thread_.single_step);
         return ZX_OK;
     }
+    case ZX_THREAD_STATE_EXCEPTION: {
+        if (buffer_len != sizeof(zx_thread_state_exception_t))
+            return ZX_ERR_INVALID_ARGS;
+        if (!InExceptionLocked())
+            return ZX_ERR_BAD_STATE;
+        auto state = static_cast<zx_thread_state_exception_t*>(buffer);
+        DEBUG_ASSERT(exception_report_ != nullptr);
+        state->report = *exception_report_;
+        return arch_get_general_regs(&thread_, &state->general_regs);
+    }
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -926,7 +1106,11 @@ zx_status_t ThreadDispatcher::WriteState(zx_thread_state_topic_t state_kind,
     // We can't be reading regs while the thread transitions from
     // SUSPENDED to RUNNING.
     AutoLock state_lock(&state_lock_);
+    return WriteStateLocked(state_kind, buffer, buffer_len);
+}
 
+zx_status_t ThreadDispatcher::WriteStateLocked(zx_thread_state_topic_t state_kind,
+                                               const void* buffer, size_t buffer_len) {
     if (state_ != State::SUSPENDED && !InExceptionLocked())
         return ZX_ERR_BAD_STATE;
 
@@ -61,7 +61,7 @@ zx_status_t TimerDispatcher::Create(uint32_t options,
 
 TimerDispatcher::TimerDispatcher(slack_mode slack_mode)
     : slack_mode_(slack_mode),
-      timer_dpc_({LIST_INITIAL_CLEARED_VALUE, &dpc_callback, this}),
+      timer_dpc_({LIST_INITIAL_CLEARED_VALUE, &dpc_callback, this, DPC_PRIORITY_NORMAL, 0}),
       deadline_(0u), slack_(0u), cancel_pending_(false),
       timer_(TIMER_INITIAL_VALUE(timer_)) {
 }
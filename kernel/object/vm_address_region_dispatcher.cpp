@@ -221,6 +221,104 @@ zx_status_t VmAddressRegionDispatcher::Unmap(vaddr_t base, size_t len) {
     return vmar_->Unmap(base, len);
 }
 
+zx_status_t VmAddressRegionDispatcher::RangeOp(uint32_t op, vaddr_t base, size_t len) {
+    canary_.Assert();
+
+    if (!IS_PAGE_ALIGNED(base)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    VmRangeHint hint;
+    switch (op) {
+    case ZX_VMAR_OP_DONT_NEED:
+        hint = VmRangeHint::DontNeed;
+        break;
+    case ZX_VMAR_OP_WILL_NEED:
+        hint = VmRangeHint::WillNeed;
+        break;
+    case ZX_VMAR_OP_NORMAL:
+        hint = VmRangeHint::Normal;
+        break;
+    case ZX_VMAR_OP_SEQUENTIAL:
+        hint = VmRangeHint::Sequential;
+        break;
+    case ZX_VMAR_OP_RANDOM:
+        hint = VmRangeHint::Random;
+        break;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    return vmar_->HintRange(base, len, hint);
+}
+
+zx_status_t VmAddressRegionDispatcher::Batch(zx_vmar_batch_op_t* ops,
+                                             fbl::RefPtr<VmObject>* vmos, size_t count,
+                                             size_t* completed) {
+    canary_.Assert();
+
+    *completed = 0;
+    if (count > ZX_VMAR_BATCH_MAX_OPS)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    VmBatchOp batch[ZX_VMAR_BATCH_MAX_OPS];
+    for (size_t i = 0; i < count; ++i) {
+        const zx_vmar_batch_op_t& op = ops[i];
+        VmBatchOp& vm_op = batch[i];
+
+        if (op.reserved != 0)
+            return ZX_ERR_INVALID_ARGS;
+
+        vm_op.base = op.addr;
+        vm_op.size = op.len;
+        vm_op.vmar_flags = 0;
+        vm_op.arch_mmu_flags = 0;
+        switch (op.op) {
+        case ZX_VMAR_BATCH_MAP: {
+            if (!is_valid_mapping_protection(op.flags))
+                return ZX_ERR_INVALID_ARGS;
+            zx_status_t status = split_syscall_flags(op.flags, &vm_op.vmar_flags,
+                                                     &vm_op.arch_mmu_flags);
+            if (status != ZX_OK)
+                return status;
+            vm_op.type = VmBatchOp::Type::Map;
+            vm_op.vmo = vmos[i];
+            vm_op.vmo_offset = op.vmo_offset;
+            vm_op.name = "useralloc";
+            break;
+        }
+        case ZX_VMAR_BATCH_UNMAP:
+            if (op.flags != 0 || !IS_PAGE_ALIGNED(op.addr))
+                return ZX_ERR_INVALID_ARGS;
+            vm_op.type = VmBatchOp::Type::Unmap;
+            break;
+        case ZX_VMAR_BATCH_PROTECT: {
+            if (!IS_PAGE_ALIGNED(op.addr) || !is_valid_mapping_protection(op.flags))
+                return ZX_ERR_INVALID_ARGS;
+            uint32_t vmar_flags;
+            zx_status_t status = split_syscall_flags(op.flags, &vmar_flags,
+                                                     &vm_op.arch_mmu_flags);
+            if (status != ZX_OK)
+                return status;
+            // As with Protect(), no VMAR flags may be set.
+            if (vmar_flags)
+                return ZX_ERR_INVALID_ARGS;
+            vm_op.type = VmBatchOp::Type::Protect;
+            break;
+        }
+        default:
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+
+    zx_status_t status = vmar_->Batch(batch, count, completed);
+    for (size_t i = 0; i < *completed; ++i) {
+        if (batch[i].type == VmBatchOp::Type::Map)
+            ops[i].addr = batch[i].base;
+    }
+    return status;
+}
+
 bool VmAddressRegionDispatcher::is_valid_mapping_protection(uint32_t flags) {
     if (!(flags & ZX_VM_FLAG_PERM_READ)) {
         // No way to express non-readable mappings that are also writeable or
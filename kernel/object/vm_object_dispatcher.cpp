@@ -41,6 +41,13 @@ VmObjectDispatcher::~VmObjectDispatcher() {
     // Intentionally leave vmo_->user_id() set to our koid even though we're
     // dying and the koid will no longer map to a Dispatcher. koids are never
     // recycled, and it could be a useful breadcrumb.
+
+    // Without the handle a clone may be all that keeps the object alive, in which case the
+    // clone takes over its pages and stops looking up pages through it.
+    fbl::RefPtr<VmObject> child = vmo_->GetOnlyChild();
+    vmo_.reset();
+    if (child)
+        child->CollapseHiddenParents();
 }
 
 void VmObjectDispatcher::get_name(char out_name[ZX_MAX_NAME_LEN]) const {
@@ -104,10 +111,29 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             auto status = vmo_->DecommitRange(offset, size, nullptr);
             return status;
         }
-        case ZX_VMO_OP_LOCK:
+        case ZX_VMO_OP_LOCK: {
+            // discardable objects are locked and unlocked as a whole
+            if (offset != 0 || size != vmo_->size())
+                return ZX_ERR_INVALID_ARGS;
+            bool was_discarded;
+            auto status = vmo_->LockDiscardable(&was_discarded);
+            if (status != ZX_OK)
+                return status;
+            // report whether the old contents are gone, if the caller asked
+            if (buffer && buffer_size >= sizeof(uint32_t)) {
+                uint32_t discarded = was_discarded ? 1u : 0u;
+                status = buffer.reinterpret<uint32_t>().copy_to_user(discarded);
+                if (status != ZX_OK) {
+                    vmo_->UnlockDiscardable();
+                    return status;
+                }
+            }
+            return ZX_OK;
+        }
         case ZX_VMO_OP_UNLOCK:
-            // TODO: handle
-            return ZX_ERR_NOT_SUPPORTED;
+            if (offset != 0 || size != vmo_->size())
+                return ZX_ERR_INVALID_ARGS;
+            return vmo_->UnlockDiscardable();
         case ZX_VMO_OP_LOOKUP:
             // we will be using the user pointer
             if (!buffer)
@@ -125,6 +151,10 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             return vmo_->CleanCache(offset, size);
         case ZX_VMO_OP_CACHE_CLEAN_INVALIDATE:
             return vmo_->CleanInvalidateCache(offset, size);
+        case ZX_VMO_OP_DONT_NEED:
+            return vmo_->HintRange(offset, size, VmObject::RangeHint::DontNeed);
+        case ZX_VMO_OP_WILL_NEED:
+            return vmo_->HintRange(offset, size, VmObject::RangeHint::WillNeed);
         default:
             return ZX_ERR_INVALID_ARGS;
     }
@@ -134,6 +164,22 @@ zx_status_t VmObjectDispatcher::SetMappingCachePolicy(uint32_t cache_policy) {
     return vmo_->SetMappingCachePolicy(cache_policy);
 }
 
+zx_status_t VmObjectDispatcher::GetNumaNode(uint32_t* node) {
+    return vmo_->GetNumaNode(node);
+}
+
+zx_status_t VmObjectDispatcher::SetNumaNode(uint32_t node) {
+    return vmo_->SetNumaNode(node);
+}
+
+zx_status_t VmObjectDispatcher::GetMergeable(bool* mergeable) {
+    return vmo_->GetMergeable(mergeable);
+}
+
+zx_status_t VmObjectDispatcher::SetMergeable(bool mergeable) {
+    return vmo_->SetMergeable(mergeable);
+}
+
 zx_status_t VmObjectDispatcher::Clone(uint32_t options, uint64_t offset, uint64_t size,
         bool copy_name, fbl::RefPtr<VmObject>* clone_vmo) {
     canary_.Assert();
@@ -10,6 +10,7 @@
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/interrupts.h>
+#include <arch/x86/mp.h>
 #include <assert.h>
 #include <debug.h>
 #include <dev/interrupt.h>
@@ -164,6 +165,22 @@ zx_status_t get_interrupt_config(unsigned int vector,
     return apic_io_fetch_irq_config(vector, tm, pol);
 }
 
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    if (!is_valid_interrupt(vector, 0))
+        return ZX_ERR_INVALID_ARGS;
+    if (!mp_is_cpu_online(cpu))
+        return ZX_ERR_INVALID_ARGS;
+
+    // Physical destination mode only has room for 8 bit APIC IDs.
+    uint32_t apic_id = x86_cpu_num_to_apic_id(cpu);
+    if (apic_id > 0xff)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    AutoSpinLock guard(&lock);
+    apic_io_configure_irq_dst(vector, static_cast<uint8_t>(apic_id));
+    return ZX_OK;
+}
+
 void platform_irq(x86_iframe_t* frame) {
     // get the current vector
     uint64_t x86_vector = frame->vector;
@@ -4,19 +4,23 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include <acpica/acpi.h>
 #include <arch/x86/bootstrap16.h>
 #include <arch/x86/mmu.h>
+#include <arch/x86/mp.h>
 #include <assert.h>
 #include <efi/boot-services.h>
 #include <err.h>
 #include <fbl/algorithm.h>
 #include <inttypes.h>
 #include <lib/memory_limit.h>
+#include <lk/init.h>
 #include <platform.h>
 #include <platform/pc/bootloader.h>
 #include <platform/pc/memory.h>
 #include <string.h>
 #include <trace.h>
+#include <vm/pmm.h>
 #include <vm/vm.h>
 #include <zircon/boot/multiboot.h>
 #include <zircon/types.h>
@@ -520,3 +524,136 @@ void pc_mem_init(void) {
         TRACEF("WARNING - Failed to assign bootstrap16 region, SMP won't work\n");
     }
 }
+
+/* proximity domains seen in the SRAT, indexed by pmm memory node */
+static uint32_t numa_node_domains[PMM_MAX_NODES];
+static uint numa_node_count;
+
+/* processor affinity entries from the SRAT, applied once the cpus have been numbered */
+#define NUMA_MAX_CPU_ENTRIES 256
+static struct {
+    uint32_t apic_id;
+    uint node;
+} numa_cpu_entries[NUMA_MAX_CPU_ENTRIES];
+static size_t numa_cpu_entry_count;
+
+/* map an ACPI proximity domain to a dense pmm node number */
+static bool numa_domain_to_node(uint32_t domain, uint* node) {
+    for (uint i = 0; i < numa_node_count; i++) {
+        if (numa_node_domains[i] == domain) {
+            *node = i;
+            return true;
+        }
+    }
+    if (numa_node_count == PMM_MAX_NODES) {
+        TRACEF("too many proximity domains, ignoring domain %u\n", domain);
+        return false;
+    }
+    numa_node_domains[numa_node_count] = domain;
+    *node = numa_node_count++;
+    return true;
+}
+
+static void numa_add_cpu(uint32_t apic_id, uint32_t domain) {
+    uint node;
+    if (!numa_domain_to_node(domain, &node))
+        return;
+    if (numa_cpu_entry_count == NUMA_MAX_CPU_ENTRIES) {
+        TRACEF("too many SRAT processor entries, ignoring apic id %#x\n", apic_id);
+        return;
+    }
+    numa_cpu_entries[numa_cpu_entry_count].apic_id = apic_id;
+    numa_cpu_entries[numa_cpu_entry_count].node = node;
+    numa_cpu_entry_count++;
+}
+
+/* Tag the pmm arenas with the memory node they belong to, using the ACPI SRAT.
+ * The arenas have to be added before the ACPI tables are reachable, so this
+ * runs afterwards and lets the pmm split arenas at node boundaries.
+ */
+static void pc_mem_init_numa(uint level) {
+    ACPI_TABLE_HEADER* table = NULL;
+    ACPI_STATUS acpi_status = AcpiGetTable((char*)ACPI_SIG_SRAT, 1, &table);
+    if (acpi_status != AE_OK) {
+        LTRACEF("no SRAT, assuming a single memory node\n");
+        return;
+    }
+
+    ACPI_TABLE_SRAT* srat = (ACPI_TABLE_SRAT*)table;
+    uintptr_t records_start = (uintptr_t)srat + sizeof(*srat);
+    uintptr_t records_end = (uintptr_t)srat + srat->Header.Length;
+
+    uintptr_t addr;
+    ACPI_SUBTABLE_HEADER* record_hdr;
+    for (addr = records_start; addr < records_end; addr += record_hdr->Length) {
+        record_hdr = (ACPI_SUBTABLE_HEADER*)addr;
+        if (record_hdr->Length == 0)
+            break;
+
+        switch (record_hdr->Type) {
+        case ACPI_SRAT_TYPE_MEMORY_AFFINITY: {
+            ACPI_SRAT_MEM_AFFINITY* mem = (ACPI_SRAT_MEM_AFFINITY*)record_hdr;
+            if (!(mem->Flags & ACPI_SRAT_MEM_ENABLED) || mem->Length == 0)
+                continue;
+
+            uint node;
+            if (!numa_domain_to_node(mem->ProximityDomain, &node))
+                continue;
+
+            LTRACEF("memory %#" PRIx64 " size %#" PRIx64 " domain %u node %u\n",
+                    mem->BaseAddress, mem->Length, mem->ProximityDomain, node);
+            zx_status_t status = pmm_set_node_range(mem->BaseAddress, mem->Length, node);
+            if (status != ZX_OK && status != ZX_ERR_INVALID_ARGS) {
+                TRACEF("failed to assign memory %#" PRIx64 " to node %u: %d\n",
+                       mem->BaseAddress, node, status);
+            }
+            break;
+        }
+        case ACPI_SRAT_TYPE_CPU_AFFINITY: {
+            ACPI_SRAT_CPU_AFFINITY* cpu = (ACPI_SRAT_CPU_AFFINITY*)record_hdr;
+            if (!(cpu->Flags & ACPI_SRAT_CPU_USE_AFFINITY))
+                continue;
+
+            uint32_t domain = cpu->ProximityDomainLo |
+                              ((uint32_t)cpu->ProximityDomainHi[0] << 8) |
+                              ((uint32_t)cpu->ProximityDomainHi[1] << 16) |
+                              ((uint32_t)cpu->ProximityDomainHi[2] << 24);
+            numa_add_cpu(cpu->ApicId, domain);
+            break;
+        }
+        case ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY: {
+            ACPI_SRAT_X2APIC_CPU_AFFINITY* cpu = (ACPI_SRAT_X2APIC_CPU_AFFINITY*)record_hdr;
+            if (!(cpu->Flags & ACPI_SRAT_CPU_ENABLED))
+                continue;
+
+            numa_add_cpu(cpu->ApicId, cpu->ProximityDomain);
+            break;
+        }
+        }
+    }
+    if (addr != records_end) {
+        TRACEF("malformed SRAT\n");
+    }
+
+    dprintf(INFO, "MEM: %u memory node%s\n", MAX(numa_node_count, 1u),
+            (numa_node_count > 1) ? "s" : "");
+}
+
+/* after the ACPI tables are initialized */
+LK_INIT_HOOK(pc_mem_numa, &pc_mem_init_numa, LK_INIT_LEVEL_VM + 2);
+
+/* cpu numbers are assigned by platform_init, so wait until then to tell the pmm
+ * which node each cpu is on */
+static void pc_mem_init_cpu_nodes(uint level) {
+    for (size_t i = 0; i < numa_cpu_entry_count; i++) {
+        int cpu = x86_apic_id_to_cpu_num(numa_cpu_entries[i].apic_id);
+        if (cpu < 0)
+            continue;
+
+        LTRACEF("cpu %d apic id %#x node %u\n", cpu, numa_cpu_entries[i].apic_id,
+                numa_cpu_entries[i].node);
+        pmm_set_cpu_node(cpu, numa_cpu_entries[i].node);
+    }
+}
+
+LK_INIT_HOOK(pc_mem_cpu_nodes, &pc_mem_init_cpu_nodes, LK_INIT_LEVEL_PLATFORM);
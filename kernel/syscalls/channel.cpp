@@ -107,9 +107,12 @@ static void msg_get_handles(ProcessDispatcher* up, MessagePacket* msg,
     for (size_t i = 0; i < num_handles; ++i) {
         if (handle_list[i]->dispatcher()->has_state_tracker())
             handle_list[i]->dispatcher()->Cancel(handle_list[i]);
+    }
+
+    fbl::AutoLock lock(up->handle_table_lock());
+    for (size_t i = 0; i < num_handles; ++i) {
         HandleOwner handle(handle_list[i]);
-        // TODO(ZX-969): This takes a lock per call. Consider doing these in a batch.
-        up->AddHandle(fbl::move(handle));
+        up->AddHandleLocked(fbl::move(handle));
     }
 }
 
@@ -156,7 +159,7 @@ static zx_status_t channel_read(zx_handle_t handle_value, uint32_t options,
         return result;
 
     if (num_bytes > 0u) {
-        if (msg->CopyDataTo(bytes) != ZX_OK)
+        if (msg->MoveDataTo(up->aspace().get(), bytes) != ZX_OK)
             return ZX_ERR_INVALID_ARGS;
     }
 
@@ -191,6 +194,82 @@ zx_status_t sys_channel_read_etc(zx_handle_t handle_value, uint32_t options,
         bytes, handle_info, num_bytes, num_handles, actual_bytes, actual_handles);
 }
 
+zx_status_t sys_channel_read_many(zx_handle_t handle_value, uint32_t options,
+                                  user_inout_ptr<zx_channel_msg_t> user_msgs, uint32_t num_msgs,
+                                  user_out_ptr<uint32_t> actual_msgs) {
+    LTRACEF("handle %x msgs %p num_msgs %u\n", handle_value, user_msgs.get(), num_msgs);
+
+    if (options)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (num_msgs == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    if (num_msgs > ZX_CHANNEL_MAX_MSGS_PER_BATCH)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t result = up->GetDispatcherWithRights(handle_value, ZX_RIGHT_READ, &channel);
+    if (result != ZX_OK)
+        return result;
+
+    zx_channel_msg_t msgs[ZX_CHANNEL_MAX_MSGS_PER_BATCH];
+    if (user_msgs.copy_array_from_user(msgs, num_msgs) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    uint32_t sizes[ZX_CHANNEL_MAX_MSGS_PER_BATCH];
+    uint32_t handle_counts[ZX_CHANNEL_MAX_MSGS_PER_BATCH];
+    for (uint32_t i = 0; i < num_msgs; ++i) {
+        sizes[i] = msgs[i].num_bytes;
+        handle_counts[i] = msgs[i].num_handles;
+    }
+
+    // All of the messages are dequeued under a single acquisition of the
+    // channel lock; copying them out happens afterwards.
+    ChannelDispatcher::MessageList read;
+    result = channel->ReadMany(num_msgs, sizes, handle_counts, &read);
+    if (result == ZX_ERR_BUFFER_TOO_SMALL) {
+        // Report the size of the message that didn't fit, as channel_read does.
+        msgs[0].num_bytes = sizes[0];
+        msgs[0].num_handles = handle_counts[0];
+        if (user_msgs.copy_array_to_user(msgs, 1u) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+    }
+    if (result != ZX_OK)
+        return result;
+
+    uint32_t count = 0;
+    while (!read.is_empty()) {
+        fbl::unique_ptr<MessagePacket> msg = read.pop_front();
+        zx_channel_msg_t& desc = msgs[count];
+        desc.num_bytes = sizes[count];
+        desc.num_handles = handle_counts[count];
+
+        if (desc.num_bytes > 0u) {
+            if (msg->MoveDataTo(up->aspace().get(), make_user_out_ptr(desc.bytes)) != ZX_OK)
+                return ZX_ERR_INVALID_ARGS;
+        }
+        // As with channel_read, the handles are written after the data.
+        if (desc.num_handles > 0u) {
+            msg_get_handles(up, msg.get(), make_user_out_ptr(desc.handles), desc.num_handles);
+        }
+
+        record_recv_msg_sz(desc.num_bytes);
+        count++;
+    }
+
+    if (user_msgs.copy_array_to_user(msgs, count) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    if (actual_msgs) {
+        zx_status_t status = actual_msgs.copy_to_user(count);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    ktrace(TAG_CHANNEL_READ, (uint32_t)channel->get_koid(), count, 0, 0);
+    return ZX_OK;
+}
+
 static zx_status_t channel_read_out(ProcessDispatcher* up,
                                     fbl::unique_ptr<MessagePacket> reply,
                                     zx_channel_call_args_t* args,
@@ -211,7 +290,7 @@ static zx_status_t channel_read_out(ProcessDispatcher* up,
         return status;
 
     if (num_bytes > 0u) {
-        if (reply->CopyDataTo(make_user_out_ptr(args->rd_bytes)) != ZX_OK) {
+        if (reply->MoveDataTo(up->aspace().get(), make_user_out_ptr(args->rd_bytes)) != ZX_OK) {
             return ZX_ERR_INVALID_ARGS;
         }
     }
@@ -307,7 +386,7 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
     LTRACEF("handle %x bytes %p num_bytes %u handles %p num_handles %u options 0x%x\n",
             handle_value, user_bytes.get(), num_bytes, user_handles.get(), num_handles, options);
 
-    if (options)
+    if (options & ~ZX_CHANNEL_WRITE_MOVE)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -319,7 +398,12 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
 
 
     fbl::unique_ptr<MessagePacket> msg;
-    result = MessagePacket::Create(user_bytes, num_bytes, num_handles, &msg);
+    if (options & ZX_CHANNEL_WRITE_MOVE) {
+        result = MessagePacket::CreateByMove(up->aspace().get(), user_bytes, num_bytes,
+                                             num_handles, &msg);
+    } else {
+        result = MessagePacket::Create(user_bytes, num_bytes, num_handles, &msg);
+    }
     if (result != ZX_OK)
         return result;
 
@@ -345,6 +429,80 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
     return ZX_OK;
 }
 
+// Gives the handles carried by each of |msgs| back to |up|, undoing msg_put_handles().
+static void msgs_return_handles(ProcessDispatcher* up, ChannelDispatcher::MessageList* msgs) {
+    AutoLock lock(up->handle_table_lock());
+    for (auto& msg : *msgs) {
+        msg.set_owns_handles(false);
+        Handle* const* handles = msg.handles();
+        for (size_t ix = 0; ix != msg.num_handles(); ++ix) {
+            up->AddHandleLocked(HandleOwner(handles[ix]));
+        }
+    }
+}
+
+zx_status_t sys_channel_write_many(zx_handle_t handle_value, uint32_t options,
+                                   user_in_ptr<const zx_channel_msg_t> user_msgs,
+                                   uint32_t num_msgs) {
+    LTRACEF("handle %x msgs %p num_msgs %u options 0x%x\n",
+            handle_value, user_msgs.get(), num_msgs, options);
+
+    if (options & ~ZX_CHANNEL_WRITE_MOVE)
+        return ZX_ERR_INVALID_ARGS;
+    if (num_msgs > ZX_CHANNEL_MAX_MSGS_PER_BATCH)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ChannelDispatcher> channel;
+    zx_status_t result = up->GetDispatcherWithRights(handle_value, ZX_RIGHT_WRITE, &channel);
+    if (result != ZX_OK)
+        return result;
+
+    zx_channel_msg_t msgs[ZX_CHANNEL_MAX_MSGS_PER_BATCH];
+    if (user_msgs.copy_array_from_user(msgs, num_msgs) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    // Build every packet up front so that the batch is written all or nothing.
+    ChannelDispatcher::MessageList packets;
+    zx_handle_t handles[kMaxMessageHandles];
+    size_t total_bytes = 0;
+    for (uint32_t i = 0; i < num_msgs; ++i) {
+        const zx_channel_msg_t& desc = msgs[i];
+        auto bytes = make_user_in_ptr(static_cast<const void*>(desc.bytes));
+
+        fbl::unique_ptr<MessagePacket> msg;
+        if (options & ZX_CHANNEL_WRITE_MOVE) {
+            result = MessagePacket::CreateByMove(up->aspace().get(), bytes, desc.num_bytes,
+                                                 desc.num_handles, &msg);
+        } else {
+            result = MessagePacket::Create(bytes, desc.num_bytes, desc.num_handles, &msg);
+        }
+        if (result == ZX_OK && desc.num_handles > 0u) {
+            result = msg_put_handles(up, msg.get(), handles,
+                                     make_user_in_ptr(static_cast<const zx_handle_t*>(desc.handles)),
+                                     desc.num_handles, static_cast<Dispatcher*>(channel.get()));
+        }
+        if (result != ZX_OK) {
+            msgs_return_handles(up, &packets);
+            return result;
+        }
+
+        total_bytes += desc.num_bytes;
+        packets.push_back(fbl::move(msg));
+    }
+
+    result = channel->WriteMany(&packets);
+    if (result != ZX_OK) {
+        // Write failed, put back the handles into this process.
+        msgs_return_handles(up, &packets);
+        return result;
+    }
+
+    ktrace(TAG_CHANNEL_WRITE, (uint32_t)channel->get_koid(), (uint32_t)total_bytes, num_msgs, 0);
+    return ZX_OK;
+}
+
 zx_status_t sys_channel_call_noretry(zx_handle_t handle_value, uint32_t options,
                                      zx_time_t deadline,
                                      user_in_ptr<const zx_channel_call_args_t> user_args,
@@ -357,7 +515,7 @@ zx_status_t sys_channel_call_noretry(zx_handle_t handle_value, uint32_t options,
     if (status != ZX_OK)
         return status;
 
-    if (options)
+    if (options & ~ZX_CHANNEL_WRITE_MOVE)
         return ZX_ERR_INVALID_ARGS;
 
     uint32_t num_bytes = args.wr_num_bytes;
@@ -373,8 +531,13 @@ zx_status_t sys_channel_call_noretry(zx_handle_t handle_value, uint32_t options,
 
     // Prepare a MessagePacket for writing
     fbl::unique_ptr<MessagePacket> msg;
-    result = MessagePacket::Create(make_user_in_ptr(args.wr_bytes),
-                                   num_bytes, num_handles, &msg);
+    if (options & ZX_CHANNEL_WRITE_MOVE) {
+        result = MessagePacket::CreateByMove(up->aspace().get(), make_user_in_ptr(args.wr_bytes),
+                                             num_bytes, num_handles, &msg);
+    } else {
+        result = MessagePacket::Create(make_user_in_ptr(args.wr_bytes),
+                                       num_bytes, num_handles, &msg);
+    }
     if (result != ZX_OK)
         return result;
 
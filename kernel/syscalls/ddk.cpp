@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 
 #include <err.h>
+#include <inttypes.h>
 #include <platform.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -18,10 +19,12 @@
 #include <vm/vm_object_paged.h>
 #include <vm/vm_object_physical.h>
 #include <lib/user_copy/user_ptr.h>
+#include <object/bus_transaction_initiator_dispatcher.h>
 #include <object/handle.h>
 #include <object/interrupt_dispatcher.h>
 #include <object/interrupt_event_dispatcher.h>
 #include <object/iommu_dispatcher.h>
+#include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 #include <object/resources.h>
 #include <object/vm_object_dispatcher.h>
@@ -136,6 +139,51 @@ zx_status_t sys_interrupt_signal(zx_handle_t handle, uint32_t slot, zx_time_t ti
     return interrupt->UserSignal(slot, timestamp);
 }
 
+zx_status_t sys_interrupt_bind_port(zx_handle_t handle, zx_handle_t port_handle,
+                                    uint64_t key, uint32_t options) {
+    LTRACEF("handle %x port %x\n", handle, port_handle);
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<InterruptDispatcher> interrupt;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &interrupt);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PortDispatcher> port;
+    status = up->GetDispatcherWithRights(port_handle, ZX_RIGHT_WRITE, &port);
+    if (status != ZX_OK)
+        return status;
+
+    return interrupt->BindPort(fbl::move(port), key);
+}
+
+zx_status_t sys_interrupt_ack(zx_handle_t handle, uint64_t slots) {
+    LTRACEF("handle %x\n", handle);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<InterruptDispatcher> interrupt;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &interrupt);
+    if (status != ZX_OK)
+        return status;
+
+    return interrupt->Ack(slots);
+}
+
+zx_status_t sys_interrupt_set_affinity(zx_handle_t handle, uint32_t slot, uint32_t cpu) {
+    LTRACEF("handle %x\n", handle);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<InterruptDispatcher> interrupt;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &interrupt);
+    if (status != ZX_OK)
+        return status;
+
+    return interrupt->SetAffinity(slot, cpu);
+}
+
 zx_status_t sys_vmo_create_contiguous(zx_handle_t hrsrc, size_t size,
                                       uint32_t alignment_log2,
                                       user_out_handle* out) {
@@ -332,6 +380,90 @@ zx_status_t sys_iommu_create(zx_handle_t rsrc_handle, uint32_t type,
     return out->make(fbl::move(dispatcher), rights);
 }
 
+zx_status_t sys_bti_create(zx_handle_t iommu, uint32_t options, uint64_t bti_id,
+                           user_out_handle* out) {
+    LTRACEF("iommu %x bti_id %#" PRIx64 "\n", iommu, bti_id);
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<IommuDispatcher> iommu_dispatcher;
+    zx_status_t status = up->GetDispatcherWithRights(iommu, ZX_RIGHT_NONE, &iommu_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = BusTransactionInitiatorDispatcher::Create(iommu_dispatcher->iommu(), bti_id,
+                                                       &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+zx_status_t sys_bti_pin(zx_handle_t handle, uint32_t options, zx_handle_t vmo,
+                        uint64_t offset, uint64_t size,
+                        user_out_ptr<zx_paddr_t> addrs, size_t addrs_len) {
+    LTRACEF("handle %x vmo %x offset %#" PRIx64 " size %#" PRIx64 "\n",
+            handle, vmo, offset, size);
+
+    const uint32_t perms = options & (ZX_BTI_PERM_READ | ZX_BTI_PERM_WRITE |
+                                      ZX_BTI_PERM_EXECUTE);
+    if (perms == 0u || (options & ~(perms | ZX_BTI_CACHE)) != 0u)
+        return ZX_ERR_INVALID_ARGS;
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(size) || size == 0u)
+        return ZX_ERR_INVALID_ARGS;
+    if (addrs_len != size / PAGE_SIZE)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<BusTransactionInitiatorDispatcher> bti;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_MAP, &bti);
+    if (status != ZX_OK)
+        return status;
+
+    zx_rights_t vmo_rights = ZX_RIGHT_MAP;
+    if (options & ZX_BTI_PERM_READ)
+        vmo_rights |= ZX_RIGHT_READ;
+    if (options & ZX_BTI_PERM_WRITE)
+        vmo_rights |= ZX_RIGHT_WRITE;
+    if (options & ZX_BTI_PERM_EXECUTE)
+        vmo_rights |= ZX_RIGHT_EXECUTE;
+    fbl::RefPtr<VmObjectDispatcher> vmo_dispatcher;
+    status = up->GetDispatcherWithRights(vmo, vmo_rights, &vmo_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<dev_vaddr_t[]> mapped_addrs(new (&ac) dev_vaddr_t[addrs_len]);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    status = bti->Pin(vmo_dispatcher->vmo(), offset, size, options, mapped_addrs.get());
+    if (status != ZX_OK)
+        return status;
+
+    static_assert(sizeof(dev_vaddr_t) == sizeof(zx_paddr_t), "");
+    status = addrs.reinterpret<dev_vaddr_t>().copy_array_to_user(mapped_addrs.get(), addrs_len);
+    if (status != ZX_OK) {
+        bti->Unpin(mapped_addrs[0], size);
+        return status;
+    }
+    return ZX_OK;
+}
+
+zx_status_t sys_bti_unpin(zx_handle_t handle, zx_paddr_t base_addr, uint64_t size) {
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<BusTransactionInitiatorDispatcher> bti;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_MAP, &bti);
+    if (status != ZX_OK)
+        return status;
+
+    return bti->Unpin(base_addr, size);
+}
+
 #if ARCH_X86
 #include <arch/x86/descriptor.h>
 #include <arch/x86/ioport.h>
@@ -364,15 +364,16 @@ zx_status_t sys_pci_config_read(zx_handle_t handle, uint16_t offset, size_t widt
 
     // Based on the width passed in we can use the type safety of the PciConfig layer
     // to ensure we're getting correctly sized data back and return errors in the PIO
-    // cases.
+    // cases.  Read-only header fields come from the config's shadow of them, so
+    // drivers polling their ids and class codes do not touch the hardware.
     auto config = device->config();
     switch (width) {
     case 1u:
-        return out_val.copy_to_user(static_cast<uint32_t>(config->Read(PciReg8(offset))));
+        return out_val.copy_to_user(static_cast<uint32_t>(config->ReadCached(PciReg8(offset))));
     case 2u:
-        return out_val.copy_to_user(static_cast<uint32_t>(config->Read(PciReg16(offset))));
+        return out_val.copy_to_user(static_cast<uint32_t>(config->ReadCached(PciReg16(offset))));
     case 4u:
-        return out_val.copy_to_user(config->Read(PciReg32(offset)));
+        return out_val.copy_to_user(config->ReadCached(PciReg32(offset)));
     }
 
     // If we reached this point then the width was invalid.
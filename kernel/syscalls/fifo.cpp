@@ -15,6 +15,7 @@
 #include <object/fifo_dispatcher.h>
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <zircon/syscalls/policy.h>
 #include <fbl/ref_ptr.h>
@@ -84,3 +85,37 @@ zx_status_t sys_fifo_read(zx_handle_t handle, user_out_ptr<void> entries, size_t
 
     return ZX_OK;
 }
+
+zx_status_t sys_fifo_shared_vmo(zx_handle_t handle, uint32_t options, user_out_handle* out) {
+    zx_rights_t needed;
+    switch (options) {
+    case ZX_FIFO_SHARED_READ:
+        needed = ZX_RIGHT_READ;
+        break;
+    case ZX_FIFO_SHARED_WRITE:
+        needed = ZX_RIGHT_WRITE;
+        break;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<FifoDispatcher> fifo;
+    zx_status_t status = up->GetDispatcherWithRights(handle, needed, &fifo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    status = fifo->GetSharedVmo(options, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    return out->make(fbl::move(dispatcher), rights & ~ZX_RIGHT_EXECUTE);
+}
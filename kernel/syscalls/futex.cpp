@@ -9,6 +9,7 @@
 #include <trace.h>
 
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <zircon/types.h>
 
 #include "priv.h"
@@ -22,6 +23,27 @@ zx_status_t sys_futex_wait(user_in_ptr<const zx_futex_t> value_ptr, int current_
         value_ptr, current_value, deadline);
 }
 
+zx_status_t sys_futex_wait_owned(user_in_ptr<const zx_futex_t> value_ptr, int current_value,
+                                 zx_handle_t owner_handle, zx_time_t deadline) {
+    LTRACEF("futex %p current %d owner %x\n", value_ptr.get(), current_value, owner_handle);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    if (owner_handle == ZX_HANDLE_INVALID)
+        return up->futex_context()->FutexWait(value_ptr, current_value, deadline);
+
+    fbl::RefPtr<ThreadDispatcher> owner;
+    zx_status_t status = up->GetDispatcher(owner_handle, &owner);
+    if (status != ZX_OK)
+        return status;
+
+    // Futexes are private to a process, so the owner must be a thread of
+    // the same process. A thread cannot wait behind itself.
+    if (owner->process() != up || owner.get() == ThreadDispatcher::GetCurrent())
+        return ZX_ERR_INVALID_ARGS;
+
+    return up->futex_context()->FutexWait(value_ptr, current_value, deadline, owner.get());
+}
+
 zx_status_t sys_futex_wake(user_in_ptr<const zx_futex_t> value_ptr, uint32_t count) {
     LTRACEF("futex %p count %" PRIu32 "\n", value_ptr.get(), count);
 
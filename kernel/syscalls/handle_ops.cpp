@@ -10,7 +10,9 @@
 
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_lock.h>
+#include <zircon/types.h>
 
 #include "priv.h"
 
@@ -74,3 +76,138 @@ zx_status_t sys_handle_replace(
     zx_handle_t handle_value, zx_rights_t rights, user_out_handle* out) {
     return handle_dup_replace(true, handle_value, rights, out);
 }
+
+// Closes handles this many at a time, under one acquisition of the handle
+// table lock.
+static constexpr size_t kCloseBatchSize = 64;
+
+zx_status_t sys_handle_close_many(user_in_ptr<const zx_handle_t> handles, size_t num_handles) {
+    LTRACEF("num_handles %zu\n", num_handles);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    zx_status_t result = ZX_OK;
+
+    for (size_t offset = 0; offset < num_handles; offset += kCloseBatchSize) {
+        size_t count = fbl::min(num_handles - offset, kCloseBatchSize);
+        zx_handle_t values[kCloseBatchSize];
+        if (handles.copy_array_from_user(values, count, offset) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+
+        // The handles are destroyed once the lock is dropped, when |closed|
+        // goes out of scope.
+        HandleOwner closed[kCloseBatchSize];
+        {
+            fbl::AutoLock lock(up->handle_table_lock());
+            for (size_t i = 0; i < count; ++i) {
+                if (values[i] == ZX_HANDLE_INVALID)
+                    continue;
+                closed[i] = up->RemoveHandleLocked(values[i]);
+                if (!closed[i])
+                    result = ZX_ERR_BAD_HANDLE;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Duplicates or replaces all of |handles|, or none of them. The handle table
+// lock is taken once to check and duplicate the handles, and once more to
+// install the new ones after their values have been copied out.
+static zx_status_t handle_dup_replace_many(
+    bool is_replace, user_in_ptr<const zx_handle_t> handles, size_t num_handles,
+    zx_rights_t rights, user_out_ptr<zx_handle_t> out) {
+    LTRACEF("num_handles %zu\n", num_handles);
+
+    if (num_handles > ZX_HANDLE_BATCH_MAX)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    zx_handle_t values[ZX_HANDLE_BATCH_MAX];
+    if (handles.copy_array_from_user(values, num_handles) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    if (is_replace) {
+        // Replacing a handle twice would duplicate it without the right to.
+        for (size_t i = 0; i < num_handles; ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                if (values[i] == values[j])
+                    return ZX_ERR_INVALID_ARGS;
+            }
+        }
+    }
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // These are declared ahead of the locks so that any handles left in them
+    // are destroyed after the lock is dropped.
+    HandleOwner new_handles[ZX_HANDLE_BATCH_MAX];
+    HandleOwner replaced[ZX_HANDLE_BATCH_MAX];
+    zx_handle_t new_values[ZX_HANDLE_BATCH_MAX];
+
+    {
+        fbl::AutoLock lock(up->handle_table_lock());
+
+        zx_rights_t new_rights[ZX_HANDLE_BATCH_MAX];
+        for (size_t i = 0; i < num_handles; ++i) {
+            auto source = up->GetHandleLocked(values[i]);
+            if (!source)
+                return ZX_ERR_BAD_HANDLE;
+
+            if (!is_replace) {
+                if (!source->HasRights(ZX_RIGHT_DUPLICATE))
+                    return ZX_ERR_ACCESS_DENIED;
+            }
+
+            if (rights == ZX_RIGHT_SAME_RIGHTS) {
+                new_rights[i] = source->rights();
+            } else if ((source->rights() & rights) != rights) {
+                return ZX_ERR_INVALID_ARGS;
+            } else {
+                new_rights[i] = rights;
+            }
+        }
+
+        for (size_t i = 0; i < num_handles; ++i) {
+            new_handles[i] = Handle::Dup(up->GetHandleLocked(values[i]), new_rights[i]);
+            if (!new_handles[i])
+                return ZX_ERR_NO_MEMORY;
+            new_values[i] = up->MapHandleToValue(new_handles[i]);
+        }
+
+        // Take the originals out now, so that they can't be used or passed
+        // on while the new handles are being copied out.
+        if (is_replace) {
+            for (size_t i = 0; i < num_handles; ++i)
+                replaced[i] = up->RemoveHandleLocked(values[i]);
+        }
+    }
+
+    if (out.copy_array_to_user(new_values, num_handles) != ZX_OK) {
+        if (is_replace) {
+            fbl::AutoLock lock(up->handle_table_lock());
+            for (size_t i = 0; i < num_handles; ++i)
+                up->AddHandleLocked(fbl::move(replaced[i]));
+        }
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    {
+        fbl::AutoLock lock(up->handle_table_lock());
+        for (size_t i = 0; i < num_handles; ++i)
+            up->AddHandleLocked(fbl::move(new_handles[i]));
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t sys_handle_duplicate_many(
+    user_in_ptr<const zx_handle_t> handles, size_t num_handles, zx_rights_t rights,
+    user_out_ptr<zx_handle_t> out) {
+    return handle_dup_replace_many(false, handles, num_handles, rights, out);
+}
+
+zx_status_t sys_handle_replace_many(
+    user_in_ptr<const zx_handle_t> handles, size_t num_handles, zx_rights_t rights,
+    user_out_ptr<zx_handle_t> out) {
+    return handle_dup_replace_many(true, handles, num_handles, rights, out);
+}
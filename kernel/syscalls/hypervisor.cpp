@@ -61,6 +61,18 @@ zx_status_t sys_guest_set_trap(zx_handle_t guest_handle, uint32_t kind, zx_vaddr
     return guest->SetTrap(kind, addr, len, fbl::move(port), key);
 }
 
+zx_status_t sys_guest_get_dirty_pages(zx_handle_t guest_handle, zx_vaddr_t addr, size_t len,
+                                      user_out_ptr<void> user_bitmap, size_t bitmap_size) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<GuestDispatcher> guest;
+    zx_status_t status = up->GetDispatcherWithRights(guest_handle, ZX_RIGHT_READ, &guest);
+    if (status != ZX_OK)
+        return status;
+
+    return guest->GetDirtyPages(addr, len, user_bitmap, bitmap_size);
+}
+
 zx_status_t sys_vcpu_create(zx_handle_t guest_handle, uint32_t options,
                             zx_vaddr_t entry, user_out_handle* out) {
     if (options != 0u)
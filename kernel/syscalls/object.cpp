@@ -6,23 +6,33 @@
 
 #include <err.h>
 #include <inttypes.h>
+#include <string.h>
 #include <trace.h>
 
+#include <kernel/lockstat.h>
 #include <kernel/mp.h>
 #include <kernel/stats.h>
 #include <vm/pmm.h>
+#include <vm/vm_object_paged.h>
 #include <lib/heap.h>
 #include <platform.h>
+#include <syscalls/syscalls.h>
 #include <zircon/types.h>
+#include <zircon/zx-syscall-numbers.h>
 
+#include <object/bus_transaction_initiator_dispatcher.h>
 #include <object/diagnostics.h>
+#include <object/guest_dispatcher.h>
 #include <object/handle.h>
+#include <object/interrupt_dispatcher.h>
 #include <object/job_dispatcher.h>
+#include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 #include <object/resource_dispatcher.h>
 #include <object/resources.h>
 #include <object/thread_dispatcher.h>
 #include <object/vm_address_region_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <fbl/ref_ptr.h>
 
@@ -238,6 +248,30 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             }
             return ZX_OK;
         }
+        case ZX_INFO_JOB_TREE: {
+            fbl::RefPtr<JobDispatcher> job;
+            zx_status_t status =
+                up->GetDispatcherWithRights(handle, ZX_RIGHT_ENUMERATE, &job);
+            if (status < 0)
+                return status;
+
+            auto nodes = _buffer.reinterpret<zx_info_task_node_t>();
+            size_t count = buffer_size / sizeof(zx_info_task_node_t);
+            size_t avail = 0;
+            status = GetJobTree(job.get(), nodes, count, &count, &avail);
+
+            if (_actual) {
+                zx_status_t status = _actual.copy_to_user(count);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                zx_status_t status = _avail.copy_to_user(avail);
+                if (status != ZX_OK)
+                    return status;
+            }
+            return status;
+        }
         case ZX_INFO_THREAD: {
             // TODO(ZX-458): Handle forward/backward compatibility issues
             // with changes to the struct.
@@ -320,6 +354,39 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
         }
+        case ZX_INFO_TASK_RUNTIME: {
+            fbl::RefPtr<Dispatcher> dispatcher;
+            auto error = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &dispatcher);
+            if (error < 0)
+                return error;
+
+            zx_info_task_runtime_t info = {};
+            if (auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher)) {
+                thread->GetRuntime(&info);
+            } else if (auto process = DownCastDispatcher<ProcessDispatcher>(&dispatcher)) {
+                process->GetRuntime(&info);
+            } else if (auto job = DownCastDispatcher<JobDispatcher>(&dispatcher)) {
+                job->GetRuntime(&info);
+            } else {
+                return ZX_ERR_WRONG_TYPE;
+            }
+
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
+        }
+        case ZX_INFO_PROCESS_HANDLE_STATS: {
+            fbl::RefPtr<ProcessDispatcher> process;
+            auto error = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ,
+                                                     &process);
+            if (error < 0)
+                return error;
+
+            zx_info_process_handle_stats_t info = {};
+            process->GetHandleStats(&info);
+
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
+        }
         case ZX_INFO_PROCESS_MAPS: {
             fbl::RefPtr<ProcessDispatcher> process;
             zx_status_t status =
@@ -510,9 +577,120 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             // All other VM_PAGE_STATE_* counts get lumped into other_bytes.
             stats.other_bytes = other_bytes;
 
+            static_assert(ZX_MAX_NUMA_NODES == PMM_MAX_NODES, "");
+            size_t node_free[PMM_MAX_NODES];
+            stats.num_nodes = pmm_count_free_pages_per_node(node_free);
+            for (uint i = 0; i < stats.num_nodes; i++) {
+                stats.free_bytes_node[i] = node_free[i] * PAGE_SIZE;
+            }
+
+            VmObjectPaged::ReclaimStats reclaim;
+            VmObjectPaged::GetReclaimStats(&reclaim);
+            stats.reclaimable_bytes = reclaim.reclaimable_pages * PAGE_SIZE;
+            stats.reclaimed_bytes = reclaim.reclaimed_pages * PAGE_SIZE;
+            stats.reclaimed_vmos = reclaim.reclaimed_objects;
+
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &stats, sizeof(stats));
         }
+        case ZX_INFO_KERNEL_LOCK_STATS: {
+            auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+            if (status != ZX_OK)
+                return status;
+
+            static_assert(ZX_LOCK_STATS_KIND_MUTEX == LOCKSTAT_KIND_MUTEX, "");
+            static_assert(ZX_LOCK_STATS_KIND_SPINLOCK == LOCKSTAT_KIND_SPINLOCK, "");
+            static_assert(ZX_LOCK_STATS_HISTOGRAM_BUCKETS == LOCKSTAT_HISTOGRAM_BUCKETS, "");
+            static_assert(ZX_LOCK_STATS_MAX_CALLERS == LOCKSTAT_MAX_CALLERS, "");
+
+            size_t num_space_for = buffer_size / sizeof(zx_info_kernel_lock_stats_t);
+            user_out_ptr<zx_info_kernel_lock_stats_t> stats_buf =
+                _buffer.reinterpret<zx_info_kernel_lock_stats_t>();
+
+            // walk the whole table, including the catch-all entry at the end,
+            // copying out the slots in use for as long as there is room
+            size_t num_copied = 0;
+            size_t num_used = 0;
+            for (size_t i = 0; i <= LOCKSTAT_TABLE_SIZE; i++) {
+                lockstat_entry_t e;
+                if (!lockstat_read(i, &e))
+                    continue;
+                if (num_used++ >= num_space_for)
+                    continue;
+
+                zx_info_kernel_lock_stats_t stats = {};
+                stats.lock = e.lock;
+                stats.kind = e.kind;
+                stats.contended = e.contended;
+                stats.spin_acquired = e.spin_acquired;
+                stats.blocked = e.blocked;
+                stats.blocked_ns = e.blocked_ns;
+#if LOCK_PROFILING
+                stats.wait_ns = e.wait_ns;
+                memcpy(stats.wait_histogram, e.wait_histogram, sizeof(stats.wait_histogram));
+                memcpy(stats.caller, e.caller, sizeof(stats.caller));
+                memcpy(stats.caller_count, e.caller_count, sizeof(stats.caller_count));
+                stats.other_callers = e.other_callers;
+                stats.spin_queued = e.spin_queued;
+#endif
+
+                if (stats_buf.copy_array_to_user(&stats, 1, num_copied) != ZX_OK)
+                    return ZX_ERR_INVALID_ARGS;
+                num_copied++;
+            }
+
+            if (_actual) {
+                zx_status_t status = _actual.copy_to_user(num_copied);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                zx_status_t status = _avail.copy_to_user(num_used);
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+        }
+        case ZX_INFO_SYSCALL_STATS: {
+            auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+            if (status != ZX_OK)
+                return status;
+
+#if SYSCALL_PROFILING
+            size_t num_space_for = buffer_size / sizeof(zx_info_syscall_stats_t);
+            user_out_ptr<zx_info_syscall_stats_t> stats_buf =
+                _buffer.reinterpret<zx_info_syscall_stats_t>();
+
+            // copy out the syscalls that have been made, for as long as
+            // there is room
+            size_t num_copied = 0;
+            size_t num_used = 0;
+            for (uint32_t i = 0; i < ZX_SYS_COUNT; i++) {
+                zx_info_syscall_stats_t stats;
+                if (!syscall_stats_read(i, &stats))
+                    continue;
+                if (num_used++ >= num_space_for)
+                    continue;
+                if (stats_buf.copy_array_to_user(&stats, 1, num_copied) != ZX_OK)
+                    return ZX_ERR_INVALID_ARGS;
+                num_copied++;
+            }
+
+            if (_actual) {
+                zx_status_t status = _actual.copy_to_user(num_copied);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                zx_status_t status = _avail.copy_to_user(num_used);
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+#else
+            return ZX_ERR_NOT_SUPPORTED;
+#endif
+        }
         case ZX_INFO_RESOURCE: {
             // grab a reference to the dispatcher
             fbl::RefPtr<ResourceDispatcher> resource;
@@ -541,6 +719,80 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
         }
+        case ZX_INFO_GUEST_STATS: {
+            fbl::RefPtr<GuestDispatcher> guest;
+            auto error = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &guest);
+            if (error < 0)
+                return error;
+
+            zx_info_guest_stats_t info = {};
+            guest->GetStats(&info);
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
+        }
+        case ZX_INFO_BTI: {
+            fbl::RefPtr<BusTransactionInitiatorDispatcher> bti;
+            zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &bti);
+            if (status != ZX_OK)
+                return status;
+
+            zx_info_bti_t info = {};
+            bti->GetInfo(&info);
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &info, sizeof(info));
+        }
+        case ZX_INFO_PORT_EXCEPTION_STATS: {
+            fbl::RefPtr<PortDispatcher> port;
+            zx_status_t status =
+                up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &port);
+            if (status != ZX_OK)
+                return status;
+
+            auto stats = _buffer.reinterpret<zx_info_exception_port_stats_t>();
+            size_t count = buffer_size / sizeof(zx_info_exception_port_stats_t);
+            size_t avail = 0;
+            status = port->GetExceptionStats(stats, count, &count, &avail);
+            if (status != ZX_OK)
+                return status;
+
+            if (_actual) {
+                status = _actual.copy_to_user(count);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                status = _avail.copy_to_user(avail);
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+        }
+        case ZX_INFO_INTERRUPT_STATS: {
+            fbl::RefPtr<InterruptDispatcher> interrupt;
+            zx_status_t status =
+                up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &interrupt);
+            if (status != ZX_OK)
+                return status;
+
+            auto stats = _buffer.reinterpret<zx_info_interrupt_stats_t>();
+            size_t count = buffer_size / sizeof(zx_info_interrupt_stats_t);
+            size_t avail = 0;
+            status = interrupt->GetStats(stats, count, &count, &avail);
+            if (status != ZX_OK)
+                return status;
+
+            if (_actual) {
+                status = _actual.copy_to_user(count);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                status = _avail.copy_to_user(avail);
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+        }
 
         default:
             return ZX_ERR_NOT_SUPPORTED;
@@ -607,6 +859,30 @@ zx_status_t sys_object_get_property(zx_handle_t handle_value, uint32_t property,
                 return status;
             return ZX_OK;
         }
+        case ZX_PROP_VMO_NUMA_NODE: {
+            if (size != sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmo = DownCastDispatcher<VmObjectDispatcher>(&dispatcher);
+            if (!vmo)
+                return ZX_ERR_WRONG_TYPE;
+            uint32_t value;
+            zx_status_t status = vmo->GetNumaNode(&value);
+            if (status != ZX_OK)
+                return status;
+            return _value.reinterpret<uint32_t>().copy_to_user(value);
+        }
+        case ZX_PROP_VMO_MERGEABLE: {
+            if (size != sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmo = DownCastDispatcher<VmObjectDispatcher>(&dispatcher);
+            if (!vmo)
+                return ZX_ERR_WRONG_TYPE;
+            bool mergeable;
+            zx_status_t status = vmo->GetMergeable(&mergeable);
+            if (status != ZX_OK)
+                return status;
+            return _value.reinterpret<uint32_t>().copy_to_user(mergeable ? 1u : 0u);
+        }
         default:
             return ZX_ERR_INVALID_ARGS;
     }
@@ -687,6 +963,33 @@ zx_status_t sys_object_set_property(zx_handle_t handle_value, uint32_t property,
             return job->set_importance(
                 static_cast<zx_job_importance_t>(value));
         }
+        case ZX_PROP_VMO_NUMA_NODE: {
+            if (size != sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmo = DownCastDispatcher<VmObjectDispatcher>(&dispatcher);
+            if (!vmo)
+                return ZX_ERR_WRONG_TYPE;
+            static_assert(ZX_VMO_NUMA_NODE_LOCAL == PMM_NODE_LOCAL, "");
+            uint32_t value = 0;
+            zx_status_t status = _value.reinterpret<const uint32_t>().copy_from_user(&value);
+            if (status != ZX_OK)
+                return status;
+            return vmo->SetNumaNode(value);
+        }
+        case ZX_PROP_VMO_MERGEABLE: {
+            if (size != sizeof(uint32_t))
+                return ZX_ERR_BUFFER_TOO_SMALL;
+            auto vmo = DownCastDispatcher<VmObjectDispatcher>(&dispatcher);
+            if (!vmo)
+                return ZX_ERR_WRONG_TYPE;
+            uint32_t value = 0;
+            zx_status_t status = _value.reinterpret<const uint32_t>().copy_from_user(&value);
+            if (status != ZX_OK)
+                return status;
+            if (value > 1)
+                return ZX_ERR_INVALID_ARGS;
+            return vmo->SetMergeable(value != 0);
+        }
     }
 
     return ZX_ERR_INVALID_ARGS;
@@ -105,6 +105,47 @@ zx_status_t sys_port_wait(zx_handle_t handle, zx_time_t deadline,
     return ZX_OK;
 }
 
+zx_status_t sys_port_wait_many(zx_handle_t handle, zx_time_t deadline,
+                               user_out_ptr<zx_port_packet_t> packets_out, size_t count,
+                               user_out_ptr<size_t> actual_out) {
+    LTRACEF("handle %x\n", handle);
+
+    if (count == 0u || count > ZX_PORT_WAIT_MANY_MAX)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<PortDispatcher> port;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &port);
+    if (status != ZX_OK)
+        return status;
+
+    ktrace(TAG_PORT_WAIT, (uint32_t)port->get_koid(), 0, 0, 0);
+
+    zx_port_packet_t pp[ZX_PORT_WAIT_MANY_MAX];
+    size_t actual = 0u;
+    zx_status_t st = port->DequeueMany(deadline, pp, count, &actual);
+
+    ktrace(TAG_PORT_WAIT_DONE, (uint32_t)port->get_koid(), st, 0, 0);
+
+    if (st != ZX_OK)
+        return st;
+
+    // The packets have already left the port; if the copy fails they are lost,
+    // just as they are for zx_port_wait().
+    status = packets_out.copy_array_to_user(pp, actual);
+    if (status != ZX_OK)
+        return status;
+
+    if (actual_out) {
+        status = actual_out.copy_to_user(actual);
+        if (status != ZX_OK)
+            return status;
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t sys_port_cancel(zx_handle_t handle, zx_handle_t source, uint64_t key) {
     auto up = ProcessDispatcher::GetCurrent();
 
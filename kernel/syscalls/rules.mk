@@ -32,6 +32,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/zircon.cpp \
     $(LOCAL_DIR)/object.cpp \
     $(LOCAL_DIR)/object_wait.cpp \
+    $(LOCAL_DIR)/pager.cpp \
     $(LOCAL_DIR)/port.cpp \
     $(LOCAL_DIR)/resource.cpp \
     $(LOCAL_DIR)/socket.cpp \
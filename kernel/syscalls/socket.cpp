@@ -17,6 +17,7 @@
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
 #include <object/socket_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <zircon/syscalls/policy.h>
 #include <fbl/auto_lock.h>
@@ -114,7 +115,10 @@ zx_status_t sys_socket_read(zx_handle_t handle, uint32_t options,
         status = socket->ReadControl(buffer, size, &nread);
         break;
     default:
-        return ZX_ERR_INVALID_ARGS;
+        if ((options & ~ZX_SOCKET_SLOT_ORDER_MASK) != ZX_SOCKET_DATAGRAM_BATCH)
+            return ZX_ERR_INVALID_ARGS;
+        status = socket->ReadDatagrams(buffer, size, ZX_SOCKET_SLOT_ORDER_GET(options), &nread);
+        break;
     }
 
     // Caller may ignore results if desired.
@@ -169,3 +173,32 @@ zx_status_t sys_socket_accept(zx_handle_t handle, user_out_handle* out) {
 
     return out->transfer(fbl::move(outhandle));
 }
+
+zx_status_t sys_socket_ring_vmo(zx_handle_t handle, uint32_t options, user_out_handle* out) {
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<SocketDispatcher> socket;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &socket);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    status = socket->GetRingVmo(&vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    // The ring is shared with the kernel; it can be mapped and inspected but
+    // not executed.
+    rights &= ~ZX_RIGHT_EXECUTE;
+
+    return out->make(fbl::move(dispatcher), rights);
+}
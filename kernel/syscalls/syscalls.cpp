@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 
 #include <err.h>
+#include <fbl/atomic.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
 #include <lib/ktrace.h>
@@ -17,6 +18,7 @@
 
 #include <inttypes.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "priv.h"
 #include "vdso-valid-sysret.h"
@@ -31,6 +33,71 @@ int sys_invalid_syscall(uint64_t num, uint64_t pc,
     return ZX_ERR_BAD_SYSCALL;
 }
 
+#if SYSCALL_PROFILING
+namespace {
+
+constexpr uint32_t kHistogramShift = 7;
+
+struct SyscallStats {
+    fbl::atomic<uint64_t> count;
+    fbl::atomic<uint64_t> cycles;
+    fbl::atomic<uint64_t> histogram[ZX_SYSCALL_STATS_HISTOGRAM_BUCKETS];
+};
+
+SyscallStats syscall_stats[ZX_SYS_COUNT];
+
+const struct {
+    uint32_t id;
+    uint32_t nargs;
+    const char* name;
+} syscall_info[] = {
+#include <zircon/syscall-ktrace-info.inc>
+};
+
+void syscall_stats_record(uint64_t syscall_num, uint64_t cycles) {
+    if (syscall_num >= ZX_SYS_COUNT) {
+        return;
+    }
+    SyscallStats* stats = &syscall_stats[syscall_num];
+    uint32_t bucket = 0;
+    if (cycles >> (kHistogramShift + 1)) {
+        bucket = (63 - __builtin_clzll(cycles)) - kHistogramShift;
+        if (bucket >= ZX_SYSCALL_STATS_HISTOGRAM_BUCKETS) {
+            bucket = ZX_SYSCALL_STATS_HISTOGRAM_BUCKETS - 1;
+        }
+    }
+    stats->count.fetch_add(1, fbl::memory_order_relaxed);
+    stats->cycles.fetch_add(cycles, fbl::memory_order_relaxed);
+    stats->histogram[bucket].fetch_add(1, fbl::memory_order_relaxed);
+}
+
+} // namespace
+
+bool syscall_stats_read(uint32_t num, zx_info_syscall_stats_t* out) {
+    if (num >= ZX_SYS_COUNT) {
+        return false;
+    }
+    const SyscallStats* stats = &syscall_stats[num];
+    *out = {};
+    out->syscall = num;
+    out->count = stats->count.load(fbl::memory_order_relaxed);
+    if (out->count == 0) {
+        return false;
+    }
+    out->cycles = stats->cycles.load(fbl::memory_order_relaxed);
+    for (size_t i = 0; i < ZX_SYSCALL_STATS_HISTOGRAM_BUCKETS; i++) {
+        out->histogram[i] = stats->histogram[i].load(fbl::memory_order_relaxed);
+    }
+    for (const auto& info : syscall_info) {
+        if (info.id == num) {
+            strlcpy(out->name, info.name, sizeof(out->name));
+            break;
+        }
+    }
+    return true;
+}
+#endif // SYSCALL_PROFILING
+
 // N.B. Interrupts must be disabled on entry and they will be disabled on exit.
 // The reason is the two calls two arch_curr_cpu_num in the ktrace calls: we
 // don't want the cpu changing during the call.
@@ -38,10 +105,18 @@ int sys_invalid_syscall(uint64_t num, uint64_t pc,
 template <typename T>
 inline syscall_result do_syscall(uint64_t syscall_num, uint64_t pc,
                                         bool (*valid_pc)(uintptr_t), T make_call) {
-    ktrace_tiny(TAG_SYSCALL_ENTER, (static_cast<uint32_t>(syscall_num) << 8) | arch_curr_cpu_num());
+#if SYSCALL_PROFILING
+    const uint64_t start = arch_cycle_count();
+#endif
+    const bool traced = ktrace_sample(TAG_SYSCALL_ENTER);
+    if (traced) {
+        ktrace_tiny(TAG_SYSCALL_ENTER, (static_cast<uint32_t>(syscall_num) << 8) | arch_curr_cpu_num());
+    }
 
     CPU_STATS_INC(syscalls);
 
+    const zx_duration_t entry_runtime = thread_current_runtime();
+
     /* re-enable interrupts to maintain kernel preemptiveness
        This must be done after the above ktrace_tiny call, and after the
        above CPU_STATS_INC call as it also calls arch_curr_cpu_num. */
@@ -66,12 +141,59 @@ inline syscall_result do_syscall(uint64_t syscall_num, uint64_t pc,
        This must be done before the below ktrace_tiny call. */
     arch_disable_ints();
 
-    ktrace_tiny(TAG_SYSCALL_EXIT, (static_cast<uint32_t>(syscall_num << 8)) | arch_curr_cpu_num());
+    thread_t* current_thread = get_current_thread();
+    current_thread->kernel_ns += thread_current_runtime() - entry_runtime;
+
+    if (traced) {
+        ktrace_tiny(TAG_SYSCALL_EXIT, (static_cast<uint32_t>(syscall_num << 8)) | arch_curr_cpu_num());
+    }
+
+#if SYSCALL_PROFILING
+    syscall_stats_record(syscall_num, arch_cycle_count() - start);
+#endif
 
     // The assembler caller will re-disable interrupts at the appropriate time.
     return {ret, thread_is_signaled(get_current_thread())};
 }
 
+// Syscalls marked "leaf" in syscalls.abigen are short, and never block,
+// take a mutex or touch user memory.  They run entirely with interrupts
+// disabled, which saves turning them back on and off; an interrupt that
+// arrives meanwhile is taken once the thread is back in user mode.
+template <typename T>
+inline syscall_result do_leaf_syscall(uint64_t syscall_num, uint64_t pc,
+                                      bool (*valid_pc)(uintptr_t), T make_call) {
+    ProcessDispatcher* current_process = ProcessDispatcher::GetCurrent();
+    const uintptr_t vdso_code_address = current_process->cached_vdso_code_address();
+    if (unlikely(vdso_code_address == 0 || !valid_pc(pc - vdso_code_address))) {
+        // Computing the address, or reporting a bad one, takes locks.
+        return do_syscall(syscall_num, pc, valid_pc, make_call);
+    }
+
+#if SYSCALL_PROFILING
+    const uint64_t start = arch_cycle_count();
+#endif
+    const uint32_t trace_arg = (static_cast<uint32_t>(syscall_num) << 8) | arch_curr_cpu_num();
+    const bool traced = ktrace_sample(TAG_SYSCALL_ENTER);
+    if (traced) {
+        ktrace_tiny(TAG_SYSCALL_ENTER, trace_arg);
+    }
+
+    CPU_STATS_INC(syscalls);
+
+    const uint64_t ret = make_call(current_process);
+
+    if (traced) {
+        ktrace_tiny(TAG_SYSCALL_EXIT, trace_arg);
+    }
+
+#if SYSCALL_PROFILING
+    syscall_stats_record(syscall_num, arch_cycle_count() - start);
+#endif
+
+    return {ret, thread_is_signaled(get_current_thread())};
+}
+
 syscall_result unknown_syscall(uint64_t syscall_num, uint64_t pc) {
     return do_syscall(syscall_num, pc,
                       [](uintptr_t) { return false; },
@@ -98,6 +98,7 @@ zx_status_t get_process(ProcessDispatcher* up,
 union thread_state_local_buffer_t {
     zx_thread_state_general_regs general_regs;  // ZX_THREAD_STATE_GENERAL_REGS
     uint32_t single_step;  // ZX_THREAD_STATE_SINGLE_STEP
+    zx_thread_state_exception_t exception;  // ZX_THREAD_STATE_EXCEPTION
 };
 
 // Validates the input topic to thread_read_state and thread_write_state is a valid value, and
@@ -111,6 +112,9 @@ zx_status_t validate_thread_state_input(uint32_t in_topic, size_t in_len, size_t
     case ZX_THREAD_STATE_SINGLE_STEP:
         *out_len = sizeof(zx_thread_state_single_step_t);
         break;
+    case ZX_THREAD_STATE_EXCEPTION:
+        *out_len = sizeof(zx_thread_state_exception_t);
+        break;
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -250,6 +254,44 @@ zx_status_t sys_thread_write_state(zx_handle_t handle, uint32_t state_kind,
                               local_buffer_len);
 }
 
+zx_status_t sys_thread_resume_from_exception(zx_handle_t handle, uint32_t options,
+                                             uint32_t state_kind,
+                                             user_in_ptr<const void> _buffer,
+                                             size_t buffer_len) {
+    LTRACEF("handle %x, options %#x, state_kind %u\n", handle, options, state_kind);
+
+    if (options & ~ZX_RESUME_TRY_NEXT)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // TODO(ZX-968): debug rights
+    fbl::RefPtr<ThreadDispatcher> thread;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &thread);
+    if (status != ZX_OK)
+        return status;
+
+    // A zero |buffer_len| resumes without writing any state.
+    thread_state_local_buffer_t local_buffer;
+    size_t local_buffer_len = 0;
+    if (buffer_len != 0) {
+        status = validate_thread_state_input(state_kind, buffer_len, &local_buffer_len);
+        if (status != ZX_OK)
+            return status;
+        if (local_buffer_len != buffer_len)
+            return ZX_ERR_INVALID_ARGS;
+
+        status = _buffer.copy_array_from_user(&local_buffer, local_buffer_len);
+        if (status != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+    }
+
+    auto estatus = (options & ZX_RESUME_TRY_NEXT) ? ThreadDispatcher::ExceptionStatus::TRY_NEXT
+                                                  : ThreadDispatcher::ExceptionStatus::RESUME;
+    return thread->ResumeFromException(estatus, static_cast<zx_thread_state_topic_t>(state_kind),
+                                       &local_buffer, local_buffer_len);
+}
+
 // See ZX-940
 zx_status_t sys_thread_set_priority(int32_t prio) {
 #if THREAD_SET_PRIORITY_EXPERIMENT
@@ -269,6 +311,37 @@ zx_status_t sys_thread_set_priority(int32_t prio) {
 #endif
 }
 
+zx_status_t sys_thread_set_deadline(zx_handle_t handle, zx_duration_t capacity,
+                                    zx_duration_t deadline, zx_duration_t period) {
+    LTRACEF("handle %x, capacity %" PRIu64 ", deadline %" PRIu64 ", period %" PRIu64 "\n",
+            handle, capacity, deadline, period);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> thread;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &thread);
+    if (status != ZX_OK)
+        return status;
+
+    return thread->SetDeadline(capacity, deadline, period);
+}
+
+zx_status_t sys_thread_set_affinity(zx_handle_t handle, uint64_t cpu_mask) {
+    LTRACEF("handle %x, cpu_mask %#" PRIx64 "\n", handle, cpu_mask);
+
+    if (cpu_mask & ~static_cast<uint64_t>(CPU_MASK_ALL))
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> thread;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &thread);
+    if (status != ZX_OK)
+        return status;
+
+    return thread->SetAffinity(static_cast<cpu_mask_t>(cpu_mask));
+}
+
 zx_status_t sys_task_suspend(zx_handle_t task_handle) {
     LTRACE_ENTRY;
 
@@ -25,6 +25,56 @@
 
 #define LOCAL_TRACE 0
 
+// Checks that the protections requested in |*map_flags| are allowed by both
+// the VMO and the VMAR, and adds the CAN_MAP flags for the permissions they
+// both allow, so that the VMO's rights as of now can be used to constrain
+// future permission changes via Protect().
+static zx_status_t check_map_rights(zx_rights_t vmar_rights, zx_rights_t vmo_rights,
+                                    uint32_t* map_flags) {
+    // test to see if we should even be able to map this
+    if (!(vmo_rights & ZX_RIGHT_MAP))
+        return ZX_ERR_ACCESS_DENIED;
+
+    // Usermode is not allowed to specify these flags on mappings, though we may
+    // set them below.
+    if (*map_flags & (ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_WRITE | ZX_VM_FLAG_CAN_MAP_EXECUTE)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // Permissions allowed by both the VMO and the VMAR
+    const bool can_read = (vmo_rights & ZX_RIGHT_READ) && (vmar_rights & ZX_RIGHT_READ);
+    const bool can_write = (vmo_rights & ZX_RIGHT_WRITE) && (vmar_rights & ZX_RIGHT_WRITE);
+    const bool can_exec = (vmo_rights & ZX_RIGHT_EXECUTE) && (vmar_rights & ZX_RIGHT_EXECUTE);
+
+    // test to see if the requested mapping protections are allowed
+    if ((*map_flags & ZX_VM_FLAG_PERM_READ) && !can_read)
+        return ZX_ERR_ACCESS_DENIED;
+    if ((*map_flags & ZX_VM_FLAG_PERM_WRITE) && !can_write)
+        return ZX_ERR_ACCESS_DENIED;
+    if ((*map_flags & ZX_VM_FLAG_PERM_EXECUTE) && !can_exec)
+        return ZX_ERR_ACCESS_DENIED;
+
+    if (can_read)
+        *map_flags |= ZX_VM_FLAG_CAN_MAP_READ;
+    if (can_write)
+        *map_flags |= ZX_VM_FLAG_CAN_MAP_WRITE;
+    if (can_exec)
+        *map_flags |= ZX_VM_FLAG_CAN_MAP_EXECUTE;
+    return ZX_OK;
+}
+
+// Returns the VMAR rights needed to give a mapping the protections in |prot|.
+static zx_rights_t protect_rights(uint32_t prot) {
+    zx_rights_t vmar_rights = 0u;
+    if (prot & ZX_VM_FLAG_PERM_READ)
+        vmar_rights |= ZX_RIGHT_READ;
+    if (prot & ZX_VM_FLAG_PERM_WRITE)
+        vmar_rights |= ZX_RIGHT_WRITE;
+    if (prot & ZX_VM_FLAG_PERM_EXECUTE)
+        vmar_rights |= ZX_RIGHT_EXECUTE;
+    return vmar_rights;
+}
+
 zx_status_t sys_vmar_allocate(zx_handle_t parent_vmar_handle,
                               size_t offset, size_t size, uint32_t map_flags,
                               user_out_handle* child_vmar,
@@ -106,10 +156,6 @@ zx_status_t sys_vmar_map(zx_handle_t vmar_handle, size_t vmar_offset,
     if (status != ZX_OK)
         return status;
 
-    // test to see if we should even be able to map this
-    if (!(vmo_rights & ZX_RIGHT_MAP))
-        return ZX_ERR_ACCESS_DENIED;
-
     if (!VmAddressRegionDispatcher::is_valid_mapping_protection(map_flags))
         return ZX_ERR_INVALID_ARGS;
 
@@ -119,34 +165,9 @@ zx_status_t sys_vmar_map(zx_handle_t vmar_handle, size_t vmar_offset,
         map_flags &= ~ZX_VM_FLAG_MAP_RANGE;
     }
 
-    // Usermode is not allowed to specify these flags on mappings, though we may
-    // set them below.
-    if (map_flags & (ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_WRITE | ZX_VM_FLAG_CAN_MAP_EXECUTE)) {
-        return ZX_ERR_INVALID_ARGS;
-    }
-
-    // Permissions allowed by both the VMO and the VMAR
-    const bool can_read = (vmo_rights & ZX_RIGHT_READ) && (vmar_rights & ZX_RIGHT_READ);
-    const bool can_write = (vmo_rights & ZX_RIGHT_WRITE) && (vmar_rights & ZX_RIGHT_WRITE);
-    const bool can_exec = (vmo_rights & ZX_RIGHT_EXECUTE) && (vmar_rights & ZX_RIGHT_EXECUTE);
-
-    // test to see if the requested mapping protections are allowed
-    if ((map_flags & ZX_VM_FLAG_PERM_READ) && !can_read)
-        return ZX_ERR_ACCESS_DENIED;
-    if ((map_flags & ZX_VM_FLAG_PERM_WRITE) && !can_write)
-        return ZX_ERR_ACCESS_DENIED;
-    if ((map_flags & ZX_VM_FLAG_PERM_EXECUTE) && !can_exec)
-        return ZX_ERR_ACCESS_DENIED;
-
-    // If a permission is allowed by both the VMO and the VMAR, add it to the
-    // flags for the new mapping, so that the VMO's rights as of now can be used
-    // to constrain future permission changes via Protect().
-    if (can_read)
-        map_flags |= ZX_VM_FLAG_CAN_MAP_READ;
-    if (can_write)
-        map_flags |= ZX_VM_FLAG_CAN_MAP_WRITE;
-    if (can_exec)
-        map_flags |= ZX_VM_FLAG_CAN_MAP_EXECUTE;
+    status = check_map_rights(vmar_rights, vmo_rights, &map_flags);
+    if (status != ZX_OK)
+        return status;
 
     fbl::RefPtr<VmMapping> vm_mapping;
     status = vmar->Map(vmar_offset, vmo->vmo(), vmo_offset, len, map_flags, &vm_mapping);
@@ -188,17 +209,9 @@ zx_status_t sys_vmar_unmap(zx_handle_t vmar_handle, uintptr_t addr, size_t len)
 zx_status_t sys_vmar_protect(zx_handle_t vmar_handle, uintptr_t addr, size_t len, uint32_t prot) {
     auto up = ProcessDispatcher::GetCurrent();
 
-    zx_rights_t vmar_rights = 0u;
-    if (prot & ZX_VM_FLAG_PERM_READ)
-        vmar_rights |= ZX_RIGHT_READ;
-    if (prot & ZX_VM_FLAG_PERM_WRITE)
-        vmar_rights |= ZX_RIGHT_WRITE;
-    if (prot & ZX_VM_FLAG_PERM_EXECUTE)
-        vmar_rights |= ZX_RIGHT_EXECUTE;
-
     // lookup the dispatcher from handle
     fbl::RefPtr<VmAddressRegionDispatcher> vmar;
-    zx_status_t status = up->GetDispatcherWithRights(vmar_handle, vmar_rights, &vmar);
+    zx_status_t status = up->GetDispatcherWithRights(vmar_handle, protect_rights(prot), &vmar);
     if (status != ZX_OK)
         return status;
 
@@ -207,3 +220,81 @@ zx_status_t sys_vmar_protect(zx_handle_t vmar_handle, uintptr_t addr, size_t len
 
     return vmar->Protect(addr, len, prot);
 }
+
+zx_status_t sys_vmar_op_range(zx_handle_t vmar_handle, uint32_t op, uintptr_t addr, size_t len) {
+    LTRACEF("handle %x op %u addr %#" PRIxPTR " len %#zx\n", vmar_handle, op, addr, len);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the dispatcher from handle
+    fbl::RefPtr<VmAddressRegionDispatcher> vmar;
+    zx_status_t status = up->GetDispatcher(vmar_handle, &vmar);
+    if (status != ZX_OK)
+        return status;
+
+    return vmar->RangeOp(op, addr, len);
+}
+
+zx_status_t sys_vmar_batch(zx_handle_t vmar_handle, user_inout_ptr<zx_vmar_batch_op_t> user_ops,
+                           size_t count, user_out_ptr<size_t> actual) {
+    LTRACEF("handle %x count %zu\n", vmar_handle, count);
+
+    if (count > ZX_VMAR_BATCH_MAX_OPS)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    zx_vmar_batch_op_t ops[ZX_VMAR_BATCH_MAX_OPS];
+    if (user_ops.copy_array_from_user(ops, count) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the VMAR dispatcher from handle
+    fbl::RefPtr<VmAddressRegionDispatcher> vmar;
+    zx_rights_t vmar_rights;
+    zx_status_t status = up->GetDispatcherAndRights(vmar_handle, &vmar, &vmar_rights);
+    if (status != ZX_OK)
+        return status;
+
+    // Check the rights for every operation before running any of them.  The
+    // flags the user passed are put back before the ops are copied out.
+    uint32_t user_flags[ZX_VMAR_BATCH_MAX_OPS];
+    fbl::RefPtr<VmObject> vmos[ZX_VMAR_BATCH_MAX_OPS];
+    for (size_t i = 0; i < count; ++i) {
+        user_flags[i] = ops[i].flags;
+        if (ops[i].op == ZX_VMAR_BATCH_MAP) {
+            // Mappings can't be populated as part of a batch.
+            if (ops[i].flags & ZX_VM_FLAG_MAP_RANGE)
+                return ZX_ERR_INVALID_ARGS;
+
+            fbl::RefPtr<VmObjectDispatcher> vmo;
+            zx_rights_t vmo_rights;
+            status = up->GetDispatcherAndRights(ops[i].vmo, &vmo, &vmo_rights);
+            if (status != ZX_OK)
+                return status;
+            status = check_map_rights(vmar_rights, vmo_rights, &ops[i].flags);
+            if (status != ZX_OK)
+                return status;
+            vmos[i] = vmo->vmo();
+        } else if (ops[i].op == ZX_VMAR_BATCH_PROTECT) {
+            const zx_rights_t needed = protect_rights(ops[i].flags);
+            if ((vmar_rights & needed) != needed)
+                return ZX_ERR_ACCESS_DENIED;
+        }
+    }
+
+    size_t completed = 0;
+    status = vmar->Batch(ops, vmos, count, &completed);
+
+    // Report the addresses of the mappings which were made, even if a later
+    // operation failed.
+    for (size_t i = 0; i < completed; ++i)
+        ops[i].flags = user_flags[i];
+    if (completed > 0 && user_ops.copy_array_to_user(ops, completed) != ZX_OK)
+        return ZX_ERR_INVALID_ARGS;
+    if (actual) {
+        zx_status_t copy_status = actual.copy_to_user(completed);
+        if (copy_status != ZX_OK)
+            return copy_status;
+    }
+    return status;
+}
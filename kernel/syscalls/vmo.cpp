@@ -27,7 +27,7 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
                            user_out_handle* out) {
     LTRACEF("size %#" PRIx64 "\n", size);
 
-    if (options != 0u)
+    if (options & ~(ZX_VMO_LARGE_PAGES | ZX_VMO_DISCARDABLE))
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -35,9 +35,15 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
     if (res != ZX_OK)
         return res;
 
+    uint32_t vmo_options = 0;
+    if (options & ZX_VMO_LARGE_PAGES)
+        vmo_options |= VmObjectPaged::kLargePages;
+    if (options & ZX_VMO_DISCARDABLE)
+        vmo_options |= VmObjectPaged::kDiscardable;
+
     // create a vm object
     fbl::RefPtr<VmObject> vmo;
-    res = VmObjectPaged::Create(0, size, &vmo);
+    res = VmObjectPaged::Create(0, vmo_options, size, &vmo);
     if (res != ZX_OK)
         return res;
 
@@ -18,6 +18,7 @@
 #include <kernel/thread.h>
 #include <lib/crypto/global_prng.h>
 #include <lib/user_copy/user_ptr.h>
+#include <lib/vdso.h>
 #include <object/event_dispatcher.h>
 #include <object/event_pair_dispatcher.h>
 #include <object/handle.h>
@@ -26,6 +27,7 @@
 #include <object/resources.h>
 #include <object/thread_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/atomic.h>
 #include <fbl/ref_ptr.h>
@@ -40,6 +42,7 @@
 
 constexpr size_t kMaxCPRNGDraw = ZX_CPRNG_DRAW_MAX_LEN;
 constexpr size_t kMaxCPRNGSeed = ZX_CPRNG_ADD_ENTROPY_MAX_LEN;
+constexpr size_t kMaxDebugLogRead = 64 * 1024;
 
 zx_status_t sys_nanosleep(zx_time_t deadline) {
     LTRACEF("nseconds %" PRIu64 "\n", deadline);
@@ -60,7 +63,9 @@ zx_status_t sys_nanosleep(zx_time_t deadline) {
 // update pvclock too.
 fbl::atomic<int64_t> utc_offset;
 
-uint64_t sys_clock_get(uint32_t clock_id) {
+// The vDSO handles ZX_CLOCK_MONOTONIC and ZX_CLOCK_UTC itself when it can
+// read the counter behind current_time().
+uint64_t sys_clock_get_via_kernel(uint32_t clock_id) {
     switch (clock_id) {
     case ZX_CLOCK_MONOTONIC:
         return current_time();
@@ -86,6 +91,7 @@ zx_status_t sys_clock_adjust(zx_handle_t hrsrc, uint32_t clock_id, int64_t offse
         return ZX_ERR_ACCESS_DENIED;
     case ZX_CLOCK_UTC:
         utc_offset.store(offset);
+        VDso::SetUtcOffset(offset);
         return ZX_OK;
     default:
         return ZX_ERR_INVALID_ARGS;
@@ -192,7 +198,7 @@ zx_status_t sys_debuglog_read(zx_handle_t log_handle, uint32_t options,
                               user_out_ptr<void> ptr, size_t len) {
     LTRACEF("log handle %x, opt %x, ptr 0x%p, len %zu\n", log_handle, options, ptr.get(), len);
 
-    if (options != 0)
+    if (options & ~ZX_LOG_READ_MULTIPLE)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -202,6 +208,14 @@ zx_status_t sys_debuglog_read(zx_handle_t log_handle, uint32_t options,
     if (status != ZX_OK)
         return status;
 
+    if (options & ZX_LOG_READ_MULTIPLE) {
+        // The byte count comes back in the status, so must stay positive.
+        size_t actual;
+        if ((status = log->ReadMultiple(ptr, fbl::min(len, kMaxDebugLogRead), &actual)) < 0)
+            return status;
+        return static_cast<zx_status_t>(actual);
+    }
+
     char buf[DLOG_MAX_RECORD];
     size_t actual;
     if ((status = log->Read(options, buf, DLOG_MAX_RECORD, &actual)) < 0)
@@ -230,9 +244,7 @@ zx_status_t sys_cprng_draw(user_out_ptr<void> buffer, size_t len, user_out_ptr<s
     // returns.
     explicit_memory::ZeroDtor<uint8_t> zero_guard(kernel_buf, sizeof(kernel_buf));
 
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    ASSERT(prng->is_thread_safe());
-    prng->Draw(kernel_buf, static_cast<int>(len));
+    crypto::GlobalPRNG::DrawPerCpu(kernel_buf, len);
 
     if (buffer.copy_array_to_user(kernel_buf, len) != ZX_OK)
         return ZX_ERR_INVALID_ARGS;
@@ -255,9 +267,8 @@ zx_status_t sys_cprng_add_entropy(user_in_ptr<const void> buffer, size_t len) {
     if (buffer.copy_array_from_user(kernel_buf, len) != ZX_OK)
         return ZX_ERR_INVALID_ARGS;
 
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    ASSERT(prng->is_thread_safe());
-    prng->AddEntropy(kernel_buf, static_cast<int>(len));
+    ASSERT(crypto::GlobalPRNG::GetInstance()->is_thread_safe());
+    crypto::GlobalPRNG::AddEntropy(kernel_buf, len);
 
     return ZX_OK;
 }
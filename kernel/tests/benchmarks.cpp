@@ -21,6 +21,10 @@
 #include <string.h>
 #include <sys/types.h>
 
+#if ARCH_X86
+#include <arch/x86/user_copy.h>
+#endif
+
 const size_t BUFSIZE = (8 * 1024 * 1024);
 const size_t ITER = (1UL * 1024 * 1024 * 1024 / BUFSIZE); // enough iterations to have to copy/set 1GB of memory
 
@@ -178,6 +182,45 @@ __NO_INLINE static void bench_memcpy() {
     free(buf);
 }
 
+#if ARCH_X86
+// Times the copy loop used by arch_copy_from_user() and arch_copy_to_user(),
+// as patched for this cpu, and the non-temporal one used for large VMO
+// writes, over a range of sizes.  Kernel buffers stand in for user ones.
+__NO_INLINE static void bench_user_copy() {
+    static const size_t kMaxSize = 1024 * 1024;
+    uint8_t* buf = (uint8_t*)calloc(1, 2 * kMaxSize);
+    void* fault_return = nullptr;
+
+    for (size_t size = 16; size <= kMaxSize; size *= 4) {
+        // Copy the same total amount at each size, up to 256MB.
+        const size_t iter = (256UL * 1024 * 1024) / size;
+
+        spin_lock_saved_state_t state;
+        arch_interrupt_save(&state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+        uint64_t count = arch_cycle_count();
+        for (size_t i = 0; i < iter; i++) {
+            _x86_copy_to_or_from_user(buf, buf + kMaxSize, size, &fault_return);
+        }
+        count = arch_cycle_count() - count;
+        uint64_t nt_count = arch_cycle_count();
+        for (size_t i = 0; i < iter; i++) {
+            _x86_copy_to_or_from_user_nontemporal(buf, buf + kMaxSize, size, &fault_return);
+        }
+        nt_count = arch_cycle_count() - nt_count;
+        arch_interrupt_restore(state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+
+        uint64_t bytes_cycle = (size * iter * 1000ULL) / count;
+        uint64_t nt_bytes_cycle = (size * iter * 1000ULL) / nt_count;
+        printf("user copy of %7zu bytes %8zu times: %" PRIu64 ".%03" PRIu64 " bytes/cycle, "
+               "non-temporal %" PRIu64 ".%03" PRIu64 " bytes/cycle\n",
+               size, iter, bytes_cycle / 1000, bytes_cycle % 1000,
+               nt_bytes_cycle / 1000, nt_bytes_cycle % 1000);
+    }
+
+    free(buf);
+}
+#endif
+
 __NO_INLINE static void bench_spinlock() {
     spin_lock_saved_state_t state;
     spin_lock_saved_state_t state2;
@@ -226,6 +269,87 @@ __NO_INLINE static void bench_spinlock() {
 #undef COUNT
 }
 
+struct spinlock_contention_args {
+    spin_lock_t* lock;
+    volatile uint64_t* shared;
+    volatile bool* go;
+    zx_time_t end;
+    uint64_t acquired;
+};
+
+static int spinlock_contention_thread(void* arg) {
+    auto args = static_cast<spinlock_contention_args*>(arg);
+    while (!*args->go)
+        arch_spinloop_pause();
+
+    // check the clock every batch of acquisitions, rather than in the loop
+    uint64_t acquired = 0;
+    do {
+        for (int i = 0; i < 1024; i++) {
+            spin_lock_saved_state_t state;
+            spin_lock_irqsave(args->lock, state);
+            *args->shared = *args->shared + 1;
+            spin_unlock_irqrestore(args->lock, state);
+        }
+        acquired += 1024;
+    } while (current_time() < args->end);
+
+    args->acquired = acquired;
+    return 0;
+}
+
+// every online cpu hammering one spinlock: the rate it changes hands, and how
+// evenly it is shared out between the cpus
+__NO_INLINE static void bench_spinlock_contention() {
+    spin_lock_t lock;
+    spin_lock_init(&lock);
+    volatile uint64_t shared = 0;
+    volatile bool go = false;
+
+    const zx_duration_t duration = ZX_MSEC(500);
+    spinlock_contention_args args[SMP_MAX_CPUS] = {};
+    thread_t* threads[SMP_MAX_CPUS] = {};
+    cpu_mask_t online = mp_get_online_mask();
+    uint cpus = 0;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (!(online & cpu_num_to_mask(i)))
+            continue;
+        args[i] = {&lock, &shared, &go, 0, 0};
+        threads[i] = thread_create("spinlock contention", &spinlock_contention_thread, &args[i],
+                                   HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+        if (!threads[i])
+            continue;
+        thread_set_cpu_affinity(threads[i], cpu_num_to_mask(i));
+        thread_resume(threads[i]);
+        cpus++;
+    }
+
+    zx_time_t end = current_time() + duration;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++)
+        args[i].end = end;
+    go = true;
+
+    uint64_t total = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (!threads[i])
+            continue;
+        thread_join(threads[i], NULL, ZX_TIME_INFINITE);
+        total += args[i].acquired;
+        min = MIN(min, args[i].acquired);
+        max = MAX(max, args[i].acquired);
+    }
+    if (total == 0)
+        return;
+
+    printf("%" PRIu64 " contended spinlock acquisitions on %u cpus in %" PRIu64 " ms "
+           "(%" PRIu64 " ns per)\n",
+           total, cpus, duration / ZX_MSEC(1), duration / total);
+    printf("\tper cpu: min %" PRIu64 " max %" PRIu64 " (min/max %" PRIu64 "%%)\n",
+           min, max, max ? min * 100 / max : 0);
+}
+
 __NO_INLINE static void bench_mutex() {
     mutex_t m;
     mutex_init(&m);
@@ -245,6 +369,9 @@ void benchmarks() {
     bench_set_overhead();
     bench_memcpy();
     bench_memset();
+#if ARCH_X86
+    bench_user_copy();
+#endif
 
     bench_memset_per_page();
     bench_zero_page();
@@ -256,5 +383,6 @@ void benchmarks() {
     bench_cset_wide();
 
     bench_spinlock();
+    bench_spinlock_contention();
     bench_mutex();
 }
@@ -0,0 +1,134 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <arch/ops.h>
+#include <kernel/dpc.h>
+#include <kernel/event.h>
+#include <kernel/spinlock.h>
+#include <unittest.h>
+
+namespace {
+
+struct OrderState {
+    event_t done;
+    int ran;
+    int order[3];
+};
+
+struct OrderedDpc {
+    dpc_t dpc;
+    OrderState* state;
+    int id;
+};
+
+void record_order(dpc_t* d) {
+    auto dpc = reinterpret_cast<OrderedDpc*>(d->arg);
+    OrderState* state = dpc->state;
+    state->order[state->ran++] = dpc->id;
+    if (state->ran == 3)
+        event_signal(&state->done, true);
+}
+
+void init_dpc(dpc_t* dpc, dpc_func_t func, void* arg, uint32_t priority) {
+    list_clear_node(&dpc->node);
+    dpc->func = func;
+    dpc->arg = arg;
+    dpc->priority = priority;
+    dpc->queued = 0;
+}
+
+// High priority dpcs run ahead of normal ones queued before them.
+bool test_priority_order(void* context) {
+    BEGIN_TEST;
+
+    OrderState state = {};
+    event_init(&state.done, false, 0);
+
+    OrderedDpc dpcs[3];
+    const uint32_t priorities[3] = {DPC_PRIORITY_NORMAL, DPC_PRIORITY_NORMAL, DPC_PRIORITY_HIGH};
+    for (int i = 0; i < 3; i++) {
+        dpcs[i].state = &state;
+        dpcs[i].id = i;
+        init_dpc(&dpcs[i].dpc, record_order, &dpcs[i], priorities[i]);
+    }
+
+    // Queue them all on this cpu before its dpc thread can get to any.
+    spin_lock_saved_state_t irqstate;
+    arch_interrupt_save(&irqstate, SPIN_LOCK_FLAG_INTERRUPTS);
+    for (auto& dpc : dpcs)
+        EXPECT_EQ(dpc_queue(&dpc.dpc, false), ZX_OK, "");
+    EXPECT_EQ(dpc_queue(&dpcs[0].dpc, false), ZX_ERR_ALREADY_EXISTS, "");
+    arch_interrupt_restore(irqstate, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    REQUIRE_EQ(event_wait(&state.done), ZX_OK, "");
+    EXPECT_EQ(state.order[0], 2, "high priority dpc should run first");
+    EXPECT_EQ(state.order[1], 0, "");
+    EXPECT_EQ(state.order[2], 1, "");
+
+    event_destroy(&state.done);
+
+    END_TEST;
+}
+
+struct BlockingState {
+    event_t started;
+    event_t release;
+    volatile bool finished;
+    volatile bool other_ran;
+};
+
+void block(dpc_t* d) {
+    auto state = reinterpret_cast<BlockingState*>(d->arg);
+    event_signal(&state->started, false);
+    event_wait(&state->release);
+    state->finished = true;
+}
+
+void note_ran(dpc_t* d) {
+    reinterpret_cast<BlockingState*>(d->arg)->other_ran = true;
+}
+
+// dpc_cancel_sync() dequeues a dpc that hasn't run, and waits out one that
+// is running.
+bool test_cancel_sync(void* context) {
+    BEGIN_TEST;
+
+    BlockingState state = {};
+    event_init(&state.started, false, 0);
+    event_init(&state.release, false, 0);
+
+    dpc_t blocker;
+    dpc_t queued;
+    init_dpc(&blocker, block, &state, DPC_PRIORITY_NORMAL);
+    init_dpc(&queued, note_ran, &state, DPC_PRIORITY_NORMAL);
+
+    spin_lock_saved_state_t irqstate;
+    arch_interrupt_save(&irqstate, SPIN_LOCK_FLAG_INTERRUPTS);
+    EXPECT_EQ(dpc_queue(&blocker, false), ZX_OK, "");
+    EXPECT_EQ(dpc_queue(&queued, false), ZX_OK, "");
+    arch_interrupt_restore(irqstate, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    REQUIRE_EQ(event_wait(&state.started), ZX_OK, "");
+    dpc_cancel_sync(&queued);
+    EXPECT_FALSE(list_in_list(&queued.node), "");
+
+    event_signal(&state.release, true);
+    dpc_cancel_sync(&blocker);
+    EXPECT_TRUE(state.finished, "should wait for the running dpc");
+    EXPECT_FALSE(state.other_ran, "canceled dpc should not run");
+
+    event_destroy(&state.started);
+    event_destroy(&state.release);
+
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(dpc_tests)
+UNITTEST("priority_order", test_priority_order)
+UNITTEST("cancel_sync", test_cancel_sync)
+UNITTEST_END_TESTCASE(dpc_tests, "dpc_tests", "dpc tests", nullptr, nullptr);
@@ -14,6 +14,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/benchmarks.cpp \
     $(LOCAL_DIR)/cache_tests.cpp \
     $(LOCAL_DIR)/clock_tests.cpp \
+    $(LOCAL_DIR)/dpc_tests.cpp \
     $(LOCAL_DIR)/fibo.cpp \
     $(LOCAL_DIR)/mem_tests.cpp \
     $(LOCAL_DIR)/preempt_disable_tests.cpp \
@@ -15,6 +15,8 @@
 
 #include <assert.h>
 #include <debug.h>
+#include <kernel/thread.h>
+#include <lib/ktrace.h>
 #include <trace.h>
 #include <zircon/compiler.h>
 
@@ -27,6 +29,10 @@
 extern const struct lk_init_struct __start_lk_init[];
 extern const struct lk_init_struct __stop_lk_init[];
 
+static bool lk_init_is_deferred(const struct lk_init_struct* ptr) {
+    return (ptr->flags & LK_INIT_FLAG_DEFERRED) && ptr->level >= LK_INIT_LEVEL_THREADING;
+}
+
 void lk_init_level(enum lk_init_flags required_flag, uint start_level, uint stop_level) {
     LTRACEF("flags %#x, start_level %#x, stop_level %#x\n",
             (uint)required_flag, start_level, stop_level);
@@ -49,6 +55,10 @@ void lk_init_level(enum lk_init_flags required_flag, uint start_level, uint stop
             /* reject the easy ones */
             if (!(ptr->flags & required_flag))
                 continue;
+            if (required_flag == LK_INIT_FLAG_PRIMARY_CPU && lk_init_is_deferred(ptr))
+                continue;
+            if (required_flag == LK_INIT_FLAG_DEFERRED && !lk_init_is_deferred(ptr))
+                continue;
             if (ptr->level > stop_level)
                 continue;
             if (ptr->level < last_called_level)
@@ -87,3 +97,20 @@ void lk_init_level(enum lk_init_flags required_flag, uint start_level, uint stop
         last = found;
     }
 }
+
+static int lk_init_deferred_thread(void*) {
+    lk_init_level(LK_INIT_FLAG_DEFERRED, LK_INIT_LEVEL_THREADING, LK_INIT_LEVEL_LAST);
+    ktrace_boot_phase("boot_deferred_done");
+    return 0;
+}
+
+void lk_init_deferred(void) {
+    thread_t* t = thread_create("deferred init", &lk_init_deferred_thread, NULL,
+                                DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+    if (!t) {
+        // run them here instead
+        lk_init_deferred_thread(NULL);
+        return;
+    }
+    thread_detach_and_resume(t);
+}
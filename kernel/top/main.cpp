@@ -17,6 +17,7 @@
 #include <kernel/mutex.h>
 #include <kernel/thread.h>
 #include <lib/heap.h>
+#include <lib/ktrace.h>
 #include <lk/init.h>
 #include <platform.h>
 #include <string.h>
@@ -53,6 +54,7 @@ void lk_main() {
     // do any super early platform initialization
     lk_primary_cpu_init_level(LK_INIT_LEVEL_ARCH_EARLY, LK_INIT_LEVEL_PLATFORM_EARLY - 1);
     platform_early_init();
+    ktrace_boot_phase("boot_platform_early");
 
     // do any super early target initialization
     lk_primary_cpu_init_level(LK_INIT_LEVEL_PLATFORM_EARLY, LK_INIT_LEVEL_TARGET_EARLY - 1);
@@ -63,6 +65,7 @@ void lk_main() {
     lk_primary_cpu_init_level(LK_INIT_LEVEL_TARGET_EARLY, LK_INIT_LEVEL_VM_PREHEAP - 1);
     dprintf(SPEW, "initializing vm pre-heap\n");
     vm_init_preheap();
+    ktrace_boot_phase("boot_vm_preheap");
 
     // bring up the kernel heap
     lk_primary_cpu_init_level(LK_INIT_LEVEL_VM_PREHEAP, LK_INIT_LEVEL_HEAP - 1);
@@ -72,11 +75,13 @@ void lk_main() {
     lk_primary_cpu_init_level(LK_INIT_LEVEL_HEAP, LK_INIT_LEVEL_VM - 1);
     dprintf(SPEW, "initializing vm\n");
     vm_init();
+    ktrace_boot_phase("boot_vm");
 
     // initialize the kernel
     lk_primary_cpu_init_level(LK_INIT_LEVEL_VM, LK_INIT_LEVEL_KERNEL - 1);
     dprintf(SPEW, "initializing kernel\n");
     kernel_init();
+    ktrace_boot_phase("boot_kernel");
 
     lk_primary_cpu_init_level(LK_INIT_LEVEL_KERNEL, LK_INIT_LEVEL_THREADING - 1);
 
@@ -94,21 +99,29 @@ void lk_main() {
 static int bootstrap2(void*) {
     dprintf(SPEW, "top of bootstrap2()\n");
 
+    ktrace_boot_phase("boot_threading");
     lk_primary_cpu_init_level(LK_INIT_LEVEL_THREADING, LK_INIT_LEVEL_ARCH - 1);
     arch_init();
+    ktrace_boot_phase("boot_arch");
 
     // initialize the rest of the platform
     dprintf(SPEW, "initializing platform\n");
     lk_primary_cpu_init_level(LK_INIT_LEVEL_ARCH, LK_INIT_LEVEL_PLATFORM - 1);
     platform_init();
+    ktrace_boot_phase("boot_platform");
 
     // initialize the target
     dprintf(SPEW, "initializing target\n");
     lk_primary_cpu_init_level(LK_INIT_LEVEL_PLATFORM, LK_INIT_LEVEL_TARGET - 1);
     target_init();
+    ktrace_boot_phase("boot_target");
 
     dprintf(SPEW, "moving to last init level\n");
     lk_primary_cpu_init_level(LK_INIT_LEVEL_TARGET, LK_INIT_LEVEL_LAST);
+    ktrace_boot_phase("boot_done");
+
+    // userboot is on its way, so run what could wait alongside it
+    lk_init_deferred();
 
     return 0;
 }
@@ -58,6 +58,14 @@ public:
 
     virtual zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) = 0;
 
+    // Batch the TLB invalidations made by the calling thread's Unmap and
+    // Protect calls until FlushPendingInvalidations(), so that an operation
+    // spanning many mappings only has to interrupt the other CPUs once.
+    // Nothing unmapped in between may be freed before the flush.
+    // Architectures that broadcast invalidations in hardware need not batch.
+    virtual void DeferInvalidations() {}
+    virtual void FlushPendingInvalidations() {}
+
     virtual vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                              vaddr_t end, uint next_region_mmu_flags,
                              vaddr_t align, size_t size, uint mmu_flags) = 0;
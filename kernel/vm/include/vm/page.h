@@ -39,12 +39,30 @@ typedef struct vm_page {
             // If true, one pin slot is used by the VmObject to keep a run
             // contiguous.
             bool contiguous_pin : 1;
+            // If true, the page has been merged with identical pages of other
+            // objects and may be in several of them at once, see
+            // VmMergedPages. It must not be written or freed by any one of
+            // them.
+            bool merged : 1;
+
+            // Number of objects holding a merged page, guarded by the
+            // VmMergedPages lock.
+            uint32_t merge_count;
         } object;
 
+        struct {
+            // On the first page of a large heap allocation, the number of
+            // pages in it. See VM_PAGE_FLAG_HEAP_LARGE.
+            size_t large_pages;
+        } heap;
+
         uint8_t pad[24]; // pad out to 32 bytes
     };
 } vm_page_t;
 
+// vm_page_t.flags
+#define VM_PAGE_FLAG_HEAP_LARGE (1u << 0) // first page of a large heap allocation
+
 // pmm will maintain pages of this size
 #define VM_PAGE_STRUCT_SIZE (sizeof(vm_page_t))
 static_assert(sizeof(vm_page_t) == 32, "");
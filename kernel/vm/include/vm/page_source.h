@@ -0,0 +1,73 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <stdint.h>
+#include <zircon/types.h>
+
+class VmObjectPaged;
+
+// Provides the contents of a VmObjectPaged whose pages are not committed up
+// front. The object asks for the pages it is missing and the source supplies
+// them later through VmObjectPaged::SupplyPagerPages().
+class PageSource : public fbl::RefCounted<PageSource> {
+public:
+    // Ask for the missing pages of the object in [offset, offset + len). Called
+    // with the object lock held, so it must not block or call back into the object.
+    // A failure is handed to the thread that needed the page.
+    virtual zx_status_t GetPages(uint64_t offset, uint64_t len) = 0;
+
+    // The last clone of the object went away. |children| is the number of clones
+    // the object has had so far. Called with the object lock held.
+    virtual void OnZeroChildren(uint64_t children) = 0;
+
+    // The object is being destroyed and will not ask for anything again.
+    virtual void OnDetach() = 0;
+
+protected:
+    PageSource() = default;
+    virtual ~PageSource() = default;
+    friend fbl::RefPtr<PageSource>;
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageSource);
+};
+
+// A thread waiting for pages to be supplied. Lookups that would need a page the
+// source has not supplied yet fail with ZX_ERR_SHOULD_WAIT; the caller then
+// queues a request with VmObject::QueuePageRequestLocked(), drops its locks,
+// waits and retries. Requests live on the waiting thread's stack.
+class PageRequest : public fbl::DoublyLinkedListable<PageRequest*> {
+public:
+    PageRequest() = default;
+    ~PageRequest();
+
+    // Wait until the page has been supplied, returning ZX_OK, or until the
+    // source goes away or the thread is killed. Does nothing if no request was
+    // queued.
+    zx_status_t Wait();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageRequest);
+
+private:
+    friend class VmObjectPaged;
+
+    // The object the request is queued on, and the range asked of its source on
+    // its behalf. Guarded by the object's lock.
+    fbl::RefPtr<VmObjectPaged> vmo_;
+    uint64_t offset_ = 0;
+    uint64_t request_offset_ = 0;
+    uint64_t request_end_ = 0;
+    zx_status_t status_ = ZX_OK;
+
+    Event event_;
+};
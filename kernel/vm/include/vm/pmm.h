@@ -28,10 +28,33 @@ typedef struct pmm_arena_info {
 // Add a pre-filled memory arena to the physical allocator.
 zx_status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 
+// Assign the memory in [base, base + size) to memory node |node|, splitting
+// arenas that straddle the edges of the range. Only valid during boot, before
+// the secondary cpus are started.
+zx_status_t pmm_set_node_range(paddr_t base, size_t size, uint node);
+
+// Record which memory node is local to |cpu|.
+void pmm_set_cpu_node(uint cpu, uint node);
+
+// Return the number of memory nodes in the system.
+uint pmm_node_count(void);
+
+// maximum number of memory nodes (NUMA proximity domains) the pmm tracks
+#define PMM_MAX_NODES 8
+
+// value for VmObject::SetNumaNode to allocate from the node of the current cpu
+#define PMM_NODE_LOCAL UINT32_MAX
+
 // flags for allocation routines below
 #define PMM_ALLOC_FLAG_ANY (0x0)  // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_KMAP (0x1) // allocate only from arenas marked KMAP
 
+// Prefer arenas on memory node |n| over the node of the current cpu. Other
+// nodes are still used once the preferred node is exhausted.
+#define PMM_ALLOC_FLAG_NODE_SHIFT 8
+#define PMM_ALLOC_FLAG_NODE_MASK (0xffu << PMM_ALLOC_FLAG_NODE_SHIFT)
+#define PMM_ALLOC_FLAG_NODE(n) ((((uint)(n)) + 1) << PMM_ALLOC_FLAG_NODE_SHIFT)
+
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
 // Returns the number of pages allocated.
@@ -40,6 +63,12 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) _
 // Allocate a single page of physical memory.
 vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa);
 
+// Same as above, but the pages are filled with zeros. Pages are taken from a
+// pool that is zeroed in the background when possible, and cleared
+// synchronously otherwise.
+size_t pmm_alloc_zeroed_pages(size_t count, uint alloc_flags, struct list_node* list) __NONNULL((3));
+vm_page_t* pmm_alloc_zeroed_page(uint alloc_flags, paddr_t* pa);
+
 // Allocate a specific range of physical pages, adding to the tail of the passed list.
 // Returns the number of pages allocated.
 size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list);
@@ -60,6 +89,20 @@ size_t pmm_free_page(vm_page_t* page) __NONNULL((1));
 // Return count of unallocated physical pages in system
 size_t pmm_count_free_pages(void);
 
+// Set the free memory watermarks, in pages, that drive page reclamation. Once
+// allocations find fewer than |low| free pages, reclamation is requested until
+// there are |high| free pages again. A |low| of 0 turns reclamation off.
+void pmm_set_reclaim_watermarks(size_t low, size_t high);
+
+// Wait until reclamation is requested or |deadline| passes. On ZX_OK |target|
+// is the number of pages that need freeing to get back to the high watermark,
+// which may be 0 if memory was freed in the meantime.
+zx_status_t pmm_wait_for_reclaim(zx_time_t deadline, size_t* target) __NONNULL((2));
+
+// Fill in the count of unallocated physical pages on each memory node.
+// Returns the number of memory nodes.
+uint pmm_count_free_pages_per_node(size_t counts[PMM_MAX_NODES]);
+
 // Return amount of physical memory in system, in bytes.
 size_t pmm_count_total_bytes(void);
 
@@ -47,6 +47,42 @@
                             VMAR_FLAG_CAN_MAP_WRITE | \
                             VMAR_FLAG_CAN_MAP_EXECUTE)
 
+// Advice about how a range of an address space will be used, see
+// VmAddressRegion::HintRange().
+enum class VmRangeHint : uint8_t {
+    // Passed on to the mapped objects as VmObject::RangeHint.
+    DontNeed,
+    WillNeed,
+    // How the mappings in the range are accessed, tunes fault around and read-ahead.
+    Normal,
+    Sequential,
+    Random,
+};
+
+// One step of VmAddressRegion::Batch().
+struct VmBatchOp {
+    enum class Type : uint8_t {
+        // Like CreateVmMapping(), with |base| as the offset into the region.
+        // On success |base| is replaced with the address of the new mapping.
+        Map,
+        // Like Unmap().
+        Unmap,
+        // Like Protect().
+        Protect,
+    };
+
+    Type type;
+    vaddr_t base;
+    size_t size;
+    uint32_t vmar_flags;
+    uint arch_mmu_flags;
+
+    // Only used by Map.
+    fbl::RefPtr<VmObject> vmo;
+    uint64_t vmo_offset;
+    const char* name;
+};
+
 class VmAspace;
 
 // forward declarations
@@ -114,8 +150,10 @@ public:
     fbl::RefPtr<VmMapping> as_vm_mapping();
 
     // Page fault in an address within the region.  Recursively traverses
-    // the regions to find the target mapping, if it exists.
-    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags) = 0;
+    // the regions to find the target mapping, if it exists.  Returns
+    // ZX_ERR_SHOULD_WAIT with |page_request| queued if the page has to come
+    // from a page source first.
+    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) = 0;
 
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
@@ -195,8 +233,23 @@ protected:
         }
     };
 
+    // keeps the subtree_* fields below up to date as the parent's list of
+    // children changes
+    struct SubregionTreeObserver : public fbl::tests::intrusive_containers::DefaultWAVLTreeObserver {
+        static void OnSubtreeChanged(VmAddressRegionOrMapping* node,
+                                     VmAddressRegionOrMapping* left,
+                                     VmAddressRegionOrMapping* right);
+    };
+
     // node for element in list of parent's children.
     fbl::WAVLTreeNodeState<fbl::RefPtr<VmAddressRegionOrMapping>, bool> subregion_list_node_;
+
+    // The span of the subtree under this node in the parent's list of
+    // children, and the largest gap between two of the regions in it.  Lets
+    // the allocators skip over subtrees with no gap large enough.
+    vaddr_t subtree_min_base_ = 0;
+    vaddr_t subtree_max_end_ = 0;
+    size_t subtree_max_gap_ = 0;
 };
 
 // A representation of a contiguous range of virtual address space
@@ -231,11 +284,25 @@ public:
     // Protect() will fail.
     virtual zx_status_t Protect(vaddr_t base, size_t size, uint new_arch_mmu_flags);
 
+    // Apply |hint| to the mappings in a subset of the region of memory in the
+    // containing address space. Access pattern hints cover the whole of every
+    // mapping the range touches. If the requested range overlaps with a
+    // subregion, HintRange() will fail.
+    virtual zx_status_t HintRange(vaddr_t base, size_t size, VmRangeHint hint);
+
+    // Run the |count| operations in |ops| in order, taking the aspace lock
+    // only once and holding back the TLB invalidations they make until the
+    // end, so that a batch of protects needs only one shootdown.  Unmaps
+    // still flush before anything they unmapped is freed.  Stops at the
+    // first operation which fails; those before it stay in effect, and
+    // |*completed| is set to how many there were.
+    virtual zx_status_t Batch(VmBatchOp* ops, size_t count, size_t* completed);
+
     const char* name() const { return name_; }
     bool is_mapping() const override { return false; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     // constructor for use in creating a VmAddressRegionDummy
@@ -254,12 +321,16 @@ protected:
     // Remove *region* from the subregion list
     void RemoveSubregion(VmAddressRegionOrMapping* region);
 
+    // Change the size of *region*, one of our subregions, keeping the gaps
+    // recorded in the subregion list up to date.
+    void ResizeSubregionLocked(VmAddressRegionOrMapping* region, size_t size);
+
     friend fbl::RefPtr<VmAddressRegion>;
 
 private:
     using ChildList = fbl::WAVLTree<vaddr_t, fbl::RefPtr<VmAddressRegionOrMapping>,
                                     fbl::DefaultKeyedObjectTraits<vaddr_t, VmAddressRegionOrMapping>,
-                                    WAVLTreeTraits>;
+                                    WAVLTreeTraits, SubregionTreeObserver>;
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmAddressRegion);
 
@@ -283,6 +354,19 @@ private:
                                       fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset,
                                       uint arch_mmu_flags, const char* name,
                                       fbl::RefPtr<VmAddressRegionOrMapping>* out);
+    // Version of CreateSubVmarInternal() that does not acquire the aspace lock
+    zx_status_t CreateSubVmarInternalLocked(size_t offset, size_t size, uint8_t align_pow2,
+                                            uint32_t vmar_flags,
+                                            fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset,
+                                            uint arch_mmu_flags, const char* name,
+                                            fbl::RefPtr<VmAddressRegionOrMapping>* out);
+
+    // Version of CreateVmMapping() that does not acquire the aspace lock
+    zx_status_t CreateVmMappingLocked(size_t mapping_offset, size_t size, uint8_t align_pow2,
+                                      uint32_t vmar_flags,
+                                      fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset,
+                                      uint arch_mmu_flags, const char* name,
+                                      fbl::RefPtr<VmMapping>* out);
 
     // Create a new VmMapping within this region, overwriting any existing
     // mappings that are in the way.  If the range crosses a subregion, the call
@@ -296,6 +380,10 @@ private:
     // the aspace lock.
     zx_status_t UnmapInternalLocked(vaddr_t base, size_t size, bool can_destroy_regions);
 
+    // Version of Protect() that does not acquire the aspace lock.  The caller
+    // is responsible for deferring and flushing the TLB invalidations.
+    zx_status_t ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags);
+
     // internal utilities for interacting with the children list
 
     // returns true if it would be valid to create a child in the
@@ -319,12 +407,16 @@ private:
     zx_status_t CompactRandomizedRegionAllocatorLocked(size_t size, uint8_t align_pow2,
                                                        uint arch_mmu_flags, vaddr_t* spot);
 
+    // Returns the size of the largest gap between (or around) the subregions.
+    size_t LargestGapLocked() const;
+
     // Utility for allocators for iterating over gaps between allocations
     // F should have a signature of bool func(vaddr_t gap_base, size_t gap_size).
     // If func returns false, the iteration stops.  gap_base will be aligned in
-    // accordance with align_pow2.
+    // accordance with align_pow2.  Gaps smaller than min_gap are not reported,
+    // and subtrees of the subregion list which have none are skipped.
     template <typename F>
-    void ForEachGap(F func, uint8_t align_pow2);
+    void ForEachGap(F func, size_t min_gap, uint8_t align_pow2);
 
     // list of subregions, indexed by base address
     ChildList subregions_;
@@ -360,6 +452,15 @@ public:
         return ZX_ERR_BAD_STATE;
     }
 
+    zx_status_t HintRange(vaddr_t base, size_t size, VmRangeHint hint) override {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    zx_status_t Batch(VmBatchOp* ops, size_t count, size_t* completed) override {
+        *completed = 0;
+        return ZX_ERR_BAD_STATE;
+    }
+
     zx_status_t Unmap(vaddr_t base, size_t size) override {
         return ZX_ERR_BAD_STATE;
     }
@@ -368,7 +469,7 @@ public:
         return;
     }
 
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override {
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override {
         // We should never be trying to page fault on this...
         ASSERT(false);
         return ZX_ERR_BAD_STATE;
@@ -414,6 +515,12 @@ public:
     // offset modification and locking.
     zx_status_t DecommitRange(size_t offset, size_t len, size_t* decommitted);
 
+    // Convenience wrappers for vmo()->TakePages() and vmo()->SupplyPages() with the
+    // necessary offset modification, locking and permission checks.  |offset| and |len|
+    // must be page aligned.
+    zx_status_t TakePages(size_t offset, size_t len, list_node* pages);
+    zx_status_t SupplyPages(size_t offset, size_t len, list_node* pages);
+
     // Map in pages from the underlying vm object, optionally committing pages as it goes
     zx_status_t MapRange(size_t offset, size_t len, bool commit);
 
@@ -432,7 +539,7 @@ public:
     bool is_mapping() const override { return true; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     ~VmMapping() override;
@@ -470,6 +577,28 @@ private:
     // Version of AllocatedPages() that does not acquire the aspace lock
     size_t AllocatedPagesLocked() const override;
 
+    // Try to resolve a fault at |va| by mapping the surrounding LARGE_PAGE_SIZE
+    // run of the object with a single large page. Called with the object lock held.
+    zx_status_t PageFaultLargeLocked(vaddr_t va, uint pf_flags, uint mmu_flags);
+
+    // After a fault at |va|, map the resident pages around it and read ahead of
+    // sequential faults. Called with the object lock held.
+    void FaultAheadLocked(vaddr_t va, uint pf_flags, uint mmu_flags);
+
+    // Map the page at |va| unless something is already mapped there. Returns
+    // true if a page was mapped.
+    bool MapSpeculativeLocked(vaddr_t va, uint pf_flags, uint mmu_flags);
+
+    // Count |count| more pages of the mapping as mapping the zero page, or stop
+    // counting those in [base, base + size) before the range is unmapped. Called
+    // with the object lock held, which Clang cannot see through the aliasing.
+    void ZeroPagesMappedLocked(size_t count) const TA_NO_THREAD_SAFETY_ANALYSIS;
+    void ForgetZeroPagesLocked(vaddr_t base, size_t size) const TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // Implementation for VmAddressRegion::HintRange(). [base, base + size) must be
+    // within the mapping. This does not acquire the aspace lock.
+    zx_status_t HintRangeLocked(vaddr_t base, size_t size, VmRangeHint hint);
+
     void Activate() override;
 
     // Version of Activate that does not take the object_ lock.
@@ -486,4 +615,12 @@ private:
 
     // used to detect recursions through the vmo fault path
     bool currently_faulting_ = false;
+
+    // sequential fault detection for read-ahead, guarded by the aspace lock
+    vaddr_t next_fault_va_ = 0;
+    uint32_t read_ahead_window_ = 0;
+
+    // how the mapping is expected to be accessed, Normal, Sequential or Random;
+    // guarded by the aspace lock
+    VmRangeHint access_hint_ = VmRangeHint::Normal;
 };
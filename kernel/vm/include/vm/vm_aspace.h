@@ -9,6 +9,7 @@
 #include <arch/aspace.h>
 #include <arch/mmu.h>
 #include <assert.h>
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
@@ -105,11 +106,41 @@ public:
         //
         // This number is strictly smaller than shared_pages * PAGE_SIZE.
         size_t scaled_shared_bytes;
+
+        // A count of pages covered by VmMapping ranges that are held
+        // compressed instead of committed, and the bytes their compressed
+        // copies take up.
+        size_t compressed_pages;
+        size_t compressed_bytes;
+
+        // A count of pages mapped to the shared zero page, for reads of
+        // never written offsets. They take up no memory of their own.
+        size_t zero_mapped_pages;
+
+        // Copied from the fault statistics below.
+        uint64_t decompress_faults;
+        zx_duration_t decompress_ns;
     };
 
     // Counts memory usage under the VmAspace.
     zx_status_t GetMemoryUsage(vm_usage_t* usage);
 
+    // Page fault counts, updated with the aspace lock held.
+    struct fault_stats_t {
+        // Faults resolved by mapping in a page.
+        uint64_t faults;
+
+        // Already resident pages mapped around a faulting page.
+        uint64_t fault_around_pages;
+
+        // Pages faulted in ahead of a run of sequential faults.
+        uint64_t read_ahead_pages;
+
+        // Faults that had to decompress a page, and the time spent on it.
+        uint64_t decompress_faults;
+        zx_duration_t decompress_ns;
+    };
+
     size_t AllocatedPages() const;
 
     // Convenience method for traversing the tree of VMARs to find the deepest
@@ -202,6 +233,17 @@ private:
     // architecturally specific part of the aspace
     ArchVmAspace arch_aspace_;
 
+    // Guarded by lock_.
+    fault_stats_t fault_stats_ = {};
+
+    // Pages mapped to the shared zero page. Updated by the mappings with
+    // only their object's lock held, so not guarded by lock_.
+    fbl::atomic<size_t> zero_mapped_pages_ = {0};
+
+    // Set while VmAddressRegion::Batch() is holding back the TLB invalidations
+    // of arch_aspace_.  Guarded by lock_.
+    bool invalidations_deferred_ = false;
+
 #if WITH_LIB_VDSO
     fbl::RefPtr<VmMapping> vdso_code_mapping_;
 #endif
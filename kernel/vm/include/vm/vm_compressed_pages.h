@@ -0,0 +1,75 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <stdint.h>
+#include <zircon/types.h>
+
+// The LZ4 compressed copies of pages an object has given back to the pmm, keyed by
+// their offset in the object. Not thread safe, the owning object's lock guards it.
+class VmCompressedPages {
+public:
+    VmCompressedPages() = default;
+    ~VmCompressedPages();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(VmCompressedPages);
+
+    // Compress the PAGE_SIZE bytes at |page| and keep them for |offset|, which must not
+    // be stored already. Fails with ZX_ERR_OUT_OF_RANGE if the page does not compress
+    // well enough to be worth keeping.
+    zx_status_t Insert(uint64_t offset, const void* page);
+
+    // Decompress the page stored for |offset| into the PAGE_SIZE bytes at |page| and drop
+    // it from the store. Fails with ZX_ERR_NOT_FOUND if there is none.
+    zx_status_t Take(uint64_t offset, void* page);
+
+    bool Contains(uint64_t offset) const { return pages_.find(offset).IsValid(); }
+
+    // Find the lowest stored offset in [start, end), returning false if there is none.
+    bool FirstInRange(uint64_t start, uint64_t end, uint64_t* offset) const;
+
+    // Count the pages stored in [start, end), and optionally their compressed size.
+    size_t CountInRange(uint64_t start, uint64_t end, size_t* bytes = nullptr) const;
+
+    // Drop the pages stored in [start, end), returning how many there were.
+    size_t RemoveRange(uint64_t start, uint64_t end);
+
+    // Hand the page stored for |offset| over to |dest|, which keeps it for |dest_offset|
+    // and must not have a page for it already.
+    void MoveTo(uint64_t offset, VmCompressedPages* dest, uint64_t dest_offset);
+
+    bool is_empty() const { return pages_.is_empty(); }
+    size_t page_count() const { return pages_.size(); }
+    // bytes of compressed data held, not counting bookkeeping
+    size_t stored_bytes() const { return stored_bytes_; }
+
+    struct Stats {
+        size_t pages;        // held by every store
+        size_t stored_bytes; // compressed size of those pages
+        uint64_t compressed;
+        uint64_t decompressed;
+        uint64_t rejected; // did not compress well enough
+    };
+    static void GetStats(Stats* stats);
+
+private:
+    struct Page : public fbl::WAVLTreeContainable<fbl::unique_ptr<Page>> {
+        uint64_t GetKey() const { return offset; }
+
+        uint64_t offset;
+        uint32_t size;
+        fbl::unique_ptr<uint8_t[]> data;
+    };
+
+    void Erase(Page* page);
+
+    fbl::WAVLTree<uint64_t, fbl::unique_ptr<Page>> pages_;
+    size_t stored_bytes_ = 0;
+};
@@ -0,0 +1,58 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <stdint.h>
+#include <vm/page.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+// The pages shared between objects by same-page merging, indexed by a hash of
+// their contents, along with the hashes of pages seen by the current scan.
+//
+// A merged page stays in the index for as long as it is merged. Nobody writes
+// to it: objects unmap it when it is merged and copy it, or take it back if
+// they are the only holder, before writing to it.
+class VmMergedPages {
+public:
+    static uint64_t Hash(const void* page);
+
+    static fbl::Mutex* lock() TA_RET_CAP(lock_) { return &lock_; }
+
+    // Find a merged page with the contents of the PAGE_SIZE bytes at |data|, whose
+    // contents hash to |hash|.
+    static vm_page_t* FindLocked(uint64_t hash, const void* data) TA_REQ(lock_);
+
+    // Note that a page hashing to |hash| was scanned, returning true if one was
+    // seen already since the last ClearSeenLocked().
+    static bool SeenLocked(uint64_t hash) TA_REQ(lock_);
+    static void ClearSeenLocked() TA_REQ(lock_);
+
+    // Make |page|, whose contents hash to |hash|, a merged page with the caller as
+    // its only holder. The caller must have unmapped it. Fails if the index has a
+    // page for |hash| already.
+    static zx_status_t AddLocked(vm_page_t* page, uint64_t hash) TA_REQ(lock_);
+
+    // Add a holder to a merged page.
+    static void HoldLocked(vm_page_t* page) TA_REQ(lock_);
+
+    // Drop a holder of a merged page. Returns true if that was the last one, in
+    // which case the page is no longer merged and is the caller's to keep or free.
+    static bool ReleaseLocked(vm_page_t* page) TA_REQ(lock_);
+
+    struct Stats {
+        size_t merged_pages; // distinct merged pages
+        size_t saved_pages;  // holders beyond the first of every merged page
+        size_t seen_hashes;
+    };
+    static void GetStatsLocked(Stats* stats) TA_REQ(lock_);
+
+private:
+    static fbl::Mutex lock_;
+};
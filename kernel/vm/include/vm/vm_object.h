@@ -24,6 +24,7 @@
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 
+class PageRequest;
 class VmMapping;
 
 typedef zx_status_t (*vmo_lookup_fn_t)(void* context, size_t offset, size_t index, paddr_t pa);
@@ -55,6 +56,15 @@ public:
         return AllocatedPagesInRange(0, size());
     }
 
+    // Returns the number of pages the object holds compressed instead of
+    // allocated where (offset <= page_offset < offset+len), and in
+    // |stored_bytes| the memory their compressed copies take up.
+    virtual size_t CompressedPagesInRange(uint64_t offset, uint64_t len,
+                                          size_t* stored_bytes) const {
+        *stored_bytes = 0;
+        return 0;
+    }
+
     // find physical pages to back the range of the object
     virtual zx_status_t CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) {
         return ZX_ERR_NOT_SUPPORTED;
@@ -71,6 +81,29 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Detach the committed pages backing the page-aligned range and append them to |pages|,
+    // leaving the range decommitted.  Fails without side effects unless every page in the
+    // range is committed, unpinned and owned outright by this object (no parent or children).
+    virtual zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Install pages removed from the head of |pages| as the backing of the page-aligned
+    // range, freeing whatever was committed there before.  Pages must be in the ALLOC state.
+    // On failure some prefix of the range may already have been supplied; the pages that
+    // remain on |pages| still belong to the caller.
+    virtual zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Queue |request| to wait for the page at |offset|, after GetPageLocked() failed with
+    // ZX_ERR_SHOULD_WAIT because the page source of the object, or of the object it was
+    // cloned from, has not supplied the page yet. Asks the source for it if nobody has yet.
+    virtual zx_status_t QueuePageRequestLocked(uint64_t offset, PageRequest* request)
+        TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // Pin the given range of the vmo.  If any pages are not committed, this
     // returns a ZX_ERR_NO_MEMORY.
     virtual zx_status_t Pin(uint64_t offset, uint64_t len) {
@@ -84,6 +117,30 @@ public:
         panic("Unpin should only be called on a pinned range");
     }
 
+    // Lock the contents of a discardable object against reclamation. Locks nest. Sets
+    // |was_discarded| if the contents were thrown away since the object was last unlocked,
+    // in which case the object now reads as zeros.
+    virtual zx_status_t LockDiscardable(bool* was_discarded) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Drop a lock taken by LockDiscardable(). Once the last one is gone the contents may be
+    // thrown away under memory pressure.
+    virtual zx_status_t UnlockDiscardable() {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    enum class RangeHint {
+        DontNeed, // the range will not be touched for a while, reclaim it first
+        WillNeed, // the range is about to be touched, bring it back in now
+    };
+
+    // Advise the object about the coming use of a range. Hints change where the contents
+    // are kept, never what they are, and objects are free to ignore them.
+    virtual zx_status_t HintRange(uint64_t offset, uint64_t len, RangeHint hint) {
+        return ZX_OK;
+    }
+
     // read/write operators against kernel pointers only
     virtual zx_status_t Read(void* ptr, uint64_t offset, size_t len, size_t* bytes_read) {
         return ZX_ERR_NOT_SUPPORTED;
@@ -156,6 +213,26 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // The memory node that pages committed to the object are preferably
+    // allocated from, or PMM_NODE_LOCAL for the node of the committing cpu.
+    virtual zx_status_t GetNumaNode(uint32_t* node) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    virtual zx_status_t SetNumaNode(const uint32_t node) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Whether pages of the object may be merged with identical pages of other
+    // mergeable objects by the background scanner.
+    virtual zx_status_t GetMergeable(bool* mergeable) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    virtual zx_status_t SetMergeable(bool mergeable) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // create a copy-on-write clone vmo at the page-aligned offset and length
     // note: it's okay to start or extend past the size of the parent
     virtual zx_status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
@@ -170,11 +247,20 @@ public:
 
     // get a pointer to the page structure and/or physical address at the specified offset.
     // valid flags are VMM_PF_FLAG_*
+    // pages taken from |free_list|, if any, must already be zero filled.
     virtual zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
                                       vm_page_t** page, paddr_t* pa) TA_REQ(lock_) {
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // get the physical address of the LARGE_PAGE_SIZE run of pages at the LARGE_PAGE_SIZE
+    // aligned |offset|, if the object backs it with naturally aligned contiguous memory that
+    // can be mapped with a single large page. faults in the run if pf_flags allows it.
+    virtual zx_status_t GetLargePageLocked(uint64_t offset, uint pf_flags, paddr_t* pa)
+        TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     fbl::Mutex* lock() TA_RET_CAP(lock_) { return &lock_; }
     fbl::Mutex& lock_ref() TA_RET_CAP(lock_) { return lock_; }
 
@@ -182,6 +268,17 @@ public:
     void RemoveMappingLocked(VmMapping* r) TA_REQ(lock_);
     uint32_t num_mappings() const;
 
+    // The number of pages across the object's mappings that map the shared zero
+    // page, standing in for offsets that have never been written. Kept up to date
+    // by the mappings, with the object lock held.
+    size_t zero_mapped_pages() const;
+    size_t zero_mapped_pages_locked() const TA_REQ(lock_) { return zero_mapped_pages_; }
+    void ZeroPagesMappedLocked(size_t count) TA_REQ(lock_) { zero_mapped_pages_ += count; }
+    void ZeroPagesUnmappedLocked(size_t count) TA_REQ(lock_) {
+        DEBUG_ASSERT(zero_mapped_pages_ >= count);
+        zero_mapped_pages_ -= count;
+    }
+
     // Returns true if this VMO is mapped into any VmAspace whose is_user()
     // returns true.
     bool IsMappedByUser() const;
@@ -194,6 +291,19 @@ public:
     void RemoveChildLocked(VmObject* r) TA_REQ(lock_);
     uint32_t num_children() const;
 
+    // Returns the object's child if it has exactly one, nullptr otherwise.
+    fbl::RefPtr<VmObject> GetOnlyChild();
+
+    // Fold the ancestors of the object that nothing but the object refers to any more into
+    // it, shortening the chain of parents its lookups walk.
+    virtual void CollapseHiddenParents() {}
+
+    // Called when the last child of the object goes away.
+    virtual void OnZeroChildrenLocked() TA_REQ(lock_) {}
+
+    // Called when set_user_id() hands the object out to userspace.
+    virtual void OnUserIdSetLocked() TA_REQ(lock_) {}
+
     // Calls the provided |func(const VmObject&)| on every VMO in the system,
     // from oldest to newest. Stops if |func| returns an error, returning the
     // error value.
@@ -255,6 +365,9 @@ protected:
     uint32_t mapping_list_len_ TA_GUARDED(lock_) = 0;
     uint32_t children_list_len_ TA_GUARDED(lock_) = 0;
 
+    // pages of mappings of the object that map the zero page
+    size_t zero_mapped_pages_ TA_GUARDED(lock_) = 0;
+
     uint64_t user_id_ TA_GUARDED(lock_) = 0;
 
     // The user-friendly VMO name. For debug purposes only. That
@@ -8,17 +8,22 @@
 
 #include <assert.h>
 #include <fbl/array.h>
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <kernel/mutex.h>
 #include <lib/user_copy/user_ptr.h>
 #include <list.h>
 #include <stdint.h>
+#include <vm/page_source.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
+#include <vm/vm_compressed_pages.h>
+#include <vm/vm_merged_pages.h>
 #include <vm/vm_object.h>
 #include <vm/vm_page_list.h>
 #include <zircon/thread_annotations.h>
@@ -27,10 +32,24 @@
 // the main VM object type, holding a list of pages
 class VmObjectPaged final : public VmObject {
 public:
+    // Create options
+    // Back the object with naturally aligned LARGE_PAGE_SIZE runs of pages where possible.
+    static constexpr uint32_t kLargePages = (1u << 0);
+    // Allow the contents to be thrown away under memory pressure while the object is unlocked.
+    // See LockDiscardable().
+    static constexpr uint32_t kDiscardable = (1u << 1);
+
     static zx_status_t Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* vmo);
+    static zx_status_t Create(uint32_t pmm_alloc_flags, uint32_t options, uint64_t size,
+                              fbl::RefPtr<VmObject>* vmo);
 
     static zx_status_t CreateFromROData(const void* data, size_t size, fbl::RefPtr<VmObject>* vmo);
 
+    // Create an object whose pages are provided on demand by |source|. Lookups of pages it
+    // has not supplied yet fail with ZX_ERR_SHOULD_WAIT, see PageRequest.
+    static zx_status_t CreateExternal(fbl::RefPtr<PageSource> source, uint64_t size,
+                                      fbl::RefPtr<VmObjectPaged>* vmo);
+
     zx_status_t Resize(uint64_t size) override;
     zx_status_t ResizeLocked(uint64_t size) override TA_REQ(lock_);
     uint64_t size() const override
@@ -40,15 +59,42 @@ public:
     bool is_paged() const override { return true; }
 
     size_t AllocatedPagesInRange(uint64_t offset, uint64_t len) const override;
+    size_t CompressedPagesInRange(uint64_t offset, uint64_t len,
+                                  size_t* stored_bytes) const override;
 
     zx_status_t CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) override;
     zx_status_t CommitRangeContiguous(uint64_t offset, uint64_t len, uint64_t* committed,
                                       uint8_t alignment_log2) override;
     zx_status_t DecommitRange(uint64_t offset, uint64_t len, uint64_t* decommitted) override;
 
+    zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) override;
+    zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages) override;
+
+    zx_status_t QueuePageRequestLocked(uint64_t offset, PageRequest* request) override
+        // Calls a Locked method of the parent, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // Move pages from the head of |pages| into the page-aligned range of an object created with
+    // CreateExternal(), keeping any page that is already present, and wake the threads waiting
+    // for them. Pages must be in the ALLOC state. All of |pages| is consumed, pages that are not
+    // used are freed.
+    zx_status_t SupplyPagerPages(uint64_t offset, uint64_t len, list_node* pages);
+
+    // Cut the object off from its page source. Waiting threads are woken with ZX_ERR_BAD_STATE
+    // and lookups of pages that were never supplied fail with ZX_ERR_BAD_STATE from now on.
+    void DetachSource();
+
+    void OnZeroChildrenLocked() override TA_REQ(lock_);
+    void CollapseHiddenParents() override;
+    void OnUserIdSetLocked() override TA_REQ(lock_);
+
     zx_status_t Pin(uint64_t offset, uint64_t len) override;
     void Unpin(uint64_t offset, uint64_t len) override;
 
+    zx_status_t LockDiscardable(bool* was_discarded) override;
+    zx_status_t UnlockDiscardable() override;
+    zx_status_t HintRange(uint64_t offset, uint64_t len, RangeHint hint) override;
+
     zx_status_t Read(void* ptr, uint64_t offset, size_t len, size_t* bytes_read) override;
     zx_status_t Write(const void* ptr, uint64_t offset, size_t len, size_t* bytes_written) override;
     zx_status_t Lookup(uint64_t offset, uint64_t len, uint pf_flags,
@@ -69,11 +115,20 @@ public:
     zx_status_t CleanInvalidateCache(const uint64_t offset, const uint64_t len) override;
     zx_status_t SyncCache(const uint64_t offset, const uint64_t len) override;
 
+    zx_status_t GetNumaNode(uint32_t* node) override;
+    zx_status_t SetNumaNode(const uint32_t node) override;
+
+    zx_status_t GetMergeable(bool* mergeable) override;
+    zx_status_t SetMergeable(bool mergeable) override;
+
     zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
                               vm_page_t**, paddr_t*) override
         // Calls a Locked method of the parent, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    zx_status_t GetLargePageLocked(uint64_t offset, uint pf_flags, paddr_t* pa) override
+        TA_REQ(lock_);
+
     zx_status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
                          fbl::RefPtr<VmObject>* clone_vmo) override
         // Calls a Locked method of the child, which confuses analysis.
@@ -86,9 +141,48 @@ public:
     // maximum size of a VMO is one page less than the full 64bit range
     static const uint64_t MAX_SIZE = ROUNDDOWN(UINT64_MAX, PAGE_SIZE);
 
+    // most parents a clone may have above it, every one of them is a level of recursion on
+    // lookups of pages the clone does not have itself
+    static constexpr uint32_t kMaxCloneDepth = 32;
+
+    // Unlocked discardable objects sit on an active and an inactive reclaim list, oldest
+    // unlock first. Aging moves objects that have been unlocked for at least |min_age| and
+    // not touched in the meantime from the active to the inactive list; touched ones get
+    // another trip around the active list.
+    static void AgeDiscardable(zx_duration_t min_age);
+
+    // Throw away the contents of unlocked discardable objects, inactive ones first and then
+    // the oldest active ones, until at least |target| pages have been freed or there is
+    // nothing left to reclaim. Returns the number of pages freed.
+    static size_t ReclaimDiscardable(size_t target);
+
+    // Anonymous objects handed out to userspace age on a second pair of lists the same way,
+    // on every lookup rather than on unlock. Compress the pages of inactive ones until at
+    // least |target| pages have been freed or every inactive object has been tried, moving
+    // them back to the active list. Returns the number of pages freed.
+    static size_t CompressInactive(size_t target);
+
+    // Look at up to |max_pages| pages of mergeable objects, carrying on from where the last
+    // scan stopped, and merge the ones identical to a page seen earlier into a single shared
+    // page. Returns the number of pages given back to the pmm.
+    static size_t ScanMergeable(size_t max_pages);
+
+    struct ReclaimStats {
+        size_t reclaimable_pages; // committed to unlocked objects when they were unlocked
+        size_t active_objects;
+        size_t inactive_objects;
+        uint64_t reclaimed_pages;
+        uint64_t reclaimed_objects;
+        size_t compress_active_objects;
+        size_t compress_inactive_objects;
+        uint64_t compressed_pages_freed;
+    };
+    static void GetReclaimStats(ReclaimStats* stats);
+
 private:
     // private constructor (use Create())
-    explicit VmObjectPaged(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject> parent);
+    explicit VmObjectPaged(uint32_t pmm_alloc_flags, uint32_t options, uint64_t size,
+                           fbl::RefPtr<VmObject> parent);
 
     // private destructor, only called from refptr
     ~VmObjectPaged() override;
@@ -110,6 +204,9 @@ private:
     // internal page list routine
     void AddPageToArray(size_t index, vm_page_t* p);
 
+    // commit the empty LARGE_PAGE_SIZE run at |offset| with a contiguous, aligned run of pages
+    zx_status_t CommitLargePageLocked(uint64_t offset) TA_REQ(lock_);
+
     zx_status_t PinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
     void UnpinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
 
@@ -124,11 +221,151 @@ private:
     // set our offset within our parent
     zx_status_t SetParentOffsetLocked(uint64_t o) TA_REQ(lock_);
 
+    // If the parent of the object is hidden, referred to by nothing but the object, and has a
+    // parent of its own, move the parent's pages the object can see into the object, free the
+    // rest and make the grandparent the object's parent. The former parent is handed back in
+    // |hidden| so it can be released once the lock is dropped.
+    bool CollapseParentLocked(fbl::RefPtr<VmObject>* hidden)
+        // Touches the parent's state, under the lock the whole chain shares, which confuses
+        // analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // take a request whose wait was cut short off the object
+    friend class PageRequest;
+    void CancelPageRequest(PageRequest* request);
+
+    // wait for the page source to supply the page at |offset|, dropping the lock meanwhile
+    zx_status_t WaitForPageLocked(uint64_t offset) TA_REQ(lock_);
+
+    // the most pages asked of the page source at once
+    static constexpr uint64_t kPageRequestPages = 16;
+
+    // put the object on the tail of the active reclaim list, or take it off whichever list
+    // it is on
+    void AddToReclaimListLocked() TA_REQ(lock_);
+    void RemoveFromReclaimList();
+
+    // throw away every page of the object if it is still unlocked and nothing is pinned,
+    // returning how many pages were freed
+    size_t DiscardLocked() TA_REQ(lock_);
+
+    // whether the pages of the object may be compressed: anonymous memory handed out to
+    // userspace and only mapped into user address spaces
+    bool CompressibleLocked() const TA_REQ(lock_);
+
+    // put the object on the tail of the active compression list
+    void AddToCompressListLocked() TA_REQ(lock_);
+
+    // move the object to the head of the inactive list it ages on, so reclaim gets to it
+    // before anything else
+    void DeactivateLocked() TA_REQ(lock_);
+
+    // compress the unpinned pages of the object, returning how many pages were freed
+    size_t CompressLocked() TA_REQ(lock_) { return CompressRangeLocked(0, size_); }
+
+    // compress the unpinned pages in [start, end), returning how many pages were freed
+    size_t CompressRangeLocked(uint64_t start, uint64_t end) TA_REQ(lock_);
+
+    // move the compressed page at |offset| back into the page list, taking the page from
+    // |free_list| if it has one. ZX_ERR_NOT_FOUND if there is no such page.
+    zx_status_t DecompressPageLocked(uint64_t offset, list_node* free_list,
+                                     vm_page_t** page_out, paddr_t* pa_out) TA_REQ(lock_);
+
+    // decompress every compressed page in [offset, offset + len)
+    zx_status_t DecompressRangeLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
+
+    // merge pages of the object from the scan cursor on, counting every page looked at
+    // against |budget| and stopping when it runs out. Returns the number of pages freed.
+    size_t MergeLocked(size_t* budget) TA_REQ(lock_);
+
+    // make the merged page |p| at |offset| private to the object so it can be written to,
+    // copying it into a page from |free_list| if it has one when others still hold it
+    zx_status_t UnmergePageLocked(uint64_t offset, vm_page_t* p, list_node* free_list,
+                                  vm_page_t** page_out) TA_REQ(lock_);
+
+    // unmerge every merged page in [offset, offset + len)
+    zx_status_t UnmergeRangeLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
+
+    // drop the object's hold on the merged pages in [start, end), taking them out of the
+    // page list, before the rest of the range is freed. Returns how many there were.
+    size_t ReleaseMergedPagesLocked(uint64_t start, uint64_t end) TA_REQ(lock_);
+
     // members
     uint64_t size_ TA_GUARDED(lock_) = 0;
     uint64_t parent_offset_ TA_GUARDED(lock_) = 0;
+    // offsets at and beyond this are never looked up in the parent, set when a hidden parent
+    // whose pages did not reach that far is collapsed
+    uint64_t parent_limit_ TA_GUARDED(lock_) = UINT64_MAX;
     uint32_t pmm_alloc_flags_ TA_GUARDED(lock_) = PMM_ALLOC_FLAG_ANY;
+    const uint32_t options_;
 
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
+
+    // pages given back to the pmm after being compressed, none of which are in page_list_
+    VmCompressedPages compressed_ TA_GUARDED(lock_);
+
+    // where pages come from when the object has an external source, and the threads waiting
+    // for pages from it
+    fbl::RefPtr<PageSource> page_source_ TA_GUARDED(lock_);
+    bool page_source_detached_ TA_GUARDED(lock_) = false;
+    uint64_t children_created_ TA_GUARDED(lock_) = 0;
+    fbl::DoublyLinkedList<PageRequest*> page_requests_ TA_GUARDED(lock_);
+
+    // discardable object state
+    uint32_t discard_lock_count_ TA_GUARDED(lock_) = 0;
+    bool discarded_ TA_GUARDED(lock_) = false;
+    // set when a page is looked up while the object is on a reclaim or compression list,
+    // read by aging without the object lock
+    fbl::atomic<bool> reclaim_referenced_ = {false};
+
+    enum class ReclaimQueue : uint8_t {
+        None,
+        Active,
+        Inactive,
+        CompressActive,
+        CompressInactive,
+    };
+    using ReclaimNodeState = fbl::DoublyLinkedListNodeState<VmObjectPaged*>;
+    struct ReclaimListTraits {
+        static ReclaimNodeState& node_state(VmObjectPaged& vmo) {
+            return vmo.reclaim_list_state_;
+        }
+    };
+    using ReclaimList = fbl::DoublyLinkedList<VmObjectPaged*, ReclaimListTraits>;
+
+    // Taken after the object lock, never before it.
+    static fbl::Mutex reclaim_lock_;
+    static ReclaimList reclaim_active_ TA_GUARDED(reclaim_lock_);
+    static ReclaimList reclaim_inactive_ TA_GUARDED(reclaim_lock_);
+    static ReclaimList compress_active_ TA_GUARDED(reclaim_lock_);
+    static ReclaimList compress_inactive_ TA_GUARDED(reclaim_lock_);
+    static ReclaimStats reclaim_stats_ TA_GUARDED(reclaim_lock_);
+
+    ReclaimNodeState reclaim_list_state_ TA_GUARDED(reclaim_lock_);
+    ReclaimQueue reclaim_queue_ TA_GUARDED(reclaim_lock_) = ReclaimQueue::None;
+    zx_time_t reclaim_time_ TA_GUARDED(reclaim_lock_) = 0;
+    size_t reclaim_pages_ TA_GUARDED(reclaim_lock_) = 0;
+
+    // same-page merging state. |has_merged_pages_| is set once any page of the object has been
+    // merged and never cleared, it only saves looking for merged pages in objects without any.
+    bool mergeable_ TA_GUARDED(lock_) = false;
+    bool has_merged_pages_ TA_GUARDED(lock_) = false;
+    uint64_t merge_scan_offset_ TA_GUARDED(lock_) = 0;
+
+    struct MergeListTraits {
+        static ReclaimNodeState& node_state(VmObjectPaged& vmo) {
+            return vmo.merge_list_state_;
+        }
+    };
+    using MergeList = fbl::DoublyLinkedList<VmObjectPaged*, MergeListTraits>;
+
+    // Mergeable objects in scan order, guarded by the VmMergedPages lock, which is taken after
+    // the object lock. The hashes of pages seen are forgotten once every object on the list has
+    // been scanned, |merge_round_left_| more objects from now.
+    static MergeList merge_list_ TA_GUARDED(VmMergedPages::lock());
+    static size_t merge_objects_ TA_GUARDED(VmMergedPages::lock());
+    static size_t merge_round_left_ TA_GUARDED(VmMergedPages::lock());
+
+    ReclaimNodeState merge_list_state_ TA_GUARDED(VmMergedPages::lock());
 };
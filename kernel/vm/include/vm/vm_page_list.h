@@ -7,23 +7,33 @@
 #pragma once
 
 #include <err.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
 #include <fbl/unique_ptr.h>
+#include <kernel/align.h>
+#include <list.h>
 #include <vm/vm.h>
 #include <zircon/types.h>
 
 struct vm_page;
 
-class VmPageListNode final : public fbl::WAVLTreeContainable<fbl::unique_ptr<VmPageListNode>> {
+// Nodes are cache line aligned, and hold enough pages that multi-GB objects
+// keep the tree shallow.
+class __CPU_ALIGN VmPageListNode final
+    : public fbl::WAVLTreeContainable<fbl::unique_ptr<VmPageListNode>> {
 public:
     explicit VmPageListNode(uint64_t offset);
     ~VmPageListNode();
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmPageListNode);
 
-    static const size_t kPageFanOut = 16;
+    // the heap does not honor the class alignment on its own
+    static void* operator new(size_t size, fbl::AllocChecker* ac) noexcept;
+    static void operator delete(void* ptr);
+
+    static const size_t kPageFanOut = 64;
 
     // accessors
     uint64_t offset() const { return obj_offset_; }
@@ -85,17 +95,18 @@ public:
     vm_page* RemovePage(size_t index);
     zx_status_t AddPage(vm_page* p, size_t index);
 
-    bool IsEmpty() const {
-        for (const auto p : pages_) {
-            if (p)
-                return false;
-        }
-        return true;
-    }
+    // detach every page in [start_offset, end_offset) onto |pages|, returning
+    // how many there were
+    size_t RemovePages(uint64_t start_offset, uint64_t end_offset, list_node* pages);
+
+    // only tracks pages added and removed through the methods above, not ones
+    // cleared through a ForEveryPage() reference
+    bool IsEmpty() const { return num_pages_ == 0; }
 
 private:
     fbl::Canary<fbl::magic("PLST")> canary_;
 
+    uint32_t num_pages_ = 0;
     uint64_t obj_offset_ = 0;
     vm_page* pages_[kPageFanOut] = {};
 };
@@ -189,9 +200,22 @@ public:
 
     zx_status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
+    // detach the page at |offset| from the list without freeing it
+    vm_page* RemovePage(uint64_t offset);
+    // detach every page in [start_offset, end_offset) onto |pages| without
+    // freeing them, returning how many there were
+    size_t RemovePages(uint64_t start_offset, uint64_t end_offset, list_node* pages);
     zx_status_t FreePage(uint64_t offset);
     size_t FreeAllPages();
 
 private:
+    // find the node starting at |node_offset|, trying the last one found first
+    VmPageListNode* FindNode(uint64_t node_offset);
+    void EraseNode(VmPageListNode* node);
+
     fbl::WAVLTree<uint64_t, fbl::unique_ptr<VmPageListNode>> list_;
+
+    // lookups tend to walk an object in order, so most hit the same node as
+    // the one before them
+    VmPageListNode* last_node_ = nullptr;
 };
@@ -10,9 +10,13 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/event.h>
 #include <kernel/mp.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <lk/init.h>
 #include <platform.h>
 #include <pow2.h>
@@ -26,6 +30,7 @@
 #include "pmm_arena.h"
 #include "vm_priv.h"
 
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -42,6 +47,102 @@ static fbl::Mutex arena_lock;
 static fbl::DoublyLinkedList<PmmArena*> arena_list TA_GUARDED(arena_lock);
 static size_t arena_cumulative_size TA_GUARDED(arena_lock);
 
+// Per-cpu caches of free pages taken from KMAP arenas on the cpu's memory node. Single page and small
+// multi page allocations and frees are served out of the local cache under a
+// per-cpu spinlock, and the cache is refilled from or drained to the arenas
+// PMM_CACHE_BATCH pages at a time, so the global arena lock is taken once per
+// batch rather than once per page. Cached pages are kept in the ALLOC state so
+// the arenas never hand them out from underneath the cache.
+#define PMM_CACHE_BATCH 32
+#define PMM_CACHE_MAX (PMM_CACHE_BATCH * 2)
+
+namespace {
+
+struct PmmCache {
+    spin_lock_t lock;
+    list_node free_list;
+    size_t count;
+
+    // statistics
+    uint64_t alloc_hits;   // pages allocated out of the cache
+    uint64_t alloc_misses; // pages requested while the cache was empty
+    uint64_t free_hits;    // pages freed into the cache
+    uint64_t free_misses;  // pages freed while the cache was full or from other arenas
+    uint64_t refills;
+    uint64_t drains;
+};
+
+} // namespace
+
+static PmmCache pmm_cache[SMP_MAX_CPUS];
+static bool pmm_cache_enabled;
+
+// Memory node layout. Set up during boot and read without locking afterwards.
+static uint pmm_num_nodes = 1;
+static uint8_t pmm_cpu_node[SMP_MAX_CPUS];
+
+// Per-node pools of pages that are known to contain zeros. A low priority
+// thread tops the pools up to PMM_ZERO_POOL_TARGET pages, zeroing pages while
+// the cpus would otherwise be idle, so that committing a page to a VMO does not
+// have to clear it while holding the VMO lock. The thread is woken once a pool
+// drops below PMM_ZERO_POOL_LOW and stops refilling while free memory is below
+// PMM_ZERO_POOL_RESERVE pages. Pooled pages are kept in the ALLOC state, like
+// cached pages.
+#define PMM_ZERO_POOL_TARGET 256
+#define PMM_ZERO_POOL_LOW (PMM_ZERO_POOL_TARGET / 2)
+#define PMM_ZERO_POOL_RESERVE (PMM_ZERO_POOL_TARGET * 16)
+
+namespace {
+
+struct PmmZeroPool {
+    spin_lock_t lock;
+    list_node free_list;
+    size_t count;
+};
+
+} // namespace
+
+static PmmZeroPool pmm_zero_pool[PMM_MAX_NODES];
+static bool pmm_zero_pool_enabled;
+static event_t pmm_zero_pool_event =
+    EVENT_INITIAL_VALUE(pmm_zero_pool_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+KCOUNTER(zero_pool_depth, "kernel.pmm.zero_pool.depth");
+KCOUNTER(zero_pool_hits, "kernel.pmm.zero_pool.hit");
+KCOUNTER(zero_pool_misses, "kernel.pmm.zero_pool.miss");
+KCOUNTER(zero_pool_zeroed, "kernel.pmm.zero_pool.zeroed");
+
+// Free memory watermarks for page reclamation, in pages. When an allocation that
+// reaches the arenas finds free memory below the low watermark it wakes the
+// reclaim thread, which frees memory until it is back above the high watermark.
+// A low watermark of 0 leaves reclamation off.
+static size_t pmm_reclaim_low;
+static size_t pmm_reclaim_high;
+static event_t pmm_reclaim_event =
+    EVENT_INITIAL_VALUE(pmm_reclaim_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+KCOUNTER(reclaim_requests, "kernel.pmm.reclaim.request");
+
+static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock);
+
+static void pmm_check_reclaim_locked() TA_REQ(arena_lock) {
+    if (pmm_reclaim_low == 0 || event_signaled(&pmm_reclaim_event))
+        return;
+    if (pmm_count_free_pages_locked() < pmm_reclaim_low) {
+        kcounter_add(reclaim_requests, 1u);
+        event_signal(&pmm_reclaim_event, false);
+    }
+}
+
+static void pmm_cache_init(uint level) {
+    for (auto& c : pmm_cache) {
+        c.lock = SPIN_LOCK_INITIAL_VALUE;
+        list_initialize(&c.free_list);
+    }
+    pmm_cache_enabled = true;
+}
+LK_INIT_HOOK(pmm_cache, &pmm_cache_init, LK_INIT_LEVEL_VM);
+
 #if PMM_ENABLE_FREE_FILL
 static void pmm_enforce_fill(uint level) {
     for (auto& a : arena_list) {
@@ -75,6 +176,15 @@ vm_page_t* paddr_to_vm_page(paddr_t addr) TA_NO_THREAD_SAFETY_ANALYSIS {
     return nullptr;
 }
 
+// Same as above, the arena list does not change after boot.
+static const PmmArena* pmm_page_arena(const vm_page_t* page) TA_NO_THREAD_SAFETY_ANALYSIS {
+    for (const auto& a : arena_list) {
+        if (a.page_belongs_to_arena(page))
+            return &a;
+    }
+    return nullptr;
+}
+
 // We disable thread safety analysis here, since this function is only called
 // during early boot before threading exists.
 zx_status_t pmm_add_arena(const pmm_arena_info_t* info) TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -119,25 +229,441 @@ done_add:
     return ZX_OK;
 }
 
-vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+// Split |arena| at |pa|, placing the upper part right after it in the arena list.
+static zx_status_t pmm_split_arena(PmmArena& arena, paddr_t pa) TA_REQ(arena_lock) {
+    fbl::AllocChecker ac;
+    PmmArena* upper = new (&ac) PmmArena();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    arena.Split(pa, upper);
+    arena_list.insert_after(arena_list.make_iterator(arena), upper);
+
+    return ZX_OK;
+}
+
+zx_status_t pmm_set_node_range(paddr_t base, size_t size, uint node) {
+    LTRACEF("base %#" PRIxPTR ", size %#zx, node %u\n", base, size, node);
+
+    if (node >= PMM_MAX_NODES)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    base = ROUNDUP(base, PAGE_SIZE);
+    size = ROUNDDOWN(size, PAGE_SIZE);
+    paddr_t end = base + size;
+    if (size == 0 || end < base)
+        return ZX_ERR_INVALID_ARGS;
+
     AutoLock al(&arena_lock);
 
-    /* walk the arenas in order until we find one with a free page */
-    for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+    for (auto iter = arena_list.begin(); iter != arena_list.end(); ++iter) {
+        paddr_t arena_end = iter->base() + iter->size();
+        if (arena_end <= base || iter->base() >= end)
+            continue;
+
+        /* split off the part below the range and move on to the part inside it */
+        if (iter->base() < base) {
+            zx_status_t status = pmm_split_arena(*iter, base);
+            if (status != ZX_OK)
+                return status;
+            ++iter;
+        }
+
+        /* split off the part above the range, it is visited next and skipped */
+        if (iter->base() + iter->size() > end) {
+            zx_status_t status = pmm_split_arena(*iter, end);
+            if (status != ZX_OK)
+                return status;
+        }
+
+        iter->set_node(node);
+    }
+
+    pmm_num_nodes = MAX(pmm_num_nodes, node + 1);
+
+    return ZX_OK;
+}
+
+void pmm_set_cpu_node(uint cpu, uint node) {
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+    DEBUG_ASSERT(node < PMM_MAX_NODES);
+
+    pmm_cpu_node[cpu] = static_cast<uint8_t>(node);
+}
+
+uint pmm_node_count() {
+    return pmm_num_nodes;
+}
+
+// Pick the memory node an allocation should come from: the one asked for in
+// |alloc_flags|, or else the node local to the current cpu.
+static uint pmm_alloc_node(uint alloc_flags) {
+    uint flag_node = (alloc_flags & PMM_ALLOC_FLAG_NODE_MASK) >> PMM_ALLOC_FLAG_NODE_SHIFT;
+    if (flag_node != 0 && flag_node <= pmm_num_nodes)
+        return flag_node - 1;
+    return pmm_cpu_node[arch_curr_cpu_num()];
+}
+
+// Call |func| on every arena usable for |alloc_flags| in priority order, visiting
+// the arenas on the preferred node before those on other nodes. Stops early
+// once |func| returns true.
+template <typename F>
+static void pmm_for_each_arena(uint alloc_flags, F func) TA_REQ(arena_lock) {
+    uint node = pmm_alloc_node(alloc_flags);
+    int passes = (pmm_num_nodes > 1) ? 2 : 1;
+
+    for (int pass = 0; pass < passes; pass++) {
+        for (auto& a : arena_list) {
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
+
+            /* local arenas on the first pass, everything else on the second */
+            if (passes > 1 && (a.node() == node) != (pass == 0))
                 continue;
+
+            if (func(a))
+                return;
         }
+    }
+}
 
+static vm_page_t* pmm_alloc_page_locked(uint alloc_flags, paddr_t* pa) TA_REQ(arena_lock) {
+    /* walk the arenas in order until we find one with a free page */
+    vm_page_t* page = nullptr;
+    pmm_for_each_arena(alloc_flags, [&](PmmArena& a) {
         // try to allocate the page out of the arena
-        vm_page_t* page = a.AllocPage(pa);
-        if (page)
-            return page;
+        page = a.AllocPage(pa);
+        return page != nullptr;
+    });
+
+    return page;
+}
+
+static size_t pmm_alloc_pages_locked(size_t count, uint alloc_flags, struct list_node* list)
+    TA_REQ(arena_lock) {
+    /* walk the arenas in order, allocating as many pages as we can from each */
+    size_t allocated = 0;
+    pmm_for_each_arena(alloc_flags, [&](PmmArena& a) {
+        DEBUG_ASSERT(count > allocated);
+
+        // ask the arena to allocate some pages
+        allocated += a.AllocPages(count - allocated, list);
+        DEBUG_ASSERT(allocated <= count);
+        return allocated == count;
+    });
+
+    return allocated;
+}
+
+static size_t pmm_free_locked(struct list_node* list) TA_REQ(arena_lock) {
+    size_t count = 0;
+    while (!list_is_empty(list)) {
+        vm_page_t* page = list_remove_head_type(list, vm_page_t, free.node);
+
+        DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
+
+        /* see which arena this page belongs to and add it */
+        for (auto& a : arena_list) {
+            if (a.FreePage(page) >= 0) {
+                count++;
+                break;
+            }
+        }
     }
 
-    LTRACEF("failed to allocate page\n");
-    return nullptr;
+    return count;
+}
+
+// Take up to |count| pages out of the local cache, refilling it from the
+// arenas first if it is empty and the request would fit in a batch.
+static size_t pmm_cache_alloc(size_t count, uint alloc_flags, struct list_node* list)
+    TA_EXCL(arena_lock) {
+    if (!pmm_cache_enabled)
+        return 0;
+
+    // It does not matter if we migrate after picking the cache, it is only
+    // used as a hint for locality and is protected by its own lock.
+    cpu_num_t cpu = arch_curr_cpu_num();
+    PmmCache* c = &pmm_cache[cpu];
+
+    // the cache only holds pages local to its cpu
+    if (pmm_alloc_node(alloc_flags) != pmm_cpu_node[cpu])
+        return 0;
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&c->lock, state);
+
+    if (c->count == 0 && count <= PMM_CACHE_BATCH) {
+        spin_unlock_irqrestore(&c->lock, state);
+
+        struct list_node batch = LIST_INITIAL_VALUE(batch);
+        size_t refilled;
+        {
+            AutoLock al(&arena_lock);
+            refilled = pmm_alloc_pages_locked(PMM_CACHE_BATCH, PMM_ALLOC_FLAG_KMAP, &batch);
+            pmm_check_reclaim_locked();
+        }
+
+        spin_lock_irqsave(&c->lock, state);
+
+        if (refilled > 0) {
+            struct list_node* node;
+            while ((node = list_remove_head(&batch)) != nullptr)
+                list_add_tail(&c->free_list, node);
+            c->count += refilled;
+            c->refills++;
+        }
+    }
+
+    size_t allocated = 0;
+    while (allocated < count && c->count > 0) {
+        list_add_tail(list, list_remove_head(&c->free_list));
+        c->count--;
+        allocated++;
+    }
+
+    c->alloc_hits += allocated;
+    c->alloc_misses += count - allocated;
+
+    spin_unlock_irqrestore(&c->lock, state);
+
+    return allocated;
+}
+
+// Move pages from |list| into the local cache. Pages that do not fit, or that
+// come from arenas the cache does not hold, are left on |list|. When the cache
+// fills up a batch of its coldest pages is moved to |drain| so the caller can
+// return them to the arenas along with the rest.
+static size_t pmm_cache_free(struct list_node* list, struct list_node* drain) {
+    if (!pmm_cache_enabled)
+        return 0;
+
+    cpu_num_t cpu = arch_curr_cpu_num();
+    PmmCache* c = &pmm_cache[cpu];
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&c->lock, state);
+
+    size_t freed = 0;
+    bool drained = false;
+    vm_page_t* page;
+    vm_page_t* temp;
+    list_for_every_entry_safe (list, page, temp, vm_page_t, free.node) {
+        DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
+        DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
+
+        const PmmArena* arena = pmm_page_arena(page);
+        if (!arena || !(arena->flags() & PMM_ARENA_FLAG_KMAP) ||
+            arena->node() != pmm_cpu_node[cpu]) {
+            c->free_misses++;
+            continue;
+        }
+
+        if (c->count >= PMM_CACHE_MAX) {
+            // Only drain once per call, a large free mostly goes straight back
+            // to the arenas.
+            if (drained) {
+                c->free_misses++;
+                continue;
+            }
+            for (size_t i = 0; i < PMM_CACHE_BATCH; i++)
+                list_add_tail(drain, list_remove_tail(&c->free_list));
+            c->count -= PMM_CACHE_BATCH;
+            c->drains++;
+            drained = true;
+        }
+
+        list_delete(&page->free.node);
+        page->state = VM_PAGE_STATE_ALLOC;
+        list_add_head(&c->free_list, &page->free.node);
+        c->count++;
+        c->free_hits++;
+        freed++;
+    }
+
+    spin_unlock_irqrestore(&c->lock, state);
+
+    return freed;
+}
+
+// Return every cached page to the arenas, used when an allocation could not be
+// satisfied and the pages might be sitting in another cpu's cache.
+static size_t pmm_cache_drain_all_locked() TA_REQ(arena_lock) {
+    if (!pmm_cache_enabled)
+        return 0;
+
+    struct list_node drain = LIST_INITIAL_VALUE(drain);
+    for (auto& c : pmm_cache) {
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&c.lock, state);
+
+        if (c.count > 0) {
+            struct list_node* node;
+            while ((node = list_remove_head(&c.free_list)) != nullptr)
+                list_add_tail(&drain, node);
+            c.count = 0;
+            c.drains++;
+        }
+
+        spin_unlock_irqrestore(&c.lock, state);
+    }
+
+    return pmm_free_locked(&drain);
+}
+
+// Take up to |count| pre-zeroed pages out of the pool of |node|.
+static size_t pmm_zero_pool_alloc(uint node, size_t count, struct list_node* list) {
+    PmmZeroPool& z = pmm_zero_pool[node];
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&z.lock, state);
+
+    size_t allocated = 0;
+    while (allocated < count && z.count > 0) {
+        list_add_tail(list, list_remove_head(&z.free_list));
+        z.count--;
+        allocated++;
+    }
+    bool low = z.count < PMM_ZERO_POOL_LOW;
+
+    spin_unlock_irqrestore(&z.lock, state);
+
+    if (allocated > 0)
+        kcounter_add(zero_pool_depth, -static_cast<uint64_t>(allocated));
+    if (low)
+        event_signal(&pmm_zero_pool_event, false);
+
+    return allocated;
+}
+
+// Return every pre-zeroed page to the arenas, for the same reason as above.
+static size_t pmm_zero_pool_drain_all_locked() TA_REQ(arena_lock) {
+    if (!pmm_zero_pool_enabled)
+        return 0;
+
+    struct list_node drain = LIST_INITIAL_VALUE(drain);
+    size_t drained = 0;
+    for (auto& z : pmm_zero_pool) {
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&z.lock, state);
+
+        struct list_node* node;
+        while ((node = list_remove_head(&z.free_list)) != nullptr)
+            list_add_tail(&drain, node);
+        drained += z.count;
+        z.count = 0;
+
+        spin_unlock_irqrestore(&z.lock, state);
+    }
+
+    if (drained > 0)
+        kcounter_add(zero_pool_depth, -static_cast<uint64_t>(drained));
+
+    return pmm_free_locked(&drain);
+}
+
+// Hand every page sitting in a cache or pool back to the arenas.
+static size_t pmm_drain_all_locked() TA_REQ(arena_lock) {
+    size_t drained = pmm_cache_drain_all_locked();
+    drained += pmm_zero_pool_drain_all_locked();
+    return drained;
+}
+
+static size_t pmm_count_zero_pool_pages() {
+    size_t pooled = 0u;
+    for (const auto& z : pmm_zero_pool) {
+        pooled += z.count;
+    }
+    return pooled;
+}
+
+// Top up the pool of |node|. Returns false if it stopped early because memory
+// is short.
+static bool pmm_zero_pool_fill(uint node) {
+    PmmZeroPool& z = pmm_zero_pool[node];
+
+    while (z.count < PMM_ZERO_POOL_TARGET) {
+        if (pmm_count_free_pages() < PMM_ZERO_POOL_RESERVE)
+            return false;
+
+        paddr_t pa;
+        vm_page_t* page = pmm_alloc_page(PMM_ALLOC_FLAG_KMAP | PMM_ALLOC_FLAG_NODE(node), &pa);
+        if (!page)
+            return false;
+
+        // the node is only a preference, don't pool pages from elsewhere
+        if (pmm_page_arena(page)->node() != node) {
+            pmm_free_page(page);
+            return false;
+        }
+
+        arch_zero_page(paddr_to_physmap(pa));
+        kcounter_add(zero_pool_zeroed, 1u);
+
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&z.lock, state);
+        list_add_tail(&z.free_list, &page->free.node);
+        z.count++;
+        spin_unlock_irqrestore(&z.lock, state);
+
+        kcounter_add(zero_pool_depth, 1u);
+    }
+
+    return true;
+}
+
+static int pmm_zero_thread(void*) {
+    for (;;) {
+        event_wait(&pmm_zero_pool_event);
+
+        for (uint node = 0; node < pmm_num_nodes; node++) {
+            if (!pmm_zero_pool_fill(node))
+                break;
+        }
+    }
+    return 0;
+}
+
+static void pmm_zero_pool_init(uint level) {
+    for (auto& z : pmm_zero_pool) {
+        z.lock = SPIN_LOCK_INITIAL_VALUE;
+        list_initialize(&z.free_list);
+    }
+    pmm_zero_pool_enabled = true;
+
+    thread_t* t = thread_create("pmm zero", &pmm_zero_thread, nullptr,
+                                LOWEST_PRIORITY + 1, DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("PMM: failed to create the page zeroing thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+    event_signal(&pmm_zero_pool_event, false);
+}
+LK_INIT_HOOK(pmm_zero_pool, &pmm_zero_pool_init, LK_INIT_LEVEL_THREADING);
+
+vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+    struct list_node list = LIST_INITIAL_VALUE(list);
+    if (pmm_cache_alloc(1, alloc_flags, &list) > 0) {
+        vm_page_t* page = list_remove_head_type(&list, vm_page_t, free.node);
+        if (pa)
+            *pa = vm_page_to_paddr(page);
+        return page;
+    }
+
+    AutoLock al(&arena_lock);
+
+    vm_page_t* page = pmm_alloc_page_locked(alloc_flags, pa);
+    if (!page && pmm_drain_all_locked() > 0)
+        page = pmm_alloc_page_locked(alloc_flags, pa);
+    pmm_check_reclaim_locked();
+
+    if (!page)
+        LTRACEF("failed to allocate page\n");
+    return page;
 }
 
 size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
@@ -149,27 +675,56 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
     if (count == 0)
         return 0;
 
+    /* every cached page comes from a KMAP arena, so the cache satisfies either arena flag */
+    size_t allocated = pmm_cache_alloc(count, alloc_flags, list);
+    if (allocated == count)
+        return allocated;
+
     AutoLock al(&arena_lock);
 
-    /* walk the arenas in order, allocating as many pages as we can from each */
-    size_t allocated = 0;
-    for (auto& a : arena_list) {
-        DEBUG_ASSERT(count > allocated);
+    allocated += pmm_alloc_pages_locked(count - allocated, alloc_flags, list);
+    if (allocated < count && pmm_drain_all_locked() > 0)
+        allocated += pmm_alloc_pages_locked(count - allocated, alloc_flags, list);
+    pmm_check_reclaim_locked();
 
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
+    return allocated;
+}
 
-        // ask the arena to allocate some pages
-        allocated += a.AllocPages(count - allocated, list);
-        DEBUG_ASSERT(allocated <= count);
-        if (allocated == count)
-            break;
+vm_page_t* pmm_alloc_zeroed_page(uint alloc_flags, paddr_t* pa) {
+    struct list_node list = LIST_INITIAL_VALUE(list);
+    if (pmm_alloc_zeroed_pages(1, alloc_flags, &list) == 0)
+        return nullptr;
+
+    vm_page_t* page = list_remove_head_type(&list, vm_page_t, free.node);
+    if (pa)
+        *pa = vm_page_to_paddr(page);
+    return page;
+}
+
+size_t pmm_alloc_zeroed_pages(size_t count, uint alloc_flags, struct list_node* list) {
+    DEBUG_ASSERT(list);
+
+    if (count == 0)
+        return 0;
+
+    /* pooled pages come from KMAP arenas, like cached pages */
+    size_t allocated = pmm_zero_pool_alloc(pmm_alloc_node(alloc_flags), count, list);
+    kcounter_add(zero_pool_hits, allocated);
+    if (allocated == count)
+        return allocated;
+
+    kcounter_add(zero_pool_misses, count - allocated);
+
+    struct list_node dirty = LIST_INITIAL_VALUE(dirty);
+    size_t dirty_count = pmm_alloc_pages(count - allocated, alloc_flags, &dirty);
+
+    vm_page_t* page;
+    while ((page = list_remove_head_type(&dirty, vm_page_t, free.node)) != nullptr) {
+        arch_zero_page(paddr_to_physmap(vm_page_to_paddr(page)));
+        list_add_tail(list, &page->free.node);
     }
 
-    return allocated;
+    return allocated + dirty_count;
 }
 
 size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
@@ -183,6 +738,9 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
 
     AutoLock al(&arena_lock);
 
+    /* pages in the range may be sitting in a page cache */
+    pmm_drain_all_locked();
+
     /* walk through the arenas, looking to see if the physical page belongs to it */
     for (auto& a : arena_list) {
         while (allocated < count && a.address_in_arena(address)) {
@@ -225,14 +783,17 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
 
     AutoLock al(&arena_lock);
 
-    for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
+    /* on the first pass leave the page caches alone, if that fails they may be
+     * holding pages that break up the run we need */
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1 && pmm_drain_all_locked() == 0)
+            break;
 
-        size_t allocated = a.AllocContiguous(count, alignment_log2, pa, list);
+        size_t allocated = 0;
+        pmm_for_each_arena(alloc_flags, [&](PmmArena& a) {
+            allocated = a.AllocContiguous(count, alignment_log2, pa, list);
+            return allocated > 0;
+        });
         if (allocated > 0) {
             DEBUG_ASSERT(allocated == count);
             return allocated;
@@ -317,24 +878,19 @@ size_t pmm_free(struct list_node* list) {
 
     DEBUG_ASSERT(list);
 
+    struct list_node drain = LIST_INITIAL_VALUE(drain);
+    size_t count = pmm_cache_free(list, &drain);
+    if (list_is_empty(list) && list_is_empty(&drain)) {
+        LTRACEF("returning count %zu\n", count);
+        return count;
+    }
+
     AutoLock al(&arena_lock);
 
-    uint count = 0;
-    while (!list_is_empty(list)) {
-        vm_page_t* page = list_remove_head_type(list, vm_page_t, free.node);
+    count += pmm_free_locked(list);
+    pmm_free_locked(&drain);
 
-        DEBUG_ASSERT_MSG(!page_is_free(page), "page %p state %u\n", page, page->state);
-
-        /* see which arena this page belongs to and add it */
-        for (auto& a : arena_list) {
-            if (a.FreePage(page) >= 0) {
-                count++;
-                break;
-            }
-        }
-    }
-
-    LTRACEF("returning count %u\n", count);
+    LTRACEF("returning count %zu\n", count);
 
     return count;
 }
@@ -348,8 +904,16 @@ size_t pmm_free_page(vm_page_t* page) {
     return pmm_free(&list);
 }
 
+static size_t pmm_count_cached_pages() {
+    size_t cached = 0u;
+    for (const auto& c : pmm_cache) {
+        cached += c.count;
+    }
+    return cached;
+}
+
 static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock) {
-    size_t free = 0u;
+    size_t free = pmm_count_cached_pages() + pmm_count_zero_pool_pages();
     for (const auto& a : arena_list) {
         free += a.free_count();
     }
@@ -361,6 +925,46 @@ size_t pmm_count_free_pages() {
     return pmm_count_free_pages_locked();
 }
 
+void pmm_set_reclaim_watermarks(size_t low, size_t high) {
+    AutoLock al(&arena_lock);
+    pmm_reclaim_low = low;
+    pmm_reclaim_high = MAX(low, high);
+    pmm_check_reclaim_locked();
+}
+
+zx_status_t pmm_wait_for_reclaim(zx_time_t deadline, size_t* target) {
+    zx_status_t status = event_wait_deadline(&pmm_reclaim_event, deadline, false);
+    if (status != ZX_OK)
+        return status;
+
+    AutoLock al(&arena_lock);
+    size_t free = pmm_count_free_pages_locked();
+    *target = free < pmm_reclaim_high ? pmm_reclaim_high - free : 0;
+    return ZX_OK;
+}
+
+uint pmm_count_free_pages_per_node(size_t counts[PMM_MAX_NODES]) {
+    for (uint i = 0; i < PMM_MAX_NODES; i++) {
+        counts[i] = 0;
+    }
+
+    AutoLock al(&arena_lock);
+    for (const auto& a : arena_list) {
+        counts[a.node()] += a.free_count();
+    }
+
+    // cached pages are taken from the node of the cpu owning the cache, unless
+    // that node had run dry when the cache was refilled. close enough.
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        counts[pmm_cpu_node[i]] += pmm_cache[i].count;
+    }
+    for (uint i = 0; i < PMM_MAX_NODES; i++) {
+        counts[i] += pmm_zero_pool[i].count;
+    }
+
+    return pmm_num_nodes;
+}
+
 static void pmm_dump_free() TA_REQ(arena_lock) {
     auto megabytes_free = pmm_count_free_pages_locked() / 256u;
     printf(" %zu free MBs\n", megabytes_free);
@@ -382,6 +986,11 @@ void pmm_count_total_states(size_t state_count[_VM_PAGE_STATE_COUNT]) {
     for (auto& a : arena_list) {
         a.CountStates(state_count);
     }
+
+    // cached and pre-zeroed pages are held in the ALLOC state but are really free
+    size_t cached = pmm_count_cached_pages() + pmm_count_zero_pool_pages();
+    state_count[VM_PAGE_STATE_ALLOC] -= cached;
+    state_count[VM_PAGE_STATE_FREE] += cached;
 }
 
 static void pmm_dump_timer(timer_t* t, zx_time_t now, void*) TA_REQ(arena_lock) {
@@ -402,6 +1011,23 @@ static void arena_dump(bool is_panic) TA_NO_THREAD_SAFETY_ANALYSIS {
     }
 }
 
+// No locking, the counters are only a snapshot.
+static void pmm_cache_dump() {
+    printf("cpu  cached    alloc hit/miss     free hit/miss  refills   drains  hit%%\n");
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        if (!mp_is_cpu_online(i))
+            continue;
+
+        const PmmCache& c = pmm_cache[i];
+        uint64_t total = c.alloc_hits + c.alloc_misses + c.free_hits + c.free_misses;
+        uint64_t hit_percent = total ? ((c.alloc_hits + c.free_hits) * 100 / total) : 0;
+        printf("%3u %7zu %8" PRIu64 "/%-8" PRIu64 " %8" PRIu64 "/%-8" PRIu64
+               " %8" PRIu64 " %8" PRIu64 " %4" PRIu64 "\n",
+               i, c.count, c.alloc_hits, c.alloc_misses, c.free_hits, c.free_misses,
+               c.refills, c.drains, hit_percent);
+    }
+}
+
 static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
     bool is_panic = flags & CMD_FLAG_PANIC;
 
@@ -411,6 +1037,7 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
     usage:
         printf("usage:\n");
         printf("%s arenas\n", argv[0].str);
+        printf("%s cache\n", argv[0].str);
         if (!is_panic) {
             printf("%s alloc <count>\n", argv[0].str);
             printf("%s alloc_range <address> <count>\n", argv[0].str);
@@ -427,9 +1054,11 @@ static int cmd_pmm(int argc, const cmd_args* argv, uint32_t flags) {
 
     if (!strcmp(argv[1].str, "arenas")) {
         arena_dump(is_panic);
+    } else if (!strcmp(argv[1].str, "cache")) {
+        pmm_cache_dump();
     } else if (is_panic) {
         // No other operations will work during a panic.
-        printf("Only the \"arenas\" command is available during a panic.\n");
+        printf("Only the \"arenas\" and \"cache\" commands are available during a panic.\n");
         goto usage;
     } else if (!strcmp(argv[1].str, "free")) {
         static bool show_mem = false;
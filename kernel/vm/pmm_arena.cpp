@@ -104,6 +104,40 @@ zx_status_t PmmArena::Init(const pmm_arena_info_t* info) {
     return ZX_OK;
 }
 
+void PmmArena::Split(paddr_t pa, PmmArena* upper) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(pa));
+    DEBUG_ASSERT(pa > base() && pa < base() + size());
+    DEBUG_ASSERT(upper->page_array_ == nullptr);
+
+    size_t split_index = (pa - base()) / PAGE_SIZE;
+
+    /* the upper arena shares the tail of our page array */
+    upper->info_ = info_;
+    upper->info_.base = pa;
+    upper->info_.size = size() - (pa - base());
+    upper->page_array_ = page_array_ + split_index;
+    upper->node_ = node_;
+#if PMM_ENABLE_FREE_FILL
+    upper->enforce_fill_ = enforce_fill_;
+#endif
+
+    info_.size = pa - base();
+
+    /* hand the free pages above the split point over to the upper arena */
+    vm_page_t* page;
+    vm_page_t* temp;
+    list_for_every_entry_safe (&free_list_, page, temp, vm_page_t, free.node) {
+        if (page_belongs_to_arena(page))
+            continue;
+
+        DEBUG_ASSERT(upper->page_belongs_to_arena(page));
+        list_delete(&page->free.node);
+        list_add_tail(&upper->free_list_, &page->free.node);
+        free_count_--;
+        upper->free_count_++;
+    }
+}
+
 vm_page_t* PmmArena::AllocPage(paddr_t* pa) {
     vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
     if (!page)
@@ -275,8 +309,8 @@ void PmmArena::CountStates(size_t state_count[_VM_PAGE_STATE_COUNT]) const {
 
 void PmmArena::Dump(bool dump_pages, bool dump_free_ranges) {
     char pbuf[16];
-    printf("arena %p: name '%s' base %#" PRIxPTR " size %s (0x%zx) priority %u flags 0x%x\n", this, name(), base(),
-           format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags());
+    printf("arena %p: name '%s' base %#" PRIxPTR " size %s (0x%zx) priority %u flags 0x%x node %u\n", this, name(),
+           base(), format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags(), node());
     printf("\tpage_array %p, free_count %zu\n", page_array_, free_count_);
 
     /* dump all of the pages */
@@ -40,6 +40,14 @@ public:
     unsigned int priority() const { return info_.priority; }
     size_t free_count() const { return free_count_; };
 
+    // memory node the arena belongs to
+    unsigned int node() const { return node_; }
+    void set_node(unsigned int node) { node_ = node; }
+
+    // Move everything at and above |pa| into |upper|, which must be a freshly
+    // constructed arena.
+    void Split(paddr_t pa, PmmArena* upper);
+
     // Counts the number of pages in every state. For each page in the arena,
     // increments the corresponding VM_PAGE_STATE_*-indexed entry of
     // |state_count|. Does not zero out the entries first.
@@ -86,6 +94,8 @@ private:
     size_t free_count_ = 0;
     list_node free_list_ = LIST_INITIAL_VALUE(free_list_);
 
+    unsigned int node_ = 0;
+
 #if PMM_ENABLE_FREE_FILL
     bool enforce_fill_ = false;
 #endif
@@ -13,7 +13,8 @@ MODULE_DEPS += \
     kernel/lib/fbl \
     kernel/lib/pretty \
     kernel/lib/user_copy \
-    third_party/lib/cryptolib
+    third_party/lib/cryptolib \
+    third_party/lib/lz4
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/bootalloc.cpp \
@@ -25,11 +26,15 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/vm_address_region.cpp \
     $(LOCAL_DIR)/vm_address_region_or_mapping.cpp \
     $(LOCAL_DIR)/vm_aspace.cpp \
+    $(LOCAL_DIR)/vm_compressed_pages.cpp \
     $(LOCAL_DIR)/vm_mapping.cpp \
+    $(LOCAL_DIR)/vm_merge.cpp \
+    $(LOCAL_DIR)/vm_merged_pages.cpp \
     $(LOCAL_DIR)/vm_object.cpp \
     $(LOCAL_DIR)/vm_object_paged.cpp \
     $(LOCAL_DIR)/vm_object_physical.cpp \
     $(LOCAL_DIR)/vm_page_list.cpp \
+    $(LOCAL_DIR)/vm_reclaim.cpp \
     $(LOCAL_DIR)/vm_unittest.cpp \
     $(LOCAL_DIR)/vmm.cpp \
 
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <err.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <pow2.h>
@@ -83,9 +84,20 @@ zx_status_t VmAddressRegion::CreateSubVmarInternal(size_t offset, size_t size, u
                                                    uint64_t vmo_offset, uint arch_mmu_flags,
                                                    const char* name,
                                                    fbl::RefPtr<VmAddressRegionOrMapping>* out) {
+    AutoLock guard(aspace_->lock());
+    return CreateSubVmarInternalLocked(offset, size, align_pow2, vmar_flags, fbl::move(vmo),
+                                       vmo_offset, arch_mmu_flags, name, out);
+}
+
+zx_status_t VmAddressRegion::CreateSubVmarInternalLocked(size_t offset, size_t size,
+                                                         uint8_t align_pow2, uint32_t vmar_flags,
+                                                         fbl::RefPtr<VmObject> vmo,
+                                                         uint64_t vmo_offset, uint arch_mmu_flags,
+                                                         const char* name,
+                                                         fbl::RefPtr<VmAddressRegionOrMapping>* out) {
     DEBUG_ASSERT(out);
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
-    AutoLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
         return ZX_ERR_BAD_STATE;
     }
@@ -232,7 +244,18 @@ zx_status_t VmAddressRegion::CreateVmMapping(size_t mapping_offset, size_t size,
                                              uint32_t vmar_flags, fbl::RefPtr<VmObject> vmo,
                                              uint64_t vmo_offset, uint arch_mmu_flags, const char* name,
                                              fbl::RefPtr<VmMapping>* out) {
+    AutoLock guard(aspace_->lock());
+    return CreateVmMappingLocked(mapping_offset, size, align_pow2, vmar_flags, fbl::move(vmo),
+                                 vmo_offset, arch_mmu_flags, name, out);
+}
+
+zx_status_t VmAddressRegion::CreateVmMappingLocked(size_t mapping_offset, size_t size,
+                                                   uint8_t align_pow2, uint32_t vmar_flags,
+                                                   fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset,
+                                                   uint arch_mmu_flags, const char* name,
+                                                   fbl::RefPtr<VmMapping>* out) {
     DEBUG_ASSERT(out);
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
     LTRACEF("%p %#zx %#zx %x\n", this, mapping_offset, size, vmar_flags);
 
     // Check that only allowed flags have been set
@@ -246,7 +269,7 @@ zx_status_t VmAddressRegion::CreateVmMapping(size_t mapping_offset, size_t size,
     }
 
     // If size overflows, it'll become 0 and get rejected in
-    // CreateSubVmarInternal.
+    // CreateSubVmarInternalLocked.
     size = ROUNDUP(size, PAGE_SIZE);
 
     // Make sure that vmo_offset is aligned and that a mapping of this size
@@ -269,8 +292,8 @@ zx_status_t VmAddressRegion::CreateVmMapping(size_t mapping_offset, size_t size,
 
     fbl::RefPtr<VmAddressRegionOrMapping> res;
     zx_status_t status =
-        CreateSubVmarInternal(mapping_offset, size, align_pow2, vmar_flags, fbl::move(vmo),
-                              vmo_offset, arch_mmu_flags, name, &res);
+        CreateSubVmarInternalLocked(mapping_offset, size, align_pow2, vmar_flags, fbl::move(vmo),
+                                    vmo_offset, arch_mmu_flags, name, &res);
     if (status != ZX_OK) {
         return status;
     }
@@ -344,6 +367,16 @@ void VmAddressRegion::RemoveSubregion(VmAddressRegionOrMapping* region) {
     subregions_.erase(*region);
 }
 
+void VmAddressRegion::ResizeSubregionLocked(VmAddressRegionOrMapping* region, size_t size) {
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+
+    // The gaps are only recalculated for the subtrees the tree restructures,
+    // so take the region out while it changes.
+    fbl::RefPtr<VmAddressRegionOrMapping> ref(subregions_.erase(*region));
+    region->size_ = size;
+    subregions_.insert(fbl::move(ref));
+}
+
 fbl::RefPtr<VmAddressRegionOrMapping> VmAddressRegion::FindRegion(vaddr_t addr) {
     AutoLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
@@ -380,7 +413,7 @@ size_t VmAddressRegion::AllocatedPagesLocked() const {
     return sum;
 }
 
-zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
+zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -388,7 +421,7 @@ zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
          auto next = vmar->FindRegionLocked(va);
          vmar = next->as_vm_address_region()) {
         if (next->is_mapping())
-            return next->PageFault(va, pf_flags);
+            return next->PageFault(va, pf_flags, page_request);
     }
 
     return ZX_ERR_NOT_FOUND;
@@ -634,6 +667,31 @@ zx_status_t VmAddressRegion::UnmapInternalLocked(vaddr_t base, size_t size, bool
         }
     }
 
+    // If more than one mapping is affected, tear down the hardware mappings
+    // for the whole range up front so that their TLB shootdowns are batched
+    // into one.  Nothing is freed until the regions are unmapped or destroyed
+    // below, by which point their own arch unmaps find nothing left to
+    // invalidate.  Within Batch() this is always done, since the flush has
+    // to happen before anything is freed, and it takes the invalidations
+    // held back for the earlier operations along with it.
+    const bool deferred = aspace_->invalidations_deferred_;
+    auto second = begin;
+    if (begin != end && (deferred || ++second != end || !begin->is_mapping())) {
+        ArchVmAspace& arch_aspace = aspace_->arch_aspace();
+        if (!deferred) {
+            arch_aspace.DeferInvalidations();
+        }
+        for (auto itr = begin; itr != end; ++itr) {
+            const vaddr_t unmap_base = fbl::max(itr->base(), base);
+            const vaddr_t unmap_end = fbl::min(itr->base() + itr->size(), end_addr);
+            arch_aspace.Unmap(unmap_base, (unmap_end - unmap_base) / PAGE_SIZE, nullptr);
+        }
+        arch_aspace.FlushPendingInvalidations();
+        if (deferred) {
+            arch_aspace.DeferInvalidations();
+        }
+    }
+
     for (auto itr = begin; itr != end;) {
         // Create a copy of the iterator, in case we destroy this element
         auto curr = itr++;
@@ -676,16 +734,29 @@ zx_status_t VmAddressRegion::UnmapInternalLocked(vaddr_t base, size_t size, bool
 zx_status_t VmAddressRegion::Protect(vaddr_t base, size_t size, uint new_arch_mmu_flags) {
     canary_.Assert();
 
-    size = ROUNDUP(size, PAGE_SIZE);
-    if (size == 0 || !IS_PAGE_ALIGNED(base)) {
-        return ZX_ERR_INVALID_ARGS;
-    }
-
     AutoLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
         return ZX_ERR_BAD_STATE;
     }
 
+    // Protecting doesn't free anything, so the TLB shootdowns for every
+    // mapping in the range can be batched into one, as long as it is issued
+    // before the new permissions are relied upon.
+    ArchVmAspace& arch_aspace = aspace_->arch_aspace();
+    arch_aspace.DeferInvalidations();
+    auto flush = fbl::MakeAutoCall([&arch_aspace]() { arch_aspace.FlushPendingInvalidations(); });
+
+    return ProtectLocked(base, size, new_arch_mmu_flags);
+}
+
+zx_status_t VmAddressRegion::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags) {
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+
+    size = ROUNDUP(size, PAGE_SIZE);
+    if (size == 0 || !IS_PAGE_ALIGNED(base)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
     if (!is_in_range(base, size)) {
         return ZX_ERR_INVALID_ARGS;
     }
@@ -755,6 +826,121 @@ zx_status_t VmAddressRegion::Protect(vaddr_t base, size_t size, uint new_arch_mm
     return ZX_OK;
 }
 
+zx_status_t VmAddressRegion::Batch(VmBatchOp* ops, size_t count, size_t* completed) {
+    canary_.Assert();
+
+    *completed = 0;
+
+    AutoLock guard(aspace_->lock());
+    if (state_ != LifeCycleState::ALIVE) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    ArchVmAspace& arch_aspace = aspace_->arch_aspace();
+    arch_aspace.DeferInvalidations();
+    aspace_->invalidations_deferred_ = true;
+    auto flush = fbl::MakeAutoCall([this, &arch_aspace]() {
+        aspace_->invalidations_deferred_ = false;
+        arch_aspace.FlushPendingInvalidations();
+    });
+
+    for (size_t i = 0; i < count; ++i) {
+        VmBatchOp& op = ops[i];
+        zx_status_t status;
+        switch (op.type) {
+        case VmBatchOp::Type::Map: {
+            fbl::RefPtr<VmMapping> mapping;
+            status = CreateVmMappingLocked(op.base, op.size, /* align_pow2 */ 0, op.vmar_flags,
+                                           fbl::move(op.vmo), op.vmo_offset, op.arch_mmu_flags,
+                                           op.name, &mapping);
+            if (status == ZX_OK) {
+                op.base = mapping->base();
+            }
+            break;
+        }
+        case VmBatchOp::Type::Unmap:
+            op.size = ROUNDUP(op.size, PAGE_SIZE);
+            if (op.size == 0 || !IS_PAGE_ALIGNED(op.base)) {
+                status = ZX_ERR_INVALID_ARGS;
+            } else {
+                status = UnmapInternalLocked(op.base, op.size, true /* can_destroy_regions */);
+            }
+            break;
+        case VmBatchOp::Type::Protect:
+            status = ProtectLocked(op.base, op.size, op.arch_mmu_flags);
+            break;
+        default:
+            status = ZX_ERR_INVALID_ARGS;
+            break;
+        }
+        if (status != ZX_OK) {
+            return status;
+        }
+        *completed = i + 1;
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t VmAddressRegion::HintRange(vaddr_t base, size_t size, VmRangeHint hint) {
+    canary_.Assert();
+
+    size = ROUNDUP(size, PAGE_SIZE);
+    if (size == 0 || !IS_PAGE_ALIGNED(base)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    AutoLock guard(aspace_->lock());
+    if (state_ != LifeCycleState::ALIVE) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    if (!is_in_range(base, size)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    if (subregions_.is_empty()) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    const vaddr_t end_addr = base + size;
+    const auto end = subregions_.lower_bound(end_addr);
+
+    // Same rules as Protect(): the range must be fully mapped, by mappings
+    // directly in this region.
+    auto begin = --subregions_.upper_bound(base);
+    if (!begin.IsValid() || begin->base() + begin->size() <= base) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    vaddr_t last_mapped = begin->base();
+    for (auto itr = begin; itr != end; ++itr) {
+        if (!itr->is_mapping()) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (itr->base() != last_mapped) {
+            return ZX_ERR_NOT_FOUND;
+        }
+        last_mapped = itr->base() + itr->size();
+    }
+    if (last_mapped < base + size) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    for (auto itr = begin; itr != end; ++itr) {
+        const vaddr_t hint_base = fbl::max(itr->base(), base);
+        const vaddr_t hint_end = fbl::min(itr->base() + itr->size(), end_addr);
+
+        zx_status_t status = itr->as_vm_mapping()->HintRangeLocked(hint_base,
+                                                                   hint_end - hint_base, hint);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t VmAddressRegion::LinearRegionAllocatorLocked(size_t size, uint8_t align_pow2,
                                                          uint arch_mmu_flags, vaddr_t* spot) {
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
@@ -786,31 +972,88 @@ zx_status_t VmAddressRegion::LinearRegionAllocatorLocked(size_t size, uint8_t al
     return ZX_ERR_NO_MEMORY;
 }
 
+size_t VmAddressRegion::LargestGapLocked() const {
+    const VmAddressRegionOrMapping* root = subregions_.root_node();
+    if (!root) {
+        return size_;
+    }
+    size_t gap = fbl::max(root->subtree_max_gap_, root->subtree_min_base_ - base_);
+    return fbl::max(gap, (base_ + size_) - root->subtree_max_end_);
+}
+
 template <typename F>
-void VmAddressRegion::ForEachGap(F func, uint8_t align_pow2) {
+void VmAddressRegion::ForEachGap(F func, size_t min_gap, uint8_t align_pow2) {
     const vaddr_t align = 1UL << align_pow2;
 
-    // Scan the regions list to find the gap to the left of each region.  We
-    // round up the end of the previous region to the requested alignment, so
-    // all gaps reported will be for aligned ranges.
-    vaddr_t prev_region_end = ROUNDUP(base_, align);
-    for (const auto& region : subregions_) {
-        if (region.base() > prev_region_end) {
-            const size_t gap = region.base() - prev_region_end;
-            if (!func(prev_region_end, gap)) {
-                return;
+    // The end of the previous region.  We round it up to the requested
+    // alignment, so all gaps reported will be for aligned ranges.
+    vaddr_t prev_region_end = base_;
+    auto report_gap = [&](vaddr_t gap_end) -> bool {
+        const vaddr_t gap_base = ROUNDUP(prev_region_end, align);
+        if (gap_end > gap_base && gap_end - gap_base >= min_gap) {
+            return func(gap_base, gap_end - gap_base);
+        }
+        return true;
+    };
+
+    // Whether the subtree under |node| might hold a gap of min_gap, counting
+    // the one between it and the previous region.  Alignment only makes gaps
+    // smaller, so a subtree which fails this has nothing to report.
+    auto may_have_gap = [&](const VmAddressRegionOrMapping* node) -> bool {
+        return node->subtree_max_gap_ >= min_gap ||
+               node->subtree_min_base_ - prev_region_end >= min_gap;
+    };
+
+    // Walk the regions in order, to find the gap to the left of each one,
+    // stepping over the subtrees which have no gap to report.
+    VmAddressRegionOrMapping* node = subregions_.root_node();
+    if (node && !may_have_gap(node)) {
+        prev_region_end = node->subtree_max_end_;
+        node = nullptr;
+    }
+    bool descend = true;
+    while (node) {
+        if (descend) {
+            for (auto left = ChildList::left_child(node); left; left = ChildList::left_child(node)) {
+                if (!may_have_gap(left)) {
+                    prev_region_end = left->subtree_max_end_;
+                    break;
+                }
+                node = left;
+            }
+        }
+
+        if (!report_gap(node->base())) {
+            return;
+        }
+        prev_region_end = node->base() + node->size();
+
+        auto right = ChildList::right_child(node);
+        if (right && may_have_gap(right)) {
+            node = right;
+            descend = true;
+            continue;
+        }
+        if (right) {
+            prev_region_end = right->subtree_max_end_;
+        }
+
+        // Everything under |node| is done, so move up to the first ancestor
+        // whose left subtree it is in.
+        descend = false;
+        for (;;) {
+            auto parent = ChildList::parent_node(node);
+            if (!parent || ChildList::left_child(parent) == node) {
+                node = parent;
+                break;
             }
+            node = parent;
         }
-        prev_region_end = ROUNDUP(region.base() + region.size(), align);
     }
 
     // Grab the gap to the right of the last region (note that if there are no
     // regions, this handles reporting the VMAR's whole span as a gap).
-    const vaddr_t end = base_ + size_;
-    if (end > prev_region_end) {
-        const size_t gap = end - prev_region_end;
-        func(prev_region_end, gap);
-    }
+    report_gap(base_ + size_);
 }
 
 namespace {
@@ -821,11 +1064,22 @@ constexpr size_t AllocationSpotsInRange(size_t range_size, size_t alloc_size, ui
     return ((range_size - alloc_size) >> align_pow2) + 1;
 }
 
+// The number of positions the non-compact allocator tries at random before
+// counting the free ones.
+constexpr int kRandomAllocationProbes = 4;
+
 } // namespace {}
 
 // Perform allocations for VMARs that aren't using the COMPACT policy.  This
 // allocator works by choosing uniformly at random from the set of positions
 // that could satisfy the allocation.
+//
+// It starts by trying a few positions chosen uniformly from the whole VMAR.
+// The first of these which is free is uniformly distributed over the free
+// positions, and when the VMAR is sparsely used one almost always is, after a
+// single O(log n) lookup.  Otherwise it counts the free positions, skipping
+// the parts of the subregion list which have no gap large enough, and picks
+// one of them.
 zx_status_t VmAddressRegion::NonCompactRandomizedRegionAllocatorLocked(size_t size, uint8_t align_pow2,
                                                                        uint arch_mmu_flags,
                                                                        vaddr_t* spot) {
@@ -835,42 +1089,57 @@ zx_status_t VmAddressRegion::NonCompactRandomizedRegionAllocatorLocked(size_t si
     align_pow2 = fbl::max(align_pow2, static_cast<uint8_t>(PAGE_SIZE_SHIFT));
     const vaddr_t align = 1UL << align_pow2;
 
-    // Calculate the number of spaces that we can fit this allocation in.
-    size_t candidate_spaces = 0;
-    ForEachGap([align, align_pow2, size, &candidate_spaces](vaddr_t gap_base, size_t gap_len) -> bool {
-        DEBUG_ASSERT(IS_ALIGNED(gap_base, align));
-        if (gap_len >= size) {
-            candidate_spaces += AllocationSpotsInRange(gap_len, size, align_pow2);
-        }
-        return true;
-    },
-               align_pow2);
-
-    if (candidate_spaces == 0) {
+    // The aligned range the allocation has to fit in.
+    const vaddr_t range_base = ROUNDUP(base_, align);
+    const vaddr_t range_end = base_ + size_;
+    if (range_base < base_ || range_base >= range_end || range_end - range_base < size ||
+        LargestGapLocked() < size) {
         return ZX_ERR_NO_MEMORY;
     }
 
-    // Choose the index of the allocation to use.
-    size_t selected_index = aspace_->AslrPrng().RandInt(candidate_spaces);
-    DEBUG_ASSERT(selected_index < candidate_spaces);
-
-    // Find which allocation we picked.
     vaddr_t alloc_spot = static_cast<vaddr_t>(-1);
-    ForEachGap([align_pow2, size, &alloc_spot, &selected_index](vaddr_t gap_base,
-                                                                size_t gap_len) -> bool {
-        if (gap_len < size) {
-            return true;
+    const size_t range_spaces = AllocationSpotsInRange(range_end - range_base, size, align_pow2);
+    for (int i = 0; i < kRandomAllocationProbes; ++i) {
+        const vaddr_t candidate =
+            range_base + (aspace_->AslrPrng().RandInt(range_spaces) << align_pow2);
+        if (IsRangeAvailableLocked(candidate, size)) {
+            alloc_spot = candidate;
+            break;
         }
+    }
 
-        const size_t spots = AllocationSpotsInRange(gap_len, size, align_pow2);
-        if (selected_index < spots) {
-            alloc_spot = gap_base + (selected_index << align_pow2);
-            return false;
+    if (alloc_spot == static_cast<vaddr_t>(-1)) {
+        // Calculate the number of spaces that we can fit this allocation in.
+        size_t candidate_spaces = 0;
+        ForEachGap([align, align_pow2, size, &candidate_spaces](vaddr_t gap_base,
+                                                               size_t gap_len) -> bool {
+            DEBUG_ASSERT(IS_ALIGNED(gap_base, align));
+            candidate_spaces += AllocationSpotsInRange(gap_len, size, align_pow2);
+            return true;
+        },
+                   size, align_pow2);
+
+        if (candidate_spaces == 0) {
+            return ZX_ERR_NO_MEMORY;
         }
-        selected_index -= spots;
-        return true;
-    },
-               align_pow2);
+
+        // Choose the index of the allocation to use.
+        size_t selected_index = aspace_->AslrPrng().RandInt(candidate_spaces);
+        DEBUG_ASSERT(selected_index < candidate_spaces);
+
+        // Find which allocation we picked.
+        ForEachGap([align_pow2, size, &alloc_spot, &selected_index](vaddr_t gap_base,
+                                                                    size_t gap_len) -> bool {
+            const size_t spots = AllocationSpotsInRange(gap_len, size, align_pow2);
+            if (selected_index < spots) {
+                alloc_spot = gap_base + (selected_index << align_pow2);
+                return false;
+            }
+            selected_index -= spots;
+            return true;
+        },
+                   size, align_pow2);
+    }
     ASSERT(alloc_spot != static_cast<vaddr_t>(-1));
     ASSERT(IS_ALIGNED(alloc_spot, align));
 
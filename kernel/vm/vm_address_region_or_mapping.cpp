@@ -9,6 +9,7 @@
 #include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
@@ -93,3 +94,27 @@ size_t VmAddressRegionOrMapping::AllocatedPages() const {
     }
     return AllocatedPagesLocked();
 }
+
+void VmAddressRegionOrMapping::SubregionTreeObserver::OnSubtreeChanged(
+    VmAddressRegionOrMapping* node, VmAddressRegionOrMapping* left,
+    VmAddressRegionOrMapping* right) {
+    const vaddr_t end = node->base_ + node->size_;
+    size_t max_gap = 0;
+
+    if (left) {
+        node->subtree_min_base_ = left->subtree_min_base_;
+        max_gap = fbl::max(left->subtree_max_gap_, node->base_ - left->subtree_max_end_);
+    } else {
+        node->subtree_min_base_ = node->base_;
+    }
+
+    if (right) {
+        node->subtree_max_end_ = right->subtree_max_end_;
+        max_gap = fbl::max(max_gap, right->subtree_max_gap_);
+        max_gap = fbl::max(max_gap, right->subtree_min_base_ - end);
+    } else {
+        node->subtree_max_end_ = end;
+    }
+
+    node->subtree_max_gap_ = max_gap;
+}
@@ -544,12 +544,25 @@ zx_status_t VmAspace::PageFault(vaddr_t va, uint flags) {
         flags |= VMM_PF_FLAG_GUEST;
     }
 
-    // for now, hold the aspace lock across the page fault operation,
-    // which stops any other operations on the address space from moving
-    // the region out from underneath it
-    AutoLock a(&lock_);
+    for (;;) {
+        // for now, hold the aspace lock across the page fault operation,
+        // which stops any other operations on the address space from moving
+        // the region out from underneath it
+        PageRequest page_request;
+        zx_status_t status;
+        {
+            AutoLock a(&lock_);
+            status = root_vmar_->PageFault(va, flags, &page_request);
+        }
+        if (status != ZX_ERR_SHOULD_WAIT)
+            return status;
 
-    return root_vmar_->PageFault(va, flags);
+        // the page has to come from a page source, which may need this address space
+        // to produce it, so wait with no locks held and then look the address up again
+        status = page_request.Wait();
+        if (status != ZX_OK)
+            return status;
+    }
 }
 
 void VmAspace::Dump(bool verbose) const {
@@ -559,6 +572,15 @@ void VmAspace::Dump(bool verbose) const {
 
     AutoLock a(&lock_);
 
+    // every page mapped speculatively is a fault that would otherwise have been taken
+    // if the page was touched
+    printf("   faults %" PRIu64 " avoided up to %" PRIu64 " (fault around %" PRIu64
+           ", read ahead %" PRIu64 ")\n",
+           fault_stats_.faults, fault_stats_.fault_around_pages + fault_stats_.read_ahead_pages,
+           fault_stats_.fault_around_pages, fault_stats_.read_ahead_pages);
+    printf("   decompress faults %" PRIu64 " time %" PRIi64 "ns\n",
+           fault_stats_.decompress_faults, fault_stats_.decompress_ns);
+
     if (verbose)
         root_vmar_->Dump(1, verbose);
 }
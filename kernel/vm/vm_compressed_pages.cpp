@@ -0,0 +1,175 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/vm_compressed_pages.h>
+
+#include "vm_priv.h"
+
+#include <assert.h>
+#include <err.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
+#include <inttypes.h>
+#include <lib/counters.h>
+#include <lz4/lz4.h>
+#include <string.h>
+#include <trace.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+KCOUNTER(compress_pages_compressed, "kernel.vm.compress.compressed");
+KCOUNTER(compress_pages_decompressed, "kernel.vm.compress.decompressed");
+KCOUNTER(compress_pages_rejected, "kernel.vm.compress.rejected");
+
+namespace {
+
+// A page has to shrink to at most this to be kept, anything larger saves too little to
+// pay for the decompression on the next fault.
+constexpr size_t kMaxStoredSize = PAGE_SIZE * 3 / 4;
+
+// Compression uses one shared state and output buffer, the allocation mode of the
+// library is compiled out of the kernel and the state is too big for the stack.
+fbl::Mutex compress_lock;
+uint64_t compress_state[LZ4_STREAMSIZE_U64] TA_GUARDED(compress_lock);
+uint8_t compress_buffer[kMaxStoredSize] TA_GUARDED(compress_lock);
+
+fbl::Mutex stats_lock;
+VmCompressedPages::Stats stats TA_GUARDED(stats_lock);
+
+} // namespace
+
+VmCompressedPages::~VmCompressedPages() {
+    RemoveRange(0, UINT64_MAX);
+}
+
+zx_status_t VmCompressedPages::Insert(uint64_t offset, const void* page) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+    DEBUG_ASSERT(!Contains(offset));
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Page> entry(new (&ac) Page());
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    {
+        fbl::AutoLock a(&compress_lock);
+
+        int size = LZ4_compress_fast_extState(compress_state, static_cast<const char*>(page),
+                                              reinterpret_cast<char*>(compress_buffer),
+                                              PAGE_SIZE, sizeof(compress_buffer), 1);
+        if (size <= 0) {
+            kcounter_add(compress_pages_rejected, 1u);
+            fbl::AutoLock al(&stats_lock);
+            stats.rejected++;
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+
+        entry->data.reset(new (&ac) uint8_t[size]);
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        memcpy(entry->data.get(), compress_buffer, size);
+        entry->size = static_cast<uint32_t>(size);
+    }
+
+    LTRACEF("offset %#" PRIx64 " compressed to %u bytes\n", offset, entry->size);
+
+    entry->offset = offset;
+    stored_bytes_ += entry->size;
+    kcounter_add(compress_pages_compressed, 1u);
+    {
+        fbl::AutoLock a(&stats_lock);
+        stats.pages++;
+        stats.stored_bytes += entry->size;
+        stats.compressed++;
+    }
+    pages_.insert(fbl::move(entry));
+
+    return ZX_OK;
+}
+
+zx_status_t VmCompressedPages::Take(uint64_t offset, void* page) {
+    auto iter = pages_.find(offset);
+    if (!iter.IsValid())
+        return ZX_ERR_NOT_FOUND;
+
+    int size = LZ4_decompress_safe(reinterpret_cast<const char*>(iter->data.get()),
+                                   static_cast<char*>(page), iter->size, PAGE_SIZE);
+    // we wrote the data ourselves, anything else is memory corruption
+    ASSERT_MSG(size == PAGE_SIZE, "corrupt compressed page at offset %#" PRIx64 ": %d\n",
+               offset, size);
+
+    kcounter_add(compress_pages_decompressed, 1u);
+    {
+        fbl::AutoLock a(&stats_lock);
+        stats.decompressed++;
+    }
+    Erase(&*iter);
+
+    return ZX_OK;
+}
+
+bool VmCompressedPages::FirstInRange(uint64_t start, uint64_t end, uint64_t* offset) const {
+    auto iter = pages_.lower_bound(start);
+    if (!iter.IsValid() || iter->offset >= end)
+        return false;
+    *offset = iter->offset;
+    return true;
+}
+
+size_t VmCompressedPages::CountInRange(uint64_t start, uint64_t end, size_t* bytes) const {
+    size_t count = 0;
+    size_t total = 0;
+    for (auto iter = pages_.lower_bound(start); iter.IsValid() && iter->offset < end; ++iter) {
+        count++;
+        total += iter->size;
+    }
+    if (bytes)
+        *bytes = total;
+    return count;
+}
+
+size_t VmCompressedPages::RemoveRange(uint64_t start, uint64_t end) {
+    size_t count = 0;
+    auto iter = pages_.lower_bound(start);
+    while (iter.IsValid() && iter->offset < end) {
+        Page* page = &*iter;
+        ++iter;
+        Erase(page);
+        count++;
+    }
+    return count;
+}
+
+void VmCompressedPages::MoveTo(uint64_t offset, VmCompressedPages* dest, uint64_t dest_offset) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(dest_offset));
+    DEBUG_ASSERT(!dest->Contains(dest_offset));
+
+    fbl::unique_ptr<Page> page = pages_.erase(offset);
+    DEBUG_ASSERT(page);
+
+    // the page is still stored, just somewhere else, so the global stats stay as they are
+    stored_bytes_ -= page->size;
+    dest->stored_bytes_ += page->size;
+    page->offset = dest_offset;
+    dest->pages_.insert(fbl::move(page));
+}
+
+void VmCompressedPages::Erase(Page* page) {
+    stored_bytes_ -= page->size;
+    {
+        fbl::AutoLock a(&stats_lock);
+        stats.pages--;
+        stats.stored_bytes -= page->size;
+    }
+    // dropping the entry frees it
+    pages_.erase(*page);
+}
+
+void VmCompressedPages::GetStats(Stats* out) {
+    fbl::AutoLock a(&stats_lock);
+    *out = stats;
+}
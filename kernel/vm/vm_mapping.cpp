@@ -13,6 +13,9 @@
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <lk/init.h>
+#include <pow2.h>
 #include <safeint/safe_math.h>
 #include <trace.h>
 #include <vm/fault.h>
@@ -25,6 +28,24 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+// Number of pages in the naturally aligned window around a read fault that
+// are mapped along with the faulting page if the object already has them.
+static uint32_t fault_around_pages = 16;
+
+// Largest number of pages faulted in ahead of a sequential run of faults.
+static uint32_t read_ahead_pages = 32;
+
+static void vm_fault_ahead_init(uint level) {
+    fault_around_pages = cmdline_get_uint32("kernel.vm.fault-around", fault_around_pages);
+    read_ahead_pages = cmdline_get_uint32("kernel.vm.read-ahead", read_ahead_pages);
+
+    // keep the fault around window to a power of two that fits in one page table
+    fault_around_pages = MIN(fault_around_pages, (uint32_t)(LARGE_PAGE_SIZE / PAGE_SIZE));
+    if (fault_around_pages > 0 && !ispow2(fault_around_pages))
+        fault_around_pages = round_up_pow2_u32(fault_around_pages) / 2;
+}
+LK_INIT_HOOK(vm_fault_ahead, &vm_fault_ahead_init, LK_INIT_LEVEL_VM);
+
 VmMapping::VmMapping(VmAddressRegion& parent, vaddr_t base, size_t size, uint32_t vmar_flags,
                      fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset, uint arch_mmu_flags)
     : VmAddressRegionOrMapping(base, size, vmar_flags,
@@ -136,6 +157,11 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         return ZX_OK;
     }
 
+    // removing all access unmaps the range
+    if (!(new_arch_mmu_flags & ARCH_MMU_FLAG_PERM_RWX_MASK)) {
+        ForgetZeroPagesLocked(base, size);
+    }
+
     // TODO(teisenbe): deal with error mapping on arch_mmu_protect fail
 
     // If we're changing the whole mapping, just make the change.
@@ -156,12 +182,13 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         if (!ac.check()) {
             return ZX_ERR_NO_MEMORY;
         }
+        mapping->access_hint_ = access_hint_;
 
         zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
         LTRACEF("arch_mmu_protect returns %d\n", status);
         arch_mmu_flags_ = new_arch_mmu_flags;
 
-        size_ = size;
+        parent_->ResizeSubregionLocked(this, size);
         mapping->ActivateLocked();
         return ZX_OK;
     }
@@ -178,11 +205,12 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
         if (!ac.check()) {
             return ZX_ERR_NO_MEMORY;
         }
+        mapping->access_hint_ = access_hint_;
 
         zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
         LTRACEF("arch_mmu_protect returns %d\n", status);
 
-        size_ -= size;
+        parent_->ResizeSubregionLocked(this, size_ - size);
         mapping->ActivateLocked();
         return ZX_OK;
     }
@@ -206,12 +234,14 @@ zx_status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mm
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
+    center_mapping->access_hint_ = access_hint_;
+    right_mapping->access_hint_ = access_hint_;
 
     zx_status_t status = ProtectOrUnmap(aspace_, base, size, new_arch_mmu_flags);
     LTRACEF("arch_mmu_protect returns %d\n", status);
 
     // Turn us into the left half
-    size_ = left_size;
+    parent_->ResizeSubregionLocked(this, left_size);
 
     center_mapping->ActivateLocked();
     right_mapping->ActivateLocked();
@@ -273,20 +303,26 @@ zx_status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
     // Check if unmapping from one of the ends
     if (base_ == base || base + size == base_ + size_) {
         LTRACEF("unmapping base %#lx size %#zx\n", base, size);
+        ForgetZeroPagesLocked(base, size);
         zx_status_t status = aspace_->arch_aspace().Unmap(base, size / PAGE_SIZE, nullptr);
         if (status < 0) {
             return status;
         }
 
-        if (base_ == base && size_ != size) {
+        if (size_ == size) {
+            size_ = 0;
+        } else {
             // We need to remove ourselves from tree before updating base_,
-            // since base_ is the tree key.
+            // since base_ is the tree key, and before updating size_, since
+            // the tree keeps track of the gaps between its regions.
             fbl::RefPtr<VmAddressRegionOrMapping> ref(parent_->subregions_.erase(*this));
-            base_ += size;
-            object_offset_ += size;
+            if (base_ == base) {
+                base_ += size;
+                object_offset_ += size;
+            }
+            size_ -= size;
             parent_->subregions_.insert(fbl::move(ref));
         }
-        size_ -= size;
 
         return ZX_OK;
     }
@@ -305,16 +341,18 @@ zx_status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
+    mapping->access_hint_ = access_hint_;
 
     // Unmap the middle segment
     LTRACEF("unmapping base %#lx size %#zx\n", base, size);
+    ForgetZeroPagesLocked(base, size);
     zx_status_t status = aspace_->arch_aspace().Unmap(base, size / PAGE_SIZE, nullptr);
     if (status < 0) {
         return status;
     }
 
     // Turn us into the left half
-    size_ = base - base_;
+    parent_->ResizeSubregionLocked(this, base - base_);
     mapping->ActivateLocked();
     return ZX_OK;
 }
@@ -378,6 +416,7 @@ zx_status_t VmMapping::UnmapVmoRangeLocked(uint64_t offset, uint64_t len) const
     LTRACEF("going to unmap %#" PRIxPTR ", len %#" PRIx64 " aspace %p\n",
             unmap_base.ValueOrDie(), len_new, aspace_.get());
 
+    ForgetZeroPagesLocked(unmap_base.ValueOrDie(), static_cast<size_t>(len_new));
     zx_status_t status = aspace_->arch_aspace().Unmap(unmap_base.ValueOrDie(),
                                                       static_cast<size_t>(len_new) / PAGE_SIZE, nullptr);
     if (status < 0)
@@ -397,14 +436,28 @@ public:
     // no longer valid.
     zx_status_t Append(vaddr_t vaddr, paddr_t paddr) {
         DEBUG_ASSERT(!aborted_);
+        const bool next_vaddr = count_ > 0 && vaddr == base_ + count_ * PAGE_SIZE;
+
+        // Physically contiguous runs are allowed to grow past the end of
+        // |phys_| so that Flush() can hand them to the MMU in one piece, which
+        // lets it use large pages where the run is suitably aligned.
+        if (next_vaddr && contiguous_ && paddr == phys_[0] + count_ * PAGE_SIZE) {
+            if (count_ < fbl::count_of(phys_)) {
+                phys_[count_] = paddr;
+            }
+            ++count_;
+            return ZX_OK;
+        }
+
         // If this isn't the expected vaddr, flush the run we have first.
-        if (count_ >= fbl::count_of(phys_) || vaddr != base_ + count_ * PAGE_SIZE) {
+        if (count_ >= fbl::count_of(phys_) || !next_vaddr) {
             zx_status_t status = Flush();
             if (status != ZX_OK) {
                 return status;
             }
             base_ = vaddr;
         }
+        contiguous_ = (count_ == 0);
         phys_[count_] = paddr;
         ++count_;
         return ZX_OK;
@@ -426,11 +479,13 @@ private:
     vaddr_t base_;
     paddr_t phys_[16];
     size_t count_;
+    // true if the pages in the run are physically contiguous
+    bool contiguous_;
     bool aborted_;
 };
 
 VmMappingCoalescer::VmMappingCoalescer(VmMapping* mapping, vaddr_t base)
-    : mapping_(mapping), base_(base), count_(0), aborted_(false) { }
+    : mapping_(mapping), base_(base), count_(0), contiguous_(true), aborted_(false) { }
 
 VmMappingCoalescer::~VmMappingCoalescer() {
     // Make sure we've flushed or aborted
@@ -445,8 +500,13 @@ zx_status_t VmMappingCoalescer::Flush() {
     uint flags = mapping_->arch_mmu_flags();
     if (flags & ARCH_MMU_FLAG_PERM_RWX_MASK) {
         size_t mapped;
-        zx_status_t ret = mapping_->aspace()->arch_aspace().Map(base_, phys_, count_, flags,
-                                                                &mapped);
+        zx_status_t ret;
+        if (contiguous_) {
+            ret = mapping_->aspace()->arch_aspace().MapContiguous(base_, phys_[0], count_, flags,
+                                                                  &mapped);
+        } else {
+            ret = mapping_->aspace()->arch_aspace().Map(base_, phys_, count_, flags, &mapped);
+        }
         if (ret != ZX_OK) {
             TRACEF("error %d mapping %zu pages starting at va %#" PRIxPTR "\n", ret, count_, base_);
             aborted_ = true;
@@ -456,6 +516,7 @@ zx_status_t VmMappingCoalescer::Flush() {
     }
     base_ += count_ * PAGE_SIZE;
     count_ = 0;
+    contiguous_ = true;
     return ZX_OK;
 }
 
@@ -545,6 +606,44 @@ zx_status_t VmMapping::DecommitRange(size_t offset, size_t len,
     return object_->DecommitRange(object_offset_ + offset, len, decommitted);
 }
 
+zx_status_t VmMapping::TakePages(size_t offset, size_t len, list_node* pages) {
+    canary_.Assert();
+    LTRACEF("%p [%#zx+%#zx], offset %#zx, len %#zx\n",
+            this, base_, size_, offset, len);
+
+    AutoLock guard(aspace_->lock());
+    if (state_ != LifeCycleState::ALIVE) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (offset + len < offset || offset + len > size_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    // taking the pages is observable as a write of zeros through this mapping
+    const uint rw = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE;
+    if ((arch_mmu_flags_ & rw) != rw) {
+        return ZX_ERR_ACCESS_DENIED;
+    }
+    return object_->TakePages(object_offset_ + offset, len, pages);
+}
+
+zx_status_t VmMapping::SupplyPages(size_t offset, size_t len, list_node* pages) {
+    canary_.Assert();
+    LTRACEF("%p [%#zx+%#zx], offset %#zx, len %#zx\n",
+            this, base_, size_, offset, len);
+
+    AutoLock guard(aspace_->lock());
+    if (state_ != LifeCycleState::ALIVE) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (offset + len < offset || offset + len > size_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    if (!(arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_WRITE)) {
+        return ZX_ERR_ACCESS_DENIED;
+    }
+    return object_->SupplyPages(object_offset_ + offset, len, pages);
+}
+
 zx_status_t VmMapping::DestroyLocked() {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
@@ -595,7 +694,215 @@ zx_status_t VmMapping::DestroyLocked() {
     return ZX_OK;
 }
 
-zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
+zx_status_t VmMapping::PageFaultLargeLocked(vaddr_t va, uint pf_flags, uint mmu_flags) {
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    // the whole run has to sit inside the mapping, at a large page aligned offset in the object
+    const vaddr_t large_va = ROUNDDOWN(va, LARGE_PAGE_SIZE);
+    if (large_va < base_ || large_va + (LARGE_PAGE_SIZE - 1) > base_ + (size_ - 1))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    const uint64_t vmo_offset = large_va - base_ + object_offset_;
+    if (!IS_ALIGNED(vmo_offset, LARGE_PAGE_SIZE))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    paddr_t new_pa;
+    zx_status_t status = object_->GetLargePageLocked(vmo_offset, pf_flags, &new_pa);
+    if (status != ZX_OK)
+        return status;
+
+    // another thread may have beaten us to it
+    uint page_flags;
+    paddr_t pa;
+    if (aspace_->arch_aspace().Query(va, &pa, &page_flags) == ZX_OK &&
+        pa == new_pa + (va - large_va) &&
+        (page_flags == arch_mmu_flags_ || page_flags == mmu_flags)) {
+        return ZX_OK;
+    }
+
+    // whatever is there now is either nothing, single pages of the same run or the same
+    // large page with other permissions, so replace it wholesale
+    const size_t count = LARGE_PAGE_SIZE / PAGE_SIZE;
+    ForgetZeroPagesLocked(large_va, LARGE_PAGE_SIZE);
+    status = aspace_->arch_aspace().Unmap(large_va, count, nullptr);
+    if (status < 0) {
+        TRACEF("failed to remove old mappings before mapping large page\n");
+        return status;
+    }
+
+    size_t mapped;
+    status = aspace_->arch_aspace().MapContiguous(large_va, new_pa, count, mmu_flags, &mapped);
+    if (status < 0) {
+        TRACEF("failed to map large page\n");
+        return status;
+    }
+    DEBUG_ASSERT(mapped == count);
+
+    LTRACEF("mapped large page pa %#" PRIxPTR " at va %#" PRIxPTR "\n", new_pa, large_va);
+
+#if ARCH_ARM64
+    if (!(pf_flags & VMM_PF_FLAG_GUEST) && (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)) {
+        arch_sync_cache_range(large_va, LARGE_PAGE_SIZE);
+    }
+#endif
+    return ZX_OK;
+}
+
+void VmMapping::ZeroPagesMappedLocked(size_t count) const {
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+    object_->ZeroPagesMappedLocked(count);
+    aspace_->zero_mapped_pages_.fetch_add(count, fbl::memory_order_relaxed);
+}
+
+void VmMapping::ForgetZeroPagesLocked(vaddr_t base, size_t size) const {
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    // zero page mappings are only looked for while the object has some, and only
+    // until all of them have been found
+    const size_t mapped = object_->zero_mapped_pages_locked();
+    size_t found = 0;
+    for (vaddr_t va = base; va < base + size && found < mapped; va += PAGE_SIZE) {
+        paddr_t pa;
+        if (aspace_->arch_aspace().Query(va, &pa, nullptr) == ZX_OK &&
+            pa == vm_get_zero_page_paddr()) {
+            found++;
+        }
+    }
+    if (found == 0)
+        return;
+
+    object_->ZeroPagesUnmappedLocked(found);
+    aspace_->zero_mapped_pages_.fetch_sub(found, fbl::memory_order_relaxed);
+}
+
+bool VmMapping::MapSpeculativeLocked(vaddr_t va, uint pf_flags, uint mmu_flags) {
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    paddr_t pa;
+    uint page_flags;
+    if (aspace_->arch_aspace().Query(va, &pa, &page_flags) >= 0)
+        return false;
+
+    uint64_t vmo_offset = va - base_ + object_offset_;
+    if (object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, &pa) != ZX_OK)
+        return false;
+
+    // assert that we're not accidentally mapping the zero page writable
+    DEBUG_ASSERT((pa != vm_get_zero_page_paddr()) || !(mmu_flags & ARCH_MMU_FLAG_PERM_WRITE));
+
+    size_t mapped;
+    if (aspace_->arch_aspace().MapContiguous(va, pa, 1, mmu_flags, &mapped) != ZX_OK)
+        return false;
+    if (pa == vm_get_zero_page_paddr())
+        ZeroPagesMappedLocked(1);
+
+#if ARCH_ARM64
+    if (!(pf_flags & VMM_PF_FLAG_GUEST) && (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)) {
+        arch_sync_cache_range(va, PAGE_SIZE);
+    }
+#endif
+    return true;
+}
+
+void VmMapping::FaultAheadLocked(vaddr_t va, uint pf_flags, uint mmu_flags) {
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    // faults on a randomly accessed mapping say nothing about its other pages
+    if (access_hint_ == VmRangeHint::Random)
+        return;
+
+    const vaddr_t last = base_ + size_ - 1;
+
+    // a fault on the page right after the last one (or after the pages we read
+    // ahead of it) continues a sequential run, so fault in a growing window of
+    // pages ahead of it the same way the fault itself was handled. Mappings
+    // that are known to be read sequentially get the whole window right away.
+    if (read_ahead_pages > 0) {
+        if (access_hint_ == VmRangeHint::Sequential) {
+            read_ahead_window_ = read_ahead_pages;
+        } else if (va == next_fault_va_) {
+            read_ahead_window_ = MIN(MAX(read_ahead_window_ * 2, 4u), read_ahead_pages);
+        } else {
+            read_ahead_window_ = 0;
+        }
+
+        vaddr_t ahead = va + PAGE_SIZE;
+        for (uint32_t i = 0; i < read_ahead_window_ && ahead > va && ahead <= last; i++) {
+            if (MapSpeculativeLocked(ahead, pf_flags, mmu_flags))
+                aspace_->fault_stats_.read_ahead_pages++;
+            ahead += PAGE_SIZE;
+        }
+        next_fault_va_ = ahead;
+    }
+
+    // writes need a page of their own, so only read faults map what the object
+    // already has around them
+    if (fault_around_pages > 1 && !(pf_flags & VMM_PF_FLAG_WRITE)) {
+        const size_t window = fault_around_pages * PAGE_SIZE;
+        vaddr_t start = MAX(ROUNDDOWN(va, window), base_);
+        vaddr_t end = MIN(ROUNDDOWN(va, window) + (window - 1), last);
+
+        // only map what is resident, and map it read only
+        const uint around_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK | VMM_PF_FLAG_WRITE);
+        const uint around_mmu_flags = mmu_flags & ~ARCH_MMU_FLAG_PERM_WRITE;
+        for (vaddr_t v = start; v <= end && v >= start; v += PAGE_SIZE) {
+            if (v == va)
+                continue;
+            if (MapSpeculativeLocked(v, around_pf_flags, around_mmu_flags))
+                aspace_->fault_stats_.fault_around_pages++;
+        }
+    }
+}
+
+zx_status_t VmMapping::HintRangeLocked(vaddr_t base, size_t size, VmRangeHint hint) {
+    canary_.Assert();
+    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(size != 0 && IS_PAGE_ALIGNED(size) && IS_PAGE_ALIGNED(base));
+    DEBUG_ASSERT(base >= base_ && base - base_ < size_);
+    DEBUG_ASSERT(size_ - (base - base_) >= size);
+
+    if (state_ != LifeCycleState::ALIVE) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    LTRACEF("%p %#" PRIxPTR " %zu hint %d\n", this, base, size, static_cast<int>(hint));
+
+    const uint64_t vmo_offset = base - base_ + object_offset_;
+
+    switch (hint) {
+    case VmRangeHint::Normal:
+    case VmRangeHint::Sequential:
+    case VmRangeHint::Random:
+        // access patterns are kept per mapping, not per page
+        access_hint_ = hint;
+        next_fault_va_ = 0;
+        read_ahead_window_ = 0;
+        return ZX_OK;
+    case VmRangeHint::DontNeed:
+        // VmObject::HintRange() unmaps whatever it gives up through UnmapVmoRangeLocked()
+        return object_->HintRange(vmo_offset, size, VmObject::RangeHint::DontNeed);
+    case VmRangeHint::WillNeed: {
+        zx_status_t status =
+            object_->HintRange(vmo_offset, size, VmObject::RangeHint::WillNeed);
+        if (status != ZX_OK)
+            return status;
+        if (!(arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_READ))
+            return ZX_OK;
+
+        // map what the object has now, read only the same way fault around does, so the
+        // first touch of each page does not fault
+        AutoLock al(object_->lock());
+        const uint mmu_flags = arch_mmu_flags_ & ~ARCH_MMU_FLAG_PERM_WRITE;
+        for (vaddr_t va = base; va < base + size; va += PAGE_SIZE) {
+            MapSpeculativeLocked(va, 0, mmu_flags);
+        }
+        return ZX_OK;
+    }
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -642,15 +949,18 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     currently_faulting_ = true;
     auto ac = fbl::MakeAutoCall([&]() { currently_faulting_ = false; });
 
-    // fault in or grab an existing page
-    paddr_t new_pa;
-    vm_page_t* page;
-    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
-    if (status < 0) {
-        TRACEF("ERROR: failed to fault in or grab existing page\n");
-        TRACEF("%p vmo_offset %#" PRIx64 ", pf_flags %#x\n", this, vmo_offset, pf_flags);
-        return status;
-    }
+    // charge any pages the object had to decompress for us, including the ones mapped
+    // around the fault, to this fault
+    thread_t* current_thread = get_current_thread();
+    const uint64_t decompressed_pages = current_thread->vm_decompressed_pages;
+    const zx_duration_t decompress_ns = current_thread->vm_decompress_ns;
+    auto charge = fbl::MakeAutoCall([&]() {
+        if (current_thread->vm_decompressed_pages != decompressed_pages) {
+            aspace_->fault_stats_.decompress_faults++;
+            aspace_->fault_stats_.decompress_ns +=
+                current_thread->vm_decompress_ns - decompress_ns;
+        }
+    });
 
     // if we read faulted, make sure we map or modify the page without any write permissions
     // this ensures we will fault again if a write is attempted so we can potentially
@@ -661,6 +971,26 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
         mmu_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
     }
 
+    // see if the object can back the whole large page around us, otherwise fall back to
+    // mapping just the one page
+    if (PageFaultLargeLocked(va, pf_flags, mmu_flags) == ZX_OK)
+        return ZX_OK;
+
+    // fault in or grab an existing page
+    paddr_t new_pa;
+    vm_page_t* page;
+    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
+    if (status == ZX_ERR_SHOULD_WAIT) {
+        // the caller waits for the page with all the locks dropped and tries again
+        status = object_->QueuePageRequestLocked(vmo_offset, page_request);
+        return status == ZX_OK ? ZX_ERR_SHOULD_WAIT : status;
+    }
+    if (status < 0) {
+        TRACEF("ERROR: failed to fault in or grab existing page\n");
+        TRACEF("%p vmo_offset %#" PRIx64 ", pf_flags %#x\n", this, vmo_offset, pf_flags);
+        return status;
+    }
+
     // see if something is mapped here now
     // this may happen if we are one of multiple threads racing on a single address
     uint page_flags;
@@ -695,6 +1025,7 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
             DEBUG_ASSERT((new_pa != vm_get_zero_page_paddr()) || !(mmu_flags & ARCH_MMU_FLAG_PERM_WRITE));
 
             // unmap the old one and put the new one in place
+            ForgetZeroPagesLocked(va, PAGE_SIZE);
             status = aspace_->arch_aspace().Unmap(va, 1, nullptr);
             if (status < 0) {
                 TRACEF("failed to remove old mapping before replacing\n");
@@ -708,6 +1039,8 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
                 return ZX_ERR_NO_MEMORY;
             }
             DEBUG_ASSERT(mapped == 1);
+            if (new_pa == vm_get_zero_page_paddr())
+                ZeroPagesMappedLocked(1);
 
             return ZX_OK;
         }
@@ -726,6 +1059,12 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
             return ZX_ERR_NO_MEMORY;
         }
         DEBUG_ASSERT(mapped == 1);
+        if (new_pa == vm_get_zero_page_paddr())
+            ZeroPagesMappedLocked(1);
+
+        aspace_->fault_stats_.faults++;
+
+        FaultAheadLocked(va, pf_flags, mmu_flags);
     }
 
 // TODO: figure out what to do with this
@@ -0,0 +1,100 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/vm_merged_pages.h>
+#include <vm/vm_object_paged.h>
+
+#include "vm_priv.h"
+
+#include <fbl/auto_lock.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/console.h>
+#include <lk/init.h>
+#include <stdio.h>
+#include <string.h>
+#include <trace.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// How long the scanner sleeps between scans, and how many pages it looks at
+// in each.
+static zx_duration_t merge_interval;
+static size_t merge_pages;
+
+static int vm_merge_thread(void*) {
+    for (;;) {
+        thread_sleep_relative(merge_interval);
+
+        size_t freed = VmObjectPaged::ScanMergeable(merge_pages);
+        LTRACEF("freed %zu pages\n", freed);
+    }
+    return 0;
+}
+
+static void vm_merge_init(uint level) {
+    // Be sure to update kernel_cmdline.md if any of these defaults change.
+    if (!cmdline_get_bool("kernel.vm.merge.enable", true))
+        return;
+    merge_interval = ZX_MSEC(cmdline_get_uint64("kernel.vm.merge.interval-ms", 200));
+    merge_pages = cmdline_get_uint64("kernel.vm.merge.pages", 1000);
+    if (merge_interval == 0)
+        merge_interval = ZX_MSEC(1);
+    if (merge_pages == 0)
+        return;
+
+    // the scan only ever saves memory, it should not delay anything else
+    thread_t* t = thread_create("vm merge", &vm_merge_thread, nullptr,
+                                LOW_PRIORITY, DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("VM: failed to create the merge thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+LK_INIT_HOOK_DEFERRED(vm_merge, &vm_merge_init, LK_INIT_LEVEL_THREADING);
+
+#if WITH_LIB_CONSOLE
+
+static int cmd_merge(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+    notenoughargs:
+        printf("not enough arguments\n");
+    usage:
+        printf("usage:\n");
+        printf("%s info                : same-page merging statistics\n", argv[0].str);
+        printf("%s scan <pages>        : look at up to <pages> pages of mergeable VMOs now\n",
+               argv[0].str);
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (!strcmp(argv[1].str, "info")) {
+        VmMergedPages::Stats stats;
+        {
+            fbl::AutoLock a(VmMergedPages::lock());
+            VmMergedPages::GetStatsLocked(&stats);
+        }
+        printf("merged pages %zu, saving %zu pages, %zu hashes seen this round\n",
+               stats.merged_pages, stats.saved_pages, stats.seen_hashes);
+    } else if (!strcmp(argv[1].str, "scan")) {
+        if (argc < 3)
+            goto notenoughargs;
+        size_t freed = VmObjectPaged::ScanMergeable(argv[2].u);
+        printf("freed %zu pages\n", freed);
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+
+    return ZX_OK;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("merge", "same-page merging", &cmd_merge)
+STATIC_COMMAND_END(merge);
+
+#endif // WITH_LIB_CONSOLE
@@ -0,0 +1,146 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/vm_merged_pages.h>
+
+#include "vm_priv.h"
+
+#include <assert.h>
+#include <err.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/unique_ptr.h>
+#include <inttypes.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/physmap.h>
+#include <vm/pmm.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+fbl::Mutex VmMergedPages::lock_ = {};
+
+namespace {
+
+struct MergedPage : public fbl::WAVLTreeContainable<fbl::unique_ptr<MergedPage>> {
+    uint64_t GetKey() const { return hash; }
+
+    uint64_t hash;
+    vm_page_t* page;
+};
+
+struct SeenHash : public fbl::WAVLTreeContainable<fbl::unique_ptr<SeenHash>> {
+    uint64_t GetKey() const { return hash; }
+
+    uint64_t hash;
+};
+
+// One merged page per hash, a page whose hash collides with a different merged
+// page is left alone.
+fbl::WAVLTree<uint64_t, fbl::unique_ptr<MergedPage>> merged_pages
+    TA_GUARDED(VmMergedPages::lock());
+fbl::WAVLTree<uint64_t, fbl::unique_ptr<SeenHash>> seen_hashes
+    TA_GUARDED(VmMergedPages::lock());
+size_t saved_pages TA_GUARDED(VmMergedPages::lock());
+
+const void* PageData(const vm_page_t* page) {
+    return paddr_to_physmap(vm_page_to_paddr(page));
+}
+
+} // namespace
+
+uint64_t VmMergedPages::Hash(const void* page) {
+    // FNV-1a a word at a time, only used to find candidates that are then compared
+    const uint64_t* words = static_cast<const uint64_t*>(page);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        hash ^= words[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+vm_page_t* VmMergedPages::FindLocked(uint64_t hash, const void* data) {
+    auto iter = merged_pages.find(hash);
+    if (!iter.IsValid())
+        return nullptr;
+    if (memcmp(PageData(iter->page), data, PAGE_SIZE) != 0)
+        return nullptr;
+    return iter->page;
+}
+
+bool VmMergedPages::SeenLocked(uint64_t hash) {
+    if (seen_hashes.find(hash).IsValid())
+        return true;
+
+    // forgetting a page only costs a missed merge
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<SeenHash> seen(new (&ac) SeenHash());
+    if (ac.check()) {
+        seen->hash = hash;
+        seen_hashes.insert(fbl::move(seen));
+    }
+    return false;
+}
+
+void VmMergedPages::ClearSeenLocked() {
+    seen_hashes.clear();
+}
+
+zx_status_t VmMergedPages::AddLocked(vm_page_t* page, uint64_t hash) {
+    DEBUG_ASSERT(page->state == VM_PAGE_STATE_OBJECT);
+    DEBUG_ASSERT(!page->object.merged);
+    DEBUG_ASSERT(page->object.pin_count == 0);
+
+    if (merged_pages.find(hash).IsValid())
+        return ZX_ERR_ALREADY_EXISTS;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<MergedPage> merged(new (&ac) MergedPage());
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    merged->hash = hash;
+    merged->page = page;
+    merged_pages.insert(fbl::move(merged));
+
+    page->object.merged = true;
+    page->object.merge_count = 1;
+
+    LTRACEF("page %p hash %#" PRIx64 "\n", page, hash);
+    return ZX_OK;
+}
+
+void VmMergedPages::HoldLocked(vm_page_t* page) {
+    DEBUG_ASSERT(page->object.merged);
+    DEBUG_ASSERT(page->object.merge_count > 0);
+
+    page->object.merge_count++;
+    saved_pages++;
+}
+
+bool VmMergedPages::ReleaseLocked(vm_page_t* page) {
+    DEBUG_ASSERT(page->object.merged);
+    DEBUG_ASSERT(page->object.merge_count > 0);
+
+    if (--page->object.merge_count > 0) {
+        saved_pages--;
+        return false;
+    }
+
+    // the contents have not changed since the page was merged, so neither has the hash
+    __UNUSED auto merged = merged_pages.erase(Hash(PageData(page)));
+    DEBUG_ASSERT(merged && merged->page == page);
+    page->object.merged = false;
+
+    LTRACEF("page %p\n", page);
+    return true;
+}
+
+void VmMergedPages::GetStatsLocked(Stats* stats) {
+    stats->merged_pages = merged_pages.size();
+    stats->saved_pages = saved_pages;
+    stats->seen_hashes = seen_hashes.size();
+}
@@ -87,6 +87,7 @@ void VmObject::set_user_id(uint64_t user_id) {
     AutoLock a(&lock_);
     DEBUG_ASSERT(user_id_ == 0);
     user_id_ = user_id;
+    OnUserIdSetLocked();
 }
 
 uint64_t VmObject::user_id() const {
@@ -137,6 +138,12 @@ uint32_t VmObject::num_mappings() const {
     return mapping_list_len_;
 }
 
+size_t VmObject::zero_mapped_pages() const {
+    canary_.Assert();
+    AutoLock a(&lock_);
+    return zero_mapped_pages_;
+}
+
 bool VmObject::IsMappedByUser() const {
     canary_.Assert();
     AutoLock a(&lock_);
@@ -207,6 +214,8 @@ void VmObject::RemoveChildLocked(VmObject* o) {
     children_list_.erase(*o);
     DEBUG_ASSERT(children_list_len_ > 0);
     children_list_len_--;
+    if (children_list_len_ == 0)
+        OnZeroChildrenLocked();
 }
 
 uint32_t VmObject::num_children() const {
@@ -215,6 +224,17 @@ uint32_t VmObject::num_children() const {
     return children_list_len_;
 }
 
+fbl::RefPtr<VmObject> VmObject::GetOnlyChild() {
+    canary_.Assert();
+    AutoLock a(&lock_);
+    if (children_list_len_ != 1)
+        return nullptr;
+
+    // a child whose last reference is gone is on its way through the destructor, which
+    // takes it off the list under the lock
+    return fbl::internal::MakeRefPtrUpgradeFromRaw(&children_list_.front(), lock_);
+}
+
 void VmObject::RangeChangeUpdateLocked(uint64_t offset, uint64_t len) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
@@ -15,6 +15,8 @@
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <lib/console.h>
+#include <lib/counters.h>
+#include <platform.h>
 #include <safeint/safe_math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,8 +31,42 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(reclaim_aged, "kernel.vm.reclaim.aged");
+KCOUNTER(reclaim_rotated, "kernel.vm.reclaim.rotated");
+KCOUNTER(reclaim_discarded, "kernel.vm.reclaim.discarded");
+KCOUNTER(reclaim_pages_freed, "kernel.vm.reclaim.pages_freed");
+KCOUNTER(compress_aged, "kernel.vm.compress.aged");
+KCOUNTER(compress_rotated, "kernel.vm.compress.rotated");
+KCOUNTER(compress_pages_freed, "kernel.vm.compress.pages_freed");
+KCOUNTER(compress_zero_pages, "kernel.vm.compress.zero_pages");
+KCOUNTER(merge_scanned, "kernel.vm.merge.scanned");
+KCOUNTER(merge_merged, "kernel.vm.merge.merged");
+KCOUNTER(merge_zero_pages, "kernel.vm.merge.zero_pages");
+KCOUNTER(merge_promoted, "kernel.vm.merge.promoted");
+KCOUNTER(merge_unmerged, "kernel.vm.merge.unmerged");
+KCOUNTER(merge_scan_ns, "kernel.vm.merge.scan_ns");
+KCOUNTER(clone_collapsed, "kernel.vm.clone.collapsed");
+KCOUNTER(clone_pages_migrated, "kernel.vm.clone.pages_migrated");
+KCOUNTER(hint_dont_need_pages, "kernel.vm.hint.dont_need_pages");
+KCOUNTER(hint_will_need_pages, "kernel.vm.hint.will_need_pages");
+
+fbl::Mutex VmObjectPaged::reclaim_lock_ = {};
+VmObjectPaged::ReclaimList VmObjectPaged::reclaim_active_ = {};
+VmObjectPaged::ReclaimList VmObjectPaged::reclaim_inactive_ = {};
+VmObjectPaged::ReclaimList VmObjectPaged::compress_active_ = {};
+VmObjectPaged::ReclaimList VmObjectPaged::compress_inactive_ = {};
+VmObjectPaged::ReclaimStats VmObjectPaged::reclaim_stats_ = {};
+VmObjectPaged::MergeList VmObjectPaged::merge_list_ = {};
+size_t VmObjectPaged::merge_objects_ = 0;
+size_t VmObjectPaged::merge_round_left_ = 0;
+
 namespace {
 
+// Writes at least this large are copied with non-temporal stores, since
+// they would otherwise evict more of the cache than is likely to be read
+// back from the VMO soon.
+constexpr size_t kNonTemporalWriteThreshold = 1024 * 1024;
+
 void ZeroPage(paddr_t pa) {
     void* ptr = paddr_to_physmap(pa);
     DEBUG_ASSERT(ptr);
@@ -43,11 +79,22 @@ void ZeroPage(vm_page_t* p) {
     ZeroPage(pa);
 }
 
+bool IsZeroPage(const void* page) {
+    const uint64_t* words = static_cast<const uint64_t*>(page);
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (words[i] != 0)
+            return false;
+    }
+    return true;
+}
+
 void InitializeVmPage(vm_page_t* p) {
     DEBUG_ASSERT(p->state == VM_PAGE_STATE_ALLOC);
     p->state = VM_PAGE_STATE_OBJECT;
     p->object.pin_count = 0;
     p->object.contiguous_pin = 0;
+    p->object.merged = 0;
+    p->object.merge_count = 0;
 }
 
 // round up the size to the next page size boundary and make sure we dont wrap
@@ -65,8 +112,10 @@ zx_status_t RoundSize(uint64_t size, uint64_t* out_size) {
 
 } // namespace
 
-VmObjectPaged::VmObjectPaged(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject> parent)
-    : VmObject(fbl::move(parent)), size_(size), pmm_alloc_flags_(pmm_alloc_flags) {
+VmObjectPaged::VmObjectPaged(uint32_t pmm_alloc_flags, uint32_t options, uint64_t size,
+                             fbl::RefPtr<VmObject> parent)
+    : VmObject(fbl::move(parent)), size_(size), pmm_alloc_flags_(pmm_alloc_flags),
+      options_(options) {
     LTRACEF("%p\n", this);
 
     DEBUG_ASSERT(IS_PAGE_ALIGNED(size_));
@@ -77,6 +126,11 @@ VmObjectPaged::~VmObjectPaged() {
 
     LTRACEF("%p\n", this);
 
+    // nothing can be waiting on us, requests hold a reference
+    DEBUG_ASSERT(page_requests_.is_empty());
+    if (page_source_)
+        page_source_->OnDetach();
+
     page_list_.ForEveryPage(
         [](const auto p, uint64_t off) {
             if (p->object.contiguous_pin) {
@@ -86,21 +140,68 @@ VmObjectPaged::~VmObjectPaged() {
             return ZX_ERR_NEXT;
         });
 
+    RemoveFromReclaimList();
+
+    {
+        AutoLock a(VmMergedPages::lock());
+        if (merge_list_state_.InContainer()) {
+            merge_list_.erase(*this);
+            merge_objects_--;
+        }
+    }
+    if (has_merged_pages_) {
+        AutoLock a(&lock_);
+        ReleaseMergedPagesLocked(0, size_);
+    }
+
     // free all of the pages attached to us
     page_list_.FreeAllPages();
 }
 
 zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* obj) {
+    return Create(pmm_alloc_flags, 0u, size, obj);
+}
+
+zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint32_t options, uint64_t size,
+                                  fbl::RefPtr<VmObject>* obj) {
+    if (options & ~(kLargePages | kDiscardable))
+        return ZX_ERR_INVALID_ARGS;
+
+    // make sure size is page aligned
+    zx_status_t status = RoundSize(size, &size);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::AllocChecker ac;
+    auto vmo = fbl::AdoptRef<VmObject>(new (&ac) VmObjectPaged(pmm_alloc_flags, options, size,
+                                                               nullptr));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *obj = fbl::move(vmo);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::CreateExternal(fbl::RefPtr<PageSource> source, uint64_t size,
+                                          fbl::RefPtr<VmObjectPaged>* obj) {
     // make sure size is page aligned
     zx_status_t status = RoundSize(size, &size);
     if (status != ZX_OK)
         return status;
 
     fbl::AllocChecker ac;
-    auto vmo = fbl::AdoptRef<VmObject>(new (&ac) VmObjectPaged(pmm_alloc_flags, size, nullptr));
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(PMM_ALLOC_FLAG_ANY, 0u, size,
+                                                                    nullptr));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
+    // nobody else can see the object yet
+    {
+        AutoLock a(&vmo->lock_);
+        vmo->page_source_ = fbl::move(source);
+    }
+
     *obj = fbl::move(vmo);
 
     return ZX_OK;
@@ -111,13 +212,33 @@ zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_na
 
     canary_.Assert();
 
+    // a clone would keep reading the pages of a discarded parent
+    if (options_ & kDiscardable)
+        return ZX_ERR_NOT_SUPPORTED;
+
     // make sure size is page aligned
     zx_status_t status = RoundSize(size, &size);
     if (status != ZX_OK)
         return status;
 
+    // repeated clones of a clone whose handle is closed each time would otherwise grow the
+    // chain without bound
+    CollapseHiddenParents();
+
+    {
+        AutoLock a(&lock_);
+
+        // every object in the chain shares our lock
+        uint32_t depth = 1;
+        for (VmObject* o = parent_.get(); o; o = static_cast<VmObjectPaged*>(o)->parent_.get()) {
+            if (++depth > kMaxCloneDepth)
+                return ZX_ERR_NO_RESOURCES;
+        }
+    }
+
     fbl::AllocChecker ac;
-    auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(pmm_alloc_flags_, size, fbl::WrapRefPtr(this)));
+    // clones fill in their pages one at a time, don't pass the large page option on
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(pmm_alloc_flags_, 0u, size, fbl::WrapRefPtr(this)));
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
@@ -134,6 +255,8 @@ zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_na
     if (copy_name)
         vmo->name_ = name_;
 
+    children_created_++;
+
     *clone_vmo = fbl::move(vmo);
 
     return ZX_OK;
@@ -157,8 +280,8 @@ void VmObjectPaged::Dump(uint depth, bool verbose) {
         printf("  ");
     }
     printf("vmo %p/k%" PRIu64 " size %#" PRIx64
-           " pages %zu ref %d parent k%" PRIu64 "\n",
-           this, user_id_, size_, count, ref_count_debug(), parent_id);
+           " pages %zu compressed %zu ref %d parent k%" PRIu64 "\n",
+           this, user_id_, size_, count, compressed_.page_count(), ref_count_debug(), parent_id);
 
     if (verbose) {
         auto f = [depth](const auto p, uint64_t offset) {
@@ -192,6 +315,19 @@ size_t VmObjectPaged::AllocatedPagesInRange(uint64_t offset, uint64_t len) const
     return count;
 }
 
+size_t VmObjectPaged::CompressedPagesInRange(uint64_t offset, uint64_t len,
+                                             size_t* stored_bytes) const {
+    canary_.Assert();
+    AutoLock a(&lock_);
+    *stored_bytes = 0;
+    uint64_t new_len;
+    if (!TrimRange(offset, len, size_, &new_len)) {
+        return 0;
+    }
+    return compressed_.CountInRange(ROUNDDOWN(offset, PAGE_SIZE), offset + new_len,
+                                    stored_bytes);
+}
+
 zx_status_t VmObjectPaged::AddPage(vm_page_t* p, uint64_t offset) {
     AutoLock a(&lock_);
 
@@ -283,12 +419,23 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     if (offset >= size_)
         return ZX_ERR_OUT_OF_RANGE;
 
+    // only lookups through this path count as a use for aging, faults on pages that are
+    // already mapped are not seen
+    reclaim_referenced_.store(true, fbl::memory_order_relaxed);
+
     vm_page_t* p;
     paddr_t pa;
 
     // see if we already have a page at that offset
     p = page_list_.GetPage(offset);
     if (p) {
+        // nobody writes to a page shared with other objects, writers get their own copy
+        if ((pf_flags & VMM_PF_FLAG_WRITE) && p->state == VM_PAGE_STATE_OBJECT &&
+            p->object.merged) {
+            zx_status_t status = UnmergePageLocked(offset, p, free_list, &p);
+            if (status != ZX_OK)
+                return status;
+        }
         if (page_out)
             *page_out = p;
         if (pa_out)
@@ -300,8 +447,15 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     LTRACEF("vmo %p, offset %#" PRIx64 ", pf_flags %#x (%s)\n", this, offset, pf_flags,
             vmm_pf_flags_to_string(pf_flags, pf_string));
 
+    // a compressed page is still ours, whether or not we were asked to fault it in
+    if (!compressed_.is_empty()) {
+        zx_status_t status = DecompressPageLocked(offset, free_list, page_out, pa_out);
+        if (status != ZX_ERR_NOT_FOUND)
+            return status;
+    }
+
     // if we have a parent see if they have a page for us
-    if (parent_) {
+    if (parent_ && offset < parent_limit_) {
         safeint::CheckedNumeric<uint64_t> parent_offset = parent_offset_;
         parent_offset += offset;
         DEBUG_ASSERT(parent_offset.IsValid());
@@ -311,6 +465,12 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
         zx_status_t status = parent_->GetPageLocked(parent_offset.ValueOrDie(), parent_pf_flags,
                                                     nullptr, &p, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT || status == ZX_ERR_BAD_STATE ||
+            status == ZX_ERR_NO_MEMORY) {
+            // the page has to come from the parent's page source, or be decompressed by the
+            // parent, first
+            return status;
+        }
         if (status == ZX_OK) {
             // we have a page from them. if we're read-only faulting, return that page so they can map
             // or read from it directly
@@ -367,6 +527,13 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         }
     }
 
+    // an object with a page source never makes up pages of its own, the caller has to
+    // queue a page request and wait for the source to supply this one
+    if (page_source_)
+        return ZX_ERR_SHOULD_WAIT;
+    if (page_source_detached_)
+        return ZX_ERR_BAD_STATE;
+
     // if we're not being asked to sw or hw fault in the page, return not found
     if ((pf_flags & VMM_PF_FLAG_FAULT_MASK) == 0)
         return ZX_ERR_NOT_FOUND;
@@ -382,7 +549,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_OK;
     }
 
-    // allocate a page
+    // allocate a zeroed page, pages handed to us on |free_list| are already zeroed
     if (free_list) {
         p = list_remove_head_type(free_list, vm_page_t, free.node);
         if (p) {
@@ -390,7 +557,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         }
     }
     if (!p) {
-        p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+        p = pmm_alloc_zeroed_page(pmm_alloc_flags_, &pa);
     }
     if (!p) {
         return ZX_ERR_NO_MEMORY;
@@ -398,9 +565,6 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     InitializeVmPage(p);
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
-
     zx_status_t status = AddPageLocked(p, offset);
     DEBUG_ASSERT(status == ZX_OK);
 
@@ -417,6 +581,97 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::CommitLargePageLocked(uint64_t offset) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(IS_ALIGNED(offset, LARGE_PAGE_SIZE));
+    DEBUG_ASSERT(offset < size_ && size_ - offset >= LARGE_PAGE_SIZE);
+
+    const size_t count = LARGE_PAGE_SIZE / PAGE_SIZE;
+
+    list_node page_list;
+    list_initialize(&page_list);
+
+    size_t allocated = pmm_alloc_contiguous(count, pmm_alloc_flags_, LARGE_PAGE_SIZE_SHIFT,
+                                            nullptr, &page_list);
+    if (allocated < count) {
+        LTRACEF("failed to allocate a large page at offset %#" PRIx64 "\n", offset);
+        pmm_free(&page_list);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    for (uint64_t o = offset; o < offset + LARGE_PAGE_SIZE; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(&page_list, vm_page_t, free.node);
+        ASSERT(p);
+
+        InitializeVmPage(p);
+        ZeroPage(p);
+
+        auto status = page_list_.AddPage(p, o);
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+
+    // other mappings may have covered this range of the vmo, so unmap those ranges
+    RangeChangeUpdateLocked(offset, LARGE_PAGE_SIZE);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::GetLargePageLocked(uint64_t offset, uint pf_flags, paddr_t* pa_out) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(IS_ALIGNED(offset, LARGE_PAGE_SIZE));
+
+    // clones may share pages with their parent, so only ever map them a page at a time
+    if (!(options_ & kLargePages) || parent_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (offset >= size_ || size_ - offset < LARGE_PAGE_SIZE)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    const uint64_t end = offset + LARGE_PAGE_SIZE;
+
+    // see how much of the run is already there, and whether it is contiguous
+    size_t count = 0;
+    paddr_t base = 0;
+    bool contiguous = true;
+    page_list_.ForEveryPageInRange(
+        [&](const auto p, uint64_t off) {
+            paddr_t pa = vm_page_to_paddr(p);
+            if (count == 0) {
+                base = pa - (off - offset);
+            }
+            if (pa != base + (off - offset)) {
+                contiguous = false;
+                return ZX_ERR_STOP;
+            }
+            count++;
+            return ZX_ERR_NEXT;
+        },
+        offset, end);
+
+    if (count == 0) {
+        if ((pf_flags & VMM_PF_FLAG_FAULT_MASK) == 0)
+            return ZX_ERR_NOT_FOUND;
+
+        zx_status_t status = CommitLargePageLocked(offset);
+        if (status != ZX_OK)
+            return status;
+
+        base = vm_page_to_paddr(page_list_.GetPage(offset));
+    } else if (!contiguous || count != LARGE_PAGE_SIZE / PAGE_SIZE) {
+        // partially committed or assembled a page at a time
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    if (!IS_ALIGNED(base, LARGE_PAGE_SIZE))
+        return ZX_ERR_NOT_FOUND;
+
+    *pa_out = base;
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) {
     canary_.Assert();
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
@@ -440,6 +695,27 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     DEBUG_ASSERT(end > offset);
     offset = ROUNDDOWN(offset, PAGE_SIZE);
 
+    // commit whole empty runs as large pages first if the object wants them, the rest of
+    // the range is filled in a page at a time below
+    uint64_t large_committed = 0;
+    if ((options_ & kLargePages) && !parent_ && !page_source_) {
+        for (uint64_t o = ROUNDUP(offset, LARGE_PAGE_SIZE);
+             o < end && end - o >= LARGE_PAGE_SIZE; o += LARGE_PAGE_SIZE) {
+            bool empty = true;
+            page_list_.ForEveryPageInRange(
+                [&empty](const auto p, uint64_t off) {
+                    empty = false;
+                    return ZX_ERR_STOP;
+                },
+                o, o + LARGE_PAGE_SIZE);
+
+            if (empty && CommitLargePageLocked(o) == ZX_OK)
+                large_committed += LARGE_PAGE_SIZE;
+        }
+        if (committed)
+            *committed += large_committed;
+    }
+
     // make a pass through the list, counting the number of pages we need to allocate
     size_t count = 0;
     uint64_t expected_next_off = offset;
@@ -459,11 +735,11 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     if (count == 0)
         return ZX_OK;
 
-    // allocate count number of pages
+    // allocate count number of pages, unless they all come from a page source
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    size_t allocated = page_source_ ? count : pmm_alloc_zeroed_pages(count, pmm_alloc_flags_, &page_list);
     if (allocated < count) {
         LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
         pmm_free(&page_list);
@@ -485,18 +761,36 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
         paddr_t pa;
         const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
         // Should not be able to fail, since we're providing it memory and the
-        // range should be valid.
+        // range should be valid, unless the page has to come from a page source.
         zx_status_t status = GetPageLocked(o, flags, &page_list, &p, &pa);
-        ASSERT(status == ZX_OK);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            // the lock is dropped while waiting, look at this offset again afterwards
+            status = WaitForPageLocked(o);
+            if (status != ZX_OK) {
+                pmm_free(&page_list);
+                return status;
+            }
+            o -= PAGE_SIZE;
+            continue;
+        }
+        if (status != ZX_OK) {
+            // only a detached page source or a concurrent resize gets here
+            DEBUG_ASSERT(status == ZX_ERR_BAD_STATE || status == ZX_ERR_OUT_OF_RANGE);
+            pmm_free(&page_list);
+            return status;
+        }
 
         if (committed)
             *committed += PAGE_SIZE;
     }
 
-    DEBUG_ASSERT(list_is_empty(&page_list));
+    // pages supplied by a page source leave some of the ones allocated above unused
+    if (!list_is_empty(&page_list))
+        pmm_free(&page_list);
 
-    // for now we only support committing as much as we were asked for
-    DEBUG_ASSERT(!committed || *committed == count * PAGE_SIZE);
+    // for now we only support committing as much as we were asked for, pages supplied while
+    // we waited are not counted
+    DEBUG_ASSERT(!committed || *committed <= count * PAGE_SIZE + large_committed);
 
     return ZX_OK;
 }
@@ -532,7 +826,7 @@ zx_status_t VmObjectPaged::CommitRangeContiguous(uint64_t offset, uint64_t len,
     // make a pass through the list, making sure we have an empty run on the object
     size_t count = 0;
     for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
-        if (!page_list_.GetPage(o))
+        if (!page_list_.GetPage(o) && !compressed_.Contains(o))
             count++;
     }
 
@@ -623,141 +917,1364 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t
     // unmap all of the pages in this range on all the mapping regions
     RangeChangeUpdateLocked(start, page_aligned_len);
 
-    // iterate through the pages, freeing them
-    // TODO: use page_list iterator, move pages to list, free at once
-    while (start < end) {
-        auto status = page_list_.FreePage(start);
-        if (status == ZX_OK && decommitted) {
-            *decommitted += PAGE_SIZE;
-        }
-        start += PAGE_SIZE;
-    }
+    size_t count = 0;
+    if (has_merged_pages_)
+        count = ReleaseMergedPagesLocked(start, end);
+
+    // detach all of the pages in the range and return them to the pmm at once
+    list_node list;
+    list_initialize(&list);
+    size_t removed = page_list_.RemovePages(start, end, &list);
+    __UNUSED auto freed = pmm_free(&list);
+    DEBUG_ASSERT(freed == removed);
+    count += removed;
+    count += compressed_.RemoveRange(start, end);
+
+    if (decommitted)
+        *decommitted = count * PAGE_SIZE;
 
     return ZX_OK;
 }
 
-zx_status_t VmObjectPaged::Pin(uint64_t offset, uint64_t len) {
+zx_status_t VmObjectPaged::TakePages(uint64_t offset, uint64_t len, list_node* pages) {
     canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
-    AutoLock a(&lock_);
-    return PinLocked(offset, len);
-}
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len));
 
-zx_status_t VmObjectPaged::PinLocked(uint64_t offset, uint64_t len) {
-    canary_.Assert();
+    AutoLock a(&lock_);
 
-    // verify that the range is within the object
-    if (unlikely(!InRange(offset, len, size_)))
+    if (!InRange(offset, len, size_))
         return ZX_ERR_OUT_OF_RANGE;
 
-    if (unlikely(len == 0))
-        return ZX_OK;
+    // a clone would see its parent's pages show through the hole, and a parent's pages may
+    // be visible through its children, so only ever take pages from a standalone object
+    if (parent_ || children_list_len_ != 0)
+        return ZX_ERR_NOT_SUPPORTED;
 
-    const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
-    const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
+    const uint64_t end = offset + len;
 
-    uint64_t expected_next_off = start_page_offset;
-    zx_status_t status = page_list_.ForEveryPageInRange(
-        [&expected_next_off](const auto p, uint64_t off) {
-            if (off != expected_next_off) {
-                return ZX_ERR_NOT_FOUND;
-            }
+    zx_status_t status = DecompressRangeLocked(offset, len);
+    if (status != ZX_OK)
+        return status;
+    status = UnmergeRangeLocked(offset, len);
+    if (status != ZX_OK)
+        return status;
 
-            DEBUG_ASSERT(p->state == VM_PAGE_STATE_OBJECT);
-            if (p->object.pin_count == VM_PAGE_OBJECT_MAX_PIN_COUNT) {
-                return ZX_ERR_UNAVAILABLE;
+    size_t count = 0;
+    page_list_.ForEveryPageInRange(
+        [&count](const auto p, uint64_t off) {
+            if (p->object.pin_count > 0) {
+                return ZX_ERR_STOP;
             }
-
-            p->object.pin_count++;
-            expected_next_off = off + PAGE_SIZE;
+            count++;
             return ZX_ERR_NEXT;
         },
-        start_page_offset, end_page_offset);
+        offset, end);
+    if (count != len / PAGE_SIZE)
+        return ZX_ERR_BAD_STATE;
 
-    if (status == ZX_OK && expected_next_off != end_page_offset) {
-        status = ZX_ERR_NOT_FOUND;
-    }
-    if (status != ZX_OK) {
-        UnpinLocked(start_page_offset, expected_next_off - start_page_offset);
-        return status;
+    // unmap all of the pages in this range on all the mapping regions
+    RangeChangeUpdateLocked(offset, len);
+
+    for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
+        vm_page_t* p = page_list_.RemovePage(o);
+        DEBUG_ASSERT(p);
+
+        p->state = VM_PAGE_STATE_ALLOC;
+        list_add_tail(pages, &p->free.node);
     }
 
     return ZX_OK;
 }
 
-void VmObjectPaged::Unpin(uint64_t offset, uint64_t len) {
-    AutoLock a(&lock_);
-    UnpinLocked(offset, len);
-}
-
-void VmObjectPaged::UnpinLocked(uint64_t offset, uint64_t len) {
+zx_status_t VmObjectPaged::SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
     canary_.Assert();
-    DEBUG_ASSERT(lock_.IsHeld());
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
-    // verify that the range is within the object
-    ASSERT(InRange(offset, len, size_));
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len));
 
-    if (unlikely(len == 0))
-        return;
+    AutoLock a(&lock_);
 
-    const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
-    const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
 
-    uint64_t expected_next_off = start_page_offset;
-    zx_status_t status = page_list_.ForEveryPageInRange(
-        [&expected_next_off](const auto p, uint64_t off) {
-            if (off != expected_next_off) {
-                return ZX_ERR_NOT_FOUND;
-            }
+    // children may be sharing the pages being replaced
+    if (children_list_len_ != 0)
+        return ZX_ERR_NOT_SUPPORTED;
 
-            DEBUG_ASSERT(p->state == VM_PAGE_STATE_OBJECT);
-            ASSERT(p->object.pin_count > 0);
-            p->object.pin_count--;
-            expected_next_off = off + PAGE_SIZE;
-            return ZX_ERR_NEXT;
-        },
-        start_page_offset, end_page_offset);
-    ASSERT_MSG(status == ZX_OK && expected_next_off == end_page_offset,
-               "Tried to unpin an uncommitted page");
-    return;
-}
+    if (AnyPagesPinnedLocked(offset, len))
+        return ZX_ERR_BAD_STATE;
 
-bool VmObjectPaged::AnyPagesPinnedLocked(uint64_t offset, size_t len) {
-    canary_.Assert();
-    DEBUG_ASSERT(lock_.IsHeld());
-    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
-    DEBUG_ASSERT(IS_PAGE_ALIGNED(len));
+    // unmap whatever is currently mapped in this range on all the mapping regions
+    RangeChangeUpdateLocked(offset, len);
+    compressed_.RemoveRange(offset, offset + len);
+    if (has_merged_pages_)
+        ReleaseMergedPagesLocked(offset, offset + len);
+
+    list_node old_pages = LIST_INITIAL_VALUE(old_pages);
+    zx_status_t status = ZX_OK;
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(pages, vm_page_t, free.node);
+        if (!p) {
+            status = ZX_ERR_INVALID_ARGS;
+            break;
+        }
 
-    const uint64_t start_page_offset = offset;
-    const uint64_t end_page_offset = offset + len;
+        vm_page_t* old = page_list_.RemovePage(o);
+        if (old) {
+            list_add_tail(&old_pages, &old->free.node);
+        }
 
-    bool found_pinned = false;
-    page_list_.ForEveryPageInRange(
-        [&found_pinned, start_page_offset, end_page_offset](const auto p, uint64_t off) {
-            DEBUG_ASSERT(off >= start_page_offset && off < end_page_offset);
-            if (p->object.pin_count > 0) {
-                found_pinned = true;
-                return ZX_ERR_STOP;
-            }
-            return ZX_ERR_NEXT;
-        },
-        start_page_offset, end_page_offset);
+        InitializeVmPage(p);
+        status = page_list_.AddPage(p, o);
+        if (status != ZX_OK) {
+            // hand the page back to the caller untouched
+            p->state = VM_PAGE_STATE_ALLOC;
+            list_add_head(pages, &p->free.node);
+            break;
+        }
+    }
 
-    return found_pinned;
+    pmm_free(&old_pages);
+
+    return status;
 }
 
-zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
+zx_status_t VmObjectPaged::QueuePageRequestLocked(uint64_t offset, PageRequest* request) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(!request->InContainer());
 
-    LTRACEF("vmo %p, size %" PRIu64 "\n", this, s);
-
-    // round up the size to the next page size boundary and make sure we dont wrap
-    zx_status_t status = RoundSize(s, &s);
-    if (status != ZX_OK)
-        return status;
+    if (!page_source_) {
+        if (page_source_detached_)
+            return ZX_ERR_BAD_STATE;
+        if (!parent_)
+            return ZX_ERR_NOT_SUPPORTED;
 
-    // make sure everything is aligned before we get started
+        // the page is missing further up the clone chain, we share the lock with our parent
+        safeint::CheckedNumeric<uint64_t> parent_offset = parent_offset_;
+        parent_offset += offset;
+        DEBUG_ASSERT(parent_offset.IsValid());
+        return parent_->QueuePageRequestLocked(parent_offset.ValueOrDie(), request);
+    }
+
+    if (offset >= size_)
+        return ZX_ERR_OUT_OF_RANGE;
+    offset = ROUNDDOWN(offset, PAGE_SIZE);
+
+    request->offset_ = offset;
+    request->status_ = ZX_OK;
+
+    // piggyback on a request that already asked the source for this page
+    bool asked = false;
+    for (const auto& r : page_requests_) {
+        if (offset >= r.request_offset_ && offset < r.request_end_) {
+            request->request_offset_ = r.request_offset_;
+            request->request_end_ = r.request_end_;
+            asked = true;
+            break;
+        }
+    }
+
+    if (!asked) {
+        // ask for the run of missing pages starting here, sequential readers would
+        // otherwise take a round trip to the source per page
+        uint64_t end = offset + PAGE_SIZE;
+        while (end < size_ && end - offset < kPageRequestPages * PAGE_SIZE &&
+               !page_list_.GetPage(end)) {
+            end += PAGE_SIZE;
+        }
+
+        LTRACEF("vmo %p asking for [%#" PRIx64 ", %#" PRIx64 ")\n", this, offset, end);
+
+        zx_status_t status = page_source_->GetPages(offset, end - offset);
+        if (status != ZX_OK)
+            return status;
+
+        request->request_offset_ = offset;
+        request->request_end_ = end;
+    }
+
+    request->vmo_ = fbl::WrapRefPtr(this);
+    page_requests_.push_back(request);
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SupplyPagerPages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len));
+
+    int woken = 0;
+    zx_status_t status = ZX_OK;
+    {
+        AutoLock a(&lock_);
+
+        if (!page_source_) {
+            status = ZX_ERR_BAD_STATE;
+        } else if (!InRange(offset, len, size_)) {
+            status = ZX_ERR_OUT_OF_RANGE;
+        } else {
+            // nothing is mapped where pages were missing, so there is nothing to unmap
+            list_node unused = LIST_INITIAL_VALUE(unused);
+            for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+                vm_page_t* p = list_remove_head_type(pages, vm_page_t, free.node);
+                if (!p)
+                    break;
+
+                // somebody else may have supplied this one already
+                if (page_list_.GetPage(o)) {
+                    list_add_tail(&unused, &p->free.node);
+                    continue;
+                }
+
+                InitializeVmPage(p);
+                if (page_list_.AddPage(p, o) != ZX_OK) {
+                    p->state = VM_PAGE_STATE_ALLOC;
+                    list_add_tail(&unused, &p->free.node);
+                    status = ZX_ERR_NO_MEMORY;
+                }
+            }
+            pmm_free(&unused);
+
+            // wake everyone whose page is now here
+            for (auto iter = page_requests_.begin(); iter != page_requests_.end();) {
+                auto cur = iter++;
+                if (!page_list_.GetPage(cur->offset_))
+                    continue;
+
+                PageRequest* request = page_requests_.erase(cur);
+                request->status_ = ZX_OK;
+                woken += request->event_.Signal();
+            }
+        }
+
+        // the caller hands over all of its pages
+        pmm_free(pages);
+    }
+
+    if (woken > 0)
+        thread_reschedule();
+
+    return status;
+}
+
+void VmObjectPaged::DetachSource() {
+    canary_.Assert();
+
+    int woken = 0;
+    fbl::RefPtr<PageSource> source;
+    {
+        AutoLock a(&lock_);
+
+        source = fbl::move(page_source_);
+        page_source_detached_ = true;
+
+        while (!page_requests_.is_empty()) {
+            PageRequest* request = page_requests_.pop_front();
+            request->status_ = ZX_ERR_BAD_STATE;
+            woken += request->event_.Signal();
+        }
+    }
+
+    if (woken > 0)
+        thread_reschedule();
+}
+
+void VmObjectPaged::OnZeroChildrenLocked() {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // the source may hold a handle to the object and be waiting for its clones to go
+    // away, tell it how many there have been so that it can match the count against its own
+    if (page_source_)
+        page_source_->OnZeroChildren(children_created_);
+}
+
+void VmObjectPaged::CollapseHiddenParents() {
+    canary_.Assert();
+
+    for (;;) {
+        fbl::RefPtr<VmObject> hidden;
+        {
+            AutoLock a(&lock_);
+            if (!CollapseParentLocked(&hidden))
+                return;
+        }
+        // the former parent goes away here, outside the lock
+    }
+}
+
+bool VmObjectPaged::CollapseParentLocked(fbl::RefPtr<VmObject>* hidden) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // the root of the chain owns the lock all of it shares and has to stay
+    if (!parent_ || !parent_->is_paged())
+        return false;
+    auto parent = static_cast<VmObjectPaged*>(parent_.get());
+    DEBUG_ASSERT(&parent->lock_ == &lock_);
+    if (!parent->parent_)
+        return false;
+
+    // Our reference being the only one means there are no handles to the parent and nothing
+    // maps or pins it. Nothing can take a new reference but the reclaim and merge scanners,
+    // which would find an empty object once they get the lock.
+    if (parent->ref_count_debug() != 1 || parent->children_list_len_ != 1 ||
+        parent->mapping_list_len_ != 0)
+        return false;
+    if (parent->page_source_ || parent->page_source_detached_)
+        return false;
+    if (parent->AnyPagesPinnedLocked(0, parent->size_))
+        return false;
+
+    safeint::CheckedNumeric<uint64_t> grandparent_offset = parent->parent_offset_;
+    grandparent_offset += parent_offset_;
+    if (!grandparent_offset.IsValid())
+        return false;
+
+    // the part of the parent we can see, and how much of that the grandparent shows through
+    auto until = [](uint64_t limit, uint64_t offset) {
+        return limit > offset ? limit - offset : 0;
+    };
+    const uint64_t window = MIN(MIN(size_, parent_limit_), until(parent->size_, parent_offset_));
+    const uint64_t limit = MIN(window, until(parent->parent_limit_, parent_offset_));
+    const uint64_t start = parent_offset_;
+    const uint64_t end = parent_offset_ + window;
+
+    // move over the pages we do not have copies of ourselves, the rest are freed below
+    size_t migrated = 0;
+    for (uint64_t off = start; off < end;) {
+        vm_page_t* p = nullptr;
+        parent->page_list_.ForEveryPageInRange(
+            [&](const auto page, uint64_t o) {
+                p = page;
+                off = o;
+                return ZX_ERR_STOP;
+            },
+            off, end);
+        if (!p)
+            break;
+
+        const uint64_t offset = off - parent_offset_;
+        off += PAGE_SIZE;
+        if (page_list_.GetPage(offset) || compressed_.Contains(offset))
+            continue;
+
+        // the parent keeps what has not been moved yet and stays usable as it is
+        if (page_list_.AddPage(p, offset) != ZX_OK)
+            return false;
+        parent->page_list_.RemovePage(offset + parent_offset_);
+        if (p->state == VM_PAGE_STATE_OBJECT && p->object.merged)
+            has_merged_pages_ = true;
+        migrated++;
+    }
+    for (uint64_t off = start; parent->compressed_.FirstInRange(off, end, &off);) {
+        const uint64_t offset = off - parent_offset_;
+        if (!page_list_.GetPage(offset) && !compressed_.Contains(offset)) {
+            parent->compressed_.MoveTo(off, &compressed_, offset);
+            migrated++;
+        }
+        off += PAGE_SIZE;
+    }
+
+    // nothing maps the pages left to the parent, and what shows through to us or our
+    // children is either ours now or shadowed by our own pages
+    if (parent->has_merged_pages_) {
+        parent->ReleaseMergedPagesLocked(0, parent->size_);
+        parent->has_merged_pages_ = false;
+    }
+    list_node list = LIST_INITIAL_VALUE(list);
+    parent->page_list_.RemovePages(0, parent->size_, &list);
+    pmm_free(&list);
+    parent->compressed_.RemoveRange(0, UINT64_MAX);
+
+    fbl::RefPtr<VmObject> grandparent = parent->parent_;
+    grandparent->AddChildLocked(this);
+    parent->RemoveChildLocked(this);
+    parent_offset_ = grandparent_offset.ValueOrDie();
+    parent_limit_ = limit;
+    *hidden = fbl::move(parent_);
+    parent_ = fbl::move(grandparent);
+
+    kcounter_add(clone_collapsed, 1u);
+    kcounter_add(clone_pages_migrated, migrated);
+
+    LTRACEF("vmo %p collapsed parent %p, %zu pages migrated, parent now %p offset %#" PRIx64
+            " limit %#" PRIx64 "\n", this, hidden->get(), migrated, parent_.get(),
+            parent_offset_, parent_limit_);
+
+    return true;
+}
+
+void VmObjectPaged::CancelPageRequest(PageRequest* request) {
+    AutoLock a(&lock_);
+
+    // the request may have been completed while the wait was being interrupted
+    if (request->InContainer())
+        page_requests_.erase(*request);
+}
+
+zx_status_t VmObjectPaged::WaitForPageLocked(uint64_t offset) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    PageRequest request;
+    zx_status_t status = QueuePageRequestLocked(offset, &request);
+    if (status != ZX_OK)
+        return status;
+
+    // the source may need to get at this object, or at anything in the same clone tree,
+    // to produce the page
+    lock_.Release();
+    status = request.Wait();
+    lock_.Acquire();
+
+    return status;
+}
+
+PageRequest::~PageRequest() {
+    DEBUG_ASSERT(!InContainer());
+}
+
+zx_status_t PageRequest::Wait() {
+    if (!vmo_)
+        return ZX_OK;
+
+    zx_status_t status = event_.Wait(ZX_TIME_INFINITE);
+    if (status != ZX_OK) {
+        // killed or suspended, take the request back before it goes out of scope
+        vmo_->CancelPageRequest(this);
+    } else {
+        AutoLock a(vmo_->lock());
+        status = status_;
+    }
+
+    // this may hold the last reference to the object
+    vmo_.reset();
+
+    return status;
+}
+
+zx_status_t VmObjectPaged::LockDiscardable(bool* was_discarded) {
+    canary_.Assert();
+
+    if (!(options_ & kDiscardable))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    AutoLock a(&lock_);
+
+    if (discard_lock_count_ == UINT32_MAX)
+        return ZX_ERR_BAD_STATE;
+    if (discard_lock_count_++ == 0)
+        RemoveFromReclaimList();
+
+    if (was_discarded)
+        *was_discarded = discarded_;
+    discarded_ = false;
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::UnlockDiscardable() {
+    canary_.Assert();
+
+    if (!(options_ & kDiscardable))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    AutoLock a(&lock_);
+
+    if (discard_lock_count_ == 0)
+        return ZX_ERR_BAD_STATE;
+    if (--discard_lock_count_ == 0)
+        AddToReclaimListLocked();
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::HintRange(uint64_t offset, uint64_t len, RangeHint hint) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 ", hint %d\n", offset, len,
+            static_cast<int>(hint));
+
+    AutoLock a(&lock_);
+
+    uint64_t new_len;
+    if (!TrimRange(offset, len, size_, &new_len))
+        return ZX_ERR_OUT_OF_RANGE;
+    if (new_len == 0)
+        return ZX_OK;
+
+    const uint64_t end = ROUNDUP_PAGE_SIZE(offset + new_len);
+    offset = ROUNDDOWN(offset, PAGE_SIZE);
+
+    switch (hint) {
+    case RangeHint::DontNeed: {
+        // discardable objects go as a whole, put this one first in line; anonymous memory
+        // can give its pages up right away and get them back on the next touch
+        if (options_ & kDiscardable) {
+            DeactivateLocked();
+        } else if (CompressibleLocked()) {
+            size_t count = CompressRangeLocked(offset, end);
+            kcounter_add(hint_dont_need_pages, count);
+        }
+        return ZX_OK;
+    }
+    case RangeHint::WillNeed: {
+        // the object is in use again, don't age it out from under the caller
+        reclaim_referenced_.store(true, fbl::memory_order_relaxed);
+
+        const size_t before = compressed_.page_count();
+        zx_status_t status = DecompressRangeLocked(offset, end - offset);
+        kcounter_add(hint_will_need_pages, before - compressed_.page_count());
+        return status;
+    }
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
+
+void VmObjectPaged::DeactivateLocked() {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    reclaim_referenced_.store(false, fbl::memory_order_relaxed);
+
+    AutoLock a(&reclaim_lock_);
+
+    switch (reclaim_queue_) {
+    case ReclaimQueue::None:
+        return;
+    case ReclaimQueue::Active:
+        reclaim_active_.erase(*this);
+        reclaim_stats_.active_objects--;
+        reclaim_stats_.inactive_objects++;
+        break;
+    case ReclaimQueue::Inactive:
+        reclaim_inactive_.erase(*this);
+        break;
+    case ReclaimQueue::CompressActive:
+        compress_active_.erase(*this);
+        reclaim_stats_.compress_active_objects--;
+        reclaim_stats_.compress_inactive_objects++;
+        break;
+    case ReclaimQueue::CompressInactive:
+        compress_inactive_.erase(*this);
+        break;
+    }
+
+    if (reclaim_queue_ == ReclaimQueue::Active || reclaim_queue_ == ReclaimQueue::Inactive) {
+        reclaim_inactive_.push_front(this);
+        reclaim_queue_ = ReclaimQueue::Inactive;
+    } else {
+        compress_inactive_.push_front(this);
+        reclaim_queue_ = ReclaimQueue::CompressInactive;
+    }
+}
+
+void VmObjectPaged::AddToReclaimListLocked() {
+    size_t count = 0;
+    page_list_.ForEveryPage([&count](const auto p, uint64_t) {
+        count++;
+        return ZX_ERR_NEXT;
+    });
+    reclaim_referenced_.store(false, fbl::memory_order_relaxed);
+
+    AutoLock a(&reclaim_lock_);
+
+    DEBUG_ASSERT(reclaim_queue_ == ReclaimQueue::None);
+    reclaim_active_.push_back(this);
+    reclaim_queue_ = ReclaimQueue::Active;
+    reclaim_time_ = current_time();
+    reclaim_pages_ = count;
+    reclaim_stats_.reclaimable_pages += count;
+    reclaim_stats_.active_objects++;
+}
+
+void VmObjectPaged::RemoveFromReclaimList() {
+    AutoLock a(&reclaim_lock_);
+
+    switch (reclaim_queue_) {
+    case ReclaimQueue::None:
+        return;
+    case ReclaimQueue::Active:
+        reclaim_active_.erase(*this);
+        reclaim_stats_.active_objects--;
+        break;
+    case ReclaimQueue::Inactive:
+        reclaim_inactive_.erase(*this);
+        reclaim_stats_.inactive_objects--;
+        break;
+    case ReclaimQueue::CompressActive:
+        compress_active_.erase(*this);
+        reclaim_stats_.compress_active_objects--;
+        break;
+    case ReclaimQueue::CompressInactive:
+        compress_inactive_.erase(*this);
+        reclaim_stats_.compress_inactive_objects--;
+        break;
+    }
+    reclaim_queue_ = ReclaimQueue::None;
+    reclaim_stats_.reclaimable_pages -= reclaim_pages_;
+    reclaim_pages_ = 0;
+}
+
+size_t VmObjectPaged::DiscardLocked() {
+    DEBUG_ASSERT(options_ & kDiscardable);
+    DEBUG_ASSERT(!parent_ && children_list_len_ == 0);
+
+    if (discard_lock_count_ > 0 || AnyPagesPinnedLocked(0, size_))
+        return 0;
+
+    // unmap everything before the pages go away
+    RangeChangeUpdateLocked(0, size_);
+
+    list_node list;
+    list_initialize(&list);
+    size_t count = page_list_.RemovePages(0, size_, &list);
+    __UNUSED auto freed = pmm_free(&list);
+    DEBUG_ASSERT(freed == count);
+
+    discarded_ = true;
+    return count;
+}
+
+void VmObjectPaged::AgeDiscardable(zx_duration_t min_age) {
+    AutoLock a(&reclaim_lock_);
+
+    // the active list is in unlock order, so aging stops at the first object that is too
+    // young; objects that go round again get a new time and end up behind it
+    const zx_time_t now = current_time();
+    const zx_time_t cutoff = now > min_age ? now - min_age : 0;
+    for (size_t n = reclaim_stats_.active_objects; n > 0; n--) {
+        VmObjectPaged& vmo = reclaim_active_.front();
+        if (vmo.reclaim_time_ > cutoff)
+            break;
+
+        reclaim_active_.pop_front();
+        vmo.reclaim_time_ = now;
+        if (vmo.reclaim_referenced_.exchange(false, fbl::memory_order_relaxed)) {
+            reclaim_active_.push_back(&vmo);
+            kcounter_add(reclaim_rotated, 1u);
+        } else {
+            reclaim_inactive_.push_back(&vmo);
+            vmo.reclaim_queue_ = ReclaimQueue::Inactive;
+            reclaim_stats_.active_objects--;
+            reclaim_stats_.inactive_objects++;
+            kcounter_add(reclaim_aged, 1u);
+        }
+    }
+
+    // the compression lists are kept in the same order, by the time objects were handed
+    // out or last went round
+    for (size_t n = reclaim_stats_.compress_active_objects; n > 0; n--) {
+        VmObjectPaged& vmo = compress_active_.front();
+        if (vmo.reclaim_time_ > cutoff)
+            break;
+
+        compress_active_.pop_front();
+        vmo.reclaim_time_ = now;
+        if (vmo.reclaim_referenced_.exchange(false, fbl::memory_order_relaxed)) {
+            compress_active_.push_back(&vmo);
+            kcounter_add(compress_rotated, 1u);
+        } else {
+            compress_inactive_.push_back(&vmo);
+            vmo.reclaim_queue_ = ReclaimQueue::CompressInactive;
+            reclaim_stats_.compress_active_objects--;
+            reclaim_stats_.compress_inactive_objects++;
+            kcounter_add(compress_aged, 1u);
+        }
+    }
+}
+
+size_t VmObjectPaged::ReclaimDiscardable(size_t target) {
+    size_t freed = 0;
+
+    // bound the walk by the objects there were at the start, since ones we cannot discard
+    // go back on the active list
+    size_t remaining;
+    {
+        AutoLock a(&reclaim_lock_);
+        remaining = reclaim_stats_.active_objects + reclaim_stats_.inactive_objects;
+    }
+
+    for (; remaining > 0 && freed < target; remaining--) {
+        fbl::RefPtr<VmObjectPaged> vmo;
+        {
+            AutoLock a(&reclaim_lock_);
+
+            VmObjectPaged* raw;
+            if (!reclaim_inactive_.is_empty()) {
+                raw = &reclaim_inactive_.front();
+                // something looked at it since it aged, give it a second chance
+                if (raw->reclaim_referenced_.exchange(false, fbl::memory_order_relaxed)) {
+                    reclaim_inactive_.erase(*raw);
+                    reclaim_active_.push_back(raw);
+                    raw->reclaim_queue_ = ReclaimQueue::Active;
+                    raw->reclaim_time_ = current_time();
+                    reclaim_stats_.inactive_objects--;
+                    reclaim_stats_.active_objects++;
+                    kcounter_add(reclaim_rotated, 1u);
+                    continue;
+                }
+            } else if (!reclaim_active_.is_empty()) {
+                raw = &reclaim_active_.front();
+            } else {
+                break;
+            }
+
+            // An object whose last reference is gone is on its way through the destructor,
+            // which takes it off the list; leave it alone.
+            vmo = fbl::internal::MakeRefPtrUpgradeFromRaw(raw, reclaim_lock_);
+            if (!vmo)
+                continue;
+        }
+
+        // Locking can race with us taking the object lock, DiscardLocked() checks the lock
+        // count again under it.
+        AutoLock a(&vmo->lock_);
+        vmo->RemoveFromReclaimList();
+
+        size_t count = vmo->DiscardLocked();
+        if (count == 0 && vmo->discard_lock_count_ == 0 && !vmo->discarded_) {
+            // pinned, try again later
+            vmo->AddToReclaimListLocked();
+            continue;
+        }
+
+        freed += count;
+        kcounter_add(reclaim_discarded, 1u);
+        kcounter_add(reclaim_pages_freed, count);
+
+        AutoLock al(&reclaim_lock_);
+        reclaim_stats_.reclaimed_pages += count;
+        reclaim_stats_.reclaimed_objects++;
+    }
+
+    return freed;
+}
+
+size_t VmObjectPaged::CompressInactive(size_t target) {
+    size_t freed = 0;
+
+    // every object tried goes back on the active list, so each is looked at once
+    size_t remaining;
+    {
+        AutoLock a(&reclaim_lock_);
+        remaining = reclaim_stats_.compress_inactive_objects;
+    }
+
+    for (; remaining > 0 && freed < target; remaining--) {
+        fbl::RefPtr<VmObjectPaged> vmo;
+        {
+            AutoLock a(&reclaim_lock_);
+            if (compress_inactive_.is_empty())
+                break;
+
+            VmObjectPaged* raw = &compress_inactive_.front();
+            compress_inactive_.pop_front();
+            compress_active_.push_back(raw);
+            raw->reclaim_queue_ = ReclaimQueue::CompressActive;
+            raw->reclaim_time_ = current_time();
+            reclaim_stats_.compress_inactive_objects--;
+            reclaim_stats_.compress_active_objects++;
+
+            // something looked at it since it aged, give it a second chance
+            if (raw->reclaim_referenced_.exchange(false, fbl::memory_order_relaxed)) {
+                kcounter_add(compress_rotated, 1u);
+                continue;
+            }
+
+            // An object whose last reference is gone is on its way through the destructor,
+            // which takes it off the list; leave it alone.
+            vmo = fbl::internal::MakeRefPtrUpgradeFromRaw(raw, reclaim_lock_);
+            if (!vmo)
+                continue;
+        }
+
+        AutoLock a(&vmo->lock_);
+        size_t count = vmo->CompressLocked();
+        freed += count;
+        kcounter_add(compress_pages_freed, count);
+
+        AutoLock al(&reclaim_lock_);
+        reclaim_stats_.compressed_pages_freed += count;
+    }
+
+    return freed;
+}
+
+void VmObjectPaged::OnUserIdSetLocked() {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (CompressibleLocked())
+        AddToCompressListLocked();
+}
+
+bool VmObjectPaged::CompressibleLocked() const {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // large pages would be split up, discardable objects are thrown away whole instead,
+    // and only the page source knows how to get back pages of an object that has one
+    if (options_ & (kLargePages | kDiscardable))
+        return false;
+    if (page_source_ || page_source_detached_)
+        return false;
+
+    // the kernel only faults on its own objects when it has gone wrong
+    return user_id_ != 0;
+}
+
+void VmObjectPaged::AddToCompressListLocked() {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    reclaim_referenced_.store(false, fbl::memory_order_relaxed);
+
+    AutoLock a(&reclaim_lock_);
+
+    DEBUG_ASSERT(reclaim_queue_ == ReclaimQueue::None);
+    compress_active_.push_back(this);
+    reclaim_queue_ = ReclaimQueue::CompressActive;
+    reclaim_time_ = current_time();
+    reclaim_stats_.compress_active_objects++;
+}
+
+size_t VmObjectPaged::CompressRangeLocked(uint64_t range_start, uint64_t range_end) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(CompressibleLocked());
+
+    // kernel mappings of the object may be touched where faulting is not allowed
+    for (const auto& m : mapping_list_) {
+        if (!m.aspace()->is_user())
+            return 0;
+    }
+
+    auto compressible = [](const vm_page_t* p) {
+        // pages wired in by CreateFromROData() are not ours to free, nor are merged pages
+        return p->state == VM_PAGE_STATE_OBJECT && p->object.pin_count == 0 &&
+               !p->object.merged;
+    };
+
+    uint64_t start = UINT64_MAX;
+    uint64_t end = 0;
+    page_list_.ForEveryPageInRange(
+        [&](const auto p, uint64_t off) {
+            if (compressible(p)) {
+                start = MIN(start, off);
+                end = off + PAGE_SIZE;
+            }
+            return ZX_ERR_NEXT;
+        },
+        range_start, range_end);
+    if (start >= end)
+        return 0;
+
+    // nothing may write to the pages through a mapping once they are being compressed
+    RangeChangeUpdateLocked(start, end - start);
+
+    list_node list = LIST_INITIAL_VALUE(list);
+    size_t count = 0;
+    for (uint64_t off = start; off < end; off += PAGE_SIZE) {
+        vm_page_t* p = nullptr;
+        page_list_.ForEveryPageInRange(
+            [&](const auto page, uint64_t o) {
+                if (!compressible(page))
+                    return ZX_ERR_NEXT;
+                p = page;
+                off = o;
+                return ZX_ERR_STOP;
+            },
+            off, end);
+        if (!p)
+            break;
+
+        // a missing page reads as zero unless a parent has one to show through
+        const void* data = paddr_to_physmap(vm_page_to_paddr(p));
+        if (!parent_ && IsZeroPage(data)) {
+            kcounter_add(compress_zero_pages, 1u);
+        } else if (compressed_.Insert(off, data) != ZX_OK) {
+            continue;
+        }
+
+        page_list_.RemovePage(off);
+        list_add_tail(&list, &p->free.node);
+        count++;
+    }
+
+    __UNUSED auto freed = pmm_free(&list);
+    DEBUG_ASSERT(freed == count);
+
+    LTRACEF("vmo %p freed %zu pages, %zu compressed into %zu bytes\n", this, count,
+            compressed_.page_count(), compressed_.stored_bytes());
+
+    return count;
+}
+
+zx_status_t VmObjectPaged::DecompressPageLocked(uint64_t offset, list_node* free_list,
+                                                vm_page_t** page_out, paddr_t* pa_out) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    offset = ROUNDDOWN(offset, PAGE_SIZE);
+    if (!compressed_.Contains(offset))
+        return ZX_ERR_NOT_FOUND;
+
+    const zx_time_t start = current_time();
+
+    vm_page_t* p = nullptr;
+    paddr_t pa;
+    if (free_list) {
+        p = list_remove_head_type(free_list, vm_page_t, free.node);
+        if (p) {
+            pa = vm_page_to_paddr(p);
+        }
+    }
+    if (!p) {
+        p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+    }
+    if (!p) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    __UNUSED zx_status_t status = compressed_.Take(offset, paddr_to_physmap(pa));
+    DEBUG_ASSERT(status == ZX_OK);
+
+    InitializeVmPage(p);
+    status = AddPageLocked(p, offset);
+    DEBUG_ASSERT(status == ZX_OK);
+
+    thread_t* current_thread = get_current_thread();
+    current_thread->vm_decompressed_pages++;
+    current_thread->vm_decompress_ns += current_time() - start;
+
+    LTRACEF("decompressed page %p, pa %#" PRIxPTR " at offset %#" PRIx64 "\n", p, pa, offset);
+
+    if (page_out)
+        *page_out = p;
+    if (pa_out)
+        *pa_out = pa;
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::DecompressRangeLocked(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    const uint64_t end = offset + len;
+    uint64_t off;
+    while (compressed_.FirstInRange(offset, end, &off)) {
+        zx_status_t status = DecompressPageLocked(off, nullptr, nullptr, nullptr);
+        if (status != ZX_OK)
+            return status;
+        offset = off + PAGE_SIZE;
+    }
+    return ZX_OK;
+}
+
+size_t VmObjectPaged::ScanMergeable(size_t max_pages) {
+    const zx_time_t start = current_time();
+    size_t budget = max_pages;
+    size_t freed = 0;
+
+    // each object is visited at most once, so objects without a page left to look at cannot
+    // keep the scan going
+    size_t remaining;
+    {
+        AutoLock a(VmMergedPages::lock());
+        remaining = merge_objects_;
+    }
+
+    for (; remaining > 0 && budget > 0; remaining--) {
+        fbl::RefPtr<VmObjectPaged> vmo;
+        {
+            AutoLock a(VmMergedPages::lock());
+            if (merge_list_.is_empty())
+                break;
+
+            // pages only seen in an earlier round are forgotten, which bounds the memory spent
+            // on hashes by the number of mergeable pages
+            if (merge_round_left_ == 0) {
+                VmMergedPages::ClearSeenLocked();
+                merge_round_left_ = merge_objects_;
+            }
+            merge_round_left_--;
+
+            VmObjectPaged* raw = &merge_list_.front();
+            merge_list_.pop_front();
+            merge_list_.push_back(raw);
+
+            // An object whose last reference is gone is on its way through the destructor,
+            // which takes it off the list; leave it alone.
+            vmo = fbl::internal::MakeRefPtrUpgradeFromRaw(raw, *VmMergedPages::lock());
+            if (!vmo)
+                continue;
+        }
+
+        AutoLock a(&vmo->lock_);
+        freed += vmo->MergeLocked(&budget);
+    }
+
+    kcounter_add(merge_scan_ns, current_time() - start);
+
+    return freed;
+}
+
+size_t VmObjectPaged::MergeLocked(size_t* budget) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (!mergeable_)
+        return 0;
+
+    // kernel mappings of the object write to its pages without faulting first
+    for (const auto& m : mapping_list_) {
+        if (!m.aspace()->is_user())
+            return 0;
+    }
+
+    auto mergeable = [](const vm_page_t* p) {
+        return p->state == VM_PAGE_STATE_OBJECT && p->object.pin_count == 0 &&
+               !p->object.merged;
+    };
+
+    size_t freed = 0;
+    while (*budget > 0) {
+        if (merge_scan_offset_ >= size_) {
+            merge_scan_offset_ = 0;
+            break;
+        }
+
+        vm_page_t* p = nullptr;
+        uint64_t off = 0;
+        page_list_.ForEveryPageInRange(
+            [&](const auto page, uint64_t o) {
+                if (!mergeable(page))
+                    return ZX_ERR_NEXT;
+                p = page;
+                off = o;
+                return ZX_ERR_STOP;
+            },
+            merge_scan_offset_, size_);
+        if (!p) {
+            merge_scan_offset_ = 0;
+            break;
+        }
+        merge_scan_offset_ = off + PAGE_SIZE;
+        (*budget)--;
+        kcounter_add(merge_scanned, 1u);
+
+        // only pages whose contents turned up before are worth unmapping
+        const void* data = paddr_to_physmap(vm_page_to_paddr(p));
+        const bool zero = !parent_ && IsZeroPage(data);
+        uint64_t hash = 0;
+        if (!zero) {
+            hash = VmMergedPages::Hash(data);
+            AutoLock a(VmMergedPages::lock());
+            if (!VmMergedPages::FindLocked(hash, data) && !VmMergedPages::SeenLocked(hash))
+                continue;
+        }
+
+        // nothing may write to the page through a mapping from now on, and the contents may
+        // have changed before the mappings were gone
+        RangeChangeUpdateLocked(off, PAGE_SIZE);
+
+        if (zero) {
+            // a missing page reads as zero, there is nothing to share
+            if (!IsZeroPage(data))
+                continue;
+            kcounter_add(merge_zero_pages, 1u);
+        } else {
+            hash = VmMergedPages::Hash(data);
+            AutoLock a(VmMergedPages::lock());
+            vm_page_t* match = VmMergedPages::FindLocked(hash, data);
+            if (!match) {
+                // the first page with these contents is the one the others are merged into
+                if (VmMergedPages::AddLocked(p, hash) == ZX_OK) {
+                    has_merged_pages_ = true;
+                    kcounter_add(merge_promoted, 1u);
+                }
+                continue;
+            }
+            VmMergedPages::HoldLocked(match);
+            has_merged_pages_ = true;
+            kcounter_add(merge_merged, 1u);
+
+            __UNUSED vm_page_t* old = page_list_.RemovePage(off);
+            DEBUG_ASSERT(old == p);
+            __UNUSED zx_status_t status = page_list_.AddPage(match, off);
+            DEBUG_ASSERT(status == ZX_OK);
+            pmm_free_page(p);
+            freed++;
+            continue;
+        }
+
+        page_list_.RemovePage(off);
+        pmm_free_page(p);
+        freed++;
+    }
+
+    LTRACEF("vmo %p freed %zu pages, scan at %#" PRIx64 "\n", this, freed, merge_scan_offset_);
+
+    return freed;
+}
+
+zx_status_t VmObjectPaged::UnmergePageLocked(uint64_t offset, vm_page_t* p, list_node* free_list,
+                                             vm_page_t** page_out) {
+    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(p->state == VM_PAGE_STATE_OBJECT && p->object.merged);
+
+    // the last holder simply keeps the page
+    {
+        AutoLock a(VmMergedPages::lock());
+        if (p->object.merge_count == 1) {
+            __UNUSED bool last = VmMergedPages::ReleaseLocked(p);
+            DEBUG_ASSERT(last);
+            kcounter_add(merge_unmerged, 1u);
+            *page_out = p;
+            return ZX_OK;
+        }
+    }
+
+    vm_page_t* copy = nullptr;
+    paddr_t pa;
+    if (free_list) {
+        copy = list_remove_head_type(free_list, vm_page_t, free.node);
+        if (copy) {
+            pa = vm_page_to_paddr(copy);
+        }
+    }
+    if (!copy) {
+        copy = pmm_alloc_page(pmm_alloc_flags_, &pa);
+    }
+    if (!copy) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    InitializeVmPage(copy);
+    memcpy(paddr_to_physmap(pa), paddr_to_physmap(vm_page_to_paddr(p)), PAGE_SIZE);
+
+    page_list_.RemovePage(offset);
+
+    // the others may have let go of the page while it was being copied
+    bool last;
+    {
+        AutoLock a(VmMergedPages::lock());
+        last = VmMergedPages::ReleaseLocked(p);
+    }
+    if (last)
+        pmm_free_page(p);
+    kcounter_add(merge_unmerged, 1u);
+
+    __UNUSED zx_status_t status = AddPageLocked(copy, offset);
+    DEBUG_ASSERT(status == ZX_OK);
+
+    LTRACEF("unmerged page %p into %p at offset %#" PRIx64 "\n", p, copy, offset);
+
+    *page_out = copy;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::UnmergeRangeLocked(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (!has_merged_pages_)
+        return ZX_OK;
+
+    const uint64_t end = offset + len;
+    while (offset < end) {
+        vm_page_t* p = nullptr;
+        uint64_t off = 0;
+        page_list_.ForEveryPageInRange(
+            [&](const auto page, uint64_t o) {
+                if (page->state != VM_PAGE_STATE_OBJECT || !page->object.merged)
+                    return ZX_ERR_NEXT;
+                p = page;
+                off = o;
+                return ZX_ERR_STOP;
+            },
+            offset, end);
+        if (!p)
+            break;
+
+        zx_status_t status = UnmergePageLocked(off, p, nullptr, &p);
+        if (status != ZX_OK)
+            return status;
+        offset = off + PAGE_SIZE;
+    }
+    return ZX_OK;
+}
+
+size_t VmObjectPaged::ReleaseMergedPagesLocked(uint64_t start, uint64_t end) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // other holders have the pages in their page lists too, so they are taken out and let go
+    // of one at a time rather than strung together through their list nodes
+    size_t count = 0;
+    while (start < end) {
+        vm_page_t* p = nullptr;
+        uint64_t off = 0;
+        page_list_.ForEveryPageInRange(
+            [&](const auto page, uint64_t o) {
+                if (page->state != VM_PAGE_STATE_OBJECT || !page->object.merged)
+                    return ZX_ERR_NEXT;
+                p = page;
+                off = o;
+                return ZX_ERR_STOP;
+            },
+            start, end);
+        if (!p)
+            break;
+
+        page_list_.RemovePage(off);
+        bool last;
+        {
+            AutoLock a(VmMergedPages::lock());
+            last = VmMergedPages::ReleaseLocked(p);
+        }
+        if (last)
+            pmm_free_page(p);
+        count++;
+        start = off + PAGE_SIZE;
+    }
+    return count;
+}
+
+void VmObjectPaged::GetReclaimStats(ReclaimStats* stats) {
+    AutoLock a(&reclaim_lock_);
+    *stats = reclaim_stats_;
+}
+
+zx_status_t VmObjectPaged::Pin(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+    return PinLocked(offset, len);
+}
+
+zx_status_t VmObjectPaged::PinLocked(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+
+    // verify that the range is within the object
+    if (unlikely(!InRange(offset, len, size_)))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    if (unlikely(len == 0))
+        return ZX_OK;
+
+    const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
+    const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
+
+    // the pages may have been compressed since they were committed
+    zx_status_t status = DecompressRangeLocked(start_page_offset,
+                                               end_page_offset - start_page_offset);
+    if (status != ZX_OK)
+        return status;
+    // a pinned page may be written by a device, which the other holders would see
+    status = UnmergeRangeLocked(start_page_offset, end_page_offset - start_page_offset);
+    if (status != ZX_OK)
+        return status;
+
+    uint64_t expected_next_off = start_page_offset;
+    status = page_list_.ForEveryPageInRange(
+        [&expected_next_off](const auto p, uint64_t off) {
+            if (off != expected_next_off) {
+                return ZX_ERR_NOT_FOUND;
+            }
+
+            DEBUG_ASSERT(p->state == VM_PAGE_STATE_OBJECT);
+            if (p->object.pin_count == VM_PAGE_OBJECT_MAX_PIN_COUNT) {
+                return ZX_ERR_UNAVAILABLE;
+            }
+
+            p->object.pin_count++;
+            expected_next_off = off + PAGE_SIZE;
+            return ZX_ERR_NEXT;
+        },
+        start_page_offset, end_page_offset);
+
+    if (status == ZX_OK && expected_next_off != end_page_offset) {
+        status = ZX_ERR_NOT_FOUND;
+    }
+    if (status != ZX_OK) {
+        UnpinLocked(start_page_offset, expected_next_off - start_page_offset);
+        return status;
+    }
+
+    return ZX_OK;
+}
+
+void VmObjectPaged::Unpin(uint64_t offset, uint64_t len) {
+    AutoLock a(&lock_);
+    UnpinLocked(offset, len);
+}
+
+void VmObjectPaged::UnpinLocked(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    // verify that the range is within the object
+    ASSERT(InRange(offset, len, size_));
+
+    if (unlikely(len == 0))
+        return;
+
+    const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
+    const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
+
+    uint64_t expected_next_off = start_page_offset;
+    zx_status_t status = page_list_.ForEveryPageInRange(
+        [&expected_next_off](const auto p, uint64_t off) {
+            if (off != expected_next_off) {
+                return ZX_ERR_NOT_FOUND;
+            }
+
+            DEBUG_ASSERT(p->state == VM_PAGE_STATE_OBJECT);
+            ASSERT(p->object.pin_count > 0);
+            p->object.pin_count--;
+            expected_next_off = off + PAGE_SIZE;
+            return ZX_ERR_NEXT;
+        },
+        start_page_offset, end_page_offset);
+    ASSERT_MSG(status == ZX_OK && expected_next_off == end_page_offset,
+               "Tried to unpin an uncommitted page");
+    return;
+}
+
+bool VmObjectPaged::AnyPagesPinnedLocked(uint64_t offset, size_t len) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(len));
+
+    const uint64_t start_page_offset = offset;
+    const uint64_t end_page_offset = offset + len;
+
+    bool found_pinned = false;
+    page_list_.ForEveryPageInRange(
+        [&found_pinned, start_page_offset, end_page_offset](const auto p, uint64_t off) {
+            DEBUG_ASSERT(off >= start_page_offset && off < end_page_offset);
+            if (p->object.pin_count > 0) {
+                found_pinned = true;
+                return ZX_ERR_STOP;
+            }
+            return ZX_ERR_NEXT;
+        },
+        start_page_offset, end_page_offset);
+
+    return found_pinned;
+}
+
+zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    LTRACEF("vmo %p, size %" PRIu64 "\n", this, s);
+
+    // round up the size to the next page size boundary and make sure we dont wrap
+    zx_status_t status = RoundSize(s, &s);
+    if (status != ZX_OK)
+        return status;
+
+    // make sure everything is aligned before we get started
     DEBUG_ASSERT(IS_PAGE_ALIGNED(size_));
     DEBUG_ASSERT(IS_PAGE_ALIGNED(s));
 
@@ -778,6 +2295,9 @@ zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
 
         // iterate through the pages, freeing them
         // TODO: use page_list iterator, move pages to list, free at once
+        compressed_.RemoveRange(start, end);
+        if (has_merged_pages_)
+            ReleaseMergedPagesLocked(start, end);
         while (start < end) {
             page_list_.FreePage(start);
             start += PAGE_SIZE;
@@ -802,6 +2322,10 @@ zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
 zx_status_t VmObjectPaged::Resize(uint64_t s) {
     AutoLock a(&lock_);
 
+    // the page source decides what is in the object
+    if (page_source_ || page_source_detached_)
+        return ZX_ERR_NOT_SUPPORTED;
+
     return ResizeLocked(s);
 }
 
@@ -857,6 +2381,12 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, size_t
         auto status = GetPageLocked(src_offset,
                                     VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
                                     nullptr, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            status = WaitForPageLocked(src_offset);
+            if (status < 0)
+                return status;
+            continue;
+        }
         if (status < 0)
             return status;
 
@@ -929,8 +2459,20 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
     const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
     const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
 
+    // bring back compressed pages and give the object its own copy of merged pages it is going
+    // to write to up front, either would change the page list while it is being walked
+    zx_status_t status = DecompressRangeLocked(start_page_offset,
+                                               end_page_offset - start_page_offset);
+    if (status != ZX_OK)
+        return status;
+    if (pf_flags & VMM_PF_FLAG_WRITE) {
+        status = UnmergeRangeLocked(start_page_offset, end_page_offset - start_page_offset);
+        if (status != ZX_OK)
+            return status;
+    }
+
     uint64_t expected_next_off = start_page_offset;
-    zx_status_t status = page_list_.ForEveryPageInRange(
+    status = page_list_.ForEveryPageInRange(
         [&expected_next_off, this, pf_flags, lookup_fn, context,
          start_page_offset](const auto p, uint64_t off) {
 
@@ -1009,7 +2551,13 @@ zx_status_t VmObjectPaged::WriteUser(user_in_ptr<const void> ptr, uint64_t offse
     auto write_routine = [ptr](void* dst, size_t offset, size_t len) -> zx_status_t {
         return ptr.byte_offset(offset).copy_array_from_user(dst, len);
     };
+    auto write_routine_nontemporal = [ptr](void* dst, size_t offset, size_t len) -> zx_status_t {
+        return ptr.byte_offset(offset).copy_array_from_user_nontemporal(dst, len);
+    };
 
+    if (len >= kNonTemporalWriteThreshold) {
+        return ReadWriteInternal(offset, len, bytes_written, true, write_routine_nontemporal);
+    }
     return ReadWriteInternal(offset, len, bytes_written, true, write_routine);
 }
 
@@ -1109,6 +2657,66 @@ zx_status_t VmObjectPaged::CacheOp(const uint64_t start_offset, const uint64_t l
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::GetNumaNode(uint32_t* node) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    uint32_t flag_node = (pmm_alloc_flags_ & PMM_ALLOC_FLAG_NODE_MASK) >> PMM_ALLOC_FLAG_NODE_SHIFT;
+    *node = (flag_node == 0) ? PMM_NODE_LOCAL : flag_node - 1;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SetNumaNode(const uint32_t node) {
+    canary_.Assert();
+
+    if (node != PMM_NODE_LOCAL && node >= pmm_node_count())
+        return ZX_ERR_OUT_OF_RANGE;
+
+    AutoLock a(&lock_);
+
+    // only affects pages committed from now on, existing pages stay where they are
+    pmm_alloc_flags_ &= ~PMM_ALLOC_FLAG_NODE_MASK;
+    if (node != PMM_NODE_LOCAL)
+        pmm_alloc_flags_ |= PMM_ALLOC_FLAG_NODE(node);
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::GetMergeable(bool* mergeable) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    *mergeable = mergeable_;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SetMergeable(bool mergeable) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    // the same objects whose pages may be compressed: the pages of the others are either not
+    // the object's own to share or are already thrown away under memory pressure
+    if (!CompressibleLocked())
+        return ZX_ERR_NOT_SUPPORTED;
+    if (mergeable == mergeable_)
+        return ZX_OK;
+
+    // pages that are already merged stay merged until they are written to
+    mergeable_ = mergeable;
+
+    AutoLock al(VmMergedPages::lock());
+    if (mergeable) {
+        merge_list_.push_back(this);
+        merge_objects_++;
+    } else {
+        merge_list_.erase(*this);
+        merge_objects_--;
+    }
+    return ZX_OK;
+}
+
 void VmObjectPaged::RangeChangeUpdateFromParentLocked(const uint64_t offset, const uint64_t len) {
     canary_.Assert();
 
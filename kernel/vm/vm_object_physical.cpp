@@ -90,6 +90,23 @@ zx_status_t VmObjectPhysical::GetPageLocked(uint64_t offset, uint pf_flags, list
     return ZX_OK;
 }
 
+zx_status_t VmObjectPhysical::GetLargePageLocked(uint64_t offset, uint pf_flags, paddr_t* _pa) {
+    canary_.Assert();
+
+    DEBUG_ASSERT(IS_ALIGNED(offset, LARGE_PAGE_SIZE));
+
+    if (offset >= size_ || size_ - offset < LARGE_PAGE_SIZE)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    uint64_t pa = base_ + offset;
+    if (!IS_ALIGNED(pa, LARGE_PAGE_SIZE) || pa + LARGE_PAGE_SIZE - 1 > UINTPTR_MAX)
+        return ZX_ERR_NOT_FOUND;
+
+    *_pa = (paddr_t)pa;
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPhysical::LookupUser(uint64_t offset, uint64_t len, user_inout_ptr<paddr_t> buffer,
                                          size_t buffer_size) {
     canary_.Assert();
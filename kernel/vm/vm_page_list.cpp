@@ -9,6 +9,7 @@
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <inttypes.h>
+#include <stdlib.h>
 #include <trace.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
@@ -32,6 +33,16 @@ VmPageListNode::~VmPageListNode() {
     }
 }
 
+void* VmPageListNode::operator new(size_t size, fbl::AllocChecker* ac) noexcept {
+    void* mem = memalign(alignof(VmPageListNode), size);
+    ac->arm(size, mem != nullptr);
+    return mem;
+}
+
+void VmPageListNode::operator delete(void* ptr) {
+    free(ptr);
+}
+
 vm_page* VmPageListNode::GetPage(size_t index) {
     canary_.Assert();
     DEBUG_ASSERT(index < kPageFanOut);
@@ -47,6 +58,7 @@ vm_page* VmPageListNode::RemovePage(size_t index) {
         return nullptr;
 
     pages_[index] = nullptr;
+    num_pages_--;
 
     return p;
 }
@@ -57,9 +69,27 @@ zx_status_t VmPageListNode::AddPage(vm_page* p, size_t index) {
     if (pages_[index])
         return ZX_ERR_ALREADY_EXISTS;
     pages_[index] = p;
+    num_pages_++;
     return ZX_OK;
 }
 
+size_t VmPageListNode::RemovePages(uint64_t start_offset, uint64_t end_offset, list_node* pages) {
+    canary_.Assert();
+
+    size_t count = 0;
+    auto per_page_func = [pages, &count](vm_page*& p, uint64_t offset) {
+        list_add_tail(pages, &p->free.node);
+        p = nullptr;
+        count++;
+        return ZX_ERR_NEXT;
+    };
+    ForEveryPage(per_page_func, start_offset, end_offset);
+
+    DEBUG_ASSERT(count <= num_pages_);
+    num_pages_ -= static_cast<uint32_t>(count);
+    return count;
+}
+
 VmPageList::VmPageList() {
     LTRACEF("%p\n", this);
 }
@@ -77,8 +107,8 @@ zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
                   node_offset, index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
+    auto pln = FindNode(node_offset);
+    if (!pln) {
         fbl::AllocChecker ac;
         fbl::unique_ptr<VmPageListNode> pl =
             fbl::unique_ptr<VmPageListNode>(new (&ac) VmPageListNode(node_offset));
@@ -89,6 +119,7 @@ zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
         __UNUSED auto status = pl->AddPage(p, index);
         DEBUG_ASSERT(status == ZX_OK);
 
+        last_node_ = pl.get();
         list_.insert(fbl::move(pl));
     } else {
         pln->AddPage(p, index);
@@ -105,15 +136,15 @@ vm_page* VmPageList::GetPage(uint64_t offset) {
                   index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
+    auto pln = FindNode(node_offset);
+    if (!pln) {
         return nullptr;
     }
 
     return pln->GetPage(index);
 }
 
-zx_status_t VmPageList::FreePage(uint64_t offset) {
+vm_page* VmPageList::RemovePage(uint64_t offset) {
     uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
     size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
 
@@ -121,23 +152,57 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
                   index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
-        return ZX_ERR_NOT_FOUND;
+    auto pln = FindNode(node_offset);
+    if (!pln) {
+        return nullptr;
     }
 
-    // free this page
+    // detach this page
     auto page = pln->RemovePage(index);
     if (page) {
         // if it was the last page in the node, remove the node from the tree
         if (pln->IsEmpty()) {
             LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
-            list_.erase(*pln);
+            EraseNode(pln);
+        }
+    }
+
+    return page;
+}
+
+size_t VmPageList::RemovePages(uint64_t start_offset, uint64_t end_offset, list_node* pages) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(start_offset) && IS_PAGE_ALIGNED(end_offset));
+    LTRACEF_LEVEL(2, "%p start %#" PRIx64 " end %#" PRIx64 "\n", this, start_offset, end_offset);
+
+    size_t count = 0;
+
+    // start with the node that may hold start_offset, as in ForEveryPageInRange
+    auto itr = --list_.upper_bound(start_offset);
+    if (!itr.IsValid()) {
+        itr = list_.begin();
+    }
+    while (itr.IsValid() && itr->offset() < end_offset) {
+        VmPageListNode* pln = &*itr;
+        // step past the node before it can be erased
+        ++itr;
+
+        count += pln->RemovePages(start_offset, end_offset, pages);
+        if (pln->IsEmpty()) {
+            EraseNode(pln);
         }
+    }
 
-        pmm_free_page(page);
+    return count;
+}
+
+zx_status_t VmPageList::FreePage(uint64_t offset) {
+    auto page = RemovePage(offset);
+    if (!page) {
+        return ZX_ERR_NOT_FOUND;
     }
 
+    pmm_free_page(page);
+
     return ZX_OK;
 }
 
@@ -166,7 +231,29 @@ size_t VmPageList::FreeAllPages() {
     DEBUG_ASSERT(freed == count);
 
     // empty the tree
+    last_node_ = nullptr;
     list_.clear();
 
     return count;
 }
+
+VmPageListNode* VmPageList::FindNode(uint64_t node_offset) {
+    if (last_node_ && last_node_->offset() == node_offset) {
+        return last_node_;
+    }
+
+    auto pln = list_.find(node_offset);
+    if (!pln.IsValid()) {
+        return nullptr;
+    }
+
+    last_node_ = &*pln;
+    return last_node_;
+}
+
+void VmPageList::EraseNode(VmPageListNode* node) {
+    if (last_node_ == node) {
+        last_node_ = nullptr;
+    }
+    list_.erase(*node);
+}
@@ -0,0 +1,134 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/vm_object_paged.h>
+
+#include "vm_priv.h"
+
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/console.h>
+#include <lk/init.h>
+#include <platform.h>
+#include <stdio.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/pmm.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// How long an unlocked discardable VMO has to go untouched before aging moves
+// it to the inactive list. Aging runs this often as well.
+static zx_duration_t reclaim_age;
+
+// Whether anonymous VMOs are compressed when discarding falls short.
+static bool compress_enabled;
+
+static int vm_reclaim_thread(void*) {
+    for (;;) {
+        size_t target;
+        zx_status_t status = pmm_wait_for_reclaim(current_time() + reclaim_age, &target);
+
+        VmObjectPaged::AgeDiscardable(reclaim_age);
+        if (status != ZX_OK || target == 0)
+            continue;
+
+        size_t freed = VmObjectPaged::ReclaimDiscardable(target);
+        LTRACEF("wanted %zu pages, freed %zu\n", target, freed);
+
+        // discarding is cheaper to undo than compressing, so it goes first
+        if (compress_enabled && freed < target) {
+            size_t compressed = VmObjectPaged::CompressInactive(target - freed);
+            LTRACEF("freed %zu more by compression\n", compressed);
+        }
+    }
+    return 0;
+}
+
+static void vm_reclaim_init(uint level) {
+    // Be sure to update kernel_cmdline.md if any of these defaults change.
+    if (!cmdline_get_bool("kernel.vm.reclaim.enable", true))
+        return;
+    reclaim_age = ZX_SEC(cmdline_get_uint64("kernel.vm.reclaim.age-sec", 10));
+    const uint64_t low_mb = cmdline_get_uint64("kernel.vm.reclaim.low-mb", 100);
+    const uint64_t high_mb = cmdline_get_uint64("kernel.vm.reclaim.high-mb", 150);
+    compress_enabled = cmdline_get_bool("kernel.vm.compress.enable", true);
+    if (reclaim_age == 0)
+        reclaim_age = ZX_SEC(1);
+
+    thread_t* t = thread_create("vm reclaim", &vm_reclaim_thread, nullptr,
+                                HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("VM: failed to create the reclaim thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+
+    pmm_set_reclaim_watermarks(low_mb * MB / PAGE_SIZE, high_mb * MB / PAGE_SIZE);
+}
+LK_INIT_HOOK_DEFERRED(vm_reclaim, &vm_reclaim_init, LK_INIT_LEVEL_THREADING);
+
+#if WITH_LIB_CONSOLE
+
+static int cmd_reclaim(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+    notenoughargs:
+        printf("not enough arguments\n");
+    usage:
+        printf("usage:\n");
+        printf("%s info                : reclaim statistics\n", argv[0].str);
+        printf("%s age                 : age unlocked discardable and anonymous VMOs now\n",
+               argv[0].str);
+        printf("%s reclaim <pages>     : discard up to <pages> pages now\n", argv[0].str);
+        printf("%s compress <pages>    : compress inactive VMOs until <pages> pages are freed\n",
+               argv[0].str);
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (!strcmp(argv[1].str, "info")) {
+        VmObjectPaged::ReclaimStats stats;
+        VmObjectPaged::GetReclaimStats(&stats);
+        printf("active %zu inactive %zu reclaimable pages %zu\n",
+               stats.active_objects, stats.inactive_objects, stats.reclaimable_pages);
+        printf("reclaimed %" PRIu64 " pages from %" PRIu64 " vmos\n",
+               stats.reclaimed_pages, stats.reclaimed_objects);
+
+        VmCompressedPages::Stats compress;
+        VmCompressedPages::GetStats(&compress);
+        printf("compression: active %zu inactive %zu, freed %" PRIu64 " pages\n",
+               stats.compress_active_objects, stats.compress_inactive_objects,
+               stats.compressed_pages_freed);
+        printf("compressed %zu pages into %zu bytes (%zu%%), %" PRIu64 " in %" PRIu64
+               " out %" PRIu64 " rejected\n",
+               compress.pages, compress.stored_bytes,
+               compress.pages ? compress.stored_bytes * 100 / (compress.pages * PAGE_SIZE) : 0,
+               compress.compressed, compress.decompressed, compress.rejected);
+    } else if (!strcmp(argv[1].str, "age")) {
+        VmObjectPaged::AgeDiscardable(0);
+    } else if (!strcmp(argv[1].str, "reclaim")) {
+        if (argc < 3)
+            goto notenoughargs;
+        size_t freed = VmObjectPaged::ReclaimDiscardable(argv[2].u);
+        printf("freed %zu pages\n", freed);
+    } else if (!strcmp(argv[1].str, "compress")) {
+        if (argc < 3)
+            goto notenoughargs;
+        size_t freed = VmObjectPaged::CompressInactive(argv[2].u);
+        printf("freed %zu pages\n", freed);
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+
+    return ZX_OK;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("reclaim", "discardable memory reclamation", &cmd_reclaim)
+STATIC_COMMAND_END(reclaim);
+
+#endif // WITH_LIB_CONSOLE
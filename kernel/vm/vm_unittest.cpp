@@ -8,13 +8,17 @@
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <inttypes.h>
+#include <platform.h>
 #include <unittest.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
+#include <vm/vm_compressed_pages.h>
 #include <vm/vm_object.h>
 #include <vm/vm_object_paged.h>
 #include <vm/vm_object_physical.h>
+#include <vm/vm_page_list.h>
 #include <zircon/types.h>
 
 static const uint kArchRwFlags = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE;
@@ -305,6 +309,64 @@ static bool vmaspace_alloc_smoke_test(void* context) {
     END_TEST;
 }
 
+// Fills a vmar with one page mappings placed at random, unmaps every other
+// page, and checks that new mappings are only placed where they fit.
+static bool vmaspace_fragmented_alloc_test(void* context) {
+    BEGIN_TEST;
+    static const size_t kPages = 64;
+    static const uint32_t kVmarFlags = VMAR_FLAG_CAN_MAP_READ | VMAR_FLAG_CAN_MAP_WRITE;
+
+    auto aspace = VmAspace::Create(0, "test aspace3");
+    REQUIRE_NONNULL(aspace, "VmAspace::Create pointer");
+
+    fbl::RefPtr<VmAddressRegion> vmar;
+    zx_status_t status = aspace->RootVmar()->CreateSubVmar(0, kPages * PAGE_SIZE, 0, kVmarFlags,
+                                                           "test vmar", &vmar);
+    REQUIRE_EQ(ZX_OK, status, "creating vmar\n");
+
+    fbl::RefPtr<VmObject> vmo;
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, PAGE_SIZE, &vmo);
+    REQUIRE_EQ(ZX_OK, status, "vmobject creation\n");
+
+    fbl::RefPtr<VmMapping> mappings[kPages];
+    for (size_t i = 0; i < kPages; ++i) {
+        status = vmar->CreateVmMapping(0, PAGE_SIZE, 0, kVmarFlags, vmo, 0, kArchRwFlags,
+                                       "test", &mappings[i]);
+        REQUIRE_EQ(ZX_OK, status, "filling vmar\n");
+    }
+
+    fbl::RefPtr<VmMapping> mapping;
+    status = vmar->CreateVmMapping(0, PAGE_SIZE, 0, kVmarFlags, vmo, 0, kArchRwFlags,
+                                   "test", &mapping);
+    EXPECT_EQ(ZX_ERR_NO_MEMORY, status, "mapping into a full vmar\n");
+
+    // Leave only gaps of one page.
+    for (size_t i = 0; i < kPages; ++i) {
+        if (((mappings[i]->base() - vmar->base()) / PAGE_SIZE) % 2 == 0) {
+            EXPECT_EQ(ZX_OK, mappings[i]->Destroy(), "unmapping\n");
+        }
+    }
+
+    status = vmar->CreateVmMapping(0, 2 * PAGE_SIZE, 0, kVmarFlags, vmo, 0, kArchRwFlags,
+                                   "test", &mapping);
+    EXPECT_EQ(ZX_ERR_NO_MEMORY, status, "mapping two pages into one page gaps\n");
+
+    for (size_t i = 0; i < kPages / 2; ++i) {
+        status = vmar->CreateVmMapping(0, PAGE_SIZE, 0, kVmarFlags, vmo, 0, kArchRwFlags,
+                                       "test", &mapping);
+        REQUIRE_EQ(ZX_OK, status, "refilling vmar\n");
+        EXPECT_EQ(0u, ((mapping->base() - vmar->base()) / PAGE_SIZE) % 2,
+                  "mapping placed in a gap\n");
+    }
+
+    status = vmar->CreateVmMapping(0, PAGE_SIZE, 0, kVmarFlags, vmo, 0, kArchRwFlags,
+                                   "test", &mapping);
+    EXPECT_EQ(ZX_ERR_NO_MEMORY, status, "mapping into a refilled vmar\n");
+
+    aspace->Destroy();
+    END_TEST;
+}
+
 // Doesn't do anything, just prints all aspaces.
 // Should be run after all other tests so that people can manually comb
 // through the output for leaked test aspaces.
@@ -887,6 +949,234 @@ static bool vmo_lookup_test(void* context) {
     END_TEST;
 }
 
+// Locks and unlocks a discardable VMO and checks that only unlocked ones count
+// as reclaimable.
+static bool vmo_discardable_test(void* context) {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 16;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+    bool discarded;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->LockDiscardable(&discarded), "not discardable\n");
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->UnlockDiscardable(), "not discardable\n");
+
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, VmObjectPaged::kDiscardable, alloc_size,
+                                   &vmo);
+    REQUIRE_EQ(status, ZX_OK, "vmobject creation\n");
+    EXPECT_EQ(ZX_ERR_BAD_STATE, vmo->UnlockDiscardable(), "unlocking while unlocked\n");
+
+    fbl::RefPtr<VmObject> clone;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->CloneCOW(0, alloc_size, false, &clone), "cloning\n");
+
+    EXPECT_EQ(ZX_OK, vmo->LockDiscardable(&discarded), "locking\n");
+    EXPECT_FALSE(discarded, "not discarded yet\n");
+    EXPECT_EQ(ZX_OK, vmo->CommitRange(0, alloc_size, nullptr), "committing\n");
+
+    VmObjectPaged::ReclaimStats before;
+    VmObjectPaged::GetReclaimStats(&before);
+    EXPECT_EQ(ZX_OK, vmo->UnlockDiscardable(), "unlocking\n");
+    VmObjectPaged::ReclaimStats after;
+    VmObjectPaged::GetReclaimStats(&after);
+    EXPECT_EQ(before.reclaimable_pages + alloc_size / PAGE_SIZE, after.reclaimable_pages,
+              "unlocked pages are reclaimable\n");
+    EXPECT_EQ(before.active_objects + 1, after.active_objects, "unlocked vmo is active\n");
+
+    // relocking takes it back off the reclaim list, unless it was discarded in between
+    EXPECT_EQ(ZX_OK, vmo->LockDiscardable(&discarded), "relocking\n");
+    if (!discarded) {
+        VmObjectPaged::GetReclaimStats(&after);
+        EXPECT_EQ(before.reclaimable_pages, after.reclaimable_pages,
+                  "locked pages are not reclaimable\n");
+        EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->AllocatedPages(), "pages kept\n");
+    }
+    EXPECT_EQ(ZX_OK, vmo->UnlockDiscardable(), "unlocking\n");
+
+    END_TEST;
+}
+
+// Detaches a range of pages in bulk, across node boundaries.
+static bool vmpl_remove_pages_test(void* context) {
+    BEGIN_TEST;
+
+    static const size_t kPages = VmPageListNode::kPageFanOut * 3;
+    static vm_page_t pages[kPages];
+    VmPageList pl;
+    for (size_t i = 0; i < kPages; i++) {
+        EXPECT_EQ(ZX_OK, pl.AddPage(&pages[i], i * PAGE_SIZE), "");
+    }
+
+    // take everything but the first and last page
+    list_node list = LIST_INITIAL_VALUE(list);
+    size_t count = pl.RemovePages(PAGE_SIZE, (kPages - 1) * PAGE_SIZE, &list);
+    EXPECT_EQ(kPages - 2, count, "");
+    EXPECT_EQ(kPages - 2, list_length(&list), "");
+    EXPECT_EQ(&pages[1], list_peek_head_type(&list, vm_page_t, free.node), "");
+
+    EXPECT_EQ(&pages[0], pl.GetPage(0), "");
+    EXPECT_NULL(pl.GetPage(PAGE_SIZE), "");
+    EXPECT_NULL(pl.GetPage(VmPageListNode::kPageFanOut * PAGE_SIZE), "");
+    EXPECT_EQ(&pages[kPages - 1], pl.GetPage((kPages - 1) * PAGE_SIZE), "");
+
+    EXPECT_EQ(&pages[0], pl.RemovePage(0), "");
+    EXPECT_EQ(&pages[kPages - 1], pl.RemovePage((kPages - 1) * PAGE_SIZE), "");
+
+    END_TEST;
+}
+
+// Compresses pages into a store and gets them back, and checks that pages that
+// don't shrink enough are turned away.
+static bool vmcp_round_trip_test(void* context) {
+    BEGIN_TEST;
+
+    static uint8_t page[PAGE_SIZE];
+    static uint8_t out[PAGE_SIZE];
+    VmCompressedPages store;
+
+    // a repeating pattern compresses well
+    for (size_t i = 0; i < PAGE_SIZE; i++) {
+        page[i] = static_cast<uint8_t>(i % 61);
+    }
+    EXPECT_EQ(ZX_OK, store.Insert(PAGE_SIZE * 3, page), "compressible page\n");
+    EXPECT_TRUE(store.Contains(PAGE_SIZE * 3), "");
+    EXPECT_EQ(1u, store.page_count(), "");
+    EXPECT_LT(store.stored_bytes(), PAGE_SIZE / 4, "pattern compresses\n");
+
+    // pseudo-random bytes don't
+    uint32_t x = 1;
+    for (size_t i = 0; i < PAGE_SIZE; i++) {
+        x = x * 1103515245 + 12345;
+        out[i] = static_cast<uint8_t>(x >> 16);
+    }
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, store.Insert(0, out), "incompressible page\n");
+    EXPECT_FALSE(store.Contains(0), "");
+
+    uint64_t offset;
+    EXPECT_TRUE(store.FirstInRange(0, PAGE_SIZE * 8, &offset), "");
+    EXPECT_EQ(PAGE_SIZE * 3, offset, "");
+    EXPECT_FALSE(store.FirstInRange(PAGE_SIZE * 4, PAGE_SIZE * 8, &offset), "");
+
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, store.Take(0, out), "");
+    EXPECT_EQ(ZX_OK, store.Take(PAGE_SIZE * 3, out), "");
+    EXPECT_EQ(0, memcmp(page, out, PAGE_SIZE), "contents survive\n");
+    EXPECT_TRUE(store.is_empty(), "taken pages are dropped\n");
+    EXPECT_EQ(0u, store.stored_bytes(), "");
+
+    EXPECT_EQ(ZX_OK, store.Insert(0, page), "");
+    EXPECT_EQ(ZX_OK, store.Insert(PAGE_SIZE, page), "");
+    EXPECT_EQ(2u, store.CountInRange(0, PAGE_SIZE * 2), "");
+    EXPECT_EQ(1u, store.RemoveRange(PAGE_SIZE, PAGE_SIZE * 2), "");
+    EXPECT_EQ(1u, store.page_count(), "");
+
+    END_TEST;
+}
+
+static paddr_t vmo_merge_test_paddr(const fbl::RefPtr<VmObject>& vmo) {
+    paddr_t pa = 0;
+    auto lookup_fn = [](void* context, size_t offset, size_t index, paddr_t pa) {
+        *static_cast<paddr_t*>(context) = pa;
+        return ZX_OK;
+    };
+    vmo->Lookup(0, PAGE_SIZE, 0, lookup_fn, &pa);
+    return pa;
+}
+
+// Two mergeable objects with identical pages end up sharing one, and writing
+// to the shared page gives the writer a private copy again.
+static bool vmo_merge_test(void* context) {
+    BEGIN_TEST;
+
+    fbl::RefPtr<VmObject> vmos[2];
+    static uint8_t page[PAGE_SIZE];
+    static uint8_t out[PAGE_SIZE];
+    for (size_t i = 0; i < PAGE_SIZE; i++) {
+        page[i] = static_cast<uint8_t>((i * 7) % 251);
+    }
+    for (auto& vmo : vmos) {
+        zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, PAGE_SIZE, &vmo);
+        REQUIRE_EQ(ZX_OK, status, "vmobject creation\n");
+        // only objects handed out to userspace may be merged
+        EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->SetMergeable(true), "");
+        vmo->set_user_id(1);
+        EXPECT_EQ(ZX_OK, vmo->SetMergeable(true), "");
+        EXPECT_EQ(ZX_OK, vmo->Write(page, 0, PAGE_SIZE, nullptr), "");
+    }
+
+    // the first sighting of the contents only records them, and scans elsewhere
+    // may have moved where this one starts
+    for (int i = 0; i < 4 && vmo_merge_test_paddr(vmos[0]) != vmo_merge_test_paddr(vmos[1]);
+         i++) {
+        VmObjectPaged::ScanMergeable(SIZE_MAX);
+    }
+    EXPECT_EQ(vmo_merge_test_paddr(vmos[0]), vmo_merge_test_paddr(vmos[1]), "pages merged\n");
+
+    const uint8_t byte = 0x5a;
+    EXPECT_EQ(ZX_OK, vmos[0]->Write(&byte, 0, 1, nullptr), "");
+    EXPECT_NE(vmo_merge_test_paddr(vmos[0]), vmo_merge_test_paddr(vmos[1]), "write unmerges\n");
+    EXPECT_EQ(ZX_OK, vmos[1]->Read(out, 0, PAGE_SIZE, nullptr), "");
+    EXPECT_EQ(0, memcmp(page, out, PAGE_SIZE), "other holder keeps its contents\n");
+    EXPECT_EQ(ZX_OK, vmos[0]->Read(out, 0, 1, nullptr), "");
+    EXPECT_EQ(byte, out[0], "");
+
+    END_TEST;
+}
+
+// Walks |pages| pages of a page list in order, or with a large odd stride
+// that visits every page in a scattered order.
+static uint64_t vmpl_bench_offset(size_t i, size_t pages, bool random) {
+    return (random ? (i * 0x9e3779b1u) % pages : i) * PAGE_SIZE;
+}
+
+// Times adding, looking up and removing pages in a page list at several object
+// sizes. The list only stores the page pointers, so a single dummy page stands
+// in for all of them and no memory is committed.
+static bool vmpl_benchmark(void* context) {
+    BEGIN_TEST;
+
+    vm_page_t dummy = {};
+    static const size_t kSizes[] = {1ul << 20, 64ul << 20, 1ul << 30, 4ul << 30};
+    for (const size_t size : kSizes) {
+        const size_t pages = size / PAGE_SIZE;
+        for (int pass = 0; pass < 2; pass++) {
+            const bool random = pass != 0;
+            VmPageList pl;
+
+            zx_time_t t = current_time();
+            for (size_t i = 0; i < pages; i++) {
+                if (pl.AddPage(&dummy, vmpl_bench_offset(i, pages, random)) != ZX_OK)
+                    break;
+            }
+            const zx_time_t add = current_time() - t;
+
+            size_t found = 0;
+            t = current_time();
+            for (size_t i = 0; i < pages; i++) {
+                if (pl.GetPage(vmpl_bench_offset(i, pages, random)))
+                    found++;
+            }
+            const zx_time_t lookup = current_time() - t;
+
+            size_t removed = 0;
+            t = current_time();
+            for (size_t i = 0; i < pages; i++) {
+                if (pl.RemovePage(vmpl_bench_offset(i, pages, random)))
+                    removed++;
+            }
+            const zx_time_t remove = current_time() - t;
+
+            printf("%6zu MiB %s: add %" PRIu64 " lookup %" PRIu64 " remove %" PRIu64
+                   " ns per page\n",
+                   size >> 20, random ? "random    " : "sequential",
+                   add / pages, lookup / pages, remove / pages);
+            EXPECT_EQ(pages, found, "");
+            EXPECT_EQ(pages, removed, "");
+        }
+    }
+
+    END_TEST;
+}
+
 // TODO(ZX-1431): The ARM code's error codes are always ZX_ERR_INTERNAL, so
 // special case that.
 #if ARCH_ARM64
@@ -981,6 +1271,7 @@ VM_UNITTEST(vmm_alloc_contiguous_missing_flag_commit_fails)
 VM_UNITTEST(vmm_alloc_contiguous_zero_size_fails)
 VM_UNITTEST(vmaspace_create_smoke_test)
 VM_UNITTEST(vmaspace_alloc_smoke_test)
+VM_UNITTEST(vmaspace_fragmented_alloc_test)
 VM_UNITTEST(vmo_create_test)
 VM_UNITTEST(vmo_pin_test)
 VM_UNITTEST(vmo_multiple_pin_test)
@@ -995,6 +1286,11 @@ VM_UNITTEST(vmo_double_remap_test)
 VM_UNITTEST(vmo_read_write_smoke_test)
 VM_UNITTEST(vmo_cache_test)
 VM_UNITTEST(vmo_lookup_test)
+VM_UNITTEST(vmo_discardable_test)
+VM_UNITTEST(vmpl_remove_pages_test)
+VM_UNITTEST(vmcp_round_trip_test)
+VM_UNITTEST(vmo_merge_test)
+VM_UNITTEST(vmpl_benchmark)
 VM_UNITTEST(arch_noncontiguous_map)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
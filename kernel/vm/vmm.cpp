@@ -45,21 +45,35 @@ zx_status_t vmm_page_fault_handler(vaddr_t addr, uint flags) {
     // hardware fault, mark it as such
     flags |= VMM_PF_FLAG_HW_FAULT;
 
-#if TRACE_PAGE_FAULT || LOCAL_TRACE
     thread_t* current_thread = get_current_thread();
+
+#if TRACE_PAGE_FAULT || LOCAL_TRACE
     TRACEF("thread %s va %#" PRIxPTR ", flags 0x%x\n", current_thread->name, addr, flags);
 #endif
 
-    ktrace(TAG_PAGE_FAULT, (uint32_t)(addr >> 32), (uint32_t)addr, flags, arch_curr_cpu_num());
+    const bool traced = ktrace_sample(TAG_PAGE_FAULT);
+    if (traced) {
+        ktrace(TAG_PAGE_FAULT, (uint32_t)(addr >> 32), (uint32_t)addr, flags, arch_curr_cpu_num());
+    }
 
     // get the address space object this pointer is in
     VmAspace* aspace = VmAspace::vaddr_to_aspace(addr);
     if (!aspace)
         return ZX_ERR_NOT_FOUND;
 
-    // page fault it
+    // page fault it, keeping track of the time the thread spends doing so
+    const zx_time_t start = current_time();
+    const zx_duration_t start_runtime = thread_current_runtime();
+
     zx_status_t status = aspace->PageFault(addr, flags);
 
+    current_thread->page_faults++;
+    current_thread->page_fault_ns += current_time() - start;
+    // faults taken in the kernel are already part of a syscall's time
+    if (flags & VMM_PF_FLAG_USER) {
+        current_thread->kernel_ns += thread_current_runtime() - start_runtime;
+    }
+
     // If it's a user fault, dump info about process memory usage.
     // If it's a kernel fault, the kernel could possibly already
     // hold locks on VMOs, Aspaces, etc, so we can't safely do
@@ -69,7 +83,9 @@ zx_status_t vmm_page_fault_handler(vaddr_t addr, uint flags) {
         DumpProcessMemoryUsage("PageFault: MemoryUsed: ", 8 * 256);
     }
 
-    ktrace(TAG_PAGE_FAULT_EXIT, (uint32_t)(addr >> 32), (uint32_t)addr, flags, arch_curr_cpu_num());
+    if (traced) {
+        ktrace(TAG_PAGE_FAULT_EXIT, (uint32_t)(addr >> 32), (uint32_t)addr, flags, arch_curr_cpu_num());
+    }
 
     return status;
 }
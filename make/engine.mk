@@ -41,6 +41,8 @@ THINLTO_CACHE_DIR ?= $(BUILDDIR)/thinlto-cache
 LKNAME ?= zircon
 CLANG_TARGET_FUCHSIA ?= false
 USE_LINKER_GC ?= true
+ENABLE_LOCK_PROFILING ?= false
+ENABLE_SYSCALL_PROFILING ?= false
 HOST_USE_ASAN ?= false
 
 ifeq ($(call TOBOOL,$(ENABLE_ULIB_ONLY)),true)
@@ -591,6 +593,16 @@ GLOBAL_DEFINES += \
     ZX_DEBUGLEVEL=$(DEBUG)
 endif
 
+# profile contended kernel locks?
+ifeq ($(call TOBOOL,$(ENABLE_LOCK_PROFILING)),true)
+KERNEL_DEFINES += LOCK_PROFILING=1
+endif
+
+# time each system call?
+ifeq ($(call TOBOOL,$(ENABLE_SYSCALL_PROFILING)),true)
+KERNEL_DEFINES += SYSCALL_PROFILING=1
+endif
+
 # allow additional defines from outside the build system
 ifneq ($(EXTERNAL_DEFINES),)
 GLOBAL_DEFINES += $(EXTERNAL_DEFINES)
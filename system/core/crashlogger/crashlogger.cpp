@@ -345,6 +345,7 @@ void process_report(uint64_t pid, uint64_t tid, uint32_t type, bool use_libunwin
         inspector_dso_print_list(stdout, dso_list);
         inspector_print_backtrace(stdout, process, thread, dso_list,
                                   pc, sp, fp, use_libunwind);
+        inspector_dso_free_list(dso_list);
     }
 
     // TODO(ZX-588): Print a backtrace of all other threads in the process.
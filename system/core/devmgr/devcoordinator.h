@@ -144,13 +144,24 @@ struct dc_driver {
     uint32_t flags;
     struct list_node node;
     const char* libname;
+    // The protocol a device must have for the binding program to match
+    // it, or 0 if the program does not require one.  Lets most drivers
+    // be passed over without running their binding programs.
+    uint32_t protocol_id;
+    // The driver's shared library, read on its first bind.
+    zx_handle_t dso_vmo;
 };
 
+// Bind in the devhost of the device, even one which asks to be isolated,
+// so that calls between the two are not made over a channel.
+#define DRIVER_FLAG_COLOCATE 0x00000001
+
 #define DRIVER_NAME_LEN_MAX 64
 
 zx_status_t devfs_publish(device_t* parent, device_t* dev);
 void devfs_unpublish(device_t* dev);
 void devfs_advertise(device_t* dev);
+void devfs_flush_watchers(void);
 
 device_t* coordinator_init(zx_handle_t root_job);
 void coordinator(void);
@@ -164,6 +175,8 @@ bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     zx_device_prop_t* props, size_t prop_count,
                     bool autobind);
 
+uint32_t dc_binding_protocol(const zx_bind_inst_t* binding, uint32_t binding_size);
+
 #define DC_MAX_DATA 4096
 
 // The first two fields of devcoordinator messages align
@@ -138,6 +138,39 @@ next_instruction:
     return false;
 }
 
+// Finds the protocol a binding program requires, if any: one which it
+// aborts without, or the only one it matches, before it can branch or
+// match anything else.
+uint32_t dc_binding_protocol(const zx_bind_inst_t* binding, uint32_t binding_size) {
+    const zx_bind_inst_t* ip = binding;
+    const zx_bind_inst_t* end = ip + (binding_size / sizeof(zx_bind_inst_t));
+
+    for (; ip < end; ip++) {
+        uint32_t inst = ip->op;
+        bool on_protocol = (BINDINST_CC(inst) != COND_AL) &&
+                           (BINDINST_PB(inst) == BIND_PROTOCOL);
+        switch (BINDINST_OP(inst)) {
+        case OP_ABORT:
+            if (on_protocol && (BINDINST_CC(inst) == COND_NE)) {
+                return ip->arg;
+            }
+            break;
+        case OP_MATCH:
+            if (on_protocol && (BINDINST_CC(inst) == COND_EQ) && (ip + 1 == end)) {
+                return ip->arg;
+            }
+            return 0;
+        case OP_SET:
+        case OP_CLEAR:
+        case OP_LABEL:
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 0;
+}
+
 bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     zx_device_prop_t* props, size_t prop_count,
                     bool autobind) {
@@ -148,6 +181,9 @@ bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
     ctx.props = props;
     ctx.end = props + prop_count;
     ctx.protocol_id = protocol_id;
+    if ((drv->protocol_id != 0) && (drv->protocol_id != dev_get_prop(&ctx, BIND_PROTOCOL))) {
+        return false;
+    }
     ctx.binding = drv->binding;
     ctx.binding_size = drv->binding_size;
     ctx.name = drv->name;
@@ -11,6 +11,7 @@
 #include <ddk/driver.h>
 #include <driver-info/driver-info.h>
 #include <launchpad/launchpad.h>
+#include <launchpad/vmo.h>
 #include <zircon/assert.h>
 #include <zircon/ktrace.h>
 #include <zircon/processargs.h>
@@ -235,17 +236,22 @@ static zx_status_t libname_to_vmo(const char* libname, zx_handle_t* out) {
         log(ERROR, "devcoord: cannot find driver '%s'\n", libname);
         return ZX_ERR_NOT_FOUND;
     }
-    int fd = open(libname, O_RDONLY);
-    if (fd < 0) {
-        log(ERROR, "devcoord: cannot open driver '%s'\n", libname);
-        return ZX_ERR_IO;
-    }
-    zx_status_t r = fdio_get_vmo(fd, out);
-    close(fd);
-    if (r < 0) {
-        log(ERROR, "devcoord: cannot get driver vmo '%s'\n", libname);
+    // drivers bound to many devices are only read once
+    if (drv->dso_vmo == ZX_HANDLE_INVALID) {
+        int fd = open(libname, O_RDONLY);
+        if (fd < 0) {
+            log(ERROR, "devcoord: cannot open driver '%s'\n", libname);
+            return ZX_ERR_IO;
+        }
+        zx_status_t r = fdio_get_vmo(fd, &drv->dso_vmo);
+        close(fd);
+        if (r < 0) {
+            log(ERROR, "devcoord: cannot get driver vmo '%s'\n", libname);
+            drv->dso_vmo = ZX_HANDLE_INVALID;
+            return r;
+        }
     }
-    return r;
+    return zx_handle_duplicate(drv->dso_vmo, ZX_RIGHT_SAME_RIGHTS, out);
 }
 
 zx_status_t devmgr_set_platform_id(zx_handle_t vmo, zx_off_t offset, size_t length) {
@@ -437,6 +443,39 @@ static const char* get_devhost_bin(void) {
 
 zx_handle_t get_service_root(void);
 
+// Boot timeline: devmgr's milestones are written into the kernel trace as
+// probes, so they line up with the kernel's own records of the same boot.
+enum {
+    TRACE_DRIVERS_LOADED,
+    TRACE_DEVHOST_LAUNCH,
+    TRACE_BIND_DRIVER,
+    TRACE_COORDINATOR_RUNNING,
+    TRACE_COUNT,
+};
+
+static const char* trace_names[TRACE_COUNT] = {
+    [TRACE_DRIVERS_LOADED] = "devmgr:drivers-loaded",
+    [TRACE_DEVHOST_LAUNCH] = "devmgr:devhost-launch",
+    [TRACE_BIND_DRIVER] = "devmgr:bind-driver",
+    [TRACE_COORDINATOR_RUNNING] = "devmgr:running",
+};
+
+static uint32_t trace_ids[TRACE_COUNT];
+
+static void dc_trace(unsigned event, uint32_t arg0, uint32_t arg1) {
+    if (trace_ids[event] == 0) {
+        char name[ZX_MAX_NAME_LEN] = {};
+        strncpy(name, trace_names[event], sizeof(name) - 1);
+        zx_status_t id = zx_ktrace_control(get_root_resource(), KTRACE_ACTION_NEW_PROBE,
+                                           0, name);
+        if (id < 0) {
+            return;
+        }
+        trace_ids[event] = id;
+    }
+    zx_ktrace_write(get_root_resource(), trace_ids[event], arg0, arg1);
+}
+
 static zx_status_t dc_get_topo_path(device_t* dev, char* out, size_t max) {
     char tmp[max];
     char* path = tmp + max - 1;
@@ -534,13 +573,38 @@ static void dc_watch(zx_handle_t h) {
     }
 }
 
+// Every devhost runs the same binary, so it is only read and parsed
+// for the first one.
+static const char* devhost_template_bin;
+static launchpad_template_t* devhost_template;
+
+static void dc_load_devhost(launchpad_t* lp, const char* devhost_bin) {
+    if (devhost_template_bin != devhost_bin) {
+        if (devhost_template != NULL) {
+            launchpad_template_destroy(devhost_template);
+            devhost_template = NULL;
+        }
+        devhost_template_bin = devhost_bin;
+        zx_handle_t vmo;
+        if (launchpad_vmo_from_file(devhost_bin, &vmo) == ZX_OK &&
+            launchpad_template_create(vmo, ZX_HANDLE_INVALID, &devhost_template) < 0) {
+            devhost_template = NULL;
+        }
+    }
+    if (devhost_template != NULL) {
+        launchpad_load_from_template(lp, devhost_template);
+    } else {
+        launchpad_load_from_file(lp, devhost_bin);
+    }
+}
+
 static zx_status_t dc_launch_devhost(devhost_t* host,
                                      const char* name, zx_handle_t hrpc) {
     const char* devhost_bin = get_devhost_bin();
 
     launchpad_t* lp;
     launchpad_create_with_jobs(devhost_job, 0, name, &lp);
-    launchpad_load_from_file(lp, devhost_bin);
+    dc_load_devhost(lp, devhost_bin);
     launchpad_set_args(lp, 1, &devhost_bin);
 
     launchpad_add_handle(lp, hrpc, PA_HND(PA_USER0, 0));
@@ -585,6 +649,7 @@ static zx_status_t dc_launch_devhost(devhost_t* host,
     }
     log(INFO, "devcoord: launch devhost '%s': pid=%zu\n",
         name, host->koid);
+    dc_trace(TRACE_DEVHOST_LAUNCH, (uint32_t)host->koid, 0);
 
     return ZX_OK;
 }
@@ -1336,6 +1401,7 @@ static zx_status_t dh_bind_driver(device_t* dev, const char* libname) {
 
     msg.txid = 0;
     msg.op = DC_OP_BIND_DRIVER;
+    dc_trace(TRACE_BIND_DRIVER, dev->host ? (uint32_t)dev->host->koid : 0, 0);
 
     if ((r = zx_channel_write(dev->hrpc, 0, &msg, mlen, &vmo, 1)) < 0) {
         free(pending);
@@ -1430,8 +1496,10 @@ static zx_status_t dc_attempt_bind(driver_t* drv, device_t* dev) {
     if ((dev->flags & DEV_CTX_BOUND) && (!(dev->flags & DEV_CTX_MULTI_BIND))) {
         return ZX_ERR_BAD_STATE;
     }
-    if (!(dev->flags & DEV_CTX_MUST_ISOLATE)) {
-        // non-busdev is pretty simple
+    if (!(dev->flags & DEV_CTX_MUST_ISOLATE) ||
+        ((drv->flags & DRIVER_FLAG_COLOCATE) && (dev->host != NULL))) {
+        // non-busdev is pretty simple, as is a driver which has been
+        // asked to share its busdev's devhost
         if (dev->host == NULL) {
             log(ERROR, "devcoord: can't bind to device without devhost\n");
             return ZX_ERR_BAD_STATE;
@@ -1690,6 +1758,8 @@ static work_t new_driver_work;
 // to the list of new drivers and work is queued to process it.  If
 // before it's added to the list of all drivers or fallback list.
 void dc_driver_added(driver_t* drv, const char* version) {
+    drv->protocol_id = dc_binding_protocol(drv->binding, drv->binding_size);
+
     //TODO: real priority scheme
     if (dc_running) {
         if (version[0] == '*') {
@@ -1828,6 +1898,7 @@ void coordinator(void) {
     find_loadable_drivers("/boot/driver");
     find_loadable_drivers("/boot/driver/test");
     find_loadable_drivers("/boot/lib/driver");
+    dc_trace(TRACE_DRIVERS_LOADED, 0, 0);
 
     // Special case early handling for the ramdisk boot
     // path where /system is present before the coordinator
@@ -1863,17 +1934,18 @@ void coordinator(void) {
     }
 
     dc_running = true;
+    dc_trace(TRACE_COORDINATOR_RUNNING, 0, 0);
 
     for (;;) {
-        zx_status_t status;
-        if (list_is_empty(&list_pending_work)) {
-            status = port_dispatch(&dc_port, ZX_TIME_INFINITE, true);
-        } else {
-            status = port_dispatch(&dc_port, 0, true);
-            if (status == ZX_ERR_TIMED_OUT) {
+        zx_status_t status = port_dispatch(&dc_port, 0, true);
+        if (status == ZX_ERR_TIMED_OUT) {
+            if (!list_is_empty(&list_pending_work)) {
                 process_work(list_remove_head_type(&list_pending_work, work_t, node));
                 continue;
             }
+            // idle: deliver the devfs events gathered since last time
+            devfs_flush_watchers();
+            status = port_dispatch(&dc_port, ZX_TIME_INFINITE, true);
         }
         if (status != ZX_OK) {
             log(ERROR, "devcoord: port dispatch ended: %d\n", status);
@@ -28,6 +28,13 @@ struct dc_watcher {
     devnode_t* devnode;
     uint32_t mask;
     zx_handle_t handle;
+
+    // events not yet sent, packed as vfs_watch_msg_t records
+    uint8_t* buf;
+    size_t buflen;
+
+    // entry in the list of watchers with events to send
+    list_node_t dirty_node;
 };
 
 struct dc_devnode {
@@ -43,6 +50,11 @@ struct dc_devnode {
     // entry in our parent devnode's children list
     list_node_t node;
 
+    // our parent devnode, and the next devnode in our
+    // bucket of the name hash
+    devnode_t* parent;
+    devnode_t* hash_next;
+
     // list of our child devnodes
     list_node_t children;
 
@@ -79,6 +91,15 @@ static devnode_t root_devnode = {
 
 static devnode_t* class_devnode;
 
+// Children are looked up by name through a hash shared by all devnodes,
+// keyed on both the parent and the name, rather than by walking the
+// parent's list of children.
+#define DEVNODE_HASH_BITS 10
+static devnode_t* devnode_hash[1u << DEVNODE_HASH_BITS];
+
+// Watchers with events waiting to be sent.
+static list_node_t list_dirty_watchers = LIST_INITIAL_VALUE(list_dirty_watchers);
+
 static zx_status_t dc_rio_handler(port_handler_t* ph, zx_signals_t signals, uint32_t evt);
 static devnode_t* devfs_mkdir(devnode_t* parent, const char* name);
 
@@ -188,6 +209,61 @@ static bool devnode_is_local(devnode_t* dn) {
     return false;
 }
 
+// Sends the events a watcher has gathered as one message.  A watcher
+// whose channel cannot be written to is left with an invalid handle,
+// to be freed by the next devfs_notify() on its devnode.
+static void watcher_flush(watcher_t* w) {
+    if (list_in_list(&w->dirty_node)) {
+        list_delete(&w->dirty_node);
+    }
+    if (w->buflen == 0) {
+        return;
+    }
+    if ((w->handle != ZX_HANDLE_INVALID) &&
+        (zx_channel_write(w->handle, 0, w->buf, w->buflen, NULL, 0) < 0)) {
+        zx_handle_close(w->handle);
+        w->handle = ZX_HANDLE_INVALID;
+    }
+    free(w->buf);
+    w->buf = NULL;
+    w->buflen = 0;
+}
+
+static void watcher_destroy(watcher_t* w) {
+    watcher_flush(w);
+    zx_handle_close(w->handle);
+    free(w);
+}
+
+static void watcher_queue(watcher_t* w, unsigned op, const char* name, size_t len) {
+    if (w->buflen + sizeof(vfs_watch_msg_t) + len > VFS_WATCH_MSG_MAX) {
+        watcher_flush(w);
+    }
+    if (w->buf == NULL) {
+        if ((w->buf = malloc(VFS_WATCH_MSG_MAX)) == NULL) {
+            return;
+        }
+    }
+    vfs_watch_msg_t* msg = (vfs_watch_msg_t*) (w->buf + w->buflen);
+    msg->event = op;
+    msg->len = len;
+    memcpy(msg->name, name, len);
+    w->buflen += sizeof(vfs_watch_msg_t) + len;
+    if (!list_in_list(&w->dirty_node)) {
+        list_add_tail(&list_dirty_watchers, &w->dirty_node);
+    }
+}
+
+// Events are gathered into one message per watcher until the
+// coordinator has nothing else to do, so that a burst of devices
+// being added does not send a burst of messages to every watcher.
+void devfs_flush_watchers(void) {
+    watcher_t* w;
+    while ((w = list_peek_head_type(&list_dirty_watchers, watcher_t, dirty_node)) != NULL) {
+        watcher_flush(w);
+    }
+}
+
 static void devfs_notify(devnode_t* dn, const char* name, unsigned op) {
     watcher_t* w = dn->watchers;
     if (w == NULL) {
@@ -199,27 +275,21 @@ static void devfs_notify(devnode_t* dn, const char* name, unsigned op) {
         return;
     }
 
-    uint8_t msg[VFS_WATCH_NAME_MAX + 2];
-    msg[0] = op;
-    msg[1] = len;
-    memcpy(msg + 2, name, len);
-
     // convert to mask
-    op = (1u << op);
+    uint32_t mask = (1u << op);
 
     watcher_t** wp;
     watcher_t* next;
     for (wp = &dn->watchers; w != NULL; w = next) {
         next = w->next;
-        if (!(w->mask & op)) {
+        if (w->handle == ZX_HANDLE_INVALID) {
+            *wp = next;
+            watcher_destroy(w);
             continue;
         }
-        if (zx_channel_write(w->handle, 0, msg, len + 2, NULL, 0) < 0) {
-            *wp = next;
-            zx_handle_close(w->handle);
-            free(w);
-        } else {
-            wp = &w->next;
+        wp = &w->next;
+        if (w->mask & mask) {
+            watcher_queue(w, op, name, len);
         }
     }
 }
@@ -242,11 +312,10 @@ static zx_status_t devfs_watch(devnode_t* dn, zx_handle_t h, uint32_t mask) {
             if (child->device && (child->device->flags & DEV_CTX_INVISIBLE)) {
                 continue;
             }
-            //TODO: send multiple per write
-            devfs_notify(dn, child->name, VFS_WATCH_EVT_EXISTING);
+            watcher_queue(watcher, VFS_WATCH_EVT_EXISTING, child->name, strlen(child->name));
         }
-        devfs_notify(dn, "", VFS_WATCH_EVT_IDLE);
-
+        watcher_queue(watcher, VFS_WATCH_EVT_IDLE, "", 0);
+        watcher_flush(watcher);
     }
 
     // Don't send EXISTING or IDLE events from now on...
@@ -277,21 +346,67 @@ static devnode_t* devfs_mknode(device_t* dev, const char* name, size_t namelen)
     return dn;
 }
 
+static uint32_t devnode_hash_key(devnode_t* parent, const char* name) {
+    // FNV-1a, seeded with the parent
+    uint32_t hash = 2166136261u ^ (uint32_t)((uintptr_t)parent >> 4);
+    for (; *name; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return (hash ^ (hash >> DEVNODE_HASH_BITS)) & ((1u << DEVNODE_HASH_BITS) - 1);
+}
+
+static void devnode_add_child(devnode_t* parent, devnode_t* dn) {
+    list_add_tail(&parent->children, &dn->node);
+    dn->parent = parent;
+
+    // keep each bucket in the order devnodes were added, which is
+    // the order lookups used to find them in
+    devnode_t** dnp = &devnode_hash[devnode_hash_key(parent, dn->name)];
+    while (*dnp != NULL) {
+        dnp = &(*dnp)->hash_next;
+    }
+    dn->hash_next = NULL;
+    *dnp = dn;
+}
+
+static void devnode_remove_child(devnode_t* dn) {
+    if (list_in_list(&dn->node)) {
+        list_delete(&dn->node);
+    }
+    if (dn->parent == NULL) {
+        return;
+    }
+    devnode_t** dnp = &devnode_hash[devnode_hash_key(dn->parent, dn->name)];
+    while (*dnp != dn) {
+        dnp = &(*dnp)->hash_next;
+    }
+    *dnp = dn->hash_next;
+    dn->hash_next = NULL;
+    dn->parent = NULL;
+}
+
 static devnode_t* devfs_mkdir(devnode_t* parent, const char* name) {
     devnode_t* dn = devfs_mknode(NULL, name, 0);
     if (dn == NULL) {
         return NULL;
     }
-    list_add_tail(&parent->children, &dn->node);
+    devnode_add_child(parent, dn);
     return dn;
 }
 
-static devnode_t* devfs_lookup(devnode_t* parent, const char* name) {
+// Finds the first child of |parent| called |name|, passing over
+// invisible devices if |visible| is set.
+static devnode_t* devfs_lookup(devnode_t* parent, const char* name, bool visible) {
     devnode_t* child;
-    list_for_every_entry(&parent->children, child, devnode_t, node) {
-        if (!strcmp(name, child->name)) {
-            return child;
+    for (child = devnode_hash[devnode_hash_key(parent, name)];
+         child != NULL; child = child->hash_next) {
+        if ((child->parent != parent) || strcmp(name, child->name)) {
+            continue;
         }
+        if (visible && child->device && (child->device->flags & DEV_CTX_INVISIBLE)) {
+            continue;
+        }
+        return child;
     }
     return NULL;
 }
@@ -337,7 +452,7 @@ zx_status_t devfs_publish(device_t* parent, device_t* dev) {
 
             for (unsigned n = 0; n < 1000; n++) {
                 snprintf(tmp, sizeof(tmp), "%03u", (dir->seqcount++) % 1000);
-                if (devfs_lookup(dir, tmp) == NULL) {
+                if (devfs_lookup(dir, tmp, false) == NULL) {
                     name = tmp;
                     namelen = 4;
                     goto got_name;
@@ -356,13 +471,13 @@ got_name:
         }
 
         // add link node to class directory
-        list_add_tail(&dir->children, &dnlink->node);
+        devnode_add_child(dir, dnlink);
         dev->link = dnlink;
     }
 
 done:
     // add self node to parent directory
-    list_add_tail(&parent->self->children, &dnself->node);
+    devnode_add_child(parent->self, dnself);
     dev->self = dnself;
 
     if (!(dev->flags & DEV_CTX_INVISIBLE)) {
@@ -372,9 +487,7 @@ done:
 }
 
 static void _devfs_remove(devnode_t* dn) {
-    if (list_in_list(&dn->node)) {
-        list_delete(&dn->node);
-    }
+    devnode_remove_child(dn);
 
     // detach all connected iostates
     iostate_t* ios;
@@ -417,15 +530,16 @@ static void _devfs_remove(devnode_t* dn) {
     watcher_t* next;
     for (watcher = dn->watchers; watcher != NULL; watcher = next) {
         next = watcher->next;
-        zx_handle_close(watcher->handle);
-        free(watcher);
+        watcher_destroy(watcher);
     }
     dn->watchers = NULL;
 
     // detach children
-    while (list_remove_head(&dn->children) != NULL) {
+    devnode_t* child;
+    while ((child = list_peek_head_type(&dn->children, devnode_t, node)) != NULL) {
         // they will be unpublished when the devices they're
         // associated with are eventually destroyed
+        devnode_remove_child(child);
     }
 }
 
@@ -457,15 +571,10 @@ again:
     if (name[0] == 0) {
         return ZX_ERR_BAD_PATH;
     }
-    devnode_t* child;
-    list_for_every_entry(&dn->children, child, devnode_t, node) {
-        if (!strcmp(child->name, name)) {
-            if(child->device && (child->device->flags & DEV_CTX_INVISIBLE)) {
-                continue;
-            }
-            dn = child;
-            goto again;
-        }
+    devnode_t* child = devfs_lookup(dn, name, true);
+    if (child != NULL) {
+        dn = child;
+        goto again;
     }
     if (dn == *_dn) {
         return ZX_ERR_NOT_FOUND;
@@ -23,6 +23,13 @@ static bool is_driver_disabled(const char* name) {
     return getenv_bool(opt, false);
 }
 
+static bool is_driver_colocated(const char* name) {
+    // driver.<driver_name>.colocate
+    char opt[16 + DRIVER_NAME_LEN_MAX];
+    snprintf(opt, 16 + DRIVER_NAME_LEN_MAX, "driver.%s.colocate", name);
+    return getenv_bool(opt, false);
+}
+
 static void found_driver(zircon_driver_note_payload_t* note,
                          const zx_bind_inst_t* bi, void* cookie) {
     // ensure strings are terminated
@@ -55,6 +62,10 @@ static void found_driver(zircon_driver_note_payload_t* note,
     memcpy((void*) drv->libname, libname, pathlen);
     memcpy((void*) drv->name, note->name, namelen);
 
+    if (is_driver_colocated(note->name)) {
+        drv->flags |= DRIVER_FLAG_COLOCATE;
+    }
+
 #if VERBOSE_DRIVER_LOAD
     printf("found driver: %s\n", (char*) cookie);
     printf("        name: %s\n", note->name);
@@ -4,6 +4,7 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,6 +12,7 @@
 #include <threads.h>
 #include <unistd.h>
 
+#include <bootdata/decompress.h>
 #include <launchpad/launchpad.h>
 #include <loader-service/loader-service.h>
 #include <zircon/boot/bootdata.h>
@@ -449,7 +451,57 @@ int main(int argc, char** argv) {
     return 0;
 }
 
-static void devmgr_import_bootdata(zx_handle_t vmo) {
+#define BOOTFS_MAX_WORKERS 15
+
+static int bootfs_worker(void* work) {
+    bootfs_lazy_work(work);
+    return 0;
+}
+
+// userboot decompresses only the parts of a seekable primary bootfs it
+// needs itself; decompress the rest, on every CPU, before anything else
+// looks at it.
+static void devmgr_finish_bootfs(zx_handle_t vmo, size_t off, size_t len,
+                                 zx_handle_t bootfs_vmo) {
+    bootfs_lazy_t lazy;
+    const char* errmsg;
+    zx_status_t status = bootfs_lazy_open(zx_vmar_root_self(), vmo, off, len,
+                                          bootfs_vmo, &lazy, &errmsg);
+    if (status != ZX_OK) {
+        printf("devmgr: cannot finish decompressing bootfs: %s\n", errmsg);
+        return;
+    }
+
+    bootfs_lazy_work_t work;
+    bootfs_lazy_work_init(&work, &lazy, 0, SIZE_MAX);
+    thrd_t workers[BOOTFS_MAX_WORKERS];
+    uint32_t nworkers = zx_system_get_num_cpus() - 1;
+    if (nworkers > BOOTFS_MAX_WORKERS) {
+        nworkers = BOOTFS_MAX_WORKERS;
+    }
+    for (uint32_t i = 0; i < nworkers; i++) {
+        if (thrd_create_with_name(&workers[i], bootfs_worker, &work,
+                                  "bootfs-worker") != thrd_success) {
+            nworkers = i;
+            break;
+        }
+    }
+    bootfs_lazy_work(&work);
+    for (uint32_t i = 0; i < nworkers; i++) {
+        thrd_join(workers[i], NULL);
+    }
+
+    status = bootfs_lazy_work_finish(&work, &errmsg);
+    printf("devmgr: decompressed %u of %u bootfs frames in %" PRIu64 " us"
+           " on %u threads\n", lazy.frames_filled, lazy.frame_count,
+           lazy.fill_time / 1000, nworkers + 1);
+    if (status != ZX_OK) {
+        printf("devmgr: cannot finish decompressing bootfs: %s\n", errmsg);
+    }
+    bootfs_lazy_close(&lazy);
+}
+
+static void devmgr_import_bootdata(zx_handle_t vmo, zx_handle_t bootfs_vmo) {
     bootdata_t bootdata;
     size_t actual;
     zx_status_t status = zx_vmo_read(vmo, &bootdata, 0, sizeof(bootdata), &actual);
@@ -483,6 +535,14 @@ static void devmgr_import_bootdata(zx_handle_t vmo) {
         case BOOTDATA_PLATFORM_ID:
             devmgr_set_platform_id(vmo, off + sizeof(bootdata_t), itemlen);
             break;
+        case BOOTDATA_BOOTFS_DISCARD:
+            // this was already unpacked into the primary bootfs by userboot
+            if ((bootdata.flags & BOOTDATA_BOOTFS_FLAG_SEEKABLE) &&
+                (bootfs_vmo != ZX_HANDLE_INVALID)) {
+                devmgr_finish_bootfs(vmo, off, sizeof(bootdata_t) + bootdata.length,
+                                     bootfs_vmo);
+            }
+            break;
         default:
             break;
         }
@@ -525,6 +585,18 @@ static loader_service_t* loader_service;
 
 void fshost_start(void) {
     zx_handle_t vmo = zx_get_startup_handle(PA_HND(PA_VMO_BOOTFS, 0));
+
+    // this also finishes decompressing the primary bootfs if need be
+    zx_handle_t bootdata[MAXHND];
+    size_t bootdata_count = 0;
+    while (bootdata_count < MAXHND) {
+        uint32_t type = PA_HND(PA_VMO_BOOTDATA, bootdata_count);
+        if ((bootdata[bootdata_count] = zx_get_startup_handle(type)) == ZX_HANDLE_INVALID) {
+            break;
+        }
+        devmgr_import_bootdata(bootdata[bootdata_count++], vmo);
+    }
+
     if ((vmo == ZX_HANDLE_INVALID) ||
         (bootfs_create(&bootfs, vmo) != ZX_OK)) {
         printf("devmgr: cannot find and open bootfs\n");
@@ -575,14 +647,9 @@ void fshost_start(void) {
     }
 
     // pass bootdata VMOs to fshost
-    for (size_t m = 0; n < MAXHND; m++) {
-        uint32_t type = PA_HND(PA_VMO_BOOTDATA, m);
-        if ((handles[n] = zx_get_startup_handle(type)) != ZX_HANDLE_INVALID) {
-            devmgr_import_bootdata(handles[n]);
-            types[n++] = type;
-        } else {
-            break;
-        }
+    for (size_t m = 0; (m < bootdata_count) && (n < MAXHND); m++) {
+        handles[n] = bootdata[m];
+        types[n++] = PA_HND(PA_VMO_BOOTDATA, m);
     }
 
     // pass VDSO VMOS to fsboot
@@ -12,39 +12,87 @@
 
 #define MAX_LOG_LINE (ZX_LOG_RECORD_MAX + 32)
 
+// Header and nodename ahead of the log text of a packet.
+#define LOG_HDR_LEN (MAX_NODENAME_LENGTH + sizeof(uint32_t) * 2)
+
+// Most packets we keep in flight, should the listener allow as many.
+#define LOG_WINDOW 16
+
 static zx_handle_t loghandle;
-static logpacket_t pkt;
-static int pkt_len;
 
-static volatile uint32_t seqno = 1;
-static volatile uint32_t pending = 0;
+// Packets sent but not yet acknowledged, indexed by seqno.
+static logpacket_t pkts[LOG_WINDOW];
+static size_t pkt_lens[LOG_WINDOW];
+
+// The oldest unacknowledged packet, and the next to send. Listeners which
+// predate windowed acknowledgements take one packet at a time.
+static uint32_t ack_seqno = 1;
+static uint32_t next_seqno = 1;
+static uint32_t window = 1;
+
+// Records read from the log in one go, and a formatted line from them
+// which has yet to fit in a packet.
+static uint8_t records[4096] __ALIGNED(8);
+static size_t records_off;
+static size_t records_len;
+static char line[MAX_LOG_LINE];
+static size_t line_len;
 
 zx_time_t debuglog_next_timeout = ZX_TIME_INFINITE;
 
-static int get_log_line(char* out) {
-    char buf[ZX_LOG_RECORD_MAX + 1];
-    zx_log_record_t* rec = (zx_log_record_t*)buf;
+static bool get_log_line(void) {
     for (;;) {
-        if (zx_log_read(loghandle, ZX_LOG_RECORD_MAX, rec, 0) > 0) {
-            if (rec->datalen && (rec->data[rec->datalen - 1] == '\n')) {
-                rec->datalen--;
-            }
-            // records flagged for local display are ignored
-            if (rec->flags & ZX_LOG_LOCAL) {
-                continue;
+        if (records_off == records_len) {
+            zx_status_t r = zx_log_read(loghandle, sizeof(records), records,
+                                        ZX_LOG_READ_MULTIPLE);
+            if (r <= 0) {
+                return false;
             }
-            rec->data[rec->datalen] = 0;
-            snprintf(out, MAX_LOG_LINE, "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %s\n",
-                     (int)(rec->timestamp / 1000000000ULL),
-                     (int)((rec->timestamp / 1000000ULL) % 1000ULL),
-                     rec->pid, rec->tid, rec->data);
-            return strlen(out);
-        } else {
-            return 0;
+            records_off = 0;
+            records_len = r;
         }
+        zx_log_record_t* rec = (zx_log_record_t*)(records + records_off);
+        records_off += ZX_LOG_RECORD_SIZE(rec->datalen);
+
+        // records flagged for local display are ignored
+        if (rec->flags & ZX_LOG_LOCAL) {
+            continue;
+        }
+        int datalen = rec->datalen;
+        if (datalen && (rec->data[datalen - 1] == '\n')) {
+            datalen--;
+        }
+        int r = snprintf(line, sizeof(line), "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %.*s\n",
+                         (int)(rec->timestamp / 1000000000ULL),
+                         (int)((rec->timestamp / 1000000ULL) % 1000ULL),
+                         rec->pid, rec->tid, datalen, rec->data);
+        line_len = (r < (int)sizeof(line)) ? (size_t)r : sizeof(line) - 1;
+        return true;
     }
 }
 
+// Fills |pkt| with as many whole lines as fit, returning the length of its
+// log text, which is NUL-terminated to tell listeners we take windowed acks.
+static size_t fill_packet(logpacket_t* pkt) {
+    size_t len = 0;
+    for (;;) {
+        if (line_len == 0 && !get_log_line()) {
+            break;
+        }
+        if (len + line_len > MAX_LOG_DATA - 1) {
+            break;
+        }
+        memcpy(pkt->data + len, line, line_len);
+        len += line_len;
+        line_len = 0;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    pkt->data[len++] = 0;
+    return len;
+}
+
 int debuglog_init(void) {
     if (zx_log_create(ZX_LOG_FLAG_READABLE, &loghandle) < 0) {
         return -1;
@@ -53,60 +101,66 @@ int debuglog_init(void) {
     // Set up our timeout to expire immediately, so that we check for pending log messages
     debuglog_next_timeout = zx_clock_get(ZX_CLOCK_MONOTONIC);
 
-    seqno = 1;
-    pending = 0;
+    ack_seqno = 1;
+    next_seqno = 1;
+    window = 1;
 
     return 0;
 }
 
-// If we have an outstanding (unacknowledged) log, resend it. Otherwise, send new logs, if we
-// have any.
-static void debuglog_send(void) {
-    if (pending == 0) {
-        pkt.magic = NB_DEBUGLOG_MAGIC;
-        pkt.seqno = seqno;
-        strncpy(pkt.nodename, nodename, sizeof(pkt.nodename) - 1);
-        pkt_len = 0;
-        while (pkt_len < (MAX_LOG_DATA - MAX_LOG_LINE)) {
-            int r = get_log_line(pkt.data + pkt_len);
-            if (r > 0) {
-                pkt_len += r;
-            } else {
-                break;
-            }
+// If |resend|, send again whatever is still unacknowledged. Then send new logs, if we have
+// any, for as long as the listener's window allows. Logs left behind stay in the kernel
+// until acks come back.
+static void debuglog_send(bool resend) {
+    if (resend) {
+        for (uint32_t seqno = ack_seqno; seqno != next_seqno; seqno++) {
+            udp6_send(&pkts[seqno % LOG_WINDOW], pkt_lens[seqno % LOG_WINDOW],
+                      &ip6_ll_all_nodes, DEBUGLOG_PORT, DEBUGLOG_ACK_PORT, false);
         }
-        if (pkt_len) {
-            // include header and nodename in length
-            pkt_len += MAX_NODENAME_LENGTH + sizeof(uint32_t) * 2;
-            pending = 1;
-        } else {
-            goto done;
+    }
+    while (next_seqno - ack_seqno < window) {
+        logpacket_t* pkt = &pkts[next_seqno % LOG_WINDOW];
+        size_t len = fill_packet(pkt);
+        if (len == 0) {
+            break;
         }
+        pkt->magic = NB_DEBUGLOG_MAGIC;
+        pkt->seqno = next_seqno;
+        strncpy(pkt->nodename, nodename, sizeof(pkt->nodename) - 1);
+        pkt_lens[next_seqno % LOG_WINDOW] = LOG_HDR_LEN + len;
+        udp6_send(pkt, LOG_HDR_LEN + len, &ip6_ll_all_nodes, DEBUGLOG_PORT, DEBUGLOG_ACK_PORT,
+                  false);
+        next_seqno++;
     }
-    udp6_send(&pkt, pkt_len, &ip6_ll_all_nodes, DEBUGLOG_PORT, DEBUGLOG_ACK_PORT, false);
-done:
     debuglog_next_timeout = zx_deadline_after(ZX_MSEC(100));
 }
 
 void debuglog_recv(void* data, size_t len, bool is_mcast) {
-    // The only message we should be receiving is acknowledgement of our last transmission
-    if (!pending) {
+    // The only message we should be receiving is acknowledgement of our transmissions
+    if (ack_seqno == next_seqno) {
+        return;
+    }
+    if (((len != 8) && (len < sizeof(logack_t))) || is_mcast) {
         return;
     }
-    if ((len != 8) || is_mcast) {
+    logack_t* ack = data;
+    if (ack->magic != NB_DEBUGLOG_MAGIC) {
         return;
     }
-    logpacket_t* pkt = data;
-    if ((pkt->magic != NB_DEBUGLOG_MAGIC) || (pkt->seqno != seqno)) {
+    // Acks are cumulative; ignore those for packets already acknowledged.
+    if (ack->seqno - ack_seqno >= next_seqno - ack_seqno) {
         return;
     }
 
-    seqno++;
-    pending = 0;
-    debuglog_send();
+    ack_seqno = ack->seqno + 1;
+    if (len >= sizeof(logack_t)) {
+        window = (ack->window < 1) ? 1 : (ack->window > LOG_WINDOW) ? LOG_WINDOW : ack->window;
+    } else {
+        window = 1;
+    }
+    debuglog_send(false);
 }
 
 void debuglog_timeout_expired(void) {
-    debuglog_send();
+    debuglog_send(true);
 }
-
@@ -23,11 +23,37 @@
 
 #define TMP_SUFFIX ".netsvc.tmp"
 
+// Writes arrive a network packet at a time, so they are gathered up here and
+// go out to the filesystem in larger pieces. Anything buffered is at the end
+// of what has been written, so the file's own offset is netfile.offset less
+// netfile_buffered.
+#define NETFILE_BUFSZ (64 * 1024)
+
 netfile_state netfile = {
     .fd = -1,
     .needs_rename = false,
 };
 
+static char netfile_buf[NETFILE_BUFSZ];
+static size_t netfile_buffered;
+
+static int netfile_flush(void) {
+    if (netfile_buffered == 0) {
+        return 0;
+    }
+    ssize_t n = write(netfile.fd, netfile_buf, netfile_buffered);
+    if (n != (ssize_t)netfile_buffered) {
+        printf("netsvc: error writing %s: %d\n", netfile.filename, errno);
+        int result = (errno == 0) ? -EIO : -errno;
+        close(netfile.fd);
+        netfile.fd = -1;
+        netfile_buffered = 0;
+        return result;
+    }
+    netfile_buffered = 0;
+    return 0;
+}
+
 static int netfile_mkdir(const char* filename) {
     const char* ptr = filename[0] == '/' ? filename + 1 : filename;
     struct stat st;
@@ -58,6 +84,7 @@ int netfile_open(const char *filename, uint32_t arg, size_t* file_size) {
         close(netfile.fd);
         netfile.fd = -1;
     }
+    netfile_buffered = 0;
     size_t len = strlen(filename);
     strlcpy(netfile.filename, filename, sizeof(netfile.filename));
 
@@ -149,6 +176,10 @@ int netfile_offset_write(const char* data, off_t offset, size_t length) {
         return -EBADF;
     }
     if (offset != netfile.offset) {
+        int result = netfile_flush();
+        if (result < 0) {
+            return result;
+        }
         if (lseek(netfile.fd, offset, SEEK_SET) != offset) {
             return -errno;
         }
@@ -162,6 +193,18 @@ int netfile_write(const char* data, size_t len) {
         printf("netsvc: write, but no open file\n");
         return -EBADF;
     }
+    if (netfile_buffered + len > sizeof(netfile_buf)) {
+        int result = netfile_flush();
+        if (result < 0) {
+            return result;
+        }
+    }
+    if (len < sizeof(netfile_buf)) {
+        memcpy(netfile_buf + netfile_buffered, data, len);
+        netfile_buffered += len;
+        netfile.offset += len;
+        return len;
+    }
     ssize_t n = write(netfile.fd, data, len);
     if (n != (ssize_t)len) {
         printf("netsvc: error writing %s: %d\n", netfile.filename, errno);
@@ -178,7 +221,7 @@ int netfile_close(void) {
     int result = 0;
     if (netfile.fd < 0) {
         printf("netsvc: close, but no open file\n");
-    } else {
+    } else if ((result = netfile_flush()) == 0) {
         if (netfile.needs_rename) {
             char src[PATH_MAX];
             strlcpy(src, netfile.filename, sizeof(src));
@@ -201,6 +244,7 @@ void netfile_abort_write(void) {
     if (netfile.fd < 0) {
         return;
     }
+    netfile_buffered = 0;
     close(netfile.fd);
     netfile.fd = -1;
     char tmp[PATH_MAX];
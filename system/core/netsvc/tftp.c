@@ -4,6 +4,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
@@ -23,6 +24,8 @@
 #include "netsvc.h"
 
 #define SCRATCHSZ 2048
+// Room for a DATA packet filling a jumbo frame
+#define OUT_SCRATCHSZ (ETH_JUMBO_MTU)
 
 #define TFTP_TIMEOUT_SECS 1
 
@@ -40,6 +43,8 @@ typedef struct {
     bool is_write;
     char filename[PATH_MAX + 1];
     netfile_type_t type;
+    size_t size;                        // For reporting throughput once done
+    zx_time_t start;
     union {
         nbfile* netboot_file;
         struct {
@@ -65,7 +70,7 @@ typedef struct {
 } transport_info_t;
 
 static char tftp_session_scratch[SCRATCHSZ];
-char tftp_out_scratch[SCRATCHSZ];
+char tftp_out_scratch[OUT_SCRATCHSZ];
 
 static size_t last_msg_size = 0;
 static tftp_session* session = NULL;
@@ -87,6 +92,7 @@ static ssize_t file_open_read(const char* filename, void* cookie) {
     file_info->netboot_file = NULL;
     size_t file_size;
     if (netfile_open(filename, O_RDONLY, &file_size) == 0) {
+        file_info->size = file_size;
         return (ssize_t)file_size;
     }
     return TFTP_ERR_NOT_FOUND;
@@ -293,6 +299,7 @@ static tftp_status file_open_write(const char* filename, size_t size,
     }
     file_info_t* file_info = cookie;
     file_info->is_write = true;
+    file_info->size = size;
     strncpy(file_info->filename, filename, PATH_MAX);
     file_info->filename[PATH_MAX] = '\0';
 
@@ -421,12 +428,23 @@ static void initialize_connection(const ip6_addr_t* saddr, uint16_t sport) {
                                     file_read, file_write, file_close};
     tftp_session_set_file_interface(session, &file_ifc);
 
+    // Let the client negotiate blocks as large as the link carries, less the
+    // DATA header
+    size_t max_payload = udp6_max_payload();
+    if (max_payload > sizeof(tftp_out_scratch)) {
+        max_payload = sizeof(tftp_out_scratch);
+    }
+    tftp_session_set_max_block_size(session, max_payload - 4);
+
     // Initialize transport interface
     memcpy(&transport_info.dest_addr, saddr, sizeof(ip6_addr_t));
     transport_info.dest_port = sport;
     transport_info.timeout_ms = TFTP_TIMEOUT_SECS * 1000;
     tftp_transport_interface transport_ifc = {transport_send, NULL, transport_timeout_set};
     tftp_session_set_transport_interface(session, &transport_ifc);
+
+    file_info.size = 0;
+    file_info.start = zx_clock_get(ZX_CLOCK_MONOTONIC);
 }
 
 static void end_connection(void) {
@@ -489,11 +507,15 @@ void tftp_recv(void* data, size_t len,
     switch (status) {
     case TFTP_NO_ERROR:
         return;
-    case TFTP_TRANSFER_COMPLETED:
-        printf("netsvc: tftp %s of file %s completed\n",
+    case TFTP_TRANSFER_COMPLETED: {
+        zx_time_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - file_info.start;
+        uint64_t ms = elapsed / ZX_MSEC(1);
+        printf("netsvc: tftp %s of file %s completed (%zu bytes, %" PRIu64 " KB/s)\n",
                file_info.is_write ? "write" : "read",
-               file_info.filename);
+               file_info.filename, file_info.size,
+               ms ? file_info.size / ms : 0);
         break;
+    }
     case TFTP_ERR_SHOULD_WAIT:
         break;
     default:
@@ -15,7 +15,7 @@
 #pragma GCC visibility pop
 
 zx_handle_t bootdata_get_bootfs(zx_handle_t log, zx_handle_t vmar_self,
-                                zx_handle_t bootdata_vmo) {
+                                zx_handle_t bootdata_vmo, bootfs_lazy_t* lazy) {
     size_t off = 0;
     for (;;) {
         bootdata_t bootdata;
@@ -43,9 +43,17 @@ zx_handle_t bootdata_get_bootfs(zx_handle_t log, zx_handle_t vmar_self,
         case BOOTDATA_BOOTFS_BOOT:;
             const char* errmsg;
             zx_handle_t bootfs_vmo;
-            status = decompress_bootdata(vmar_self, bootdata_vmo, off,
-                                         bootdata.length + sizeof(bootdata),
-                                         &bootfs_vmo, &errmsg);
+            status = bootfs_lazy_open(vmar_self, bootdata_vmo, off,
+                                      bootdata.length + sizeof(bootdata),
+                                      ZX_HANDLE_INVALID, lazy, &errmsg);
+            if (status == ZX_OK) {
+                // Only what gets looked at will be decompressed.
+                bootfs_vmo = lazy->vmo;
+            } else if (status == ZX_ERR_NOT_SUPPORTED) {
+                status = decompress_bootdata(vmar_self, bootdata_vmo, off,
+                                             bootdata.length + sizeof(bootdata),
+                                             &bootfs_vmo, &errmsg);
+            }
             check(log, status, "%s", errmsg);
 
             // Signal that we've already processed this one.
@@ -6,9 +6,12 @@
 
 #pragma GCC visibility push(hidden)
 
+#include <bootdata/decompress.h>
 #include <zircon/types.h>
 
+// If the bootfs is seekable, lazy is left active and the returned VMO is
+// only filled in as bootfs_lazy_fill() is called on it.
 zx_handle_t bootdata_get_bootfs(zx_handle_t log, zx_handle_t vmar_self,
-                                zx_handle_t bootdata_vmo);
+                                zx_handle_t bootdata_vmo, bootfs_lazy_t* lazy);
 
 #pragma GCC visibility pop
@@ -8,12 +8,95 @@
 #pragma GCC visibility push(hidden)
 
 #include <zircon/boot/bootdata.h>
+#include <zircon/stack.h>
 #include <zircon/syscalls.h>
+#include <stdnoreturn.h>
 #include <string.h>
 
 #pragma GCC visibility pop
 
-void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t vmo, struct bootfs *fs) {
+// LZ4 decompression needs very little stack.
+#define WORKER_STACK_SIZE (64 << 10)
+#define WORKER_STACK_VMO_NAME "userboot-bootfs-worker-stacks"
+
+// Starting a thread costs about as much as decompressing a frame, so only
+// use one for every few frames.
+#define FRAMES_PER_WORKER 4
+
+static noreturn void bootfs_worker(uintptr_t work, uintptr_t unused) {
+    bootfs_lazy_work((bootfs_lazy_work_t*)work);
+    zx_thread_exit();
+}
+
+static void bootfs_fill(zx_handle_t log, struct bootfs *fs,
+                        size_t offset, size_t length) {
+    bootfs_lazy_work_t work;
+    bootfs_lazy_work_init(&work, fs->lazy, offset, length);
+
+    zx_handle_t threads[BOOTFS_MAX_WORKERS];
+    uint32_t nthreads = (work.end - work.next) / FRAMES_PER_WORKER;
+    if (nthreads > fs->workers)
+        nthreads = fs->workers;
+    for (uint32_t i = 0; i < nthreads; ++i) {
+        uintptr_t sp = compute_initial_stack_pointer(
+            fs->worker_stacks + i * WORKER_STACK_SIZE, WORKER_STACK_SIZE);
+        zx_status_t status = zx_thread_create(fs->proc, "bootfs-worker",
+                                              13, 0, &threads[i]);
+        if (status == ZX_OK) {
+            status = zx_thread_start(threads[i], (uintptr_t)bootfs_worker,
+                                     sp, (uintptr_t)&work, 0);
+            if (status != ZX_OK)
+                zx_handle_close(threads[i]);
+        }
+        if (status != ZX_OK) {
+            // Whatever threads we have will do the rest.
+            printl(log, "cannot start bootfs worker thread: %d", status);
+            nthreads = i;
+            break;
+        }
+    }
+
+    bootfs_lazy_work(&work);
+
+    for (uint32_t i = 0; i < nthreads; ++i) {
+        zx_status_t status = zx_object_wait_one(
+            threads[i], ZX_THREAD_TERMINATED, ZX_TIME_INFINITE, NULL);
+        check(log, status, "zx_object_wait_one failed on bootfs worker");
+        zx_handle_close(threads[i]);
+    }
+
+    const char* errmsg;
+    zx_status_t status = bootfs_lazy_work_finish(&work, &errmsg);
+    check(log, status, "%s", errmsg);
+}
+
+static void bootfs_start_workers(zx_handle_t vmar, zx_handle_t log,
+                                 struct bootfs *fs) {
+    fs->workers = 0;
+    if (fs->lazy->frame_count == 0)
+        return;
+    uint32_t workers = zx_system_get_num_cpus() - 1;
+    if (workers > BOOTFS_MAX_WORKERS)
+        workers = BOOTFS_MAX_WORKERS;
+    if (workers == 0)
+        return;
+
+    zx_handle_t stack_vmo;
+    zx_status_t status = zx_vmo_create(workers * WORKER_STACK_SIZE, 0,
+                                       &stack_vmo);
+    check(log, status, "zx_vmo_create failed for bootfs worker stacks");
+    zx_object_set_property(stack_vmo, ZX_PROP_NAME, WORKER_STACK_VMO_NAME,
+                           sizeof(WORKER_STACK_VMO_NAME) - 1);
+    status = zx_vmar_map(vmar, 0, stack_vmo, 0, workers * WORKER_STACK_SIZE,
+                         ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                         &fs->worker_stacks);
+    check(log, status, "zx_vmar_map failed for bootfs worker stacks");
+    zx_handle_close(stack_vmo);
+    fs->workers = workers;
+}
+
+void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t proc,
+                  zx_handle_t vmo, bootfs_lazy_t* lazy, struct bootfs *fs) {
     uint64_t size;
     zx_status_t status = zx_vmo_get_size(vmo, &size);
     check(log, status, "zx_vmo_get_size failed on bootfs vmo\n");
@@ -28,10 +111,32 @@ void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t vmo, struct boo
         ZX_RIGHTS_BASIC | ZX_RIGHT_GET_PROPERTY,
         &fs->vmo);
     check(log, status, "zx_handle_duplicate failed on bootfs VMO handle\n");
+
+    fs->lazy = lazy;
+    fs->proc = proc;
+    bootfs_start_workers(vmar, log, fs);
+
+    // Decompress the directory so it can be searched.
+    bootfs_fill(log, fs, 0, sizeof(bootfs_header_t));
+    const bootfs_header_t* hdr = fs->contents;
+    bootfs_fill(log, fs, sizeof(bootfs_header_t), hdr->dirsize);
 }
 
 void bootfs_unmount(zx_handle_t vmar, zx_handle_t log, struct bootfs *fs) {
-    zx_status_t status = zx_vmar_unmap(vmar, (uintptr_t)fs->contents, fs->len);
+    if (fs->lazy->frame_count > 0) {
+        printl(log, "bootfs: decompressed %u of %u frames in %zu us "
+               "with up to %u threads",
+               fs->lazy->frames_filled, fs->lazy->frame_count,
+               (size_t)(fs->lazy->fill_time / 1000), fs->workers + 1);
+    }
+    bootfs_lazy_close(fs->lazy);
+    zx_status_t status;
+    if (fs->workers > 0) {
+        status = zx_vmar_unmap(vmar, fs->worker_stacks,
+                               fs->workers * WORKER_STACK_SIZE);
+        check(log, status, "zx_vmar_unmap failed\n");
+    }
+    status = zx_vmar_unmap(vmar, (uintptr_t)fs->contents, fs->len);
     check(log, status, "zx_vmar_unmap failed\n");
     status = zx_handle_close(fs->vmo);
     check(log, status, "zx_handle_close failed\n");
@@ -87,6 +192,8 @@ zx_handle_t bootfs_open(zx_handle_t log, const char* purpose,
     if (fs->len - e->data_off < e->data_len)
         fail(log, "bogus size in bootfs header!");
 
+    bootfs_fill(log, fs, e->data_off, e->data_len);
+
     // Clone a private copy of the file's subset of the bootfs VMO.
     // TODO(mcgrathr): Create a plain read-only clone when the feature
     // is implemented in the VM.
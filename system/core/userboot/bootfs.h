@@ -6,17 +6,29 @@
 
 #pragma GCC visibility push(hidden)
 
+#include <bootdata/decompress.h>
 #include <zircon/types.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#define BOOTFS_MAX_WORKERS 15
+
 struct bootfs {
     zx_handle_t vmo;
     const void* contents;
     size_t len;
+    bootfs_lazy_t* lazy;
+
+    // Threads to start in proc, beyond our own, to decompress with.
+    zx_handle_t proc;
+    uint32_t workers;
+    uintptr_t worker_stacks;
 };
 
-void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t vmo, struct bootfs *fs);
+// If lazy is active, parts of vmo are decompressed as they're looked at,
+// using a thread per CPU for the larger parts.
+void bootfs_mount(zx_handle_t vmar, zx_handle_t log, zx_handle_t proc,
+                  zx_handle_t vmo, bootfs_lazy_t* lazy, struct bootfs *fs);
 void bootfs_unmount(zx_handle_t vmar, zx_handle_t log, struct bootfs *fs);
 
 zx_handle_t bootfs_open(zx_handle_t log, const char* purpose,
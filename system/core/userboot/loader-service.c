@@ -91,8 +91,13 @@ static bool handle_loader_rpc(struct loader_state* state,
     if (hcount == 1)
         zx_handle_close(reqhandle);
 
-    ldmsg_rsp_t rsp;
-    memset(&rsp, 0, sizeof(rsp));
+    // Room for the largest reply, though only LOAD_OBJECTS needs it.
+    union {
+        ldmsg_rsp_t rsp;
+        ldmsg_rsp_objects_t objects;
+    } reply;
+    memset(&reply, 0, sizeof(reply));
+    ldmsg_rsp_t* rsp = &reply.rsp;
 
     zx_handle_t handle = ZX_HANDLE_INVALID;
     switch (req.header.ordinal) {
@@ -113,7 +118,8 @@ static bool handle_loader_rpc(struct loader_state* state,
         break;
 
     case LDMSG_OP_CLONE:
-        rsp.rv = ZX_ERR_NOT_SUPPORTED;
+    case LDMSG_OP_LOAD_OBJECTS:
+        rsp->rv = ZX_ERR_NOT_SUPPORTED;
         goto error_reply;
 
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
@@ -125,13 +131,13 @@ static bool handle_loader_rpc(struct loader_state* state,
         break;
     }
 
-    rsp.rv = ZX_OK;
-    rsp.object = handle == ZX_HANDLE_INVALID ?
+    rsp->rv = ZX_OK;
+    rsp->object = handle == ZX_HANDLE_INVALID ?
         FIDL_HANDLE_ABSENT : FIDL_HANDLE_PRESENT;
 error_reply:
-    rsp.header.txid = req.header.txid;
-    rsp.header.ordinal = req.header.ordinal;
-    status = zx_channel_write(channel, 0, &rsp, ldmsg_rsp_get_size(&rsp),
+    rsp->header.txid = req.header.txid;
+    rsp->header.ordinal = req.header.ordinal;
+    status = zx_channel_write(channel, 0, rsp, ldmsg_rsp_get_size(rsp),
                               &handle, handle == ZX_HANDLE_INVALID ? 0 : 1);
     check(state->log, status,
           "zx_channel_write on loader-service channel failed");
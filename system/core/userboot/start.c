@@ -191,7 +191,7 @@ static noreturn void bootstrap(zx_handle_t log, zx_handle_t bootstrap_pipe) {
 
     // Hang on to our own process handle.  If we closed it, our process
     // would be killed.  Exiting will clean it up.
-    __UNUSED const zx_handle_t proc_self = *proc_handle_loc;
+    const zx_handle_t proc_self = *proc_handle_loc;
     const zx_handle_t vmar_self = *vmar_root_handle_loc;
 
     // Hang on to the resource root handle.
@@ -201,10 +201,13 @@ static noreturn void bootstrap(zx_handle_t log, zx_handle_t bootstrap_pipe) {
     if (status < 0)
         fail(log, "zx_handle_duplicate failed: %d", status);
 
-    // Locate the first bootfs bootdata section and decompress it.
-    // We need it to load devmgr and libc from.
-    // Later bootfs sections will be processed by devmgr.
-    zx_handle_t bootfs_vmo = bootdata_get_bootfs(log, vmar_self, bootdata_vmo);
+    // Locate the first bootfs bootdata section and decompress it, or if
+    // it's seekable, just the parts of it we look at.  We need it to load
+    // devmgr and libc from.  devmgr finishes decompressing it, and handles
+    // later bootfs sections.
+    bootfs_lazy_t lazy;
+    zx_handle_t bootfs_vmo = bootdata_get_bootfs(log, vmar_self, bootdata_vmo,
+                                                 &lazy);
 
     // Pass the decompressed bootfs VMO on.
     handles[nhandles + EXTRA_HANDLE_BOOTFS] = bootfs_vmo;
@@ -213,7 +216,7 @@ static noreturn void bootstrap(zx_handle_t log, zx_handle_t bootstrap_pipe) {
 
     // Map in the bootfs so we can look for files in it.
     struct bootfs bootfs;
-    bootfs_mount(vmar_self, log, bootfs_vmo, &bootfs);
+    bootfs_mount(vmar_self, log, proc_self, bootfs_vmo, &lazy, &bootfs);
 
     // Make the channel for the bootstrap message.
     zx_handle_t to_child;
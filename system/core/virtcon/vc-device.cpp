@@ -141,20 +141,31 @@ static void vc_invalidate(void* cookie, int x0, int y0, int w, int h) {
 
 // implement tc callbacks:
 
-static inline void vc_invalidate_lines(vc_t* vc, int y, int h) {
+// Grows the region vc_flush() sends to the display, so that typing a
+// character only flushes the cells around it rather than whole rows.
+static inline void vc_invalidate_cells(vc_t* vc, int x, int y, int w, int h) {
     if (y < vc->invy0) {
         vc->invy0 = y;
     }
-    y += h;
-    if (y > vc->invy1) {
-        vc->invy1 = y;
+    if (y + h > vc->invy1) {
+        vc->invy1 = y + h;
+    }
+    if (x < vc->invx0) {
+        vc->invx0 = x;
+    }
+    if (x + w > vc->invx1) {
+        vc->invx1 = x + w;
     }
 }
 
+static inline void vc_invalidate_lines(vc_t* vc, int y, int h) {
+    vc_invalidate_cells(vc, 0, y, static_cast<int>(vc->columns), h);
+}
+
 static void vc_tc_invalidate(void* cookie, int x0, int y0, int w, int h){
     vc_t* vc = reinterpret_cast<vc_t*>(cookie);
     vc_invalidate(cookie, x0, y0, w, h);
-    vc_invalidate_lines(vc, y0, h);
+    vc_invalidate_cells(vc, x0, y0, w, h);
 }
 
 static void vc_tc_movecursor(void* cookie, int x, int y) {
@@ -166,11 +177,11 @@ static void vc_tc_movecursor(void* cookie, int x, int y) {
     if (vc->active && !vc->hide_cursor) {
         // Clear the cursor from its old position.
         vc_invalidate(cookie, old_x, old_y, 1, 1);
-        vc_invalidate_lines(vc, old_y, 1);
+        vc_invalidate_cells(vc, old_x, old_y, 1, 1);
 
         // Display the cursor in its new position.
         vc_invalidate(cookie, vc->cursor_x, vc->cursor_y, 1, 1);
-        vc_invalidate_lines(vc, vc->cursor_y, 1);
+        vc_invalidate_cells(vc, vc->cursor_x, vc->cursor_y, 1, 1);
     }
 }
 
@@ -230,7 +241,7 @@ static void vc_set_cursor_hidden(vc_t* vc, bool hide) {
     vc->hide_cursor = hide;
     if (vc->active) {
         vc_invalidate(vc, vc->cursor_x, vc->cursor_y, 1, 1);
-        vc_invalidate_lines(vc, vc->cursor_y, 1);
+        vc_invalidate_cells(vc, vc->cursor_x, vc->cursor_y, 1, 1);
     }
 }
 
@@ -600,8 +611,13 @@ void vc_flush(vc_t* vc) {
         // console-relative row numbers to screen-relative row numbers.
         int invalidate_y0 = MIN(vc->invy0 - vc->viewport_y, rows);
         int invalidate_y1 = MIN(vc->invy1 - vc->viewport_y, rows);
-        vc_gfx_invalidate(vc, 0, invalidate_y0,
-                          vc->columns, invalidate_y1 - invalidate_y0);
+        // The cursor may sit just past the last column.
+        int invalidate_x0 = MAX(vc->invx0, 0);
+        int invalidate_x1 = MIN(vc->invx1, static_cast<int>(vc->columns));
+        if (invalidate_x1 > invalidate_x0) {
+            vc_gfx_invalidate(vc, invalidate_x0, invalidate_y0,
+                              invalidate_x1 - invalidate_x0, invalidate_y1 - invalidate_y0);
+        }
     }
 }
 
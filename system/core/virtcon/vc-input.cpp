@@ -232,6 +232,8 @@ void handle_key_press(uint8_t keycode, int modifiers) {
 ssize_t vc_write(vc_t* vc, const void* buf, size_t count, zx_off_t off) {
     vc->invy0 = vc_rows(vc) + 1;
     vc->invy1 = -1;
+    vc->invx0 = vc->columns + 1;
+    vc->invx1 = -1;
     const uint8_t* str = (const uint8_t*)buf;
     for (size_t i = 0; i < count; i++) {
         vc->textcon.putc(&vc->textcon, str[i]);
@@ -70,7 +70,8 @@ typedef struct vc {
     // size of character cell
 
     int invy0, invy1;
-    // offscreen invalid lines, tracked during textcon drawing
+    int invx0, invx1;
+    // offscreen invalid region, tracked during textcon drawing
 
     unsigned cursor_x, cursor_y;
     // cursor
@@ -282,6 +282,22 @@ zx_status_t IntelHDAController::SetupStreamDescriptors() {
         return res;
     }
 
+    // Allocate the DMA position buffer, and have the hardware start writing
+    // each stream's position into it.  Clients may map it (read-only) in order
+    // to track their stream's position without waiting for notifications.
+    // The allocation is page aligned, which satisfies the 128 byte alignment
+    // required of the DPIBLBASE register.
+    res = dma_pos_mem_.Allocate(HDA_DMA_POS_ENTRY_SIZE * total_stream_cnt);
+    if (res != ZX_OK) {
+        LOG("Failed to allocate DMA position buffer!  (res %d)\n", res);
+        return res;
+    }
+
+    REG_WR(&regs_->dpibubase, static_cast<uint32_t>((dma_pos_mem_.phys() >> 32) & 0xFFFFFFFFu));
+    REG_WR(&regs_->dpiblbase, static_cast<uint32_t>(dma_pos_mem_.phys() & 0xFFFFFFFFu)
+                              | HDA_REG_DPIBLBASE_EN);
+    hw_wmb();
+
     // Allocate our stream descriptors and populate our free lists.
     for (uint32_t i = 0, bdl_off = 0; i < total_stream_cnt; ++i, bdl_off += bdl_size) {
         uint16_t stream_id = static_cast<uint16_t>(i + 1);
@@ -291,11 +307,24 @@ zx_status_t IntelHDAController::SetupStreamDescriptors() {
                   ? IntelHDAStream::Type::OUTPUT
                   : IntelHDAStream::Type::BIDIR);
 
+        // Each stream gets its own read-only handle to the position buffer to
+        // hand out to its clients.
+        zx::vmo dma_pos_vmo;
+        res = dma_pos_mem_.vmo().duplicate(ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER |
+                                           ZX_RIGHT_READ | ZX_RIGHT_MAP,
+                                           &dma_pos_vmo);
+        if (res != ZX_OK) {
+            LOG("Failed to duplicate DMA position buffer handle!  (res %d)\n", res);
+            return res;
+        }
+
         auto stream = fbl::AdoptRef(new IntelHDAStream(type,
                                                         stream_id,
                                                         &regs_->stream_desc[i],
                                                         bdl_mem_.phys() + bdl_off,
-                                                        bdl_mem_.virt() + bdl_off));
+                                                        bdl_mem_.virt() + bdl_off,
+                                                        fbl::move(dma_pos_vmo),
+                                                        i * HDA_DMA_POS_ENTRY_SIZE));
 
         ZX_DEBUG_ASSERT(i < countof(all_streams_));
         ZX_DEBUG_ASSERT(all_streams_[i] == nullptr);
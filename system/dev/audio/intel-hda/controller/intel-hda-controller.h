@@ -142,9 +142,10 @@ private:
     zx_handle_t      regs_handle_ = ZX_HANDLE_INVALID;
     hda_registers_t* regs_        = nullptr;
 
-    // Contiguous physical memory allocated for the command buffer (CORB/RIRB)
-    // and Stream Buffer Desctiptor Lists (BDLs)
+    // Contiguous physical memory allocated for the command buffer (CORB/RIRB),
+    // the Stream Buffer Desctiptor Lists (BDLs) and the DMA position buffer.
     ContigPhysMem  bdl_mem_     TA_GUARDED(stream_pool_lock_);
+    ContigPhysMem  dma_pos_mem_ TA_GUARDED(stream_pool_lock_);
     ContigPhysMem  cmd_buf_mem_ TA_GUARDED(corb_lock_);
 
     // Stream state
@@ -39,12 +39,16 @@ IntelHDAStream::IntelHDAStream(Type                    type,
                                uint16_t                id,
                                hda_stream_desc_regs_t* regs,
                                zx_paddr_t              bdl_phys,
-                               uintptr_t               bdl_virt)
+                               uintptr_t               bdl_virt,
+                               zx::vmo&&               dma_pos_vmo,
+                               uint32_t                dma_pos_offset)
     : type_(type),
       id_(id),
       regs_(regs),
       bdl_(reinterpret_cast<IntelHDABDLEntry*>(bdl_virt)),
-      bdl_phys_(bdl_phys) {
+      bdl_phys_(bdl_phys),
+      dma_pos_vmo_(fbl::move(dma_pos_vmo)),
+      dma_pos_offset_(dma_pos_offset) {
     // Check the alignment restrictions
     ZX_DEBUG_ASSERT(!(bdl_phys & static_cast<zx_paddr_t>(DMA_ALIGN_MASK)));
     ZX_DEBUG_ASSERT(!(bdl_virt & static_cast<uintptr_t>(DMA_ALIGN_MASK)));
@@ -213,6 +217,7 @@ zx_status_t IntelHDAStream::ProcessClientRequest(dispatcher::Channel* channel) {
         audio_proto::RingBufGetBufferReq    get_buffer;
         audio_proto::RingBufStartReq        start;
         audio_proto::RingBufStopReq         stop;
+        audio_proto::RingBufGetPositionBufferReq get_position_buffer;
     } req;
     // TODO(johngro) : How large is too large?
     static_assert(sizeof(req) <= 256, "Request buffer is too large to hold on the stack!");
@@ -255,6 +260,8 @@ zx_status_t IntelHDAStream::ProcessClientRequest(dispatcher::Channel* channel) {
     HANDLE_REQ(AUDIO_RB_CMD_GET_BUFFER,     get_buffer,     ProcessGetBufferLocked,    false);
     HANDLE_REQ(AUDIO_RB_CMD_START,          start,          ProcessStartLocked,        false);
     HANDLE_REQ(AUDIO_RB_CMD_STOP,           stop,           ProcessStopLocked,         false);
+    HANDLE_REQ(AUDIO_RB_CMD_GET_POSITION_BUFFER, get_position_buffer,
+               ProcessGetPositionBufferLocked, false);
     default:
         DEBUG_LOG("Unrecognized command ID 0x%04x\n", req.hdr.cmd);
         return ZX_ERR_INVALID_ARGS;
@@ -675,6 +682,24 @@ zx_status_t IntelHDAStream::ProcessStopLocked(const audio_proto::RingBufStopReq&
     return channel_->Write(&resp, sizeof(resp));
 }
 
+zx_status_t IntelHDAStream::ProcessGetPositionBufferLocked(
+        const audio_proto::RingBufGetPositionBufferReq& req) {
+    audio_proto::RingBufGetPositionBufferResp resp = { };
+    zx::vmo client_pos_handle;
+
+    ZX_DEBUG_ASSERT(channel_ != nullptr);
+    resp.hdr = req.hdr;
+    resp.position_offset = dma_pos_offset_;
+    resp.result = dma_pos_vmo_.duplicate(ZX_RIGHT_TRANSFER | ZX_RIGHT_READ | ZX_RIGHT_MAP,
+                                         &client_pos_handle);
+    if (resp.result != ZX_OK) {
+        DEBUG_LOG("Failed to duplicate DMA position buffer handle (res %d)\n", resp.result);
+        return channel_->Write(&resp, sizeof(resp));
+    }
+
+    return channel_->Write(&resp, sizeof(resp), fbl::move(client_pos_handle));
+}
+
 void IntelHDAStream::ReleaseRingBufferLocked() {
     ring_buffer_vmo_.reset();
     ZX_DEBUG_ASSERT(bdl_);
@@ -68,7 +68,9 @@ private:
                    uint16_t                id,
                    hda_stream_desc_regs_t* regs,
                    zx_paddr_t              bdl_phys,
-                   uintptr_t               bdl_virt);
+                   uintptr_t               bdl_virt,
+                   zx::vmo&&               dma_pos_vmo,
+                   uint32_t                dma_pos_offset);
     ~IntelHDAStream();
 
     void PrintDebugPrefix() const;
@@ -85,6 +87,8 @@ private:
         TA_REQ(channel_lock_);
     zx_status_t ProcessStartLocked(const audio_proto::RingBufStartReq& req) TA_REQ(channel_lock_);
     zx_status_t ProcessStopLocked(const audio_proto::RingBufStopReq& req) TA_REQ(channel_lock_);
+    zx_status_t ProcessGetPositionBufferLocked(
+            const audio_proto::RingBufGetPositionBufferReq& req) TA_REQ(channel_lock_);
 
     // Release the client ring buffer (if one has been assigned)
     void ReleaseRingBufferLocked() TA_REQ(channel_lock_);
@@ -114,6 +118,11 @@ private:
     IntelHDABDLEntry*       const bdl_        = nullptr;
     const zx_paddr_t              bdl_phys_   = 0;
 
+    // A read-only handle to the controller's DMA position buffer, and the
+    // offset of this stream's entry within it.
+    const zx::vmo                 dma_pos_vmo_;
+    const uint32_t                dma_pos_offset_ = 0;
+
     // Parameters determined at allocation time.
     Type    configured_type_;
     uint8_t tag_;
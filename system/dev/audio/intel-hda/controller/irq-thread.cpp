@@ -7,6 +7,8 @@
 #include <fbl/algorithm.h>
 #include <fbl/auto_lock.h>
 #include <string.h>
+#include <threads.h>
+#include <zircon/syscalls.h>
 
 #include <intel-hda/utils/intel-hda-registers.h>
 
@@ -17,6 +19,16 @@
 namespace audio {
 namespace intel_hda {
 
+namespace {
+// The cpu reservation of the IRQ thread.  Servicing the stream interrupts takes
+// a few tens of microseconds; what matters is that it happens promptly, so that
+// position notifications for short periods arrive before the client's data
+// runs out.
+constexpr zx_duration_t IRQ_THREAD_CAPACITY = ZX_USEC(100);
+constexpr zx_duration_t IRQ_THREAD_DEADLINE = ZX_MSEC(1);
+constexpr zx_duration_t IRQ_THREAD_PERIOD   = ZX_MSEC(1);
+}  // namespace
+
 void IntelHDAController::WakeupIRQThread() {
     ZX_DEBUG_ASSERT(irq_handle_ != ZX_HANDLE_INVALID);
 
@@ -347,7 +359,17 @@ void IntelHDAController::ProcessControllerIRQ() {
 }
 
 int IntelHDAController::IRQThread() {
-    // TODO(johngro) : Raise our thread priority here.
+    // Position notifications are sent from this thread, so make sure it gets
+    // to run when a stream interrupt fires.  If the reservation cannot be
+    // admitted, settle for a high priority instead.
+    zx_status_t res = zx_thread_set_deadline(thrd_get_zx_handle(thrd_current()),
+                                             IRQ_THREAD_CAPACITY,
+                                             IRQ_THREAD_DEADLINE,
+                                             IRQ_THREAD_PERIOD);
+    if (res != ZX_OK) {
+        LOG("Failed to reserve cpu time for the IRQ thread (res %d)\n", res);
+        zx_thread_set_priority(24 /* HIGH_PRIORITY in LK */);
+    }
 
     // Compute the set of interrupts we may be interested in during operation.
     uint32_t interesting_irqs = HDA_REG_INTCTL_GIE | HDA_REG_INTCTL_CIE;
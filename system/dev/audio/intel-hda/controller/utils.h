@@ -77,6 +77,7 @@ public:
     uintptr_t   virt()        const { return virt_; }
     size_t      size()        const { return size_; }
     size_t      actual_size() const { return actual_size_; }
+    const zx::vmo& vmo()      const { return vmo_; }
 
 private:
     zx::vmo     vmo_;
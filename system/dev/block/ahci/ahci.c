@@ -42,6 +42,9 @@
 // until pending transactions are done
 #define AHCI_PORT_FLAG_SYNC_PAUSED (1 << 2)
 
+// how long a command may be in flight before the port is reset
+#define AHCI_CMD_TIMEOUT ZX_SEC(5)
+
 //clang-format on
 
 typedef struct ahci_port {
@@ -60,7 +63,9 @@ typedef struct ahci_port {
     list_node_t txn_list;
     io_buffer_t buffer;
 
+    uint32_t slots;     // bitmask of command slots the port may use
     uint32_t running;   // bitmask of running commands
+    uint32_t queued;    // bitmask of running commands which are NCQ commands
     uint32_t completed; // bitmask of completed commands
     sata_txn_t* commands[AHCI_MAX_COMMANDS]; // commands in flight
     sata_txn_t* sync;   // FLUSH command in flight
@@ -183,11 +188,15 @@ static void ahci_port_reset(ahci_port_t* port) {
     ahci_write(&port->regs->serr, ahci_read(&port->regs->serr));
 }
 
-static bool ahci_port_cmd_busy(ahci_port_t* port, int slot) {
-    // a command slot is busy if a transaction is in flight or pending to be completed
-    return ((ahci_read(&port->regs->sact) | ahci_read(&port->regs->ci)) & (1 << slot)) ||
-           (port->commands[slot] != NULL) ||
-           (port->running & (1 << slot)) || (port->completed & (1 << slot));
+// Returns a free command slot, or -1 if all the slots the port may use are busy.
+// A slot is busy from when its command is issued until the worker thread has
+// completed it, so the hardware registers need not be read.
+static int ahci_port_alloc_slot(ahci_port_t* port) {
+    uint32_t free = port->slots & ~(port->running | port->completed);
+    if (!free) {
+        return -1;
+    }
+    return __builtin_ctz(free);
 }
 
 static bool cmd_is_read(uint8_t cmd) {
@@ -214,14 +223,58 @@ static bool cmd_is_queued(uint8_t cmd) {
     return (cmd == SATA_CMD_READ_FPDMA_QUEUED) || (cmd == SATA_CMD_WRITE_FPDMA_QUEUED);
 }
 
+// Returns the command to issue for |txn|: DMA reads and writes are issued as
+// queued commands if both the controller and the device support NCQ.
+static uint8_t ahci_port_txn_cmd(ahci_device_t* dev, ahci_port_t* port, sata_txn_t* txn) {
+    if ((dev->cap & AHCI_CAP_NCQ) && port->devinfo.ncq) {
+        if (txn->cmd == SATA_CMD_READ_DMA_EXT) {
+            return SATA_CMD_READ_FPDMA_QUEUED;
+        } else if (txn->cmd == SATA_CMD_WRITE_DMA_EXT) {
+            return SATA_CMD_WRITE_FPDMA_QUEUED;
+        }
+    }
+    return txn->cmd;
+}
+
+// Moves the commands the device has finished from running to completed. Must
+// be called with the port lock held.
+static void ahci_port_reap_locked(ahci_port_t* port) {
+    // queued commands stay set in sact, and others in ci, until they finish
+    uint32_t active = ahci_read(&port->regs->sact) | ahci_read(&port->regs->ci);
+    uint32_t done = port->running & ~port->completed & ~active;
+    while (done) {
+        unsigned slot = __builtin_ctz(done);
+        port->commands[slot]->status = ZX_OK;
+        port->completed |= (1u << slot);
+        done &= ~(1u << slot);
+    }
+}
+
+// Fails all the commands in flight with |status| and restarts the port. When a
+// queued command fails the device aborts all the others, so they cannot be
+// told apart. Must be called with the port lock held.
+static void ahci_port_recover_locked(ahci_port_t* port, zx_status_t status) {
+    uint32_t pending = port->running & ~port->completed;
+    zxlogf(ERROR, "ahci.%d: failing commands 0x%08x (tfd 0x%08x serr 0x%08x)\n",
+           port->nr, pending, ahci_read(&port->regs->tfd), ahci_read(&port->regs->serr));
+    while (pending) {
+        unsigned slot = __builtin_ctz(pending);
+        port->commands[slot]->status = status;
+        port->completed |= (1u << slot);
+        pending &= ~(1u << slot);
+    }
+    // clearing ST clears sact and ci
+    ahci_port_reset(port);
+    ahci_write(&port->regs->is, ahci_read(&port->regs->is));
+    ahci_port_enable(port);
+}
+
 static void ahci_port_complete_txn(ahci_device_t* dev, ahci_port_t* port, zx_status_t status) {
     mtx_lock(&port->lock);
-    uint32_t sact = ahci_read(&port->regs->sact);
-    uint32_t running = port->running;
-    uint32_t done = sact ^ running;
-    // assert if a command slot without an outstanding transaction is active
-    ZX_DEBUG_ASSERT(!(done & sact));
-    port->completed |= done;
+    ahci_port_reap_locked(port);
+    if (status != ZX_OK) {
+        ahci_port_recover_locked(port, status);
+    }
     mtx_unlock(&port->lock);
     // hit the worker thread to complete commands
     completion_signal(&dev->worker_completion);
@@ -229,7 +282,7 @@ static void ahci_port_complete_txn(ahci_device_t* dev, ahci_port_t* port, zx_sta
 
 static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot, sata_txn_t* txn) {
     assert(slot < AHCI_MAX_COMMANDS);
-    assert(!ahci_port_cmd_busy(port, slot));
+    assert(!((port->running | port->completed) & (1u << slot)));
 
     uint64_t bytes = txn->bop.rw.length * port->devinfo.block_size;
     size_t pagecount = ((txn->bop.rw.offset_vmo & (PAGE_SIZE - 1)) + bytes + (PAGE_SIZE - 1)) /
@@ -263,20 +316,11 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
     phys_iter_t iter;
     phys_iter_init(&iter, &physbuf, AHCI_PRD_MAX_SIZE);
 
-    uint8_t cmd = txn->cmd;
+    uint8_t cmd = ahci_port_txn_cmd(dev, port, txn);
     uint8_t device = txn->device;
     uint64_t lba = txn->bop.rw.offset_dev;
     uint64_t count = txn->bop.rw.length;
 
-    // use queued command if available
-    if (dev->cap & AHCI_CAP_NCQ) {
-        if (cmd == SATA_CMD_READ_DMA_EXT) {
-            cmd = SATA_CMD_READ_FPDMA_QUEUED;
-        } else if (cmd == SATA_CMD_WRITE_DMA_EXT) {
-            cmd = SATA_CMD_WRITE_FPDMA_QUEUED;
-        }
-    }
-
     // build the command
     ahci_cl_t* cl = port->cl + slot;
     // don't clear the cl since we set up ctba/ctbau at init
@@ -340,7 +384,10 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
         prd += 1;
     }
 
-    port->running |= (1 << slot);
+    port->running |= (1u << slot);
+    if (cmd_is_queued(cmd)) {
+        port->queued |= (1u << slot);
+    }
     port->commands[slot] = txn;
 
     zxlogf(SPEW, "ahci.%d: do_txn txn %p (%c) offset 0x%" PRIx64 " length 0x%" PRIx64
@@ -363,7 +410,7 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
 
     // set the watchdog
     // TODO: general timeout mechanism
-    txn->timeout = zx_clock_get(ZX_CLOCK_MONOTONIC) + ZX_SEC(1);
+    txn->timeout = zx_clock_get(ZX_CLOCK_MONOTONIC) + AHCI_CMD_TIMEOUT;
     completion_signal(&dev->watchdog_completion);
     return ZX_OK;
 }
@@ -468,7 +515,12 @@ static void ahci_hba_reset(ahci_device_t* dev) {
 void ahci_set_devinfo(ahci_device_t* device, int portnr, sata_devinfo_t* devinfo) {
     ZX_DEBUG_ASSERT(ahci_port_valid(device, portnr));
     ahci_port_t* port = &device->ports[portnr];
+    mtx_lock(&port->lock);
     memcpy(&port->devinfo, devinfo, sizeof(port->devinfo));
+    // both the device's queue depth and the controller's slot count are 0-based
+    int max = MIN(devinfo->max_cmd, (int)((device->cap >> 8) & 0x1f));
+    port->slots = (max == AHCI_MAX_COMMANDS - 1) ? 0xffffffffu : ((1u << (max + 1)) - 1);
+    mtx_unlock(&port->lock);
 }
 
 void ahci_queue(ahci_device_t* device, int portnr, sata_txn_t* txn) {
@@ -510,21 +562,23 @@ static int ahci_worker_thread(void* arg) {
             }
 
             // complete commands first
+            // in whatever order the device finished them
             while (port->completed) {
-                unsigned slot = 32 - __builtin_clz(port->completed) - 1;
+                unsigned slot = __builtin_ctz(port->completed);
                 txn = port->commands[slot];
+                port->completed &= ~(1u << slot);
+                port->running &= ~(1u << slot);
+                port->queued &= ~(1u << slot);
+                port->commands[slot] = NULL;
                 if (txn == NULL) {
                     zxlogf(ERROR, "ahci.%d: illegal state, completing slot %d but txn == NULL\n",
                             port->nr, slot);
                 } else {
                     mtx_unlock(&port->lock);
                     zxlogf(SPEW, "ahci.%d: complete txn %p\n", port->nr, txn);
-                    block_complete(&txn->bop, ZX_OK);
+                    block_complete(&txn->bop, txn->status);
                     mtx_lock(&port->lock);
                 }
-                port->completed &= ~(1 << slot);
-                port->running &= ~(1 << slot);
-                port->commands[slot] = NULL;
                 // resume the port if paused for sync and no outstanding transactions
                 if ((port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) && !port->running) {
                     port->flags &= ~AHCI_PORT_FLAG_SYNC_PAUSED;
@@ -550,15 +604,21 @@ static int ahci_worker_thread(void* arg) {
                 }
 
                 // find a free command tag
-                int max = MIN(port->devinfo.max_cmd, (int)((dev->cap >> 8) & 0x1f));
-                int i = 0;
-                for (i = 0; i <= max; i++) {
-                    if (!ahci_port_cmd_busy(port, i)) break;
-                }
-                if (i > max) {
+                int slot = ahci_port_alloc_slot(port);
+                if (slot < 0) {
                     break;
                 }
 
+                // queued and non-queued commands cannot be mixed: a non-queued
+                // command waits for the port to go idle, and queued commands
+                // wait for a non-queued command to finish
+                if (txn->bop.command != BLOCK_OP_FLUSH) {
+                    bool queued = cmd_is_queued(ahci_port_txn_cmd(dev, port, txn));
+                    if (queued ? (port->running & ~port->queued) : port->running) {
+                        break;
+                    }
+                }
+
                 list_delete(&txn->node);
 
                 if (txn->bop.command == BLOCK_OP_FLUSH) {
@@ -575,7 +635,7 @@ static int ahci_worker_thread(void* arg) {
                     }
                 } else {
                     // run the transaction
-                    zx_status_t st = ahci_do_txn(dev, port, i, txn);
+                    zx_status_t st = ahci_do_txn(dev, port, slot, txn);
                     // complete the transaction with if it failed during processing
                     if (st != ZX_OK) {
                         mtx_unlock(&port->lock);
@@ -610,22 +670,20 @@ static int ahci_watchdog_thread(void* arg) {
             uint32_t pending = port->running & ~port->completed;
             while (pending) {
                 idle = false;
-                unsigned slot = 32 - __builtin_clz(pending) - 1;
+                unsigned slot = __builtin_ctz(pending);
                 sata_txn_t* txn = port->commands[slot];
                 if (!txn) {
                     zxlogf(ERROR, "ahci: command %u pending but txn is NULL\n", slot);
-                } else {
-                    if (txn->timeout < now) {
-                        // time out
-                        zxlogf(ERROR, "ahci: txn time out on port %d txn %p\n", port->nr, txn);
-                        port->running &= ~(1 << slot);
-                        port->commands[slot] = NULL;
-                        mtx_unlock(&port->lock);
-                        block_complete(&txn->bop, ZX_ERR_TIMED_OUT);
-                        mtx_lock(&port->lock);
-                    }
+                } else if (txn->timeout < now) {
+                    // the slot cannot be reused while the device may still
+                    // write to its buffer, so stop the port to reclaim it
+                    zxlogf(ERROR, "ahci: txn time out on port %d txn %p\n", port->nr, txn);
+                    ahci_port_reap_locked(port);
+                    ahci_port_recover_locked(port, ZX_ERR_TIMED_OUT);
+                    completion_signal(&dev->worker_completion);
+                    break;
                 }
-                pending &= ~(1 << slot);
+                pending &= ~(1u << slot);
             }
             mtx_unlock(&port->lock);
         }
@@ -651,7 +709,7 @@ static void ahci_port_irq(ahci_device_t* dev, int nr) {
     }
     if (is & AHCI_PORT_INT_ERROR) { // error
         zxlogf(ERROR, "ahci.%d: error is=0x%08x\n", nr, is);
-        ahci_port_complete_txn(dev, port, ZX_ERR_INTERNAL);
+        ahci_port_complete_txn(dev, port, ZX_ERR_IO);
     } else if (is) {
         ahci_port_complete_txn(dev, port, ZX_OK);
     }
@@ -27,6 +27,7 @@
 
 #define SATA_FLAG_DMA   (1 << 0)
 #define SATA_FLAG_LBA48 (1 << 1)
+#define SATA_FLAG_NCQ   (1 << 2)
 
 typedef struct sata_device {
     zx_device_t* zxdev;
@@ -143,7 +144,15 @@ static zx_status_t sata_device_identify(sata_device_t* dev, ahci_device_t* contr
     } else {
         zxlogf(INFO, " PIO");
     }
-    dev->max_cmd = *(devinfo + SATA_DEVINFO_QUEUE_DEPTH);
+    if (*(devinfo + SATA_DEVINFO_SATA_CAP) & (1 << 8)) {
+        zxlogf(INFO, " NCQ");
+        flags |= SATA_FLAG_NCQ;
+        // the queue depth is 0-based in the low 5 bits
+        dev->max_cmd = *(devinfo + SATA_DEVINFO_QUEUE_DEPTH) & 0x1f;
+    } else {
+        // without NCQ the device runs one command at a time
+        dev->max_cmd = 0;
+    }
     zxlogf(INFO, " %d commands\n", dev->max_cmd + 1);
 
     uint32_t block_size = 512; // default
@@ -176,9 +185,15 @@ static zx_status_t sata_device_identify(sata_device_t* dev, ahci_device_t* contr
     }
     dev->info.max_transfer_size = MIN(AHCI_MAX_BYTES, max_sg_size);
 
+    // 1 means solid state, anything else a rotation rate or not reported
+    if (*(devinfo + SATA_DEVINFO_ROTATION_RATE) != 1) {
+        dev->info.flags |= BLOCK_FLAG_SEEK_PENALTY;
+    }
+
     // set devinfo on controller
     di.block_size = block_size,
     di.max_cmd = dev->max_cmd,
+    di.ncq = !!(flags & SATA_FLAG_NCQ),
 
     ahci_set_devinfo(controller, dev->port, &di);
 
@@ -28,6 +28,7 @@
 #define SATA_DEVINFO_LBA_CAPACITY_2      100
 #define SATA_DEVINFO_SECTOR_SIZE         106
 #define SATA_DEVINFO_LOGICAL_SECTOR_SIZE 117
+#define SATA_DEVINFO_ROTATION_RATE       217
 
 #define SATA_DEVINFO_SERIAL_LEN   20
 #define SATA_DEVINFO_FW_REV_LEN   8
@@ -51,7 +52,8 @@ typedef struct ahci_device ahci_device_t;
 
 typedef struct sata_devinfo {
     uint32_t block_size;
-    int max_cmd;
+    int max_cmd; // inclusive
+    bool ncq;    // device supports native command queuing
 } sata_devinfo_t;
 
 zx_status_t sata_bind(ahci_device_t* controller, zx_device_t* parent, int port);
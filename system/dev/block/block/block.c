@@ -183,6 +183,48 @@ done:
     return status;
 }
 
+static zx_status_t blkdev_set_txn_priority(blkdev_t* bdev, const void* in_buf,
+                                           size_t in_len) {
+    if (in_len != sizeof(block_txn_priority_t)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_status_t status;
+    mtx_lock(&bdev->lock);
+    if (bdev->bs == NULL) {
+        status = ZX_ERR_BAD_STATE;
+        goto done;
+    }
+
+    const block_txn_priority_t* req = in_buf;
+    status = blockserver_set_txn_priority(bdev->bs, req->txnid, req->priority);
+done:
+    mtx_unlock(&bdev->lock);
+    return status;
+}
+
+static zx_status_t blkdev_get_server_stats(blkdev_t* bdev,
+                                           const void* in_buf, size_t in_len,
+                                           void* out_buf, size_t out_len, size_t* out_actual) {
+    if ((in_len != sizeof(bool)) || (out_len < sizeof(block_server_stats_t))) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_status_t status;
+    mtx_lock(&bdev->lock);
+    if (bdev->bs == NULL) {
+        status = ZX_ERR_BAD_STATE;
+        goto done;
+    }
+
+    blockserver_get_stats(bdev->bs, *(const bool*)in_buf, out_buf);
+    *out_actual = sizeof(block_server_stats_t);
+    status = ZX_OK;
+done:
+    mtx_unlock(&bdev->lock);
+    return status;
+}
+
 static zx_status_t blkdev_fifo_close_locked(blkdev_t* bdev) {
     if (bdev->bs != NULL) {
         blockserver_shutdown(bdev->bs);
@@ -207,6 +249,10 @@ static zx_status_t blkdev_ioctl(void* ctx, uint32_t op, const void* cmd,
         return blkdev_alloc_txn(blkdev, cmd, cmdlen, reply, max, out_actual);
     case IOCTL_BLOCK_FREE_TXN:
         return blkdev_free_txn(blkdev, cmd, cmdlen);
+    case IOCTL_BLOCK_SET_TXN_PRIORITY:
+        return blkdev_set_txn_priority(blkdev, cmd, cmdlen);
+    case IOCTL_BLOCK_GET_SERVER_STATS:
+        return blkdev_get_server_stats(blkdev, cmd, cmdlen, reply, max, out_actual);
     case IOCTL_BLOCK_FIFO_CLOSE: {
         mtx_lock(&blkdev->lock);
         zx_status_t status = blkdev_fifo_close_locked(blkdev);
@@ -12,7 +12,9 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/limits.h>
+#include <fbl/new.h>
 #include <fbl/ref_ptr.h>
+#include <fbl/unique_ptr.h>
 #include <zircon/compiler.h>
 #include <zircon/device/block.h>
 #include <zircon/syscalls.h>
@@ -28,9 +30,21 @@
 // If additional signals are set on the FIFO, it should be noted that
 // block clients will also be able to manipulate them.
 constexpr zx_signals_t kSignalFifoTerminate = ZX_USER_SIGNAL_0;
+// This signal is set on the FIFO when a block op completed while others
+// were waiting for room in flight, to have the server queue them.
+constexpr zx_signals_t kSignalFifoRefill = ZX_USER_SIGNAL_1;
 
 namespace {
 
+// Blocks a txn may have queued to the device per turn, times the weight of
+// its priority class
+constexpr uint64_t kQuantumBlocks = 256;
+constexpr uint64_t kPriorityWeights[BLOCK_PRIORITY_COUNT] = {
+    16, // BLOCK_PRIORITY_REALTIME
+    4,  // BLOCK_PRIORITY_INTERACTIVE
+    1,  // BLOCK_PRIORITY_BACKGROUND
+};
+
 void OutOfBandRespond(const zx::fifo& fifo, zx_status_t status, txnid_t txnid) {
     block_fifo_response_t response;
     response.status = status;
@@ -46,33 +60,174 @@ void OutOfBandRespond(const zx::fifo& fifo, zx_status_t status, txnid_t txnid) {
 
 void BlockComplete(void* cookie, zx_status_t status) {
     block_msg_t* msg = static_cast<block_msg_t*>(cookie);
-    // Since iobuf is a RefPtr, it lives at least as long as the txn,
-    // and is not discarded underneath the block device driver.
-    ZX_DEBUG_ASSERT(msg->iobuf != nullptr);
-    ZX_DEBUG_ASSERT(msg->txn != nullptr);
-    // Hold an extra copy of the 'blktxn' refptr; if we don't, and 'msg->txn' is
-    // the last copy, then when we nullify 'msg->txn' in Complete we end up
-    // trying to unlock a lock in a deleted BlockTxn.
-    auto blktxn = msg->txn;
-    // Pass msg to complete so 'msg->txn' can be nullified while protected
-    // by the BlockTransaction's lock.
-    blktxn->Complete(msg, status);
+    while (msg != nullptr) {
+        // A message may be reused as soon as it has completed.
+        block_msg_t* next = msg->merged_next;
+        msg->merged_next = nullptr;
+        // Since iobuf is a RefPtr, it lives at least as long as the txn,
+        // and is not discarded underneath the block device driver.
+        ZX_DEBUG_ASSERT(msg->iobuf != nullptr);
+        ZX_DEBUG_ASSERT(msg->txn != nullptr);
+        // Hold an extra copy of the 'blktxn' refptr; if we don't, and 'msg->txn' is
+        // the last copy, then when we nullify 'msg->txn' in Complete we end up
+        // trying to unlock a lock in a deleted BlockTxn.
+        auto blktxn = msg->txn;
+        // Pass msg to complete so 'msg->txn' can be nullified while protected
+        // by the BlockTransaction's lock.
+        blktxn->Complete(msg, status);
+        msg = next;
+    }
 }
 
 void BlockCompleteCb(block_op_t* bop, zx_status_t status) {
+    BlockServerOp* op = BlockServerOp::FromBop(bop);
     BlockComplete(bop->cookie, status);
-    free(bop);
+    op->server->OpComplete();
+    free(op);
+}
+
+// Whether |a| and |b| touch the same blocks with at least one of them
+// writing them, in which case they must stay in the order they came in.
+bool Conflicts(const block_request_t& a, const block_request_t& b) {
+    if ((a.msg->opcode == BLOCKIO_READ) && (b.msg->opcode == BLOCKIO_READ)) {
+        return false;
+    }
+    return (a.dev_offset < b.dev_offset + b.length) && (b.dev_offset < a.dev_offset + a.length);
 }
 
 }  // namespace
 
+BlockServerStats::BlockServerStats() {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void BlockServerStats::AddBatch(uint64_t requests, uint64_t ops, uint64_t merged, bool sorted) {
+    fbl::AutoLock lock(&lock_);
+    stats_.requests += requests;
+    stats_.ops += ops;
+    stats_.merged += merged;
+    if (sorted) {
+        stats_.sorted_batches++;
+    }
+}
+
+void BlockServerStats::AddRequest(uint32_t priority, uint64_t blocks) {
+    fbl::AutoLock lock(&lock_);
+    stats_.classes[priority].requests++;
+    stats_.classes[priority].blocks += blocks;
+}
+
+void BlockServerStats::AddLatency(uint32_t priority, zx_duration_t latency) {
+    uint64_t us = latency / ZX_USEC(1);
+    size_t bucket = (us > 1) ? 63 - __builtin_clzll(us) : 0;
+    bucket = fbl::min(bucket, static_cast<size_t>(BLOCK_LATENCY_BUCKETS - 1));
+    fbl::AutoLock lock(&lock_);
+    stats_.latency[bucket]++;
+    block_class_stats_t* stats = &stats_.classes[priority];
+    stats->total_latency += latency;
+    if (latency > stats->max_latency) {
+        stats->max_latency = latency;
+    }
+}
+
+void BlockServerStats::SetDispatchThreads(uint32_t count) {
+    fbl::AutoLock lock(&lock_);
+    stats_.dispatch_threads = count;
+}
+
+void BlockServerStats::Get(block_server_stats_t* out, bool clear) {
+    fbl::AutoLock lock(&lock_);
+    *out = stats_;
+    if (clear) {
+        uint32_t dispatch_threads = stats_.dispatch_threads;
+        memset(&stats_, 0, sizeof(stats_));
+        stats_.dispatch_threads = dispatch_threads;
+    }
+}
+
+BlockDispatcher::BlockDispatcher(const block_protocol_t& bp) : bp_(bp) {}
+
+BlockDispatcher::~BlockDispatcher() {
+    Stop();
+}
+
+zx_status_t BlockDispatcher::Start(uint32_t index) {
+    char name[ZX_MAX_NAME_LEN];
+    snprintf(name, sizeof(name), "block-dispatch-%u", index);
+    if (thrd_create_with_name(&thread_, Thread, this, name) != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    started_ = true;
+    return ZX_OK;
+}
+
+bool BlockDispatcher::Queue(block_op_t* bop) {
+    {
+        fbl::AutoLock lock(&lock_);
+        if (stopping_) {
+            return false;
+        }
+        fbl::AllocChecker ac;
+        ops_.push_back(bop, &ac);
+        if (!ac.check()) {
+            return false;
+        }
+    }
+    completion_signal(&signal_);
+    return true;
+}
+
+void BlockDispatcher::Stop() {
+    if (!started_) {
+        return;
+    }
+    {
+        fbl::AutoLock lock(&lock_);
+        stopping_ = true;
+    }
+    completion_signal(&signal_);
+    thrd_join(thread_, nullptr);
+    started_ = false;
+}
+
+int BlockDispatcher::Thread(void* arg) {
+    BlockDispatcher* dispatcher = static_cast<BlockDispatcher*>(arg);
+    fbl::Vector<block_op_t*> ops;
+    while (true) {
+        completion_wait(&dispatcher->signal_, ZX_TIME_INFINITE);
+        completion_reset(&dispatcher->signal_);
+
+        bool stopping;
+        {
+            fbl::AutoLock lock(&dispatcher->lock_);
+            ops.swap(dispatcher->ops_);
+            stopping = dispatcher->stopping_;
+        }
+        for (size_t i = 0; i < ops.size(); i++) {
+            dispatcher->bp_.ops->queue(dispatcher->bp_.ctx, ops[i]);
+        }
+        // Keep the storage for the next batch
+        while (!ops.is_empty()) {
+            ops.pop_back();
+        }
+        if (stopping) {
+            return 0;
+        }
+    }
+}
+
 void BlockServer::Queue(uint32_t flags, zx_handle_t vmo, uint64_t length,
                         uint64_t vmo_offset, uint64_t dev_offset, block_msg_t* msg) {
-    block_op_t* bop = (block_op_t*) malloc(block_op_size_);
-    if (bop == nullptr) {
+    BlockServerOp* op = (BlockServerOp*) malloc(sizeof(BlockServerOp) + block_op_size_);
+    if (op == nullptr) {
         BlockComplete(msg, ZX_ERR_NO_MEMORY);
         return;
     }
+    new (op) BlockServerOp();
+    op->server = this;
+    op->length = length;
+
+    block_op_t* bop = op->bop();
     bop->command = (msg->opcode == BLOCKIO_READ) ? BLOCK_OP_READ : BLOCK_OP_WRITE;
     bop->rw.length = (uint32_t) length;
     bop->rw.vmo = vmo;
@@ -81,11 +236,206 @@ void BlockServer::Queue(uint32_t flags, zx_handle_t vmo, uint64_t length,
     bop->rw.pages = NULL;
     bop->completion_cb = BlockCompleteCb;
     bop->cookie = msg;
-    bp_.ops->queue(bp_.ctx, bop);
+
+    fbl::AutoLock lock(&sched_lock_);
+    BlockClientQueue* client = &clients_[msg->txn->txnid()];
+    client->ops.push_back(op);
+    if (!client->InContainer()) {
+        active_.push_back(client);
+    }
+}
+
+void BlockServer::Pump() {
+    // Deficit round robin: a txn has ops queued until it has used up its
+    // quantum, and then goes to the back to wait for its next turn.
+    BlockServerOp* ops[kMaxInflightOps];
+    size_t count = 0;
+    {
+        fbl::AutoLock lock(&sched_lock_);
+        while ((inflight_ < kMaxInflightOps) && !active_.is_empty()) {
+            BlockClientQueue* client = &active_.front();
+            BlockServerOp* op = &client->ops.front();
+            if (client->deficit < op->length) {
+                client->deficit += kQuantumBlocks * kPriorityWeights[client->priority];
+                active_.push_back(active_.pop_front());
+                continue;
+            }
+            client->deficit -= op->length;
+            client->ops.pop_front();
+            if (client->ops.is_empty()) {
+                // A txn does not save up turns while it has nothing waiting
+                active_.pop_front();
+                client->deficit = 0;
+            }
+            inflight_++;
+            ops[count++] = op;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        Dispatch(ops[i]->bop());
+    }
+}
+
+void BlockServer::Drain() {
+    fbl::DoublyLinkedList<BlockServerOp*> ops;
+    bool idle;
+    {
+        fbl::AutoLock lock(&sched_lock_);
+        draining_ = true;
+        while (!active_.is_empty()) {
+            BlockClientQueue* client = active_.pop_front();
+            while (!client->ops.is_empty()) {
+                ops.push_back(client->ops.pop_front());
+                inflight_++;
+            }
+            client->deficit = 0;
+        }
+        idle = (inflight_ == 0);
+    }
+    while (!ops.is_empty()) {
+        Dispatch(ops.pop_front()->bop());
+    }
+
+    // Ops refer back to the server when they complete, so it must outlast
+    // them. The last one signals idle_ holding the lock, taking it after
+    // waiting makes sure it is done.
+    if (!idle) {
+        completion_wait(&idle_, ZX_TIME_INFINITE);
+    }
+    fbl::AutoLock lock(&sched_lock_);
+}
+
+void BlockServer::OpComplete() {
+    fbl::AutoLock lock(&sched_lock_);
+    ZX_DEBUG_ASSERT(inflight_ > 0);
+    inflight_--;
+    if (draining_) {
+        if (inflight_ == 0) {
+            completion_signal(&idle_);
+        }
+    } else if (!active_.is_empty()) {
+        fifo_.signal(0, kSignalFifoRefill);
+    }
+}
+
+void BlockServer::Dispatch(block_op_t* bop) {
+    // Round robin over the fifo thread itself and the dispatcher threads
+    uint32_t n = next_dispatch_++ % dispatch_count_;
+    if ((n == 0) || !dispatchers_[n - 1]->Queue(bop)) {
+        bp_.ops->queue(bp_.ctx, bop);
+    }
+}
+
+uint64_t BlockServer::QueueRequest(block_msg_t* msg, zx_handle_t vmo, uint64_t length,
+                                   uint64_t vmo_offset, uint64_t dev_offset) {
+    const uint64_t max_xfer = info_.max_transfer_size / info_.block_size;
+    if (max_xfer == 0 || max_xfer >= length) {
+        Queue(msg->flags, vmo, length, vmo_offset, dev_offset, msg);
+        return 1;
+    }
+
+    // Requests are never merged past the maximum transfer size
+    ZX_DEBUG_ASSERT(msg->merged_next == nullptr);
+    uint64_t len_remaining = length;
+    size_t sub_txns = fbl::round_up(len_remaining, max_xfer) / max_xfer;
+    msg->sub_txns = static_cast<uint32_t>(sub_txns);
+    for (size_t i = 0; i < sub_txns; i++) {
+        uint64_t length = fbl::min(len_remaining, max_xfer);
+        len_remaining -= length;
+
+        uint32_t flags = msg->flags;
+        Queue(flags, vmo, length, vmo_offset, dev_offset, msg);
+        vmo_offset += length;
+        dev_offset += length;
+    }
+    ZX_DEBUG_ASSERT(len_remaining == 0);
+    return sub_txns;
+}
+
+void BlockServer::Schedule(block_request_t* requests, size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    // Devices that seek get the batch in device offset order. An insertion
+    // sort keeps requests that conflict in order and batches are small.
+    bool sorted = false;
+    if (info_.flags & BLOCK_FLAG_SEEK_PENALTY) {
+        for (size_t i = 1; i < count; i++) {
+            block_request_t request = requests[i];
+            size_t j = i;
+            while ((j > 0) && (requests[j - 1].dev_offset > request.dev_offset) &&
+                   !Conflicts(requests[j - 1], request)) {
+                requests[j] = requests[j - 1];
+                j--;
+            }
+            if (j != i) {
+                requests[j] = request;
+                sorted = true;
+            }
+        }
+    }
+
+    // Requests that continue the one before them on both the device and
+    // the same vmo become a single block op, up to the maximum transfer.
+    const uint64_t max_xfer = info_.max_transfer_size / info_.block_size;
+    uint64_t ops = 0;
+    uint64_t merged = 0;
+    size_t i = 0;
+    while (i < count) {
+        const block_request_t& head = requests[i];
+        block_msg_t* tail = head.msg;
+        uint64_t length = head.length;
+        for (i++; i < count; i++) {
+            const block_request_t& next = requests[i];
+            uint64_t merged_length = length + next.length;
+            if ((next.msg->opcode != head.msg->opcode) || (next.vmo != head.vmo) ||
+                (next.dev_offset != head.dev_offset + length) ||
+                (next.vmo_offset != head.vmo_offset + length) ||
+                (max_xfer != 0 && merged_length > max_xfer) ||
+                (merged_length > fbl::numeric_limits<uint32_t>::max())) {
+                break;
+            }
+            tail->merged_next = next.msg;
+            tail = next.msg;
+            length = merged_length;
+            merged++;
+        }
+        ops += QueueRequest(head.msg, head.vmo, length, head.vmo_offset, head.dev_offset);
+    }
+    stats_->AddBatch(count, ops, merged, sorted);
 }
 
-BlockTransaction::BlockTransaction(zx_handle_t fifo, txnid_t txnid) :
-    fifo_(fifo), flags_(0), ctr_(0) {
+void BlockServer::StartDispatchers() {
+    dispatch_count_ = 1;
+    next_dispatch_ = 0;
+    // Sorted ops are queued from the fifo thread alone, to keep them in order
+    if (!(info_.flags & BLOCK_FLAG_SEEK_PENALTY)) {
+        uint32_t want = fbl::min(zx_system_get_num_cpus(), kMaxDispatchThreads);
+        while (dispatch_count_ < want) {
+            fbl::AllocChecker ac;
+            fbl::unique_ptr<BlockDispatcher> dispatcher(new (&ac) BlockDispatcher(bp_));
+            if (!ac.check() || dispatcher->Start(dispatch_count_) != ZX_OK) {
+                break;
+            }
+            dispatchers_[dispatch_count_ - 1] = fbl::move(dispatcher);
+            dispatch_count_++;
+        }
+    }
+    stats_->SetDispatchThreads(dispatch_count_);
+}
+
+void BlockServer::StopDispatchers() {
+    for (uint32_t i = 0; i + 1 < dispatch_count_; i++) {
+        dispatchers_[i]->Stop();
+        dispatchers_[i].reset();
+    }
+    dispatch_count_ = 1;
+}
+
+BlockTransaction::BlockTransaction(zx_handle_t fifo, txnid_t txnid,
+                                   fbl::RefPtr<BlockServerStats> stats) :
+    fifo_(fifo), txnid_(txnid), stats_(fbl::move(stats)), flags_(0), ctr_(0) {
     memset(&response_, 0, sizeof(response_));
     response_.txnid = txnid;
 }
@@ -113,6 +463,7 @@ zx_status_t BlockTransaction::Enqueue(bool do_respond, block_msg_t** msg_out) {
     ZX_DEBUG_ASSERT(ctr_ < MAX_TXN_MESSAGES); // Avoid overflowing msgs
     msgs_[ctr_].flags = 0;
     msgs_[ctr_].sub_txns = 1;
+    msgs_[ctr_].merged_next = nullptr;
     *msg_out = &msgs_[ctr_++];
     if (do_respond) {
         SetResponseReadyLocked();
@@ -171,6 +522,8 @@ void BlockTransaction::Complete(block_msg_t* msg, zx_status_t status) {
         return;
     }
 
+    stats_->AddLatency(msg->priority, zx_clock_get(ZX_CLOCK_MONOTONIC) - msg->queued);
+
     response_.count++;
     ZX_DEBUG_ASSERT(ctr_ != 0);
     ZX_DEBUG_ASSERT(response_.count <= ctr_);
@@ -203,7 +556,8 @@ zx_status_t BlockServer::Read(block_fifo_request_t* requests, uint32_t* count) {
     while (true) {
         zx_status_t status = fifo_.read(requests, sizeof(block_fifo_request_t), count);
         if (status == ZX_ERR_SHOULD_WAIT) {
-            zx_signals_t waitfor = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED | kSignalFifoTerminate;
+            zx_signals_t waitfor = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED | kSignalFifoTerminate |
+                                   kSignalFifoRefill;
             zx_signals_t observed;
             if ((status = fifo_.wait_one(waitfor, zx::time::infinite(), &observed)) != ZX_OK) {
                 return status;
@@ -211,6 +565,12 @@ zx_status_t BlockServer::Read(block_fifo_request_t* requests, uint32_t* count) {
             if ((observed & ZX_FIFO_PEER_CLOSED) || (observed & kSignalFifoTerminate)) {
                 return ZX_ERR_PEER_CLOSED;
             }
+            if (observed & kSignalFifoRefill) {
+                // Return no requests, to have waiting block ops queued
+                fifo_.signal(kSignalFifoRefill, 0);
+                *count = 0;
+                return ZX_OK;
+            }
             // Try reading again...
         } else {
             return status;
@@ -260,7 +620,7 @@ zx_status_t BlockServer::AllocateTxn(txnid_t* out) {
         if (txns_[i] == nullptr) {
             txnid_t txnid = static_cast<txnid_t>(i);
             fbl::AllocChecker ac;
-            txns_[i] = fbl::AdoptRef(new (&ac) BlockTransaction(fifo_.get(), txnid));
+            txns_[i] = fbl::AdoptRef(new (&ac) BlockTransaction(fifo_.get(), txnid, stats_));
             if (!ac.check()) {
                 return ZX_ERR_NO_MEMORY;
             }
@@ -271,6 +631,10 @@ zx_status_t BlockServer::AllocateTxn(txnid_t* out) {
     return ZX_ERR_NO_RESOURCES;
 }
 
+void BlockServer::GetStats(block_server_stats_t* out, bool clear) {
+    stats_->Get(out, clear);
+}
+
 void BlockServer::FreeTxn(txnid_t txnid) {
     fbl::AutoLock server_lock(&server_lock_);
     if (txnid >= fbl::count_of(txns_)) {
@@ -278,6 +642,22 @@ void BlockServer::FreeTxn(txnid_t txnid) {
     }
     ZX_DEBUG_ASSERT(txns_[txnid] != nullptr);
     txns_[txnid] = nullptr;
+
+    fbl::AutoLock lock(&sched_lock_);
+    clients_[txnid].priority = BLOCK_PRIORITY_INTERACTIVE;
+}
+
+zx_status_t BlockServer::SetTxnPriority(txnid_t txnid, uint32_t priority) {
+    if (priority >= BLOCK_PRIORITY_COUNT) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    fbl::AutoLock server_lock(&server_lock_);
+    if (txnid >= fbl::count_of(txns_) || txns_[txnid] == nullptr) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    fbl::AutoLock lock(&sched_lock_);
+    clients_[txnid].priority = priority;
+    return ZX_OK;
 }
 
 zx_status_t BlockServer::Create(zx_device_t* dev, block_protocol_t* bp,
@@ -287,6 +667,11 @@ zx_status_t BlockServer::Create(zx_device_t* dev, block_protocol_t* bp,
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
+    bs->stats_ = fbl::AdoptRef(new (&ac) BlockServerStats());
+    if (!ac.check()) {
+        delete bs;
+        return ZX_ERR_NO_MEMORY;
+    }
 
     zx_status_t status;
     if ((status = zx::fifo::create(BLOCK_FIFO_MAX_DEPTH, BLOCK_FIFO_ESIZE, 0,
@@ -306,12 +691,20 @@ zx_status_t BlockServer::Create(zx_device_t* dev, block_protocol_t* bp,
 zx_status_t BlockServer::Serve() {
     zx_status_t status;
     block_fifo_request_t requests[BLOCK_FIFO_MAX_DEPTH];
+    block_request_t pending[BLOCK_FIFO_MAX_DEPTH];
     uint32_t count;
+    StartDispatchers();
     while (true) {
         if ((status = Read(requests, &count) != ZX_OK)) {
+            Drain();
+            StopDispatchers();
             return status;
         }
 
+        // Reads and writes are scheduled together once the whole batch has
+        // been taken apart
+        zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        size_t pending_count = 0;
         for (size_t i = 0; i < count; i++) {
             bool wants_reply = requests[i].opcode & BLOCKIO_TXN_END;
             txnid_t txnid = requests[i].txnid;
@@ -352,6 +745,12 @@ zx_status_t BlockServer::Serve() {
                 msg->txn = txns_[txnid];
                 ZX_DEBUG_ASSERT(msg->iobuf == nullptr);
                 msg->iobuf = iobuf.CopyPointer();
+                msg->queued = now;
+                {
+                    fbl::AutoLock lock(&sched_lock_);
+                    msg->priority = clients_[txnid].priority;
+                }
+                stats_->AddRequest(msg->priority, requests[i].length);
 
                 // Hack to ensure that the vmo is valid.
                 // In the future, this code will be responsible for pinning VMO pages,
@@ -366,30 +765,12 @@ zx_status_t BlockServer::Serve() {
 
                 msg->opcode = requests[i].opcode & BLOCKIO_OP_MASK;
 
-                const uint64_t max_xfer = info_.max_transfer_size / bsz;
-                if (max_xfer != 0 && max_xfer < requests[i].length) {
-                    uint64_t len_remaining = requests[i].length;
-                    uint64_t vmo_offset = requests[i].vmo_offset;
-                    uint64_t dev_offset = requests[i].dev_offset;
-
-                    size_t sub_txns = fbl::round_up(len_remaining, max_xfer) / max_xfer;
-                    msg->sub_txns = static_cast<uint32_t>(sub_txns);
-                    for (size_t i = 0; i < sub_txns; i++) {
-                        uint64_t length = fbl::min(len_remaining, max_xfer);
-                        len_remaining -= length;
-
-                        uint32_t flags = msg->flags;
-                        Queue(flags, iobuf->vmo(), length,
-                              vmo_offset, dev_offset, msg);
-                        vmo_offset += length;
-                        dev_offset += length;
-                    }
-                    ZX_DEBUG_ASSERT(len_remaining == 0);
-                } else {
-                    Queue(msg->flags, iobuf->vmo(), requests[i].length,
-                          requests[i].vmo_offset, requests[i].dev_offset, msg);
-                }
-
+                block_request_t* request = &pending[pending_count++];
+                request->msg = msg;
+                request->vmo = iobuf->vmo();
+                request->length = requests[i].length;
+                request->vmo_offset = requests[i].vmo_offset;
+                request->dev_offset = requests[i].dev_offset;
                 break;
             }
             case BLOCKIO_SYNC: {
@@ -410,11 +791,15 @@ zx_status_t BlockServer::Serve() {
             }
             }
         }
+
+        Schedule(pending, pending_count);
+        Pump();
     }
 }
 
 BlockServer::BlockServer(zx_device_t* dev, block_protocol_t* bp) :
-    dev_(dev), bp_(*bp), block_op_size_(0), last_id_(VMOID_INVALID + 1) {
+    dev_(dev), bp_(*bp), block_op_size_(0), dispatch_count_(1), next_dispatch_(0),
+    inflight_(0), draining_(false), last_id_(VMOID_INVALID + 1) {
     size_t actual;
     device_ioctl(dev_, IOCTL_BLOCK_GET_INFO, nullptr, 0, &info_, sizeof(info_), &actual);
 }
@@ -456,3 +841,9 @@ zx_status_t blockserver_allocate_txn(BlockServer* bs, txnid_t* out) {
 void blockserver_free_txn(BlockServer* bs, txnid_t txnid) {
     return bs->FreeTxn(txnid);
 }
+zx_status_t blockserver_set_txn_priority(BlockServer* bs, txnid_t txnid, uint32_t priority) {
+    return bs->SetTxnPriority(txnid, priority);
+}
+void blockserver_get_stats(BlockServer* bs, bool clear, block_server_stats_t* out) {
+    bs->GetStats(out, clear);
+}
@@ -7,6 +7,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <threads.h>
 
 #include <zircon/device/block.h>
 #include <ddk/protocol/block.h>
@@ -17,11 +18,14 @@
 
 #include <zx/fifo.h>
 #include <zx/vmo.h>
+#include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <sync/completion.h>
 
 // Represents the mapping of "vmoid --> VMO"
 class IoBuffer : public fbl::WAVLTreeContainable<fbl::RefPtr<IoBuffer>>,
@@ -52,19 +56,47 @@ constexpr uint32_t kTxnFlagRespond = 0x00000001; // Should a reponse be sent whe
 
 class BlockTransaction;
 
-typedef struct {
+typedef struct block_msg {
     fbl::RefPtr<BlockTransaction> txn;
     fbl::RefPtr<IoBuffer> iobuf;
     uint32_t opcode;
     uint32_t flags;
     uint32_t sub_txns;
+    // The next message completed by the same block op, when the requests
+    // of several messages were merged into one.
+    struct block_msg* merged_next;
+    // When the request was taken from the fifo
+    zx_time_t queued;
+    // The priority class of the txn when the request was taken
+    uint32_t priority;
 } block_msg_t;
 
+// How the requests of a BlockServer were scheduled. Shared with its
+// transactions, which may complete after the server is gone.
+class BlockServerStats : public fbl::RefCounted<BlockServerStats> {
+public:
+    BlockServerStats();
+
+    void AddBatch(uint64_t requests, uint64_t ops, uint64_t merged, bool sorted);
+    void AddRequest(uint32_t priority, uint64_t blocks);
+    void AddLatency(uint32_t priority, zx_duration_t latency);
+    void SetDispatchThreads(uint32_t count);
+    void Get(block_server_stats_t* out, bool clear);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlockServerStats);
+
+    fbl::Mutex lock_;
+    block_server_stats_t stats_ TA_GUARDED(lock_);
+};
+
 class BlockTransaction : public fbl::RefCounted<BlockTransaction> {
 public:
-    BlockTransaction(zx_handle_t fifo, txnid_t txnid);
+    BlockTransaction(zx_handle_t fifo, txnid_t txnid, fbl::RefPtr<BlockServerStats> stats);
     ~BlockTransaction();
 
+    txnid_t txnid() const { return txnid_; }
+
     // Verifies that the incoming txn does not break the Block IO fifo protocol.
     // If it is successful, sets up the response_ with the registered cookie,
     // and adds to the "ctr_" counter of number of Completions that must be
@@ -91,6 +123,8 @@ private:
     void RespondLocked() TA_REQ(lock_);
 
     const zx_handle_t fifo_;
+    const txnid_t txnid_;
+    const fbl::RefPtr<BlockServerStats> stats_;
 
     fbl::Mutex lock_;
     block_msg_t msgs_[MAX_TXN_MESSAGES] TA_GUARDED(lock_);
@@ -99,6 +133,78 @@ private:
     uint32_t ctr_ TA_GUARDED(lock_); // How many ops does the block device need to complete?
 };
 
+// A read or write request taken from the fifo, waiting to be scheduled.
+// The units of length, vmo_offset, and dev_offset are 'blocks'.
+typedef struct {
+    block_msg_t* msg;
+    zx_handle_t vmo;
+    uint64_t length;
+    uint64_t vmo_offset;
+    uint64_t dev_offset;
+} block_request_t;
+
+// A thread queueing block ops to the device on behalf of the fifo thread,
+// so that a driver with a queue per submitting thread spreads the ops of a
+// single fifo over several of its queues.
+class BlockDispatcher {
+public:
+    explicit BlockDispatcher(const block_protocol_t& bp);
+    ~BlockDispatcher();
+
+    zx_status_t Start(uint32_t index);
+
+    // Queues |bop| to the device from the dispatcher thread. Returns false,
+    // leaving |bop| to the caller, if it could not be handed over.
+    bool Queue(block_op_t* bop);
+
+    // Queues every op handed over so far and stops the thread.
+    void Stop();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlockDispatcher);
+
+    static int Thread(void* arg);
+
+    const block_protocol_t bp_;
+    thrd_t thread_;
+    bool started_ = false;
+    completion_t signal_;
+
+    fbl::Mutex lock_;
+    fbl::Vector<block_op_t*> ops_ TA_GUARDED(lock_);
+    bool stopping_ TA_GUARDED(lock_) = false;
+};
+
+// Most threads a server queues block ops from, including the fifo thread.
+constexpr uint32_t kMaxDispatchThreads = 4;
+
+// Most block ops a server has queued to the device at once. The rest wait
+// in the server for their turn, which is what lets it share the device
+// fairly between txns.
+constexpr uint32_t kMaxInflightOps = 64;
+
+class BlockServer;
+
+// A block op of a BlockServer, allocated with the space for the op the
+// device asked for right after it.
+struct BlockServerOp : public fbl::DoublyLinkedListable<BlockServerOp*> {
+    BlockServer* server;
+    uint64_t length;
+
+    block_op_t* bop() { return reinterpret_cast<block_op_t*>(this + 1); }
+    static BlockServerOp* FromBop(block_op_t* bop) {
+        return reinterpret_cast<BlockServerOp*>(bop) - 1;
+    }
+};
+
+// The block ops of a txn waiting for their turn to be queued to the device.
+struct BlockClientQueue : public fbl::DoublyLinkedListable<BlockClientQueue*> {
+    fbl::DoublyLinkedList<BlockServerOp*> ops;
+    // Blocks the txn may still have queued to the device in its current turn
+    uint64_t deficit = 0;
+    uint32_t priority = BLOCK_PRIORITY_INTERACTIVE;
+};
+
 class BlockServer {
 public:
     // Creates a new BlockServer
@@ -109,6 +215,11 @@ public:
     zx_status_t AttachVmo(zx::vmo vmo, vmoid_t* out);
     zx_status_t AllocateTxn(txnid_t* out);
     void FreeTxn(txnid_t txnid);
+    zx_status_t SetTxnPriority(txnid_t txnid, uint32_t priority);
+    void GetStats(block_server_stats_t* out, bool clear);
+
+    // Called by each block op when it has completed
+    void OpComplete();
 
     void ShutDown();
 
@@ -124,12 +235,44 @@ private:
     void Queue(uint32_t flags, zx_handle_t vmo, uint64_t length,
                uint64_t vmo_offset, uint64_t dev_offset, block_msg_t* msg);
 
+    // Orders the |count| requests of a batch and merges neighbours among
+    // them, queueing the block ops they turn into.
+    void Schedule(block_request_t* requests, size_t count);
+    // Queues the request of |msg| and of the messages merged with it as a
+    // single request, returning the number of block ops it took.
+    uint64_t QueueRequest(block_msg_t* msg, zx_handle_t vmo, uint64_t length,
+                          uint64_t vmo_offset, uint64_t dev_offset);
+    void Dispatch(block_op_t* bop);
+
+    // Queues waiting block ops to the device, taking turns between the txns
+    // they belong to, while there is room for more in flight.
+    void Pump();
+    // Queues every waiting block op and waits for all of them to complete.
+    void Drain();
+
+    void StartDispatchers();
+    void StopDispatchers();
+
     zx::fifo fifo_;
     zx_device_t* dev_;
     block_info_t info_;
     block_protocol_t bp_;
     size_t block_op_size_;
 
+    fbl::RefPtr<BlockServerStats> stats_;
+    // Only touched by the fifo thread
+    fbl::unique_ptr<BlockDispatcher> dispatchers_[kMaxDispatchThreads - 1];
+    uint32_t dispatch_count_;
+    uint32_t next_dispatch_;
+
+    fbl::Mutex sched_lock_;
+    BlockClientQueue clients_[MAX_TXN_COUNT] TA_GUARDED(sched_lock_);
+    // txns with block ops waiting, in the order they take turns
+    fbl::DoublyLinkedList<BlockClientQueue*> active_ TA_GUARDED(sched_lock_);
+    uint32_t inflight_ TA_GUARDED(sched_lock_);
+    bool draining_ TA_GUARDED(sched_lock_);
+    completion_t idle_;
+
     fbl::Mutex server_lock_;
     fbl::WAVLTree<vmoid_t, fbl::RefPtr<IoBuffer>> tree_ TA_GUARDED(server_lock_);
     fbl::RefPtr<BlockTransaction> txns_[MAX_TXN_COUNT] TA_GUARDED(server_lock_);
@@ -164,4 +307,10 @@ zx_status_t blockserver_attach_vmo(BlockServer* bs, zx_handle_t vmo, vmoid_t* ou
 zx_status_t blockserver_allocate_txn(BlockServer* bs, txnid_t* out);
 void blockserver_free_txn(BlockServer* bs, txnid_t txnid);
 
+// Set the priority class of a txn
+zx_status_t blockserver_set_txn_priority(BlockServer* bs, txnid_t txnid, uint32_t priority);
+
+// Get the block server's scheduling stats, optionally clearing them
+void blockserver_get_stats(BlockServer* bs, bool clear, block_server_stats_t* out);
+
 __END_CDECLS
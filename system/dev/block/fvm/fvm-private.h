@@ -20,6 +20,7 @@
 #include <ddktl/protocol/block.h>
 #include <fs/mapped-vmo.h>
 #include <fbl/algorithm.h>
+#include <fbl/array.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
@@ -94,6 +95,8 @@ public:
 
     // Update, hash, and write back the current copy of the FVM metadata.
     // Automatically handles alternating writes to primary / backup copy of FVM.
+    // Only the metadata blocks modified since the destination copy was last
+    // written are sent to disk.
     zx_status_t WriteFvmLocked() TA_REQ(lock_);
 
     // Block Protocol
@@ -102,20 +105,28 @@ public:
 
     // Acquire access to a VPart Entry which has already been modified (and
     // will, as a consequence, not be de-allocated underneath us).
-    vpart_entry_t* GetAllocatedVPartEntry(size_t index) const TA_NO_THREAD_SAFETY_ANALYSIS {
+    const vpart_entry_t* GetAllocatedVPartEntry(size_t index) const TA_NO_THREAD_SAFETY_ANALYSIS {
         auto entry = GetVPartEntryLocked(index);
         ZX_DEBUG_ASSERT(entry->slices > 0);
         return entry;
     }
 
-    slice_entry_t* GetSliceEntryLocked(size_t index) const TA_REQ(lock_) {
+    const slice_entry_t* GetSliceEntryLocked(size_t index) const TA_REQ(lock_) {
         ZX_DEBUG_ASSERT(index >= 1);
         uintptr_t metadata_start = reinterpret_cast<uintptr_t>(GetFvmLocked());
         uintptr_t offset = static_cast<uintptr_t>(kAllocTableOffset +
                                                   index * sizeof(slice_entry_t));
         ZX_DEBUG_ASSERT(kAllocTableOffset <= offset);
         ZX_DEBUG_ASSERT(offset < kAllocTableOffset + AllocTableLength(DiskSize(), SliceSize()));
-        return reinterpret_cast<slice_entry_t*>(metadata_start + offset);
+        return reinterpret_cast<const slice_entry_t*>(metadata_start + offset);
+    }
+
+    // Acquire a slice entry for modification. The metadata block holding it
+    // is written back by the next WriteFvmLocked.
+    slice_entry_t* GetSliceEntryLocked(size_t index) TA_REQ(lock_) {
+        auto entry = static_cast<const VPartitionManager*>(this)->GetSliceEntryLocked(index);
+        MarkDirtyLocked(entry);
+        return const_cast<slice_entry_t*>(entry);
     }
 
     // Allocate 'count' slices, write back the FVM.
@@ -123,6 +134,13 @@ public:
     zx_status_t AllocateSlicesLocked(VPartition* vp, size_t vslice_start,
                                      size_t count) TA_REQ(lock_);
 
+    // Allocate slices for each of the 'count' ranges, write back the FVM once.
+    // Either every range is allocated, or none are.
+    zx_status_t AllocateSliceRanges(VPartition* vp, const extend_request_t* ranges,
+                                    size_t count) TA_EXCL(lock_);
+    zx_status_t AllocateSliceRangesLocked(VPartition* vp, const extend_request_t* ranges,
+                                          size_t count) TA_REQ(lock_);
+
     // Marks the partition with instance GUID |old_guid| as inactive,
     // and marks partitions with instance GUID |new_guid| as active.
     //
@@ -162,18 +180,42 @@ private:
     zx_status_t FindFreeVPartEntryLocked(size_t* out) const TA_REQ(lock_);
     zx_status_t FindFreeSliceLocked(size_t* out, size_t hint) const TA_REQ(lock_);
 
+    // Map 'count' vslices starting at 'vslice_start' to free pslices, without
+    // writing back the FVM. On failure, nothing from this range stays mapped.
+    zx_status_t AllocateRangeLocked(VPartition* vp, size_t vslice_start, size_t count,
+                                    size_t* hint) TA_REQ(lock_, vp->lock_);
+    // Unmap a range mapped by AllocateRangeLocked.
+    void UndoRangeLocked(VPartition* vp, size_t vslice_start,
+                         size_t count) TA_REQ(lock_, vp->lock_);
+
     fvm_t* GetFvmLocked() const TA_REQ(lock_) {
         return reinterpret_cast<fvm_t*>(metadata_->GetData());
     }
 
-    vpart_entry_t* GetVPartEntryLocked(size_t index) const TA_REQ(lock_) {
+    const vpart_entry_t* GetVPartEntryLocked(size_t index) const TA_REQ(lock_) {
         ZX_DEBUG_ASSERT(index >= 1);
         uintptr_t metadata_start = reinterpret_cast<uintptr_t>(GetFvmLocked());
         uintptr_t offset = static_cast<uintptr_t>(kVPartTableOffset +
                                                   index * sizeof(vpart_entry_t));
         ZX_DEBUG_ASSERT(kVPartTableOffset <= offset);
         ZX_DEBUG_ASSERT(offset < kVPartTableOffset + kVPartTableLength);
-        return reinterpret_cast<vpart_entry_t*>(metadata_start + offset);
+        return reinterpret_cast<const vpart_entry_t*>(metadata_start + offset);
+    }
+
+    vpart_entry_t* GetVPartEntryLocked(size_t index) TA_REQ(lock_) {
+        auto entry = static_cast<const VPartitionManager*>(this)->GetVPartEntryLocked(index);
+        MarkDirtyLocked(entry);
+        return const_cast<vpart_entry_t*>(entry);
+    }
+
+    // Record that the metadata block holding 'entry' differs from both
+    // on-disk copies. Entries never straddle metadata blocks.
+    void MarkDirtyLocked(const void* entry) TA_REQ(lock_) {
+        size_t offset = reinterpret_cast<uintptr_t>(entry) -
+                        reinterpret_cast<uintptr_t>(GetFvmLocked());
+        for (auto& dirty : dirty_) {
+            dirty[offset / FVM_BLOCK_SIZE] = true;
+        }
     }
 
     size_t PrimaryOffsetLocked() const TA_REQ(lock_) {
@@ -188,11 +230,15 @@ private:
         return metadata_size_;
     }
 
-    zx_status_t DoIoLocked(zx_handle_t vmo, size_t off, size_t len, uint32_t command);
+    zx_status_t DoIoLocked(zx_handle_t vmo, size_t off, size_t vmo_off, size_t len,
+                           uint32_t command);
 
     fbl::Mutex lock_;
     fbl::unique_ptr<MappedVmo> metadata_ TA_GUARDED(lock_);
     bool first_metadata_is_primary_ TA_GUARDED(lock_);
+    // Per metadata block, whether it has changed since the first (index 0) or
+    // second (index 1) on-disk copy of the metadata was last written.
+    fbl::Array<bool> dirty_[2] TA_GUARDED(lock_);
     size_t metadata_size_;
     size_t slice_size_;
 
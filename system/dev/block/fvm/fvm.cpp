@@ -110,7 +110,7 @@ static void io_callback(block_op_t* op, zx_status_t status) {
     completion_signal((completion_t*) op->cookie);
 }
 
-zx_status_t VPartitionManager::DoIoLocked(zx_handle_t vmo, size_t off,
+zx_status_t VPartitionManager::DoIoLocked(zx_handle_t vmo, size_t off, size_t vmo_off,
                                           size_t len, uint32_t command) {
     completion_t signal;
 
@@ -122,7 +122,7 @@ zx_status_t VPartitionManager::DoIoLocked(zx_handle_t vmo, size_t off,
     bop->rw.vmo = vmo;
     bop->rw.length = (uint32_t) (len / bsz);
     bop->rw.offset_dev = off / bsz;
-    bop->rw.offset_vmo = 0;
+    bop->rw.offset_vmo = vmo_off / bsz;
     bop->rw.pages = NULL;
     bop->completion_cb = io_callback;
     bop->cookie = &signal;
@@ -160,7 +160,7 @@ zx_status_t VPartitionManager::Load() {
     }
 
     // Read the superblock first, to determine the slice sice
-    if (DoIoLocked(vmo.get(), 0, FVM_BLOCK_SIZE, BLOCK_OP_READ)) {
+    if (DoIoLocked(vmo.get(), 0, 0, FVM_BLOCK_SIZE, BLOCK_OP_READ)) {
         fprintf(stderr, "fvm: Failed to read first block from underlying device\n");
         return ZX_ERR_INTERNAL;
     }
@@ -201,7 +201,7 @@ zx_status_t VPartitionManager::Load() {
         }
 
         // Read both copies of metadata, ensure at least one is valid
-        if ((status = DoIoLocked(mvmo->GetVmo(), offset,
+        if ((status = DoIoLocked(mvmo->GetVmo(), offset, 0,
                                  MetadataSize(), BLOCK_OP_READ)) != ZX_OK) {
             return status;
         }
@@ -236,6 +236,18 @@ zx_status_t VPartitionManager::Load() {
         metadata_ = fbl::move(mvmo_backup);
     }
 
+    // Until the in-memory metadata has been written over a copy in full, that
+    // copy is treated as wholly out of date.
+    const size_t metadata_blocks = MetadataSize() / FVM_BLOCK_SIZE;
+    for (auto& dirty : dirty_) {
+        fbl::AllocChecker ac;
+        dirty.reset(new (&ac) bool[metadata_blocks], metadata_blocks);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        memset(dirty.get(), true, metadata_blocks);
+    }
+
     // Begin initializing the underlying partitions
     DdkMakeVisible();
     auto_detach.cancel();
@@ -270,6 +282,10 @@ zx_status_t VPartitionManager::Load() {
         vpartitions[entry->vpart]->SliceSetUnsafe(entry->vslice, i);
     }
 
+    // The primary copy is exactly what was just loaded.
+    auto& primary_dirty = dirty_[first_metadata_is_primary_ ? 0 : 1];
+    memset(primary_dirty.get(), false, primary_dirty.size());
+
     lock.release();
 
     // Iterate through 'valid' VPartitions, and create their devices.
@@ -296,12 +312,29 @@ zx_status_t VPartitionManager::WriteFvmLocked() {
     GetFvmLocked()->generation++;
     fvm_update_hash(GetFvmLocked(), MetadataSize());
 
-    // If we were reading from the primary, write to the backup.
-    status = DoIoLocked(metadata_->GetVmo(), BackupOffsetLocked(),
-                        MetadataSize(), BLOCK_OP_WRITE);
-    if (status != ZX_OK) {
-        return status;
+    // If we were reading from the primary, write to the backup. Only the
+    // blocks which changed since the backup was last written go out, along
+    // with the superblock, which carries the new generation and hash.
+    auto& dirty = dirty_[first_metadata_is_primary_ ? 1 : 0];
+    dirty[0] = true;
+    for (size_t start = 0; start < dirty.size();) {
+        if (!dirty[start]) {
+            start++;
+            continue;
+        }
+        size_t end = start + 1;
+        while (end < dirty.size() && dirty[end]) {
+            end++;
+        }
+        status = DoIoLocked(metadata_->GetVmo(), BackupOffsetLocked() + start * FVM_BLOCK_SIZE,
+                            start * FVM_BLOCK_SIZE, (end - start) * FVM_BLOCK_SIZE,
+                            BLOCK_OP_WRITE);
+        if (status != ZX_OK) {
+            return status;
+        }
+        start = end;
     }
+    memset(dirty.get(), false, dirty.size());
 
     // We only allow the switch of "write to the other copy of metadata"
     // once a valid version has been written entirely.
@@ -346,8 +379,26 @@ zx_status_t VPartitionManager::AllocateSlices(VPartition* vp, size_t vslice_star
 
 zx_status_t VPartitionManager::AllocateSlicesLocked(VPartition* vp, size_t vslice_start,
                                                     size_t count) {
-    if (vslice_start + count > VSliceMax()) {
-        return ZX_ERR_INVALID_ARGS;
+    extend_request_t range;
+    range.offset = vslice_start;
+    range.length = count;
+    return AllocateSliceRangesLocked(vp, &range, 1);
+}
+
+zx_status_t VPartitionManager::AllocateSliceRanges(VPartition* vp,
+                                                   const extend_request_t* ranges,
+                                                   size_t count) {
+    fbl::AutoLock lock(&lock_);
+    return AllocateSliceRangesLocked(vp, ranges, count);
+}
+
+zx_status_t VPartitionManager::AllocateSliceRangesLocked(VPartition* vp,
+                                                         const extend_request_t* ranges,
+                                                         size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (ranges[i].offset + ranges[i].length > VSliceMax()) {
+            return ZX_ERR_INVALID_ARGS;
+        }
     }
 
     zx_status_t status = ZX_OK;
@@ -359,46 +410,63 @@ zx_status_t VPartitionManager::AllocateSlicesLocked(VPartition* vp, size_t vslic
             return ZX_ERR_BAD_STATE;
         }
         for (size_t i = 0; i < count; i++) {
-            size_t pslice;
-            auto vslice = vslice_start + i;
-            if (vp->SliceGetLocked(vslice) != PSLICE_UNALLOCATED) {
-                status = ZX_ERR_INVALID_ARGS;
-            }
-            if ((status != ZX_OK) ||
-                ((status = FindFreeSliceLocked(&pslice, hint)) != ZX_OK) ||
-                ((status = vp->SliceSetLocked(vslice, static_cast<uint32_t>(pslice)) != ZX_OK))) {
-                for (int j = static_cast<int>(i - 1); j >= 0; j--) {
-                    vslice = vslice_start + j;
-                    GetSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
-                    vp->SliceFreeLocked(vslice);
+            status = AllocateRangeLocked(vp, ranges[i].offset, ranges[i].length, &hint);
+            if (status != ZX_OK) {
+                while (i-- > 0) {
+                    UndoRangeLocked(vp, ranges[i].offset, ranges[i].length);
                 }
-
                 return status;
             }
-            slice_entry_t* alloc_entry = GetSliceEntryLocked(pslice);
-            auto vpart = vp->GetEntryIndex();
-            ZX_DEBUG_ASSERT(vpart <= VPART_MAX);
-            ZX_DEBUG_ASSERT(vslice <= VSLICE_MAX);
-            alloc_entry->vpart = vpart & VPART_MAX;
-            alloc_entry->vslice = vslice & VSLICE_MAX;
-            hint = pslice + 1;
         }
     }
 
+    // The whole batch is committed with a single metadata write.
     if ((status = WriteFvmLocked()) != ZX_OK) {
         // Undo allocation in the event of failure; avoid holding VPartition
         // lock while writing to fvm.
         fbl::AutoLock lock(&vp->lock_);
-        for (int j = static_cast<int>(count - 1); j >= 0; j--) {
-            auto vslice = vslice_start + j;
-            GetSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
-            vp->SliceFreeLocked(vslice);
+        for (size_t i = count; i-- > 0;) {
+            UndoRangeLocked(vp, ranges[i].offset, ranges[i].length);
         }
     }
 
     return status;
 }
 
+zx_status_t VPartitionManager::AllocateRangeLocked(VPartition* vp, size_t vslice_start,
+                                                   size_t count, size_t* hint) {
+    zx_status_t status = ZX_OK;
+    for (size_t i = 0; i < count; i++) {
+        size_t pslice;
+        auto vslice = vslice_start + i;
+        if (vp->SliceGetLocked(vslice) != PSLICE_UNALLOCATED) {
+            status = ZX_ERR_INVALID_ARGS;
+        }
+        if ((status != ZX_OK) ||
+            ((status = FindFreeSliceLocked(&pslice, *hint)) != ZX_OK) ||
+            ((status = vp->SliceSetLocked(vslice, static_cast<uint32_t>(pslice)) != ZX_OK))) {
+            UndoRangeLocked(vp, vslice_start, i);
+            return status;
+        }
+        slice_entry_t* alloc_entry = GetSliceEntryLocked(pslice);
+        auto vpart = vp->GetEntryIndex();
+        ZX_DEBUG_ASSERT(vpart <= VPART_MAX);
+        ZX_DEBUG_ASSERT(vslice <= VSLICE_MAX);
+        alloc_entry->vpart = vpart & VPART_MAX;
+        alloc_entry->vslice = vslice & VSLICE_MAX;
+        *hint = pslice + 1;
+    }
+    return ZX_OK;
+}
+
+void VPartitionManager::UndoRangeLocked(VPartition* vp, size_t vslice_start, size_t count) {
+    for (size_t i = count; i-- > 0;) {
+        auto vslice = vslice_start + i;
+        GetSliceEntryLocked(vp->SliceGetLocked(vslice))->vpart = PSLICE_UNALLOCATED;
+        vp->SliceFreeLocked(vslice);
+    }
+}
+
 zx_status_t VPartitionManager::Upgrade(const uint8_t* old_guid, const uint8_t* new_guid) {
     fbl::AutoLock lock(&lock_);
     size_t old_index = 0;
@@ -838,6 +906,21 @@ zx_status_t VPartition::DdkIoctl(uint32_t op, const void* cmd, size_t cmdlen,
         }
         return mgr_->AllocateSlices(this, request->offset, request->length);
     }
+    case IOCTL_BLOCK_FVM_EXTEND_BATCH: {
+        if (cmdlen < sizeof(extend_batch_request_t))
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        const extend_batch_request_t* request = static_cast<const extend_batch_request_t*>(cmd);
+        if (request->count > MAX_FVM_EXTEND_REQUESTS) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        for (size_t i = 0; i < request->count; i++) {
+            zx_status_t status;
+            if ((status = RequestBoundCheck(&request->extents[i], mgr_->VSliceMax())) != ZX_OK) {
+                return status;
+            }
+        }
+        return mgr_->AllocateSliceRanges(this, request->extents, request->count);
+    }
     case IOCTL_BLOCK_FVM_SHRINK: {
         if (cmdlen < sizeof(extend_request_t))
             return ZX_ERR_BUFFER_TOO_SMALL;
@@ -79,6 +79,25 @@ static_assert(sizeof(nvme_cpl_t) == (1 << NVME_CPL_SHIFT), "");
 #define NVME_CPL_STATUS_CODE(n) (((n) >> 1) & 0x7FF)
 
 
+// Scatter Gather List Descriptor
+typedef struct {
+    uint64_t address;
+    uint32_t length;
+    uint8_t reserved[3];
+    uint8_t type;
+} nvme_sgl_desc_t;
+
+#define NVME_SGL_DESC_SIZE 16
+static_assert(sizeof(nvme_sgl_desc_t) == NVME_SGL_DESC_SIZE, "");
+
+#define NVME_SGL_TYPE_DATA_BLOCK   (0x0 << 4)
+#define NVME_SGL_TYPE_BIT_BUCKET   (0x1 << 4)
+#define NVME_SGL_TYPE_SEGMENT      (0x2 << 4) // points at a list of descriptors
+#define NVME_SGL_TYPE_LAST_SEGMENT (0x3 << 4) // ... which has no segment descriptor
+
+#define NVME_SGLS_SUPPORT(n)       ((n) & 3) // 0: none, 1: any alignment, 2: dword aligned
+
+
 // Submission Queue Entry
 typedef struct {
     uint32_t cmd;
@@ -87,6 +106,7 @@ typedef struct {
     uint64_t mptr;
     union {
         uint64_t prp[2];
+        nvme_sgl_desc_t sgl;
     } dptr;
     union {
         uint32_t raw[6];
@@ -4,9 +4,11 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include <threads.h>
 
 #include <ddk/binding.h>
@@ -23,6 +25,7 @@
 #include <sync/completion.h>
 
 #include <zircon/device/block.h>
+#include <zircon/device/nvme.h>
 #include <zircon/syscalls.h>
 #include <zircon/types.h>
 #include <zircon/listnode.h>
@@ -31,29 +34,39 @@
 
 // If enabled, gather stats on concurrent io ops,
 // pending txns, etc.  Stats are retrieved by
-// IOCTL_BLOCK_GET_STATS
+// IOCTL_BLOCK_GET_STATS and IOCTL_NVME_GET_QUEUE_STATS
 #define WITH_STATS 1
 
 #define TXN_FLAG_FAILED 1
 
-typedef struct {
+typedef struct nvme_txn {
     block_op_t op;
     list_node_t node;
+    struct nvme_txn* next;  // link on the submitted stack of its queue
+    zx_time_t queued;       // when nvme_queue() took it
     uint16_t pending_utxns;
     uint8_t opcode;
     uint8_t flags;
 } nvme_txn_t;
 
 typedef struct {
-    zx_paddr_t phys;    // io buffer phys base (1 page)
-    void* virt;         // io buffer virt base
     nvme_txn_t* txn;    // related txn
     uint16_t id;
-    uint16_t reserved0;
-    uint32_t reserved1;
+    int16_t list;       // scatter list page in use, or -1 if none
+    uint32_t reserved;
 } nvme_utxn_t;
 
-#define UTXN_COUNT 63
+// Deepest io queues we create, in entries.  The controller may allow
+// fewer (CAP.MQES).  Both queues of a pair have the same power of two depth.
+#define IOQ_MAX_ENTRIES 256
+
+// One utxn fewer than queue entries, so a full pool never overfills the queue.
+#define UTXN_MAX (IOQ_MAX_ENTRIES - 1)
+#define UTXN_WORDS ((UTXN_MAX + 63) / 64)
+
+// Scatter list pages per io queue.  Commands whose data can be described
+// inline in the command do not need one, so they are not tied to the utxns.
+#define LIST_COUNT 64
 
 // There's no system constant for this.  Ensure it matches reality.
 #define PAGE_SHIFT 12
@@ -61,50 +74,77 @@ static_assert(PAGE_SIZE == (1 << PAGE_SHIFT), "");
 
 #define PAGE_MASK (PAGE_SIZE - 1)
 
-// Limit maximum transfer size to 1MB which fits comfortably
-// within our single scatter gather page per utxn setup
-#define MAX_XFER (1024*1024)
+// Limit maximum transfer size to 2MB, as a single PRP list page can
+// address every page after the first of such a transfer
+#define MAX_XFER (2*1024*1024)
+
+// Most pages a transfer can touch, one more than it spans if it is not
+// page aligned, and the pages it takes to look up their addresses
+#define XFER_PAGES_MAX (MAX_XFER / PAGE_SIZE + 1)
+#define LOOKUP_PAGE_COUNT ((XFER_PAGES_MAX * sizeof(zx_paddr_t) + PAGE_MASK) / PAGE_SIZE)
 
 // Maximum submission and completion queue item counts, for
-// queues that are a single page in size.
+// the admin queues, which are a single page in size.
 #define SQMAX (PAGE_SIZE / sizeof(nvme_cmd_t))
 #define CQMAX (PAGE_SIZE / sizeof(nvme_cpl_t))
 
+// Most data block descriptors a scatter list page holds
+#define SGL_MAX (PAGE_SIZE / sizeof(nvme_sgl_desc_t))
+
+// Most IO queue pairs we set up, and the most interrupt vectors we ask for.
+// We ask for one queue pair per cpu up to this, and get fewer if the controller
+// or the interrupt controller cannot provide that many.
+#define MAX_IO_QUEUES 16
+
 // global driver state bits
-#define FLAG_IRQ_THREAD_STARTED  0x0001
-#define FLAG_IO_THREAD_STARTED   0x0002
 #define FLAG_SHUTDOWN            0x0004
 
 #define FLAG_HAS_VWC             0x0100
+#define FLAG_HAS_SGL             0x0200
 
-typedef struct {
-    void* io;
-    zx_handle_t irqh;
-    uint32_t flags;
-    mtx_t lock;
-
-    // io queue doorbell registers
-    void* io_sq_tail_db;
-    void* io_cq_head_db;
-
-    nvme_cpl_t* io_cq;
-    nvme_cmd_t* io_sq;
-    uint32_t io_nsid;
-    uint16_t io_cq_head;
-    uint16_t io_cq_toggle;
-    uint16_t io_sq_tail;
-    uint16_t io_sq_head;
-
-    uint64_t utxn_avail;   // bitmask of available utxns
+typedef struct nvme_device nvme_device_t;
 
-    // The pending list is txns that have been received
-    // via nvme_queue() and are waiting for io to start.
+// An IO submission queue and the completion queue it posts to, with the io
+// thread that services them.
+typedef struct {
+    nvme_device_t* nvme;
+    uint16_t id;        // NVMe queue id, both queues of the pair use the same one
+    uint16_t vector;    // interrupt vector of the completion queue
+    uint16_t entries;   // depth of both queues
+    uint16_t utxn_count;
+
+    // doorbell registers
+    void* sq_tail_db;
+    void* cq_head_db;
+
+    nvme_cpl_t* cq;
+    nvme_cmd_t* sq;
+    uint16_t cq_head;
+    uint16_t cq_toggle;
+    uint16_t sq_tail;
+    uint16_t sq_head;
+
+    uint64_t utxn_avail[UTXN_WORDS];   // bitmask of available utxns
+    uint64_t list_avail;               // bitmask of available scatter list pages
+
+    // the page addresses of the data of the command being built
+    zx_paddr_t* lookup;
+
+    // Txns handed to nvme_queue() are pushed onto this stack without taking
+    // any lock, the io thread takes the whole stack at once and moves it onto
+    // the pending list in the order the txns came in.
+    _Atomic(nvme_txn_t*) submitted;
+
+    // The pending list is txns taken from the submitted stack
+    // that are waiting for io to start.
     // The exception is the head of the pending list which may
     // be partially started, waiting for more utxns to become
     // available.
     // The active list consists of txns where all utxns have
     // been created and we're waiting for them to complete or
     // error out.
+    // Both are only touched by the io thread, and by release
+    // once it has stopped.
     list_node_t pending_txns;      // inbound txns to process
     list_node_t active_txns;       // txns in flight
 
@@ -113,6 +153,55 @@ typedef struct {
     // it has work to do.
     completion_t io_signal;
 
+    thrd_t iothread;
+    bool iothread_started;
+
+    // physically contiguous pages for the queues
+    io_buffer_t ring_iob;
+
+    // pages for the page lookups and the scatter lists
+    io_buffer_t iob;
+    zx_paddr_t list_phys[LIST_COUNT];
+    void* list_virt[LIST_COUNT];
+
+#if WITH_STATS
+    // guards the stats, which the io thread updates and the ioctls read
+    mtx_t stat_lock;
+    size_t stat_concur;
+    size_t stat_pending;
+    size_t stat_max_concur;
+    size_t stat_max_pending;
+    size_t stat_total_ops;
+    size_t stat_total_blocks;
+    uint64_t stat_total_latency;
+    uint64_t stat_max_latency;
+#endif
+
+    // pool of utxns, utxn_count of which are used
+    nvme_utxn_t utxn[UTXN_MAX];
+} nvme_queue_t;
+
+// An interrupt vector and the thread waiting on it.
+typedef struct {
+    nvme_device_t* nvme;
+    zx_handle_t irqh;
+    uint32_t vector;
+    thrd_t thread;
+    bool started;
+} nvme_irq_t;
+
+struct nvme_device {
+    void* io;
+    uint32_t flags;
+
+    nvme_irq_t irq[MAX_IO_QUEUES];
+    uint32_t irq_count;
+
+    // io queue pairs, ioq[n] has queue id n + 1
+    nvme_queue_t* ioq;
+    uint32_t ioq_count;
+
+    uint32_t io_nsid;
     uint32_t max_xfer;
     block_info_t info;
 
@@ -140,40 +229,29 @@ typedef struct {
     size_t iosz;
     zx_handle_t ioh;
 
-    // source of physical pages for queues and admin commands
+    // source of physical pages for the admin queues and admin commands
     io_buffer_t iob;
-
-    thrd_t irqthread;
-    thrd_t iothread;
-
-#if WITH_STATS
-    size_t stat_concur;
-    size_t stat_pending;
-    size_t stat_max_concur;
-    size_t stat_max_pending;
-    size_t stat_total_ops;
-    size_t stat_total_blocks;
-#endif
-
-    // pool of utxns
-    nvme_utxn_t utxn[UTXN_COUNT];
-} nvme_device_t;
+};
 
 #if WITH_STATS
-#define STAT_INC(name) do { nvme->stat_##name++; } while (0)
-#define STAT_DEC(name) do { nvme->stat_##name--; } while (0)
-#define STAT_DEC_IF(name, c) do { if (c) nvme->stat_##name--; } while (0)
-#define STAT_ADD(name, num) do { nvme->stat_##name += num; } while (0)
+#define STAT_INC(name) do { q->stat_##name++; } while (0)
+#define STAT_DEC(name) do { q->stat_##name--; } while (0)
+#define STAT_DEC_IF(name, c) do { if (c) q->stat_##name--; } while (0)
+#define STAT_ADD(name, num) do { q->stat_##name += num; } while (0)
 #define STAT_INC_MAX(name) do { \
-    if (++nvme->stat_##name > nvme->stat_max_##name) { \
-        nvme->stat_max_##name = nvme->stat_##name; \
+    if (++q->stat_##name > q->stat_max_##name) { \
+        q->stat_max_##name = q->stat_##name; \
     }} while (0)
+#define STAT_LOCK() mtx_lock(&q->stat_lock)
+#define STAT_UNLOCK() mtx_unlock(&q->stat_lock)
 #else
 #define STAT_INC(name) do { } while (0)
 #define STAT_DEC(name) do { } while (0)
 #define STAT_DEC_IF(name, c) do { } while (0)
 #define STAT_ADD(name, num) do { } while (0)
 #define STAT_INC_MAX(name) do { } while (0)
+#define STAT_LOCK() do { } while (0)
+#define STAT_UNLOCK() do { } while (0)
 #endif
 
 
@@ -183,28 +261,55 @@ typedef struct {
 // queued to the NVME device.  This id is the same as its index into the
 // pool of utxns and the bitmask of free txns, to simplify management.
 //
-// We maintain a pool of 63 of these, which is the number of commands
-// that can be submitted to NVME via a single page submit queue.
+// Every io queue has a pool of one fewer of these than its submit queue
+// has entries, up to 255.
+//
+// A command whose data pointers do not fit in the command itself also
+// takes one of the queue's scatter list pages, for its PRP list or its SGL,
+// and gives it back along with its utxn.
 //
 // The utxns are not protected by locks.  Instead, after initialization,
-// they may only be touched by the io thread, which is responsible for
-// queueing commands and dequeuing completion messages.
+// they may only be touched by the io thread of their queue, which is
+// responsible for queueing commands and dequeuing completion messages.
 
-static nvme_utxn_t* utxn_get(nvme_device_t* nvme) {
-    uint64_t n = __builtin_ffsll(nvme->utxn_avail);
-    if (n == 0) {
-        return NULL;
-    }
-    n--;
-    nvme->utxn_avail &= ~(1ULL << n);
-    STAT_INC_MAX(concur);
-    return nvme->utxn + n;
+static nvme_utxn_t* utxn_get(nvme_queue_t* q) {
+    for (unsigned w = 0; w < UTXN_WORDS; w++) {
+        uint64_t n = __builtin_ffsll(q->utxn_avail[w]);
+        if (n == 0) {
+            continue;
+        }
+        n--;
+        q->utxn_avail[w] &= ~(1ULL << n);
+        STAT_LOCK();
+        STAT_INC_MAX(concur);
+        STAT_UNLOCK();
+        return q->utxn + w * 64 + n;
+    }
+    return NULL;
 }
 
-static void utxn_put(nvme_device_t* nvme, nvme_utxn_t* utxn) {
+static void utxn_put(nvme_queue_t* q, nvme_utxn_t* utxn) {
     uint64_t n = utxn->id;
+    if (utxn->list >= 0) {
+        q->list_avail |= (1ULL << utxn->list);
+        utxn->list = -1;
+    }
+    STAT_LOCK();
     STAT_DEC(concur);
-    nvme->utxn_avail |= (1ULL << n);
+    STAT_UNLOCK();
+    q->utxn_avail[n / 64] |= (1ULL << (n % 64));
+}
+
+// Give |utxn| a scatter list page, returning false if none is available.
+static bool utxn_get_list(nvme_queue_t* q, nvme_utxn_t* utxn) {
+    int n = __builtin_ffsll(q->list_avail);
+    if (n == 0) {
+        return false;
+    }
+    n--;
+    q->list_avail &= ~(1ULL << n);
+    utxn->list = n;
+    return true;
 }
 
 static zx_status_t nvme_admin_cq_get(nvme_device_t* nvme, nvme_cpl_t* cpl) {
@@ -243,61 +348,69 @@ static zx_status_t nvme_admin_sq_put(nvme_device_t* nvme, nvme_cmd_t* cmd) {
     return ZX_OK;
 }
 
-static zx_status_t nvme_io_cq_get(nvme_device_t* nvme, nvme_cpl_t* cpl) {
-    if ((readw(&nvme->io_cq[nvme->io_cq_head].status) & 1) != nvme->io_cq_toggle) {
+static zx_status_t nvme_io_cq_get(nvme_queue_t* q, nvme_cpl_t* cpl) {
+    if ((readw(&q->cq[q->cq_head].status) & 1) != q->cq_toggle) {
         return ZX_ERR_SHOULD_WAIT;
     }
-    *cpl = nvme->io_cq[nvme->io_cq_head];
+    *cpl = q->cq[q->cq_head];
 
     // advance the head pointer, wrapping and inverting toggle at max
-    uint16_t next = (nvme->io_cq_head + 1) & (CQMAX - 1);
-    if ((nvme->io_cq_head = next) == 0) {
-        nvme->io_cq_toggle ^= 1;
+    uint16_t next = (q->cq_head + 1) & (q->entries - 1);
+    if ((q->cq_head = next) == 0) {
+        q->cq_toggle ^= 1;
     }
 
     // note the new sq head reported by hw
-    nvme->io_sq_head = cpl->sq_head;
+    q->sq_head = cpl->sq_head;
     return ZX_OK;
 }
 
-static void nvme_io_cq_ack(nvme_device_t* nvme) {
+static void nvme_io_cq_ack(nvme_queue_t* q) {
     // ring the doorbell
-    writel(nvme->io_cq_head, nvme->io_cq_head_db);
+    writel(q->cq_head, q->cq_head_db);
 }
 
-static zx_status_t nvme_io_sq_put(nvme_device_t* nvme, nvme_cmd_t* cmd) {
-    uint16_t next = (nvme->io_sq_tail + 1) & (SQMAX - 1);
+static zx_status_t nvme_io_sq_put(nvme_queue_t* q, nvme_cmd_t* cmd) {
+    uint16_t next = (q->sq_tail + 1) & (q->entries - 1);
 
     // if head+1 == tail: queue is full
-    if (next == nvme->io_sq_head) {
+    if (next == q->sq_head) {
         return ZX_ERR_SHOULD_WAIT;
     }
 
-    nvme->io_sq[nvme->io_sq_tail] = *cmd;
-    nvme->io_sq_tail = next;
+    q->sq[q->sq_tail] = *cmd;
+    q->sq_tail = next;
 
     // ring the doorbell
-    writel(next, nvme->io_sq_tail_db);
+    writel(next, q->sq_tail_db);
     return ZX_OK;
 }
 
 static int irq_thread(void* arg) {
-    nvme_device_t* nvme = arg;
+    nvme_irq_t* irq = arg;
+    nvme_device_t* nvme = irq->nvme;
     for (;;) {
         zx_status_t r;
         uint64_t slots;
-        if ((r = zx_interrupt_wait(nvme->irqh, &slots)) != ZX_OK) {
-            zxlogf(ERROR, "nvme: irq wait failed: %d\n", r);
+        if ((r = zx_interrupt_wait(irq->irqh, &slots)) != ZX_OK) {
+            if (!(nvme->flags & FLAG_SHUTDOWN)) {
+                zxlogf(ERROR, "nvme: irq %u wait failed: %d\n", irq->vector, r);
+            }
             break;
         }
 
-        nvme_cpl_t cpl;
-        if (nvme_admin_cq_get(nvme, &cpl) == ZX_OK) {
-            nvme->admin_result = cpl;
-            completion_signal(&nvme->admin_signal);
+        // the admin completion queue shares vector 0 with the first io queue
+        if (irq->vector == 0) {
+            nvme_cpl_t cpl;
+            if (nvme_admin_cq_get(nvme, &cpl) == ZX_OK) {
+                nvme->admin_result = cpl;
+                completion_signal(&nvme->admin_signal);
+            }
         }
 
-        completion_signal(&nvme->io_signal);
+        for (uint32_t n = irq->vector; n < nvme->ioq_count; n += nvme->irq_count) {
+            completion_signal(&nvme->ioq[n].io_signal);
+        }
     }
     return 0;
 }
@@ -331,10 +444,95 @@ static inline void txn_complete(nvme_txn_t* txn, zx_status_t status) {
     txn->op.completion_cb(&txn->op, status);
 }
 
+// Describe |bytes| of data starting |offset| bytes into the first of
+// |pagecount| pages with a PRP: the first page, and the second page or a
+// PRP list of the rest in a scatter list page.
+static zx_status_t io_build_prp(nvme_queue_t* q, nvme_utxn_t* utxn, nvme_cmd_t* cmd,
+                                const zx_paddr_t* pages, size_t pagecount, size_t offset) {
+    // The NVME command has room for two data pointers inline.
+    // The first is always the pointer to the first page where data is.
+    // The second is the second page if pagecount is 2.
+    // The second is the address of an array of page 2..n if pagecount > 2
+    cmd->cmd |= NVME_CMD_PRP;
+    cmd->dptr.prp[0] = pages[0] | offset;
+    if (pagecount == 2) {
+        cmd->dptr.prp[1] = pages[1];
+    } else if (pagecount > 2) {
+        if (!utxn_get_list(q, utxn)) {
+            return ZX_ERR_SHOULD_WAIT;
+        }
+        memcpy(q->list_virt[utxn->list], pages + 1, (pagecount - 1) * sizeof(zx_paddr_t));
+        cmd->dptr.prp[1] = q->list_phys[utxn->list];
+    }
+    return ZX_OK;
+}
+
+// Merge the pages of the data into physically contiguous runs, storing a
+// data block descriptor for each in |sgl| if it is not NULL, and return
+// the number of runs.
+static size_t sgl_runs(const zx_paddr_t* pages, size_t pagecount, size_t offset, size_t bytes,
+                       nvme_sgl_desc_t* sgl) {
+    size_t runs = 0;
+    zx_paddr_t end = 0;
+    for (size_t i = 0; i < pagecount; i++) {
+        zx_paddr_t addr = pages[i] + offset;
+        size_t len = MIN(PAGE_SIZE - offset, bytes);
+        if ((runs > 0) && (addr == end)) {
+            if (sgl != NULL) {
+                sgl[runs - 1].length += len;
+            }
+        } else {
+            if (sgl != NULL) {
+                sgl[runs] = (nvme_sgl_desc_t) {
+                    .address = addr,
+                    .length = len,
+                    .type = NVME_SGL_TYPE_DATA_BLOCK,
+                };
+            }
+            runs++;
+        }
+        end = addr + len;
+        bytes -= len;
+        offset = 0;
+    }
+    return runs;
+}
+
+// Describe the data with an SGL: a single data block descriptor in the
+// command if the pages are physically contiguous, or else one descriptor
+// per contiguous run in a scatter list page.  Fails with NOT_SUPPORTED if
+// that takes more descriptors than the page holds, a PRP works then.
+static zx_status_t io_build_sgl(nvme_queue_t* q, nvme_utxn_t* utxn, nvme_cmd_t* cmd,
+                                const zx_paddr_t* pages, size_t pagecount, size_t offset,
+                                size_t bytes) {
+    size_t runs = sgl_runs(pages, pagecount, offset, bytes, NULL);
+    if (runs > SGL_MAX) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    cmd->cmd |= NVME_CMD_SGL;
+    if (runs == 1) {
+        cmd->dptr.sgl.address = pages[0] + offset;
+        cmd->dptr.sgl.length = bytes;
+        cmd->dptr.sgl.type = NVME_SGL_TYPE_DATA_BLOCK;
+        return ZX_OK;
+    }
+
+    if (!utxn_get_list(q, utxn)) {
+        return ZX_ERR_SHOULD_WAIT;
+    }
+    sgl_runs(pages, pagecount, offset, bytes, q->list_virt[utxn->list]);
+    cmd->dptr.sgl.address = q->list_phys[utxn->list];
+    cmd->dptr.sgl.length = runs * sizeof(nvme_sgl_desc_t);
+    cmd->dptr.sgl.type = NVME_SGL_TYPE_LAST_SEGMENT;
+    return ZX_OK;
+}
+
 // Attempt to generate utxns and queue nvme commands for a txn
 // Returns true if this could not be completed due to temporary
 // lack of resources or false if either it succeeded or errored out.
-static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
+static bool io_process_txn(nvme_queue_t* q, nvme_txn_t* txn) {
+    nvme_device_t* nvme = q->nvme;
     zx_handle_t vmo = txn->op.rw.vmo;
     nvme_utxn_t* utxn;
     zx_status_t r;
@@ -342,7 +540,7 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
     for (;;) {
         // If there are no available utxns, we can't proceed
         // and we tell the caller to retain the txn (true)
-        if ((utxn = utxn_get(nvme)) == NULL) {
+        if ((utxn = utxn_get(q)) == NULL) {
             return true;
         }
 
@@ -359,41 +557,50 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
             break;
         }
 
-        zx_paddr_t* pages = utxn->virt;
+        // The data pointers are built straight from the client's pages,
+        // the data itself is never copied.
+        zx_paddr_t* pages = q->lookup;
         if ((r = zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP,
-                                 txn->op.rw.offset_vmo, bytes, pages, PAGE_SIZE)) != ZX_OK) {
+                                 txn->op.rw.offset_vmo, bytes, pages,
+                                 LOOKUP_PAGE_COUNT * PAGE_SIZE)) != ZX_OK) {
             zxlogf(ERROR, "nvme: could not lookup pages\n");
             break;
         }
 
         // Take the starting byte into the initial page plus total bytes
         // transferred, convert to page count (rounded up)
-        size_t pagecount = ((txn->op.rw.offset_vmo & PAGE_MASK) + bytes + PAGE_MASK) / PAGE_SIZE;
+        size_t offset = txn->op.rw.offset_vmo & PAGE_MASK;
+        size_t pagecount = (offset + bytes + PAGE_MASK) / PAGE_SIZE;
 
         nvme_cmd_t cmd;
         memset(&cmd, 0, sizeof(cmd));
-        cmd.cmd = NVME_CMD_CID(utxn->id) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(txn->opcode);
+        cmd.cmd = NVME_CMD_CID(utxn->id) | NVME_CMD_NORMAL | NVME_CMD_OPC(txn->opcode);
         cmd.nsid = 1;
         cmd.u.rw.start_lba = txn->op.rw.offset_dev;
         cmd.u.rw.block_count = blocks - 1;
-        // The NVME command has room for two data pointers inline.
-        // The first is always the pointer to the first page where data is.
-        // The second is the second page if pagecount is 2.
-        // The second is the address of an array of page 2..n if pagecount > 2
-        cmd.dptr.prp[0] = pages[0] | (txn->op.rw.offset_vmo & PAGE_MASK);
-        if (pagecount == 2) {
-            cmd.dptr.prp[1] = pages[1];
-        } else if (pagecount > 2) {
-            cmd.dptr.prp[1] = utxn->phys + sizeof(uint64_t);
+
+        r = ZX_ERR_NOT_SUPPORTED;
+        if (nvme->flags & FLAG_HAS_SGL) {
+            r = io_build_sgl(q, utxn, &cmd, pages, pagecount, offset, bytes);
+        }
+        if (r == ZX_ERR_NOT_SUPPORTED) {
+            r = io_build_prp(q, utxn, &cmd, pages, pagecount, offset);
+        }
+        if (r == ZX_ERR_SHOULD_WAIT) {
+            // no scatter list page until more commands complete,
+            // retain the txn (true) like when out of utxns
+            utxn_put(q, utxn);
+            return true;
         }
 
-        zxlogf(TRACE, "nvme: txn=%p utxn id=%u pages=%zu op=%s\n", txn, utxn->id, pagecount,
-               txn->opcode == NVME_OP_WRITE ? "WR" : "RD");
-        zxlogf(SPEW, "nvme: prp[0]=%016zx prp[1]=%016zx\n", cmd.dptr.prp[0], cmd.dptr.prp[1]);
+        zxlogf(TRACE, "nvme: q%u txn=%p utxn id=%u pages=%zu op=%s\n", q->id, txn, utxn->id,
+               pagecount, txn->opcode == NVME_OP_WRITE ? "WR" : "RD");
+        zxlogf(SPEW, "nvme: %s dptr=%016zx %016zx\n",
+               (cmd.cmd & NVME_CMD_SGL) ? "sgl" : "prp", cmd.dptr.prp[0], cmd.dptr.prp[1]);
         zxlogf(SPEW, "nvme: pages[] = { %016zx, %016zx, %016zx, %016zx, ... }\n",
                pages[0], pages[1], pages[2], pages[3]);
 
-        if ((r = nvme_io_sq_put(nvme, &cmd)) != ZX_OK) {
+        if ((r = nvme_io_sq_put(q, &cmd)) != ZX_OK) {
             zxlogf(ERROR, "nvme: could not submit cmd (txn=%p id=%u)\n", txn, utxn->id);
             break;
         }
@@ -410,25 +617,21 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
         // move this txn to the active list and tell the
         // caller not to retain the txn (false)
         if (txn->op.rw.length == 0) {
-            mtx_lock(&nvme->lock);
-            list_add_tail(&nvme->active_txns, &txn->node);
-            mtx_unlock(&nvme->lock);
+            list_add_tail(&q->active_txns, &txn->node);
             return false;
         }
     }
 
     // failure
-    utxn_put(nvme, utxn);
+    utxn_put(q, utxn);
 
-    mtx_lock(&nvme->lock);
     txn->flags |= TXN_FLAG_FAILED;
     if (txn->pending_utxns) {
         // if there are earlier uncompleted IOs we become active now
         // and will finish erroring out when they complete
-        list_add_tail(&nvme->active_txns, &txn->node);
+        list_add_tail(&q->active_txns, &txn->node);
         txn = NULL;
     }
-    mtx_unlock(&nvme->lock);
 
     if (txn != NULL) {
         txn_complete(txn, ZX_ERR_INTERNAL);
@@ -438,46 +641,63 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
     return false;
 }
 
-static void io_process_txns(nvme_device_t* nvme) {
+// Move everything nvme_queue() pushed since the last call onto the pending list.
+static void io_take_submitted(nvme_queue_t* q) {
+    nvme_txn_t* txn = atomic_exchange_explicit(&q->submitted, NULL, memory_order_acquire);
+
+    // the stack is newest first, splice it in oldest first
+    list_node_t* tail = q->pending_txns.prev;
+    STAT_LOCK();
+    for (; txn != NULL; txn = txn->next) {
+        list_add_after(tail, &txn->node);
+        STAT_INC(total_ops);
+        STAT_ADD(total_blocks, txn->op.rw.length);
+        STAT_INC_MAX(pending);
+    }
+    STAT_UNLOCK();
+}
+
+static void io_process_txns(nvme_queue_t* q) {
     nvme_txn_t* txn;
 
-    for (;;) {
-        mtx_lock(&nvme->lock);
-        txn = list_remove_head_type(&nvme->pending_txns, nvme_txn_t, node);
-        STAT_DEC_IF(pending, txn != NULL);
-        mtx_unlock(&nvme->lock);
+    io_take_submitted(q);
 
+    for (;;) {
+        txn = list_remove_head_type(&q->pending_txns, nvme_txn_t, node);
         if (txn == NULL) {
             return;
         }
+        STAT_LOCK();
+        STAT_DEC(pending);
+        STAT_UNLOCK();
 
-        if (io_process_txn(nvme, txn)) {
+        if (io_process_txn(q, txn)) {
             // put txn back at front of queue for further processing later
-            mtx_lock(&nvme->lock);
-            list_add_head(&nvme->pending_txns, &txn->node);
-            STAT_INC_MAX(pending);
-            mtx_unlock(&nvme->lock);
+            list_add_head(&q->pending_txns, &txn->node);
+            STAT_LOCK();
+            STAT_INC(pending);
+            STAT_UNLOCK();
             return;
         }
     }
 }
 
-static void io_process_cpls(nvme_device_t* nvme) {
+static void io_process_cpls(nvme_queue_t* q) {
     bool ring_doorbell = false;
     nvme_cpl_t cpl;
 
-    while (nvme_io_cq_get(nvme, &cpl) == ZX_OK) {
+    while (nvme_io_cq_get(q, &cpl) == ZX_OK) {
         ring_doorbell = true;
 
-        if (cpl.cmd_id >= UTXN_COUNT) {
-            zxlogf(ERROR, "nvme: unexpected cmd id %u\n", cpl.cmd_id);
+        if (cpl.cmd_id >= q->utxn_count) {
+            zxlogf(ERROR, "nvme: q%u unexpected cmd id %u\n", q->id, cpl.cmd_id);
             continue;
         }
-        nvme_utxn_t* utxn = nvme->utxn + cpl.cmd_id;
+        nvme_utxn_t* utxn = q->utxn + cpl.cmd_id;
         nvme_txn_t* txn = utxn->txn;
 
         if (txn == NULL) {
-            zxlogf(ERROR, "nvme: inactive utxn #%u completed?!\n", cpl.cmd_id);
+            zxlogf(ERROR, "nvme: q%u inactive utxn #%u completed?!\n", q->id, cpl.cmd_id);
             continue;
         }
 
@@ -495,48 +715,67 @@ static void io_process_cpls(nvme_device_t* nvme) {
 
         // release the microtransaction
         utxn->txn = NULL;
-        utxn_put(nvme, utxn);
+        utxn_put(q, utxn);
 
         txn->pending_utxns--;
         if ((txn->pending_utxns == 0) && (txn->op.rw.length == 0)) {
             // remove from either pending or active list
-            mtx_lock(&nvme->lock);
             list_delete(&txn->node);
-            mtx_unlock(&nvme->lock);
+#if WITH_STATS
+            uint64_t latency = zx_clock_get(ZX_CLOCK_MONOTONIC) - txn->queued;
+            STAT_LOCK();
+            STAT_ADD(total_latency, latency);
+            if (latency > q->stat_max_latency) {
+                q->stat_max_latency = latency;
+            }
+            STAT_UNLOCK();
+#endif
             zxlogf(TRACE, "nvme: txn %p %s\n", txn, txn->flags & TXN_FLAG_FAILED ? "error" : "okay");
             txn_complete(txn, txn->flags & TXN_FLAG_FAILED ? ZX_ERR_IO : ZX_OK);
         }
     }
 
     if (ring_doorbell) {
-        nvme_io_cq_ack(nvme);
+        nvme_io_cq_ack(q);
     }
 }
 
 static int io_thread(void* arg) {
-    nvme_device_t* nvme = arg;
+    nvme_queue_t* q = arg;
     for (;;) {
-        if (completion_wait(&nvme->io_signal, ZX_TIME_INFINITE)) {
+        if (completion_wait(&q->io_signal, ZX_TIME_INFINITE)) {
             break;
         }
-        if (nvme->flags & FLAG_SHUTDOWN) {
+        if (q->nvme->flags & FLAG_SHUTDOWN) {
             //TODO: cancel out pending IO
-            zxlogf(INFO, "nvme: io thread exiting\n");
+            zxlogf(INFO, "nvme: q%u io thread exiting\n", q->id);
             break;
         }
 
-        completion_reset(&nvme->io_signal);
+        completion_reset(&q->io_signal);
 
         // process completion messages
-        io_process_cpls(nvme);
+        io_process_cpls(q);
 
         // process work queue
-        io_process_txns(nvme);
+        io_process_txns(q);
 
     }
     return 0;
 }
 
+// Clients are spread over the io queues, each thread that queues txns
+// sticks to the queue it was given the first time.
+static atomic_uint next_queue_slot;
+static _Thread_local unsigned queue_slot;
+
+static nvme_queue_t* nvme_pick_queue(nvme_device_t* nvme) {
+    if (queue_slot == 0) {
+        queue_slot = atomic_fetch_add_explicit(&next_queue_slot, 1, memory_order_relaxed) + 1;
+    }
+    return nvme->ioq + (queue_slot - 1) % nvme->ioq_count;
+}
+
 static void nvme_queue(void* ctx, block_op_t* op) {
     nvme_device_t* nvme = ctx;
     nvme_txn_t* txn = containerof(op, nvme_txn_t, op);
@@ -573,20 +812,28 @@ static void nvme_queue(void* ctx, block_op_t* op) {
 
     txn->pending_utxns = 0;
     txn->flags = 0;
+#if WITH_STATS
+    txn->queued = zx_clock_get(ZX_CLOCK_MONOTONIC);
+#endif
 
     zxlogf(SPEW, "nvme: io: %s: %ublks @ blk#%zu\n",
            txn->opcode == NVME_OP_WRITE ? "wr" : "rd",
            txn->op.rw.length + 1U, txn->op.rw.offset_dev);
 
-    STAT_INC(total_ops);
-    STAT_ADD(total_blocks, txn->op.rw.length);
-
-    mtx_lock(&nvme->lock);
-    list_add_tail(&nvme->pending_txns, &txn->node);
-    STAT_INC_MAX(pending);
-    mtx_unlock(&nvme->lock);
+    nvme_queue_t* q = nvme_pick_queue(nvme);
 
-    completion_signal(&nvme->io_signal);
+    // Only the first txn pushed onto an empty stack needs to wake the io
+    // thread, it takes the stack after it has reset the signal, so any txn
+    // pushed later is either taken along or finds the stack empty again.
+    nvme_txn_t* head = atomic_load_explicit(&q->submitted, memory_order_relaxed);
+    do {
+        txn->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&q->submitted, &head, txn,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+    if (head == NULL) {
+        completion_signal(&q->io_signal);
+    }
 }
 
 static void nvme_query(void* ctx, block_info_t* info_out, size_t* block_op_size_out) {
@@ -595,6 +842,31 @@ static void nvme_query(void* ctx, block_info_t* info_out, size_t* block_op_size_
     *block_op_size_out = sizeof(nvme_txn_t);
 }
 
+#if WITH_STATS
+static void nvme_get_queue_stats(nvme_queue_t* q, nvme_queue_stats_t* out, bool clear) {
+    mtx_lock(&q->stat_lock);
+    out->qid = q->id;
+    out->vector = q->vector;
+    out->depth = q->utxn_count;
+    out->inflight = q->stat_concur;
+    out->max_inflight = q->stat_max_concur;
+    out->max_pending = q->stat_max_pending;
+    out->total_ops = q->stat_total_ops;
+    out->total_blocks = q->stat_total_blocks;
+    out->total_latency = q->stat_total_latency;
+    out->max_latency = q->stat_max_latency;
+    if (clear) {
+        q->stat_max_concur = 0;
+        q->stat_max_pending = 0;
+        q->stat_total_ops = 0;
+        q->stat_total_blocks = 0;
+        q->stat_total_latency = 0;
+        q->stat_max_latency = 0;
+    }
+    mtx_unlock(&q->stat_lock);
+}
+#endif
+
 static zx_status_t nvme_ioctl(void* ctx, uint32_t op, const void* cmd, size_t cmdlen, void* reply,
                               size_t max, size_t* out_actual) {
     nvme_device_t* nvme = ctx;
@@ -617,23 +889,42 @@ static zx_status_t nvme_ioctl(void* ctx, uint32_t op, const void* cmd, size_t cm
         if (max < sizeof(*out)) {
             return ZX_ERR_BUFFER_TOO_SMALL;
         }
-        mtx_lock(&nvme->lock);
-        out->max_concur = nvme->stat_max_concur;
-        out->max_pending = nvme->stat_max_pending;
-        out->total_ops = nvme->stat_total_ops;
-        out->total_blocks = nvme->stat_total_blocks;
+        // totals add up over the queues, the maxima are those of the
+        // busiest queue
         bool clear = *(bool *)cmd;
-        if (clear) {
-            nvme->stat_max_concur = 0;
-            nvme->stat_max_pending = 0;
-            nvme->stat_total_ops = 0;
-            nvme->stat_total_blocks = 0;
+        memset(out, 0, sizeof(*out));
+        for (uint32_t n = 0; n < nvme->ioq_count; n++) {
+            nvme_queue_stats_t qs;
+            nvme_get_queue_stats(&nvme->ioq[n], &qs, clear);
+            out->max_concur = MAX(out->max_concur, qs.max_inflight);
+            out->max_pending = MAX(out->max_pending, qs.max_pending);
+            out->total_ops += qs.total_ops;
+            out->total_blocks += qs.total_blocks;
         }
-        mtx_unlock(&nvme->lock);
         *out_actual = sizeof(*out);
         return ZX_OK;
 #else
         return ZX_ERR_NOT_SUPPORTED;
+#endif
+    }
+    case IOCTL_NVME_GET_QUEUE_STATS: {
+#if WITH_STATS
+        if (cmdlen != sizeof(bool)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (max < sizeof(nvme_queue_stats_t)) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        bool clear = *(bool *)cmd;
+        nvme_queue_stats_t* out = reply;
+        uint32_t count = MIN(nvme->ioq_count, max / sizeof(nvme_queue_stats_t));
+        for (uint32_t n = 0; n < count; n++) {
+            nvme_get_queue_stats(&nvme->ioq[n], &out[n], clear);
+        }
+        *out_actual = count * sizeof(nvme_queue_stats_t);
+        return ZX_OK;
+#else
+        return ZX_ERR_NOT_SUPPORTED;
 #endif
     }
     case IOCTL_BLOCK_RR_PART: {
@@ -672,26 +963,38 @@ static void nvme_release(void* ctx) {
         zx_handle_close(nvme->ioh);
         // TODO: risks a handle use-after-close, will be resolved by IRQ api
         // changes coming soon
-        zx_handle_close(nvme->irqh);
+        for (uint32_t n = 0; n < nvme->irq_count; n++) {
+            zx_handle_close(nvme->irq[n].irqh);
+        }
     }
-    if (nvme->flags & FLAG_IRQ_THREAD_STARTED) {
-        thrd_join(nvme->irqthread, &r);
+    for (uint32_t n = 0; n < nvme->irq_count; n++) {
+        if (nvme->irq[n].started) {
+            thrd_join(nvme->irq[n].thread, &r);
+        }
     }
-    if (nvme->flags & FLAG_IO_THREAD_STARTED) {
-        completion_signal(&nvme->io_signal);
-        thrd_join(nvme->iothread, &r);
+    for (uint32_t n = 0; n < nvme->ioq_count; n++) {
+        nvme_queue_t* q = &nvme->ioq[n];
+        if (q->iothread_started) {
+            completion_signal(&q->io_signal);
+            thrd_join(q->iothread, &r);
+        }
     }
 
     // error out any pending txns
-    mtx_lock(&nvme->lock);
-    nvme_txn_t* txn;
-    while ((txn = list_remove_head_type(&nvme->active_txns, nvme_txn_t, node)) != NULL) {
-        txn_complete(txn, ZX_ERR_PEER_CLOSED);
-    }
-    while ((txn = list_remove_head_type(&nvme->pending_txns, nvme_txn_t, node)) != NULL) {
-        txn_complete(txn, ZX_ERR_PEER_CLOSED);
+    for (uint32_t n = 0; n < nvme->ioq_count; n++) {
+        nvme_queue_t* q = &nvme->ioq[n];
+        io_take_submitted(q);
+        nvme_txn_t* txn;
+        while ((txn = list_remove_head_type(&q->active_txns, nvme_txn_t, node)) != NULL) {
+            txn_complete(txn, ZX_ERR_PEER_CLOSED);
+        }
+        while ((txn = list_remove_head_type(&q->pending_txns, nvme_txn_t, node)) != NULL) {
+            txn_complete(txn, ZX_ERR_PEER_CLOSED);
+        }
+        io_buffer_release(&q->ring_iob);
+        io_buffer_release(&q->iob);
     }
-    mtx_unlock(&nvme->lock);
+    free(nvme->ioq);
 
     io_buffer_release(&nvme->iob);
     free(nvme);
@@ -742,12 +1045,15 @@ static void infostring(const char* prefix, uint8_t* str, size_t len) {
 // dedicated pages from the page pool
 #define IDX_ADMIN_SQ   0
 #define IDX_ADMIN_CQ   1
-#define IDX_IO_SQ      2
-#define IDX_IO_CQ      3
-#define IDX_SCRATCH    4
-#define IDX_UTXN_POOL  5 // this must always be last
+#define IDX_SCRATCH    2
+
+#define IO_PAGE_COUNT  (IDX_SCRATCH + 1)
 
-#define IO_PAGE_COUNT  (IDX_UTXN_POOL + UTXN_COUNT)
+// dedicated pages from the page pool of each io queue
+#define IDX_LOOKUP     0
+#define IDX_LIST_POOL  (IDX_LOOKUP + LOOKUP_PAGE_COUNT) // this must always be last
+
+#define IOQ_PAGE_COUNT (IDX_LIST_POOL + LIST_COUNT)
 
 static inline uint64_t U64(uint8_t* x) {
     return *((uint64_t*) (void*) x);
@@ -761,6 +1067,103 @@ static inline uint32_t U16(uint8_t* x) {
 
 #define WAIT_MS 5000
 
+// Set up the io queue pair with queue id |n| + 1 on the controller, and start its io thread.
+static zx_status_t nvme_ioq_init(nvme_device_t* nvme, uint64_t cap, uint32_t n) {
+    nvme_queue_t* q = &nvme->ioq[n];
+    q->nvme = nvme;
+    q->id = n + 1;
+    q->vector = n % nvme->irq_count;
+    atomic_init(&q->submitted, NULL);
+    list_initialize(&q->pending_txns);
+    list_initialize(&q->active_txns);
+#if WITH_STATS
+    mtx_init(&q->stat_lock, mtx_plain);
+#endif
+
+    // The deepest power of two queues the controller allows, MQES is 0's based.
+    // The queues are always physically contiguous, so CAP.CQR needs no handling.
+    q->entries = IOQ_MAX_ENTRIES;
+    while (q->entries > NVME_CAP_MQES(cap) + 1U) {
+        q->entries >>= 1;
+    }
+    q->utxn_count = q->entries - 1;
+
+    // allocate pages for the queues, which must not be split across pages
+    // that are not physically adjacent
+    size_t sq_bytes = (q->entries * sizeof(nvme_cmd_t) + PAGE_MASK) & ~PAGE_MASK;
+    size_t cq_bytes = (q->entries * sizeof(nvme_cpl_t) + PAGE_MASK) & ~PAGE_MASK;
+    if (io_buffer_init(&q->ring_iob, sq_bytes + cq_bytes, IO_BUFFER_RW | IO_BUFFER_CONTIG)) {
+        zxlogf(ERROR, "nvme: could not allocate queue buffers for q%u\n", q->id);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // allocate pages for the page lookups and the scatter lists
+    if (io_buffer_init(&q->iob, PAGE_SIZE * IOQ_PAGE_COUNT, IO_BUFFER_RW) ||
+        io_buffer_physmap(&q->iob)) {
+        zxlogf(ERROR, "nvme: could not allocate io buffers for q%u\n", q->id);
+        return ZX_ERR_NO_MEMORY;
+    }
+    q->lookup = q->iob.virt + PAGE_SIZE * IDX_LOOKUP;
+
+    // initialize the microtransaction pool and the scatter lists
+    for (unsigned i = 0; i < q->utxn_count; i++) {
+        q->utxn[i].id = i;
+        q->utxn[i].list = -1;
+        q->utxn_avail[i / 64] |= (1ULL << (i % 64));
+    }
+    q->list_avail = ~0ULL;
+    for (unsigned i = 0; i < LIST_COUNT; i++) {
+        q->list_phys[i] = q->iob.phys_list[IDX_LIST_POOL + i];
+        q->list_virt[i] = q->iob.virt + (IDX_LIST_POOL + i) * PAGE_SIZE;
+    }
+
+    // registers and buffers for IO queues
+    q->sq_tail_db = nvme->io + NVME_REG_SQnTDBL(q->id, cap);
+    q->cq_head_db = nvme->io + NVME_REG_CQnHDBL(q->id, cap);
+
+    q->sq = io_buffer_virt(&q->ring_iob);
+    q->sq_head = 0;
+    q->sq_tail = 0;
+
+    q->cq = io_buffer_virt(&q->ring_iob) + sq_bytes;
+    q->cq_head = 0;
+    q->cq_toggle = 1;
+
+    // create the IO completion queue
+    nvme_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOCQ);
+    cmd.dptr.prp[0] = io_buffer_phys(&q->ring_iob) + sq_bytes;
+    cmd.u.raw[0] = ((q->entries - 1) << 16) | q->id; // queue size, queue id
+    cmd.u.raw[1] = (q->vector << 16) | 2 | 1; // irq vector, irq enable, phys contig
+
+    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
+        zxlogf(ERROR, "nvme: completion queue %u creation op failed\n", q->id);
+        return ZX_ERR_INTERNAL;
+    }
+
+    // create the IO submit queue
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOSQ);
+    cmd.dptr.prp[0] = io_buffer_phys(&q->ring_iob);
+    cmd.u.raw[0] = ((q->entries - 1) << 16) | q->id; // queue size, queue id
+    cmd.u.raw[1] = (q->id << 16) | 0 | 1; // cqid, qprio, phys contig
+
+    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
+        zxlogf(ERROR, "nvme: submit queue %u creation op failed\n", q->id);
+        return ZX_ERR_INTERNAL;
+    }
+
+    char name[ZX_MAX_NAME_LEN];
+    snprintf(name, sizeof(name), "nvme-io-thread-%u", q->id);
+    if (thrd_create_with_name(&q->iothread, io_thread, q, name)) {
+        zxlogf(ERROR, "nvme; cannot create io thread\n");
+        return ZX_ERR_INTERNAL;
+    }
+    q->iothread_started = true;
+    return ZX_OK;
+}
+
 static zx_status_t nvme_init(nvme_device_t* nvme) {
     uint32_t n = rd32(VS);
     uint64_t cap = rd64(CAP);
@@ -783,21 +1186,13 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
         zxlogf(ERROR, "nvme: minimum page size larger than platform page size\n");
         return ZX_ERR_NOT_SUPPORTED;
     }
-    // allocate pages for various queues and the utxn scatter lists
+    // allocate pages for the admin queues and commands
     if (io_buffer_init(&nvme->iob, PAGE_SIZE * IO_PAGE_COUNT, IO_BUFFER_RW) ||
         io_buffer_physmap(&nvme->iob)) {
         zxlogf(ERROR, "nvme: could not allocate io buffers\n");
         return ZX_ERR_NO_MEMORY;
     }
 
-    // initialize the microtransaction pool
-    nvme->utxn_avail = 0x7FFFFFFFFFFFFFFFULL;
-    for (unsigned n = 0; n < UTXN_COUNT; n++) {
-        nvme->utxn[n].id = n;
-        nvme->utxn[n].phys = nvme->iob.phys_list[IDX_UTXN_POOL + n];
-        nvme->utxn[n].virt = nvme->iob.virt + (IDX_UTXN_POOL + n) * PAGE_SIZE;
-    }
-
     if (rd32(CSTS) & NVME_CSTS_RDY) {
         zxlogf(INFO, "nvme: controller is active. resetting...\n");
         wr32(rd32(CC) & ~NVME_CC_EN, CC); // disable
@@ -847,32 +1242,19 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     nvme->admin_cq_head = 0;
     nvme->admin_cq_toggle = 1;
 
-    // registers and buffers for IO queues
-    nvme->io_sq_tail_db = nvme->io + NVME_REG_SQnTDBL(1, cap);
-    nvme->io_cq_head_db = nvme->io + NVME_REG_CQnHDBL(1, cap);
-
-    nvme->io_sq = nvme->iob.virt + PAGE_SIZE * IDX_IO_SQ;
-    nvme->io_sq_head = 0;
-    nvme->io_sq_tail = 0;
-
-    nvme->io_cq = nvme->iob.virt + PAGE_SIZE * IDX_IO_CQ;
-    nvme->io_cq_head = 0;
-    nvme->io_cq_toggle = 1;
-
     // scratch page for admin ops
     void* scratch = nvme->iob.virt + PAGE_SIZE * IDX_SCRATCH;
 
-    if (thrd_create_with_name(&nvme->irqthread, irq_thread, nvme, "nvme-irq-thread")) {
-        zxlogf(ERROR, "nvme; cannot create irq thread\n");
-        return ZX_ERR_INTERNAL;
-    }
-    nvme->flags |= FLAG_IRQ_THREAD_STARTED;
-
-    if (thrd_create_with_name(&nvme->iothread, io_thread, nvme, "nvme-io-thread")) {
-        zxlogf(ERROR, "nvme; cannot create io thread\n");
-        return ZX_ERR_INTERNAL;
+    for (uint32_t n = 0; n < nvme->irq_count; n++) {
+        nvme_irq_t* irq = &nvme->irq[n];
+        char name[ZX_MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "nvme-irq-thread-%u", n);
+        if (thrd_create_with_name(&irq->thread, irq_thread, irq, name)) {
+            zxlogf(ERROR, "nvme; cannot create irq thread\n");
+            return ZX_ERR_INTERNAL;
+        }
+        irq->started = true;
     }
-    nvme->flags |= FLAG_IO_THREAD_STARTED;
 
     nvme_cmd_t cmd;
 
@@ -908,7 +1290,12 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     uint32_t nscount = ci->NN;
     zxlogf(INFO, "nvme: max namespaces: %u\n", nscount);
     zxlogf(INFO, "nvme: scatter gather lists (SGL): %c %08x\n",
-           (ci->SGLS & 3) ? 'Y' : 'N', ci->SGLS);
+           NVME_SGLS_SUPPORT(ci->SGLS) ? 'Y' : 'N', ci->SGLS);
+    // Our data blocks are always whole lba blocks, which meets the
+    // dword alignment some controllers require of them.
+    if (NVME_SGLS_SUPPORT(ci->SGLS) == 1 || NVME_SGLS_SUPPORT(ci->SGLS) == 2) {
+        nvme->flags |= FLAG_HAS_SGL;
+    }
 
     // Maximum transfer is in units of 2^n * PAGESIZE, n == 0 means "infinite"
     nvme->max_xfer = 0xFFFFFFFF;
@@ -950,41 +1337,37 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     FEATURE(ONCS, WRITE_UNCORRECTABLE);
     FEATURE(ONCS, COMPARE);
 
-    // set feature (number of queues) to 1 iosq and 1 iocq
+    // ask for one io queue pair per cpu, the controller may grant fewer
+    uint32_t want = MIN(zx_system_get_num_cpus(), MAX_IO_QUEUES);
     memset(&cmd, 0, sizeof(cmd));
     cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_SET_FEATURE);
     cmd.u.raw[0] = NVME_FEATURE_NUMBER_OF_QUEUES;
-    cmd.u.raw[1] = 0;
+    cmd.u.raw[1] = ((want - 1) << 16) | (want - 1); // iocqs, iosqs, zero based
 
     nvme_cpl_t cpl;
     if (nvme_admin_txn(nvme, &cmd, &cpl) != ZX_OK) {
         zxlogf(ERROR, "nvme: set feature (number queues) op failed\n");
         return ZX_ERR_INTERNAL;
     }
-    zxlogf(INFO,"cpl.cmd %08x\n", cpl.cmd);
+    uint32_t nsqa = (cpl.cmd & 0xFFFF) + 1;
+    uint32_t ncqa = (cpl.cmd >> 16) + 1;
+    uint32_t count = MIN(want, MIN(nsqa, ncqa));
+    zxlogf(INFO, "nvme: io queues: wanted %u, granted %u/%u sq/cq, using %u on %u irqs\n",
+           want, nsqa, ncqa, count, nvme->irq_count);
 
-    // create the IO completion queue
-    memset(&cmd, 0, sizeof(cmd));
-    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOCQ);
-    cmd.dptr.prp[0] = nvme->iob.phys_list[IDX_IO_CQ];
-    cmd.u.raw[0] = ((CQMAX - 1) << 16) | 1; // queue size, queue id
-    cmd.u.raw[1] = (0 << 16) | 2 | 1; // irq vector, irq enable, phys contig
-
-    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
-        zxlogf(ERROR, "nvme: completion queue creation op failed\n");
-        return ZX_ERR_INTERNAL;
+    // The irq threads look at the queues as soon as ioq_count says they are
+    // there, so only publish each one once it is set up.
+    if ((nvme->ioq = calloc(count, sizeof(nvme_queue_t))) == NULL) {
+        return ZX_ERR_NO_MEMORY;
     }
-
-    // create the IO submit queue
-    memset(&cmd, 0, sizeof(cmd));
-    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOSQ);
-    cmd.dptr.prp[0] = nvme->iob.phys_list[IDX_IO_SQ];
-    cmd.u.raw[0] = ((SQMAX - 1) << 16) | 1; // queue size, queue id
-    cmd.u.raw[1] = (1 << 16) | 0 | 1; // cqid, qprio, phys contig
-
-    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
-        zxlogf(ERROR, "nvme: submit queue creation op failed\n");
-        return ZX_ERR_INTERNAL;
+    for (uint32_t n = 0; n < count; n++) {
+        zx_status_t r = nvme_ioq_init(nvme, cap, n);
+        if (r != ZX_OK) {
+            // release cleans up what was set up of this one too
+            nvme->ioq_count = n + 1;
+            return r;
+        }
+        nvme->ioq_count = n + 1;
     }
 
     // identify namespace 1
@@ -1068,9 +1451,6 @@ static zx_status_t nvme_bind(void* ctx, zx_device_t* dev) {
     if ((nvme = calloc(1, sizeof(nvme_device_t))) == NULL) {
         return ZX_ERR_NO_MEMORY;
     }
-    list_initialize(&nvme->pending_txns);
-    list_initialize(&nvme->active_txns);
-    mtx_init(&nvme->lock, mtx_plain);
     mtx_init(&nvme->admin_lock, mtx_plain);
 
     if (device_get_protocol(dev, ZX_PROTOCOL_PCI, &nvme->pci)) {
@@ -1083,14 +1463,24 @@ static zx_status_t nvme_bind(void* ctx, zx_device_t* dev) {
         goto fail;
     }
 
+    // With MSI-X every io queue pair can have a vector of its own, the
+    // first one shared with the admin queue. Otherwise they all share one.
     uint32_t modes[3] = {
         ZX_PCIE_IRQ_MODE_MSI_X, ZX_PCIE_IRQ_MODE_MSI, ZX_PCIE_IRQ_MODE_LEGACY,
     };
     uint32_t nirq = 0;
     for (unsigned n = 0; n < countof(modes); n++) {
-        if ((pci_query_irq_mode(&nvme->pci, modes[n], &nirq) == ZX_OK) &&
-            (pci_set_irq_mode(&nvme->pci, modes[n], 1) == ZX_OK)) {
-            zxlogf(INFO, "nvme: irq mode %u, irq count %u (#%u)\n", modes[n], nirq, n);
+        if ((pci_query_irq_mode(&nvme->pci, modes[n], &nirq) != ZX_OK) || (nirq == 0)) {
+            continue;
+        }
+        uint32_t count = 1;
+        if (modes[n] == ZX_PCIE_IRQ_MODE_MSI_X) {
+            count = MIN(nirq, MIN(zx_system_get_num_cpus(), MAX_IO_QUEUES));
+        }
+        if (pci_set_irq_mode(&nvme->pci, modes[n], count) == ZX_OK) {
+            zxlogf(INFO, "nvme: irq mode %u, irq count %u, using %u (#%u)\n",
+                   modes[n], nirq, count, n);
+            nvme->irq_count = count;
             goto irq_configured;
         }
     }
@@ -1098,9 +1488,13 @@ static zx_status_t nvme_bind(void* ctx, zx_device_t* dev) {
     goto fail;
 
 irq_configured:
-    if (pci_map_interrupt(&nvme->pci, 0, &nvme->irqh) != ZX_OK) {
-        zxlogf(ERROR, "nvme: could not map irq\n");
-        goto fail;
+    for (uint32_t n = 0; n < nvme->irq_count; n++) {
+        nvme->irq[n].nvme = nvme;
+        nvme->irq[n].vector = n;
+        if (pci_map_interrupt(&nvme->pci, n, &nvme->irq[n].irqh) != ZX_OK) {
+            zxlogf(ERROR, "nvme: could not map irq %u\n", n);
+            goto fail;
+        }
     }
     if (pci_enable_bus_master(&nvme->pci, true)) {
         zxlogf(ERROR, "nvme: cannot enable bus mastering\n");
@@ -8,7 +8,6 @@
 #include <ddk/protocol/block.h>
 
 #include <zircon/device/ramdisk.h>
-#include <sync/completion.h>
 
 #include <assert.h>
 #include <inttypes.h>
@@ -24,87 +23,181 @@
 #include <zircon/syscalls.h>
 #include <zircon/types.h>
 
+// Ops are run by up to this many worker threads at once.
+#define RAMDISK_MAX_WORKERS 4
+
 typedef struct {
     zx_device_t* zxdev;
 } ramctl_device_t;
 
-typedef struct ramdisk_device {
+typedef struct {
+    block_op_t op;
+    list_node_t node;
+} ramdisk_txn_t;
+
+typedef struct ramdisk_device ramdisk_device_t;
+
+typedef struct ramdisk_worker {
+    ramdisk_device_t* dev;
+    thrd_t thread;
+    // The op being run, if any. Protected by the device lock.
+    ramdisk_txn_t* txn;
+} ramdisk_worker_t;
+
+struct ramdisk_device {
     zx_device_t* zxdev;
     uintptr_t mapped_addr;
     uint64_t blk_size;
     uint64_t blk_count;
 
     mtx_t lock;
-    completion_t signal;
+    cnd_t signal;
     list_node_t txn_list;
     bool dead;
 
     uint32_t flags;
     zx_handle_t vmo;
-    thrd_t worker;
+    uint32_t num_workers;
+    ramdisk_worker_t workers[RAMDISK_MAX_WORKERS];
     char name[NAME_MAX];
-} ramdisk_device_t;
+};
 
-typedef struct {
-    block_op_t op;
-    list_node_t node;
-} ramdisk_txn_t;
+static bool ramdisk_txns_overlap(const ramdisk_txn_t* a, const ramdisk_txn_t* b,
+                                 uint64_t blk_size) {
+    uint64_t a_end = a->op.rw.offset_dev + a->op.rw.length * blk_size;
+    uint64_t b_end = b->op.rw.offset_dev + b->op.rw.length * blk_size;
+    return (a->op.rw.offset_dev < b_end) && (b->op.rw.offset_dev < a_end);
+}
+
+// Takes the op at the head of the queue for |worker|, unless it has to wait:
+// an op which overlaps a running one waits for it, so that ops on the same
+// blocks happen in the order they were queued, and a FLUSH waits for all the
+// ops before it.
+static ramdisk_txn_t* ramdisk_next_txn_locked(ramdisk_device_t* dev, ramdisk_worker_t* worker) {
+    ramdisk_txn_t* txn = list_peek_head_type(&dev->txn_list, ramdisk_txn_t, node);
+    if (txn == NULL) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < dev->num_workers; i++) {
+        ramdisk_txn_t* running = dev->workers[i].txn;
+        if ((running != NULL) && ((txn->op.command == BLOCK_OP_FLUSH) ||
+                                  ramdisk_txns_overlap(txn, running, dev->blk_size))) {
+            return NULL;
+        }
+    }
+    list_delete(&txn->node);
+    if (txn->op.command != BLOCK_OP_FLUSH) {
+        worker->txn = txn;
+    }
+    return txn;
+}
+
+// Gives back the whole pages of the ramdisk in [offset, offset + len) which
+// hold only zeroes, so that a ramdisk which is mostly empty, or which is
+// written with zeroes to discard its contents, stays sparse.
+static void ramdisk_decommit_zero_pages(ramdisk_device_t* dev, uint64_t offset, uint64_t len) {
+    uint64_t start = (offset + PAGE_SIZE - 1) & ~((uint64_t)PAGE_SIZE - 1);
+    uint64_t end = (offset + len) & ~((uint64_t)PAGE_SIZE - 1);
+    uint64_t zero_start = start;
+    for (uint64_t page = start; page < end; page += PAGE_SIZE) {
+        const uint64_t* words = (const uint64_t*)(dev->mapped_addr + page);
+        size_t i = 0;
+        while ((i < PAGE_SIZE / sizeof(uint64_t)) && (words[i] == 0)) {
+            i++;
+        }
+        if (i < PAGE_SIZE / sizeof(uint64_t)) {
+            if (zero_start < page) {
+                zx_vmo_op_range(dev->vmo, ZX_VMO_OP_DECOMMIT, zero_start, page - zero_start,
+                                NULL, 0);
+            }
+            zero_start = page + PAGE_SIZE;
+        }
+    }
+    if (zero_start < end) {
+        zx_vmo_op_range(dev->vmo, ZX_VMO_OP_DECOMMIT, zero_start, end - zero_start, NULL, 0);
+    }
+}
+
+static zx_status_t ramdisk_do_txn(ramdisk_device_t* dev, ramdisk_txn_t* txn) {
+    if (txn->op.command == BLOCK_OP_FLUSH) {
+        return ZX_OK;
+    }
+
+    void* addr = (void*) dev->mapped_addr + txn->op.rw.offset_dev;
+    size_t len = txn->op.rw.length * dev->blk_size;
+    size_t actual;
 
-// The worker thread processes messages from iotxns in the background
+    if (txn->op.command == BLOCK_OP_READ) {
+        if ((zx_vmo_write(txn->op.rw.vmo, addr, txn->op.rw.offset_vmo,
+                          len, &actual) != ZX_OK) ||
+            (actual != len)) {
+            return ZX_ERR_IO;
+        }
+    } else {
+        if ((zx_vmo_read(txn->op.rw.vmo, addr, txn->op.rw.offset_vmo,
+                         len, &actual) != ZX_OK) ||
+            (actual != len)) {
+            return ZX_ERR_IO;
+        }
+        ramdisk_decommit_zero_pages(dev, txn->op.rw.offset_dev, len);
+    }
+    return ZX_OK;
+}
+
+// The worker threads process ops in the background
 static int worker_thread(void* arg) {
-    ramdisk_device_t* dev = (ramdisk_device_t*)arg;
+    ramdisk_worker_t* worker = (ramdisk_worker_t*)arg;
+    ramdisk_device_t* dev = worker->dev;
     ramdisk_txn_t* txn;
-    bool dead;
 
+    mtx_lock(&dev->lock);
     for (;;) {
-        for (;;) {
-            mtx_lock(&dev->lock);
-            dead = dev->dead;
-            txn = list_remove_head_type(&dev->txn_list, ramdisk_txn_t, node);
-            mtx_unlock(&dev->lock);
-            if (dead) {
-                goto goodbye;
-            }
-            if (txn == NULL) {
-                completion_wait(&dev->signal, ZX_TIME_INFINITE);
-            } else {
-                completion_reset(&dev->signal);
-                break;
-            }
+        if (dev->dead) {
+            break;
         }
+        if ((txn = ramdisk_next_txn_locked(dev, worker)) == NULL) {
+            cnd_wait(&dev->signal, &dev->lock);
+            continue;
+        }
+        mtx_unlock(&dev->lock);
 
-        zx_status_t status = ZX_OK;
-        void* addr = (void*) dev->mapped_addr + txn->op.rw.offset_dev;
-        size_t len = txn->op.rw.length * dev->blk_size;
-        size_t actual;
+        zx_status_t status = ramdisk_do_txn(dev, txn);
 
-        if (txn->op.command == BLOCK_OP_READ) {
-            if ((zx_vmo_write(txn->op.rw.vmo, addr, txn->op.rw.offset_vmo,
-                              len, &actual) != ZX_OK) ||
-                (actual != len)) {
-                status = ZX_ERR_IO;
-            }
-        } else {
-            if ((zx_vmo_read(txn->op.rw.vmo, addr, txn->op.rw.offset_vmo,
-                             len, &actual) != ZX_OK) ||
-                (actual != len)) {
-                status = ZX_ERR_IO;
-            }
+        mtx_lock(&dev->lock);
+        worker->txn = NULL;
+        // ops waiting for this one may be able to run now
+        if (!list_is_empty(&dev->txn_list)) {
+            cnd_broadcast(&dev->signal);
         }
+        mtx_unlock(&dev->lock);
 
         txn->op.completion_cb(&txn->op, status);
+
+        mtx_lock(&dev->lock);
     }
 
-goodbye:
-    while (txn != NULL) {
+    while ((txn = list_remove_head_type(&dev->txn_list, ramdisk_txn_t, node)) != NULL) {
+        mtx_unlock(&dev->lock);
         txn->op.completion_cb(&txn->op, ZX_ERR_BAD_STATE);
         mtx_lock(&dev->lock);
-        txn = list_remove_head_type(&dev->txn_list, ramdisk_txn_t, node);
-        mtx_unlock(&dev->lock);
     }
+    mtx_unlock(&dev->lock);
     return 0;
 }
 
+// Stops the worker threads, failing the ops still queued.
+static void ramdisk_stop_workers(ramdisk_device_t* ramdev) {
+    mtx_lock(&ramdev->lock);
+    ramdev->dead = true;
+    cnd_broadcast(&ramdev->signal);
+    mtx_unlock(&ramdev->lock);
+
+    for (uint32_t i = 0; i < ramdev->num_workers; i++) {
+        thrd_join(ramdev->workers[i].thread, NULL);
+    }
+    ramdev->num_workers = 0;
+}
+
 static uint64_t sizebytes(ramdisk_device_t* rdev) {
     return rdev->blk_size * rdev->blk_count;
 }
@@ -125,8 +218,8 @@ static void ramdisk_unbind(void* ctx) {
     ramdisk_device_t* ramdev = ctx;
     mtx_lock(&ramdev->lock);
     ramdev->dead = true;
+    cnd_broadcast(&ramdev->signal);
     mtx_unlock(&ramdev->lock);
-    completion_signal(&ramdev->signal);
     device_remove(ramdev->zxdev);
 }
 
@@ -193,21 +286,18 @@ static void ramdisk_queue(void* ctx, block_op_t* bop) {
         }
         txn->op.rw.offset_dev *= ramdev->blk_size;
         txn->op.rw.offset_vmo *= ramdev->blk_size;
-
+        // fall through
+    case BLOCK_OP_FLUSH:
         mtx_lock(&ramdev->lock);
         if (!(dead = ramdev->dead)) {
             list_add_tail(&ramdev->txn_list, &txn->node);
+            cnd_signal(&ramdev->signal);
         }
         mtx_unlock(&ramdev->lock);
         if (dead) {
             bop->completion_cb(bop, ZX_ERR_BAD_STATE);
-        } else {
-            completion_signal(&ramdev->signal);
         }
         break;
-    case BLOCK_OP_FLUSH:
-        bop->completion_cb(bop, ZX_OK);
-        break;
     default:
         bop->completion_cb(bop, ZX_ERR_NOT_SUPPORTED);
         break;
@@ -226,18 +316,13 @@ static zx_off_t ramdisk_getsize(void* ctx) {
 static void ramdisk_release(void* ctx) {
     ramdisk_device_t* ramdev = ctx;
 
-    // Wake up the worker thread, in case it is sleeping
-    mtx_lock(&ramdev->lock);
-    ramdev->dead = true;
-    mtx_unlock(&ramdev->lock);
-    completion_signal(&ramdev->signal);
-
-    int r;
-    thrd_join(ramdev->worker, &r);
+    ramdisk_stop_workers(ramdev);
     if (ramdev->vmo != ZX_HANDLE_INVALID) {
         zx_vmar_unmap(zx_vmar_root_self(), ramdev->mapped_addr, sizebytes(ramdev));
         zx_handle_close(ramdev->vmo);
     }
+    cnd_destroy(&ramdev->signal);
+    mtx_destroy(&ramdev->lock);
     free(ramdev);
 }
 
@@ -275,6 +360,9 @@ static zx_status_t ramctl_config(ramctl_device_t* ramctl, zx_handle_t vmo,
     if (mtx_init(&ramdev->lock, mtx_plain) != thrd_success) {
         goto fail_free;
     }
+    if (cnd_init(&ramdev->signal) != thrd_success) {
+        goto fail_mtx;
+    }
     ramdev->vmo = vmo;
     ramdev->blk_size = blk_size;
     ramdev->blk_count = blk_count;
@@ -285,11 +373,18 @@ static zx_status_t ramctl_config(ramctl_device_t* ramctl, zx_handle_t vmo,
                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
                          &ramdev->mapped_addr);
     if (status != ZX_OK) {
-        goto fail_mtx;
+        goto fail_cnd;
     }
     list_initialize(&ramdev->txn_list);
-    if (thrd_create(&ramdev->worker, worker_thread, ramdev) != thrd_success) {
-        goto fail_unmap;
+    uint32_t num_workers = MIN(zx_system_get_num_cpus(), RAMDISK_MAX_WORKERS);
+    for (uint32_t i = 0; i < num_workers; i++) {
+        ramdisk_worker_t* worker = &ramdev->workers[i];
+        worker->dev = ramdev;
+        if (thrd_create(&worker->thread, worker_thread, worker) != thrd_success) {
+            status = ZX_ERR_NO_RESOURCES;
+            goto fail_workers;
+        }
+        ramdev->num_workers++;
     }
 
     device_add_args_t args = {
@@ -309,8 +404,11 @@ static zx_status_t ramctl_config(ramctl_device_t* ramctl, zx_handle_t vmo,
     *out_actual = strlen(reply);
     return ZX_OK;
 
-fail_unmap:
+fail_workers:
+    ramdisk_stop_workers(ramdev);
     zx_vmar_unmap(zx_vmar_root_self(), ramdev->mapped_addr, sizebytes(ramdev));
+fail_cnd:
+    cnd_destroy(&ramdev->signal);
 fail_mtx:
     mtx_destroy(&ramdev->lock);
 fail_free:
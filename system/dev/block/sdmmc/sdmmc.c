@@ -251,7 +251,47 @@ static zx_status_t sdmmc_wait_for_tran(sdmmc_device_t* dev) {
     }
 }
 
-static void sdmmc_do_txn(sdmmc_device_t* dev, sdmmc_txn_t* txn) {
+// Moves the txns queued right behind |txn| which continue it, in the same VMO
+// and on the device, onto |merged|, so that they are issued together as one
+// multi-block command instead of one command each.
+static void sdmmc_merge_txns_locked(sdmmc_device_t* dev, sdmmc_txn_t* txn, list_node_t* merged) {
+    if ((txn->bop.command != BLOCK_OP_READ) && (txn->bop.command != BLOCK_OP_WRITE)) {
+        return;
+    }
+
+    const uint64_t block_size = dev->block_info.block_size;
+    uint64_t max_bytes = dev->host_info.max_transfer_size;
+    if (max_bytes == 0) {
+        max_bytes = SDMMC_PAGES_COUNT * PAGE_SIZE;
+    }
+    const uint64_t page_offset = (txn->bop.rw.offset_vmo * block_size) & (PAGE_SIZE - 1);
+    uint64_t blocks = txn->bop.rw.length;
+
+    sdmmc_txn_t* next;
+    while ((next = list_peek_head_type(&dev->txn_list, sdmmc_txn_t, node)) != NULL) {
+        if ((next->bop.command != txn->bop.command) ||
+            (next->bop.rw.vmo != txn->bop.rw.vmo) ||
+            (next->bop.rw.offset_dev != txn->bop.rw.offset_dev + blocks) ||
+            (next->bop.rw.offset_vmo != txn->bop.rw.offset_vmo + blocks)) {
+            break;
+        }
+        uint64_t total = blocks + next->bop.rw.length;
+        // the command's block count is 16 bits, and the pages of the whole
+        // transfer must fit in the request
+        if ((total > UINT16_MAX) || (total * block_size > max_bytes) ||
+            ((page_offset + total * block_size + PAGE_SIZE - 1) / PAGE_SIZE >
+             SDMMC_PAGES_COUNT)) {
+            break;
+        }
+        list_delete(&next->node);
+        list_add_tail(merged, &next->node);
+        STAT_DEC(pending);
+        blocks = total;
+    }
+    txn->bop.rw.length = blocks;
+}
+
+static zx_status_t sdmmc_do_txn(sdmmc_device_t* dev, sdmmc_txn_t* txn) {
     bool is_read = true;
     uint32_t cmd = 0;
 
@@ -274,14 +314,12 @@ static void sdmmc_do_txn(sdmmc_device_t* dev, sdmmc_txn_t* txn) {
         is_read = false;
         break;
     case BLOCK_OP_FLUSH:
-        block_complete(&txn->bop, ZX_OK);
-        return;
+        return ZX_OK;
     default:
         // should not get here
         zxlogf(ERROR, "sdmmc: do_txn invalid block op %d\n", txn->bop.command);
         ZX_DEBUG_ASSERT(true);
-        block_complete(&txn->bop, ZX_ERR_INVALID_ARGS);
-        return;
+        return ZX_ERR_INVALID_ARGS;
     }
 
     zxlogf(TRACE, "sdmmc: do_txn blockop %d offset_vmo 0x%" PRIx64 " length 0x%x blocksize 0x%x"
@@ -312,7 +350,7 @@ static void sdmmc_do_txn(sdmmc_device_t* dev, sdmmc_txn_t* txn) {
         }
         if (st != ZX_OK) {
             zxlogf(TRACE, "sdmmc: do_txn cacheop error %d\n", st);
-            block_complete(&txn->bop, st);
+            return st;
         }
 
         req->use_dma = true;
@@ -323,8 +361,7 @@ static void sdmmc_do_txn(sdmmc_device_t* dev, sdmmc_txn_t* txn) {
                              txn->bop.rw.offset_vmo, txn->bop.rw.length, NULL, 0);
         if (st != ZX_OK) {
             zxlogf(TRACE, "sdmmc: do_txn vmo commit error %d\n", st);
-            block_complete(&txn->bop, st);
-            return;
+            return st;
         }
         st = zx_vmo_op_range(txn->bop.rw.vmo, ZX_VMO_OP_LOOKUP,
                              txn->bop.rw.offset_vmo, txn->bop.rw.length,
@@ -333,8 +370,7 @@ static void sdmmc_do_txn(sdmmc_device_t* dev, sdmmc_txn_t* txn) {
             zxlogf(TRACE, "sdmmc: do_txn vmo lookup error %d\n", st);
             zxlogf(TRACE, "sdmmc: offset_vmo 0x%" PRIx64 " length 0x%x buflen 0x%zx\n",
                    txn->bop.rw.offset_vmo, txn->bop.rw.length, sizeof(req->phys));
-            block_complete(&txn->bop, st);
-            return;
+            return st;
         }
     } else {
         req->use_dma = false;
@@ -343,19 +379,20 @@ static void sdmmc_do_txn(sdmmc_device_t* dev, sdmmc_txn_t* txn) {
                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, (uintptr_t*)&req->virt);
         if (st != ZX_OK) {
             zxlogf(TRACE, "sdmmc: do_txn vmo map error %d\n", st);
-            block_complete(&txn->bop, st);
-            return;
+            return st;
         }
     }
 
     st = sdmmc_request(&dev->host, req);
+    if (!req->use_dma) {
+        zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)req->virt, txn->bop.rw.length);
+    }
     if (st != ZX_OK) {
         zxlogf(TRACE, "sdmmc: do_txn error %d\n", st);
-        block_complete(&txn->bop, st);
     } else {
         zxlogf(TRACE, "sdmmc: do_txn complete\n");
-        block_complete(&txn->bop, ZX_OK);
     }
+    return st;
 }
 
 static int sdmmc_worker_thread(void* arg) {
@@ -374,6 +411,8 @@ static int sdmmc_worker_thread(void* arg) {
            dev->host_info.max_transfer_size);
 
     dev->block_info.max_transfer_size = dev->host_info.max_transfer_size;
+    // random writes are far slower than sequential ones on most cards
+    dev->block_info.flags |= BLOCK_FLAG_SEEK_PENALTY;
 
     // Reset the card.
     sdmmc_hw_reset(&dev->host);
@@ -412,9 +451,16 @@ static int sdmmc_worker_thread(void* arg) {
         sdmmc_txn_t* txn = list_remove_head_type(&dev->txn_list, sdmmc_txn_t, node);
         STAT_DEC_IF(pending, txn != NULL);
         if (txn) {
+            list_node_t merged = LIST_INITIAL_VALUE(merged);
+            sdmmc_merge_txns_locked(dev, txn, &merged);
             // Unlock if we execute the transaction
             SDMMC_UNLOCK(dev);
-            sdmmc_do_txn(dev, txn);
+            zx_status_t status = sdmmc_do_txn(dev, txn);
+            block_complete(&txn->bop, status);
+            sdmmc_txn_t* next;
+            while ((next = list_remove_head_type(&merged, sdmmc_txn_t, node)) != NULL) {
+                block_complete(&next->bop, status);
+            }
         } else {
             // Stay locked if we're clearing the "RECEIVED" flag.
             zx_object_signal(dev->worker_event, SDMMC_TXN_RECEIVED, 0);
@@ -26,6 +26,7 @@
 #endif
 
 static csw_status_t ums_verify_csw(ums_t* ums, usb_request_t* csw_request, uint32_t* out_residue);
+static zx_status_t ums_csw_status(ums_t* ums, uint32_t* out_residue);
 
 static inline void txn_complete(ums_txn_t* txn, zx_status_t status) {
     zxlogf(TRACE, "UMS DONE %d (%p)\n", status, &txn->op);
@@ -54,15 +55,16 @@ static void ums_req_complete(usb_request_t* req, void* cookie) {
     }
 }
 
-static void ums_send_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint8_t flags,
-                         uint8_t command_len, void* command) {
+// Sets up the CBW request for a command, without queueing it.
+static zx_status_t ums_fill_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint8_t flags,
+                                uint8_t command_len, void* command) {
     usb_request_t* req = ums->cbw_req;
 
     ums_cbw_t* cbw;
     zx_status_t status = usb_request_mmap(req, (void **)&cbw);
     if (status != ZX_OK) {
         DEBUG_PRINT(("UMS: usb request mmap failed: %d\n", status));
-        return;
+        return status;
     }
 
     memset(cbw, 0, sizeof(*cbw));
@@ -75,7 +77,16 @@ static void ums_send_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint
 
     // copy command_len bytes from the command passed in into the command_len
     memcpy(cbw->CBWCB, command, command_len);
+    return ZX_OK;
+}
 
+static void ums_send_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint8_t flags,
+                         uint8_t command_len, void* command) {
+    if (ums_fill_cbw(ums, lun, transfer_length, flags, command_len, command) != ZX_OK) {
+        return;
+    }
+
+    usb_request_t* req = ums->cbw_req;
     completion_t completion = COMPLETION_INIT;
     req->cookie = &completion;
     usb_request_queue(&ums->usb, req);
@@ -89,7 +100,12 @@ static zx_status_t ums_read_csw(ums_t* ums, uint32_t* out_residue) {
     usb_request_queue(&ums->usb, csw_request);
     completion_wait(&completion, ZX_TIME_INFINITE);
 
-    csw_status_t csw_error = ums_verify_csw(ums, csw_request, out_residue);
+    return ums_csw_status(ums, out_residue);
+}
+
+// Returns the status of the command from the CSW which has been received.
+static zx_status_t ums_csw_status(ums_t* ums, uint32_t* out_residue) {
+    csw_status_t csw_error = ums_verify_csw(ums, ums->csw_req, out_residue);
 
     if (csw_error == CSW_SUCCESS) {
         return ZX_OK;
@@ -246,8 +262,12 @@ static zx_status_t ums_mode_sense6(ums_t* ums, uint8_t lun, scsi_mode_sense_6_da
     return status;
 }
 
+// Runs the command set up in the CBW request, with a data phase from or to
+// the txn's VMO. The CBW, data and CSW requests are queued together, so the
+// controller moves on to each phase as soon as the one before it is done,
+// rather than waiting for this thread to queue it.
 static zx_status_t ums_data_transfer(ums_t* ums, ums_txn_t* txn, zx_off_t offset, size_t length,
-                                     uint8_t ep_address) {
+                                     uint8_t ep_address, uint32_t* out_residue) {
     usb_request_t* req = &ums->data_transfer_req;
 
     zx_status_t status = usb_request_init(req, txn->op.rw.vmo, offset, length, ep_address);
@@ -256,14 +276,44 @@ static zx_status_t ums_data_transfer(ums_t* ums, ums_txn_t* txn, zx_off_t offset
     }
     req->complete_cb = ums_req_complete;
 
-    completion_t completion = COMPLETION_INIT;
-    req->cookie = &completion;
+    completion_t cbw_completion = COMPLETION_INIT;
+    completion_t data_completion = COMPLETION_INIT;
+    completion_t csw_completion = COMPLETION_INIT;
+    ums->cbw_req->cookie = &cbw_completion;
+    req->cookie = &data_completion;
+    ums->csw_req->cookie = &csw_completion;
+    usb_request_queue(&ums->usb, ums->cbw_req);
     usb_request_queue(&ums->usb, req);
-    completion_wait(&completion, ZX_TIME_INFINITE);
+    usb_request_queue(&ums->usb, ums->csw_req);
+
+    completion_wait(&cbw_completion, ZX_TIME_INFINITE);
+    status = ums->cbw_req->response.status;
+    if (status == ZX_OK) {
+        completion_wait(&data_completion, ZX_TIME_INFINITE);
+        status = req->response.status;
+        if (status == ZX_OK && req->response.actual != length) {
+            status = ZX_ERR_IO;
+        }
+    }
+
+    if (status != ZX_OK) {
+        // the requests behind the failed one may never complete, so take
+        // them back
+        usb_cancel_all(&ums->usb, ums->bulk_out_addr);
+        usb_cancel_all(&ums->usb, ums->bulk_in_addr);
+        completion_wait(&data_completion, ZX_TIME_INFINITE);
+    }
+    completion_wait(&csw_completion, ZX_TIME_INFINITE);
+    if (status == ZX_OK) {
+        status = ums->csw_req->response.status;
+    }
 
-    status = req->response.status;
-    if (status == ZX_OK && req->response.actual != length) {
-        status = ZX_ERR_IO;
+    if (status == ZX_OK) {
+        status = ums_csw_status(ums, out_residue);
+    } else {
+        // get the device ready for the next command
+        ums_reset(ums);
+        ums->tag_receive = ums->tag_send;
     }
 
     usb_request_release(req);
@@ -299,7 +349,7 @@ static zx_status_t ums_read(ums_block_t* dev, ums_txn_t* txn) {
             command.opcode = UMS_READ16;
             command.lba = htobe64(block_offset);
             command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
+            status = ums_fill_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
         } else if (blocks <= UINT16_MAX) {
             scsi_command10_t command;
             memset(&command, 0, sizeof(command));
@@ -307,29 +357,30 @@ static zx_status_t ums_read(ums_block_t* dev, ums_txn_t* txn) {
             command.lba = htobe32(block_offset);
             command.length_hi = blocks >> 8;
             command.length_lo = blocks & 0xFF;
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
+            status = ums_fill_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
         } else {
             scsi_command12_t command;
             memset(&command, 0, sizeof(command));
             command.opcode = UMS_READ12;
             command.lba = htobe32(block_offset);
             command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
+            status = ums_fill_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
         }
 
-        status = ums_data_transfer(ums, txn, vmo_offset, length, ums->bulk_in_addr);
-
-        block_offset += blocks;
-        num_blocks -= blocks;
-        vmo_offset += (blocks * block_size);
+        if (status != ZX_OK) {
+            break;
+        }
 
-        // receive CSW
         uint32_t residue;
-        status = ums_read_csw(ums, &residue);
+        status = ums_data_transfer(ums, txn, vmo_offset, length, ums->bulk_in_addr, &residue);
         if (status == ZX_OK && residue) {
             zxlogf(ERROR, "unexpected residue in ums_read\n");
             status = ZX_ERR_IO;
         }
+
+        block_offset += blocks;
+        num_blocks -= blocks;
+        vmo_offset += (blocks * block_size);
     }
 
     return status;
@@ -364,7 +415,7 @@ static zx_status_t ums_write(ums_block_t* dev, ums_txn_t* txn) {
             command.opcode = UMS_WRITE16;
             command.lba = htobe64(block_offset);
             command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
+            status = ums_fill_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
         } else if (blocks <= UINT16_MAX) {
             scsi_command10_t command;
             memset(&command, 0, sizeof(command));
@@ -372,29 +423,30 @@ static zx_status_t ums_write(ums_block_t* dev, ums_txn_t* txn) {
             command.lba = htobe32(block_offset);
             command.length_hi = blocks >> 8;
             command.length_lo = blocks & 0xFF;
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
+            status = ums_fill_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
         } else {
             scsi_command12_t command;
             memset(&command, 0, sizeof(command));
             command.opcode = UMS_WRITE12;
             command.lba = htobe32(block_offset);
             command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
+            status = ums_fill_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
         }
 
-        status = ums_data_transfer(ums, txn, vmo_offset, length, ums->bulk_out_addr);
-
-        block_offset += blocks;
-        num_blocks -= blocks;
-        vmo_offset += (blocks * block_size);
+        if (status != ZX_OK) {
+            break;
+        }
 
-        // receive CSW
         uint32_t residue;
-        status = ums_read_csw(ums, &residue);
+        status = ums_data_transfer(ums, txn, vmo_offset, length, ums->bulk_out_addr, &residue);
         if (status == ZX_OK && residue) {
             zxlogf(ERROR, "unexpected residue in ums_write\n");
             status = ZX_ERR_IO;
         }
+
+        block_offset += blocks;
+        num_blocks -= blocks;
+        vmo_offset += (blocks * block_size);
     }
 
     return status;
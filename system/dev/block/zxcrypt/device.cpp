@@ -20,6 +20,7 @@
 #include <zircon/device/block.h>
 #include <zircon/errors.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 #include <zx/port.h>
@@ -52,8 +53,8 @@ int InitThread(void* arg) {
 // Public methods
 
 Device::Device(zx_device_t* parent)
-    : DeviceType(parent), info_(nullptr), active_(false), tasks_(0), mapped_(0), base_(nullptr),
-      last_(0), head_(nullptr), tail_(nullptr) {}
+    : DeviceType(parent), info_(nullptr), num_workers_(0), active_(false), tasks_(0), mapped_(0),
+      base_(nullptr), last_(0), head_(nullptr), tail_(nullptr) {}
 
 Device::~Device() {}
 
@@ -130,6 +131,8 @@ zx_status_t Device::Init() {
     info->offset_dev = Volume::kReservedSlices * (fvm_.slice_size / info->blk.block_size);
     info->op_size += sizeof(extra_op_t);
     info->scale = info->blk.block_size / blk.block_size;
+    info->chunk_len = fbl::max(kMaxChunkLen - (kMaxChunkLen % info->blk.block_size),
+                               info->blk.block_size);
 
     // Reserve space for shadow I/O transactions
     if ((rc = zx::vmo::create(info->mapped_len, 0, &info->vmo)) != ZX_OK) {
@@ -147,15 +150,16 @@ zx_status_t Device::Init() {
         xprintf("bitmap allocation failed: %s\n", zx_status_get_string(rc));
         return rc;
     }
-    // TODO(aarongreen): Investigate performance implications of adding more workers.
     if ((rc = zx::port::create(0, &port_)) != ZX_OK) {
         xprintf("zx::port::create failed: %s\n", zx_status_get_string(rc));
         return rc;
     }
-    for (size_t i = 0; i < kNumWorkers; ++i) {
+    size_t num_workers = fbl::clamp<size_t>(zx_system_get_num_cpus(), 1, kMaxWorkers);
+    for (size_t i = 0; i < num_workers; ++i) {
         if ((rc = workers_[i].Start(this, *volume, port_)) != ZX_OK) {
             return rc;
         }
+        ++num_workers_;
     }
 
     // Make the pointer const
@@ -213,6 +217,35 @@ zx_status_t Device::DdkIoctl(uint32_t op, const void* in, size_t in_len, void* o
         return ZX_OK;
     }
 
+    case IOCTL_BLOCK_FVM_EXTEND_BATCH: {
+        if (!info_->has_fvm) {
+            xprintf("FVM ioctl to non-FVM device\n");
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (!in || in_len < sizeof(extend_batch_request_t)) {
+            xprintf("bad parameter(s): in=%p, in_len=%zu\n", in, in_len);
+            return ZX_ERR_INVALID_ARGS;
+        }
+        // Skip the leading reserved slice in each of the ranges.
+        extend_batch_request_t mod;
+        memcpy(&mod, in, sizeof(mod));
+        if (mod.count > MAX_FVM_EXTEND_REQUESTS) {
+            xprintf("bad parameter(s): count=%zu\n", mod.count);
+            return ZX_ERR_INVALID_ARGS;
+        }
+        size_t length = 0;
+        for (size_t i = 0; i < mod.count; ++i) {
+            mod.extents[i].offset += Volume::kReservedSlices;
+            length += mod.extents[i].length;
+        }
+        if ((rc = device_ioctl(parent(), op, &mod, sizeof(mod), out, out_len, actual)) < 0) {
+            return rc;
+        }
+        fbl::AutoLock lock(&mtx_);
+        fvm_.vslice_count += length;
+        return ZX_OK;
+    }
+
     case IOCTL_BLOCK_FVM_QUERY: {
         if (!info_->has_fvm) {
             xprintf("FVM ioctl to non-FVM device\n");
@@ -269,7 +302,7 @@ void Device::DdkUnbind() {
     packet.key = 0;
     packet.type = ZX_PKT_TYPE_USER;
     packet.status = ZX_ERR_STOP;
-    for (size_t i = 0; i < kNumWorkers; ++i) {
+    for (size_t i = 0; i < num_workers_; ++i) {
         port_.queue(&packet, 1);
     }
     port_.reset();
@@ -284,8 +317,7 @@ void Device::DdkRelease() {
     if (rc != ZX_OK) {
         xprintf("WARNING: init thread returned %s\n", zx_status_get_string(rc));
     }
-    for (size_t i = 0; i < kNumWorkers; ++i) {
-
+    for (size_t i = 0; i < num_workers_; ++i) {
         workers_[i].Stop();
     }
     if (mapped_ != 0 && (rc = zx::vmar::root_self().unmap(mapped_, info_->mapped_len)) != ZX_OK) {
@@ -376,14 +408,7 @@ void Device::BlockComplete(block_op_t* block, zx_status_t rc) {
         return;
     }
 
-    zx_port_packet_t packet;
-    packet.key = 0;
-    packet.type = ZX_PKT_TYPE_USER;
-    packet.status = ZX_ERR_NEXT;
-    memcpy(packet.user.c8, &block, sizeof(block));
-    if ((rc = device->port_.queue(&packet, 1)) != ZX_OK) {
-        device->BlockRelease(block, rc);
-    }
+    device->BlockTransform(block);
 }
 
 void Device::BlockRelease(block_op_t* block, zx_status_t rc) {
@@ -411,6 +436,24 @@ void Device::BlockRelease(block_op_t* block, zx_status_t rc) {
     }
 }
 
+void Device::BlockTransformed(block_op_t* block, uint32_t chunks, zx_status_t rc) {
+    extra_op_t* extra = BlockToExtra(block);
+    if (rc != ZX_OK) {
+        zx_status_t expected = ZX_OK;
+        extra->status.compare_exchange_strong(&expected, rc, fbl::memory_order_relaxed,
+                                              fbl::memory_order_relaxed);
+    }
+    if (extra->pending.fetch_sub(chunks, fbl::memory_order_acq_rel) != chunks) {
+        return;
+    }
+    rc = extra->status.load(fbl::memory_order_relaxed);
+    if (rc == ZX_OK && block->command == BLOCK_OP_WRITE) {
+        BlockForward(block);
+    } else {
+        BlockRelease(block, rc);
+    }
+}
+
 extra_op_t* Device::BlockToExtra(block_op_t* block) const {
     ZX_DEBUG_ASSERT(block);
     uint8_t* ptr = reinterpret_cast<uint8_t*>(block);
@@ -485,8 +528,6 @@ void Device::ReleaseBlocks(uint64_t off, uint64_t len) {
 }
 
 void Device::ProcessBlock(block_op_t* block, uint64_t off) {
-    zx_status_t rc;
-
     extra_op_t* extra = BlockToExtra(block);
     extra->buf = base_ + (off * info_->blk.block_size);
     extra->len = block->rw.length * info_->blk.block_size;
@@ -503,16 +544,39 @@ void Device::ProcessBlock(block_op_t* block, uint64_t off) {
     block->completion_cb = BlockComplete;
     block->cookie = this;
 
-    // Set remaining fields and pass along
+    // Reads are decrypted once the parent device completes them; writes are encrypted first.
+    if (block->command == BLOCK_OP_READ) {
+        BlockForward(block);
+    } else {
+        BlockTransform(block);
+    }
+}
+
+void Device::BlockTransform(block_op_t* block) {
+    zx_status_t rc;
+
+    extra_op_t* extra = BlockToExtra(block);
+    const uint32_t len = extra->len;
+    const uint32_t chunks = fbl::round_up(len, info_->chunk_len) / info_->chunk_len;
+    extra->pending.store(chunks, fbl::memory_order_relaxed);
+    extra->status.store(ZX_OK, fbl::memory_order_relaxed);
+
+    // Each packet carries the request and the byte range of its chunk.  Once the last chunk is
+    // queued, |block| may be completed by a worker at any time and must not be touched.
     zx_port_packet_t packet;
     packet.key = 0;
     packet.type = ZX_PKT_TYPE_USER;
     packet.status = ZX_ERR_NEXT;
     memcpy(packet.user.c8, &block, sizeof(block));
-    if (block->command == BLOCK_OP_READ) {
-        BlockForward(block);
-    } else if ((rc = port_.queue(&packet, 1)) != ZX_OK) {
-        BlockRelease(block, rc);
+    for (uint32_t i = 0; i < chunks; ++i) {
+        uint64_t off = static_cast<uint64_t>(i) * info_->chunk_len;
+        packet.user.u64[1] = off;
+        packet.user.u64[2] = fbl::min<uint64_t>(len - off, info_->chunk_len);
+        if ((rc = port_.queue(&packet, 1)) != ZX_OK) {
+            // Account for the chunks that will never reach a worker.
+            BlockTransformed(block, chunks - i, rc);
+            return;
+        }
     }
 }
 
@@ -75,6 +75,11 @@ public:
     // to the caller of |DdkIotxnQueue|.
     void BlockRelease(block_op_t* block, zx_status_t rc) __TA_EXCLUDES(mtx_);
 
+    // Called by the workers as |chunks| pieces of |block| finish being encrypted or decrypted, with
+    // |rc| indicating their result.  Once the last piece is done, forwards writes to the parent
+    // device and completes reads.
+    void BlockTransformed(block_op_t* block, uint32_t chunks, zx_status_t rc) __TA_EXCLUDES(mtx_);
+
     // Translates |block_op_t|s to |extra_op_t|s and vice versa.
     extra_op_t* BlockToExtra(block_op_t* block) const;
     block_op_t* ExtraToBlock(extra_op_t* extra) const;
@@ -82,9 +87,12 @@ public:
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Device);
 
-    // TODO(aarongreen): Investigate performance impact of changing this.
-    // Number of encrypting/decrypting workers
-    static const size_t kNumWorkers = 2;
+    // Maximum number of encrypting/decrypting workers.  One is started per CPU, up to this limit.
+    static const size_t kMaxWorkers = 8;
+
+    // Requests are split into chunks of at most this many bytes, so that a single large request is
+    // transformed by several workers at once.
+    static const uint32_t kMaxChunkLen = 1U << 16;
 
     // Increments the amount of work this device has outstanding.  This should be called at the
     // start of any method that shouldn't be invoked after the device has been unbound.  It notably
@@ -110,6 +118,9 @@ private:
     // and send it to a worker.
     void ProcessBlock(block_op_t* block, uint64_t offset) __TA_EXCLUDES(mtx_);
 
+    // Splits |block| into chunks and queues them for the workers.
+    void BlockTransform(block_op_t* block) __TA_EXCLUDES(mtx_);
+
     // Defer this |block| request until later, due to insufficient memory for cryptographic
     // transformations.
     void EnqueueBlock(block_op_t* block) __TA_EXCLUDES(mtx_);
@@ -144,6 +155,8 @@ private:
         block_protocol_t proto;
         // The ratio modified to unmodified parent block sizes.
         uint32_t scale;
+        // The length of the chunks requests are split into for the workers, in bytes.
+        uint32_t chunk_len;
         // A memory region used when encrypting/decrypting I/O transactions.
         zx::vmo vmo;
     };
@@ -154,7 +167,9 @@ private:
     // The |Init| thread, used to configure and add the device.
     thrd_t init_;
     // Threads that performs encryption/decryption.
-    Worker workers_[kNumWorkers];
+    Worker workers_[kMaxWorkers];
+    // The number of |workers_| that have been started.
+    size_t num_workers_;
     // Port used to send write/read operations to be encrypted/decrypted.
     zx::port port_;
     // Primary lock for accessing the fields below
@@ -9,6 +9,7 @@
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <pretty/hexdump.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +27,9 @@
 
 #define PAGE_MASK (PAGE_SIZE - 1)
 
+// an indirect table holds the header, the scatter list and the response
+#define INDIRECT_DESCS (MAX_SCATTER + 2)
+
 namespace virtio {
 
 static void txn_complete(block_txn_t* txn, zx_status_t status) {
@@ -48,7 +52,8 @@ void BlockDevice::GetInfo(block_info_t* info) {
     memset(info, 0, sizeof(*info));
     info->block_size = GetBlockSize();
     info->block_count = GetSize() / GetBlockSize();
-    info->max_transfer_size = (uint32_t)(PAGE_SIZE * (ring_size - 2));
+    // with indirect descriptors, a transfer takes a single ring slot
+    info->max_transfer_size = indirect_ ? MAX_MAX_XFER : (uint32_t)(PAGE_SIZE * (ring_size - 2));
 
     // limit max transfer to our worst case scatter list size
     if (info->max_transfer_size > MAX_MAX_XFER) {
@@ -111,22 +116,84 @@ zx_status_t BlockDevice::virtio_block_ioctl(void* ctx, uint32_t op, const void*
 }
 
 BlockDevice::BlockDevice(zx_device_t* bus_device, fbl::unique_ptr<Backend> backend)
-    : Device(bus_device, fbl::move(backend)) {
-    completion_reset(&txn_signal_);
+    : Device(bus_device, fbl::move(backend)), next_queue_(0) {
 }
 
 BlockDevice::~BlockDevice() {
     // TODO: clean up allocated physical memory
 }
 
+zx_status_t BlockDevice::Queue::Init(uint16_t index, bool use_indirect, bool event_idx) {
+    // allocate the vring
+    auto err = ring.Init(index, ring_size);
+    if (err < 0) {
+        zxlogf(ERROR, "failed to allocate vring\n");
+        return err;
+    }
+    ring.SetEventIdx(event_idx);
+
+    // allocate a queue of block requests, followed by their responses and
+    // then any indirect descriptor tables
+    size_t req_size = sizeof(virtio_blk_req_t) * blk_req_count;
+    size_t res_size = fbl::round_up(sizeof(uint8_t) * blk_req_count, sizeof(struct vring_desc));
+    size_t table_size = use_indirect ? sizeof(struct vring_desc) * INDIRECT_DESCS * blk_req_count : 0;
+    va_len = req_size + res_size + table_size;
+
+    zx_status_t r = map_contiguous_memory(va_len, &va, &blk_req_pa);
+    if (r < 0) {
+        zxlogf(ERROR, "cannot alloc blk_req buffers %d\n", r);
+        return r;
+    }
+    blk_req = reinterpret_cast<virtio_blk_req_t*>(va);
+
+    LTRACEF("allocated blk request at %p, physical address %#" PRIxPTR "\n", blk_req, blk_req_pa);
+
+    blk_res_pa = blk_req_pa + req_size;
+    blk_res = reinterpret_cast<uint8_t*>(va + req_size);
+
+    LTRACEF("allocated blk responses at %p, physical address %#" PRIxPTR "\n", blk_res, blk_res_pa);
+
+    if (use_indirect) {
+        indirect_pa = blk_res_pa + res_size;
+        indirect = reinterpret_cast<struct vring_desc*>(va + req_size + res_size);
+    }
+    return ZX_OK;
+}
+
+size_t BlockDevice::Queue::AllocReq() {
+    uint32_t free = ~blk_req_bitmap;
+    if (free == 0) {
+        return blk_req_count;
+    }
+    size_t i = __builtin_ctz(free);
+    if (i >= blk_req_count) {
+        return blk_req_count;
+    }
+    blk_req_bitmap |= (1u << i);
+    return i;
+}
+
+void BlockDevice::Queue::FreeReq(size_t i) {
+    blk_req_bitmap &= ~(1u << i);
+}
+
+bool BlockDevice::AckFeature(uint32_t features) {
+    uint32_t bit = static_cast<uint32_t>(__builtin_ctz(features));
+    if (!DeviceFeatureSupported(bit)) {
+        return false;
+    }
+    DriverFeatureAck(bit);
+    return true;
+}
+
 zx_status_t BlockDevice::Init() {
     LTRACE_ENTRY;
 
     // reset the device
     DeviceReset();
 
-    // read our configuration
-    CopyDeviceConfig(&config_, sizeof(config_));
+    // read our configuration, up to the fields which depend on features
+    CopyDeviceConfig(&config_, offsetof(virtio_blk_config_t, topology));
     // TODO(cja): The blk_size provided in the device configuration is only
     // populated if a specific feature bit has been negotiated during
     // initialization, otherwise it is 0, at least in Virtio 0.9.5. Use 512
@@ -143,31 +210,36 @@ zx_status_t BlockDevice::Init() {
     // ack and set the driver status bit
     DriverStatusAck();
 
-    // XXX check features bits and ack/nak them
-
-    // allocate the main vring
-    auto err = vring_.Init(0, ring_size);
-    if (err < 0) {
-        zxlogf(ERROR, "failed to allocate vring\n");
-        return err;
+    // Put each request's scatter list in a table of its own, only kick when
+    // the device is waiting for it, and spread requests over the device's
+    // queues.
+    indirect_ = AckFeature(1u << VIRTIO_RING_F_INDIRECT_DESC);
+    bool event_idx = AckFeature(1u << VIRTIO_RING_F_EVENT_IDX);
+    num_queues_ = 1;
+    if (AckFeature(VIRTIO_BLK_F_MQ)) {
+        uint16_t num_queues;
+        ReadDeviceConfig(offsetof(virtio_blk_config_t, num_queues), &num_queues);
+        config_.num_queues = num_queues;
+        num_queues_ = fbl::clamp<uint16_t>(num_queues, 1, kMaxQueues);
     }
-
-    // allocate a queue of block requests
-    size_t size = sizeof(virtio_blk_req_t) * blk_req_count + sizeof(uint8_t) * blk_req_count;
-
-    zx_status_t r = map_contiguous_memory(size, (uintptr_t*)&blk_req_, &blk_req_pa_);
-    if (r < 0) {
-        zxlogf(ERROR, "cannot alloc blk_req buffers %d\n", r);
-        return r;
+    LTRACEF("indirect %d, event_idx %d, num_queues %u\n", indirect_, event_idx, num_queues_);
+    zx_status_t status = DeviceStatusFeaturesOk();
+    if (status != ZX_OK) {
+        zxlogf(ERROR, "%s: Feature negotiation failed (%d)\n", tag(), status);
+        return status;
     }
 
-    LTRACEF("allocated blk request at %p, physical address %#" PRIxPTR "\n", blk_req_, blk_req_pa_);
-
-    // responses are 32 words at the end of the allocated block
-    blk_res_pa_ = blk_req_pa_ + sizeof(virtio_blk_req_t) * blk_req_count;
-    blk_res_ = (uint8_t*)((uintptr_t)blk_req_ + sizeof(virtio_blk_req_t) * blk_req_count);
-
-    LTRACEF("allocated blk responses at %p, physical address %#" PRIxPTR "\n", blk_res_, blk_res_pa_);
+    // allocate the vrings, along with their block requests
+    fbl::AllocChecker ac;
+    for (uint16_t q = 0; q < num_queues_; q++) {
+        queues_[q].reset(new (&ac) Queue(this));
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        if ((status = queues_[q]->Init(q, indirect_, event_idx)) != ZX_OK) {
+            return status;
+        }
+    }
 
     // start the interrupt thread
     StartIrqThread();
@@ -191,7 +263,7 @@ zx_status_t BlockDevice::Init() {
     args.proto_id = ZX_PROTOCOL_BLOCK_CORE;
     args.proto_ops = &block_ops_;
 
-    auto status = device_add(bus_device_, &args, &device_);
+    status = device_add(bus_device_, &args, &device_);
     if (status < 0) {
         device_ = nullptr;
         return status;
@@ -203,128 +275,135 @@ zx_status_t BlockDevice::Init() {
 void BlockDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
 
-    // parse our descriptor chain, add back to the free queue
-    auto free_chain = [this](vring_used_elem* used_elem) {
-        uint32_t i = (uint16_t)used_elem->id;
-        struct vring_desc* desc = vring_.DescFromIndex((uint16_t)i);
-        auto head_desc = desc; // save the first element
-        for (;;) {
-            int next;
-            LTRACE_DO(virtio_dump_desc(desc));
-            if (desc->flags & VRING_DESC_F_NEXT) {
-                next = desc->next;
-            } else {
-                /* end of chain */
-                next = -1;
-            }
-
-            vring_.FreeDesc((uint16_t)i);
-
-            if (next < 0)
-                break;
-            i = next;
-            desc = vring_.DescFromIndex((uint16_t)i);
-        }
+    // the queues share an interrupt, so look at all of them
+    for (uint16_t q = 0; q < num_queues_; q++) {
+        Queue* queue = queues_[q].get();
+
+        // parse our descriptor chain, add back to the free queue
+        auto free_chain = [queue](vring_used_elem* used_elem) {
+            uint16_t head = (uint16_t)used_elem->id;
+            bool need_signal = false;
+            block_txn_t* txn = nullptr;
+            zx_status_t status = ZX_OK;
+            {
+                fbl::AutoLock lock(&queue->txn_lock);
+
+                uint32_t i = head;
+                struct vring_desc* desc = queue->ring.DescFromIndex((uint16_t)i);
+                for (;;) {
+                    int next;
+                    LTRACE_DO(virtio_dump_desc(desc));
+                    if (desc->flags & VRING_DESC_F_NEXT) {
+                        next = desc->next;
+                    } else {
+                        /* end of chain */
+                        next = -1;
+                    }
 
-        bool need_signal = false;
-        bool need_complete = false;
-        block_txn_t* txn = nullptr;
-        {
-            fbl::AutoLock lock(&txn_lock_);
+                    queue->ring.FreeDesc((uint16_t)i);
 
-            // search our pending txn list to see if this completes it
+                    if (next < 0)
+                        break;
+                    i = next;
+                    desc = queue->ring.DescFromIndex((uint16_t)i);
+                }
 
-            list_for_every_entry (&txn_list_, txn, block_txn_t, node) {
-                if (txn->desc == head_desc) {
+                // look up the txn this chain completes
+                txn = queue->txns[head];
+                queue->txns[head] = nullptr;
+                if (txn != nullptr) {
                     LTRACEF("completes txn %p\n", txn);
-                    free_blk_req((unsigned int)txn->index);
-                    list_delete(&txn->node);
-
-                    // we will do this outside of the lock
-                    need_complete = true;
-
-                    // check to see if QueueTxn is waiting on
-                    // resources becoming available
-                    if ((need_signal = txn_wait_)) {
-                        txn_wait_ = false;
+                    if (queue->blk_res[txn->index] != VIRTIO_BLK_S_OK) {
+                        status = ZX_ERR_IO;
                     }
-                    break;
+                    queue->FreeReq(txn->index);
+                    queue->txn_count--;
+                }
+
+                // check to see if QueueTxn is waiting on
+                // resources becoming available
+                if ((need_signal = queue->txn_wait)) {
+                    queue->txn_wait = false;
                 }
             }
-        }
 
-        if (need_signal) {
-            completion_signal(&txn_signal_);
-        }
-        if (need_complete) {
-            txn_complete(txn, ZX_OK);
-        }
-    };
+            if (need_signal) {
+                completion_signal(&queue->txn_signal);
+            }
+            if (txn != nullptr) {
+                txn_complete(txn, status);
+            }
+        };
 
-    // tell the ring to find free chains and hand it back to our lambda
-    vring_.IrqRingUpdate(free_chain);
+        // tell the ring to find free chains and hand it back to our lambda
+        queue->ring.IrqRingUpdate(free_chain);
+    }
 }
 
 void BlockDevice::IrqConfigChange() {
     LTRACE_ENTRY;
 }
 
-zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
-                           uint64_t* pages, size_t pagecount, uint16_t* idx) {
+zx_status_t BlockDevice::QueueTxn(Queue* queue, block_txn_t* txn, bool write, size_t bytes,
+                                  uint64_t* pages, size_t pagecount) {
+    fbl::AutoLock lock(&queue->txn_lock);
 
-    size_t index;
-    {
-        fbl::AutoLock lock(&txn_lock_);
-        index = alloc_blk_req();
-        if (index >= blk_req_count) {
-            LTRACEF("too many block requests queued (%zu)!\n", index);
-            return ZX_ERR_NO_RESOURCES;
-        }
+    size_t index = queue->AllocReq();
+    if (index >= blk_req_count) {
+        LTRACEF("too many block requests queued (%zu)!\n", index);
+        return ZX_ERR_NO_RESOURCES;
     }
 
-    auto req = &blk_req_[index];
+    auto req = &queue->blk_req[index];
     req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
     req->ioprio = 0;
     req->sector = txn->op.rw.offset_dev;
     LTRACEF("blk_req type %u ioprio %u sector %" PRIu64 "\n",
             req->type, req->ioprio, req->sector);
 
-    // save the req index into the txn->extra[1] slot so we can free it when we complete the transfer
+    // save the req index into the txn so we can free it when we complete the transfer
     txn->index = index;
 
-#if LOCAL_TRACE
-    LTRACEF("phys %p, phys_count %#lx\n", txn->phys, txn->phys_count);
-    for (uint64_t i = 0; i < txn->phys_count; i++) {
-        LTRACEF("phys %lu: %#lx\n", i, txn->phys[i]);
-    }
-#endif
-
     LTRACEF("page count %lu\n", pagecount);
     assert(pagecount > 0);
 
-    /* put together a transfer */
+    /* put together a transfer, in the request's own table of descriptors
+     * if we can, and otherwise in a chain of them on the ring */
     uint16_t i;
-    auto desc = vring_.AllocDescChain((uint16_t)(2u + pagecount), &i);
-    if (!desc) {
+    auto head = queue->ring.AllocDescChain(indirect_ ? 1u : (uint16_t)(2u + pagecount), &i);
+    if (!head) {
         LTRACEF("failed to allocate descriptor chain of length %zu\n", 2u + pagecount);
-        fbl::AutoLock lock(&txn_lock_);
-        free_blk_req(index);
+        queue->FreeReq(index);
         return ZX_ERR_NO_RESOURCES;
     }
 
-    LTRACEF("after alloc chain desc %p, i %u\n", desc, i);
-
-    /* point the txn at this head descriptor */
-    txn->desc = desc;
+    LTRACEF("after alloc chain desc %p, i %u\n", head, i);
+
+    struct vring_desc* table = nullptr;
+    struct vring_desc* desc = head;
+    if (indirect_) {
+        table = &queue->indirect[index * INDIRECT_DESCS];
+        head->addr = queue->indirect_pa + index * INDIRECT_DESCS * sizeof(struct vring_desc);
+        head->len = (uint32_t)((2u + pagecount) * sizeof(struct vring_desc));
+        head->flags = VRING_DESC_F_INDIRECT;
+        LTRACE_DO(virtio_dump_desc(head));
+        for (uint16_t n = 0; n < 2u + pagecount; n++) {
+            table[n].next = (uint16_t)(n + 1);
+        }
+        desc = table;
+    }
+    auto next_desc = [queue, table](struct vring_desc* desc) {
+        return table ? &table[desc->next] : queue->ring.DescFromIndex(desc->next);
+    };
 
     /* set up the descriptor pointing to the head */
-    desc->addr = blk_req_pa_ + index * sizeof(virtio_blk_req_t);
+    desc->addr = queue->blk_req_pa + index * sizeof(virtio_blk_req_t);
     desc->len = sizeof(virtio_blk_req_t);
     desc->flags = VRING_DESC_F_NEXT;
     LTRACE_DO(virtio_dump_desc(desc));
 
     for (size_t n = 0; n < pagecount; n++) {
-        desc = vring_.DescFromIndex(desc->next);
+        desc = next_desc(desc);
         desc->addr = pages[n];
         desc->len = (uint32_t) ((bytes > PAGE_SIZE) ? PAGE_SIZE : bytes);
         if (n == 0) {
@@ -352,20 +431,27 @@ zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
     assert(bytes == 0);
 
     /* set up the descriptor pointing to the response */
-    desc = vring_.DescFromIndex(desc->next);
-    desc->addr = blk_res_pa_ + index;
+    desc = next_desc(desc);
+    queue->blk_res[index] = VIRTIO_BLK_S_IOERR;
+    desc->addr = queue->blk_res_pa + index;
     desc->len = 1;
     desc->flags = VRING_DESC_F_WRITE;
     LTRACE_DO(virtio_dump_desc(desc));
 
-    *idx = i;
+    /* save the txn, and submit the transfer */
+    queue->txns[i] = txn;
+    queue->txn_count++;
+    queue->ring.SubmitChain(i);
     return ZX_OK;
 }
 
 void BlockDevice::QueueReadWriteTxn(block_txn_t* txn, bool write) {
     LTRACEF("txn %p, command %#x\n", txn, txn->op.command);
 
-    fbl::AutoLock lock(&lock_);
+    // requests go to each queue in turn
+    uint32_t q = next_queue_.fetch_add(1, fbl::memory_order_relaxed) % num_queues_;
+    Queue* queue = queues_[q].get();
+    fbl::AutoLock submit_lock(&queue->submit_lock);
 
     txn->op.rw.offset_vmo *= config_.blk_size;
 
@@ -403,22 +489,11 @@ void BlockDevice::QueueReadWriteTxn(block_txn_t* txn, bool write) {
     bool cannot_fail = false;
 
     for (;;) {
-        uint16_t idx;
-
         // attempt to setup hw txn
-        zx_status_t status = QueueTxn(txn, write, bytes, pages, pagecount, &idx);
+        zx_status_t status = QueueTxn(queue, txn, write, bytes, pages, pagecount);
         if (status == ZX_OK) {
-            fbl::AutoLock lock(&txn_lock_);
-
-            // save the txn in a list
-            list_add_tail(&txn_list_, &txn->node);
-
-            /* submit the transfer */
-            vring_.SubmitChain(idx);
-
-            /* kick it off */
-            vring_.Kick();
-
+            /* kick it off, unless the device is still working through the ring */
+            queue->ring.Kick();
             return;
         } else {
             if (cannot_fail) {
@@ -427,21 +502,21 @@ void BlockDevice::QueueReadWriteTxn(block_txn_t* txn, bool write) {
                 return;
             }
 
-            fbl::AutoLock lock(&txn_lock_);
+            fbl::AutoLock lock(&queue->txn_lock);
 
-            if (list_is_empty(&txn_list_)) {
-                // we hold the queue lock and the list is empty
+            if (queue->txn_count == 0) {
+                // we hold the queue lock and nothing is in flight
                 // if we fail this time around, no point in trying again
                 cannot_fail = true;
                 continue;
             } else {
                 // let the completer know we need to wake up
-                txn_wait_ = true;
+                queue->txn_wait = true;
             }
         }
 
-        completion_wait(&txn_signal_, ZX_TIME_INFINITE);
-        completion_reset(&txn_signal_);
+        completion_wait(&queue->txn_signal, ZX_TIME_INFINITE);
+        completion_reset(&queue->txn_signal);
     }
 }
 
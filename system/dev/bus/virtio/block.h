@@ -8,8 +8,11 @@
 
 #include <stdlib.h>
 #include <zircon/compiler.h>
+#include <zircon/thread_annotations.h>
 
 #include "backends/backend.h"
+#include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
 #include <virtio/block.h>
 #include <zircon/device/block.h>
 #include <ddk/protocol/block.h>
@@ -20,7 +23,7 @@ namespace virtio {
 
 struct block_txn_t {
     block_op_t op;
-    struct vring_desc* desc;
+    uint16_t head;
     size_t index;
     list_node_t node;
 };
@@ -53,47 +56,71 @@ private:
 
     void GetInfo(block_info_t* info);
 
-    zx_status_t QueueTxn(block_txn_t* txn, bool write, size_t bytes,
-                         uint64_t* pages, size_t pagecount, uint16_t* idx);
-    void QueueReadWriteTxn(block_txn_t* txn, bool write);
-
-    // the main virtio ring
-    Ring vring_ = {this};
-
-    static const uint16_t ring_size = 128; // 128 matches legacy pci
-
-    // saved block device configuration out of the pci config BAR
-    virtio_blk_config_t config_ = {};
-
     // a queue of block request/responses
     static const size_t blk_req_count = 32;
 
-    zx_paddr_t blk_req_pa_ = 0;
-    virtio_blk_req_t* blk_req_ = nullptr;
+    // The most queues the driver uses, when the device offers more.
+    static const uint16_t kMaxQueues = 8;
 
-    zx_paddr_t blk_res_pa_ = 0;
-    uint8_t* blk_res_ = nullptr;
+    static const uint16_t ring_size = 128; // 128 matches legacy pci
 
-    uint32_t blk_req_bitmap_ = 0;
-    static_assert(blk_req_count <= sizeof(blk_req_bitmap_) * CHAR_BIT, "");
+    // A virtqueue and the requests in flight on it.
+    struct Queue {
+        explicit Queue(Device* device) : ring(device) { completion_reset(&txn_signal); }
+
+        zx_status_t Init(uint16_t index, bool indirect, bool event_idx);
+
+        // Returns the index of a free request slot, or blk_req_count if
+        // there is none.
+        size_t AllocReq() TA_REQ(txn_lock);
+        void FreeReq(size_t i) TA_REQ(txn_lock);
+
+        Ring ring;
+
+        // Request headers, responses and, with indirect descriptors, a
+        // table of descriptors for each request slot, in one allocation.
+        uintptr_t va = 0;
+        size_t va_len = 0;
+        zx_paddr_t blk_req_pa = 0;
+        virtio_blk_req_t* blk_req = nullptr;
+        zx_paddr_t blk_res_pa = 0;
+        uint8_t* blk_res = nullptr;
+        zx_paddr_t indirect_pa = 0;
+        struct vring_desc* indirect = nullptr;
+
+        // Serializes submitters, of which only one at a time waits for
+        // resources to become available.
+        fbl::Mutex submit_lock;
+
+        // pending txns, by the descriptor heading their chain, and waiter
+        // state
+        fbl::Mutex txn_lock;
+        uint32_t blk_req_bitmap TA_GUARDED(txn_lock) = 0;
+        block_txn_t* txns[ring_size] TA_GUARDED(txn_lock) = {};
+        size_t txn_count TA_GUARDED(txn_lock) = 0;
+        bool txn_wait TA_GUARDED(txn_lock) = false;
+        completion_t txn_signal;
+
+        static_assert(blk_req_count <= sizeof(blk_req_bitmap) * CHAR_BIT, "");
+    };
+
+    // Acks the feature bits of |features| if the device offers them.
+    bool AckFeature(uint32_t features);
+
+    zx_status_t QueueTxn(Queue* queue, block_txn_t* txn, bool write, size_t bytes,
+                         uint64_t* pages, size_t pagecount);
+    void QueueReadWriteTxn(block_txn_t* txn, bool write);
 
-    size_t alloc_blk_req() {
-        size_t i = 0;
-        if (blk_req_bitmap_ != 0)
-            i = sizeof(blk_req_bitmap_) * CHAR_BIT - __builtin_clz(blk_req_bitmap_);
-        blk_req_bitmap_ |= (1 << i);
-        return i;
-    }
+    // the virtqueues, of which each request goes to the next in turn
+    fbl::unique_ptr<Queue> queues_[kMaxQueues];
+    uint16_t num_queues_ = 0;
+    fbl::atomic<uint32_t> next_queue_;
 
-    void free_blk_req(size_t i) {
-        blk_req_bitmap_ &= ~(1 << i);
-    }
+    // saved block device configuration out of the pci config BAR
+    virtio_blk_config_t config_ = {};
 
-    // pending iotxns and waiter state
-    fbl::Mutex txn_lock_;
-    list_node txn_list_ = LIST_INITIAL_VALUE(txn_list_);
-    bool txn_wait_ = false;
-    completion_t txn_signal_;
+    // A request's scatter list takes a single ring slot
+    bool indirect_ = false;
 
     block_protocol_ops_t block_ops_ = {};
 };
@@ -59,7 +59,7 @@ protected:
     // Methods for checking / acknowledging features
     bool DeviceFeatureSupported(uint32_t feature) { return backend_->ReadFeature(feature); }
     void DriverFeatureAck(uint32_t feature) { backend_->SetFeature(feature); }
-    bool DeviceStatusFeaturesOk() { return backend_->ConfirmFeatures(); }
+    zx_status_t DeviceStatusFeaturesOk() { return backend_->ConfirmFeatures(); }
 
     // Devie lifecycle methods
     void DeviceReset() { backend_->DeviceReset(); }
@@ -70,7 +70,7 @@ protected:
     // Device config management
     zx_status_t CopyDeviceConfig(void* _buf, size_t len) const;
     template <typename T>
-    T ReadDeviceConfig(uint16_t offset, T* val) { return backend_->DeviceConfigRead(offset, val); }
+    void ReadDeviceConfig(uint16_t offset, T* val) { backend_->DeviceConfigRead(offset, val); }
     template <typename T>
     void WriteDeviceConfig(uint16_t offset, T val) { backend_->DeviceConfigWrite(offset, val); }
 
@@ -23,6 +23,7 @@
 #include <virtio/virtio.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <zircon/types.h>
 
 #include "ring.h"
@@ -48,10 +49,25 @@ const size_t kL1EthHdrLen = 26;
 // The goal here is to allocate single-page I/O buffers.
 const size_t kFrameSize = sizeof(virtio_net_hdr_t) + kL1EthHdrLen + kVirtioMtu;
 const size_t kFramesInBuf = PAGE_SIZE / kFrameSize;
-const size_t kNumIoBufs = fbl::round_up(kBacklog * 2, kFramesInBuf) / kFramesInBuf;
 
-const uint16_t kRxId = 0u;
-const uint16_t kTxId = 1u;
+// Segmentation offload frames are sent on a chain of descriptors, of which
+// they may take up to half of the tx backlog.
+const size_t kTsoMax = (kBacklog / 2) * kFrameSize - sizeof(virtio_net_hdr_t);
+
+// Queue pair |q| receives on virtqueue 2q and transmits on 2q + 1; the
+// control virtqueue comes after the most pairs the device supports.
+uint16_t RxId(uint16_t q) {
+    return static_cast<uint16_t>(2 * q);
+}
+
+uint16_t TxId(uint16_t q) {
+    return static_cast<uint16_t>(2 * q + 1);
+}
+
+// The control virtqueue only ever has one command outstanding, which is
+// polled for as the device sets up.
+const uint16_t kCtrlDescs = 4u;
+const uint32_t kCtrlPolls = 100u;
 
 // Strictly for convenience...
 typedef struct vring_desc desc_t;
@@ -118,17 +134,17 @@ ethmac_protocol_ops_t kProtoOps = {
 };
 
 // I/O buffer helpers
-zx_status_t InitBuffers(fbl::unique_ptr<io_buffer_t[]>* out) {
+zx_status_t InitBuffers(size_t num_bufs, fbl::unique_ptr<io_buffer_t[]>* out) {
     zx_status_t rc;
     fbl::AllocChecker ac;
-    fbl::unique_ptr<io_buffer_t[]> bufs(new (&ac) io_buffer_t[kNumIoBufs]);
+    fbl::unique_ptr<io_buffer_t[]> bufs(new (&ac) io_buffer_t[num_bufs]);
     if (!ac.check()) {
         zxlogf(ERROR, "out of memory!\n");
         return ZX_ERR_NO_MEMORY;
     }
-    memset(bufs.get(), 0, sizeof(io_buffer_t) * kNumIoBufs);
+    memset(bufs.get(), 0, sizeof(io_buffer_t) * num_bufs);
     size_t buf_size = kFrameSize * kFramesInBuf;
-    for (uint16_t id = 0; id < kNumIoBufs; ++id) {
+    for (size_t id = 0; id < num_bufs; ++id) {
         if ((rc = io_buffer_init(&bufs[id], buf_size, IO_BUFFER_RW | IO_BUFFER_CONTIG)) != ZX_OK) {
             zxlogf(ERROR, "failed to allocate I/O buffers: %s\n", zx_status_get_string(rc));
             return rc;
@@ -138,11 +154,11 @@ zx_status_t InitBuffers(fbl::unique_ptr<io_buffer_t[]>* out) {
     return ZX_OK;
 }
 
-void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs) {
+void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs, size_t num_bufs) {
     if (!bufs) {
         return;
     }
-    for (size_t i = 0; i < kNumIoBufs; ++i) {
+    for (size_t i = 0; i < num_bufs; ++i) {
         if (io_buffer_is_valid(&bufs[i])) {
             io_buffer_release(&bufs[i]);
         }
@@ -179,8 +195,9 @@ uint8_t* GetFrameData(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id) {
 } // namespace
 
 EthernetDevice::EthernetDevice(zx_device_t* bus_device, fbl::unique_ptr<Backend> backend)
-    : Device(bus_device, fbl::move(backend)), rx_(this), tx_(this), bufs_(nullptr), unkicked_(0),
-      ifc_(nullptr), cookie_(nullptr) {
+    : Device(bus_device, fbl::move(backend)), num_pairs_(0), bufs_(nullptr), num_bufs_(0),
+      tx_csum_(false), rx_csum_(false), tso4_(false), tso6_(false), ifc_(nullptr),
+      cookie_(nullptr) {
 }
 
 EthernetDevice::~EthernetDevice() {
@@ -190,8 +207,7 @@ EthernetDevice::~EthernetDevice() {
 zx_status_t EthernetDevice::Init() {
     LTRACE_ENTRY;
     zx_status_t rc;
-    if (mtx_init(&state_lock_, mtx_plain) != thrd_success ||
-        mtx_init(&tx_lock_, mtx_plain) != thrd_success) {
+    if (mtx_init(&state_lock_, mtx_plain) != thrd_success) {
         return ZX_ERR_NO_RESOURCES;
     }
     fbl::AutoLock lock(&state_lock_);
@@ -207,45 +223,91 @@ zx_status_t EthernetDevice::Init() {
     // Ack and set the driver status bit
     DriverStatusAck();
 
-    // TODO(aarongreen): Check features bits and ack/nak them
+    // Leave checksums, and segmenting TCP, to the host where it can.
+    tx_csum_ = AckFeature(VIRTIO_NET_F_CSUM);
+    rx_csum_ = AckFeature(VIRTIO_NET_F_GUEST_CSUM);
+    tso4_ = tx_csum_ && AckFeature(VIRTIO_NET_F_HOST_TSO4);
+    tso6_ = tx_csum_ && AckFeature(VIRTIO_NET_F_HOST_TSO6);
+    // Only kick, or take interrupts, when the other side is waiting for it.
+    bool event_idx = AckFeature(1u << VIRTIO_RING_F_EVENT_IDX);
+    // Spread traffic over as many queue pairs as the device and the generic
+    // Ethernet driver can handle.
+    num_pairs_ = 1;
+    if (AckFeature(VIRTIO_NET_F_MQ) && AckFeature(VIRTIO_NET_F_CTRL_VQ) &&
+        config_.max_virtqueue_pairs > 1) {
+        num_pairs_ = fbl::min<uint16_t>(config_.max_virtqueue_pairs, ETH_MAX_QUEUES);
+    }
+    if ((rc = DeviceStatusFeaturesOk()) != ZX_OK) {
+        zxlogf(ERROR, "%s: Feature negotiation failed (%d)\n", tag(), rc);
+        return rc;
+    }
 
     // Plan to clean up unless everything goes right.
     auto cleanup = fbl::MakeAutoCall([this]() { Release(); });
 
     // Allocate I/O buffers and virtqueues.
     uint16_t num_descs = static_cast<uint16_t>(kBacklog & 0xffff);
-    if ((rc = InitBuffers(&bufs_)) != ZX_OK || (rc = rx_.Init(kRxId, num_descs)) != ZX_OK ||
-        (rc = tx_.Init(kTxId, num_descs)) != ZX_OK) {
-        zxlogf(ERROR, "failed to allocate virtqueue: %s\n", zx_status_get_string(rc));
+    num_bufs_ = fbl::round_up(kBacklog * 2 * num_pairs_, kFramesInBuf) / kFramesInBuf;
+    if ((rc = InitBuffers(num_bufs_, &bufs_)) != ZX_OK) {
         return rc;
     }
+    fbl::AllocChecker ac;
+    for (uint16_t q = 0; q < num_pairs_; ++q) {
+        pairs_[q].reset(new (&ac) QueuePair(this));
+        if (!ac.check()) {
+            zxlogf(ERROR, "out of memory!\n");
+            return ZX_ERR_NO_MEMORY;
+        }
+        QueuePair* pair = pairs_[q].get();
+        if ((rc = pair->rx.Init(RxId(q), num_descs)) != ZX_OK ||
+            (rc = pair->tx.Init(TxId(q), num_descs)) != ZX_OK) {
+            zxlogf(ERROR, "failed to allocate virtqueue: %s\n", zx_status_get_string(rc));
+            return rc;
+        }
+        pair->rx.SetEventIdx(event_idx);
+        pair->tx.SetEventIdx(event_idx);
+
+        // Associate the I/O buffers with the virtqueue descriptors
+        desc_t* desc = nullptr;
+        uint16_t id;
+
+        // For rx buffers, we queue a bunch of "reads" from the network that
+        // complete when packets arrive.
+        for (uint16_t i = 0; i < num_descs; ++i) {
+            desc = pair->rx.AllocDescChain(1, &id);
+            desc->addr = GetFramePhys(bufs_.get(), RxId(q), id);
+            desc->len = kFrameSize;
+            desc->flags |= VRING_DESC_F_WRITE;
+            LTRACE_DO(virtio_dump_desc(desc));
+            pair->rx.SubmitChain(id);
+        }
 
-    // Associate the I/O buffers with the virtqueue descriptors
-    desc_t* desc = nullptr;
-    uint16_t id;
-
-    // For rx buffers, we queue a bunch of "reads" from the network that
-    // complete when packets arrive.
-    for (uint16_t i = 0; i < num_descs; ++i) {
-        desc = rx_.AllocDescChain(1, &id);
-        desc->addr = GetFramePhys(bufs_.get(), kRxId, id);
-        desc->len = kFrameSize;
-        desc->flags |= VRING_DESC_F_WRITE;
-        LTRACE_DO(virtio_dump_desc(desc));
-        rx_.SubmitChain(id);
+        // For tx buffers, we hold onto them until we need to send a packet,
+        // reclaiming them when we run out rather than on an interrupt.
+        for (uint16_t id = 0; id < num_descs; ++id) {
+            desc = pair->tx.DescFromIndex(id);
+            desc->addr = GetFramePhys(bufs_.get(), TxId(q), id);
+            desc->len = 0;
+            desc->flags &= static_cast<uint16_t>(~VRING_DESC_F_WRITE);
+            LTRACE_DO(virtio_dump_desc(desc));
+        }
+        pair->tx.SuppressInterrupts();
     }
 
-    // For tx buffers, we hold onto them until we need to send a packet.
-    for (uint16_t id = 0; id < num_descs; ++id) {
-        desc = tx_.DescFromIndex(id);
-        desc->addr = GetFramePhys(bufs_.get(), kTxId, id);
-        desc->len = 0;
-        desc->flags &= static_cast<uint16_t>(~VRING_DESC_F_WRITE);
-        LTRACE_DO(virtio_dump_desc(desc));
+    // Set the driver OK status, after which the device starts out using only
+    // the first queue pair until told otherwise.
+    DriverStatusOk();
+    if (num_pairs_ > 1 && (rc = SetQueuePairs(num_pairs_)) != ZX_OK) {
+        zxlogf(ERROR, "%s: failed to use %u queue pairs: %s\n", tag(), num_pairs_,
+               zx_status_get_string(rc));
+        num_pairs_ = 1;
     }
 
-    // Start the interrupt thread and set the driver OK status
+    // Start the interrupt thread, and give the rx buffers to the host
     StartIrqThread();
+    for (uint16_t q = 0; q < num_pairs_; ++q) {
+        pairs_[q]->rx.Kick();
+    }
 
     // Initialize the zx_device and publish us
     device_add_args_t args;
@@ -260,12 +322,9 @@ zx_status_t EthernetDevice::Init() {
         zxlogf(ERROR, "failed to add device: %s\n", zx_status_get_string(rc));
         return rc;
     }
-    // Give the rx buffers to the host
-    rx_.Kick();
 
     // Woohoo! Driver should be ready.
     cleanup.cancel();
-    DriverStatusOk();
     return ZX_OK;
 }
 
@@ -275,41 +334,139 @@ void EthernetDevice::Release() {
     ReleaseLocked();
 }
 
+bool EthernetDevice::AckFeature(uint32_t feature) {
+    uint32_t bit = static_cast<uint32_t>(__builtin_ctz(feature));
+    if (!DeviceFeatureSupported(bit)) {
+        return false;
+    }
+    DriverFeatureAck(bit);
+    return true;
+}
+
+zx_status_t EthernetDevice::SetQueuePairs(uint16_t pairs) {
+    zx_status_t rc;
+    fbl::AllocChecker ac;
+    ctrl_.reset(new (&ac) Ring(this));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint16_t ctrl_id = static_cast<uint16_t>(2 * config_.max_virtqueue_pairs);
+    if ((rc = ctrl_->Init(ctrl_id, kCtrlDescs)) != ZX_OK) {
+        return rc;
+    }
+    ctrl_->SuppressInterrupts();
+
+    // The command is the header and its data, followed by a byte for the
+    // device to acknowledge it in.
+    io_buffer_t buf;
+    if ((rc = io_buffer_init(&buf, PAGE_SIZE, IO_BUFFER_RW | IO_BUFFER_CONTIG)) != ZX_OK) {
+        return rc;
+    }
+    auto release = fbl::MakeAutoCall([&buf]() { io_buffer_release(&buf); });
+    uint8_t* virt = static_cast<uint8_t*>(io_buffer_virt(&buf));
+    auto hdr = reinterpret_cast<virtio_net_ctrl_hdr_t*>(virt);
+    auto mq = reinterpret_cast<virtio_net_ctrl_mq_t*>(virt + sizeof(*hdr));
+    auto ack = reinterpret_cast<volatile uint8_t*>(virt + sizeof(*hdr) + sizeof(*mq));
+    hdr->ctrl_class = VIRTIO_NET_CTRL_MQ;
+    hdr->cmd = VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET;
+    mq->virtqueue_pairs = pairs;
+    *ack = VIRTIO_NET_ERR;
+
+    uint16_t head;
+    desc_t* desc = ctrl_->AllocDescChain(2, &head);
+    desc->addr = io_buffer_phys(&buf);
+    desc->len = static_cast<uint32_t>(sizeof(*hdr) + sizeof(*mq));
+    desc = ctrl_->DescFromIndex(desc->next);
+    desc->addr = io_buffer_phys(&buf) + sizeof(*hdr) + sizeof(*mq);
+    desc->len = sizeof(*ack);
+    desc->flags |= VRING_DESC_F_WRITE;
+    ctrl_->SubmitChain(head);
+    ctrl_->Kick();
+
+    bool done = false;
+    for (uint32_t i = 0; i < kCtrlPolls && !done; ++i) {
+        ctrl_->IrqRingUpdate([this, &done](vring_used_elem* used_elem) {
+            uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
+            ctrl_->FreeDesc(ctrl_->DescFromIndex(id)->next);
+            ctrl_->FreeDesc(id);
+            done = true;
+        });
+        if (!done) {
+            zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+        }
+    }
+    if (!done) {
+        return ZX_ERR_TIMED_OUT;
+    }
+    return *ack == VIRTIO_NET_OK ? ZX_OK : ZX_ERR_IO;
+}
+
 void EthernetDevice::ReleaseLocked() {
     ifc_ = nullptr;
-    ReleaseBuffers(fbl::move(bufs_));
+    ReleaseBuffers(fbl::move(bufs_), num_bufs_);
     Device::Release();
 }
 
 void EthernetDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
+    // The queue pairs share an interrupt, so look at all of them.
+    for (uint16_t q = 0; q < num_pairs_; ++q) {
+        RxRingUpdate(q);
+    }
+}
+
+void EthernetDevice::RxRingUpdate(uint16_t q) {
+    Ring& rx = pairs_[q]->rx;
     // Lock to prevent changes to ifc_.
     {
         fbl::AutoLock lock(&state_lock_);
-        if (!ifc_) {
-            return;
-        }
         // Ring::IrqRingUpdate will call this lambda on each rx buffer filled by
-        // the underlying device since the last IRQ.
+        // the underlying device since the last IRQ, which are handed up
+        // together before any of them are reused.  Frames arriving while
+        // stopped are dropped, so that the device goes on interrupting.
         // Thread safety analysis is explicitly disabled as clang isn't able to determine that the
         // state_lock_ is  held when the lambda invoked.
-        rx_.IrqRingUpdate([this](vring_used_elem* used_elem) TA_NO_THREAD_SAFETY_ANALYSIS {
+        ethmac_rx_frame_t frames[kBacklog];
+        uint16_t ids[kBacklog];
+        size_t count = 0;
+        rx.IrqRingUpdate([&](vring_used_elem* used_elem) TA_NO_THREAD_SAFETY_ANALYSIS {
             uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
-            desc_t* desc = rx_.DescFromIndex(id);
+            desc_t* desc = rx.DescFromIndex(id);
 
             // Transitional driver does not merge rx buffers.
             assert(used_elem->len < desc->len);
-            uint8_t* data = GetFrameData(bufs_.get(), kRxId, id);
+            assert((desc->flags & VRING_DESC_F_NEXT) == 0);
+            LTRACE_DO(virtio_dump_desc(desc));
+            uint8_t* data = GetFrameData(bufs_.get(), RxId(q), id);
             size_t len = used_elem->len - sizeof(virtio_net_hdr_t);
             LTRACEF("Receiving %zu bytes:\n", len);
             LTRACE_DO(hexdump8_ex(data, len, 0));
 
-            // Pass the data up the stack to the generic Ethernet driver
-            ifc_->recv(cookie_, data, len, 0);
-            assert((desc->flags & VRING_DESC_F_NEXT) == 0);
-            LTRACE_DO(virtio_dump_desc(desc));
-            rx_.FreeDesc(id);
+            virtio_net_hdr_t* hdr = GetFrameHdr(bufs_.get(), RxId(q), id);
+            frames[count].data = data;
+            frames[count].length = len;
+            frames[count].flags = (hdr->flags & VIRTIO_NET_HDR_F_DATA_VALID) ? ETHMAC_RX_CSUM_OK : 0;
+            ids[count++] = id;
         });
+
+        // Pass the data up the stack to the generic Ethernet driver
+        if (ifc_ && count > 0) {
+            if (ifc_->recv_batch) {
+                ifc_->recv_batch(cookie_, q, frames, count);
+            } else {
+                for (size_t i = 0; i < count; ++i) {
+                    if (num_pairs_ > 1) {
+                        ifc_->recv_queue(cookie_, q, frames[i].data, frames[i].length,
+                                         frames[i].flags);
+                    } else {
+                        ifc_->recv(cookie_, frames[i].data, frames[i].length, frames[i].flags);
+                    }
+                }
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            rx.FreeDesc(ids[i]);
+        }
     }
 
     // Now recycle the rx buffers.  As in Init(), this means queuing a bunch of
@@ -317,15 +474,16 @@ void EthernetDevice::IrqRingUpdate() {
     desc_t* desc = nullptr;
     uint16_t id;
     bool need_kick = false;
-    while ((desc = rx_.AllocDescChain(1, &id))) {
+    while ((desc = rx.AllocDescChain(1, &id))) {
         desc->len = kFrameSize;
-        rx_.SubmitChain(id);
+        rx.SubmitChain(id);
         need_kick = true;
     }
 
-    // If we have re-queued any rx buffers, poke the virtqueue to pick them up.
+    // If we have re-queued any rx buffers, poke the virtqueue to pick them up
+    // with a single kick, if the device is waiting for one.
     if (need_kick) {
-        rx_.Kick();
+        rx.Kick();
     }
 }
 
@@ -348,7 +506,21 @@ zx_status_t EthernetDevice::Query(uint32_t options, ethmac_info_t* info) {
     }
     fbl::AutoLock lock(&state_lock_);
     if (info) {
-        // TODO(aarongreen): Add info->features = GetFeatures();
+        memset(info, 0, sizeof(*info));
+        if (tx_csum_) {
+            info->features |= ETHMAC_FEATURE_TX_CSUM;
+        }
+        if (rx_csum_) {
+            info->features |= ETHMAC_FEATURE_RX_CSUM;
+        }
+        if (tso4_ || tso6_) {
+            info->features |= ETHMAC_FEATURE_TSO;
+            info->tso_max = kTsoMax;
+        }
+        if (num_pairs_ > 1) {
+            info->features |= ETHMAC_FEATURE_MULTIQUEUE;
+            info->queues = num_pairs_;
+        }
         info->mtu = kVirtioMtu;
         memcpy(info->mac, config_.mac, sizeof(info->mac));
     }
@@ -380,52 +552,109 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
     LTRACE_ENTRY;
     void* data = netbuf->data;
     size_t length = netbuf->len;
+    const eth_offload_t& offload = netbuf->offload;
+    uint8_t gso_type = VIRTIO_NET_HDR_GSO_NONE;
+    if (offload.flags & ETH_OFFLOAD_TSO4) {
+        gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+    } else if (offload.flags & ETH_OFFLOAD_TSO6) {
+        gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+    }
     // First, validate the packet
-    if (!data || length > sizeof(virtio_net_hdr_t) + kVirtioMtu) {
+    if (!data || length > (gso_type != VIRTIO_NET_HDR_GSO_NONE ? kTsoMax :
+                           sizeof(virtio_net_hdr_t) + kVirtioMtu)) {
         LTRACEF("dropping packet; invalid packet\n");
         return ZX_ERR_INVALID_ARGS;
     }
+    if ((gso_type == VIRTIO_NET_HDR_GSO_TCPV4 && !tso4_) ||
+        (gso_type == VIRTIO_NET_HDR_GSO_TCPV6 && !tso6_)) {
+        LTRACEF("dropping packet; segmentation not negotiated\n");
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    // Frames too big for one descriptor's buffer go on a chain of them.
+    uint16_t num_descs = static_cast<uint16_t>(
+        fbl::round_up(sizeof(virtio_net_hdr_t) + length, kFrameSize) / kFrameSize);
 
-    fbl::AutoLock lock(&tx_lock_);
+    uint16_t q = static_cast<uint16_t>(ETHMAC_TX_OPT_GET_QUEUE(options) % num_pairs_);
+    QueuePair* pair = pairs_[q].get();
+    Ring& tx = pair->tx;
+    fbl::AutoLock lock(&pair->tx_lock);
 
     // Flush outstanding descriptors.  Ring::IrqRingUpdate will call this lambda
     // on each sent tx_buffer, allowing us to reclaim them.
-    auto flush = [this](vring_used_elem* used_elem) {
+    auto flush = [&tx](vring_used_elem* used_elem) {
         uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
-        desc_t* desc = tx_.DescFromIndex(id);
-        assert((desc->flags & VRING_DESC_F_NEXT) == 0);
-        LTRACE_DO(virtio_dump_desc(desc));
-        tx_.FreeDesc(id);
+        for (;;) {
+            desc_t* desc = tx.DescFromIndex(id);
+            bool more = (desc->flags & VRING_DESC_F_NEXT) != 0;
+            uint16_t next = desc->next;
+            LTRACE_DO(virtio_dump_desc(desc));
+            tx.FreeDesc(id);
+            if (!more) {
+                break;
+            }
+            id = next;
+        }
     };
 
-    // Grab a free descriptor
-    uint16_t id;
-    desc_t* desc = tx_.AllocDescChain(1, &id);
+    // Grab free descriptors
+    uint16_t head;
+    desc_t* desc = tx.AllocDescChain(num_descs, &head);
     if (!desc) {
-        tx_.IrqRingUpdate(flush);
-        desc = tx_.AllocDescChain(1, &id);
+        tx.IrqRingUpdate(flush);
+        desc = tx.AllocDescChain(num_descs, &head);
     }
     if (!desc) {
         LTRACEF("dropping packet; out of descriptors\n");
         return ZX_ERR_NO_RESOURCES;
     }
 
-    // Add the data to be sent
-    void* tx_hdr = GetFrameHdr(bufs_.get(), kTxId, id);
+    // Add the header, asking the host to finish the checksum or segment the
+    // frame as requested
+    virtio_net_hdr_t* tx_hdr = GetFrameHdr(bufs_.get(), TxId(q), head);
     memset(tx_hdr, 0, sizeof(virtio_net_hdr_t));
-    void* tx_buf = GetFrameData(bufs_.get(), kTxId, id);
-    memcpy(tx_buf, data, length);
-    desc->len = static_cast<uint32_t>(sizeof(virtio_net_hdr_t) + length);
+    if (offload.flags & ETH_OFFLOAD_CSUM) {
+        tx_hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        tx_hdr->csum_start = offload.csum_start;
+        tx_hdr->csum_offset = offload.csum_offset;
+    }
+    if (gso_type != VIRTIO_NET_HDR_GSO_NONE) {
+        tx_hdr->gso_type = gso_type;
+        tx_hdr->hdr_len = offload.hdr_len;
+        tx_hdr->gso_size = offload.mss;
+    }
+
+    // Add the data to be sent, following the header
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    size_t remaining = length;
+    uint16_t id = head;
+    size_t room = kFrameSize - sizeof(virtio_net_hdr_t);
+    uint8_t* tx_buf = GetFrameData(bufs_.get(), TxId(q), id);
+    desc->len = static_cast<uint32_t>(sizeof(virtio_net_hdr_t));
+    for (;;) {
+        size_t chunk = fbl::min(remaining, room);
+        memcpy(tx_buf, src, chunk);
+        desc->len += static_cast<uint32_t>(chunk);
+        src += chunk;
+        remaining -= chunk;
+        LTRACE_DO(virtio_dump_desc(desc));
+        if (remaining == 0) {
+            break;
+        }
+        id = desc->next;
+        desc = tx.DescFromIndex(id);
+        tx_buf = static_cast<uint8_t*>(GetFrameVirt(bufs_.get(), TxId(q), id));
+        desc->len = 0;
+        room = kFrameSize;
+    }
 
-    // Submit the descriptor and notify the back-end.
-    LTRACE_DO(virtio_dump_desc(desc));
+    // Submit the descriptors and notify the back-end.
     LTRACEF("Sending %zu bytes:\n", length);
-    LTRACE_DO(hexdump8_ex(tx_buf, length, 0));
-    tx_.SubmitChain(id);
-    ++unkicked_;
-    if ((options & ETHMAC_TX_OPT_MORE) == 0 || unkicked_ > kBacklog / 2) {
-        tx_.Kick();
-        unkicked_ = 0;
+    LTRACE_DO(hexdump8_ex(data, length, 0));
+    tx.SubmitChain(head);
+    ++pair->unkicked;
+    if ((options & ETHMAC_TX_OPT_MORE) == 0 || pair->unkicked > kBacklog / 2) {
+        tx.Kick();
+        pair->unkicked = 0;
     }
     return ZX_OK;
 }
@@ -14,6 +14,7 @@
 #include <ddk/io-buffer.h>
 #include <ddk/protocol/ethernet.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
 #include <virtio/net.h>
 #include <zircon/compiler.h>
@@ -49,22 +50,47 @@ private:
     // DDK device hooks; see ddk/device.h
     void ReleaseLocked() TA_REQ(state_lock_);
 
+    // Acks the VIRTIO_NET_F_ |feature| if the device offers it.
+    bool AckFeature(uint32_t feature);
+
+    // Asks the device to use |pairs| queue pairs, with a command on the
+    // control virtqueue.
+    zx_status_t SetQueuePairs(uint16_t pairs) TA_REQ(state_lock_);
+
+    // Hands up the frames received on queue pair |q| and gives their buffers
+    // back to the device.
+    void RxRingUpdate(uint16_t q) TA_EXCL(state_lock_);
+
     // Mutexes to control concurrent access
     mtx_t state_lock_;
-    mtx_t tx_lock_;
 
     // Virtqueues; see section 5.1.2 of the spec
-    // This driver doesn't currently support multi-queueing, automatic
-    // steering, or the control virtqueue, so only a single queue is needed in
-    // each direction.
-    Ring rx_;
-    Ring tx_;
+    // Each pair has a receive and a transmit queue, among which the device
+    // steers flows when there's more than one; they all share an interrupt.
+    struct QueuePair {
+        explicit QueuePair(Device* device) : rx(device), tx(device) {}
+
+        Ring rx;
+        Ring tx;
+        fbl::Mutex tx_lock;
+        size_t unkicked TA_GUARDED(tx_lock) = 0;
+    };
+    fbl::unique_ptr<QueuePair> pairs_[ETH_MAX_QUEUES];
+    uint16_t num_pairs_;
+    // Only used to set up multiqueueing.
+    fbl::unique_ptr<Ring> ctrl_;
     fbl::unique_ptr<io_buffer_t[]> bufs_;
-    size_t unkicked_ TA_GUARDED(tx_lock_);
+    size_t num_bufs_;
 
     // Saved net device configuration out of the pci config BAR
     virtio_net_config_t config_ TA_GUARDED(state_lock_);
 
+    // Offloads negotiated with the device
+    bool tx_csum_;
+    bool rx_csum_;
+    bool tso4_;
+    bool tso6_;
+
     // Ethmac callback interface; see ddk/protocol/ethernet.h
     ethmac_ifc_t* ifc_ TA_GUARDED(state_lock_);
     void* cookie_;
@@ -7,6 +7,9 @@
 #include <assert.h>
 #include <ddk/debug.h>
 #include <ddk/debug.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/array.h>
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
@@ -26,6 +29,32 @@
 
 namespace virtio {
 
+namespace {
+
+// Room in the request buffer for a batch of commands and their responses,
+// and for attaching an image of a few thousand scattered pages.
+constexpr size_t kRequestBufferSize = 16 * PAGE_SIZE;
+
+// Each command takes two descriptors, of the 16 in the ring.
+constexpr size_t kMaxBatch = 8;
+
+void union_rect(virtio_gpu_rect* r, const virtio_gpu_rect& other) {
+    if (other.width == 0 || other.height == 0)
+        return;
+    if (r->width == 0 || r->height == 0) {
+        *r = other;
+        return;
+    }
+    uint32_t x1 = fbl::max(r->x + r->width, other.x + other.width);
+    uint32_t y1 = fbl::max(r->y + r->height, other.y + other.height);
+    r->x = fbl::min(r->x, other.x);
+    r->y = fbl::min(r->y, other.y);
+    r->width = x1 - r->x;
+    r->height = y1 - r->y;
+}
+
+} // namespace
+
 // DDK level ops
 
 // queue an iotxn. iotxn's are always completed by its complete() op
@@ -77,6 +106,32 @@ void GpuDevice::virtio_gpu_flush(void* ctx) {
     gd->Flush();
 }
 
+void GpuDevice::virtio_gpu_flush_region(void* ctx, uint32_t x, uint32_t y,
+                                        uint32_t width, uint32_t height) {
+    GpuDevice* gd = static_cast<GpuDevice*>(ctx);
+
+    LTRACEF("dev %p, x %u y %u w %u h %u\n", gd, x, y, width, height);
+
+    gd->FlushRegion(x, y, width, height);
+}
+
+zx_status_t GpuDevice::virtio_gpu_import_vmo(void* ctx, zx_handle_t vmo, void** image) {
+    return static_cast<GpuDevice*>(ctx)->ImportVmo(vmo, image);
+}
+
+void GpuDevice::virtio_gpu_release_image(void* ctx, void* image) {
+    static_cast<GpuDevice*>(ctx)->ReleaseImage(image);
+}
+
+zx_status_t GpuDevice::virtio_gpu_flip(void* ctx, void* image) {
+    return static_cast<GpuDevice*>(ctx)->Flip(image);
+}
+
+void GpuDevice::virtio_gpu_set_flip_callback(void* ctx, zx_display_flip_cb_t callback,
+                                             void* cookie) {
+    static_cast<GpuDevice*>(ctx)->SetFlipCallback(callback, cookie);
+}
+
 GpuDevice::GpuDevice(zx_device_t* bus_device, fbl::unique_ptr<Backend> backend)
     : Device(bus_device, fbl::move(backend)) {
     sem_init(&request_sem_, 0, 1);
@@ -91,48 +146,69 @@ GpuDevice::~GpuDevice() {
     cnd_destroy(&flush_cond_);
 }
 
-zx_status_t GpuDevice::send_command_response(const void* cmd, size_t cmd_len, void** _res, size_t res_len) {
-    LTRACEF("dev %p, cmd %p, cmd_len %zu, res %p, res_len %zu\n", this, cmd, cmd_len, _res, res_len);
+// Sends a batch of commands with a single kick, and waits for all of their
+// responses. The responses stay valid until the next batch is sent.
+zx_status_t GpuDevice::send_commands(const Command* cmds, size_t count) {
+    LTRACEF("dev %p, cmds %p, count %zu\n", this, cmds, count);
+
+    if (count == 0 || count > kMaxBatch)
+        return ZX_ERR_INVALID_ARGS;
 
-    /* Keep this single message at a time */
+    /* Keep this single batch at a time */
     sem_wait(&request_sem_);
-    fbl::MakeAutoCall([this]() { sem_post(&request_sem_); });
+    auto ac = fbl::MakeAutoCall([this]() { sem_post(&request_sem_); });
 
-    uint16_t i;
-    struct vring_desc* desc = vring_.AllocDescChain(2, &i);
-    assert(desc);
+    /* lay the requests and responses out one after another in the buffer */
+    size_t offset = 0;
+    for (size_t c = 0; c < count; c++) {
+        size_t res_offset = fbl::round_up(offset + cmds[c].cmd_len, 8u);
+        size_t next = fbl::round_up(res_offset + cmds[c].res_len, 8u);
+        if (next > kRequestBufferSize)
+            return ZX_ERR_BUFFER_TOO_SMALL;
 
-    memcpy(gpu_req_, cmd, cmd_len);
+        uint16_t i;
+        struct vring_desc* desc = vring_.AllocDescChain(2, &i);
+        assert(desc);
 
-    desc->addr = gpu_req_pa_;
-    desc->len = (uint32_t)cmd_len;
-    desc->flags |= VRING_DESC_F_NEXT;
+        memcpy((uint8_t*)gpu_req_ + offset, cmds[c].cmd, cmds[c].cmd_len);
 
-    /* set the second descriptor to the response with the write bit set */
-    desc = vring_.DescFromIndex(desc->next);
-    assert(desc);
+        desc->addr = gpu_req_pa_ + offset;
+        desc->len = (uint32_t)cmds[c].cmd_len;
+        desc->flags |= VRING_DESC_F_NEXT;
 
-    void* res = (void*)((uint8_t*)gpu_req_ + cmd_len);
-    *_res = res;
-    zx_paddr_t res_phys = gpu_req_pa_ + cmd_len;
-    memset(res, 0, res_len);
+        /* set the second descriptor to the response with the write bit set */
+        desc = vring_.DescFromIndex(desc->next);
+        assert(desc);
 
-    desc->addr = res_phys;
-    desc->len = (uint32_t)res_len;
-    desc->flags = VRING_DESC_F_WRITE;
+        void* res = (uint8_t*)gpu_req_ + res_offset;
+        *cmds[c].res = res;
+        memset(res, 0, cmds[c].res_len);
 
-    /* submit the transfer */
-    vring_.SubmitChain(i);
+        desc->addr = gpu_req_pa_ + res_offset;
+        desc->len = (uint32_t)cmds[c].res_len;
+        desc->flags = VRING_DESC_F_WRITE;
 
-    /* kick it off */
+        /* submit the transfer */
+        vring_.SubmitChain(i);
+
+        offset = next;
+    }
+
+    /* kick them all off at once */
     vring_.Kick();
 
-    /* wait for result */
-    sem_wait(&response_sem_);
+    /* wait for every result */
+    for (size_t c = 0; c < count; c++)
+        sem_wait(&response_sem_);
 
     return ZX_OK;
 }
 
+zx_status_t GpuDevice::send_command_response(const void* cmd, size_t cmd_len, void** _res, size_t res_len) {
+    const Command command = {cmd, cmd_len, _res, res_len};
+    return send_commands(&command, 1);
+}
+
 zx_status_t GpuDevice::get_display_info() {
     LTRACEF("dev %p\n", this);
 
@@ -170,6 +246,29 @@ zx_status_t GpuDevice::get_display_info() {
     return ZX_OK;
 }
 
+zx_status_t GpuDevice::get_capset_info() {
+    LTRACEF("dev %p, num_capsets %u\n", this, num_capsets_);
+
+    for (uint32_t index = 0; index < num_capsets_; index++) {
+        virtio_gpu_get_capset_info req;
+        memset(&req, 0, sizeof(req));
+        req.hdr.type = VIRTIO_GPU_CMD_GET_CAPSET_INFO;
+        req.capset_index = index;
+
+        virtio_gpu_resp_capset_info* info;
+        auto err = send_command_response(&req, sizeof(req), (void**)&info, sizeof(*info));
+        if (err < ZX_OK)
+            return err;
+        if (info->hdr.type != VIRTIO_GPU_RESP_OK_CAPSET_INFO)
+            return ZX_ERR_NOT_SUPPORTED;
+
+        zxlogf(INFO, "%s: capset %u: id %u max version %u max size %u\n", tag(), index,
+               info->capset_id, info->capset_max_version, info->capset_max_size);
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t GpuDevice::allocate_2d_resource(uint32_t* resource_id, uint32_t width, uint32_t height) {
     LTRACEF("dev %p\n", this);
 
@@ -198,29 +297,31 @@ zx_status_t GpuDevice::allocate_2d_resource(uint32_t* resource_id, uint32_t widt
     return err;
 }
 
-zx_status_t GpuDevice::attach_backing(uint32_t resource_id, zx_paddr_t ptr, size_t buf_len) {
-    LTRACEF("dev %p, resource_id %u, ptr %#" PRIxPTR ", buf_len %zu\n", this, resource_id, ptr, buf_len);
-
-    assert(ptr);
+zx_status_t GpuDevice::attach_backing(uint32_t resource_id, const virtio_gpu_mem_entry* entries,
+                                      uint32_t nr_entries) {
+    LTRACEF("dev %p, resource_id %u, nr_entries %u\n", this, resource_id, nr_entries);
 
-    /* construct the request */
-    struct {
-        struct virtio_gpu_resource_attach_backing req;
-        struct virtio_gpu_mem_entry mem;
-    } req;
-    memset(&req, 0, sizeof(req));
+    assert(nr_entries > 0);
 
-    req.req.hdr.type = VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING;
-    req.req.resource_id = resource_id;
-    req.req.nr_entries = 1;
+    /* construct the request, with the entries following it */
+    size_t len = sizeof(virtio_gpu_resource_attach_backing) + nr_entries * sizeof(*entries);
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> buf(new (&ac) uint8_t[len], len);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
 
-    req.mem.addr = ptr;
-    req.mem.length = (uint32_t)buf_len;
+    auto req = reinterpret_cast<virtio_gpu_resource_attach_backing*>(buf.get());
+    memset(req, 0, sizeof(*req));
+    req->hdr.type = VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING;
+    req->resource_id = resource_id;
+    req->nr_entries = nr_entries;
+    memcpy(req + 1, entries, nr_entries * sizeof(*entries));
 
     /* send the command and get a response */
     struct virtio_gpu_ctrl_hdr* res;
-    auto err = send_command_response(&req, sizeof(req), (void**)&res, sizeof(*res));
-    assert(err == ZX_OK);
+    auto err = send_command_response(buf.get(), len, (void**)&res, sizeof(*res));
+    if (err < ZX_OK)
+        return err;
 
     /* see if we got a valid response */
     LTRACEF("response type 0x%x\n", res->type);
@@ -229,6 +330,72 @@ zx_status_t GpuDevice::attach_backing(uint32_t resource_id, zx_paddr_t ptr, size
     return err;
 }
 
+// Backs a resource with the first |len| bytes of |vmo|, one entry for each
+// physically contiguous run of its pages.
+zx_status_t GpuDevice::attach_vmo_backing(uint32_t resource_id, const zx::vmo& vmo, size_t len) {
+    auto status = vmo.op_range(ZX_VMO_OP_COMMIT, 0, len, nullptr, 0);
+    if (status != ZX_OK)
+        return status;
+
+    size_t num_pages = fbl::round_up(len, (size_t)PAGE_SIZE) / PAGE_SIZE;
+    fbl::AllocChecker ac;
+    fbl::Array<virtio_gpu_mem_entry> entries(new (&ac) virtio_gpu_mem_entry[num_pages], num_pages);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    constexpr size_t kLookupPages = PAGE_SIZE / sizeof(zx_paddr_t);
+    zx_paddr_t paddrs[kLookupPages];
+    uint32_t nr_entries = 0;
+    for (size_t page = 0; page < num_pages; page += kLookupPages) {
+        size_t count = fbl::min(num_pages - page, kLookupPages);
+        status = vmo.op_range(ZX_VMO_OP_LOOKUP, page * PAGE_SIZE, count * PAGE_SIZE,
+                              paddrs, count * sizeof(zx_paddr_t));
+        if (status != ZX_OK)
+            return status;
+
+        for (size_t j = 0; j < count; j++) {
+            uint32_t length = (uint32_t)fbl::min(len - (page + j) * PAGE_SIZE, (size_t)PAGE_SIZE);
+            virtio_gpu_mem_entry* last = nr_entries ? &entries[nr_entries - 1] : nullptr;
+            if (last && last->addr + last->length == paddrs[j]) {
+                last->length += length;
+            } else {
+                entries[nr_entries++] = {paddrs[j], length, 0};
+            }
+        }
+    }
+
+    return attach_backing(resource_id, entries.get(), nr_entries);
+}
+
+zx_status_t GpuDevice::destroy_resource(uint32_t resource_id) {
+    LTRACEF("dev %p, resource_id %u\n", this, resource_id);
+
+    virtio_gpu_resource_detach_backing detach;
+    memset(&detach, 0, sizeof(detach));
+    detach.hdr.type = VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING;
+    detach.resource_id = resource_id;
+
+    virtio_gpu_resource_unref unref;
+    memset(&unref, 0, sizeof(unref));
+    unref.hdr.type = VIRTIO_GPU_CMD_RESOURCE_UNREF;
+    unref.resource_id = resource_id;
+
+    virtio_gpu_ctrl_hdr* res[2];
+    const Command cmds[] = {
+        {&detach, sizeof(detach), (void**)&res[0], sizeof(*res[0])},
+        {&unref, sizeof(unref), (void**)&res[1], sizeof(*res[1])},
+    };
+    auto err = send_commands(cmds, countof(cmds));
+    if (err < ZX_OK)
+        return err;
+
+    for (auto r : res) {
+        if (r->type != VIRTIO_GPU_RESP_OK_NODATA)
+            return ZX_ERR_INTERNAL;
+    }
+    return ZX_OK;
+}
+
 zx_status_t GpuDevice::set_scanout(uint32_t scanout_id, uint32_t resource_id, uint32_t width, uint32_t height) {
     LTRACEF("dev %p, scanout_id %u, resource_id %u, width %u, height %u\n", this, scanout_id, resource_id, width, height);
 
@@ -255,84 +422,193 @@ zx_status_t GpuDevice::set_scanout(uint32_t scanout_id, uint32_t resource_id, ui
     return err;
 }
 
-zx_status_t GpuDevice::flush_resource(uint32_t resource_id, uint32_t width, uint32_t height) {
-    LTRACEF("dev %p, resource_id %u, width %u, height %u\n", this, resource_id, width, height);
+// Copies the rect |r| of a resource's backing to the host and flushes it to
+// the display, as one batch. With |scanout| set the resource is first made
+// the scanout, to flip to it.
+zx_status_t GpuDevice::update_resource(uint32_t resource_id, const virtio_gpu_rect& r,
+                                       bool scanout) {
+    LTRACEF("dev %p, resource_id %u, x %u y %u w %u h %u, scanout %d\n", this, resource_id,
+            r.x, r.y, r.width, r.height, scanout);
+
+    /* the backing is laid out like the display, so find the rect's first pixel */
+    virtio_gpu_transfer_to_host_2d transfer;
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D;
+    transfer.r = r;
+    transfer.offset = ((uint64_t)r.y * pmode_.r.width + r.x) * 4;
+    transfer.resource_id = resource_id;
+
+    virtio_gpu_set_scanout set_scanout;
+    memset(&set_scanout, 0, sizeof(set_scanout));
+    set_scanout.hdr.type = VIRTIO_GPU_CMD_SET_SCANOUT;
+    set_scanout.r.width = pmode_.r.width;
+    set_scanout.r.height = pmode_.r.height;
+    set_scanout.scanout_id = pmode_id_;
+    set_scanout.resource_id = resource_id;
+
+    virtio_gpu_resource_flush flush;
+    memset(&flush, 0, sizeof(flush));
+    flush.hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
+    flush.r = r;
+    flush.resource_id = resource_id;
+
+    virtio_gpu_ctrl_hdr* res[3];
+    Command cmds[3];
+    size_t count = 0;
+    cmds[count++] = {&transfer, sizeof(transfer), (void**)&res[0], sizeof(*res[0])};
+    if (scanout)
+        cmds[count++] = {&set_scanout, sizeof(set_scanout), (void**)&res[1], sizeof(*res[1])};
+    cmds[count++] = {&flush, sizeof(flush), (void**)&res[2], sizeof(*res[2])};
+
+    auto err = send_commands(cmds, count);
+    if (err < ZX_OK)
+        return err;
 
-    /* construct the request */
-    virtio_gpu_resource_flush req;
-    memset(&req, 0, sizeof(req));
+    for (size_t c = 0; c < count; c++) {
+        auto type = (*reinterpret_cast<virtio_gpu_ctrl_hdr**>(cmds[c].res))->type;
+        LTRACEF("response type 0x%x\n", type);
+        if (type != VIRTIO_GPU_RESP_OK_NODATA)
+            return ZX_ERR_INTERNAL;
+    }
+    return ZX_OK;
+}
 
-    req.hdr.type = VIRTIO_GPU_CMD_RESOURCE_FLUSH;
-    req.r.x = req.r.y = 0;
-    req.r.width = width;
-    req.r.height = height;
-    req.resource_id = resource_id;
+void GpuDevice::Flush() {
+    FlushRegion(0, 0, pmode_.r.width, pmode_.r.height);
+}
 
-    /* send the command and get a response */
-    virtio_gpu_ctrl_hdr* res;
-    auto err = send_command_response(&req, sizeof(req), (void**)&res, sizeof(*res));
-    assert(err == ZX_OK);
+void GpuDevice::FlushRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    if (x >= pmode_.r.width || y >= pmode_.r.height)
+        return;
 
-    /* see if we got a valid response */
-    LTRACEF("response type 0x%x\n", res->type);
-    err = (res->type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
+    virtio_gpu_rect r = {};
+    r.x = x;
+    r.y = y;
+    r.width = fbl::min(width, pmode_.r.width - x);
+    r.height = fbl::min(height, pmode_.r.height - y);
 
-    return err;
+    fbl::AutoLock al(&flush_lock_);
+    union_rect(&damage_, r);
+    cnd_signal(&flush_cond_);
 }
 
-zx_status_t GpuDevice::transfer_to_host_2d(uint32_t resource_id, uint32_t width, uint32_t height) {
-    LTRACEF("dev %p, resource_id %u, width %u, height %u\n", this, resource_id, width, height);
+zx_status_t GpuDevice::ImportVmo(zx_handle_t handle, void** image) {
+    zx::vmo vmo;
+    auto status = zx_handle_duplicate(handle, ZX_RIGHT_SAME_RIGHTS, vmo.reset_and_get_address());
+    if (status != ZX_OK)
+        return status;
 
-    /* construct the request */
-    virtio_gpu_transfer_to_host_2d req;
-    memset(&req, 0, sizeof(req));
+    size_t len = pmode_.r.width * pmode_.r.height * 4;
+    uint64_t size;
+    if ((status = vmo.get_size(&size)) != ZX_OK)
+        return status;
+    if (size < len)
+        return ZX_ERR_BUFFER_TOO_SMALL;
 
-    req.hdr.type = VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D;
-    req.r.x = req.r.y = 0;
-    req.r.width = width;
-    req.r.height = height;
-    req.offset = 0;
-    req.resource_id = resource_id;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Image> img(new (&ac) Image);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
 
-    /* send the command and get a response */
-    virtio_gpu_ctrl_hdr* res;
-    auto err = send_command_response(&req, sizeof(req), (void**)&res, sizeof(*res));
-    assert(err == ZX_OK);
+    status = allocate_2d_resource(&img->resource_id, pmode_.r.width, pmode_.r.height);
+    if (status != ZX_OK)
+        return status;
 
-    /* see if we got a valid response */
-    LTRACEF("response type 0x%x\n", res->type);
-    err = (res->type == VIRTIO_GPU_RESP_OK_NODATA) ? ZX_OK : ZX_ERR_NO_MEMORY;
+    status = attach_vmo_backing(img->resource_id, vmo, len);
+    if (status != ZX_OK) {
+        destroy_resource(img->resource_id);
+        return status;
+    }
 
-    return err;
+    img->vmo = fbl::move(vmo);
+    *image = img.release();
+    return ZX_OK;
 }
 
-void GpuDevice::Flush() {
+void GpuDevice::ReleaseImage(void* image) {
+    fbl::unique_ptr<Image> img(static_cast<Image*>(image));
+
+    {
+        fbl::AutoLock al(&flush_lock_);
+        if (flip_pending_ && flip_image_ == img.get())
+            flip_image_ = nullptr;
+    }
+
+    // Wait out a flip to the image the flusher may be in the middle of.
+    fbl::AutoLock scanout_lock(&scanout_lock_);
+    if (scanout_resource_id_ == img->resource_id)
+        scanout_resource_id_ = 0;
+
+    destroy_resource(img->resource_id);
+}
+
+zx_status_t GpuDevice::Flip(void* image) {
     fbl::AutoLock al(&flush_lock_);
-    flush_pending_ = true;
+    flip_pending_ = true;
+    flip_image_ = static_cast<Image*>(image);
     cnd_signal(&flush_cond_);
+    return ZX_OK;
+}
+
+void GpuDevice::SetFlipCallback(zx_display_flip_cb_t callback, void* cookie) {
+    fbl::AutoLock al(&flush_lock_);
+    flip_cb_ = callback;
+    flip_cookie_ = cookie;
 }
 
 void GpuDevice::virtio_gpu_flusher() {
     LTRACE_ENTRY;
     for (;;) {
+        virtio_gpu_rect damage;
+        bool flip;
+        uint32_t flip_resource_id = 0;
+        zx_display_flip_cb_t flip_cb;
+        void* flip_cookie;
         {
             fbl::AutoLock al(&flush_lock_);
-            while (!flush_pending_)
+            while (!flip_pending_ && (damage_.width == 0 || damage_.height == 0))
                 cnd_wait(&flush_cond_, flush_lock_.GetInternal());
-            flush_pending_ = false;
+            damage = damage_;
+            damage_ = {};
+            flip = flip_pending_;
+            flip_pending_ = false;
+            if (flip)
+                flip_resource_id = flip_image_ ? flip_image_->resource_id : display_resource_id_;
+            flip_cb = flip_cb_;
+            flip_cookie = flip_cookie_;
         }
 
-        LTRACEF("flushing\n");
+        // An image released from here on fails to flip, rather than being
+        // freed under us; only its resource id is used.
+        fbl::AutoLock scanout_lock(&scanout_lock_);
 
-        /* transfer to host 2d */
-        auto err = transfer_to_host_2d(display_resource_id_, pmode_.r.width, pmode_.r.height);
-        if (err < 0) {
-            LTRACEF("failed to flush resource\n");
-            continue;
+        if (flip) {
+            LTRACEF("flipping to resource %u\n", flip_resource_id);
+
+            /* upload the whole image, scan it out and show it */
+            virtio_gpu_rect r = {};
+            r.width = pmode_.r.width;
+            r.height = pmode_.r.height;
+            auto err = update_resource(flip_resource_id, r, true);
+            if (err < 0) {
+                LTRACEF("failed to flip\n");
+            } else {
+                scanout_resource_id_ = flip_resource_id;
+            }
+            // the framebuffer's damage was sent along with a flip to it
+            if (flip_resource_id == display_resource_id_)
+                damage = {};
+            if (flip_cb)
+                flip_cb(flip_cookie);
         }
 
-        /* resource flush */
-        err = flush_resource(display_resource_id_, pmode_.r.width, pmode_.r.height);
+        /* only what was drawn, and only while the framebuffer is on screen */
+        if (damage.width == 0 || scanout_resource_id_ != display_resource_id_)
+            continue;
+
+        LTRACEF("flushing\n");
+
+        auto err = update_resource(display_resource_id_, damage, false);
         if (err < 0) {
             LTRACEF("failed to flush resource\n");
             continue;
@@ -365,6 +641,13 @@ zx_status_t GpuDevice::virtio_gpu_start() {
         return ZX_ERR_NOT_FOUND;
     }
 
+    if (virgl_ && num_capsets_ > 0) {
+        // Nothing submits 3d commands yet; just report what the host offers.
+        err = get_capset_info();
+        if (err < 0)
+            zxlogf(ERROR, "%s: failed to get capset info %d\n", tag(), err);
+    }
+
     printf("virtio-gpu: found display x %u y %u w %u h %u flags 0x%x\n",
            pmode_.r.x, pmode_.r.y, pmode_.r.width, pmode_.r.height,
            pmode_.flags);
@@ -387,7 +670,8 @@ zx_status_t GpuDevice::virtio_gpu_start() {
 
     LTRACEF("framebuffer at %p, 0x%zx bytes\n", fb_, len);
 
-    err = attach_backing(display_resource_id_, fb_pa_, len);
+    virtio_gpu_mem_entry mem = {fb_pa_, (uint32_t)len, 0};
+    err = attach_backing(display_resource_id_, &mem, 1);
     if (err < 0) {
         zxlogf(ERROR, "%s: failed to attach backing store\n", tag());
         return err;
@@ -399,6 +683,7 @@ zx_status_t GpuDevice::virtio_gpu_start() {
         zxlogf(ERROR, "%s: failed to set scanout\n", tag());
         return err;
     }
+    scanout_resource_id_ = display_resource_id_;
 
     // run a worker thread to shove in flush events
     thrd_create_with_name(&flush_thread_, virtio_gpu_flusher_entry, this, "virtio-gpu-flusher");
@@ -410,6 +695,11 @@ zx_status_t GpuDevice::virtio_gpu_start() {
     display_proto_ops_.get_mode = virtio_gpu_get_mode;
     display_proto_ops_.get_framebuffer = virtio_gpu_get_framebuffer;
     display_proto_ops_.flush = virtio_gpu_flush;
+    display_proto_ops_.flush_region = virtio_gpu_flush_region;
+    display_proto_ops_.import_vmo = virtio_gpu_import_vmo;
+    display_proto_ops_.release_image = virtio_gpu_release_image;
+    display_proto_ops_.flip = virtio_gpu_flip;
+    display_proto_ops_.set_flip_callback = virtio_gpu_set_flip_callback;
 
     // initialize the zx_device and publish us
     // point the ctx of our DDK device at ourself
@@ -453,12 +743,21 @@ zx_status_t GpuDevice::Init() {
     LTRACEF("events_read 0x%x\n", config.events_read);
     LTRACEF("events_clear 0x%x\n", config.events_clear);
     LTRACEF("num_scanouts 0x%x\n", config.num_scanouts);
-    LTRACEF("reserved 0x%x\n", config.reserved);
+    LTRACEF("num_capsets 0x%x\n", config.num_capsets);
 
     // ack and set the driver status bit
     DriverStatusAck();
 
-    // XXX check features bits and ack/nak them
+    if (DeviceFeatureSupported(VIRTIO_GPU_F_VIRGL)) {
+        DriverFeatureAck(VIRTIO_GPU_F_VIRGL);
+        virgl_ = true;
+        num_capsets_ = config.num_capsets;
+    }
+    auto status = DeviceStatusFeaturesOk();
+    if (status != ZX_OK) {
+        zxlogf(ERROR, "%s: feature negotiation failed %d\n", tag(), status);
+        return status;
+    }
 
     // allocate the main vring
     auto err = vring_.Init(0, 16);
@@ -468,7 +767,7 @@ zx_status_t GpuDevice::Init() {
     }
 
     // allocate a gpu request
-    auto r = map_contiguous_memory(PAGE_SIZE, (uintptr_t*)&gpu_req_, &gpu_req_pa_);
+    auto r = map_contiguous_memory(kRequestBufferSize, (uintptr_t*)&gpu_req_, &gpu_req_pa_);
     if (r < 0) {
         zxlogf(ERROR, "%s: cannot alloc gpu_req buffers %d\n", tag(), r);
         return r;
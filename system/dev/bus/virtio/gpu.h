@@ -7,10 +7,12 @@
 #include "ring.h"
 #include "virtio_gpu.h"
 
+#include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
 #include <semaphore.h>
 #include <stdlib.h>
 #include <zircon/compiler.h>
+#include <zx/vmo.h>
 
 #include <ddk/protocol/display.h>
 
@@ -32,6 +34,12 @@ public:
     const virtio_gpu_resp_display_info::virtio_gpu_display_one* pmode() const { return &pmode_; }
 
     void Flush();
+    void FlushRegion(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+    zx_status_t ImportVmo(zx_handle_t vmo, void** image);
+    void ReleaseImage(void* image);
+    zx_status_t Flip(void* image);
+    void SetFlipCallback(zx_display_flip_cb_t callback, void* cookie);
 
     const char* tag() const override { return "virtio-gpu"; };
 
@@ -41,15 +49,42 @@ private:
     static zx_status_t virtio_gpu_get_mode(void* ctx, zx_display_info_t* info);
     static zx_status_t virtio_gpu_get_framebuffer(void* ctx, void** framebuffer);
     static void virtio_gpu_flush(void* ctx);
+    static void virtio_gpu_flush_region(void* ctx, uint32_t x, uint32_t y,
+                                        uint32_t width, uint32_t height);
+    static zx_status_t virtio_gpu_import_vmo(void* ctx, zx_handle_t vmo, void** image);
+    static void virtio_gpu_release_image(void* ctx, void* image);
+    static zx_status_t virtio_gpu_flip(void* ctx, void* image);
+    static void virtio_gpu_set_flip_callback(void* ctx, zx_display_flip_cb_t callback,
+                                             void* cookie);
+
+    // A command for send_commands(): the request, and where to return a
+    // pointer to its response of |res_len| bytes.
+    struct Command {
+        const void* cmd;
+        size_t cmd_len;
+        void** res;
+        size_t res_len;
+    };
+
+    // An image imported by ImportVmo(): a resource backed by the pages of a
+    // client's VMO, which the handle keeps alive.
+    struct Image {
+        uint32_t resource_id;
+        zx::vmo vmo;
+    };
 
     // internal routines
+    zx_status_t send_commands(const Command* cmds, size_t count);
     zx_status_t send_command_response(const void* cmd, size_t cmd_len, void** _res, size_t res_len);
     zx_status_t get_display_info();
+    zx_status_t get_capset_info();
     zx_status_t allocate_2d_resource(uint32_t* resource_id, uint32_t width, uint32_t height);
-    zx_status_t attach_backing(uint32_t resource_id, zx_paddr_t ptr, size_t buf_len);
+    zx_status_t attach_backing(uint32_t resource_id, const virtio_gpu_mem_entry* entries,
+                               uint32_t nr_entries);
+    zx_status_t attach_vmo_backing(uint32_t resource_id, const zx::vmo& vmo, size_t len);
+    zx_status_t destroy_resource(uint32_t resource_id);
     zx_status_t set_scanout(uint32_t scanout_id, uint32_t resource_id, uint32_t width, uint32_t height);
-    zx_status_t flush_resource(uint32_t resource_id, uint32_t width, uint32_t height);
-    zx_status_t transfer_to_host_2d(uint32_t resource_id, uint32_t width, uint32_t height);
+    zx_status_t update_resource(uint32_t resource_id, const virtio_gpu_rect& r, bool scanout);
 
     zx_status_t virtio_gpu_start();
     static int virtio_gpu_start_entry(void* arg);
@@ -61,19 +96,28 @@ private:
     // display protocol ops
     display_protocol_ops_t display_proto_ops_ = {};
 
-    // gpu op
+    // gpu op, room for a batch of commands and their responses
     void* gpu_req_ = nullptr;
     zx_paddr_t gpu_req_pa_ = 0;
 
+    // the capability sets of a device with VIRTIO_GPU_F_VIRGL
+    bool virgl_ = false;
+    uint32_t num_capsets_ = 0;
+
     // a saved copy of the display
     virtio_gpu_resp_display_info::virtio_gpu_display_one pmode_ = {};
     int pmode_id_ = -1;
 
-    // resource id that is set as scanout
+    // resource id of the framebuffer
     uint32_t display_resource_id_ = 0;
 
-    // next resource id
-    uint32_t next_resource_id_ = -1;
+    // resource id that is set as scanout, only touched with |scanout_lock_|
+    // held; the framebuffer's or an imported image's
+    fbl::Mutex scanout_lock_;
+    uint32_t scanout_resource_id_ = 0;
+
+    // next resource id, 0 is reserved for no resource
+    uint32_t next_resource_id_ = 1;
 
     // framebuffer
     void* fb_ = nullptr;
@@ -90,7 +134,13 @@ private:
     thrd_t flush_thread_ = {};
     fbl::Mutex flush_lock_;
     cnd_t flush_cond_ = {};
-    bool flush_pending_ = false;
+    // the part of the framebuffer drawn into since the last flush
+    virtio_gpu_rect damage_ = {};
+    // the image to show next, or null for the framebuffer
+    bool flip_pending_ = false;
+    Image* flip_image_ = nullptr;
+    zx_display_flip_cb_t flip_cb_ = nullptr;
+    void* flip_cookie_ = nullptr;
 };
 
 } // namespace virtio
@@ -129,13 +129,34 @@ void Ring::SubmitChain(uint16_t desc_index) {
     struct vring_avail* avail = ring_.avail;
 
     avail->ring[avail->idx & ring_.num_mask] = desc_index;
-    //mb();
+    // The device may see the new index as soon as it's written.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
     avail->idx++;
 }
 
+void Ring::SuppressInterrupts() {
+    no_interrupt_ = true;
+    ring_.avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+}
+
 void Ring::Kick() {
     LTRACE_ENTRY;
 
+    // Order the new avail index before reading whether the device wants to
+    // hear about it; see section 2.4.7.2 of the spec.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint16_t new_idx = ring_.avail->idx;
+    uint16_t old_idx = kicked_idx_;
+    kicked_idx_ = new_idx;
+    if (event_idx_) {
+        uint16_t event = *reinterpret_cast<volatile uint16_t*>(&vring_avail_event(&ring_));
+        if (!vring_need_event(event, new_idx, old_idx)) {
+            return;
+        }
+    } else if (*reinterpret_cast<volatile uint16_t*>(&ring_.used->flags) &
+               VRING_USED_F_NO_NOTIFY) {
+        return;
+    }
     device_->RingKick(index_);
 }
 
@@ -19,9 +19,18 @@ public:
 
     zx_status_t Init(uint16_t index, uint16_t count);
 
+    // Once VIRTIO_RING_F_EVENT_IDX is negotiated, kicks and interrupts are
+    // suppressed by the event indices rather than the ring flags.
+    void SetEventIdx(bool enable) { event_idx_ = enable; }
+    // Asks the device not to interrupt as descriptors are used, for rings
+    // which are only reclaimed when the driver needs more descriptors.
+    void SuppressInterrupts();
+
     void FreeDesc(uint16_t desc_index);
     struct vring_desc* AllocDescChain(uint16_t count, uint16_t* start_index);
     void SubmitChain(uint16_t desc_index);
+    // Notifies the device of the chains submitted since the last kick, unless
+    // it has said it doesn't need to hear about them.
     void Kick();
 
     struct vring_desc* DescFromIndex(uint16_t index) {
@@ -40,6 +49,11 @@ private:
 
     uint16_t index_ = 0;
 
+    bool event_idx_ = false;
+    bool no_interrupt_ = false;
+    // The avail index the device was last kicked at.
+    uint16_t kicked_idx_ = 0;
+
     vring ring_ = {};
 };
 
@@ -50,18 +64,32 @@ inline void Ring::IrqRingUpdate(T free_chain) {
     //         ring_.used->flags, ring_.used->idx, ring_.last_used);
 
     // find a new free chain of descriptors
-    uint16_t cur_idx = ring_.used->idx;
     uint16_t i = ring_.last_used;
-    for (; i != cur_idx; ++i) {
-        // TRACEF("looking at idx %u\n", i);
-
-        struct vring_used_elem* used_elem = &ring_.used->ring[i & ring_.num_mask];
-        // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
-
-        // free the chain
-        free_chain(used_elem);
+    for (;;) {
+        uint16_t cur_idx = *reinterpret_cast<volatile uint16_t*>(&ring_.used->idx);
+        if (i == cur_idx) {
+            break;
+        }
+        // Read the used elements only after the index covering them.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        for (; i != cur_idx; ++i) {
+            // TRACEF("looking at idx %u\n", i);
+
+            struct vring_used_elem* used_elem = &ring_.used->ring[i & ring_.num_mask];
+            // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
+
+            // free the chain
+            free_chain(used_elem);
+        }
+        ring_.last_used = i;
+        if (!event_idx_ || no_interrupt_) {
+            break;
+        }
+        // Ask for an interrupt on the next used chain, then look once more in
+        // case the device used one before it could see the request.
+        vring_used_event(&ring_) = i;
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
     }
-    ring_.last_used = i;
 }
 
 void virtio_dump_desc(const struct vring_desc* desc);
@@ -23,6 +23,9 @@ typedef struct fb fb_t;
 #define GROUP_VIRTCON 0
 #define GROUP_FULLSCREEN 1
 
+// enough for triple buffering
+#define FB_MAX_IMAGES 3
+
 struct fb {
     zx_device_t* zxdev;
     display_protocol_t dpy;
@@ -45,19 +48,144 @@ struct fb {
 #define FB_HAS_GPU(fb) (fb->dpy.ops->acquire_or_release_display != NULL)
 #define FB_ACQUIRE(fb) (fb->dpy.ops->acquire_or_release_display(fb->dpy.ctx, true))
 #define FB_RELEASE(fb) (fb->dpy.ops->acquire_or_release_display(fb->dpy.ctx, false))
+#define FB_HAS_FLIP(fb) (fb->dpy.ops->flip != NULL)
 static inline void FB_FLUSH(fb_t* fb) {
     if (fb->dpy.ops->flush) {
         fb->dpy.ops->flush(fb->dpy.ctx);
     }
 }
+static inline void FB_FLUSH_REGION(fb_t* fb, uint32_t x, uint32_t y, uint32_t w, uint32_t h) {
+    if (fb->dpy.ops->flush_region) {
+        fb->dpy.ops->flush_region(fb->dpy.ctx, x, y, w, h);
+    } else {
+        FB_FLUSH(fb);
+    }
+}
 
 struct fbi {
     fb_t* fb;
     void* buffer;
     zx_handle_t vmo;
     uint32_t group;
+
+    // images imported by a fullscreen client, and the one it last flipped to
+    void* images[FB_MAX_IMAGES];
+    void* flipped;
+    zx_handle_t flip_event;
 };
 
+// Shows the fullscreen client's last flip if it is active and has flipped,
+// otherwise the display's own framebuffer. Called with fb->lock held.
+static void fb_show_flipped_locked(fb_t* fb) {
+    if (!FB_HAS_FLIP(fb)) {
+        return;
+    }
+    void* image = NULL;
+    if ((fb->active == GROUP_FULLSCREEN) && (fb->fullscreen != NULL)) {
+        image = fb->fullscreen->flipped;
+    }
+    fb->dpy.ops->flip(fb->dpy.ctx, image);
+}
+
+static void fb_flip_callback(void* cookie) {
+    fb_t* fb = cookie;
+    mtx_lock(&fb->lock);
+    if ((fb->fullscreen != NULL) && (fb->fullscreen->flip_event != ZX_HANDLE_INVALID)) {
+        zx_object_signal(fb->fullscreen->flip_event, 0, ZX_USER_SIGNAL_0);
+    }
+    mtx_unlock(&fb->lock);
+}
+
+static zx_status_t fbi_flip_ioctl(fbi_t* fbi, uint32_t op, const void* in_buf, size_t in_len,
+                                  void* out_buf, size_t out_len, size_t* out_actual) {
+    fb_t* fb = fbi->fb;
+    if (op == IOCTL_DISPLAY_IMPORT_VMO) {
+        if (in_len != sizeof(zx_handle_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        // the handle is ours to close, whatever happens
+        zx_handle_t vmo = *(const zx_handle_t*)in_buf;
+        zx_status_t r = ZX_ERR_NOT_SUPPORTED;
+        if (!FB_HAS_FLIP(fb) || (fbi->group != GROUP_FULLSCREEN)) {
+            goto import_done;
+        }
+        if (out_len < sizeof(uint32_t)) {
+            r = ZX_ERR_BUFFER_TOO_SMALL;
+            goto import_done;
+        }
+        mtx_lock(&fb->lock);
+        uint32_t id;
+        for (id = 0; id < FB_MAX_IMAGES; id++) {
+            if (fbi->images[id] == NULL) {
+                break;
+            }
+        }
+        if (id == FB_MAX_IMAGES) {
+            r = ZX_ERR_NO_RESOURCES;
+        } else if ((r = fb->dpy.ops->import_vmo(fb->dpy.ctx, vmo, &fbi->images[id])) == ZX_OK) {
+            *(uint32_t*)out_buf = id;
+            *out_actual = sizeof(uint32_t);
+        }
+        mtx_unlock(&fb->lock);
+import_done:
+        zx_handle_close(vmo);
+        return r;
+    }
+
+    if (!FB_HAS_FLIP(fb) || (fbi->group != GROUP_FULLSCREEN)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    switch (op) {
+    case IOCTL_DISPLAY_RELEASE_IMAGE:
+    case IOCTL_DISPLAY_FLIP: {
+        if (in_len != sizeof(uint32_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        uint32_t id = *(const uint32_t*)in_buf;
+        if ((id >= FB_MAX_IMAGES) || (fbi->images[id] == NULL)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        mtx_lock(&fb->lock);
+        void* image = fbi->images[id];
+        if (op == IOCTL_DISPLAY_FLIP) {
+            fbi->flipped = image;
+            fb_show_flipped_locked(fb);
+        } else {
+            if (fbi->flipped == image) {
+                fbi->flipped = NULL;
+                fb_show_flipped_locked(fb);
+            }
+            fb->dpy.ops->release_image(fb->dpy.ctx, image);
+            fbi->images[id] = NULL;
+        }
+        mtx_unlock(&fb->lock);
+        return ZX_OK;
+    }
+    case IOCTL_DISPLAY_GET_FLIP_EVENT: {
+        if (out_len != sizeof(zx_handle_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        zx_status_t r = ZX_OK;
+        mtx_lock(&fb->lock);
+        if (fbi->flip_event == ZX_HANDLE_INVALID) {
+            r = zx_event_create(0, &fbi->flip_event);
+        }
+        if (r == ZX_OK) {
+            r = zx_handle_duplicate(fbi->flip_event, ZX_RIGHTS_BASIC | ZX_RIGHT_READ |
+                                    ZX_RIGHT_WRITE, out_buf);
+        }
+        mtx_unlock(&fb->lock);
+        if (r == ZX_OK) {
+            *out_actual = sizeof(zx_handle_t);
+        }
+        return r;
+    }
+    default:
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+}
+
 void fb_callback(bool acquired, void* cookie) {
     fb_t* fb = cookie;
     mtx_lock(&fb->lock);
@@ -112,12 +240,19 @@ static zx_status_t fbi_ioctl(void* ctx, uint32_t op,
             return ZX_ERR_INVALID_ARGS;
         }
         const ioctl_display_region_t* r = in_buf;
+        uint32_t x = r->x;
         uint32_t y = r->y;
+        uint32_t w = r->width;
         uint32_t h = r->height;
         if ((y >= fb->info.height) ||
             (h > (fb->info.height - y))) {
             return ZX_ERR_OUT_OF_RANGE;
         }
+        if ((x >= fb->info.width) || (w > (fb->info.width - x))) {
+            // older clients only set the rows
+            x = 0;
+            w = fb->info.width;
+        }
         uint32_t linesize = fb->info.stride * fb->info.pixelsize;
         mtx_lock(&fb->lock);
         if (!fb->zxdev) {
@@ -125,8 +260,16 @@ static zx_status_t fbi_ioctl(void* ctx, uint32_t op,
             return ZX_ERR_PEER_CLOSED;
         }
         if ((fb->active == fbi->group) && (fbi->buffer != NULL)) {
-            memcpy(fb->buffer + y * linesize, fbi->buffer + y * linesize, h * linesize);
-            FB_FLUSH(fb);
+            if (w == fb->info.width) {
+                memcpy(fb->buffer + y * linesize, fbi->buffer + y * linesize, h * linesize);
+            } else {
+                // only copy the columns of a narrow region, a line at a time
+                size_t offset = y * linesize + x * fb->info.pixelsize;
+                for (uint32_t i = 0; i < h; i++, offset += linesize) {
+                    memcpy(fb->buffer + offset, fbi->buffer + offset, w * fb->info.pixelsize);
+                }
+            }
+            FB_FLUSH_REGION(fb, x, y, w, h);
         }
         mtx_unlock(&fb->lock);
         return ZX_OK;
@@ -194,10 +337,15 @@ static zx_status_t fbi_ioctl(void* ctx, uint32_t op,
         if ((*n == GROUP_VIRTCON) || (fb->fullscreen == NULL)) {
             fb->active = GROUP_VIRTCON;
             zx_object_signal(fb->event, ZX_USER_SIGNAL_1, ZX_USER_SIGNAL_0);
+            if ((fb->fullscreen != NULL) && (fb->fullscreen->flipped != NULL)) {
+                fb_show_flipped_locked(fb);
+            }
         } else {
             fb->active = GROUP_FULLSCREEN;
             zx_object_signal(fb->event, ZX_USER_SIGNAL_0, ZX_USER_SIGNAL_1);
-            if (fb->fullscreen->buffer) {
+            if (fb->fullscreen->flipped) {
+                fb_show_flipped_locked(fb);
+            } else if (fb->fullscreen->buffer) {
                 memcpy(fb->buffer, fb->fullscreen->buffer, fb->bufsz);
             } else {
                 memset(fb->buffer, 0, fb->bufsz);
@@ -220,6 +368,12 @@ static zx_status_t fbi_ioctl(void* ctx, uint32_t op,
         }
     }
 
+    case IOCTL_DISPLAY_IMPORT_VMO:
+    case IOCTL_DISPLAY_RELEASE_IMAGE:
+    case IOCTL_DISPLAY_FLIP:
+    case IOCTL_DISPLAY_GET_FLIP_EVENT:
+        return fbi_flip_ioctl(fbi, op, in_buf, in_len, out_buf, out_len, out_actual);
+
     default:
         return ZX_ERR_NOT_SUPPORTED;
     }
@@ -239,9 +393,23 @@ static void fbi_release(void* ctx) {
             fb->active = GROUP_VIRTCON;
             zx_object_signal(fb->event, ZX_USER_SIGNAL_1, ZX_USER_SIGNAL_0);
         }
+        if (fbi->flipped != NULL) {
+            fb_show_flipped_locked(fb);
+        }
+    }
+    // An image may still be scanned out until the next vsync, in which case
+    // that frame shows whatever the display puts in place of a released image.
+    for (uint32_t i = 0; i < FB_MAX_IMAGES; i++) {
+        if (fbi->images[i] != NULL) {
+            fb->dpy.ops->release_image(fb->dpy.ctx, fbi->images[i]);
+        }
     }
     mtx_unlock(&fb->lock);
 
+    if (fbi->flip_event != ZX_HANDLE_INVALID) {
+        zx_handle_close(fbi->flip_event);
+    }
+
     if (fbi->buffer) {
         zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t) fbi->buffer, fbi->fb->bufsz);
     }
@@ -401,6 +569,9 @@ static zx_status_t fb_bind(void* ctx, zx_device_t* dev) {
         fb->dpy.ops->set_ownership_change_callback(fb->dpy.ctx, fb_callback, fb);
         FB_ACQUIRE(fb);
     }
+    if (FB_HAS_FLIP(fb)) {
+        fb->dpy.ops->set_flip_callback(fb->dpy.ctx, fb_flip_callback, fb);
+    }
     return ZX_OK;
 
 fail:
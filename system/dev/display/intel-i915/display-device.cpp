@@ -7,6 +7,7 @@
 #include <cpuid.h>
 #include <string.h>
 
+#include <fbl/auto_lock.h>
 #include <zx/vmar.h>
 #include <zx/vmo.h>
 
@@ -82,6 +83,105 @@ void DisplayDevice::Flush() {
     }
 }
 
+zx_status_t DisplayDevice::ImportVmo(zx_handle_t handle, void** image) {
+    zx::vmo vmo;
+    zx_status_t status = zx_handle_duplicate(handle, ZX_RIGHT_SAME_RIGHTS,
+                                             vmo.reset_and_get_address());
+    if (status != ZX_OK) {
+        return status;
+    }
+    uint64_t size;
+    if ((status = vmo.get_size(&size)) != ZX_OK) {
+        return status;
+    }
+    if (size < framebuffer_size_) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    // The pages have to exist to be put in the gtt.
+    status = vmo.op_range(ZX_VMO_OP_COMMIT, 0, framebuffer_size_, nullptr, 0);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    auto region = controller_->gtt()->Insert(&vmo, framebuffer_size_,
+                                             registers::PlaneSurface::kLinearAlignment,
+                                             registers::PlaneSurface::kTrailingPtePadding);
+    if (!region) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    *image = const_cast<GttRegion*>(region.release());
+    return ZX_OK;
+}
+
+void DisplayDevice::ReleaseImage(void* image) {
+    delete static_cast<GttRegion*>(image);
+}
+
+zx_status_t DisplayDevice::Flip(void* image) {
+    uint64_t gfx_addr = image ? static_cast<GttRegion*>(image)->base() : fb_gfx_addr_->base();
+
+    fbl::AutoLock lock(&flip_lock_);
+    SetSurface(gfx_addr);
+    if (!flip_pending_) {
+        flip_pending_ = true;
+        EnableVblankInterrupt(true);
+    }
+    return ZX_OK;
+}
+
+void DisplayDevice::SetFlipCallback(zx_display_flip_cb_t callback, void* cookie) {
+    fbl::AutoLock lock(&flip_lock_);
+    flip_cb_ = callback;
+    flip_cookie_ = cookie;
+}
+
+void DisplayDevice::HandleVblank() {
+    zx_display_flip_cb_t callback;
+    void* cookie;
+    {
+        fbl::AutoLock lock(&flip_lock_);
+        if (!flip_pending_) {
+            return;
+        }
+        // A flip written just before vblank may not have been latched by this
+        // one, so check which surface the plane is actually scanning out.
+        registers::PipeRegs pipe_regs(pipe());
+        auto live = pipe_regs.PlaneSurfaceLive().ReadFrom(mmio_space());
+        if ((static_cast<uint64_t>(live.surface_base_addr()) << live.kPageShift)
+                != surface_addr_) {
+            return;
+        }
+        flip_pending_ = false;
+        EnableVblankInterrupt(false);
+        callback = flip_cb_;
+        cookie = flip_cookie_;
+    }
+    if (callback) {
+        callback(cookie);
+    }
+}
+
+void DisplayDevice::SetSurface(uint64_t gfx_addr) {
+    surface_addr_ = gfx_addr;
+
+    // The plane switches to the new address at the start of the next vblank.
+    registers::PipeRegs pipe_regs(pipe());
+    auto plane_surface = pipe_regs.PlaneSurface().ReadFrom(mmio_space());
+    plane_surface.set_surface_base_addr(
+            static_cast<uint32_t>(gfx_addr >> plane_surface.kRShiftCount));
+    plane_surface.WriteTo(mmio_space());
+}
+
+void DisplayDevice::EnableVblankInterrupt(bool enable) {
+    // Vblank interrupts are only enabled while a flip is pending, so that an
+    // idle display doesn't wake the interrupt thread every frame.
+    registers::PipeRegs pipe_regs(pipe());
+    pipe_regs.PipeDeInterrupt(registers::PipeDeInterrupt::kDePipeIntMask)
+            .Update(mmio_space(), [enable](auto& reg) { reg.set_vblank(!enable); });
+    pipe_regs.PipeDeInterrupt(registers::PipeDeInterrupt::kDePipeIntEnable)
+            .Update(mmio_space(), [enable](auto& reg) { reg.set_vblank(enable); });
+}
+
 void DisplayDevice::ResetPipe() {
     controller_->ResetPipe(pipe_);
 }
@@ -151,10 +251,8 @@ bool DisplayDevice::Init() {
     plane_stride.set_stride(info_.stride / registers::PlaneSurfaceStride::kLinearStrideChunkSize);
     plane_stride.WriteTo(controller_->mmio_space());
 
-    auto plane_surface = pipe_regs.PlaneSurface().ReadFrom(controller_->mmio_space());
-    plane_surface.set_surface_base_addr(
-            static_cast<uint32_t>(fb_gfx_addr_->base() >> plane_surface.kRShiftCount));
-    plane_surface.WriteTo(controller_->mmio_space());
+    fbl::AutoLock lock(&flip_lock_);
+    SetSurface(fb_gfx_addr_->base());
 
     return true;
 }
@@ -170,10 +268,11 @@ bool DisplayDevice::Resume() {
     plane_stride.set_stride(info_.stride / registers::PlaneSurfaceStride::kLinearStrideChunkSize);
     plane_stride.WriteTo(controller_->mmio_space());
 
-    auto plane_surface = pipe_regs.PlaneSurface().ReadFrom(controller_->mmio_space());
-    plane_surface.set_surface_base_addr(
-            static_cast<uint32_t>(fb_gfx_addr_->base() >> plane_surface.kRShiftCount));
-    plane_surface.WriteTo(controller_->mmio_space());
+    fbl::AutoLock lock(&flip_lock_);
+    SetSurface(surface_addr_);
+    if (flip_pending_) {
+        EnableVblankInterrupt(true);
+    }
 
     return true;
 }
@@ -6,6 +6,7 @@
 
 #include <ddktl/device.h>
 #include <ddktl/protocol/display.h>
+#include <fbl/mutex.h>
 #include <hwreg/mmio.h>
 #include <region-alloc/region-alloc.h>
 #include <zx/vmo.h>
@@ -36,9 +37,15 @@ public:
     zx_status_t GetMode(zx_display_info_t* info);
     zx_status_t GetFramebuffer(void** framebuffer);
     void Flush();
+    zx_status_t ImportVmo(zx_handle_t vmo, void** image);
+    void ReleaseImage(void* image);
+    zx_status_t Flip(void* image);
+    void SetFlipCallback(zx_display_flip_cb_t callback, void* cookie);
 
     bool Init();
     bool Resume();
+    // Called from the interrupt thread on vblank, while a flip is pending.
+    void HandleVblank();
 
     const zx::vmo& framebuffer_vmo() const { return framebuffer_vmo_; }
     uint32_t framebuffer_size() const { return framebuffer_size_; }
@@ -62,6 +69,9 @@ protected:
     bool ResetDdi();
 
 private:
+    void SetSurface(uint64_t gfx_addr) __TA_REQUIRES(flip_lock_);
+    void EnableVblankInterrupt(bool enable) __TA_REQUIRES(flip_lock_);
+
     // Borrowed reference to Controller instance
     Controller* controller_;
 
@@ -75,6 +85,13 @@ private:
     zx::vmo framebuffer_vmo_;
     fbl::unique_ptr<const GttRegion> fb_gfx_addr_;
 
+    fbl::Mutex flip_lock_;
+    // The gfx address of the surface being scanned out, or about to be.
+    uint64_t surface_addr_ __TA_GUARDED(flip_lock_) = 0;
+    bool flip_pending_ __TA_GUARDED(flip_lock_) = false;
+    zx_display_flip_cb_t flip_cb_ __TA_GUARDED(flip_lock_) = nullptr;
+    void* flip_cookie_ __TA_GUARDED(flip_lock_) = nullptr;
+
     bool inited_;
     zx_display_info_t info_;
 };
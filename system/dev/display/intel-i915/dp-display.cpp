@@ -594,10 +594,9 @@ bool DpDisplay::LinkTrainingSetup() {
     uint8_t i_boost_override = controller()->igd_opregion().GetIBoost(ddi(), true /* is_dp */);
 
     for (unsigned i = 0; i < count; i++) {
-        auto ddi_buf_trans_high = ddi_regs.DdiBufTransHi(i).ReadFrom(mmio_space());
-        auto ddi_buf_trans_low = ddi_regs.DdiBufTransLo(i).ReadFrom(mmio_space());
-        ddi_buf_trans_high.set_reg_value(entries[i].high_dword);
-        ddi_buf_trans_low.set_reg_value(entries[i].low_dword);
+        // Both dwords are replaced outright, so there is nothing to read.
+        auto ddi_buf_trans_high = ddi_regs.DdiBufTransHi(i).FromValue(entries[i].high_dword);
+        auto ddi_buf_trans_low = ddi_regs.DdiBufTransLo(i).FromValue(entries[i].low_dword);
         if (i_boost_override) {
             ddi_buf_trans_low.set_balance_leg_enable(1);
         }
@@ -99,6 +99,21 @@ int Controller::IrqLoop() {
             sde_int_identity.WriteTo(mmio_space_.get());
         }
 
+        // Displays are only added and removed on this thread, by HandleHotplug.
+        for (auto* display : display_devices_) {
+            if (!interrupt_ctrl.de_pipe_int_pending(display->pipe()).get()) {
+                continue;
+            }
+            registers::PipeRegs pipe_regs(display->pipe());
+            auto identity = pipe_regs.PipeDeInterrupt(registers::PipeDeInterrupt::kDePipeIntIdentity)
+                    .ReadFrom(mmio_space_.get());
+            // Write back the register to clear the bits
+            identity.WriteTo(mmio_space_.get());
+            if (identity.vblank()) {
+                display->HandleVblank();
+            }
+        }
+
         interrupt_ctrl.set_enable_mask(1);
         interrupt_ctrl.WriteTo(mmio_space_.get());
     }
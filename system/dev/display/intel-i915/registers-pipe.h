@@ -46,6 +46,17 @@ public:
     DEF_BIT(3, ring_flip_source);
 };
 
+// PLANE_SURFLIVE
+class PlaneSurfaceLive : public hwreg::RegisterBase<PlaneSurfaceLive, uint32_t> {
+public:
+    static constexpr uint32_t kBaseAddr = 0x701ac;
+
+    // The address of the surface being scanned out, which only changes to a
+    // new PLANE_SURF value at the start of vblank.
+    DEF_FIELD(31, 12, surface_base_addr);
+    static constexpr uint32_t kPageShift = 12;
+};
+
 // PLANE_STRIDE
 class PlaneSurfaceStride : public hwreg::RegisterBase<PlaneSurfaceStride, uint32_t> {
 public:
@@ -137,6 +148,16 @@ public:
     DEF_FIELD(11, 0, y_size);
 };
 
+// DE_PIPE_INTERRUPT
+class PipeDeInterrupt : public hwreg::RegisterBase<PipeDeInterrupt, uint32_t> {
+public:
+    static constexpr uint32_t kDePipeIntMask = 0x44404;
+    static constexpr uint32_t kDePipeIntIdentity = 0x44408;
+    static constexpr uint32_t kDePipeIntEnable = 0x4440c;
+
+    DEF_BIT(0, vblank);
+};
+
 // An instance of PipeRegs represents the registers for a particular pipe.
 class PipeRegs {
 public:
@@ -150,6 +171,9 @@ public:
     hwreg::RegisterAddr<registers::PlaneSurface> PlaneSurface() {
         return GetReg<registers::PlaneSurface>();
     }
+    hwreg::RegisterAddr<registers::PlaneSurfaceLive> PlaneSurfaceLive() {
+        return GetReg<registers::PlaneSurfaceLive>();
+    }
     hwreg::RegisterAddr<registers::PlaneSurfaceStride> PlaneSurfaceStride() {
         return GetReg<registers::PlaneSurfaceStride>();
     }
@@ -179,6 +203,10 @@ public:
                 PipeScalerWinSize::kBaseAddr + 0x800 * pipe_ + num * 0x100);
     }
 
+    hwreg::RegisterAddr<registers::PipeDeInterrupt> PipeDeInterrupt(uint32_t type) {
+        return hwreg::RegisterAddr<registers::PipeDeInterrupt>(type + 0x10 * pipe_);
+    }
+
 private:
     template <class RegType> hwreg::RegisterAddr<RegType> GetReg() {
         return hwreg::RegisterAddr<RegType>(RegType::kBaseAddr + 0x1000 * pipe_);
@@ -8,6 +8,7 @@
 #include <zircon/assert.h>
 
 #include "registers-ddi.h"
+#include "registers-pipe.h"
 
 namespace registers {
 
@@ -61,6 +62,11 @@ public:
     DEF_BIT(31, enable_mask);
     DEF_BIT(23, sde_int_pending);
 
+    // Bits 16 to 18.
+    hwreg::BitfieldRef<uint32_t> de_pipe_int_pending(Pipe pipe) {
+        return hwreg::BitfieldRef<uint32_t>(reg_value_ptr(), 16 + pipe, 16 + pipe);
+    }
+
     static auto Get() { return hwreg::RegisterAddr<MasterInterruptControl>(0x44200); }
 };
 
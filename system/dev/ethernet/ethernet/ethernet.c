@@ -17,6 +17,7 @@
 #include <zircon/types.h>
 
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,12 +29,24 @@
 
 #define PAGE_MASK (PAGE_SIZE - 1)
 
-// This is used for signaling that eth_tx_thread() should exit.
+// This is used for signaling that eth_tx_thread() or eth_rx_post_thread() should exit.
 static const zx_signals_t kSignalFifoTerminate = ZX_USER_SIGNAL_0;
 
 // ensure that we will not exceed fifo capacity
 static_assert((FIFO_DEPTH * FIFO_ESIZE) <= 4096, "");
 
+// Device-wide state of one queue pair.
+typedef struct ethq0 {
+    // Held while delivering frames steered to this queue. Anything which changes
+    // list_active, or the rx fifos of the instances on it, holds every queue's.
+    mtx_t rx_lock;
+
+    atomic_uint_fast64_t rx_packets;
+    atomic_uint_fast64_t rx_dropped;
+    atomic_uint_fast64_t tx_packets;
+    atomic_uint_fast64_t tx_dropped;
+} ethq0_t;
+
 // ethernet device
 typedef struct ethdev0 {
     // shared state
@@ -53,16 +66,30 @@ typedef struct ethdev0 {
     ethmac_info_t info;
     uint32_t status;
     zx_device_t* zxdev;
+
+    // The ethmac's own queues if it has several, and otherwise one per cpu, with
+    // received frames steered among them by flow hash.
+    uint32_t nqueues;
+    ethq0_t queues[ETH_MAX_QUEUES];
+
+    // The queue whose client's buffers are handed to the ethmac to receive into,
+    // if any
+    struct ethq* rx_direct;
 } ethdev0_t;
 
 typedef struct tx_info {
-    struct ethdev* edev;
+    struct ethq* q;
     void* fifo_cookie;
+    uint16_t headroom;  // bytes of the fifo entry before netbuf.data, for its eth_offload_t
     ethmac_netbuf_t netbuf;
 } tx_info_t;
 
-// transmit thread has been created
-#define ETHDEV_TX_THREAD (1u)
+typedef struct rx_info {
+    struct ethq* q;
+    void* fifo_cookie;
+    uint16_t length;  // of the buffer, as netbuf.len becomes that of the frame
+    ethmac_netbuf_t netbuf;
+} rx_info_t;
 
 // connected to the ethmac and handling traffic
 #define ETHDEV_RUNNING (2u)
@@ -94,6 +121,45 @@ typedef struct tx_info {
 //   zircon/system/utest/ethernet/ethernet.cpp
 #define MULTICAST_LIST_LIMIT (32)
 
+// One queue pair of an instance. Queue 0 is the pair of IOCTL_ETHERNET_GET_FIFOS,
+// the others those of IOCTL_ETHERNET_GET_QUEUE_FIFOS.
+typedef struct ethq {
+    struct ethdev* edev;
+    uint32_t index;
+
+    // fifos are named from the perspective
+    // of the packet from from the client
+    // to the network interface
+    zx_handle_t tx_fifo;
+    zx_handle_t rx_fifo;
+
+    mtx_t rx_lock;  // Protects rx_entries, rx_done and free_rx_bufs
+    // Buffers posted by the client, to copy frames into. Read from the fifo
+    // FIFO_BATCH_SZ at a time, but sized to hold every buffer the client can
+    // post, as those handed back unused by the ethmac are kept here too.
+    eth_fifo_entry_t rx_entries[FIFO_DEPTH];
+    size_t rx_entry_count;
+    // Filled buffers, returned to the client in one fifo write per batch
+    eth_fifo_entry_t rx_done[FIFO_BATCH_SZ];
+    size_t rx_done_count;
+
+    // Buffers handed to the ethmac to receive into, while this is edev0->rx_direct
+    rx_info_t* all_rx_bufs;
+    list_node_t free_rx_bufs;  // rx_info_t elements
+    thrd_t rx_thr;
+
+    tx_info_t all_tx_bufs[FIFO_DEPTH];
+    mtx_t lock;  // Protects free_tx_bufs
+    list_node_t free_tx_bufs;  // tx_info_t elements
+
+    // fifo thread
+    thrd_t tx_thr;
+    bool tx_thread;
+
+    uint32_t fail_rx_read;
+    uint32_t fail_rx_write;
+} ethq_t;
+
 // ethernet instance device
 typedef struct ethdev {
     list_node_t node;
@@ -103,15 +169,9 @@ typedef struct ethdev {
     uint32_t state;
     char name[DEVICE_NAME_LEN];
 
-    // fifos are named from the perspective
-    // of the packet from from the client
-    // to the network interface
-    zx_handle_t tx_fifo;
     uint32_t tx_depth;
-    zx_handle_t rx_fifo;
     uint32_t rx_depth;
-    eth_fifo_entry_t rx_entries[FIFO_BATCH_SZ];
-    size_t rx_entry_count;
+    ethq_t* queues[ETH_MAX_QUEUES];
 
     // io buffer
     zx_handle_t io_vmo;
@@ -119,21 +179,10 @@ typedef struct ethdev {
     size_t io_size;
     zx_paddr_t* paddr_map;
 
-    tx_info_t all_tx_bufs[FIFO_DEPTH];
-    mtx_t lock;  // Protects free_tx_bufs
-    list_node_t free_tx_bufs;  // tx_info_t elements
-
-    // fifo thread
-    thrd_t tx_thr;
-
     zx_device_t* zxdev;
 
     uint8_t multicast[MULTICAST_LIST_LIMIT][ETH_MAC_SIZE];
     uint32_t n_multicast;
-
-    uint32_t fail_rx_read;
-    uint32_t fail_rx_write;
-    uint32_t fail_tx_write;
 } ethdev_t;
 
 #define FAIL_REPORT_RATE 50
@@ -278,35 +327,74 @@ static ssize_t eth_config_multicast_locked(ethdev_t* edev, eth_multicast_config_
     }
 }
 
-static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
+// Returns the filled buffers staged by eth_handle_rx() to the client, and the
+// number of them there was no fifo space for. The caller holds q->rx_lock.
+static uint32_t eth_flush_rx_locked(ethq_t* q) {
+    uint32_t count = q->rx_done_count;
+    if (count == 0) {
+        return 0;
+    }
+    q->rx_done_count = 0;
+
+    zx_status_t status;
+    uint32_t actual;
+    if ((status = zx_fifo_write(q->rx_fifo, q->rx_done, sizeof(eth_fifo_entry_t) * count,
+                                &actual)) < 0) {
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            actual = 0;
+        } else {
+            // Fatal, should force teardown
+            zxlogf(ERROR, "eth [%s]: rx_fifo write failed %d\n", q->edev->name, status);
+            return count;
+        }
+    }
+    if (actual < count) {
+        if ((q->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
+            zxlogf(ERROR, "eth [%s]: no rx_fifo space available on queue %u (%u times)\n",
+                   q->edev->name, q->index, q->fail_rx_write);
+        }
+    }
+    return count - actual;
+}
+
+// Copies a frame into a buffer the client posted, staging the buffer to be
+// returned by eth_flush_rx_locked(), which must be called before more than
+// FIFO_BATCH_SZ are staged. Returns ZX_OK if the frame was delivered,
+// and an error if it had to be dropped. The caller holds q->rx_lock.
+static zx_status_t eth_handle_rx(ethq_t* q, const void* data, size_t len, uint32_t extra) {
+    ethdev_t* edev = q->edev;
     zx_status_t status;
     uint32_t count;
 
-    if (edev->rx_entry_count == 0) {
-        status = zx_fifo_read(edev->rx_fifo, edev->rx_entries, sizeof(edev->rx_entries), &count);
+    if (q->rx_entry_count == 0) {
+        status = zx_fifo_read(q->rx_fifo, q->rx_entries, sizeof(eth_fifo_entry_t) * FIFO_BATCH_SZ,
+                              &count);
         if (status != ZX_OK) {
             if (status == ZX_ERR_SHOULD_WAIT) {
-                if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
-                    zxlogf(ERROR, "eth [%s]: no rx buffers available (%u times)\n",
-                           edev->name, edev->fail_rx_read);
+                if ((q->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
+                    zxlogf(ERROR, "eth [%s]: no rx buffers available on queue %u (%u times)\n",
+                           edev->name, q->index, q->fail_rx_read);
                 }
             } else {
                 // Fatal, should force teardown
                 zxlogf(ERROR, "eth [%s]: rx fifo read failed %d\n", edev->name, status);
             }
-            return;
+            return status;
         }
-        edev->rx_entry_count = count;
+        q->rx_entry_count = count;
     }
 
-    eth_fifo_entry_t* e = &edev->rx_entries[--edev->rx_entry_count];
+    eth_fifo_entry_t* e = &q->rx_entries[--q->rx_entry_count];
+    zx_status_t result = ZX_OK;
     if ((e->offset >= edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
         // invalid offset/length. report error. drop packet
         e->length = 0;
         e->flags = ETH_FIFO_INVALID;
+        result = ZX_ERR_INVALID_ARGS;
     } else if (len > e->length) {
         e->length = 0;
         e->flags = ETH_FIFO_INVALID;
+        result = ZX_ERR_BUFFER_TOO_SMALL;
     } else {
         // packet fits. deliver it
         memcpy(edev->io_buf + e->offset, data, len);
@@ -314,17 +402,132 @@ static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t
         e->flags = ETH_FIFO_RX_OK | extra;
     }
 
-    if ((status = zx_fifo_write(edev->rx_fifo, e, sizeof(*e), &count)) < 0) {
-        if (status == ZX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
-                zxlogf(ERROR, "eth [%s]: no rx_fifo space available (%u times)\n",
-                       edev->name, edev->fail_rx_write);
+    ZX_DEBUG_ASSERT(q->rx_done_count < countof(q->rx_done));
+    q->rx_done[q->rx_done_count++] = *e;
+    return result;
+}
+
+// Keeps a buffer the client posted, to copy a later frame into. The caller
+// holds q->rx_lock.
+static void eth_stash_rx_locked(ethq_t* q, const eth_fifo_entry_t* e) {
+    ZX_DEBUG_ASSERT(q->rx_entry_count < countof(q->rx_entries));
+    q->rx_entries[q->rx_entry_count++] = *e;
+}
+
+// Takes the rx_lock of every queue, holding off delivery of received frames so
+// that list_active, and the rx fifos of the instances on it, may change.
+static void eth0_lock_rx(ethdev0_t* edev0) {
+    for (uint32_t i = 0; i < edev0->nqueues; i++) {
+        mtx_lock(&edev0->queues[i].rx_lock);
+    }
+}
+
+static void eth0_unlock_rx(ethdev0_t* edev0) {
+    for (uint32_t i = edev0->nqueues; i > 0; i--) {
+        mtx_unlock(&edev0->queues[i - 1].rx_lock);
+    }
+}
+
+#define ETH_HDR_LEN 14
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_IPV6 0x86dd
+#define IP_PROTO_TCP 6
+#define IP_PROTO_UDP 17
+
+// FNV-1a
+static uint32_t eth_hash_bytes(uint32_t hash, const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Hashes the addresses, and for TCP and UDP the ports, of an IP frame, so that
+// every frame of a flow is steered to the same queue. Other frames hash to 0.
+static uint32_t eth_flow_hash(const uint8_t* frame, size_t len) {
+    if (len < ETH_HDR_LEN) {
+        return 0;
+    }
+    const uint16_t type = (uint16_t)((frame[12] << 8) | frame[13]);
+    const uint8_t* ip = frame + ETH_HDR_LEN;
+    len -= ETH_HDR_LEN;
+
+    const uint8_t* addrs;
+    size_t addrs_len;
+    const uint8_t* l4;
+    uint8_t proto;
+    if (type == ETHERTYPE_IPV4) {
+        size_t ihl;
+        if (len < 20 || (ihl = (ip[0] & 0xf) * 4u) < 20 || len < ihl) {
+            return 0;
+        }
+        addrs = ip + 12;
+        addrs_len = 8;
+        // Fragments carry no ports past the first, so hash them all without.
+        proto = (((ip[6] << 8) | ip[7]) & 0x3fff) ? 0 : ip[9];
+        l4 = ip + ihl;
+        len -= ihl;
+    } else if (type == ETHERTYPE_IPV6) {
+        if (len < 40) {
+            return 0;
+        }
+        addrs = ip + 8;
+        addrs_len = 32;
+        proto = ip[6];
+        l4 = ip + 40;
+        len -= 40;
+    } else {
+        return 0;
+    }
+
+    uint32_t hash = eth_hash_bytes(2166136261u, addrs, addrs_len);
+    if ((proto == IP_PROTO_TCP || proto == IP_PROTO_UDP) && len >= 4) {
+        hash = eth_hash_bytes(hash, l4, 4);
+    }
+    return hash;
+}
+
+// Maps the ETHMAC_RX_ flags of a received frame to ETH_FIFO_ flags.
+static uint32_t eth_rx_flags(uint32_t flags) {
+    return (flags & ETHMAC_RX_CSUM_OK) ? ETH_FIFO_RX_CSUM_OK : 0;
+}
+
+// Delivers frames steered to queue |index| to the active instances, or to those
+// listening for tx if |extra| is ETH_FIFO_RX_TX, with one fifo write per
+// instance. Instances which have not obtained that queue receive them on queue 0.
+// The caller holds the queue's rx_lock.
+static void eth_deliver_rx_locked(ethdev0_t* edev0, uint32_t index,
+                                  const ethmac_rx_frame_t* frames, size_t count, uint32_t extra) {
+    ethq0_t* q0 = &edev0->queues[index];
+    ethdev_t* edev;
+    list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
+        if ((extra & ETH_FIFO_RX_TX) && !(edev->state & ETHDEV_TX_LISTEN)) {
+            continue;
+        }
+        ethq_t* q = edev->queues[index];
+        if (q == NULL || q->rx_fifo == ZX_HANDLE_INVALID) {
+            q = edev->queues[0];
+        }
+        if (q == NULL || q->rx_fifo == ZX_HANDLE_INVALID) {
+            continue;
+        }
+        uint32_t dropped = 0;
+        mtx_lock(&q->rx_lock);
+        for (size_t i = 0; i < count; i++) {
+            if (q->rx_done_count == countof(q->rx_done)) {
+                dropped += eth_flush_rx_locked(q);
+            }
+            if (eth_handle_rx(q, frames[i].data, frames[i].length,
+                              extra | eth_rx_flags(frames[i].flags)) != ZX_OK) {
+                dropped++;
             }
-        } else {
-            // Fatal, should force teardown
-            zxlogf(ERROR, "eth [%s]: rx_fifo write failed %d\n", edev->name, status);
         }
-        return;
+        dropped += eth_flush_rx_locked(q);
+        mtx_unlock(&q->rx_lock);
+        if (dropped > 0) {
+            atomic_fetch_add(&q0->rx_dropped, dropped);
+        }
     }
 }
 
@@ -337,73 +540,349 @@ static void eth0_status(void* cookie, uint32_t status) {
 
     ethdev_t* edev;
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        zx_object_signal_peer(edev->rx_fifo, 0, ETH_SIGNAL_STATUS);
+        zx_object_signal_peer(edev->queues[0]->rx_fifo, 0, ETH_SIGNAL_STATUS);
     }
     mtx_unlock(&edev0->lock);
 }
 
-static int tx_fifo_write(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
+static int tx_fifo_write(ethq_t* q, eth_fifo_entry_t* entries, uint32_t count) {
     zx_status_t status;
     uint32_t actual;
     // Writing should never fail, or fail to write all entries
-    status = zx_fifo_write(edev->tx_fifo, entries, sizeof(eth_fifo_entry_t) * count, &actual);
+    status = zx_fifo_write(q->tx_fifo, entries, sizeof(eth_fifo_entry_t) * count, &actual);
     if (status < 0) {
-        zxlogf(ERROR, "eth [%s]: tx_fifo write failed %d\n", edev->name, status);
+        zxlogf(ERROR, "eth [%s]: tx_fifo write failed %d\n", q->edev->name, status);
         return -1;
     }
     if (actual != count) {
-        zxlogf(ERROR, "eth [%s]: tx_fifo: only wrote %u of %u!\n", edev->name, actual, count);
+        zxlogf(ERROR, "eth [%s]: tx_fifo: only wrote %u of %u!\n", q->edev->name, actual, count);
         return -1;
     }
     return 0;
 }
 
+static void eth_recv_on_queue(ethdev0_t* edev0, uint32_t index,
+                              const ethmac_rx_frame_t* frames, size_t count) {
+    ethq0_t* q0 = &edev0->queues[index];
+    atomic_fetch_add(&q0->rx_packets, count);
+    mtx_lock(&q0->rx_lock);
+    eth_deliver_rx_locked(edev0, index, frames, count, 0);
+    mtx_unlock(&q0->rx_lock);
+}
+
 // TODO: I think if this arrives at the wrong time during teardown we
 // can deadlock with the ethermac device
-static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
+static void eth0_recv_batch(void* cookie, uint32_t queue, const ethmac_rx_frame_t* frames,
+                            size_t count) {
     ethdev0_t* edev0 = cookie;
+    if (edev0->info.features & ETHMAC_FEATURE_MULTIQUEUE) {
+        eth_recv_on_queue(edev0, queue % edev0->nqueues, frames, count);
+        return;
+    }
 
-    ethdev_t* edev;
-    mtx_lock(&edev0->lock);
-    list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        eth_handle_rx(edev, data, len, 0);
+    // Steer each frame by its flow, and deliver those for each queue together.
+    while (count > 0) {
+        ethmac_rx_frame_t steered[FIFO_BATCH_SZ];
+        uint8_t index[FIFO_BATCH_SZ];
+        size_t n = count < countof(index) ? count : countof(index);
+        uint32_t pending = 0;
+        for (size_t i = 0; i < n; i++) {
+            index[i] = (uint8_t)(eth_flow_hash(frames[i].data, frames[i].length) %
+                                 edev0->nqueues);
+            pending |= 1u << index[i];
+        }
+        for (uint32_t q = 0; pending != 0; q++) {
+            if (!(pending & (1u << q))) {
+                continue;
+            }
+            pending &= ~(1u << q);
+            size_t m = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (index[i] == q) {
+                    steered[m++] = frames[i];
+                }
+            }
+            eth_recv_on_queue(edev0, q, steered, m);
+        }
+        frames += n;
+        count -= n;
+    }
+}
+
+static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
+    ethmac_rx_frame_t frame = {.data = data, .length = len, .flags = flags};
+    eth0_recv_batch(cookie, 0, &frame, 1);
+}
+
+static void eth0_recv_queue(void* cookie, uint32_t queue, void* data, size_t len,
+                            uint32_t flags) {
+    ethmac_rx_frame_t frame = {.data = data, .length = len, .flags = flags};
+    eth0_recv_batch(cookie, queue, &frame, 1);
+}
+
+static void eth_account_tx(ethq_t* q, zx_status_t status, uint32_t count) {
+    ethq0_t* q0 = &q->edev->edev0->queues[q->index];
+    atomic_fetch_add(status == ZX_OK ? &q0->tx_packets : &q0->tx_dropped, count);
+}
+
+// Returns the netbufs of a run of completions on one queue to its free list,
+// and their fifo entries to the client in one write.
+static void eth_complete_tx_run(ethq_t* q, tx_info_t** infos, uint32_t count,
+                                zx_status_t status) {
+    eth_fifo_entry_t entries[FIFO_BATCH_SZ];
+    for (uint32_t i = 0; i < count; i++) {
+        ethmac_netbuf_t* netbuf = &infos[i]->netbuf;
+        uint16_t headroom = infos[i]->headroom;
+        entries[i] = (eth_fifo_entry_t){.offset = netbuf->data - q->edev->io_buf - headroom,
+                                        .length = netbuf->len + headroom,
+                                        .flags = status == ZX_OK ? ETH_FIFO_TX_OK : 0,
+                                        .cookie = infos[i]->fifo_cookie};
+    }
+
+    // Now that we've copied all pertinent data from the netbufs, return them to the free list so
+    // they are avaialble immediately for the next request.
+    mtx_lock(&q->lock);
+    for (uint32_t i = 0; i < count; i++) {
+        list_add_head(&q->free_tx_bufs, &infos[i]->netbuf.node);
+    }
+    mtx_unlock(&q->lock);
+
+    eth_account_tx(q, status, count);
+
+    // Send the eth_fifo_entries back to the client
+    tx_fifo_write(q, entries, count);
+}
+
+static void eth0_complete_tx_batch(void* cookie, ethmac_netbuf_t** netbufs, size_t count,
+                                   zx_status_t status) {
+    tx_info_t* run[FIFO_BATCH_SZ];
+    uint32_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        tx_info_t* tx_info = containerof(netbufs[i], tx_info_t, netbuf);
+        if (n > 0 && (n == countof(run) || run[0]->q != tx_info->q)) {
+            eth_complete_tx_run(run[0]->q, run, n, status);
+            n = 0;
+        }
+        run[n++] = tx_info;
+    }
+    if (n > 0) {
+        eth_complete_tx_run(run[0]->q, run, n, status);
     }
-    mtx_unlock(&edev0->lock);
 }
 
 static void eth0_complete_tx(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t status) {
-    tx_info_t* tx_info = containerof(netbuf, tx_info_t, netbuf);
-    ethdev_t* edev = tx_info->edev;
-    eth_fifo_entry_t entry = {.offset = netbuf->data - edev->io_buf,
-                              .length = netbuf->len,
-                              .flags = status == ZX_OK ? ETH_FIFO_TX_OK : 0,
-                              .cookie = tx_info->fifo_cookie};
+    eth0_complete_tx_batch(cookie, &netbuf, 1, status);
+}
+
+static void eth0_complete_rx(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t status) {
+    ethdev0_t* edev0 = cookie;
+    rx_info_t* rx_info = containerof(netbuf, rx_info_t, netbuf);
+    ethq_t* q = rx_info->q;
+    eth_fifo_entry_t e = {
+        .offset = (uint32_t)(netbuf->data - q->edev->io_buf),
+        .length = rx_info->length,
+        .flags = 0,
+        .cookie = rx_info->fifo_cookie,
+    };
+    uint32_t received = 0;
+    uint32_t dropped = 0;
 
-    // Now that we've copied all pertinent data from the netbuf, return it to the free list so
-    // it is avaialble immediately for the next request.
-    mtx_lock(&edev->lock);
-    list_add_head(&edev->free_tx_bufs, &tx_info->netbuf.node);
-    mtx_unlock(&edev->lock);
+    mtx_lock(&q->rx_lock);
+    list_add_head(&q->free_rx_bufs, &netbuf->node);
+    if (status == ZX_OK) {
+        e.length = netbuf->len;
+        e.flags = ETH_FIFO_RX_OK | eth_rx_flags(netbuf->flags);
+        q->rx_done[q->rx_done_count++] = e;
+        dropped = eth_flush_rx_locked(q);
+        received = 1 - dropped;
+    } else {
+        // Handed back unused, so copy into it instead.
+        eth_stash_rx_locked(q, &e);
+    }
+    mtx_unlock(&q->rx_lock);
 
-    // Send the eth_fifo_entry back to the client
-    tx_fifo_write(edev, &entry, 1);
+    ethq0_t* q0 = &edev0->queues[q->index];
+    atomic_fetch_add(&q0->rx_packets, received);
+    atomic_fetch_add(&q0->rx_dropped, dropped);
 }
 
 static ethmac_ifc_t ethmac_ifc = {
     .status = eth0_status,
     .recv = eth0_recv,
     .complete_tx = eth0_complete_tx,
+    .recv_queue = eth0_recv_queue,
+    .recv_batch = eth0_recv_batch,
+    .complete_tx_batch = eth0_complete_tx_batch,
+    .complete_rx = eth0_complete_rx,
 };
 
-static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
-    ethdev_t* edev;
-    mtx_lock(&edev0->lock);
-    list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        if (edev->state & ETHDEV_TX_LISTEN) {
-            eth_handle_rx(edev, data, len, ETH_FIFO_RX_TX);
+static void eth_tx_echo(ethdev0_t* edev0, void* data, size_t len) {
+    ethmac_rx_frame_t frame = {.data = data, .length = len};
+    uint32_t index = eth_flow_hash(data, len) % edev0->nqueues;
+    ethq0_t* q0 = &edev0->queues[index];
+    mtx_lock(&q0->rx_lock);
+    eth_deliver_rx_locked(edev0, index, &frame, 1, ETH_FIFO_RX_TX);
+    mtx_unlock(&q0->rx_lock);
+}
+
+// Looks up the physical address of a buffer the client posted, which must not
+// cross into a discontiguous page.
+static bool eth_rx_phys(ethdev_t* edev, const eth_fifo_entry_t* e, zx_paddr_t* out) {
+    if (e->length == 0) {
+        return false;
+    }
+    size_t first = e->offset / PAGE_SIZE;
+    size_t last = (e->offset + e->length - 1) / PAGE_SIZE;
+    for (size_t page = first; page < last; page++) {
+        if (edev->paddr_map[page] + PAGE_SIZE != edev->paddr_map[page + 1]) {
+            return false;
+        }
+    }
+    *out = edev->paddr_map[first] + (e->offset % PAGE_SIZE);
+    return true;
+}
+
+// Hands a buffer the client posted to the ethmac to receive into, or keeps it
+// to copy into if the ethmac can't take it.
+static void eth_post_rx(ethq_t* q, eth_fifo_entry_t* e) {
+    ethdev_t* edev = q->edev;
+    ethdev0_t* edev0 = edev->edev0;
+    rx_info_t* rx_info = NULL;
+    zx_paddr_t phys;
+
+    mtx_lock(&q->rx_lock);
+    if ((e->offset >= edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
+        // invalid offset/length. report error.
+        e->length = 0;
+        e->flags = ETH_FIFO_INVALID;
+        q->rx_done[q->rx_done_count++] = *e;
+        eth_flush_rx_locked(q);
+    } else if (!eth_rx_phys(edev, e, &phys) ||
+               (rx_info = list_remove_head_type(&q->free_rx_bufs, rx_info_t,
+                                                netbuf.node)) == NULL) {
+        eth_stash_rx_locked(q, e);
+    }
+    mtx_unlock(&q->rx_lock);
+
+    if (rx_info == NULL) {
+        return;
+    }
+    rx_info->fifo_cookie = e->cookie;
+    rx_info->length = e->length;
+    rx_info->netbuf.data = edev->io_buf + e->offset;
+    rx_info->netbuf.phys = phys;
+    rx_info->netbuf.len = e->length;
+    rx_info->netbuf.flags = 0;
+    if (edev0->mac.ops->queue_rx(edev0->mac.ctx, &rx_info->netbuf) != ZX_OK) {
+        mtx_lock(&q->rx_lock);
+        list_add_head(&q->free_rx_bufs, &rx_info->netbuf.node);
+        eth_stash_rx_locked(q, e);
+        mtx_unlock(&q->rx_lock);
+    }
+}
+
+static int eth_rx_post_thread(void* arg) {
+    ethq_t* q = (ethq_t*)arg;
+    eth_fifo_entry_t entries[FIFO_BATCH_SZ];
+    zx_status_t status;
+    uint32_t count;
+
+    for (;;) {
+        if ((status = zx_fifo_read(q->rx_fifo, entries, sizeof(entries), &count)) < 0) {
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                zx_signals_t observed;
+                if ((status = zx_object_wait_one(q->rx_fifo,
+                                                 ZX_FIFO_READABLE |
+                                                 ZX_FIFO_PEER_CLOSED |
+                                                 kSignalFifoTerminate,
+                                                 ZX_TIME_INFINITE,
+                                                 &observed)) < 0) {
+                    zxlogf(ERROR, "eth [%s]: rx_fifo: error waiting: %d\n", q->edev->name, status);
+                    break;
+                }
+                if (observed & kSignalFifoTerminate)
+                    break;
+                continue;
+            } else {
+                zxlogf(ERROR, "eth [%s]: rx_fifo: cannot read: %d\n", q->edev->name, status);
+                break;
+            }
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            eth_post_rx(q, &entries[i]);
+        }
+    }
+
+    zxlogf(INFO, "eth [%s]: rx_post_thread: exit: %d\n", q->edev->name, status);
+    return 0;
+}
+
+static void eth_start_rx_direct_locked(ethdev0_t* edev0, ethq_t* q) {
+    if (q->all_rx_bufs == NULL) {
+        if ((q->all_rx_bufs = calloc(FIFO_DEPTH, sizeof(rx_info_t))) == NULL) {
+            return;
+        }
+        mtx_lock(&q->rx_lock);
+        for (size_t ndx = 0; ndx < FIFO_DEPTH; ndx++) {
+            q->all_rx_bufs[ndx].q = q;
+            list_add_tail(&q->free_rx_bufs, &q->all_rx_bufs[ndx].netbuf.node);
         }
+        mtx_unlock(&q->rx_lock);
     }
+
+    int r = thrd_create_with_name(&q->rx_thr, eth_rx_post_thread, q, "eth-rx-post-thread");
+    if (r != thrd_success) {
+        zxlogf(ERROR, "eth [%s]: failed to start rx post thread: %d\n", q->edev->name, r);
+        return;
+    }
+    edev0->rx_direct = q;
+}
+
+static void eth_stop_rx_direct_locked(ethdev0_t* edev0) TA_NO_THREAD_SAFETY_ANALYSIS {
+    ethq_t* q = edev0->rx_direct;
+    edev0->rx_direct = NULL;
+
+    zx_object_signal(q->rx_fifo, 0, kSignalFifoTerminate);
+    thrd_join(q->rx_thr, NULL);
+    zx_object_signal(q->rx_fifo, kSignalFifoTerminate, 0);
+
+    // The ethmac hands back the buffers it still holds through complete_rx(),
+    // which may wait on its interrupt thread, itself waiting on edev0->lock.
+    edev0->state |= ETHDEV0_BUSY;
     mtx_unlock(&edev0->lock);
+    edev0->mac.ops->flush_rx(edev0->mac.ctx);
+    mtx_lock(&edev0->lock);
+    edev0->state &= ~ETHDEV0_BUSY;
+}
+
+// Has the ethmac receive straight into the buffers of the one instance running,
+// when there is only one. Frames fanned out to several instances, or looped
+// back from tx, are still copied. Called whenever the set of running instances,
+// or whether they listen to tx, changes.
+static void eth0_update_rx_mode_locked(ethdev0_t* edev0) {
+    ethq_t* direct = NULL;
+    if (edev0->info.features & ETHMAC_FEATURE_RX_QUEUE) {
+        ethdev_t* edev = list_peek_head_type(&edev0->list_active, ethdev_t, node);
+        if ((edev != NULL) && (list_next(&edev0->list_active, &edev->node) == NULL) &&
+            !(edev->state & (ETHDEV_DEAD | ETHDEV_TX_LOOPBACK)) && (edev->paddr_map != NULL)) {
+            direct = edev->queues[0];
+            for (uint32_t i = 1; i < ETH_MAX_QUEUES; i++) {
+                if (edev->queues[i] != NULL) {
+                    direct = NULL;
+                }
+            }
+        }
+    }
+
+    if (direct == edev0->rx_direct) {
+        return;
+    }
+    if (edev0->rx_direct != NULL) {
+        eth_stop_rx_direct_locked(edev0);
+    }
+    if (direct != NULL) {
+        eth_start_rx_direct_locked(edev0, direct);
+    }
 }
 
 static zx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
@@ -433,114 +912,224 @@ static zx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
         }
     }
 
+    eth0_update_rx_mode_locked(edev0);
     return ZX_OK;
 }
 
-static int eth_send(ethdev_t* edev, eth_fifo_entry_t* entries, uint32_t count) {
+// Completes the transport checksum of a frame sent with ETH_OFFLOAD_CSUM, for
+// ethmacs which can't.
+static void eth_tx_csum(uint8_t* frame, size_t len, const eth_offload_t* offload) {
+    uint32_t sum = 0;
+    size_t i = offload->csum_start;
+    for (; i + 1 < len; i += 2) {
+        sum += (uint32_t)(frame[i] << 8) | frame[i + 1];
+    }
+    if (i < len) {
+        sum += (uint32_t)(frame[i] << 8);
+    }
+    while (sum > 0xffff) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    // 0 means no checksum to UDP, and is the same as 0xffff to everything else.
+    uint16_t csum = (uint16_t)~sum;
+    if (csum == 0) {
+        csum = 0xffff;
+    }
+    uint8_t* field = frame + offload->csum_start + offload->csum_offset;
+    field[0] = (uint8_t)(csum >> 8);
+    field[1] = (uint8_t)csum;
+}
+
+// Takes the eth_offload_t off the front of a tx entry flagged ETH_FIFO_TX_OFFLOAD
+// into |netbuf|, finishing the checksum here if the ethmac can't. Returns false
+// for an offload the entry or ethmac can't support.
+static bool eth_tx_offload(ethdev_t* edev, const eth_fifo_entry_t* e, ethmac_netbuf_t* netbuf) {
+    const uint32_t features = edev->edev0->info.features;
+    eth_offload_t offload;
+    if (e->length < sizeof(offload)) {
+        return false;
+    }
+    memcpy(&offload, edev->io_buf + e->offset, sizeof(offload));
+    uint8_t* frame = edev->io_buf + e->offset + sizeof(offload);
+    size_t len = e->length - sizeof(offload);
+
+    if (offload.flags & (ETH_OFFLOAD_TSO4 | ETH_OFFLOAD_TSO6)) {
+        if (!(features & ETHMAC_FEATURE_TSO) || !(offload.flags & ETH_OFFLOAD_CSUM) ||
+            (offload.mss == 0) || (offload.hdr_len > len) || (len > edev->edev0->info.tso_max)) {
+            return false;
+        }
+    }
+    if (offload.flags & ETH_OFFLOAD_CSUM) {
+        if ((size_t)offload.csum_start + offload.csum_offset + 2 > len) {
+            return false;
+        }
+        if (!(features & (ETHMAC_FEATURE_TX_CSUM | ETHMAC_FEATURE_TSO))) {
+            eth_tx_csum(frame, len, &offload);
+            offload.flags &= ~ETH_OFFLOAD_CSUM;
+        }
+    }
+    netbuf->offload = offload;
+    return true;
+}
+
+static int eth_send(ethq_t* q, eth_fifo_entry_t* entries, uint32_t count) {
+    ethdev_t* edev = q->edev;
     ethdev0_t* edev0 = edev->edev0;
+    const uint32_t queue_opt = (edev0->info.features & ETHMAC_FEATURE_MULTIQUEUE) ?
+                               ETHMAC_TX_OPT_QUEUE(q->index) : 0u;
+    // Entries finished here are compacted to the front of |entries|, to go back
+    // to the client in one fifo write.
+    uint32_t done = 0;
     for (eth_fifo_entry_t* e = entries; count > 0; e++) {
         if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
             e->flags = ETH_FIFO_INVALID;
-            tx_fifo_write(edev, e, 1);
+            eth_account_tx(q, ZX_ERR_INVALID_ARGS, 1);
+            entries[done++] = *e;
         } else {
             zx_status_t status;
-            mtx_lock(&edev->lock);
-            tx_info_t* tx_info = list_remove_head_type(&edev->free_tx_bufs, tx_info_t, netbuf.node);
-            mtx_unlock(&edev->lock);
+            mtx_lock(&q->lock);
+            tx_info_t* tx_info = list_remove_head_type(&q->free_tx_bufs, tx_info_t, netbuf.node);
+            mtx_unlock(&q->lock);
             if (tx_info == NULL) {
                  zxlogf(ERROR, "eth [%s]: invalid tx_info pool\n", edev->name);
+                 if (done > 0) {
+                     tx_fifo_write(q, entries, done);
+                 }
                  return -1;
             }
             uint32_t opts = count > 1 ? ETHMAC_TX_OPT_MORE : 0u;
             if (opts) {
                 zxlogf(SPEW, "setting OPT_MORE (%u packets to go)\n", count);
             }
-            tx_info->netbuf.data = edev->io_buf + e->offset;
+            memset(&tx_info->netbuf.offload, 0, sizeof(tx_info->netbuf.offload));
+            tx_info->headroom = 0;
+            if (e->flags & ETH_FIFO_TX_OFFLOAD) {
+                if (!eth_tx_offload(edev, e, &tx_info->netbuf)) {
+                    mtx_lock(&q->lock);
+                    list_add_head(&q->free_tx_bufs, &tx_info->netbuf.node);
+                    mtx_unlock(&q->lock);
+                    e->flags = ETH_FIFO_INVALID;
+                    eth_account_tx(q, ZX_ERR_INVALID_ARGS, 1);
+                    entries[done++] = *e;
+                    count--;
+                    continue;
+                }
+                tx_info->headroom = sizeof(eth_offload_t);
+            }
+            uint32_t offset = e->offset + tx_info->headroom;
+            tx_info->netbuf.data = edev->io_buf + offset;
             if (edev0->info.features & ETHMAC_FEATURE_DMA) {
-                tx_info->netbuf.phys = edev->paddr_map[e->offset / PAGE_SIZE] +
-                                       (e->offset & PAGE_MASK);
+                tx_info->netbuf.phys = edev->paddr_map[offset / PAGE_SIZE] +
+                                       (offset & PAGE_MASK);
             }
-            tx_info->netbuf.len = e->length;
+            tx_info->netbuf.len = (uint16_t)(e->length - tx_info->headroom);
             tx_info->fifo_cookie = e->cookie;
-            status = edev0->mac.ops->queue_tx(edev0->mac.ctx, opts, &tx_info->netbuf);
+            status = edev0->mac.ops->queue_tx(edev0->mac.ctx, opts | queue_opt, &tx_info->netbuf);
             if (edev->state & ETHDEV_TX_LOOPBACK) {
-                eth_tx_echo(edev0, edev->io_buf + e->offset, e->length);
+                eth_tx_echo(edev0, tx_info->netbuf.data, tx_info->netbuf.len);
             }
             if (status != ZX_ERR_SHOULD_WAIT) {
                 // transaction completed, add buffer to free list and return fifo entry
-                // TODO: batch these so we can do a single fifo write
                 e->flags = status == ZX_OK ? ETH_FIFO_TX_OK : 0;
-                mtx_lock(&edev->lock);
-                list_add_head(&edev->free_tx_bufs, &tx_info->netbuf.node);
-                mtx_unlock(&edev->lock);
-                tx_fifo_write(edev, e, 1);
+                mtx_lock(&q->lock);
+                list_add_head(&q->free_tx_bufs, &tx_info->netbuf.node);
+                mtx_unlock(&q->lock);
+                eth_account_tx(q, status, 1);
+                entries[done++] = *e;
             }
         }
         count--;
     }
+    if (done > 0) {
+        tx_fifo_write(q, entries, done);
+    }
     return 0;
 }
 
 static int eth_tx_thread(void* arg) {
-    ethdev_t* edev = (ethdev_t*)arg;
+    ethq_t* q = (ethq_t*)arg;
     eth_fifo_entry_t entries[FIFO_DEPTH / 2];
     zx_status_t status;
     uint32_t count;
 
     for (;;) {
-        if ((status = zx_fifo_read(edev->tx_fifo, entries, sizeof(entries), &count)) < 0) {
+        if ((status = zx_fifo_read(q->tx_fifo, entries, sizeof(entries), &count)) < 0) {
             if (status == ZX_ERR_SHOULD_WAIT) {
                 zx_signals_t observed;
-                if ((status = zx_object_wait_one(edev->tx_fifo,
+                if ((status = zx_object_wait_one(q->tx_fifo,
                                                  ZX_FIFO_READABLE |
                                                  ZX_FIFO_PEER_CLOSED |
                                                  kSignalFifoTerminate,
                                                  ZX_TIME_INFINITE,
                                                  &observed)) < 0) {
-                    zxlogf(ERROR, "eth [%s]: tx_fifo: error waiting: %d\n", edev->name, status);
+                    zxlogf(ERROR, "eth [%s]: tx_fifo: error waiting: %d\n", q->edev->name, status);
                     break;
                 }
                 if (observed & kSignalFifoTerminate)
                     break;
                 continue;
             } else {
-                zxlogf(ERROR, "eth [%s]: tx_fifo: cannot read: %d\n", edev->name, status);
+                zxlogf(ERROR, "eth [%s]: tx_fifo: cannot read: %d\n", q->edev->name, status);
                 break;
             }
         }
-        if (eth_send(edev, entries, count)) {
+        if (eth_send(q, entries, count)) {
             break;
         }
     }
 
-    zxlogf(INFO, "eth [%s]: tx_thread: exit: %d\n", edev->name, status);
+    zxlogf(INFO, "eth [%s]: tx_thread %u: exit: %d\n", q->edev->name, q->index, status);
     return 0;
 }
 
-static zx_status_t eth_get_fifos_locked(ethdev_t* edev, void* out_buf, size_t out_len,
-                                        size_t* out_actual) {
+static zx_status_t eth_get_fifos_locked(ethdev_t* edev, uint32_t index, void* out_buf,
+                                        size_t out_len, size_t* out_actual) {
     if (out_len < sizeof(eth_fifos_t)) {
         return ZX_ERR_INVALID_ARGS;
     }
-    if (edev->tx_fifo != ZX_HANDLE_INVALID) {
+    if (index >= edev->edev0->nqueues) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    if (edev->queues[index] != NULL) {
         return ZX_ERR_ALREADY_BOUND;
     }
+    // Queues are only published to the rx path when the instance starts.
+    if (edev->state & ETHDEV_RUNNING) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    ethq_t* q;
+    if ((q = calloc(1, sizeof(ethq_t))) == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    q->edev = edev;
+    q->index = index;
+    mtx_init(&q->rx_lock, mtx_plain);
+    mtx_init(&q->lock, mtx_plain);
+    list_initialize(&q->free_tx_bufs);
+    list_initialize(&q->free_rx_bufs);
+    for (size_t ndx = 0; ndx < FIFO_DEPTH; ndx++) {
+        q->all_tx_bufs[ndx].q = q;
+        list_add_tail(&q->free_tx_bufs, &q->all_tx_bufs[ndx].netbuf.node);
+    }
 
     eth_fifos_t* fifos = out_buf;
 
     zx_status_t status;
-    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->tx_fifo, &edev->tx_fifo)) < 0) {
+    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->tx_fifo, &q->tx_fifo)) < 0) {
         zxlogf(ERROR, "eth_create  [%s]: failed to create tx fifo: %d\n", edev->name, status);
+        free(q);
         return status;
     }
-    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->rx_fifo, &edev->rx_fifo)) < 0) {
+    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->rx_fifo, &q->rx_fifo)) < 0) {
         zxlogf(ERROR, "eth_create  [%s]: failed to create rx fifo: %d\n", edev->name, status);
         zx_handle_close(fifos->tx_fifo);
-        zx_handle_close(edev->tx_fifo);
-        edev->tx_fifo = ZX_HANDLE_INVALID;
+        zx_handle_close(q->tx_fifo);
+        free(q);
         return status;
     }
 
+    edev->queues[index] = q;
     edev->tx_depth = FIFO_DEPTH;
     edev->rx_depth = FIFO_DEPTH;
     fifos->tx_depth = FIFO_DEPTH;
@@ -550,6 +1139,25 @@ static zx_status_t eth_get_fifos_locked(ethdev_t* edev, void* out_buf, size_t ou
     return ZX_OK;
 }
 
+static zx_status_t eth_get_stats_locked(ethdev_t* edev, void* out_buf, size_t out_len,
+                                        size_t* out_actual) {
+    if (out_len < sizeof(eth_stats_t)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    ethdev0_t* edev0 = edev->edev0;
+    eth_stats_t* stats = out_buf;
+    memset(stats, 0, sizeof(*stats));
+    stats->queues = edev0->nqueues;
+    for (uint32_t i = 0; i < edev0->nqueues; i++) {
+        stats->queue[i].rx_packets = atomic_load(&edev0->queues[i].rx_packets);
+        stats->queue[i].rx_dropped = atomic_load(&edev0->queues[i].rx_dropped);
+        stats->queue[i].tx_packets = atomic_load(&edev0->queues[i].tx_packets);
+        stats->queue[i].tx_dropped = atomic_load(&edev0->queues[i].tx_dropped);
+    }
+    *out_actual = sizeof(*stats);
+    return ZX_OK;
+}
+
 static ssize_t eth_set_iobuf_locked(ethdev_t* edev, const void* in_buf, size_t in_len) {
     if (in_len < sizeof(zx_handle_t)) {
         return ZX_ERR_INVALID_ARGS;
@@ -582,8 +1190,13 @@ static ssize_t eth_set_iobuf_locked(ethdev_t* edev, const void* in_buf, size_t i
             status = ZX_ERR_NO_MEMORY;
             goto fail;
         }
-        // TODO: pin memory
-        if ((status = zx_vmo_op_range(edev->io_vmo, ZX_VMO_OP_LOOKUP, 0, size, &edev->paddr_map,
+        // Committed pages stay put, so their addresses may be handed to the
+        // ethmac to receive into. TODO: pin memory
+        if ((status = zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT, 0, size, NULL, 0)) != ZX_OK) {
+            zxlogf(ERROR, "eth [%s]: could not commit io_buf: %d\n", edev->name, status);
+            goto fail;
+        }
+        if ((status = zx_vmo_op_range(vmo, ZX_VMO_OP_LOOKUP, 0, size, edev->paddr_map,
                                       paddr_map_size)) != ZX_OK) {
             zxlogf(ERROR, "eth [%s]: vmo_op_range failed, can't determine phys addr\n", edev->name);
             goto fail;
@@ -612,9 +1225,7 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
     ethdev0_t* edev0 = edev->edev0;
 
     // Cannot start unless tx/rx rings are configured
-    if ((edev->io_vmo == ZX_HANDLE_INVALID) ||
-        (edev->tx_fifo == ZX_HANDLE_INVALID) ||
-        (edev->rx_fifo == ZX_HANDLE_INVALID)) {
+    if ((edev->io_vmo == ZX_HANDLE_INVALID) || (edev->queues[0] == NULL)) {
         return ZX_ERR_BAD_STATE;
     }
 
@@ -622,14 +1233,20 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
         return ZX_OK;
     }
 
-    if (!(edev->state & ETHDEV_TX_THREAD)) {
-        int r = thrd_create_with_name(&edev->tx_thr, eth_tx_thread,
-                                      edev, "eth-tx-thread");
+    // Each queue's tx fifo is serviced by a thread of its own.
+    for (uint32_t i = 0; i < edev0->nqueues; i++) {
+        ethq_t* q = edev->queues[i];
+        if (q == NULL || q->tx_thread) {
+            continue;
+        }
+        char name[ZX_MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "eth-tx-thread-%u", i);
+        int r = thrd_create_with_name(&q->tx_thr, eth_tx_thread, q, name);
         if (r != thrd_success) {
-            zxlogf(ERROR, "eth [%s]: failed to start tx thread: %d\n", edev->name, r);
+            zxlogf(ERROR, "eth [%s]: failed to start tx thread %u: %d\n", edev->name, i, r);
             return ZX_ERR_INTERNAL;
         }
-        edev->state |= ETHDEV_TX_THREAD;
+        q->tx_thread = true;
     }
 
     zx_status_t status;
@@ -647,8 +1264,11 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
 
     if (status == ZX_OK) {
         edev->state |= ETHDEV_RUNNING;
+        eth0_lock_rx(edev0);
         list_delete(&edev->node);
         list_add_tail(&edev0->list_active, &edev->node);
+        eth0_unlock_rx(edev0);
+        eth0_update_rx_mode_locked(edev0);
         // TODO - After we get IGMP, don't automatically set multicast promisc true
         eth_set_multicast_promisc_locked(edev, true);
     } else {
@@ -665,8 +1285,11 @@ static zx_status_t eth_stop_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
 
     if (edev->state & ETHDEV_RUNNING) {
         edev->state &= (~ETHDEV_RUNNING);
+        eth0_lock_rx(edev0);
         list_delete(&edev->node);
         list_add_tail(&edev0->list_idle, &edev->node);
+        eth0_unlock_rx(edev0);
+        eth0_update_rx_mode_locked(edev0);
         // The next three lines clean up promisc, multicast-promisc, and multicast-filter, in case
         // this ethdev had any state set. Ignore failures, which may come from drivers not
         // supporting the feature. (TODO: check failure codes).
@@ -703,10 +1326,10 @@ static zx_status_t eth_get_status_locked(ethdev_t* edev, void* out_buf, size_t o
     if (out_len < sizeof(uint32_t)) {
         return ZX_ERR_INVALID_ARGS;
     }
-    if (edev->rx_fifo == ZX_HANDLE_INVALID) {
+    if (edev->queues[0] == NULL || edev->queues[0]->rx_fifo == ZX_HANDLE_INVALID) {
         return ZX_ERR_BAD_STATE;
     }
-    if (zx_object_signal_peer(edev->rx_fifo, ETH_SIGNAL_STATUS, 0) != ZX_OK) {
+    if (zx_object_signal_peer(edev->queues[0]->rx_fifo, ETH_SIGNAL_STATUS, 0) != ZX_OK) {
         return ZX_ERR_INTERNAL;
     }
 
@@ -749,14 +1372,35 @@ static zx_status_t eth_ioctl(void* ctx, uint32_t op,
             if (edev->edev0->info.features & ETHMAC_FEATURE_SYNTH) {
                 info->features |= ETH_FEATURE_SYNTH;
             }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_TX_CSUM) {
+                info->features |= ETH_FEATURE_TX_CSUM;
+            }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_RX_CSUM) {
+                info->features |= ETH_FEATURE_RX_CSUM;
+            }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_TSO) {
+                info->features |= ETH_FEATURE_TSO;
+                info->tso_max = edev->edev0->info.tso_max;
+            }
             info->mtu = edev->edev0->info.mtu;
+            info->queues = edev->edev0->nqueues;
             *out_actual = sizeof(*info);
             status = ZX_OK;
         }
         break;
     }
     case IOCTL_ETHERNET_GET_FIFOS:
-        status = eth_get_fifos_locked(edev, out_buf, out_len, out_actual);
+        status = eth_get_fifos_locked(edev, 0, out_buf, out_len, out_actual);
+        break;
+    case IOCTL_ETHERNET_GET_QUEUE_FIFOS:
+        if (in_len != sizeof(uint32_t) || in_buf == NULL) {
+            status = ZX_ERR_INVALID_ARGS;
+            goto done;
+        }
+        status = eth_get_fifos_locked(edev, *(uint32_t*)in_buf, out_buf, out_len, out_actual);
+        break;
+    case IOCTL_ETHERNET_GET_STATS:
+        status = eth_get_stats_locked(edev, out_buf, out_len, out_actual);
         break;
     case IOCTL_ETHERNET_SET_IOBUF:
         status = eth_set_iobuf_locked(edev, in_buf, in_len);
@@ -812,37 +1456,50 @@ static void eth_kill_locked(ethdev_t* edev) {
         return;
     }
 
-    zxlogf(TRACE, "eth [%s]: kill: tearing down%s\n",
-            edev->name, (edev->state & ETHDEV_TX_THREAD) ? " tx thread" : "");
+    zxlogf(TRACE, "eth [%s]: kill: tearing down\n", edev->name);
     eth_set_promisc_locked(edev, false);
 
     // make sure any future ioctls or other ops will fail
     edev->state |= ETHDEV_DEAD;
+    eth0_update_rx_mode_locked(edev->edev0);
 
     // try to convince clients to close us
-    if (edev->rx_fifo) {
-        zx_handle_close(edev->rx_fifo);
-        edev->rx_fifo = ZX_HANDLE_INVALID;
+    eth0_lock_rx(edev->edev0);
+    for (uint32_t i = 0; i < ETH_MAX_QUEUES; i++) {
+        ethq_t* q = edev->queues[i];
+        if (q != NULL && q->rx_fifo) {
+            zx_handle_close(q->rx_fifo);
+            q->rx_fifo = ZX_HANDLE_INVALID;
+        }
     }
-    if (edev->tx_fifo) {
-        // Ask the TX thread to exit.
-        zx_object_signal(edev->tx_fifo, 0, kSignalFifoTerminate);
+    eth0_unlock_rx(edev->edev0);
+    for (uint32_t i = 0; i < ETH_MAX_QUEUES; i++) {
+        ethq_t* q = edev->queues[i];
+        if (q != NULL && q->tx_fifo) {
+            // Ask the TX thread to exit.
+            zx_object_signal(q->tx_fifo, 0, kSignalFifoTerminate);
+        }
     }
     if (edev->io_vmo) {
         zx_handle_close(edev->io_vmo);
         edev->io_vmo = ZX_HANDLE_INVALID;
     }
 
-    if (edev->state & ETHDEV_TX_THREAD) {
-        edev->state &= (~ETHDEV_TX_THREAD);
-        int ret;
-        thrd_join(edev->tx_thr, &ret);
-        zxlogf(TRACE, "eth [%s]: kill: tx thread exited\n", edev->name);
-    }
-
-    if (edev->tx_fifo) {
-        zx_handle_close(edev->tx_fifo);
-        edev->tx_fifo = ZX_HANDLE_INVALID;
+    for (uint32_t i = 0; i < ETH_MAX_QUEUES; i++) {
+        ethq_t* q = edev->queues[i];
+        if (q == NULL) {
+            continue;
+        }
+        if (q->tx_thread) {
+            q->tx_thread = false;
+            int ret;
+            thrd_join(q->tx_thr, &ret);
+            zxlogf(TRACE, "eth [%s]: kill: tx thread %u exited\n", edev->name, i);
+        }
+        if (q->tx_fifo) {
+            zx_handle_close(q->tx_fifo);
+            q->tx_fifo = ZX_HANDLE_INVALID;
+        }
     }
 
     if (edev->io_buf) {
@@ -858,6 +1515,12 @@ static void eth_release(void* ctx) {
     ethdev_t* edev = ctx;
     if (edev) {
         free(edev->paddr_map);
+        for (uint32_t i = 0; i < ETH_MAX_QUEUES; i++) {
+            if (edev->queues[i] != NULL) {
+                free(edev->queues[i]->all_rx_bufs);
+            }
+            free(edev->queues[i]);
+        }
     }
     free(edev);
 }
@@ -890,13 +1553,6 @@ static zx_status_t eth0_open(void* ctx, zx_device_t** out, uint32_t flags) {
     }
     edev->edev0 = edev0;
 
-    list_initialize(&edev->free_tx_bufs);
-    for (size_t ndx = 0; ndx < FIFO_DEPTH; ndx++) {
-        edev->all_tx_bufs[ndx].edev = edev;
-        list_add_tail(&edev->free_tx_bufs, &edev->all_tx_bufs[ndx].netbuf.node);
-    }
-    mtx_init(&edev->lock, mtx_plain);
-
     device_add_args_t args = {
         .version = DEVICE_ADD_ARGS_VERSION,
         .name = "ethernet",
@@ -925,6 +1581,12 @@ static void eth0_unbind(void* ctx) {
 
     mtx_lock(&edev0->lock);
 
+    // Take back the buffers the ethmac holds first, as that may drop the lock,
+    // which can't be done while walking the lists below.
+    if (edev0->rx_direct != NULL) {
+        eth_stop_rx_direct_locked(edev0);
+    }
+
     // tear down shared memory, fifos, and threads
     // to encourage any open instances to close
     ethdev_t* edev;
@@ -979,7 +1641,30 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev) {
         goto fail;
     }
 
+    // Receiving into client buffers takes their physical addresses, and is
+    // left to the ethmac's own queues when it has several.
+    if ((edev0->info.features & ETHMAC_FEATURE_RX_QUEUE) &&
+        (!(edev0->info.features & ETHMAC_FEATURE_DMA) ||
+         (edev0->info.features & ETHMAC_FEATURE_MULTIQUEUE) ||
+         ops->queue_rx == NULL || ops->flush_rx == NULL)) {
+        edev0->info.features &= ~ETHMAC_FEATURE_RX_QUEUE;
+    }
+
+    if (edev0->info.features & ETHMAC_FEATURE_MULTIQUEUE) {
+        edev0->nqueues = edev0->info.queues;
+    } else {
+        edev0->nqueues = zx_system_get_num_cpus();
+    }
+    if (edev0->nqueues == 0) {
+        edev0->nqueues = 1;
+    } else if (edev0->nqueues > ETH_MAX_QUEUES) {
+        edev0->nqueues = ETH_MAX_QUEUES;
+    }
+
     mtx_init(&edev0->lock, mtx_plain);
+    for (uint32_t i = 0; i < edev0->nqueues; i++) {
+        mtx_init(&edev0->queues[i].rx_lock, mtx_plain);
+    }
     list_initialize(&edev0->list_active);
     list_initialize(&edev0->list_idle);
 
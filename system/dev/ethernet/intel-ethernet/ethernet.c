@@ -43,8 +43,91 @@ typedef struct ethernet_device {
     // callback interface to attached ethernet layer
     ethmac_ifc_t* ifc;
     void* cookie;
+
+    // Moving average of frames taken per rx interrupt, scaled by 4, and the
+    // interrupt interval chosen from it
+    uint32_t rx_per_irq;
+    uint32_t irq_interval;
 } ethernet_device_t;
 
+// Interrupt intervals, in 256ns units, for light, moderate and heavy rx load. Light load
+// is unthrottled to keep latency down; heavy load is held to about 8000 interrupts a second.
+#define IRQ_INTERVAL_LOW_LATENCY 0
+#define IRQ_INTERVAL_MODERATE 196
+#define IRQ_INTERVAL_BULK 488
+
+static void rx_deliver(ethernet_device_t* edev, ethmac_rx_frame_t* frames, size_t count) {
+    if (edev->ifc->recv_batch) {
+        edev->ifc->recv_batch(edev->cookie, 0, frames, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            edev->ifc->recv(edev->cookie, frames[i].data, frames[i].length, 0);
+        }
+    }
+}
+
+// Takes frames off the rx ring and hands them up a ringful at a time, until
+// the ring is found empty. Frames received into posted buffers are completed
+// in order with those copied. Returns the number of frames taken. Called with
+// edev->lock held.
+static uint32_t rx_drain(ethernet_device_t* edev) {
+    uint32_t total = 0;
+    for (;;) {
+        ethmac_rx_frame_t frames[ETH_RXBUF_COUNT];
+        uint32_t count = 0;
+        uint32_t n;
+        void* data;
+        size_t len;
+        ethmac_netbuf_t* netbuf;
+        bool deliver = edev->ifc && (edev->state == ETH_RUNNING);
+        for (n = 0; n < ETH_RXBUF_COUNT && eth_rx(&edev->eth, n, &data, &len, &netbuf) == ZX_OK;
+             n++) {
+            if (netbuf == NULL) {
+                frames[count++] = (ethmac_rx_frame_t){.data = data, .length = len};
+                continue;
+            }
+            if (deliver && count > 0) {
+                rx_deliver(edev, frames, count);
+            }
+            count = 0;
+            netbuf->len = len;
+            edev->ifc->complete_rx(edev->cookie, netbuf, ZX_OK);
+        }
+        if (n == 0) {
+            break;
+        }
+        if (deliver && count > 0) {
+            rx_deliver(edev, frames, count);
+        }
+        eth_rx_ack(&edev->eth, n);
+        total += n;
+    }
+    return total;
+}
+
+// Drains the rx ring with the rx interrupt masked, so that a burst of frames
+// costs one interrupt. The interrupt interval then adapts to how many frames
+// each interrupt found. Called with edev->lock held.
+static void rx_poll(ethernet_device_t* edev) {
+    eth_disable_rx_irq(&edev->eth);
+    uint32_t total = rx_drain(edev);
+    eth_enable_rx_irq(&edev->eth);
+
+    edev->rx_per_irq = (edev->rx_per_irq * 3 + total * 4) / 4;
+    uint32_t interval;
+    if (edev->rx_per_irq >= 4 * (ETH_RXBUF_COUNT / 2)) {
+        interval = IRQ_INTERVAL_BULK;
+    } else if (edev->rx_per_irq >= 4 * 4) {
+        interval = IRQ_INTERVAL_MODERATE;
+    } else {
+        interval = IRQ_INTERVAL_LOW_LATENCY;
+    }
+    if (interval != edev->irq_interval) {
+        edev->irq_interval = interval;
+        eth_set_irq_interval(&edev->eth, interval);
+    }
+}
+
 static int irq_thread(void* arg) {
     ethernet_device_t* edev = arg;
     for (;;) {
@@ -58,15 +141,7 @@ static int irq_thread(void* arg) {
         mtx_lock(&edev->lock);
         unsigned irq = eth_handle_irq(&edev->eth);
         if (irq & ETH_IRQ_RX) {
-            void* data;
-            size_t len;
-
-            while (eth_rx(&edev->eth, &data, &len) == ZX_OK) {
-                if (edev->ifc && (edev->state == ETH_RUNNING)) {
-                    edev->ifc->recv(edev->cookie, data, len, 0);
-                }
-                eth_rx_ack(&edev->eth);
-            }
+            rx_poll(edev);
         }
         if (irq & ETH_IRQ_LSC) {
             bool was_online = edev->online;
@@ -92,6 +167,7 @@ static zx_status_t eth_query(void* ctx, uint32_t options, ethmac_info_t* info) {
 
     memset(info, 0, sizeof(*info));
     ZX_DEBUG_ASSERT(ETH_TXBUF_SIZE >= ETH_MTU);
+    info->features = ETHMAC_FEATURE_DMA | ETHMAC_FEATURE_RX_QUEUE;
     info->mtu = ETH_MTU;
     memcpy(info->mac, edev->eth.mac, sizeof(edev->eth.mac));
 
@@ -154,12 +230,52 @@ static zx_status_t eth_set_param(void *ctx, uint32_t param, int32_t value, void*
     return status;
 }
 
+static zx_status_t eth_queue_rx(void* ctx, ethmac_netbuf_t* netbuf) {
+    ethernet_device_t* edev = ctx;
+    // The hw may fill the whole buffer a descriptor names.
+    if (netbuf->len < ETH_RXBUF_SIZE) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    mtx_lock(&edev->lock);
+    eth_rx_post(&edev->eth, netbuf);
+    mtx_unlock(&edev->lock);
+    return ZX_OK;
+}
+
+static void eth_flush_rx(void* ctx) {
+    ethernet_device_t* edev = ctx;
+    list_node_t reclaimed = LIST_INITIAL_VALUE(reclaimed);
+
+    mtx_lock(&edev->lock);
+    eth_disable_rx(&edev->eth);
+    mtx_unlock(&edev->lock);
+    // Give the hw time to finish writing any frame it was receiving.
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+
+    mtx_lock(&edev->lock);
+    rx_drain(edev);
+    eth_rx_reclaim(&edev->eth, &reclaimed);
+    if (edev->state == ETH_RUNNING) {
+        eth_enable_rx(&edev->eth);
+    }
+    ethmac_ifc_t* ifc = edev->ifc;
+    void* cookie = edev->cookie;
+    mtx_unlock(&edev->lock);
+
+    ethmac_netbuf_t* netbuf;
+    while ((netbuf = list_remove_head_type(&reclaimed, ethmac_netbuf_t, node)) != NULL) {
+        ifc->complete_rx(cookie, netbuf, ZX_ERR_CANCELED);
+    }
+}
+
 static ethmac_protocol_ops_t ethmac_ops = {
     .query = eth_query,
     .stop = eth_stop,
     .start = eth_start,
     .queue_tx = eth_queue_tx,
     .set_param = eth_set_param,
+    .queue_rx = eth_queue_rx,
+    .flush_rx = eth_flush_rx,
 };
 
 static zx_status_t eth_suspend(void* ctx, uint32_t flags) {
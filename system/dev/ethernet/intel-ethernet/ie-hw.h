@@ -19,6 +19,7 @@
 #define IE_ICS       0x00C8 // Interrupt Cause Set
 #define IE_IMS       0x00D0 // Interrupt Mask Set / Read
 #define IE_IMC       0x00D8 // Interrupt Mask Clear
+#define IE_ITR       0x00C4 // Interrupt Throttling Rate
 
 #define IE_RCTL      0x0100 // Receive Control
 #define IE_RDBAL     0x2800 // RX Descriptor Base Low
@@ -49,8 +49,8 @@ bool eth_status_online(ethdev_t* eth) {
     return readl(IE_STATUS) & IE_STATUS_LU;
 }
 
-status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
-    uint32_t n = eth->rx_rd_ptr;
+status_t eth_rx(ethdev_t* eth, uint32_t n, void** data, size_t* len, ethmac_netbuf_t** netbuf) {
+    n = (eth->rx_rd_ptr + n) & (ETH_RXBUF_COUNT - 1);
     uint64_t info = eth->rxd[n].info;
 
     if (!(info & IE_RXD_DONE)) {
@@ -60,22 +60,51 @@ status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
     // copy out packet
     zx_status_t r = IE_RXD_LEN(info);
 
-    *data = eth->rxb + ETH_RXBUF_SIZE * n;
+    *netbuf = eth->rx_netbuf[n];
+    *data = *netbuf ? (*netbuf)->data : eth->rxb + ETH_RXBUF_SIZE * n;
     *len = r;
 
     return ZX_OK;
 }
 
-void eth_rx_ack(ethdev_t* eth) {
+void eth_rx_ack(ethdev_t* eth, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
     uint32_t n = eth->rx_rd_ptr;
-
-    // make buffer available to hw
-    eth->rxd[n].info = 0;
-    writel(n, IE_RDT);
-    n = (n + 1) & (ETH_RXBUF_COUNT - 1);
+    uint32_t last = n;
+
+    // make buffers available to hw
+    for (; count > 0; count--) {
+        ethmac_netbuf_t* netbuf = list_remove_head_type(&eth->rx_posted, ethmac_netbuf_t, node);
+        eth->rx_netbuf[n] = netbuf;
+        eth->rxd[n].addr = netbuf ? netbuf->phys : eth->rxb_phys + ETH_RXBUF_SIZE * n;
+        eth->rxd[n].info = 0;
+        last = n;
+        n = (n + 1) & (ETH_RXBUF_COUNT - 1);
+    }
+    writel(last, IE_RDT);
     eth->rx_rd_ptr = n;
 }
 
+void eth_rx_post(ethdev_t* eth, ethmac_netbuf_t* netbuf) {
+    list_add_tail(&eth->rx_posted, &netbuf->node);
+}
+
+void eth_rx_reclaim(ethdev_t* eth, list_node_t* out) {
+    ethmac_netbuf_t* netbuf;
+    while ((netbuf = list_remove_head_type(&eth->rx_posted, ethmac_netbuf_t, node)) != NULL) {
+        list_add_tail(out, &netbuf->node);
+    }
+    for (uint32_t n = 0; n < ETH_RXBUF_COUNT; n++) {
+        if (eth->rx_netbuf[n] != NULL) {
+            list_add_tail(out, &eth->rx_netbuf[n]->node);
+            eth->rx_netbuf[n] = NULL;
+            eth->rxd[n].addr = eth->rxb_phys + ETH_RXBUF_SIZE * n;
+        }
+    }
+}
+
 void eth_enable_rx(ethdev_t* eth) {
     uint32_t rctl = readl(IE_RCTL);
     writel(rctl | IE_RCTL_EN, IE_RCTL);
@@ -86,6 +115,18 @@ void eth_disable_rx(ethdev_t* eth) {
     writel(rctl & ~IE_RCTL_EN, IE_RCTL);
 }
 
+void eth_enable_rx_irq(ethdev_t* eth) {
+    writel(IE_INT_RXT0, IE_IMS);
+}
+
+void eth_disable_rx_irq(ethdev_t* eth) {
+    writel(IE_INT_RXT0, IE_IMC);
+}
+
+void eth_set_irq_interval(ethdev_t* eth, uint32_t interval) {
+    writel(interval, IE_ITR);
+}
+
 static void reap_tx_buffers(ethdev_t* eth) {
     uint32_t n = eth->tx_rd_ptr;
     for (;;) {
@@ -321,6 +362,7 @@ void eth_setup_buffers(ethdev_t* eth, void* iomem, zx_paddr_t iophys) {
 
     list_initialize(&eth->free_frames);
     list_initialize(&eth->busy_frames);
+    list_initialize(&eth->rx_posted);
 
     eth->rxd = iomem;
     eth->rxd_phys = iophys;
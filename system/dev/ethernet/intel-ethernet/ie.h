@@ -6,8 +6,15 @@
 
 #include <threads.h>
 
+#include <ddk/protocol/ethernet.h>
+
 #include "ie-hw.h"
 
+#define ETH_MTU 1500
+
+#define ETH_RXBUF_SIZE  2048
+#define ETH_RXBUF_COUNT 32
+
 typedef struct framebuf framebuf_t;
 typedef struct ethdev ethdev_t;
 
@@ -32,6 +39,11 @@ struct ethdev {
     list_node_t free_frames;
     list_node_t busy_frames;
 
+    // Buffers posted to receive into, waiting for a descriptor, and the
+    // posted buffer each descriptor holds, if not one of rxb
+    list_node_t rx_posted;
+    ethmac_netbuf_t* rx_netbuf[ETH_RXBUF_COUNT];
+
     // base physical addresses for
     // tx/rx rings and rx buffers
     // store as 64bit integer to match hw register size
@@ -46,10 +58,6 @@ struct ethdev {
     mtx_t send_lock;
 };
 
-#define ETH_MTU 1500
-
-#define ETH_RXBUF_SIZE  2048
-#define ETH_RXBUF_COUNT 32
 
 #define ETH_TXBUF_SIZE  2048
 #define ETH_TXBUF_COUNT 32
@@ -68,10 +76,21 @@ void eth_init_hw(ethdev_t* eth);
 
 void eth_dump_regs(ethdev_t* eth);
 
-status_t eth_rx(ethdev_t* eth, void** data, size_t* len);
-void eth_rx_ack(ethdev_t* eth);
+// Returns the frame |n| past the next to be acked, once the hw has filled it,
+// and the posted buffer it was received into, if any.
+status_t eth_rx(ethdev_t* eth, uint32_t n, void** data, size_t* len, ethmac_netbuf_t** netbuf);
+// Returns the descriptors of the next |count| frames to the hw, with posted
+// buffers in place of their own where there are any.
+void eth_rx_ack(ethdev_t* eth, uint32_t count);
+// Posts a buffer of at least ETH_RXBUF_SIZE bytes to receive into.
+void eth_rx_post(ethdev_t* eth, ethmac_netbuf_t* netbuf);
+// Moves every posted buffer not yet received into onto |out|. Must be called
+// with rx disabled and every filled frame acked.
+void eth_rx_reclaim(ethdev_t* eth, list_node_t* out);
 void eth_enable_rx(ethdev_t* eth);
 void eth_disable_rx(ethdev_t* eth);
+void eth_enable_rx_irq(ethdev_t* eth);
+void eth_disable_rx_irq(ethdev_t* eth);
 
 status_t eth_tx(ethdev_t* eth, const void* data, size_t len);
 size_t eth_tx_queued(ethdev_t* eth);
@@ -89,3 +108,5 @@ bool eth_status_online(ethdev_t* eth);
 #define ETH_IRQ_RX IE_INT_RXT0
 #define ETH_IRQ_LSC IE_INT_LSC
 unsigned eth_handle_irq(ethdev_t* eth);
+// Sets the least time between interrupts, in 256ns units; 0 is unthrottled.
+void eth_set_irq_interval(ethdev_t* eth, uint32_t interval);
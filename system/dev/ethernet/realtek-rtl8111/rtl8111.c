@@ -64,8 +64,18 @@ typedef struct ethernet_device {
 
     ethmac_ifc_t* ifc;
     void* cookie;
+
+    // Moving average of frames taken per rx interrupt, scaled by 4, and the
+    // interrupt mitigation chosen from it
+    uint32_t rx_per_irq;
+    uint16_t intrmit;
 } ethernet_device_t;
 
+// Interrupt mitigation under light and heavy rx load. Light load interrupts on
+// every frame to keep latency down.
+#define INTRMIT_LOW_LATENCY 0
+#define INTRMIT_BULK (RTL_INTRMIT_RX_TIMER(0xf) | RTL_INTRMIT_RX_FRAMES(4))
+
 static void rtl8111_init_buffers(ethernet_device_t* edev) {
     zxlogf(TRACE, "rtl8111: Initializing buffers\n");
     edev->txd_ring = io_buffer_virt(&edev->buffer);
@@ -152,6 +162,64 @@ static void rtl8111_init_regs(ethernet_device_t* edev) {
             edev->online ? "online" : "offline");
 }
 
+static void rtl8111_rx_deliver(ethernet_device_t* edev, ethmac_rx_frame_t* frames, size_t count) {
+    if (edev->ifc->recv_batch) {
+        edev->ifc->recv_batch(edev->cookie, 0, frames, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            edev->ifc->recv(edev->cookie, frames[i].data, frames[i].length, 0);
+        }
+    }
+}
+
+// Takes frames off the rx ring and hands them up a ringful at a time, with the
+// rx interrupt masked until the ring is found empty, so that a burst of frames
+// costs one interrupt. The interrupt mitigation then adapts to how many frames
+// each interrupt found. Called with edev->lock held.
+static void rtl8111_rx_poll(ethernet_device_t* edev) {
+    writew(RTL_IMR, readw(RTL_IMR) & ~RTL_INT_ROK);
+    uint32_t total = 0;
+    for (;;) {
+        ethmac_rx_frame_t frames[ETH_BUF_COUNT];
+        int idx = edev->rxd_idx;
+        size_t count = 0;
+        eth_desc_t* rxd;
+        while (count < ETH_BUF_COUNT && !((rxd = edev->rxd_ring + idx)->status1 & RX_DESC_OWN)) {
+            frames[count++] = (ethmac_rx_frame_t){
+                .data = edev->rxb + (idx * ETH_BUF_SIZE),
+                .length = rxd->status1 & RX_DESC_LEN_MASK,
+            };
+            idx = (idx + 1) % ETH_BUF_COUNT;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        if (edev->ifc) {
+            rtl8111_rx_deliver(edev, frames, count);
+        } else {
+            zxlogf(ERROR, "rtl8111: No ethmac callback, dropping %zu packets\n", count);
+        }
+
+        // Return the descriptors to the hw
+        for (size_t i = 0; i < count; i++) {
+            bool is_end = edev->rxd_idx == (ETH_BUF_COUNT - 1);
+            edev->rxd_ring[edev->rxd_idx].status1 =
+                RX_DESC_OWN | (is_end ? RX_DESC_EOR : 0) | ETH_BUF_SIZE;
+            edev->rxd_idx = (edev->rxd_idx + 1) % ETH_BUF_COUNT;
+        }
+        total += count;
+    }
+    writew(RTL_IMR, readw(RTL_IMR) | RTL_INT_ROK);
+
+    edev->rx_per_irq = (edev->rx_per_irq * 3 + total * 4) / 4;
+    uint16_t intrmit = edev->rx_per_irq >= 4 * 8 ? INTRMIT_BULK : INTRMIT_LOW_LATENCY;
+    if (intrmit != edev->intrmit) {
+        edev->intrmit = intrmit;
+        writew(RTL_INTRMIT, intrmit);
+    }
+}
+
 static int irq_thread(void* arg) {
     ethernet_device_t* edev = arg;
     while (1) {
@@ -164,7 +232,10 @@ static int irq_thread(void* arg) {
 
         mtx_lock(&edev->lock);
 
+        // Acknowledge before handling, so that anything arriving meanwhile
+        // raises the interrupt again.
         uint16_t isr = readw(RTL_ISR);
+        writew(RTL_ISR, isr);
         if (isr & RTL_INT_LINKCHG) {
             bool was_online = edev->online;
             bool online = readb(RTL_PHYSTATUS) & RTL_PHYSTATUS_LINKSTS;
@@ -180,25 +251,9 @@ static int irq_thread(void* arg) {
             cnd_signal(&edev->tx_cond);
         }
         if (isr & RTL_INT_ROK) {
-            eth_desc_t* rxd;
-            while (!((rxd = edev->rxd_ring + edev->rxd_idx)->status1 & RX_DESC_OWN)) {
-                if (edev->ifc) {
-                    size_t len = rxd->status1 & RX_DESC_LEN_MASK;
-                    edev->ifc->recv(
-                        edev->cookie, edev->rxb + (edev->rxd_idx * ETH_BUF_SIZE), len, 0);
-                } else {
-                    zxlogf(ERROR, "rtl8111: No ethmac callback, dropping packet\n");
-                }
-
-                bool is_end = edev->rxd_idx == (ETH_BUF_COUNT - 1);
-                rxd->status1 = RX_DESC_OWN | (is_end ? RX_DESC_EOR : 0) | ETH_BUF_SIZE;
-
-                edev->rxd_idx = (edev->rxd_idx + 1) % ETH_BUF_COUNT;
-            }
+            rtl8111_rx_poll(edev);
         }
 
-        writew(RTL_ISR, 0xffff);
-
         mtx_unlock(&edev->lock);
     }
     return 0;
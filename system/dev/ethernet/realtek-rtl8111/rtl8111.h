@@ -40,6 +40,7 @@
 #define RTL_PHYSTATUS 0x006c
 #define RTL_RMS 0x00da
 #define RTL_CPLUSCR 0x00e0
+#define RTL_INTRMIT 0x00e2
 #define RTL_RDSAR_LOW 0x00e4
 #define RTL_RDSAR_HIGH 0x00e8
 #define RTL_MTPS 0x00ec
@@ -81,6 +82,11 @@
 
 #define RTL_MTPS_MTPS_MASK 0x1f
 
+// Interrupt mitigation: hold the rx interrupt until |frames| * 4 frames have arrived or the
+// timer expires
+#define RTL_INTRMIT_RX_TIMER(t) (((t) & 0xf) << 4)
+#define RTL_INTRMIT_RX_FRAMES(n) ((n) & 0xf)
+
 #define TX_DESC_OWN (1 << 31)
 #define TX_DESC_EOR (1 << 30)
 #define TX_DESC_FS (1 << 29)
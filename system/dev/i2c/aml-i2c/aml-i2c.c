@@ -18,12 +18,14 @@
 #include <hw/reg.h>
 
 #include <zircon/assert.h>
+#include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 
 #include <soc/aml-common/aml-i2c.h>
 
-#define I2C_ERROR_SIGNAL ZX_USER_SIGNAL_0
-#define I2C_TXN_COMPLETE_SIGNAL ZX_USER_SIGNAL_1
+// Port packet keys
+#define I2C_PORT_KEY_IRQ 0u
+#define I2C_PORT_KEY_TXN 1u
 
 #define AML_I2C_CONTROL_REG_START      (uint32_t)(1 << 0)
 #define AML_I2C_CONTROL_REG_ACK_IGNORE (uint32_t)(1 << 1)
@@ -31,6 +33,12 @@
 #define AML_I2C_CONTROL_REG_ERR        (uint32_t)(1 << 3)
 
 #define AML_I2C_MAX_TRANSFER 256
+#define AML_I2C_MAX_SEGMENTS 8
+
+// What the controller does in one go: a list of up to 16 tokens, moving up
+// to 8 bytes each way.
+#define AML_I2C_RUN_TOKENS 16
+#define AML_I2C_RUN_BYTES  8
 
 typedef volatile struct {
     uint32_t    control;
@@ -55,7 +63,9 @@ typedef enum {
 
 typedef struct {
     zx_handle_t         irq;
-    zx_handle_t         event;
+    // The worker thread waits here both for the interrupt and for new
+    // transactions, so a transfer costs no thread handoffs.
+    zx_handle_t         port;
     pdev_vmo_buffer_t   regs_iobuff;
     aml_i2c_regs_t*     virt_regs;
     zx_duration_t       timeout;
@@ -64,7 +74,6 @@ typedef struct {
     list_node_t         connections;
     list_node_t         txn_list;
     list_node_t         free_txn_list;
-    completion_t        txn_active;
     mtx_t               conn_mutex;
     mtx_t               txn_mutex;
 } aml_i2c_dev_t;
@@ -76,17 +85,34 @@ typedef struct {
     aml_i2c_dev_t  *dev;
 } aml_i2c_connection_t;
 
+typedef struct {
+    bool        read;
+    uint32_t    len;
+} aml_i2c_segment_t;
+
 typedef struct aml_i2c_txn {
     list_node_t            node;
+    // write data of all the write segments, back to back, and the same for
+    // the read data
     uint8_t                tx_buff[AML_I2C_MAX_TRANSFER];
     uint8_t                rx_buff[AML_I2C_MAX_TRANSFER];
-    uint32_t               tx_len;
     uint32_t               rx_len;
+    aml_i2c_segment_t      segments[AML_I2C_MAX_SEGMENTS];
+    uint32_t               segment_count;
     aml_i2c_connection_t   *conn;
     i2c_complete_cb        cb;
     void*                  cookie;
 } aml_i2c_txn_t;
 
+// The controller run being built up by aml_i2c_transfer().
+typedef struct {
+    uint64_t    tokens;
+    uint32_t    token_count;
+    uint64_t    wdata;
+    uint32_t    write_count;
+    uint32_t    read_count;
+} aml_i2c_run_t;
+
 typedef struct {
     platform_device_protocol_t pdev;
     i2c_protocol_t i2c;
@@ -95,8 +121,7 @@ typedef struct {
     size_t dev_count;
 } aml_i2c_t;
 
-static zx_status_t aml_i2c_read(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len);
-static zx_status_t aml_i2c_write(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len);
+static zx_status_t aml_i2c_transfer(aml_i2c_dev_t *dev, aml_i2c_txn_t *txn);
 
 static zx_status_t aml_i2c_set_slave_addr(aml_i2c_dev_t *dev, uint16_t addr) {
 
@@ -109,30 +134,6 @@ static zx_status_t aml_i2c_set_slave_addr(aml_i2c_dev_t *dev, uint16_t addr) {
     return ZX_OK;
 }
 
-static int aml_i2c_irq_thread(void *arg) {
-
-    aml_i2c_dev_t *dev = arg;
-    zx_status_t status;
-
-    while (1) {
-        uint64_t slots;
-        status = zx_interrupt_wait(dev->irq, &slots);
-        if (status != ZX_OK) {
-            zxlogf(ERROR, "i2c: interrupt error\n");
-            continue;
-        }
-
-        uint32_t reg =  dev->virt_regs->control;
-        if (reg & AML_I2C_CONTROL_REG_ERR) {
-            zx_object_signal(dev->event, 0, I2C_ERROR_SIGNAL);
-            zxlogf(ERROR,"i2c: error on bus\n");
-        } else {
-            zx_object_signal(dev->event, 0, I2C_TXN_COMPLETE_SIGNAL);
-        }
-    }
-    return ZX_OK;
-}
-
 static int aml_i2c_thread(void *arg) {
 
     aml_i2c_dev_t *dev = arg;
@@ -143,17 +144,10 @@ static int aml_i2c_thread(void *arg) {
         while ((txn = list_remove_tail_type(&dev->txn_list, aml_i2c_txn_t, node)) != NULL) {
             mtx_unlock(&dev->txn_mutex);
             aml_i2c_set_slave_addr(dev, txn->conn->slave_addr);
-            if (txn->tx_len > 0) {
-                aml_i2c_write(dev,txn->tx_buff, txn->tx_len);
-                if ((txn->cb) && (txn->rx_len == 0)) {
-                    txn->cb(ZX_OK, NULL, txn->rx_len, txn->cookie);
-                }
-            }
-            if (txn->rx_len > 0) {
-                aml_i2c_read(dev, txn->rx_buff, txn->rx_len);
-                if (txn->cb) {
-                    txn->cb(ZX_OK, txn->rx_buff, txn->rx_len, txn->cookie);
-                }
+            zx_status_t status = aml_i2c_transfer(dev, txn);
+            if (txn->cb) {
+                txn->cb(status, txn->rx_len ? txn->rx_buff : NULL,
+                        status == ZX_OK ? txn->rx_len : 0, txn->cookie);
             }
             memset(txn, 0, sizeof(aml_i2c_txn_t));
             mtx_lock(&dev->txn_mutex);
@@ -162,8 +156,17 @@ static int aml_i2c_thread(void *arg) {
         }
         mtx_unlock(&dev->txn_mutex);
 
-        completion_wait(&dev->txn_active, ZX_TIME_INFINITE);
-        completion_reset(&dev->txn_active);
+        // Sleep until aml_i2c_queue_txn() finds the list empty and wakes
+        // us. A stray interrupt packet just goes round the loop again.
+        zx_port_packet_t packet;
+        zx_status_t status = zx_port_wait(dev->port, ZX_TIME_INFINITE, &packet, 0);
+        if (status != ZX_OK) {
+            zxlogf(ERROR, "i2c: port wait failed %d\n", status);
+            return status;
+        }
+        if (packet.key == I2C_PORT_KEY_IRQ) {
+            zx_interrupt_ack(dev->irq, packet.interrupt.slots);
+        }
     }
     return 0;
 }
@@ -202,174 +205,210 @@ static aml_i2c_txn_t *aml_i2c_get_txn(aml_i2c_connection_t *conn) {
 }
 
 static inline void aml_i2c_queue_txn(aml_i2c_connection_t *conn, aml_i2c_txn_t *txn) {
-    mtx_lock(&conn->dev->txn_mutex);
-    list_add_head(&conn->dev->txn_list, &txn->node);
-    mtx_unlock(&conn->dev->txn_mutex);
+    aml_i2c_dev_t *dev = conn->dev;
+    mtx_lock(&dev->txn_mutex);
+    // The worker only sleeps with the list empty, so it only needs waking
+    // by whoever makes it non-empty.
+    bool wake = list_is_empty(&dev->txn_list);
+    list_add_head(&dev->txn_list, &txn->node);
+    mtx_unlock(&dev->txn_mutex);
+
+    if (wake) {
+        zx_port_packet_t packet = {
+            .key = I2C_PORT_KEY_TXN,
+            .type = ZX_PKT_TYPE_USER,
+        };
+        zx_port_queue(dev->port, &packet, 0);
+    }
 }
 
-static inline zx_status_t aml_i2c_queue_async(aml_i2c_connection_t *conn, const uint8_t *txbuff,
-                                                            uint32_t txlen, uint32_t rxlen,
-                                                            i2c_complete_cb cb, void* cookie) {
+static zx_status_t aml_i2c_queue_segments(aml_i2c_connection_t *conn,
+                                          const i2c_segment_t *segments, size_t count,
+                                          i2c_complete_cb cb, void* cookie) {
     ZX_DEBUG_ASSERT(conn);
-    ZX_DEBUG_ASSERT(txlen <= AML_I2C_MAX_TRANSFER);
-    ZX_DEBUG_ASSERT(rxlen <= AML_I2C_MAX_TRANSFER);
 
-    aml_i2c_txn_t *txn;
+    if (count == 0 || count > AML_I2C_MAX_SEGMENTS) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    size_t tx_len = 0, rx_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (segments[i].length == 0) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        switch (segments[i].type) {
+        case I2C_SEGMENT_WRITE:
+            if (!segments[i].write_buf) {
+                return ZX_ERR_INVALID_ARGS;
+            }
+            tx_len += segments[i].length;
+            break;
+        case I2C_SEGMENT_READ:
+            rx_len += segments[i].length;
+            break;
+        default:
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+    if (tx_len > AML_I2C_MAX_TRANSFER || rx_len > AML_I2C_MAX_TRANSFER) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
 
-    txn = aml_i2c_get_txn(conn);
+    aml_i2c_txn_t *txn = aml_i2c_get_txn(conn);
     if (!txn) return ZX_ERR_NO_MEMORY;
 
-    memcpy(txn->tx_buff, txbuff, txlen);
-    txn->tx_len = txlen;
-    txn->rx_len = rxlen;
+    uint8_t *tx = txn->tx_buff;
+    for (size_t i = 0; i < count; i++) {
+        txn->segments[i].read = segments[i].type == I2C_SEGMENT_READ;
+        txn->segments[i].len = segments[i].length;
+        if (!txn->segments[i].read) {
+            memcpy(tx, segments[i].write_buf, segments[i].length);
+            tx += segments[i].length;
+        }
+    }
+    txn->segment_count = (uint32_t)count;
+    txn->rx_len = (uint32_t)rx_len;
     txn->cb = cb;
     txn->cookie = cookie;
     txn->conn = conn;
 
-    aml_i2c_queue_txn(conn,txn);
-    completion_signal(&conn->dev->txn_active);
+    aml_i2c_queue_txn(conn, txn);
 
     return ZX_OK;
 }
 
-static zx_status_t aml_i2c_rd_async(aml_i2c_connection_t *conn, uint32_t len, i2c_complete_cb cb,
-                                                            void* cookie) {
-
-    return aml_i2c_queue_async(conn, NULL, 0, len, cb, cookie);
+// Waits for the interrupt that ends the current run.
+static zx_status_t aml_i2c_wait_irq(aml_i2c_dev_t* dev) {
+    zx_time_t deadline = zx_deadline_after(dev->timeout);
+    for (;;) {
+        zx_port_packet_t packet;
+        zx_status_t status = zx_port_wait(dev->port, deadline, &packet, 0);
+        if (status != ZX_OK) {
+            return status;
+        }
+        // New transactions are picked up once this one is done.
+        if (packet.key != I2C_PORT_KEY_IRQ) {
+            continue;
+        }
+        zx_interrupt_ack(dev->irq, packet.interrupt.slots);
+        if (dev->virt_regs->control & AML_I2C_CONTROL_REG_ERR) {
+            zxlogf(ERROR, "i2c: error on bus\n");
+            return ZX_ERR_IO;
+        }
+        return ZX_OK;
+    }
 }
 
-static zx_status_t aml_i2c_wr_async(aml_i2c_connection_t *conn, const uint8_t *buff, uint32_t len,
-                                                            i2c_complete_cb cb, void* cookie) {
-
-    ZX_DEBUG_ASSERT(buff);
-    return aml_i2c_queue_async(conn, buff, len, 0, cb, cookie);
-}
+// Has the controller carry out the run, and collects what it read.
+static zx_status_t aml_i2c_run(aml_i2c_dev_t *dev, aml_i2c_run_t *run, uint8_t **rx) {
+    if (run->token_count == 0) {
+        return ZX_OK;
+    }
 
-static zx_status_t aml_i2c_wr_rd_async(aml_i2c_connection_t *conn, const uint8_t *txbuff,
-                                       uint32_t txlen, uint32_t rxlen, i2c_complete_cb cb,
-                                       void* cookie) {
-    ZX_DEBUG_ASSERT(txbuff);
-    return aml_i2c_queue_async(conn, txbuff, txlen, rxlen, cb, cookie);
-}
+    dev->virt_regs->token_list_0 = (uint32_t)(run->tokens & 0xffffffff);
+    dev->virt_regs->token_list_1 = (uint32_t)((run->tokens >> 32) & 0xffffffff);
+    dev->virt_regs->token_wdata_0 = (uint32_t)(run->wdata & 0xffffffff);
+    dev->virt_regs->token_wdata_1 = (uint32_t)((run->wdata >> 32) & 0xffffffff);
 
-static zx_status_t aml_i2c_wait_event(aml_i2c_dev_t* dev, uint32_t sig_mask) {
+    //clear registers to prevent data leaking from last xfer
+    dev->virt_regs->token_rdata_0 = 0;
+    dev->virt_regs->token_rdata_1 = 0;
 
-    zx_time_t deadline = zx_deadline_after(dev->timeout);
-    uint32_t observed;
-    sig_mask |= I2C_ERROR_SIGNAL;
-    zx_status_t status = zx_object_wait_one(dev->event, sig_mask, deadline, &observed);
+    aml_i2c_start_xfer(dev);
+    zx_status_t status = aml_i2c_wait_irq(dev);
     if (status != ZX_OK) {
         return status;
     }
-    zx_object_signal(dev->event,observed,0);
-    if (observed & I2C_ERROR_SIGNAL)
-        return ZX_ERR_TIMED_OUT;
-    return ZX_OK;
-}
-
-
-static zx_status_t aml_i2c_write(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len) {
-    ZX_DEBUG_ASSERT(len <= AML_I2C_MAX_TRANSFER);
-    uint32_t token_num = 0;
-    uint64_t token_reg = 0;
-
-    token_reg |= (uint64_t)TOKEN_START << (4*(token_num++));
-    token_reg |= (uint64_t)TOKEN_SLAVE_ADDR_WR << (4*(token_num++));
 
-    while (len > 0) {
-        bool is_last_iter = len <= 8;
-        uint32_t tx_size = is_last_iter ? len : 8;
-        for (uint32_t i=0; i < tx_size; i++) {
-            token_reg |= (uint64_t)TOKEN_DATA << (4*(token_num++));
-        }
-
-        if (is_last_iter) {
-            token_reg |= (uint64_t)TOKEN_STOP << (4*(token_num++));
+    if (run->read_count) {
+        uint64_t rdata;
+        rdata = dev->virt_regs->token_rdata_0;
+        rdata |= (uint64_t)(dev->virt_regs->token_rdata_1) << 32;
+        for (uint32_t i = 0; i < run->read_count; i++) {
+            *(*rx)++ = (uint8_t)((rdata >> (8*i) & 0xff));
         }
+    }
 
-        dev->virt_regs->token_list_0 = (uint32_t)(token_reg & 0xffffffff);
-        dev->virt_regs->token_list_1 =
-            (uint32_t)((token_reg >> 32) & 0xffffffff);
+    memset(run, 0, sizeof(*run));
+    return ZX_OK;
+}
 
-        uint64_t wdata = 0;
-        for (uint32_t i=0; i < tx_size; i++) {
-            wdata |= (uint64_t)buff[i] << (8*i);
+// Adds a token to the run, first carrying out the run if there isn't room
+// for |tokens_needed| more tokens.
+static zx_status_t aml_i2c_add_token(aml_i2c_dev_t *dev, aml_i2c_run_t *run, uint8_t **rx,
+                                     aml_i2c_token_t token, uint32_t tokens_needed) {
+    if (run->token_count + tokens_needed > AML_I2C_RUN_TOKENS) {
+        zx_status_t status = aml_i2c_run(dev, run, rx);
+        if (status != ZX_OK) {
+            return status;
         }
+    }
+    run->tokens |= (uint64_t)token << (4 * run->token_count++);
+    return ZX_OK;
+}
 
-        dev->virt_regs->token_wdata_0 = (uint32_t)(wdata & 0xffffffff);
-        dev->virt_regs->token_wdata_1 = (uint32_t)((wdata >> 32) & 0xffffffff);
-
-        aml_i2c_start_xfer(dev);
-        //while (dev->virt_regs->control & 0x4) ;;    // wait for idle
-        zx_status_t status = aml_i2c_wait_event(dev, I2C_TXN_COMPLETE_SIGNAL);
+// Adds a data token moving one byte, first carrying out the run if it
+// already moves as many bytes that way as the controller can.
+static zx_status_t aml_i2c_add_data(aml_i2c_dev_t *dev, aml_i2c_run_t *run, uint8_t **rx,
+                                    aml_i2c_token_t token, bool read, uint8_t wbyte) {
+    if ((read ? run->read_count : run->write_count) == AML_I2C_RUN_BYTES) {
+        zx_status_t status = aml_i2c_run(dev, run, rx);
         if (status != ZX_OK) {
             return status;
         }
-
-        len -= tx_size;
-        buff += tx_size;
-        token_num = 0;
-        token_reg = 0;
     }
-
+    zx_status_t status = aml_i2c_add_token(dev, run, rx, token, 1);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (read) {
+        run->read_count++;
+    } else {
+        run->wdata |= (uint64_t)wbyte << (8 * run->write_count++);
+    }
     return ZX_OK;
 }
 
-static zx_status_t aml_i2c_read(aml_i2c_dev_t *dev, uint8_t *buff, uint32_t len) {
-
-    ZX_DEBUG_ASSERT(len <= AML_I2C_MAX_TRANSFER);
-    uint32_t token_num = 0;
-    uint64_t token_reg = 0;
-
-    token_reg |= (uint64_t)TOKEN_START << (4*(token_num++));
-    token_reg |= (uint64_t)TOKEN_SLAVE_ADDR_RD << (4*(token_num++));
+// Carries out all the segments of |txn| as one transaction, packing as many
+// tokens into each controller run as fit, with a repeated start between
+// segments and a single stop at the end.
+static zx_status_t aml_i2c_transfer(aml_i2c_dev_t *dev, aml_i2c_txn_t *txn) {
+    aml_i2c_run_t run = {};
+    const uint8_t *tx = txn->tx_buff;
+    uint8_t *rx = txn->rx_buff;
+    zx_status_t status;
 
-    while (len > 0) {
-        bool is_last_iter = len <= 8;
-        uint32_t rx_size = is_last_iter ? len : 8;
+    for (uint32_t i = 0; i < txn->segment_count; i++) {
+        const aml_i2c_segment_t *segment = &txn->segments[i];
 
-        for (uint32_t i=0; i < (rx_size - 1); i++) {
-            token_reg |= (uint64_t)TOKEN_DATA << (4*(token_num++));
-        }
-        if (is_last_iter) {
-            token_reg |= (uint64_t)TOKEN_DATA_LAST << (4*(token_num++));
-            token_reg |= (uint64_t)TOKEN_STOP << (4*(token_num++));
-        } else {
-            token_reg |= (uint64_t)TOKEN_DATA << (4*(token_num++));
+        // keep the start and the address together in one run
+        status = aml_i2c_add_token(dev, &run, &rx, TOKEN_START, 2);
+        if (status != ZX_OK) {
+            return status;
         }
-
-        dev->virt_regs->token_list_0 = (uint32_t)(token_reg & 0xffffffff);
-        token_reg = token_reg >> 32;
-        dev->virt_regs->token_list_1 = (uint32_t)(token_reg);
-
-        //clear registers to prevent data leaking from last xfer
-        dev->virt_regs->token_rdata_0 = 0;
-        dev->virt_regs->token_rdata_1 = 0;
-
-        aml_i2c_start_xfer(dev);
-
-        zx_status_t status = aml_i2c_wait_event(dev, I2C_TXN_COMPLETE_SIGNAL);
+        status = aml_i2c_add_token(dev, &run, &rx,
+                                   segment->read ? TOKEN_SLAVE_ADDR_RD : TOKEN_SLAVE_ADDR_WR, 1);
         if (status != ZX_OK) {
             return status;
         }
 
-        //while (dev->virt_regs->control & 0x4) ;;    // wait for idle
-
-        uint64_t rdata;
-        rdata = dev->virt_regs->token_rdata_0;
-        rdata |= (uint64_t)(dev->virt_regs->token_rdata_1) << 32;
-
-        for (uint32_t i=0; i < sizeof(rdata); i++) {
-            buff[i] = (uint8_t)((rdata >> (8*i) & 0xff));
+        for (uint32_t j = 0; j < segment->len; j++) {
+            if (segment->read) {
+                aml_i2c_token_t token = j == segment->len - 1 ? TOKEN_DATA_LAST : TOKEN_DATA;
+                status = aml_i2c_add_data(dev, &run, &rx, token, true, 0);
+            } else {
+                status = aml_i2c_add_data(dev, &run, &rx, TOKEN_DATA, false, *tx++);
+            }
+            if (status != ZX_OK) {
+                return status;
+            }
         }
-
-        len -= rx_size;
-        buff += rx_size;
-        token_num = 0;
-        token_reg = 0;
     }
 
-    return ZX_OK;
+    status = aml_i2c_add_token(dev, &run, &rx, TOKEN_STOP, 1);
+    if (status != ZX_OK) {
+        return status;
+    }
+    return aml_i2c_run(dev, &run, &rx);
 }
 
 static zx_status_t aml_i2c_connect(aml_i2c_connection_t **connection,
@@ -429,8 +468,6 @@ static zx_status_t aml_i2c_dev_init(aml_i2c_t* i2c, unsigned index) {
     mtx_init(&device->conn_mutex, mtx_plain);
     mtx_init(&device->txn_mutex, mtx_plain);
 
-    device->txn_active =  COMPLETION_INIT;
-
     device->timeout = ZX_SEC(1);
 
     zx_status_t status;
@@ -449,23 +486,25 @@ static zx_status_t aml_i2c_dev_init(aml_i2c_t* i2c, unsigned index) {
         goto init_fail;
     }
 
-    status = zx_event_create(0, &device->event);
+    status = zx_port_create(0, &device->port);
     if (status != ZX_OK) {
         goto init_fail;
     }
 
+    status = zx_interrupt_bind_port(device->irq, device->port, I2C_PORT_KEY_IRQ, 0);
+    if (status != ZX_OK) {
+        goto init_fail;
+    }
 
     thrd_t thrd;
     thrd_create_with_name(&thrd, aml_i2c_thread, device, "i2c_thread");
-    thrd_t irqthrd;
-    thrd_create_with_name(&irqthrd, aml_i2c_irq_thread, device, "i2c_irq_thread");
 
     return ZX_OK;
 
 init_fail:
     if (device) {
         pdev_vmo_buffer_release(&device->regs_iobuff);
-        zx_handle_close(device->event);
+        zx_handle_close(device->port);
         zx_handle_close(device->irq);
         free(device);
      }
@@ -478,9 +517,30 @@ static zx_status_t aml_i2c_transact(void* ctx, const void* write_buf, size_t wri
     if (read_length > AML_I2C_MAX_TRANSFER || write_length > AML_I2C_MAX_TRANSFER) {
         return ZX_ERR_OUT_OF_RANGE;
     }
+    i2c_segment_t segments[2];
+    size_t count = 0;
+    if (write_length) {
+        segments[count++] = (i2c_segment_t){
+            .type = I2C_SEGMENT_WRITE,
+            .length = (uint32_t)write_length,
+            .write_buf = write_buf,
+        };
+    }
+    if (read_length) {
+        segments[count++] = (i2c_segment_t){
+            .type = I2C_SEGMENT_READ,
+            .length = (uint32_t)read_length,
+        };
+    }
+    aml_i2c_connection_t* connection = ctx;
+    return aml_i2c_queue_segments(connection, segments, count, complete_cb, cookie);
+}
+
+static zx_status_t aml_i2c_transact_segments(void* ctx, const i2c_segment_t* segments,
+                                             size_t count, i2c_complete_cb complete_cb,
+                                             void* cookie) {
     aml_i2c_connection_t* connection = ctx;
-    return aml_i2c_wr_rd_async(connection, write_buf, write_length, read_length, complete_cb,
-                               cookie);
+    return aml_i2c_queue_segments(connection, segments, count, complete_cb, cookie);
 }
 
 static zx_status_t aml_i2c_set_bitrate(void* ctx, uint32_t bitrate) {
@@ -503,6 +563,7 @@ static i2c_channel_ops_t aml_i2c_channel_ops = {
     .set_bitrate = aml_i2c_set_bitrate,
     .get_max_transfer_size = aml_i2c_get_max_transfer_size,
     .channel_release = aml_i2c_channel_release,
+    .transact_segments = aml_i2c_transact_segments,
 };
 
 static zx_status_t aml_i2c_get_channel(void* ctx, uint32_t channel_id, i2c_channel_t* channel) {
@@ -547,7 +608,7 @@ static void aml_i2c_release(void* ctx) {
     for (unsigned i = 0; i < i2c->dev_count; i++) {
         aml_i2c_dev_t* device = &i2c->i2c_devs[i];
         pdev_vmo_buffer_release(&device->regs_iobuff);
-        zx_handle_close(device->event);
+        zx_handle_close(device->port);
         zx_handle_close(device->irq);
     }
     free(i2c);
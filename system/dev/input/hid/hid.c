@@ -13,8 +13,11 @@
 
 #include <zircon/assert.h>
 #include <zircon/listnode.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
 
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -39,6 +42,10 @@
 // needs a hack as well.
 #define BOOT_MOUSE_HACK 1
 
+// Size of the data area of an instance's report ring. At 1000 reports a
+// second of up to 16 bytes each, this holds half a second of input.
+#define HID_RING_SIZE 16384
+
 typedef struct hid_report_size {
     int16_t id;
     input_report_size_t in_size;
@@ -81,6 +88,13 @@ typedef struct hid_instance {
 
     zx_hid_fifo_t fifo;
 
+    // Once the client has asked for it, reports are written to the ring
+    // instead of the fifo. Guarded by fifo.lock.
+    zx_handle_t ring_vmo;
+    zx_handle_t ring_event;
+    input_report_ring_t* ring;
+    size_t ring_map_size;
+
     struct list_node node;
 } hid_instance_t;
 
@@ -266,6 +280,98 @@ static zx_status_t hid_set_report(hid_device_t* hid, const void* in_buf, size_t
 }
 
 
+static zx_status_t hid_create_report_ring_locked(hid_instance_t* inst) {
+    size_t size = ROUNDUP(sizeof(input_report_ring_t) + HID_RING_SIZE, PAGE_SIZE);
+    zx_status_t status = zx_vmo_create(size, 0, &inst->ring_vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    uintptr_t addr;
+    status = zx_vmar_map(zx_vmar_root_self(), 0, inst->ring_vmo, 0, size,
+                         ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr);
+    if (status == ZX_OK) {
+        status = zx_event_create(0, &inst->ring_event);
+        if (status != ZX_OK) {
+            zx_vmar_unmap(zx_vmar_root_self(), addr, size);
+        }
+    }
+    if (status != ZX_OK) {
+        zx_handle_close(inst->ring_vmo);
+        inst->ring_vmo = ZX_HANDLE_INVALID;
+        return status;
+    }
+    inst->ring = (input_report_ring_t*)addr;
+    inst->ring->size = HID_RING_SIZE;
+    inst->ring_map_size = size;
+    return ZX_OK;
+}
+
+static zx_status_t hid_get_report_ring(hid_instance_t* inst, void* out_buf, size_t out_len,
+                                       size_t* out_actual) {
+    if (out_len < sizeof(input_report_ring_handles_t)) return ZX_ERR_INVALID_ARGS;
+
+    mtx_lock(&inst->fifo.lock);
+    zx_status_t status = ZX_OK;
+    if (inst->ring == NULL) {
+        status = hid_create_report_ring_locked(inst);
+    }
+    input_report_ring_handles_t* reply = out_buf;
+    if (status == ZX_OK) {
+        status = zx_handle_duplicate(inst->ring_vmo,
+                                     ZX_RIGHT_READ | ZX_RIGHT_MAP | ZX_RIGHT_TRANSFER |
+                                     ZX_RIGHT_DUPLICATE,
+                                     &reply->vmo);
+    }
+    if (status == ZX_OK) {
+        status = zx_handle_duplicate(inst->ring_event,
+                                     ZX_RIGHT_WAIT | ZX_RIGHT_SIGNAL | ZX_RIGHT_TRANSFER |
+                                     ZX_RIGHT_DUPLICATE,
+                                     &reply->event);
+        if (status != ZX_OK) {
+            zx_handle_close(reply->vmo);
+        }
+    }
+    mtx_unlock(&inst->fifo.lock);
+
+    if (status == ZX_OK) {
+        *out_actual = sizeof(*reply);
+    }
+    return status;
+}
+
+// Appends a report to the ring of |inst|, overwriting the oldest records if
+// the client has not kept up. See zircon/device/input.h for the layout.
+static void hid_write_report_ring_locked(hid_instance_t* inst, const uint8_t* report,
+                                         size_t len, zx_time_t timestamp) {
+    input_report_ring_t* ring = inst->ring;
+    size_t rec_len = ROUNDUP(sizeof(input_report_record_t) + len, 8);
+    uint64_t head = ring->head;
+    size_t pos = head % ring->size;
+    size_t left = ring->size - pos;
+    uint64_t end = head + rec_len;
+    if (left < rec_len) {
+        end += left;
+    }
+
+    __atomic_store_n(&ring->write_head, end, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (left < rec_len) {
+        if (left >= sizeof(input_report_record_t)) {
+            input_report_record_t* pad = (input_report_record_t*)(ring->data + pos);
+            pad->len = INPUT_REPORT_RECORD_PAD;
+        }
+        pos = 0;
+    }
+    input_report_record_t* rec = (input_report_record_t*)(ring->data + pos);
+    rec->timestamp = timestamp;
+    rec->len = (uint16_t)len;
+    memcpy(rec->report, report, len);
+
+    __atomic_store_n(&ring->head, end, __ATOMIC_RELEASE);
+    zx_object_signal(inst->ring_event, 0, ZX_USER_SIGNAL_0);
+}
+
 static zx_status_t hid_read_instance(void* ctx, void* buf, size_t count, zx_off_t off,
                                      size_t* actual) {
     hid_instance_t* hid = ctx;
@@ -337,6 +443,8 @@ static zx_status_t hid_ioctl_instance(void* ctx, uint32_t op,
         return hid_get_report(hid->base, in_buf, in_len, out_buf, out_len, out_actual);
     case IOCTL_INPUT_SET_REPORT:
         return hid_set_report(hid->base, in_buf, in_len);
+    case IOCTL_INPUT_GET_REPORT_RING:
+        return hid_get_report_ring(hid, out_buf, out_len, out_actual);
     }
     return ZX_ERR_NOT_SUPPORTED;
 }
@@ -355,6 +463,11 @@ static void hid_release_reassembly_buffer(hid_device_t* dev);
 
 static void hid_release_instance(void* ctx) {
     hid_instance_t* hid = ctx;
+    if (hid->ring != NULL) {
+        zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)hid->ring, hid->ring_map_size);
+        zx_handle_close(hid->ring_vmo);
+        zx_handle_close(hid->ring_event);
+    }
     free(hid);
 }
 
@@ -731,6 +844,7 @@ zx_protocol_device_t hid_device_proto = {
 
 void hid_io_queue(void* cookie, const uint8_t* buf, size_t len) {
     hid_device_t* hid = cookie;
+    zx_time_t timestamp = zx_clock_get(ZX_CLOCK_MONOTONIC);
 
     mtx_lock(&hid->instance_lock);
 
@@ -803,6 +917,11 @@ void hid_io_queue(void* cookie, const uint8_t* buf, size_t len) {
         hid_instance_t* instance;
         foreach_instance(hid, instance) {
             mtx_lock(&instance->fifo.lock);
+            if (instance->ring != NULL) {
+                hid_write_report_ring_locked(instance, rbuf, rlen, timestamp);
+                mtx_unlock(&instance->fifo.lock);
+                continue;
+            }
             bool was_empty = zx_hid_fifo_size(&instance->fifo) == 0;
             ssize_t wrote = zx_hid_fifo_write(&instance->fifo, rbuf, rlen);
 
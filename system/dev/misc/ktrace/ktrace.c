@@ -17,6 +17,8 @@
 #include <string.h>
 #include <threads.h>
 
+#include "provider.h"
+
 static zx_status_t ktrace_read(void* ctx, void* buf, size_t count, zx_off_t off, size_t* actual) {
     uint32_t length;
     zx_status_t status = zx_ktrace_read(get_root_resource(), buf, off, count, &length);
@@ -97,7 +99,17 @@ static zx_status_t ktrace_bind(void* ctx, zx_device_t* parent) {
     };
 
     zx_device_t* dev;
-    return device_add(parent, &args, &dev);
+    zx_status_t status = device_add(parent, &args, &dev);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Kernel events can still be had through the device without it.
+    status = ktrace_provider_start();
+    if (status != ZX_OK) {
+        printf("ktrace: cannot start trace provider: %d\n", status);
+    }
+    return ZX_OK;
 }
 
 static zx_driver_ops_t ktrace_driver_ops = {
@@ -0,0 +1,125 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "provider.h"
+
+#include <string.h>
+
+#include <async/cpp/loop.h>
+#include <ddk/driver.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <trace-engine/instrumentation.h>
+#include <trace-ktrace/importer.h>
+#include <trace-provider/provider.h>
+#include <trace/observer.h>
+#include <zircon/ktrace.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+constexpr size_t kReadBufferSize = 64 * 1024;
+
+// Runs ktrace alongside each trace session which asks for kernel events.
+//
+// The kernel's records are imported when the session stops: ktrace can't
+// be read from while it is being written, short of stopping it.  A
+// reference to the trace context is held until then so that the session
+// waits for them.
+//
+// This takes over ktrace, so it shouldn't be used by anything else during
+// a trace session which asks for kernel events.
+class KtraceProvider {
+public:
+    KtraceProvider()
+        : provider_(loop_.async()) {}
+
+    zx_status_t Start() {
+        observer_.Start(loop_.async(), [this] { UpdateState(); });
+        return loop_.StartThread("ktrace-provider");
+    }
+
+private:
+    void UpdateState() {
+        if (trace_state() == TRACE_STARTED) {
+            if (!context_)
+                StartKtrace();
+        } else if (context_) {
+            StopKtrace();
+        }
+    }
+
+    void StartKtrace() {
+        trace_context_t* context = trace_acquire_context();
+        if (!context)
+            return;
+
+        const uint32_t groups = trace::KtraceImporter::GetGroupMask(context);
+        if (groups) {
+            zx_handle_t root = get_root_resource();
+            zx_ktrace_control(root, KTRACE_ACTION_STOP, 0u, nullptr);
+            zx_ktrace_control(root, KTRACE_ACTION_REWIND, 0u, nullptr);
+            if (zx_ktrace_control(root, KTRACE_ACTION_START, groups, nullptr) == ZX_OK) {
+                context_ = context;
+                return;
+            }
+        }
+        trace_release_context(context);
+    }
+
+    void StopKtrace() {
+        zx_handle_t root = get_root_resource();
+        zx_ktrace_control(root, KTRACE_ACTION_STOP, 0u, nullptr);
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[kReadBufferSize]);
+        if (ac.check()) {
+            trace::KtraceImporter importer(context_);
+            uint32_t offset = 0u;
+            size_t pending = 0u;
+            for (;;) {
+                uint32_t actual;
+                zx_status_t status = zx_ktrace_read(root, buf.get() + pending, offset,
+                                                    kReadBufferSize - pending, &actual);
+                if (status != ZX_OK || actual == 0u)
+                    break;
+                offset += actual;
+
+                // Keep any partial record at the end for the next read.
+                const size_t available = pending + actual;
+                const size_t consumed = importer.Import(buf.get(), available);
+                pending = available - consumed;
+                memmove(buf.get(), buf.get() + consumed, pending);
+            }
+        }
+
+        zx_ktrace_control(root, KTRACE_ACTION_REWIND, 0u, nullptr);
+        trace_release_context(context_);
+        context_ = nullptr;
+    }
+
+    async::Loop loop_;
+    trace::TraceProvider provider_;
+    trace::TraceObserver observer_;
+
+    // Only used on the loop's thread.
+    trace_context_t* context_ = nullptr;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(KtraceProvider);
+};
+
+} // namespace
+
+zx_status_t ktrace_provider_start(void) {
+    fbl::AllocChecker ac;
+    // Lives for as long as the driver.
+    KtraceProvider* provider = new (&ac) KtraceProvider();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+    zx_status_t status = provider->Start();
+    if (status != ZX_OK)
+        delete provider;
+    return status;
+}
@@ -0,0 +1,17 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// Starts a trace provider which merges the kernel's trace records into the
+// trace sessions which enable any of the "kernel:" categories, see
+// <trace-ktrace/importer.h>.
+zx_status_t ktrace_provider_start(void);
+
+__END_CDECLS
@@ -8,11 +8,30 @@ MODULE := $(LOCAL_DIR)
 
 MODULE_TYPE := driver
 
-MODULE_SRCS := $(LOCAL_DIR)/ktrace.c
-
-MODULE_STATIC_LIBS := system/ulib/ddk
-
-MODULE_LIBS := system/ulib/driver system/ulib/zircon system/ulib/c
+MODULE_SRCS := \
+    $(LOCAL_DIR)/ktrace.c \
+    $(LOCAL_DIR)/provider.cpp
+
+MODULE_STATIC_LIBS := \
+    system/ulib/ddk \
+    system/ulib/trace-ktrace \
+    system/ulib/trace-provider \
+    system/ulib/trace \
+    system/ulib/async.cpp \
+    system/ulib/async \
+    system/ulib/async.loop-cpp \
+    system/ulib/async.loop \
+    system/ulib/zx \
+    system/ulib/zxcpp \
+    system/ulib/fbl
+
+MODULE_LIBS := \
+    system/ulib/driver \
+    system/ulib/async.default \
+    system/ulib/fdio \
+    system/ulib/trace-engine \
+    system/ulib/zircon \
+    system/ulib/c
 
 include make/module.mk
 
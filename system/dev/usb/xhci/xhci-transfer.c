@@ -385,29 +385,36 @@ static zx_status_t xhci_continue_transfer_locked(xhci_t* xhci, xhci_slot_t* slot
         state->needs_status = false;
     }
 
-    // if we get here, then we are ready to ring the doorbell
+    // if we get here, then the request is ready to be started;
     // update dequeue_ptr to TRB following this transaction
     req->context = (void *)ring->current;
 
-    XHCI_WRITE32(&xhci->doorbells[header->device_id], ep_index + 1);
+    return ZX_OK;
+}
+
+static void xhci_ring_doorbell_locked(xhci_t* xhci, xhci_slot_t* slot, uint32_t slot_id,
+                                      uint8_t ep_index) {
+    xhci_endpoint_t* ep = &slot->eps[ep_index];
+    XHCI_WRITE32(&xhci->doorbells[slot_id], ep_index + 1);
     // it seems we need to ring the doorbell a second time when transitioning from STOPPED
     while (xhci_get_ep_ctx_state(slot, ep) == EP_CTX_STATE_STOPPED) {
         zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
-        XHCI_WRITE32(&xhci->doorbells[header->device_id], ep_index + 1);
+        XHCI_WRITE32(&xhci->doorbells[slot_id], ep_index + 1);
     }
-
-    return ZX_OK;
 }
 
 static void xhci_process_transactions_locked(xhci_t* xhci, xhci_slot_t* slot, uint8_t ep_index,
                                              list_node_t* completed_reqs) {
     xhci_endpoint_t* ep = &slot->eps[ep_index];
+    // the doorbell is rung once for all the requests queued here, rather
+    // than once for each of them
+    uint32_t slot_id = 0;
 
     // loop until we fill our transfer ring or run out of requests to process
     while (1) {
         if (xhci_transfer_ring_free_trbs(&ep->transfer_ring) == 0) {
             // no available TRBs - need to wait for some complete
-            return;
+            break;
         }
 
         while (!ep->current_req) {
@@ -415,7 +422,7 @@ static void xhci_process_transactions_locked(xhci_t* xhci, xhci_slot_t* slot, ui
             usb_request_t* req = list_remove_head_type(&ep->queued_reqs, usb_request_t, node);
             if (!req) {
                 // nothing to do
-                return;
+                break;
             }
 
             zx_status_t status = xhci_start_transfer_locked(xhci, slot, ep_index, req);
@@ -434,18 +441,26 @@ static void xhci_process_transactions_locked(xhci_t* xhci, xhci_slot_t* slot, ui
             zx_status_t status = xhci_continue_transfer_locked(xhci, slot, ep_index, req);
             if (status == ZX_ERR_SHOULD_WAIT) {
                 // no available TRBs - need to wait for some complete
-                return;
+                break;
             } else {
                 if (status != ZX_OK) {
                     req->response.status = status;
                     req->response.actual = 0;
                     list_delete(&req->node);
                     list_add_tail(completed_reqs, &req->node);
+                } else {
+                    slot_id = req->header.device_id;
                 }
                 ep->current_req = NULL;
             }
+        } else {
+            break;
         }
     }
+
+    if (slot_id != 0) {
+        xhci_ring_doorbell_locked(xhci, slot, slot_id, ep_index);
+    }
 }
 
 zx_status_t xhci_queue_transfer(xhci_t* xhci, usb_request_t* req) {
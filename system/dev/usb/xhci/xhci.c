@@ -29,7 +29,7 @@
 // The Interrupter Moderation Interval prevents the controller from sending interrupts too often.
 // According to XHCI Rev 1.1 4.17.2, the default is 4000 (= 1 ms). We set it to 1000 (= 250 us) to
 // get better latency on completions for bulk transfers; setting it too low seems to destabilize the
-// system.
+// system. It can be changed with the driver.xhci.imod=<n> kernel command line option.
 #define XHCI_IMODI_VAL      1000
 
 uint8_t xhci_endpoint_index(uint8_t ep_address) {
@@ -178,6 +178,12 @@ zx_status_t xhci_init(xhci_t* xhci, xhci_mode_t mode, uint32_t num_interrupts) {
     max_interrupters = MIN(INTERRUPTER_COUNT, max_interrupters);
     xhci->num_interrupts = MIN(max_interrupters, num_interrupts);
 
+    xhci->imodi = XHCI_IMODI_VAL;
+    const char* imod = getenv("driver.xhci.imod");
+    if (imod != NULL) {
+        xhci->imodi = strtoul(imod, NULL, 0) & IMODI_MASK;
+    }
+
     xhci->max_slots = XHCI_GET_BITS32(hcsparams1, HCSPARAMS1_MAX_SLOTS_START,
                                       HCSPARAMS1_MAX_SLOTS_BITS);
     xhci->rh_num_ports = XHCI_GET_BITS32(hcsparams1, HCSPARAMS1_MAX_PORTS_START,
@@ -368,7 +374,7 @@ static void xhci_interrupter_init(xhci_t* xhci, int interrupter) {
     xhci_update_erdp(xhci, interrupter);
 
     XHCI_SET32(&intr_regs->iman, IMAN_IE, IMAN_IE);
-    XHCI_SET32(&intr_regs->imod, IMODI_MASK, XHCI_IMODI_VAL);
+    XHCI_SET32(&intr_regs->imod, IMODI_MASK, xhci->imodi);
     XHCI_SET32(&intr_regs->erstsz, ERSTSZ_MASK, ERST_ARRAY_SIZE);
     XHCI_WRITE64(&intr_regs->erstba, xhci->erst_arrays_phys[interrupter]);
 }
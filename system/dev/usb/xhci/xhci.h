@@ -112,6 +112,8 @@ struct xhci {
     zx_handle_t irq_handles[INTERRUPTER_COUNT];
     // actual number of interrupts we are using
     uint32_t num_interrupts;
+    // interrupter moderation interval, in 250ns units
+    uint32_t imodi;
 
     zx_handle_t mmio_handle;
     void* mmio;
@@ -96,7 +96,7 @@ bool TraceInfoGenerator::syscall(ofstream& os, const Syscall& sc) {
 
 bool CategoryGenerator::syscall(ofstream& os, const Syscall& sc) {
     for (const auto& attr : sc.attributes) {
-        if (attr != "*" && attr != "internal")
+        if (attr != "*" && attr != "internal" && attr != "leaf")
             category_map_[attr].push_back(&sc.name);
     }
     return true;
@@ -41,7 +41,7 @@ bool KernelWrapperGenerator::syscall(ofstream& os, const Syscall& sc) {
 
     auto syscall_name = syscall_prefix_ + sc.name;
     write_syscall_signature_line(os, sc, wrapper_prefix_);
-    os << in << "return do_syscall("
+    os << in << (sc.is_leaf() ? "return do_leaf_syscall(" : "return do_syscall(")
        << define_prefix_ << sc.name << ", "
        << "pc, "
        << "&VDso::ValidSyscallPC::" << sc.name << ", "
@@ -167,6 +167,10 @@ bool Syscall::is_internal() const {
     return has_attribute("internal", attributes);
 }
 
+bool Syscall::is_leaf() const {
+    return has_attribute("leaf", attributes);
+}
+
 size_t Syscall::num_kernel_args() const {
     return is_noreturn() ? arg_spec.size() : arg_spec.size() + ret_spec.size() - 1;
 }
@@ -209,6 +213,11 @@ bool Syscall::validate() const {
         return false;
     }
 
+    if (is_leaf() && (is_vdso() || is_blocking() || is_noreturn())) {
+        print_error("leaf cannot be vdsocall, blocking or noreturn");
+        return false;
+    }
+
     bool valid_args = true;
     for_each_kernel_arg([this, &valid_args](const TypeSpec& arg) {
         if (arg.name.empty()) {
@@ -35,14 +35,15 @@ typedef struct {
     fbl::Vector<fbl::String> blob_list;
 } blob_options_t;
 
-int do_blobstore_add_blob(blobstore::Blobstore* bs, const char* blob_name) {
+int do_blobstore_add_blob(blobstore::Blobstore* bs, const char* blob_name,
+                          blobstore::BlobDigest* digest) {
     fbl::unique_fd data_fd(open(blob_name, O_RDONLY, 0644));
     if (!data_fd) {
         fprintf(stderr, "error: cannot open '%s'\n", blob_name);
         return -1;
     }
     int r;
-    if ((r = blobstore::blobstore_add_blob(bs, data_fd.get())) != 0) {
+    if ((r = blobstore::blobstore_add_blob(bs, data_fd.get(), digest)) != 0) {
         if (r != ZX_ERR_ALREADY_EXISTS) {
             fprintf(stderr, "blobstore: Failed to add blob '%s': %d\n", blob_name, r);
             return -1;
@@ -51,7 +52,9 @@ int do_blobstore_add_blob(blobstore::Blobstore* bs, const char* blob_name) {
     return 0;
 }
 
-int do_blobstore_add_blobs(fbl::unique_fd fd, const blob_options_t& options) {
+// Adds the listed blobs, skipping those already present. If |prune| is set,
+// blobs which are not listed are removed as well.
+int add_blobs(fbl::unique_fd fd, const blob_options_t& options, bool prune) {
     if (options.blob_list.is_empty()) {
         fprintf(stderr, "Adding a blob requires an additional file argument\n");
         return -1;
@@ -66,6 +69,7 @@ int do_blobstore_add_blobs(fbl::unique_fd fd, const blob_options_t& options) {
     std::mutex mtx;
     unsigned bi = 0;
     int res = 0;
+    std::vector<blobstore::BlobDigest> digests(options.blob_list.size());
 
     unsigned n_threads = std::thread::hardware_concurrency();
     if (!n_threads) {
@@ -81,7 +85,8 @@ int do_blobstore_add_blobs(fbl::unique_fd fd, const blob_options_t& options) {
                 if (i >= options.blob_list.size()) {
                     return;
                 }
-                if (do_blobstore_add_blob(bs.get(), options.blob_list[i].c_str()) < 0) {
+                if (do_blobstore_add_blob(bs.get(), options.blob_list[i].c_str(),
+                                          &digests[i]) < 0) {
                     mtx.lock();
                     res = -1;
                     mtx.unlock();
@@ -94,9 +99,28 @@ int do_blobstore_add_blobs(fbl::unique_fd fd, const blob_options_t& options) {
         threads[i].join();
     }
 
+    if (res == 0 && prune) {
+        size_t removed;
+        zx_status_t status;
+        if ((status = blobstore::blobstore_prune(bs.get(), fbl::move(digests), &removed))
+            != ZX_OK) {
+            fprintf(stderr, "blobstore: Failed to remove unlisted blobs: %d\n", status);
+            return -1;
+        }
+        printf("blobstore: removed %zu unlisted blobs\n", removed);
+    }
+
     return res;
 }
 
+int do_blobstore_add_blobs(fbl::unique_fd fd, const blob_options_t& options) {
+    return add_blobs(fbl::move(fd), options, false);
+}
+
+int do_blobstore_sync_blobs(fbl::unique_fd fd, const blob_options_t& options) {
+    return add_blobs(fbl::move(fd), options, true);
+}
+
 int do_blobstore_mkfs(fbl::unique_fd fd, const blob_options_t& options) {
     uint64_t block_count;
     if (blobstore::blobstore_get_blockcount(fd.get(), &block_count)) {
@@ -223,6 +247,8 @@ struct {
     {"check", do_blobstore_check, false, false, "check filesystem integrity"},
     {"fsck", do_blobstore_check, false, false, "check filesystem integrity"},
     {"add", do_blobstore_add_blobs, false, true, "add blobs to a blobstore image"},
+    {"sync", do_blobstore_sync_blobs, false, true,
+     "add blobs to a blobstore image, removing any not listed"},
 };
 
 int usage() {
@@ -234,7 +260,7 @@ int usage() {
                 CMDS[n].name, CMDS[n].help);
     }
     fprintf(stderr, "\n");
-    fprintf(stderr, "arguments (valid for create, one or more required for add):\n"
+    fprintf(stderr, "arguments (valid for create, one or more required for add and sync):\n"
                     "\t--blob <path-to-file>\n"
                     "\t--manifest <path-to-manifest>\n");
     return -1;
@@ -203,6 +203,7 @@ err:
 
 #define INITIAL_CONNECTION_TIMEOUT 250
 #define TFTP_BUF_SZ 2048
+#define TFTP_DATA_HDR_SZ 4
 
 int tftp_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
     int result = -1;
@@ -221,9 +222,16 @@ int tftp_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
     tftp_session* session = NULL;
     size_t session_data_sz = tftp_sizeof_session();
 
+    // Leave room for the largest block we might ask for, which on a link
+    // taking jumbo frames may be well beyond the default.
+    size_t buf_sz = TFTP_BUF_SZ;
+    if (tftp_block_size && *tftp_block_size + TFTP_DATA_HDR_SZ > buf_sz) {
+        buf_sz = *tftp_block_size + TFTP_DATA_HDR_SZ;
+    }
+
     if (!(session_data = calloc(session_data_sz, 1)) ||
-        !(inbuf = malloc(TFTP_BUF_SZ)) ||
-        !(outbuf = malloc(TFTP_BUF_SZ))) {
+        !(inbuf = malloc(buf_sz)) ||
+        !(outbuf = malloc(buf_sz))) {
         fprintf(stderr, "%s: error: Unable to allocate memory\n", appname);
         goto done;
     }
@@ -247,12 +255,13 @@ int tftp_xfer(struct sockaddr_in6* addr, const char* fn, const char* name) {
     uint16_t default_block_size = DEFAULT_TFTP_BLOCK_SZ;
     uint16_t default_window_size = DEFAULT_TFTP_WIN_SZ;
     tftp_set_options(session, &default_block_size, NULL, &default_window_size);
+    tftp_session_set_max_block_size(session, buf_sz - TFTP_DATA_HDR_SZ);
 
     char err_msg[128];
     tftp_request_opts opts = {0};
-    opts.inbuf_sz = TFTP_BUF_SZ;
+    opts.inbuf_sz = buf_sz;
     opts.inbuf = inbuf;
-    opts.outbuf_sz = TFTP_BUF_SZ;
+    opts.outbuf_sz = buf_sz;
     opts.outbuf = outbuf;
     opts.err_msg = err_msg;
     opts.err_msg_sz = sizeof(err_msg);
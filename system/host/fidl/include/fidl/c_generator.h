@@ -88,6 +88,12 @@ public:
 
     void GenerateStructDeclaration(StringView name, const std::vector<Member>& members);
     void GenerateTaggedUnionDeclaration(StringView name, const std::vector<Member>& members);
+    void GenerateFixedCodingFunctions(StringView name);
+
+    // Whether values of |type| are made up entirely of inline data, with no
+    // handles or out-of-line objects, so that their encoded and decoded
+    // forms are identical.
+    bool IsInlineOnly(const ast::Type* type, uint32_t depth);
 
     void MaybeProduceCodingField(std::string field_name, uint32_t offset, const ast::Type* type,
                                  std::vector<coded::Field>* fields);
@@ -111,6 +117,9 @@ public:
     void ProduceStructDeclaration(const NamedStruct& named_struct);
     void ProduceUnionDeclaration(const NamedUnion& named_union);
 
+    void ProduceMessageFixedCoding(const NamedMessage& named_message);
+    void ProduceStructFixedCoding(const NamedStruct& named_struct);
+
     Library* library_;
     std::ostringstream header_file_;
 };
@@ -14,6 +14,9 @@ namespace {
 
 constexpr const char* kIndent = "    ";
 
+// Matches FIDL_RECURSION_DEPTH in <fidl/coding.h>.
+constexpr uint32_t kMaxInlineDepth = 32u;
+
 std::string ShortName(const std::unique_ptr<ast::Identifier>& name) {
     // TODO(TO-704) C name escaping and ergonomics.
     return name->location.data();
@@ -401,6 +404,82 @@ void CGenerator::GenerateTaggedUnionDeclaration(StringView name,
     header_file_ << "};\n";
 }
 
+void CGenerator::GenerateFixedCodingFunctions(StringView name) {
+    header_file_ << "// " << name << " has no handles or out-of-line data, so encoding or decoding\n";
+    header_file_ << "// it in place only checks its size.\n";
+    header_file_ << "static inline zx_status_t " << name << "_encode(\n";
+    header_file_ << kIndent << "void* bytes, uint32_t num_bytes, zx_handle_t* handles, uint32_t max_handles,\n";
+    header_file_ << kIndent << "uint32_t* actual_handles_out, const char** error_msg_out) {\n";
+    header_file_ << kIndent << "return fidl_encode_fixed(sizeof(" << name
+                 << "), bytes, num_bytes, actual_handles_out, error_msg_out);\n";
+    header_file_ << "}\n";
+    header_file_ << "static inline zx_status_t " << name << "_decode(\n";
+    header_file_ << kIndent << "void* bytes, uint32_t num_bytes, const zx_handle_t* handles,\n";
+    header_file_ << kIndent << "uint32_t num_handles, const char** error_msg_out) {\n";
+    header_file_ << kIndent << "return fidl_decode_fixed(sizeof(" << name
+                 << "), bytes, num_bytes, num_handles, error_msg_out);\n";
+    header_file_ << "}\n";
+}
+
+bool CGenerator::IsInlineOnly(const ast::Type* type, uint32_t depth) {
+    // Aggregates cannot contain themselves inline, so only a malformed
+    // library could recurse this far.
+    if (depth > kMaxInlineDepth)
+        return false;
+
+    switch (type->kind) {
+    case ast::Type::Kind::Handle:
+    case ast::Type::Kind::Request:
+    case ast::Type::Kind::Vector:
+    case ast::Type::Kind::String:
+        return false;
+
+    case ast::Type::Kind::Primitive:
+        return true;
+
+    case ast::Type::Kind::Array: {
+        auto array_type = static_cast<const ast::ArrayType*>(type);
+        return IsInlineOnly(array_type->element_type.get(), depth + 1);
+    }
+
+    case ast::Type::Kind::Identifier: {
+        auto identifier_type = static_cast<const ast::IdentifierType*>(type);
+        if (identifier_type->nullability == types::Nullability::Nullable)
+            return false;
+        // TODO(TO-701) Handle longer names.
+        const auto& components = identifier_type->identifier->components;
+        if (components.size() != 1)
+            return false;
+        std::string name = components[0]->location.data();
+
+        for (const auto& enum_info : library_->enum_declarations_) {
+            if (LongName(enum_info.name) == name)
+                return true;
+        }
+        for (const auto& struct_info : library_->struct_declarations_) {
+            if (LongName(struct_info.name) != name)
+                continue;
+            for (const auto& member : struct_info.members) {
+                if (!IsInlineOnly(member.type.get(), depth + 1))
+                    return false;
+            }
+            return true;
+        }
+        for (const auto& union_info : library_->union_declarations_) {
+            if (LongName(union_info.name) != name)
+                continue;
+            for (const auto& member : union_info.members) {
+                if (!IsInlineOnly(member.type.get(), depth + 1))
+                    return false;
+            }
+            return true;
+        }
+        // Interfaces, which are handles, and anything unresolved.
+        return false;
+    }
+    }
+}
+
 // TODO(TO-702) These should maybe check for global name
 // collisions? Otherwise, is there some other way they should fail?
 std::vector<CGenerator::NamedConst> CGenerator::NameConsts(const std::vector<flat::Const>& const_infos) {
@@ -552,6 +631,28 @@ void CGenerator::ProduceUnionDeclaration(const NamedUnion& named_union) {
     EmitBlank(&header_file_);
 }
 
+void CGenerator::ProduceMessageFixedCoding(const NamedMessage& named_message) {
+    for (const auto& parameter : named_message.parameters) {
+        if (!IsInlineOnly(parameter.type.get(), 0u))
+            return;
+    }
+
+    GenerateFixedCodingFunctions(named_message.c_name);
+
+    EmitBlank(&header_file_);
+}
+
+void CGenerator::ProduceStructFixedCoding(const NamedStruct& named_struct) {
+    for (const auto& struct_member : named_struct.struct_info.members) {
+        if (!IsInlineOnly(struct_member.type.get(), 0u))
+            return;
+    }
+
+    GenerateFixedCodingFunctions(named_struct.c_name);
+
+    EmitBlank(&header_file_);
+}
+
 void CGenerator::ProduceCStructs(std::ostringstream* header_file_out) {
 
     GeneratePrologues();
@@ -601,6 +702,16 @@ void CGenerator::ProduceCStructs(std::ostringstream* header_file_out) {
         ProduceUnionDeclaration(named_union);
     }
 
+    // Messages and structs with nothing to fix up get encode and decode
+    // functions which skip walking the coding tables.
+    header_file_ << "\n// Fixed size coding\n\n";
+    for (const auto& named_message : named_messages) {
+        ProduceMessageFixedCoding(named_message);
+    }
+    for (const auto& named_struct : named_structs) {
+        ProduceStructFixedCoding(named_struct);
+    }
+
     GenerateEpilogues();
 
     *header_file_out = std::move(header_file_);
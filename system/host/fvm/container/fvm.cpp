@@ -6,6 +6,9 @@
 #include <inttypes.h>
 #include <sys/ioctl.h>
 
+#include <thread>
+#include <vector>
+
 #include "fvm/container.h"
 
 #if defined(__APPLE__)
@@ -305,13 +308,28 @@ zx_status_t FvmContainer::Commit() {
         return ZX_ERR_IO;
     }
 
+    // Each partition reads from its own file into its own slices, so they
+    // are all written at once.
+    std::vector<zx_status_t> results(partitions_.size(), ZX_OK);
+    std::vector<std::thread> threads;
     for (unsigned i = 0; i < partitions_.size(); i++) {
-        zx_status_t status;
-        if ((status = WritePartition(i)) != ZX_OK) {
-            return status;
+        threads.emplace_back([this, i, &results] {
+            results[i] = WritePartition(i);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (unsigned i = 0; i < partitions_.size(); i++) {
+        if (results[i] != ZX_OK) {
+            return results[i];
         }
     }
 
+    if (incremental_) {
+        printf("fvm: rewrote %zu of %zu blocks\n", blocks_written_.load(),
+               blocks_written_.load() + blocks_unchanged_.load());
+    }
     xprintf("Successfully wrote FVM data to disk\n");
     return ZX_OK;
 }
@@ -556,7 +574,8 @@ zx_status_t FvmContainer::WriteExtent(unsigned extent_index, Format* format, uin
         for (uint32_t j = 0; j < format->BlocksPerSlice(); j++) {
             // If we have gone beyond the blocks written to partition file, write empty block
             if (current_block >= vslice_info.block_count) {
-                if (!vslice_info.zero_fill) {
+                // An incremental update may find old data here, where a new file has zeroes
+                if (!vslice_info.zero_fill && !incremental_) {
                     break;
                 }
 
@@ -590,12 +609,22 @@ zx_status_t FvmContainer::WriteData(uint32_t pslice, uint32_t block_offset, size
         return ZX_ERR_OUT_OF_RANGE;
     }
 
-    if (lseek(fd_.get(), disk_offset_ + fvm::SliceStart(disk_size_, slice_size_, pslice) +
-                block_offset * block_size, SEEK_SET) < 0) {
-        return ZX_ERR_BAD_STATE;
+    // Positioned, as partitions are written concurrently
+    off_t off = disk_offset_ + fvm::SliceStart(disk_size_, slice_size_, pslice) +
+                block_offset * block_size;
+
+    if (incremental_) {
+        static thread_local std::vector<uint8_t> existing;
+        existing.resize(block_size);
+        if (pread(fd_.get(), existing.data(), block_size, off) == static_cast<ssize_t>(block_size) &&
+            !memcmp(existing.data(), data, block_size)) {
+            blocks_unchanged_++;
+            return ZX_OK;
+        }
     }
+    blocks_written_++;
 
-    ssize_t r = write(fd_.get(), data, block_size);
+    ssize_t r = pwrite(fd_.get(), data, block_size, off);
     if (r != block_size) {
         fprintf(stderr, "Failed to write data to FVM\n");
         return ZX_ERR_BAD_STATE;
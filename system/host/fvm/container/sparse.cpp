@@ -4,6 +4,9 @@
 
 #include <inttypes.h>
 
+#include <thread>
+#include <vector>
+
 #include "fvm/container.h"
 
 static LZ4F_preferences_t lz4_prefs = {
@@ -94,7 +97,8 @@ zx_status_t SparseContainer::Init() {
     image_.slice_size = slice_size_;
     image_.partition_count = 0;
     image_.header_length = sizeof(fvm::sparse_image_t);
-    image_.flags = compress_ == LZ4 ? fvm::kSparseFlagLz4 : 0;
+    image_.flags = compress_ == LZ4 ? (fvm::kSparseFlagLz4 | fvm::kSparseFlagLz4Frames |
+                                       fvm::kSparseFlagFrameTable) : 0;
     partitions_.reset();
     dirty_ = true;
     valid_ = true;
@@ -169,6 +173,24 @@ zx_status_t SparseContainer::Commit() {
         return ZX_ERR_IO;
     }
 
+    // Compressed images end their header in a table of every frame. Frames are cut at
+    // kSparseFrameLength and at the end of each extent, so their number is known up front.
+    fvm::sparse_image_t image = image_;
+    fvm::frame_table_t table;
+    table.magic = fvm::kFrameTableMagic;
+    table.frame_count = 0;
+    if (image.flags & fvm::kSparseFlagFrameTable) {
+        for (unsigned i = 0; i < image.partition_count; i++) {
+            for (unsigned j = 0; j < partitions_[i].descriptor.extent_count; j++) {
+                table.frame_count += fbl::round_up(partitions_[i].extents[j].extent_length,
+                                                   fvm::kSparseFrameLength) /
+                                     fvm::kSparseFrameLength;
+            }
+        }
+        image.header_length += sizeof(fvm::frame_table_t) +
+                               table.frame_count * sizeof(fvm::frame_entry_t);
+    }
+
     // Recalculate and verify header length
     uint64_t header_length = 0;
 
@@ -178,7 +200,7 @@ zx_status_t SparseContainer::Commit() {
     }
 
     header_length += sizeof(fvm::sparse_image_t);
-    if (write(fd_.get(), &image_, sizeof(fvm::sparse_image_t)) != sizeof(fvm::sparse_image_t)) {
+    if (write(fd_.get(), &image, sizeof(fvm::sparse_image_t)) != sizeof(fvm::sparse_image_t)) {
         fprintf(stderr, "Write sparse image header failed\n");
         return ZX_ERR_IO;
     }
@@ -204,14 +226,26 @@ zx_status_t SparseContainer::Commit() {
         }
     }
 
-    if (header_length != image_.header_length) {
+    // The entries are filled in once the frames have been written; leave a hole for them.
+    off_t table_offset = header_length + sizeof(fvm::frame_table_t);
+    if (image.flags & fvm::kSparseFlagFrameTable) {
+        size_t entries_length = table.frame_count * sizeof(fvm::frame_entry_t);
+        header_length += sizeof(fvm::frame_table_t) + entries_length;
+        if (write(fd_.get(), &table, sizeof(table)) != sizeof(table) ||
+            lseek(fd_.get(), entries_length, SEEK_CUR) < 0) {
+            fprintf(stderr, "Write frame table failed\n");
+            return ZX_ERR_IO;
+        }
+    }
+
+    if (header_length != image.header_length) {
         fprintf(stderr, "Header length does not match!\n");
         return ZX_ERR_INTERNAL;
     }
 
     zx_status_t status;
     compression_t comp;
-    if ((status = SetupCompression(&comp, extent_size_)) != ZX_OK) {
+    if ((status = SetupCompression(&comp)) != ZX_OK) {
         return status;
     }
 
@@ -240,11 +274,32 @@ zx_status_t SparseContainer::Commit() {
                     return ZX_ERR_IO;
                 }
             }
+
+            // Frames never span extents
+            if (FlushFrame(&comp) != ZX_OK) {
+                fprintf(stderr, "Failed to write data to sparse file\n");
+                return ZX_ERR_IO;
+            }
         }
     }
 
-    if ((status = FinishCompression(&comp)) != ZX_OK) {
-        return status;
+    if (FlushFrames(&comp) != ZX_OK) {
+        fprintf(stderr, "Failed to write data to sparse file\n");
+        return ZX_ERR_IO;
+    }
+
+    if (image.flags & fvm::kSparseFlagFrameTable) {
+        if (comp.table.size() != table.frame_count) {
+            fprintf(stderr, "Wrote %zu frames, expected %" PRIu64 "\n", comp.table.size(),
+                    table.frame_count);
+            return ZX_ERR_INTERNAL;
+        }
+        ssize_t entries_length = comp.table.size() * sizeof(fvm::frame_entry_t);
+        if (pwrite(fd_.get(), comp.table.get(), entries_length, table_offset) !=
+            entries_length) {
+            fprintf(stderr, "Write frame table failed\n");
+            return ZX_ERR_IO;
+        }
     }
 
     struct stat s;
@@ -347,69 +402,132 @@ zx_status_t SparseContainer::AllocateExtent(uint32_t part_index, uint64_t slice_
     return ZX_OK;
 }
 
-zx_status_t SparseContainer::SetupCompression(compression_t* comp, size_t max_len) {
+zx_status_t SparseContainer::SetupCompression(compression_t* comp) {
     if (!compress_) {
         return ZX_OK;
     }
 
-    LZ4F_errorCode_t errc = LZ4F_createCompressionContext(&comp->cctx, LZ4F_VERSION);
-    if (LZ4F_isError(errc)) {
-        fprintf(stderr, "Could not create compression context: %s\n", LZ4F_getErrorName(errc));
-        return ZX_ERR_INTERNAL;
+    unsigned batch = std::thread::hardware_concurrency();
+    if (batch == 0) {
+        batch = 4;
     }
-
-    size_t max = LZ4F_compressBound(max_len, &lz4_prefs);
-    if (!comp->reset(max)) {
+    size_t max = LZ4F_compressFrameBound(fvm::kSparseFrameLength, &lz4_prefs);
+    if (!comp->reset(max, batch)) {
         return ZX_ERR_NO_MEMORY;
     }
-
-    size_t r = LZ4F_compressBegin(comp->cctx, comp->buf(), comp->size(), &lz4_prefs);
-    if (LZ4F_isError(r)) {
-        fprintf(stderr, "Could not begin compression: %s\n", LZ4F_getErrorName(r));
-        return ZX_ERR_INTERNAL;
-    }
-
-    comp->offset += r;
     return ZX_OK;
 }
 
 zx_status_t SparseContainer::WriteData(const void* data, size_t length, compression_t* comp) {
-    if (compress_) {
-        size_t r = LZ4F_compressUpdate(comp->cctx, comp->buf(), comp->size(), data, length, NULL);
-        if (LZ4F_isError(r)) {
-            fprintf(stderr, "Could not compress data: %s\n", LZ4F_getErrorName(r));
-            return ZX_ERR_INTERNAL;
+    if (!compress_) {
+        if (write(fd_.get(), data, length) != length) {
+            return ZX_ERR_IO;
         }
-
-        comp->offset += r;
-    } else if (write(fd_.get(), data, length) != length) {
-        return ZX_ERR_IO;
+        return ZX_OK;
     }
 
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        frame_t* frame = comp->current();
+        size_t cp = fbl::min(length, fvm::kSparseFrameLength - frame->frame_length);
+        memcpy(frame->frame.get() + frame->frame_length, src, cp);
+        frame->frame_length += cp;
+        src += cp;
+        length -= cp;
+
+        zx_status_t status;
+        if (frame->frame_length == fvm::kSparseFrameLength &&
+            (status = FlushFrame(comp)) != ZX_OK) {
+            return status;
+        }
+    }
     return ZX_OK;
 }
 
-zx_status_t SparseContainer::FinishCompression(compression_t* comp) {
-    if (!compress_) {
+zx_status_t SparseContainer::FlushFrame(compression_t* comp) {
+    if (!compress_ || comp->current()->frame_length == 0) {
         return ZX_OK;
     }
 
-    size_t r = LZ4F_compressEnd(comp->cctx, comp->buf(), comp->size(), NULL);
+    if (++comp->count == comp->frames.size()) {
+        return FlushFrames(comp);
+    }
+    return ZX_OK;
+}
+
+void SparseContainer::CompressFrame(frame_t* frame, size_t data_size) {
+    fvm::frame_descriptor_t* desc = &frame->desc;
+    desc->magic = fvm::kFrameDescriptorMagic;
+    desc->length = static_cast<uint32_t>(frame->frame_length);
+    desc->compressed_length = 0;
+    frame->status = ZX_OK;
+
+    // Frames of zeroes are left out altogether, to be filled in by the reader
+    const uint8_t* data = frame->frame.get();
+    bool zero = true;
+    for (size_t i = 0; i < desc->length; i++) {
+        if (data[i] != 0) {
+            zero = false;
+            break;
+        }
+    }
+    if (zero) {
+        return;
+    }
+
+    size_t r = LZ4F_compressFrame(frame->data.get(), data_size, data, desc->length, &lz4_prefs);
     if (LZ4F_isError(r)) {
-        fprintf(stderr, "Could not finish compression: %s\n", LZ4F_getErrorName(r));
-        return ZX_ERR_INTERNAL;
+        fprintf(stderr, "Could not compress data: %s\n", LZ4F_getErrorName(r));
+        frame->status = ZX_ERR_INTERNAL;
+        return;
     }
+    desc->compressed_length = static_cast<uint32_t>(r);
+}
 
-    comp->offset += r;
-    if (write(fd_.get(), comp->data.get(), comp->offset) != comp->offset) {
-        return ZX_ERR_IO;
+zx_status_t SparseContainer::FlushFrames(compression_t* comp) {
+    if (!compress_) {
+        return ZX_OK;
     }
 
-    LZ4F_errorCode_t errc = LZ4F_freeCompressionContext(comp->cctx);
-    if (LZ4F_isError(errc)) {
-        fprintf(stderr, "Could not free compression context: %s\n", LZ4F_getErrorName(errc));
-        return ZX_ERR_INTERNAL;
+    // A last frame still filling up goes too
+    if (comp->count < comp->frames.size() && comp->current()->frame_length != 0) {
+        comp->count++;
     }
 
-    return ZX_OK;
-}
\ No newline at end of file
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < comp->count; i++) {
+        threads.emplace_back(CompressFrame, &comp->frames[i], comp->data_size);
+    }
+    if (comp->count > 0) {
+        CompressFrame(&comp->frames[0], comp->data_size);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    zx_status_t status = ZX_OK;
+    for (size_t i = 0; i < comp->count; i++) {
+        frame_t* frame = &comp->frames[i];
+        frame->frame_length = 0;
+        if (status != ZX_OK) {
+            continue;
+        }
+        const fvm::frame_descriptor_t& desc = frame->desc;
+        if (frame->status != ZX_OK) {
+            status = frame->status;
+        } else if (write(fd_.get(), &desc, sizeof(desc)) != sizeof(desc) ||
+                   write(fd_.get(), frame->data.get(), desc.compressed_length) !=
+                   desc.compressed_length) {
+            status = ZX_ERR_IO;
+        } else {
+            fvm::frame_entry_t entry;
+            entry.offset = comp->data_offset;
+            entry.length = desc.length;
+            entry.compressed_length = desc.compressed_length;
+            comp->table.push_back(entry);
+            comp->data_offset += sizeof(desc) + desc.compressed_length;
+        }
+    }
+    comp->count = 0;
+    return status;
+}
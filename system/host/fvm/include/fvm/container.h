@@ -5,6 +5,8 @@
 #include <fcntl.h>
 #include <lz4/lz4frame.h>
 
+#include <atomic>
+
 #include <fbl/vector.h>
 #include <fbl/unique_fd.h>
 #include <fvm/fvm-sparse.h>
@@ -78,8 +80,17 @@ public:
     size_t SliceSize() const final;
     zx_status_t AddPartition(const char* path, const char* type_name) final;
 
+    // Makes Commit leave alone any data block which already holds what would be written to it,
+    // so that rebuilding an image over the previous one only rewrites what changed.
+    void SetIncremental() {
+        incremental_ = true;
+    }
+
 private:
     bool valid_;
+    bool incremental_ = false;
+    std::atomic<size_t> blocks_written_{0};
+    std::atomic<size_t> blocks_unchanged_{0};
     size_t metadata_size_;
     size_t disk_offset_;
     size_t disk_size_;
@@ -143,29 +154,58 @@ private:
     zx_status_t AllocateExtent(uint32_t part_index, uint64_t slice_start, uint64_t slice_count,
                                uint64_t extent_length);
 
+    // Data is gathered up a frame of up to kSparseFrameLength bytes at a time. A batch of frames,
+    // one per cpu, is compressed in parallel and then written out in order.
     typedef struct {
-        LZ4F_compressionContext_t cctx;
-        size_t data_size = 0;
-        size_t offset = 0;
+        fbl::unique_ptr<uint8_t[]> frame;
+        size_t frame_length = 0;
         fbl::unique_ptr<uint8_t[]> data;
+        fvm::frame_descriptor_t desc;
+        zx_status_t status = ZX_OK;
+    } frame_t;
 
-        size_t size() {
-            return data_size;
-        }
-
-        void* buf() {
-            return data.get() + offset;
+    typedef struct {
+        size_t data_size = 0;
+        fbl::Vector<frame_t> frames;
+        // Frames gathered so far; the last may still be filling up.
+        size_t count = 0;
+        // Every frame written so far, and where the next will go within the data.
+        fbl::Vector<fvm::frame_entry_t> table;
+        uint64_t data_offset = 0;
+
+        frame_t* current() {
+            return &frames[count];
         }
 
-        bool reset(size_t size) {
+        bool reset(size_t size, size_t batch) {
             data_size = size;
-            fbl::AllocChecker ac;
-            data.reset(new (&ac) uint8_t[size]);
-            return ac.check();
+            count = 0;
+            frames.reset();
+            table.reset();
+            data_offset = 0;
+            for (size_t i = 0; i < batch; i++) {
+                fbl::AllocChecker ac;
+                frame_t f;
+                f.data.reset(new (&ac) uint8_t[size]);
+                if (!ac.check()) {
+                    return false;
+                }
+                f.frame.reset(new (&ac) uint8_t[fvm::kSparseFrameLength]);
+                if (!ac.check()) {
+                    return false;
+                }
+                frames.push_back(fbl::move(f));
+            }
+            return true;
         }
     } compression_t;
 
-    zx_status_t SetupCompression(compression_t* comp, size_t max_len);
+    zx_status_t SetupCompression(compression_t* comp);
     zx_status_t WriteData(const void* data, size_t length, compression_t* comp);
-    zx_status_t FinishCompression(compression_t* comp);
+    // Ends the frame gathered so far, if any.
+    zx_status_t FlushFrame(compression_t* comp);
+    // Compresses and writes out the frames gathered so far.
+    zx_status_t FlushFrames(compression_t* comp);
+    // Compresses |frame| into its |data|, of |data_size| bytes, and fills in its |desc|.
+    static void CompressFrame(frame_t* frame, size_t data_size);
 };
@@ -20,6 +20,8 @@ int usage(void) {
     fprintf(stderr, " --offset [bytes] - offset at which container begins (fvm only)\n");
     fprintf(stderr, " --length [bytes] - length of container within file (fvm only)\n");
     fprintf(stderr, " --compress - specify that file should be compressed (sparse only)\n");
+    fprintf(stderr, " --incremental - update an existing file in place, rewriting only the"
+                    " blocks which changed (create only)\n");
     fprintf(stderr, "Input options:\n");
     fprintf(stderr, " --blobstore [path] - Add path as blobstore type (must be blobstore)\n");
     fprintf(stderr, " --data [path] - Add path as data type (must be minfs)\n");
@@ -56,6 +58,7 @@ int main(int argc, char** argv) {
     size_t length = 0;
     size_t offset = 0;
     bool should_unlink = true;
+    bool incremental = false;
     compress_type_t compress = NONE;
 
     while (i < argc) {
@@ -64,6 +67,8 @@ int main(int argc, char** argv) {
             offset = atoll(argv[++i]);
         } else if (!strcmp(argv[i], "--length") && i + 1 < argc) {
             length = atoll(argv[++i]);
+        } else if (!strcmp(argv[i], "--incremental")) {
+            incremental = true;
         } else if (!strcmp(argv[i], "--compress")) {
             if (!strcmp(argv[++i], "lz4")) {
                 compress = LZ4;
@@ -78,12 +83,15 @@ int main(int argc, char** argv) {
         ++i;
     }
 
-    if (!strcmp(command, "create") && should_unlink) {
+    // An incremental create lays out the container afresh, but over the old file rather than an
+    // empty one.
+    bool reuse = !strcmp(command, "create") && should_unlink && incremental;
+    if (!strcmp(command, "create") && should_unlink && !incremental) {
         unlink(path);
     }
 
     // If length was not specified, use remainder of file after offset
-    if (length == 0) {
+    if (length == 0 && !reuse) {
         fbl::unique_fd fd(open(path, O_RDONLY, 0644));
 
         if (fd) {
@@ -105,6 +113,9 @@ int main(int argc, char** argv) {
         if (FvmContainer::Create(path, slice_size, offset, length, &fvmContainer) != ZX_OK) {
             return -1;
         }
+        if (reuse) {
+            fvmContainer->SetIncremental();
+        }
 
         if (add_partitions(fvmContainer.get(), argc - i, argv + i) < 0) {
             return -1;
@@ -30,6 +30,9 @@
 #define REUSEPORT SO_REUSEADDR
 #endif
 
+// Packets a sender may have in flight past the last one we printed.
+#define LOG_WINDOW 16
+
 static const char* appname;
 static const char* nodename = "*";
 
@@ -94,12 +97,27 @@ int main(int argc, char** argv) {
             continue;
         if (strncmp(nodename, "*", 1) && strncmp(pkt->nodename, nodename, sizeof(pkt->nodename)))
             continue;
-        if (pkt->seqno != last_seqno) {
+        // Print packets strictly in order. One past a gap is dropped, for the
+        // sender to resend along with the missing ones, while the first
+        // packet or one far from the last means the sender has restarted.
+        uint32_t ahead = pkt->seqno - last_seqno;
+        uint32_t behind = last_seqno - pkt->seqno;
+        if ((ahead == 1) || ((pkt->seqno == 1) && (last_seqno != 1)) ||
+            ((ahead > LOG_WINDOW) && (behind >= LOG_WINDOW))) {
             buf[r] = 0;
             printf("%s", pkt->data);
             last_seqno = pkt->seqno;
         }
-        sendto(s, buf, 8, 0, (struct sockaddr*)&ra, rlen);
+
+        // Senders which NUL-terminate their log text take cumulative acks
+        // with a window; others only know the original 8 byte ack.
+        logack_t ack = {
+            .magic = NB_DEBUGLOG_MAGIC,
+            .seqno = last_seqno,
+            .window = LOG_WINDOW,
+        };
+        size_t acklen = (buf[r - 1] == 0) ? sizeof(ack) : 8;
+        sendto(s, &ack, acklen, 0, (struct sockaddr*)&ra, rlen);
     }
 
     return 0;
@@ -11,6 +11,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
 #include <fbl/alloc_checker.h>
@@ -19,72 +25,109 @@
 using digest::Digest;
 using digest::MerkleTree;
 
+namespace {
+
+// Computes the Merkle tree root of |path| into |root|, which is left empty
+// for anything but a regular file.  Returns false after printing why if
+// that fails.
+bool merkleroot(const char* path, std::string* root) {
+    struct stat info;
+    if (stat(path, &info) < 0) {
+        perror("stat");
+        fprintf(stderr, "[-] Unable to stat '%s'.\n", path);
+        return false;
+    }
+    if (!S_ISREG(info.st_mode)) {
+        return true;
+    }
+    fbl::AllocChecker ac;
+    size_t len = MerkleTree::GetTreeLength(info.st_size);
+    fbl::unique_ptr<uint8_t[]> tree(new (&ac) uint8_t[len]);
+    if (!ac.check()) {
+        fprintf(stderr, "[-] Failed to allocate tree of %zu bytes.\n", len);
+        return false;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        fprintf(stderr, "[-] Failed to open '%s.\n", path);
+        return false;
+    }
+    void* data = nullptr;
+    if (info.st_size != 0) {
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    if (close(fd) < 0) {
+        perror("close");
+        fprintf(stderr, "[-] Failed to close '%s'\n", path);
+        return false;
+    }
+    if (info.st_size != 0 && data == MAP_FAILED) {
+        perror("mmap");
+        fprintf(stderr, "[-] Failed to mmap '%s.\n", path);
+        return false;
+    }
+    Digest digest;
+    zx_status_t rc = MerkleTree::Create(data, info.st_size, tree.get(), len, &digest);
+    if (info.st_size != 0 && munmap(data, info.st_size) != 0) {
+        perror("munmap");
+        fprintf(stderr, "[-] Failed to munmap '%s.\n", path);
+        return false;
+    }
+    if (rc != ZX_OK) {
+        fprintf(stderr, "[-] Merkle tree creation failed: %d\n", rc);
+        return false;
+    }
+    char strbuf[Digest::kLength * 2 + 1];
+    rc = digest.ToString(strbuf, sizeof(strbuf));
+    if (rc != ZX_OK) {
+        fprintf(stderr, "[-] Unable to print Merkle tree root: %d\n", rc);
+        return false;
+    }
+    root->assign(strbuf);
+    return true;
+}
+
+} // namespace
+
 int main(int argc, char** argv) {
     if (argc == 1) {
         fprintf(stderr, "[-] missing input file.\n");
         fprintf(stderr, "usage: %s <filename>\n", argv[0]);
         return 1;
     }
-    // Buffer one intermediate node's worth at a time.
-    struct stat info;
-    fbl::AllocChecker ac;
-    void* data = nullptr;
-    fbl::unique_ptr<uint8_t[]> tree(nullptr);
-    char strbuf[Digest::kLength * 2 + 1];
-    Digest digest;
-    for (size_t i = 1; i < argc; ++i) {
-        const char* arg = argv[i];
-        if (stat(arg, &info) < 0) {
-            perror("stat");
-            fprintf(stderr, "[-] Unable to stat '%s'.\n", arg);
-            fprintf(stderr, "usage: %s <filename>\n", argv[0]);
-            return 1;
-        }
-        if (!S_ISREG(info.st_mode)) {
-            continue;
-        }
-        size_t len = MerkleTree::GetTreeLength(info.st_size);
-        tree.reset(new (&ac) uint8_t[len]);
-        if (!ac.check()) {
-            fprintf(stderr, "[-] Failed to allocate tree of %zu bytes.\n", len);
-            return 1;
-        }
-        int fd = open(arg, O_RDONLY);
-        if (fd < 0) {
-            perror("open");
-            fprintf(stderr, "[-] Failed to open '%s.\n", arg);
-            return 1;
-        }
-        if (info.st_size != 0) {
-            data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
-        }
-        if (close(fd) < 0) {
-            perror("close");
-            fprintf(stderr, "[-] Failed to close '%s'\n", arg);
-            return 1;
-        }
-        if (info.st_size == 0 && data == MAP_FAILED) {
-            perror("mmap");
-            fprintf(stderr, "[-] Failed to mmap '%s.\n", arg);
-            return 1;
-        }
-        zx_status_t rc =
-            MerkleTree::Create(data, info.st_size, tree.get(), len, &digest);
-        if (info.st_size != 0 && munmap(data, info.st_size) != 0) {
-            perror("munmap");
-            fprintf(stderr, "[-] Failed to munmap '%s.\n", arg);
-            return 1;
-        }
-        if (rc != ZX_OK) {
-            fprintf(stderr, "[-] Merkle tree creation failed: %d\n", rc);
-            return 1;
-        }
-        rc = digest.ToString(strbuf, sizeof(strbuf));
-        if (rc != ZX_OK) {
-            fprintf(stderr, "[-] Unable to print Merkle tree root: %d\n", rc);
-            return 1;
+
+    // The files are hashed by a thread per cpu, each taking the next one
+    // not yet claimed, and the roots are printed in argument order.
+    std::vector<std::string> roots(argc);
+    std::atomic<int> next(1);
+    std::atomic<bool> ok(true);
+    unsigned n_threads = std::thread::hardware_concurrency();
+    if (n_threads == 0) {
+        n_threads = 4;
+    }
+    n_threads = std::min(n_threads, static_cast<unsigned>(argc - 1));
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < n_threads; t++) {
+        threads.emplace_back([&] {
+            for (int i = next++; i < argc && ok; i = next++) {
+                if (!merkleroot(argv[i], &roots[i])) {
+                    ok = false;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (!ok) {
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (!roots[i].empty()) {
+            printf("%s - %s\n", roots[i].c_str(), argv[i]);
         }
-        printf("%s - %s\n", strbuf, arg);
     }
     return 0;
 }
@@ -544,7 +544,9 @@ ssize_t compress_data(int fd, const void* src, size_t len, void* cookie, uint32_
     return writex(fd, buf, r);
 }
 
-ssize_t compress_file(int fd, const char* fn, size_t len, void* cookie, uint32_t* crc) {
+static ssize_t compress_file_with(int fd, const char* fn, size_t len, void* cookie, uint32_t* crc,
+                                  ssize_t (*write)(int fd, const void* src, size_t len,
+                                                   void* cookie, uint32_t* crc)) {
     if (len == 0) {
         // Don't bother trying to compress empty files
         return 0;
@@ -564,7 +566,7 @@ ssize_t compress_file(int fd, const char* fn, size_t len, void* cookie, uint32_t
         if ((r = readx(fdi, buf, xfer)) < 0) {
             break;
         }
-        if ((r = compress_data(fd, buf, xfer, cookie, crc)) < 0) {
+        if ((r = write(fd, buf, xfer, cookie, crc)) < 0) {
             break;
         }
         len -= xfer;
@@ -573,6 +575,10 @@ ssize_t compress_file(int fd, const char* fn, size_t len, void* cookie, uint32_t
     return (r < 0) ? -1 : total;
 }
 
+ssize_t compress_file(int fd, const char* fn, size_t len, void* cookie, uint32_t* crc) {
+    return compress_file_with(fd, fn, len, cookie, crc, compress_data);
+}
+
 ssize_t compress_finish(int fd, void* cookie, uint32_t* crc) {
     // Max write is one block (64kB uncompressed) plus 8 bytes of footer.
     size_t max = LZ4F_compressBound(65536, &lz4_prefs) + 8;
@@ -602,6 +608,191 @@ static const io_ops io_compressed = {
     .finish = compress_finish,
 };
 
+// A seekable bootfs is compressed as a run of independent LZ4 frames of
+// SEEKABLE_FRAME_SIZE uncompressed bytes each, preceded by an index, so that
+// userboot and devmgr can decompress only the frames a file lives in.  This
+// matches the LZ4 block size, and blocks are already independent, so framing
+// costs only the frame headers and the index.
+#define SEEKABLE_FRAME_SIZE 65536
+
+typedef struct {
+    LZ4F_compressionContext_t cctx;
+    off_t start;            // file offset of the frame index
+    size_t outsize;         // uncompressed size of the whole bootfs
+    uint32_t frame_count;
+    uint32_t frame;         // frame being written
+    size_t in_frame;        // uncompressed bytes written to it so far
+    bootfs_frame_t* frames;
+    uint32_t crc;           // of everything after the index
+    size_t crc_len;
+} seekable_t;
+
+static size_t seekable_index_size(const seekable_t* s) {
+    return sizeof(bootfs_frame_index_t) + s->frame_count * sizeof(bootfs_frame_t);
+}
+
+static ssize_t seekable_emit(int fd, seekable_t* s, const void* buf, size_t len) {
+    s->crc = crc32(s->crc, buf, len);
+    s->crc_len += len;
+    return writex(fd, buf, len);
+}
+
+ssize_t seekable_setup(int fd, void** cookie, uint32_t* crc) {
+    seekable_t* s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return -1;
+    }
+    // write_bootfs() stashes the uncompressed size here.
+    s->outsize = lz4_prefs.frameInfo.contentSize;
+    s->frame_count = (s->outsize + SEEKABLE_FRAME_SIZE - 1) / SEEKABLE_FRAME_SIZE;
+    if ((s->frames = calloc(s->frame_count, sizeof(bootfs_frame_t))) == NULL) {
+        free(s);
+        return -1;
+    }
+    LZ4F_errorCode_t errc = LZ4F_createCompressionContext(&s->cctx, LZ4F_VERSION);
+    if (check_and_log_lz4_error(errc, "could not initialize compression context")) {
+        free(s->frames);
+        free(s);
+        return -1;
+    }
+
+    // Leave room for the index, which is written once the frames are.
+    s->start = lseek(fd, 0, SEEK_CUR);
+    if ((s->start < 0) ||
+        (lseek(fd, s->start + seekable_index_size(s), SEEK_SET) < 0)) {
+        fprintf(stderr, "error: cannot seek\n");
+        LZ4F_freeCompressionContext(s->cctx);
+        free(s->frames);
+        free(s);
+        return -1;
+    }
+    *cookie = s;
+    return 0;
+}
+
+static size_t seekable_frame_content(const seekable_t* s) {
+    size_t left = s->outsize - (size_t)s->frame * SEEKABLE_FRAME_SIZE;
+    return (left < SEEKABLE_FRAME_SIZE) ? left : SEEKABLE_FRAME_SIZE;
+}
+
+ssize_t seekable_data(int fd, const void* src, size_t len, void* cookie, uint32_t* crc) {
+    seekable_t* s = cookie;
+    const uint8_t* data = src;
+    size_t total = len;
+    while (len > 0) {
+        if (s->frame >= s->frame_count) {
+            fprintf(stderr, "error: bootfs larger than its computed size\n");
+            return -1;
+        }
+        size_t content = seekable_frame_content(s);
+        if (s->in_frame == 0) {
+            off_t pos = lseek(fd, 0, SEEK_CUR);
+            if (pos < 0) {
+                fprintf(stderr, "error: couldn't seek\n");
+                return -1;
+            }
+            s->frames[s->frame].offset = pos - s->start;
+
+            LZ4F_preferences_t prefs = lz4_prefs;
+            prefs.frameInfo.contentSize = content;
+            uint8_t buf[128];
+            size_t r = LZ4F_compressBegin(s->cctx, buf, sizeof(buf), &prefs);
+            if (check_and_log_lz4_error(r, "could not begin compression")) {
+                return -1;
+            }
+            if (seekable_emit(fd, s, buf, r) < 0) {
+                return -1;
+            }
+        }
+
+        size_t xfer = content - s->in_frame;
+        if (xfer > len) {
+            xfer = len;
+        }
+        size_t max = LZ4F_compressBound(xfer, &lz4_prefs);
+        uint8_t buf[max];
+        size_t r = LZ4F_compressUpdate(s->cctx, buf, max, data, xfer, NULL);
+        if (check_and_log_lz4_error(r, "could not compress data")) {
+            return -1;
+        }
+        if (seekable_emit(fd, s, buf, r) < 0) {
+            return -1;
+        }
+        data += xfer;
+        len -= xfer;
+        s->in_frame += xfer;
+
+        if (s->in_frame == content) {
+            // Max write is one block (64kB uncompressed) plus 8 bytes of footer.
+            size_t max = LZ4F_compressBound(65536, &lz4_prefs) + 8;
+            uint8_t buf[max];
+            size_t r = LZ4F_compressEnd(s->cctx, buf, max, NULL);
+            if (check_and_log_lz4_error(r, "could not finish compression")) {
+                return -1;
+            }
+            if (seekable_emit(fd, s, buf, r) < 0) {
+                return -1;
+            }
+            off_t pos = lseek(fd, 0, SEEK_CUR);
+            if (pos < 0) {
+                fprintf(stderr, "error: couldn't seek\n");
+                return -1;
+            }
+            s->frames[s->frame].length = pos - s->start - s->frames[s->frame].offset;
+            s->frame++;
+            s->in_frame = 0;
+        }
+    }
+    return total;
+}
+
+ssize_t seekable_finish(int fd, void* cookie, uint32_t* crc) {
+    seekable_t* s = cookie;
+    ssize_t r = -1;
+    off_t end = lseek(fd, 0, SEEK_CUR);
+
+    if ((s->frame != s->frame_count) || (s->in_frame != 0)) {
+        fprintf(stderr, "error: bootfs smaller than its computed size\n");
+    } else if ((end < 0) || (lseek(fd, s->start, SEEK_SET) != s->start)) {
+        fprintf(stderr, "error: couldn't seek to frame index\n");
+    } else {
+        bootfs_frame_index_t index = {
+            .magic = BOOTFS_FRAME_INDEX_MAGIC,
+            .frame_size = SEEKABLE_FRAME_SIZE,
+            .frame_count = s->frame_count,
+        };
+        size_t frames_size = s->frame_count * sizeof(bootfs_frame_t);
+        uint32_t index_crc = crc32(0, (void*)&index, sizeof(index));
+        index_crc = crc32(index_crc, (void*)s->frames, frames_size);
+        if ((writex(fd, &index, sizeof(index)) >= 0) &&
+            (writex(fd, s->frames, frames_size) >= 0) &&
+            (lseek(fd, end, SEEK_SET) == end)) {
+            // The index was written last but comes first.
+            *crc = crc32_combine(index_crc, s->crc, s->crc_len);
+            r = 0;
+        }
+    }
+
+    LZ4F_errorCode_t errc = LZ4F_freeCompressionContext(s->cctx);
+    if (check_and_log_lz4_error(errc, "could not free compression context")) {
+        r = -1;
+    }
+    free(s->frames);
+    free(s);
+    return r;
+}
+
+ssize_t seekable_file(int fd, const char* fn, size_t len, void* cookie, uint32_t* crc) {
+    return compress_file_with(fd, fn, len, cookie, crc, seekable_data);
+}
+
+static const io_ops io_seekable = {
+    .setup = seekable_setup,
+    .write = seekable_data,
+    .write_file = seekable_file,
+    .finish = seekable_finish,
+};
+
 ssize_t copybootdatafile(int fd, const char* fn, size_t len) {
     char buf[MAXBUFFER];
     int r, fdi;
@@ -658,7 +849,7 @@ static const char fill[4096];
 #define CHECK(w) do { if ((w) < 0) goto fail; } while (0)
 
 int write_bootfs(int fd, item_t* item, bool compressed) {
-    const io_ops* op = compressed ? &io_compressed : &io_plain;
+    const io_ops* op = compressed ? &io_seekable : &io_plain;
 
     uint32_t n;
     fsentry_t* e;
@@ -776,7 +967,8 @@ fail:
     };
     if (compressed) {
         boothdr.extra = item->outsize;
-        boothdr.flags |= BOOTDATA_BOOTFS_FLAG_COMPRESSED;
+        boothdr.flags |= BOOTDATA_BOOTFS_FLAG_COMPRESSED |
+                         BOOTDATA_BOOTFS_FLAG_SEEKABLE;
     }
     uint32_t hdrcrc = crc32(0, (void*) &boothdr, sizeof(boothdr));
     boothdr.crc32 = crc32_combine(hdrcrc, crc, boothdr.length);
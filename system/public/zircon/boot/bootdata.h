@@ -59,6 +59,11 @@
 // Flag indicating that the bootfs is compressed.
 #define BOOTDATA_BOOTFS_FLAG_COMPRESSED  (1 << 0)
 
+// Flag indicating that a compressed bootfs is split into independently
+// compressed LZ4 frames, preceded by a bootfs_frame_index_t, so that any
+// range of it can be decompressed without decompressing the rest.
+#define BOOTDATA_BOOTFS_FLAG_SEEKABLE    (1 << 1)
+
 
 // These items are for passing from bootloader to kernel
 
@@ -241,4 +246,41 @@ typedef struct bootfs_entry {
 #define BOOTFS_RECSIZE(entry) \
     (sizeof(bootfs_entry_t) + BOOTFS_ALIGN(entry->name_len))
 
+// A seekable compressed bootfs (BOOTDATA_BOOTFS_FLAG_SEEKABLE) starts with
+// a bootfs_frame_index_t followed by frame_count bootfs_frame_t's, then the
+// frames themselves.  Frame n holds bytes [n * frame_size, (n + 1) * frame_size)
+// of the uncompressed image as a complete LZ4 frame, in the same restricted
+// format as a non-seekable compressed bootfs.  The last frame may be short.
+
+#define BOOTFS_FRAME_INDEX_MAGIC (0x58444946) // FIDX
+
+typedef struct bootfs_frame_index {
+    // magic value BOOTFS_FRAME_INDEX_MAGIC
+    uint32_t magic;
+
+    // uncompressed bytes per frame, a multiple of 4096
+    uint32_t frame_size;
+
+    uint32_t frame_count;
+
+    // 0
+    uint32_t reserved;
+} bootfs_frame_index_t;
+
+typedef struct bootfs_frame {
+    // offset and size of the compressed frame, from the start of the index
+    uint32_t offset;
+    uint32_t length;
+
+    // 0 as written; consumers set BOOTFS_FRAME_FLAG_DECOMPRESSED once they
+    // have decompressed the frame, so later consumers of the same bootfs
+    // can skip it
+    uint32_t flags;
+
+    // 0
+    uint32_t reserved;
+} bootfs_frame_t;
+
+#define BOOTFS_FRAME_FLAG_DECOMPRESSED (1 << 0)
+
 #endif
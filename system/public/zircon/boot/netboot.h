@@ -90,7 +90,8 @@ nbfile* netboot_get_buffer(const char* name, size_t size);
 #define DEBUGLOG_PORT         33337
 #define DEBUGLOG_ACK_PORT     33338
 
-#define MAX_LOG_DATA 1216
+// Fills a 1500 byte ethernet MTU, once the headers are accounted for.
+#define MAX_LOG_DATA 1380
 #define MAX_NODENAME_LENGTH 64
 
 typedef struct logpacket {
@@ -99,3 +100,13 @@ typedef struct logpacket {
     char nodename[MAX_NODENAME_LENGTH];
     char data[MAX_LOG_DATA];
 } logpacket_t;
+
+// Acknowledges every log packet up to and including |seqno|, and lets the
+// sender have |window| packets past it in flight. Listeners only reply with
+// this to senders which NUL-terminate their log text; others get back just
+// |magic| and |seqno|, and send one packet at a time.
+typedef struct logack {
+    uint32_t magic;
+    uint32_t seqno;
+    uint32_t window;
+} logack_t;
@@ -36,6 +36,7 @@ typedef enum audio_cmd {
     AUDIO_RB_CMD_GET_BUFFER         = 0x3001,
     AUDIO_RB_CMD_START              = 0x3002,
     AUDIO_RB_CMD_STOP               = 0x3003,
+    AUDIO_RB_CMD_GET_POSITION_BUFFER = 0x3004,
 
     // Async notifications sent on the ring buffer channel.
     AUDIO_RB_POSITION_NOTIFY        = 0x4000,
@@ -339,6 +340,30 @@ typedef struct audio_rb_cmd_stop_resp {
     zx_status_t     result;
 } audio_rb_cmd_stop_resp_t;
 
+// AUDIO_RB_CMD_GET_POSITION_BUFFER
+//
+// May be not used with the NO_ACK flag.
+typedef struct audio_rb_cmd_get_position_buffer_req {
+    audio_cmd_hdr_t hdr;
+} audio_rb_cmd_get_position_buffer_req_t;
+
+typedef struct audio_rb_cmd_get_position_buffer_resp {
+    audio_cmd_hdr_t hdr;
+    zx_status_t     result;
+
+    // The offset (in bytes) into the returned VMO of a uint32_t which holds
+    // the current position (in bytes) of the hardware's read (output) or
+    // write (input) pointer in the ring buffer.
+    uint32_t position_offset;
+
+    // NOTE: If result == ZX_OK, a read-only VMO handle will be returned as
+    // well.  The hardware updates the position in place as DMA progresses, so
+    // clients may map the VMO and poll the position at any rate without
+    // sending messages to the driver.  The VMO may hold the positions of other
+    // streams as well.  Drivers which cannot report positions this way return
+    // ZX_ERR_NOT_SUPPORTED.
+} audio_rb_cmd_get_position_buffer_resp_t;
+
 // AUDIO_RB_POSITION_NOTIFY
 typedef struct audio_rb_position_notify {
     audio_cmd_hdr_t hdr;
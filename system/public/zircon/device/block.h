@@ -82,11 +82,26 @@
 // clears the counters
 #define IOCTL_BLOCK_GET_STATS   \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 18)
+// Returns stats about how the fifo block server scheduled requests and
+// optionally clears them
+#define IOCTL_BLOCK_GET_SERVER_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 19)
+// Set the priority class of a txn of the currently running FIFO server
+#define IOCTL_BLOCK_SET_TXN_PRIORITY \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 20)
+// Extend a virtual partition by several ranges at once. Either all of the
+// ranges are allocated, or none are; the FVM metadata is written once for the
+// whole batch.
+#define IOCTL_BLOCK_FVM_EXTEND_BATCH \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 21)
 
 // Block Core ioctls (specific to each block device):
 
 #define BLOCK_FLAG_READONLY 0x00000001
 #define BLOCK_FLAG_REMOVABLE 0x00000002
+// Requests are much faster in device offset order than in random order,
+// as on rotating media or eMMC
+#define BLOCK_FLAG_SEEK_PENALTY 0x00000004
 
 typedef struct {
     uint64_t block_count;       // The number of blocks in this block device
@@ -103,6 +118,37 @@ typedef struct {
     size_t total_blocks;    // Total number of blocks processed
 } block_stats_t;
 
+#define BLOCK_LATENCY_BUCKETS 16
+
+// Priority classes of txns. The block server shares the device between
+// txns with requests waiting in proportion to the weight of their class.
+#define BLOCK_PRIORITY_REALTIME    0 // weight 16
+#define BLOCK_PRIORITY_INTERACTIVE 1 // weight 4, the default
+#define BLOCK_PRIORITY_BACKGROUND  2 // weight 1
+#define BLOCK_PRIORITY_COUNT       3
+
+typedef struct {
+    uint64_t requests;          // Read and write requests taken from the fifo
+    uint64_t blocks;            // Blocks they read or wrote
+    uint64_t total_latency;     // Sum of their times from fifo to completion, in nanoseconds
+    uint64_t max_latency;
+} block_class_stats_t;
+
+typedef struct {
+    uint64_t requests;          // Read and write requests taken from the fifo
+    uint64_t ops;               // Block ops they were queued to the device as
+    uint64_t merged;            // Requests merged into the block op of another request
+    uint64_t sorted_batches;    // Batches of requests reordered by device offset
+    uint32_t dispatch_threads;  // Threads queueing block ops to the device
+    uint32_t reserved;
+    // Requests by time from being taken from the fifo to completing:
+    // bucket n counts those that took [2^n, 2^(n+1)) microseconds, with
+    // bucket 0 also counting faster ones and the last bucket slower ones
+    uint64_t latency[BLOCK_LATENCY_BUCKETS];
+    // By the priority class of the txn the requests were sent on
+    block_class_stats_t classes[BLOCK_PRIORITY_COUNT];
+} block_server_stats_t;
+
 // ssize_t ioctl_block_get_info(int fd, block_info_t* out);
 IOCTL_WRAPPER_OUT(ioctl_block_get_info, IOCTL_BLOCK_GET_INFO, block_info_t);
 
@@ -150,12 +196,22 @@ IOCTL_WRAPPER_OUT(ioctl_block_alloc_txn, IOCTL_BLOCK_ALLOC_TXN, txnid_t);
 // ssize_t ioctl_block_free_txn(int fd, const size_t* in_txnid);
 IOCTL_WRAPPER_IN(ioctl_block_free_txn, IOCTL_BLOCK_FREE_TXN, txnid_t);
 
+typedef struct {
+    txnid_t txnid;
+    uint16_t priority;          // BLOCK_PRIORITY_*
+} block_txn_priority_t;
+
+// ssize_t ioctl_block_set_txn_priority(int fd, const block_txn_priority_t* in);
+IOCTL_WRAPPER_IN(ioctl_block_set_txn_priority, IOCTL_BLOCK_SET_TXN_PRIORITY,
+                 block_txn_priority_t);
+
 // ssize_t ioctl_block_fifo_close(int fd);
 IOCTL_WRAPPER(ioctl_block_fifo_close, IOCTL_BLOCK_FIFO_CLOSE);
 
 #define GUID_LEN 16
 #define NAME_LEN 24
 #define MAX_FVM_VSLICE_REQUESTS 16
+#define MAX_FVM_EXTEND_REQUESTS 16
 
 typedef struct {
     size_t slice_count;
@@ -176,6 +232,15 @@ typedef struct {
 // ssize_t ioctl_block_fvm_extend(int fd, const extend_request_t* request);
 IOCTL_WRAPPER_IN(ioctl_block_fvm_extend, IOCTL_BLOCK_FVM_EXTEND, extend_request_t);
 
+typedef struct {
+    size_t count; // number of elements in extents
+    extend_request_t extents[MAX_FVM_EXTEND_REQUESTS];
+} extend_batch_request_t;
+
+// ssize_t ioctl_block_fvm_extend_batch(int fd, const extend_batch_request_t* request);
+IOCTL_WRAPPER_IN(ioctl_block_fvm_extend_batch, IOCTL_BLOCK_FVM_EXTEND_BATCH,
+                 extend_batch_request_t);
+
 // ssize_t ioctl_block_fvm_shrink(int fd, const extend_request_t* request);
 IOCTL_WRAPPER_IN(ioctl_block_fvm_shrink, IOCTL_BLOCK_FVM_SHRINK, extend_request_t);
 
@@ -222,6 +287,10 @@ IOCTL_WRAPPER_IN(ioctl_block_fvm_upgrade, IOCTL_BLOCK_FVM_UPGRADE, upgrade_req_t
 // ssize_t ioctl_block_get_stats(int fd, bool clear, block_stats_t* out)
 IOCTL_WRAPPER_INOUT(ioctl_block_get_stats, IOCTL_BLOCK_GET_STATS, bool, block_stats_t);
 
+// ssize_t ioctl_block_get_server_stats(int fd, bool clear, block_server_stats_t* out)
+IOCTL_WRAPPER_INOUT(ioctl_block_get_server_stats, IOCTL_BLOCK_GET_SERVER_STATS, bool,
+                    block_server_stats_t);
+
 // Multiple Block IO operations may be sent at once before a response is actually sent back.
 // Block IO ops may be sent concurrently to different vmoids, and they also may be sent
 // to different transactions at any point in time. Up to MAX_TXN_COUNT transactions may
@@ -17,7 +17,7 @@
 __BEGIN_CDECLS
 
 // API version number (useful when doing incompatible upgrades)
-#define CPUPERF_API_VERSION 3
+#define CPUPERF_API_VERSION 4
 
 // Buffer format version
 #define CPUPERF_BUFFER_VERSION 0
@@ -67,8 +67,10 @@ typedef enum {
   CPUPERF_RECORD_VALUE = 4,
   // The record is a |cpuperf_pc_record_t|.
   CPUPERF_RECORD_PC = 5,
+  // The record is a |cpuperf_callchain_record_t|.
+  CPUPERF_RECORD_CALLCHAIN = 6,
   // non-ABI
-  CPUPERF_NUM_RECORD_TYPES = 6,
+  CPUPERF_NUM_RECORD_TYPES = 7,
 } cpuperf_record_type_t;
 
 // Trace buffer space is expensive, we want to keep records small.
@@ -174,6 +176,36 @@ typedef struct {
     uint64_t pc;
 } __PACKED cpuperf_pc_record_t;
 
+// The most frames a |cpuperf_callchain_record_t| can hold.
+#define CPUPERF_MAX_CALLCHAIN_FRAMES 32
+
+// Record the thread and call chain at the time data was collected.
+// This is used like |cpuperf_pc_record_t|, when the profile is to be
+// attributed to callers as well as to the code that was running.
+// |frames[0]| is the pc, and the rest are return addresses found by
+// following frame pointers from the innermost frame outwards. The walk stops
+// at the first frame that cannot be read, so code built without frame
+// pointers gives short chains. Samples taken in the kernel only have the
+// kernel's frames.
+// The record is variable length: only |num_frames| entries of |frames| are
+// present. Use CPUPERF_CALLCHAIN_RECORD_SIZE to find the next record.
+typedef struct {
+    cpuperf_record_header_t header;
+    uint16_t num_frames;
+    uint16_t flags;
+// The sample was taken in the kernel.
+#define CPUPERF_CALLCHAIN_FLAG_KERNEL (1u << 0)
+    // As for |cpuperf_pc_record_t|.
+    uint64_t aspace;
+    // The koids of the process and thread, or zero for kernel threads.
+    uint64_t pid;
+    uint64_t tid;
+    uint64_t frames[CPUPERF_MAX_CALLCHAIN_FRAMES];
+} __PACKED cpuperf_callchain_record_t;
+
+#define CPUPERF_CALLCHAIN_RECORD_SIZE(num_frames) \
+    (offsetof(cpuperf_callchain_record_t, frames) + (num_frames) * sizeof(uint64_t))
+
 // The properties of this system.
 typedef struct {
     // S/W API version = CPUPERF_API_VERSION.
@@ -229,6 +261,9 @@ typedef struct {
 // record (depending on what the event is).
 // It is an error to have this bit set for an event and have rate[0] be zero.
 #define CPUPERF_CONFIG_FLAG_TIMEBASE0 (1u << 3)
+// Collect the thread and call chain, as CPUPERF_RECORD_CALLCHAIN records.
+// This replaces CPUPERF_CONFIG_FLAG_PC, whose data it includes.
+#define CPUPERF_CONFIG_FLAG_CALLCHAIN (1u << 4)
 } cpuperf_config_t;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -53,6 +53,37 @@ typedef struct zx_display_info {
 #define IOCTL_DISPLAY_SET_OWNER \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 5)
 
+// The following let a fullscreen client draw into buffers of its own and
+// have the display scan them out, instead of flushing them into the
+// framebuffer. They fail with ZX_ERR_NOT_SUPPORTED on displays which can't.
+
+// Import a VMO holding an image with the framebuffer's format and size
+//   in: zx_handle_t vmo
+//   out: uint32_t image id
+#define IOCTL_DISPLAY_IMPORT_VMO \
+    IOCTL(IOCTL_KIND_SET_HANDLE, IOCTL_FAMILY_DISPLAY, 6)
+
+// Release an imported image
+//   in: uint32_t image id
+//   out: none
+#define IOCTL_DISPLAY_RELEASE_IMAGE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 7)
+
+// Scan out an imported image from the next vsync on. Its contents must
+// have been flushed from the cpu caches.
+//   in: uint32_t image id
+//   out: none
+#define IOCTL_DISPLAY_FLIP \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 8)
+
+// Get an event which is signaled with USER_SIGNAL_0 when the last flip
+// has taken effect, after which the image it replaced is no longer read
+// and may be drawn into. The client clears the signal before flipping.
+//   in: none
+//   out: zx_handle_t
+#define IOCTL_DISPLAY_GET_FLIP_EVENT \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_DISPLAY, 9)
+
 typedef struct {
     zx_handle_t vmo;
     zx_display_info_t info;
@@ -78,4 +109,16 @@ IOCTL_WRAPPER_IN(ioctl_display_flush_fb_region, IOCTL_DISPLAY_FLUSH_FB_REGION, i
 IOCTL_WRAPPER_OUT(ioctl_display_get_ownership_change_event, IOCTL_DISPLAY_GET_OWNERSHIP_CHANGE_EVENT, zx_handle_t);
 
 // ssize_t ioctl_display_set_owner(int fd, uint32_t owner);
-IOCTL_WRAPPER_IN(ioctl_display_set_owner, IOCTL_DISPLAY_SET_OWNER, uint32_t)
\ No newline at end of file
+IOCTL_WRAPPER_IN(ioctl_display_set_owner, IOCTL_DISPLAY_SET_OWNER, uint32_t)
+
+// ssize_t ioctl_display_import_vmo(int fd, const zx_handle_t* in, uint32_t* out);
+IOCTL_WRAPPER_INOUT(ioctl_display_import_vmo, IOCTL_DISPLAY_IMPORT_VMO, zx_handle_t, uint32_t);
+
+// ssize_t ioctl_display_release_image(int fd, const uint32_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_release_image, IOCTL_DISPLAY_RELEASE_IMAGE, uint32_t);
+
+// ssize_t ioctl_display_flip(int fd, const uint32_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_flip, IOCTL_DISPLAY_FLIP, uint32_t);
+
+// ssize_t ioctl_display_get_flip_event(int fd, zx_handle_t* out);
+IOCTL_WRAPPER_OUT(ioctl_display_get_flip_event, IOCTL_DISPLAY_GET_FLIP_EVENT, zx_handle_t);
\ No newline at end of file
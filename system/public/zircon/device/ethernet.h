@@ -22,7 +22,11 @@ typedef struct eth_info_t {
     uint32_t mtu;
     uint8_t mac[6];
     uint8_t pad[2];
-    uint32_t reserved[12];
+    // number of queue pairs, see IOCTL_ETHERNET_GET_QUEUE_FIFOS
+    uint32_t queues;
+    // largest frame which may be sent with ETH_OFFLOAD_TSO4/6, if ETH_FEATURE_TSO
+    uint32_t tso_max;
+    uint32_t reserved[10];
 } eth_info_t;
 
 #define ETH_SIGNAL_STATUS ZX_USER_SIGNAL_0
@@ -33,6 +37,13 @@ typedef struct eth_info_t {
 #define ETH_FEATURE_WLAN  1
 // Device is a synthetic network device
 #define ETH_FEATURE_SYNTH 2
+// Device fills in transport checksums of frames sent with ETH_OFFLOAD_CSUM.
+// Without it the checksums are filled in by the driver, in software.
+#define ETH_FEATURE_TX_CSUM 4
+// Device verifies transport checksums, flagging frames ETH_FIFO_RX_CSUM_OK
+#define ETH_FEATURE_RX_CSUM 8
+// Device segments TCP frames sent with ETH_OFFLOAD_TSO4/6
+#define ETH_FEATURE_TSO 16
 
 // Get the fifos to submit tx and rx operations
 //   in: none
@@ -90,6 +101,40 @@ typedef struct eth_fifos_t {
 #define IOCTL_ETHERNET_CONFIG_MULTICAST \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_ETH, 10)
 
+// Get the fifos of another queue pair
+//   in: uint32_t (queue index, less than eth_info_t.queues)
+//  out: eth_fifos_t*
+// Received frames are spread among the queues by a hash of their IP addresses and
+// TCP/UDP ports, so that each flow arrives on one queue. Frames for a queue whose
+// fifos were not obtained arrive on queue 0, the queue of IOCTL_ETHERNET_GET_FIFOS.
+// Each tx fifo is serviced separately. All queues share the io buffer, and their
+// fifos may only be obtained while stopped.
+#define IOCTL_ETHERNET_GET_QUEUE_FIFOS \
+    IOCTL(IOCTL_KIND_GET_TWO_HANDLES, IOCTL_FAMILY_ETH, 11)
+
+#define ETH_MAX_QUEUES 8
+
+// Get the packet counts of each queue, across all clients of the device
+//   in: none
+//  out: eth_stats_t*
+#define IOCTL_ETHERNET_GET_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_ETH, 12)
+
+typedef struct eth_queue_stats_t {
+    uint64_t rx_packets;
+    // frames a client had no buffer, or no fifo space, for
+    uint64_t rx_dropped;
+    uint64_t tx_packets;
+    // frames which failed to transmit, or were out of io buffer bounds
+    uint64_t tx_dropped;
+} eth_queue_stats_t;
+
+typedef struct eth_stats_t {
+    uint32_t queues;
+    uint32_t reserved;
+    eth_queue_stats_t queue[ETH_MAX_QUEUES];
+} eth_stats_t;
+
 // If multicast promiscuous is not on, the filter will be used. Filter config is remembered and
 // can be updated while promiscuous is on. Address must be multicast (LSb of MSB is 1)
 #define ETH_MULTICAST_ADD_MAC     0
@@ -130,13 +175,14 @@ typedef struct eth_multicast_config_t {
 // are returned along with the fifo handles in the eth_fifos_t.
 
 // flags values for request messages
-// - none -
+#define ETH_FIFO_TX_OFFLOAD (16u)   // tx packet is preceded by an eth_offload_t
 
 // flags values for response messages
-#define ETH_FIFO_RX_OK   (1u)   // packet received okay
-#define ETH_FIFO_TX_OK   (1u)   // packet transmitted okay
-#define ETH_FIFO_INVALID (2u)   // offset+length not within io_vmo bounds
-#define ETH_FIFO_RX_TX   (4u)   // received our own tx packet (when TX_LISTEN)
+#define ETH_FIFO_RX_OK      (1u)   // packet received okay
+#define ETH_FIFO_TX_OK      (1u)   // packet transmitted okay
+#define ETH_FIFO_INVALID    (2u)   // offset+length not within io_vmo bounds
+#define ETH_FIFO_RX_TX      (4u)   // received our own tx packet (when TX_LISTEN)
+#define ETH_FIFO_RX_CSUM_OK (8u)   // transport checksum verified by the device
 
 typedef struct eth_fifo_entry {
     // offset from start of io_vmo to packet data
@@ -148,6 +194,31 @@ typedef struct eth_fifo_entry {
     void* cookie;
 } eth_fifo_entry_t;
 
+// Offloads
+//
+// A tx entry flagged ETH_FIFO_TX_OFFLOAD references an eth_offload_t followed
+// by the packet, both counted in its length. With ETH_OFFLOAD_CSUM the checksum
+// field, |csum_offset| bytes past |csum_start|, must hold the sum of the
+// pseudo-header, which is then completed over the rest of the packet from
+// |csum_start|. With ETH_OFFLOAD_TSO4 or _TSO6, which also need _CSUM, a TCP
+// packet of up to eth_info_t.tso_max bytes is cut into segments of |mss| bytes
+// of payload, each with a copy of the first |hdr_len| bytes of headers.
+
+#define ETH_OFFLOAD_CSUM (1u)
+#define ETH_OFFLOAD_TSO4 (2u)
+#define ETH_OFFLOAD_TSO6 (4u)
+
+typedef struct eth_offload {
+    uint16_t flags;
+    // length of the ethernet, IP and TCP headers
+    uint16_t hdr_len;
+    // offsets from the start of the packet
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t mss;
+    uint16_t reserved[3];
+} eth_offload_t;
+
 // ssize_t ioctl_ethernet_get_info(int fd, eth_info_t* out);
 IOCTL_WRAPPER_OUT(ioctl_ethernet_get_info, IOCTL_ETHERNET_GET_INFO, eth_info_t);
 
@@ -181,3 +252,10 @@ IOCTL_WRAPPER_IN(ioctl_ethernet_set_promisc, IOCTL_ETHERNET_SET_PROMISC, bool);
 // ssize_t ioctl_ethernet_config_multicast(int fd, const eth_multicast_config_t *);
 IOCTL_WRAPPER_IN(ioctl_ethernet_config_multicast, IOCTL_ETHERNET_CONFIG_MULTICAST,
                  eth_multicast_config_t)
+
+// ssize_t ioctl_ethernet_get_queue_fifos(int fd, const uint32_t* queue, eth_fifos_t* out);
+IOCTL_WRAPPER_INOUT(ioctl_ethernet_get_queue_fifos, IOCTL_ETHERNET_GET_QUEUE_FIFOS, uint32_t,
+                    eth_fifos_t);
+
+// ssize_t ioctl_ethernet_get_stats(int fd, eth_stats_t* out);
+IOCTL_WRAPPER_OUT(ioctl_ethernet_get_stats, IOCTL_ETHERNET_GET_STATS, eth_stats_t);
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <zircon/device/ioctl.h>
 #include <zircon/device/ioctl-wrapper.h>
+#include <zircon/types.h>
 
 #define IOCTL_INPUT_GET_PROTOCOL \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 0)
@@ -26,6 +27,12 @@
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 7)
 #define IOCTL_INPUT_SET_REPORT \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 8)
+// Get the shared ring the input reports of this instance are written to
+//   in: none
+//  out: input_report_ring_handles_t
+// Once the ring has been obtained, reports are no longer delivered by read().
+#define IOCTL_INPUT_GET_REPORT_RING \
+    IOCTL(IOCTL_KIND_GET_TWO_HANDLES, IOCTL_FAMILY_INPUT, 9)
 
 enum {
     INPUT_PROTO_NONE = 0,
@@ -59,6 +66,46 @@ typedef struct input_set_report {
     uint8_t data[];
 } input_set_report_t;
 
+typedef struct input_report_ring_handles {
+    // Read-only; holds an input_report_ring_t.
+    zx_handle_t vmo;
+    // ZX_USER_SIGNAL_0 is asserted whenever reports are added to the ring.
+    // The client clears it before reading the ring.
+    zx_handle_t event;
+} input_report_ring_handles_t;
+
+// The ring holds input_report_record_t entries, each starting on an 8 byte
+// boundary. Positions are byte counts since the ring was created; the record
+// at position p is at data[p % size]. A record never wraps: if fewer than
+// sizeof(input_report_record_t) bytes are left before the end of data, or the
+// record there has a len of INPUT_REPORT_RECORD_PAD, the next record is at
+// the start of data.
+//
+// The driver never waits for the client, so old records are overwritten.
+// The driver advances |write_head| before it writes a record, and |head|
+// once the record is complete. A client reads the records between its own
+// position and |head|, then (after an acquire fence) checks that
+// |write_head| is no more than |size| past the position it started at; if it
+// is, the records it read may have been overwritten and it has fallen behind.
+typedef struct input_report_ring {
+    uint64_t head;
+    uint64_t write_head;
+    uint32_t size;
+    uint32_t reserved;
+    uint8_t data[];
+} input_report_ring_t;
+
+#define INPUT_REPORT_RECORD_PAD 0xffffu
+
+typedef struct input_report_record {
+    // ZX_CLOCK_MONOTONIC time at which the driver received the report.
+    zx_time_t timestamp;
+    // Length of the report, which follows.
+    uint16_t len;
+    uint16_t reserved[3];
+    uint8_t report[];
+} input_report_record_t;
+
 typedef struct boot_kbd_report {
     uint8_t modifier;
     uint8_t reserved;
@@ -101,3 +148,7 @@ IOCTL_WRAPPER_IN_VAROUT(ioctl_input_get_report, IOCTL_INPUT_GET_REPORT,
 
 // ssize_t ioctl_input_set_report(int fd, const input_set_report_t* in, size_t in_len);
 IOCTL_WRAPPER_VARIN(ioctl_input_set_report, IOCTL_INPUT_SET_REPORT, input_set_report_t);
+
+// ssize_t ioctl_input_get_report_ring(int fd, input_report_ring_handles_t* out);
+IOCTL_WRAPPER_OUT(ioctl_input_get_report_ring, IOCTL_INPUT_GET_REPORT_RING,
+        input_report_ring_handles_t);
@@ -70,6 +70,7 @@
 #define IOCTL_FAMILY_CAMERA         0x32
 #define IOCTL_FAMILY_BT_HOST        0x33
 #define IOCTL_FAMILY_WLANPHY        0x34
+#define IOCTL_FAMILY_NVME           0x35
 
 // IOCTL constructor
 // --K-FFNN
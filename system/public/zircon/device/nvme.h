@@ -0,0 +1,40 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zircon/compiler.h>
+#include <zircon/device/ioctl.h>
+#include <zircon/device/ioctl-wrapper.h>
+
+__BEGIN_CDECLS;
+
+// Reports the stats of every IO queue pair of an NVMe controller, one
+// nvme_queue_stats_t per queue, as many as fit in the reply buffer. The input
+// is a bool that also clears the counters when true.
+#define IOCTL_NVME_GET_QUEUE_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_NVME, 0)
+
+typedef struct {
+    uint32_t qid;            // NVMe queue id, 1 for the first IO queue
+    uint32_t vector;         // interrupt vector of its completion queue
+    uint32_t depth;          // commands that may be in flight at once
+    uint32_t inflight;       // commands in flight now
+    uint32_t max_inflight;
+    uint32_t max_pending;    // most block ops waiting for a command at once
+    uint64_t total_ops;      // block ops taken by the queue
+    uint64_t total_blocks;   // blocks transferred by those ops
+    uint64_t total_latency;  // nanoseconds from queueing to completion, summed
+    uint64_t max_latency;    // longest of those, in nanoseconds
+} nvme_queue_stats_t;
+
+// ssize_t ioctl_nvme_get_queue_stats(int fd, const bool* clear,
+//                                    nvme_queue_stats_t* out, size_t out_len);
+IOCTL_WRAPPER_IN_VAROUT(ioctl_nvme_get_queue_stats, IOCTL_NVME_GET_QUEUE_STATS, bool,
+                        nvme_queue_stats_t);
+
+__END_CDECLS;
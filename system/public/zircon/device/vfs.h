@@ -88,6 +88,24 @@
 #define IOCTL_VFS_GET_DEVICE_PATH \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 9)
 
+// Given a VMO holding a manifest and the data of several blobs, install all
+// of them at once.
+//
+// The VMO begins with |count| vfs_install_entry_t, each naming a blob by its
+// Merkle root and locating its data within the VMO. Blobs which already exist
+// are skipped; either every other blob of the batch is installed, or (if any
+// of them cannot be allocated or fails to verify) none of them are.
+//
+// This ioctl is currently only supported by the root directory of Blobstore.
+#define IOCTL_VFS_INSTALL_BATCH \
+    IOCTL(IOCTL_KIND_SET_HANDLE, IOCTL_FAMILY_VFS, 10)
+
+// Report on the cache of recently closed blobs.
+//
+// This ioctl is currently only supported by Blobstore.
+#define IOCTL_VFS_QUERY_BLOB_CACHE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 11)
+
 typedef struct {
     zx_handle_t channel; // Channel to which watch events will be sent
     uint32_t mask;       // Bitmask of desired events (1 << WATCH_EVT_*)
@@ -181,6 +199,36 @@ typedef struct {
 // ssize_t ioctl_vfs_vmo_create(int fd, vmo_create_config_t* in, size_t in_len);
 IOCTL_WRAPPER_VARIN(ioctl_vfs_vmo_create, IOCTL_VFS_VMO_CREATE, vmo_create_config_t);
 
+#define VFS_INSTALL_BATCH_MAX 4096
+
+typedef struct {
+    zx_handle_t vmo;
+    uint32_t count; // Number of entries at the start of the VMO
+} vfs_install_batch_t;
+
+typedef struct {
+    uint8_t digest[32]; // Merkle root of the blob
+    uint64_t offset;    // Location of the blob's data within the VMO
+    uint64_t size;
+} vfs_install_entry_t;
+
+// ssize_t ioctl_vfs_install_batch(int fd, vfs_install_batch_t* in);
+IOCTL_WRAPPER_IN(ioctl_vfs_install_batch, IOCTL_VFS_INSTALL_BATCH, vfs_install_batch_t);
+
+typedef struct {
+    uint64_t hits;               // Opens of blobs found in the cache
+    uint64_t misses;             // Opens of blobs which had to be found on disk
+    uint64_t evictions;          // Blobs evicted to stay within capacity
+    uint64_t pressure_evictions; // Blobs evicted under memory pressure
+    uint64_t entries;            // Blobs currently cached
+    uint64_t bytes;              // Memory the cached blobs may hold
+    uint64_t capacity;           // Most memory the cached blobs may hold
+} vfs_blob_cache_info_t;
+
+// ssize_t ioctl_vfs_query_blob_cache(int fd, vfs_blob_cache_info_t* out);
+IOCTL_WRAPPER_OUT(ioctl_vfs_query_blob_cache, IOCTL_VFS_QUERY_BLOB_CACHE,
+                  vfs_blob_cache_info_t);
+
 #define MOUNT_MKDIR_FLAG_REPLACE 1
 
 typedef struct mount_mkdir_config {
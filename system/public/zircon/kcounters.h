@@ -0,0 +1,38 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+// The kernel's counters are published as two read-only VMO files, which can
+// be mapped so that the counters are read without any syscalls:
+//
+// /boot/kernel/counters/desc holds a |kcounters_desc_t|: the names of the
+// counters, in the order of their slots.
+//
+// /boot/kernel/counters/arena holds the values. For each of |max_cpus|
+// cpus there is an array of |num_counters| uint64_t values, so the value
+// of counter |i| on cpu |c| is at index |c * num_counters + i|. Each cpu
+// updates its own values in place without synchronization, so a sum over
+// the cpus is only a snapshot of a moving target.
+
+#define KCOUNTERS_DESC_VMO_NAME "counters/desc"
+#define KCOUNTERS_ARENA_VMO_NAME "counters/arena"
+
+#define KCOUNTERS_DESC_MAGIC 0x544e434bu // "KCNT"
+#define KCOUNTERS_NAME_MAX 56
+
+typedef struct {
+    char name[KCOUNTERS_NAME_MAX];
+} kcounters_name_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t max_cpus;
+    uint32_t num_counters;
+    uint32_t reserved;
+    // Sorted, NUL-terminated names, like "kernel.dispatcher.create".
+    kcounters_name_t names[];
+} kcounters_desc_t;
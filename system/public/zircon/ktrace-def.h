@@ -27,6 +27,7 @@ KTRACE_DEF(0x034,32B,PAGE_FAULT,IRQ) // virtual_address_hi, virtual_address_lo,
 KTRACE_DEF(0x035,32B,PAGE_FAULT_EXIT,IRQ) // virtual_address_hi, virtual_address_lo, flags, cpu
 
 KTRACE_DEF(0x040,32B,CONTEXT_SWITCH,SCHEDULER) // to-tid, (state<<16|cpu), from-kt, to-kt
+KTRACE_DEF(0x041,32B,THREAD_MIGRATE,SCHEDULER) // tid, (from-cpu<<16|to-cpu), reason, kt
 
 // events from 0x100 on all share the tag/tid/ts common header
 
@@ -56,6 +57,8 @@ KTRACE_DEF(0x160,32B,KWAIT_BLOCK,SCHEDULER) // queue_hi, queue_hi
 KTRACE_DEF(0x161,32B,KWAIT_WAKE,SCHEDULER) // queue_hi, queue_hi, is_mutex
 KTRACE_DEF(0x162,32B,KWAIT_UNBLOCK,SCHEDULER) // queue_hi, queue_hi, blocked_status
 
+KTRACE_DEF(0x170,32B,LOCK_CONTEND,LOCK) // lock_lo, caller_lo, wait_ns, kind
+
 // events from 0x200-0x2ff are for arch-specific needs
 
 #ifdef __x86_64__
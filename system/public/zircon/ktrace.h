@@ -46,6 +46,7 @@ __BEGIN_CDECLS
 #define KTRACE_GRP_IRQ            0x020
 #define KTRACE_GRP_PROBE          0x040
 #define KTRACE_GRP_ARCH           0x080
+#define KTRACE_GRP_LOCK           0x100
 
 #define KTRACE_GRP_TO_MASK(grp)   ((grp) << 20)
 
@@ -83,10 +84,26 @@ enum {
 #define TAG_PROBE_16(n) KTRACE_TAG(((n)|0x800),KTRACE_GRP_PROBE,16)
 #define TAG_PROBE_24(n) KTRACE_TAG(((n)|0x800),KTRACE_GRP_PROBE,24)
 
+#define KTRACE_MAX_PROBE 0x7FF
+
+// Skipped space at the end of a block of a cpu's trace buffer, left where
+// the next record didn't fit
+#define TAG_PAD(siz) KTRACE_TAG(0,0,siz)
+
 // Actions for ktrace control
-#define KTRACE_ACTION_START     1 // options = grpmask, 0 = all
-#define KTRACE_ACTION_STOP      2 // options ignored
-#define KTRACE_ACTION_REWIND    3 // options ignored
-#define KTRACE_ACTION_NEW_PROBE 4 // options ignored, ptr = name
+#define KTRACE_ACTION_START         1 // options = grpmask, 0 = all
+#define KTRACE_ACTION_STOP          2 // options ignored
+#define KTRACE_ACTION_REWIND        3 // options ignored
+#define KTRACE_ACTION_NEW_PROBE     4 // options ignored, ptr = name
+#define KTRACE_ACTION_SET_GROUPS    5 // options = grpmask, 0 = none
+#define KTRACE_ACTION_ENABLE_PROBE  6 // options = probe number
+#define KTRACE_ACTION_DISABLE_PROBE 7 // options = probe number
+#define KTRACE_ACTION_SET_SAMPLING  8 // options = N, record 1 in N syscalls
+                                      // and page faults, 0 = all
+#define KTRACE_ACTION_SET_MODE      9 // options = KTRACE_MODE_*
+
+// Modes for each cpu's trace buffer
+#define KTRACE_MODE_ONESHOT 0 // new records are dropped once it is full
+#define KTRACE_MODE_RING    1 // the oldest records are overwritten
 
 __END_CDECLS
@@ -23,7 +23,7 @@
      ZX_RIGHT_SIGNAL | ZX_RIGHT_SIGNAL_PEER)
 
 #define ZX_DEFAULT_GUEST_RIGHTS \
-    (ZX_RIGHTS_BASIC | ZX_RIGHT_WRITE)
+    (ZX_RIGHTS_BASIC | ZX_RIGHT_READ | ZX_RIGHT_WRITE)
 
 #define ZX_DEFAULT_INTERRUPT_RIGHTS \
     (ZX_RIGHT_TRANSFER | ZX_RIGHT_WAIT | ZX_RIGHTS_IO)
@@ -77,3 +77,9 @@
 
 #define ZX_DEFAULT_IOMMU_RIGHTS \
     (ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER)
+
+#define ZX_DEFAULT_PAGER_RIGHTS \
+    (ZX_RIGHTS_BASIC | ZX_RIGHTS_IO)
+
+#define ZX_DEFAULT_BTI_RIGHTS \
+    (ZX_RIGHTS_BASIC | ZX_RIGHT_READ | ZX_RIGHT_MAP)
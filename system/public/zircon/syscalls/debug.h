@@ -5,6 +5,7 @@
 #pragma once
 
 #include <zircon/compiler.h>
+#include <zircon/syscalls/exception.h>
 #include <stdint.h>
 
 __BEGIN_CDECLS
@@ -50,10 +51,21 @@ typedef struct zx_thread_state_general_regs {
 // (single-stepping). Other values will give ZX_ERR_INVALID_ARGS.
 typedef uint32_t zx_thread_state_single_step_t;
 
+// Value for ZX_THREAD_STATE_EXCEPTION, which can only be read, and only while
+// the thread is stopped in an exception. It holds what a handler usually
+// needs, so that it takes one call rather than one for each part.
+typedef struct zx_thread_state_exception {
+    // As from ZX_INFO_THREAD_EXCEPTION_REPORT.
+    zx_exception_report_t report;
+    // As from ZX_THREAD_STATE_GENERAL_REGS.
+    zx_thread_state_general_regs_t general_regs;
+} zx_thread_state_exception_t;
+
 // Possible values for "kind" in zx_thread_read_state and zx_thread_write_state.
 typedef enum {
     ZX_THREAD_STATE_GENERAL_REGS = 0, // zx_thread_state_general_regs_t value.
-    ZX_THREAD_STATE_SINGLE_STEP = 1   // zx_thread_state_single_step_t value.
+    ZX_THREAD_STATE_SINGLE_STEP = 1,  // zx_thread_state_single_step_t value.
+    ZX_THREAD_STATE_EXCEPTION = 2     // zx_thread_state_exception_t value, read only.
 } zx_thread_state_topic_t;
 
 __END_CDECLS
@@ -18,4 +18,12 @@ typedef struct zx_iommu_desc_dummy {
     uint8_t reserved;
 } zx_iommu_desc_dummy_t;
 
+// Options for zx_bti_pin(): the accesses the device may make.
+#define ZX_BTI_PERM_READ    ((uint32_t)1u << 0)
+#define ZX_BTI_PERM_WRITE   ((uint32_t)1u << 1)
+#define ZX_BTI_PERM_EXECUTE ((uint32_t)1u << 2)
+// Keep the range pinned and mapped after it is unpinned, so that pinning
+// it again is cheap.
+#define ZX_BTI_CACHE        ((uint32_t)1u << 3)
+
 __END_CDECLS
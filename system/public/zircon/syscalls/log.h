@@ -52,4 +52,12 @@ typedef struct zx_log_record {
 
 #define ZX_LOG_FLAG_READABLE  0x40000000
 
+// Read as many whole records as fit in the buffer, rather than one.
+// Each record starts at a 4-byte aligned offset, ZX_LOG_RECORD_SIZE()
+// bytes after the one before it.
+#define ZX_LOG_READ_MULTIPLE  0x20000000
+
+#define ZX_LOG_RECORD_SIZE(datalen) \
+    ((sizeof(zx_log_record_t) + (datalen) + 3) & ~(size_t)3)
+
 __END_CDECLS
@@ -31,6 +31,15 @@ typedef enum {
     ZX_INFO_KMEM_STATS                 = 17, // zx_info_kmem_stats_t[1]
     ZX_INFO_RESOURCE                   = 18, // zx_info_resource_t[1]
     ZX_INFO_HANDLE_COUNT               = 19, // zx_info_handle_count_t[1]
+    ZX_INFO_PROCESS_HANDLE_STATS       = 20, // zx_info_process_handle_stats_t[1]
+    ZX_INFO_KERNEL_LOCK_STATS          = 21, // zx_info_kernel_lock_stats_t[n]
+    ZX_INFO_SYSCALL_STATS              = 22, // zx_info_syscall_stats_t[n]
+    ZX_INFO_TASK_RUNTIME               = 23, // zx_info_task_runtime_t[1]
+    ZX_INFO_GUEST_STATS                = 24, // zx_info_guest_stats_t[1]
+    ZX_INFO_INTERRUPT_STATS            = 25, // zx_info_interrupt_stats_t[n]
+    ZX_INFO_BTI                        = 26, // zx_info_bti_t[1]
+    ZX_INFO_JOB_TREE                   = 27, // zx_info_task_node_t[n]
+    ZX_INFO_PORT_EXCEPTION_STATS       = 28, // zx_info_exception_port_stats_t[n]
     ZX_INFO_LAST
 } zx_object_info_topic_t;
 
@@ -66,6 +75,12 @@ typedef struct zx_info_handle_count {
     uint32_t handle_count;
 } zx_info_handle_count_t;
 
+typedef struct zx_info_process_handle_stats {
+    // The number of outstanding handles to kernel objects of each type,
+    // indexed by zx_obj_type_t.
+    uint32_t handle_count[ZX_OBJ_TYPE_LAST];
+} zx_info_process_handle_stats_t;
+
 typedef struct zx_info_process {
     // The process's return code; only valid if |exited| is true.
     // Guaranteed to be non-zero if the process was killed by |zx_task_kill|.
@@ -97,6 +112,10 @@ typedef struct zx_info_thread {
 typedef struct zx_info_thread_stats {
     // Total accumulated running time of the thread.
     zx_duration_t total_runtime;
+
+    // Number of periods in which a deadline thread did not receive its full
+    // capacity by its deadline. Always zero for other threads.
+    uint64_t deadline_misses;
 } zx_info_thread_stats_t;
 
 // Statistics about resources (e.g., memory) used by a task. Can be relatively
@@ -125,8 +144,135 @@ typedef struct zx_info_task_stats {
     //
     // This number is strictly smaller than mem_shared_bytes.
     size_t mem_scaled_shared_bytes;
+
+    // Memory mapped into this task whose pages the kernel has compressed
+    // under memory pressure, and the memory the compressed copies take up.
+    // Neither is counted in the committed figures above.
+    size_t mem_compressed_bytes;
+    size_t mem_compressed_storage_bytes;
+
+    // Page faults of the task that had to decompress a page, and the total
+    // time spent decompressing for them.
+    uint64_t decompress_faults;
+    zx_duration_t decompress_fault_time;
+
+    // Memory mapped into this task that reads as zeros because it has never
+    // been written, and is backed by a single page shared by all of it.
+    // Not counted in the committed figures above.
+    size_t mem_zero_mapped_bytes;
 } zx_info_task_stats_t;
 
+// Where the time of a thread went, or that of all the threads of a process
+// or job, including those which have exited.
+typedef struct zx_info_task_runtime {
+    // Time spent running on a cpu.
+    zx_duration_t cpu_time;
+
+    // Time spent ready to run, waiting for a cpu.
+    zx_duration_t queue_time;
+
+    // The part of cpu_time spent in the kernel, handling system calls and
+    // page faults taken in user mode.
+    zx_duration_t kernel_time;
+
+    // Number of times a thread was switched out while it could still run.
+    uint64_t preemptions;
+
+    // Number of page faults taken, and the time spent handling them,
+    // including any time spent blocked.
+    uint64_t page_faults;
+    zx_duration_t page_fault_time;
+} zx_info_task_runtime_t;
+
+// One job, process or thread in a snapshot of a job tree. The entries are in
+// depth-first pre order: the job itself, then its processes, each followed
+// by its threads, then each of its child jobs in turn.
+typedef struct zx_info_task_node {
+    zx_koid_t koid;
+
+    // The koid of the job containing a job or process, or of the process
+    // containing a thread.
+    zx_koid_t parent_koid;
+
+    // ZX_OBJ_TYPE_JOB, ZX_OBJ_TYPE_PROCESS or ZX_OBJ_TYPE_THREAD.
+    uint32_t type;
+
+    // The distance from the job the snapshot is of, which has depth 0.
+    uint32_t depth;
+
+    char name[ZX_MAX_NAME_LEN];
+
+    // Threads only: as in zx_info_thread_t.
+    uint32_t state;
+    uint32_t wait_exception_port_type;
+
+    // Processes and threads only: as for ZX_INFO_TASK_RUNTIME.
+    zx_info_task_runtime_t runtime;
+
+    // Processes only: as in zx_info_task_stats_t. Zero once the process
+    // has exited.
+    size_t mem_private_bytes;
+    size_t mem_shared_bytes;
+    size_t mem_scaled_shared_bytes;
+} zx_info_task_node_t;
+
+// Faults taken by the vcpus of a guest on guest physical memory.
+typedef struct zx_info_guest_stats {
+    // Number of faults handled by mapping in guest memory.
+    uint64_t page_faults;
+
+    // Number of faults on a range with a ZX_GUEST_TRAP_BELL or
+    // ZX_GUEST_TRAP_MEM trap.
+    uint64_t trap_faults;
+} zx_info_guest_stats_t;
+
+// The number of times the interrupt bound to a slot of an interrupt object
+// has fired on one cpu.
+typedef struct zx_info_interrupt_stats {
+    uint32_t slot;
+    uint32_t cpu;
+    uint64_t count;
+} zx_info_interrupt_stats_t;
+
+// Exceptions delivered through one exception port bound to a port, and how
+// long their handlers took to respond.
+typedef struct zx_info_exception_port_stats {
+    // The key the exception port was bound with.
+    uint64_t key;
+
+    // The ZX_EXCEPTION_PORT_TYPE_* of the exception port.
+    uint32_t type;
+
+    uint32_t padding1;
+
+    // Number of exception reports queued on the port.
+    uint64_t exceptions;
+
+    // Number of those a handler responded to, with zx_task_resume() or
+    // zx_thread_resume_from_exception().
+    uint64_t responses;
+
+    // Total and longest time from a report being queued to the response.
+    zx_duration_t total_response_time;
+    zx_duration_t max_response_time;
+} zx_info_exception_port_stats_t;
+
+typedef struct zx_info_bti {
+    // Any range of at most this many bytes is mapped to contiguous device
+    // addresses.
+    uint64_t minimum_contiguity;
+
+    // The size of the device address space.
+    uint64_t aspace_size;
+
+    // Ranges pinned, and unpinned ranges kept mapped by ZX_BTI_CACHE.
+    uint64_t pinned;
+    uint64_t cached;
+
+    // Pins which were satisfied by a cached range.
+    uint64_t cache_hits;
+} zx_info_bti_t;
+
 typedef struct zx_info_vmar {
     // Base address of the region.
     uintptr_t base;
@@ -253,6 +399,11 @@ typedef struct zx_info_vmo {
     // If |flags & ZX_INFO_VMO_VIA_HANDLE|, the handle rights.
     // Undefined otherwise.
     zx_rights_t handle_rights;
+
+    // The amount of memory mapped from this VMO, across all of its mappings,
+    // that maps the shared zero page because it has never been written. It
+    // is not part of committed_bytes.
+    uint64_t zero_mapped_bytes;
 } zx_info_vmo_t;
 
 // kernel statistics per cpu
@@ -283,6 +434,70 @@ typedef struct zx_info_cpu_stats {
     uint64_t generic_ipis;
 } zx_info_cpu_stats_t;
 
+#define ZX_LOCK_STATS_KIND_MUTEX           ((uint32_t)1u)
+#define ZX_LOCK_STATS_KIND_SPINLOCK        ((uint32_t)2u)
+
+#define ZX_LOCK_STATS_HISTOGRAM_BUCKETS 16
+#define ZX_LOCK_STATS_MAX_CALLERS 4
+
+// Statistics for one contended kernel lock.
+// The fields from |wait_ns| on are only filled in by kernels built with
+// lock profiling, and are zero otherwise.
+typedef struct zx_info_kernel_lock_stats {
+    // Kernel address of the lock, or 0 for the record that aggregates
+    // locks the kernel had no room to track individually.
+    uint64_t lock;
+
+    // One of ZX_LOCK_STATS_KIND_*.
+    uint32_t kind;
+    uint32_t reserved;
+
+    // Acquisitions that found the lock held.
+    uint64_t contended;
+    // Contended acquisitions that were satisfied by spinning.
+    uint64_t spin_acquired;
+    // Contended acquisitions that blocked, and the total time spent blocked.
+    uint64_t blocked;
+    uint64_t blocked_ns;
+
+    // Total time from contention to acquisition.
+    uint64_t wait_ns;
+    // Bucket 0 counts waits under 512ns, bucket i counts waits in
+    // [2^(i+8), 2^(i+9)) ns, and the last bucket also counts longer waits.
+    uint64_t wait_histogram[ZX_LOCK_STATS_HISTOGRAM_BUCKETS];
+    // Kernel addresses of the first call sites to contend, and how many
+    // contended acquisitions each made. Unused slots are 0.
+    uint64_t caller[ZX_LOCK_STATS_MAX_CALLERS];
+    uint64_t caller_count[ZX_LOCK_STATS_MAX_CALLERS];
+    // Contended acquisitions from call sites not in |caller|.
+    uint64_t other_callers;
+    // For spinlocks, the CPUs found holding or queued for the lock, summed
+    // over contended acquisitions.  Divided by |contended|, the average
+    // queue length.
+    uint64_t spin_queued;
+} zx_info_kernel_lock_stats_t;
+
+#define ZX_SYSCALL_STATS_HISTOGRAM_BUCKETS 16
+
+// Time spent in one system call, from kernel entry to exit, including any
+// time spent blocked.
+typedef struct zx_info_syscall_stats {
+    // The system call's number and name.
+    uint32_t syscall;
+    uint32_t reserved;
+    char name[ZX_MAX_NAME_LEN];
+
+    // Calls made, and the total cycles they took.
+    uint64_t count;
+    uint64_t cycles;
+    // Bucket 0 counts calls under 256 cycles, bucket i counts calls in
+    // [2^(i+7), 2^(i+8)) cycles, and the last bucket also counts longer calls.
+    uint64_t histogram[ZX_SYSCALL_STATS_HISTOGRAM_BUCKETS];
+} zx_info_syscall_stats_t;
+
+// Maximum number of memory nodes reported by ZX_INFO_KMEM_STATS.
+#define ZX_MAX_NUMA_NODES 8
+
 // Information about kernel memory usage.
 // Can be expensive to gather.
 typedef struct zx_info_kmem_stats {
@@ -318,6 +533,23 @@ typedef struct zx_info_kmem_stats {
 
     // Non-free memory that isn't accounted for in any other field.
     uint64_t other_bytes;
+
+    // The number of memory nodes (NUMA proximity domains) in the system.
+    uint64_t num_nodes;
+
+    // The portion of |free_bytes| on each memory node. Only the first
+    // |num_nodes| entries are valid.
+    uint64_t free_bytes_node[ZX_MAX_NUMA_NODES];
+
+    // The portion of |vmo_bytes| committed to unlocked discardable VMOs, which
+    // the kernel may reclaim under memory pressure. Measured when each VMO was
+    // last unlocked.
+    uint64_t reclaimable_bytes;
+
+    // The total amount of memory reclaimed from discardable VMOs since boot,
+    // and the number of times a VMO had its contents discarded.
+    uint64_t reclaimed_bytes;
+    uint64_t reclaimed_vmos;
 } zx_info_kmem_stats_t;
 
 typedef struct zx_info_resource {
@@ -353,6 +585,16 @@ typedef struct zx_info_resource {
 // Argument is an zx_job_importance_t value.
 #define ZX_PROP_JOB_IMPORTANCE             7u
 
+// Argument is a uint32_t memory node, or ZX_VMO_NUMA_NODE_LOCAL.
+#define ZX_PROP_VMO_NUMA_NODE              8u
+
+// Allocate VMO pages from the memory node of the cpu committing them.
+#define ZX_VMO_NUMA_NODE_LOCAL             UINT32_MAX
+
+// Argument is a uint32_t, 1 to let identical pages of the VMO be merged with
+// those of other mergeable VMOs, 0 not to.
+#define ZX_PROP_VMO_MERGEABLE              9u
+
 // Describes how important a job is.
 typedef int32_t zx_job_importance_t;
 
@@ -11,6 +11,10 @@ __BEGIN_CDECLS
 // zx_object_wait_async() options
 #define ZX_WAIT_ASYNC_ONCE          0u
 #define ZX_WAIT_ASYNC_REPEATING     1u
+#define ZX_WAIT_ASYNC_EDGE          2u
+
+// The most packets a single zx_port_wait_many() call can return.
+#define ZX_PORT_WAIT_MANY_MAX       16u
 
 // packet types.
 #define ZX_PKT_TYPE_USER            0x00u
@@ -21,6 +25,8 @@ __BEGIN_CDECLS
 #define ZX_PKT_TYPE_GUEST_IO        0x05u
 #define ZX_PKT_TYPE_GUEST_VCPU      0x06u
 #define ZX_PKT_TYPE_EXCEPTION(n)    (0x07u | (((n) & 0xFFu) << 8))
+#define ZX_PKT_TYPE_PAGE_REQUEST    0x08u
+#define ZX_PKT_TYPE_INTERRUPT       0x09u
 
 #define ZX_PKT_TYPE_MASK            0xFFu
 
@@ -32,6 +38,8 @@ __BEGIN_CDECLS
 #define ZX_PKT_IS_GUEST_IO(type)    ((type) == ZX_PKT_TYPE_GUEST_IO)
 #define ZX_PKT_IS_GUEST_VCPU(type)  ((type) == ZX_PKT_TYPE_GUEST_VCPU)
 #define ZX_PKT_IS_EXCEPTION(type)   (((type) & ZX_PKT_TYPE_MASK) == ZX_PKT_TYPE_EXCEPTION(0))
+#define ZX_PKT_IS_PAGE_REQUEST(type) ((type) == ZX_PKT_TYPE_PAGE_REQUEST)
+#define ZX_PKT_IS_INTERRUPT(type)   ((type) == ZX_PKT_TYPE_INTERRUPT)
 
 #define ZX_PKT_GUEST_VCPU_INTERRUPT  0
 #define ZX_PKT_GUEST_VCPU_STARTUP    1
@@ -62,7 +70,8 @@ typedef struct zx_packet_exception {
 
 typedef struct zx_packet_guest_bell {
     zx_vaddr_t addr;
-    uint64_t reserved0;
+    // The number of accesses to the trap so far, including this one.
+    uint64_t count;
     uint64_t reserved1;
     uint64_t reserved2;
 } zx_packet_guest_bell_t;
@@ -114,6 +123,31 @@ typedef struct zx_packet_guest_vcpu {
     uint64_t reserved;
 } zx_packet_guest_vcpu_t;
 
+// port_packet_t::type ZX_PKT_TYPE_PAGE_REQUEST.
+#define ZX_PAGER_VMO_READ            0
+#define ZX_PAGER_VMO_COMPLETE        1
+#define ZX_PAGER_VMO_ZERO_CHILDREN   2
+
+typedef struct zx_packet_page_request {
+    uint16_t command;
+    uint16_t flags;
+    uint32_t reserved0;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t reserved1;
+} zx_packet_page_request_t;
+
+// port_packet_t::type ZX_PKT_TYPE_INTERRUPT.
+typedef struct zx_packet_interrupt {
+    // The slots of the interrupt object which have fired since the last
+    // packet was dequeued.
+    uint64_t slots;
+    // When the first of them fired.
+    zx_time_t timestamp;
+    uint64_t reserved0;
+    uint64_t reserved1;
+} zx_packet_interrupt_t;
+
 typedef struct zx_port_packet {
     uint64_t key;
     uint32_t type;
@@ -126,6 +160,8 @@ typedef struct zx_port_packet {
         zx_packet_guest_mem_t guest_mem;
         zx_packet_guest_io_t guest_io;
         zx_packet_guest_vcpu_t guest_vcpu;
+        zx_packet_page_request_t page_request;
+        zx_packet_interrupt_t interrupt;
     };
 } zx_port_packet_t;
 
@@ -31,6 +31,10 @@ typedef uint32_t zx_handle_t;
 
 #define ZX_HANDLE_INVALID         ((zx_handle_t)0)
 
+// Maximum number of handles zx_handle_duplicate_many() and
+// zx_handle_replace_many() take at once.
+#define ZX_HANDLE_BATCH_MAX       64u
+
 // See errors.h for the values zx_status_t can take.
 typedef int32_t zx_status_t;
 
@@ -170,6 +174,16 @@ typedef struct {
     uint32_t rd_num_handles;
 } zx_channel_call_args_t;
 
+// Message descriptor for zx_channel_read_many() and zx_channel_write_many().
+// On read, |num_bytes| and |num_handles| are the buffer capacities going in
+// and the size of the message read coming out.
+typedef struct {
+    void* bytes;
+    zx_handle_t* handles;
+    uint32_t num_bytes;
+    uint32_t num_handles;
+} zx_channel_msg_t;
+
 // Maximum number of wait items allowed for zx_object_wait_many()
 // TODO(ZX-1349) Re-lower this.
 #define ZX_WAIT_MANY_MAX_ITEMS 16
@@ -215,6 +229,10 @@ typedef uint32_t zx_rights_t;
     (ZX_RIGHT_GET_POLICY | ZX_RIGHT_SET_POLICY)
 
 
+// VM Object creation options
+#define ZX_VMO_LARGE_PAGES               1u
+#define ZX_VMO_DISCARDABLE               2u
+
 // VM Object opcodes
 #define ZX_VMO_OP_COMMIT                 1u
 #define ZX_VMO_OP_DECOMMIT               2u
@@ -225,6 +243,15 @@ typedef uint32_t zx_rights_t;
 #define ZX_VMO_OP_CACHE_INVALIDATE       7u
 #define ZX_VMO_OP_CACHE_CLEAN            8u
 #define ZX_VMO_OP_CACHE_CLEAN_INVALIDATE 9u
+#define ZX_VMO_OP_DONT_NEED              10u
+#define ZX_VMO_OP_WILL_NEED              11u
+
+// VM Address Region opcodes
+#define ZX_VMAR_OP_DONT_NEED             1u
+#define ZX_VMAR_OP_WILL_NEED             2u
+#define ZX_VMAR_OP_NORMAL                3u
+#define ZX_VMAR_OP_SEQUENTIAL            4u
+#define ZX_VMAR_OP_RANDOM                5u
 
 // VM Object clone flags
 #define ZX_VMO_CLONE_COPY_ON_WRITE       1u
@@ -258,6 +285,30 @@ typedef uint32_t  zx_paddr32_t;
 // offset
 typedef uint64_t zx_off_t;
 
+// Operations for zx_vmar_batch()
+#define ZX_VMAR_BATCH_MAP                1u
+#define ZX_VMAR_BATCH_UNMAP              2u
+#define ZX_VMAR_BATCH_PROTECT            3u
+
+// Maximum number of operations allowed for zx_vmar_batch()
+#define ZX_VMAR_BATCH_MAX_OPS            16
+
+// Structure for zx_vmar_batch():
+typedef struct {
+    uint32_t op;
+    // ZX_VM_FLAG_* flags for a map, or the new protections for a protect.
+    uint32_t flags;
+    // The VMO to map, and the offset into it.  Only used by a map.
+    zx_handle_t vmo;
+    uint32_t reserved;
+    uint64_t vmo_offset;
+    // The offset into the VMAR for a map, which is replaced with the
+    // address of the new mapping, or the address of the range to unmap or
+    // protect.
+    uintptr_t addr;
+    size_t len;
+} zx_vmar_batch_op_t;
+
 // Maximum string length for kernel names (process name, thread name, etc)
 #define ZX_MAX_NAME_LEN           (32)
 
@@ -285,9 +336,34 @@ typedef uint64_t zx_off_t;
 
 // Channel options and limits.
 #define ZX_CHANNEL_READ_MAY_DISCARD         1u
+#define ZX_CHANNEL_WRITE_MOVE               1u
 
 #define ZX_CHANNEL_MAX_MSG_BYTES            65536u
 #define ZX_CHANNEL_MAX_MSG_HANDLES          64u
+#define ZX_CHANNEL_MAX_MSGS_PER_BATCH       32u
+
+// Fifo options and limits.
+// These can be passed to zx_fifo_create()
+#define ZX_FIFO_SHARED                      (1u << 0)
+#define ZX_FIFO_CREATE_MASK                 (ZX_FIFO_SHARED)
+
+// These can be passed to zx_fifo_shared_vmo()
+#define ZX_FIFO_SHARED_READ                 0u
+#define ZX_FIFO_SHARED_WRITE                1u
+
+// Layout of the first page of a ring returned by zx_fifo_shared_vmo().
+// head and tail are free-running element counts; element i lives at
+// data_offset + (i % elem_count) * elem_size. The writer advances head and
+// the reader advances tail. The kernel only needs to be told, with a
+// zero-length zx_fifo_write() or zx_fifo_read(), when a ring changes
+// between empty and non-empty or between full and non-full.
+typedef struct zx_fifo_shared_header {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t elem_count;
+    uint32_t elem_size;
+    uint64_t data_offset;
+} zx_fifo_shared_header_t;
 
 // Socket options and limits.
 // These options can be passed to zx_socket_write()
@@ -300,11 +376,52 @@ typedef uint64_t zx_off_t;
 #define ZX_SOCKET_DATAGRAM                  (1u << 0)
 #define ZX_SOCKET_HAS_CONTROL               (1u << 1)
 #define ZX_SOCKET_HAS_ACCEPT                (1u << 2)
-#define ZX_SOCKET_CREATE_MASK               (ZX_SOCKET_DATAGRAM | ZX_SOCKET_HAS_CONTROL | ZX_SOCKET_HAS_ACCEPT)
+#define ZX_SOCKET_RING                      (1u << 3)
+// Log2 of the ZX_SOCKET_RING data size. Zero selects ZX_SOCKET_RING_DEFAULT_ORDER.
+#define ZX_SOCKET_RING_ORDER(order)         (((uint32_t)(order) & 0x1fu) << 8)
+#define ZX_SOCKET_RING_ORDER_MASK           ZX_SOCKET_RING_ORDER(0x1fu)
+#define ZX_SOCKET_RING_ORDER_GET(options)   (((options) >> 8) & 0x1fu)
+#define ZX_SOCKET_RING_DEFAULT_ORDER        20u
+#define ZX_SOCKET_RING_MIN_ORDER            16u
+#define ZX_SOCKET_RING_MAX_ORDER            24u
+#define ZX_SOCKET_CREATE_MASK               (ZX_SOCKET_DATAGRAM | ZX_SOCKET_HAS_CONTROL | \
+                                             ZX_SOCKET_HAS_ACCEPT | ZX_SOCKET_RING | \
+                                             ZX_SOCKET_RING_ORDER_MASK)
 
 // These can be passed to zx_socket_read() and zx_socket_write().
 #define ZX_SOCKET_CONTROL                   (1u << 2)
 
+// These can be passed to zx_socket_read() on a ZX_SOCKET_DATAGRAM socket to
+// read as many datagrams as there are slots of 1 << order bytes in the
+// buffer. Each slot starts with a zx_socket_datagram_t, followed by the
+// datagram truncated to fit the slot.
+#define ZX_SOCKET_DATAGRAM_BATCH            (1u << 3)
+#define ZX_SOCKET_SLOT_ORDER(order)         (((uint32_t)(order) & 0x1fu) << 8)
+#define ZX_SOCKET_SLOT_ORDER_MASK           ZX_SOCKET_SLOT_ORDER(0x1fu)
+#define ZX_SOCKET_SLOT_ORDER_GET(options)   (((options) >> 8) & 0x1fu)
+#define ZX_SOCKET_SLOT_MIN_ORDER            4u
+#define ZX_SOCKET_SLOT_MAX_ORDER            16u
+
+typedef struct zx_socket_datagram {
+    // The size of the datagram as it was written.
+    uint32_t size;
+    // The bytes of it in the slot, less than |size| if it was truncated.
+    uint32_t actual;
+} zx_socket_datagram_t;
+
+// Layout of the first page of the VMO returned by zx_socket_ring_vmo().
+// Positions are byte counts since creation and never wrap; the data for
+// position p lives at data_offset + (p % data_size). The kernel publishes
+// write_pos. A reader that consumes data through a mapping advances
+// read_pos itself and then calls zx_socket_read() with a zero size to
+// make the space available to the writer.
+typedef struct zx_socket_ring_header {
+    uint64_t write_pos;
+    uint64_t read_pos;
+    uint64_t data_offset;
+    uint64_t data_size;
+} zx_socket_ring_header_t;
+
 // Flags which can be used to to control cache policy for APIs which map memory.
 typedef enum {
     ZX_CACHE_POLICY_CACHED          = 0,
@@ -347,7 +464,9 @@ typedef uint32_t zx_obj_type_t;
 #define ZX_OBJ_TYPE_VCPU            ((zx_obj_type_t)21u)
 #define ZX_OBJ_TYPE_TIMER           ((zx_obj_type_t)22u)
 #define ZX_OBJ_TYPE_IOMMU           ((zx_obj_type_t)23u)
-#define ZX_OBJ_TYPE_LAST            ((zx_obj_type_t)24u)
+#define ZX_OBJ_TYPE_PAGER           ((zx_obj_type_t)24u)
+#define ZX_OBJ_TYPE_BTI             ((zx_obj_type_t)25u)
+#define ZX_OBJ_TYPE_LAST            ((zx_obj_type_t)26u)
 
 typedef struct {
     zx_handle_t handle;
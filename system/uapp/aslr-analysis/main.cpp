@@ -31,17 +31,28 @@ struct ReportInfo {
     uintptr_t first_heap_alloc = 0;
     uintptr_t libc = 0;
     uintptr_t vdso = 0;
+    // A mapping made after many others.
+    uintptr_t fragmented_map = 0;
+    // The offset of a mapping made in a nearly full VMAR, which can only go
+    // in one of kDenseHoles pages.
+    uintptr_t dense_map = 0;
 };
 
 namespace {
 
 static const char* kBinName = "/boot/bin/aslr-analysis";
 
+static const size_t kFragmentingMaps = 256;
+static const size_t kDenseHoles = 16;
+static const size_t kDenseHoleStride = 64;
+
 int GatherReports(const char* test_bin, fbl::Array<ReportInfo>* reports);
 unsigned int AnalyzeField(const fbl::Array<ReportInfo>& reports,
                           uintptr_t ReportInfo::*field);
 double ApproxBinomialCdf(double p, double N, double n);
 int TestRunMain(int argc, char** argv);
+zx_status_t MapFragmented(zx_handle_t vmo, uintptr_t* addr);
+zx_status_t MapDense(zx_handle_t vmo, uintptr_t* offset);
 zx_status_t LaunchTestRun(const char* bin, zx_handle_t h, zx_handle_t* out);
 int JoinProcess(zx_handle_t proc);
 } // namespace
@@ -84,6 +95,13 @@ int main(int argc, char** argv) {
     printf("libc: %d bits\n", bits);
     bits = AnalyzeField(reports, &ReportInfo::vdso);
     printf("vdso: %d bits\n", bits);
+    bits = AnalyzeField(reports, &ReportInfo::fragmented_map);
+    printf("fragmented_map: %d bits\n", bits);
+    // The hole the mapping goes in is chosen by the bits of its offset from
+    // log2(kDenseHoleStride) up, so this should come to log2(kDenseHoles).
+    bits = AnalyzeField(reports, &ReportInfo::dense_map);
+    printf("dense_map: %d bits (of %d possible)\n", bits,
+           static_cast<int>(log2(static_cast<double>(kDenseHoles))));
 
     return 0;
 }
@@ -207,8 +225,21 @@ int TestRunMain(int argc, char** argv) {
     report.libc = (uintptr_t)&memcpy;
     report.vdso = (uintptr_t)&zx_channel_write;
 
-    zx_status_t status =
-        zx_channel_write(report_pipe, 0, &report, sizeof(report), NULL, 0);
+    zx_handle_t vmo;
+    zx_status_t status = zx_vmo_create(PAGE_SIZE, 0, &vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = MapFragmented(vmo, &report.fragmented_map);
+    if (status == ZX_OK) {
+        status = MapDense(vmo, &report.dense_map);
+    }
+    zx_handle_close(vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    status = zx_channel_write(report_pipe, 0, &report, sizeof(report), NULL, 0);
     if (status != ZX_OK) {
         return status;
     }
@@ -216,6 +247,57 @@ int TestRunMain(int argc, char** argv) {
     return 0;
 }
 
+// Makes kFragmentingMaps one page mappings in the root VMAR, and then reports
+// where the next one goes.  The mappings are left for the process's exit to
+// clean up.
+zx_status_t MapFragmented(zx_handle_t vmo, uintptr_t* addr) {
+    for (size_t i = 0; i <= kFragmentingMaps; ++i) {
+        zx_status_t status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, PAGE_SIZE,
+                                         ZX_VM_FLAG_PERM_READ, addr);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+// Fills a VMAR, except for one page every kDenseHoleStride pages, and then
+// reports the offset of a one page mapping made in it.  Few of the positions
+// in the VMAR are free, so this exercises the path where the allocator has to
+// count them rather than find one by chance.
+zx_status_t MapDense(zx_handle_t vmo, uintptr_t* offset) {
+    const size_t vmar_size = kDenseHoles * kDenseHoleStride * PAGE_SIZE;
+    const size_t fill_size = (kDenseHoleStride - 1) * PAGE_SIZE;
+    zx_handle_t vmar;
+    uintptr_t vmar_addr;
+    zx_status_t status = zx_vmar_allocate(
+        zx_vmar_root_self(), 0, vmar_size,
+        ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_SPECIFIC, &vmar, &vmar_addr);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    zx_handle_t fill_vmo;
+    status = zx_vmo_create(fill_size, 0, &fill_vmo);
+    if (status != ZX_OK) {
+        zx_handle_close(vmar);
+        return status;
+    }
+    for (size_t i = 0; status == ZX_OK && i < kDenseHoles; ++i) {
+        uintptr_t addr;
+        status = zx_vmar_map(vmar, (i * kDenseHoleStride + 1) * PAGE_SIZE, fill_vmo, 0,
+                             fill_size, ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_SPECIFIC, &addr);
+    }
+    zx_handle_close(fill_vmo);
+    if (status == ZX_OK) {
+        uintptr_t addr;
+        status = zx_vmar_map(vmar, 0, vmo, 0, PAGE_SIZE, ZX_VM_FLAG_PERM_READ, &addr);
+        *offset = addr - vmar_addr;
+    }
+    zx_handle_close(vmar);
+    return status;
+}
+
 // This function unconditionally consumes the handle h.
 zx_status_t LaunchTestRun(const char* bin, zx_handle_t h, zx_handle_t* out) {
     launchpad_t* lp;
@@ -13,7 +13,6 @@
 #include <zircon/syscalls.h>
 #include <zircon/device/block.h>
 #include <zircon/misc/xorshiftrand.h>
-#include <sync/completion.h>
 
 static uint64_t number(const char* str) {
     char* end;
@@ -58,6 +57,88 @@ static void ops_per_second(uint64_t count, uint64_t nanos) {
     fprintf(stderr, "%g %s/s\n", rate, "ops");
 }
 
+// Latencies are counted in log-linear buckets: exactly below 2 * HIST_SUB ns,
+// and in HIST_SUB buckets per power of two above, each within ~3% of the
+// latencies it holds.
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t bucket[HIST_BUCKETS];
+} histogram_t;
+
+static unsigned hist_index(uint64_t v) {
+    if (v < 2 * HIST_SUB) {
+        return v;
+    }
+    unsigned shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (unsigned)((v >> shift) - HIST_SUB);
+}
+
+// Returns the middle of the range of latencies held by bucket |n|.
+static uint64_t hist_value(unsigned n) {
+    if (n < 2 * HIST_SUB) {
+        return n;
+    }
+    unsigned shift = n / HIST_SUB - 1;
+    uint64_t lo = ((uint64_t)(n % HIST_SUB + HIST_SUB)) << shift;
+    return lo + ((1ULL << shift) >> 1);
+}
+
+static void hist_add(histogram_t* h, uint64_t v) {
+    if ((h->count == 0) || (v < h->min)) {
+        h->min = v;
+    }
+    if (v > h->max) {
+        h->max = v;
+    }
+    h->count++;
+    h->sum += v;
+    h->bucket[hist_index(v)]++;
+}
+
+// Returns the latency under which |permille| thousandths of them fall.
+static uint64_t hist_percentile(const histogram_t* h, uint64_t permille) {
+    uint64_t target = (h->count * permille + 999) / 1000;
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned n = 0; n < HIST_BUCKETS; n++) {
+        seen += h->bucket[n];
+        if (seen >= target) {
+            uint64_t v = hist_value(n);
+            return (v < h->min) ? h->min : (v > h->max) ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+static void hist_print(const char* name, const histogram_t* h) {
+    if (h->count == 0) {
+        return;
+    }
+    fprintf(stderr, "%s latency (ns): min %zu avg %zu p50 %zu p99 %zu p999 %zu max %zu\n",
+            name, h->min, h->sum / h->count, hist_percentile(h, 500), hist_percentile(h, 990),
+            hist_percentile(h, 999), h->max);
+}
+
+static void hist_json(FILE* out, const char* name, const histogram_t* h) {
+    fprintf(out, "\"%s\":{\"ops\":%zu", name, h->count);
+    if (h->count > 0) {
+        fprintf(out, ",\"min_ns\":%zu,\"avg_ns\":%zu,\"p50_ns\":%zu,\"p99_ns\":%zu"
+                ",\"p999_ns\":%zu,\"max_ns\":%zu",
+                h->min, h->sum / h->count, hist_percentile(h, 500), hist_percentile(h, 990),
+                hist_percentile(h, 999), h->max);
+    }
+    fprintf(out, "}");
+}
+
 typedef struct {
     int fd;
     zx_handle_t vmo;
@@ -125,6 +206,8 @@ fail:
     return ZX_ERR_INTERNAL;
 }
 
+#define MAX_THREADS 16
+
 typedef struct {
     blkdev_t* blk;
     size_t count;
@@ -132,24 +215,56 @@ typedef struct {
     uint64_t seed;
     int max_pending;
     bool linear;
-
-    atomic_int pending;
-    completion_t signal;
+    // Percentage of operations which are writes.
+    unsigned write_pct;
+    unsigned threads;
+
+    // Operations on the device, bounded by max_pending.
+    mtx_t lock;
+    cnd_t cvar;
+    int pending;
+
+    // When the operation on each txnid was issued, and whether it is a write.
+    zx_time_t issued[MAX_TXN_COUNT];
+    bool write[MAX_TXN_COUNT];
+    histogram_t read_hist;
+    histogram_t write_hist;
 } bio_random_args_t;
 
+// The share of the work of one issuing thread.
+typedef struct {
+    bio_random_args_t* a;
+    size_t count;
+    uint64_t seed;
+    // Where linear transfers start on the device, and the part of the VMO
+    // the thread transfers to and from.
+    size_t dev_off;
+    size_t vmo_off;
+    size_t vmo_len;
+} bio_thread_args_t;
+
 static atomic_uint_fast64_t IDMAP0 = 0xFFFFFFFFFFFFFFFFULL;
 static atomic_uint_fast64_t IDMAP1 = 0xFFFFFFFFFFFFFFFFULL;
 
+// Claims the lowest free bit of |map|, returning its index plus one, or zero
+// if there is none.
+static uint64_t claim(atomic_uint_fast64_t* map) {
+    uint64_t bits = atomic_load(map);
+    while (bits != 0) {
+        uint64_t n = __builtin_ffsll(bits) - 1;
+        if (atomic_compare_exchange_weak(map, &bits, bits & ~(1ULL << n))) {
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
 static txnid_t GET(void) {
-    uint64_t n = __builtin_ffsll(atomic_load(&IDMAP0));
-    if (n > 0) {
-        n--;
-        atomic_fetch_and(&IDMAP0, ~(1ULL << n));
-        return n;
-    } else if ((n = __builtin_ffsll(atomic_load(&IDMAP1))) > 0) {
-        n--;
-        atomic_fetch_and(&IDMAP1, ~(1ULL << n));
-        return n + 64;
+    uint64_t n;
+    if ((n = claim(&IDMAP0)) > 0) {
+        return n - 1;
+    } else if ((n = claim(&IDMAP1)) > 0) {
+        return n - 1 + 64;
     } else {
         fprintf(stderr, "FATAL OUT OF IDS\n");
         sleep(100);
@@ -171,32 +286,36 @@ static void PUT(uint64_t n) {
 }
 
 static int bio_random_thread(void* arg) {
-    bio_random_args_t* a = arg;
+    bio_thread_args_t* t = arg;
+    bio_random_args_t* a = t->a;
 
     size_t off = 0;
-    size_t count = a->count;
+    size_t count = t->count;
     size_t xfer = a->xfer;
 
     size_t blksize = a->blk->info.block_size;
-    size_t blkcount = ((count * xfer) / blksize) - (xfer / blksize);
+    size_t blkcount = ((a->count * xfer) / blksize) - (xfer / blksize);
 
-    rand64_t r64 = RAND63SEED(a->seed);
+    rand64_t r64 = RAND63SEED(t->seed);
 
     zx_handle_t fifo = a->blk->fifo;
-    size_t dev_off = 0;
+    size_t dev_off = t->dev_off;
 
     while (count > 0) {
-        while (atomic_load(&a->pending) == a->max_pending) {
-            completion_wait(&a->signal, ZX_TIME_INFINITE);
-            completion_reset(&a->signal);
+        mtx_lock(&a->lock);
+        while (a->pending == a->max_pending) {
+            cnd_wait(&a->cvar, &a->lock);
         }
+        a->pending++;
+        mtx_unlock(&a->lock);
 
+        bool write = (rand64(&r64) % 100) < a->write_pct;
         block_fifo_request_t req = {
             .txnid = GET(),
             .vmoid = a->blk->vmoid,
-            .opcode = BLOCKIO_READ | BLOCKIO_TXN_END,
+            .opcode = (write ? BLOCKIO_WRITE : BLOCKIO_READ) | BLOCKIO_TXN_END,
             .length = xfer,
-            .vmo_offset = off,
+            .vmo_offset = t->vmo_off + off,
         };
 
         if (a->linear) {
@@ -206,7 +325,7 @@ static int bio_random_thread(void* arg) {
             req.dev_offset = (rand64(&r64) % blkcount) * blksize;
         }
         off += xfer;
-        if ((off + xfer) > a->blk->bufsz) {
+        if ((off + xfer) > t->vmo_len) {
             off = 0;
         }
 
@@ -218,24 +337,28 @@ static int bio_random_thread(void* arg) {
         fprintf(stderr, "IO tid=%u vid=%u op=%x len=%zu vof=%zu dof=%zu\n",
                 req.txnid, req.vmoid, req.opcode, req.length, req.vmo_offset, req.dev_offset);
 #endif
-        uint32_t actual;
-        zx_status_t r = zx_fifo_write(fifo, &req, sizeof(req), &actual);
-        if (r == ZX_ERR_SHOULD_WAIT) {
-            r = zx_object_wait_one(fifo, ZX_FIFO_WRITABLE | ZX_FIFO_PEER_CLOSED,
-                                   ZX_TIME_INFINITE, NULL);
-            if (r != ZX_OK) {
-                fprintf(stderr, "failed waiting for fifo\n");
+        a->write[req.txnid] = write;
+        a->issued[req.txnid] = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        for (;;) {
+            uint32_t actual;
+            zx_status_t r = zx_fifo_write(fifo, &req, sizeof(req), &actual);
+            if (r == ZX_ERR_SHOULD_WAIT) {
+                r = zx_object_wait_one(fifo, ZX_FIFO_WRITABLE | ZX_FIFO_PEER_CLOSED,
+                                       ZX_TIME_INFINITE, NULL);
+                if (r != ZX_OK) {
+                    fprintf(stderr, "failed waiting for fifo\n");
+                    zx_handle_close(fifo);
+                    return -1;
+                }
+                continue;
+            } else if (r < 0) {
+                fprintf(stderr, "error: failed writing fifo\n");
                 zx_handle_close(fifo);
                 return -1;
             }
-            continue;
-        } else if (r < 0) {
-            fprintf(stderr, "error: failed writing fifo\n");
-            zx_handle_close(fifo);
-            return -1;
+            break;
         }
 
-        atomic_fetch_add(&a->pending, 1);
         count--;
     }
     return 0;
@@ -244,21 +367,41 @@ static int bio_random_thread(void* arg) {
 
 static zx_status_t bio_random(bio_random_args_t* a, uint64_t* _total, zx_time_t* _res) {
 
-    thrd_t t;
+    thrd_t t[MAX_THREADS];
+    bio_thread_args_t targs[MAX_THREADS];
     int r;
 
     size_t count = a->count;
     zx_handle_t fifo = a->blk->fifo;
 
+    // Each thread takes its share of the operations, and of the VMO.
+    size_t vmo_len = (a->blk->bufsz / a->threads / a->xfer) * a->xfer;
+    size_t first = 0;
+    for (unsigned i = 0; i < a->threads; i++) {
+        targs[i].a = a;
+        targs[i].count = a->count / a->threads + (i < a->count % a->threads ? 1 : 0);
+        targs[i].seed = a->seed + i;
+        targs[i].dev_off = first * a->xfer;
+        targs[i].vmo_off = i * vmo_len;
+        targs[i].vmo_len = vmo_len;
+        first += targs[i].count;
+    }
+
     zx_time_t t0 = zx_clock_get(ZX_CLOCK_MONOTONIC);
-    thrd_create(&t, bio_random_thread, a);
+    unsigned started;
+    for (started = 0; started < a->threads; started++) {
+        if (thrd_create(&t[started], bio_random_thread, &targs[started]) != thrd_success) {
+            fprintf(stderr, "error: cannot start thread\n");
+            goto fail;
+        }
+    }
 
     while (count > 0) {
-        block_fifo_response_t resp;
+        block_fifo_response_t resp[MAX_TXN_COUNT];
         uint32_t actual;
-        zx_status_t r = zx_fifo_read(fifo, &resp, sizeof(resp), &actual);
+        zx_status_t r = zx_fifo_read(fifo, resp, sizeof(resp), &actual);
         if (r == ZX_ERR_SHOULD_WAIT) {
-            r = zx_object_wait_one(fifo, ZX_FIFO_WRITABLE | ZX_FIFO_PEER_CLOSED,
+            r = zx_object_wait_one(fifo, ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED,
                                    ZX_TIME_INFINITE, NULL);
             if (r != ZX_OK) {
                 fprintf(stderr, "failed waiting for fifo: %d\n", r);
@@ -269,22 +412,31 @@ static zx_status_t bio_random(bio_random_args_t* a, uint64_t* _total, zx_time_t*
             fprintf(stderr, "error: failed reading fifo: %d\n", r);
             goto fail;
         }
-        if (resp.status != ZX_OK) {
-            fprintf(stderr, "error: io txn failed %d (%zu remaining)\n",
-                    resp.status, count);
-            goto fail;
-        }
-        PUT(resp.txnid);
-        count--;
-        if (atomic_fetch_sub(&a->pending, 1) == a->max_pending) {
-            completion_signal(&a->signal);
+        zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        for (uint32_t i = 0; i < actual; i++) {
+            if (resp[i].status != ZX_OK) {
+                fprintf(stderr, "error: io txn failed %d (%zu remaining)\n",
+                        resp[i].status, count);
+                goto fail;
+            }
+            txnid_t txnid = resp[i].txnid;
+            hist_add(a->write[txnid] ? &a->write_hist : &a->read_hist,
+                     now - a->issued[txnid]);
+            PUT(txnid);
+            count--;
         }
+        mtx_lock(&a->lock);
+        a->pending -= actual;
+        cnd_broadcast(&a->cvar);
+        mtx_unlock(&a->lock);
     }
 
     zx_time_t t1 = zx_clock_get(ZX_CLOCK_MONOTONIC);
 
-    fprintf(stderr, "waiting for thread to exit...\n");
-    thrd_join(t, &r);
+    fprintf(stderr, "waiting for threads to exit...\n");
+    for (unsigned i = 0; i < a->threads; i++) {
+        thrd_join(t[i], &r);
+    }
 
     *_res = t1 - t0;
     *_total = a->count * a->xfer;
@@ -292,10 +444,30 @@ static zx_status_t bio_random(bio_random_args_t* a, uint64_t* _total, zx_time_t*
 
 fail:
     zx_handle_close(a->blk->fifo);
-    thrd_join(t, &r);
+    // Threads stuck waiting for room fail once the fifo is gone.
+    mtx_lock(&a->lock);
+    a->max_pending = a->pending + MAX_TXN_COUNT;
+    cnd_broadcast(&a->cvar);
+    mtx_unlock(&a->lock);
+    for (unsigned i = 0; i < started; i++) {
+        thrd_join(t[i], &r);
+    }
     return ZX_ERR_IO;
 }
 
+static void print_json(const char* dev, bio_random_args_t* a, uint64_t total, zx_time_t res) {
+    double s = ((double)res) / ((double)1000000000);
+    printf("{\"device\":\"%s\",\"xfer\":%zu,\"queue_depth\":%d,\"threads\":%u,"
+           "\"pattern\":\"%s\",\"write_pct\":%u,\"ops\":%zu,\"bytes\":%zu,\"time_ns\":%zu,"
+           "\"bytes_per_sec\":%g,\"ops_per_sec\":%g,",
+           dev, a->xfer, a->max_pending, a->threads, a->linear ? "linear" : "random",
+           a->write_pct, a->count, total, res, ((double)total) / s, ((double)a->count) / s);
+    hist_json(stdout, "read", &a->read_hist);
+    printf(",");
+    hist_json(stdout, "write", &a->write_hist);
+    printf("}\n");
+}
+
 void usage(void) {
     fprintf(stderr, "usage: biotime <option>* <device>\n"
                     "\n"
@@ -304,6 +476,10 @@ void usage(void) {
                     "       -mo <num>     maximum outstanding ops (1..128)\n"
                     "       -linear       transfers in linear order\n"
                     "       -random       random transfers across total range\n"
+                    "       -write <num>  percentage of ops which are writes (0..100)\n"
+                    "                     (destroys the contents of the device)\n"
+                    "       -threads <num> threads issuing ops (1..16)\n"
+                    "       -json         print results as JSON on stdout\n"
                     );
 }
 
@@ -317,20 +493,25 @@ void usage(void) {
 #define error(x...) do { fprintf(stderr, x); usage(); return -1; } while (0)
 
 int main(int argc, char** argv) {
-    blkdev_t blk;
+    static blkdev_t blk;
 
-    bio_random_args_t a = {
+    // Static, as the histograms are large.
+    static bio_random_args_t a = {
         .blk = &blk,
         .xfer = 32768,
         .seed = 7891263897612ULL,
         .max_pending = 128,
         .pending = 0,
         .linear = true,
+        .write_pct = 0,
+        .threads = 1,
     };
 
-    a.signal = COMPLETION_INIT;
+    mtx_init(&a.lock, mtx_plain);
+    cnd_init(&a.cvar);
 
     size_t total = 0;
+    bool json = false;
 
     nextarg();
     while (argc > 0) {
@@ -357,6 +538,22 @@ int main(int argc, char** argv) {
             a.linear = true;
         } else if (!strcmp(argv[0], "-random")) {
             a.linear = false;
+        } else if (!strcmp(argv[0], "-write")) {
+            needparam();
+            size_t n = number(argv[0]);
+            if (n > 100) {
+                error("error: write percentage must be between 0 and 100\n");
+            }
+            a.write_pct = n;
+        } else if (!strcmp(argv[0], "-threads")) {
+            needparam();
+            size_t n = number(argv[0]);
+            if ((n < 1) || (n > MAX_THREADS)) {
+                error("error: threads must be between 1 and %d\n", MAX_THREADS);
+            }
+            a.threads = n;
+        } else if (!strcmp(argv[0], "-json")) {
+            json = true;
         } else if (!strcmp(argv[0], "-h")) {
             usage();
             return 0;
@@ -373,11 +570,16 @@ int main(int argc, char** argv) {
     }
 
     int fd;
-    if ((fd = open(argv[0], O_RDONLY)) < 0) {
-        fprintf(stderr, "error: cannot open '%s'\n", argv[3]);
+    if ((fd = open(argv[0], a.write_pct > 0 ? O_RDWR : O_RDONLY)) < 0) {
+        fprintf(stderr, "error: cannot open '%s'\n", argv[0]);
+        return -1;
+    }
+    if (blkdev_open(fd, argv[0], 8*1024*1024, &blk) != ZX_OK) {
         return -1;
     }
-    if (blkdev_open(fd, argv[1], 8*1024*1024, &blk) != ZX_OK) {
+    if (a.xfer * a.threads > blk.bufsz) {
+        fprintf(stderr, "error: transfers of %zu bytes from %u threads do not fit "
+                "in the %zu byte buffer\n", a.xfer, a.threads, blk.bufsz);
         return -1;
     }
 
@@ -399,5 +601,10 @@ int main(int argc, char** argv) {
     bytes_per_second(total, res);
     fprintf(stderr, "%zu ops in %zu ns: ", a.count, res);
     ops_per_second(a.count, res);
+    hist_print("read", &a.read_hist);
+    hist_print("write", &a.write_hist);
+    if (json) {
+        print_json(argv[0], &a, total, res);
+    }
     return 0;
 }
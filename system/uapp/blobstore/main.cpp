@@ -31,6 +31,7 @@ namespace {
 
 typedef struct {
     bool readonly = false;
+    bool compress = false;
     uint64_t data_blocks = blobstore::kStartBlockMinimum; // Account for reserved blocks
     fbl::Vector<fbl::String> blob_list;
 } blob_options_t;
@@ -49,7 +50,7 @@ int do_blobstore_mount(fbl::unique_fd fd, const blob_options_t& options) {
     }
 
     fbl::RefPtr<blobstore::VnodeBlob> vn;
-    if (blobstore::blobstore_mount(&vn, fbl::move(fd)) < 0) {
+    if (blobstore::blobstore_mount(&vn, fbl::move(fd), options.compress) < 0) {
         return -1;
     }
     zx_handle_t h = zx_get_startup_handle(PA_HND(PA_USER0, 0));
@@ -110,6 +111,7 @@ int usage() {
             "usage: blobstore [ <options>* ] <command> [ <arg>* ]\n"
             "\n"
             "options: --readonly  Mount filesystem read-only\n"
+            "         --compress  Store newly written blobs compressed\n"
             "\n"
             "On Fuchsia, blobstore takes the block device argument by handle.\n"
             "This can make 'blobstore' commands hard to invoke from command line.\n"
@@ -137,6 +139,8 @@ int process_args(int argc, char** argv, CommandFunction* func, blob_options_t* o
     while (argc > 1) {
         if (!strcmp(argv[0], "--readonly")) {
             options->readonly = true;
+        } else if (!strcmp(argv[0], "--compress")) {
+            options->compress = true;
         } else {
             break;
         }
@@ -21,11 +21,14 @@ MODULE_STATIC_LIBS := \
     system/ulib/async \
     system/ulib/async.loop-cpp \
     system/ulib/async.loop \
+    system/ulib/block-client.cpp \
     system/ulib/block-client \
     system/ulib/digest \
+    system/ulib/region-alloc \
     system/ulib/trace-provider \
     system/ulib/trace \
     third_party/ulib/uboringssl \
+    third_party/ulib/lz4 \
     system/ulib/zx \
     system/ulib/zxcpp \
     system/ulib/fbl \
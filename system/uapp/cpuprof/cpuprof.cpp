@@ -0,0 +1,318 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Samples the call chains of whatever is running on each cpu, using the
+// performance monitor's cycle counter, and prints them as "folded" stacks:
+// one line per distinct stack, with its frames from the outermost inwards
+// separated by ';', followed by the number of samples. This is the input
+// format of the usual flame graph tools.
+//
+// Frames in user code are printed as "module+offset", and frames in the
+// kernel as plain addresses; both can be turned into source locations with
+// scripts/symbolize.
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/vector.h>
+#include <inspector/inspector.h>
+#include <task-utils/get.h>
+#include <zircon/device/cpu-trace/cpu-perf.h>
+#include <zircon/process.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+namespace {
+
+constexpr char kDevicePath[] = "/dev/misc/cpu-trace";
+
+#ifdef __x86_64__
+enum : cpuperf_event_id_t {
+#define DEF_FIXED_EVENT(symbol, id, regnum, flags, name, description) \
+    symbol ## _ID = CPUPERF_MAKE_EVENT_ID(CPUPERF_UNIT_FIXED, id),
+#include <zircon/device/cpu-trace/intel-pm-events.inc>
+};
+#endif
+
+struct Sample {
+    zx_koid_t pid;
+    uint32_t num_frames;
+    uint64_t frames[CPUPERF_MAX_CALLCHAIN_FRAMES];
+};
+
+// The dsos of a process we've seen samples for, looked up once.
+struct Process {
+    zx_koid_t koid;
+    char name[ZX_MAX_NAME_LEN];
+    inspector_dsoinfo_t* dso_list;
+};
+
+int SampleCompare(const void* pa, const void* pb) {
+    auto a = static_cast<const Sample*>(pa);
+    auto b = static_cast<const Sample*>(pb);
+    if (a->pid != b->pid)
+        return a->pid < b->pid ? -1 : 1;
+    if (a->num_frames != b->num_frames)
+        return a->num_frames < b->num_frames ? -1 : 1;
+    return memcmp(a->frames, b->frames, a->num_frames * sizeof(a->frames[0]));
+}
+
+bool SampleEqual(const Sample& a, const Sample& b) {
+    return a.pid == b.pid && a.num_frames == b.num_frames &&
+           memcmp(a.frames, b.frames, a.num_frames * sizeof(a.frames[0])) == 0;
+}
+
+// Reads the call chain records in the buffer of |cpu| into |samples|.
+zx_status_t ReadBuffer(int fd, uint32_t cpu, zx_koid_t pid_filter,
+                       fbl::Vector<Sample>* samples) {
+    ioctl_cpuperf_buffer_handle_req_t req = {cpu};
+    zx_handle_t vmo;
+    ssize_t rc = ioctl_cpuperf_get_buffer_handle(fd, &req, &vmo);
+    if (rc < 0)
+        return static_cast<zx_status_t>(rc);
+
+    uint64_t size;
+    zx_status_t status = zx_vmo_get_size(vmo, &size);
+    uintptr_t addr = 0;
+    if (status == ZX_OK) {
+        status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size,
+                             ZX_VM_FLAG_PERM_READ, &addr);
+    }
+    zx_handle_close(vmo);
+    if (status != ZX_OK)
+        return status;
+
+    auto buf = reinterpret_cast<const uint8_t*>(addr);
+    auto header = reinterpret_cast<const cpuperf_buffer_header_t*>(buf);
+    if (header->flags & CPUPERF_BUFFER_FLAG_FULL)
+        fprintf(stderr, "cpuprof: cpu %u: buffer filled, samples were dropped\n", cpu);
+    uint64_t end = fbl::min(header->capture_end, size);
+
+    uint64_t offset = sizeof(*header);
+    while (offset + sizeof(cpuperf_record_header_t) <= end) {
+        auto rec = reinterpret_cast<const cpuperf_record_header_t*>(buf + offset);
+        size_t rec_size;
+        switch (rec->type) {
+        case CPUPERF_RECORD_TIME:
+            rec_size = sizeof(cpuperf_time_record_t);
+            break;
+        case CPUPERF_RECORD_TICK:
+            rec_size = sizeof(cpuperf_tick_record_t);
+            break;
+        case CPUPERF_RECORD_COUNT:
+            rec_size = sizeof(cpuperf_count_record_t);
+            break;
+        case CPUPERF_RECORD_VALUE:
+            rec_size = sizeof(cpuperf_value_record_t);
+            break;
+        case CPUPERF_RECORD_PC:
+            rec_size = sizeof(cpuperf_pc_record_t);
+            break;
+        case CPUPERF_RECORD_CALLCHAIN: {
+            auto chain = reinterpret_cast<const cpuperf_callchain_record_t*>(rec);
+            uint32_t num_frames = fbl::min<uint32_t>(chain->num_frames,
+                                                     CPUPERF_MAX_CALLCHAIN_FRAMES);
+            rec_size = CPUPERF_CALLCHAIN_RECORD_SIZE(num_frames);
+            if (offset + rec_size > end)
+                break;
+            if (pid_filter != ZX_KOID_INVALID && chain->pid != pid_filter)
+                break;
+            Sample sample;
+            sample.pid = chain->pid;
+            sample.num_frames = num_frames;
+            memcpy(sample.frames, chain->frames, num_frames * sizeof(sample.frames[0]));
+            samples->push_back(sample);
+            break;
+        }
+        default:
+            fprintf(stderr, "cpuprof: cpu %u: unknown record type %u at offset %" PRIu64 "\n",
+                    cpu, rec->type, offset);
+            offset = end;
+            continue;
+        }
+        offset += rec_size;
+    }
+
+    zx_vmar_unmap(zx_vmar_root_self(), addr, size);
+    return ZX_OK;
+}
+
+Process* GetProcess(fbl::Vector<Process>* processes, zx_koid_t koid) {
+    for (auto& process : *processes) {
+        if (process.koid == koid)
+            return &process;
+    }
+
+    Process process = {};
+    process.koid = koid;
+    zx_obj_type_t type;
+    zx_handle_t handle;
+    if (get_task_by_koid(koid, &type, &handle) == ZX_OK) {
+        if (type == ZX_OBJ_TYPE_PROCESS) {
+            zx_object_get_property(handle, ZX_PROP_NAME, process.name, sizeof(process.name));
+            process.dso_list = inspector_dso_fetch_list(handle);
+        }
+        zx_handle_close(handle);
+    }
+    // The process may have exited since it was sampled.
+    if (process.name[0] == '\0')
+        snprintf(process.name, sizeof(process.name), "pid %" PRIu64, koid);
+    processes->push_back(process);
+    return &processes->get()[processes->size() - 1];
+}
+
+void PrintFrame(const Process* process, uint64_t pc) {
+    inspector_dsoinfo_t* dso = nullptr;
+    if (process != nullptr && process->dso_list != nullptr)
+        dso = inspector_dso_lookup(process->dso_list, pc);
+    if (dso != nullptr) {
+        printf(";%s+0x%" PRIx64, inspector_dso_name(dso), pc - inspector_dso_base(dso));
+    } else {
+        printf(";0x%" PRIx64, pc);
+    }
+}
+
+void PrintFoldedStacks(fbl::Vector<Sample>* samples) {
+    fbl::Vector<Process> processes;
+    Sample* begin = samples->get();
+    Sample* end = begin + samples->size();
+    qsort(begin, samples->size(), sizeof(Sample), SampleCompare);
+
+    for (Sample* s = begin; s != end;) {
+        Sample* next = s + 1;
+        while (next != end && SampleEqual(*s, *next))
+            ++next;
+
+        Process* process = nullptr;
+        if (s->pid == ZX_KOID_INVALID) {
+            printf("kernel");
+        } else {
+            process = GetProcess(&processes, s->pid);
+            printf("%s", process->name);
+        }
+        for (uint32_t i = s->num_frames; i > 0; --i)
+            PrintFrame(process, s->frames[i - 1]);
+        printf(" %zu\n", static_cast<size_t>(next - s));
+        s = next;
+    }
+
+    for (auto& process : processes) {
+        if (process.dso_list != nullptr)
+            inspector_dso_free_list(process.dso_list);
+    }
+}
+
+void Usage(void) {
+    fprintf(stderr,
+            "usage: cpuprof [options]\n"
+            "Samples call chains on every cpu and prints them as folded stacks.\n"
+            "Code must be built with frame pointers for its callers to be found.\n"
+            "Options:\n"
+            " -d <seconds>  sample for this long (default 5)\n"
+            " -r <cycles>   take a sample every this many cycles (default 1000000)\n"
+            " -b <kbytes>   size of each cpu's buffer (default 4096)\n"
+            " -p <pid>      only print samples from this process\n"
+            " -k            sample the kernel as well as user code\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned duration = 5;
+    uint32_t rate = 1000000;
+    uint32_t buffer_kb = 4096;
+    zx_koid_t pid_filter = ZX_KOID_INVALID;
+    bool kernel = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:r:b:p:kh")) != -1) {
+        switch (opt) {
+        case 'd':
+            duration = static_cast<unsigned>(atoi(optarg));
+            break;
+        case 'r':
+            rate = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'b':
+            buffer_kb = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+            break;
+        case 'p':
+            pid_filter = strtoull(optarg, nullptr, 0);
+            break;
+        case 'k':
+            kernel = true;
+            break;
+        default:
+            Usage();
+            return 1;
+        }
+    }
+    if (rate == 0 || buffer_kb == 0) {
+        Usage();
+        return 1;
+    }
+
+#ifndef __x86_64__
+    fprintf(stderr, "cpuprof: not supported on this architecture\n");
+    return 1;
+#else
+    int fd = open(kDevicePath, O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "cpuprof: cannot open %s\n", kDevicePath);
+        return 1;
+    }
+
+    cpuperf_properties_t props;
+    ssize_t rc = ioctl_cpuperf_get_properties(fd, &props);
+    if (rc < 0 || props.api_version != CPUPERF_API_VERSION) {
+        fprintf(stderr, "cpuprof: performance monitor not supported\n");
+        return 1;
+    }
+
+    uint32_t num_cpus = zx_system_get_num_cpus();
+    ioctl_cpuperf_alloc_t alloc = {num_cpus, buffer_kb * 1024};
+    if ((rc = ioctl_cpuperf_alloc_trace(fd, &alloc)) < 0) {
+        fprintf(stderr, "cpuprof: allocating buffers failed: %s\n",
+                zx_status_get_string(static_cast<zx_status_t>(rc)));
+        return 1;
+    }
+
+    cpuperf_config_t config = {};
+    config.events[0] = FIXED_UNHALTED_CORE_CYCLES_ID;
+    config.rate[0] = rate;
+    config.flags[0] = CPUPERF_CONFIG_FLAG_USER | CPUPERF_CONFIG_FLAG_CALLCHAIN;
+    if (kernel)
+        config.flags[0] |= CPUPERF_CONFIG_FLAG_OS;
+    if ((rc = ioctl_cpuperf_stage_config(fd, &config)) < 0 ||
+        (rc = ioctl_cpuperf_start(fd)) < 0) {
+        fprintf(stderr, "cpuprof: starting the performance monitor failed: %s\n",
+                zx_status_get_string(static_cast<zx_status_t>(rc)));
+        ioctl_cpuperf_free_trace(fd);
+        return 1;
+    }
+
+    zx_nanosleep(zx_deadline_after(ZX_SEC(duration)));
+    ioctl_cpuperf_stop(fd);
+
+    fbl::Vector<Sample> samples;
+    for (uint32_t cpu = 0; cpu < num_cpus; ++cpu) {
+        zx_status_t status = ReadBuffer(fd, cpu, pid_filter, &samples);
+        if (status != ZX_OK) {
+            fprintf(stderr, "cpuprof: reading the buffer of cpu %u failed: %s\n",
+                    cpu, zx_status_get_string(status));
+        }
+    }
+    ioctl_cpuperf_free_trace(fd);
+    close(fd);
+
+    PrintFoldedStacks(&samples);
+    return 0;
+#endif
+}
@@ -0,0 +1,30 @@
+# Copyright 2018 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := userapp
+MODULE_GROUP := misc
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/cpuprof.cpp
+
+MODULE_NAME := cpuprof
+
+MODULE_LIBS := \
+    third_party/ulib/backtrace \
+    third_party/ulib/ngunwind \
+    system/ulib/fdio \
+    system/ulib/zircon \
+    system/ulib/c
+
+MODULE_STATIC_LIBS := \
+    system/ulib/inspector \
+    system/ulib/task-utils \
+    system/ulib/fbl \
+    system/ulib/zxcpp
+
+include make/module.mk
@@ -0,0 +1,115 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <crypto/aead.h>
+#include <crypto/bytes.h>
+#include <crypto/cipher.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+// Total bytes transformed by each measured run.
+static constexpr size_t kBufferLen = 1 << 20;
+static constexpr unsigned kWarmUpIterations = 4;
+static constexpr unsigned kRunIterations = 64;
+
+// Sector sizes to measure random access and AEAD throughput over.
+static constexpr size_t kSectorLens[] = {512, 4096, 65536};
+
+// Runs |closure|, which transforms |kBufferLen| bytes, repeatedly and prints the throughput.
+template <typename T>
+void Run(const char* name, size_t sector_len, const T& closure) {
+    for (unsigned i = 0; i < kWarmUpIterations; i++) {
+        ZX_ASSERT(closure() == ZX_OK);
+    }
+    uint64_t start = zx_ticks_get();
+    for (unsigned i = 0; i < kRunIterations; i++) {
+        ZX_ASSERT(closure() == ZX_OK);
+    }
+    uint64_t stop = zx_ticks_get();
+    double secs = static_cast<double>(stop - start) / static_cast<double>(zx_ticks_per_second());
+    double bytes = static_cast<double>(kBufferLen) * kRunIterations;
+    printf("  %-32s %6zu bytes/unit: %7.3f GB/s\n", name, sector_len, bytes / secs / 1e9);
+}
+
+void RunCipherBenchmarks(crypto::Cipher::Algorithm algo, const char* name, uint8_t* buf) {
+    size_t key_len, iv_len;
+    crypto::Bytes key, iv;
+    ZX_ASSERT(crypto::Cipher::GetKeyLen(algo, &key_len) == ZX_OK &&
+              crypto::Cipher::GetIVLen(algo, &iv_len) == ZX_OK &&
+              key.InitRandom(key_len) == ZX_OK && iv.InitRandom(iv_len) == ZX_OK);
+    printf("* %s\n", name);
+
+    crypto::Cipher cipher;
+    ZX_ASSERT(cipher.InitEncrypt(algo, key, iv) == ZX_OK);
+    Run("stream encrypt", kBufferLen, [&] { return cipher.Encrypt(buf, kBufferLen, buf); });
+
+    for (size_t sector_len : kSectorLens) {
+        ZX_ASSERT(cipher.InitEncrypt(algo, key, iv, sector_len) == ZX_OK);
+        Run("random access encrypt", sector_len,
+            [&] { return cipher.Encrypt(buf, 0, kBufferLen, buf); });
+        ZX_ASSERT(cipher.InitDecrypt(algo, key, iv, sector_len) == ZX_OK);
+        Run("random access decrypt", sector_len,
+            [&] { return cipher.Decrypt(buf, 0, kBufferLen, buf); });
+
+        // Scatter the sectors across the device, as a block driver would see them.
+        size_t num = kBufferLen / sector_len;
+        fbl::unique_ptr<crypto::Cipher::Sector[]> sectors(new crypto::Cipher::Sector[num]);
+        for (size_t i = 0; i < num; i++) {
+            sectors[i].in = buf + i * sector_len;
+            sectors[i].offset = ((i * 7919) % num) * sector_len * 3;
+            sectors[i].length = sector_len;
+            sectors[i].out = buf + i * sector_len;
+        }
+        ZX_ASSERT(cipher.InitEncrypt(algo, key, iv, sector_len) == ZX_OK);
+        Run("batch encrypt", sector_len, [&] { return cipher.EncryptBatch(sectors.get(), num); });
+    }
+}
+
+void RunAEADBenchmarks(crypto::AEAD::Algorithm algo, const char* name) {
+    size_t key_len, iv_len;
+    crypto::Bytes key, iv;
+    ZX_ASSERT(crypto::AEAD::GetKeyLen(algo, &key_len) == ZX_OK &&
+              crypto::AEAD::GetIVLen(algo, &iv_len) == ZX_OK &&
+              key.InitRandom(key_len) == ZX_OK && iv.InitRandom(iv_len) == ZX_OK);
+    printf("* %s\n", name);
+
+    for (size_t sector_len : kSectorLens) {
+        crypto::AEAD seal, open;
+        ZX_ASSERT(seal.InitSeal(algo, key, iv) == ZX_OK && open.InitOpen(algo, key) == ZX_OK);
+        crypto::Bytes ptext, ctext, result, unit_iv;
+        ZX_ASSERT(ptext.InitRandom(sector_len) == ZX_OK);
+        size_t num = kBufferLen / sector_len;
+        Run("seal", sector_len, [&] {
+            zx_status_t rc = ZX_OK;
+            for (size_t i = 0; i < num && rc == ZX_OK; i++) {
+                rc = seal.Seal(ptext, &unit_iv, &ctext);
+            }
+            return rc;
+        });
+        Run("open", sector_len, [&] {
+            zx_status_t rc = ZX_OK;
+            for (size_t i = 0; i < num && rc == ZX_OK; i++) {
+                rc = open.Open(unit_iv, ctext, &result);
+            }
+            return rc;
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    fbl::unique_ptr<uint8_t[]> buf(new uint8_t[kBufferLen]());
+
+    RunCipherBenchmarks(crypto::Cipher::kAES256_XTS, "AES256-XTS", buf.get());
+    RunAEADBenchmarks(crypto::AEAD::kAES128_GCM, "AES128-GCM");
+    RunAEADBenchmarks(crypto::AEAD::kAES128_GCM_SIV, "AES128-GCM-SIV");
+    return 0;
+}
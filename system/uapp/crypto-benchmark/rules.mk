@@ -0,0 +1,27 @@
+# Copyright 2018 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := userapp
+MODULE_GROUP := misc
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/main.cpp
+
+MODULE_NAME := crypto-benchmark
+
+MODULE_STATIC_LIBS := \
+    system/ulib/zxcpp \
+    system/ulib/fbl
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/crypto \
+    system/ulib/fdio \
+    system/ulib/zircon
+
+include make/module.mk
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <block-client/client.h>
@@ -16,6 +17,8 @@
 #include <fbl/algorithm.h>
 #include <fbl/array.h>
 #include <fbl/auto_call.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
 #include <fdio/watcher.h>
@@ -109,12 +112,359 @@ zx_status_t register_fast_block_io(const fbl::unique_fd& fd, zx_handle_t vmo,
     return ZX_OK;
 }
 
+// Writes a chunk of an image to disk on a thread of its own, so that the next
+// chunk can be read in from the network meanwhile. Only one write is ever in
+// flight.
+class PendingWrite {
+public:
+    explicit PendingWrite(fifo_client_t* client) : client_(client) {}
+    ~PendingWrite() { Wait(); }
+
+    // Begins writing |request|; there must be no write pending.
+    zx_status_t Start(const block_fifo_request_t& request) {
+        ZX_DEBUG_ASSERT(!pending_);
+        request_ = request;
+        if (thrd_create(&thread_, &PendingWrite::Run, this) != thrd_success) {
+            return ZX_ERR_NO_RESOURCES;
+        }
+        pending_ = true;
+        return ZX_OK;
+    }
+
+    // Waits for the pending write, if any, returning how it went.
+    zx_status_t Wait() {
+        if (!pending_) {
+            return ZX_OK;
+        }
+        int result;
+        thrd_join(thread_, &result);
+        pending_ = false;
+        return static_cast<zx_status_t>(result);
+    }
+
+private:
+    static int Run(void* arg) {
+        PendingWrite* write = static_cast<PendingWrite*>(arg);
+        return static_cast<int>(block_fifo_txn(write->client_, &write->request_, 1));
+    }
+
+    fifo_client_t* const client_;
+    block_fifo_request_t request_;
+    thrd_t thread_;
+    bool pending_ = false;
+};
+
+// Streams partitions of an image compressed as independent frames (see
+// fvm-sparse.h) to disk.
+//
+// Frames are read in on the calling thread and handed to a pool of workers.
+// Each decompresses a frame into a piece of the VMO of its own and writes it
+// out on a txnid of its own, so frames decompress in parallel with several
+// writes in flight. Frames of zeroes, and the zeroes trailing each extent,
+// are written from a piece of the VMO which is never touched, without any
+// decompressing or copying.
+class FrameStreamer {
+public:
+    static zx_status_t Create(fvm::SparseReader* reader, size_t slice_size, size_t block_size,
+                              fbl::unique_ptr<FrameStreamer>* out) {
+        if (fvm::kSparseFrameLength % block_size != 0) {
+            ERROR("Block size %zu does not divide frames\n", block_size);
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<FrameStreamer> streamer(new (&ac) FrameStreamer(reader, slice_size,
+                                                                        block_size));
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < kFrames; i++) {
+            streamer->frames_[i].data.reset(
+                new (&ac) uint8_t[fvm::SparseReader::MaxCompressedFrameLength()]);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+            streamer->free_[i] = &streamer->frames_[i];
+        }
+        streamer->free_count_ = kFrames;
+
+        zx_status_t status;
+        if ((status = MappedVmo::Create((kWorkers + 1) * fvm::kSparseFrameLength,
+                                        "fvm-frames", &streamer->mvmo_)) != ZX_OK) {
+            ERROR("Failed to create stream VMO\n");
+            return status;
+        }
+
+        *out = fbl::move(streamer);
+        return ZX_OK;
+    }
+
+    ~FrameStreamer() {
+        cnd_destroy(&reader_cvar_);
+        cnd_destroy(&worker_cvar_);
+    }
+
+    // Writes out the extents of |part|, whose frames are next in the image.
+    zx_status_t Stream(partition_info* part) {
+        fifo_client_t* client;
+        vmoid_t vmoid;
+        txnid_t txnids[kWorkers];
+        zx_status_t status = register_fast_block_io(part->new_part, mvmo_->GetVmo(),
+                                                    &txnids[0], &vmoid, &client);
+        if (status != ZX_OK) {
+            ERROR("Failed to register fast block IO\n");
+            return status;
+        }
+        size_t txn_count = 1;
+        auto cleanup = fbl::MakeAutoCall([&]() {
+            for (size_t i = 1; i < txn_count; i++) {
+                ioctl_block_free_txn(part->new_part.get(), &txnids[i]);
+            }
+            block_fifo_release_client(client);
+        });
+        for (; txn_count < kWorkers; txn_count++) {
+            if (ioctl_block_alloc_txn(part->new_part.get(), &txnids[txn_count]) < 0) {
+                ERROR("Couldn't allocate transaction\n");
+                return ZX_ERR_IO;
+            }
+        }
+
+        {
+            fbl::AutoLock lock(&lock_);
+            client_ = client;
+            vmoid_ = vmoid;
+            status_ = ZX_OK;
+            done_ = false;
+        }
+        Worker workers[kWorkers];
+        size_t started = 0;
+        for (; started < kWorkers; started++) {
+            workers[started].streamer = this;
+            workers[started].txnid = txnids[started];
+            workers[started].slot = started;
+            if (thrd_create(&workers[started].thread, &FrameStreamer::WorkerThread,
+                            &workers[started]) != thrd_success) {
+                SetStatus(ZX_ERR_NO_RESOURCES);
+                break;
+            }
+        }
+
+        status = StreamExtents(part);
+
+        {
+            fbl::AutoLock lock(&lock_);
+            done_ = true;
+            cnd_broadcast(&worker_cvar_);
+        }
+        for (size_t i = 0; i < started; i++) {
+            thrd_join(workers[i].thread, nullptr);
+        }
+
+        fbl::AutoLock lock(&lock_);
+        return (status_ != ZX_OK) ? status_ : status;
+    }
+
+private:
+    static constexpr size_t kWorkers = 4;
+    // Enough frames to keep every worker busy, with as many again read ahead.
+    static constexpr size_t kFrames = 2 * kWorkers;
+
+    struct Frame {
+        fvm::frame_descriptor_t desc;
+        uint64_t dev_offset; // Unit: blocks
+        fbl::unique_ptr<uint8_t[]> data;
+    };
+
+    struct Worker {
+        FrameStreamer* streamer;
+        txnid_t txnid;
+        size_t slot;
+        thrd_t thread;
+    };
+
+    FrameStreamer(fvm::SparseReader* reader, size_t slice_size, size_t block_size)
+        : reader_(reader), slice_size_(slice_size), block_size_(block_size) {
+        cnd_init(&reader_cvar_);
+        cnd_init(&worker_cvar_);
+    }
+
+    zx_status_t StreamExtents(partition_info* part) {
+        for (size_t e = 0; e < part->pd->extent_count; e++) {
+            LOG("Writing extent %zu... \n", e);
+            fvm::extent_descriptor_t* ext = get_extent(part->pd, e);
+            size_t offset = ext->slice_start * slice_size_;
+            size_t bytes_left = ext->extent_length;
+
+            while (bytes_left > 0) {
+                Frame* frame = GetFree();
+                if (frame == nullptr) {
+                    return ZX_ERR_IO;
+                }
+                zx_status_t status = reader_->ReadFrame(&frame->desc, frame->data.get());
+                if (status != ZX_OK) {
+                    ERROR("Error reading partition data\n");
+                    PutFree(frame);
+                    return status;
+                } else if (frame->desc.length == 0 || frame->desc.length > bytes_left) {
+                    ERROR("Frame does not fit the extent\n");
+                    PutFree(frame);
+                    return ZX_ERR_IO;
+                } else if (frame->desc.length % block_size_ != 0) {
+                    ERROR("Cannot write non-block size multiple: %u\n", frame->desc.length);
+                    PutFree(frame);
+                    return ZX_ERR_IO;
+                }
+                frame->dev_offset = offset / block_size_;
+                offset += frame->desc.length;
+                bytes_left -= frame->desc.length;
+                PutReady(frame);
+            }
+
+            // Write trailing zeroes (which are implied, but were omitted from
+            // transfer).
+            bytes_left = (ext->slice_count * slice_size_) - ext->extent_length;
+            if (bytes_left > 0) {
+                LOG("%zu bytes written, %zu zeroes left\n", ext->extent_length, bytes_left);
+            }
+            while (bytes_left > 0) {
+                Frame* frame = GetFree();
+                if (frame == nullptr) {
+                    return ZX_ERR_IO;
+                }
+                frame->desc.length = static_cast<uint32_t>(fbl::min(bytes_left,
+                                                                    fvm::kSparseFrameLength));
+                frame->desc.compressed_length = 0;
+                frame->dev_offset = offset / block_size_;
+                offset += frame->desc.length;
+                bytes_left -= frame->desc.length;
+                PutReady(frame);
+            }
+        }
+        return ZX_OK;
+    }
+
+    // Waits for a frame to read into, returning null if a worker has failed.
+    Frame* GetFree() {
+        fbl::AutoLock lock(&lock_);
+        while (free_count_ == 0 && status_ == ZX_OK) {
+            cnd_wait(&reader_cvar_, lock_.GetInternal());
+        }
+        if (status_ != ZX_OK) {
+            return nullptr;
+        }
+        return free_[--free_count_];
+    }
+
+    void PutFree(Frame* frame) {
+        fbl::AutoLock lock(&lock_);
+        free_[free_count_++] = frame;
+        cnd_signal(&reader_cvar_);
+    }
+
+    void PutReady(Frame* frame) {
+        fbl::AutoLock lock(&lock_);
+        ready_[(ready_start_ + ready_count_++) % kFrames] = frame;
+        cnd_signal(&worker_cvar_);
+    }
+
+    // Waits for a frame to work on, returning null once there are no more.
+    Frame* GetReady() {
+        fbl::AutoLock lock(&lock_);
+        while (ready_count_ == 0 && !done_ && status_ == ZX_OK) {
+            cnd_wait(&worker_cvar_, lock_.GetInternal());
+        }
+        if (ready_count_ == 0 || status_ != ZX_OK) {
+            return nullptr;
+        }
+        Frame* frame = ready_[ready_start_];
+        ready_start_ = (ready_start_ + 1) % kFrames;
+        ready_count_--;
+        return frame;
+    }
+
+    void SetStatus(zx_status_t status) {
+        fbl::AutoLock lock(&lock_);
+        if (status_ == ZX_OK) {
+            status_ = status;
+        }
+        cnd_broadcast(&reader_cvar_);
+        cnd_broadcast(&worker_cvar_);
+    }
+
+    static int WorkerThread(void* arg) {
+        Worker* worker = static_cast<Worker*>(arg);
+        worker->streamer->Work(worker);
+        return 0;
+    }
+
+    void Work(Worker* worker) {
+        const size_t zero_slot = kWorkers;
+        uint8_t* out = static_cast<uint8_t*>(mvmo_->GetData()) +
+                       worker->slot * fvm::kSparseFrameLength;
+
+        Frame* frame;
+        while ((frame = GetReady()) != nullptr) {
+            size_t slot = zero_slot;
+            zx_status_t status = ZX_OK;
+            if (frame->desc.compressed_length != 0) {
+                slot = worker->slot;
+                status = fvm::SparseReader::DecompressFrame(frame->desc, frame->data.get(), out);
+            }
+
+            block_fifo_request_t request;
+            request.txnid = worker->txnid;
+            request.vmoid = vmoid_;
+            request.opcode = BLOCKIO_WRITE;
+            request.length = frame->desc.length / block_size_;
+            request.vmo_offset = (slot * fvm::kSparseFrameLength) / block_size_;
+            request.dev_offset = frame->dev_offset;
+            // The compressed data is no longer needed, so let the reader have the frame back
+            PutFree(frame);
+
+            if (status != ZX_OK) {
+                ERROR("Error decompressing partition data\n");
+                SetStatus(status);
+            } else if ((status = block_fifo_txn(client_, &request, 1)) != ZX_OK) {
+                ERROR("Error writing partition data\n");
+                SetStatus(status);
+            }
+        }
+    }
+
+    fvm::SparseReader* const reader_;
+    const size_t slice_size_;
+    const size_t block_size_;
+    fbl::unique_ptr<MappedVmo> mvmo_;
+    Frame frames_[kFrames];
+
+    // Set up for each partition before the workers start
+    fifo_client_t* client_ = nullptr;
+    vmoid_t vmoid_ = 0;
+
+    fbl::Mutex lock_;
+    cnd_t reader_cvar_;
+    cnd_t worker_cvar_;
+    Frame* free_[kFrames] __TA_GUARDED(lock_);
+    size_t free_count_ __TA_GUARDED(lock_) = 0;
+    Frame* ready_[kFrames] __TA_GUARDED(lock_);
+    size_t ready_start_ __TA_GUARDED(lock_) = 0;
+    size_t ready_count_ __TA_GUARDED(lock_) = 0;
+    bool done_ __TA_GUARDED(lock_) = false;
+    zx_status_t status_ __TA_GUARDED(lock_) = ZX_OK;
+};
+
 // Stream an FVM partition to disk.
+//
+// The VMO is used in halves, each read into while the other is written out.
 zx_status_t stream_fvm_partition(fvm::SparseReader* reader, partition_info* part,
                                  MappedVmo* mvmo, fifo_client_t* client, size_t block_size,
                                  block_fifo_request_t* request) {
     size_t slice_size = reader->Image()->slice_size;
     const size_t vmo_cap = mvmo->GetSize();
+    const size_t half_cap = vmo_cap / 2;
+    ZX_ASSERT(half_cap % block_size == 0);
+    PendingWrite pending(client);
+    size_t half = 0;
     for (size_t e = 0; e < part->pd->extent_count; e++) {
         LOG("Writing extent %zu... \n", e);
         fvm::extent_descriptor_t* ext = get_extent(part->pd, e);
@@ -126,8 +476,8 @@ zx_status_t stream_fvm_partition(fvm::SparseReader* reader, partition_info* part
             size_t vmo_sz = 0;
             size_t actual;
             zx_status_t status = reader->ReadData(
-                                    &reinterpret_cast<uint8_t*>(mvmo->GetData())[vmo_sz],
-                                    fbl::min(bytes_left, vmo_cap - vmo_sz), &actual);
+                                    &reinterpret_cast<uint8_t*>(mvmo->GetData())[half * half_cap],
+                                    fbl::min(bytes_left, half_cap), &actual);
             vmo_sz += actual;
             bytes_left -= actual;
 
@@ -142,17 +492,29 @@ zx_status_t stream_fvm_partition(fvm::SparseReader* reader, partition_info* part
                 return status;
             }
 
+            if ((status = pending.Wait()) != ZX_OK) {
+                ERROR("Error writing partition data\n");
+                return status;
+            }
+
             request->length = vmo_sz / block_size;
-            request->vmo_offset = 0;
+            request->vmo_offset = (half * half_cap) / block_size;
             request->dev_offset = offset / block_size;
 
-            ssize_t r;
-            if ((r = block_fifo_txn(client, request, 1)) != ZX_OK) {
+            if ((status = pending.Start(*request)) != ZX_OK) {
                 ERROR("Error writing partition data\n");
-                return static_cast<zx_status_t>(r);
+                return status;
             }
 
             offset += vmo_sz;
+            half ^= 1;
+        }
+
+        // The zeroes below overwrite both halves.
+        zx_status_t status;
+        if ((status = pending.Wait()) != ZX_OK) {
+            ERROR("Error writing partition data\n");
+            return status;
         }
 
         // Write trailing zeroes (which are implied, but were omitted from
@@ -167,7 +529,6 @@ zx_status_t stream_fvm_partition(fvm::SparseReader* reader, partition_info* part
             request->vmo_offset = 0;
             request->dev_offset = offset / block_size;
 
-            zx_status_t status;
             if ((status = block_fifo_txn(client, request, 1)) != ZX_OK) {
                 ERROR("Error writing trailing zeroes\n");
                 return status;
@@ -181,20 +542,25 @@ zx_status_t stream_fvm_partition(fvm::SparseReader* reader, partition_info* part
 }
 
 // Stream a raw (non-FVM) partition to disk.
+//
+// As with FVM partitions, halves of the VMO alternate between reading and
+// writing.
 zx_status_t stream_partition(MappedVmo* mvmo, fifo_client_t* client,
                              block_fifo_request_t* request, const fbl::unique_fd& src_fd,
                              const block_info_t& info) {
-    const size_t vmo_cap = mvmo->GetSize();
-    ZX_ASSERT(vmo_cap % info.block_size == 0);
+    const size_t half_cap = mvmo->GetSize() / 2;
+    ZX_ASSERT(half_cap % info.block_size == 0);
+    PendingWrite pending(client);
+    size_t half = 0;
     size_t offset = 0;
 
     while (true) {
+        uint8_t* data = &reinterpret_cast<uint8_t*>(mvmo->GetData())[half * half_cap];
         ssize_t r;
         size_t vmo_sz = 0;
-        while ((r = read(src_fd.get(), &reinterpret_cast<uint8_t*>(mvmo->GetData())[vmo_sz],
-                         vmo_cap - vmo_sz)) > 0) {
+        while ((r = read(src_fd.get(), &data[vmo_sz], half_cap - vmo_sz)) > 0) {
             vmo_sz += r;
-            if (vmo_cap - vmo_sz == 0) {
+            if (half_cap - vmo_sz == 0) {
                 // The buffer is full, let's write to disk.
                 break;
             }
@@ -203,6 +569,12 @@ zx_status_t stream_partition(MappedVmo* mvmo, fifo_client_t* client,
             ERROR("Error reading partition data\n");
             return static_cast<zx_status_t>(r);
         }
+
+        zx_status_t status;
+        if ((status = pending.Wait()) != ZX_OK) {
+            ERROR("Error writing partition data\n");
+            return status;
+        }
         if (vmo_sz == 0) {
             // Nothing left to write.
             return ZX_OK;
@@ -211,27 +583,29 @@ zx_status_t stream_partition(MappedVmo* mvmo, fifo_client_t* client,
         if ((r == 0) && (vmo_sz % info.block_size)) {
             // We have a partial block to write.
             size_t rounded_length = fbl::round_up(vmo_sz, info.block_size);
-            memset(&reinterpret_cast<uint8_t*>(mvmo->GetData())[vmo_sz], 0,
-                   rounded_length - vmo_sz);
+            memset(&data[vmo_sz], 0, rounded_length - vmo_sz);
             vmo_sz = rounded_length;
         }
 
         request->length = vmo_sz / info.block_size;
-        request->vmo_offset = 0;
+        request->vmo_offset = (half * half_cap) / info.block_size;
         request->dev_offset = offset / info.block_size;
 
-        zx_status_t status;
-        if ((status = block_fifo_txn(client, request, 1)) != ZX_OK) {
+        if ((status = pending.Start(*request)) != ZX_OK) {
             ERROR("Error writing partition data\n");
             return status;
         }
 
         if (r == 0) {
             // We have nothing left to read on the input pipe.
-            return ZX_OK;
+            if ((status = pending.Wait()) != ZX_OK) {
+                ERROR("Error writing partition data\n");
+            }
+            return status;
         }
 
         offset += vmo_sz;
+        half ^= 1;
     }
 }
 
@@ -325,6 +699,50 @@ zx_status_t fvm_init_sparse_reader(fbl::unique_fd src_fd,
     return ZX_OK;
 }
 
+// Streams partitions of an image which is either uncompressed or compressed
+// as a single frame, and so must be decompressed in order.
+zx_status_t stream_fvm_partitions_serial(fvm::SparseReader* reader, partition_info* parts,
+                                         size_t partition_count, size_t block_size) {
+    // Two halves of 1MB, written out in turn
+    const size_t vmo_sz = 2 << 20;
+
+    zx_status_t status;
+    fbl::unique_ptr<MappedVmo> mvmo;
+    if ((status = MappedVmo::Create(vmo_sz, "fvm-stream", &mvmo)) != ZX_OK) {
+        ERROR("Failed to create stream VMO\n");
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    for (size_t p = 0; p < partition_count; p++) {
+        txnid_t txnid;
+        vmoid_t vmoid;
+        fifo_client_t* client;
+        status = register_fast_block_io(parts[p].new_part, mvmo->GetVmo(), &txnid, &vmoid,
+                                        &client);
+        if (status != ZX_OK) {
+            ERROR("Failed to register fast block IO\n");
+            return status;
+        }
+
+        block_fifo_request_t request;
+        request.txnid = txnid;
+        request.vmoid = vmoid;
+        request.opcode = BLOCKIO_WRITE;
+
+        LOG("Streaming partition %zu\n", p);
+        status = stream_fvm_partition(reader, &parts[p], mvmo.get(), client, block_size,
+                                      &request);
+        LOG("Done streaming partition %zu\n", p);
+        block_fifo_release_client(client);
+        if (status != ZX_OK) {
+            ERROR("Failed to stream partition\n");
+            return status;
+        }
+    }
+
+    return ZX_OK;
+}
+
 // Given an fd representing a "sparse FVM format", fill the FVM with the
 // provided partitions described by |src_fd|.
 //
@@ -462,41 +880,26 @@ zx_status_t fvm_stream_partitions(fbl::unique_fd src_fd) {
 
     LOG("Partition space pre-allocated\n");
 
-    const size_t vmo_sz = 1 << 20;
-
-    fbl::unique_ptr<MappedVmo> mvmo;
-    if ((status = MappedVmo::Create(vmo_sz, "fvm-stream", &mvmo)) != ZX_OK) {
-        ERROR("Failed to create stream VMO\n");
-        return ZX_ERR_NO_MEMORY;
-    }
-
     // Now that all partitions are preallocated, begin streaming data to them.
-    for (size_t p = 0; p < hdr->partition_count; p++) {
-        txnid_t txnid;
-        vmoid_t vmoid;
-        fifo_client_t* client;
-        zx_status_t status = register_fast_block_io(parts[p].new_part,
-                                                    mvmo->GetVmo(), &txnid,
-                                                    &vmoid, &client);
-        if (status != ZX_OK) {
-            ERROR("Failed to register fast block IO\n");
+    if (reader->IsFramed()) {
+        fbl::unique_ptr<FrameStreamer> streamer;
+        if ((status = FrameStreamer::Create(reader.get(), hdr->slice_size, block_size,
+                                            &streamer)) != ZX_OK) {
             return status;
         }
-
-        block_fifo_request_t request;
-        request.txnid = txnid;
-        request.vmoid = vmoid;
-        request.opcode = BLOCKIO_WRITE;
-
-        LOG("Streaming partition %zu\n", p);
-        status = stream_fvm_partition(reader.get(), &parts[p], mvmo.get(), client, block_size,
-                                      &request);
-        LOG("Done streaming partition %zu\n", p);
-        block_fifo_release_client(client);
-        if (status != ZX_OK) {
-            ERROR("Failed to stream partition\n");
-            return status;
+        for (size_t p = 0; p < hdr->partition_count; p++) {
+            LOG("Streaming partition %zu\n", p);
+            status = streamer->Stream(&parts[p]);
+            LOG("Done streaming partition %zu\n", p);
+            if (status != ZX_OK) {
+                ERROR("Failed to stream partition\n");
+                return status;
+            }
         }
+    } else if ((status = stream_fvm_partitions_serial(reader.get(), parts.get(),
+                                                      hdr->partition_count,
+                                                      block_size)) != ZX_OK) {
+        return status;
     }
 
     for (size_t p = 0; p < hdr->partition_count; p++) {
@@ -1058,7 +1461,8 @@ zx_status_t partition_pave(fbl::unique_fd fd) {
         return status;
     }
 
-    const size_t vmo_sz = fbl::round_up(1LU << 20, info.block_size);
+    // Two halves of about 1MB, written out in turn
+    const size_t vmo_sz = 2 * fbl::round_up(1LU << 20, info.block_size);
     fbl::unique_ptr<MappedVmo> mvmo;
     if ((status = MappedVmo::Create(vmo_sz, "partition-pave", &mvmo)) != ZX_OK) {
         ERROR("Failed to create stream VMO\n");
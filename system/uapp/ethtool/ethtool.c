@@ -11,6 +11,7 @@
 
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <netinet/if_ether.h>
 #include <netinet/tcp.h>
@@ -30,6 +31,7 @@ typedef struct {
     bool setting_promisc;
     bool promisc_on;
     bool dump_regs;
+    bool stats;
     char *filter_macs;
     int n_filter_macs;
 } ethtool_options_t;
@@ -43,6 +45,7 @@ int usage(void) {
     fprintf(stderr, "  promisc off    : Promiscuous mode off\n");
     fprintf(stderr, "  filter n.n.n.n.n.n n.n.n.n.n.n ...    : multicast filter these addresses\n");
     fprintf(stderr, "  dump           : Dump regs of chip\n");
+    fprintf(stderr, "  stats          : Show packet counts of each queue\n");
     fprintf(stderr, "    (empty list is valid)\n");
     fprintf(stderr, "  --help  : Show this help message\n");
     return -1;
@@ -110,6 +113,13 @@ int parse_args(int argc, const char** argv, ethtool_options_t* options) {
             return usage();
         }
         options->dump_regs = true;
+    } else if (!strcmp(argv[0], "stats")) {
+        argc--;
+        argv++;
+        if (argc != 0) {
+            return usage();
+        }
+        options->stats = true;
     } else if (!strcmp(argv[0], "filter")) {
         argc--;
         argv++;
@@ -221,6 +231,19 @@ int main(int argc, const char** argv) {
             fprintf(stderr, "ethtool: failed to request reg dump\n");
         }
     }
+    if (options.stats) {
+        eth_stats_t stats;
+        if ((r = ioctl_ethernet_get_stats(fd, &stats)) < 0) {
+            fprintf(stderr, "ethtool: failed to get stats: %zd\n", r);
+        } else {
+            printf("queue  rx-packets  rx-dropped  tx-packets  tx-dropped\n");
+            for (uint32_t i = 0; i < stats.queues; i++) {
+                eth_queue_stats_t* q = &stats.queue[i];
+                printf("%5u %11" PRIu64 " %11" PRIu64 " %11" PRIu64 " %11" PRIu64 "\n", i,
+                       q->rx_packets, q->rx_dropped, q->tx_packets, q->tx_dropped);
+            }
+        }
+    }
     zx_nanosleep(zx_deadline_after(ZX_SEC(options.pause_secs)));
     return 0;
 }
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
@@ -16,6 +17,66 @@
 
 #include <gfx/gfx.h>
 
+static void draw_frame(gfx_surface* gfx, int i) {
+    int d = gfx->height / 5;
+    gfx_fillrect(gfx, 0, 0, gfx->width, gfx->height, 0xffffffff);
+    gfx_fillrect(gfx, (gfx->width - d) / 2, (gfx->height - d) / 2, d, d, i % 2 ? 0xff55ff55 : 0xffaa00aa);
+}
+
+// Draws each frame into the buffer which isn't on the screen, and flips to it.
+// Returns false if the display can't scan out buffers of ours.
+static bool run_flips(int vfd, const zx_display_info_t* info, size_t size) {
+    zx_handle_t event;
+    if (ioctl_display_get_flip_event(vfd, &event) != sizeof(event)) {
+        return false;
+    }
+
+    gfx_surface* gfx[2];
+    uint32_t ids[2];
+    uintptr_t addrs[2];
+    for (int b = 0; b < 2; b++) {
+        zx_handle_t vmo;
+        zx_status_t status = zx_vmo_create(size, 0, &vmo);
+        if (status == ZX_OK) {
+            status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size,
+                                 ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addrs[b]);
+        }
+        if (status != ZX_OK) {
+            printf("failed to create buffer (%d)\n", status);
+            exit(-1);
+        }
+        // The import takes the handle.
+        if (ioctl_display_import_vmo(vfd, &vmo, &ids[b]) != sizeof(ids[b])) {
+            return false;
+        }
+        gfx[b] = gfx_create_surface((void*)addrs[b], info->width, info->height, info->stride,
+                                    info->format, 0);
+        if (!gfx[b]) {
+            printf("failed to create gfx surface\n");
+            exit(-1);
+        }
+    }
+
+    for (int i = 9; i >= 0; i--) {
+        int b = i % 2;
+        draw_frame(gfx[b], i);
+        zx_cache_flush((void*)addrs[b], size, ZX_CACHE_FLUSH_DATA);
+        zx_object_signal(event, ZX_USER_SIGNAL_0, 0);
+        ioctl_display_flip(vfd, &ids[b]);
+        if (zx_object_wait_one(event, ZX_USER_SIGNAL_0, zx_deadline_after(ZX_SEC(1)),
+                               NULL) != ZX_OK) {
+            printf("flip did not take effect\n");
+        }
+        zx_nanosleep(zx_deadline_after(ZX_SEC(1)));
+    }
+
+    for (int b = 0; b < 2; b++) {
+        gfx_surface_destroy(gfx[b]);
+    }
+    zx_handle_close(event);
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     int vfd = open("/dev/class/framebuffer/000", O_RDWR);
     if (vfd < 0) {
@@ -29,6 +90,11 @@ int main(int argc, char* argv[]) {
     }
 
     size_t size = fb.info.stride * fb.info.pixelsize * fb.info.height;
+    if (run_flips(vfd, &fb.info, size)) {
+        close(vfd);
+        return 0;
+    }
+
     uintptr_t fbo;
     zx_status_t status = zx_vmar_map(zx_vmar_root_self(), 0, fb.vmo, 0, size,
                                      ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &fbo);
@@ -45,11 +111,10 @@ int main(int argc, char* argv[]) {
     }
     gfx_fillrect(gfx, 0, 0, gfx->width, gfx->height, 0xffffffff);
 
-    int d = gfx->height / 5;
     int i = 10;
     while (i--) {
         zx_nanosleep(zx_deadline_after(ZX_SEC(1)));
-        gfx_fillrect(gfx, (gfx->width - d) / 2, (gfx->height - d) / 2, d, d, i % 2 ? 0xff55ff55 : 0xffaa00aa);
+        draw_frame(gfx, i);
         ioctl_display_flush_fb(vfd);
     }
 
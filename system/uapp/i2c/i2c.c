@@ -8,6 +8,7 @@
 #include <zircon/types.h>
 #include <zircon/device/i2c.h>
 #include <fdio/util.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -51,6 +52,10 @@ void print_usage(void) {
     printf("For example, to perform a write of one byte and then a read\n");
     printf("of one byte without giving up the bus:\n");
     printf("%s [dev] transfer w 1 00 r 1\n", prog_name);
+    printf("\n");
+    printf("bench COUNT [segments]: Perform the transfer described by segments,\n");
+    printf("as for the transfer command, COUNT times and report the number of\n");
+    printf("transactions per second.\n");
 }
 
 int cmd_add_slave(int fd, int argc, const char** argv) {
@@ -202,7 +207,9 @@ cmd_write_finish:
     return ret;
 }
 
-int cmd_transfer(int fd, int argc, const char** argv) {
+// Performs the transfer |repeat| times. With a |repeat| of one the data read
+// is printed, otherwise the rate at which the transfers went.
+int cmd_transfer(int fd, int argc, const char** argv, long int repeat) {
     const size_t base_size = sizeof(i2c_slave_ioctl_segment_t);
     int ret = ZX_OK;
 
@@ -303,9 +310,19 @@ int cmd_transfer(int fd, int argc, const char** argv) {
         goto cmd_transfer_finish_1;
     }
 
-    ret = ioctl_i2c_slave_transfer(fd, in_buf, in_len, out_buf, out_len);
-    if (ret < 0)
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (long int n = 0; n < repeat; n++) {
+        ret = ioctl_i2c_slave_transfer(fd, in_buf, in_len, out_buf, out_len);
+        if (ret < 0)
+            goto cmd_transfer_finish_1;
+    }
+    if (repeat > 1) {
+        zx_duration_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+        printf("%ld transactions in %" PRIu64 " us, %" PRIu64 " per second\n",
+               repeat, elapsed / 1000, elapsed ? repeat * ZX_SEC(1) / elapsed : 0);
+        ret = 0;
         goto cmd_transfer_finish_1;
+    }
 
     for (size_t i = 0; i < out_len; i++) {
         printf(" %02x", ((uint8_t*)out_buf)[i]);
@@ -356,7 +373,18 @@ int main(int argc, const char** argv) {
     } else if (!strcmp("write", cmd)) {
         return cmd_write(fd, argc, argv);
     } else if (!strcmp("transfer", cmd)) {
-        return cmd_transfer(fd, argc, argv);
+        return cmd_transfer(fd, argc, argv, 1);
+    } else if (!strcmp("bench", cmd)) {
+        if (argc < 1) {
+            print_usage();
+            return 1;
+        }
+        long int count = strtol(argv[0], NULL, 10);
+        if (count < 1) {
+            print_usage();
+            return 1;
+        }
+        return cmd_transfer(fd, argc - 1, argv + 1, count);
     } else {
         printf("Unrecognized command %s.\n", cmd);
         print_usage();
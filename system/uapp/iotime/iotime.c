@@ -52,6 +52,80 @@ static void bytes_per_second(uint64_t bytes, uint64_t nanos) {
     fprintf(stderr, "%g %s/s\n", rate, unit);
 }
 
+// Latencies are counted in log-linear buckets: exactly below 2 * HIST_SUB ns,
+// and in HIST_SUB buckets per power of two above, each within ~3% of the
+// latencies it holds.
+#define HIST_SUB_BITS 5
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t bucket[HIST_BUCKETS];
+} histogram_t;
+
+static unsigned hist_index(uint64_t v) {
+    if (v < 2 * HIST_SUB) {
+        return v;
+    }
+    unsigned shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (unsigned)((v >> shift) - HIST_SUB);
+}
+
+// Returns the middle of the range of latencies held by bucket |n|.
+static uint64_t hist_value(unsigned n) {
+    if (n < 2 * HIST_SUB) {
+        return n;
+    }
+    unsigned shift = n / HIST_SUB - 1;
+    uint64_t lo = ((uint64_t)(n % HIST_SUB + HIST_SUB)) << shift;
+    return lo + ((1ULL << shift) >> 1);
+}
+
+static void hist_add(histogram_t* h, uint64_t v) {
+    if ((h->count == 0) || (v < h->min)) {
+        h->min = v;
+    }
+    if (v > h->max) {
+        h->max = v;
+    }
+    h->count++;
+    h->sum += v;
+    h->bucket[hist_index(v)]++;
+}
+
+// Returns the latency under which |permille| thousandths of them fall.
+static uint64_t hist_percentile(const histogram_t* h, uint64_t permille) {
+    uint64_t target = (h->count * permille + 999) / 1000;
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (unsigned n = 0; n < HIST_BUCKETS; n++) {
+        seen += h->bucket[n];
+        if (seen >= target) {
+            uint64_t v = hist_value(n);
+            return (v < h->min) ? h->min : (v > h->max) ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+static void hist_print(const char* name, const histogram_t* h) {
+    if (h->count == 0) {
+        return;
+    }
+    fprintf(stderr, "%s latency (ns): min %zu avg %zu p50 %zu p99 %zu p999 %zu max %zu\n",
+            name, h->min, h->sum / h->count, hist_percentile(h, 500), hist_percentile(h, 990),
+            hist_percentile(h, 999), h->max);
+}
+
+// Latencies of the transfers of the last run.
+static histogram_t latency;
+
 static zx_time_t iotime_posix(int is_read, int fd, size_t total, size_t bufsz) {
     void* buffer = malloc(bufsz);
     if (buffer == NULL) {
@@ -64,7 +138,9 @@ static zx_time_t iotime_posix(int is_read, int fd, size_t total, size_t bufsz) {
     const char* fn_name = is_read ? "read" : "write";
     while (n > 0) {
         size_t xfer = (n > bufsz) ? bufsz : n;
+        zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
         ssize_t r = is_read ? read(fd, buffer, xfer) : write(fd, buffer, xfer);
+        hist_add(&latency, zx_clock_get(ZX_CLOCK_MONOTONIC) - start);
         if (r < 0) {
             fprintf(stderr, "error: %s() error %d\n", fn_name, errno);
             return ZX_TIME_INFINITE;
@@ -155,7 +231,10 @@ static zx_time_t iotime_fifo(char* dev, int is_read, int fd, size_t total, size_
             .vmo_offset = 0,
             .dev_offset = (total - n) / info.block_size,
         };
-        if ((r = block_fifo_txn(client, &request, 1)) != ZX_OK) {
+        zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        r = block_fifo_txn(client, &request, 1);
+        hist_add(&latency, zx_clock_get(ZX_CLOCK_MONOTONIC) - start);
+        if (r != ZX_OK) {
             fprintf(stderr, "error: block_fifo_txn error %d\n", r);
             return ZX_TIME_INFINITE;
         }
@@ -215,6 +294,7 @@ int main(int argc, char** argv) {
     if (res != ZX_TIME_INFINITE) {
         fprintf(stderr, "%s %zu bytes in %zu ns: ", is_read ? "read" : "write", total, res);
         bytes_per_second(total, res);
+        hist_print(is_read ? "read" : "write", &latency);
         return 0;
     } else {
         return -1;
@@ -0,0 +1,261 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Reads the kernel's counters from the VMO files the kernel publishes them
+// in, see <zircon/kcounters.h>. The VMOs are mapped, so reading a counter
+// doesn't take a syscall.
+//
+// With --trace, runs as a trace provider which samples the counters into
+// each trace session with the "kernel:counters" category enabled.
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <async/cpp/loop.h>
+#include <async/cpp/task.h>
+#include <fbl/macros.h>
+#include <fdio/io.h>
+#include <trace-engine/instrumentation.h>
+#include <trace-provider/provider.h>
+#include <zircon/kcounters.h>
+#include <zircon/process.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+constexpr char kDescPath[] = "/boot/kernel/" KCOUNTERS_DESC_VMO_NAME;
+constexpr char kArenaPath[] = "/boot/kernel/" KCOUNTERS_ARENA_VMO_NAME;
+
+constexpr char kTraceCategory[] = "kernel:counters";
+
+// Names for the per-cpu arguments of the counter records.
+const char* const kCpuArgNames[TRACE_MAX_ARGS] = {
+    "cpu0", "cpu1", "cpu2", "cpu3", "cpu4", "cpu5", "cpu6", "cpu7",
+    "cpu8", "cpu9", "cpu10", "cpu11", "cpu12", "cpu13", "cpu14",
+};
+
+// Maps the counter VMOs read-only.
+class Counters {
+public:
+    Counters() = default;
+    ~Counters() {
+        if (desc_ != nullptr)
+            zx_vmar_unmap(zx_vmar_root_self(), reinterpret_cast<uintptr_t>(desc_), desc_size_);
+        if (arena_ != nullptr)
+            zx_vmar_unmap(zx_vmar_root_self(), reinterpret_cast<uintptr_t>(arena_), arena_size_);
+    }
+
+    zx_status_t Init() {
+        zx_status_t status = Map(kDescPath, &desc_size_, reinterpret_cast<uintptr_t*>(&desc_));
+        if (status != ZX_OK)
+            return status;
+        if (desc_size_ < sizeof(kcounters_desc_t) || desc_->magic != KCOUNTERS_DESC_MAGIC ||
+            (desc_size_ - sizeof(kcounters_desc_t)) / sizeof(kcounters_name_t) <
+                desc_->num_counters)
+            return ZX_ERR_IO_DATA_INTEGRITY;
+
+        status = Map(kArenaPath, &arena_size_, reinterpret_cast<uintptr_t*>(&arena_));
+        if (status != ZX_OK)
+            return status;
+        if (arena_size_ / sizeof(uint64_t) <
+            static_cast<size_t>(desc_->max_cpus) * desc_->num_counters)
+            return ZX_ERR_IO_DATA_INTEGRITY;
+
+        num_cpus_ = zx_system_get_num_cpus();
+        if (num_cpus_ > desc_->max_cpus)
+            num_cpus_ = desc_->max_cpus;
+        return ZX_OK;
+    }
+
+    size_t num_counters() const { return desc_->num_counters; }
+    uint32_t num_cpus() const { return num_cpus_; }
+
+    const char* name(size_t counter) const { return desc_->names[counter].name; }
+
+    uint64_t value(uint32_t cpu, size_t counter) const {
+        // The kernel writes these while we read them.
+        return __atomic_load_n(&arena_[cpu * desc_->num_counters + counter], __ATOMIC_RELAXED);
+    }
+
+    uint64_t total(size_t counter) const {
+        uint64_t sum = 0;
+        for (uint32_t cpu = 0; cpu < num_cpus_; ++cpu)
+            sum += value(cpu, counter);
+        return sum;
+    }
+
+private:
+    static zx_status_t Map(const char* path, size_t* size, uintptr_t* addr) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return ZX_ERR_NOT_FOUND;
+        zx_handle_t vmo;
+        zx_status_t status = fdio_get_exact_vmo(fd, &vmo);
+        close(fd);
+        if (status != ZX_OK)
+            return status;
+        uint64_t vmo_size;
+        status = zx_vmo_get_size(vmo, &vmo_size);
+        if (status == ZX_OK) {
+            *size = vmo_size;
+            status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, vmo_size,
+                                 ZX_VM_FLAG_PERM_READ, addr);
+        }
+        zx_handle_close(vmo);
+        return status;
+    }
+
+    const kcounters_desc_t* desc_ = nullptr;
+    size_t desc_size_ = 0;
+    const uint64_t* arena_ = nullptr;
+    size_t arena_size_ = 0;
+    uint32_t num_cpus_ = 0;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Counters);
+};
+
+bool Matches(const char* name, int num_prefixes, char** prefixes) {
+    if (num_prefixes == 0)
+        return true;
+    for (int i = 0; i < num_prefixes; ++i) {
+        if (strncmp(name, prefixes[i], strlen(prefixes[i])) == 0)
+            return true;
+    }
+    return false;
+}
+
+void PrintCounters(const Counters& counters, bool per_cpu,
+                   int num_prefixes, char** prefixes) {
+    for (size_t i = 0; i < counters.num_counters(); ++i) {
+        if (!Matches(counters.name(i), num_prefixes, prefixes))
+            continue;
+        uint64_t total = counters.total(i);
+        printf("%-40s %12" PRIu64 "\n", counters.name(i), total);
+        if (!per_cpu || total == 0)
+            continue;
+        printf("    ");
+        for (uint32_t cpu = 0; cpu < counters.num_cpus(); ++cpu)
+            printf(" [%u:%" PRIu64 "]", cpu, counters.value(cpu, i));
+        printf("\n");
+    }
+}
+
+// Writes a counter record for each counter into the current trace session,
+// if it has |kTraceCategory| enabled. While there are few enough cpus, the
+// record has each cpu's value; otherwise it has only the total.
+void SampleCounters(const Counters& counters, int num_prefixes, char** prefixes) {
+    trace_string_ref_t category_ref;
+    trace_context_t* context = trace_acquire_context_for_category(kTraceCategory,
+                                                                  &category_ref);
+    if (context == nullptr)
+        return;
+
+    trace_thread_ref_t thread_ref;
+    trace_context_register_current_thread(context, &thread_ref);
+    const trace_ticks_t now = zx_ticks_get();
+    const bool per_cpu = counters.num_cpus() <= TRACE_MAX_ARGS;
+
+    for (size_t i = 0; i < counters.num_counters(); ++i) {
+        const char* name = counters.name(i);
+        if (!Matches(name, num_prefixes, prefixes))
+            continue;
+        trace_string_ref_t name_ref;
+        trace_context_register_string_copy(context, name, strlen(name), &name_ref);
+
+        trace_arg_t args[TRACE_MAX_ARGS];
+        size_t num_args = 0;
+        if (per_cpu) {
+            for (uint32_t cpu = 0; cpu < counters.num_cpus(); ++cpu) {
+                args[num_args++] = trace_make_arg(
+                    trace_context_make_registered_string_literal(context, kCpuArgNames[cpu]),
+                    trace_make_uint64_arg_value(counters.value(cpu, i)));
+            }
+        } else {
+            args[num_args++] = trace_make_arg(
+                trace_context_make_registered_string_literal(context, "total"),
+                trace_make_uint64_arg_value(counters.total(i)));
+        }
+        trace_context_write_counter_event_record(context, now, &thread_ref, &category_ref,
+                                                 &name_ref, i, args, num_args);
+    }
+
+    trace_release_context(context);
+}
+
+int RunTraceProvider(const Counters& counters, zx_duration_t interval,
+                     int num_prefixes, char** prefixes) {
+    async::Loop loop;
+    trace::TraceProvider provider(loop.async());
+
+    async::Task task(zx_deadline_after(interval));
+    task.set_handler([&](async_t* async, zx_status_t status) {
+        if (status != ZX_OK)
+            return ASYNC_TASK_FINISHED;
+        SampleCounters(counters, num_prefixes, prefixes);
+        task.set_deadline(task.deadline() + interval);
+        return ASYNC_TASK_REPEAT;
+    });
+    task.Post(loop.async());
+
+    loop.Run();
+    return 0;
+}
+
+void Usage(void) {
+    fprintf(stderr,
+            "usage: kcounters [options] [prefix...]\n"
+            "Prints the kernel counters whose names start with one of the prefixes,\n"
+            "or all of them.\n"
+            "Options:\n"
+            " -c                Print each cpu's values as well as the total\n"
+            " --trace           Keep running, and sample the counters into trace\n"
+            "                   sessions with the \"%s\" category enabled\n"
+            " -i <msec>         Sample every this many milliseconds (default 1000)\n",
+            kTraceCategory);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool per_cpu = false;
+    bool trace = false;
+    zx_duration_t interval = ZX_SEC(1);
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        if (!strcmp(argv[i], "-c")) {
+            per_cpu = true;
+        } else if (!strcmp(argv[i], "--trace")) {
+            trace = true;
+        } else if (!strcmp(argv[i], "-i") && i + 1 < argc) {
+            long msec = atol(argv[++i]);
+            if (msec <= 0) {
+                Usage();
+                return 1;
+            }
+            interval = ZX_MSEC(msec);
+        } else {
+            Usage();
+            return 1;
+        }
+    }
+
+    Counters counters;
+    zx_status_t status = counters.Init();
+    if (status != ZX_OK) {
+        fprintf(stderr, "kcounters: cannot read the counters: %s\n",
+                zx_status_get_string(status));
+        return 1;
+    }
+
+    if (trace)
+        return RunTraceProvider(counters, interval, argc - i, argv + i);
+    PrintCounters(counters, per_cpu, argc - i, argv + i);
+    return 0;
+}
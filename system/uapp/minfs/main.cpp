@@ -14,6 +14,7 @@
 #include <unistd.h>
 
 #include <async/cpp/loop.h>
+#include <fbl/algorithm.h>
 #include <fbl/unique_free_ptr.h>
 #include <fbl/unique_ptr.h>
 #include <fs/trace.h>
@@ -23,9 +24,13 @@
 #include <zircon/compiler.h>
 #include <zircon/process.h>
 #include <zircon/processargs.h>
+#include <zircon/syscalls.h>
 
 namespace {
 
+// Upper bound on the number of threads serving filesystem requests.
+constexpr uint32_t kMaxServingThreads = 4;
+
 int do_minfs_check(fbl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
     return minfs_check(fbl::move(bc));
 }
@@ -41,11 +46,23 @@ int do_minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, bool readonly) {
     fs::Vfs vfs(loop.async());
     trace::TraceProvider trace_provider(loop.async());
     vfs.SetReadonly(readonly);
+    vfs.SetVnodeLocking(true);
 
     if (MountAndServe(&vfs, fbl::move(bc), zx::channel(h)) != ZX_OK) {
         return -1;
     }
 
+    // Serve connections from several threads. Each connection still handles
+    // one message at a time, so only operations on different connections
+    // run concurrently.
+    uint32_t threads = fbl::min(zx_system_get_num_cpus(), kMaxServingThreads);
+    for (uint32_t i = 1; i < threads; i++) {
+        if (loop.StartThread("minfs-serve") != ZX_OK) {
+            FS_TRACE_WARN("minfs: Could not start serving thread %u\n", i);
+            break;
+        }
+    }
+
     loop.Run();
     return 0;
 }
@@ -19,6 +19,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/async \
     system/ulib/async.loop-cpp \
     system/ulib/async.loop \
+    system/ulib/block-client.cpp \
     system/ulib/block-client \
     system/ulib/trace-provider \
     system/ulib/trace \
@@ -56,77 +56,17 @@ task_entry_t* add_entry(task_table_t* table, const task_entry_t* entry) {
 // The array of tasks built by the callbacks.
 static task_table_t tasks = {};
 
-// The current stack of ancestor jobs, indexed by depth.
-// process_callback may touch any entry whose depth is less that its own.
+// The current stack of ancestor jobs, indexed by depth, as indices into
+// |tasks|. A process may touch any entry whose depth is less that its own.
 #define JOB_STACK_SIZE 128
-static task_entry_t* job_stack[JOB_STACK_SIZE];
-
-// Adds a job's information to |tasks|.
-static zx_status_t job_callback(void* unused_ctx, int depth, zx_handle_t job,
-                                zx_koid_t koid, zx_koid_t parent_koid) {
-    task_entry_t e = {.type = 'j', .depth = depth};
-    zx_status_t status =
-        zx_object_get_property(job, ZX_PROP_NAME, e.name, sizeof(e.name));
-    if (status != ZX_OK) {
-        // This will abort walk_job_tree(), so we don't need to worry
-        // about job_stack.
-        return status;
-    }
-    snprintf(e.koid_str, sizeof(e.koid_str), "%" PRIu64, koid);
-    snprintf(e.parent_koid_str, sizeof(e.koid_str), "%" PRIu64, parent_koid);
-
-    // Put our entry pointer on the job stack so our descendants can find us.
-    assert(depth < JOB_STACK_SIZE);
-    job_stack[depth] = add_entry(&tasks, &e);
-    return ZX_OK;
-}
-
-// Adds a process's information to |tasks|.
-static zx_status_t process_callback(void* unused_ctx, int depth,
-                                    zx_handle_t process,
-                                    zx_koid_t koid, zx_koid_t parent_koid) {
-    task_entry_t e = {.type = 'p', .depth = depth};
-    zx_status_t status =
-        zx_object_get_property(process, ZX_PROP_NAME, e.name, sizeof(e.name));
-    if (status != ZX_OK) {
-        return status;
-    }
-    zx_info_task_stats_t info;
-    status = zx_object_get_info(
-        process, ZX_INFO_TASK_STATS, &info, sizeof(info), NULL, NULL);
-    if (status == ZX_ERR_BAD_STATE) {
-        // Process has exited, but has not been destroyed.
-        // Default to zero for all sizes.
-    } else if (status != ZX_OK) {
-        return status;
-    } else {
-        e.private_bytes = info.mem_private_bytes;
-        e.shared_bytes = info.mem_shared_bytes;
-        e.pss_bytes = info.mem_private_bytes + info.mem_scaled_shared_bytes;
-
-        // Update our ancestor jobs.
-        assert(depth > 0);
-        assert(depth < JOB_STACK_SIZE);
-        for (int i = 0; i < depth; i++) {
-            task_entry_t* job = job_stack[i];
-            job->pss_bytes += e.pss_bytes;
-            job->private_bytes += e.private_bytes;
-            // shared_bytes doesn't mean much as a sum, so leave it at zero.
-        }
-    }
-    snprintf(e.koid_str, sizeof(e.koid_str), "%" PRIu64, koid);
-    snprintf(e.parent_koid_str, sizeof(e.koid_str), "%" PRIu64, parent_koid);
-    add_entry(&tasks, &e);
-
-    return ZX_OK;
-}
+static size_t job_stack[JOB_STACK_SIZE];
 
 // Return text representation of thread state.
-static const char* state_string(const zx_info_thread_t* info) {
-    if (info->wait_exception_port_type != ZX_EXCEPTION_PORT_TYPE_NONE) {
+static const char* state_string(const zx_info_task_node_t* node) {
+    if (node->wait_exception_port_type != ZX_EXCEPTION_PORT_TYPE_NONE) {
         return "excp";
     } else {
-        switch (info->state) {
+        switch (node->state) {
         case ZX_THREAD_STATE_NEW:
             return "new";
         case ZX_THREAD_STATE_RUNNING:
@@ -145,26 +85,54 @@ static const char* state_string(const zx_info_thread_t* info) {
     }
 }
 
-// Adds a thread's information to |tasks|.
-static zx_status_t thread_callback(void* unused_ctx, int depth,
-                                   zx_handle_t thread,
-                                   zx_koid_t koid, zx_koid_t parent_koid) {
-    task_entry_t e = {.type = 't', .depth = depth};
-    zx_status_t status =
-        zx_object_get_property(thread, ZX_PROP_NAME, e.name, sizeof(e.name));
-    if (status != ZX_OK) {
-        return status;
+// Adds a task's information to |tasks|.
+static zx_status_t node_callback(void* ctx, const zx_info_task_node_t* node) {
+    bool with_threads = *(const bool*)ctx;
+    int depth = (int)node->depth;
+    task_entry_t e = {.depth = depth};
+    switch (node->type) {
+    case ZX_OBJ_TYPE_JOB:
+        e.type = 'j';
+        break;
+    case ZX_OBJ_TYPE_PROCESS:
+        e.type = 'p';
+        e.private_bytes = node->mem_private_bytes;
+        e.shared_bytes = node->mem_shared_bytes;
+        e.pss_bytes = node->mem_private_bytes + node->mem_scaled_shared_bytes;
+
+        // Update our ancestor jobs.
+        assert(depth > 0);
+        assert(depth < JOB_STACK_SIZE);
+        for (int i = 0; i < depth; i++) {
+            task_entry_t* job = tasks.entries + job_stack[i];
+            job->pss_bytes += e.pss_bytes;
+            job->private_bytes += e.private_bytes;
+            // shared_bytes doesn't mean much as a sum, so leave it at zero.
+        }
+        break;
+    case ZX_OBJ_TYPE_THREAD:
+        if (!with_threads) {
+            return ZX_OK;
+        }
+        e.type = 't';
+        // TODO: Print thread stack size in one of the memory usage fields?
+        snprintf(e.state_str, sizeof(e.state_str), "%s", state_string(node));
+        break;
+    default:
+        return ZX_OK;
     }
-    zx_info_thread_t info;
-    status = zx_object_get_info(thread, ZX_INFO_THREAD, &info, sizeof(info),
-                                NULL, NULL);
-    if (status != ZX_OK) {
-        return status;
+    strlcpy(e.name, node->name, sizeof(e.name));
+    snprintf(e.koid_str, sizeof(e.koid_str), "%" PRIu64, node->koid);
+    snprintf(e.parent_koid_str, sizeof(e.koid_str), "%" PRIu64,
+             depth == 0 ? 0 : node->parent_koid);
+
+    if (e.type == 'j') {
+        // Put our entry on the job stack so our descendants can find us.
+        // Descendants only ever add entries after ours, so its index stays
+        // valid as the table grows.
+        assert(depth < JOB_STACK_SIZE);
+        job_stack[depth] = tasks.num_entries;
     }
-    // TODO: Print thread stack size in one of the memory usage fields?
-    snprintf(e.koid_str, sizeof(e.koid_str), "%" PRIu64, koid);
-    snprintf(e.parent_koid_str, sizeof(e.koid_str), "%" PRIu64, parent_koid);
-    snprintf(e.state_str, sizeof(e.state_str), "%s", state_string(&info));
     add_entry(&tasks, &e);
     return ZX_OK;
 }
@@ -275,10 +243,9 @@ int main(int argc, char** argv) {
 
     int ret = 0;
     zx_status_t status =
-        walk_root_job_tree(job_callback, process_callback,
-                           with_threads ? thread_callback : NULL, NULL);
+        walk_root_job_tree_snapshot(node_callback, &with_threads);
     if (status != ZX_OK) {
-        fprintf(stderr, "WARNING: walk_root_job_tree failed: %s (%d)\n",
+        fprintf(stderr, "WARNING: walk_root_job_tree_snapshot failed: %s (%d)\n",
                 zx_status_get_string(status), status);
         ret = 1;
     }
@@ -21,7 +21,8 @@
 
 enum sort_order {
     UNSORTED,
-    SORT_TIME_DELTA
+    SORT_TIME_DELTA,
+    SORT_QUEUE_DELTA
 };
 
 typedef struct {
@@ -30,12 +31,14 @@ typedef struct {
     // has it been seen this pass?
     bool scanned;
     zx_time_t delta_time;
+    // change in the thread's runtime accounting since the last pass
+    zx_info_task_runtime_t delta;
 
     // information about the thread
     zx_koid_t proc_koid;
     zx_koid_t koid;
     zx_info_thread_t info;
-    zx_info_thread_stats_t stats;
+    zx_info_task_runtime_t runtime;
     char name[ZX_MAX_NAME_LEN];
     char proc_name[ZX_MAX_NAME_LEN];
 } thread_info_t;
@@ -76,43 +79,30 @@ static const char* state_string(const zx_info_thread_t* info) {
     }
 }
 
-static zx_status_t process_callback(void* unused_ctx, int depth,
-                                    zx_handle_t proc,
-                                    zx_koid_t koid, zx_koid_t parent_koid) {
-    last_process_scanned = koid;
-
-    zx_status_t status = zx_object_get_property(
-        proc, ZX_PROP_NAME, &last_process_name, sizeof(last_process_name));
-    return status;
-}
-
 // Adds a thread's information to the thread_list
-static zx_status_t thread_callback(void* unused_ctx, int depth,
-                                   zx_handle_t thread,
-                                   zx_koid_t koid, zx_koid_t parent_koid) {
+static zx_status_t node_callback(void* unused_ctx,
+                                 const zx_info_task_node_t* node) {
+    if (node->type == ZX_OBJ_TYPE_PROCESS) {
+        last_process_scanned = node->koid;
+        strlcpy(last_process_name, node->name, sizeof(last_process_name));
+        return ZX_OK;
+    }
+    if (node->type != ZX_OBJ_TYPE_THREAD) {
+        return ZX_OK;
+    }
+
     thread_info_t e = {};
 
-    e.koid = koid;
+    e.koid = node->koid;
     e.scanned = true;
 
     e.proc_koid = last_process_scanned;
     strlcpy(e.proc_name, last_process_name, sizeof(e.proc_name));
 
-    zx_status_t status =
-        zx_object_get_property(thread, ZX_PROP_NAME, e.name, sizeof(e.name));
-    if (status != ZX_OK) {
-        return status;
-    }
-    status = zx_object_get_info(
-        thread, ZX_INFO_THREAD, &e.info, sizeof(e.info), NULL, NULL);
-    if (status != ZX_OK) {
-        return status;
-    }
-    status = zx_object_get_info(
-        thread, ZX_INFO_THREAD_STATS, &e.stats, sizeof(e.stats), NULL, NULL);
-    if (status != ZX_OK) {
-        return status;
-    }
+    strlcpy(e.name, node->name, sizeof(e.name));
+    e.info.state = node->state;
+    e.info.wait_exception_port_type = node->wait_exception_port_type;
+    e.runtime = node->runtime;
 
     // see if this thread is in the list
     thread_info_t* temp;
@@ -121,10 +111,16 @@ static zx_status_t thread_callback(void* unused_ctx, int depth,
             // mark it scanned, compute the delta time,
             // and copy the new state over
             temp->scanned = true;
-            temp->delta_time =
-                e.stats.total_runtime - temp->stats.total_runtime;
+            temp->delta_time = e.runtime.cpu_time - temp->runtime.cpu_time;
+            temp->delta.cpu_time = temp->delta_time;
+            temp->delta.queue_time = e.runtime.queue_time - temp->runtime.queue_time;
+            temp->delta.kernel_time = e.runtime.kernel_time - temp->runtime.kernel_time;
+            temp->delta.preemptions = e.runtime.preemptions - temp->runtime.preemptions;
+            temp->delta.page_faults = e.runtime.page_faults - temp->runtime.page_faults;
+            temp->delta.page_fault_time =
+                e.runtime.page_fault_time - temp->runtime.page_fault_time;
             temp->info = e.info;
-            temp->stats = e.stats;
+            temp->runtime = e.runtime;
             return ZX_OK;
         }
     }
@@ -157,6 +153,12 @@ static void sort_threads(enum sort_order order) {
                     found = true;
                     break;
                 }
+            } else if (order == SORT_QUEUE_DELTA) {
+                if (e->delta.queue_time > t->delta.queue_time) {
+                    list_add_before(&t->node, &e->node);
+                    found = true;
+                    break;
+                }
             }
         }
 
@@ -168,29 +170,34 @@ static void sort_threads(enum sort_order order) {
     list_move(&new_list, &thread_list);
 }
 
+static double percent_of_delay(zx_duration_t time) {
+    return time > 0 ? time / (double)delay * 100 : 0;
+}
+
 static void print_threads(void) {
     thread_info_t* e;
-    printf("%8s %8s %10s %5s %s\n",
-           "PID", "TID", raw_time ? "TIME_NS" : "TIME%", "STATE", "NAME");
+    printf("%8s %8s %10s %10s %10s %7s %7s %5s %s\n",
+           "PID", "TID", raw_time ? "TIME_NS" : "TIME%", raw_time ? "QUEUE_NS" : "QUEUE%",
+           raw_time ? "SYS_NS" : "SYS%", "PREEMPT", "FAULTS", "STATE", "NAME");
 
     int i = 0;
     list_for_every_entry (&thread_list, e, thread_info_t, node) {
-        // only print threads that are active
-        if (!print_all && e->delta_time == 0)
+        // only print threads that are active, or that wanted to be
+        if (!print_all && e->delta_time == 0 && e->delta.queue_time == 0)
             continue;
 
         if (!raw_time) {
-            double percent = 0;
-            if (e->delta_time > 0)
-                percent = e->delta_time / (double)delay * 100;
-
-            printf("%8lu %8lu %10.2f %5s %s:%s\n",
-                   e->proc_koid, e->koid, percent, state_string(&e->info),
-                   e->proc_name, e->name);
+            printf("%8lu %8lu %10.2f %10.2f %10.2f %7lu %7lu %5s %s:%s\n",
+                   e->proc_koid, e->koid, percent_of_delay(e->delta_time),
+                   percent_of_delay(e->delta.queue_time),
+                   percent_of_delay(e->delta.kernel_time),
+                   e->delta.preemptions, e->delta.page_faults,
+                   state_string(&e->info), e->proc_name, e->name);
         } else {
-            printf("%8lu %8lu %10lu %5s %s:%s\n",
-                   e->proc_koid, e->koid, e->delta_time, state_string(&e->info),
-                   e->proc_name, e->name);
+            printf("%8lu %8lu %10lu %10lu %10lu %7lu %7lu %5s %s:%s\n",
+                   e->proc_koid, e->koid, e->delta_time, e->delta.queue_time,
+                   e->delta.kernel_time, e->delta.preemptions, e->delta.page_faults,
+                   state_string(&e->info), e->proc_name, e->name);
         }
 
         // only print the first count items (or all, if count < 0)
@@ -211,6 +218,10 @@ static void print_help(FILE* f) {
     fprintf(f, "\nSupported sort fields:\n");
     fprintf(f, "\tnone : no sorting, in job order\n");
     fprintf(f, "\ttime : sort by delta time between scans\n");
+    fprintf(f, "\tqueue: sort by time spent waiting for a cpu between scans\n");
+    fprintf(f, "\nQUEUE is time spent ready to run but waiting for a cpu, SYS the part\n");
+    fprintf(f, "of TIME spent in the kernel.  PREEMPT and FAULTS count preemptions\n");
+    fprintf(f, "and page faults since the last scan.\n");
 }
 
 int main(int argc, char** argv) {
@@ -265,6 +276,8 @@ int main(int argc, char** argv) {
                 sort_order = UNSORTED;
             } else if (!strcmp(argv[i + 1], "time")) {
                 sort_order = SORT_TIME_DELTA;
+            } else if (!strcmp(argv[i + 1], "queue")) {
+                sort_order = SORT_QUEUE_DELTA;
             } else {
                 fprintf(stderr, "Bad sort field\n");
                 print_help(stderr);
@@ -295,10 +308,9 @@ int main(int argc, char** argv) {
         }
 
         // iterate the entire job tree
-        zx_status_t status =
-            walk_root_job_tree(NULL, process_callback, thread_callback, NULL);
+        zx_status_t status = walk_root_job_tree_snapshot(node_callback, NULL);
         if (status != ZX_OK) {
-            fprintf(stderr, "WARNING: walk_root_job_tree failed: %s (%d)\n",
+            fprintf(stderr, "WARNING: walk_root_job_tree_snapshot failed: %s (%d)\n",
                     zx_status_get_string(status), status);
             ret = 1;
         }
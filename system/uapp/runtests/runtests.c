@@ -10,13 +10,16 @@
 #include <launchpad/launchpad.h>
 #include <libgen.h>
 #include <limits.h>
+#include <poll.h>
 #include <zircon/listnode.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <unittest/unittest.h>
@@ -30,6 +33,7 @@ typedef enum {
     FAILED_TO_WAIT,
     FAILED_TO_RETURN_CODE,
     FAILED_NONZERO_RETURN_CODE,
+    FAILED_TIMED_OUT,
 } test_result_t;
 
 // Represents a single test result that can be appended to a linked list.
@@ -37,6 +41,8 @@ typedef struct test {
     list_node_t node;
     test_result_t result;
     int rc; // Return code.
+    zx_duration_t duration; // Wall-clock time from launch to exit.
+    zx_duration_t cpu_time; // Time spent on a cpu by all of the test's threads.
     char name[0];
 } test_t;
 
@@ -46,11 +52,15 @@ typedef struct test {
 // |name| is the name of the test.
 // |result| is the result of trying to execute the test.
 // |rc| is the return code of the test.
-static void record_test_result(list_node_t* tests, const char* name, test_result_t result, int rc) {
+// |duration| and |cpu_time| are how long the test took to run.
+static void record_test_result(list_node_t* tests, const char* name, test_result_t result, int rc,
+                               zx_duration_t duration, zx_duration_t cpu_time) {
     size_t name_len = strlen(name) + 1;
     test_t* test = malloc(sizeof(test_t) + name_len);
     test->result = result;
     test->rc = rc;
+    test->duration = duration;
+    test->cpu_time = cpu_time;
     memcpy(test->name, name, name_len);
     list_add_tail(tests, &test->node);
 }
@@ -58,6 +68,74 @@ static void record_test_result(list_node_t* tests, const char* name, test_result
 // Represents the aggregate of all test results.
 static list_node_t tests = LIST_INITIAL_VALUE(tests);
 
+// Guards |tests|, and keeps the output of tests running at the same time
+// from interleaving on stdout.
+static mtx_t tests_lock = MTX_INIT;
+
+// The wall-clock time a test took in an earlier run, read back from that
+// run's summary.json.
+typedef struct test_history {
+    list_node_t node;
+    zx_duration_t duration;
+    char name[0];
+} test_history_t;
+
+static list_node_t history = LIST_INITIAL_VALUE(history);
+
+// Loads the durations of tests from the JSON summary of an earlier run, if
+// there is one. Relies on write_summary_json() putting each test on a line of
+// its own, so this is not a general JSON parser.
+static void load_test_history(const char* summary_path) {
+    FILE* summary_json = fopen(summary_path, "r");
+    if (summary_json == NULL) {
+        return;
+    }
+    static const char kNameKey[] = "\"name\":\"";
+    static const char kDurationKey[] = "\"duration_ms\":";
+    char line[PATH_MAX + 256];
+    while (fgets(line, sizeof(line), summary_json) != NULL) {
+        char* name = strstr(line, kNameKey);
+        char* duration = strstr(line, kDurationKey);
+        if (name == NULL || duration == NULL) {
+            continue;
+        }
+        name += sizeof(kNameKey) - 1;
+        char* name_end = strchr(name, '"');
+        if (name_end == NULL) {
+            continue;
+        }
+        *name_end = '\0';
+        size_t name_len = strlen(name) + 1;
+        test_history_t* entry = malloc(sizeof(test_history_t) + name_len);
+        if (entry == NULL) {
+            break;
+        }
+        entry->duration = ZX_MSEC(strtoull(duration + sizeof(kDurationKey) - 1, NULL, 10));
+        memcpy(entry->name, name, name_len);
+        list_add_tail(&history, &entry->node);
+    }
+    fclose(summary_json);
+}
+
+// Looks up how long the test at |path| took last time. Returns false if it
+// hasn't been run before.
+static bool expected_duration(const char* path, zx_duration_t* duration) {
+    test_history_t* entry;
+    list_for_every_entry (&history, entry, test_history_t, node) {
+        if (!strcmp(entry->name, path)) {
+            *duration = entry->duration;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The number of tests to run at once, set by -j.
+static int num_jobs = 1;
+
+// How long a test may run before it is killed, set by -w. Zero means forever.
+static zx_duration_t test_timeout = 0;
+
 // We want the default to be the same, whether the test is run by us
 // or run standalone. Do this by leaving the verbosity unspecified unless
 // provided by the user.
@@ -144,98 +222,224 @@ static int mkdir_all(const char* dirn) {
     return 0;
 }
 
+// Output of a test held back until it finishes, so that tests running at the
+// same time don't interleave their output on stdout.
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} output_buffer_t;
+
+static void append_output(output_buffer_t* buffer, const char* data, size_t len) {
+    if (buffer->len + len > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->len + len) {
+            capacity *= 2;
+        }
+        char* grown = realloc(buffer->data, capacity);
+        if (grown == NULL) {
+            return;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(&buffer->data[buffer->len], data, len);
+    buffer->len += len;
+}
+
+// Returns the number of milliseconds until |deadline|, in the form poll() expects.
+static int poll_timeout(zx_time_t deadline) {
+    if (deadline == ZX_TIME_INFINITE) {
+        return -1;
+    }
+    zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    if (now >= deadline) {
+        return 0;
+    }
+    zx_duration_t left = (deadline - now + ZX_MSEC(1) - 1) / ZX_MSEC(1);
+    return left > INT_MAX ? INT_MAX : (int)left;
+}
+
 // Invokes a test binary and prints results.
 //
+// The test runs in a job of its own, so that any processes it starts are
+// accounted to it and torn down with it when it exits or times out.
+//
 // |path| specifies the path to the binary.
 // |out| is a file stream to which the test binary's output will be written. May be
 // NULL.
 //
+// When more than one test runs at a time, the test's output is captured and
+// printed along with its result once it finishes.
+//
 // Returns true if the test binary successfully executes and has a return code of zero.
 static bool run_test(const char* path, FILE* out) {
     int fds[2];
     char verbose_opt[] = {'v','=', verbosity + '0', 0};
     const char* argv[] = {path, verbose_opt};
     int argc = verbosity >= 0 ? 2 : 1;
-
+    const bool parallel = num_jobs > 1;
+    const bool capture = out != NULL || parallel;
+
+    output_buffer_t output = {};
+    char message[256];
+    test_result_t result = SUCCESS;
+    int rc = 0;
+    zx_duration_t duration = 0;
+    zx_info_task_runtime_t runtime = {};
+
+    zx_handle_t job;
+    zx_status_t status = zx_job_create(zx_job_default(), 0, &job);
+    if (status != ZX_OK) {
+        printf("FAILURE: zx_job_create() returned %d\n", status);
+        return false;
+    }
     launchpad_t* lp;
-    zx_status_t status;
-    status = launchpad_create(0, path, &lp);
+    status = launchpad_create(job, path, &lp);
     if (status != ZX_OK) {
       printf("FAILURE: launchpad_create() returned %d\n", status);
+      zx_handle_close(job);
       return false;
     }
     status = launchpad_load_from_file(lp, argv[0]);
     if (status != ZX_OK) {
       printf("FAILURE: launchpad_load_from_file() returned %d\n", status);
+      zx_handle_close(job);
       return false;
     }
     status = launchpad_clone(lp, LP_CLONE_ALL);
     if (status != ZX_OK) {
       printf("FAILURE: launchpad_clone() returned %d\n", status);
+      zx_handle_close(job);
       return false;
     }
-    if (out != NULL) {
+    if (capture) {
         if (pipe(fds)) {
             printf("FAILURE: Failed to create pipe: %s\n", strerror(errno));
+            zx_handle_close(job);
             return false;
         }
         status = launchpad_clone_fd(lp, fds[1], STDOUT_FILENO);
         if (status != ZX_OK) {
           printf("FAILURE: launchpad_clone_fd() returned %d\n", status);
+          close(fds[0]);
+          zx_handle_close(job);
           return false;
         }
         status = launchpad_transfer_fd(lp, fds[1], STDERR_FILENO);
         if (status != ZX_OK) {
           printf("FAILURE: launchpad_transfer_fd() returned %d\n", status);
+          close(fds[0]);
+          zx_handle_close(job);
           return false;
         }
     }
     launchpad_set_args(lp, argc, argv);
     const char* errmsg;
     zx_handle_t handle;
+    const zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    const zx_time_t deadline = test_timeout ? start + test_timeout : ZX_TIME_INFINITE;
     status = launchpad_go(lp, &handle, &errmsg);
     if (status != ZX_OK) {
-        printf("FAILURE: Failed to launch %s: %d: %s\n", path, status, errmsg);
-        record_test_result(&tests, path, FAILED_TO_LAUNCH, 0);
-        return false;
+        snprintf(message, sizeof(message), "FAILURE: Failed to launch %s: %d: %s\n", path, status,
+                 errmsg);
+        result = FAILED_TO_LAUNCH;
+        if (capture) {
+            close(fds[0]);
+        }
+        goto done;
     }
-    // Tee output.
-    if (out != NULL) {
+    // Tee output, or hold it back until the test is done if others are
+    // running at the same time.
+    if (capture) {
         char buf[1024];
         ssize_t bytes_read = 0;
-        while ((bytes_read = read(fds[0], buf, 1024)) > 0) {
-            fwrite(buf, 1, bytes_read, out);
-            fwrite(buf, 1, bytes_read, stdout);
+        for (;;) {
+            struct pollfd pfd = {.fd = fds[0], .events = POLLIN};
+            int ready = poll(&pfd, 1, poll_timeout(deadline));
+            if (ready == 0) {
+                result = FAILED_TIMED_OUT;
+                break;
+            }
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ready < 0 || (bytes_read = read(fds[0], buf, sizeof(buf))) <= 0) {
+                break;
+            }
+            if (out != NULL) {
+                fwrite(buf, 1, bytes_read, out);
+            }
+            if (parallel) {
+                append_output(&output, buf, bytes_read);
+            } else {
+                fwrite(buf, 1, bytes_read, stdout);
+            }
+        }
+        close(fds[0]);
+    }
+    if (result != FAILED_TIMED_OUT) {
+        status = zx_object_wait_one(handle, ZX_PROCESS_TERMINATED, deadline, NULL);
+        if (status == ZX_ERR_TIMED_OUT) {
+            result = FAILED_TIMED_OUT;
+        } else if (status != ZX_OK) {
+            snprintf(message, sizeof(message), "FAILURE: Failed to wait for process exiting %s: %d\n",
+                     path, status);
+            result = FAILED_TO_WAIT;
         }
     }
-    status = zx_object_wait_one(handle, ZX_PROCESS_TERMINATED,
-                                ZX_TIME_INFINITE, NULL);
-    if (status != ZX_OK) {
-        printf("FAILURE: Failed to wait for process exiting %s: %d\n", path, status);
-        record_test_result(&tests, path, FAILED_TO_WAIT, 0);
-        return false;
+    if (result == FAILED_TIMED_OUT) {
+        zx_task_kill(job);
+        zx_object_wait_one(handle, ZX_PROCESS_TERMINATED, ZX_TIME_INFINITE, NULL);
+        snprintf(message, sizeof(message), "FAILURE: %s timed out after %" PRIu64 " seconds\n",
+                 path, test_timeout / ZX_SEC(1));
+    }
+    duration = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+
+    // The job's runtime includes any processes the test started, and any
+    // that have already exited.
+    zx_object_get_info(job, ZX_INFO_TASK_RUNTIME, &runtime, sizeof(runtime), NULL, NULL);
+
+    if (result == SUCCESS) {
+        // read the return code
+        zx_info_process_t proc_info;
+        status = zx_object_get_info(handle, ZX_INFO_PROCESS, &proc_info, sizeof(proc_info), NULL,
+                                    NULL);
+        if (status < 0) {
+            snprintf(message, sizeof(message), "FAILURE: Failed to get process return code %s: %d\n",
+                     path, status);
+            result = FAILED_TO_RETURN_CODE;
+        } else if (proc_info.return_code != 0) {
+            snprintf(message, sizeof(message), "FAILURE: %s exited with nonzero status: %d\n",
+                     path, proc_info.return_code);
+            result = FAILED_NONZERO_RETURN_CODE;
+            rc = proc_info.return_code;
+        } else {
+            snprintf(message, sizeof(message), "PASSED: %s passed\n", path);
+        }
     }
-
-    // read the return code
-    zx_info_process_t proc_info;
-    status = zx_object_get_info(handle, ZX_INFO_PROCESS, &proc_info, sizeof(proc_info), NULL, NULL);
     zx_handle_close(handle);
 
-    if (status < 0) {
-        printf("FAILURE: Failed to get process return code %s: %d\n", path, status);
-        record_test_result(&tests, path, FAILED_TO_RETURN_CODE, 0);
-        return false;
-    }
+done:
+    // Don't leave anything the test started running into the next test.
+    zx_task_kill(job);
+    zx_handle_close(job);
 
-    if (proc_info.return_code != 0) {
-        printf("FAILURE: %s exited with nonzero status: %d\n", path, proc_info.return_code);
-        record_test_result(&tests, path, FAILED_NONZERO_RETURN_CODE, proc_info.return_code);
-        return false;
+    mtx_lock(&tests_lock);
+    if (parallel) {
+        if (verbosity) {
+            printf(
+                "\n------------------------------------------------\n"
+                "TEST OUTPUT: %s\n\n",
+                path);
+        }
+        fwrite(output.data, 1, output.len, stdout);
     }
-
-    printf("PASSED: %s passed\n", path);
-    record_test_result(&tests, path, SUCCESS, 0);
-    return true;
+    fputs(message, stdout);
+    record_test_result(&tests, path, result, rc, duration, runtime.cpu_time);
+    mtx_unlock(&tests_lock);
+    free(output.data);
+    return result == SUCCESS;
 }
 
 // Creates an output file name from a path to a test.
@@ -283,7 +487,101 @@ static FILE* open_output_file(const char* output_dir, const char* test_path) {
     return fopen(output_path, "w");
 }
 
-// Executes all test binaries in a directory (non-recursive).
+// A test binary waiting to be run.
+typedef struct {
+    char path[PATH_MAX];
+    bool timed; // Whether |expected_duration| is known.
+    zx_duration_t expected_duration;
+} pending_test_t;
+
+// Orders tests longest first, so that a long test started last doesn't hold
+// up the end of the run. Tests that haven't been timed go first, since they
+// may well be long ones.
+static int compare_expected_duration(const void* a, const void* b) {
+    const pending_test_t* lhs = a;
+    const pending_test_t* rhs = b;
+    if (!lhs->timed || !rhs->timed) {
+        return lhs->timed - rhs->timed;
+    }
+    if (lhs->expected_duration != rhs->expected_duration) {
+        return lhs->expected_duration > rhs->expected_duration ? -1 : 1;
+    }
+    return 0;
+}
+
+// The tests of one directory, shared by the threads running them.
+typedef struct {
+    mtx_t lock;
+    pending_test_t* tests;
+    size_t num_tests;
+    const char* output_dir;
+
+    // The rest are guarded by |lock|.
+    size_t next;
+    int test_count;
+    int failed_count;
+    bool aborted;
+} test_queue_t;
+
+// Runs tests from |arg|, a test_queue_t, until there are none left.
+static int run_queued_tests(void* arg) {
+    test_queue_t* queue = arg;
+    for (;;) {
+        mtx_lock(&queue->lock);
+        if (queue->aborted || queue->next == queue->num_tests) {
+            mtx_unlock(&queue->lock);
+            return 0;
+        }
+        const char* test_path = queue->tests[queue->next++].path;
+        mtx_unlock(&queue->lock);
+
+        const char* test_name = strrchr(test_path, '/') + 1;
+        if (verbosity && num_jobs == 1) {
+            printf(
+                "\n------------------------------------------------\n"
+                "RUNNING TEST: %s\n\n",
+                test_name);
+        }
+
+        // If output_dir was specified, ask run_test to redirect stdout/stderr
+        // to a file whose name is based on the test name.
+        FILE* out = NULL;
+        if (queue->output_dir != NULL) {
+            out = open_output_file(queue->output_dir, test_path);
+            if (out == NULL) {
+                printf("Error: Could not open output file for test %s: %s\n", test_name,
+                       strerror(errno));
+                mtx_lock(&queue->lock);
+                queue->aborted = true;
+                mtx_unlock(&queue->lock);
+                return 0;
+            }
+        }
+
+        // Execute the test binary.
+        bool passed = run_test(test_path, out);
+
+        // Clean up the output file.
+        bool closed = true;
+        if (out != NULL && fclose(out)) {
+            printf("FAILURE: Failed to close output file for test %s: %s\n", test_name,
+                   strerror(errno));
+            closed = false;
+        }
+
+        mtx_lock(&queue->lock);
+        if (!passed) {
+            queue->failed_count++;
+        }
+        if (closed) {
+            queue->test_count++;
+        }
+        mtx_unlock(&queue->lock);
+    }
+}
+
+// Executes all test binaries in a directory (non-recursive), up to
+// |num_jobs| at a time.
 //
 // |dirn| is the directory to search.
 // |filter_names| is a list of test names to filter on (i.e. tests whose names
@@ -305,12 +603,14 @@ static bool run_tests_in_dir(const char* dirn, const char** filter_names, const
 
     struct dirent* de;
     struct stat stat_buf;
-    int test_count = 0;
-    int failed_count = 0;
-
-    // Iterate over the files in dir, setting up the output for test binaries
-    // and executing them via run_test as they're found. Skips over test binaries
-    // whose names aren't in filter_names.
+    test_queue_t queue = {
+        .lock = MTX_INIT,
+        .output_dir = output_dir,
+    };
+    size_t capacity = 0;
+
+    // Collect the test binaries in dir, skipping over those whose names
+    // aren't in filter_names.
     while ((de = readdir(dir)) != NULL) {
         const char* test_name = de->d_name;
         if (!match_test_names(test_name, filter_names, num_filter_names)) {
@@ -323,44 +623,45 @@ static bool run_tests_in_dir(const char* dirn, const char** filter_names, const
             continue;
         }
 
-        if (verbosity) {
-            printf(
-                "\n------------------------------------------------\n"
-                "RUNNING TEST: %s\n\n",
-                test_name);
-        }
-
-        // If output_dir was specified, ask run_test to redirect stdout/stderr
-        // to a file whose name is based on the test name.
-        FILE* out = NULL;
-        if (output_dir != NULL) {
-            out = open_output_file(output_dir, test_path);
-            if (out == NULL) {
-                printf("Error: Could not open output file for test %s: %s\n", test_name,
-                       strerror(errno));
+        if (queue.num_tests == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            pending_test_t* grown = realloc(queue.tests, capacity * sizeof(pending_test_t));
+            if (grown == NULL) {
+                printf("Error: Out of memory listing tests in %s\n", dirn);
+                free(queue.tests);
+                closedir(dir);
                 return false;
             }
+            queue.tests = grown;
         }
+        pending_test_t* test = &queue.tests[queue.num_tests++];
+        strlcpy(test->path, test_path, sizeof(test->path));
+        test->timed = expected_duration(test_path, &test->expected_duration);
+    }
+    closedir(dir);
 
-        // Execute the test binary.
-        if (!run_test(test_path, out)) {
-            failed_count++;
-        }
+    // When tests run one at a time the order makes no difference to how long
+    // the run takes, so keep it the same as the directory's.
+    if (num_jobs > 1) {
+        qsort(queue.tests, queue.num_tests, sizeof(pending_test_t), compare_expected_duration);
+    }
 
-        // Clean up the output file.
-        if (out != NULL && fclose(out)) {
-            printf("FAILURE: Failed to close output file for test %s: %s\n", de->d_name,
-                   strerror(errno));
-            continue;
+    thrd_t threads[num_jobs];
+    int num_threads = 0;
+    for (; num_threads < num_jobs - 1 && (size_t)num_threads + 1 < queue.num_tests; num_threads++) {
+        if (thrd_create(&threads[num_threads], run_queued_tests, &queue) != thrd_success) {
+            break;
         }
-
-        test_count++;
     }
+    run_queued_tests(&queue);
+    for (int i = 0; i < num_threads; i++) {
+        thrd_join(threads[i], NULL);
+    }
+    free(queue.tests);
 
-    closedir(dir);
-    *num_failed = failed_count;
-    *num_tests = test_count;
-    return failed_count == 0;
+    *num_failed = queue.failed_count;
+    *num_tests = queue.test_count;
+    return !queue.aborted && queue.failed_count == 0;
 }
 
 // Writes a JSON summary of test results given a linked-list of tests.
@@ -399,6 +700,10 @@ static int write_summary_json(const list_node_t* tests, FILE* summary_json) {
         // have one PASS condition in test_result_t, which is SUCCESS.
         fprintf(summary_json, ",\"result\":\"%s\"", test->result == SUCCESS ? "PASS" : "FAIL");
 
+        // Write how long the test took, both end to end and on a cpu.
+        fprintf(summary_json, ",\"duration_ms\":%" PRIu64, test->duration / ZX_MSEC(1));
+        fprintf(summary_json, ",\"cpu_time_ms\":%" PRIu64, test->cpu_time / ZX_MSEC(1));
+
         fprintf(summary_json, "}");
         test_count++;
     }
@@ -409,7 +714,8 @@ static int write_summary_json(const list_node_t* tests, FILE* summary_json) {
 int usage(char* name) {
     fprintf(stderr,
             "usage: %s [-q|-v] [-S|-s] [-M|-m] [-L|-l] [-P|-p] [-a]"
-            " [-t test names] [-o directory] [directories ...]\n"
+            " [-t test names] [-o directory] [-j jobs] [-w seconds]"
+            " [directories ...]\n"
             "\n"
             "The optional [directories ...] is a list of           \n"
             "directories containing tests to run, non-recursively. \n"
@@ -433,6 +739,14 @@ int usage(char* name) {
             "   -t: Filter tests by name                           \n"
             "       (accepts a comma-separated list)               \n"
             "   -o: Write test output to a directory               \n"
+            "   -j: Run up to this many tests at once (default 1)  \n"
+            "   -w: Kill tests that run longer than this many      \n"
+            "       seconds (default: no limit)                    \n"
+            "\n"
+            "Each test runs in a job of its own. With -j, the      \n"
+            "output of each test is printed once it finishes, and  \n"
+            "the tests that took longest in the run whose summary  \n"
+            "is in the -o directory are started first.             \n"
             "\n"
             "If -o is enabled, then a JSON summary of the test     \n"
             "results will be written to a file named 'summary.json'\n"
@@ -440,7 +754,8 @@ int usage(char* name) {
             "test's standard output and error.                     \n"
             "The summary contains a listing of the tests executed  \n"
             "by full path (e.g. /boot/test/core/futex_test) as well\n"
-            "as whether the test passed or failed. For details, see\n"
+            "as whether the test passed or failed, and how long it \n"
+            "took. For details, see                                \n"
             "//system/uapp/runtests/summary-schema.json            \n", name);
     return -1;
 }
@@ -495,6 +810,18 @@ int main(int argc, char** argv) {
             }
             output_dir = (const char*)argv[i + 1];
             i++;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc || (num_jobs = atoi(argv[i + 1])) < 1) {
+                return usage(argv[0]);
+            }
+            i++;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            int timeout_secs;
+            if (i + 1 >= argc || (timeout_secs = atoi(argv[i + 1])) < 1) {
+                return usage(argv[0]);
+            }
+            test_timeout = ZX_SEC(timeout_secs);
+            i++;
         } else if (argv[i][0] != '-') {
             num_test_dirs = argc - i;
             test_dirs = (const char**)&argv[i];
@@ -526,6 +853,14 @@ int main(int argc, char** argv) {
         return -1;
     }
 
+    // Order the tests by how long they took in the last run written to the
+    // same place.
+    if (output_dir != NULL && num_jobs > 1) {
+        char summary_path[PATH_MAX];
+        snprintf(summary_path, sizeof(summary_path), "%s/summary.json", output_dir);
+        load_test_history(summary_path);
+    }
+
     int failed_count = 0;
     int total_count = 0;
     for (i = 0; i < num_test_dirs; i++) {
@@ -575,6 +910,12 @@ int main(int argc, char** argv) {
     }
     free(filter_names);
 
+    test_history_t* entry = NULL;
+    test_history_t* next_entry = NULL;
+    list_for_every_entry_safe (&history, entry, next_entry, test_history_t, node) {
+        free(entry);
+    }
+
     // It's not catastrophic if we can't unset it; we're just trying to clean up
     unsetenv(TEST_ENV_NAME);
 
@@ -628,6 +969,9 @@ int main(int argc, char** argv) {
         case FAILED_NONZERO_RETURN_CODE:
             printf("%s: returned nonzero: %d\n", test->name, test->rc);
             break;
+        case FAILED_TIMED_OUT:
+            printf("%s: timed out\n", test->name);
+            break;
         default:
             printf("%s: unknown result\n", test->name);
             break;
@@ -0,0 +1,397 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <zircon/syscalls.h>
+
+#include "sched-bench.h"
+
+using sched::Kind;
+using sched::Worker;
+using sched::WorkerSpec;
+
+namespace {
+
+constexpr uint32_t kDefaultSeconds = 10;
+constexpr int32_t kDefaultPriority = 16;
+constexpr zx_duration_t kDefaultPeriod = ZX_MSEC(1);
+constexpr size_t kMaxSpecs = 16;
+
+struct Summary {
+    double mean;
+    double p50;
+    double p99;
+    double max;
+};
+
+// Summarizes |count| values, scaled by |scale|.
+Summary Summarize(const uint64_t* values, size_t count, double scale) {
+    Summary s = {};
+    if (count == 0) {
+        return s;
+    }
+    fbl::unique_ptr<uint64_t[]> sorted(new uint64_t[count]);
+    memcpy(sorted.get(), values, count * sizeof(uint64_t));
+    qsort(sorted.get(), count, sizeof(uint64_t), [](const void* a, const void* b) {
+        const uint64_t x = *static_cast<const uint64_t*>(a);
+        const uint64_t y = *static_cast<const uint64_t*>(b);
+        return x < y ? -1 : (x > y ? 1 : 0);
+    });
+    double sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += static_cast<double>(sorted[i]);
+    }
+    s.mean = sum / static_cast<double>(count) * scale;
+    s.p50 = static_cast<double>(sorted[count / 2]) * scale;
+    s.p99 = static_cast<double>(sorted[fbl::min(count - 1, count * 99 / 100)]) * scale;
+    s.max = static_cast<double>(sorted[count - 1]) * scale;
+    return s;
+}
+
+// Jain's fairness index: 1 when every share is equal, down to 1/n when one
+// share takes everything.
+double Jain(const double* shares, size_t count) {
+    double sum = 0, squares = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += shares[i];
+        squares += shares[i] * shares[i];
+    }
+    return squares > 0 ? sum * sum / (static_cast<double>(count) * squares) : 1.0;
+}
+
+bool ParseDuration(const char* s, zx_duration_t* out) {
+    char* end;
+    const unsigned long long v = strtoull(s, &end, 10);
+    if (end == s) {
+        return false;
+    } else if (!strcmp(end, "us")) {
+        *out = ZX_USEC(v);
+    } else if (!strcmp(end, "ms") || *end == '\0') {
+        *out = ZX_MSEC(v);
+    } else {
+        return false;
+    }
+    return *out > 0;
+}
+
+// Parses KIND:COUNT[:PRIORITY[:PERIOD]].
+bool ParseSpec(const char* arg, WorkerSpec* out) {
+    char buf[64];
+    if (strlen(arg) >= sizeof(buf)) {
+        return false;
+    }
+    strcpy(buf, arg);
+    char* fields[4] = {};
+    size_t n = 0;
+    for (char* save = nullptr, *f = strtok_r(buf, ":", &save); f != nullptr && n < 4;
+         f = strtok_r(nullptr, ":", &save)) {
+        fields[n++] = f;
+    }
+    if (n < 2) {
+        return false;
+    }
+
+    static constexpr Kind kKinds[] = {Kind::kPeriodic, Kind::kDeadline, Kind::kCpu, Kind::kIo};
+    bool found = false;
+    for (Kind kind : kKinds) {
+        if (!strcmp(fields[0], sched::KindName(kind))) {
+            out->kind = kind;
+            found = true;
+        }
+    }
+    char* end;
+    out->count = static_cast<uint32_t>(strtoul(fields[1], &end, 10));
+    if (!found || *end != '\0' || out->count == 0) {
+        return false;
+    }
+    out->priority = kDefaultPriority;
+    if (n > 2) {
+        out->priority = static_cast<int32_t>(strtol(fields[2], &end, 10));
+        if (*end != '\0' || out->priority < 0 || out->priority > 31) {
+            return false;
+        }
+    }
+    out->period = out->kind == Kind::kIo ? 2 * kDefaultPeriod : kDefaultPeriod;
+    return n < 4 || ParseDuration(fields[3], &out->period);
+}
+
+void usage(const char* program_name) {
+    printf("usage: %s [-d SECONDS] [-s SEED] [-n] [-o FILE] [-t KIND:COUNT[:PRIO[:PERIOD]]]...\n"
+           "  -d : run for SECONDS.  Default %u\n"
+           "  -s : RNG seed for the io events.  Defaults to seeding from zx_clock_get\n"
+           "  -n : don't trace the scheduler with ktrace\n"
+           "  -o : also write the results to FILE as JSON\n"
+           "  -t : add COUNT threads of KIND at priority PRIO (default %d), where KIND is\n"
+           "       periodic : wake every PERIOD (default 1ms) and compute for a tenth of it\n"
+           "       deadline : as periodic, with a deadline reservation of a fifth of PERIOD\n"
+           "       cpu      : compute without blocking\n"
+           "       io       : wake on events at random intervals averaging PERIOD (default 2ms)\n"
+           "       PERIOD takes a us or ms suffix.  The default mix is\n"
+           "       periodic:2:24:1ms io:2:20:2ms cpu:<cpus>:16 cpu:<cpus/2>:8\n"
+           "Priorities need the kernel booted with thread.set.priority.allowed=true.\n"
+           "Scheduler tracing needs /dev/misc/ktrace, and leaves ktrace stopped.\n",
+           program_name, kDefaultSeconds, kDefaultPriority);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint32_t seconds = kDefaultSeconds;
+    unsigned int seed = static_cast<unsigned int>(zx_clock_get(ZX_CLOCK_MONOTONIC));
+    bool trace = true;
+    const char* json_path = nullptr;
+    WorkerSpec specs[kMaxSpecs];
+    size_t num_specs = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hd:s:no:t:")) != -1) {
+        switch (opt) {
+        case 'd':
+            seconds = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+            if (seconds == 0) {
+                usage(argv[0]);
+                return -1;
+            }
+            break;
+        case 's':
+            seed = static_cast<unsigned int>(strtoul(optarg, nullptr, 10));
+            break;
+        case 'n':
+            trace = false;
+            break;
+        case 'o':
+            json_path = optarg;
+            break;
+        case 't':
+            if (num_specs == kMaxSpecs || !ParseSpec(optarg, &specs[num_specs])) {
+                fprintf(stderr, "%s: bad thread group '%s'\n", argv[0], optarg);
+                return -1;
+            }
+            num_specs++;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : -1;
+        }
+    }
+    if (num_specs == 0) {
+        const uint32_t cpus = zx_system_get_num_cpus();
+        specs[num_specs++] = {Kind::kPeriodic, 2, 24, kDefaultPeriod};
+        specs[num_specs++] = {Kind::kIo, 2, 20, 2 * kDefaultPeriod};
+        specs[num_specs++] = {Kind::kCpu, cpus, 16, 0};
+        specs[num_specs++] = {Kind::kCpu, fbl::max(cpus / 2, 1u), 8, 0};
+    }
+
+    fbl::Vector<fbl::unique_ptr<Worker>> workers;
+    fbl::Vector<Worker*> io_workers;
+    fbl::AllocChecker ac;
+    for (size_t i = 0; i < num_specs; i++) {
+        for (uint32_t j = 0; j < specs[i].count; j++) {
+            fbl::unique_ptr<Worker> w(new (&ac) Worker(specs[i], static_cast<uint32_t>(i)));
+            if (!ac.check()) {
+                return -1;
+            }
+            if (specs[i].kind == Kind::kIo) {
+                io_workers.push_back(w.get(), &ac);
+                if (!ac.check()) {
+                    return -1;
+                }
+            }
+            workers.push_back(fbl::move(w), &ac);
+            if (!ac.check()) {
+                return -1;
+            }
+        }
+    }
+    sched::Producer producer(fbl::move(io_workers), seed);
+
+    sched::SchedTrace sched_trace;
+    if (trace) {
+        zx_status_t status = sched_trace.Start();
+        if (status != ZX_OK) {
+            fprintf(stderr, "%s: cannot start ktrace (%d); running without it\n", argv[0],
+                    status);
+            trace = false;
+        }
+    }
+
+    printf("Running %zu threads for %u seconds (seed %u)\n", workers.size(), seconds, seed);
+    for (auto& w : workers) {
+        zx_status_t status = w->Start();
+        if (status != ZX_OK) {
+            fprintf(stderr, "%s: cannot start thread (%d)\n", argv[0], status);
+            sched::g_quit = true;
+            return -1;
+        }
+    }
+    if (producer.Start() != ZX_OK) {
+        fprintf(stderr, "%s: cannot start producer thread\n", argv[0]);
+        sched::g_quit = true;
+        return -1;
+    }
+
+    zx_nanosleep(zx_deadline_after(ZX_SEC(seconds)));
+    sched::g_quit = true;
+    producer.Stop();
+    for (auto& w : workers) {
+        w->Stop();
+    }
+
+    fbl::unique_ptr<zx_koid_t[]> koids(new zx_koid_t[workers.size()]);
+    for (size_t i = 0; i < workers.size(); i++) {
+        koids[i] = workers[i]->koid();
+    }
+    if (trace) {
+        zx_status_t status = sched_trace.Stop(koids.get(), workers.size());
+        if (status != ZX_OK || sched_trace.ticks_per_ms() == 0 ||
+            sched_trace.duration_ticks() == 0) {
+            fprintf(stderr, "%s: cannot read the ktrace buffer (%d)\n", argv[0], status);
+            trace = false;
+        }
+    }
+
+    FILE* json = nullptr;
+    if (json_path != nullptr && (json = fopen(json_path, "w")) == nullptr) {
+        fprintf(stderr, "%s: cannot open %s\n", argv[0], json_path);
+    }
+    if (json != nullptr) {
+        fprintf(json, "{\n  \"seconds\": %u,\n  \"cpus\": %u,\n  \"groups\": [",
+                seconds, zx_system_get_num_cpus());
+    }
+
+    // The trace's clock, in ns per tick, and the CPU time available.
+    const double tick_ns = trace ? 1e6 / static_cast<double>(sched_trace.ticks_per_ms()) : 0;
+    const double cpu_ticks = trace ? static_cast<double>(sched_trace.duration_ticks()) *
+                                         zx_system_get_num_cpus()
+                                   : 0;
+
+    bool unscheduled = false;
+    printf("\n%-9s %4s %3s | %-34s | %-8s %-6s %-9s %-12s\n", "group", "prio", "n",
+           "wakeup latency us (p50/p99/max)", "cpu %", "jain", "preempt/s",
+           "ready us p99");
+    for (size_t i = 0; i < num_specs; i++) {
+        const WorkerSpec& spec = specs[i];
+        fbl::Vector<uint64_t> latencies;
+        fbl::Vector<uint64_t> ready_waits;
+        fbl::Vector<double> shares;
+        size_t wakeups = 0, overruns = 0;
+        uint64_t run_ticks = 0, preemptions = 0, migrations = 0;
+        for (size_t w = 0; w < workers.size(); w++) {
+            const Worker& worker = *workers[w];
+            if (worker.index() != i) {
+                continue;
+            }
+            unscheduled |= !worker.scheduled_as_asked();
+            wakeups += worker.wakeups();
+            overruns += worker.overruns();
+            for (size_t k = 0; k < worker.latency_count(); k++) {
+                latencies.push_back(worker.latencies()[k], &ac);
+            }
+            if (trace) {
+                const sched::ThreadTrace& t = sched_trace.thread(w);
+                run_ticks += t.run_ticks;
+                preemptions += t.preemptions;
+                migrations += t.migrations;
+                shares.push_back(static_cast<double>(t.run_ticks), &ac);
+                for (uint64_t wait : t.ready_waits) {
+                    ready_waits.push_back(wait, &ac);
+                }
+            } else {
+                shares.push_back(static_cast<double>(worker.work()), &ac);
+            }
+            if (!ac.check()) {
+                return -1;
+            }
+        }
+
+        const Summary lat = Summarize(latencies.get(), latencies.size(), 1e-3);
+        const Summary ready = Summarize(ready_waits.get(), ready_waits.size(), tick_ns * 1e-3);
+        const double cpu_pct = trace ? 100.0 * static_cast<double>(run_ticks) / cpu_ticks : 0;
+        const double jain = Jain(shares.get(), shares.size());
+        const double preempt_rate = static_cast<double>(preemptions) / seconds;
+        char lat_str[40] = "-";
+        if (spec.kind != Kind::kCpu) {
+            snprintf(lat_str, sizeof(lat_str), "%.1f/%.1f/%.1f", lat.p50, lat.p99, lat.max);
+        }
+        printf("%-9s %4d %3u | %-34s | %-8.2f %-6.3f %-9.1f %-12.1f\n",
+               sched::KindName(spec.kind), spec.priority, spec.count, lat_str, cpu_pct, jain,
+               preempt_rate, ready.p99);
+        if (overruns > 0) {
+            printf("          %zu of %zu wakeups came due while still busy\n", overruns,
+                   wakeups + overruns);
+        }
+
+        if (json != nullptr) {
+            fprintf(json, "%s\n    {\"kind\": \"%s\", \"priority\": %d, \"count\": %u, "
+                          "\"period_ns\": %" PRId64 ", \"wakeups\": %zu, \"overruns\": %zu, "
+                          "\"latency_us\": {\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, "
+                          "\"max\": %.2f}, \"jain\": %.4f",
+                    i > 0 ? "," : "", sched::KindName(spec.kind), spec.priority, spec.count,
+                    spec.period, wakeups, overruns, lat.mean, lat.p50, lat.p99, lat.max, jain);
+            if (trace) {
+                fprintf(json, ", \"cpu_percent\": %.3f, \"preemptions\": %" PRIu64
+                              ", \"migrations\": %" PRIu64 ", \"ready_wait_us\": "
+                              "{\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f}",
+                        cpu_pct, preemptions, migrations, ready.mean, ready.p50, ready.p99,
+                        ready.max);
+            }
+            fprintf(json, "}");
+        }
+    }
+
+    // Fairness across everything sharing a priority band, whatever its kind.
+    if (trace) {
+        printf("\n%-4s %7s %8s %6s\n", "prio", "threads", "cpu %", "jain");
+        if (json != nullptr) {
+            fprintf(json, "\n  ],\n  \"bands\": [");
+        }
+        bool first = true;
+        for (int32_t prio = 31; prio >= 0; prio--) {
+            fbl::Vector<double> shares;
+            uint64_t run_ticks = 0;
+            for (size_t w = 0; w < workers.size(); w++) {
+                if (workers[w]->spec().kind == Kind::kDeadline ||
+                    workers[w]->spec().priority != prio) {
+                    continue;
+                }
+                run_ticks += sched_trace.thread(w).run_ticks;
+                shares.push_back(static_cast<double>(sched_trace.thread(w).run_ticks), &ac);
+                if (!ac.check()) {
+                    return -1;
+                }
+            }
+            if (shares.is_empty()) {
+                continue;
+            }
+            const double cpu_pct = 100.0 * static_cast<double>(run_ticks) / cpu_ticks;
+            const double jain = Jain(shares.get(), shares.size());
+            printf("%-4d %7zu %8.2f %6.3f\n", prio, shares.size(), cpu_pct, jain);
+            if (json != nullptr) {
+                fprintf(json, "%s\n    {\"priority\": %d, \"threads\": %zu, "
+                              "\"cpu_percent\": %.3f, \"jain\": %.4f}",
+                        first ? "" : ",", prio, shares.size(), cpu_pct, jain);
+            }
+            first = false;
+        }
+    } else {
+        printf("\nWithout ktrace, fairness is over the work each thread got done.\n");
+    }
+    if (json != nullptr) {
+        fprintf(json, "\n  ]\n}\n");
+        fclose(json);
+    }
+    if (unscheduled) {
+        printf("\nSome threads could not be given their priority or deadline; boot with\n"
+               "thread.set.priority.allowed=true to set priorities.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+# Copyright 2018 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+MODULE := $(LOCAL_DIR)
+MODULE_TYPE := userapp
+MODULE_GROUP := misc
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/main.cpp \
+    $(LOCAL_DIR)/sched-trace.cpp \
+    $(LOCAL_DIR)/worker.cpp
+
+MODULE_STATIC_LIBS := \
+    system/ulib/zxcpp \
+    system/ulib/fbl
+
+MODULE_LIBS := \
+    system/ulib/fdio \
+    system/ulib/zircon \
+    system/ulib/c
+
+include make/module.mk
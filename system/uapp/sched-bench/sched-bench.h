@@ -0,0 +1,164 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <threads.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/array.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <zircon/types.h>
+
+namespace sched {
+
+enum class Kind {
+    // Wakes on a timer every |period|, and computes for a tenth of it.
+    kPeriodic,
+    // As kPeriodic, but scheduled with zx_thread_set_deadline() for a fifth
+    // of each period rather than by priority.
+    kDeadline,
+    // Computes without blocking.
+    kCpu,
+    // Waits for events signaled by the producer thread at random intervals
+    // averaging |period|, and computes briefly on each.
+    kIo,
+};
+
+const char* KindName(Kind kind);
+
+// One group of identical threads in the mix.
+struct WorkerSpec {
+    Kind kind;
+    uint32_t count;
+    int32_t priority;
+    zx_duration_t period;
+};
+
+// Wakeup latencies kept per thread; later ones are counted but not kept.
+constexpr size_t kMaxLatencySamples = 1 << 16;
+
+class Worker {
+public:
+    Worker(const WorkerSpec& spec, uint32_t index);
+    ~Worker();
+
+    zx_status_t Start();
+    // Asks the thread to stop, and waits for it.
+    void Stop();
+
+    const WorkerSpec& spec() const { return spec_; }
+    uint32_t index() const { return index_; }
+    zx_koid_t koid() const { return koid_; }
+    // Whether the thread could be given its priority or deadline.
+    bool scheduled_as_asked() const { return scheduled_as_asked_; }
+
+    // Nanoseconds from each wakeup being due to the thread running.
+    const uint64_t* latencies() const { return latencies_.get(); }
+    size_t latency_count() const { return fbl::min(wakeups_, kMaxLatencySamples); }
+    size_t wakeups() const { return wakeups_; }
+    // Wakeups which came due while the thread was still busy with the last.
+    size_t overruns() const { return overruns_; }
+    // Units of computation done; the CPU share the thread got, as seen from
+    // userspace.
+    uint64_t work() const { return work_; }
+
+    // For kIo: called by the producer to raise the next event.
+    void Signal(zx_time_t now);
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Worker);
+
+    int Run();
+    void RunPeriodic();
+    void RunCpu();
+    void RunIo();
+    void Compute(zx_duration_t duration);
+    void AddLatency(zx_duration_t latency);
+
+    const WorkerSpec spec_;
+    const uint32_t index_;
+    thrd_t thread_;
+    bool started_ = false;
+    zx_koid_t koid_ = 0;
+    bool scheduled_as_asked_ = true;
+    zx_handle_t event_ = ZX_HANDLE_INVALID;
+    // When the pending kIo event was raised, or zero if none is pending.
+    zx_time_t signaled_at_ = 0;
+    fbl::unique_ptr<uint64_t[]> latencies_;
+    size_t wakeups_ = 0;
+    size_t overruns_ = 0;
+    uint64_t work_ = 0;
+    volatile double accumulator_ = 1.0;
+};
+
+// Signals the kIo workers at exponentially distributed intervals.
+class Producer {
+public:
+    Producer(fbl::Vector<Worker*> workers, uint32_t seed);
+    ~Producer();
+
+    zx_status_t Start();
+    void Stop();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Producer);
+
+    int Run();
+    zx_duration_t NextInterval(zx_duration_t mean);
+
+    fbl::Vector<Worker*> workers_;
+    unsigned int seed_;
+    thrd_t thread_;
+    bool started_ = false;
+};
+
+// Set by main() to stop every thread.
+extern volatile bool g_quit;
+
+// What the kernel's scheduler trace says about one thread over the run.
+struct ThreadTrace {
+    zx_koid_t koid;
+    // Ticks spent running.
+    uint64_t run_ticks;
+    // Times it was switched out while still runnable.
+    uint32_t preemptions;
+    uint32_t migrations;
+    // Ticks from each preemption to running again.
+    fbl::Vector<uint64_t> ready_waits;
+};
+
+// Records the scheduler's context switches and migrations with ktrace, for
+// the threads of interest. ktrace is left stopped afterwards.
+class SchedTrace {
+public:
+    SchedTrace() = default;
+    ~SchedTrace();
+
+    // Fails if ktrace is not available to this process.
+    zx_status_t Start();
+    zx_status_t Stop(const zx_koid_t* koids, size_t count);
+
+    const ThreadTrace& thread(size_t i) const { return threads_[i]; }
+    uint64_t ticks_per_ms() const { return ticks_per_ms_; }
+    // The span of time covered by the trace, in ticks.
+    uint64_t duration_ticks() const { return last_ts_ - first_ts_; }
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SchedTrace);
+
+    void Analyze(const uint8_t* data, size_t len);
+    ThreadTrace* Find(uint32_t tid);
+
+    zx_handle_t handle_ = ZX_HANDLE_INVALID;
+    fbl::Array<ThreadTrace> threads_;
+    uint64_t ticks_per_ms_ = 0;
+    uint64_t first_ts_ = 0;
+    uint64_t last_ts_ = 0;
+};
+
+} // namespace sched
@@ -0,0 +1,202 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fbl/alloc_checker.h>
+#include <zircon/device/ktrace.h>
+#include <zircon/ktrace.h>
+#include <zircon/syscalls.h>
+
+#include "sched-bench.h"
+
+namespace sched {
+namespace {
+
+// The kernel's thread states, as reported in TAG_CONTEXT_SWITCH.
+constexpr uint32_t kThreadReady = 1;
+
+struct Switch {
+    uint64_t ts;
+    uint32_t from_tid;
+    uint32_t to_tid;
+    uint32_t cpu;
+    uint32_t from_state;
+};
+
+int CompareSwitches(const void* a, const void* b) {
+    const uint64_t x = static_cast<const Switch*>(a)->ts;
+    const uint64_t y = static_cast<const Switch*>(b)->ts;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+} // namespace
+
+SchedTrace::~SchedTrace() {
+    if (handle_ != ZX_HANDLE_INVALID) {
+        zx_handle_close(handle_);
+    }
+}
+
+zx_status_t SchedTrace::Start() {
+    int fd = open("/dev/misc/ktrace", O_RDWR);
+    if (fd < 0) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    ssize_t r = ioctl_ktrace_get_handle(fd, &handle_);
+    close(fd);
+    if (r < 0) {
+        return static_cast<zx_status_t>(r);
+    }
+
+    // Whatever was being traced is dropped, so the buffer holds this run
+    // alone.
+    zx_status_t status;
+    zx_ktrace_control(handle_, KTRACE_ACTION_STOP, 0, nullptr);
+    if ((status = zx_ktrace_control(handle_, KTRACE_ACTION_REWIND, 0, nullptr)) != ZX_OK) {
+        return status;
+    }
+    return zx_ktrace_control(handle_, KTRACE_ACTION_START, KTRACE_GRP_SCHEDULER, nullptr);
+}
+
+zx_status_t SchedTrace::Stop(const zx_koid_t* koids, size_t count) {
+    zx_status_t status;
+    if ((status = zx_ktrace_control(handle_, KTRACE_ACTION_STOP, 0, nullptr)) != ZX_OK) {
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    threads_.reset(new (&ac) ThreadTrace[count], count);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < count; i++) {
+        threads_[i].koid = koids[i];
+        threads_[i].run_ticks = 0;
+        threads_[i].preemptions = 0;
+        threads_[i].migrations = 0;
+    }
+
+    uint32_t size;
+    if ((status = zx_ktrace_read(handle_, nullptr, 0, 0, &size)) != ZX_OK) {
+        return status;
+    }
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[size]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint32_t offset = 0;
+    while (offset < size) {
+        uint32_t actual;
+        if ((status = zx_ktrace_read(handle_, data.get() + offset, offset, size - offset,
+                                     &actual)) != ZX_OK) {
+            return status;
+        }
+        if (actual == 0) {
+            break;
+        }
+        offset += actual;
+    }
+    Analyze(data.get(), offset);
+    return ZX_OK;
+}
+
+ThreadTrace* SchedTrace::Find(uint32_t tid) {
+    if (tid == 0) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < threads_.size(); i++) {
+        if (static_cast<uint32_t>(threads_[i].koid) == tid) {
+            return &threads_[i];
+        }
+    }
+    return nullptr;
+}
+
+void SchedTrace::Analyze(const uint8_t* data, size_t len) {
+    fbl::Vector<Switch> switches;
+    fbl::AllocChecker ac;
+    for (size_t off = 0; off + sizeof(ktrace_header_t) <= len;) {
+        auto hdr = reinterpret_cast<const ktrace_header_t*>(data + off);
+        const size_t rec_len = KTRACE_LEN(hdr->tag);
+        if (rec_len == 0 || off + rec_len > len) {
+            break;
+        }
+        off += rec_len;
+        if (rec_len < sizeof(ktrace_rec_32b_t)) {
+            continue;
+        }
+        auto rec = reinterpret_cast<const ktrace_rec_32b_t*>(hdr);
+        const uint32_t event = KTRACE_EVENT(hdr->tag);
+        if (event == KTRACE_EVENT(TAG_TICKS_PER_MS)) {
+            ticks_per_ms_ = (static_cast<uint64_t>(rec->b) << 32) | rec->a;
+        } else if (event == KTRACE_EVENT(TAG_CONTEXT_SWITCH)) {
+            switches.push_back({rec->ts, rec->tid, rec->a, rec->b & 0xffff, rec->b >> 16}, &ac);
+            if (!ac.check()) {
+                return;
+            }
+        } else if (event == KTRACE_EVENT(TAG_THREAD_MIGRATE)) {
+            ThreadTrace* t = Find(rec->a);
+            if (t != nullptr) {
+                t->migrations++;
+            }
+        }
+    }
+    if (switches.is_empty()) {
+        return;
+    }
+
+    // Each CPU's records are in order, but the CPUs' buffers may be read
+    // back one after another.
+    qsort(switches.get(), switches.size(), sizeof(Switch), CompareSwitches);
+    first_ts_ = switches[0].ts;
+    last_ts_ = switches[switches.size() - 1].ts;
+
+    const uint32_t num_cpus = zx_system_get_num_cpus();
+    fbl::unique_ptr<uint64_t[]> running_since(new (&ac) uint64_t[num_cpus]);
+    fbl::unique_ptr<uint64_t[]> ready_since(new (&ac) uint64_t[threads_.size()]);
+    if (!ac.check()) {
+        return;
+    }
+    for (uint32_t i = 0; i < num_cpus; i++) {
+        running_since[i] = 0;
+    }
+    for (size_t i = 0; i < threads_.size(); i++) {
+        ready_since[i] = 0;
+    }
+
+    for (const Switch& s : switches) {
+        if (s.cpu >= num_cpus) {
+            continue;
+        }
+        ThreadTrace* from = Find(s.from_tid);
+        if (from != nullptr) {
+            // The first switch seen on a CPU has no start to measure from.
+            if (running_since[s.cpu] != 0) {
+                from->run_ticks += s.ts - running_since[s.cpu];
+            }
+            if (s.from_state == kThreadReady) {
+                from->preemptions++;
+                ready_since[from - threads_.get()] = s.ts;
+            }
+        }
+        ThreadTrace* to = Find(s.to_tid);
+        if (to != nullptr) {
+            uint64_t& since = ready_since[to - threads_.get()];
+            if (since != 0) {
+                to->ready_waits.push_back(s.ts - since, &ac);
+                if (!ac.check()) {
+                    return;
+                }
+                since = 0;
+            }
+        }
+        running_since[s.cpu] = s.ts;
+    }
+}
+
+} // namespace sched
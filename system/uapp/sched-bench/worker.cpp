@@ -0,0 +1,259 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fbl/alloc_checker.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/threads.h>
+
+#include "sched-bench.h"
+
+namespace sched {
+
+volatile bool g_quit = false;
+
+namespace {
+
+// How long a kIo worker computes for on each event.
+constexpr zx_duration_t kIoBurst = ZX_USEC(50);
+// Threads waiting to be stopped check in at least this often.
+constexpr zx_duration_t kMaxWait = ZX_MSEC(10);
+
+zx_time_t Now() {
+    return zx_clock_get(ZX_CLOCK_MONOTONIC);
+}
+
+} // namespace
+
+const char* KindName(Kind kind) {
+    switch (kind) {
+    case Kind::kPeriodic:
+        return "periodic";
+    case Kind::kDeadline:
+        return "deadline";
+    case Kind::kCpu:
+        return "cpu";
+    case Kind::kIo:
+        return "io";
+    }
+    return "unknown";
+}
+
+Worker::Worker(const WorkerSpec& spec, uint32_t index)
+    : spec_(spec), index_(index) {}
+
+Worker::~Worker() {
+    Stop();
+    if (event_ != ZX_HANDLE_INVALID) {
+        zx_handle_close(event_);
+    }
+}
+
+zx_status_t Worker::Start() {
+    fbl::AllocChecker ac;
+    latencies_.reset(new (&ac) uint64_t[kMaxLatencySamples]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status;
+    if (spec_.kind == Kind::kIo && (status = zx_event_create(0, &event_)) != ZX_OK) {
+        return status;
+    }
+
+    char name[ZX_MAX_NAME_LEN];
+    snprintf(name, sizeof(name), "sched-bench-%s-%u", KindName(spec_.kind), index_);
+    int c11_res = thrd_create_with_name(
+        &thread_, [](void* ctx) -> int { return static_cast<Worker*>(ctx)->Run(); }, this, name);
+    if (c11_res != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    started_ = true;
+
+    zx_info_handle_basic_t info;
+    if ((status = zx_object_get_info(thrd_get_zx_handle(thread_), ZX_INFO_HANDLE_BASIC, &info,
+                                     sizeof(info), nullptr, nullptr)) != ZX_OK) {
+        return status;
+    }
+    koid_ = info.koid;
+    return ZX_OK;
+}
+
+void Worker::Stop() {
+    if (started_) {
+        if (event_ != ZX_HANDLE_INVALID) {
+            zx_object_signal(event_, 0, ZX_USER_SIGNAL_0);
+        }
+        thrd_join(thread_, nullptr);
+        started_ = false;
+    }
+}
+
+void Worker::Signal(zx_time_t now) {
+    zx_time_t expected = 0;
+    if (!__atomic_compare_exchange_n(&signaled_at_, &expected, now, false, __ATOMIC_RELEASE,
+                                     __ATOMIC_RELAXED)) {
+        // The last event has not been taken yet.
+        __atomic_fetch_add(&overruns_, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    zx_object_signal(event_, 0, ZX_EVENT_SIGNALED);
+}
+
+int Worker::Run() {
+    if (spec_.kind == Kind::kDeadline) {
+        scheduled_as_asked_ = zx_thread_set_deadline(thrd_get_zx_handle(thrd_current()),
+                                                     spec_.period / 5, spec_.period,
+                                                     spec_.period) == ZX_OK;
+    } else {
+        // zx_thread_set_priority() is experimental, and only allowed when
+        // booted with thread.set.priority.allowed=true.
+        scheduled_as_asked_ = zx_thread_set_priority(spec_.priority) == ZX_OK;
+    }
+
+    switch (spec_.kind) {
+    case Kind::kPeriodic:
+    case Kind::kDeadline:
+        RunPeriodic();
+        break;
+    case Kind::kCpu:
+        RunCpu();
+        break;
+    case Kind::kIo:
+        RunIo();
+        break;
+    }
+    return 0;
+}
+
+void Worker::Compute(zx_duration_t duration) {
+    const zx_time_t end = Now() + duration;
+    do {
+        for (int i = 0; i < 256; i++) {
+            accumulator_ = accumulator_ * 1.000001 + 0.5;
+            if (accumulator_ > 1e9) {
+                accumulator_ = 1.0;
+            }
+        }
+        work_++;
+    } while (Now() < end && !g_quit);
+}
+
+void Worker::AddLatency(zx_duration_t latency) {
+    if (wakeups_ < kMaxLatencySamples) {
+        latencies_[wakeups_] = latency;
+    }
+    wakeups_++;
+}
+
+void Worker::RunPeriodic() {
+    zx_time_t next = Now() + spec_.period;
+    while (!g_quit) {
+        zx_nanosleep(next);
+        const zx_time_t woke = Now();
+        AddLatency(woke - next);
+        Compute(spec_.period / 10);
+
+        next += spec_.period;
+        const zx_time_t now = Now();
+        if (now >= next) {
+            // Skip the periods already missed rather than running them back
+            // to back.
+            overruns_++;
+            next += ((now - next) / spec_.period + 1) * spec_.period;
+        }
+    }
+}
+
+void Worker::RunCpu() {
+    while (!g_quit) {
+        Compute(kMaxWait);
+    }
+}
+
+void Worker::RunIo() {
+    while (!g_quit) {
+        zx_signals_t observed;
+        zx_status_t status = zx_object_wait_one(event_, ZX_EVENT_SIGNALED | ZX_USER_SIGNAL_0,
+                                                zx_deadline_after(kMaxWait), &observed);
+        if (status == ZX_ERR_TIMED_OUT || !(observed & ZX_EVENT_SIGNALED)) {
+            continue;
+        }
+        const zx_time_t woke = Now();
+        zx_object_signal(event_, ZX_EVENT_SIGNALED, 0);
+        const zx_time_t signaled = __atomic_load_n(&signaled_at_, __ATOMIC_ACQUIRE);
+        AddLatency(woke - signaled);
+        Compute(kIoBurst);
+        __atomic_store_n(&signaled_at_, 0, __ATOMIC_RELEASE);
+    }
+}
+
+Producer::Producer(fbl::Vector<Worker*> workers, uint32_t seed)
+    : workers_(fbl::move(workers)), seed_(seed) {}
+
+Producer::~Producer() {
+    Stop();
+}
+
+zx_status_t Producer::Start() {
+    if (workers_.is_empty()) {
+        return ZX_OK;
+    }
+    int c11_res = thrd_create_with_name(
+        &thread_, [](void* ctx) -> int { return static_cast<Producer*>(ctx)->Run(); }, this,
+        "sched-bench-producer");
+    if (c11_res != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    started_ = true;
+    return ZX_OK;
+}
+
+void Producer::Stop() {
+    if (started_) {
+        thrd_join(thread_, nullptr);
+        started_ = false;
+    }
+}
+
+zx_duration_t Producer::NextInterval(zx_duration_t mean) {
+    // Exponentially distributed, as arrivals from independent sources are.
+    const double u = (rand_r(&seed_) + 1.0) / (static_cast<double>(RAND_MAX) + 2.0);
+    return static_cast<zx_duration_t>(-log(u) * static_cast<double>(mean));
+}
+
+int Producer::Run() {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zx_time_t[]> due(new (&ac) zx_time_t[workers_.size()]);
+    if (!ac.check()) {
+        return -1;
+    }
+    const zx_time_t start = Now();
+    for (size_t i = 0; i < workers_.size(); i++) {
+        due[i] = start + NextInterval(workers_[i]->spec().period);
+    }
+
+    while (!g_quit) {
+        size_t next = 0;
+        for (size_t i = 1; i < workers_.size(); i++) {
+            if (due[i] < due[next]) {
+                next = i;
+            }
+        }
+        zx_nanosleep(fbl::min(due[next], Now() + kMaxWait));
+        const zx_time_t now = Now();
+        for (size_t i = 0; i < workers_.size(); i++) {
+            if (due[i] <= now) {
+                workers_[i]->Signal(now);
+                due[i] = now + NextInterval(workers_[i]->spec().period);
+            }
+        }
+    }
+    return 0;
+}
+
+} // namespace sched
@@ -0,0 +1,135 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "benchmark.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <zircon/assert.h>
+#include <zircon/threads.h>
+
+namespace bench {
+
+Runner::Runner(const Options& options)
+    : options_(options), samples_(new uint64_t[options.samples]) {
+    if (options_.json != nullptr) {
+        fprintf(options_.json, "{\n  \"cpus\": %u,\n  \"samples\": %u,\n  \"batch\": %u,\n"
+                               "  \"unit\": \"ns\",\n  \"benchmarks\": [",
+                zx_system_get_num_cpus(), options_.samples, options_.batch);
+    }
+}
+
+Runner::~Runner() = default;
+
+bool Runner::Enabled(const char* name) const {
+    if (options_.filter != nullptr && strstr(name, options_.filter) == nullptr) {
+        return false;
+    }
+    if (options_.list) {
+        printf("%s\n", name);
+        return false;
+    }
+    return true;
+}
+
+void Runner::Report(const char* name) {
+    const uint32_t n = options_.samples;
+    uint64_t* samples = samples_.get();
+    fbl::unique_ptr<uint64_t[]> sorted(new uint64_t[n]);
+    memcpy(sorted.get(), samples, n * sizeof(uint64_t));
+    qsort(sorted.get(), n, sizeof(uint64_t), [](const void* a, const void* b) {
+        const uint64_t x = *static_cast<const uint64_t*>(a);
+        const uint64_t y = *static_cast<const uint64_t*>(b);
+        return x < y ? -1 : (x > y ? 1 : 0);
+    });
+
+    // Samples are in ticks for a whole batch; everything reported is in
+    // nanoseconds per operation.
+    const double scale = 1e9 / static_cast<double>(zx_ticks_per_second()) /
+                         static_cast<double>(options_.batch);
+    double sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += static_cast<double>(samples[i]) * scale;
+    }
+    const double mean = sum / n;
+    double squares = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        const double d = static_cast<double>(samples[i]) * scale - mean;
+        squares += d * d;
+    }
+    const double stddev = n > 1 ? sqrt(squares / (n - 1)) : 0;
+    const double p50 = static_cast<double>(sorted[n / 2]) * scale;
+    const double p99 = static_cast<double>(sorted[fbl::min(n - 1, n * 99 / 100)]) * scale;
+    const double min = static_cast<double>(sorted[0]) * scale;
+    const double max = static_cast<double>(sorted[n - 1]) * scale;
+
+    printf("%-48s mean %10.1f  p50 %10.1f  p99 %10.1f  stddev %9.1f ns\n",
+           name, mean, p50, p99, stddev);
+    if (options_.json != nullptr) {
+        fprintf(options_.json, "%s\n    {\"name\": \"%s\", \"mean\": %.1f, \"p50\": %.1f, "
+                               "\"p99\": %.1f, \"stddev\": %.1f, \"min\": %.1f, \"max\": %.1f}",
+                reported_ > 0 ? "," : "", name, mean, p50, p99, stddev, min, max);
+    }
+    reported_++;
+}
+
+void Runner::Finish() {
+    if (options_.json != nullptr) {
+        fprintf(options_.json, "\n  ]\n}\n");
+    }
+}
+
+PeerThread::~PeerThread() {
+    Join();
+}
+
+int PeerThread::Entry(void* arg) {
+    static_cast<PeerThread*>(arg)->fn_();
+    return 0;
+}
+
+zx_status_t PeerThread::Start(uint32_t cpu, fbl::Function<void()> fn) {
+    ZX_DEBUG_ASSERT(!started_);
+    fn_ = fbl::move(fn);
+    if (thrd_create(&thread_, Entry, this) != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    started_ = true;
+    if (cpu != kAnyCpu) {
+        return zx_thread_set_affinity(thrd_get_zx_handle(thread_), 1ull << cpu);
+    }
+    return ZX_OK;
+}
+
+void PeerThread::Join() {
+    if (started_) {
+        thrd_join(thread_, nullptr);
+        started_ = false;
+    }
+}
+
+size_t GetPlacements(const Placement** out) {
+    static constexpr Placement kPlacements[] = {
+        {"same-cpu", 0, 0},
+        {"cross-cpu", 0, 1},
+        {"any-cpu", kAnyCpu, kAnyCpu},
+    };
+    *out = kPlacements;
+    return zx_system_get_num_cpus() > 1 ? fbl::count_of(kPlacements) : 1;
+}
+
+zx_status_t PinCurrentThread(uint32_t cpu) {
+    uint64_t mask;
+    if (cpu != kAnyCpu) {
+        mask = 1ull << cpu;
+    } else {
+        const uint32_t cpus = zx_system_get_num_cpus();
+        mask = cpus >= 64 ? ~0ull : (1ull << cpus) - 1;
+    }
+    return zx_thread_set_affinity(thrd_get_zx_handle(thrd_current()), mask);
+}
+
+} // namespace bench
@@ -0,0 +1,116 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+
+#include <fbl/function.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/syscalls.h>
+#include <zircon/types.h>
+
+namespace bench {
+
+struct Options {
+    // Only benchmarks whose names contain |filter| are run.
+    const char* filter = nullptr;
+    // Lists the benchmarks that would run, without running them.
+    bool list = false;
+    // Timed samples taken per benchmark, each of |batch| operations.
+    uint32_t samples = 1000;
+    uint32_t batch = 10;
+    // Untimed samples taken first, to fault in and warm up caches.
+    uint32_t warmup = 20;
+    // Where the results are written as JSON, or null.
+    FILE* json = nullptr;
+};
+
+// Runs and reports benchmarks. Each sample times a batch of operations, and
+// is reported per operation: mean, median, 99th percentile and standard
+// deviation over the samples.
+class Runner {
+public:
+    explicit Runner(const Options& options);
+    ~Runner();
+
+    // Whether the benchmark |name| is selected. In list mode, prints the
+    // name and returns false, so no set up is done for it.
+    bool Enabled(const char* name) const;
+
+    // Times |op|, which performs |count| operations each time it is called,
+    // and reports the result under |name|.
+    template <typename Op>
+    void Measure(const char* name, Op op) {
+        for (uint32_t i = 0; i < options_.warmup; i++) {
+            op(options_.batch);
+        }
+        for (uint32_t i = 0; i < options_.samples; i++) {
+            const uint64_t start = zx_ticks_get();
+            op(options_.batch);
+            samples_[i] = zx_ticks_get() - start;
+        }
+        Report(name);
+    }
+
+    // Writes out the closing of the JSON document.
+    void Finish();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Runner);
+
+    void Report(const char* name);
+
+    const Options options_;
+    fbl::unique_ptr<uint64_t[]> samples_;
+    uint32_t reported_ = 0;
+};
+
+// A thread running the other end of a round trip benchmark, optionally
+// pinned to one CPU. The thread is joined on destruction, so whatever it
+// waits on must be made to return first.
+class PeerThread {
+public:
+    PeerThread() = default;
+    ~PeerThread();
+
+    // Starts |fn| on a new thread, pinned to |cpu| unless it is kAnyCpu.
+    zx_status_t Start(uint32_t cpu, fbl::Function<void()> fn);
+    void Join();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PeerThread);
+
+    static int Entry(void* arg);
+
+    fbl::Function<void()> fn_;
+    thrd_t thread_;
+    bool started_ = false;
+};
+
+constexpr uint32_t kAnyCpu = UINT32_MAX;
+
+// Where the two ends of a round trip benchmark run.
+struct Placement {
+    const char* name;
+    uint32_t client_cpu;
+    uint32_t server_cpu;
+};
+
+// The placements worth measuring on this machine: both ends on one CPU, and
+// if there are several, on two different CPUs and wherever the scheduler puts
+// them.
+size_t GetPlacements(const Placement** out);
+
+// Pins the calling thread to |cpu|, or lets it run anywhere for kAnyCpu.
+zx_status_t PinCurrentThread(uint32_t cpu);
+
+void RunIpcBenchmarks(Runner* runner);
+void RunScalingBenchmarks(Runner* runner);
+void RunVmBenchmarks(Runner* runner);
+
+} // namespace bench
@@ -0,0 +1,503 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include "benchmark.h"
+
+namespace bench {
+namespace {
+
+// Large enough for any message the benchmarks send.
+constexpr uint32_t kMaxMessageSize = 65536;
+constexpr uint32_t kMaxHandles = 8;
+
+// Page aligned so that ZX_CHANNEL_WRITE_MOVE can move whole pages of the
+// message rather than copy them.
+constexpr size_t kDataAlignment = 4096;
+
+struct Buffer {
+    Buffer() {
+        void* ptr = nullptr;
+        ZX_ASSERT(posix_memalign(&ptr, kDataAlignment, kMaxMessageSize) == 0);
+        data = static_cast<uint8_t*>(ptr);
+        for (uint32_t i = 0; i < kMaxMessageSize; i++) {
+            data[i] = static_cast<uint8_t>(i);
+        }
+    }
+    ~Buffer() { free(data); }
+    uint8_t* data;
+};
+
+void CloseHandles(zx_handle_t* handles, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        zx_handle_close(handles[i]);
+    }
+}
+
+// Blocks until |handle| is readable, returning false if the peer went away
+// first.
+bool WaitReadable(zx_handle_t handle) {
+    zx_signals_t observed;
+    ZX_ASSERT(zx_object_wait_one(handle, __ZX_OBJECT_READABLE | __ZX_OBJECT_PEER_CLOSED,
+                                 ZX_TIME_INFINITE, &observed) == ZX_OK);
+    return observed & __ZX_OBJECT_READABLE;
+}
+
+struct ChannelArgs {
+    uint32_t size;
+    uint32_t handles;
+    // Messages left sitting in the channel throughout.
+    uint32_t queue;
+    uint32_t write_options;
+};
+
+// A write followed by a read of the same message, on one thread; this is
+// the case the old channel-perf measured.
+void ChannelWriteRead(Runner* runner, Buffer* buf) {
+    static constexpr ChannelArgs kCases[] = {
+        {64, 0, 0, 0},
+        {1024, 0, 0, 0},
+        {4096, 0, 0, 0},
+        {16384, 0, 0, 0},
+        {65536, 0, 0, 0},
+        {64, 1, 0, 0},
+        {64, 4, 0, 0},
+        {64, 0, 1, 0},
+        {4096, 0, 0, ZX_CHANNEL_WRITE_MOVE},
+        {16384, 0, 0, ZX_CHANNEL_WRITE_MOVE},
+        {65536, 0, 0, ZX_CHANNEL_WRITE_MOVE},
+    };
+    for (const ChannelArgs& args : kCases) {
+        char name[64];
+        snprintf(name, sizeof(name), "channel/write_read/%uB/%uh%s%s", args.size, args.handles,
+                 args.queue ? "/queued" : "",
+                 (args.write_options & ZX_CHANNEL_WRITE_MOVE) ? "/move" : "");
+        if (!runner->Enabled(name)) {
+            continue;
+        }
+
+        zx_handle_t ch[2];
+        ZX_ASSERT(zx_channel_create(0, &ch[0], &ch[1]) == ZX_OK);
+        zx_handle_t event;
+        ZX_ASSERT(zx_event_create(0, &event) == ZX_OK);
+        zx_handle_t handles[kMaxHandles];
+        for (uint32_t i = 0; i < args.queue; i++) {
+            ZX_ASSERT(zx_channel_write(ch[0], 0, buf->data, args.size, nullptr, 0) == ZX_OK);
+        }
+        for (uint32_t i = 0; i < args.handles; i++) {
+            ZX_ASSERT(zx_handle_duplicate(event, ZX_RIGHT_SAME_RIGHTS, &handles[i]) == ZX_OK);
+        }
+
+        // The handles read back are the ones written next.
+        runner->Measure(name, [&](uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                ZX_ASSERT(zx_channel_write(ch[0], args.write_options, buf->data, args.size,
+                                           handles, args.handles) == ZX_OK);
+                uint32_t actual_bytes, actual_handles;
+                ZX_ASSERT(zx_channel_read(ch[1], 0, buf->data, handles, kMaxMessageSize,
+                                          kMaxHandles, &actual_bytes, &actual_handles) == ZX_OK);
+            }
+        });
+
+        CloseHandles(handles, args.handles);
+        zx_handle_close(event);
+        zx_handle_close(ch[0]);
+        zx_handle_close(ch[1]);
+    }
+}
+
+// A zx_channel_call() answered by a server thread which echoes the message.
+void ChannelCall(Runner* runner, Buffer* buf, const Placement& placement) {
+    static constexpr uint32_t kSizes[] = {64, 4096, 65536};
+    for (uint32_t size : kSizes) {
+        char name[64];
+        snprintf(name, sizeof(name), "channel/call/%uB/%s", size, placement.name);
+        if (!runner->Enabled(name)) {
+            continue;
+        }
+
+        zx_handle_t ch[2];
+        ZX_ASSERT(zx_channel_create(0, &ch[0], &ch[1]) == ZX_OK);
+        PeerThread server;
+        ZX_ASSERT(server.Start(placement.server_cpu, [server_ch = ch[1]] {
+            Buffer reply;
+            while (WaitReadable(server_ch)) {
+                uint32_t actual_bytes, actual_handles;
+                ZX_ASSERT(zx_channel_read(server_ch, 0, reply.data, nullptr, kMaxMessageSize, 0,
+                                          &actual_bytes, &actual_handles) == ZX_OK);
+                ZX_ASSERT(zx_channel_write(server_ch, 0, reply.data, actual_bytes,
+                                           nullptr, 0) == ZX_OK);
+            }
+        }) == ZX_OK);
+
+        fbl::unique_ptr<uint8_t[]> reply(new uint8_t[size]);
+        zx_channel_call_args_t args = {};
+        args.wr_bytes = buf->data;
+        args.wr_num_bytes = size;
+        args.rd_bytes = reply.get();
+        args.rd_num_bytes = size;
+        runner->Measure(name, [&](uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t actual_bytes, actual_handles;
+                ZX_ASSERT(zx_channel_call(ch[0], 0, ZX_TIME_INFINITE, &args, &actual_bytes,
+                                          &actual_handles, nullptr) == ZX_OK);
+            }
+        });
+
+        zx_handle_close(ch[0]);
+        server.Join();
+        zx_handle_close(ch[1]);
+    }
+}
+
+void SocketWriteRead(Runner* runner, Buffer* buf) {
+    static constexpr uint32_t kSizes[] = {64, 1024, 16384};
+    static constexpr struct {
+        const char* name;
+        uint32_t options;
+    } kTypes[] = {
+        {"stream", 0},
+        {"datagram", ZX_SOCKET_DATAGRAM},
+    };
+    for (const auto& type : kTypes) {
+        for (uint32_t size : kSizes) {
+            char name[64];
+            snprintf(name, sizeof(name), "socket/%s/write_read/%uB", type.name, size);
+            if (!runner->Enabled(name)) {
+                continue;
+            }
+
+            zx_handle_t sock[2];
+            ZX_ASSERT(zx_socket_create(type.options, &sock[0], &sock[1]) == ZX_OK);
+            runner->Measure(name, [&](uint32_t count) {
+                for (uint32_t i = 0; i < count; i++) {
+                    size_t actual;
+                    ZX_ASSERT(zx_socket_write(sock[0], 0, buf->data, size, &actual) == ZX_OK &&
+                              actual == size);
+                    ZX_ASSERT(zx_socket_read(sock[1], 0, buf->data, size, &actual) == ZX_OK &&
+                              actual == size);
+                }
+            });
+            zx_handle_close(sock[0]);
+            zx_handle_close(sock[1]);
+        }
+    }
+}
+
+// Reads exactly |size| bytes from a stream socket.
+bool SocketReadAll(zx_handle_t sock, uint8_t* data, size_t size) {
+    while (size > 0) {
+        if (!WaitReadable(sock)) {
+            return false;
+        }
+        size_t actual;
+        ZX_ASSERT(zx_socket_read(sock, 0, data, size, &actual) == ZX_OK);
+        data += actual;
+        size -= actual;
+    }
+    return true;
+}
+
+void SocketRoundTrip(Runner* runner, Buffer* buf, const Placement& placement) {
+    static constexpr uint32_t kSizes[] = {64, 1024};
+    for (uint32_t size : kSizes) {
+        char name[64];
+        snprintf(name, sizeof(name), "socket/stream/round_trip/%uB/%s", size, placement.name);
+        if (!runner->Enabled(name)) {
+            continue;
+        }
+
+        zx_handle_t sock[2];
+        ZX_ASSERT(zx_socket_create(0, &sock[0], &sock[1]) == ZX_OK);
+        PeerThread server;
+        ZX_ASSERT(server.Start(placement.server_cpu, [server_sock = sock[1], size] {
+            Buffer reply;
+            while (SocketReadAll(server_sock, reply.data, size)) {
+                size_t actual;
+                ZX_ASSERT(zx_socket_write(server_sock, 0, reply.data, size, &actual) == ZX_OK &&
+                          actual == size);
+            }
+        }) == ZX_OK);
+
+        runner->Measure(name, [&](uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                size_t actual;
+                ZX_ASSERT(zx_socket_write(sock[0], 0, buf->data, size, &actual) == ZX_OK &&
+                          actual == size);
+                ZX_ASSERT(SocketReadAll(sock[0], buf->data, size));
+            }
+        });
+
+        zx_handle_close(sock[0]);
+        server.Join();
+        zx_handle_close(sock[1]);
+    }
+}
+
+constexpr uint32_t kFifoElemSizes[] = {8, 64};
+constexpr uint32_t kFifoElems = 64;
+
+void FifoWriteRead(Runner* runner, Buffer* buf) {
+    for (uint32_t elem_size : kFifoElemSizes) {
+        char name[64];
+        snprintf(name, sizeof(name), "fifo/write_read/%uB", elem_size);
+        if (!runner->Enabled(name)) {
+            continue;
+        }
+
+        zx_handle_t fifo[2];
+        ZX_ASSERT(zx_fifo_create(kFifoElems, elem_size, 0, &fifo[0], &fifo[1]) == ZX_OK);
+        runner->Measure(name, [&](uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t actual;
+                ZX_ASSERT(zx_fifo_write(fifo[0], buf->data, elem_size, &actual) == ZX_OK);
+                ZX_ASSERT(zx_fifo_read(fifo[1], buf->data, elem_size, &actual) == ZX_OK);
+            }
+        });
+        zx_handle_close(fifo[0]);
+        zx_handle_close(fifo[1]);
+    }
+}
+
+void FifoRoundTrip(Runner* runner, Buffer* buf, const Placement& placement) {
+    for (uint32_t elem_size : kFifoElemSizes) {
+        char name[64];
+        snprintf(name, sizeof(name), "fifo/round_trip/%uB/%s", elem_size, placement.name);
+        if (!runner->Enabled(name)) {
+            continue;
+        }
+
+        zx_handle_t fifo[2];
+        ZX_ASSERT(zx_fifo_create(kFifoElems, elem_size, 0, &fifo[0], &fifo[1]) == ZX_OK);
+        PeerThread server;
+        ZX_ASSERT(server.Start(placement.server_cpu, [server_fifo = fifo[1], elem_size] {
+            uint8_t elem[64];
+            while (WaitReadable(server_fifo)) {
+                uint32_t actual;
+                ZX_ASSERT(zx_fifo_read(server_fifo, elem, elem_size, &actual) == ZX_OK);
+                ZX_ASSERT(zx_fifo_write(server_fifo, elem, elem_size, &actual) == ZX_OK);
+            }
+        }) == ZX_OK);
+
+        runner->Measure(name, [&](uint32_t count) {
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t actual;
+                ZX_ASSERT(zx_fifo_write(fifo[0], buf->data, elem_size, &actual) == ZX_OK);
+                ZX_ASSERT(WaitReadable(fifo[0]));
+                ZX_ASSERT(zx_fifo_read(fifo[0], buf->data, elem_size, &actual) == ZX_OK);
+            }
+        });
+
+        zx_handle_close(fifo[0]);
+        server.Join();
+        zx_handle_close(fifo[1]);
+    }
+}
+
+void PortQueueWait(Runner* runner) {
+    const char* name = "port/queue_wait";
+    if (!runner->Enabled(name)) {
+        return;
+    }
+    zx_handle_t port;
+    ZX_ASSERT(zx_port_create(0, &port) == ZX_OK);
+    zx_port_packet_t packet = {};
+    packet.type = ZX_PKT_TYPE_USER;
+    runner->Measure(name, [&](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            ZX_ASSERT(zx_port_queue(port, &packet, 1) == ZX_OK);
+            ZX_ASSERT(zx_port_wait(port, ZX_TIME_INFINITE, &packet, 1) == ZX_OK);
+        }
+    });
+    zx_handle_close(port);
+}
+
+// Packets are queued on one port for the server, which answers on another.
+void PortRoundTrip(Runner* runner, const Placement& placement) {
+    char name[64];
+    snprintf(name, sizeof(name), "port/round_trip/%s", placement.name);
+    if (!runner->Enabled(name)) {
+        return;
+    }
+
+    static constexpr uint64_t kQuitKey = 1;
+    zx_handle_t ports[2];
+    ZX_ASSERT(zx_port_create(0, &ports[0]) == ZX_OK);
+    ZX_ASSERT(zx_port_create(0, &ports[1]) == ZX_OK);
+    PeerThread server;
+    ZX_ASSERT(server.Start(placement.server_cpu, [request = ports[0], reply = ports[1]] {
+        for (;;) {
+            zx_port_packet_t packet;
+            ZX_ASSERT(zx_port_wait(request, ZX_TIME_INFINITE, &packet, 1) == ZX_OK);
+            if (packet.key == kQuitKey) {
+                break;
+            }
+            ZX_ASSERT(zx_port_queue(reply, &packet, 1) == ZX_OK);
+        }
+    }) == ZX_OK);
+
+    zx_port_packet_t packet = {};
+    packet.type = ZX_PKT_TYPE_USER;
+    runner->Measure(name, [&](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            ZX_ASSERT(zx_port_queue(ports[0], &packet, 1) == ZX_OK);
+            ZX_ASSERT(zx_port_wait(ports[1], ZX_TIME_INFINITE, &packet, 1) == ZX_OK);
+        }
+    });
+
+    packet.key = kQuitKey;
+    ZX_ASSERT(zx_port_queue(ports[0], &packet, 1) == ZX_OK);
+    server.Join();
+    zx_handle_close(ports[0]);
+    zx_handle_close(ports[1]);
+}
+
+void EventSignal(Runner* runner) {
+    const char* name = "event/signal";
+    if (!runner->Enabled(name)) {
+        return;
+    }
+    zx_handle_t event;
+    ZX_ASSERT(zx_event_create(0, &event) == ZX_OK);
+    runner->Measure(name, [&](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            ZX_ASSERT(zx_object_signal(event, 0, ZX_EVENT_SIGNALED) == ZX_OK);
+            ZX_ASSERT(zx_object_signal(event, ZX_EVENT_SIGNALED, 0) == ZX_OK);
+        }
+    });
+    zx_handle_close(event);
+}
+
+// Each side raises ZX_USER_SIGNAL_0 on its peer and waits for it back.
+void EventRoundTrip(Runner* runner, const Placement& placement) {
+    char name[64];
+    snprintf(name, sizeof(name), "event/round_trip/%s", placement.name);
+    if (!runner->Enabled(name)) {
+        return;
+    }
+
+    zx_handle_t pair[2];
+    ZX_ASSERT(zx_eventpair_create(0, &pair[0], &pair[1]) == ZX_OK);
+    PeerThread server;
+    ZX_ASSERT(server.Start(placement.server_cpu, [server_pair = pair[1]] {
+        for (;;) {
+            zx_signals_t observed;
+            ZX_ASSERT(zx_object_wait_one(server_pair, ZX_USER_SIGNAL_0 | ZX_EPAIR_PEER_CLOSED,
+                                         ZX_TIME_INFINITE, &observed) == ZX_OK);
+            if (!(observed & ZX_USER_SIGNAL_0)) {
+                break;
+            }
+            ZX_ASSERT(zx_object_signal(server_pair, ZX_USER_SIGNAL_0, 0) == ZX_OK);
+            ZX_ASSERT(zx_object_signal_peer(server_pair, 0, ZX_USER_SIGNAL_0) == ZX_OK);
+        }
+    }) == ZX_OK);
+
+    runner->Measure(name, [&](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            ZX_ASSERT(zx_object_signal_peer(pair[0], 0, ZX_USER_SIGNAL_0) == ZX_OK);
+            ZX_ASSERT(zx_object_wait_one(pair[0], ZX_USER_SIGNAL_0, ZX_TIME_INFINITE,
+                                         nullptr) == ZX_OK);
+            ZX_ASSERT(zx_object_signal(pair[0], ZX_USER_SIGNAL_0, 0) == ZX_OK);
+        }
+    });
+
+    zx_handle_close(pair[0]);
+    server.Join();
+    zx_handle_close(pair[1]);
+}
+
+void FutexWake(Runner* runner) {
+    const char* name = "futex/wake_no_waiters";
+    if (!runner->Enabled(name)) {
+        return;
+    }
+    zx_futex_t futex = 0;
+    runner->Measure(name, [&](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            ZX_ASSERT(zx_futex_wake(&futex, 1) == ZX_OK);
+        }
+    });
+}
+
+// The futex holds whose turn it is: 1 while the server has a request to
+// answer, 0 once it has answered. |quit| is read by the server on waking.
+struct FutexPingPong {
+    zx_futex_t turn = 0;
+    bool quit = false;
+};
+
+void FutexRoundTrip(Runner* runner, const Placement& placement) {
+    char name[64];
+    snprintf(name, sizeof(name), "futex/round_trip/%s", placement.name);
+    if (!runner->Enabled(name)) {
+        return;
+    }
+
+    FutexPingPong state;
+    PeerThread server;
+    ZX_ASSERT(server.Start(placement.server_cpu, [s = &state] {
+        for (;;) {
+            while (__atomic_load_n(&s->turn, __ATOMIC_ACQUIRE) == 0) {
+                zx_futex_wait(&s->turn, 0, ZX_TIME_INFINITE);
+            }
+            if (__atomic_load_n(&s->quit, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            __atomic_store_n(&s->turn, 0, __ATOMIC_RELEASE);
+            ZX_ASSERT(zx_futex_wake(&s->turn, 1) == ZX_OK);
+        }
+    }) == ZX_OK);
+
+    runner->Measure(name, [&](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            __atomic_store_n(&state.turn, 1, __ATOMIC_RELEASE);
+            ZX_ASSERT(zx_futex_wake(&state.turn, 1) == ZX_OK);
+            while (__atomic_load_n(&state.turn, __ATOMIC_ACQUIRE) == 1) {
+                zx_futex_wait(&state.turn, 1, ZX_TIME_INFINITE);
+            }
+        }
+    });
+
+    __atomic_store_n(&state.quit, true, __ATOMIC_RELEASE);
+    __atomic_store_n(&state.turn, 1, __ATOMIC_RELEASE);
+    ZX_ASSERT(zx_futex_wake(&state.turn, 1) == ZX_OK);
+    server.Join();
+}
+
+} // namespace
+
+void RunIpcBenchmarks(Runner* runner) {
+    Buffer buf;
+    ChannelWriteRead(runner, &buf);
+    SocketWriteRead(runner, &buf);
+    FifoWriteRead(runner, &buf);
+    PortQueueWait(runner);
+    EventSignal(runner);
+    FutexWake(runner);
+
+    // Round trips, with the client on this thread.
+    const Placement* placements;
+    const size_t num_placements = GetPlacements(&placements);
+    for (size_t i = 0; i < num_placements; i++) {
+        const Placement& placement = placements[i];
+        ZX_ASSERT(PinCurrentThread(placement.client_cpu) == ZX_OK);
+        ChannelCall(runner, &buf, placement);
+        SocketRoundTrip(runner, &buf, placement);
+        FifoRoundTrip(runner, &buf, placement);
+        PortRoundTrip(runner, placement);
+        EventRoundTrip(runner, placement);
+        FutexRoundTrip(runner, placement);
+    }
+    ZX_ASSERT(PinCurrentThread(kAnyCpu) == ZX_OK);
+}
+
+} // namespace bench
@@ -0,0 +1,98 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark.h"
+
+namespace {
+
+void argument_error(const char* argv0, const char* message) {
+    fprintf(stderr, "%s: error: %s\nRun with -h for help.\n", argv0, message);
+    exit(EXIT_FAILURE);
+}
+
+uint32_t parse_count(const char* argv0, const char* arg) {
+    errno = 0;
+    char* endptr = nullptr;
+    unsigned long long v = strtoull(arg, &endptr, 10);
+    if (errno != 0 || *endptr != '\0' || v == 0 || v > UINT32_MAX) {
+        argument_error(argv0, "invalid numeric option value");
+    }
+    return static_cast<uint32_t>(v);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    static constexpr char help[] =
+        "Usage: %s [options ...]\n"
+        "\n"
+        "Options:\n"
+        "  -h       show help (this)\n"
+        "  -l       list the benchmarks instead of running them\n"
+        "  -f STR   only run benchmarks whose names contain STR\n"
+        "  -n N     take N timed samples per benchmark (default: 1000)\n"
+        "  -b N     time batches of N operations per sample (default: 10)\n"
+        "  -w N     take N untimed samples first (default: 20)\n"
+        "  -o FILE  also write the results to FILE as JSON\n";
+
+    bench::Options options;
+    const char* json_path = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "+hlf:n:b:w:o:")) != -1) {
+        switch (opt) {
+        case 'h':
+            printf(help, argv[0]);
+            return EXIT_SUCCESS;
+        case 'l':
+            options.list = true;
+            break;
+        case 'f':
+            options.filter = optarg;
+            break;
+        case 'n':
+            options.samples = parse_count(argv[0], optarg);
+            break;
+        case 'b':
+            options.batch = parse_count(argv[0], optarg);
+            break;
+        case 'w':
+            options.warmup = parse_count(argv[0], optarg);
+            break;
+        case 'o':
+            json_path = optarg;
+            break;
+        default: // '?'
+            argument_error(argv[0], "invalid option");
+            break;
+        }
+    }
+    if (optind < argc) {
+        argument_error(argv[0], "unexpected positional argument");
+    }
+
+    if (json_path != nullptr && !options.list) {
+        if ((options.json = fopen(json_path, "w")) == nullptr) {
+            fprintf(stderr, "%s: error: cannot open %s\n", argv[0], json_path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench::Runner runner(options);
+    bench::RunIpcBenchmarks(&runner);
+    bench::RunVmBenchmarks(&runner);
+    bench::RunScalingBenchmarks(&runner);
+    runner.Finish();
+
+    if (options.json != nullptr && fclose(options.json) != 0) {
+        fprintf(stderr, "%s: error: cannot write %s\n", argv[0], json_path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
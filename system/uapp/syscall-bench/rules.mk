@@ -0,0 +1,30 @@
+# Copyright 2018 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := userapp
+MODULE_GROUP := misc
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/benchmark.cpp \
+    $(LOCAL_DIR)/ipc.cpp \
+    $(LOCAL_DIR)/main.cpp \
+    $(LOCAL_DIR)/scaling.cpp \
+    $(LOCAL_DIR)/vm.cpp \
+
+MODULE_NAME := syscall-bench
+
+MODULE_STATIC_LIBS := \
+    system/ulib/zxcpp \
+    system/ulib/fbl
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/fdio \
+    system/ulib/zircon
+
+include make/module.mk
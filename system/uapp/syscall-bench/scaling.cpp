@@ -0,0 +1,196 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include "benchmark.h"
+
+namespace bench {
+namespace {
+
+// One client and server pair doing round trips, both pinned to the same
+// CPU. Pairs on different CPUs share nothing, so any slowdown as more of
+// them run at once comes from contention in the kernel.
+class Lane {
+public:
+    virtual ~Lane() = default;
+
+    // Does |count| round trips with the server.
+    virtual void RoundTrips(uint32_t count) = 0;
+};
+
+class FutexLane final : public Lane {
+public:
+    explicit FutexLane(uint32_t cpu) {
+        ZX_ASSERT(server_.Start(cpu, [this] {
+            for (;;) {
+                while (__atomic_load_n(&turn_, __ATOMIC_ACQUIRE) == 0) {
+                    zx_futex_wait(&turn_, 0, ZX_TIME_INFINITE);
+                }
+                if (__atomic_load_n(&quit_, __ATOMIC_ACQUIRE)) {
+                    break;
+                }
+                __atomic_store_n(&turn_, 0, __ATOMIC_RELEASE);
+                ZX_ASSERT(zx_futex_wake(&turn_, 1) == ZX_OK);
+            }
+        }) == ZX_OK);
+    }
+
+    ~FutexLane() override {
+        __atomic_store_n(&quit_, true, __ATOMIC_RELEASE);
+        __atomic_store_n(&turn_, 1, __ATOMIC_RELEASE);
+        ZX_ASSERT(zx_futex_wake(&turn_, 1) == ZX_OK);
+        server_.Join();
+    }
+
+    void RoundTrips(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            __atomic_store_n(&turn_, 1, __ATOMIC_RELEASE);
+            ZX_ASSERT(zx_futex_wake(&turn_, 1) == ZX_OK);
+            while (__atomic_load_n(&turn_, __ATOMIC_ACQUIRE) == 1) {
+                zx_futex_wait(&turn_, 1, ZX_TIME_INFINITE);
+            }
+        }
+    }
+
+private:
+    // 1 while the server has a request to answer, 0 once it has answered.
+    zx_futex_t turn_ = 0;
+    bool quit_ = false;
+    PeerThread server_;
+};
+
+class EventLane final : public Lane {
+public:
+    explicit EventLane(uint32_t cpu) {
+        ZX_ASSERT(zx_eventpair_create(0, &client_, &server_handle_) == ZX_OK);
+        ZX_ASSERT(server_.Start(cpu, [handle = server_handle_] {
+            for (;;) {
+                zx_signals_t observed;
+                ZX_ASSERT(zx_object_wait_one(handle, ZX_USER_SIGNAL_0 | ZX_EPAIR_PEER_CLOSED,
+                                             ZX_TIME_INFINITE, &observed) == ZX_OK);
+                if (!(observed & ZX_USER_SIGNAL_0)) {
+                    break;
+                }
+                ZX_ASSERT(zx_object_signal(handle, ZX_USER_SIGNAL_0, 0) == ZX_OK);
+                ZX_ASSERT(zx_object_signal_peer(handle, 0, ZX_USER_SIGNAL_0) == ZX_OK);
+            }
+        }) == ZX_OK);
+    }
+
+    ~EventLane() override {
+        zx_handle_close(client_);
+        server_.Join();
+        zx_handle_close(server_handle_);
+    }
+
+    void RoundTrips(uint32_t count) override {
+        for (uint32_t i = 0; i < count; i++) {
+            ZX_ASSERT(zx_object_signal_peer(client_, 0, ZX_USER_SIGNAL_0) == ZX_OK);
+            ZX_ASSERT(zx_object_wait_one(client_, ZX_USER_SIGNAL_0, ZX_TIME_INFINITE,
+                                         nullptr) == ZX_OK);
+            ZX_ASSERT(zx_object_signal(client_, ZX_USER_SIGNAL_0, 0) == ZX_OK);
+        }
+    }
+
+private:
+    zx_handle_t client_;
+    zx_handle_t server_handle_;
+    PeerThread server_;
+};
+
+// Starts every client on a sample at once and waits for the last to finish.
+struct StartingGate {
+    // Bumped to start a sample; the clients wait for it to change.
+    zx_futex_t generation = 0;
+    // Clients yet to finish the current sample.
+    zx_futex_t remaining = 0;
+    uint32_t count = 0;
+    bool quit = false;
+};
+
+void ClientLoop(StartingGate* gate, Lane* lane) {
+    int seen = 0;
+    for (;;) {
+        int generation;
+        while ((generation = __atomic_load_n(&gate->generation, __ATOMIC_ACQUIRE)) == seen) {
+            zx_futex_wait(&gate->generation, seen, ZX_TIME_INFINITE);
+        }
+        seen = generation;
+        if (__atomic_load_n(&gate->quit, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        lane->RoundTrips(gate->count);
+        if (__atomic_sub_fetch(&gate->remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+            ZX_ASSERT(zx_futex_wake(&gate->remaining, 1) == ZX_OK);
+        }
+    }
+}
+
+void OpenGate(StartingGate* gate) {
+    __atomic_add_fetch(&gate->generation, 1, __ATOMIC_RELEASE);
+    ZX_ASSERT(zx_futex_wake(&gate->generation, UINT32_MAX) == ZX_OK);
+}
+
+// Round trips on the first |cpus| CPUs at once, one pair on each. Reported
+// per round trip on one CPU, so with perfect scaling the time is the same
+// for every CPU count.
+template <typename LaneType>
+void Scaling(Runner* runner, const char* kind, uint32_t cpus) {
+    char name[64];
+    snprintf(name, sizeof(name), "scaling/%s/%ucpu", kind, cpus);
+    if (!runner->Enabled(name)) {
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<fbl::unique_ptr<Lane>[]> lanes(new (&ac) fbl::unique_ptr<Lane>[cpus]);
+    ZX_ASSERT(ac.check());
+    fbl::unique_ptr<PeerThread[]> clients(new (&ac) PeerThread[cpus]);
+    ZX_ASSERT(ac.check());
+
+    StartingGate gate;
+    for (uint32_t cpu = 0; cpu < cpus; cpu++) {
+        lanes[cpu].reset(new (&ac) LaneType(cpu));
+        ZX_ASSERT(ac.check());
+        ZX_ASSERT(clients[cpu].Start(cpu, [g = &gate, lane = lanes[cpu].get()] {
+            ClientLoop(g, lane);
+        }) == ZX_OK);
+    }
+
+    runner->Measure(name, [&](uint32_t count) {
+        gate.count = count;
+        __atomic_store_n(&gate.remaining, static_cast<int>(cpus), __ATOMIC_RELAXED);
+        OpenGate(&gate);
+        int remaining;
+        while ((remaining = __atomic_load_n(&gate.remaining, __ATOMIC_ACQUIRE)) != 0) {
+            zx_futex_wait(&gate.remaining, remaining, ZX_TIME_INFINITE);
+        }
+    });
+
+    __atomic_store_n(&gate.quit, true, __ATOMIC_RELEASE);
+    OpenGate(&gate);
+    for (uint32_t cpu = 0; cpu < cpus; cpu++) {
+        clients[cpu].Join();
+    }
+}
+
+} // namespace
+
+void RunScalingBenchmarks(Runner* runner) {
+    // 1, 2, 4, ... CPUs, and all of them.
+    const uint32_t num_cpus = zx_system_get_num_cpus();
+    for (uint32_t cpus = 1;; cpus = cpus * 2 < num_cpus ? cpus * 2 : num_cpus) {
+        Scaling<FutexLane>(runner, "futex", cpus);
+        Scaling<EventLane>(runner, "event", cpus);
+        if (cpus == num_cpus) {
+            break;
+        }
+    }
+}
+
+} // namespace bench
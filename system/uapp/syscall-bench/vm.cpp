@@ -0,0 +1,120 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <string.h>
+#include <threads.h>
+
+#include <fbl/unique_ptr.h>
+#include <zircon/assert.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+#include "benchmark.h"
+
+namespace bench {
+namespace {
+
+constexpr size_t kVmoSizes[] = {4096, 65536, 1 << 20};
+constexpr size_t kMaxVmoSize = 1 << 20;
+
+void VmoReadWrite(Runner* runner) {
+    fbl::unique_ptr<uint8_t[]> buf(new uint8_t[kMaxVmoSize]);
+    memset(buf.get(), 0x5a, kMaxVmoSize);
+    zx_handle_t vmo;
+    ZX_ASSERT(zx_vmo_create(kMaxVmoSize, 0, &vmo) == ZX_OK);
+
+    for (size_t size : kVmoSizes) {
+        char name[64];
+        snprintf(name, sizeof(name), "vmo/write/%zuB", size);
+        if (runner->Enabled(name)) {
+            runner->Measure(name, [&](uint32_t count) {
+                for (uint32_t i = 0; i < count; i++) {
+                    size_t actual;
+                    ZX_ASSERT(zx_vmo_write(vmo, buf.get(), 0, size, &actual) == ZX_OK);
+                }
+            });
+        }
+        snprintf(name, sizeof(name), "vmo/read/%zuB", size);
+        if (runner->Enabled(name)) {
+            runner->Measure(name, [&](uint32_t count) {
+                for (uint32_t i = 0; i < count; i++) {
+                    size_t actual;
+                    ZX_ASSERT(zx_vmo_read(vmo, buf.get(), 0, size, &actual) == ZX_OK);
+                }
+            });
+        }
+    }
+    zx_handle_close(vmo);
+}
+
+// Maps and unmaps the pages of a committed VMO, with and without faulting
+// them in through the mapping.
+void VmarMapUnmap(Runner* runner) {
+    zx_handle_t vmo;
+    ZX_ASSERT(zx_vmo_create(kMaxVmoSize, 0, &vmo) == ZX_OK);
+    ZX_ASSERT(zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT, 0, kMaxVmoSize, nullptr, 0) == ZX_OK);
+
+    static constexpr struct {
+        const char* name;
+        uint32_t flags;
+        bool touch;
+    } kModes[] = {
+        {"map_unmap", 0, false},
+        {"map_range_unmap", ZX_VM_FLAG_MAP_RANGE, false},
+        {"map_touch_unmap", 0, true},
+    };
+    for (const auto& mode : kModes) {
+        for (size_t size : kVmoSizes) {
+            char name[64];
+            snprintf(name, sizeof(name), "vmar/%s/%zuB", mode.name, size);
+            if (!runner->Enabled(name)) {
+                continue;
+            }
+            const uint32_t flags = ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE | mode.flags;
+            runner->Measure(name, [&](uint32_t count) {
+                for (uint32_t i = 0; i < count; i++) {
+                    uintptr_t addr;
+                    ZX_ASSERT(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size, flags,
+                                          &addr) == ZX_OK);
+                    if (mode.touch) {
+                        for (size_t off = 0; off < size; off += PAGE_SIZE) {
+                            reinterpret_cast<volatile uint8_t*>(addr)[off] = 1;
+                        }
+                    }
+                    ZX_ASSERT(zx_vmar_unmap(zx_vmar_root_self(), addr, size) == ZX_OK);
+                }
+            });
+        }
+    }
+    zx_handle_close(vmo);
+}
+
+int ThreadNop(void*) {
+    return 0;
+}
+
+void ThreadCreateExit(Runner* runner) {
+    const char* name = "thread/create_join";
+    if (!runner->Enabled(name)) {
+        return;
+    }
+    runner->Measure(name, [](uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            thrd_t thread;
+            ZX_ASSERT(thrd_create(&thread, ThreadNop, nullptr) == thrd_success);
+            ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+        }
+    });
+}
+
+} // namespace
+
+void RunVmBenchmarks(Runner* runner) {
+    VmoReadWrite(runner);
+    VmarMapUnmap(runner);
+    ThreadCreateExit(runner);
+}
+
+} // namespace bench
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <async/cpp/handler.h>
 #include <async/task.h>
 #include <fbl/function.h>
 #include <fbl/macros.h>
@@ -28,8 +29,8 @@ public:
     // The result must be |ASYNC_TASK_FINISHED| if |status| was not |ZX_OK|.
     //
     // It is safe for the handler to destroy itself when returning |ASYNC_TASK_FINISHED|.
-    using Handler = fbl::Function<async_task_result_t(async_t* async,
-                                                      zx_status_t status)>;
+    using Handler = HandlerFunction<async_task_result_t(async_t* async,
+                                                        zx_status_t status)>;
 
     // Initializes the properties of the task and binds it to an asynchronous
     // dispatcher.
@@ -0,0 +1,22 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <fbl/function.h>
+
+namespace async {
+
+// The handlers of the C++ helpers keep callables of up to this size inline,
+// which covers the usual lambda capturing |this| and a few pointers or
+// values, so that setting a handler does not allocate.  Larger callables
+// are still accepted, and are moved to the heap.
+constexpr size_t kHandlerInlineSize = 4 * sizeof(void*);
+
+template <typename T>
+using HandlerFunction = fbl::SizedFunction<T, kHandlerInlineSize>;
+
+} // namespace async
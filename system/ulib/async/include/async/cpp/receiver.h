@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <async/cpp/handler.h>
 #include <async/dispatcher.h>
 #include <async/receiver.h>
 #include <fbl/function.h>
@@ -25,9 +26,9 @@ public:
     //
     // It is safe for the handler to destroy itself when there are no remaining
     // packets pending delivery to it.
-    using Handler = fbl::Function<void(async_t* async,
-                                       zx_status_t status,
-                                       const zx_packet_user_t* data)>;
+    using Handler = HandlerFunction<void(async_t* async,
+                                         zx_status_t status,
+                                         const zx_packet_user_t* data)>;
 
     // Initializes the properties of the receiver.
     explicit Receiver(uint32_t flags = 0u);
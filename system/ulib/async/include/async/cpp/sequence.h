@@ -0,0 +1,188 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <async/task.h>
+#include <async/wait.h>
+#include <fbl/macros.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls/port.h>
+
+namespace async {
+
+// Runs a sequence of steps, each resumed once the previous one's wait for
+// signals, a deadline or both has finished, much as a coroutine would
+// |co_await| them.  The steps are member functions of the object which
+// holds the sequence, so the state carried from one step to the next lives
+// in that object rather than in per-step handler closures, and awaiting
+// allocates nothing.
+//
+// A step awaits at most one thing at a time.  When what it awaited
+// finishes, the next step is invoked with:
+//   |ZX_OK| if the signals were observed (see |observed()|) or the
+//   deadline passed,
+//   |ZX_ERR_TIMED_OUT| if the deadline passed before the signals arrived,
+//   or the status of a wait which failed.
+// A step which awaits nothing ends the sequence; it may then destroy the
+// object holding it.
+//
+// Objects holding sequences can be allocated per request from a slab, such
+// as an |fbl::SlabAllocator| with |fbl::NullLock| kept alongside the loop.
+//
+// This class is NOT thread-safe; it can only be used with single-threaded
+// asynchronous dispatchers.  If the dispatcher shuts down, pending steps are
+// abandoned without being invoked.
+//
+// Example usage:
+//
+//   class Request {
+//       void Start(async_t* async) {
+//           seq_.AwaitReadable(async, channel_, &Request::OnReadable, deadline);
+//       }
+//       void OnReadable(async_t* async, zx_status_t status) {
+//           if (status != ZX_OK) { delete this; return; }
+//           ... read and reply ...
+//           seq_.AwaitDeadline(async, zx_deadline_after(ZX_SEC(1)), &Request::OnIdle);
+//       }
+//       void OnIdle(async_t* async, zx_status_t status) { ... }
+//       async::Sequence<Request> seq_{this};
+//   };
+template <class Class>
+class Sequence final : private async_wait_t, private async_task_t {
+public:
+    using Step = void (Class::*)(async_t* async, zx_status_t status);
+
+    explicit Sequence(Class* ptr)
+        : async_wait_t{{ASYNC_STATE_INIT}, &Sequence::WaitHandler, ZX_HANDLE_INVALID,
+                       ZX_SIGNAL_NONE, 0u, {}},
+          async_task_t{{ASYNC_STATE_INIT}, &Sequence::TaskHandler, ZX_TIME_INFINITE, 0u, {}},
+          ptr_(ptr) {}
+
+    // The sequence must not be destroyed while a step is pending unless the
+    // dispatcher itself has been destroyed.
+    ~Sequence() = default;
+
+    // True while the sequence is waiting to invoke its next step.
+    bool is_pending() const { return step_ != nullptr; }
+
+    // The signals observed by the last wait which completed.
+    zx_signals_t observed() const { return observed_; }
+
+    // Resumes at |step| once |object| asserts one of the |trigger| signals,
+    // or with |ZX_ERR_TIMED_OUT| at |deadline| if that comes first.
+    zx_status_t AwaitSignals(async_t* async, zx_handle_t object, zx_signals_t trigger,
+                             Step step, zx_time_t deadline = ZX_TIME_INFINITE) {
+        ZX_DEBUG_ASSERT(!is_pending());
+        async_wait_t::object = object;
+        async_wait_t::trigger = trigger;
+        zx_status_t status = async_begin_wait(async, this);
+        if (status != ZX_OK)
+            return status;
+        waiting_ = true;
+        if (deadline != ZX_TIME_INFINITE) {
+            async_task_t::deadline = deadline;
+            status = async_post_task(async, this);
+            if (status != ZX_OK) {
+                zx_status_t cancel_status = async_cancel_wait(async, this);
+                ZX_DEBUG_ASSERT_MSG(cancel_status == ZX_OK, "cancel_status=%d", cancel_status);
+                waiting_ = false;
+                return status;
+            }
+            timing_ = true;
+        }
+        step_ = step;
+        return ZX_OK;
+    }
+
+    // Resumes at |step| once a message can be read from |channel| or its
+    // peer has closed, or with |ZX_ERR_TIMED_OUT| at |deadline| if that
+    // comes first.
+    zx_status_t AwaitReadable(async_t* async, zx_handle_t channel, Step step,
+                              zx_time_t deadline = ZX_TIME_INFINITE) {
+        return AwaitSignals(async, channel, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                            step, deadline);
+    }
+
+    // Resumes at |step| once |deadline| has passed.
+    zx_status_t AwaitDeadline(async_t* async, zx_time_t deadline, Step step) {
+        ZX_DEBUG_ASSERT(!is_pending());
+        async_task_t::deadline = deadline;
+        zx_status_t status = async_post_task(async, this);
+        if (status != ZX_OK)
+            return status;
+        timing_ = true;
+        step_ = step;
+        return ZX_OK;
+    }
+
+    // Stops waiting; the pending step will not be invoked.
+    //
+    // Returns |ZX_ERR_NOT_FOUND| if no step was pending.
+    zx_status_t Cancel(async_t* async) {
+        if (!is_pending())
+            return ZX_ERR_NOT_FOUND;
+        zx_status_t status = ZX_OK;
+        if (waiting_)
+            status = async_cancel_wait(async, this);
+        if (timing_) {
+            zx_status_t task_status = async_cancel_task(async, this);
+            if (status == ZX_OK)
+                status = task_status;
+        }
+        waiting_ = false;
+        timing_ = false;
+        step_ = nullptr;
+        return status;
+    }
+
+private:
+    // Invokes the pending step, which may await again or destroy |this|.
+    void Resume(async_t* async, zx_status_t status) {
+        Step step = step_;
+        step_ = nullptr;
+        (ptr_->*step)(async, status);
+    }
+
+    static async_wait_result_t WaitHandler(async_t* async, async_wait_t* wait,
+                                           zx_status_t status,
+                                           const zx_packet_signal_t* signal) {
+        auto self = static_cast<Sequence*>(wait);
+        self->waiting_ = false;
+        self->observed_ = signal ? signal->observed : ZX_SIGNAL_NONE;
+        if (self->timing_) {
+            zx_status_t cancel_status = async_cancel_task(async, self);
+            ZX_DEBUG_ASSERT_MSG(cancel_status == ZX_OK, "cancel_status=%d", cancel_status);
+            self->timing_ = false;
+        }
+        self->Resume(async, status);
+        return ASYNC_WAIT_FINISHED;
+    }
+
+    static async_task_result_t TaskHandler(async_t* async, async_task_t* task,
+                                           zx_status_t status) {
+        auto self = static_cast<Sequence*>(task);
+        self->timing_ = false;
+        if (self->waiting_) {
+            zx_status_t cancel_status = async_cancel_wait(async, self);
+            ZX_DEBUG_ASSERT_MSG(cancel_status == ZX_OK, "cancel_status=%d", cancel_status);
+            self->waiting_ = false;
+            self->observed_ = ZX_SIGNAL_NONE;
+            if (status == ZX_OK)
+                status = ZX_ERR_TIMED_OUT;
+        }
+        self->Resume(async, status);
+        return ASYNC_TASK_FINISHED;
+    }
+
+    Class* const ptr_;
+    Step step_ = nullptr;
+    zx_signals_t observed_ = ZX_SIGNAL_NONE;
+    bool waiting_ = false;
+    bool timing_ = false;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Sequence);
+};
+
+} // namespace async
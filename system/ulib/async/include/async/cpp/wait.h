@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <async/cpp/handler.h>
 #include <async/dispatcher.h>
 #include <async/wait.h>
 #include <fbl/function.h>
@@ -41,9 +42,9 @@ public:
     // The result must be |ASYNC_WAIT_FINISHED| if |status| was not |ZX_OK|.
     //
     // It is safe for the handler to destroy itself when returning |ASYNC_WAIT_FINISHED|.
-    using Handler = fbl::Function<async_wait_result_t(async_t* async,
-                                                      zx_status_t status,
-                                                      const zx_packet_signal_t* signal)>;
+    using Handler = HandlerFunction<async_wait_result_t(async_t* async,
+                                                        zx_status_t status,
+                                                        const zx_packet_signal_t* signal)>;
 
     // Initializes the properties of the wait operation.
     explicit Wait(zx_handle_t object = ZX_HANDLE_INVALID,
@@ -69,7 +70,7 @@ public:
     zx_signals_t trigger() const { return async_wait_t::trigger; }
     void set_trigger(zx_signals_t trigger) { async_wait_t::trigger = trigger; }
 
-    // Valid flags: |ASYNC_FLAG_HANDLE_SHUTDOWN|.
+    // Valid flags: |ASYNC_FLAG_HANDLE_SHUTDOWN|, |ASYNC_FLAG_PERSISTENT|.
     uint32_t flags() const { return async_wait_t::flags; }
     void set_flags(uint32_t flags) { async_wait_t::flags = flags; }
 
@@ -131,7 +132,7 @@ public:
     zx_signals_t trigger() const { return async_wait_t::trigger; }
     void set_trigger(zx_signals_t trigger) { async_wait_t::trigger = trigger; }
 
-    // Valid flags: |ASYNC_FLAG_HANDLE_SHUTDOWN|.
+    // Valid flags: |ASYNC_FLAG_HANDLE_SHUTDOWN|, |ASYNC_FLAG_PERSISTENT|.
     uint32_t flags() const { return async_wait_t::flags; }
     void set_flags(uint32_t flags) { async_wait_t::flags = flags; }
 
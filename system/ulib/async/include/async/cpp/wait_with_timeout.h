@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <async/cpp/handler.h>
 #include <async/task.h>
 #include <async/wait.h>
 #include <fbl/function.h>
@@ -35,9 +36,9 @@ public:
     // The result must be |ASYNC_WAIT_FINISHED| if |status| was not |ZX_OK|.
     //
     // It is safe for the handler to destroy itself when returning |ASYNC_WAIT_FINISHED|.
-    using Handler = fbl::Function<async_wait_result_t(async_t* async,
-                                                      zx_status_t status,
-                                                      const zx_packet_signal_t* signal)>;
+    using Handler = HandlerFunction<async_wait_result_t(async_t* async,
+                                                        zx_status_t status,
+                                                        const zx_packet_signal_t* signal)>;
 
     // Initializes the properties of the wait with timeout operation.
     explicit WaitWithTimeout(zx_handle_t object = ZX_HANDLE_INVALID,
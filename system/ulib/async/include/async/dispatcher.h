@@ -40,6 +40,22 @@ enum {
     // This flag only applies to pending waits and tasks; receivers will
     // not be notified of shutdown.
     ASYNC_FLAG_HANDLE_SHUTDOWN = 1 << 0,
+
+    // Keeps a wait registered with the dispatcher between invocations of
+    // its handler, so that repeating it does not have to begin it again.
+    //
+    // The handler is invoked whenever one of the trigger signals becomes
+    // asserted, and |signal->observed| holds the newly asserted signals.
+    // It is not invoked again while they stay asserted, so the handler
+    // should consume all the pending work (for example, read a channel
+    // until it is empty) before it returns |ASYNC_WAIT_AGAIN|.  Changes
+    // the handler makes to the wait's properties are not applied.
+    //
+    // On a dispatcher with several threads the handler may be invoked
+    // again before it has returned.
+    //
+    // This flag only applies to waits.  See |ZX_WAIT_ASYNC_EDGE|.
+    ASYNC_FLAG_PERSISTENT = 1 << 1,
 };
 
 // Asynchronous dispatcher interface.
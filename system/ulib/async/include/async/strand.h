@@ -0,0 +1,69 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdbool.h>
+#include <threads.h>
+
+#include <zircon/listnode.h>
+
+#include <async/receiver.h>
+
+__BEGIN_CDECLS
+
+// A strand runs the work posted to it one item at a time, in the order it
+// was posted.  Work posted to different strands may run concurrently on a
+// dispatcher with several threads, so a strand ties the ordering of work to
+// an object (say, a connection) rather than to the whole dispatcher.
+//
+// A strand delivers its work through a packet receiver, so it works with any
+// dispatcher which supports |async_queue_packet()|.
+
+// Handles an item of work posted to a strand.
+//
+// It is safe for the handler to destroy the work item, but not the strand.
+typedef struct async_strand_work async_strand_work_t;
+typedef void(async_strand_handler_t)(async_t* async, async_strand_work_t* work);
+
+// Context for an item of work posted to a strand.
+// A separate instance must be used for each item of work.
+struct async_strand_work {
+    // Private state owned by the strand, initialize to zero with |ASYNC_STATE_INIT|.
+    async_state_t state;
+    // The handler to invoke to perform the work.
+    async_strand_handler_t* handler;
+};
+
+// A strand.  Initialize with |async_strand_init()|; the contents are private.
+//
+// The strand must outlive the work posted to it, and must not be destroyed
+// by one of its own handlers.
+typedef struct async_strand {
+    async_receiver_t receiver;
+    mtx_t lock;
+    list_node_t queue; // work not yet run, earliest posted first
+    bool scheduled; // true while a packet is queued for the strand or it is running
+} async_strand_t;
+
+// Initializes a strand.
+void async_strand_init(async_strand_t* strand);
+
+// Posts work to run on |async| after all work previously posted to the strand.
+//
+// Every item of work posted to one strand must use the same dispatcher.
+//
+// Returns |ZX_OK| if the work was successfully posted.
+// Returns |ZX_ERR_BAD_STATE| if the dispatcher shut down.
+// Returns |ZX_ERR_NOT_SUPPORTED| if the dispatcher does not support queueing packets.
+zx_status_t async_strand_post(async_t* async, async_strand_t* strand,
+                              async_strand_work_t* work);
+
+// Cancels work posted to a strand which has not yet started to run.
+//
+// Returns |ZX_OK| if the work was removed before it ran.
+// Returns |ZX_ERR_NOT_FOUND| if the work was not pending on the strand.
+zx_status_t async_strand_cancel(async_strand_t* strand, async_strand_work_t* work);
+
+__END_CDECLS
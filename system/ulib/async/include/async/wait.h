@@ -51,7 +51,7 @@ struct async_wait {
     zx_handle_t object;
     // The set of signals to wait for.
     zx_signals_t trigger;
-    // Valid flags: |ASYNC_FLAG_HANDLE_SHUTDOWN|.
+    // Valid flags: |ASYNC_FLAG_HANDLE_SHUTDOWN|, |ASYNC_FLAG_PERSISTENT|.
     uint32_t flags;
     // Reserved for future use, set to zero.
     uint32_t reserved;
@@ -11,6 +11,7 @@
 #include <zircon/assert.h>
 #include <zircon/listnode.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
 
 #include <async/receiver.h>
 #include <async/task.h>
@@ -19,6 +20,11 @@
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// The most packets a loop holds after dequeuing them from its port in
+// bulk, across all of its threads.  One more than a thread's share is
+// requested so the waiting thread can dispatch the first packet itself.
+#define MAX_PENDING_PACKETS (ZX_PORT_WAIT_MANY_MAX - 1u)
+
 static zx_status_t async_loop_begin_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait);
 static zx_status_t async_loop_post_task(async_t* async, async_task_t* task);
@@ -33,11 +39,42 @@ static const async_ops_t async_loop_ops = {
     .queue_packet = async_loop_queue_packet,
 };
 
+// The number of pending tasks the task heap first makes room for.
+#define INITIAL_TASK_CAPACITY (16u)
+
+// Marks the state of a task which is in the task heap; its second word
+// holds the task's index in the heap.  The value cannot be a list node
+// pointer, so tasks in |due_list| are told apart from those in the heap.
+#define TASK_IN_HEAP ((uintptr_t)1u)
+
+// Marks the state of a task which was posted but not yet moved into the
+// heap; its second word links to the task posted before it.
+#define TASK_POSTED ((uintptr_t)2u)
+
 typedef struct thread_record {
     list_node_t node;
     thrd_t thread;
 } thread_record_t;
 
+// A thread running the loop.  Packets the thread dequeued from the port in
+// bulk wait in its queue until it dispatches them or an idle thread steals
+// them.
+typedef struct async_loop_worker {
+    list_node_t node;
+    mtx_t lock; // guards the queue
+    zx_port_packet_t queue[MAX_PENDING_PACKETS];
+    uint32_t head; // index of the oldest queued packet
+    uint32_t count; // number of queued packets
+} async_loop_worker_t;
+
+// An entry in the task heap.  The deadline is copied out of the task so
+// that sifting does not touch the tasks themselves.
+typedef struct task_entry {
+    zx_time_t deadline;
+    uint64_t seq; // orders tasks with equal deadlines by when they were posted
+    async_task_t* task;
+} task_entry_t;
+
 typedef struct async_loop {
     async_t async; // must be first
     async_loop_config_t config; // immutable
@@ -46,16 +83,58 @@ typedef struct async_loop {
 
     _Atomic async_loop_state_t state;
     atomic_uint active_threads; // number of active dispatch threads
+    atomic_uint idle_threads; // number of threads blocked in the port
 
-    mtx_t lock; // guards the lists and the dispatching tasks flag
-    bool dispatching_tasks; // true while the loop is busy dispatching tasks
+    mtx_t lock; // guards the wait, thread and worker lists and |pending|
     list_node_t wait_list; // most recently added first
-    list_node_t task_list; // pending tasks, earliest deadline first
-    list_node_t due_list; // due tasks, earliest deadline first
     list_node_t thread_list; // earliest created thread first
+    list_node_t worker_list; // threads running the loop, earliest first
+
+    // Packets left queued by threads which stopped running the loop,
+    // oldest first.  Guarded by |lock|.
+    zx_port_packet_t pending[MAX_PENDING_PACKETS];
+    uint32_t pending_head; // index of the oldest pending packet
+    uint32_t pending_count; // number of pending packets
+    // Packets which may still be dequeued in bulk.  Each packet held in a
+    // worker's queue or in |pending| uses one up, so |pending| always has
+    // room for what a departing thread leaves behind.
+    atomic_uint pending_free;
+    atomic_uint queued_packets; // packets held in worker queues and |pending|
+
+    mtx_t task_lock; // guards the task heap, |due_list| and |dispatching_tasks|
+    bool dispatching_tasks; // true while the loop is busy dispatching tasks
+    list_node_t due_list; // due tasks, earliest deadline first
+
+    // Pending tasks, kept as a binary min-heap by deadline then posting
+    // order so that posting and canceling take O(log n) steps.
+    // Guarded by |task_lock|.
+    task_entry_t* task_heap;
+    size_t task_heap_count; // number of tasks in the heap
+    uint64_t task_seq; // sequence number of the next task inserted
+    // Room in the heap, at least the number of tasks the loop holds.  Only
+    // grows, and only under |task_lock|.
+    _Atomic size_t task_capacity;
+    _Atomic size_t task_count; // tasks posted and neither finished nor canceled
+
+    // Tasks posted without taking |task_lock|, most recent first.  They are
+    // moved into the heap whenever the loop next looks at it.
+    _Atomic(async_task_t*) posted_tasks;
+    // By when the loop will next look at the task heap without being
+    // prompted; zero if it is about to anyway.  Posting a task which is due
+    // earlier fires the timer.
+    _Atomic zx_time_t timer_deadline;
 } async_loop_t;
 
-static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
+static zx_status_t async_loop_run_once(async_loop_t* loop, async_loop_worker_t* worker,
+                                       zx_time_t deadline);
+static void async_loop_retire_worker(async_loop_t* loop, async_loop_worker_t* worker);
+static bool async_loop_take_queued(async_loop_t* loop, async_loop_worker_t* worker,
+                                   zx_port_packet_t* out_packet);
+static bool async_loop_steal_packets(async_loop_t* loop, async_loop_worker_t* worker,
+                                     zx_port_packet_t* out_packet);
+static zx_status_t async_loop_wait_port(async_loop_t* loop, async_loop_worker_t* worker,
+                                        zx_time_t deadline, zx_port_packet_t* out_packet);
+static bool async_loop_cancel_pending_wait(async_loop_t* loop, async_wait_t* wait);
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal);
 static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop);
@@ -63,7 +142,10 @@ static zx_status_t async_loop_dispatch_packet(async_loop_t* loop, async_receiver
                                               zx_status_t status, const zx_packet_user_t* data);
 static void async_loop_wake_threads(async_loop_t* loop);
 static zx_status_t async_loop_wait_async(async_loop_t* loop, async_wait_t* wait);
+static zx_status_t async_loop_grow_tasks_locked(async_loop_t* loop, size_t count);
+static void async_loop_take_posted_tasks_locked(async_loop_t* loop);
 static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static async_task_t* async_loop_remove_task_locked(async_loop_t* loop, size_t index);
 static void async_loop_restart_timer_locked(async_loop_t* loop);
 static void async_loop_invoke_prologue(async_loop_t* loop);
 static void async_loop_invoke_epilogue(async_loop_t* loop);
@@ -96,6 +178,14 @@ static inline async_task_t* node_to_task(list_node_t* node) {
     return FROM_NODE(async_task_t, node);
 }
 
+static inline bool task_in_heap(const async_task_t* task) {
+    return task->state.reserved[0] == TASK_IN_HEAP;
+}
+
+static inline size_t task_heap_index(const async_task_t* task) {
+    return task->state.reserved[1];
+}
+
 zx_status_t async_loop_create(const async_loop_config_t* config, async_t** out_async) {
     ZX_DEBUG_ASSERT(out_async);
 
@@ -104,15 +194,23 @@ zx_status_t async_loop_create(const async_loop_config_t* config, async_t** out_a
         return ZX_ERR_NO_MEMORY;
     atomic_init(&loop->state, ASYNC_LOOP_RUNNABLE);
     atomic_init(&loop->active_threads, 0u);
+    atomic_init(&loop->idle_threads, 0u);
+    atomic_init(&loop->pending_free, MAX_PENDING_PACKETS);
+    atomic_init(&loop->queued_packets, 0u);
+    atomic_init(&loop->task_capacity, 0u);
+    atomic_init(&loop->task_count, 0u);
+    atomic_init(&loop->posted_tasks, NULL);
+    atomic_init(&loop->timer_deadline, ZX_TIME_INFINITE);
 
     loop->async.ops = &async_loop_ops;
     if (config)
         loop->config = *config;
     mtx_init(&loop->lock, mtx_plain);
+    mtx_init(&loop->task_lock, mtx_plain);
     list_initialize(&loop->wait_list);
-    list_initialize(&loop->task_list);
-    list_initialize(&loop->due_list);
     list_initialize(&loop->thread_list);
+    list_initialize(&loop->worker_list);
+    list_initialize(&loop->due_list);
 
     zx_status_t status = zx_port_create(0u, &loop->port);
     if (status == ZX_OK)
@@ -144,6 +242,8 @@ void async_loop_destroy(async_t* async) {
     zx_handle_close(loop->port);
     zx_handle_close(loop->timer);
     mtx_destroy(&loop->lock);
+    mtx_destroy(&loop->task_lock);
+    free(loop->task_heap);
     free(loop);
 }
 
@@ -176,14 +276,16 @@ void async_loop_shutdown(async_t* async) {
             async_loop_invoke_epilogue(loop);
         }
     }
-    while ((node = list_remove_head(&loop->task_list))) {
-        async_task_t* task = node_to_task(node);
+    async_loop_take_posted_tasks_locked(loop);
+    while (loop->task_heap_count) {
+        async_task_t* task = async_loop_remove_task_locked(loop, 0u);
         if (task->flags & ASYNC_FLAG_HANDLE_SHUTDOWN) {
             async_loop_invoke_prologue(loop);
             async_loop_invoke_task_handler(loop, task, ZX_ERR_CANCELED);
             async_loop_invoke_epilogue(loop);
         }
     }
+    atomic_store_explicit(&loop->task_count, 0u, memory_order_relaxed);
 
     if (loop->config.make_default_for_current_thread) {
         ZX_DEBUG_ASSERT(async_get_default() == async);
@@ -195,12 +297,20 @@ zx_status_t async_loop_run(async_t* async, zx_time_t deadline, bool once) {
     async_loop_t* loop = (async_loop_t*)async;
     ZX_DEBUG_ASSERT(loop);
 
+    async_loop_worker_t worker = {.head = 0u, .count = 0u};
+    mtx_init(&worker.lock, mtx_plain);
+    mtx_lock(&loop->lock);
+    list_add_tail(&loop->worker_list, &worker.node);
+    mtx_unlock(&loop->lock);
+
     zx_status_t status;
     atomic_fetch_add_explicit(&loop->active_threads, 1u, memory_order_acq_rel);
     do {
-        status = async_loop_run_once(loop, deadline);
+        status = async_loop_run_once(loop, &worker, deadline);
     } while (status == ZX_OK && !once);
     atomic_fetch_sub_explicit(&loop->active_threads, 1u, memory_order_acq_rel);
+
+    async_loop_retire_worker(loop, &worker);
     return status;
 }
 
@@ -212,20 +322,27 @@ zx_status_t async_loop_run_until_idle(async_t* async) {
     return status;
 }
 
-static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
+static zx_status_t async_loop_run_once(async_loop_t* loop, async_loop_worker_t* worker,
+                                       zx_time_t deadline) {
     async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
     if (state == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
     if (state != ASYNC_LOOP_RUNNABLE)
         return ZX_ERR_CANCELED;
 
+    // Drain packets left over from an earlier bulk dequeue before asking the
+    // kernel for more.  Since the state is checked above for every packet,
+    // quitting the loop leaves any remainder queued until it resumes.
     zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet, 0);
-    if (status != ZX_OK)
-        return status;
+    if (!async_loop_take_queued(loop, worker, &packet)) {
+        zx_status_t status = async_loop_wait_port(loop, worker, deadline, &packet);
+        if (status != ZX_OK)
+            return status;
+    }
 
     if (packet.key == KEY_CONTROL) {
-        // Handle wake-up packets.
+        // Handle wake-up packets.  The next iteration looks for packets to
+        // steal before waiting on the port again.
         if (packet.type == ZX_PKT_TYPE_USER)
             return ZX_OK;
 
@@ -252,10 +369,203 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
     return ZX_ERR_INTERNAL;
 }
 
+static void async_loop_retire_worker(async_loop_t* loop, async_loop_worker_t* worker) {
+    // Hand the thread's queued packets to whichever thread runs the loop
+    // next.  They fit, since they were counted against |pending_free|.
+    mtx_lock(&loop->lock);
+    list_delete(&worker->node);
+    mtx_lock(&worker->lock);
+    for (uint32_t i = 0u; i < worker->count; i++) {
+        uint32_t tail = (loop->pending_head + loop->pending_count) % MAX_PENDING_PACKETS;
+        loop->pending[tail] = worker->queue[(worker->head + i) % MAX_PENDING_PACKETS];
+        loop->pending_count++;
+    }
+    worker->count = 0u;
+    mtx_unlock(&worker->lock);
+    mtx_unlock(&loop->lock);
+    mtx_destroy(&worker->lock);
+}
+
+static bool async_loop_take_queued(async_loop_t* loop, async_loop_worker_t* worker,
+                                   zx_port_packet_t* out_packet) {
+    // Most of the time nothing is queued anywhere; say so without locking.
+    if (!atomic_load_explicit(&loop->queued_packets, memory_order_acquire))
+        return false;
+
+    bool found = false;
+    mtx_lock(&worker->lock);
+    if (worker->count) {
+        *out_packet = worker->queue[worker->head];
+        worker->head = (worker->head + 1u) % MAX_PENDING_PACKETS;
+        worker->count--;
+        found = true;
+    }
+    mtx_unlock(&worker->lock);
+
+    if (!found)
+        found = async_loop_steal_packets(loop, worker, out_packet);
+    if (found) {
+        atomic_fetch_sub_explicit(&loop->queued_packets, 1u, memory_order_acq_rel);
+        atomic_fetch_add_explicit(&loop->pending_free, 1u, memory_order_acq_rel);
+    }
+    return found;
+}
+
+// Takes the oldest packet left by a departed thread or, failing that, the
+// older half of the packets queued by another thread.  Stealers hold
+// |lock|, so no two of them lock one another's queues.
+static bool async_loop_steal_packets(async_loop_t* loop, async_loop_worker_t* worker,
+                                     zx_port_packet_t* out_packet) {
+    zx_port_packet_t stolen[MAX_PENDING_PACKETS];
+    uint32_t count = 0u;
+
+    mtx_lock(&loop->lock);
+    if (loop->pending_count) {
+        *out_packet = loop->pending[loop->pending_head];
+        loop->pending_head = (loop->pending_head + 1u) % MAX_PENDING_PACKETS;
+        loop->pending_count--;
+        mtx_unlock(&loop->lock);
+        return true;
+    }
+    async_loop_worker_t* victim;
+    list_for_every_entry (&loop->worker_list, victim, async_loop_worker_t, node) {
+        if (victim == worker)
+            continue;
+        mtx_lock(&victim->lock);
+        count = (victim->count + 1u) / 2u;
+        for (uint32_t i = 0u; i < count; i++) {
+            stolen[i] = victim->queue[victim->head];
+            victim->head = (victim->head + 1u) % MAX_PENDING_PACKETS;
+        }
+        victim->count -= count;
+        mtx_unlock(&victim->lock);
+        if (count)
+            break;
+    }
+    mtx_unlock(&loop->lock);
+
+    if (!count)
+        return false;
+    *out_packet = stolen[0];
+    if (count > 1u) {
+        mtx_lock(&worker->lock);
+        for (uint32_t i = 1u; i < count; i++) {
+            uint32_t tail = (worker->head + worker->count) % MAX_PENDING_PACKETS;
+            worker->queue[tail] = stolen[i];
+            worker->count++;
+        }
+        mtx_unlock(&worker->lock);
+    }
+    return true;
+}
+
+static zx_status_t async_loop_wait_port(async_loop_t* loop, async_loop_worker_t* worker,
+                                        zx_time_t deadline, zx_port_packet_t* out_packet) {
+    // Dequeue in bulk, up to this thread's share of the packets the loop
+    // may hold.  Packets beyond the first wait in this thread's queue, from
+    // which idle threads steal them rather than leaving them behind this
+    // thread's handler.
+    uint32_t threads = atomic_load_explicit(&loop->active_threads, memory_order_acquire);
+    uint32_t share = MAX_PENDING_PACKETS / (threads ? threads : 1u);
+    uint32_t room = atomic_load_explicit(&loop->pending_free, memory_order_acquire);
+    uint32_t take;
+    do {
+        take = room < share ? room : share;
+    } while (take && !atomic_compare_exchange_weak_explicit(&loop->pending_free, &room,
+                                                            room - take, memory_order_acq_rel,
+                                                            memory_order_acquire));
+
+    zx_port_packet_t packets[MAX_PENDING_PACKETS + 1u];
+    size_t actual = 0u;
+    atomic_fetch_add_explicit(&loop->idle_threads, 1u, memory_order_acq_rel);
+    zx_status_t status = zx_port_wait_many(loop->port, deadline, packets, take + 1u, &actual);
+    atomic_fetch_sub_explicit(&loop->idle_threads, 1u, memory_order_acq_rel);
+
+    uint32_t queued = (status == ZX_OK && actual > 1u) ? (uint32_t)(actual - 1u) : 0u;
+    if (take > queued)
+        atomic_fetch_add_explicit(&loop->pending_free, take - queued, memory_order_acq_rel);
+    if (queued) {
+        mtx_lock(&worker->lock);
+        for (uint32_t i = 1u; i <= queued; i++) {
+            uint32_t tail = (worker->head + worker->count) % MAX_PENDING_PACKETS;
+            worker->queue[tail] = packets[i];
+            worker->count++;
+        }
+        mtx_unlock(&worker->lock);
+        atomic_fetch_add_explicit(&loop->queued_packets, queued, memory_order_acq_rel);
+
+        // Wake an idle thread to share the backlog.  Failing to is harmless.
+        if (atomic_load_explicit(&loop->idle_threads, memory_order_acquire)) {
+            zx_port_packet_t wake = {
+                .key = KEY_CONTROL,
+                .type = ZX_PKT_TYPE_USER,
+                .status = ZX_OK};
+            zx_port_queue(loop->port, &wake, 0u);
+        }
+    }
+
+    if (status != ZX_OK)
+        return status;
+    *out_packet = packets[0];
+    return ZX_OK;
+}
+
+// Removes the completion packet for |wait| from a queue of |*count| packets
+// starting at |head|, returning true if it was there.
+static bool async_loop_remove_wait_packet(zx_port_packet_t* queue, uint32_t head,
+                                          uint32_t* count, async_wait_t* wait) {
+    bool found = false;
+    uint32_t kept = 0u;
+    for (uint32_t i = 0u; i < *count; i++) {
+        const zx_port_packet_t* packet = &queue[(head + i) % MAX_PENDING_PACKETS];
+        if (!found && packet->key == (uintptr_t)wait &&
+            (ZX_PKT_IS_SIGNAL_ONE(packet->type) || ZX_PKT_IS_SIGNAL_REP(packet->type))) {
+            found = true;
+            continue;
+        }
+        queue[(head + kept) % MAX_PENDING_PACKETS] = *packet;
+        kept++;
+    }
+    *count = kept;
+    return found;
+}
+
+// Removes the completion packet for |wait| if it is queued in the loop.
+static bool async_loop_cancel_pending_wait(async_loop_t* loop, async_wait_t* wait) {
+    if (!atomic_load_explicit(&loop->queued_packets, memory_order_acquire))
+        return false;
+
+    mtx_lock(&loop->lock);
+    bool found = async_loop_remove_wait_packet(loop->pending, loop->pending_head,
+                                               &loop->pending_count, wait);
+    async_loop_worker_t* worker;
+    list_for_every_entry (&loop->worker_list, worker, async_loop_worker_t, node) {
+        if (found)
+            break;
+        mtx_lock(&worker->lock);
+        found = async_loop_remove_wait_packet(worker->queue, worker->head,
+                                              &worker->count, wait);
+        mtx_unlock(&worker->lock);
+    }
+    mtx_unlock(&loop->lock);
+
+    if (found) {
+        atomic_fetch_sub_explicit(&loop->queued_packets, 1u, memory_order_acq_rel);
+        atomic_fetch_add_explicit(&loop->pending_free, 1u, memory_order_acq_rel);
+    }
+    return found;
+}
+
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal) {
     async_loop_invoke_prologue(loop);
 
+    // A persistent wait stays registered until its handler finishes, at which
+    // point the wait might have been destroyed, so keep what's needed to
+    // cancel the registration.
+    const bool persistent = wait->flags & ASYNC_FLAG_PERSISTENT;
+    const zx_handle_t object = wait->object;
+
     // We must dequeue the handler before invoking it since it might destroy itself.
     if (wait->flags & ASYNC_FLAG_HANDLE_SHUTDOWN) {
         mtx_lock(&loop->lock);
@@ -265,12 +575,17 @@ static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wa
 
     // Invoke the handler.  Note that it might destroy itself.
     async_wait_result_t result = async_loop_invoke_wait_handler(loop, wait, status, signal);
-    if (result == ASYNC_WAIT_AGAIN) {
+    if (result == ASYNC_WAIT_AGAIN && !persistent) {
         status = async_loop_wait_async(loop, wait);
         if (status != ZX_OK) {
             async_loop_invoke_wait_handler(loop, wait, status, NULL);
             result = ASYNC_WAIT_FINISHED;
         }
+    } else if (result == ASYNC_WAIT_FINISHED && persistent) {
+        // Fails harmlessly if the handler closed the object.  Another
+        // packet for the wait may already have left the port.
+        zx_port_cancel(loop->port, object, (uintptr_t)wait);
+        async_loop_cancel_pending_wait(loop, wait);
     }
 
     // Requeue the handler if it still wants to observe shutdown.
@@ -288,31 +603,23 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
     // Dequeue and dispatch one task at a time in case an earlier task wants
     // to cancel a later task which has also come due.  At most one thread
     // can dispatch tasks at any given moment (to preserve serial ordering).
-    // Timer restarts are suppressed until we run out of tasks to dispatch.
-    mtx_lock(&loop->lock);
+    // Timer restarts are suppressed until we run out of tasks to dispatch;
+    // meanwhile, tasks posted from elsewhere wait in |posted_tasks|.
+    mtx_lock(&loop->task_lock);
     if (!loop->dispatching_tasks) {
         loop->dispatching_tasks = true;
+        atomic_store_explicit(&loop->timer_deadline, 0, memory_order_seq_cst);
 
         // Extract all of the tasks that are due into |due_list| for dispatch
         // unless we already have some waiting from a previous iteration which
         // we would like to process in order.
         list_node_t* node;
         if (list_is_empty(&loop->due_list)) {
+            async_loop_take_posted_tasks_locked(loop);
             zx_time_t due_time = zx_clock_get(ZX_CLOCK_MONOTONIC);
-            list_node_t* tail = NULL;
-            list_for_every(&loop->task_list, node) {
-                if (node_to_task(node)->deadline > due_time)
-                    break;
-                tail = node;
-            }
-            if (tail) {
-                list_node_t* head = loop->task_list.next;
-                loop->task_list.next = tail->next;
-                tail->next->prev = &loop->task_list;
-                loop->due_list.next = head;
-                head->prev = &loop->due_list;
-                loop->due_list.prev = tail;
-                tail->next = &loop->due_list;
+            while (loop->task_heap_count && loop->task_heap[0].deadline <= due_time) {
+                async_task_t* task = async_loop_remove_task_locked(loop, 0u);
+                list_add_tail(&loop->due_list, task_to_node(task));
             }
         }
 
@@ -321,20 +628,27 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
         // item from the list.
         while ((node = list_remove_head(&loop->due_list))) {
             async_task_t* task = node_to_task(node);
-            mtx_unlock(&loop->lock);
+            mtx_unlock(&loop->task_lock);
 
             // Invoke the handler.  Note that it might destroy itself.
             async_loop_invoke_prologue(loop);
             async_task_result_t result = async_loop_invoke_task_handler(loop, task, ZX_OK);
 
-            mtx_lock(&loop->lock);
-            if (result == ASYNC_TASK_REPEAT)
+            mtx_lock(&loop->task_lock);
+            if (result == ASYNC_TASK_REPEAT) {
+                // The task still counts against |task_capacity|, so there
+                // is room for it in the heap.  Tasks posted before it
+                // returned go first.
+                async_loop_take_posted_tasks_locked(loop);
                 async_loop_insert_task_locked(loop, task);
-            mtx_unlock(&loop->lock);
+            } else {
+                atomic_fetch_sub_explicit(&loop->task_count, 1u, memory_order_acq_rel);
+            }
+            mtx_unlock(&loop->task_lock);
 
             async_loop_invoke_epilogue(loop);
 
-            mtx_lock(&loop->lock);
+            mtx_lock(&loop->task_lock);
             async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
             if (state != ASYNC_LOOP_RUNNABLE)
                 break;
@@ -343,7 +657,7 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
         loop->dispatching_tasks = false;
         async_loop_restart_timer_locked(loop);
     }
-    mtx_unlock(&loop->lock);
+    mtx_unlock(&loop->task_lock);
     return ZX_OK;
 }
 
@@ -458,6 +772,12 @@ static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait) {
     // invoked again past this point.
     zx_status_t status = zx_port_cancel(loop->port, wait->object,
                                         (uintptr_t)wait);
+
+    // The completion packet may already have left the port in a bulk
+    // dequeue without having been delivered yet.
+    if (status == ZX_ERR_NOT_FOUND && async_loop_cancel_pending_wait(loop, wait))
+        status = ZX_OK;
+
     if (status == ZX_OK && (wait->flags & ASYNC_FLAG_HANDLE_SHUTDOWN)) {
         mtx_lock(&loop->lock);
         list_delete(wait_to_node(wait));
@@ -474,16 +794,37 @@ static zx_status_t async_loop_post_task(async_t* async, async_task_t* task) {
     if (atomic_load_explicit(&loop->state, memory_order_acquire) == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
 
-    mtx_lock(&loop->lock);
-
-    async_loop_insert_task_locked(loop, task);
-    if (!loop->dispatching_tasks &&
-        task_to_node(task)->prev == &loop->task_list) {
-        // Task inserted at head.  Earliest deadline changed.
-        async_loop_restart_timer_locked(loop);
+    // Reserve room in the heap, taking the lock only to grow it.  Every
+    // task the loop holds was counted before it was posted, so the heap
+    // always has room for the tasks moved into it.
+    size_t count = atomic_fetch_add_explicit(&loop->task_count, 1u, memory_order_acq_rel) + 1u;
+    if (count > atomic_load_explicit(&loop->task_capacity, memory_order_acquire)) {
+        mtx_lock(&loop->task_lock);
+        zx_status_t status = async_loop_grow_tasks_locked(loop, count);
+        mtx_unlock(&loop->task_lock);
+        if (status != ZX_OK) {
+            atomic_fetch_sub_explicit(&loop->task_count, 1u, memory_order_acq_rel);
+            return status;
+        }
     }
 
-    mtx_unlock(&loop->lock);
+    // Publish the task without taking the lock.  Once published, the task
+    // may run and be destroyed at any moment.
+    zx_time_t deadline = task->deadline;
+    async_task_t* next = atomic_load_explicit(&loop->posted_tasks, memory_order_relaxed);
+    do {
+        task->state.reserved[0] = TASK_POSTED;
+        task->state.reserved[1] = (uintptr_t)next;
+    } while (!atomic_compare_exchange_weak_explicit(&loop->posted_tasks, &next, task,
+                                                    memory_order_seq_cst, memory_order_relaxed));
+
+    // Fire the timer if the task is due before the loop would otherwise
+    // look for it.  This pairs with |async_loop_restart_timer_locked()|,
+    // which publishes the deadline before checking for posted tasks.
+    if (deadline < atomic_load_explicit(&loop->timer_deadline, memory_order_seq_cst)) {
+        zx_status_t status = zx_timer_set(loop->timer, 0ULL, 0);
+        ZX_ASSERT_MSG(status == ZX_OK, "status=%d", status);
+    }
     return ZX_OK;
 }
 
@@ -496,25 +837,29 @@ static zx_status_t async_loop_cancel_task(async_t* async, async_task_t* task) {
     // destroyed in case the client is counting on the handler not being
     // invoked again past this point.  Also, the task we're removing here
     // might be present in the dispatcher's |due_list| if it is pending
-    // dispatch instead of in the loop's |task_list| as usual.  The same
-    // logic works in both cases.
-
-    mtx_lock(&loop->lock);
-    list_node_t* node = task_to_node(task);
-    if (!list_in_list(node)) {
-        mtx_unlock(&loop->lock);
-        return ZX_ERR_NOT_FOUND;
-    }
-
-    if (!loop->dispatching_tasks &&
-        node->prev == &loop->task_list &&
-        node->next != &loop->task_list &&
-        node_to_task(node->next)->deadline > task->deadline) {
-        // The head task was canceled and following task has a later deadline.
-        async_loop_restart_timer_locked(loop);
+    // dispatch instead of in the loop's task heap as usual.
+
+    mtx_lock(&loop->task_lock);
+    async_loop_take_posted_tasks_locked(loop);
+    if (task_in_heap(task)) {
+        size_t index = task_heap_index(task);
+        async_loop_remove_task_locked(loop, index);
+        if (!loop->dispatching_tasks && index == 0u &&
+            loop->task_heap_count &&
+            loop->task_heap[0].deadline > task->deadline) {
+            // The head task was canceled and following task has a later deadline.
+            async_loop_restart_timer_locked(loop);
+        }
+    } else {
+        list_node_t* node = task_to_node(task);
+        if (!list_in_list(node)) {
+            mtx_unlock(&loop->task_lock);
+            return ZX_ERR_NOT_FOUND;
+        }
+        list_delete(node);
     }
-    list_delete(node);
-    mtx_unlock(&loop->lock);
+    atomic_fetch_sub_explicit(&loop->task_count, 1u, memory_order_acq_rel);
+    mtx_unlock(&loop->task_lock);
     return ZX_OK;
 }
 
@@ -538,40 +883,139 @@ static zx_status_t async_loop_queue_packet(async_t* async, async_receiver_t* rec
 }
 
 static zx_status_t async_loop_wait_async(async_loop_t* loop, async_wait_t* wait) {
+    uint32_t options = (wait->flags & ASYNC_FLAG_PERSISTENT) ? ZX_WAIT_ASYNC_EDGE
+                                                              : ZX_WAIT_ASYNC_ONCE;
     return zx_object_wait_async(wait->object, loop->port, (uintptr_t)wait, wait->trigger,
-                                ZX_WAIT_ASYNC_ONCE);
+                                options);
 }
 
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
-    // TODO(ZX-976): We assume that tasks are inserted in quasi-monotonic order and
-    // that insertion into the task queue will typically take no more than a few steps.
-    // If this assumption proves false and the cost of insertion becomes a problem, we
-    // should consider using a more efficient representation for maintaining order.
-    list_node_t* node;
-    for (node = loop->task_list.prev; node != &loop->task_list; node = node->prev) {
-        if (task->deadline >= node_to_task(node)->deadline)
+static inline bool task_entry_before(const task_entry_t* a, const task_entry_t* b) {
+    return a->deadline < b->deadline || (a->deadline == b->deadline && a->seq < b->seq);
+}
+
+static inline void async_loop_set_task_entry_locked(async_loop_t* loop, size_t index,
+                                                    task_entry_t entry) {
+    loop->task_heap[index] = entry;
+    entry.task->state.reserved[0] = TASK_IN_HEAP;
+    entry.task->state.reserved[1] = index;
+}
+
+static void async_loop_sift_up_locked(async_loop_t* loop, size_t index, task_entry_t entry) {
+    while (index > 0u) {
+        size_t parent = (index - 1u) / 2u;
+        if (!task_entry_before(&entry, &loop->task_heap[parent]))
             break;
+        async_loop_set_task_entry_locked(loop, index, loop->task_heap[parent]);
+        index = parent;
     }
-    list_add_after(node, task_to_node(task));
+    async_loop_set_task_entry_locked(loop, index, entry);
 }
 
-static void async_loop_restart_timer_locked(async_loop_t* loop) {
-    zx_time_t deadline;
-    if (list_is_empty(&loop->due_list)) {
-        list_node_t* head = list_peek_head(&loop->task_list);
-        if (!head)
-            return;
-        async_task_t* task = node_to_task(head);
-        deadline = task->deadline;
-        if (deadline == ZX_TIME_INFINITE)
-            return;
-    } else {
-        // Fire now.
-        deadline = 0ULL;
+static void async_loop_sift_down_locked(async_loop_t* loop, size_t index, task_entry_t entry) {
+    size_t count = loop->task_heap_count;
+    for (;;) {
+        size_t child = index * 2u + 1u;
+        if (child >= count)
+            break;
+        if (child + 1u < count &&
+            task_entry_before(&loop->task_heap[child + 1u], &loop->task_heap[child]))
+            child++;
+        if (!task_entry_before(&loop->task_heap[child], &entry))
+            break;
+        async_loop_set_task_entry_locked(loop, index, loop->task_heap[child]);
+        index = child;
+    }
+    async_loop_set_task_entry_locked(loop, index, entry);
+}
+
+// Makes sure the heap has room for |count| tasks.
+static zx_status_t async_loop_grow_tasks_locked(async_loop_t* loop, size_t count) {
+    size_t capacity = atomic_load_explicit(&loop->task_capacity, memory_order_relaxed);
+    if (count <= capacity)
+        return ZX_OK;
+
+    capacity = capacity ? capacity * 2u : INITIAL_TASK_CAPACITY;
+    if (capacity < count)
+        capacity = count;
+    task_entry_t* heap = realloc(loop->task_heap, capacity * sizeof(task_entry_t));
+    if (!heap)
+        return ZX_ERR_NO_MEMORY;
+    loop->task_heap = heap;
+    atomic_store_explicit(&loop->task_capacity, capacity, memory_order_release);
+    return ZX_OK;
+}
+
+// Moves the tasks in |posted_tasks| into the heap, in the order they were
+// posted.
+static void async_loop_take_posted_tasks_locked(async_loop_t* loop) {
+    async_task_t* task = atomic_exchange_explicit(&loop->posted_tasks, NULL,
+                                                  memory_order_acq_rel);
+    async_task_t* oldest = NULL;
+    while (task) {
+        async_task_t* next = (async_task_t*)task->state.reserved[1];
+        task->state.reserved[1] = (uintptr_t)oldest;
+        oldest = task;
+        task = next;
+    }
+    while (oldest) {
+        async_task_t* next = (async_task_t*)oldest->state.reserved[1];
+        async_loop_insert_task_locked(loop, oldest);
+        oldest = next;
     }
+}
+
+static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
+    ZX_DEBUG_ASSERT(loop->task_heap_count <
+                    atomic_load_explicit(&loop->task_capacity, memory_order_relaxed));
+
+    task_entry_t entry = {
+        .deadline = task->deadline,
+        .seq = loop->task_seq++,
+        .task = task};
+    async_loop_sift_up_locked(loop, loop->task_heap_count++, entry);
+}
+
+// Removes the task at |index| in the heap, returning it.
+static async_task_t* async_loop_remove_task_locked(async_loop_t* loop, size_t index) {
+    ZX_DEBUG_ASSERT(index < loop->task_heap_count);
+
+    async_task_t* task = loop->task_heap[index].task;
+    task->state.reserved[0] = 0u;
+    task->state.reserved[1] = 0u;
+
+    task_entry_t last = loop->task_heap[--loop->task_heap_count];
+    if (index < loop->task_heap_count) {
+        // Move the last entry into the hole, in whichever direction it belongs.
+        if (index > 0u && task_entry_before(&last, &loop->task_heap[(index - 1u) / 2u])) {
+            async_loop_sift_up_locked(loop, index, last);
+        } else {
+            async_loop_sift_down_locked(loop, index, last);
+        }
+    }
+    return task;
+}
+
+static void async_loop_restart_timer_locked(async_loop_t* loop) {
+    do {
+        async_loop_take_posted_tasks_locked(loop);
+
+        zx_time_t deadline;
+        if (list_is_empty(&loop->due_list)) {
+            deadline = loop->task_heap_count ? loop->task_heap[0].deadline : ZX_TIME_INFINITE;
+        } else {
+            // Fire now.
+            deadline = 0ULL;
+        }
+
+        atomic_store_explicit(&loop->timer_deadline, deadline, memory_order_seq_cst);
+        if (deadline != ZX_TIME_INFINITE) {
+            zx_status_t status = zx_timer_set(loop->timer, deadline, 0);
+            ZX_ASSERT_MSG(status == ZX_OK, "status=%d", status);
+        }
 
-    zx_status_t status = zx_timer_set(loop->timer, deadline, 0);
-    ZX_ASSERT_MSG(status == ZX_OK, "status=%d", status);
+        // A task posted since the heap was examined may have seen the old
+        // deadline and left the timer alone.
+    } while (atomic_load_explicit(&loop->posted_tasks, memory_order_seq_cst));
 }
 
 static void async_loop_invoke_prologue(async_loop_t* loop) {
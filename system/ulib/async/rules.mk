@@ -14,12 +14,14 @@ MODULE_NAME := async
 
 MODULE_TYPE := userlib
 
-MODULE_SRCS =
+MODULE_SRCS = \
+    $(LOCAL_DIR)/strand.c
 
-MODULE_PACKAGE_SRCS := none
+MODULE_PACKAGE_SRCS := $(MODULE_SRCS)
 MODULE_PACKAGE_INCS := \
     $(LOCAL_INC)/dispatcher.h \
     $(LOCAL_INC)/receiver.h \
+    $(LOCAL_INC)/strand.h \
     $(LOCAL_INC)/task.h \
     $(LOCAL_INC)/wait.h \
 
@@ -53,6 +55,7 @@ MODULE_PACKAGE_INCS := \
     $(LOCAL_INC)/cpp/auto_task.h \
     $(LOCAL_INC)/cpp/auto_wait.h \
     $(LOCAL_INC)/cpp/receiver.h \
+    $(LOCAL_INC)/cpp/sequence.h \
     $(LOCAL_INC)/cpp/task.h \
     $(LOCAL_INC)/cpp/wait.h \
     $(LOCAL_INC)/cpp/wait_with_timeout.h
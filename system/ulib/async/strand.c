@@ -0,0 +1,85 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <async/strand.h>
+
+#include <stddef.h>
+
+// The most work a strand runs before giving other packets a turn.
+#define MAX_WORK_PER_PACKET (16u)
+
+static inline list_node_t* work_to_node(async_strand_work_t* work) {
+    return (list_node_t*)&work->state;
+}
+
+static inline async_strand_work_t* node_to_work(list_node_t* node) {
+    return (async_strand_work_t*)((char*)node - offsetof(async_strand_work_t, state));
+}
+
+static void async_strand_run(async_t* async, async_receiver_t* receiver,
+                             zx_status_t status, const zx_packet_user_t* data) {
+    async_strand_t* strand = (async_strand_t*)receiver;
+
+    // The strand stays scheduled while its work runs, so no other thread
+    // starts running it meanwhile.
+    for (uint32_t i = 0u; i < MAX_WORK_PER_PACKET; i++) {
+        mtx_lock(&strand->lock);
+        list_node_t* node = list_remove_head(&strand->queue);
+        if (!node) {
+            strand->scheduled = false;
+            mtx_unlock(&strand->lock);
+            return;
+        }
+        mtx_unlock(&strand->lock);
+
+        // Invoke the handler.  Note that it might destroy the work item.
+        async_strand_work_t* work = node_to_work(node);
+        work->handler(async, work);
+    }
+
+    // Let other packets run before carrying on.
+    mtx_lock(&strand->lock);
+    bool more = !list_is_empty(&strand->queue);
+    if (more && async_queue_packet(async, &strand->receiver, NULL) != ZX_OK)
+        more = false;
+    strand->scheduled = more;
+    mtx_unlock(&strand->lock);
+}
+
+void async_strand_init(async_strand_t* strand) {
+    *strand = (async_strand_t){
+        .receiver = {
+            .handler = async_strand_run,
+        },
+        .scheduled = false,
+    };
+    mtx_init(&strand->lock, mtx_plain);
+    list_initialize(&strand->queue);
+}
+
+zx_status_t async_strand_post(async_t* async, async_strand_t* strand,
+                              async_strand_work_t* work) {
+    zx_status_t status = ZX_OK;
+    mtx_lock(&strand->lock);
+    if (!strand->scheduled) {
+        status = async_queue_packet(async, &strand->receiver, NULL);
+        strand->scheduled = status == ZX_OK;
+    }
+    if (status == ZX_OK)
+        list_add_tail(&strand->queue, work_to_node(work));
+    mtx_unlock(&strand->lock);
+    return status;
+}
+
+zx_status_t async_strand_cancel(async_strand_t* strand, async_strand_work_t* work) {
+    zx_status_t status = ZX_ERR_NOT_FOUND;
+    mtx_lock(&strand->lock);
+    list_node_t* node = work_to_node(work);
+    if (list_in_list(node)) {
+        list_delete(node);
+        status = ZX_OK;
+    }
+    mtx_unlock(&strand->lock);
+    return status;
+}
@@ -588,11 +588,58 @@ zx_status_t AudioDeviceStream::StopRingBuffer() {
     return DoCall(rb_ch_, req, &resp);
 }
 
+zx_status_t AudioDeviceStream::MapPositionBuffer() {
+    if (!rb_ch_.is_valid() || (pos_virt_ != nullptr))
+        return ZX_ERR_BAD_STATE;
+
+    audio_rb_cmd_get_position_buffer_req_t  req;
+    audio_rb_cmd_get_position_buffer_resp_t resp;
+
+    req.hdr.cmd = AUDIO_RB_CMD_GET_POSITION_BUFFER;
+    req.hdr.transaction_id = 1;
+
+    zx::handle tmp;
+    zx_status_t res = DoCall(rb_ch_, req, &resp, &tmp);
+    if (res != ZX_OK)
+        return res;
+
+    zx::vmo pos_vmo(tmp.release());
+    uint64_t pos_vmo_sz;
+    res = pos_vmo.get_size(&pos_vmo_sz);
+    if (res != ZX_OK)
+        return res;
+
+    if ((resp.position_offset % sizeof(uint32_t)) ||
+        (pos_vmo_sz < sizeof(uint32_t)) ||
+        (resp.position_offset > pos_vmo_sz - sizeof(uint32_t))) {
+        printf("Bad position offset returned by audio driver! "
+               "(offset = %u vmo size = %lu)\n", resp.position_offset, pos_vmo_sz);
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    res = zx::vmar::root_self().map(0u, pos_vmo, 0u, pos_vmo_sz,
+                                    ZX_VM_FLAG_PERM_READ, &pos_map_);
+    if (res != ZX_OK) {
+        printf("Failed to map position buffer VMO (res %d)\n", res);
+        return res;
+    }
+
+    pos_map_sz_ = pos_vmo_sz;
+    pos_virt_ = reinterpret_cast<const volatile uint32_t*>(pos_map_ + resp.position_offset);
+    return ZX_OK;
+}
+
 void AudioDeviceStream::ResetRingBuffer() {
     if (rb_virt_ != nullptr) {
         ZX_DEBUG_ASSERT(rb_sz_ != 0);
         zx::vmar::root_self().unmap(reinterpret_cast<uintptr_t>(rb_virt_), rb_sz_);
     }
+    if (pos_map_ != 0) {
+        zx::vmar::root_self().unmap(pos_map_, pos_map_sz_);
+    }
+    pos_map_ = 0;
+    pos_map_sz_ = 0;
+    pos_virt_ = nullptr;
     rb_ch_.reset();
     rb_vmo_.reset();
     rb_sz_ = 0;
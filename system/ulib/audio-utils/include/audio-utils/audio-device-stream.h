@@ -26,6 +26,7 @@ public:
                           uint16_t channels,
                           audio_sample_format_t sample_format);
     zx_status_t GetBuffer(uint32_t frames, uint32_t irqs_per_ring);
+    zx_status_t MapPositionBuffer();
     zx_status_t StartRingBuffer();
     zx_status_t StopRingBuffer();
     void        ResetRingBuffer();
@@ -50,6 +51,11 @@ public:
     uint64_t    start_time()           const { return start_time_; }
     uint64_t    external_delay_nsec()  const { return external_delay_nsec_; }
 
+    // The driver's current position in the ring buffer, read from the
+    // position buffer mapped by MapPositionBuffer.
+    uint32_t    ring_buffer_pos()      const { return *pos_virt_; }
+    bool        has_position_buffer()  const { return pos_virt_ != nullptr; }
+
 protected:
     friend class fbl::unique_ptr<AudioDeviceStream>;
 
@@ -79,6 +85,10 @@ protected:
     uint32_t fifo_depth_           = 0;
     uint32_t rb_sz_                = 0;
     void*    rb_virt_              = nullptr;
+    uintptr_t pos_map_             = 0;
+    uint64_t pos_map_sz_           = 0;
+
+    const volatile uint32_t* pos_virt_ = nullptr;
 };
 
 }  // namespace utils
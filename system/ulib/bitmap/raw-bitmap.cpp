@@ -76,22 +76,25 @@ size_t RawBitmapBase::Scan(size_t bitoff, size_t bitmax, bool is_set) const {
     }
     size_t first_idx = FirstIdx(bitoff);
     size_t last_idx = LastIdx(bitmax);
+    // XOR-ing a word with |flip| leaves ones exactly where its bits don't
+    // match |is_set|, so the scan is for the first non-zero word.
+    const size_t flip = is_set ? ~static_cast<size_t>(0) : 0;
     size_t i = first_idx;
-    size_t value = 0;
-    for (i = first_idx; i <= last_idx; ++i) {
-        value = GetMask(i == first_idx, i == last_idx, bitoff, bitmax);
-        if (is_set) {
-            // If is_set=true, invert the mask, OR it with the value, and invert
-            // it again to hopefully get all zeros.
-            value = ~(~value | data_[i]);
-        } else {
-            // If is_set=false, just AND the mask with the value to hopefully
-            // get all zeros.
-            value &= data_[i];
-        }
-        if (value != 0) {
-            break;
+    size_t value = (data_[i] ^ flip) & GetMask(true, i == last_idx, bitoff, bitmax);
+    while (value == 0 && i < last_idx) {
+        ++i;
+        // The words strictly between the first and the last need no mask.
+        // Skip runs of matching words four at a time; the OR of independent
+        // loads is cheap and easy for the compiler to vectorize.
+        while (i + 4 <= last_idx &&
+               ((data_[i] ^ flip) | (data_[i + 1] ^ flip) |
+                (data_[i + 2] ^ flip) | (data_[i + 3] ^ flip)) == 0) {
+            i += 4;
         }
+        value = (data_[i] ^ flip) & GetMask(false, i == last_idx, bitoff, bitmax);
+    }
+    if (value == 0) {
+        return bitmax;
     }
     return fbl::min(bitmax, CountZeros(i, value));
 }
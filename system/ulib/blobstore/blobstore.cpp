@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,12 +14,15 @@
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
 #include <fs/block-txn.h>
+#include <lz4/lz4.h>
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <fdio/debug.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/limits.h>
 #include <fbl/ref_ptr.h>
+#include <fbl/vector.h>
+#include <zircon/device/vfs.h>
 #include <zx/event.h>
 
 #define ZXDEBUG 0
@@ -31,6 +35,9 @@ using digest::MerkleTree;
 namespace blobstore {
 namespace {
 
+// Bounds the bookkeeping of the index of free extents.
+constexpr size_t kFreeExtentsPoolSize = 4 * 1024 * 1024;
+
 zx_status_t vmo_read_exact(zx_handle_t h, void* data, uint64_t offset, size_t len) {
     size_t actual;
     zx_status_t status = zx_vmo_read(h, data, offset, len, &actual);
@@ -113,31 +120,46 @@ blobstore_inode_t* Blobstore::GetNode(size_t index) const {
     return &reinterpret_cast<blobstore_inode_t*>(node_map_->GetData())[index];
 }
 
-zx_status_t VnodeBlob::Verify() const {
-    TRACE_DURATION("blobstore", "Blobstore::Verify");
+template <typename Txn>
+void VnodeBlob::EnqueueBlocks(Txn* txn, vmoid_t vmoid, uint64_t vmo_block, uint64_t blob_block,
+                              uint64_t nblocks) {
+    const uint64_t data_start = DataStartBlock(blobstore_->info_);
+    ForEachRun(extents_, blob_block, nblocks,
+               [txn, vmoid, vmo_block, data_start](uint64_t offset, uint64_t start,
+                                                   uint64_t length) {
+        txn->Enqueue(vmoid, vmo_block + offset, data_start + start, length);
+    });
+}
+
+zx_status_t VnodeBlob::Verify(uint64_t off, uint64_t len) const {
+    TRACE_DURATION("blobstore", "Blobstore::Verify", "off", off, "len", len);
     ZX_DEBUG_ASSERT(blob_ != nullptr);
 
     const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
-    // TODO(smklein): We could lazily verify more of the VMO if
-    // we could fault in pages on-demand.
-    //
-    // For now, we aggressively verify the entire VMO up front.
     Digest d;
     d = reinterpret_cast<const uint8_t*>(&digest_[0]);
     return MerkleTree::Verify(GetData(), inode->blob_size, GetMerkle(),
-                              MerkleTree::GetTreeLength(inode->blob_size), 0,
-                              inode->blob_size, d);
+                              MerkleTree::GetTreeLength(inode->blob_size), off,
+                              len, d);
 }
 
 zx_status_t VnodeBlob::InitVmos() {
     TRACE_DURATION("blobstore", "Blobstore::InitVmos");
 
-    if (blob_ != nullptr) {
+    if (blob_ != nullptr || data_vmo_.is_valid()) {
         return ZX_OK;
     }
 
     zx_status_t status;
     const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    if ((status = blobstore_->LoadExtents(map_index_, &extents_)) != ZX_OK) {
+        FS_TRACE_ERROR("blobstore: Failed to load extents of blob: %d\n", status);
+        return status;
+    }
+    const bool compressed = inode->flags & kBlobInodeFlagLZ4;
+    if (blobstore_->pager_ != nullptr && !compressed) {
+        return InitPagedVmo();
+    }
 
     uint64_t num_blocks = BlobDataBlocks(*inode) + MerkleTreeBlocks(*inode);
     if ((status = MappedVmo::Create(num_blocks * kBlobstoreBlockSize, "blob", &blob_)) != ZX_OK) {
@@ -150,15 +172,148 @@ zx_status_t VnodeBlob::InitVmos() {
         BlobCloseHandles();
         return status;
     }
-
-    ReadTxn txn(blobstore_.get());
-    txn.Enqueue(vmoid_, 0, inode->start_block + DataStartBlock(blobstore_->info_),
-                BlobDataBlocks(*inode) + MerkleTreeBlocks(*inode));
-    if ((status = txn.Flush()) != ZX_OK) {
+    if ((status = verified_.Reset(BlobDataBlocks(*inode))) != ZX_OK) {
+        BlobCloseHandles();
         return status;
     }
 
-    return Verify();
+    // Only the Merkle Tree is read up front; it stays cached in blob_ while
+    // the data blocks are read and verified by LoadRange() as they are used.
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    if (merkle_blocks > 0) {
+        ReadTxn txn(blobstore_.get());
+        EnqueueBlocks(&txn, vmoid_, 0, 0, merkle_blocks);
+        if ((status = txn.Flush()) != ZX_OK) {
+            BlobCloseHandles();
+            return status;
+        }
+    }
+
+    // The compressed form of a blob is read whole, and decompressed a chunk
+    // at a time by LoadRange().
+    if (compressed) {
+        const uint64_t compressed_blocks = inode->num_blocks - merkle_blocks;
+        if (compressed_blocks * kBlobstoreBlockSize < CompressedTableSize(*inode)) {
+            BlobCloseHandles();
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if ((status = MappedVmo::Create(compressed_blocks * kBlobstoreBlockSize,
+                                        "blob-compressed", &compressed_)) != ZX_OK) {
+            BlobCloseHandles();
+            return status;
+        }
+        vmoid_t vmoid;
+        if ((status = blobstore_->AttachVmo(compressed_->GetVmo(), &vmoid)) != ZX_OK) {
+            BlobCloseHandles();
+            return status;
+        }
+
+        ReadTxn txn(blobstore_.get());
+        EnqueueBlocks(&txn, vmoid, 0, merkle_blocks, compressed_blocks);
+        status = txn.Flush();
+        blobstore_->DetachVmo(vmoid);
+        if (status != ZX_OK) {
+            BlobCloseHandles();
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::LoadRange(uint64_t off, uint64_t len) {
+    TRACE_DURATION("blobstore", "Blobstore::LoadRange", "off", off, "len", len);
+    ZX_DEBUG_ASSERT(blob_ != nullptr);
+
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    if (len == 0 || off >= inode->blob_size) {
+        return ZX_OK;
+    }
+    len = fbl::min(len, inode->blob_size - off);
+
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    const uint64_t blk_end = fbl::round_up(off + len, kBlobstoreBlockSize) / kBlobstoreBlockSize;
+    uint64_t blk = off / kBlobstoreBlockSize;
+    zx_status_t status;
+    while (blk < blk_end) {
+        // Skip over blocks which have already been verified, then read the
+        // following run of unverified blocks in a single transaction.
+        size_t run_start = verified_.Scan(blk, blk_end, true);
+        if (run_start == blk_end) {
+            break;
+        }
+        size_t run_end = verified_.Scan(run_start, blk_end, false);
+
+        if (compressed_ != nullptr) {
+            // Chunks can only be decompressed whole, so widen the run to
+            // cover all of the chunks it touches.
+            constexpr uint64_t kChunkBlocks = kBlobstoreCompressionChunkSize /
+                                              kBlobstoreBlockSize;
+            run_start = fbl::round_down(run_start, kChunkBlocks);
+            run_end = fbl::min(fbl::round_up(run_end, kChunkBlocks), verified_.size());
+            status = DecompressChunks(run_start / kChunkBlocks,
+                                      fbl::round_up(run_end, kChunkBlocks) / kChunkBlocks);
+            if (status != ZX_OK) {
+                return status;
+            }
+        } else {
+            ReadTxn txn(blobstore_.get());
+            EnqueueBlocks(&txn, vmoid_, merkle_blocks + run_start, merkle_blocks + run_start,
+                          run_end - run_start);
+            if ((status = txn.Flush()) != ZX_OK) {
+                return status;
+            }
+        }
+
+        const uint64_t run_off = run_start * kBlobstoreBlockSize;
+        const uint64_t run_len = fbl::min(run_end * kBlobstoreBlockSize,
+                                          inode->blob_size) - run_off;
+        if ((status = Verify(run_off, run_len)) != ZX_OK) {
+            FS_TRACE_ERROR("blobstore: Blob failed verification at offset %" PRIu64 "\n",
+                           run_off);
+            return status;
+        }
+        verified_.Set(run_start, run_end);
+        blk = run_end;
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::InitPagedVmo() {
+    TRACE_DURATION("blobstore", "Blobstore::InitPagedVmo");
+
+    zx_status_t status;
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+
+    // The pager keeps its own copy of the Merkle Tree, which is only needed
+    // here long enough to hand it over.
+    fbl::unique_ptr<MappedVmo> merkle;
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    if (merkle_blocks > 0) {
+        vmoid_t vmoid;
+        if ((status = MappedVmo::Create(merkle_blocks * kBlobstoreBlockSize, "blob-merkle",
+                                        &merkle)) != ZX_OK) {
+            FS_TRACE_ERROR("Failed to initialize vmo; error: %d\n", status);
+            return status;
+        }
+        if ((status = blobstore_->AttachVmo(merkle->GetVmo(), &vmoid)) != ZX_OK) {
+            FS_TRACE_ERROR("Failed to attach VMO to block device; error: %d\n", status);
+            return status;
+        }
+
+        ReadTxn txn(blobstore_.get());
+        EnqueueBlocks(&txn, vmoid, 0, 0, merkle_blocks);
+        status = txn.Flush();
+        blobstore_->DetachVmo(vmoid);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    Digest d;
+    d = reinterpret_cast<const uint8_t*>(&digest_[0]);
+    return blobstore_->pager_->GetVmo(map_index_, *inode, d,
+                                      merkle != nullptr ? merkle->GetData() : nullptr,
+                                      &data_vmo_);
 }
 
 uint64_t VnodeBlob::SizeData() const {
@@ -179,8 +334,124 @@ VnodeBlob::VnodeBlob(fbl::RefPtr<Blobstore> bs)
     : blobstore_(fbl::move(bs)),
       flags_(kBlobStateEmpty | kBlobFlagDirectory) {}
 
+zx_status_t VnodeBlob::DecompressChunks(uint64_t chunk_start, uint64_t chunk_end) {
+    TRACE_DURATION("blobstore", "Blobstore::DecompressChunks", "chunk_start", chunk_start,
+                   "chunk_end", chunk_end);
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint64_t* table = static_cast<const uint64_t*>(compressed_->GetData());
+    const char* src = static_cast<const char*>(compressed_->GetData());
+    char* dst = static_cast<char*>(GetData());
+
+    for (uint64_t i = chunk_start; i < chunk_end; i++) {
+        // The chunk table is read from disk, and is not covered by the Merkle
+        // Tree; the decompressed data is verified by the caller.
+        const uint64_t src_off = table[i];
+        const uint64_t src_end = table[i + 1];
+        if (src_off < CompressedTableSize(*inode) || src_off > src_end ||
+            src_end > compressed_->GetSize() ||
+            src_end - src_off > static_cast<uint64_t>(LZ4_compressBound(
+                static_cast<int>(kBlobstoreCompressionChunkSize)))) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+
+        const uint64_t off = i * kBlobstoreCompressionChunkSize;
+        const int len = static_cast<int>(fbl::min(kBlobstoreCompressionChunkSize,
+                                                  inode->blob_size - off));
+        if (LZ4_decompress_safe(src + src_off, dst + off, static_cast<int>(src_end - src_off),
+                                len) != len) {
+            FS_TRACE_ERROR("blobstore: Failed to decompress chunk %" PRIu64 "\n", i);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::WriteCompressed(WriteTxn* txn) {
+    TRACE_DURATION("blobstore", "Blobstore::WriteCompressed");
+    blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    const uint64_t data_blocks = BlobDataBlocks(*inode);
+    const uint64_t chunks = CompressedChunks(*inode);
+
+    // Every chunk gets room for its worst case, so compression can't fail
+    // for lack of space.
+    const int chunk_bound = LZ4_compressBound(static_cast<int>(kBlobstoreCompressionChunkSize));
+    const uint64_t max_size = CompressedTableSize(*inode) + chunks * chunk_bound;
+    fbl::unique_ptr<MappedVmo> compressed;
+    zx_status_t status;
+    if ((status = MappedVmo::Create(fbl::round_up(max_size, kBlobstoreBlockSize),
+                                    "blob-compressed", &compressed)) != ZX_OK) {
+        return status;
+    }
+
+    uint64_t* table = static_cast<uint64_t*>(compressed->GetData());
+    char* dst = static_cast<char*>(compressed->GetData());
+    const char* src = static_cast<const char*>(GetData());
+    uint64_t size = CompressedTableSize(*inode);
+    for (uint64_t i = 0; i < chunks; i++) {
+        const uint64_t off = i * kBlobstoreCompressionChunkSize;
+        const int len = static_cast<int>(fbl::min(kBlobstoreCompressionChunkSize,
+                                                  inode->blob_size - off));
+        int r = LZ4_compress_default(src + off, dst + size, len, chunk_bound);
+        if (r <= 0) {
+            return ZX_ERR_INTERNAL;
+        }
+        table[i] = size;
+        size += r;
+    }
+    table[chunks] = size;
+
+    const uint64_t compressed_blocks = fbl::round_up(size, kBlobstoreBlockSize) /
+                                       kBlobstoreBlockSize;
+    if (compressed_blocks >= data_blocks) {
+        // Compression doesn't save any space; store the blob as it is.
+        return WriteShared(txn, merkle_blocks * kBlobstoreBlockSize, inode->blob_size);
+    }
+
+    vmoid_t vmoid;
+    if ((status = blobstore_->AttachVmo(compressed->GetVmo(), &vmoid)) != ZX_OK) {
+        return status;
+    }
+    EnqueueBlocks(txn, vmoid, 0, merkle_blocks, compressed_blocks);
+    status = txn->Flush();
+    blobstore_->DetachVmo(vmoid);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Release the blocks only the uncompressed data needed, from the end of
+    // the blob's extents. The rest of the blob's allocation is written out by
+    // WriteMetadata().
+    fbl::AllocChecker ac;
+    ExtentList kept;
+    kept.reserve(extents_.size(), &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint64_t remaining = merkle_blocks + compressed_blocks;
+    for (const blobstore_extent_t& extent : extents_) {
+        const uint64_t length = fbl::min(extent.length, remaining);
+        if (length > 0) {
+            kept.push_back({extent.start, length});
+        }
+        if (length < extent.length) {
+            blobstore_->FreeBlocks(extent.length - length, extent.start + length);
+            if ((status = blobstore_->WriteBitmap(txn, extent.length - length,
+                                                  extent.start + length)) != ZX_OK) {
+                return status;
+            }
+        }
+        remaining -= length;
+    }
+    extents_ = fbl::move(kept);
+    inode->num_blocks = merkle_blocks + compressed_blocks;
+    inode->flags |= kBlobInodeFlagLZ4;
+    return blobstore_->SetExtents(map_index_, extents_);
+}
+
 void VnodeBlob::BlobCloseHandles() {
     blob_ = nullptr;
+    compressed_ = nullptr;
     readable_event_.reset();
 }
 
@@ -204,18 +475,26 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
     blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
     memset(inode->merkle_root_hash, 0, Digest::kLength);
     inode->blob_size = size_data;
+    inode->flags = 0;
     inode->num_blocks = MerkleTreeBlocks(*inode) + BlobDataBlocks(*inode);
 
     // Open VMOs, so we can begin writing after allocate succeeds.
     if ((status = MappedVmo::Create(inode->num_blocks * kBlobstoreBlockSize, "blob", &blob_)) != ZX_OK) {
         goto fail;
     }
+    if ((status = merkle_tree_.CreateInit(size_data,
+                                          MerkleTree::GetTreeLength(size_data))) != ZX_OK) {
+        goto fail;
+    }
     if ((status = blobstore_->AttachVmo(blob_->GetVmo(), &vmoid_)) != ZX_OK) {
         goto fail;
     }
 
     // Allocate space for the blob
-    if ((status = blobstore_->AllocateBlocks(inode->num_blocks, &inode->start_block)) != ZX_OK) {
+    if ((status = blobstore_->AllocateBlocks(inode->num_blocks, &extents_)) != ZX_OK) {
+        goto fail;
+    }
+    if ((status = blobstore_->SetExtents(map_index_, extents_)) != ZX_OK) {
         goto fail;
     }
 
@@ -224,23 +503,52 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
 
 fail:
     BlobCloseHandles();
+    for (const blobstore_extent_t& extent : extents_) {
+        blobstore_->FreeBlocks(extent.length, extent.start);
+    }
+    extents_.reset();
+    blobstore_->FreeContainers(map_index_);
     blobstore_->FreeNode(map_index_);
     return status;
 }
 
 // A helper function for dumping either the Merkle Tree or the actual blob data
 // to both (1) The containing VMO, and (2) disk.
-zx_status_t VnodeBlob::WriteShared(WriteTxn* txn, size_t start, size_t len, uint64_t start_block) {
-    TRACE_DURATION("blobstore", "Blobstore::WriteShared", "txn", txn, "start", start, "len", len,
-                   "start_block", start_block);
+zx_status_t VnodeBlob::WriteShared(WriteTxn* txn, size_t start, size_t len) {
+    TRACE_DURATION("blobstore", "Blobstore::WriteShared", "txn", txn, "start", start, "len", len);
 
     // Write as many 'entire blocks' as possible
     uint64_t n = start / kBlobstoreBlockSize;
     uint64_t n_end = (start + len + kBlobstoreBlockSize - 1) / kBlobstoreBlockSize;
-    txn->Enqueue(vmoid_, n, n + start_block + DataStartBlock(blobstore_->info_), n_end - n);
+    EnqueueBlocks(txn, vmoid_, n, n, n_end - n);
     return txn->Flush();
 }
 
+zx_status_t VnodeBlob::QueueWrite(uint64_t vmo_block, uint64_t nblocks) {
+    TRACE_DURATION("blobstore", "Blobstore::QueueWrite", "vmo_block", vmo_block,
+                   "nblocks", nblocks);
+    if (blobstore_->writeback_ != nullptr) {
+        const uint64_t data_start = DataStartBlock(blobstore_->info_);
+        ForEachRun(extents_, vmo_block, nblocks,
+                   [this, vmo_block, data_start](uint64_t offset, uint64_t start,
+                                                 uint64_t length) {
+            blobstore_->writeback_->Enqueue(&writeback_, vmoid_, vmo_block + offset,
+                                            data_start + start, length);
+        });
+        return ZX_OK;
+    }
+    WriteTxn txn(blobstore_.get());
+    EnqueueBlocks(&txn, vmoid_, vmo_block, vmo_block, nblocks);
+    return txn.Flush();
+}
+
+zx_status_t VnodeBlob::WaitForWrites() {
+    if (blobstore_->writeback_ == nullptr) {
+        return ZX_OK;
+    }
+    return blobstore_->writeback_->Wait(&writeback_);
+}
+
 void* VnodeBlob::GetData() const {
     auto inode = blobstore_->GetNode(map_index_);
     return fs::GetBlock<kBlobstoreBlockSize>(blob_->GetData(),
@@ -251,20 +559,34 @@ void* VnodeBlob::GetMerkle() const {
     return blob_->GetData();
 }
 
-zx_status_t VnodeBlob::WriteMetadata() {
-    TRACE_DURATION("blobstore", "Blobstore::WriteMetadata");
-
-    assert(GetState() == kBlobStateDataWrite);
-
-    // All data has been written to the containing VMO
+zx_status_t VnodeBlob::MarkReadable() {
+    // All data has been written to the containing VMO, and was verified as
+    // it was written.
+    zx_status_t status = verified_.Reset(BlobDataBlocks(*blobstore_->GetNode(map_index_)));
+    if (status != ZX_OK) {
+        return status;
+    }
+    verified_.Set(0, verified_.size());
     SetState(kBlobStateReadable);
     if (readable_event_.is_valid()) {
-        zx_status_t status = readable_event_.signal(0u, ZX_USER_SIGNAL_0);
+        status = readable_event_.signal(0u, ZX_USER_SIGNAL_0);
         if (status != ZX_OK) {
             SetState(kBlobStateError);
             return status;
         }
     }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::WriteMetadata() {
+    TRACE_DURATION("blobstore", "Blobstore::WriteMetadata");
+
+    assert(GetState() == kBlobStateDataWrite);
+
+    zx_status_t status = MarkReadable();
+    if (status != ZX_OK) {
+        return status;
+    }
 
     // TODO(smklein): We could probably flush out these disk structures asynchronously.
     // Even writing the above blocks could be done async. The "node" write must be done
@@ -277,8 +599,10 @@ zx_status_t VnodeBlob::WriteMetadata() {
 
     WriteTxn txn(blobstore_.get());
 
-    // Write block allocation bitmap
-    if (blobstore_->WriteBitmap(&txn, inode->num_blocks, inode->start_block) != ZX_OK) {
+    // Write block allocation bitmap, along with the extent containers
+    blobstore_->EnqueueBitmap(&txn, extents_);
+    blobstore_->EnqueueContainers(&txn, map_index_);
+    if (txn.Flush() != ZX_OK) {
         return ZX_ERR_IO;
     }
 
@@ -306,7 +630,6 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
         return ZX_OK;
     }
 
-    WriteTxn txn(blobstore_.get());
     auto inode = blobstore_->GetNode(map_index_);
     const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
     if (GetState() == kBlobStateDataWrite) {
@@ -317,8 +640,9 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             return status;
         }
 
-        status = WriteShared(&txn, offset, len, inode->start_block);
-        if (status != ZX_OK) {
+        // Hash the data as it arrives, leaving only the upper levels of the
+        // Merkle tree for once the last byte is in.
+        if ((status = merkle_tree_.CreateUpdate(data, to_write, GetMerkle())) != ZX_OK) {
             SetState(kBlobStateError);
             return status;
         }
@@ -326,40 +650,54 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
         *actual = to_write;
         bytes_written_ += to_write;
 
+        // Blocks are written out as soon as they are filled, while the rest
+        // of the blob arrives; the last one once it is complete. Compressed
+        // blobs are only written out once all of their data has arrived.
+        const uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+        if (!blobstore_->compression_enabled_) {
+            uint64_t filled = bytes_written_ / kBlobstoreBlockSize;
+            if (bytes_written_ == inode->blob_size) {
+                filled = BlobDataBlocks(*inode);
+            }
+            if (filled > blocks_queued_) {
+                status = QueueWrite(merkle_blocks + blocks_queued_, filled - blocks_queued_);
+                if (status != ZX_OK) {
+                    SetState(kBlobStateError);
+                    return status;
+                }
+                blocks_queued_ = filled;
+            }
+        }
+
         // More data to write.
         if (bytes_written_ < inode->blob_size) {
             return ZX_OK;
         }
 
-        // TODO(smklein): As an optimization, use the CreateInit/Update/Final
-        // methods to create the merkle tree as we write data, rather than
-        // waiting until the data is fully downloaded to create the tree.
-        size_t merkle_size = MerkleTree::GetTreeLength(inode->blob_size);
-        if (merkle_size > 0) {
-            Digest digest;
-            void* merkle_data = GetMerkle();
-            const void* blob_data = GetData();
-            if (MerkleTree::Create(blob_data, inode->blob_size, merkle_data,
-                                   merkle_size, &digest) != ZX_OK) {
-                SetState(kBlobStateError);
-                return status;
-            } else if (digest != digest_) {
-                // Downloaded blob did not match provided digest
-                SetState(kBlobStateError);
-                return status;
-            }
+        Digest digest;
+        if ((status = merkle_tree_.CreateFinal(GetMerkle(), &digest)) != ZX_OK) {
+            SetState(kBlobStateError);
+            return status;
+        } else if (digest != digest_) {
+            // Downloaded blob did not match provided digest
+            SetState(kBlobStateError);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if (merkle_blocks > 0 && (status = QueueWrite(0, merkle_blocks)) != ZX_OK) {
+            SetState(kBlobStateError);
+            return status;
+        }
+        if ((status = WaitForWrites()) != ZX_OK) {
+            SetState(kBlobStateError);
+            return status;
+        }
 
-            status = WriteShared(&txn, 0, merkle_size, inode->start_block);
-            if (status != ZX_OK) {
+        if (blobstore_->compression_enabled_) {
+            WriteTxn txn(blobstore_.get());
+            if ((status = WriteCompressed(&txn)) != ZX_OK) {
                 SetState(kBlobStateError);
                 return status;
             }
-        } else if ((status = Verify()) != ZX_OK) {
-            // Small blobs may not have associated Merkle Trees, and will
-            // require validation, since we are not regenerating and checking
-            // the digest.
-            SetState(kBlobStateError);
-            return status;
         }
 
         // No more data to write. Flush to disk.
@@ -373,6 +711,158 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
     return ZX_ERR_BAD_STATE;
 }
 
+void VnodeBlob::CacheContents() {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<CachedBlob> cached(new (&ac) CachedBlob());
+    if (!ac.check()) {
+        return;
+    }
+    const blobstore_inode_t* inode = blobstore_->GetNode(map_index_);
+    if (data_vmo_.is_valid()) {
+        cached->data_vmo = fbl::move(data_vmo_);
+        cached->bytes = BlobDataBlocks(*inode) * kBlobstoreBlockSize;
+    } else if (blob_ != nullptr && verified_.Scan(0, verified_.size(), true) == verified_.size()) {
+        cached->blob = fbl::move(blob_);
+        cached->vmoid = vmoid_;
+        cached->bytes = cached->blob->GetSize();
+        compressed_ = nullptr;
+    } else {
+        return;
+    }
+    memcpy(cached->digest, digest_, Digest::kLength);
+    cached->map_index = map_index_;
+    blobstore_->cache_.Insert(fbl::move(cached));
+}
+
+zx_status_t VnodeBlob::AdoptCached(fbl::unique_ptr<CachedBlob> cached) {
+    if (cached->data_vmo.is_valid()) {
+        data_vmo_ = fbl::move(cached->data_vmo);
+        return ZX_OK;
+    }
+    const uint64_t data_blocks = BlobDataBlocks(*blobstore_->GetNode(map_index_));
+    zx_status_t status = verified_.Reset(data_blocks);
+    if (status != ZX_OK) {
+        blobstore_->DetachVmo(cached->vmoid);
+        return status;
+    }
+    verified_.Set(0, data_blocks);
+    blob_ = fbl::move(cached->blob);
+    vmoid_ = cached->vmoid;
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::InstallBatch(zx_handle_t vmo, uint32_t count) {
+    TRACE_DURATION("blobstore", "Blobstore::InstallBatch", "count", count);
+    ZX_DEBUG_ASSERT(IsDirectory());
+
+    if (count == 0 || count > VFS_INSTALL_BATCH_MAX) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zx_status_t status;
+    uint64_t vmo_size;
+    if ((status = zx_vmo_get_size(vmo, &vmo_size)) != ZX_OK) {
+        return status;
+    }
+    const size_t manifest_size = count * sizeof(vfs_install_entry_t);
+    if (manifest_size > vmo_size) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<vfs_install_entry_t[]> entries(new (&ac) vfs_install_entry_t[count]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if ((status = vmo_read_exact(vmo, entries.get(), 0, manifest_size)) != ZX_OK) {
+        return status;
+    }
+
+    // Every blob of the batch has its node and blocks allocated before any
+    // data is written. On failure, releasing the blobs which are still being
+    // written frees whatever they had been given.
+    struct Pending {
+        fbl::RefPtr<VnodeBlob> blob;
+        const vfs_install_entry_t* entry;
+    };
+    fbl::Vector<Pending> pending;
+    pending.reserve(count, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        const vfs_install_entry_t& entry = entries[i];
+        if (entry.size == 0 || entry.offset > vmo_size || entry.size > vmo_size - entry.offset) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        Digest digest;
+        digest = entry.digest;
+        if (blobstore_->LookupBlob(digest, nullptr) == ZX_OK) {
+            continue;
+        }
+        fbl::RefPtr<VnodeBlob> blob;
+        if ((status = blobstore_->NewBlob(digest, &blob)) != ZX_OK) {
+            return status;
+        } else if ((status = blob->SpaceAllocate(entry.size)) != ZX_OK) {
+            return status;
+        }
+        pending.push_back(Pending{fbl::move(blob), &entry});
+    }
+
+    // Each blob is verified as its data is copied in, and written out whole
+    // while the next one is being verified.
+    for (auto& p : pending) {
+        VnodeBlob* blob = p.blob.get();
+        const blobstore_inode_t* inode = blobstore_->GetNode(blob->map_index_);
+        if ((status = vmo_read_exact(vmo, blob->GetData(), p.entry->offset,
+                                     p.entry->size)) != ZX_OK) {
+            return status;
+        }
+        Digest digest;
+        if ((status = MerkleTree::Create(blob->GetData(), p.entry->size, blob->GetMerkle(),
+                                         MerkleTree::GetTreeLength(p.entry->size),
+                                         &digest)) != ZX_OK) {
+            return status;
+        } else if (digest != blob->digest_) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        } else if ((status = blob->QueueWrite(0, inode->num_blocks)) != ZX_OK) {
+            return status;
+        }
+    }
+    for (auto& p : pending) {
+        if ((status = p.blob->WaitForWrites()) != ZX_OK) {
+            return status;
+        }
+    }
+
+    if (pending.is_empty()) {
+        return ZX_OK;
+    }
+
+    // With all of the data on disk, the allocations and nodes of the whole
+    // batch are committed together. Unlike WriteNode(), the node blocks are
+    // only enqueued here, so that neighbouring nodes and bitmap blocks share
+    // a request, and everything is issued at once.
+    WriteTxn txn(blobstore_.get());
+    for (auto& p : pending) {
+        blobstore_inode_t* inode = blobstore_->GetNode(p.blob->map_index_);
+        memcpy(inode->merkle_root_hash, &p.blob->digest_[0], Digest::kLength);
+        uint64_t b = (p.blob->map_index_ * sizeof(blobstore_inode_t)) / kBlobstoreBlockSize;
+        txn.Enqueue(blobstore_->node_map_vmoid_, b, NodeMapStartBlock(blobstore_->info_) + b, 1);
+        blobstore_->EnqueueContainers(&txn, p.blob->map_index_);
+        blobstore_->EnqueueBitmap(&txn, p.blob->extents_);
+    }
+    blobstore_->CountUpdate(&txn);
+    if ((status = txn.Flush()) != ZX_OK) {
+        return status;
+    }
+
+    for (auto& p : pending) {
+        if ((status = p.blob->MarkReadable()) != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
 zx_status_t VnodeBlob::GetReadableEvent(zx_handle_t* out) {
     TRACE_DURATION("blobstore", "Blobstore::GetReadableEvent");
     zx_status_t status;
@@ -403,13 +893,25 @@ zx_status_t VnodeBlob::CopyVmo(zx_rights_t rights, zx_handle_t* out) {
     }
 
     auto inode = blobstore_->GetNode(map_index_);
-    // TODO(smklein): Only clone / verify the part of the vmo that
-    // was requested.
-    const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
+    // The paged VMO holds only the data, and is verified as it is paged in.
     zx_handle_t clone;
-    if ((status = zx_vmo_clone(blob_->GetVmo(), ZX_VMO_CLONE_COPY_ON_WRITE,
-                               data_start, inode->blob_size, &clone)) != ZX_OK) {
-        return status;
+    if (data_vmo_.is_valid()) {
+        if ((status = zx_vmo_clone(data_vmo_.get(), ZX_VMO_CLONE_COPY_ON_WRITE,
+                                   0, inode->blob_size, &clone)) != ZX_OK) {
+            return status;
+        }
+        blobstore_->pager_->AddClone(map_index_);
+    } else {
+        // Without a pager, the clone can't fault pages in on demand, so the
+        // whole blob must be read and verified before it is handed out.
+        if ((status = LoadRange(0, inode->blob_size)) != ZX_OK) {
+            return status;
+        }
+        const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
+        if ((status = zx_vmo_clone(blob_->GetVmo(), ZX_VMO_CLONE_COPY_ON_WRITE,
+                                   data_start, inode->blob_size, &clone)) != ZX_OK) {
+            return status;
+        }
     }
 
     if ((status = zx_handle_replace(clone, rights, out)) != ZX_OK) {
@@ -442,6 +944,12 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         len = inode->blob_size - off;
     }
 
+    if (data_vmo_.is_valid()) {
+        return data_vmo_.read(data, off, len, actual);
+    }
+    if ((status = LoadRange(off, len)) != ZX_OK) {
+        return status;
+    }
     const size_t data_start = MerkleTreeBlocks(*inode) * kBlobstoreBlockSize;
     return zx_vmo_read(blob_->GetVmo(), data, data_start + off, len, actual);
 }
@@ -450,24 +958,95 @@ void VnodeBlob::QueueUnlink() {
     flags_ |= kBlobFlagDeletable;
 }
 
+zx_status_t Blobstore::InitFreeExtents() {
+    TRACE_DURATION("blobstore", "Blobstore::InitFreeExtents");
+    zx_status_t status;
+    if ((status = free_extents_.SetRegionPool(
+             RegionAllocator::RegionPool::Create(kFreeExtentsPoolSize))) != ZX_OK) {
+        return status;
+    }
+    size_t start = 0;
+    while ((start = block_map_.Scan(start, block_map_.size(), true)) < block_map_.size()) {
+        const size_t end = block_map_.Scan(start, block_map_.size(), false);
+        ralloc_region_t region;
+        region.base = start;
+        region.size = end - start;
+        if ((status = free_extents_.AddRegion(region)) != ZX_OK) {
+            return status;
+        }
+        start = end;
+    }
+    return ZX_OK;
+}
+
 // Allocates Blocks IN MEMORY
-zx_status_t Blobstore::AllocateBlocks(size_t nblocks, size_t* blkno_out) {
+zx_status_t Blobstore::AllocateBlocks(size_t nblocks, ExtentList* out) {
     TRACE_DURATION("blobstore", "Blobstore::AllocateBlocks", "nblocks", nblocks);
 
-    zx_status_t status;
-    if ((status = block_map_.Find(false, 0, block_map_.size(), nblocks, blkno_out)) != ZX_OK) {
-        // If we have run out of blocks, attempt to add block slices via FVM
-        size_t old_size = block_map_.size();
-        if (AddBlocks(nblocks) != ZX_OK) {
-            return ZX_ERR_NO_SPACE;
-        } else if (block_map_.Find(false, old_size, block_map_.size(), nblocks, blkno_out)
-                   != ZX_OK) {
-            return ZX_ERR_NO_SPACE;
+    // If no free extent can hold all of the blocks, attempt to add block
+    // slices via FVM, which keeps them contiguous.
+    RegionAllocator::Region::UPtr region;
+    if (free_extents_.GetRegion(nblocks, 1, region) != ZX_OK) {
+        AddBlocks(nblocks);
+    }
+    region.reset();
+    if (info_.block_count - info_.alloc_block_count < nblocks) {
+        return ZX_ERR_NO_SPACE;
+    }
+
+    // Take the smallest free extent which holds whatever is left to allocate.
+    // Failing that, the blocks are split over the largest extents found by
+    // halving the length asked for.
+    ExtentList extents;
+    zx_status_t status = ZX_OK;
+    uint64_t remaining = nblocks;
+    uint64_t length = nblocks;
+    while (remaining > 0) {
+        length = fbl::min(length, remaining);
+        if ((status = free_extents_.GetRegion(length, 1, region)) == ZX_ERR_NOT_FOUND &&
+            length > 1) {
+            length /= 2;
+            continue;
+        } else if (status != ZX_OK) {
+            break;
+        }
+
+        // Only free blocks are indexed, so the region goes straight back, to
+        // be taken out of the index.
+        ralloc_region_t taken;
+        taken.base = region->base;
+        taken.size = region->size;
+        region.reset();
+        if ((status = free_extents_.SubtractRegion(taken)) != ZX_OK) {
+            break;
         }
+        status = block_map_.Set(taken.base, taken.base + taken.size);
+        assert(status == ZX_OK);
+        info_.alloc_block_count += taken.size;
+
+        if (!extents.is_empty() &&
+            extents[extents.size() - 1].start + extents[extents.size() - 1].length ==
+            taken.base) {
+            extents[extents.size() - 1].length += taken.size;
+        } else {
+            fbl::AllocChecker ac;
+            extents.push_back({taken.base, taken.size}, &ac);
+            if (!ac.check()) {
+                FreeBlocks(taken.size, taken.base);
+                status = ZX_ERR_NO_MEMORY;
+                break;
+            }
+        }
+        remaining -= taken.size;
     }
-    status = block_map_.Set(*blkno_out, *blkno_out + nblocks);
-    assert(status == ZX_OK);
-    info_.alloc_block_count += nblocks;
+
+    if (remaining > 0) {
+        for (const blobstore_extent_t& extent : extents) {
+            FreeBlocks(extent.length, extent.start);
+        }
+        return status == ZX_ERR_NOT_FOUND ? ZX_ERR_NO_SPACE : status;
+    }
+    *out = fbl::move(extents);
     return ZX_OK;
 }
 
@@ -477,6 +1056,128 @@ void Blobstore::FreeBlocks(size_t nblocks, size_t blkno) {
     zx_status_t status = block_map_.Clear(blkno, blkno + nblocks);
     info_.alloc_block_count -= nblocks;
     assert(status == ZX_OK);
+
+    ralloc_region_t region;
+    region.base = blkno;
+    region.size = nblocks;
+    if ((status = free_extents_.AddRegion(region)) != ZX_OK) {
+        // The blocks are free all the same, and are indexed again at the next
+        // mount.
+        FS_TRACE_ERROR("blobstore: Failed to index free blocks: %d\n", status);
+    }
+}
+
+blobstore_extent_container_t* Blobstore::GetContainer(size_t index) const {
+    if (index == 0 || index >= info_.inode_count) {
+        return nullptr;
+    }
+    auto container = reinterpret_cast<blobstore_extent_container_t*>(GetNode(index));
+    if (container->start_block != kStartBlockReserved ||
+        !(container->flags & kBlobInodeFlagContainer) ||
+        container->extent_count > kBlobstoreContainerExtents) {
+        return nullptr;
+    }
+    return container;
+}
+
+zx_status_t Blobstore::SetExtents(size_t node_index, const ExtentList& extents) {
+    ZX_DEBUG_ASSERT(!extents.is_empty());
+    GetNode(node_index)->start_block = extents[0].start;
+    if (extents.size() == 1) {
+        FreeContainers(node_index);
+        return ZX_OK;
+    }
+
+    // Fill in the chain of containers, reusing those the blob already has.
+    // Allocating a node may grow the node map, so nodes are only held by
+    // index meanwhile.
+    size_t prev = node_index;
+    for (size_t i = 0; i < extents.size(); i += kBlobstoreContainerExtents) {
+        size_t index = GetNode(prev)->next_node;
+        if (index == 0) {
+            zx_status_t status;
+            if ((status = AllocateNode(&index)) != ZX_OK) {
+                return status;
+            }
+            ZX_DEBUG_ASSERT(index <= fbl::numeric_limits<uint32_t>::max());
+            GetNode(prev)->next_node = static_cast<uint32_t>(index);
+        }
+        auto container = reinterpret_cast<blobstore_extent_container_t*>(GetNode(index));
+        container->flags = kBlobInodeFlagContainer;
+        container->extent_count = fbl::min<uint64_t>(extents.size() - i,
+                                                     kBlobstoreContainerExtents);
+        for (size_t j = 0; j < container->extent_count; j++) {
+            container->extents[j] = extents[i + j];
+        }
+        prev = index;
+    }
+    FreeContainers(prev);
+    return ZX_OK;
+}
+
+zx_status_t Blobstore::LoadExtents(size_t node_index, ExtentList* out) const {
+    const blobstore_inode_t* inode = GetNode(node_index);
+    ExtentList extents;
+    fbl::AllocChecker ac;
+    if (inode->next_node == 0) {
+        extents.push_back({inode->start_block, inode->num_blocks}, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        *out = fbl::move(extents);
+        return ZX_OK;
+    }
+
+    // Every extent holds at least one more of the blob's blocks, which
+    // bounds the walk even on a corrupt chain.
+    uint64_t total = 0;
+    for (size_t next = inode->next_node; next != 0;) {
+        const blobstore_extent_container_t* container = GetContainer(next);
+        if (container == nullptr) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        for (size_t i = 0; i < container->extent_count; i++) {
+            const blobstore_extent_t& extent = container->extents[i];
+            if (extent.length == 0 || extent.length > inode->num_blocks - total ||
+                extent.start > info_.block_count ||
+                extent.length > info_.block_count - extent.start) {
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            extents.push_back(extent, &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
+            total += extent.length;
+        }
+        next = container->next_node;
+    }
+    if (total != inode->num_blocks) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    *out = fbl::move(extents);
+    return ZX_OK;
+}
+
+void Blobstore::FreeContainers(size_t node_index) {
+    size_t next = GetNode(node_index)->next_node;
+    GetNode(node_index)->next_node = 0;
+    const blobstore_extent_container_t* container;
+    while ((container = GetContainer(next)) != nullptr) {
+        const size_t index = next;
+        next = container->next_node;
+        FreeNode(index);
+    }
+}
+
+void Blobstore::EnqueueContainers(WriteTxn* txn, size_t node_index) {
+    size_t count = 0;
+    const blobstore_extent_container_t* container;
+    for (size_t next = GetNode(node_index)->next_node;
+         (container = GetContainer(next)) != nullptr && count < info_.inode_count;
+         next = container->next_node, count++) {
+        uint64_t b = (next * sizeof(blobstore_inode_t)) / kBlobstoreBlockSize;
+        txn->Enqueue(node_map_vmoid_, b, NodeMapStartBlock(info_) + b, 1);
+    }
 }
 
 // Allocates a node IN MEMORY
@@ -544,6 +1245,17 @@ zx_status_t Blobstore::WriteBitmap(WriteTxn* txn, uint64_t nblocks, uint64_t sta
     return txn->Flush();
 }
 
+void Blobstore::EnqueueBitmap(WriteTxn* txn, const ExtentList& extents) {
+    for (const blobstore_extent_t& extent : extents) {
+        uint64_t bbm_start_block = extent.start / kBlobstoreBlockBits;
+        uint64_t bbm_end_block = fbl::round_up(extent.start + extent.length,
+                                               kBlobstoreBlockBits) / kBlobstoreBlockBits;
+        txn->Enqueue(block_map_vmoid_, bbm_start_block,
+                     BlockMapStartBlock(info_) + bbm_start_block,
+                     bbm_end_block - bbm_start_block);
+    }
+}
+
 zx_status_t Blobstore::WriteNode(WriteTxn* txn, size_t map_index) {
     TRACE_DURATION("blobstore", "Blobstore::WriteNode", "map_index", map_index);
     uint64_t b = (map_index * sizeof(blobstore_inode_t)) / kBlobstoreBlockSize;
@@ -573,11 +1285,8 @@ zx_status_t Blobstore::NewBlob(const Digest& digest, fbl::RefPtr<VnodeBlob>* out
 zx_status_t Blobstore::ReleaseBlob(VnodeBlob* vn) {
     TRACE_DURATION("blobstore", "Blobstore::ReleaseBlob");
 
-    // TODO(smklein): What if kBlobFlagSync is set? Do we risk writing out
-    // parts of the blob AFTER it has been deleted?
-    // Ex: open, alloc, disk write async start, unlink, release, disk write async end.
-    // FWIW, this isn't a problem right now with synchronous writes, but it
-    // would become a problem with asynchronous writes.
+    // Data blocks queued to the writeback have all landed by now; the vnode
+    // waits for them before releasing itself.
     switch (vn->GetState()) {
     case kBlobStateEmpty: {
         // There are no in-memory or on-disk structures allocated.
@@ -596,13 +1305,25 @@ zx_status_t Blobstore::ReleaseBlob(VnodeBlob* vn) {
     case kBlobStateError: {
         vn->SetState(kBlobStateReleasing);
         size_t node_index = vn->GetMapIndex();
-        uint64_t start_block = GetNode(node_index)->start_block;
-        uint64_t nblocks = GetNode(node_index)->num_blocks;
-        FreeNode(node_index);
-        FreeBlocks(nblocks, start_block);
+        if (pager_ != nullptr) {
+            pager_->Purge(node_index);
+        }
+        ExtentList extents;
+        zx_status_t status = LoadExtents(node_index, &extents);
+        if (status != ZX_OK) {
+            // Leak the blocks rather than free those of another blob.
+            FS_TRACE_ERROR("blobstore: Failed to load extents of released blob: %d\n", status);
+        }
         WriteTxn txn(this);
+        // The containers are written back once freed.
+        EnqueueContainers(&txn, node_index);
+        FreeContainers(node_index);
+        FreeNode(node_index);
+        for (const blobstore_extent_t& extent : extents) {
+            FreeBlocks(extent.length, extent.start);
+        }
+        EnqueueBitmap(&txn, extents);
         WriteNode(&txn, node_index);
-        WriteBitmap(&txn, nblocks, start_block);
         CountUpdate(&txn);
         hash_.erase(*vn);
         return ZX_OK;
@@ -685,29 +1406,48 @@ zx_status_t Blobstore::LookupBlob(const Digest& digest, fbl::RefPtr<VnodeBlob>*
         return ZX_OK;
     }
 
-    // Look up blob in the slow map
-    for (size_t i = 0; i < info_.inode_count; ++i) {
-        if (GetNode(i)->start_block >= kStartBlockMinimum) {
-            if (digest == GetNode(i)->merkle_root_hash) {
-                if (out != nullptr) {
-                    // Found it. Attempt to wrap the blob in a vnode.
-                    fbl::AllocChecker ac;
-                    fbl::RefPtr<VnodeBlob> vn =
-                        fbl::AdoptRef(new (&ac) VnodeBlob(fbl::RefPtr<Blobstore>(this), digest));
-                    if (!ac.check()) {
-                        return ZX_ERR_NO_MEMORY;
-                    }
-                    vn->SetState(kBlobStateReadable);
-                    vn->SetMapIndex(i);
-                    // Delay reading any data from disk until read.
-                    hash_.insert(vn.get());
-                    *out = fbl::move(vn);
-                }
-                return ZX_OK;
+    // Look up blob among those closed recently, and then in the slow map
+    CachedBlob* cached = cache_.Find(digest);
+    size_t index = info_.inode_count;
+    if (cached != nullptr) {
+        index = cached->map_index;
+    } else {
+        for (size_t i = 0; i < info_.inode_count; ++i) {
+            if (GetNode(i)->start_block >= kStartBlockMinimum &&
+                digest == GetNode(i)->merkle_root_hash) {
+                index = i;
+                break;
             }
         }
     }
-    return ZX_ERR_NOT_FOUND;
+    if (index == info_.inode_count) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    if (out == nullptr) {
+        return ZX_OK;
+    }
+
+    // Found it. Attempt to wrap the blob in a vnode.
+    fbl::AllocChecker ac;
+    vn = fbl::AdoptRef(new (&ac) VnodeBlob(fbl::RefPtr<Blobstore>(this), digest));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    vn->SetState(kBlobStateReadable);
+    vn->SetMapIndex(index);
+    if (cached != nullptr) {
+        // A cached blob comes with its contents already read and verified.
+        zx_status_t status = vn->AdoptCached(cache_.Remove(cached));
+        if (status != ZX_OK) {
+            return status;
+        }
+    } else {
+        // Delay reading any data from disk until read.
+        cache_.RecordMiss();
+    }
+    hash_.insert(vn.get());
+    *out = fbl::move(vn);
+    return ZX_OK;
 }
 
 zx_status_t Blobstore::AttachVmo(zx_handle_t vmo, vmoid_t* out) {
@@ -724,6 +1464,13 @@ zx_status_t Blobstore::AttachVmo(zx_handle_t vmo, vmoid_t* out) {
     return ZX_OK;
 }
 
+void Blobstore::DetachVmo(vmoid_t vmoid) {
+    block_fifo_request_t request;
+    request.vmoid = vmoid;
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    Txn(&request, 1);
+}
+
 zx_status_t Blobstore::AddInodes() {
     TRACE_DURATION("blobstore", "Blobstore::AddInodes");
 
@@ -816,6 +1563,15 @@ zx_status_t Blobstore::AddBlocks(size_t nblocks) {
                     abmblks - abmblks_old);
     }
 
+    ralloc_region_t region;
+    region.base = info_.block_count;
+    region.size = blocks - info_.block_count;
+    zx_status_t status;
+    if ((status = free_extents_.AddRegion(region)) != ZX_OK) {
+        // The blocks are free all the same, and are indexed at the next mount.
+        FS_TRACE_ERROR("blobstore: Failed to index added blocks: %d\n", status);
+    }
+
     info_.vslice_count += request.length;
     info_.dat_slices += static_cast<uint32_t>(request.length);
     info_.block_count = blocks;
@@ -827,15 +1583,19 @@ zx_status_t Blobstore::AddBlocks(size_t nblocks) {
 
 
 Blobstore::Blobstore(fbl::unique_fd fd, const blobstore_info_t* info)
-    : blockfd_(fbl::move(fd)) {
+    : blockfd_(fbl::move(fd)), cache_(this) {
     memcpy(&info_, info, sizeof(blobstore_info_t));
 }
 
 Blobstore::~Blobstore() {
-    if (fifo_client_ != nullptr) {
-        ioctl_block_free_txn(Fd(), &txnid_);
+    // The cache, the pager and the writeback go through the fifo.
+    cache_.Clear();
+    pager_.reset();
+    writeback_.reset();
+    if (block_client_ != nullptr) {
+        io_loop_.Shutdown();
+        block_client_.reset();
         ioctl_block_fifo_close(Fd());
-        block_fifo_release_client(fifo_client_);
     }
 }
 
@@ -862,13 +1622,12 @@ zx_status_t Blobstore::Create(fbl::unique_fd fd, const blobstore_info_t* info,
         return ZX_ERR_IO;
     } else if ((r = ioctl_block_get_fifos(fs->Fd(), &fifo)) < 0) {
         return static_cast<zx_status_t>(r);
-    } else if ((r = ioctl_block_alloc_txn(fs->Fd(), &fs->txnid_)) < 0) {
-        zx_handle_close(fifo);
-        return static_cast<zx_status_t>(r);
-    } else if ((status = block_fifo_create_client(fifo, &fs->fifo_client_)) != ZX_OK) {
-        ioctl_block_free_txn(fs->Fd(), &fs->txnid_);
+    } else if ((status = fs->io_loop_.StartThread("blobstore-io")) != ZX_OK) {
         zx_handle_close(fifo);
         return status;
+    } else if ((status = block_client::Client::Create(fs->Fd(), fifo, fs->io_loop_.async(),
+                                                      &fs->block_client_)) != ZX_OK) {
+        return status;
     }
 
     // Keep the block_map_ aligned to a block multiple
@@ -894,6 +1653,9 @@ zx_status_t Blobstore::Create(fbl::unique_fd fd, const blobstore_info_t* info,
     } else if ((status = fs->LoadBitmaps()) < 0) {
         fprintf(stderr, "blobstore: Failed to load bitmaps: %d\n", status);
         return status;
+    } else if ((status = fs->InitFreeExtents()) != ZX_OK) {
+        fprintf(stderr, "blobstore: Failed to index free blocks: %d\n", status);
+        return status;
     } else if ((status = MappedVmo::Create(kBlobstoreBlockSize, "blobstore-superblock",
                                            &fs->info_vmo_)) != ZX_OK) {
         fprintf(stderr, "blobstore: Failed to create info vmo: %d\n", status);
@@ -907,6 +1669,19 @@ zx_status_t Blobstore::Create(fbl::unique_fd fd, const blobstore_info_t* info,
         return status;
     }
 
+    // Without a pager, blobs are read and verified in whole when opened.
+    if ((status = BlobPager::Create(fs.get(), &fs->pager_)) != ZX_OK) {
+        fprintf(stderr, "blobstore: Failed to create pager: %d\n", status);
+    }
+    // Without the canary, the cache is not emptied under memory pressure.
+    if ((status = fs->cache_.Init()) != ZX_OK) {
+        fprintf(stderr, "blobstore: Failed to watch for memory pressure: %d\n", status);
+    }
+    // Without a writeback thread, blob data is written synchronously.
+    if ((status = BlobWriteback::Create(fs.get(), &fs->writeback_)) != ZX_OK) {
+        fprintf(stderr, "blobstore: Failed to create writeback: %d\n", status);
+    }
+
     *out = fs;
     return ZX_OK;
 }
@@ -969,13 +1744,15 @@ zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd
     return ZX_OK;
 }
 
-zx_status_t blobstore_mount(fbl::RefPtr<VnodeBlob>* out, fbl::unique_fd blockfd) {
+zx_status_t blobstore_mount(fbl::RefPtr<VnodeBlob>* out, fbl::unique_fd blockfd,
+                            bool compress) {
     zx_status_t status;
     fbl::RefPtr<Blobstore> fs;
 
     if ((status = blobstore_create(&fs, fbl::move(blockfd))) != ZX_OK) {
         return status;
     }
+    fs->SetCompression(compress);
 
     if ((status = fs->GetRootBlob(out)) != ZX_OK) {
         fprintf(stderr, "blobstore: mount failed; could not get root blob\n");
@@ -0,0 +1,130 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <zircon/syscalls.h>
+
+#include <blobstore/blobstore.h>
+
+namespace blobstore {
+namespace {
+
+// The size of the memory pressure canary.
+constexpr uint64_t kCanarySize = kBlobstoreBlockSize;
+
+} // namespace
+
+BlobCache::BlobCache(Blobstore* blobstore) : blobstore_(blobstore) {}
+
+BlobCache::~BlobCache() {
+    ZX_DEBUG_ASSERT(lru_.is_empty());
+}
+
+zx_status_t BlobCache::Init() {
+    zx::vmo canary;
+    zx_status_t status;
+    uint32_t discarded;
+    size_t actual;
+    const uint8_t one = 1;
+    if ((status = zx::vmo::create(kCanarySize, ZX_VMO_DISCARDABLE, &canary)) != ZX_OK) {
+        return status;
+    } else if ((status = canary.op_range(ZX_VMO_OP_LOCK, 0, kCanarySize, &discarded,
+                                         sizeof(discarded))) != ZX_OK) {
+        return status;
+    } else if ((status = canary.write(&one, 0, sizeof(one), &actual)) != ZX_OK) {
+        return status;
+    } else if ((status = canary.op_range(ZX_VMO_OP_UNLOCK, 0, kCanarySize, nullptr, 0)) != ZX_OK) {
+        return status;
+    }
+    canary_ = fbl::move(canary);
+    return ZX_OK;
+}
+
+void BlobCache::Insert(fbl::unique_ptr<CachedBlob> cached) {
+    TRACE_DURATION("blobstore", "BlobCache::Insert", "bytes", cached->bytes);
+    CheckPressure();
+    if (cached->bytes > capacity_) {
+        evictions_++;
+        Evict(fbl::move(cached));
+        return;
+    }
+    while (bytes_ + cached->bytes > capacity_) {
+        evictions_++;
+        Evict(PopOldest());
+    }
+    bytes_ += cached->bytes;
+    lru_.push_back(fbl::move(cached));
+}
+
+CachedBlob* BlobCache::Find(const Digest& digest) {
+    CheckPressure();
+    auto iter = lru_.find_if([&digest](const CachedBlob& cached) {
+        return digest == cached.digest;
+    });
+    return iter.IsValid() ? &*iter : nullptr;
+}
+
+fbl::unique_ptr<CachedBlob> BlobCache::Remove(CachedBlob* cached) {
+    hits_++;
+    bytes_ -= cached->bytes;
+    return lru_.erase(*cached);
+}
+
+void BlobCache::Clear() {
+    while (!lru_.is_empty()) {
+        Evict(PopOldest());
+    }
+}
+
+void BlobCache::GetInfo(vfs_blob_cache_info_t* info) const {
+    info->hits = hits_;
+    info->misses = misses_;
+    info->evictions = evictions_;
+    info->pressure_evictions = pressure_evictions_;
+    info->entries = lru_.size_slow();
+    info->bytes = bytes_;
+    info->capacity = capacity_;
+}
+
+fbl::unique_ptr<CachedBlob> BlobCache::PopOldest() {
+    fbl::unique_ptr<CachedBlob> cached = lru_.pop_front();
+    bytes_ -= cached->bytes;
+    return cached;
+}
+
+void BlobCache::Evict(fbl::unique_ptr<CachedBlob> cached) {
+    if (cached->data_vmo.is_valid()) {
+        cached->data_vmo.reset();
+        blobstore_->pager_->Release(cached->map_index);
+    }
+    if (cached->blob != nullptr) {
+        blobstore_->DetachVmo(cached->vmoid);
+    }
+}
+
+void BlobCache::CheckPressure() {
+    if (!canary_.is_valid()) {
+        return;
+    }
+    uint32_t discarded = 0;
+    if (canary_.op_range(ZX_VMO_OP_LOCK, 0, kCanarySize, &discarded,
+                         sizeof(discarded)) != ZX_OK) {
+        return;
+    }
+    if (discarded) {
+        while (!lru_.is_empty()) {
+            pressure_evictions_++;
+            Evict(PopOldest());
+        }
+
+        // Give the kernel something to discard the next time around.
+        size_t actual;
+        const uint8_t one = 1;
+        canary_.write(&one, 0, sizeof(one), &actual);
+    }
+    canary_.op_range(ZX_VMO_OP_UNLOCK, 0, kCanarySize, nullptr, 0);
+}
+
+} // namespace blobstore
@@ -188,21 +188,18 @@ int blobstore_mkfs(int fd, uint64_t block_count) {
 
         const size_t kBlocksPerSlice = info.slice_size / kBlobstoreBlockSize;
 
-        extend_request_t request;
-        request.length = 1;
-        request.offset = kFVMBlockMapStart / kBlocksPerSlice;
-        if (ioctl_block_fvm_extend(fd, &request) < 0) {
-            fprintf(stderr, "blobstore mkfs: Failed to allocate block map\n");
-            return -1;
-        }
-        request.offset = kFVMNodeMapStart / kBlocksPerSlice;
-        if (ioctl_block_fvm_extend(fd, &request) < 0) {
-            fprintf(stderr, "blobstore mkfs: Failed to allocate node map\n");
-            return -1;
+        // Allocate the block map, node map and data slices with a single
+        // metadata update.
+        extend_batch_request_t request;
+        request.count = 3;
+        request.extents[0].offset = kFVMBlockMapStart / kBlocksPerSlice;
+        request.extents[1].offset = kFVMNodeMapStart / kBlocksPerSlice;
+        request.extents[2].offset = kFVMDataStart / kBlocksPerSlice;
+        for (size_t i = 0; i < request.count; i++) {
+            request.extents[i].length = 1;
         }
-        request.offset = kFVMDataStart / kBlocksPerSlice;
-        if (ioctl_block_fvm_extend(fd, &request) < 0) {
-            fprintf(stderr, "blobstore mkfs: Failed to allocate data blocks\n");
+        if (ioctl_block_fvm_extend_batch(fd, &request) < 0) {
+            fprintf(stderr, "blobstore mkfs: Failed to allocate slices\n");
             return -1;
         }
 
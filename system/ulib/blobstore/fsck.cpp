@@ -3,24 +3,344 @@
 // found in the LICENSE file.
 
 #include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <blobstore/common.h>
 #include <blobstore/fsck.h>
+#include <digest/merkle-tree.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/array.h>
+#include <fbl/unique_ptr.h>
 
 #ifdef __Fuchsia__
+#include <threads.h>
+
 #include <blobstore/blobstore.h>
+#include <lz4/lz4.h>
+#include <zircon/syscalls.h>
 #else
 #include <blobstore/host.h>
 #endif
 
-//TODO(planders): Add more checks for fsck.
+using digest::Digest;
+using digest::MerkleTree;
+
 namespace blobstore {
+namespace {
+
+uint64_t MonotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+#ifdef __Fuchsia__
+// Each thread scans at least this many nodes; below that the cost of the
+// thread outweighs the work it takes on.
+constexpr uint32_t kMinNodesPerThread = 1024;
+constexpr uint32_t kMaxScanThreads = 8;
+
+// Decompresses the LZ4 chunks of a compressed blob from |src| into |dst|,
+// with the same checks on the chunk table as the blob's own reads.
+zx_status_t DecompressBlob(const blobstore_inode_t& inode, const uint8_t* src, size_t src_len,
+                           uint8_t* dst) {
+    const uint64_t* table = reinterpret_cast<const uint64_t*>(src);
+    const uint64_t chunks = CompressedChunks(inode);
+    const uint64_t bound = LZ4_compressBound(static_cast<int>(kBlobstoreCompressionChunkSize));
+    for (uint64_t i = 0; i < chunks; i++) {
+        const uint64_t src_off = table[i];
+        const uint64_t src_end = table[i + 1];
+        if (src_off < CompressedTableSize(inode) || src_off > src_end || src_end > src_len ||
+            src_end - src_off > bound) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        const uint64_t off = i * kBlobstoreCompressionChunkSize;
+        const int len = static_cast<int>(fbl::min(kBlobstoreCompressionChunkSize,
+                                                  inode.blob_size - off));
+        if (LZ4_decompress_safe(reinterpret_cast<const char*>(src + src_off),
+                                reinterpret_cast<char*>(dst + off),
+                                static_cast<int>(src_end - src_off), len) != len) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    return ZX_OK;
+}
+#endif
+
+} // namespace
+
+BlobstoreChecker::BlobstoreChecker()
+    : blobstore_(nullptr), alloc_inodes_(0), alloc_blocks_(0), bad_blobs_(0) {}
+
+void BlobstoreChecker::Init(fbl::RefPtr<Blobstore> blob) {
+    blobstore_.reset(blob.get());
+}
+
+int BlobstoreChecker::ScanThread(void* arg) {
+    auto scan = static_cast<NodeScan*>(arg);
+    scan->checker->ScanNodes(scan);
+    return 0;
+}
+
+zx_status_t BlobstoreChecker::ReadBlocks(uint64_t start, uint64_t count, void* data) const {
+#ifdef __Fuchsia__
+    const int fd = blobstore_->Fd();
+    const off_t base = DataStartBlock(blobstore_->info_) * kBlobstoreBlockSize;
+#else
+    const int fd = blobstore_->blockfd_.get();
+    const off_t base = blobstore_->offset_ + blobstore_->data_start_block_ * kBlobstoreBlockSize;
+#endif
+    const size_t len = count * kBlobstoreBlockSize;
+    if (pread(fd, data, len, base + start * kBlobstoreBlockSize) != static_cast<ssize_t>(len)) {
+        FS_TRACE_ERROR("check: cannot read blocks %" PRIu64 "-%" PRIu64 "\n", start,
+                       start + count - 1);
+        return ZX_ERR_IO;
+    }
+    return ZX_OK;
+}
+
+bool BlobstoreChecker::CollectExtents(NodeScan* scan, uint32_t node,
+                                      const blobstore_inode_t& inode) {
+    fbl::AllocChecker ac;
+    if (inode.next_node == 0) {
+        scan->refs.push_back({inode.start_block, inode.num_blocks, node}, &ac);
+        if (!ac.check()) {
+            scan->status = ZX_ERR_NO_MEMORY;
+            return false;
+        }
+        return true;
+    }
+
+    // A well formed chain visits each node at most once, which bounds the
+    // walk even through a cycle.
+    uint64_t total = 0;
+    uint32_t hops = 0;
+    blobstore_extent_container_t container;
+    for (uint32_t next = inode.next_node; next != 0;) {
+        if (next >= blobstore_->info_.inode_count || ++hops > blobstore_->info_.inode_count) {
+            FS_TRACE_ERROR("check: blob %u has a bad extent chain\n", node);
+            return false;
+        }
+        const blobstore_inode_t* raw = blobstore_->GetNode(next);
+        if (raw == nullptr) {
+            scan->status = ZX_ERR_IO;
+            return false;
+        }
+        memcpy(&container, raw, sizeof(container));
+        if (container.start_block != kStartBlockReserved ||
+            !(container.flags & kBlobInodeFlagContainer) ||
+            container.extent_count > kBlobstoreContainerExtents) {
+            FS_TRACE_ERROR("check: blob %u links to node %u, which is not an extent "
+                           "container\n", node, next);
+            return false;
+        }
+        for (uint64_t i = 0; i < container.extent_count; i++) {
+            const blobstore_extent_t& extent = container.extents[i];
+            if (extent.length == 0 || extent.length > inode.num_blocks - total) {
+                FS_TRACE_ERROR("check: blob %u has an extent of bad length %" PRIu64 "\n",
+                               node, extent.length);
+                return false;
+            }
+            scan->refs.push_back({extent.start, extent.length, node}, &ac);
+            if (!ac.check()) {
+                scan->status = ZX_ERR_NO_MEMORY;
+                return false;
+            }
+            total += extent.length;
+        }
+        next = container.next_node;
+    }
+    if (total != inode.num_blocks) {
+        FS_TRACE_ERROR("check: blob %u has %" PRIu64 " blocks in its extents (should be %"
+                       PRIu64 ")\n", node, total, inode.num_blocks);
+        return false;
+    }
+    return true;
+}
+
+zx_status_t BlobstoreChecker::VerifyBlob(const blobstore_inode_t& inode, const BlockRef* extents,
+                                         size_t count) {
+    const uint64_t block_count = blobstore_->info_.block_count;
+    for (size_t i = 0; i < count; i++) {
+        if (extents[i].start > block_count || extents[i].length > block_count - extents[i].start) {
+            // Reported by CheckBlockReferences().
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+    }
+
+    const uint64_t merkle_blocks = MerkleTreeBlocks(inode);
+    if (inode.num_blocks < merkle_blocks) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    const bool compressed = inode.flags & kBlobInodeFlagLZ4;
+#ifndef __Fuchsia__
+    if (compressed) {
+        // The host library does not carry a decompressor; the device checks
+        // these.
+        return ZX_OK;
+    }
+#endif
+    if (!compressed && inode.num_blocks - merkle_blocks < BlobDataBlocks(inode)) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> blob(new (&ac) uint8_t[inode.num_blocks * kBlobstoreBlockSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status;
+    uint8_t* dst = blob.get();
+    for (size_t i = 0; i < count; i++) {
+        if ((status = ReadBlocks(extents[i].start, extents[i].length, dst)) != ZX_OK) {
+            return status;
+        }
+        dst += extents[i].length * kBlobstoreBlockSize;
+    }
+
+    const uint8_t* tree = blob.get();
+    const uint8_t* data = blob.get() + merkle_blocks * kBlobstoreBlockSize;
+#ifdef __Fuchsia__
+    fbl::unique_ptr<uint8_t[]> decompressed;
+    if (compressed) {
+        const size_t src_len = (inode.num_blocks - merkle_blocks) * kBlobstoreBlockSize;
+        if (src_len < CompressedTableSize(inode)) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        decompressed.reset(new (&ac) uint8_t[inode.blob_size]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        if ((status = DecompressBlob(inode, data, src_len, decompressed.get())) != ZX_OK) {
+            return status;
+        }
+        data = decompressed.get();
+    }
+#endif
+
+    Digest digest(inode.merkle_root_hash);
+    return MerkleTree::Verify(data, inode.blob_size, tree,
+                              MerkleTree::GetTreeLength(inode.blob_size), 0, inode.blob_size,
+                              digest);
+}
+
+void BlobstoreChecker::ScanNodes(NodeScan* scan) {
+    for (uint32_t n = scan->start; n < scan->end; n++) {
+        // The host reads nodes through a single cached block, so each one is
+        // copied out before the next is read.
+        const blobstore_inode_t* raw = blobstore_->GetNode(n);
+        if (raw == nullptr) {
+            scan->status = ZX_ERR_IO;
+            return;
+        }
+        blobstore_inode_t inode;
+        memcpy(&inode, raw, sizeof(inode));
+
+        if (inode.start_block == kStartBlockReserved && (inode.flags & kBlobInodeFlagContainer)) {
+            // Extent containers take up nodes of their own.
+            scan->alloc_inodes++;
+            continue;
+        } else if (inode.start_block < kStartBlockMinimum) {
+            continue;
+        }
+        scan->alloc_inodes++;
+        scan->blobs++;
+
+        const size_t first = scan->refs.size();
+        if (!CollectExtents(scan, n, inode)) {
+            if (scan->status != ZX_OK) {
+                return;
+            }
+            scan->bad_blobs++;
+            continue;
+        }
+        zx_status_t status = VerifyBlob(inode, scan->refs.get() + first,
+                                        scan->refs.size() - first);
+        if (status == ZX_ERR_NO_MEMORY || status == ZX_ERR_IO) {
+            scan->status = status;
+            return;
+        } else if (status != ZX_OK && status != ZX_ERR_OUT_OF_RANGE) {
+            FS_TRACE_ERROR("check: blob %u failed verification: %d\n", n, status);
+            scan->bad_blobs++;
+        }
+    }
+}
+
+zx_status_t BlobstoreChecker::TraverseInodeBitmap() {
+    const uint64_t start_ms = MonotonicMs();
+    const uint32_t inode_count = static_cast<uint32_t>(blobstore_->info_.inode_count);
+
+    uint32_t num_threads = 1;
+#ifdef __Fuchsia__
+    num_threads = fbl::min(zx_system_get_num_cpus(), kMaxScanThreads);
+    num_threads = fbl::max(fbl::min(num_threads, inode_count / kMinNodesPerThread), 1u);
+#endif
+
+    fbl::AllocChecker ac;
+    fbl::Array<NodeScan> scans(new (&ac) NodeScan[num_threads], num_threads);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    const uint32_t per_thread = fbl::round_up(inode_count, num_threads) / num_threads;
+    for (uint32_t i = 0; i < num_threads; i++) {
+        NodeScan& scan = scans[i];
+        scan.checker = this;
+        scan.start = fbl::min(i * per_thread, inode_count);
+        scan.end = fbl::min(scan.start + per_thread, inode_count);
+        scan.alloc_inodes = 0;
+        scan.blobs = 0;
+        scan.bad_blobs = 0;
+        scan.status = ZX_OK;
+    }
+
+#ifdef __Fuchsia__
+    // The first share runs on this thread; a share whose thread can't be
+    // started runs here too.
+    fbl::Array<thrd_t> threads(new (&ac) thrd_t[num_threads], num_threads);
+    fbl::Array<bool> started(new (&ac) bool[num_threads], num_threads);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (uint32_t i = 1; i < num_threads; i++) {
+        started[i] = thrd_create(&threads[i], ScanThread, &scans[i]) == thrd_success;
+    }
+    ScanNodes(&scans[0]);
+    for (uint32_t i = 1; i < num_threads; i++) {
+        if (started[i]) {
+            thrd_join(threads[i], nullptr);
+        } else {
+            ScanNodes(&scans[i]);
+        }
+    }
+#else
+    ScanNodes(&scans[0]);
+#endif
 
-void BlobstoreChecker::TraverseInodeBitmap() {
-    for (unsigned n = 0; n < blobstore_->info_.inode_count; n++) {
-        blobstore_inode_t* inode = blobstore_->GetNode(n);
-        if (inode->start_block >= kStartBlockMinimum) {
-            alloc_inodes_++;
+    uint32_t blobs = 0;
+    for (uint32_t i = 0; i < num_threads; i++) {
+        NodeScan& scan = scans[i];
+        if (scan.status != ZX_OK) {
+            FS_TRACE_ERROR("check: cannot scan nodes %u-%u: %d\n", scan.start, scan.end - 1,
+                           scan.status);
+            return scan.status;
+        }
+        alloc_inodes_ += scan.alloc_inodes;
+        blobs += scan.blobs;
+        bad_blobs_ += scan.bad_blobs;
+        for (const BlockRef& ref : scan.refs) {
+            refs_.push_back(ref, &ac);
+            if (!ac.check()) {
+                return ZX_ERR_NO_MEMORY;
+            }
         }
     }
+
+    FS_TRACE_INFO("check: verified %u blobs in %u nodes on %u thread%s in %" PRIu64 " ms\n",
+                  blobs, inode_count, num_threads, num_threads == 1 ? "" : "s",
+                  MonotonicMs() - start_ms);
+    return ZX_OK;
 }
 
 void BlobstoreChecker::TraverseBlockBitmap() {
@@ -31,6 +351,57 @@ void BlobstoreChecker::TraverseBlockBitmap() {
     }
 }
 
+zx_status_t BlobstoreChecker::CheckBlockReferences() {
+    const uint64_t block_count = blobstore_->info_.block_count;
+    zx_status_t status = ZX_OK;
+    RawBitmap seen;
+    if ((status = seen.Reset(block_count)) != ZX_OK) {
+        return status;
+    }
+    // Blocks below kStartBlockMinimum are reserved, and referenced by
+    // nothing.
+    seen.Set(0, fbl::min(kStartBlockMinimum, block_count));
+
+    for (const BlockRef& ref : refs_) {
+        if (ref.start < kStartBlockMinimum || ref.start > block_count ||
+            ref.length > block_count - ref.start) {
+            FS_TRACE_ERROR("check: blob %u references blocks %" PRIu64 "-%" PRIu64
+                           " out of range\n", ref.node, ref.start, ref.start + ref.length - 1);
+            status = ZX_ERR_BAD_STATE;
+            continue;
+        }
+        for (uint64_t bno = ref.start; bno < ref.start + ref.length; bno++) {
+            if (!blobstore_->block_map_.Get(bno, bno + 1)) {
+                FS_TRACE_ERROR("check: blob %u references unallocated block %" PRIu64 "\n",
+                               ref.node, bno);
+                status = ZX_ERR_BAD_STATE;
+            }
+            if (seen.Get(bno, bno + 1)) {
+                FS_TRACE_ERROR("check: block %" PRIu64 " referenced more than once (by blob %u)"
+                               "\n", bno, ref.node);
+                status = ZX_ERR_BAD_STATE;
+            }
+            seen.Set(bno, bno + 1);
+        }
+    }
+
+    uint64_t unreferenced = 0;
+    for (uint64_t bno = kStartBlockMinimum; bno < block_count; bno++) {
+        if (blobstore_->block_map_.Get(bno, bno + 1) && !seen.Get(bno, bno + 1)) {
+            unreferenced++;
+        }
+    }
+    if (unreferenced > 0) {
+        FS_TRACE_WARN("check: %" PRIu64 " allocated blocks are not referenced by any blob\n",
+                      unreferenced);
+    }
+    if (bad_blobs_ > 0) {
+        FS_TRACE_ERROR("check: %u blobs are damaged\n", bad_blobs_);
+        status = ZX_ERR_BAD_STATE;
+    }
+    return status;
+}
+
 zx_status_t BlobstoreChecker::CheckAllocatedCounts() const {
     zx_status_t status = ZX_OK;
     if (alloc_blocks_ != blobstore_->info_.alloc_block_count) {
@@ -50,20 +421,19 @@ zx_status_t BlobstoreChecker::CheckAllocatedCounts() const {
     return status;
 }
 
-BlobstoreChecker::BlobstoreChecker()
-    : blobstore_(nullptr), alloc_inodes_(0), alloc_blocks_(0){};
-
-void BlobstoreChecker::Init(fbl::RefPtr<Blobstore> blob) {
-    blobstore_.reset(blob.get());
-}
-
 zx_status_t blobstore_check(fbl::RefPtr<Blobstore> blob) {
+    const uint64_t start_ms = MonotonicMs();
     zx_status_t status = ZX_OK;
     BlobstoreChecker chk;
     chk.Init(fbl::move(blob));
-    chk.TraverseInodeBitmap();
+    if ((status = chk.TraverseInodeBitmap()) != ZX_OK) {
+        return status;
+    }
     chk.TraverseBlockBitmap();
+    status |= chk.CheckBlockReferences();
     status |= (status != ZX_OK) ? 0 : chk.CheckAllocatedCounts();
+    FS_TRACE_INFO("check: %s in %" PRIu64 " ms\n", status == ZX_OK ? "passed" : "failed",
+                  MonotonicMs() - start_ms);
     return status;
 }
 
@@ -12,6 +12,8 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <digest/digest.h>
 #include <digest/merkle-tree.h>
 #include <fs/block-txn.h>
@@ -34,13 +36,11 @@ namespace blobstore {
 
 #define EXTENT_COUNT 4
 
+// Block reads and writes are positioned, so that several threads adding
+// blobs can share the image's fd.
 zx_status_t readblk_offset(int fd, uint64_t bno, off_t offset, void* data) {
     off_t off = offset + bno * kBlobstoreBlockSize;
-    if (lseek(fd, off, SEEK_SET) < 0) {
-        fprintf(stderr, "blobstore: cannot seek to block %" PRIu64 "\n", bno);
-        return ZX_ERR_IO;
-    }
-    if (read(fd, data, kBlobstoreBlockSize) != kBlobstoreBlockSize) {
+    if (pread(fd, data, kBlobstoreBlockSize, off) != kBlobstoreBlockSize) {
         fprintf(stderr, "blobstore: cannot read block %" PRIu64 "\n", bno);
         return ZX_ERR_IO;
     }
@@ -49,17 +49,33 @@ zx_status_t readblk_offset(int fd, uint64_t bno, off_t offset, void* data) {
 
 zx_status_t writeblk_offset(int fd, uint64_t bno, off_t offset, const void* data) {
     off_t off = offset + bno * kBlobstoreBlockSize;
-    if (lseek(fd, off, SEEK_SET) < 0) {
-        fprintf(stderr, "blobstore: cannot seek to block %" PRIu64 "\n", bno);
-        return ZX_ERR_IO;
-    }
-    if (write(fd, data, kBlobstoreBlockSize) != kBlobstoreBlockSize) {
+    if (pwrite(fd, data, kBlobstoreBlockSize, off) != kBlobstoreBlockSize) {
         fprintf(stderr, "blobstore: cannot write block %" PRIu64 "\n", bno);
         return ZX_ERR_IO;
     }
     return ZX_OK;
 }
 
+// Writes |nblocks| blocks starting at block |bno| in one go.
+static zx_status_t writeblks_offset(int fd, uint64_t bno, uint64_t nblocks, off_t offset,
+                                    const void* data) {
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    size_t len = nblocks * kBlobstoreBlockSize;
+    off_t off = offset + bno * kBlobstoreBlockSize;
+    while (len > 0) {
+        ssize_t r = pwrite(fd, src, len, off);
+        if (r <= 0) {
+            fprintf(stderr, "blobstore: cannot write block %" PRIu64 "\n",
+                    (off - offset) / kBlobstoreBlockSize);
+            return ZX_ERR_IO;
+        }
+        src += r;
+        len -= r;
+        off += r;
+    }
+    return ZX_OK;
+}
+
 zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd fd) {
     info_block_t info_block;
 
@@ -149,7 +165,7 @@ zx_status_t blobstore_create_sparse(fbl::RefPtr<Blobstore>* out, fbl::unique_fd
 
 std::mutex add_blob_mutex_;
 
-zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
+zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd, BlobDigest* out) {
     // Mmap user-provided file, create the corresponding merkle tree
     struct stat s;
     if (fstat(data_fd, &s) < 0) {
@@ -175,35 +191,48 @@ zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd) {
                                   merkle_size, &digest)) != ZX_OK) {
         return status;
     }
-
-    std::lock_guard<std::mutex> lock(add_blob_mutex_);
-    fbl::unique_ptr<InodeBlock> inode_block;
-    if ((status = bs->NewBlob(digest, &inode_block)) < 0) {
-        return status;
-    }
-    if (inode_block == nullptr) {
-        fprintf(stderr, "error: No nodes available on blobstore image\n");
-        return ZX_ERR_NO_RESOURCES;
+    if (out != nullptr) {
+        digest.CopyTo(out->data(), out->size());
     }
 
-    inode_block->SetSize(s.st_size);
-    blobstore_inode_t* inode = inode_block->GetInode();
+    // Only the metadata is updated under the lock. The blob's blocks are
+    // its own once allocated, so its data is written after dropping it.
+    blobstore_inode_t inode;
+    {
+        std::lock_guard<std::mutex> lock(add_blob_mutex_);
+        fbl::unique_ptr<InodeBlock> inode_block;
+        if ((status = bs->NewBlob(digest, &inode_block)) < 0) {
+            return status;
+        }
+        if (inode_block == nullptr) {
+            fprintf(stderr, "error: No nodes available on blobstore image\n");
+            return ZX_ERR_NO_RESOURCES;
+        }
 
-    if ((status = bs->AllocateBlocks(inode->num_blocks,
-                                     reinterpret_cast<size_t*>(&inode->start_block))) != ZX_OK) {
-        fprintf(stderr, "error: No blocks available\n");
-        return status;
-    } else if ((status = bs->WriteData(inode, merkle_tree.get(), blob_data)) != ZX_OK) {
-        return status;
-    } else if ((status = bs->WriteBitmap(inode->num_blocks, inode->start_block)) != ZX_OK) {
-        return status;
-    } else if ((status = bs->WriteNode(fbl::move(inode_block))) != ZX_OK) {
-        return status;
-    } else if ((status = bs->WriteInfo()) != ZX_OK) {
-        return status;
+        inode_block->SetSize(s.st_size);
+        blobstore_inode_t* node = inode_block->GetInode();
+
+        if ((status = bs->AllocateBlocks(node->num_blocks,
+                                         reinterpret_cast<size_t*>(&node->start_block))) != ZX_OK) {
+            fprintf(stderr, "error: No blocks available\n");
+            return status;
+        }
+        inode = *node;
+        if ((status = bs->WriteBitmap(inode.num_blocks, inode.start_block)) != ZX_OK) {
+            return status;
+        } else if ((status = bs->WriteNode(fbl::move(inode_block))) != ZX_OK) {
+            return status;
+        } else if ((status = bs->WriteInfo()) != ZX_OK) {
+            return status;
+        }
     }
 
-    return ZX_OK;
+    return bs->WriteData(&inode, merkle_tree.get(), blob_data);
+}
+
+zx_status_t blobstore_prune(Blobstore* bs, std::vector<BlobDigest> keep, size_t* removed) {
+    std::sort(keep.begin(), keep.end());
+    return bs->Prune(keep, removed);
 }
 
 zx_status_t blobstore_fsck(fbl::unique_fd fd, off_t start, off_t end,
@@ -346,6 +375,50 @@ zx_status_t Blobstore::NewBlob(const Digest& digest, fbl::unique_ptr<InodeBlock>
     return ZX_OK;
 }
 
+zx_status_t Blobstore::Prune(const std::vector<BlobDigest>& keep, size_t* removed) {
+    *removed = 0;
+    for (size_t i = 0; i < info_.inode_count; ++i) {
+        size_t bno = (i / kBlobstoreInodesPerBlock) + node_map_start_block_;
+
+        zx_status_t status;
+        if ((status = ReadBlock(bno)) != ZX_OK) {
+            return status;
+        }
+
+        auto iblk = reinterpret_cast<blobstore_inode_t*>(cache_.blk);
+        blobstore_inode_t* inode = &iblk[i % kBlobstoreInodesPerBlock];
+        if (inode->start_block < kStartBlockMinimum) {
+            continue;
+        }
+        BlobDigest root;
+        memcpy(root.data(), inode->merkle_root_hash, root.size());
+        if (std::binary_search(keep.begin(), keep.end(), root)) {
+            continue;
+        }
+        if (inode->next_node != 0) {
+            // Only images written on a device have blobs in several pieces
+            fprintf(stderr, "blobstore: cannot remove fragmented blob %zu\n", i);
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+
+        size_t start = inode->start_block;
+        size_t nblocks = inode->num_blocks;
+        memset(inode, 0, sizeof(*inode));
+        if ((status = WriteBlock(bno, cache_.blk)) != ZX_OK) {
+            return status;
+        } else if ((status = block_map_.Clear(start, start + nblocks)) != ZX_OK) {
+            return status;
+        } else if ((status = WriteBitmap(nblocks, start)) != ZX_OK) {
+            return status;
+        }
+        info_.alloc_block_count -= nblocks;
+        info_.alloc_inode_count--;
+        ++*removed;
+    }
+
+    return *removed > 0 ? WriteInfo() : ZX_OK;
+}
+
 zx_status_t Blobstore::AllocateBlocks(size_t nblocks, size_t* blkno_out) {
     zx_status_t status;
     if ((status = block_map_.Find(false, 0, block_map_.size(), nblocks, blkno_out)) != ZX_OK) {
@@ -385,32 +458,29 @@ zx_status_t Blobstore::WriteNode(fbl::unique_ptr<InodeBlock> ino_block) {
 }
 
 zx_status_t Blobstore::WriteData(blobstore_inode_t* inode, void* merkle_data, void* blob_data) {
-    for (size_t n = 0; n < MerkleTreeBlocks(*inode); n++) {
-        const void* data = fs::GetBlock<kBlobstoreBlockSize>(merkle_data, n);
-        uint64_t bno = data_start_block_ + inode->start_block + n;
-        zx_status_t status;
-        if ((status = WriteBlock(bno, data)) != ZX_OK) {
-            return status;
-        }
+    uint64_t bno = data_start_block_ + inode->start_block;
+    uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    zx_status_t status;
+    if ((status = writeblks_offset(blockfd_.get(), bno, merkle_blocks, offset_,
+                                   merkle_data)) != ZX_OK) {
+        return status;
     }
+    bno += merkle_blocks;
 
-    for (size_t n = 0; n < BlobDataBlocks(*inode); n++) {
-        const void* data = fs::GetBlock<kBlobstoreBlockSize>(blob_data, n);
+    // All but a partial last block come straight from the mapped file.
+    uint64_t full_blocks = inode->blob_size / kBlobstoreBlockSize;
+    if ((status = writeblks_offset(blockfd_.get(), bno, full_blocks, offset_,
+                                   blob_data)) != ZX_OK) {
+        return status;
+    }
 
-        // If we try to write a block, will it be reaching beyond the end of the
-        // mapped file?
-        size_t off = n * kBlobstoreBlockSize;
+    size_t off = full_blocks * kBlobstoreBlockSize;
+    if (off < inode->blob_size) {
+        // Read the partial block from a block-sized buffer which zero-pads the data.
         uint8_t last_data[kBlobstoreBlockSize];
-        if (inode->blob_size < off + kBlobstoreBlockSize) {
-            // Read the partial block from a block-sized buffer which zero-pads the data.
-            memset(last_data, 0, kBlobstoreBlockSize);
-            memcpy(last_data, data, inode->blob_size - off);
-            data = last_data;
-        }
-
-        uint64_t bno = data_start_block_ + inode->start_block + MerkleTreeBlocks(*inode) + n;
-        zx_status_t status;
-        if ((status = WriteBlock(bno, data)) != ZX_OK) {
+        memset(last_data, 0, kBlobstoreBlockSize);
+        memcpy(last_data, static_cast<uint8_t*>(blob_data) + off, inode->blob_size - off);
+        if ((status = WriteBlock(bno + full_blocks, last_data)) != ZX_OK) {
             return status;
         }
     }
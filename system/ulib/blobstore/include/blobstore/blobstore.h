@@ -13,26 +13,37 @@
 
 #include <bitmap/raw-bitmap.h>
 #include <digest/digest.h>
+#include <digest/merkle-tree.h>
 #include <fbl/algorithm.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <fs/block-txn.h>
 #include <fs/trace.h>
 #include <fs/vfs.h>
 #include <fs/vnode.h>
 
 #include <string.h>
+#include <threads.h>
 
-#include <block-client/client.h>
+#include <async/cpp/loop.h>
+#include <block-client/cpp/client.h>
 #include <fs/mapped-vmo.h>
+#include <region-alloc/region-alloc.h>
+#include <sync/completion.h>
 #include <trace/event.h>
 #include <zx/event.h>
+#include <zx/pager.h>
+#include <zx/port.h>
 #include <zx/vmo.h>
+#include <zircon/device/vfs.h>
+#include <zircon/syscalls/port.h>
 
 #include <blobstore/common.h>
 #include <blobstore/format.h>
@@ -40,11 +51,37 @@
 namespace blobstore {
 
 class Blobstore;
+struct CachedBlob;
 
 using WriteTxn = fs::WriteTxn<kBlobstoreBlockSize, Blobstore>;
 using ReadTxn = fs::ReadTxn<kBlobstoreBlockSize, Blobstore>;
 using digest::Digest;
 
+// The extents holding the blocks of a blob, in order: first the Merkle Tree,
+// then the data.
+using ExtentList = fbl::Vector<blobstore_extent_t>;
+
+// Splits the |nblocks| blocks of a blob starting at block |blob_block| into
+// the runs which are contiguous on disk, calling |fn(offset, start, length)|
+// for each: |offset| blocks in from |blob_block|, the run is at data block
+// |start|.
+template <typename F>
+void ForEachRun(const ExtentList& extents, uint64_t blob_block, uint64_t nblocks, F fn) {
+    uint64_t offset = 0;
+    for (const blobstore_extent_t& extent : extents) {
+        if (offset == nblocks) {
+            return;
+        } else if (blob_block >= extent.length) {
+            blob_block -= extent.length;
+            continue;
+        }
+        const uint64_t length = fbl::min(extent.length - blob_block, nblocks - offset);
+        fn(offset, extent.start + blob_block, length);
+        offset += length;
+        blob_block = 0;
+    }
+}
+
 typedef uint32_t BlobFlags;
 
 // clang-format off
@@ -69,6 +106,14 @@ constexpr BlobFlags kBlobOtherMask        = 0x0000FF00;
 
 // clang-format on
 
+// The writes queued to the BlobWriteback on behalf of one blob.
+struct WritebackBatch {
+    // Writes which have been queued but have not yet completed.
+    uint64_t pending{};
+    // The first error hit by any of them.
+    zx_status_t status = ZX_OK;
+};
+
 class VnodeBlob final : public fs::Vnode {
 public:
     // Intrusive methods and structures
@@ -107,6 +152,9 @@ public:
 
     uint64_t SizeData() const;
 
+    // Takes over the contents of this blob kept by the BlobCache.
+    zx_status_t AdoptCached(fbl::unique_ptr<CachedBlob> cached);
+
     // Constructs the "directory" blob
     VnodeBlob(fbl::RefPtr<Blobstore> bs);
     // Constructs actual blobs
@@ -163,23 +211,64 @@ private:
     zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) final;
     void Sync(SyncCallback closure) final;
 
-    // Read both VMOs into memory, if we haven't already.
+    // Prepare the blob's VMOs, if we haven't already.
     //
-    // TODO(ZX-1481): When we have can register the Blob Store as a pager
-    // service, and it can properly handle pages faults on a vnode's contents,
-    // then we can avoid reading the entire blob up-front. Until then, read
-    // the contents of a VMO into memory when it is opened.
+    // Only the Merkle Tree is read here. With a pager, the data is paged in
+    // from disk and verified as it is touched; otherwise it is read and
+    // verified by LoadRange().
     zx_status_t InitVmos();
+    zx_status_t InitPagedVmo();
+
+    // Verify the integrity of the byte range [off, off + len) of the
+    // in-memory Blob. InitVmos() must have already been called for this blob.
+    zx_status_t Verify(uint64_t off, uint64_t len) const;
+
+    // Read any blocks covering [off, off + len) which are not yet in blob_
+    // from disk, verifying each run against the cached Merkle Tree.
+    zx_status_t LoadRange(uint64_t off, uint64_t len);
+
+    // Decompress the chunks [chunk_start, chunk_end) of a compressed blob from
+    // compressed_ into blob_.
+    zx_status_t DecompressChunks(uint64_t chunk_start, uint64_t chunk_end);
+
+    // Called once all data has been written to blob_ when compression is
+    // enabled. Writes the data compressed if that saves space, releasing the
+    // blocks which are no longer needed, and uncompressed otherwise.
+    zx_status_t WriteCompressed(WriteTxn* txn);
+
+    zx_status_t WriteShared(WriteTxn* txn, size_t start, size_t len);
 
-    // Verify the integrity of the in-memory Blob.
-    // InitVmos() must have already been called for this blob.
-    zx_status_t Verify() const;
+    // Enqueues a transfer between |nblocks| blocks of the VMO |vmoid|,
+    // starting at |vmo_block|, and the same number of blocks of the blob on
+    // disk, starting at |blob_block|.
+    template <typename Txn>
+    void EnqueueBlocks(Txn* txn, vmoid_t vmoid, uint64_t vmo_block, uint64_t blob_block,
+                       uint64_t nblocks);
+
+    // Writes |nblocks| blocks of blob_, starting at |vmo_block|, to the same
+    // blocks of the blob on disk. With a BlobWriteback this only queues the
+    // write; WaitForWrites() collects the result.
+    zx_status_t QueueWrite(uint64_t vmo_block, uint64_t nblocks);
+
+    // Waits for every write queued by QueueWrite() to reach the disk.
+    zx_status_t WaitForWrites();
 
-    zx_status_t WriteShared(WriteTxn* txn, size_t start, size_t len, uint64_t start_block);
     // Called by Blob once the last write has completed, updating the
     // on-disk metadata.
     zx_status_t WriteMetadata();
 
+    // Makes a blob whose data and Merkle Tree have been verified readable.
+    zx_status_t MarkReadable();
+
+    // Hands the verified contents of this blob, whose last reference is going
+    // away, to the Blobstore's BlobCache. Blobs only partly read and verified
+    // without a pager are not kept.
+    void CacheContents();
+
+    // Installs the blobs described by the manifest at the start of |vmo|,
+    // as per IOCTL_VFS_INSTALL_BATCH. Only called on the root directory.
+    zx_status_t InstallBatch(zx_handle_t vmo, uint32_t count);
+
     // Acquire a pointer to the mapped data or merkle tree
     void* GetData() const;
     void* GetMerkle() const;
@@ -194,12 +283,30 @@ private:
     // 2) The Blob itself, aligned to the nearest kBlobstoreBlockSize
     fbl::unique_ptr<MappedVmo> blob_{};
     vmoid_t vmoid_{};
+    // One bit per data block of blob_, set once the block has been read and
+    // verified.
+    bitmap::RawBitmapGeneric<bitmap::DefaultStorage> verified_{};
+    // The on-disk data of a compressed blob, decompressed into blob_ as it
+    // is read.
+    fbl::unique_ptr<MappedVmo> compressed_{};
+
+    // The data of a blob read back from disk, served by the Blobstore's pager.
+    // blob_ is not used for these.
+    zx::vmo data_vmo_{};
 
     zx::event readable_event_{};
     uint64_t bytes_written_{};
+    // Data blocks of blob_ already handed to QueueWrite() while writing.
+    uint64_t blocks_queued_{};
+    // Hashes the data as it is written.
+    digest::MerkleTree merkle_tree_{};
+    WritebackBatch writeback_{};
     uint8_t digest_[Digest::kLength]{};
 
     size_t map_index_{};
+    // Where the blocks of the blob are on disk. Loaded along with the VMOs
+    // of the blob, or set when it is allocated.
+    ExtentList extents_{};
 };
 
 // We need to define this structure to allow the Blob to be indexable by a key
@@ -215,9 +322,229 @@ struct MerkleRootTraits {
     }
 };
 
+// Serves the data of blobs read back from disk through a pager, so that only
+// the parts of a blob that get touched are read and verified.
+//
+// Each blob has one paged VMO, kept until the vnode and every clone handed
+// out from it are gone, and reused if the blob is opened again meanwhile.
+class BlobPager {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlobPager);
+
+    static zx_status_t Create(Blobstore* blobstore, fbl::unique_ptr<BlobPager>* out);
+    ~BlobPager();
+
+    // Returns a handle to a VMO of the data of the blob at |map_index|, which
+    // is verified against |merkle| and |digest| as it is paged in.
+    zx_status_t GetVmo(size_t map_index, const blobstore_inode_t& inode, const Digest& digest,
+                       const void* merkle, zx::vmo* out);
+
+    // A clone was made of the VMO of the blob at |map_index|.
+    void AddClone(size_t map_index);
+
+    // The vnode of the blob at |map_index| closed its handle to the VMO.
+    void Release(size_t map_index);
+
+    // The blob at |map_index| is being deleted. Reads in whatever its clones
+    // may still need before its blocks can be reused.
+    void Purge(size_t map_index);
+
+private:
+    // The paged VMO of one blob, and what is needed to fill it in.
+    struct Source : public fbl::RefCounted<Source>,
+                    public fbl::DoublyLinkedListable<fbl::RefPtr<Source>> {
+        uint64_t key{};
+        size_t map_index{};
+        // Where the blob is on disk; its data follows the Merkle Tree.
+        ExtentList extents{};
+        uint64_t merkle_blocks{};
+        uint64_t blob_size{};
+        uint64_t data_blocks{};
+        uint8_t digest[Digest::kLength]{};
+        fbl::unique_ptr<uint8_t[]> merkle{};
+        size_t merkle_size{};
+        zx::vmo vmo{};
+
+        // Guarded by the pager's lock_.
+        bool open{};
+        bool purged{};
+        uint64_t clones{};
+        // Clones the kernel had seen when it last reported having none.
+        uint64_t zero_children_at{};
+    };
+
+    explicit BlobPager(Blobstore* blobstore);
+
+    fbl::RefPtr<Source> FindLocked(size_t map_index) __TA_REQUIRES(lock_);
+    void ReleaseIfUnusedLocked(Source* source) __TA_REQUIRES(lock_);
+
+    static int PagerThread(void* arg);
+    void HandleRequest(uint64_t key, const zx_packet_page_request_t& request);
+
+    // A read into one of the transfer buffers.
+    struct Read {
+        completion_t done;
+        zx_status_t status;
+    };
+
+    // Starts reading the range at |offset| into the data of |source| into
+    // transfer buffer |buf|, signalling |read| once it is in.
+    void StartRead(const Source& source, uint64_t offset, uint64_t len, size_t buf, Read* read);
+    // Verifies the range read into transfer buffer |buf|, then supplies it to
+    // the VMO of |source|.
+    zx_status_t SupplyRange(const Source& source, uint64_t offset, uint64_t len, size_t buf);
+
+    // One range is read into a transfer buffer while the last is verified.
+    static constexpr size_t kTransferBuffers = 2;
+
+    Blobstore* const blobstore_;
+    zx::pager pager_{};
+    zx::port port_{};
+    thrd_t pager_thrd_{};
+    bool running_{};
+
+    // Only touched by the pager thread once it runs.
+    fbl::unique_ptr<MappedVmo> transfer_[kTransferBuffers]{};
+    vmoid_t transfer_vmoid_[kTransferBuffers]{};
+
+    fbl::Mutex lock_;
+    fbl::DoublyLinkedList<fbl::RefPtr<Source>> sources_ __TA_GUARDED(lock_);
+    uint64_t next_key_ __TA_GUARDED(lock_) = 1;
+};
+
+// Writes the data of blobs out to disk from a thread of its own, so that the
+// blocks of a blob reach the device while the rest of it is still being copied
+// in and hashed.
+class BlobWriteback {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlobWriteback);
+
+    static zx_status_t Create(Blobstore* blobstore, fbl::unique_ptr<BlobWriteback>* out);
+    ~BlobWriteback();
+
+    // Queues a write of |nblocks| blocks of |vmoid|, in the units of
+    // WriteTxn::Enqueue, on behalf of |batch|. Blocks while the queue is full.
+    void Enqueue(WritebackBatch* batch, vmoid_t vmoid, uint64_t vmo_offset,
+                 uint64_t dev_offset, uint64_t nblocks);
+
+    // Waits for every write queued on behalf of |batch| to complete, returning
+    // the first error any of them hit.
+    zx_status_t Wait(WritebackBatch* batch);
+
+private:
+    struct Request {
+        WritebackBatch* batch;
+        block_fifo_request_t request;
+    };
+
+    // The most writes waiting to be issued at once.
+    static constexpr size_t kQueueDepth = MAX_TXN_MESSAGES;
+    // The most transactions of writes on the device at once.
+    static constexpr size_t kMaxInFlight = 4;
+
+    explicit BlobWriteback(Blobstore* blobstore);
+
+    static int WritebackThread(void* arg);
+
+    // Called once the writes issued on behalf of |batches| complete.
+    void Complete(WritebackBatch* const* batches, size_t count, zx_status_t status)
+        __TA_EXCLUDES(lock_);
+
+    Blobstore* const blobstore_;
+    thrd_t writeback_thrd_{};
+    bool running_{};
+
+    fbl::Mutex lock_;
+    // Signalled when writes are queued or complete, or the writeback is
+    // stopping.
+    cnd_t consumer_cvar_;
+    // Signalled when writes complete, or room frees up in the queue.
+    cnd_t producer_cvar_;
+    bool unmounting_ __TA_GUARDED(lock_){};
+    Request queue_[kQueueDepth] __TA_GUARDED(lock_);
+    size_t start_ __TA_GUARDED(lock_){};
+    size_t len_ __TA_GUARDED(lock_){};
+    size_t in_flight_ __TA_GUARDED(lock_){};
+};
+
+// The contents of a readable blob kept by the BlobCache once its vnode has
+// gone: either the paged VMO of its data, or its blob_, with every block
+// already verified.
+struct CachedBlob : public fbl::DoublyLinkedListable<fbl::unique_ptr<CachedBlob>> {
+    uint8_t digest[Digest::kLength]{};
+    size_t map_index{};
+    // The memory the blob may hold, charged to the cache.
+    uint64_t bytes{};
+    zx::vmo data_vmo{};
+    fbl::unique_ptr<MappedVmo> blob{};
+    vmoid_t vmoid{};
+};
+
+// Keeps the contents of recently closed blobs, so that opening one again needs
+// neither a search of the node map nor rereading and reverifying its data.
+//
+// The cache is bounded by the memory its blobs may hold, evicting the least
+// recently closed first. It also empties itself once the kernel signals
+// memory pressure, which it notices by the discarding of an unlocked,
+// discardable canary VMO.
+class BlobCache {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlobCache);
+
+    static constexpr uint64_t kDefaultCapacity = 64 * (1 << 20);
+
+    explicit BlobCache(Blobstore* blobstore);
+    ~BlobCache();
+
+    // Sets up the memory pressure canary. Without it, the cache is only bounded
+    // by its capacity.
+    zx_status_t Init();
+
+    // Keeps |cached| as the most recently used blob, evicting others as needed.
+    void Insert(fbl::unique_ptr<CachedBlob> cached);
+
+    // Returns the blob cached for |digest|, or null.
+    CachedBlob* Find(const Digest& digest);
+
+    // Takes |cached| back out of the cache, to be opened again.
+    fbl::unique_ptr<CachedBlob> Remove(CachedBlob* cached);
+
+    // Notes the opening of a blob which was not cached.
+    void RecordMiss() { misses_++; }
+
+    // Evicts every blob.
+    void Clear();
+
+    void GetInfo(vfs_blob_cache_info_t* info) const;
+
+private:
+    fbl::unique_ptr<CachedBlob> PopOldest();
+
+    // Releases what |cached|, no longer in the cache, holds on to.
+    void Evict(fbl::unique_ptr<CachedBlob> cached);
+
+    // Empties the cache if the canary was discarded since the last check.
+    void CheckPressure();
+
+    Blobstore* const blobstore_;
+    // Least recently closed first.
+    fbl::DoublyLinkedList<fbl::unique_ptr<CachedBlob>> lru_{};
+    uint64_t bytes_{};
+    uint64_t capacity_ = kDefaultCapacity;
+    zx::vmo canary_{};
+
+    uint64_t hits_{};
+    uint64_t misses_{};
+    uint64_t evictions_{};
+    uint64_t pressure_evictions_{};
+};
+
 class Blobstore : public fbl::RefCounted<Blobstore> {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Blobstore);
+    friend class BlobCache;
+    friend class BlobPager;
+    friend class BlobWriteback;
     friend class VnodeBlob;
 
     static zx_status_t Create(fbl::unique_fd blockfd, const blobstore_info_t* info,
@@ -253,13 +580,22 @@ public:
     zx_status_t Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len, size_t* out_actual);
 
     zx_status_t AttachVmo(zx_handle_t vmo, vmoid_t* out);
+    void DetachVmo(vmoid_t vmoid);
     zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
         TRACE_DURATION("blobstore", "Blobstore::Txn", "count", count);
-        return block_fifo_txn(fifo_client_, requests, count);
+        return block_client_->Transaction(requests, count);
+    }
+    // Issues |requests| without waiting for them; |callback| runs on the I/O
+    // thread once they complete.
+    void TxnAsync(const block_fifo_request_t* requests, size_t count,
+                  block_client::TxnCallback callback) {
+        TRACE_DURATION("blobstore", "Blobstore::TxnAsync", "count", count);
+        block_client_->Transaction(requests, count, fbl::move(callback));
     }
     uint32_t BlockSize() const { return block_info_.block_size; }
 
-    txnid_t TxnId() const { return txnid_; }
+    // The block client picks the txnid of each request itself.
+    txnid_t TxnId() const { return TXNID_INVALID; }
 
     // If possible, attempt to resize the blobstore partition.
     // Add one additional slice for inodes.
@@ -274,6 +610,9 @@ public:
     // Returns an unique identifier for this instance.
     uint64_t GetFsId() const { return fs_id_; }
 
+    // Whether newly written blobs are stored compressed.
+    void SetCompression(bool enabled) { compression_enabled_ = enabled; }
+
     blobstore_info_t info_;
 
 private:
@@ -282,10 +621,28 @@ private:
     Blobstore(fbl::unique_fd fd, const blobstore_info_t* info);
     zx_status_t LoadBitmaps();
 
-    // Finds space for a block in memory. Does not update disk.
-    zx_status_t AllocateBlocks(size_t nblocks, size_t* blkno_out);
+    // Builds the index of free extents from the block bitmap.
+    zx_status_t InitFreeExtents();
+
+    // Finds space for |nblocks| blocks in memory, in as few extents as
+    // possible. Does not update disk.
+    zx_status_t AllocateBlocks(size_t nblocks, ExtentList* out);
     void FreeBlocks(size_t nblocks, size_t blkno);
 
+    // Records |extents| as the blocks of the blob at |node_index|, allocating
+    // and freeing extent containers as needed. Does not update disk.
+    zx_status_t SetExtents(size_t node_index, const ExtentList& extents);
+
+    // Reads the extents of the blob at |node_index| from the node map.
+    zx_status_t LoadExtents(size_t node_index, ExtentList* out) const;
+
+    // Frees the extent containers of the blob at |node_index| in memory.
+    void FreeContainers(size_t node_index);
+
+    // Enqueues the blocks of the node map holding the extent containers of
+    // the blob at |node_index|.
+    void EnqueueContainers(WriteTxn* txn, size_t node_index);
+
     // Finds space for a blob node in memory. Does not update disk.
     zx_status_t AllocateNode(size_t* node_index_out);
     void FreeNode(size_t node_index);
@@ -293,10 +650,18 @@ private:
     // Access the nth inode of the node map
     blobstore_inode_t* GetNode(size_t index) const;
 
+    // Returns the extent container at |index| of the node map, or null if
+    // there is none.
+    blobstore_extent_container_t* GetContainer(size_t index) const;
+
     // Given a contiguous number of blocks after a starting block,
     // write out the bitmap to disk for the corresponding blocks.
     zx_status_t WriteBitmap(WriteTxn* txn, uint64_t nblocks, uint64_t start_block);
 
+    // As WriteBitmap(), for each extent in |extents|; the writes are only
+    // enqueued, and go out with the next flush of |txn|.
+    void EnqueueBitmap(WriteTxn* txn, const ExtentList& extents);
+
     // Given a node within the node map at an index, write it to disk.
     zx_status_t WriteNode(WriteTxn* txn, size_t map_index);
 
@@ -317,20 +682,32 @@ private:
 
     fbl::unique_fd blockfd_;
     block_info_t block_info_{};
-    fifo_client_t* fifo_client_{};
-    txnid_t txnid_{};
+    // Runs the completions of block_client_, on a thread of its own.
+    async::Loop io_loop_;
+    fbl::unique_ptr<block_client::Client> block_client_{};
     RawBitmap block_map_{};
     vmoid_t block_map_vmoid_{};
+    // The free runs of block_map_, indexed by start and by length.
+    RegionAllocator free_extents_{};
     fbl::unique_ptr<MappedVmo> node_map_{};
     vmoid_t node_map_vmoid_{};
     fbl::unique_ptr<MappedVmo> info_vmo_{};
     vmoid_t info_vmoid_{};
     uint64_t fs_id_{};
+
+    // Null if the pager could not be set up, blobs are then read in whole.
+    fbl::unique_ptr<BlobPager> pager_{};
+    // Null if the writeback thread could not be started, blob data is then
+    // written synchronously.
+    fbl::unique_ptr<BlobWriteback> writeback_{};
+    bool compression_enabled_{};
+    BlobCache cache_;
 };
 
 zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd);
 
 //TODO(planders): Update blobstore to use unique_fd.
-zx_status_t blobstore_mount(fbl::RefPtr<VnodeBlob>* out, fbl::unique_fd blockfd);
+zx_status_t blobstore_mount(fbl::RefPtr<VnodeBlob>* out, fbl::unique_fd blockfd,
+                            bool compress = false);
 
 } // namespace blobstore
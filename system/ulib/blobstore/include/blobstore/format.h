@@ -15,6 +15,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // clang-format off
@@ -23,7 +24,7 @@ namespace blobstore {
 
 constexpr uint64_t kBlobstoreMagic0  = (0xac2153479e694d21ULL);
 constexpr uint64_t kBlobstoreMagic1  = (0x985000d4d4d3d314ULL);
-constexpr uint32_t kBlobstoreVersion = 0x00000004;
+constexpr uint32_t kBlobstoreVersion = 0x00000005;
 
 constexpr uint32_t kBlobstoreFlagClean      = 1;
 constexpr uint32_t kBlobstoreFlagDirty      = 2;
@@ -108,17 +109,60 @@ constexpr uint64_t kStartBlockFree     = 0;
 constexpr uint64_t kStartBlockReserved = 1;
 constexpr uint64_t kStartBlockMinimum  = 2; // Smallest 'data' block possible
 
+// Flags of 'blobstore_inode_t'.
+// The blob data is stored as independently LZ4-compressed chunks.
+constexpr uint32_t kBlobInodeFlagLZ4 = 1;
+// The node is not a blob, but a 'blobstore_extent_container_t'.
+constexpr uint32_t kBlobInodeFlagContainer = 2;
+
+// Uncompressed size of each chunk of a compressed blob. Chunks are compressed
+// independently so that any range of the blob can be decompressed on its own.
+constexpr uint64_t kBlobstoreCompressionChunkSize = 8 * kBlobstoreBlockSize;
+
 using digest::Digest;
 typedef struct {
     uint8_t  merkle_root_hash[Digest::kLength];
     uint64_t start_block;
     uint64_t num_blocks;
     uint64_t blob_size;
-    uint64_t reserved;
+    uint32_t flags;
+    uint32_t next_node;  // First extent container, or zero if the blob is the
+                         // single extent of 'num_blocks' at 'start_block'
 } blobstore_inode_t;
 
 static_assert(sizeof(blobstore_inode_t) == kBlobstoreInodeSize,
               "Blobstore Inode size is wrong");
+
+// A run of contiguous data blocks.
+typedef struct {
+    uint64_t start;
+    uint64_t length;
+} blobstore_extent_t;
+
+constexpr uint32_t kBlobstoreContainerExtents = 2;
+
+// The blocks of a blob which could not be allocated in one piece are listed,
+// in order, by a chain of extent containers: nodes of the node map linked
+// from the blob's 'next_node'. A container lays its fields over those of a
+// blobstore_inode_t, so that it is an allocated node which is not a blob.
+typedef struct {
+    blobstore_extent_t extents[kBlobstoreContainerExtents];
+    uint64_t start_block;   // Always kStartBlockReserved
+    uint64_t extent_count;
+    uint64_t reserved;
+    uint32_t flags;         // Always kBlobInodeFlagContainer
+    uint32_t next_node;
+} blobstore_extent_container_t;
+
+static_assert(sizeof(blobstore_extent_container_t) == kBlobstoreInodeSize,
+              "Blobstore extent container size is wrong");
+static_assert(offsetof(blobstore_extent_container_t, start_block) ==
+              offsetof(blobstore_inode_t, start_block) &&
+              offsetof(blobstore_extent_container_t, flags) ==
+              offsetof(blobstore_inode_t, flags) &&
+              offsetof(blobstore_extent_container_t, next_node) ==
+              offsetof(blobstore_inode_t, next_node),
+              "Blobstore extent containers must overlay inodes");
 static_assert(kBlobstoreBlockSize % kBlobstoreInodeSize == 0,
               "Blobstore Inodes should fit cleanly within a blobstore block");
 
@@ -127,4 +171,17 @@ constexpr uint64_t BlobDataBlocks(const blobstore_inode_t& blobNode) {
     return fbl::round_up(blobNode.blob_size, kBlobstoreBlockSize) / kBlobstoreBlockSize;
 }
 
+// Number of chunks the blob is split into when compressed.
+constexpr uint64_t CompressedChunks(const blobstore_inode_t& blobNode) {
+    return fbl::round_up(blobNode.blob_size, kBlobstoreCompressionChunkSize) /
+           kBlobstoreCompressionChunkSize;
+}
+
+// A compressed blob's data starts with a table of 'CompressedChunks() + 1'
+// uint64_t byte offsets, relative to the start of the data, giving the
+// extent of each compressed chunk. The compressed chunks follow the table.
+constexpr uint64_t CompressedTableSize(const blobstore_inode_t& blobNode) {
+    return (CompressedChunks(blobNode) + 1) * sizeof(uint64_t);
+}
+
 } // namespace blobstore
@@ -7,10 +7,12 @@
 
 #pragma once
 
+#include <bitmap/raw-bitmap.h>
 #include <digest/digest.h>
 #include <fbl/algorithm.h>
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
+#include <fbl/vector.h>
 #include <fs/trace.h>
 
 #ifdef __Fuchsia__
@@ -25,15 +27,53 @@ class BlobstoreChecker {
 public:
     BlobstoreChecker();
     void Init(fbl::RefPtr<Blobstore> vnode);
-    void TraverseInodeBitmap();
+    // Scans every node, split across threads where there are several cpus:
+    // counts the allocated nodes, collects the extents of each blob, and
+    // verifies each blob against its Merkle tree.
+    zx_status_t TraverseInodeBitmap();
     void TraverseBlockBitmap();
+    // Checks the extents collected by TraverseInodeBitmap() against the block
+    // bitmap, and against one another.
+    zx_status_t CheckBlockReferences();
     zx_status_t CheckAllocatedCounts() const;
 
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(BlobstoreChecker);
+
+    // A run of blocks claimed by the blob at |node|.
+    struct BlockRef {
+        uint64_t start;
+        uint64_t length;
+        uint32_t node;
+    };
+
+    // The state of a scan over the nodes [start, end), one per thread.
+    struct NodeScan {
+        BlobstoreChecker* checker;
+        uint32_t start;
+        uint32_t end;
+        uint32_t alloc_inodes;
+        uint32_t blobs;
+        uint32_t bad_blobs;
+        fbl::Vector<BlockRef> refs;
+        zx_status_t status;
+    };
+
+    static int ScanThread(void* arg);
+    void ScanNodes(NodeScan* scan);
+    // Collects the extents of the blob at |node| into |scan|, returning false
+    // if they are not well formed.
+    bool CollectExtents(NodeScan* scan, uint32_t node, const blobstore_inode_t& inode);
+    // Reads the blob from the extents just collected, and verifies it.
+    zx_status_t VerifyBlob(const blobstore_inode_t& inode, const BlockRef* extents,
+                           size_t count);
+    zx_status_t ReadBlocks(uint64_t start, uint64_t count, void* data) const;
+
     fbl::RefPtr<Blobstore> blobstore_;
     uint32_t alloc_inodes_;
     uint32_t alloc_blocks_;
+    uint32_t bad_blobs_;
+    fbl::Vector<BlockRef> refs_;
 };
 
 zx_status_t blobstore_check(fbl::RefPtr<Blobstore> vnode);
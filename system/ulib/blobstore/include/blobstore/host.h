@@ -26,7 +26,9 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <array>
 #include <mutex>
+#include <vector>
 
 #include <blobstore/format.h>
 #include <blobstore/common.h>
@@ -38,6 +40,9 @@ typedef union {
     blobstore_info_t info;
 } info_block_t;
 
+// A blob's merkle root, its identity within an image.
+typedef std::array<uint8_t, Digest::kLength> BlobDigest;
+
 // Stores pointer to an inode's metadata and the matching block number
 class InodeBlock {
 public:
@@ -85,6 +90,9 @@ public:
     zx_status_t WriteNode(fbl::unique_ptr<InodeBlock> ino_block);
     zx_status_t WriteInfo();
 
+    // Removes every blob whose merkle root is not in |keep|, which is sorted.
+    zx_status_t Prune(const std::vector<BlobDigest>& keep, size_t* removed);
+
 private:
     typedef struct {
         size_t bno;
@@ -137,7 +145,13 @@ zx_status_t blobstore_create(fbl::RefPtr<Blobstore>* out, fbl::unique_fd blockfd
 
 // blobstore_add_blob may be called by multiple threads to gain concurrent
 // merkle tree generation. No other methods are thread safe.
-zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd);
+// If |out| is not null, it is set to the blob's merkle root, whether or not
+// the blob was already present.
+zx_status_t blobstore_add_blob(Blobstore* bs, int data_fd, BlobDigest* out = nullptr);
+
+// Removes the blobs of |bs| whose merkle roots are not in |keep|, so that an
+// existing image can be brought up to date by adding only the blobs it lacks.
+zx_status_t blobstore_prune(Blobstore* bs, std::vector<BlobDigest> keep, size_t* removed);
 zx_status_t blobstore_fsck(fbl::unique_fd fd, off_t start, off_t end,
                            const fbl::Vector<size_t>& extent_lengths);
 
@@ -0,0 +1,336 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <digest/digest.h>
+#include <digest/merkle-tree.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include <blobstore/blobstore.h>
+
+using digest::Digest;
+using digest::MerkleTree;
+
+namespace blobstore {
+namespace {
+
+// The most blocks read and verified at once.
+constexpr uint64_t kTransferBlocks = 16;
+
+} // namespace
+
+zx_status_t BlobPager::Create(Blobstore* blobstore, fbl::unique_ptr<BlobPager>* out) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<BlobPager> pager(new (&ac) BlobPager(blobstore));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    zx_status_t status;
+    if ((status = zx::pager::create(0, &pager->pager_)) != ZX_OK) {
+        return status;
+    } else if ((status = zx::port::create(0, &pager->port_)) != ZX_OK) {
+        return status;
+    }
+    for (size_t i = 0; i < kTransferBuffers; i++) {
+        if ((status = MappedVmo::Create(kTransferBlocks * kBlobstoreBlockSize,
+                                        "blob-pager", &pager->transfer_[i])) != ZX_OK) {
+            return status;
+        } else if ((status = blobstore->AttachVmo(pager->transfer_[i]->GetVmo(),
+                                                  &pager->transfer_vmoid_[i])) != ZX_OK) {
+            return status;
+        }
+    }
+    if (thrd_create_with_name(&pager->pager_thrd_, BlobPager::PagerThread, pager.get(),
+                                     "blobstore-pager") != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    pager->running_ = true;
+
+    *out = fbl::move(pager);
+    return ZX_OK;
+}
+
+BlobPager::BlobPager(Blobstore* blobstore) : blobstore_(blobstore) {}
+
+BlobPager::~BlobPager() {
+    if (running_) {
+        zx_port_packet_t packet;
+        memset(&packet, 0, sizeof(packet));
+        packet.type = ZX_PKT_TYPE_USER;
+        port_.queue(&packet, 0);
+        int r;
+        thrd_join(pager_thrd_, &r);
+    }
+
+    for (size_t i = 0; i < kTransferBuffers; i++) {
+        if (transfer_vmoid_[i] != VMOID_INVALID) {
+            blobstore_->DetachVmo(transfer_vmoid_[i]);
+        }
+    }
+
+    // Clones still reading through to these VMOs fail with ZX_ERR_BAD_STATE
+    // once the pager goes away.
+    while (!sources_.is_empty()) {
+        sources_.pop_front();
+    }
+}
+
+zx_status_t BlobPager::GetVmo(size_t map_index, const blobstore_inode_t& inode,
+                              const Digest& digest, const void* merkle, zx::vmo* out) {
+    TRACE_DURATION("blobstore", "BlobPager::GetVmo", "map_index", map_index);
+
+    {
+        fbl::AutoLock lock(&lock_);
+        fbl::RefPtr<Source> source = FindLocked(map_index);
+        if (source != nullptr) {
+            source->open = true;
+            return source->vmo.duplicate(ZX_RIGHT_SAME_RIGHTS, out);
+        }
+    }
+
+    fbl::AllocChecker ac;
+    fbl::RefPtr<Source> source = fbl::AdoptRef(new (&ac) Source());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    source->map_index = map_index;
+    zx_status_t status;
+    if ((status = blobstore_->LoadExtents(map_index, &source->extents)) != ZX_OK) {
+        return status;
+    }
+    source->merkle_blocks = MerkleTreeBlocks(inode);
+    source->blob_size = inode.blob_size;
+    source->data_blocks = BlobDataBlocks(inode);
+    digest.CopyTo(source->digest, sizeof(source->digest));
+    source->merkle_size = MerkleTree::GetTreeLength(inode.blob_size);
+    if (source->merkle_size > 0) {
+        source->merkle.reset(new (&ac) uint8_t[source->merkle_size]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        memcpy(source->merkle.get(), merkle, source->merkle_size);
+    }
+
+    zx::vmo vmo;
+    {
+        fbl::AutoLock lock(&lock_);
+        source->key = next_key_++;
+    }
+    if ((status = pager_.create_vmo(port_, source->key,
+                                    source->data_blocks * kBlobstoreBlockSize, 0,
+                                    &source->vmo)) != ZX_OK) {
+        FS_TRACE_ERROR("blobstore: Failed to create paged VMO: %d\n", status);
+        return status;
+    } else if ((status = source->vmo.duplicate(ZX_RIGHT_SAME_RIGHTS, &vmo)) != ZX_OK) {
+        return status;
+    }
+
+    source->open = true;
+    fbl::AutoLock lock(&lock_);
+    sources_.push_back(source);
+    *out = fbl::move(vmo);
+    return ZX_OK;
+}
+
+void BlobPager::AddClone(size_t map_index) {
+    fbl::AutoLock lock(&lock_);
+    fbl::RefPtr<Source> source = FindLocked(map_index);
+    if (source != nullptr) {
+        source->clones++;
+    }
+}
+
+void BlobPager::Release(size_t map_index) {
+    fbl::RefPtr<Source> source;
+    fbl::AutoLock lock(&lock_);
+    source = FindLocked(map_index);
+    if (source == nullptr) {
+        return;
+    }
+    source->open = false;
+    ReleaseIfUnusedLocked(source.get());
+}
+
+void BlobPager::Purge(size_t map_index) {
+    TRACE_DURATION("blobstore", "BlobPager::Purge", "map_index", map_index);
+
+    fbl::RefPtr<Source> source;
+    {
+        fbl::AutoLock lock(&lock_);
+        source = FindLocked(map_index);
+        if (source == nullptr) {
+            return;
+        }
+        source->purged = true;
+    }
+
+    // Clones of the blob outlive it and keep reading through to the VMO, so
+    // page in everything they may still touch before the blocks are reused.
+    zx_status_t status = source->vmo.op_range(ZX_VMO_OP_COMMIT, 0,
+                                              source->data_blocks * kBlobstoreBlockSize,
+                                              nullptr, 0);
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("blobstore: Failed to page in deleted blob: %d\n", status);
+    }
+}
+
+fbl::RefPtr<BlobPager::Source> BlobPager::FindLocked(size_t map_index) {
+    auto iter = sources_.find_if([map_index](const Source& source) {
+        return source.map_index == map_index && !source.purged;
+    });
+    return iter.IsValid() ? iter.CopyPointer() : nullptr;
+}
+
+void BlobPager::ReleaseIfUnusedLocked(Source* source) {
+    // Every clone made has gone away once the kernel has seen as many as we made.
+    if (!source->open && source->zero_children_at == source->clones) {
+        sources_.erase(*source);
+    }
+}
+
+int BlobPager::PagerThread(void* arg) {
+    BlobPager* pager = reinterpret_cast<BlobPager*>(arg);
+    for (;;) {
+        zx_port_packet_t packet;
+        zx_status_t status = pager->port_.wait(zx::time::infinite(), &packet, 0);
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("blobstore: Pager port wait failed: %d\n", status);
+            return -1;
+        } else if (packet.type == ZX_PKT_TYPE_USER) {
+            return 0;
+        } else if (packet.type == ZX_PKT_TYPE_PAGE_REQUEST) {
+            pager->HandleRequest(packet.key, packet.page_request);
+        }
+    }
+}
+
+void BlobPager::HandleRequest(uint64_t key, const zx_packet_page_request_t& request) {
+    fbl::RefPtr<Source> source;
+    {
+        fbl::AutoLock lock(&lock_);
+        auto iter = sources_.find_if([key](const Source& source) {
+            return source.key == key;
+        });
+        // COMPLETE only arrives once we have dropped the source.
+        if (!iter.IsValid()) {
+            return;
+        }
+        source = iter.CopyPointer();
+        if (request.command == ZX_PAGER_VMO_ZERO_CHILDREN) {
+            source->zero_children_at = request.offset;
+            ReleaseIfUnusedLocked(source.get());
+            return;
+        }
+    }
+    if (request.command != ZX_PAGER_VMO_READ) {
+        return;
+    }
+
+    // The Merkle tree covers whole blocks, which are larger than pages.
+    const uint64_t data_size = source->data_blocks * kBlobstoreBlockSize;
+    uint64_t start = fbl::round_down(request.offset, kBlobstoreBlockSize);
+    const uint64_t end = fbl::min(fbl::round_up(request.offset + request.length,
+                                                kBlobstoreBlockSize),
+                                  data_size);
+    if (start >= end) {
+        return;
+    }
+
+    // Keep the next range on its way in from the device while the last one
+    // is verified.
+    Read reads[kTransferBuffers];
+    size_t buf = 0;
+    uint64_t len = fbl::min(end - start, kTransferBlocks * kBlobstoreBlockSize);
+    StartRead(*source, start, len, buf, &reads[buf]);
+    while (start < end) {
+        const uint64_t next = start + len;
+        uint64_t next_len = 0;
+        if (next < end) {
+            next_len = fbl::min(end - next, kTransferBlocks * kBlobstoreBlockSize);
+            StartRead(*source, next, next_len, buf ^ 1, &reads[buf ^ 1]);
+        }
+
+        completion_wait(&reads[buf].done, ZX_TIME_INFINITE);
+        zx_status_t status = reads[buf].status;
+        if (status == ZX_OK) {
+            status = SupplyRange(*source, start, len, buf);
+        }
+        if (status != ZX_OK) {
+            if (next < end) {
+                completion_wait(&reads[buf ^ 1].done, ZX_TIME_INFINITE);
+            }
+            // There is no way to fail the request; the threads waiting on it
+            // stay blocked until they are killed, as they would on a hung disk.
+            FS_TRACE_ERROR("blobstore: Failed to page in blob at %" PRIu64 ": %d\n",
+                           start, status);
+            return;
+        }
+        start = next;
+        len = next_len;
+        buf ^= 1;
+    }
+}
+
+void BlobPager::StartRead(const Source& source, uint64_t offset, uint64_t len, size_t buf,
+                          Read* read) {
+    TRACE_DURATION("blobstore", "BlobPager::StartRead", "offset", offset, "len", len);
+
+    completion_reset(&read->done);
+    read->status = ZX_OK;
+
+    // Each run is at least a block long, so there are no more of them than
+    // there are blocks in the transfer buffer.
+    const uint64_t block_factor = kBlobstoreBlockSize / blobstore_->BlockSize();
+    const uint64_t data_start = DataStartBlock(blobstore_->info_);
+    const vmoid_t vmoid = transfer_vmoid_[buf];
+    block_fifo_request_t requests[kTransferBlocks];
+    size_t count = 0;
+    ForEachRun(source.extents, source.merkle_blocks + offset / kBlobstoreBlockSize,
+               len / kBlobstoreBlockSize,
+               [&](uint64_t block, uint64_t start, uint64_t length) {
+        block_fifo_request_t* request = &requests[count++];
+        request->vmoid = vmoid;
+        request->opcode = BLOCKIO_READ;
+        request->vmo_offset = block * block_factor;
+        request->dev_offset = (data_start + start) * block_factor;
+        request->length = static_cast<uint32_t>(length * block_factor);
+    });
+    blobstore_->TxnAsync(requests, count, [read](zx_status_t status) {
+        read->status = status;
+        completion_signal(&read->done);
+    });
+}
+
+zx_status_t BlobPager::SupplyRange(const Source& source, uint64_t offset, uint64_t len,
+                                   size_t buf) {
+    TRACE_DURATION("blobstore", "BlobPager::SupplyRange", "offset", offset, "len", len);
+
+    // The tail of the last block is not part of the blob, keep it zero.
+    zx_status_t status;
+    uint8_t* data = static_cast<uint8_t*>(transfer_[buf]->GetData());
+    const uint64_t valid = fbl::min(len, source.blob_size - offset);
+    memset(data + valid, 0, len - valid);
+
+    // Verify() looks for the range at |offset| into the data, point it at the
+    // transfer buffer.
+    Digest digest;
+    digest = source.digest;
+    const void* base = reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(data) - offset);
+    if ((status = MerkleTree::Verify(base, source.blob_size, source.merkle.get(),
+                                     source.merkle_size, offset, valid, digest)) != ZX_OK) {
+        return status;
+    }
+
+    return zx_pager_supply_pages(pager_.get(), source.vmo.get(), offset, len,
+                                 transfer_[buf]->GetVmo(), 0);
+}
+
+} // namespace blobstore
@@ -18,8 +18,11 @@ COMMON_SRCS := \
 MODULE_SRCS := \
     $(COMMON_SRCS) \
     $(LOCAL_DIR)/blobstore.cpp \
+    $(LOCAL_DIR)/cache.cpp \
+    $(LOCAL_DIR)/pager.cpp \
     $(LOCAL_DIR)/vnode.cpp \
     $(LOCAL_DIR)/rpc.cpp \
+    $(LOCAL_DIR)/writeback.cpp \
 
 MODULE_STATIC_LIBS := \
     system/ulib/fs \
@@ -27,9 +30,12 @@ MODULE_STATIC_LIBS := \
     system/ulib/async \
     system/ulib/async.loop-cpp \
     system/ulib/async.loop \
+    system/ulib/block-client.cpp \
     system/ulib/block-client \
     system/ulib/digest \
+    system/ulib/region-alloc \
     third_party/ulib/uboringssl \
+    third_party/ulib/lz4 \
     system/ulib/trace \
     system/ulib/zx \
     system/ulib/zxcpp \
@@ -30,13 +30,19 @@ using digest::Digest;
 namespace blobstore {
 
 VnodeBlob::~VnodeBlob() {
+    // A blob whose write was abandoned may still have blocks on their way to
+    // disk, which must land before those blocks are freed.
+    WaitForWrites();
+    if (GetState() == kBlobStateReadable && !DeletionQueued() && !IsDirectory()) {
+        CacheContents();
+    }
+    if (data_vmo_.is_valid()) {
+        data_vmo_.reset();
+        blobstore_->pager_->Release(map_index_);
+    }
     blobstore_->ReleaseBlob(this);
     if (blob_ != nullptr) {
-        block_fifo_request_t request;
-        request.txnid = blobstore_->TxnId();
-        request.vmoid = vmoid_;
-        request.opcode = BLOCKIO_CLOSE_VMO;
-        blobstore_->Txn(&request, 1);
+        blobstore_->DetachVmo(vmoid_);
     }
 }
 
@@ -202,6 +208,27 @@ zx_status_t VnodeBlob::Ioctl(uint32_t op, const void* in_buf, size_t in_len, voi
         return len > 0 ? ZX_OK : static_cast<zx_status_t>(len);
     }
 #endif
+    case IOCTL_VFS_QUERY_BLOB_CACHE: {
+        if (out_len < sizeof(vfs_blob_cache_info_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        blobstore_->cache_.GetInfo(static_cast<vfs_blob_cache_info_t*>(out_buf));
+        *out_actual = sizeof(vfs_blob_cache_info_t);
+        return ZX_OK;
+    }
+    case IOCTL_VFS_INSTALL_BATCH: {
+        // Unsupported requests have their handle closed by the caller.
+        if (!IsDirectory()) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        const auto* batch = reinterpret_cast<const vfs_install_batch_t*>(in_buf);
+        zx::vmo vmo(batch->vmo);
+        if (in_len < sizeof(vfs_install_batch_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        *out_actual = 0;
+        return InstallBatch(vmo.get(), batch->count);
+    }
     default: {
         return ZX_ERR_NOT_SUPPORTED;
     }
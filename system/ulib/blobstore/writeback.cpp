@@ -0,0 +1,153 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <zircon/device/block.h>
+
+#include <blobstore/blobstore.h>
+
+namespace blobstore {
+
+zx_status_t BlobWriteback::Create(Blobstore* blobstore, fbl::unique_ptr<BlobWriteback>* out) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<BlobWriteback> wb(new (&ac) BlobWriteback(blobstore));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    if (thrd_create_with_name(&wb->writeback_thrd_, BlobWriteback::WritebackThread, wb.get(),
+                              "blobstore-writeback") != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    wb->running_ = true;
+
+    *out = fbl::move(wb);
+    return ZX_OK;
+}
+
+BlobWriteback::BlobWriteback(Blobstore* blobstore) : blobstore_(blobstore) {
+    cnd_init(&consumer_cvar_);
+    cnd_init(&producer_cvar_);
+}
+
+BlobWriteback::~BlobWriteback() {
+    // Block until the background thread has written out everything queued.
+    if (running_) {
+        {
+            fbl::AutoLock lock(&lock_);
+            unmounting_ = true;
+            cnd_signal(&consumer_cvar_);
+        }
+        int r;
+        thrd_join(writeback_thrd_, &r);
+    }
+    cnd_destroy(&consumer_cvar_);
+    cnd_destroy(&producer_cvar_);
+}
+
+void BlobWriteback::Enqueue(WritebackBatch* batch, vmoid_t vmoid, uint64_t vmo_offset,
+                            uint64_t dev_offset, uint64_t nblocks) {
+    TRACE_DURATION("blobstore", "BlobWriteback::Enqueue", "vmo_offset", vmo_offset,
+                   "nblocks", nblocks);
+    fbl::AutoLock lock(&lock_);
+    for (;;) {
+        // A blob is written in order, so its next write usually follows on
+        // from the last one queued, and can be issued as one.
+        if (len_ > 0) {
+            block_fifo_request_t* last = &queue_[(start_ + len_ - 1) % kQueueDepth].request;
+            if (queue_[(start_ + len_ - 1) % kQueueDepth].batch == batch &&
+                last->vmoid == vmoid && last->vmo_offset + last->length == vmo_offset &&
+                last->dev_offset + last->length == dev_offset) {
+                last->length += nblocks;
+                return;
+            }
+        }
+        if (len_ < kQueueDepth) {
+            break;
+        }
+        cnd_wait(&producer_cvar_, lock_.GetInternal());
+    }
+
+    Request* req = &queue_[(start_ + len_) % kQueueDepth];
+    req->batch = batch;
+    req->request.vmoid = vmoid;
+    req->request.opcode = BLOCKIO_WRITE;
+    req->request.vmo_offset = vmo_offset;
+    req->request.dev_offset = dev_offset;
+    req->request.length = nblocks;
+    len_++;
+    batch->pending++;
+    cnd_signal(&consumer_cvar_);
+}
+
+zx_status_t BlobWriteback::Wait(WritebackBatch* batch) {
+    TRACE_DURATION("blobstore", "BlobWriteback::Wait");
+    fbl::AutoLock lock(&lock_);
+    while (batch->pending > 0) {
+        cnd_wait(&producer_cvar_, lock_.GetInternal());
+    }
+    zx_status_t status = batch->status;
+    batch->status = ZX_OK;
+    return status;
+}
+
+int BlobWriteback::WritebackThread(void* arg) {
+    BlobWriteback* wb = reinterpret_cast<BlobWriteback*>(arg);
+    const uint64_t block_factor = kBlobstoreBlockSize / wb->blobstore_->BlockSize();
+
+    wb->lock_.Acquire();
+    for (;;) {
+        if (wb->len_ == 0 || wb->in_flight_ == kMaxInFlight) {
+            if (wb->len_ == 0 && wb->in_flight_ == 0 && wb->unmounting_) {
+                wb->lock_.Release();
+                return 0;
+            }
+            cnd_wait(&wb->consumer_cvar_, wb->lock_.GetInternal());
+            continue;
+        }
+
+        // Take everything queued so far, so writes arriving meanwhile can
+        // keep being merged into the queue.
+        WritebackBatch* batches[kQueueDepth];
+        block_fifo_request_t requests[kQueueDepth];
+        const size_t count = wb->len_;
+        for (size_t i = 0; i < count; i++) {
+            const Request& req = wb->queue_[(wb->start_ + i) % kQueueDepth];
+            batches[i] = req.batch;
+            requests[i] = req.request;
+            requests[i].vmo_offset *= block_factor;
+            requests[i].dev_offset *= block_factor;
+            requests[i].length *= block_factor;
+        }
+        wb->start_ = (wb->start_ + count) % kQueueDepth;
+        wb->len_ = 0;
+        wb->in_flight_++;
+        cnd_broadcast(&wb->producer_cvar_);
+
+        // Go back to the queue without waiting for the device, which is kept
+        // busy with up to kMaxInFlight transactions at once.
+        wb->lock_.Release();
+        wb->blobstore_->TxnAsync(requests, count, [wb, batches, count](zx_status_t status) {
+            wb->Complete(batches, count, status);
+        });
+        wb->lock_.Acquire();
+    }
+}
+
+void BlobWriteback::Complete(WritebackBatch* const* batches, size_t count, zx_status_t status) {
+    fbl::AutoLock lock(&lock_);
+    for (size_t i = 0; i < count; i++) {
+        WritebackBatch* batch = batches[i];
+        if (status != ZX_OK && batch->status == ZX_OK) {
+            batch->status = status;
+        }
+        batch->pending--;
+    }
+    in_flight_--;
+    cnd_broadcast(&producer_cvar_);
+    cnd_signal(&consumer_cvar_);
+}
+
+} // namespace blobstore
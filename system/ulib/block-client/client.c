@@ -129,3 +129,11 @@ zx_status_t block_fifo_txn(fifo_client_t* client, block_fifo_request_t* requests
 
     return client->txns[txnid].status;
 }
+
+zx_status_t block_txn_set_priority(int fd, txnid_t txnid, uint32_t priority) {
+    block_txn_priority_t req;
+    req.txnid = txnid;
+    req.priority = (uint16_t) priority;
+    ssize_t r = ioctl_block_set_txn_priority(fd, &req);
+    return (r < 0) ? (zx_status_t) r : ZX_OK;
+}
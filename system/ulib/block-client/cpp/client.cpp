@@ -0,0 +1,284 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <block-client/cpp/client.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <sync/completion.h>
+#include <zircon/device/block.h>
+#include <zircon/syscalls.h>
+
+namespace block_client {
+namespace {
+
+// Writes on a FIFO, repeating the write later if the FIFO is full.
+zx_status_t DoWrite(zx_handle_t fifo, const block_fifo_request_t* request, size_t count) {
+    while (count > 0) {
+        uint32_t actual;
+        zx_status_t status = zx_fifo_write(fifo, request, sizeof(block_fifo_request_t) * count,
+                                           &actual);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            zx_signals_t signals;
+            if ((status = zx_object_wait_one(fifo, ZX_FIFO_WRITABLE | ZX_FIFO_PEER_CLOSED,
+                                             ZX_TIME_INFINITE, &signals)) != ZX_OK) {
+                return status;
+            } else if (signals & ZX_FIFO_PEER_CLOSED) {
+                return ZX_ERR_PEER_CLOSED;
+            }
+        } else if (status != ZX_OK) {
+            return status;
+        } else {
+            count -= actual;
+            request += actual;
+        }
+    }
+    return ZX_OK;
+}
+
+} // namespace
+
+zx_status_t Client::Create(int fd, zx_handle_t fifo, async_t* async,
+                           fbl::unique_ptr<Client>* out) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Client> client(new (&ac) Client(fd, fifo, async));
+    if (!ac.check()) {
+        zx_handle_close(fifo);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Other clients of the device may hold txnids of their own, so make do
+    // with however many are left.
+    while (client->txn_count_ < kMaxTxns) {
+        txnid_t txnid;
+        if (ioctl_block_alloc_txn(fd, &txnid) < 0) {
+            break;
+        }
+        client->txnids_[client->txn_count_++] = txnid;
+    }
+    if (client->txn_count_ == 0) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    {
+        fbl::AutoLock lock(&client->lock_);
+        memcpy(client->free_, client->txnids_, sizeof(txnid_t) * client->txn_count_);
+        client->free_count_ = client->txn_count_;
+    }
+
+    zx_status_t status;
+    if ((status = client->wait_.Begin(async)) != ZX_OK) {
+        return status;
+    }
+
+    *out = fbl::move(client);
+    return ZX_OK;
+}
+
+Client::Client(int fd, zx_handle_t fifo, async_t* async)
+    : fd_(fd), fifo_(fifo), async_(async) {
+    wait_.set_object(fifo);
+    wait_.set_trigger(ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED);
+}
+
+Client::~Client() {
+    wait_.Cancel(async_);
+    FailAll(ZX_ERR_CANCELED);
+    for (size_t i = 0; i < txn_count_; i++) {
+        ioctl_block_free_txn(fd_, &txnids_[i]);
+    }
+    zx_handle_close(fifo_);
+}
+
+void Client::Transaction(const block_fifo_request_t* requests, size_t count,
+                         TxnCallback callback) {
+    if (count == 0) {
+        callback(ZX_OK);
+        return;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Txn> txn(new (&ac) Txn);
+    if (!ac.check()) {
+        callback(ZX_ERR_NO_MEMORY);
+        return;
+    }
+    txn->pending = 0;
+    txn->status = ZX_OK;
+
+    // Build every group before sending any, so that the transaction either
+    // goes out whole or not at all.
+    fbl::DoublyLinkedList<fbl::unique_ptr<Group>> groups;
+    for (size_t off = 0; off < count; off += MAX_TXN_MESSAGES) {
+        fbl::unique_ptr<Group> group(new (&ac) Group);
+        if (!ac.check()) {
+            callback(ZX_ERR_NO_MEMORY);
+            return;
+        }
+        group->txn = txn.get();
+        group->count = fbl::min(count - off, static_cast<size_t>(MAX_TXN_MESSAGES));
+        memcpy(group->requests, &requests[off], sizeof(block_fifo_request_t) * group->count);
+        groups.push_back(fbl::move(group));
+        txn->pending++;
+    }
+    txn->callback = fbl::move(callback);
+
+    // Owned by the groups from here on, and freed by the last to complete.
+    txn.release();
+    while (!groups.is_empty()) {
+        Send(groups.pop_front());
+    }
+}
+
+zx_status_t Client::Transaction(const block_fifo_request_t* requests, size_t count) {
+    completion_t done;
+    completion_reset(&done);
+    zx_status_t result = ZX_OK;
+    Transaction(requests, count, [&done, &result](zx_status_t status) {
+        result = status;
+        completion_signal(&done);
+    });
+    completion_wait(&done, ZX_TIME_INFINITE);
+    return result;
+}
+
+void Client::Send(fbl::unique_ptr<Group> group) {
+    txnid_t txnid;
+    {
+        fbl::AutoLock lock(&lock_);
+        zx_status_t status = closed_status_;
+        if (status != ZX_OK) {
+            lock.release();
+            Complete(fbl::move(group), status);
+            return;
+        } else if (free_count_ == 0) {
+            waiting_.push_back(fbl::move(group));
+            return;
+        }
+        txnid = free_[--free_count_];
+        in_flight_[txnid] = fbl::move(group);
+    }
+    Write(txnid);
+}
+
+void Client::Write(txnid_t txnid) {
+    // Write from a copy, as the group may complete, and be freed, as soon as
+    // its last request is on the fifo.
+    block_fifo_request_t requests[MAX_TXN_MESSAGES];
+    size_t count;
+    {
+        fbl::AutoLock lock(&lock_);
+        Group* group = in_flight_[txnid].get();
+        if (group == nullptr) {
+            return;
+        }
+        count = group->count;
+        for (size_t i = 0; i < count; i++) {
+            requests[i] = group->requests[i];
+            requests[i].txnid = txnid;
+            requests[i].opcode = (requests[i].opcode & BLOCKIO_OP_MASK) |
+                                 (i == count - 1 ? BLOCKIO_TXN_END : 0);
+        }
+    }
+
+    zx_status_t status = DoWrite(fifo_, requests, count);
+    if (status != ZX_OK) {
+        // Part of the group may have gone out, so the fifo can no longer be
+        // trusted to stay in step with the device.
+        fbl::unique_ptr<Group> failed;
+        {
+            fbl::AutoLock lock(&lock_);
+            failed = fbl::move(in_flight_[txnid]);
+        }
+        if (failed != nullptr) {
+            Complete(fbl::move(failed), status);
+        }
+        FailAll(status);
+    }
+}
+
+void Client::Complete(fbl::unique_ptr<Group> group, zx_status_t status) {
+    Txn* txn = group->txn;
+    group.reset();
+    {
+        fbl::AutoLock lock(&lock_);
+        if (status != ZX_OK && txn->status == ZX_OK) {
+            txn->status = status;
+        }
+        if (--txn->pending > 0) {
+            return;
+        }
+    }
+    fbl::unique_ptr<Txn> done(txn);
+    done->callback(done->status);
+}
+
+void Client::FailAll(zx_status_t status) {
+    fbl::DoublyLinkedList<fbl::unique_ptr<Group>> failed;
+    {
+        fbl::AutoLock lock(&lock_);
+        if (closed_status_ == ZX_OK) {
+            closed_status_ = status;
+        }
+        for (size_t i = 0; i < txn_count_; i++) {
+            if (in_flight_[txnids_[i]] != nullptr) {
+                failed.push_back(fbl::move(in_flight_[txnids_[i]]));
+            }
+        }
+        while (!waiting_.is_empty()) {
+            failed.push_back(waiting_.pop_front());
+        }
+    }
+    while (!failed.is_empty()) {
+        Complete(failed.pop_front(), status);
+    }
+}
+
+async_wait_result_t Client::OnFifoSignal(async_t* async, zx_status_t status,
+                                         const zx_packet_signal_t* signal) {
+    if (status != ZX_OK) {
+        FailAll(status);
+        return ASYNC_WAIT_FINISHED;
+    }
+
+    block_fifo_response_t responses[kMaxTxns];
+    uint32_t count;
+    while ((status = zx_fifo_read(fifo_, responses, sizeof(responses), &count)) == ZX_OK) {
+        for (uint32_t i = 0; i < count; i++) {
+            const txnid_t txnid = responses[i].txnid;
+            fbl::unique_ptr<Group> done;
+            bool next = false;
+            {
+                fbl::AutoLock lock(&lock_);
+                if (txnid >= MAX_TXN_COUNT || in_flight_[txnid] == nullptr) {
+                    continue;
+                }
+                done = fbl::move(in_flight_[txnid]);
+                // Hand the txnid straight to the next group waiting for one.
+                if (!waiting_.is_empty()) {
+                    in_flight_[txnid] = waiting_.pop_front();
+                    next = true;
+                } else {
+                    free_[free_count_++] = txnid;
+                }
+            }
+            Complete(fbl::move(done), responses[i].status);
+            if (next) {
+                Write(txnid);
+            }
+        }
+    }
+
+    if (status != ZX_ERR_SHOULD_WAIT) {
+        FailAll(status);
+        return ASYNC_WAIT_FINISHED;
+    } else if (signal->observed & ZX_FIFO_PEER_CLOSED) {
+        FailAll(ZX_ERR_PEER_CLOSED);
+        return ASYNC_WAIT_FINISHED;
+    }
+    return ASYNC_WAIT_AGAIN;
+}
+
+} // namespace block_client
@@ -35,6 +35,14 @@ void block_fifo_release_client(fifo_client_t* client);
 // length                                   read, write
 // vmo_offset                               read, write
 // dev_offset                               read, write
+//
+// Only one transaction per caller is outstanding at a time; the C++ client in
+// <block-client/cpp/client.h> keeps many on the device at once.
 zx_status_t block_fifo_txn(fifo_client_t* client, block_fifo_request_t* requests, size_t count);
 
+// Sets the priority class (BLOCK_PRIORITY_*) of the requests sent on |txnid|
+// from now on, where |fd| is the block device the txn was allocated from.
+// Txns start out as BLOCK_PRIORITY_INTERACTIVE.
+zx_status_t block_txn_set_priority(int fd, txnid_t txnid, uint32_t priority);
+
 __END_CDECLS
@@ -0,0 +1,112 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <async/cpp/wait.h>
+#include <async/dispatcher.h>
+#include <fbl/function.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/device/block.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+namespace block_client {
+
+// Invoked once every request of a transaction has completed, with the first
+// error any of them hit.
+using TxnCallback = fbl::Function<void(zx_status_t status)>;
+
+// Sends requests to a block device over its fifo, with many transactions
+// outstanding at once.
+//
+// A transaction is sent as groups of up to MAX_TXN_MESSAGES requests, each
+// group on a txnid of its own taken from a pool the client allocates. Groups
+// which find the pool empty wait in the client until an earlier group
+// completes. Responses are read on |async|, where completion callbacks run.
+//
+// The client reads every response on the fifo, so it may not be used
+// alongside block_fifo_txn() on the same fifo.
+//
+// This class is thread-safe.
+class Client {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Client);
+
+    // Takes ownership of |fifo|, obtained from the block device |fd|, which
+    // must outlive the client.
+    static zx_status_t Create(int fd, zx_handle_t fifo, async_t* async,
+                              fbl::unique_ptr<Client>* out);
+
+    // |async| must no longer be dispatching for the client, having been
+    // shut down first. Anything still outstanding fails with ZX_ERR_CANCELED.
+    ~Client();
+
+    // Sends |count| requests, of which the client fills in the txnid and
+    // BLOCKIO_TXN_END flag. |callback| is invoked on |async| once they all
+    // complete; or, when they could not be sent, on the calling thread before
+    // this returns.
+    void Transaction(const block_fifo_request_t* requests, size_t count, TxnCallback callback);
+
+    // As above, blocking until the requests complete. Must not be called on
+    // the thread which dispatches |async|.
+    zx_status_t Transaction(const block_fifo_request_t* requests, size_t count);
+
+private:
+    // The most groups the client keeps on the device at once. Responses are
+    // then always able to fit in the fifo, so its writer is never held up by
+    // its reader.
+    static constexpr size_t kMaxTxns = BLOCK_FIFO_MAX_DEPTH / MAX_TXN_MESSAGES;
+
+    struct Txn {
+        TxnCallback callback;
+        size_t pending;
+        zx_status_t status;
+    };
+
+    struct Group : public fbl::DoublyLinkedListable<fbl::unique_ptr<Group>> {
+        Txn* txn;
+        size_t count;
+        block_fifo_request_t requests[MAX_TXN_MESSAGES];
+    };
+
+    Client(int fd, zx_handle_t fifo, async_t* async);
+
+    // Puts |group| on the device, or queues it until a txnid is free.
+    void Send(fbl::unique_ptr<Group> group);
+    // Writes out the group in flight on |txnid|.
+    void Write(txnid_t txnid);
+
+    // Records that |group| finished with |status|, invoking the callback of
+    // its transaction if it was the last.
+    void Complete(fbl::unique_ptr<Group> group, zx_status_t status);
+
+    // Fails every group in flight or queued with |status|, as well as any
+    // sent from now on.
+    void FailAll(zx_status_t status);
+
+    async_wait_result_t OnFifoSignal(async_t* async, zx_status_t status,
+                                     const zx_packet_signal_t* signal);
+
+    const int fd_;
+    const zx_handle_t fifo_;
+    async_t* const async_;
+    async::WaitMethod<Client, &Client::OnFifoSignal> wait_{this};
+
+    fbl::Mutex lock_;
+    // Every txnid the client allocated, and those of them not in use.
+    txnid_t txnids_[kMaxTxns];
+    size_t txn_count_{};
+    txnid_t free_[kMaxTxns] __TA_GUARDED(lock_);
+    size_t free_count_ __TA_GUARDED(lock_){};
+    // The group in flight on each txnid.
+    fbl::unique_ptr<Group> in_flight_[MAX_TXN_COUNT] __TA_GUARDED(lock_);
+    fbl::DoublyLinkedList<fbl::unique_ptr<Group>> waiting_ __TA_GUARDED(lock_);
+    zx_status_t closed_status_ __TA_GUARDED(lock_) = ZX_OK;
+};
+
+} // namespace block_client
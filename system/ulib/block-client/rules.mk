@@ -25,3 +25,33 @@ MODULE_HEADER_DEPS := system/ulib/ddk
 MODULE_PACKAGE = static
 
 include make/module.mk
+
+#
+# libblock-client-cpp.a: the asynchronous C++ client
+#
+
+MODULE := $(LOCAL_DIR).cpp
+
+MODULE_NAME := block-client-cpp
+
+MODULE_TYPE := userlib
+
+MODULE_SRCS := \
+    $(LOCAL_DIR)/cpp/client.cpp \
+
+MODULE_STATIC_LIBS := \
+    system/ulib/async.cpp \
+    system/ulib/async \
+    system/ulib/fbl \
+    system/ulib/sync \
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/zircon \
+    system/ulib/fdio \
+
+MODULE_HEADER_DEPS := system/ulib/ddk
+
+MODULE_PACKAGE = static
+
+include make/module.mk
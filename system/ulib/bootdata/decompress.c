@@ -5,6 +5,8 @@
 #include <bootdata/decompress.h>
 
 #include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 
 #include <zircon/boot/bootdata.h>
@@ -85,18 +87,74 @@ static zx_status_t check_lz4_frame(const lz4_frame_desc* fd,
     return ZX_OK;
 }
 
-static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
-                                         size_t _outsize, zx_handle_t* out,
-                                         const char** err) {
-    if (*(const uint32_t*)data != ZX_LZ4_MAGIC) {
+// Decompress one LZ4 frame of at most data_len bytes at data, which must
+// expand to exactly content_size bytes, into dst.
+static zx_status_t decompress_lz4_frame(const uint8_t* data, size_t data_len,
+                                        size_t content_size, uint8_t* dst,
+                                        const char** err) {
+    if (data_len < sizeof(uint32_t) + sizeof(lz4_frame_desc) ||
+        *(const uint32_t*)data != ZX_LZ4_MAGIC) {
         *err = "bad magic number for compressed bootfs";
         return ZX_ERR_INVALID_ARGS;
     }
+    const uint8_t* end = data + data_len;
     data += sizeof(uint32_t);
 
-    check_lz4_frame((const lz4_frame_desc*)data, _outsize, err);
+    zx_status_t status = check_lz4_frame((const lz4_frame_desc*)data, content_size, err);
+    if (status != ZX_OK) {
+        return status;
+    }
     data += sizeof(lz4_frame_desc);
 
+    size_t remaining = content_size;
+
+    // Read each LZ4 block and decompress it. Block sizes are 32 bits.
+    for (;;) {
+        if ((size_t)(end - data) < sizeof(uint32_t)) {
+            *err = "lz4 frame truncated";
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        uint32_t blocksize = *(const uint32_t*)data;
+        data += sizeof(uint32_t);
+        if (blocksize == 0) {
+            break;
+        }
+
+        // If the data is uncompressed, the high bit is 1.
+        uint32_t actual = blocksize & 0x7fffffff;
+        if (actual > (size_t)(end - data)) {
+            *err = "lz4 frame truncated";
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if (blocksize >> 31) {
+            if (actual > remaining) {
+                *err = "bootdata outsize too small for lz4 decompression";
+                return ZX_ERR_INVALID_ARGS;
+            }
+            memcpy(dst, data, actual);
+        } else {
+            int dcmp = LZ4_decompress_safe((const char*)data, (char*)dst, actual, remaining);
+            if (dcmp < 0) {
+                *err = "lz4 decompression failed";
+                return ZX_ERR_BAD_STATE;
+            }
+            actual = dcmp;
+        }
+        dst += actual;
+        data += blocksize & 0x7fffffff;
+        remaining -= actual;
+    }
+
+    if (remaining != 0) {
+        *err = "bootdata size error; outsize does not match decompressed size";
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+static zx_status_t create_bootfs_vmo(zx_handle_t vmar, size_t _outsize,
+                                     zx_handle_t* out, uintptr_t* addr,
+                                     size_t* len, const char** err) {
     size_t outsize = (_outsize + 4095) & ~4095;
     if (outsize < _outsize) {
         // newsize wrapped, which means the outsize was too large
@@ -111,68 +169,259 @@ static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
     }
     zx_object_set_property(dst_vmo, ZX_PROP_NAME, "bootfs", 6);
 
-    uintptr_t dst_addr = 0;
     status = zx_vmar_map(vmar, 0, dst_vmo, 0, outsize,
-            ZX_VM_FLAG_PERM_READ|ZX_VM_FLAG_PERM_WRITE, &dst_addr);
+            ZX_VM_FLAG_PERM_READ|ZX_VM_FLAG_PERM_WRITE, addr);
     if (status < 0) {
         *err = "zx_vmar_map failed on bootfs vmo during decompression";
+        zx_handle_close(dst_vmo);
         return status;
     }
+    *out = dst_vmo;
+    *len = outsize;
+    return ZX_OK;
+}
 
-    size_t remaining = outsize;
-    uint8_t* dst = (uint8_t*)dst_addr;
+static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
+                                         size_t data_len, size_t _outsize,
+                                         zx_handle_t* out, const char** err) {
+    zx_handle_t dst_vmo;
+    uintptr_t dst_addr;
+    size_t outsize;
+    zx_status_t status = create_bootfs_vmo(vmar, _outsize, &dst_vmo,
+                                           &dst_addr, &outsize, err);
+    if (status < 0) {
+        return status;
+    }
 
-    // Read each LZ4 block and decompress it. Block sizes are 32 bits.
-    uint32_t blocksize = *(const uint32_t*)data;
-    data += sizeof(uint32_t);
-    while (blocksize) {
-        // If the data is uncompressed, the high bit is 1.
-        if (blocksize >> 31) {
-            uint32_t actual = blocksize & 0x7fffffff;
-            memcpy(dst, data, actual);
-            dst += actual;
-            data += actual;
-            if (remaining - actual > remaining) {
-                // Remaining wrapped around (would be negative if signed)
-                *err = "bootdata outsize too small for lz4 decompression";
-                return ZX_ERR_INVALID_ARGS;
-            }
-            remaining -= actual;
-        } else {
-            int dcmp = LZ4_decompress_safe((const char*)data, (char*)dst, blocksize, remaining);
-            if (dcmp < 0) {
-                *err = "lz4 decompression failed";
-                return ZX_ERR_BAD_STATE;
-            }
-            dst += dcmp;
-            data += blocksize;
-            if (remaining - dcmp > remaining) {
-                // Remaining wrapped around (would be negative if signed)
-                *err = "bootdata outsize too small for lz4 decompression";
-                return ZX_ERR_INVALID_ARGS;
-            }
-            remaining -= dcmp;
-        }
+    status = decompress_lz4_frame(data, data_len, _outsize, (uint8_t*)dst_addr, err);
 
-        blocksize = *(uint32_t*)data;
-        data += sizeof(uint32_t);
+    zx_status_t s = zx_vmar_unmap(vmar, dst_addr, outsize);
+    if (status == ZX_OK && s < 0) {
+        *err = "zx_vmar_unmap after decompress failed";
+        status = s;
+    }
+    if (status < 0) {
+        zx_handle_close(dst_vmo);
+        return status;
     }
+    *out = dst_vmo;
+    return ZX_OK;
+}
 
-    // Sanity check: verify that we didn't have more than one page leftover.
-    // The bootdata header should have specified the exact outsize needed, which
-    // we rounded up to the next full page.
-    if (remaining > 4095) {
-        *err = "bootdata size error; outsize does not match decompressed size";
-        return ZX_ERR_INVALID_ARGS;
+static const bootfs_frame_t* lazy_frames(const bootfs_lazy_t* lazy) {
+    return (const bootfs_frame_t*)(lazy->index + 1);
+}
+
+zx_status_t bootfs_lazy_open(zx_handle_t vmar, zx_handle_t vmo,
+                             size_t offset, size_t length,
+                             zx_handle_t bootfs_vmo, bootfs_lazy_t* lazy,
+                             const char** err) {
+    *err = "none";
+    memset(lazy, 0, sizeof(*lazy));
+    lazy->vmo = ZX_HANDLE_INVALID;
+
+    if (length < sizeof(bootdata_t) + sizeof(bootfs_frame_index_t)) {
+        *err = "bootfs not seekable";
+        return ZX_ERR_NOT_SUPPORTED;
     }
 
-    status = zx_vmar_unmap(vmar, dst_addr, outsize);
+    size_t aligned_offset = offset & ~(PAGE_SIZE - 1);
+    size_t align_shift = offset - aligned_offset;
+    size_t map_len = length + align_shift;
+    uintptr_t addr = 0;
+    zx_status_t status = zx_vmar_map(vmar, 0, vmo, aligned_offset, map_len,
+                                     ZX_VM_FLAG_PERM_READ, &addr);
     if (status < 0) {
-        *err = "zx_vmar_unmap after decompress failed";
+        *err = "zx_vmar_map failed on bootfs vmo";
         return status;
     }
-    *out = dst_vmo;
+
+    const bootdata_t* hdr = (const bootdata_t*)(addr + align_shift);
+    const bootfs_frame_index_t* index = (const bootfs_frame_index_t*)(hdr + 1);
+    const size_t payload_len = length - sizeof(bootdata_t);
+    const uint32_t flags = BOOTDATA_BOOTFS_FLAG_COMPRESSED | BOOTDATA_BOOTFS_FLAG_SEEKABLE;
+    if ((hdr->type != BOOTDATA_BOOTFS_BOOT && hdr->type != BOOTDATA_BOOTFS_SYSTEM &&
+         hdr->type != BOOTDATA_BOOTFS_DISCARD) || (hdr->flags & flags) != flags) {
+        *err = "bootfs not seekable";
+        status = ZX_ERR_NOT_SUPPORTED;
+        goto fail;
+    }
+    if (index->magic != BOOTFS_FRAME_INDEX_MAGIC || index->frame_size == 0 ||
+        (index->frame_size & (PAGE_SIZE - 1)) != 0 || hdr->length > payload_len ||
+        index->frame_count != (hdr->extra + index->frame_size - 1) / index->frame_size ||
+        sizeof(*index) + (size_t)index->frame_count * sizeof(bootfs_frame_t) > hdr->length) {
+        *err = "bad seekable bootfs frame index";
+        status = ZX_ERR_IO_DATA_INTEGRITY;
+        goto fail;
+    }
+
+    lazy->vmar = vmar;
+    lazy->bootdata_vmo = vmo;
+    lazy->index_offset = offset + sizeof(bootdata_t);
+    lazy->src_addr = addr;
+    lazy->src_len = map_len;
+    lazy->payload_len = hdr->length;
+    lazy->outsize = hdr->extra;
+    lazy->frame_count = index->frame_count;
+
+    if (bootfs_vmo == ZX_HANDLE_INVALID) {
+        status = create_bootfs_vmo(vmar, lazy->outsize, &lazy->vmo,
+                                   &lazy->dst_addr, &lazy->dst_len, err);
+        if (status < 0) {
+            goto fail;
+        }
+    } else {
+        uint64_t size;
+        status = zx_vmo_get_size(bootfs_vmo, &size);
+        if (status < 0 || size < lazy->outsize) {
+            *err = "bootfs vmo too small for seekable bootfs";
+            status = (status < 0) ? status : ZX_ERR_BUFFER_TOO_SMALL;
+            goto fail;
+        }
+        lazy->dst_len = (lazy->outsize + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        status = zx_vmar_map(vmar, 0, bootfs_vmo, 0, lazy->dst_len,
+                             ZX_VM_FLAG_PERM_READ|ZX_VM_FLAG_PERM_WRITE,
+                             &lazy->dst_addr);
+        if (status < 0) {
+            *err = "zx_vmar_map failed on bootfs vmo during decompression";
+            goto fail;
+        }
+        lazy->vmo = bootfs_vmo;
+    }
+
+    // Only now is lazy active.
+    lazy->index = index;
     return ZX_OK;
+
+fail:
+    zx_vmar_unmap(vmar, addr, map_len);
+    memset(lazy, 0, sizeof(*lazy));
+    lazy->vmo = ZX_HANDLE_INVALID;
+    return status;
+}
+
+// Find the frames [*first, *end) covering a range, if any need looking at.
+static bool lazy_frame_range(const bootfs_lazy_t* lazy, size_t offset, size_t length,
+                             uint32_t* first, uint32_t* end) {
+    if (lazy->index == NULL || length == 0 || offset >= lazy->outsize) {
+        return false;
+    }
+    if (length > lazy->outsize - offset) {
+        length = lazy->outsize - offset;
+    }
+    const size_t frame_size = lazy->index->frame_size;
+    *first = offset / frame_size;
+    *end = (offset + length - 1) / frame_size + 1;
+    return true;
+}
+
+// Decompress frame n unless it already has been.  Different frames of the
+// same lazy may be decompressed on different threads at once.
+static zx_status_t lazy_fill_frame(bootfs_lazy_t* lazy, uint32_t n, const char** err) {
+    const uint8_t* payload = (const uint8_t*)lazy->index;
+    const bootfs_frame_t* frame = &lazy_frames(lazy)[n];
+    const size_t frame_size = lazy->index->frame_size;
+    if (frame->flags & BOOTFS_FRAME_FLAG_DECOMPRESSED) {
+        return ZX_OK;
+    }
+    if (frame->offset > lazy->payload_len ||
+        frame->length > lazy->payload_len - frame->offset) {
+        *err = "seekable bootfs frame out of bounds";
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    size_t frame_start = (size_t)n * frame_size;
+    size_t content_size = lazy->outsize - frame_start;
+    if (content_size > frame_size) {
+        content_size = frame_size;
+    }
+    zx_status_t status = decompress_lz4_frame(payload + frame->offset, frame->length,
+                                              content_size,
+                                              (uint8_t*)lazy->dst_addr + frame_start, err);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Record it in the bootdata itself, where whoever gets this bootfs
+    // next will look.  The mapping is read-only, so go through the VMO.
+    uint32_t flags = frame->flags | BOOTFS_FRAME_FLAG_DECOMPRESSED;
+    size_t actual;
+    status = zx_vmo_write(lazy->bootdata_vmo, &flags,
+                          lazy->index_offset + sizeof(bootfs_frame_index_t) +
+                          n * sizeof(bootfs_frame_t) + offsetof(bootfs_frame_t, flags),
+                          sizeof(flags), &actual);
+    if (status != ZX_OK) {
+        *err = "zx_vmo_write failed on bootdata VMO";
+        return status;
+    }
+    __atomic_fetch_add(&lazy->frames_filled, 1, __ATOMIC_RELAXED);
+    return ZX_OK;
+}
+
+zx_status_t bootfs_lazy_fill(bootfs_lazy_t* lazy, size_t offset, size_t length,
+                             const char** err) {
+    *err = "none";
+    uint32_t first, end;
+    if (!lazy_frame_range(lazy, offset, length, &first, &end)) {
+        return ZX_OK;
+    }
+
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    zx_status_t status = ZX_OK;
+    for (uint32_t n = first; n < end && status == ZX_OK; n++) {
+        status = lazy_fill_frame(lazy, n, err);
+    }
+    lazy->fill_time += zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+    return status;
+}
+
+void bootfs_lazy_work_init(bootfs_lazy_work_t* work, bootfs_lazy_t* lazy,
+                           size_t offset, size_t length) {
+    work->lazy = lazy;
+    work->status = ZX_OK;
+    work->errmsg = "none";
+    work->start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    if (!lazy_frame_range(lazy, offset, length, &work->next, &work->end)) {
+        work->next = work->end = 0;
+    }
+}
+
+void bootfs_lazy_work(bootfs_lazy_work_t* work) {
+    for (;;) {
+        uint32_t n = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED);
+        if (n >= work->end || __atomic_load_n(&work->status, __ATOMIC_RELAXED) != ZX_OK) {
+            return;
+        }
+        const char* err;
+        zx_status_t status = lazy_fill_frame(work->lazy, n, &err);
+        if (status != ZX_OK) {
+            // Only the first failure is kept.
+            zx_status_t expected = ZX_OK;
+            if (__atomic_compare_exchange_n(&work->status, &expected, status, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                work->errmsg = err;
+            }
+            return;
+        }
+    }
+}
+
+zx_status_t bootfs_lazy_work_finish(bootfs_lazy_work_t* work, const char** err) {
+    work->lazy->fill_time += zx_clock_get(ZX_CLOCK_MONOTONIC) - work->start;
+    *err = work->errmsg;
+    return work->status;
+}
+
+zx_status_t bootfs_lazy_fill_all(bootfs_lazy_t* lazy, const char** err) {
+    return bootfs_lazy_fill(lazy, 0, lazy->outsize, err);
+}
+
+void bootfs_lazy_close(bootfs_lazy_t* lazy) {
+    if (lazy->index == NULL) {
+        return;
+    }
+    zx_vmar_unmap(lazy->vmar, lazy->dst_addr, lazy->dst_len);
+    zx_vmar_unmap(lazy->vmar, lazy->src_addr, lazy->src_len);
+    lazy->index = NULL;
 }
 
 zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
@@ -203,8 +452,23 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
     case BOOTDATA_BOOTFS_BOOT:
     case BOOTDATA_BOOTFS_SYSTEM:
     case BOOTDATA_RAMDISK:
-        if (hdr->flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED) {
-            status = decompress_bootfs_vmo(vmar, (const uint8_t*)bootdata_addr, hdr->extra, out, err);
+        if (hdr->flags & BOOTDATA_BOOTFS_FLAG_SEEKABLE) {
+            // Decompressing all of it lazily is the same as doing it now.
+            bootfs_lazy_t lazy;
+            status = bootfs_lazy_open(vmar, vmo, offset, length - align_shift,
+                                      ZX_HANDLE_INVALID, &lazy, err);
+            if (status == ZX_OK) {
+                status = bootfs_lazy_fill_all(&lazy, err);
+                bootfs_lazy_close(&lazy);
+                if (status == ZX_OK) {
+                    *out = lazy.vmo;
+                } else {
+                    zx_handle_close(lazy.vmo);
+                }
+            }
+        } else if (hdr->flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED) {
+            status = decompress_bootfs_vmo(vmar, (const uint8_t*)bootdata_addr,
+                                           hdr->length, hdr->extra, out, err);
         }
         break;
     default:
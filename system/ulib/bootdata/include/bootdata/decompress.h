@@ -7,7 +7,10 @@
 
 #pragma GCC visibility push(hidden)
 
+#include <zircon/boot/bootdata.h>
 #include <zircon/types.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Decompress bootdata at offset of total size length into a new VMO
 // On failure, errmsg is a human readable error description to provide
@@ -16,4 +19,76 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
                                 size_t offset, size_t length,
                                 zx_handle_t* out, const char** errmsg);
 
+// State for decompressing a seekable bootfs (BOOTDATA_BOOTFS_FLAG_SEEKABLE)
+// a range at a time.  Callers may read the fields from vmo on; the rest are
+// private to the functions below.
+typedef struct bootfs_lazy {
+    zx_handle_t vmar;
+    zx_handle_t bootdata_vmo;
+    size_t index_offset;
+    uintptr_t src_addr;
+    size_t src_len;
+    const bootfs_frame_index_t* index;
+    size_t payload_len;
+    size_t outsize;
+    uintptr_t dst_addr;
+    size_t dst_len;
+
+    // The decompressed bootfs.  Owned by the caller; it stays valid after
+    // bootfs_lazy_close().
+    zx_handle_t vmo;
+
+    // Frames in all, frames decompressed so far and the time spent doing
+    // it, for boot timing reports.
+    uint32_t frame_count;
+    uint32_t frames_filled;
+    zx_duration_t fill_time;
+} bootfs_lazy_t;
+
+// Prepare to decompress the bootfs item at offset of total size length
+// in vmo on demand.  If bootfs_vmo is ZX_HANDLE_INVALID a new, empty VMO is
+// created for the output; otherwise bootfs_vmo is a VMO another consumer
+// already partly filled from the same item, and only frames it did not mark
+// decompressed will be.  Returns ZX_ERR_NOT_SUPPORTED if the item is not
+// seekable, leaving lazy inactive; use decompress_bootdata() for it instead.
+zx_status_t bootfs_lazy_open(zx_handle_t vmar, zx_handle_t vmo,
+                             size_t offset, size_t length,
+                             zx_handle_t bootfs_vmo, bootfs_lazy_t* lazy,
+                             const char** errmsg);
+
+// Make bytes [offset, offset + length) of lazy->vmo valid.  Does nothing
+// if lazy is inactive.
+zx_status_t bootfs_lazy_fill(bootfs_lazy_t* lazy, size_t offset, size_t length,
+                             const char** errmsg);
+
+// Make all of lazy->vmo valid.
+zx_status_t bootfs_lazy_fill_all(bootfs_lazy_t* lazy, const char** errmsg);
+
+// A range of a seekable bootfs being decompressed by several threads at
+// once, a frame at a time.  Callers may read the frames [next, end) left to
+// do after bootfs_lazy_work_init(); the rest is private.
+typedef struct bootfs_lazy_work {
+    uint32_t next;
+    uint32_t end;
+    bootfs_lazy_t* lazy;
+    zx_status_t status;
+    const char* errmsg;
+    zx_time_t start;
+} bootfs_lazy_work_t;
+
+// Prepare to make bytes [offset, offset + length) of lazy->vmo valid.
+void bootfs_lazy_work_init(bootfs_lazy_work_t* work, bootfs_lazy_t* lazy,
+                           size_t offset, size_t length);
+
+// Decompress frames from work until none are left or one fails.  Any
+// number of threads may call this on the same work at once.
+void bootfs_lazy_work(bootfs_lazy_work_t* work);
+
+// Once every thread has returned from bootfs_lazy_work(), account the time
+// taken to lazy and return the first failure, if any.
+zx_status_t bootfs_lazy_work_finish(bootfs_lazy_work_t* work, const char** errmsg);
+
+// Unmap everything bootfs_lazy_open() mapped.  lazy->vmo is not closed.
+void bootfs_lazy_close(bootfs_lazy_t* lazy);
+
 #pragma GCC visibility pop
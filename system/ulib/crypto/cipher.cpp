@@ -16,21 +16,138 @@
 #include <fbl/macros.h>
 #include <fbl/unique_ptr.h>
 #include <fdio/debug.h>
+#include <openssl/aes.h>
 #include <openssl/cipher.h>
+#include <zircon/assert.h>
+#include <zircon/compiler.h>
 #include <zircon/errors.h>
 #include <zircon/types.h>
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__aarch64__)
+#include <zircon/features.h>
+#include <zircon/syscalls.h>
+#endif
+
 #define ZXDEBUG 0
 
+// Hardware AES routines from BoringSSL's assembly.  These are hidden in the static library, but
+// visible to code linked with it.
+__BEGIN_CDECLS
+#if defined(__x86_64__)
+int aesni_set_encrypt_key(const uint8_t* key, int bits, AES_KEY* out);
+int aesni_set_decrypt_key(const uint8_t* key, int bits, AES_KEY* out);
+void aesni_xts_encrypt(const uint8_t* in, uint8_t* out, size_t length, const AES_KEY* key1,
+                       const AES_KEY* key2, const uint8_t iv[16]);
+void aesni_xts_decrypt(const uint8_t* in, uint8_t* out, size_t length, const AES_KEY* key1,
+                       const AES_KEY* key2, const uint8_t iv[16]);
+#elif defined(__aarch64__)
+int aes_hw_set_encrypt_key(const uint8_t* key, int bits, AES_KEY* out);
+int aes_hw_set_decrypt_key(const uint8_t* key, int bits, AES_KEY* out);
+void aes_hw_encrypt(const uint8_t* in, uint8_t* out, const AES_KEY* key);
+void aes_hw_decrypt(const uint8_t* in, uint8_t* out, const AES_KEY* key);
+#endif
+__END_CDECLS
+
 namespace crypto {
+namespace {
+
+// Key schedules for AES-XTS using the CPU's AES instructions directly.  The first half of an XTS
+// key encrypts the data, the second half encrypts the tweak.
+struct HwXtsKeys {
+    AES_KEY data;
+    AES_KEY tweak;
+};
+
+// Returns whether the CPU provides the AES instructions needed by |HwXtsTransform|.
+bool HasHardwareAES() {
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES) != 0;
+#elif defined(__aarch64__)
+    uint32_t features;
+    return zx_system_get_features(ZX_FEATURE_KIND_CPU, &features) == ZX_OK &&
+           (features & ZX_ARM64_FEATURE_ISA_AES) != 0;
+#else
+    return false;
+#endif
+}
+
+// Expands the XTS |key| into |out| for the given |direction|.  Returns false if hardware AES is
+// not available for this architecture or the key could not be expanded.
+bool HwXtsSetKeys(const uint8_t* key, size_t key_len, Cipher::Direction direction,
+                  HwXtsKeys* out) {
+    const int bits = static_cast<int>(key_len / 2) * 8;
+    const uint8_t* data_key = key;
+    const uint8_t* tweak_key = key + key_len / 2;
+#if defined(__x86_64__)
+    return (direction == Cipher::kEncrypt ? aesni_set_encrypt_key(data_key, bits, &out->data)
+                                          : aesni_set_decrypt_key(data_key, bits, &out->data)) ==
+               0 &&
+           aesni_set_encrypt_key(tweak_key, bits, &out->tweak) == 0;
+#elif defined(__aarch64__)
+    return (direction == Cipher::kEncrypt ? aes_hw_set_encrypt_key(data_key, bits, &out->data)
+                                          : aes_hw_set_decrypt_key(data_key, bits, &out->data)) ==
+               0 &&
+           aes_hw_set_encrypt_key(tweak_key, bits, &out->tweak) == 0;
+#else
+    return false;
+#endif
+}
+
+// Transforms a single XTS data unit of |length| bytes with the given |iv|.  |length| must be a
+// non-zero multiple of AES_BLOCK_SIZE.
+void HwXtsTransform(const HwXtsKeys& keys, Cipher::Direction direction, const uint8_t* iv,
+                    const uint8_t* in, size_t length, uint8_t* out) {
+    ZX_DEBUG_ASSERT(length != 0 && length % AES_BLOCK_SIZE == 0);
+#if defined(__x86_64__)
+    if (direction == Cipher::kEncrypt) {
+        aesni_xts_encrypt(in, out, length, &keys.data, &keys.tweak, iv);
+    } else {
+        aesni_xts_decrypt(in, out, length, &keys.data, &keys.tweak, iv);
+    }
+#elif defined(__aarch64__)
+    uint64_t tweak[2];
+    aes_hw_encrypt(iv, reinterpret_cast<uint8_t*>(tweak), &keys.tweak);
+    for (size_t i = 0; i < length; i += AES_BLOCK_SIZE) {
+        uint64_t block[2];
+        memcpy(block, in + i, sizeof(block));
+        block[0] ^= tweak[0];
+        block[1] ^= tweak[1];
+        if (direction == Cipher::kEncrypt) {
+            aes_hw_encrypt(reinterpret_cast<uint8_t*>(block), reinterpret_cast<uint8_t*>(block),
+                           &keys.data);
+        } else {
+            aes_hw_decrypt(reinterpret_cast<uint8_t*>(block), reinterpret_cast<uint8_t*>(block),
+                           &keys.data);
+        }
+        block[0] ^= tweak[0];
+        block[1] ^= tweak[1];
+        memcpy(out + i, block, sizeof(block));
+        // Multiply the tweak by x in GF(2^128), per IEEE 1619.
+        uint64_t carry = tweak[1] >> 63;
+        tweak[1] = (tweak[1] << 1) | (tweak[0] >> 63);
+        tweak[0] = (tweak[0] << 1) ^ (carry * 0x87);
+    }
+#endif
+}
+
+} // namespace
 
 // The previously opaque crypto implementation context.  Guaranteed to clean up on destruction.
 struct Cipher::Context {
-    Context() { EVP_CIPHER_CTX_init(&impl); }
+    Context() : hw(false) { EVP_CIPHER_CTX_init(&impl); }
 
-    ~Context() { EVP_CIPHER_CTX_cleanup(&impl); }
+    ~Context() {
+        EVP_CIPHER_CTX_cleanup(&impl);
+        mandatory_memset(&hw_keys, 0, sizeof(hw_keys));
+    }
 
     EVP_CIPHER_CTX impl;
+    // Indicates random access XTS should bypass |impl| and use |hw_keys|.
+    bool hw;
+    HwXtsKeys hw_keys;
 };
 
 namespace {
@@ -166,6 +283,12 @@ zx_status_t Cipher::Init(Algorithm algo, Direction direction, const Bytes& key,
     direction_ = direction;
     block_size_ = cipher->block_size;
 
+    // In random access mode every data unit would otherwise re-initialize |impl| with its tweak;
+    // use the CPU's AES instructions directly when they are present.
+    if (algo == kAES256_XTS && alignment != 0 && HasHardwareAES()) {
+        ctx_->hw = HwXtsSetKeys(key.get(), key.len(), direction, &ctx_->hw_keys);
+    }
+
     cleanup.cancel();
     return ZX_OK;
 }
@@ -197,28 +320,41 @@ zx_status_t Cipher::Transform(const uint8_t* in, zx_off_t offset, size_t length,
             xprintf("unaligned offset\n");
             return ZX_ERR_INVALID_ARGS;
         }
-        if ((rc = tweaked_iv_.Copy(iv_)) != ZX_OK ||
-            (rc = tweaked_iv_.Increment(offset / alignment_)) != ZX_OK) {
+        if ((rc = TransformAt(in, offset, length, out)) != ZX_OK) {
             return rc;
         }
-        while (length > 0) {
-            if (EVP_CipherInit_ex(&ctx_->impl, nullptr, nullptr, nullptr, tweaked_iv_.get(), -1) <
-                0) {
-                xprintf_crypto_errors(&rc);
-                return rc;
-            }
-            size_t chunk_len = length < alignment_ ? length : alignment_;
-            int res;
-            if ((res = EVP_Cipher(&ctx_->impl, out, in, chunk_len)) <= 0) {
-                xprintf_crypto_errors(&rc);
-                return rc;
-            }
-            out += chunk_len;
-            in += chunk_len;
-            length -= chunk_len;
-            if ((rc = tweaked_iv_.Increment()) != ZX_OK) {
-                return rc;
-            }
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t Cipher::TransformBatch(const Sector* sectors, size_t num, Direction direction) {
+    zx_status_t rc;
+
+    if (!ctx_ || direction != direction_ || alignment_ == 0) {
+        xprintf("not initialized/wrong direction/not random access\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    if (num != 0 && !sectors) {
+        xprintf("bad args: sectors=%p, num=%zu\n", sectors, num);
+        return ZX_ERR_INVALID_ARGS;
+    }
+    for (size_t i = 0; i < num; ++i) {
+        const Sector& sector = sectors[i];
+        if (sector.length == 0) {
+            continue;
+        }
+        if (!sector.in || !sector.out || sector.length % block_size_ != 0 ||
+            sector.offset % alignment_ != 0) {
+            xprintf("bad sector %zu: in=%p, offset=%" PRIu64 ", length=%zu, out=%p\n", i,
+                    sector.in, sector.offset, sector.length, sector.out);
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+    for (size_t i = 0; i < num; ++i) {
+        const Sector& sector = sectors[i];
+        if ((rc = TransformAt(sector.in, sector.offset, sector.length, sector.out)) != ZX_OK) {
+            return rc;
         }
     }
 
@@ -235,4 +371,39 @@ void Cipher::Reset() {
     alignment_ = 0;
 }
 
+// Private methods
+
+zx_status_t Cipher::TransformAt(const uint8_t* in, zx_off_t offset, size_t length, uint8_t* out) {
+    zx_status_t rc;
+
+    if ((rc = tweaked_iv_.Copy(iv_)) != ZX_OK ||
+        (rc = tweaked_iv_.Increment(offset / alignment_)) != ZX_OK) {
+        return rc;
+    }
+    while (length > 0) {
+        size_t chunk_len = length < alignment_ ? length : alignment_;
+        if (ctx_->hw && chunk_len % AES_BLOCK_SIZE == 0) {
+            HwXtsTransform(ctx_->hw_keys, direction_, tweaked_iv_.get(), in, chunk_len, out);
+        } else {
+            if (EVP_CipherInit_ex(&ctx_->impl, nullptr, nullptr, nullptr, tweaked_iv_.get(),
+                                  -1) < 0) {
+                xprintf_crypto_errors(&rc);
+                return rc;
+            }
+            if (EVP_Cipher(&ctx_->impl, out, in, chunk_len) <= 0) {
+                xprintf_crypto_errors(&rc);
+                return rc;
+            }
+        }
+        out += chunk_len;
+        in += chunk_len;
+        length -= chunk_len;
+        if ((rc = tweaked_iv_.Increment()) != ZX_OK) {
+            return rc;
+        }
+    }
+
+    return ZX_OK;
+}
+
 } // namespace crypto
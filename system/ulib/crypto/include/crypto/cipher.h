@@ -100,12 +100,41 @@ public:
         return Transform(in, offset, length, out, kDecrypt);
     }
 
+    // A data unit of a random access cipher, transformed from |in| to |out| as if by |Transform|
+    // with the given |offset| and |length|.
+    struct Sector {
+        const uint8_t* in;
+        zx_off_t offset;
+        size_t length;
+        uint8_t* out;
+    };
+
+    // Encrypts or decrypts |num| independent |sectors| in one call, based on the given |direction|.
+    // The cipher must have been set up as a random access cipher.  The whole batch is validated as
+    // described in |Transform| before any sector is transformed, after which each sector's tweak
+    // is derived from its offset without any further per-call setup.
+    zx_status_t TransformBatch(const Sector* sectors, size_t num, Direction direction);
+
+    // Encrypts |num| |sectors|, as described above in |TransformBatch|.
+    zx_status_t EncryptBatch(const Sector* sectors, size_t num) {
+        return TransformBatch(sectors, num, kEncrypt);
+    }
+
+    // Decrypts |num| |sectors|, as described above in |TransformBatch|.
+    zx_status_t DecryptBatch(const Sector* sectors, size_t num) {
+        return TransformBatch(sectors, num, kDecrypt);
+    }
+
     // Clears all state from this instance.
     void Reset();
 
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Cipher);
 
+    // Transforms |length| bytes of data units starting at the |alignment_|-aligned |offset| in
+    // random access mode.  Arguments must already be validated.
+    zx_status_t TransformAt(const uint8_t* in, zx_off_t offset, size_t length, uint8_t* out);
+
     // Opaque crypto implementation context.
     struct Context;
 
@@ -16,6 +16,7 @@ __BEGIN_CDECLS;
  */
 
 typedef void (*zx_display_cb_t)(bool acquired, void* cookie);
+typedef void (*zx_display_flip_cb_t)(void* cookie);
 
 typedef struct display_protocol_ops {
     // sets the display mode
@@ -44,6 +45,29 @@ typedef struct display_protocol_ops {
     // The provided callback will be invoked with a value of true if the display
     // has been acquired, false if it has been released.
     void (*set_ownership_change_callback)(void* ctx, zx_display_cb_t callback, void* cookie);
+
+    // The following are optional, for displays which can scan out of client buffers.
+
+    // Makes a VMO holding an image with the framebuffer's mode available to
+    // flip(), and returns a handle to it in |image|.
+    zx_status_t (*import_vmo)(void* ctx, zx_handle_t vmo, void** image);
+
+    // Releases an image returned by import_vmo(). The image should not be on
+    // the screen, or in a pending flip.
+    void (*release_image)(void* ctx, void* image);
+
+    // Scans out |image|, or the display's own framebuffer if it is NULL, from
+    // the next vsync on. A flip which has not taken effect yet is replaced.
+    zx_status_t (*flip)(void* ctx, void* image);
+
+    // Registers a callback to be invoked when a flip takes effect. It may be
+    // invoked from an interrupt thread.
+    void (*set_flip_callback)(void* ctx, zx_display_flip_cb_t callback, void* cookie);
+
+    // Optional. Flushes only the given region of the framebuffer, for displays
+    // which copy what was drawn to where it is scanned out. flush() is used
+    // instead when this is NULL.
+    void (*flush_region)(void* ctx, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 } display_protocol_ops_t;
 
 typedef struct zx_display_protocol {
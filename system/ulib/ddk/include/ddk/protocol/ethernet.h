@@ -16,9 +16,15 @@ __BEGIN_CDECLS;
 // The ethermac interface supports both synchronous and asynchronous transmissions using the
 // proto->queue_tx() and ifc->complete_tx() methods.
 //
-// Receive operations are supported with the ifc->recv() interface.
-// TODO: implement netbuf-based receive operations by implementing proto->queue_rx() and
-// ifc->complete_rx()
+// Receive operations are supported with the ifc->recv() interface. Drivers which take several
+// frames off the device per interrupt should hand them up together with ifc->recv_batch(), and
+// complete transmissions together with ifc->complete_tx_batch(), so that the generic ethernet
+// driver wakes its clients once per batch rather than once per frame.
+//
+// Drivers may also receive straight into buffers of the generic ethernet driver's client, posted
+// with proto->queue_rx() and returned filled with ifc->complete_rx(). The generic ethernet driver
+// does so only while a single client is running, and frames handed to ifc->recv() are still
+// copied into the client's other buffers.
 //
 // The FEATURE_WLAN flag indicates a device that supports wlan operations.
 //
@@ -26,17 +32,38 @@ __BEGIN_CDECLS;
 //
 // The FEATURE_DMA flag indicates that the device can copy the buffer data using DMA and will ensure
 // that physical addresses are provided in netbufs.
-
-#define ETHMAC_FEATURE_WLAN     (1u)
-#define ETHMAC_FEATURE_SYNTH    (2u)
-#define ETHMAC_FEATURE_DMA      (4u)
+//
+// The FEATURE_MULTIQUEUE flag indicates a device with |queues| pairs of receive and transmit
+// queues, which steers received flows among its receive queues by hash and reports each frame
+// with ifc->recv_queue(). Transmissions name their queue with ETHMAC_TX_OPT_QUEUE(). Without
+// it the generic ethernet driver steers frames from ifc->recv() among queues of its own.
+//
+// The FEATURE_RX_QUEUE flag indicates a device which implements proto->queue_rx() and
+// proto->flush_rx(). It requires FEATURE_DMA.
+//
+// The FEATURE_TX_CSUM and FEATURE_TSO flags indicate a device which acts on the offload of
+// netbufs passed to proto->queue_tx(), as eth_offload_t is described in
+// zircon/device/ethernet.h. Frames of up to |tso_max| bytes are sent with ETH_OFFLOAD_TSO4/6.
+// The FEATURE_RX_CSUM flag indicates a device which flags received frames whose transport
+// checksums it verified with ETHMAC_RX_CSUM_OK.
+
+#define ETHMAC_FEATURE_WLAN       (1u)
+#define ETHMAC_FEATURE_SYNTH      (2u)
+#define ETHMAC_FEATURE_DMA        (4u)
+#define ETHMAC_FEATURE_MULTIQUEUE (8u)
+#define ETHMAC_FEATURE_RX_QUEUE   (16u)
+#define ETHMAC_FEATURE_TX_CSUM    (32u)
+#define ETHMAC_FEATURE_RX_CSUM    (64u)
+#define ETHMAC_FEATURE_TSO        (128u)
 
 typedef struct ethmac_info {
     uint32_t features;
     uint32_t mtu;
     uint8_t mac[ETH_MAC_SIZE];
     uint8_t reserved0[2];
-    uint32_t reserved1[4];
+    uint32_t queues;  // Only used if ETHMAC_FEATURE_MULTIQUEUE is set
+    uint32_t tso_max;  // Only used if ETHMAC_FEATURE_TSO is set
+    uint32_t reserved1[2];
 } ethmac_info_t;
 
 typedef struct ethmac_netbuf {
@@ -45,7 +72,9 @@ typedef struct ethmac_netbuf {
     zx_paddr_t phys;  // Only used if ETHMAC_FEATURE_DMA is available
     uint16_t len;
     uint16_t reserved;
-    uint32_t flags;
+    uint32_t flags;  // ETHMAC_RX_ flags, for netbufs passed to complete_rx()
+    // Zero unless the device has ETHMAC_FEATURE_TX_CSUM or ETHMAC_FEATURE_TSO
+    eth_offload_t offload;
 
     // Shared between the generic ethernet and ethmac drivers
     list_node_t node;
@@ -57,6 +86,15 @@ typedef struct ethmac_netbuf {
     };
 } ethmac_netbuf_t;
 
+// Flags of received frames
+#define ETHMAC_RX_CSUM_OK (1u)
+
+typedef struct ethmac_rx_frame {
+    void* data;
+    size_t length;
+    uint32_t flags;
+} ethmac_rx_frame_t;
+
 typedef struct ethmac_ifc_virt {
     void (*status)(void* cookie, uint32_t status);
 
@@ -64,12 +102,35 @@ typedef struct ethmac_ifc_virt {
 
     // complete_tx() is called to return ownership of a netbuf to the generic ethernet driver.
     void (*complete_tx)(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t status);
+
+    // recv_queue() is recv() for devices with ETHMAC_FEATURE_MULTIQUEUE, naming the receive
+    // queue the frame arrived on. It may be called for different queues simultaneously, from
+    // a thread (or interrupt) per queue.
+    void (*recv_queue)(void* cookie, uint32_t queue, void* data, size_t length, uint32_t flags);
+
+    // recv_batch() is recv(), or recv_queue() on |queue|, for |count| frames at once. The
+    // frames need only remain valid until it returns.
+    void (*recv_batch)(void* cookie, uint32_t queue, const ethmac_rx_frame_t* frames,
+                       size_t count);
+
+    // complete_tx_batch() is complete_tx() for |count| netbufs which finished with |status|.
+    void (*complete_tx_batch)(void* cookie, ethmac_netbuf_t** netbufs, size_t count,
+                              zx_status_t status);
+
+    // complete_rx() returns ownership of a netbuf posted with queue_rx(). On ZX_OK a frame of
+    // netbuf->len bytes was received into it; on ZX_ERR_CANCELED it is returned unused.
+    void (*complete_rx)(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t status);
 } ethmac_ifc_t;
 
 // Indicates that additional data is available to be sent after this call finishes. Allows a ethmac
 // driver to batch tx to hardware if possible.
 #define ETHMAC_TX_OPT_MORE (1u)
 
+// The transmit queue a packet is for, on devices with ETHMAC_FEATURE_MULTIQUEUE.
+#define ETHMAC_TX_OPT_QUEUE_SHIFT 16
+#define ETHMAC_TX_OPT_QUEUE(q) ((uint32_t)(q) << ETHMAC_TX_OPT_QUEUE_SHIFT)
+#define ETHMAC_TX_OPT_GET_QUEUE(opts) ((opts) >> ETHMAC_TX_OPT_QUEUE_SHIFT)
+
 // SETPARAM_ values identify the parameter to set. Each call to set_param()
 // takes an int32_t |value| and void* |data| which have meaning specific to
 // the parameter being set.
@@ -129,6 +190,19 @@ typedef struct ethmac_protocol_ops {
     // set_param() may be called at any time after start() is called including from multiple threads
     // simultaneously.
     zx_status_t (*set_param)(void* ctx, uint32_t param, int32_t value, void* data);
+
+    // Post the buffer in netbuf, of netbuf->len bytes at netbuf->phys, for a frame to be received
+    // into. On ZX_OK the driver takes ownership of the netbuf and must return it with
+    // complete_rx(), which MUST NOT be called from within the queue_rx() implementation. Buffers
+    // too small for any frame the device may receive are refused with ZX_ERR_INVALID_ARGS.
+    //
+    // queue_rx() may be called at any time after start() is called, from a thread other than
+    // the one making other calls.
+    zx_status_t (*queue_rx)(void* ctx, ethmac_netbuf_t* netbuf);
+
+    // Return every netbuf posted with queue_rx() and not yet completed, with complete_rx() and
+    // ZX_ERR_CANCELED, before returning.
+    void (*flush_rx)(void* ctx);
 } ethmac_protocol_ops_t;
 
 typedef struct ethmac_protocol {
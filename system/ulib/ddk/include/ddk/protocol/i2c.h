@@ -18,6 +18,17 @@ __BEGIN_CDECLS;
 typedef void (*i2c_complete_cb)(zx_status_t status, const uint8_t* data, size_t actual,
                                 void* cookie);
 
+// Segment types for i2c_transact_segments()
+#define I2C_SEGMENT_WRITE 0u
+#define I2C_SEGMENT_READ  1u
+
+// One segment of an i2c_transact_segments() transaction
+typedef struct {
+    uint32_t type;          // I2C_SEGMENT_WRITE or I2C_SEGMENT_READ
+    uint32_t length;
+    const void* write_buf;  // data for writes, ignored for reads
+} i2c_segment_t;
+
 // Protocol for an i2c channel
 typedef struct {
     zx_status_t (*transact)(void* ctx, const void* write_buf, size_t write_length,
@@ -25,6 +36,9 @@ typedef struct {
     zx_status_t (*set_bitrate)(void* ctx, uint32_t bitrate);
     zx_status_t (*get_max_transfer_size)(void* ctx, size_t* out_size);
     void (*channel_release)(void* ctx);
+    // optional, see i2c_transact_segments()
+    zx_status_t (*transact_segments)(void* ctx, const i2c_segment_t* segments, size_t count,
+                                     i2c_complete_cb complete_cb, void* cookie);
 } i2c_channel_ops_t;
 
 typedef struct {
@@ -46,6 +60,20 @@ static inline zx_status_t i2c_transact(i2c_channel_t* channel, const void* write
                                   cookie);
 }
 
+// Performs several segments as one transaction, with a repeated start rather
+// than a stop between segments, so that no other traffic occurs on the bus
+// until the last one is done. The write data is copied before this returns.
+// The data of all the read segments is returned back to back via complete_cb.
+// Returns ZX_ERR_NOT_SUPPORTED if the channel cannot do this.
+static inline zx_status_t i2c_transact_segments(i2c_channel_t* channel,
+                                                const i2c_segment_t* segments, size_t count,
+                                                i2c_complete_cb complete_cb, void* cookie) {
+    if (!channel->ops->transact_segments) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    return channel->ops->transact_segments(channel->ctx, segments, count, complete_cb, cookie);
+}
+
 // Sets the bitrate for the i2c channel
 static inline zx_status_t i2c_set_bitrate(i2c_channel_t* channel, uint32_t bitrate) {
     return channel->ops->set_bitrate(channel->ctx, bitrate);
@@ -131,7 +131,9 @@ zx_status_t usb_request_cache_flush(usb_request_t* req, zx_off_t offset, size_t
 // in the request's buffer
 zx_status_t usb_request_cache_flush_invalidate(usb_request_t* req, zx_off_t offset, size_t length);
 
-// Looks up the physical pages backing this request's vm object.
+// Looks up the physical pages backing the request's header.length bytes at the
+// buffer's vmo offset. The lookup is kept, and only redone if the request is later
+// used for a longer transfer.
 zx_status_t usb_request_physmap(usb_request_t* req);
 
 // usb_request_release() frees the message data -- should be called only by the entity that allocated it
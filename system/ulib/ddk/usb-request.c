@@ -2,9 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <ddk/driver.h>
 #include <ddk/protocol/usb.h>
 #include <ddk/usb-request.h>
 #include <zircon/syscalls.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -104,7 +106,34 @@ zx_status_t usb_request_cache_flush_invalidate(usb_request_t* req, zx_off_t offs
 }
 
 zx_status_t usb_request_physmap(usb_request_t* req) {
-    return io_buffer_physmap(&req->buffer);
+    io_buffer_t* buffer = &req->buffer;
+    if (req->header.length == 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // Only the pages the transfer touches are looked up. A request made for a
+    // client's VMO would otherwise look up every page from its offset to the
+    // end of the VMO, on every transfer.
+    uint64_t page_offset = ROUNDDOWN(buffer->offset, PAGE_SIZE);
+    uint64_t page_length = ROUNDUP(buffer->offset + req->header.length, PAGE_SIZE) - page_offset;
+    uint64_t pages = page_length / PAGE_SIZE;
+    if (buffer->phys_count >= pages) {
+        return ZX_OK;
+    }
+
+    zx_paddr_t* paddrs = malloc(pages * sizeof(zx_paddr_t));
+    if (paddrs == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status = io_buffer_physmap_range(buffer, page_offset, page_length, pages, paddrs);
+    if (status != ZX_OK) {
+        free(paddrs);
+        return status;
+    }
+    free(buffer->phys_list);
+    buffer->phys_list = paddrs;
+    buffer->phys_count = pages;
+    return ZX_OK;
 }
 
 void usb_request_release(usb_request_t* req) {
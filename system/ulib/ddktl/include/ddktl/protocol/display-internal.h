@@ -21,6 +21,10 @@ DECLARE_HAS_MEMBER_FN(has_get_framebuffer, GetFramebuffer);
 DECLARE_HAS_MEMBER_FN(has_flush, Flush);
 DECLARE_HAS_MEMBER_FN(has_acquire_or_release_display, AcquireOrReleaseDisplay);
 DECLARE_HAS_MEMBER_FN(has_set_ownership_change_callback, SetOwnershipChangeCallback);
+DECLARE_HAS_MEMBER_FN(has_import_vmo, ImportVmo);
+DECLARE_HAS_MEMBER_FN(has_release_image, ReleaseImage);
+DECLARE_HAS_MEMBER_FN(has_flip, Flip);
+DECLARE_HAS_MEMBER_FN(has_set_flip_callback, SetFlipCallback);
 
 template <typename D>
 constexpr void CheckDisplayProtocolSubclass() {
@@ -56,6 +60,38 @@ constexpr void CheckDisplayProtocolSubclass() {
                   "'void Flush()', and be visible to "
                   "ddk::DisplayProtocol<D> (either because they are public, or because of "
                   "friendship).");
+    static_assert(internal::has_import_vmo<D>::value,
+                  "DisplayProtocol subclasses must implement ImportVmo");
+    static_assert(fbl::is_same<decltype(&D::ImportVmo),
+                                zx_status_t (D::*)(zx_handle_t, void**)>::value,
+                  "ImportVmo must be a non-static member function with signature "
+                  "'zx_status_t ImportVmo(zx_handle_t vmo, void** image)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_release_image<D>::value,
+                  "DisplayProtocol subclasses must implement ReleaseImage");
+    static_assert(fbl::is_same<decltype(&D::ReleaseImage),
+                                void (D::*)(void*)>::value,
+                  "ReleaseImage must be a non-static member function with signature "
+                  "'void ReleaseImage(void* image)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_flip<D>::value,
+                  "DisplayProtocol subclasses must implement Flip");
+    static_assert(fbl::is_same<decltype(&D::Flip),
+                                zx_status_t (D::*)(void*)>::value,
+                  "Flip must be a non-static member function with signature "
+                  "'zx_status_t Flip(void* image)', and be visible to "
+                  "ddk::DisplayProtocol<D> (either because they are public, or because of "
+                  "friendship).");
+    static_assert(internal::has_set_flip_callback<D>::value,
+                  "DisplayProtocol subclasses must implement SetFlipCallback");
+    static_assert(fbl::is_same<decltype(&D::SetFlipCallback),
+                                void (D::*)(zx_display_flip_cb_t, void*)>::value,
+                  "SetFlipCallback must be a non-static member function with signature "
+                  "'void SetFlipCallback(zx_display_flip_cb_t callback, void* cookie)', and be "
+                  "visible to ddk::DisplayProtocol<D> (either because they are public, or "
+                  "because of friendship).");
 }
 
 }  // namespace internal
@@ -20,6 +20,10 @@ class DisplayProtocol : public internal::base_protocol {
         ops_.get_mode = GetMode;
         ops_.get_framebuffer = GetFramebuffer;
         ops_.flush = FlushThunk;
+        ops_.import_vmo = ImportVmo;
+        ops_.release_image = ReleaseImage;
+        ops_.flip = Flip;
+        ops_.set_flip_callback = SetFlipCallback;
 
         // Can only inherit from one base_protocol implemenation
         ZX_ASSERT(ddk_proto_id_ == 0);
@@ -44,6 +48,22 @@ class DisplayProtocol : public internal::base_protocol {
         static_cast<D*>(ctx)->Flush();
     }
 
+    static zx_status_t ImportVmo(void* ctx, zx_handle_t vmo, void** image) {
+        return static_cast<D*>(ctx)->ImportVmo(vmo, image);
+    }
+
+    static void ReleaseImage(void* ctx, void* image) {
+        static_cast<D*>(ctx)->ReleaseImage(image);
+    }
+
+    static zx_status_t Flip(void* ctx, void* image) {
+        return static_cast<D*>(ctx)->Flip(image);
+    }
+
+    static void SetFlipCallback(void* ctx, zx_display_flip_cb_t callback, void* cookie) {
+        static_cast<D*>(ctx)->SetFlipCallback(callback, cookie);
+    }
+
     display_protocol_ops_t ops_ = {};
 };
 
@@ -15,6 +15,8 @@
 #include <zircon/assert.h>
 #include <zircon/errors.h>
 
+#include "sha256-hw.h"
+
 namespace digest {
 
 // The previously opaque crypto implementation context.
@@ -42,10 +44,14 @@ Digest& Digest::operator=(const uint8_t* rhs) {
 
 zx_status_t Digest::Init() {
     ZX_DEBUG_ASSERT(ref_count_ == 0);
-    fbl::AllocChecker ac;
-    ctx_.reset(new (&ac) Context());
-    if (!ac.check()) {
-        return ZX_ERR_NO_MEMORY;
+    // The context is reused when a Digest hashes many things in turn, as when
+    // building a Merkle tree.
+    if (!ctx_) {
+        fbl::AllocChecker ac;
+        ctx_.reset(new (&ac) Context());
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
     }
     SHA256_Init(&ctx_->impl);
     return ZX_OK;
@@ -54,7 +60,39 @@ zx_status_t Digest::Init() {
 void Digest::Update(const void* buf, size_t len) {
     ZX_DEBUG_ASSERT(ref_count_ == 0);
     ZX_DEBUG_ASSERT(len <= INT_MAX);
-    SHA256_Update(&ctx_->impl, buf, len);
+    static const internal::Sha256BlocksFn blocks = internal::GetSha256Blocks();
+    SHA256_CTX* impl = &ctx_->impl;
+    if (blocks == nullptr || len < SHA256_CBLOCK) {
+        SHA256_Update(impl, buf, len);
+        return;
+    }
+
+    // Let BoringSSL complete any partially buffered block, hash the whole
+    // blocks with the CPU's SHA-256 instructions, and buffer what remains.
+    const uint8_t* in = static_cast<const uint8_t*>(buf);
+    if (impl->num != 0) {
+        size_t fill = SHA256_CBLOCK - impl->num;
+        SHA256_Update(impl, in, fill);
+        in += fill;
+        len -= fill;
+    }
+    size_t n = len / SHA256_CBLOCK;
+    if (n != 0) {
+        blocks(impl->h, in, n);
+        // Count the hashed bits the same way SHA256_Update does.
+        size_t bytes = n * SHA256_CBLOCK;
+        uint32_t nl = impl->Nl + static_cast<uint32_t>(bytes << 3);
+        if (nl < impl->Nl) {
+            impl->Nh++;
+        }
+        impl->Nh += static_cast<uint32_t>(bytes >> 29);
+        impl->Nl = nl;
+        in += bytes;
+        len -= bytes;
+    }
+    if (len != 0) {
+        SHA256_Update(impl, in, len);
+    }
 }
 
 const uint8_t* Digest::Final() {
@@ -107,6 +107,11 @@ private:
                                    const void* tree, size_t offset,
                                    size_t length, uint64_t level);
 
+    // Implements Create for more than one node of data by hashing the tree a
+    // whole level at a time, rather than a node at a time.
+    static zx_status_t CreateByLevel(const void* data, size_t data_len, void* tree,
+                                     size_t tree_len, Digest* root);
+
     // See CreateFinal.  This implements that method, with an extra parameter to
     // allow levels other than the bottommost to be padded.
     zx_status_t CreateFinalInternal(const void* data, void* tree, Digest* root);
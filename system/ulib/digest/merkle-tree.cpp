@@ -14,6 +14,11 @@
 #include <zircon/assert.h>
 #include <zircon/errors.h>
 
+#ifdef __Fuchsia__
+#include <threads.h>
+#include <zircon/syscalls.h>
+#endif
+
 namespace digest {
 
 // Size of a node in bytes.  Defined in tree.h.
@@ -94,6 +99,93 @@ size_t NextAligned(size_t length) {
     return fbl::round_up(NextLength(length), MerkleTree::kNodeSize);
 }
 
+////////
+// Helper functions for building a tree a whole level at a time.
+
+// Hashes the nodes [start, end) of the |length| bytes of |level| at |in|,
+// writing their digests to |out|.
+zx_status_t HashNodes(const uint8_t* in, size_t length, uint64_t level, size_t start, size_t end,
+                      uint8_t* out) {
+    zx_status_t rc;
+    Digest digest;
+    for (size_t i = start; i < end; ++i) {
+        size_t offset = i * MerkleTree::kNodeSize;
+        if ((rc = DigestInit(&digest, offset | level, length - offset)) != ZX_OK) {
+            return rc;
+        }
+        offset += DigestUpdate(&digest, in + offset, offset, length - offset);
+        DigestFinal(&digest, offset);
+        digest.CopyTo(out + i * Digest::kLength, Digest::kLength);
+    }
+    return ZX_OK;
+}
+
+#ifdef __Fuchsia__
+
+// Levels with fewer nodes than this per thread are hashed on one thread, as
+// starting a thread would cost more than it saves.
+constexpr size_t kMinNodesPerThread = 32;
+constexpr uint32_t kMaxHashThreads = 8;
+
+struct HashNodesArgs {
+    const uint8_t* in;
+    size_t length;
+    uint64_t level;
+    size_t start;
+    size_t end;
+    uint8_t* out;
+    zx_status_t rc;
+};
+
+int HashNodesThread(void* arg) {
+    HashNodesArgs* args = static_cast<HashNodesArgs*>(arg);
+    args->rc = HashNodes(args->in, args->length, args->level, args->start, args->end,
+                         args->out);
+    return 0;
+}
+
+#endif
+
+// Hashes all the nodes of a level, splitting them across threads when the
+// level is large enough.
+zx_status_t HashLevel(const uint8_t* in, size_t length, uint64_t level, uint8_t* out) {
+    size_t nodes = fbl::round_up(length, MerkleTree::kNodeSize) / MerkleTree::kNodeSize;
+#ifdef __Fuchsia__
+    size_t num_threads = fbl::min(nodes / kMinNodesPerThread,
+                                  static_cast<size_t>(fbl::min(zx_system_get_num_cpus(),
+                                                               kMaxHashThreads)));
+    if (num_threads > 1) {
+        HashNodesArgs args[kMaxHashThreads];
+        thrd_t threads[kMaxHashThreads];
+        bool started[kMaxHashThreads] = {};
+        size_t per_thread = fbl::round_up(nodes, num_threads) / num_threads;
+        for (size_t t = 0; t < num_threads; ++t) {
+            args[t] = {in, length, level, t * per_thread,
+                       fbl::min((t + 1) * per_thread, nodes), out, ZX_OK};
+        }
+        // The first share is hashed on this thread. If a thread can't be
+        // started, its share is hashed here too.
+        for (size_t t = 1; t < num_threads; ++t) {
+            started[t] = thrd_create(&threads[t], HashNodesThread, &args[t]) == thrd_success;
+        }
+        HashNodesThread(&args[0]);
+        zx_status_t rc = args[0].rc;
+        for (size_t t = 1; t < num_threads; ++t) {
+            if (started[t]) {
+                thrd_join(threads[t], nullptr);
+            } else {
+                HashNodesThread(&args[t]);
+            }
+            if (rc == ZX_OK) {
+                rc = args[t].rc;
+            }
+        }
+        return rc;
+    }
+#endif
+    return HashNodes(in, length, level, 0, nodes, out);
+}
+
 } // namespace
 
 ////////
@@ -107,6 +199,11 @@ size_t MerkleTree::GetTreeLength(size_t data_len) {
 zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, size_t tree_len,
                                Digest* digest) {
     zx_status_t rc;
+    // With all the data at hand, the tree can be built a level at a time,
+    // hashing the nodes of each level in parallel.
+    if (data_len > kNodeSize) {
+        return CreateByLevel(data, data_len, tree, tree_len, digest);
+    }
     MerkleTree mt;
     if ((rc = mt.CreateInit(data_len, tree_len)) != ZX_OK ||
         (rc = mt.CreateUpdate(data, data_len, tree)) != ZX_OK ||
@@ -116,6 +213,43 @@ zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, si
     return ZX_OK;
 }
 
+zx_status_t MerkleTree::CreateByLevel(const void* data, size_t data_len, void* tree,
+                                      size_t tree_len, Digest* root) {
+    zx_status_t rc;
+    if (tree_len < GetTreeLength(data_len)) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    if (!data || !tree || !root) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    uint8_t* out = static_cast<uint8_t*>(tree);
+    size_t length = data_len;
+    uint64_t level = 0;
+    while (length > kNodeSize) {
+        // Zero the padding after the last digest of the level.
+        size_t next_len = NextLength(length);
+        size_t next_aligned = NextAligned(length);
+        memset(out + next_len, 0, next_aligned - next_len);
+        if ((rc = HashLevel(in, length, level, out)) != ZX_OK) {
+            return rc;
+        }
+        in = out;
+        out += next_aligned;
+        length = next_aligned;
+        ++level;
+    }
+    Digest digest;
+    if ((rc = DigestInit(&digest, level, length)) != ZX_OK) {
+        return rc;
+    }
+    DigestUpdate(&digest, in, 0, length);
+    DigestFinal(&digest, length);
+    *root = digest.AcquireBytes();
+    digest.ReleaseBytes();
+    return ZX_OK;
+}
+
 MerkleTree::MerkleTree() : initialized_(false), next_(nullptr), level_(0), offset_(0), length_(0) {}
 
 MerkleTree::~MerkleTree() {}
@@ -10,10 +10,18 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/digest.cpp \
-    $(LOCAL_DIR)/merkle-tree.cpp
+    $(LOCAL_DIR)/merkle-tree.cpp \
+    $(LOCAL_DIR)/sha256-hw.cpp
 
 MODULE_SO_NAME := digest
-MODULE_LIBS := system/ulib/c
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/zircon \
+
+# Allow the ARMv8 SHA-256 instructions; they are only used if the CPU has them.
+ifeq ($(ARCH),arm64)
+MODULE_COMPILEFLAGS += -mcpu=cortex-a53+crypto
+endif
 
 MODULE_STATIC_LIBS := \
     third_party/ulib/uboringssl \
@@ -33,7 +41,8 @@ MODULE_COMPILEFLAGS := \
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/digest.cpp \
-    $(LOCAL_DIR)/merkle-tree.cpp
+    $(LOCAL_DIR)/merkle-tree.cpp \
+    $(LOCAL_DIR)/sha256-hw.cpp
 
 MODULE_HOST_LIBS := \
     third_party/ulib/uboringssl.hostlib \
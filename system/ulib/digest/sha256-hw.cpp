@@ -0,0 +1,163 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "sha256-hw.h"
+
+#if defined(__x86_64__)
+#define SHA256_HW_X86 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO) && \
+    (defined(__Fuchsia__) || defined(__linux__))
+#define SHA256_HW_ARM64 1
+#endif
+
+#if SHA256_HW_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#elif SHA256_HW_ARM64
+#include <arm_neon.h>
+#ifdef __Fuchsia__
+#include <zircon/features.h>
+#include <zircon/syscalls.h>
+#else
+#include <sys/auxv.h>
+#endif
+#endif
+
+namespace digest {
+namespace internal {
+namespace {
+
+#if SHA256_HW_X86 || SHA256_HW_ARM64
+
+// SHA-256 round constants.
+alignas(16) constexpr uint32_t kK[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#endif
+
+#if SHA256_HW_X86
+
+// The message schedule is kept as four vectors of four words; each group of
+// four rounds replaces the oldest vector with the next four words.
+__attribute__((target("sha,sse4.1")))
+void Sha256BlocksShaNi(uint32_t state[8], const uint8_t* data, size_t num) {
+    const __m128i kByteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The SHA instructions want the state as ABEF and CDGH.
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<__m128i*>(&state[0])), 0xB1);
+    __m128i cdgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<__m128i*>(&state[4])), 0x1B);
+    __m128i abef = _mm_alignr_epi8(tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+    for (; num > 0; --num, data += 64) {
+        const __m128i abef_save = abef;
+        const __m128i cdgh_save = cdgh;
+        __m128i w[4];
+        for (int i = 0; i < 4; ++i) {
+            w[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i)), kByteSwap);
+        }
+        for (int i = 0; i < 16; ++i) {
+            if (i >= 4) {
+                __m128i x = _mm_sha256msg1_epu32(w[i % 4], w[(i + 1) % 4]);
+                x = _mm_add_epi32(x, _mm_alignr_epi8(w[(i + 3) % 4], w[(i + 2) % 4], 4));
+                w[i % 4] = _mm_sha256msg2_epu32(x, w[(i + 3) % 4]);
+            }
+            __m128i wk = _mm_add_epi32(w[i % 4],
+                                       _mm_load_si128(reinterpret_cast<const __m128i*>(&kK[4 * i])));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E));
+        }
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(abef, 0x1B);
+    cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), _mm_blend_epi16(tmp, cdgh, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+bool HasShaNi() {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1) || !(ecx & bit_SSSE3)) {
+        return false;
+    }
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return ebx & (1u << 29);
+}
+
+#elif SHA256_HW_ARM64
+
+void Sha256BlocksArmv8(uint32_t state[8], const uint8_t* data, size_t num) {
+    uint32x4_t abcd = vld1q_u32(&state[0]);
+    uint32x4_t efgh = vld1q_u32(&state[4]);
+
+    for (; num > 0; --num, data += 64) {
+        const uint32x4_t abcd_save = abcd;
+        const uint32x4_t efgh_save = efgh;
+        uint32x4_t w[4];
+        for (int i = 0; i < 4; ++i) {
+            w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+        }
+        for (int i = 0; i < 16; ++i) {
+            if (i >= 4) {
+                w[i % 4] = vsha256su1q_u32(vsha256su0q_u32(w[i % 4], w[(i + 1) % 4]),
+                                           w[(i + 2) % 4], w[(i + 3) % 4]);
+            }
+            const uint32x4_t wk = vaddq_u32(w[i % 4], vld1q_u32(&kK[4 * i]));
+            const uint32x4_t abcd_prev = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, wk);
+            efgh = vsha256h2q_u32(efgh, abcd_prev, wk);
+        }
+        abcd = vaddq_u32(abcd, abcd_save);
+        efgh = vaddq_u32(efgh, efgh_save);
+    }
+
+    vst1q_u32(&state[0], abcd);
+    vst1q_u32(&state[4], efgh);
+}
+
+bool HasArmv8Sha2() {
+#ifdef __Fuchsia__
+    uint32_t features;
+    return zx_system_get_features(ZX_FEATURE_KIND_CPU, &features) == ZX_OK &&
+           (features & ZX_ARM64_FEATURE_ISA_SHA2);
+#else
+    return getauxval(AT_HWCAP) & HWCAP_SHA2;
+#endif
+}
+
+#endif
+
+Sha256BlocksFn Detect() {
+#if SHA256_HW_X86
+    return HasShaNi() ? Sha256BlocksShaNi : nullptr;
+#elif SHA256_HW_ARM64
+    return HasArmv8Sha2() ? Sha256BlocksArmv8 : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+} // namespace
+
+Sha256BlocksFn GetSha256Blocks() {
+    static const Sha256BlocksFn blocks = Detect();
+    return blocks;
+}
+
+} // namespace internal
+} // namespace digest
@@ -0,0 +1,24 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace digest {
+namespace internal {
+
+// Processes |num| whole 64-byte blocks of |data| into the SHA-256 |state|,
+// using the CPU's SHA-256 instructions.
+using Sha256BlocksFn = void (*)(uint32_t state[8], const uint8_t* data, size_t num);
+
+// Returns the SHA-256 block function accelerated for this CPU, or null if the
+// CPU has no SHA-256 instructions (or they are not supported in this build).
+// On x86-64 these are the SHA extensions; on arm64, the ARMv8 crypto
+// extensions.
+Sha256BlocksFn GetSha256Blocks();
+
+} // namespace internal
+} // namespace digest
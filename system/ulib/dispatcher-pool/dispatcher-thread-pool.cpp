@@ -4,11 +4,13 @@
 
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/port.h>
+#include <zircon/threads.h>
 #include <stdio.h>
 #include <string.h>
 
 #include <dispatcher-pool/dispatcher-execution-domain.h>
 #include <dispatcher-pool/dispatcher-thread-pool.h>
+#include <fbl/algorithm.h>
 
 #include "debug-logging.h"
 
@@ -20,6 +22,8 @@ bool ThreadPool::system_shutdown_ = false;
 
 static constexpr uint32_t MAX_THREAD_PRIORITY = 31;
 
+constexpr zx_duration_t ThreadPool::kIdleRetireTimeout;
+
 // static
 zx_status_t ThreadPool::Get(fbl::RefPtr<ThreadPool>* pool_out, uint32_t priority) {
     if ((pool_out == nullptr) || (priority > MAX_THREAD_PRIORITY))
@@ -104,23 +108,9 @@ zx_status_t ThreadPool::AddDomainToPool(fbl::RefPtr<ExecutionDomain> domain) {
     active_domains_.push_back(fbl::move(domain));
     ++active_domain_count_;
 
-    while ((active_thread_count_ < active_domain_count_) &&
-           (active_thread_count_ < zx_system_get_num_cpus())) {
-        auto thread = Thread::Create(fbl::WrapRefPtr(this), active_thread_count_);
-        if (thread == nullptr) {
-            LOG("Failed to create new thread\n");
-            break;
-        }
-
-        active_threads_.push_front(fbl::move(thread));
-        if (active_threads_.front().Start() != ZX_OK) {
-            LOG("Failed to start new thread\n");
-            thread = active_threads_.pop_front();
-            break;
-        }
-
-        active_thread_count_++;
-    }
+    // Start with a single thread; the rest are added as the load demands.
+    if (active_thread_count_.load() == 0)
+        StartThreadLocked();
 
     return ZX_OK;
 }
@@ -128,7 +118,46 @@ zx_status_t ThreadPool::AddDomainToPool(fbl::RefPtr<ExecutionDomain> domain) {
 void ThreadPool::RemoveDomainFromPool(ExecutionDomain* domain) {
     ZX_DEBUG_ASSERT(domain != nullptr);
     fbl::AutoLock pool_lock(&pool_lock_);
+
+    // Once shutdown has begun, the domains have already been taken off of our
+    // list by InternalShutdown.
+    if (pool_shutting_down_)
+        return;
+
     active_domains_.erase(*domain);
+    --active_domain_count_;
+}
+
+zx_status_t ThreadPool::SetCpuAffinity(uint64_t cpu_mask) {
+    if (cpu_mask == 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AutoLock pool_lock(&pool_lock_);
+
+    if (pool_shutting_down_)
+        return ZX_ERR_BAD_STATE;
+
+    for (auto& thread : active_threads_) {
+        zx_status_t res = thread.SetAffinity(cpu_mask);
+        if (res != ZX_OK) {
+            LOG("Failed to set thread affinity to %#" PRIx64 " (res %d)\n", cpu_mask, res);
+            return res;
+        }
+    }
+
+    cpu_mask_ = cpu_mask;
+    return ZX_OK;
+}
+
+void ThreadPool::GetStats(Stats* out) const {
+    ZX_DEBUG_ASSERT(out != nullptr);
+    out->thread_count = active_thread_count_.load();
+    out->peak_thread_count = peak_thread_count_.load();
+    out->threads_started = threads_started_.load();
+    out->threads_retired = threads_retired_.load();
+    out->packets_dispatched = packets_dispatched_.load();
+    out->busy_time = busy_time_.load();
+    out->idle_time = idle_time_.load();
 }
 
 zx_status_t ThreadPool::WaitOnPort(const zx::handle& handle,
@@ -174,6 +203,84 @@ zx_status_t ThreadPool::Init() {
     return ZX_OK;
 }
 
+uint32_t ThreadPool::MaxThreadsLocked() const {
+    // Each domain dispatches on at most one thread at a time, so threads
+    // beyond the number of domains would never have anything to do.
+    return fbl::min(active_domain_count_, zx_system_get_num_cpus());
+}
+
+zx_status_t ThreadPool::StartThreadLocked() {
+    auto thread = Thread::Create(fbl::WrapRefPtr(this), next_thread_id_++);
+    if (thread == nullptr) {
+        LOG("Failed to create new thread\n");
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // The new thread counts as idle from the start, so that threads which see
+    // a backlog while it spins up do not each start another.
+    idle_thread_count_.fetch_add(1);
+    active_threads_.push_front(fbl::move(thread));
+    zx_status_t res = active_threads_.front().Start();
+    if (res != ZX_OK) {
+        LOG("Failed to start new thread\n");
+        idle_thread_count_.fetch_sub(1);
+        thread = active_threads_.pop_front();
+        return res;
+    }
+
+    if (cpu_mask_ != 0) {
+        __UNUSED zx_status_t affinity_res = active_threads_.front().SetAffinity(cpu_mask_);
+        ZX_DEBUG_ASSERT(affinity_res == ZX_OK);
+    }
+
+    uint32_t count = active_thread_count_.load() + 1;
+    active_thread_count_.store(count);
+    if (count > peak_thread_count_.load())
+        peak_thread_count_.store(count);
+    threads_started_.fetch_add(1);
+
+    DEBUG_LOG("Started thread, %u now active\n", count);
+    return ZX_OK;
+}
+
+void ThreadPool::MaybeGrow() {
+    fbl::AutoLock pool_lock(&pool_lock_);
+
+    if (pool_shutting_down_ || (active_thread_count_.load() >= MaxThreadsLocked()))
+        return;
+
+    StartThreadLocked();
+}
+
+bool ThreadPool::MaybeRetire(Thread* thread) {
+    fbl::unique_ptr<Thread> predecessor;
+    {
+        fbl::AutoLock pool_lock(&pool_lock_);
+
+        // The last thread never retires.  Nor does any thread once shutdown
+        // has begun, each is owed one of the quit messages.
+        if (pool_shutting_down_ || (active_thread_count_.load() <= 1))
+            return false;
+
+        // Each retiring thread joins the one which retired before it, so at
+        // most one is ever left waiting to be joined.
+        if (!retired_threads_.is_empty())
+            predecessor = retired_threads_.pop_front();
+
+        retired_threads_.push_back(active_threads_.erase(*thread));
+        uint32_t count = active_thread_count_.load() - 1;
+        active_thread_count_.store(count);
+        threads_retired_.fetch_add(1);
+
+        DEBUG_LOG("Retired thread, %u still active\n", count);
+    }
+
+    if (predecessor != nullptr)
+        predecessor->Join();
+
+    return true;
+}
+
 void ThreadPool::InternalShutdown() {
     // Be careful when shutting down, a specific sequence needs to be followed.
     // See MG-1118 for details.
@@ -216,15 +323,19 @@ void ThreadPool::InternalShutdown() {
         }
     }
 
-    // Synchronize with the threads as they exit.
+    // Synchronize with the threads as they exit, along with any which retired
+    // earlier and have yet to be joined.
     while (true) {
         fbl::unique_ptr<Thread> thread;
         {
             fbl::AutoLock lock(&pool_lock_);
-            if (active_threads_.is_empty())
+            if (!active_threads_.is_empty()) {
+                thread = active_threads_.pop_front();
+            } else if (!retired_threads_.is_empty()) {
+                thread = retired_threads_.pop_front();
+            } else {
                 break;
-
-            thread = active_threads_.pop_front();
+            }
         }
 
         thread->Join();
@@ -271,6 +382,10 @@ void ThreadPool::Thread::Join() {
     ZX_DEBUG_ASSERT(pool_ == nullptr);
 }
 
+zx_status_t ThreadPool::Thread::SetAffinity(uint64_t cpu_mask) {
+    return zx_thread_set_affinity(thrd_get_zx_handle(thread_handle_), cpu_mask);
+}
+
 void ThreadPool::Thread::PrintDebugPrefix() const {
     printf("[Thread %03u-%02u] ", id_, pool_->priority());
 }
@@ -286,42 +401,89 @@ int ThreadPool::Thread::Main() {
         DEBUG_LOG("WARNING - Failed to set thread priority (res %d)\n", res);
     }
 
+    // We were counted as idle when we were started; from here on we count
+    // ourselves, leaving the count each time we wake up with work and
+    // rejoining it once the work is done.
+    bool quit = false;
     while (true) {
-        zx_port_packet_t pkt;
-
-        // TODO(johngro) : consider automatically shutting down if we have more
-        // threads than clients.
+        zx_port_packet_t pkts[ZX_PORT_WAIT_MANY_MAX];
+        size_t count;
+
+        // Wait for there to be work to dispatch.  Unless we are the pool's
+        // last thread, give up and retire if none shows up for a while.
+        zx::time deadline = (pool_->active_thread_count_.load() > 1)
+                          ? zx::deadline_after(zx::duration(kIdleRetireTimeout))
+                          : zx::time::infinite();
+        zx_time_t idle_start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        res = pool_->port().wait_many(deadline, pkts, fbl::count_of(pkts), &count);
+        zx_time_t busy_start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        uint32_t idle_siblings = pool_->idle_thread_count_.fetch_sub(1) - 1;
+        pool_->idle_time_.fetch_add(busy_start - idle_start);
+
+        if (res == ZX_ERR_TIMED_OUT) {
+            if (pool_->MaybeRetire(this))
+                break;
+            pool_->idle_thread_count_.fetch_add(1);
+            continue;
+        }
 
-        // Wait for there to be work to dispatch.  We should never encounter an
-        // error, but if we do, shut down.
-        res = pool_->port().wait(zx::time::infinite(), &pkt, 0);
+        // We should never encounter any other error, but if we do, shut down.
         ZX_DEBUG_ASSERT(res == ZX_OK);
-
-        // Is it time to exit?
-        if ((res != ZX_OK) || (pkt.type == ZX_PKT_TYPE_USER)) {
+        if (res != ZX_OK)
             break;
-        }
 
-        if (pkt.type != ZX_PKT_TYPE_SIGNAL_ONE) {
-            LOG("Unexpected packet type (%u) in Thread pool!\n", pkt.type);
-            continue;
+        // Finding more than one packet waiting while every other thread is
+        // busy means work is backing up behind us; bring in another thread.
+        if ((count > 1) && (idle_siblings == 0))
+            pool_->MaybeGrow();
+
+        // Dispatch the whole batch before going back to the kernel.  Every
+        // signal packet carries a reference to its event source which must be
+        // reclaimed, so keep going even after seeing our quit message.
+        for (size_t i = 0; i < count; ++i) {
+            const zx_port_packet_t& pkt = pkts[i];
+
+            // Is it time to exit?  Shutdown queues one quit message per
+            // thread, so pass on any beyond the first to our siblings.
+            if (pkt.type == ZX_PKT_TYPE_USER) {
+                if (quit) {
+                    __UNUSED zx_status_t requeue_res;
+                    requeue_res = pool_->port().queue(&pkt, sizeof(pkt));
+                    ZX_DEBUG_ASSERT(requeue_res == ZX_OK);
+                }
+                quit = true;
+                continue;
+            }
+
+            if (pkt.type != ZX_PKT_TYPE_SIGNAL_ONE) {
+                LOG("Unexpected packet type (%u) in Thread pool!\n", pkt.type);
+                continue;
+            }
+
+            // Reclaim our event source reference from the kernel.
+            static_assert(sizeof(pkt.key) >= sizeof(EventSource*),
+                          "Port packet keys are not large enough to hold a pointer!");
+            auto event_source =
+                fbl::internal::MakeRefPtrNoAdopt(reinterpret_cast<EventSource*>(pkt.key));
+
+            // Schedule the dispatch of the pending events for this event source.
+            // If ScheduleDispatch returns a valid ExecutionDomain reference, then
+            // actually go ahead and perform the dispatch of pending work for this
+            // domain.
+            ZX_DEBUG_ASSERT(event_source != nullptr);
+            fbl::RefPtr<ExecutionDomain> domain = event_source->ScheduleDispatch(pkt);
+
+            if (domain != nullptr)
+                domain->DispatchPendingWork();
         }
 
-        // Reclaim our event source reference from the kernel.
-        static_assert(sizeof(pkt.key) >= sizeof(EventSource*),
-                      "Port packet keys are not large enough to hold a pointer!");
-        auto event_source =
-            fbl::internal::MakeRefPtrNoAdopt(reinterpret_cast<EventSource*>(pkt.key));
-
-        // Schedule the dispatch of the pending events for this event source.
-        // If ScheduleDispatch returns a valid ExecutionDomain reference, then
-        // actually go ahead and perform the dispatch of pending work for this
-        // domain.
-        ZX_DEBUG_ASSERT(event_source != nullptr);
-        fbl::RefPtr<ExecutionDomain> domain = event_source->ScheduleDispatch(pkt);
-
-        if (domain != nullptr)
-            domain->DispatchPendingWork();
+        pool_->packets_dispatched_.fetch_add(count);
+        pool_->busy_time_.fetch_add(zx_clock_get(ZX_CLOCK_MONOTONIC) - busy_start);
+
+        if (quit)
+            break;
+
+        pool_->idle_thread_count_.fetch_add(1);
     }
 
     DEBUG_LOG("Client work thread shutting down\n");
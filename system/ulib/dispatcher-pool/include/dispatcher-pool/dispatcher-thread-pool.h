@@ -7,6 +7,8 @@
 #include <zircon/compiler.h>
 #include <zircon/types.h>
 #include <zx/port.h>
+#include <zx/time.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_single_list.h>
@@ -21,9 +23,32 @@
 
 namespace dispatcher {
 
+// A pool of threads servicing the execution domains which share a priority.
+//
+// The pool sizes itself to its load.  It starts with a single thread and adds
+// another whenever a thread finds work backed up on the port while none of
+// its siblings are idle, up to one thread per domain (domains never dispatch
+// concurrently, so more would just sit idle) or per cpu, whichever is fewer.
+// Threads which find no work for kIdleRetireTimeout retire, down to the
+// single thread.
 class ThreadPool : public fbl::RefCounted<ThreadPool>,
                    public fbl::WAVLTreeContainable<fbl::RefPtr<ThreadPool>> {
 public:
+    // Utilization of a pool, see GetStats.  The busy and idle times cover
+    // every thread which has served the pool; busy_time / (busy_time +
+    // idle_time) is the fraction of its threads' time spent dispatching.
+    struct Stats {
+        uint32_t thread_count;
+        uint32_t peak_thread_count;
+        uint64_t threads_started;
+        uint64_t threads_retired;
+        uint64_t packets_dispatched;
+        zx_duration_t busy_time;
+        zx_duration_t idle_time;
+    };
+
+    static constexpr zx_duration_t kIdleRetireTimeout = ZX_SEC(2);
+
     static zx_status_t Get(fbl::RefPtr<ThreadPool>* pool_out, uint32_t priority);
     static void ShutdownAll();
 
@@ -31,6 +56,12 @@ public:
     zx_status_t AddDomainToPool(fbl::RefPtr<ExecutionDomain> domain);
     void RemoveDomainFromPool(ExecutionDomain* domain);
 
+    // Restricts the pool's threads, current and future, to the cpus in
+    // |cpu_mask| (see zx_thread_set_affinity).
+    zx_status_t SetCpuAffinity(uint64_t cpu_mask);
+
+    void GetStats(Stats* out) const;
+
     zx_status_t WaitOnPort(const zx::handle& handle,
                            uint64_t key,
                            zx_signals_t signals,
@@ -47,6 +78,7 @@ private:
         static fbl::unique_ptr<Thread> Create(fbl::RefPtr<ThreadPool> pool, uint32_t id);
         zx_status_t Start();
         void Join();
+        zx_status_t SetAffinity(uint64_t cpu_mask);
 
     private:
         Thread(fbl::RefPtr<ThreadPool> pool, uint32_t id);
@@ -74,6 +106,17 @@ private:
     zx_status_t Init();
     void InternalShutdown();
 
+    uint32_t MaxThreadsLocked() const __TA_REQUIRES(pool_lock_);
+    zx_status_t StartThreadLocked() __TA_REQUIRES(pool_lock_);
+
+    // Called by a thread which found work backed up with no idle sibling to
+    // take it.
+    void MaybeGrow();
+
+    // Called by a thread which has been idle for kIdleRetireTimeout.  Returns
+    // true if the thread has been removed from the pool and should exit.
+    bool MaybeRetire(Thread* thread);
+
     static fbl::Mutex active_pools_lock_;
     static fbl::WAVLTree<uint32_t, fbl::RefPtr<ThreadPool>> active_pools_
         __TA_GUARDED(active_pools_lock_);
@@ -84,15 +127,32 @@ private:
     fbl::Mutex pool_lock_ __TA_ACQUIRED_AFTER(active_pools_lock_);
     zx::port port_;
     uint32_t active_domain_count_ __TA_GUARDED(pool_lock_) = 0;
-    uint32_t active_thread_count_ __TA_GUARDED(pool_lock_) = 0;
+    uint32_t next_thread_id_ __TA_GUARDED(pool_lock_) = 0;
+    uint64_t cpu_mask_ __TA_GUARDED(pool_lock_) = 0;
     bool pool_shutting_down_ __TA_GUARDED(pool_lock_) = false;
 
+    // Only changed with pool_lock_ held, but read without it by threads
+    // deciding whether to grow the pool or wait to retire.
+    fbl::atomic<uint32_t> active_thread_count_{0};
+    fbl::atomic<uint32_t> idle_thread_count_{0};
+
+    fbl::atomic<uint32_t> peak_thread_count_{0};
+    fbl::atomic<uint64_t> threads_started_{0};
+    fbl::atomic<uint64_t> threads_retired_{0};
+    fbl::atomic<uint64_t> packets_dispatched_{0};
+    fbl::atomic<zx_duration_t> busy_time_{0};
+    fbl::atomic<zx_duration_t> idle_time_{0};
+
     fbl::DoublyLinkedList<fbl::RefPtr<ExecutionDomain>,
                            ExecutionDomain::ThreadPoolListTraits> active_domains_
         __TA_GUARDED(pool_lock_);
 
     fbl::DoublyLinkedList<fbl::unique_ptr<Thread>> active_threads_
         __TA_GUARDED(pool_lock_);
+
+    // Threads which have retired but not yet been joined.
+    fbl::DoublyLinkedList<fbl::unique_ptr<Thread>> retired_threads_
+        __TA_GUARDED(pool_lock_);
 };
 
 }  // namespace dispatcher
@@ -139,8 +139,60 @@ static zx_status_t choose_load_bias(zx_handle_t root_vmar,
     return status;
 }
 
+// The mappings for the segments are queued up and made with as few
+// zx_vmar_batch() calls as possible.  The VMOs created for them are
+// kept open until their mappings have been made.
+typedef struct {
+    zx_vmar_batch_op_t ops[ZX_VMAR_BATCH_MAX_OPS];
+    size_t count;
+    zx_handle_t handles[ZX_VMAR_BATCH_MAX_OPS];
+    size_t nhandles;
+} map_batch_t;
+
+// Makes the queued mappings, and closes the VMOs handed to close_after_maps.
+static zx_status_t flush_maps(zx_handle_t vmar, map_batch_t* batch) {
+    zx_status_t status = ZX_OK;
+    if (batch->count > 0)
+        status = zx_vmar_batch(vmar, batch->ops, batch->count, NULL);
+    for (size_t i = 0; i < batch->nhandles; ++i)
+        zx_handle_close(batch->handles[i]);
+    batch->count = 0;
+    batch->nhandles = 0;
+    return status;
+}
+
+static zx_status_t queue_map(zx_handle_t vmar, map_batch_t* batch,
+                             size_t vmar_offset, zx_handle_t vmo,
+                             uint64_t vmo_offset, size_t len, uint32_t flags) {
+    if (batch->count == ZX_VMAR_BATCH_MAX_OPS) {
+        zx_status_t status = flush_maps(vmar, batch);
+        if (status != ZX_OK)
+            return status;
+    }
+    batch->ops[batch->count++] = (zx_vmar_batch_op_t){
+        .op = ZX_VMAR_BATCH_MAP,
+        .flags = flags,
+        .vmo = vmo,
+        .vmo_offset = vmo_offset,
+        .addr = vmar_offset,
+        .len = len,
+    };
+    return ZX_OK;
+}
+
+// Takes ownership of |vmo|, which must not be used by any mapping
+// queued after this.
+static zx_status_t close_after_maps(zx_handle_t vmar, map_batch_t* batch,
+                                    zx_handle_t vmo) {
+    batch->handles[batch->nhandles++] = vmo;
+    if (batch->nhandles == ZX_VMAR_BATCH_MAX_OPS)
+        return flush_maps(vmar, batch);
+    return ZX_OK;
+}
+
 static zx_status_t finish_load_segment(
-    zx_handle_t vmar, zx_handle_t vmo, const char vmo_name[ZX_MAX_NAME_LEN],
+    zx_handle_t vmar, map_batch_t* batch, zx_handle_t vmo,
+    const char vmo_name[ZX_MAX_NAME_LEN],
     const elf_phdr_t* ph, size_t start_offset, size_t size,
     uintptr_t file_start, uintptr_t file_end, size_t partial_page) {
     const uint32_t flags = ZX_VM_FLAG_SPECIFIC |
@@ -148,19 +200,18 @@ static zx_status_t finish_load_segment(
         ((ph->p_flags & PF_W) ? ZX_VM_FLAG_PERM_WRITE : 0) |
         ((ph->p_flags & PF_X) ? ZX_VM_FLAG_PERM_EXECUTE : 0);
 
-    uintptr_t start;
     if (ph->p_filesz == ph->p_memsz)
         // Straightforward segment, map all the whole pages from the file.
-        return zx_vmar_map(vmar, start_offset, vmo, file_start, size, flags,
-                           &start);
+        return queue_map(vmar, batch, start_offset, vmo, file_start, size,
+                         flags);
 
     const size_t file_size = file_end - file_start;
 
     // This segment has some bss, so things are more complicated.
     // Only the leading portion is directly mapped in from the file.
     if (file_size > 0) {
-        zx_status_t status = zx_vmar_map(vmar, start_offset, vmo, file_start,
-                                         file_size, flags, &start);
+        zx_status_t status = queue_map(vmar, batch, start_offset, vmo,
+                                       file_start, file_size, flags);
         if (status != ZX_OK)
             return status;
 
@@ -210,15 +261,18 @@ static zx_status_t finish_load_segment(
         }
     }
 
-    status = zx_vmar_map(vmar, start_offset, bss_vmo, 0, size, flags, &start);
-    zx_handle_close(bss_vmo);
+    status = queue_map(vmar, batch, start_offset, bss_vmo, 0, size, flags);
+    if (status != ZX_OK) {
+        zx_handle_close(bss_vmo);
+        return status;
+    }
 
-    return status;
+    return close_after_maps(vmar, batch, bss_vmo);
 }
 
-static zx_status_t load_segment(zx_handle_t vmar, size_t vmar_offset,
-                                zx_handle_t vmo, const char* vmo_name,
-                                const elf_phdr_t* ph) {
+static zx_status_t load_segment(zx_handle_t vmar, map_batch_t* batch,
+                                size_t vmar_offset, zx_handle_t vmo,
+                                const char* vmo_name, const elf_phdr_t* ph) {
     // The p_vaddr can start in the middle of a page, but the
     // semantics are that all the whole pages containing the
     // p_vaddr+p_filesz range are mapped in.
@@ -244,7 +298,7 @@ static zx_status_t load_segment(zx_handle_t vmar, size_t vmar_offset,
 
     // With no writable data, it's the simple case.
     if (!(ph->p_flags & PF_W) || data_size == 0)
-        return finish_load_segment(vmar, vmo, vmo_name, ph, start, size,
+        return finish_load_segment(vmar, batch, vmo, vmo_name, ph, start, size,
                                    file_start, file_end, partial_page);
 
     // For a writable segment, we need a writable VMO.
@@ -259,8 +313,10 @@ static zx_status_t load_segment(zx_handle_t vmar, size_t vmar_offset,
                                         name, strlen(name));
         if (status == ZX_OK)
             status = finish_load_segment(
-                vmar, writable_vmo, vmo_name, ph, start, size,
+                vmar, batch, writable_vmo, vmo_name, ph, start, size,
                 0, file_end - file_start, partial_page);
+        if (status == ZX_OK)
+            return close_after_maps(vmar, batch, writable_vmo);
         zx_handle_close(writable_vmo);
     }
     return status;
@@ -285,10 +341,17 @@ zx_status_t elf_load_map_segments(zx_handle_t root_vmar,
                                           &vmar, &vmar_base, &bias);
 
     size_t vmar_offset = bias - vmar_base;
+    map_batch_t batch = {.count = 0, .nhandles = 0};
     for (uint_fast16_t i = 0; status == ZX_OK && i < header->e_phnum; ++i) {
         if (phdrs[i].p_type == PT_LOAD)
-            status = load_segment(vmar, vmar_offset, vmo, vmo_name, &phdrs[i]);
+            status = load_segment(vmar, &batch, vmar_offset, vmo, vmo_name,
+                                  &phdrs[i]);
     }
+    if (status != ZX_OK)
+        batch.count = 0;
+    zx_status_t flush_status = flush_maps(vmar, &batch);
+    if (status == ZX_OK)
+        status = flush_status;
 
     if (status == ZX_OK && segments_vmar != NULL)
         *segments_vmar = vmar;
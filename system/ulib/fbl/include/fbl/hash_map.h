@@ -0,0 +1,329 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/macros.h>
+#include <fbl/new.h>
+#include <fbl/type_support.h>
+#include <fbl/vector.h>
+#include <zircon/assert.h>
+
+namespace fbl {
+
+// Default hashing for HashMap<> keys which are integers or pointers.  Users
+// with other key types supply their own traits with the same two members.
+// The map mixes the bits of whatever Hash() returns, so it need not be a
+// good hash by itself.
+template <typename Key>
+struct DefaultHashMapTraits {
+    static uint64_t Hash(const Key& key) { return static_cast<uint64_t>(key); }
+    static bool EqualTo(const Key& a, const Key& b) { return a == b; }
+};
+
+template <typename T>
+struct DefaultHashMapTraits<T*> {
+    static uint64_t Hash(T* key) {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+    }
+    static bool EqualTo(T* a, T* b) { return a == b; }
+};
+
+// HashMap<> is an open addressing hash table which owns its keys and values,
+// implementing a limited set of the functionality of std::unordered_map.
+//
+// Unlike the intrusive HashTable<>, lookups do not chase a pointer per
+// element.  Alongside the slots, the table keeps one control byte per slot:
+// either empty, deleted, or 7 bits of the hash of the key in the slot.  A
+// lookup hashes its key to a group of 8 slots and compares the tag against
+// all 8 control bytes of the group at once, as a single 64-bit word, so it
+// usually touches one line of control bytes and one slot.  Groups are probed
+// in triangular order until one with an empty slot is found.
+//
+// Like Vector<>, HashMap<> reports allocation failures through an
+// AllocChecker rather than by throwing, and may not be copied.  Pointers to
+// values are invalidated by any insertion which grows the table.
+template <typename Key,
+          typename Value,
+          typename HashTraits = DefaultHashMapTraits<Key>,
+          typename AllocatorTraits = DefaultAllocatorTraits>
+class HashMap {
+public:
+    // move semantics only
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(HashMap);
+
+    constexpr HashMap() {}
+
+    HashMap(HashMap&& other) { swap(other); }
+
+    HashMap& operator=(HashMap&& other) {
+        reset();
+        swap(other);
+        return *this;
+    }
+
+    ~HashMap() { reset(); }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool is_empty() const { return size_ == 0; }
+
+    // Returns the value stored for |key|, or nullptr if there is none.
+    Value* find(const Key& key) const {
+        size_t i = find_index(key);
+        return i == capacity_ ? nullptr : &slots_[i].value;
+    }
+
+    // Stores |value| for |key|, replacing any value already stored for it.
+    // On allocation failure the map is left unchanged.
+    void insert(Key key, Value value, AllocChecker* ac) {
+        Value* existing = find(key);
+        if (existing != nullptr) {
+            *existing = fbl::move(value);
+            ac->arm(0u, true);
+            return;
+        }
+        if (size_ + deleted_ >= MaxLoad(capacity_)) {
+            // Reclaim deleted slots in place if that leaves room to grow into,
+            // otherwise double the table.
+            size_t new_capacity = capacity_ == 0 ? kMinCapacity
+                                  : (size_ < MaxLoad(capacity_) / 2) ? capacity_
+                                  : capacity_ * 2;
+            if (!rehash(new_capacity, ac)) {
+                return;
+            }
+        }
+        insert_new(Hash(key), fbl::move(key), fbl::move(value));
+        ac->arm(0u, true);
+    }
+
+    // Removes the entry for |key|.  Returns false if there was none.
+    bool erase(const Key& key) {
+        size_t i = find_index(key);
+        if (i == capacity_) {
+            return false;
+        }
+        slots_[i].~Slot();
+        // A probe stops at the first group with an empty slot.  If this
+        // group already has one, no probe passes through it, so the slot can
+        // become empty again; otherwise it must be marked deleted to keep
+        // later entries of the probe sequence reachable.
+        size_t group = i & ~(kGroupWidth - 1);
+        if (MatchEmpty(LoadGroup(group)) != 0) {
+            ctrl_[i] = kEmpty;
+        } else {
+            ctrl_[i] = kDeleted;
+            ++deleted_;
+        }
+        --size_;
+        return true;
+    }
+
+    // Grows the table so that |count| entries fit without a further
+    // allocation.
+    void reserve(size_t count, AllocChecker* ac) {
+        size_t new_capacity = capacity_ == 0 ? kMinCapacity : capacity_;
+        while (MaxLoad(new_capacity) <= count) {
+            new_capacity *= 2;
+        }
+        if (new_capacity == capacity_) {
+            ac->arm(0u, true);
+            return;
+        }
+        rehash(new_capacity, ac);
+    }
+
+    // Calls |fn(const Key&, Value&)| for every entry, in no particular order.
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (IsFull(ctrl_[i])) {
+                fn(static_cast<const Key&>(slots_[i].key), slots_[i].value);
+            }
+        }
+    }
+
+    // Destroys every entry and frees the table.
+    void reset() {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (IsFull(ctrl_[i])) {
+                slots_[i].~Slot();
+            }
+        }
+        AllocatorTraits::Deallocate(slots_);
+        slots_ = nullptr;
+        ctrl_ = nullptr;
+        capacity_ = 0;
+        size_ = 0;
+        deleted_ = 0;
+    }
+
+    void swap(HashMap& other) {
+        Slot* slots = slots_;
+        uint8_t* ctrl = ctrl_;
+        size_t capacity = capacity_;
+        size_t size = size_;
+        size_t deleted = deleted_;
+        slots_ = other.slots_;
+        ctrl_ = other.ctrl_;
+        capacity_ = other.capacity_;
+        size_ = other.size_;
+        deleted_ = other.deleted_;
+        other.slots_ = slots;
+        other.ctrl_ = ctrl;
+        other.capacity_ = capacity;
+        other.size_ = size;
+        other.deleted_ = deleted;
+    }
+
+private:
+    struct Slot {
+        Slot(Key&& k, Value&& v) : key(fbl::move(k)), value(fbl::move(v)) {}
+        Key key;
+        Value value;
+    };
+
+    // Visits groups at offsets h, h + 1, h + 3, h + 6, ... (in groups),
+    // which covers every group of a power-of-two sized table.
+    class ProbeSeq {
+    public:
+        ProbeSeq(uint64_t hash, size_t capacity)
+            : mask_(capacity - 1), offset_((hash >> 7) & mask_ & ~(kGroupWidth - 1)) {}
+        size_t offset() const { return offset_; }
+        void next() {
+            stride_ += kGroupWidth;
+            offset_ = (offset_ + stride_) & mask_;
+        }
+
+    private:
+        size_t mask_;
+        size_t offset_;
+        size_t stride_ = 0;
+    };
+
+    static constexpr size_t kGroupWidth = 8;
+    static constexpr size_t kMinCapacity = 16;
+    static constexpr uint8_t kEmpty = 0x80;
+    static constexpr uint8_t kDeleted = 0xfe;
+    static constexpr uint64_t kLsbs = 0x0101010101010101ull;
+    static constexpr uint64_t kMsbs = 0x8080808080808080ull;
+
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                  "group matching assumes little endian control words");
+
+    // At most 7/8 of the slots may be in use, counting deleted ones.
+    static size_t MaxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+    // Fibonacci hashing, folded so that the low bits, which the tag and the
+    // group index come from, depend on every bit of the user's hash.
+    static uint64_t Hash(const Key& key) {
+        uint64_t hash = HashTraits::Hash(key) * 0x9e3779b97f4a7c15ull;
+        return hash ^ (hash >> 32);
+    }
+
+    static uint8_t Tag(uint64_t hash) { return static_cast<uint8_t>(hash & 0x7f); }
+    static bool IsFull(uint8_t ctrl) { return (ctrl & 0x80) == 0; }
+
+    uint64_t LoadGroup(size_t offset) const {
+        uint64_t group;
+        memcpy(&group, ctrl_ + offset, sizeof(group));
+        return group;
+    }
+
+    // Returns the high bit of each byte of |group| which may equal the tag
+    // repeated in |tag_bits|.  A borrow can produce a false positive above a
+    // real match, which the key comparison weeds out.
+    static uint64_t MatchTag(uint64_t group, uint64_t tag_bits) {
+        uint64_t x = group ^ tag_bits;
+        return (x - kLsbs) & ~x & kMsbs;
+    }
+
+    // Empty is the only control value with the high bit set and bit 1 clear.
+    static uint64_t MatchEmpty(uint64_t group) { return group & (~group << 6) & kMsbs; }
+
+    // Full slots are the only ones with the high bit clear.
+    static uint64_t MatchEmptyOrDeleted(uint64_t group) { return group & kMsbs; }
+
+    // Returns the slot holding |key|, or capacity_ if there is none.
+    size_t find_index(const Key& key) const {
+        if (size_ == 0) {
+            return capacity_;
+        }
+        uint64_t hash = Hash(key);
+        uint64_t tag_bits = kLsbs * Tag(hash);
+        ProbeSeq seq(hash, capacity_);
+        for (;;) {
+            uint64_t group = LoadGroup(seq.offset());
+            for (uint64_t m = MatchTag(group, tag_bits); m != 0; m &= m - 1) {
+                size_t i = seq.offset() + (__builtin_ctzll(m) >> 3);
+                if (HashTraits::EqualTo(slots_[i].key, key)) {
+                    return i;
+                }
+            }
+            if (MatchEmpty(group) != 0) {
+                return capacity_;
+            }
+            seq.next();
+        }
+    }
+
+    // Places a key known to be absent into the first free slot of its probe
+    // sequence.  There must be room for it.
+    void insert_new(uint64_t hash, Key&& key, Value&& value) {
+        ProbeSeq seq(hash, capacity_);
+        uint64_t m;
+        while ((m = MatchEmptyOrDeleted(LoadGroup(seq.offset()))) == 0) {
+            seq.next();
+        }
+        size_t i = seq.offset() + (__builtin_ctzll(m) >> 3);
+        if (ctrl_[i] == kDeleted) {
+            --deleted_;
+        }
+        ctrl_[i] = Tag(hash);
+        new (&slots_[i]) Slot(fbl::move(key), fbl::move(value));
+        ++size_;
+    }
+
+    // Moves every entry into a new table of |new_capacity| slots, dropping
+    // deleted markers.  On failure the table is unchanged.
+    bool rehash(size_t new_capacity, AllocChecker* ac) {
+        ZX_DEBUG_ASSERT((new_capacity & (new_capacity - 1)) == 0);
+        ZX_DEBUG_ASSERT(MaxLoad(new_capacity) > size_);
+        size_t slots_size = new_capacity * sizeof(Slot);
+        void* mem = AllocatorTraits::Allocate(slots_size + new_capacity);
+        if (mem == nullptr) {
+            ac->arm(1u, false);
+            return false;
+        }
+
+        HashMap old;
+        swap(old);
+        slots_ = reinterpret_cast<Slot*>(mem);
+        ctrl_ = reinterpret_cast<uint8_t*>(mem) + slots_size;
+        capacity_ = new_capacity;
+        memset(ctrl_, kEmpty, new_capacity);
+
+        for (size_t i = 0; i < old.capacity_; ++i) {
+            if (IsFull(old.ctrl_[i])) {
+                Slot& slot = old.slots_[i];
+                insert_new(Hash(slot.key), fbl::move(slot.key),
+                           fbl::move(slot.value));
+            }
+        }
+        ac->arm(0u, true);
+        return true;
+    }
+
+    Slot* slots_ = nullptr;
+    uint8_t* ctrl_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    size_t deleted_ = 0;
+};
+
+} // namespace fbl
@@ -0,0 +1,190 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/macros.h>
+#include <fbl/new.h>
+#include <fbl/type_support.h>
+#include <fbl/vector.h>
+#include <zircon/assert.h>
+
+namespace fbl {
+
+// InlineVector<> is a dynamic array which keeps its first |N| elements
+// inside the object itself, and only allocates once it grows beyond them.
+// Small vectors, which are the common case for many lists, therefore cost
+// no allocation and sit in the same cache lines as their owner.
+//
+// Like Vector<>, it reports allocation failures through an AllocChecker,
+// may not be copied, and only grows and shrinks at the end.  Unlike
+// Vector<>, moving it moves the elements when they are stored inline, and
+// it never gives back memory until it is reset.
+template <typename T, size_t N, typename AllocatorTraits = DefaultAllocatorTraits>
+class InlineVector {
+public:
+    static_assert(N > 0, "use Vector<> for vectors without inline storage");
+
+    // move semantics only
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(InlineVector);
+
+    InlineVector() : ptr_(inline_storage()), size_(0U), capacity_(N) {}
+
+    InlineVector(InlineVector&& other) : InlineVector() {
+        move_from(other);
+    }
+
+    InlineVector& operator=(InlineVector&& other) {
+        reset();
+        move_from(other);
+        return *this;
+    }
+
+    ~InlineVector() {
+        reset();
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    bool is_empty() const {
+        return size_ == 0;
+    }
+
+    // Whether the elements are still stored inside the object.
+    bool is_inline() const {
+        return ptr_ == inline_storage();
+    }
+
+    // Reserve enough size to hold at least capacity elements.
+    void reserve(size_t capacity, AllocChecker* ac) {
+        if (capacity <= capacity_) {
+            ac->arm(0u, true);
+            return;
+        }
+        reallocate(capacity, ac);
+    }
+
+    // Destroys the elements and returns to the inline storage.
+    void reset() {
+        while (size_ > 0) {
+            ptr_[--size_].~T();
+        }
+        if (!is_inline()) {
+            AllocatorTraits::Deallocate(ptr_);
+            ptr_ = inline_storage();
+            capacity_ = N;
+        }
+    }
+
+    void push_back(T&& value, AllocChecker* ac) {
+        if (!grow_for_new_element(ac)) {
+            return;
+        }
+        new (&ptr_[size_++]) T(fbl::move(value));
+    }
+
+    void push_back(const T& value, AllocChecker* ac) {
+        if (!grow_for_new_element(ac)) {
+            return;
+        }
+        new (&ptr_[size_++]) T(value);
+    }
+
+    void pop_back() {
+        ZX_DEBUG_ASSERT(size_ > 0);
+        ptr_[--size_].~T();
+    }
+
+    T* get() const {
+        return ptr_;
+    }
+
+    T& operator[](size_t i) const {
+        ZX_DEBUG_ASSERT(i < size_);
+        return ptr_[i];
+    }
+
+    T* begin() const {
+        return ptr_;
+    }
+
+    T* end() const {
+        return &ptr_[size_];
+    }
+
+private:
+    T* inline_storage() const {
+        return reinterpret_cast<T*>(const_cast<char*>(inline_storage_));
+    }
+
+    // Takes the elements of |other|, which must be empty afterwards, into
+    // this vector, which must be empty and inline.
+    void move_from(InlineVector& other) {
+        ZX_DEBUG_ASSERT(size_ == 0 && is_inline());
+        if (other.is_inline()) {
+            for (size_t i = 0; i < other.size_; i++) {
+                new (&ptr_[i]) T(fbl::move(other.ptr_[i]));
+                other.ptr_[i].~T();
+            }
+            size_ = other.size_;
+            other.size_ = 0;
+        } else {
+            ptr_ = other.ptr_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.ptr_ = other.inline_storage();
+            other.size_ = 0;
+            other.capacity_ = N;
+        }
+    }
+
+    bool grow_for_new_element(AllocChecker* ac) {
+        ZX_DEBUG_ASSERT(size_ <= capacity_);
+        if (size_ == capacity_) {
+            return reallocate(capacity_ * kCapacityGrowthFactor, ac);
+        }
+        ac->arm(0u, true);
+        return true;
+    }
+
+    // Moves the elements to a new heap array of |new_capacity| elements.
+    // On failure the vector is unchanged.
+    bool reallocate(size_t new_capacity, AllocChecker* ac) {
+        ZX_DEBUG_ASSERT(new_capacity > capacity_);
+        auto new_ptr = reinterpret_cast<T*>(AllocatorTraits::Allocate(new_capacity * sizeof(T)));
+        if (new_ptr == nullptr) {
+            ac->arm(1u, false);
+            return false;
+        }
+        for (size_t i = 0; i < size_; i++) {
+            new (&new_ptr[i]) T(fbl::move(ptr_[i]));
+            ptr_[i].~T();
+        }
+        if (!is_inline()) {
+            AllocatorTraits::Deallocate(ptr_);
+        }
+        ptr_ = new_ptr;
+        capacity_ = new_capacity;
+        ac->arm(0u, true);
+        return true;
+    }
+
+    T* ptr_;
+    size_t size_;
+    size_t capacity_;
+    alignas(T) char inline_storage_[N * sizeof(T)];
+
+    static constexpr size_t kCapacityGrowthFactor = 2;
+};
+
+} // namespace fbl
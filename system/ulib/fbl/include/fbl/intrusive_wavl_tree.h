@@ -444,6 +444,30 @@ public:
     // size : return the current number of elements in the tree.
     size_t size() const { return count_; };
 
+    // root_node, left_child, right_child, parent_node
+    //
+    // Access to the shape of the tree, for searches which use the subtree
+    // values kept by an Observer (see OnSubtreeChanged) to skip over whole
+    // subtrees.  Each returns nullptr where there is no such node.
+    RawPtrType root_node() const {
+        return PtrTraits::IsValid(root_) ? PtrTraits::GetRaw(root_) : nullptr;
+    }
+
+    static RawPtrType left_child(RawPtrType node) {
+        const auto& ns = NodeTraits::node_state(*node);
+        return PtrTraits::IsValid(ns.left_) ? PtrTraits::GetRaw(ns.left_) : nullptr;
+    }
+
+    static RawPtrType right_child(RawPtrType node) {
+        const auto& ns = NodeTraits::node_state(*node);
+        return PtrTraits::IsValid(ns.right_) ? PtrTraits::GetRaw(ns.right_) : nullptr;
+    }
+
+    static RawPtrType parent_node(RawPtrType node) {
+        const auto& ns = NodeTraits::node_state(*node);
+        return PtrTraits::IsValid(ns.parent_) ? ns.parent_ : nullptr;
+    }
+
     // erase_if
     //
     // Find the first member of the list which satisfies the predicate given by
@@ -691,6 +715,7 @@ private:
             right_most_ = PtrTraits::GetRaw(ptr);
 
             root_ = fbl::move(ptr);
+            UpdateSubtrees(PtrTraits::GetRaw(root_));
 
             ++count_;
             Observer::RecordInsert();
@@ -766,6 +791,7 @@ private:
         ZX_DEBUG_ASSERT(*owner == nullptr);
         ns.parent_ = parent;
         *owner = fbl::move(ptr);
+        UpdateSubtrees(PtrTraits::GetRaw(*owner));
 
         ++count_;
         Observer::RecordInsert();
@@ -906,9 +932,12 @@ private:
         // indicate that it is not in the container.
         ZX_DEBUG_ASSERT(ns.IsValid() && !ns.InContainer());
 
-        // Update the count bookkeeping.
+        // Update the count bookkeeping, and the subtree values of the nodes
+        // above the one which was removed.  Any rotations made while
+        // rebalancing keep these up to date.
         --count_;
         Observer::RecordErase();
+        UpdateSubtrees(parent);
 
         // Time to rebalance.  We know that we don't need to rebalance if we
         // just removed the root (IOW - its parent was the sentinel value).
@@ -990,6 +1019,7 @@ private:
         // caller.
         PtrTraits::Swap(GetLinkPtrToNode(old_node), new_node);
         pod_swap(old_ns.parent_, new_ns.parent_);
+        UpdateSubtrees(new_raw);
         return fbl::move(new_node);
     }
 
@@ -1348,6 +1378,25 @@ private:
         Z_ns.parent_ = X;
         if (Y)
             NodeTraits::node_state(*Y).parent_ = Z;
+
+        // Z is now X's child, and the set of nodes under X is the set which
+        // was under Z, so nothing above X needs to be updated.
+        UpdateSubtree(Z);
+        UpdateSubtree(X);
+    }
+
+    // Tells the observer that the subtree under |node| has changed.
+    void UpdateSubtree(RawPtrType node) {
+        Observer::OnSubtreeChanged(node, left_child(node), right_child(node));
+    }
+
+    // Tells the observer that the subtrees under |node| and each of its
+    // ancestors have changed.  |node| may be the sentinel.
+    void UpdateSubtrees(RawPtrType node) {
+        while (PtrTraits::IsValid(node)) {
+            UpdateSubtree(node);
+            node = NodeTraits::node_state(*node).parent_;
+        }
     }
 
     // PostInsertFixupLR<LRTraits>
@@ -26,6 +26,12 @@ class WAVLTreeChecker;
 // phase of rebalancing are considered to be part of the cost of rotation and
 // are not tallied in the overall promote/demote accounting.
 //
+// Observers may also keep a value for each node which summarizes the node's
+// subtree (a count of nodes, or the largest gap between keys, for example).
+// OnSubtreeChanged is called for every node whose subtree has changed, after
+// it has been called for any of its children which have changed.  |left| and
+// |right| are the node's children, or nullptr where it has none.
+//
 struct DefaultWAVLTreeObserver {
     static void RecordInsert()               { }
     static void RecordInsertPromote()        { }
@@ -37,6 +43,9 @@ struct DefaultWAVLTreeObserver {
     static void RecordEraseRotation()        { }
     static void RecordEraseDoubleRotation()  { }
 
+    template <typename RawPtrType>
+    static void OnSubtreeChanged(RawPtrType node, RawPtrType left, RawPtrType right) { }
+
     template <typename TreeType>
     static bool VerifyRankRule(const TreeType& tree, typename TreeType::RawPtrType node) {
         return true;
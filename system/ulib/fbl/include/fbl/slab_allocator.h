@@ -6,6 +6,7 @@
 
 #include <zircon/compiler.h>
 #include <fbl/algorithm.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/deleter.h>
 #include <fbl/intrusive_single_list.h>
@@ -17,6 +18,10 @@
 #include <fbl/type_support.h>
 #include <fbl/unique_ptr.h>
 
+#ifdef _KERNEL
+#include <arch/ops.h>
+#endif
+
 // Usage Notes:
 //
 // fbl::SlabAllocator<> is a utility class which implements a slab-style
@@ -95,6 +100,43 @@
 //
 // fbl::SlabAllocator<UnlockedStaticSlabAllocator<fbl::unique_ptr<MyObject>> allocator;
 //
+// :: Magazines ::
+//
+// An allocator with a single lock serializes every New and delete on it.
+// Allocators which are hammered from many threads at once may instead be given
+// a magazine policy (the MagazinePolicy parameter of SlabAllocatorTraits<>).
+// The allocator then keeps an array of magazines, small stacks of free objects
+// each guarded by a lock of their own, and the policy picks which magazine the
+// calling thread uses.
+//
+// ++ New pops an object from the current magazine.  An empty magazine is
+//    refilled with half a magazine's worth of objects in one trip to the
+//    central allocator.  If the central allocator has nothing left either,
+//    the other magazines are searched before the allocation fails, so the
+//    allocator's quota is never stranded in a magazine.
+// ++ Frees push the object onto the current magazine.  A full magazine spills
+//    its colder half onto a lock-free pending list; the central lock is not
+//    taken to free.  The pending list is moved onto the free list the next
+//    time a magazine is refilled.
+//
+// fbl::PerCpuSlabMagazines<> (kernel) and fbl::PerThreadSlabMagazines<>
+// (user mode) are the stock policies.  Since a thread may migrate (or share
+// its magazine with other threads) the magazine lock is still taken, but it
+// is only contended when that happens.
+//
+// ** Example **
+//
+// using MyAllocatorTraits =
+//     fbl::ConcurrentSlabAllocatorTraits<fbl::RefPtr<MyObject>,
+//                                        fbl::PerThreadSlabMagazines<>>;
+// fbl::SlabAllocator<MyAllocatorTraits> allocator(64);
+//
+// :: Statistics ::
+//
+// GetStats(SlabAllocatorStats*) fills out a snapshot of the allocator's slab
+// usage and, for allocators with magazines, how often the magazines were able
+// to satisfy requests without going to the central allocator.
+//
 // :: Object Requirements ::
 //
 // Objects must be small enough that at least 1 can be allocated from a slab
@@ -167,9 +209,10 @@
 //
 // :: API ::
 //
-// The slab allocator API consists of 2 methods.
+// The slab allocator API consists of 3 methods.
 // ++ Ctor(size_t, bool)
 // ++ New(...)
+// ++ GetStats(SlabAllocatorStats*)
 //
 // The allocator constructor takes two arguments.  The first is the maximum
 // number of slabs the allocator is permitted to allocate.  The second is a bool
@@ -283,12 +326,73 @@ enum class SlabAllocatorFlavor {
 template <typename T,
           size_t   SLAB_SIZE,
           typename LockType,
-          SlabAllocatorFlavor AllocatorFlavor> struct SlabAllocatorTraits;
+          SlabAllocatorFlavor AllocatorFlavor,
+          typename MagazinePolicy> struct SlabAllocatorTraits;
 template <typename SATraits, typename = void> class SlabAllocator;
 template <typename SATraits, typename = void> class SlabAllocated;
 
 constexpr size_t DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE = (16 << 10u);
 
+// A snapshot of a slab allocator's bookkeeping, see GetStats.
+struct SlabAllocatorStats {
+    // Slabs allocated so far, and the most the allocator may allocate.
+    size_t slab_count;
+    size_t max_slabs;
+
+    // Objects handed out by the central allocator (directly, or to refill a
+    // magazine) over the life of the allocator.
+    size_t central_allocs;
+
+    // Allocations satisfied by a magazine without going to the central
+    // allocator, and the number of times a full magazine spilled back to the
+    // central allocator.  Both are zero for allocators without magazines.
+    size_t magazine_hits;
+    size_t magazine_spills;
+};
+
+// Magazine policy which gives the allocator no magazines at all; every
+// allocation and free takes the allocator's lock.  This is the default.
+struct NoSlabMagazines {
+    static constexpr size_t kMagazineCount = 0;
+};
+
+// Magazine policies must provide...
+//
+// ++ kMagazineCount : The number of magazines.
+// ++ kMagazineSize  : The number of objects a magazine may hold (at least 2).
+// ++ LockType       : The fbl::AutoLock compatible lock guarding a magazine.
+// ++ CurrentMagazine() : A static method returning the index of the magazine
+//                        the calling thread should use, in the range
+//                        [0, kMagazineCount).
+#ifdef _KERNEL
+// One magazine per cpu.
+template <size_t _MagazineSize = 32u>
+struct PerCpuSlabMagazines {
+    static constexpr size_t kMagazineCount = SMP_MAX_CPUS;
+    static constexpr size_t kMagazineSize = _MagazineSize;
+    using LockType = ::fbl::Mutex;
+
+    static size_t CurrentMagazine() { return arch_curr_cpu_num(); }
+};
+#else
+// Threads are dealt magazines round robin the first time they use any
+// allocator with this policy; with at least as many magazines as busy threads,
+// no two of them share one.
+template <size_t _MagazineCount = 16u, size_t _MagazineSize = 32u>
+struct PerThreadSlabMagazines {
+    static constexpr size_t kMagazineCount = _MagazineCount;
+    static constexpr size_t kMagazineSize = _MagazineSize;
+    using LockType = ::fbl::Mutex;
+
+    static size_t CurrentMagazine() {
+        static atomic<size_t> next_index(0u);
+        static thread_local size_t index =
+            next_index.fetch_add(1u, memory_order_relaxed) % kMagazineCount;
+        return index;
+    }
+};
+#endif
+
 namespace internal {
 
 // internal fwd-decls
@@ -355,6 +459,12 @@ class SlabAllocatorBase {
 protected:
     struct FreeListEntry : public SinglyLinkedListable<FreeListEntry*> { };
 
+    // Objects waiting on the lock-free pending list to be moved onto the free
+    // list.
+    struct PendingFreeEntry {
+        PendingFreeEntry* next;
+    };
+
     struct Slab {
         explicit Slab(size_t initial_bytes_used) : bytes_used_(initial_bytes_used) { }
 
@@ -408,6 +518,9 @@ public:
         size_t allocated_count = 0;
         size_t free_list_size = this->free_list_.size_slow();
 #endif
+        // Nothing can be racing with us to return objects any more.
+        DrainPendingListLocked();
+
         // null out the free list so that it does not assert that we left
         // unmanaged pointers on it as we destruct, and so that the free list
         // does not attempt to auto-destruct the managed objects which were
@@ -436,6 +549,7 @@ protected:
     void* AllocateLocked() {
         // If we can alloc from the free list, do so.
         if (!free_list_.is_empty()) {
+            central_allocs_++;
             return free_list_.pop_front();
         }
 
@@ -443,8 +557,10 @@ protected:
         if (!slab_list_.is_empty()) {
             auto& active_slab = slab_list_.front();
             void* mem = active_slab.Allocate(alloc_size_, slab_storage_limit_);
-            if (mem)
+            if (mem) {
+                central_allocs_++;
                 return mem;
+            }
         }
 
         // If we are allowed to allocate new slabs, try to do so.
@@ -456,6 +572,7 @@ protected:
                 slab_count_++;
                 slab_list_.push_front(slab);
 
+                central_allocs_++;
                 return slab->Allocate(alloc_size_, slab_storage_limit_);
             }
         }
@@ -469,6 +586,60 @@ protected:
         free_list_.push_front(free_obj);
     }
 
+    // Allocates up to |count| objects into |out|, moving any pending frees
+    // onto the free list first.  Returns the number of objects allocated.
+    size_t AllocateBatchLocked(void** out, size_t count) {
+        DrainPendingListLocked();
+
+        size_t allocated = 0;
+        while (allocated < count) {
+            void* mem = AllocateLocked();
+            if (mem == nullptr)
+                break;
+            out[allocated++] = mem;
+        }
+        return allocated;
+    }
+
+    // Pushes |count| objects onto the pending list.  This does not need the
+    // lock: the only consumer takes the entire list at once, so a push can
+    // never observe a head which has been popped and pushed again.
+    void ReturnBatchToPendingList(void* const* ptrs, size_t count) {
+        ZX_DEBUG_ASSERT(count > 0);
+
+        PendingFreeEntry* first = reinterpret_cast<PendingFreeEntry*>(ptrs[0]);
+        PendingFreeEntry* last = first;
+        for (size_t i = 1; i < count; ++i) {
+            last->next = reinterpret_cast<PendingFreeEntry*>(ptrs[i]);
+            last = last->next;
+        }
+
+        uintptr_t head = pending_list_.load(memory_order_relaxed);
+        do {
+            last->next = reinterpret_cast<PendingFreeEntry*>(head);
+        } while (!pending_list_.compare_exchange_weak(&head,
+                                                      reinterpret_cast<uintptr_t>(first),
+                                                      memory_order_release,
+                                                      memory_order_relaxed));
+    }
+
+    void DrainPendingListLocked() {
+        uintptr_t head = pending_list_.exchange(0u, memory_order_acquire);
+        while (head != 0u) {
+            PendingFreeEntry* entry = reinterpret_cast<PendingFreeEntry*>(head);
+            head = reinterpret_cast<uintptr_t>(entry->next);
+            ReturnToFreeListLocked(entry);
+        }
+    }
+
+    void GetStatsLocked(SlabAllocatorStats* stats) const {
+        stats->slab_count = slab_count_;
+        stats->max_slabs = max_slabs_;
+        stats->central_allocs = central_allocs_;
+        stats->magazine_hits = 0;
+        stats->magazine_spills = 0;
+    }
+
 private:
     // Constant properties of the allocator passed to us by our templated
     // wrapper during construction.
@@ -482,6 +653,118 @@ private:
     SinglyLinkedList<FreeListEntry*> free_list_;
     SinglyLinkedList<Slab*>          slab_list_;
     size_t                           slab_count_ = 0;
+    size_t                           central_allocs_ = 0;
+    atomic<uintptr_t>                pending_list_{0u};
+};
+
+// The magazines of an allocator; see "Magazines" above.  |Central| is the
+// internal::SlabAllocator<> owning them.
+template <typename MagazinePolicy, typename = void>
+class SlabMagazines;
+
+// Without magazines every request goes straight to the central allocator.
+template <typename MagazinePolicy>
+class SlabMagazines<MagazinePolicy,
+                    typename enable_if<(MagazinePolicy::kMagazineCount == 0)>::type> {
+public:
+    template <typename Central>
+    void* Allocate(Central* central) { return central->AllocateCentral(); }
+
+    template <typename Central>
+    void Free(Central* central, void* ptr) { central->ReturnToFreeListCentral(ptr); }
+
+    template <typename Central>
+    void Drain(Central* central) { }
+
+    void AddStats(SlabAllocatorStats* stats) { }
+};
+
+template <typename MagazinePolicy>
+class SlabMagazines<MagazinePolicy,
+                    typename enable_if<(MagazinePolicy::kMagazineCount > 0)>::type> {
+public:
+    static constexpr size_t kRounds = MagazinePolicy::kMagazineSize;
+    static_assert(kRounds >= 2, "Slab magazines must hold at least 2 objects");
+
+    template <typename Central>
+    void* Allocate(Central* central) {
+        Magazine& mag = magazines_[CurrentMagazine()];
+        {
+            AutoLock lock(&mag.lock);
+            if (mag.count > 0) {
+                mag.hits++;
+                return mag.rounds[--mag.count];
+            }
+
+            mag.count = central->AllocateBatchCentral(mag.rounds, kRounds / 2);
+            if (mag.count > 0)
+                return mag.rounds[--mag.count];
+        }
+
+        // The central allocator is out of objects; take one from whichever
+        // magazine still has one before giving up.
+        for (auto& other : magazines_) {
+            AutoLock lock(&other.lock);
+            if (other.count > 0)
+                return other.rounds[--other.count];
+        }
+
+        return nullptr;
+    }
+
+    template <typename Central>
+    void Free(Central* central, void* ptr) {
+        Magazine& mag = magazines_[CurrentMagazine()];
+        AutoLock lock(&mag.lock);
+        if (mag.count == kRounds) {
+            // Spill the colder half (the bottom of the stack) and keep the
+            // objects most recently freed.
+            constexpr size_t kSpill = kRounds / 2;
+            central->ReturnBatchCentral(mag.rounds, kSpill);
+            for (size_t i = kSpill; i < kRounds; ++i) {
+                mag.rounds[i - kSpill] = mag.rounds[i];
+            }
+            mag.count -= kSpill;
+            mag.spills++;
+        }
+        mag.rounds[mag.count++] = ptr;
+    }
+
+    template <typename Central>
+    void Drain(Central* central) {
+        for (auto& mag : magazines_) {
+            AutoLock lock(&mag.lock);
+            if (mag.count > 0) {
+                central->ReturnBatchCentral(mag.rounds, mag.count);
+                mag.count = 0;
+            }
+        }
+    }
+
+    void AddStats(SlabAllocatorStats* stats) {
+        for (auto& mag : magazines_) {
+            AutoLock lock(&mag.lock);
+            stats->magazine_hits += mag.hits;
+            stats->magazine_spills += mag.spills;
+        }
+    }
+
+private:
+    struct Magazine {
+        typename MagazinePolicy::LockType lock;
+        size_t count = 0;
+        size_t hits = 0;
+        size_t spills = 0;
+        void* rounds[kRounds];
+    };
+
+    static size_t CurrentMagazine() {
+        size_t index = MagazinePolicy::CurrentMagazine();
+        ZX_DEBUG_ASSERT(index < MagazinePolicy::kMagazineCount);
+        return index;
+    }
+
+    Magazine magazines_[MagazinePolicy::kMagazineCount];
 };
 
 template <typename SATraits>
@@ -529,7 +812,11 @@ public:
                             max_slabs,
                             alloc_initial) { }
 
-    ~SlabAllocator() { }
+    ~SlabAllocator() {
+        // Hand everything parked in the magazines back so that the base class
+        // can account for it.
+        magazines_.Drain(this);
+    }
 
     template <typename... ConstructorSignature>
     PtrType New(ConstructorSignature&&... args) {
@@ -559,16 +846,30 @@ public:
         return PtrTraits::CreatePtr(obj);
     }
 
+    void GetStats(SlabAllocatorStats* stats) {
+        ZX_DEBUG_ASSERT(stats != nullptr);
+        {
+            AutoLock alloc_lock(&alloc_lock_);
+            GetStatsLocked(stats);
+        }
+        magazines_.AddStats(stats);
+    }
+
 protected:
     friend class ::fbl::SlabAllocator<SATraits>;
     friend class ::fbl::SlabAllocated<SATraits>;
+    friend class SlabMagazines<typename SATraits::MagazinePolicy>;
 
-    void* Allocate() {
+    void* Allocate() { return magazines_.Allocate(this); }
+
+    void ReturnToFreeList(void* ptr) { magazines_.Free(this, ptr); }
+
+    void* AllocateCentral() {
         AutoLock alloc_lock(&this->alloc_lock_);
         return AllocateLocked();
     }
 
-    void ReturnToFreeList(void* ptr) {
+    void ReturnToFreeListCentral(void* ptr) {
         FreeListEntry* free_obj = new (ptr) FreeListEntry;
         {
             AutoLock alloc_lock(&alloc_lock_);
@@ -576,7 +877,17 @@ protected:
         }
     }
 
+    size_t AllocateBatchCentral(void** out, size_t count) {
+        AutoLock alloc_lock(&this->alloc_lock_);
+        return AllocateBatchLocked(out, count);
+    }
+
+    void ReturnBatchCentral(void* const* ptrs, size_t count) {
+        ReturnBatchToPendingList(ptrs, count);
+    }
+
     typename SATraits::LockType alloc_lock_;
+    SlabMagazines<typename SATraits::MagazinePolicy> magazines_;
 };
 }  // namespace internal
 
@@ -598,7 +909,7 @@ protected:
 // ++ LockType
 //  The fbl::AutoLock compatible class which will handle synchronization.
 //
-// ++ AllocatorType
+// ++ AllocatorFlavor
 //  Selects between a the three flavors of allocator.
 //  ++ INSTANCED - Allocations come from an instance of an allocator.
 //     Allocation objects carry the overhead of an "origin pointer" which will
@@ -618,16 +929,22 @@ protected:
 //     the object to the allocator it came from.  MANUAL_DELETE allocators are
 //     only permitted for unmanaged pointer types.
 //
+// ++ MagazinePolicy
+//  Selects the magazines (if any) which sit in front of the allocator's lock.
+//  Defaults to NoSlabMagazines.  See "Magazines" above.
+//
 ////////////////////////////////////////////////////////////////////////////////
 template <typename T,
           size_t   _SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
           typename _LockType  = ::fbl::Mutex,
-          SlabAllocatorFlavor _AllocatorFlavor = SlabAllocatorFlavor::INSTANCED>
+          SlabAllocatorFlavor _AllocatorFlavor = SlabAllocatorFlavor::INSTANCED,
+          typename _MagazinePolicy = NoSlabMagazines>
 struct SlabAllocatorTraits {
-    using PtrTraits     = internal::SlabAllocatorPtrTraits<T>;
-    using PtrType       = typename PtrTraits::PtrType;
-    using ObjType       = typename PtrTraits::ObjType;
-    using LockType      = _LockType;
+    using PtrTraits      = internal::SlabAllocatorPtrTraits<T>;
+    using PtrType        = typename PtrTraits::PtrType;
+    using ObjType        = typename PtrTraits::ObjType;
+    using LockType       = _LockType;
+    using MagazinePolicy = _MagazinePolicy;
 
     static constexpr size_t SLAB_SIZE = _SLAB_SIZE;
     static constexpr SlabAllocatorFlavor AllocatorFlavor = _AllocatorFlavor;
@@ -763,6 +1080,22 @@ template <typename T,
 using UnlockedManualDeleteSlabAllocatorTraits =
     SlabAllocatorTraits<T, SLAB_SIZE, ::fbl::NullLock, SlabAllocatorFlavor::MANUAL_DELETE>;
 
+// Shorthand for declaring the properties of instanced and MANUAL_DELETE
+// allocators with magazines.
+template <typename T,
+          typename MagazinePolicy,
+          size_t   SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE>
+using ConcurrentSlabAllocatorTraits =
+    SlabAllocatorTraits<T, SLAB_SIZE, ::fbl::Mutex, SlabAllocatorFlavor::INSTANCED,
+                        MagazinePolicy>;
+
+template <typename T,
+          typename MagazinePolicy,
+          size_t   SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE>
+using ConcurrentManualDeleteSlabAllocatorTraits =
+    SlabAllocatorTraits<T, SLAB_SIZE, ::fbl::Mutex, SlabAllocatorFlavor::MANUAL_DELETE,
+                        MagazinePolicy>;
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Implementation of a static slab allocator.
@@ -791,6 +1124,8 @@ public:
 
     static size_t max_slabs() { return allocator_.max_slabs(); }
 
+    static void GetStats(SlabAllocatorStats* stats) { allocator_.GetStats(stats); }
+
 private:
     friend class SlabAllocated<SATraits>;           // SlabAllocated<> gets to call ReturnToFreeList
     friend class internal::SlabAllocator<SATraits>; // internal::SA<> gets to call ConstructObject
@@ -834,6 +1169,13 @@ template <typename T,
 using UnlockedStaticSlabAllocatorTraits =
     SlabAllocatorTraits<T, SLAB_SIZE, ::fbl::NullLock, SlabAllocatorFlavor::STATIC>;
 
+template <typename T,
+          typename MagazinePolicy,
+          size_t   SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE>
+using ConcurrentStaticSlabAllocatorTraits =
+    SlabAllocatorTraits<T, SLAB_SIZE, ::fbl::Mutex, SlabAllocatorFlavor::STATIC,
+                        MagazinePolicy>;
+
 // Shorthand for declaring the global storage required for a static allocator
 #define DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(ALLOC_TRAITS, ...) \
 template<> ::fbl::SlabAllocator<ALLOC_TRAITS>::InternalAllocatorType \
@@ -0,0 +1,567 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <zircon/device/vfs.h>
+#include <zircon/listnode.h>
+#include <zircon/syscalls.h>
+
+#include <fdio/cache.h>
+#include <fdio/remoteio.h>
+#include <fdio/vfs.h>
+
+#include "private.h"
+#include "unistd.h"
+
+// Entries are keyed by directory and name. Each directory we cache names
+// for is held open with a watcher on it, which is drained before the
+// directory's entries are trusted; that way creations, unlinks and renames,
+// ours or anyone else's, are never missed. Directories which cannot be
+// watched are not cached at all.
+
+// Most directories held open at once, each costing a connection and a
+// watcher channel on the server.
+#define CACHE_MAX_DIRS 64
+
+#define CACHE_DEFAULT_LEASE ZX_SEC(1)
+
+typedef struct cache_dir {
+    list_node_t node;
+    list_node_t entries;
+    uint64_t id;
+    // Bumped for every event seen, so that a lookup which raced with one is
+    // not cached.
+    uint64_t gen;
+    fdio_t* io;
+    zx_handle_t watcher;
+    char path[];
+} cache_dir_t;
+
+typedef struct cache_entry {
+    list_node_t lru_node;
+    list_node_t hash_node;
+    list_node_t dir_node;
+    cache_dir_t* dir;
+    uint32_t hash;
+    // ZX_OK, or ZX_ERR_NOT_FOUND for a name known not to exist.
+    zx_status_t status;
+    zx_time_t expires;
+    vnattr_t attr;
+    char name[];
+} cache_entry_t;
+
+static mtx_t cache_lock = MTX_INIT;
+static atomic_bool cache_enabled;
+static size_t cache_max_entries;
+static zx_duration_t cache_lease;
+static uint64_t cache_next_id;
+
+// Most recently used first, for both.
+static list_node_t cache_dirs = LIST_INITIAL_VALUE(cache_dirs);
+static list_node_t cache_lru = LIST_INITIAL_VALUE(cache_lru);
+
+static list_node_t* cache_buckets;
+static size_t cache_bucket_mask;
+
+static fdio_cache_stats_t cache_stats;
+
+static uint32_t cache_hash(uint64_t id, const char* name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(id); i++) {
+        hash = (hash ^ (uint8_t)(id >> (i * 8))) * 16777619u;
+    }
+    for (; *name; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619u;
+    }
+    return hash;
+}
+
+// Resolves |path|, relative to |dirfd|, to the absolute path of the
+// directory containing it and its final name. Only absolute paths and
+// paths relative to the cwd can be cached, and not those which name a
+// directory by a trailing slash or dot.
+static bool cache_resolve(int dirfd, const char* path,
+                          char dirpath[PATH_MAX], char name[NAME_MAX + 1]) {
+    if (path == NULL || path[0] == 0) {
+        return false;
+    }
+    if (path[0] != '/') {
+        if (dirfd != AT_FDCWD) {
+            return false;
+        }
+        bool ok;
+        mtx_lock(&fdio_cwd_lock);
+        size_t len = strlen(fdio_cwd_path);
+        ok = (fdio_cwd_path[0] == '/') && (len + 1 + strlen(path) < PATH_MAX);
+        if (ok) {
+            memcpy(dirpath, fdio_cwd_path, len);
+            dirpath[len] = '/';
+            strcpy(dirpath + len + 1, path);
+        }
+        mtx_unlock(&fdio_cwd_lock);
+        if (!ok) {
+            return false;
+        }
+        path = dirpath;
+    }
+
+    char clean[PATH_MAX];
+    size_t len;
+    bool is_dir;
+    if (__fdio_cleanpath(path, clean, &len, &is_dir) != ZX_OK || is_dir) {
+        return false;
+    }
+    char* slash = strrchr(clean, '/');
+    if (strlen(slash + 1) > NAME_MAX) {
+        return false;
+    }
+    strcpy(name, slash + 1);
+    if (slash == clean) {
+        strcpy(dirpath, "/");
+    } else {
+        *slash = 0;
+        strcpy(dirpath, clean);
+    }
+    return true;
+}
+
+static cache_entry_t* cache_find_entry(cache_dir_t* dir, const char* name, uint32_t hash) {
+    cache_entry_t* entry;
+    list_for_every_entry (&cache_buckets[hash & cache_bucket_mask], entry,
+                          cache_entry_t, hash_node) {
+        if (entry->hash == hash && entry->dir == dir && !strcmp(entry->name, name)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void cache_drop_entry(cache_entry_t* entry) {
+    list_delete(&entry->lru_node);
+    list_delete(&entry->hash_node);
+    list_delete(&entry->dir_node);
+    cache_stats.entries--;
+    free(entry);
+}
+
+static void cache_insert_entry(cache_dir_t* dir, const char* name, uint32_t hash,
+                               zx_status_t status, const vnattr_t* attr) {
+    while (cache_stats.entries >= cache_max_entries) {
+        cache_drop_entry(list_peek_tail_type(&cache_lru, cache_entry_t, lru_node));
+        cache_stats.evictions++;
+    }
+    size_t len = strlen(name);
+    cache_entry_t* entry = malloc(sizeof(cache_entry_t) + len + 1);
+    if (entry == NULL) {
+        return;
+    }
+    entry->dir = dir;
+    entry->hash = hash;
+    entry->status = status;
+    entry->expires = zx_deadline_after(cache_lease);
+    if (attr != NULL) {
+        entry->attr = *attr;
+    }
+    memcpy(entry->name, name, len + 1);
+    list_add_head(&cache_lru, &entry->lru_node);
+    list_add_head(&cache_buckets[hash & cache_bucket_mask], &entry->hash_node);
+    list_add_head(&dir->entries, &entry->dir_node);
+    cache_stats.entries++;
+}
+
+// Unlinks |dir| and drops its entries. The caller frees it, with
+// cache_free_dir(), once the cache lock is released.
+static void cache_drop_dir(cache_dir_t* dir) {
+    cache_entry_t* entry;
+    while ((entry = list_peek_head_type(&dir->entries, cache_entry_t, dir_node)) != NULL) {
+        cache_drop_entry(entry);
+    }
+    list_delete(&dir->node);
+    cache_stats.dirs--;
+}
+
+static void cache_free_dir(cache_dir_t* dir) {
+    if (dir == NULL) {
+        return;
+    }
+    zx_handle_close(dir->watcher);
+    fdio_close(dir->io);
+    fdio_release(dir->io);
+    free(dir);
+}
+
+// Applies whatever the watcher has reported since we last looked. Returns
+// false if the watch has gone away, or reported something we cannot make
+// sense of, in which case the directory must be dropped.
+static bool cache_sync_dir(cache_dir_t* dir) {
+    for (;;) {
+        uint8_t msg[sizeof(vfs_watch_msg_t) + VFS_WATCH_NAME_MAX + 1];
+        uint32_t sz;
+        zx_status_t status = zx_channel_read(dir->watcher, 0, msg, NULL, sizeof(msg) - 1, 0,
+                                             &sz, NULL);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            return true;
+        } else if (status != ZX_OK) {
+            return false;
+        }
+        dir->gen++;
+
+        uint8_t* ptr = msg;
+        while (sz >= sizeof(vfs_watch_msg_t)) {
+            vfs_watch_msg_t* vmsg = (vfs_watch_msg_t*)ptr;
+            size_t len = sizeof(vfs_watch_msg_t) + vmsg->len;
+            if (len > sz) {
+                return false;
+            }
+            if (vmsg->event == VFS_WATCH_EVT_ADDED || vmsg->event == VFS_WATCH_EVT_REMOVED) {
+                // Terminate the name in place, putting back the byte after
+                // it, which may start the next message.
+                uint8_t tmp = ptr[len];
+                ptr[len] = 0;
+                cache_entry_t* entry = cache_find_entry(dir, vmsg->name,
+                                                        cache_hash(dir->id, vmsg->name));
+                ptr[len] = tmp;
+                if (entry != NULL) {
+                    cache_drop_entry(entry);
+                    cache_stats.invalidations++;
+                }
+            }
+            ptr += len;
+            sz -= len;
+        }
+    }
+}
+
+// Finds the directory at |path|, or with |id| if |path| is NULL, and brings
+// its entries up to date. A directory found to be no longer watched is
+// dropped and returned through |stale| to be freed.
+static cache_dir_t* cache_find_dir(const char* path, uint64_t id, cache_dir_t** stale) {
+    cache_dir_t* dir;
+    list_for_every_entry (&cache_dirs, dir, cache_dir_t, node) {
+        if ((path != NULL) ? !strcmp(dir->path, path) : (dir->id == id)) {
+            if (!cache_sync_dir(dir)) {
+                cache_drop_dir(dir);
+                *stale = dir;
+                return NULL;
+            }
+            list_delete(&dir->node);
+            list_add_head(&cache_dirs, &dir->node);
+            return dir;
+        }
+    }
+    return NULL;
+}
+
+// Opens the directory at |path| and starts watching it.
+static zx_status_t cache_open_dir(const char* path, cache_dir_t** out) {
+    size_t len = strlen(path);
+    cache_dir_t* dir = malloc(sizeof(cache_dir_t) + len + 1);
+    if (dir == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status;
+    if ((status = __fdio_open(&dir->io, path, O_RDONLY | O_DIRECTORY, 0)) != ZX_OK) {
+        free(dir);
+        return status;
+    }
+    vfs_watch_dir_t wd = {
+        .mask = VFS_WATCH_MASK_ADDED | VFS_WATCH_MASK_REMOVED,
+        .options = 0,
+    };
+    if ((status = zx_channel_create(0, &wd.channel, &dir->watcher)) != ZX_OK) {
+        fdio_close(dir->io);
+        fdio_release(dir->io);
+        free(dir);
+        return status;
+    }
+    ssize_t r = dir->io->ops->ioctl(dir->io, IOCTL_VFS_WATCH_DIR, &wd, sizeof(wd), NULL, 0);
+    if (r < 0) {
+        zx_handle_close(dir->watcher);
+        fdio_close(dir->io);
+        fdio_release(dir->io);
+        free(dir);
+        return (zx_status_t)r;
+    }
+    list_initialize(&dir->entries);
+    dir->gen = 0;
+    memcpy(dir->path, path, len + 1);
+    *out = dir;
+    return ZX_OK;
+}
+
+// Looks |name| up in |io| and fetches its attributes, as fstatat() would.
+static zx_status_t cache_lookup(fdio_t* io, const char* name, vnattr_t* attr) {
+    fdio_t* child;
+    zx_status_t status = io->ops->open(io, name, ZX_FS_RIGHT_READABLE | ZX_FS_FLAG_DESCRIBE |
+                                       ZX_FS_FLAG_VNODE_REF_ONLY, 0, &child);
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = child->ops->misc(child, ZXRIO_STAT, 0, sizeof(*attr), attr, 0);
+    if (status >= 0) {
+        status = (status < (zx_status_t)sizeof(*attr)) ? ZX_ERR_IO : ZX_OK;
+    }
+    fdio_close(child);
+    fdio_release(child);
+    return status;
+}
+
+zx_status_t __fdio_cache_getattr(int dirfd, const char* path, vnattr_t* attr) {
+    if (!atomic_load(&cache_enabled)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    char dirpath[PATH_MAX];
+    char name[NAME_MAX + 1];
+    if (!cache_resolve(dirfd, path, dirpath, name)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    cache_dir_t* dir;
+    cache_dir_t* stale = NULL;
+    cache_dir_t* evicted = NULL;
+    cache_dir_t* created = NULL;
+    fdio_t* io = NULL;
+    uint64_t id = 0;
+    uint64_t gen = 0;
+    zx_status_t status = ZX_ERR_NOT_SUPPORTED;
+
+    mtx_lock(&cache_lock);
+    if (cache_max_entries == 0) {
+        goto done;
+    }
+    dir = cache_find_dir(dirpath, 0, &stale);
+    if (dir != NULL) {
+        uint32_t hash = cache_hash(dir->id, name);
+        cache_entry_t* entry = cache_find_entry(dir, name, hash);
+        if (entry != NULL) {
+            if (entry->status != ZX_OK) {
+                cache_stats.negative_hits++;
+                status = entry->status;
+                goto done;
+            } else if (zx_clock_get(ZX_CLOCK_MONOTONIC) < entry->expires) {
+                list_delete(&entry->lru_node);
+                list_add_head(&cache_lru, &entry->lru_node);
+                cache_stats.hits++;
+                *attr = entry->attr;
+                status = ZX_OK;
+                goto done;
+            }
+            cache_drop_entry(entry);
+            cache_stats.expired++;
+        }
+        io = dir->io;
+        fdio_acquire(io);
+        id = dir->id;
+        gen = dir->gen;
+    }
+    cache_stats.misses++;
+    mtx_unlock(&cache_lock);
+    cache_free_dir(stale);
+    stale = NULL;
+
+    if (io == NULL) {
+        // Not watchable, or otherwise unusable: leave the lookup to the
+        // caller, and try again next time.
+        if (cache_open_dir(dirpath, &created) != ZX_OK) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        mtx_lock(&cache_lock);
+        if (cache_max_entries == 0) {
+            goto done;
+        }
+        dir = cache_find_dir(dirpath, 0, &stale);
+        if (dir == NULL) {
+            if (cache_stats.dirs >= CACHE_MAX_DIRS) {
+                evicted = list_peek_tail_type(&cache_dirs, cache_dir_t, node);
+                cache_drop_dir(evicted);
+                cache_stats.evictions++;
+            }
+            dir = created;
+            created = NULL;
+            dir->id = cache_next_id++;
+            list_add_head(&cache_dirs, &dir->node);
+            cache_stats.dirs++;
+        }
+        io = dir->io;
+        fdio_acquire(io);
+        id = dir->id;
+        gen = dir->gen;
+        mtx_unlock(&cache_lock);
+        cache_free_dir(stale);
+        cache_free_dir(evicted);
+        cache_free_dir(created);
+        stale = NULL;
+        evicted = NULL;
+        created = NULL;
+    }
+
+    status = cache_lookup(io, name, attr);
+    fdio_release(io);
+    if (status != ZX_OK && status != ZX_ERR_NOT_FOUND) {
+        // Let the caller make the lookup the usual way, and report it.
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    mtx_lock(&cache_lock);
+    if (cache_max_entries == 0) {
+        goto done;
+    }
+    dir = cache_find_dir(NULL, id, &stale);
+    if (dir != NULL && dir->gen == gen) {
+        uint32_t hash = cache_hash(id, name);
+        if (cache_find_entry(dir, name, hash) == NULL) {
+            cache_insert_entry(dir, name, hash, status, (status == ZX_OK) ? attr : NULL);
+        }
+    }
+
+done:
+    mtx_unlock(&cache_lock);
+    cache_free_dir(stale);
+    cache_free_dir(evicted);
+    cache_free_dir(created);
+    return status;
+}
+
+bool __fdio_cache_missing(int dirfd, const char* path) {
+    if (!atomic_load(&cache_enabled)) {
+        return false;
+    }
+    char dirpath[PATH_MAX];
+    char name[NAME_MAX + 1];
+    if (!cache_resolve(dirfd, path, dirpath, name)) {
+        return false;
+    }
+
+    bool missing = false;
+    cache_dir_t* stale = NULL;
+    mtx_lock(&cache_lock);
+    if (cache_max_entries > 0) {
+        cache_dir_t* dir = cache_find_dir(dirpath, 0, &stale);
+        if (dir != NULL) {
+            cache_entry_t* entry = cache_find_entry(dir, name, cache_hash(dir->id, name));
+            if (entry != NULL && entry->status == ZX_ERR_NOT_FOUND) {
+                cache_stats.negative_hits++;
+                missing = true;
+            }
+        }
+    }
+    mtx_unlock(&cache_lock);
+    cache_free_dir(stale);
+    return missing;
+}
+
+void __fdio_cache_invalidate(int dirfd, const char* path) {
+    if (!atomic_load(&cache_enabled)) {
+        return;
+    }
+    char dirpath[PATH_MAX];
+    char name[NAME_MAX + 1];
+    if (!cache_resolve(dirfd, path, dirpath, name)) {
+        // We cannot tell which entry |path| is, so drop them all.
+        __fdio_cache_flush();
+        return;
+    }
+
+    cache_dir_t* stale = NULL;
+    mtx_lock(&cache_lock);
+    if (cache_max_entries > 0) {
+        cache_dir_t* dir = cache_find_dir(dirpath, 0, &stale);
+        if (dir != NULL) {
+            cache_entry_t* entry = cache_find_entry(dir, name, cache_hash(dir->id, name));
+            if (entry != NULL) {
+                cache_drop_entry(entry);
+                cache_stats.invalidations++;
+            }
+        }
+    }
+    mtx_unlock(&cache_lock);
+    cache_free_dir(stale);
+}
+
+// Drops every directory, and so every entry, onto |dirs|. The caller frees
+// them with cache_free_dirs() once the cache lock is released.
+static void cache_drop_dirs(list_node_t* dirs) {
+    cache_dir_t* dir;
+    while ((dir = list_peek_head_type(&cache_dirs, cache_dir_t, node)) != NULL) {
+        cache_drop_dir(dir);
+        list_add_tail(dirs, &dir->node);
+    }
+}
+
+static void cache_free_dirs(list_node_t* dirs) {
+    cache_dir_t* dir;
+    while ((dir = list_remove_head_type(dirs, cache_dir_t, node)) != NULL) {
+        cache_free_dir(dir);
+    }
+}
+
+void __fdio_cache_flush(void) {
+    if (!atomic_load(&cache_enabled)) {
+        return;
+    }
+    list_node_t dirs = LIST_INITIAL_VALUE(dirs);
+    mtx_lock(&cache_lock);
+    cache_stats.invalidations += cache_stats.entries;
+    cache_drop_dirs(&dirs);
+    mtx_unlock(&cache_lock);
+    cache_free_dirs(&dirs);
+}
+
+void __fdio_cache_init(void) {
+    const char* env = getenv("FDIO_CACHE");
+    if (env == NULL) {
+        return;
+    }
+    char* end;
+    size_t max_entries = strtoul(env, &end, 10);
+    zx_duration_t lease = CACHE_DEFAULT_LEASE;
+    if (*end == ',') {
+        lease = ZX_MSEC(strtoul(end + 1, NULL, 10));
+    }
+    fdio_cache_configure(max_entries, lease);
+}
+
+zx_status_t fdio_cache_configure(size_t max_entries, zx_duration_t lease) {
+    list_node_t* buckets = NULL;
+    size_t nbuckets = 0;
+    if (max_entries > 0) {
+        for (nbuckets = 1; nbuckets < max_entries; nbuckets <<= 1) {
+        }
+        if ((buckets = malloc(nbuckets * sizeof(list_node_t))) == NULL) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < nbuckets; i++) {
+            list_initialize(&buckets[i]);
+        }
+    }
+
+    list_node_t dirs = LIST_INITIAL_VALUE(dirs);
+    mtx_lock(&cache_lock);
+    cache_drop_dirs(&dirs);
+    list_node_t* old = cache_buckets;
+    cache_buckets = buckets;
+    cache_bucket_mask = nbuckets - 1;
+    cache_max_entries = max_entries;
+    cache_lease = lease;
+    memset(&cache_stats, 0, sizeof(cache_stats));
+    atomic_store(&cache_enabled, max_entries > 0);
+    mtx_unlock(&cache_lock);
+
+    free(old);
+    cache_free_dirs(&dirs);
+    return ZX_OK;
+}
+
+void fdio_cache_get_stats(fdio_cache_stats_t* out) {
+    mtx_lock(&cache_lock);
+    *out = cache_stats;
+    mtx_unlock(&cache_lock);
+}
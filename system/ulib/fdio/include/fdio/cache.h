@@ -0,0 +1,56 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// fdio can remember, on the client side, which absolute paths exist and
+// what their attributes are, so that repeated stat() and access() calls,
+// and open() calls for names known not to exist, need not go to the
+// filesystem server each time.
+//
+// Entries are only kept for directories which support watching, and are
+// dropped as soon as the directory watcher reports the name added or
+// removed. Attributes are only trusted for the lease given below, since
+// writes to a file are not reported by the watcher.
+//
+// The cache is off by default. It may also be enabled at process start by
+// setting FDIO_CACHE to "<max_entries>[,<lease_ms>]" in the environment.
+
+typedef struct fdio_cache_stats {
+    // Lookups answered from the cache, with attributes or as not found.
+    uint64_t hits;
+    uint64_t negative_hits;
+
+    // Lookups which went to the server, and the subset of those which found
+    // an entry whose lease had run out.
+    uint64_t misses;
+    uint64_t expired;
+
+    // Entries dropped because of a watcher event or a local change, and
+    // because the cache was full.
+    uint64_t invalidations;
+    uint64_t evictions;
+
+    // Current number of entries, and of directories held open for them.
+    uint32_t entries;
+    uint32_t dirs;
+} fdio_cache_stats_t;
+
+// Enables the cache with room for |max_entries| lookups, trusting cached
+// attributes for |lease|. A |max_entries| of zero disables the cache. Any
+// entries already cached are flushed either way.
+zx_status_t fdio_cache_configure(size_t max_entries, zx_duration_t lease);
+
+// Returns the cache's counters since it was last configured.
+void fdio_cache_get_stats(fdio_cache_stats_t* out);
+
+__END_CDECLS
@@ -60,7 +60,10 @@ __BEGIN_CDECLS
 #define ZXRIO_LINK        (0x0000001a | ZXRIO_ONE_HANDLE)
 #define ZXRIO_MMAP         0x0000001b
 #define ZXRIO_FCNTL        0x0000001c
-#define ZXRIO_NUM_OPS      29
+#define ZXRIO_READ_VMO    (0x0000001d | ZXRIO_ONE_HANDLE)
+#define ZXRIO_WRITE_VMO   (0x0000001e | ZXRIO_ONE_HANDLE)
+#define ZXRIO_MSYNC        0x0000001f
+#define ZXRIO_NUM_OPS      32
 
 // Control Ordinals; unsolicited messages from
 // the server to the client.
@@ -77,7 +80,8 @@ __BEGIN_CDECLS
     "read_at", "write_at", "truncate", "rename", \
     "connect", "bind", "listen", "getsockname", \
     "getpeername", "getsockopt", "setsockopt", "getaddrinfo", \
-    "setattr", "sync", "link", "mmap", "fcntl" }
+    "setattr", "sync", "link", "mmap", "fcntl", \
+    "read_vmo", "write_vmo", "msync" }
 
 // dispatcher callback return code that there were no messages to read
 #define ERR_DISPATCHER_NO_WORK ZX_ERR_SHOULD_WAIT
@@ -221,8 +225,21 @@ typedef struct zxrio_mmap_data {
     int32_t flags;
 } zxrio_mmap_data_t;
 
+// Return once the data has reached storage, rather than once it is queued.
+#define FDIO_MSYNC_FLAG_SYNC   (1u << 0)
+
+typedef struct zxrio_msync_data {
+    uint64_t offset;
+    uint64_t length;
+    uint32_t flags;
+} zxrio_msync_data_t;
+
 static_assert(FDIO_CHUNK_SIZE >= PATH_MAX, "FDIO_CHUNK_SIZE must be large enough to contain paths");
 
+// Offset for READ_VMO and WRITE_VMO which asks for a transfer at, and
+// moving, the seek offset of the connection, as READ and WRITE would.
+#define ZXRIO_VMO_SEEK_OFFSET (-1)
+
 #define READDIR_CMD_NONE  0
 #define READDIR_CMD_RESET 1
 
@@ -259,6 +276,14 @@ static_assert(FDIO_CHUNK_SIZE >= PATH_MAX, "FDIO_CHUNK_SIZE must be large enough
 // LINK        0          0        <name1>0<name2>0  0           -               -
 // MMAP        maxreply   0        mmap_data_msg     0           mmap_data_msg   vmohandle
 // FCNTL       cmd        flags    0                 flags       -               -
+// READ_VMO    len        offset   -                 newoffset   -               -
+// WRITE_VMO   len        offset   -                 newoffset   -               -
+// MSYNC       0          0        msync_data_msg    0           -               -
+//
+// READ_VMO and WRITE_VMO carry a vmo handle, whose first len bytes the
+// server fills or takes the data from, so that a large transfer needs one
+// message rather than one per FDIO_CHUNK_SIZE. An offset of
+// ZXRIO_VMO_SEEK_OFFSET uses the seek offset, which is returned in arg2.
 //
 // proposed:
 //
@@ -612,16 +612,12 @@ zx_status_t fdio_ns_bind_fd(fdio_ns_t* ns, const char* path, int fd) {
 
     if (type[0] != PA_FDIO_REMOTE) {
         // wrong type, discard handles
-        for (int n = 0; n < r; n++) {
-            zx_handle_close(handle[n]);
-        }
+        zx_handle_close_many(handle, r);
         return ZX_ERR_WRONG_TYPE;
     }
 
     // close any aux handles, then do the actual bind
-    for (int n = 1; n < r; n++) {
-        zx_handle_close(handle[n]);
-    }
+    zx_handle_close_many(&handle[1], r - 1);
     if ((r = fdio_ns_bind(ns, path, handle[0])) < 0) {
         zx_handle_close(handle[0]);
     }
@@ -768,9 +764,7 @@ zx_status_t fdio_ns_export(fdio_ns_t* ns, fdio_flat_namespace_t** out) {
     mtx_unlock(&ns->lock);
 
     if (status < 0) {
-        for (size_t n = 0; n < es.count; n++) {
-            zx_handle_close(es.handle[n]);
-        }
+        zx_handle_close_many(es.handle, es.count);
         free(flat);
     } else {
         flat->count = es.count;
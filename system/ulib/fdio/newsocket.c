@@ -410,6 +410,37 @@ static ssize_t zxsio_write_dgram(fdio_t* io, const void* data, size_t len) {
     return zxsio_sendmsg_dgram(io, &msg, 0);
 }
 
+// Copies out a datagram with |n| bytes of data following its header.
+// |truncated| is set if the datagram had more data than that.
+static ssize_t zxsio_unpack_dgram(struct msghdr* msg, const fdio_socket_msg_t* m, size_t n,
+                                  bool truncated) {
+    if (msg->msg_name != NULL) {
+        int bytes_to_copy = (msg->msg_namelen < m->addrlen) ? msg->msg_namelen : m->addrlen;
+        memcpy(msg->msg_name, &m->addr, bytes_to_copy);
+    }
+    msg->msg_namelen = m->addrlen;
+    msg->msg_flags = m->flags;
+    const char* data = m->data;
+    size_t resid = n;
+    for (int i = 0; i < msg->msg_iovlen; i++) {
+        struct iovec *iov = &msg->msg_iov[i];
+        if (resid == 0) {
+            iov->iov_len = 0;
+        } else {
+            if (resid < iov->iov_len)
+                iov->iov_len = resid;
+            memcpy(iov->iov_base, data, iov->iov_len);
+            data += iov->iov_len;
+            resid -= iov->iov_len;
+        }
+    }
+
+    if (resid > 0 || truncated) {
+        msg->msg_flags |= MSG_TRUNC;
+    }
+    return n - resid;
+}
+
 static ssize_t zxsio_recvmsg_dgram(fdio_t* io, struct msghdr* msg, int flags) {
     if (flags != 0) {
         // TODO: support MSG_OOB
@@ -437,33 +468,7 @@ static ssize_t zxsio_recvmsg_dgram(fdio_t* io, struct msghdr* msg, int flags) {
         free(m);
         return ZX_ERR_INTERNAL;
     }
-    n -= FDIO_SOCKET_MSG_HEADER_SIZE;
-    if (msg->msg_name != NULL) {
-        int bytes_to_copy = (msg->msg_namelen < m->addrlen) ? msg->msg_namelen : m->addrlen;
-        memcpy(msg->msg_name, &m->addr, bytes_to_copy);
-    }
-    msg->msg_namelen = m->addrlen;
-    msg->msg_flags = m->flags;
-    char* data = m->data;
-    size_t resid = n;
-    for (int i = 0; i < msg->msg_iovlen; i++) {
-        struct iovec *iov = &msg->msg_iov[i];
-        if (resid == 0) {
-            iov->iov_len = 0;
-        } else {
-            if (resid < iov->iov_len)
-                iov->iov_len = resid;
-            memcpy(iov->iov_base, data, iov->iov_len);
-            data += iov->iov_len;
-            resid -= iov->iov_len;
-        }
-    }
-
-    if (resid > 0) {
-        msg->msg_flags |= MSG_TRUNC;
-        n -= resid;
-    }
-
+    n = zxsio_unpack_dgram(msg, m, n - FDIO_SOCKET_MSG_HEADER_SIZE, false);
     free(m);
     return n;
 }
@@ -795,6 +800,102 @@ void fdio_socket_set_stream_ops(fdio_t* io) {
     sio->io.ops = &fdio_socket_stream_ops;
 }
 
+// The most a batch of datagrams read by recvmmsg() is allowed to take up.
+#define ZXSIO_MMSG_BUFFER_MAX (64u * 1024u)
+
+ssize_t fdio_socket_recvmmsg(fdio_t* io, struct mmsghdr* msgvec, unsigned int vlen,
+                             int flags, zx_time_t deadline) {
+    zxsio_t* sio = (zxsio_t*)io;
+    if (io->ops != &fdio_socket_dgram_ops) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (flags & ~(MSG_DONTWAIT | MSG_WAITFORONE)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (vlen == 0) {
+        return 0;
+    }
+
+    // The kernel reads each datagram into a slot of the same size, so size
+    // the slots for the largest of the messages.
+    size_t max_len = 0;
+    for (unsigned int i = 0; i < vlen; i++) {
+        const struct msghdr* msg = &msgvec[i].msg_hdr;
+        size_t len = 0;
+        for (int j = 0; j < msg->msg_iovlen; j++) {
+            if (msg->msg_iov[j].iov_len <= 0) {
+                return ZX_ERR_INVALID_ARGS;
+            }
+            len += msg->msg_iov[j].iov_len;
+        }
+        if (len > max_len) {
+            max_len = len;
+        }
+    }
+    const size_t need = sizeof(zx_socket_datagram_t) + FDIO_SOCKET_MSG_HEADER_SIZE + max_len;
+    uint32_t order = ZX_SOCKET_SLOT_MIN_ORDER;
+    while (order < ZX_SOCKET_SLOT_MAX_ORDER && ((size_t)1 << order) < need) {
+        order++;
+    }
+    size_t slots = ZXSIO_MMSG_BUFFER_MAX >> order;
+    if (slots > vlen) {
+        slots = vlen;
+    }
+
+    char* buf = malloc(slots << order);
+    if (buf == NULL) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Only wait for the first datagram; the rest are whatever came with it.
+    bool nonblock = (io->ioflag & IOFLAG_NONBLOCK) || (flags & MSG_DONTWAIT);
+    size_t actual;
+    zx_status_t r;
+    for (;;) {
+        r = zx_socket_read(sio->s, ZX_SOCKET_DATAGRAM_BATCH | ZX_SOCKET_SLOT_ORDER(order),
+                           buf, slots << order, &actual);
+        if (r != ZX_ERR_SHOULD_WAIT || nonblock) {
+            break;
+        }
+        zx_signals_t pending;
+        r = zx_object_wait_one(sio->s,
+                               ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED | ZX_SOCKET_READ_DISABLED,
+                               deadline, &pending);
+        if (r == ZX_ERR_TIMED_OUT) {
+            r = ZX_ERR_SHOULD_WAIT;
+            break;
+        }
+        if (r < 0) {
+            break;
+        }
+        if (!(pending & ZX_SOCKET_READABLE)) {
+            r = ZX_ERR_PEER_CLOSED;
+            break;
+        }
+    }
+    if (r != ZX_OK) {
+        free(buf);
+        // As with read(), a closed socket has nothing more to give.
+        return (r == ZX_ERR_PEER_CLOSED || r == ZX_ERR_BAD_STATE) ? 0 : r;
+    }
+
+    size_t count = actual >> order;
+    for (size_t i = 0; i < count; i++) {
+        const char* slot = buf + (i << order);
+        const zx_socket_datagram_t* header = (const zx_socket_datagram_t*)slot;
+        if (header->actual < FDIO_SOCKET_MSG_HEADER_SIZE) {
+            free(buf);
+            return i > 0 ? (ssize_t)i : ZX_ERR_INTERNAL;
+        }
+        const fdio_socket_msg_t* m = (const fdio_socket_msg_t*)(slot + sizeof(*header));
+        msgvec[i].msg_len = zxsio_unpack_dgram(&msgvec[i].msg_hdr, m,
+                                               header->actual - FDIO_SOCKET_MSG_HEADER_SIZE,
+                                               header->actual < header->size);
+    }
+    free(buf);
+    return count;
+}
+
 void fdio_socket_set_dgram_ops(fdio_t* io) {
     zxsio_t* sio = (zxsio_t*)io;
     sio->io.ops = &fdio_socket_dgram_ops;
@@ -0,0 +1,170 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+#include <fdio/limits.h>
+
+#include "private.h"
+
+// poll() and select() wait on a port which keeps a repeating registration
+// for each fd they have waited on, rather than having zx_object_wait_many()
+// attach and detach an observer to every handle on every call.
+//
+// A registration lasts until the fd is waited on with a different fdio
+// object, handle or set of signals.  Its packets record which signals have
+// been seen; since a packet is not a promise that the signals are still
+// asserted, those are checked again with zx_object_wait_one() before they
+// are reported.
+//
+// Only one thread uses the port at a time.  Others fall back to
+// zx_object_wait_many(), as do calls which cannot register every fd
+// (including those which list an fd twice with different signals).
+
+typedef struct {
+    // Holds a reference, so that it cannot be mistaken for a new object
+    // which happens to be allocated at the same address.
+    fdio_t* io;
+    zx_handle_t handle;
+    zx_signals_t signals;
+    // Signals reported by packets which have not been checked yet.
+    zx_signals_t seen;
+    // Distinguishes packets for this registration from those for earlier
+    // registrations of the same fd, which may still be queued.
+    uint32_t gen;
+} fdio_poll_entry_t;
+
+static struct {
+    mtx_t lock;
+    zx_handle_t port;
+    uint32_t gen;
+    fdio_poll_entry_t entries[FDIO_MAX_FD];
+} fdio_pollset = {
+    .lock = MTX_INIT,
+    .port = ZX_HANDLE_INVALID,
+};
+
+static inline uint64_t poll_key(int fd, uint32_t gen) {
+    return ((uint64_t)gen << 32) | (uint32_t)fd;
+}
+
+// Registrations made after |min_gen| belong to the current call and must
+// not be replaced.
+static zx_status_t poll_register(int fd, fdio_t* io, const zx_wait_item_t* item,
+                                 uint32_t min_gen) {
+    fdio_poll_entry_t* entry = &fdio_pollset.entries[fd];
+    if (entry->io == io && entry->handle == item->handle && entry->signals == item->waitfor) {
+        return ZX_OK;
+    }
+    if (entry->io != NULL && entry->gen > min_gen) {
+        return ZX_ERR_ALREADY_BOUND;
+    }
+
+    if (entry->io != NULL) {
+        // Fails harmlessly if the handle has been closed.
+        zx_port_cancel(fdio_pollset.port, entry->handle, poll_key(fd, entry->gen));
+        fdio_release(entry->io);
+        entry->io = NULL;
+    }
+
+    uint32_t gen = ++fdio_pollset.gen;
+    zx_status_t status = zx_object_wait_async(item->handle, fdio_pollset.port,
+                                              poll_key(fd, gen), item->waitfor,
+                                              ZX_WAIT_ASYNC_REPEATING);
+    if (status != ZX_OK) {
+        return status;
+    }
+    fdio_acquire(io);
+    entry->io = io;
+    entry->handle = item->handle;
+    entry->signals = item->waitfor;
+    entry->seen = 0u;
+    entry->gen = gen;
+    return ZX_OK;
+}
+
+// Reads the packets queued by |deadline| into the entries they are for.
+static zx_status_t poll_read_packets(zx_time_t deadline) {
+    zx_port_packet_t packets[ZX_PORT_WAIT_MANY_MAX];
+    size_t actual;
+    zx_status_t status = zx_port_wait_many(fdio_pollset.port, deadline, packets,
+                                           ZX_PORT_WAIT_MANY_MAX, &actual);
+    if (status != ZX_OK) {
+        return status;
+    }
+    for (size_t i = 0; i < actual; i++) {
+        uint32_t fd = (uint32_t)packets[i].key;
+        if (fd >= FDIO_MAX_FD) {
+            continue;
+        }
+        fdio_poll_entry_t* entry = &fdio_pollset.entries[fd];
+        if (entry->io != NULL && packets[i].key == poll_key(fd, entry->gen)) {
+            entry->seen |= packets[i].signal.observed;
+        }
+    }
+    return ZX_OK;
+}
+
+static zx_status_t poll_wait_locked(const int* fds, fdio_t** ios, zx_wait_item_t* items,
+                                    size_t count, zx_time_t deadline) {
+    zx_status_t status;
+    if (fdio_pollset.port == ZX_HANDLE_INVALID &&
+        (status = zx_port_create(0u, &fdio_pollset.port)) != ZX_OK) {
+        return status;
+    }
+    const uint32_t min_gen = fdio_pollset.gen;
+    for (size_t i = 0; i < count; i++) {
+        if ((status = poll_register(fds[i], ios[i], &items[i], min_gen)) != ZX_OK) {
+            return zx_object_wait_many(items, count, deadline);
+        }
+        items[i].pending = 0u;
+    }
+
+    zx_time_t packet_deadline = 0u;
+    for (;;) {
+        // Take everything which has been queued, blocking only if nothing
+        // was found to be ready.
+        while ((status = poll_read_packets(packet_deadline)) == ZX_OK) {
+            packet_deadline = 0u;
+        }
+        if (status != ZX_ERR_TIMED_OUT) {
+            return status;
+        }
+
+        bool ready = false;
+        for (size_t i = 0; i < count; i++) {
+            fdio_poll_entry_t* entry = &fdio_pollset.entries[fds[i]];
+            if (!(entry->seen & items[i].waitfor)) {
+                continue;
+            }
+            zx_signals_t observed = 0u;
+            zx_object_wait_one(items[i].handle, items[i].waitfor, 0u, &observed);
+            // Until a packet says otherwise the signals are not asserted.
+            entry->seen = observed & items[i].waitfor;
+            if (entry->seen) {
+                items[i].pending = observed;
+                ready = true;
+            }
+        }
+        if (ready) {
+            return ZX_OK;
+        }
+        if (packet_deadline == deadline) {
+            return ZX_ERR_TIMED_OUT;
+        }
+        packet_deadline = deadline;
+    }
+}
+
+zx_status_t fdio_pollset_wait(const int* fds, fdio_t** ios, zx_wait_item_t* items,
+                              size_t count, zx_time_t deadline) {
+    if (mtx_trylock(&fdio_pollset.lock) != thrd_success) {
+        return zx_object_wait_many(items, count, deadline);
+    }
+    zx_status_t status = poll_wait_locked(fds, ios, items, count, deadline);
+    mtx_unlock(&fdio_pollset.lock);
+    return status;
+}
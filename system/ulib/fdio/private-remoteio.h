@@ -19,6 +19,17 @@ struct zxrio {
 
     // transaction id used for synchronous remoteio calls
     _Atomic zx_txid_t txid;
+
+    // Set until the description of a pipelined open has been read (see
+    // FDIO_OPEN_FLAG_PIPELINE), after which describe_status holds the
+    // outcome of the open.
+    atomic_bool describe_pending;
+    zx_status_t describe_status;
+
+    // vmo for large transfers (see ZXRIO_READ_VMO), kept between uses, and
+    // whether the server turned such transfers down.
+    _Atomic zx_handle_t xfer_vmo;
+    atomic_bool xfer_vmo_unsupported;
 };
 
 // These are for the benefit of namespace.c
@@ -62,6 +62,12 @@ typedef struct fdio_ops {
 #define IOFLAG_SOCKET_CONNECTED     (1 << 5)
 #define IOFLAG_NONBLOCK             (1 << 6)
 
+// Open flag for the fdio open op which is never sent to the server: the
+// new object is returned without waiting for the server to describe it.
+// The description is read along with the reply to the first request made
+// of the object, and a failure to open is reported by that request.
+#define FDIO_OPEN_FLAG_PIPELINE 0x80000000u
+
 // The subset of fdio_t per-fd flags queryable via fcntl.
 // Static assertions in unistd.c ensure we aren't colliding.
 #define IOFLAG_FD_FLAGS IOFLAG_CLOEXEC
@@ -121,6 +127,11 @@ static inline zx_status_t fdio_open(fdio_t* io, const char* path, uint32_t flags
     return io->ops->open(io, path, flags, mode, out);
 }
 zx_status_t fdio_close(fdio_t* io);
+// Waits like zx_object_wait_many() for |items|, which are the handles and
+// signals given by wait_begin for |fds| and their fdio objects |ios|, using
+// persistent registrations with a port shared by poll() and select().
+zx_status_t fdio_pollset_wait(const int* fds, fdio_t** ios, zx_wait_item_t* items,
+                              size_t count, zx_time_t deadline);
 zx_status_t fdio_wait(fdio_t* io, uint32_t events, zx_time_t deadline,
                       uint32_t* out_pending);
 
@@ -159,6 +170,12 @@ fdio_t* fdio_waitable_create(zx_handle_t h, zx_signals_t signals_in, zx_signals_
 void fdio_socket_set_stream_ops(fdio_t* io);
 void fdio_socket_set_dgram_ops(fdio_t* io);
 
+// Reads up to |vlen| datagrams with one zx_socket_read(), waiting until
+// |deadline| for the first. Returns ZX_ERR_NOT_SUPPORTED if |io| is not a
+// datagram socket.
+ssize_t fdio_socket_recvmmsg(fdio_t* io, struct mmsghdr* msgvec, unsigned int vlen,
+                             int flags, zx_time_t deadline);
+
 zx_status_t fdio_socket_posix_ioctl(fdio_t* io, int req, va_list va);
 zx_status_t fdio_socket_shutdown(fdio_t* io, int how);
 zx_status_t fdio_socketpair_shutdown(fdio_t* io, int how);
@@ -69,9 +69,7 @@ static bool is_message_reply_valid(zxrio_msg_t* msg, uint32_t size) {
 }
 
 static void discard_handles(zx_handle_t* handles, unsigned count) {
-    while (count-- > 0) {
-        zx_handle_close(*handles++);
-    }
+    zx_handle_close_many(handles, count);
 }
 
 static zx_status_t zxrio_read_msg(zx_handle_t h, zxrio_msg_t* msg) {
@@ -182,6 +180,68 @@ zx_status_t zxrio_txn_handoff(zx_handle_t srv, zx_handle_t reply, zxrio_msg_t* m
     return r;
 }
 
+// Reads the description of a pipelined open, if it has arrived, returning
+// the status of the open. Servers describe an object before serving any
+// requests of it, so once a reply has been read, or the channel found
+// closed, the description is there to be read if it will ever be.
+static zx_status_t zxrio_take_describe(zxrio_t* rio) {
+    if (!atomic_load(&rio->describe_pending)) {
+        return rio->describe_status;
+    }
+
+    zxrio_describe_t info;
+    zx_handle_t extra = ZX_HANDLE_INVALID;
+    uint32_t dsize = sizeof(info);
+    uint32_t hcount = 0;
+    zx_status_t r = zx_channel_read(rio->h, 0, &info, &extra, dsize, 1, &dsize, &hcount);
+    if (r != ZX_OK) {
+        // Not here yet, or never coming; the request speaks for itself.
+        return ZX_OK;
+    }
+    if (dsize < ZXRIO_DESCRIBE_HDR_SZ || info.op != ZXRIO_ON_OPEN) {
+        r = ZX_ERR_IO;
+    } else if ((r = info.status) == ZX_OK && dsize != sizeof(zxrio_describe_t)) {
+        r = ZX_ERR_IO;
+    }
+    if (r == ZX_OK) {
+        switch (info.extra.tag) {
+        case FDIO_PROTOCOL_FILE:
+        case FDIO_PROTOCOL_DEVICE:
+            // The event handle, which wait_begin uses as it would for an
+            // object opened synchronously.
+            rio->h2 = extra;
+            extra = ZX_HANDLE_INVALID;
+            break;
+        case FDIO_PROTOCOL_PIPE:
+        case FDIO_PROTOCOL_SOCKET:
+        case FDIO_PROTOCOL_SOCKET_CONNECTED:
+            // Not served over the channel we hold.
+            r = ZX_ERR_NOT_SUPPORTED;
+            break;
+        default:
+            // Everything else answers requests on the channel; any
+            // handle given for quicker local access goes unused.
+            break;
+        }
+    }
+    if (extra != ZX_HANDLE_INVALID) {
+        zx_handle_close(extra);
+    }
+    rio->describe_status = r;
+    atomic_store(&rio->describe_pending, false);
+    return r;
+}
+
+// Waits for the description of a pipelined open, for those uses of an
+// object which need to know what it is before going further.
+static zx_status_t zxrio_await_describe(zxrio_t* rio) {
+    if (atomic_load(&rio->describe_pending)) {
+        zx_object_wait_one(rio->h, ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                           ZX_TIME_INFINITE, NULL);
+    }
+    return zxrio_take_describe(rio);
+}
+
 // on success, msg->hcount indicates number of valid handles in msg->handle
 // on error there are never any handles
 static zx_status_t zxrio_txn(zxrio_t* rio, zxrio_msg_t* msg) {
@@ -207,16 +267,25 @@ static zx_status_t zxrio_txn(zxrio_t* rio, zxrio_msg_t* msg) {
     args.rd_num_handles = FDIO_MAX_HANDLES;
 
     r = zx_channel_call(rio->h, 0, ZX_TIME_INFINITE, &args, &dsize, &msg->hcount, &rs);
+
+    // A pipelined open which failed is reported in place of whatever became
+    // of the request.
+    zx_status_t open_status = zxrio_take_describe(rio);
     if (r < 0) {
         if (r == ZX_ERR_CALL_FAILED) {
             // read phase failed, true status is in rs
             msg->hcount = 0;
-            return rs;
+            return (open_status != ZX_OK) ? open_status : rs;
         } else {
             // write phase failed, we must discard the handles
+            r = (open_status != ZX_OK) ? open_status : r;
             goto fail_discard_handles;
         }
     }
+    if (open_status != ZX_OK) {
+        r = open_status;
+        goto fail_discard_handles;
+    }
 
     // check for protocol errors
     if (!is_message_reply_valid(msg, dsize) ||
@@ -337,6 +406,79 @@ ssize_t zxrio_ioctl(fdio_t* io, uint32_t op, const void* in_buf,
     return r;
 }
 
+// Reads and writes longer than XFER_VMO_MIN go through a vmo, up to
+// XFER_VMO_SIZE at a time, instead of in FDIO_CHUNK_SIZE messages.
+#define XFER_VMO_MIN (2 * FDIO_CHUNK_SIZE)
+#define XFER_VMO_SIZE (1024 * 1024)
+#define XFER_VMO_RIGHTS (ZX_RIGHT_TRANSFER | ZX_RIGHTS_IO | ZX_RIGHT_MAP)
+
+// Takes the object's transfer vmo, or a new one if another thread has it.
+static zx_status_t xfer_vmo_get(zxrio_t* rio, zx_handle_t* out) {
+    zx_handle_t vmo = atomic_exchange(&rio->xfer_vmo, ZX_HANDLE_INVALID);
+    if (vmo == ZX_HANDLE_INVALID) {
+        zx_status_t r;
+        if ((r = zx_vmo_create(XFER_VMO_SIZE, 0, &vmo)) != ZX_OK) {
+            return r;
+        }
+    }
+    *out = vmo;
+    return ZX_OK;
+}
+
+static void xfer_vmo_put(zxrio_t* rio, zx_handle_t vmo) {
+    zx_handle_t expected = ZX_HANDLE_INVALID;
+    if (!atomic_compare_exchange_strong(&rio->xfer_vmo, &expected, vmo)) {
+        zx_handle_close(vmo);
+    }
+}
+
+// Moves |len| bytes, no more than XFER_VMO_SIZE, with a single READ_VMO or
+// WRITE_VMO message, returning the number moved.
+static zx_status_t xfer_vmo_txn(zxrio_t* rio, uint32_t op, void* data, size_t len, off_t offset) {
+    zx_handle_t vmo;
+    zx_status_t r;
+    if ((r = xfer_vmo_get(rio, &vmo)) != ZX_OK) {
+        return r;
+    }
+
+    size_t actual;
+    if ((op == ZXRIO_WRITE_VMO) && (r = zx_vmo_write(vmo, data, 0, len, &actual)) != ZX_OK) {
+        goto done;
+    }
+
+    zxrio_msg_t msg;
+    memset(&msg, 0, ZXRIO_HDR_SZ);
+    msg.op = op;
+    msg.arg = len;
+    msg.arg2.off = offset;
+    if ((r = zx_handle_duplicate(vmo, XFER_VMO_RIGHTS, &msg.handle[0])) != ZX_OK) {
+        goto done;
+    }
+    msg.hcount = 1;
+    if ((r = zxrio_txn(rio, &msg)) < 0) {
+        goto done;
+    }
+    discard_handles(msg.handle, msg.hcount);
+
+    if ((size_t)r > len) {
+        r = ZX_ERR_IO;
+    } else if ((op == ZXRIO_READ_VMO) && (r > 0)) {
+        zx_status_t status = zx_vmo_read(vmo, data, 0, r, &actual);
+        if (status != ZX_OK) {
+            r = status;
+        }
+    }
+done:
+    xfer_vmo_put(rio, vmo);
+    return r;
+}
+
+// Whether to move the next |len| bytes through the transfer vmo. Servers
+// which do not know READ_VMO and WRITE_VMO are only asked once.
+static bool use_xfer_vmo(zxrio_t* rio, size_t len) {
+    return (len > XFER_VMO_MIN) && !atomic_load(&rio->xfer_vmo_unsupported);
+}
+
 static ssize_t write_common(uint32_t op, fdio_t* io, const void* _data, size_t len, off_t offset) {
     zxrio_t* rio = (zxrio_t*)io;
     const uint8_t* data = _data;
@@ -346,19 +488,31 @@ static ssize_t write_common(uint32_t op, fdio_t* io, const void* _data, size_t l
     ssize_t xfer;
 
     while (len > 0) {
-        xfer = (len > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len;
+        if (use_xfer_vmo(rio, len)) {
+            xfer = (len > XFER_VMO_SIZE) ? XFER_VMO_SIZE : len;
+            r = xfer_vmo_txn(rio, ZXRIO_WRITE_VMO, (void*)data, xfer,
+                             (op == ZXRIO_WRITE_AT) ? offset : ZXRIO_VMO_SEEK_OFFSET);
+            if (r == ZX_ERR_NOT_SUPPORTED) {
+                atomic_store(&rio->xfer_vmo_unsupported, true);
+                continue;
+            } else if (r < 0) {
+                break;
+            }
+        } else {
+            xfer = (len > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len;
 
-        memset(&msg, 0, ZXRIO_HDR_SZ);
-        msg.op = op;
-        msg.datalen = xfer;
-        if (op == ZXRIO_WRITE_AT)
-            msg.arg2.off = offset;
-        memcpy(msg.data, data, xfer);
+            memset(&msg, 0, ZXRIO_HDR_SZ);
+            msg.op = op;
+            msg.datalen = xfer;
+            if (op == ZXRIO_WRITE_AT)
+                msg.arg2.off = offset;
+            memcpy(msg.data, data, xfer);
 
-        if ((r = zxrio_txn(rio, &msg)) < 0) {
-            break;
+            if ((r = zxrio_txn(rio, &msg)) < 0) {
+                break;
+            }
+            discard_handles(msg.handle, msg.hcount);
         }
-        discard_handles(msg.handle, msg.hcount);
 
         if (r > xfer) {
             r = ZX_ERR_IO;
@@ -394,24 +548,36 @@ static ssize_t read_common(uint32_t op, fdio_t* io, void* _data, size_t len, off
     ssize_t xfer;
 
     while (len > 0) {
-        xfer = (len > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len;
+        if (use_xfer_vmo(rio, len)) {
+            xfer = (len > XFER_VMO_SIZE) ? XFER_VMO_SIZE : len;
+            r = xfer_vmo_txn(rio, ZXRIO_READ_VMO, data, xfer,
+                             (op == ZXRIO_READ_AT) ? offset : ZXRIO_VMO_SEEK_OFFSET);
+            if (r == ZX_ERR_NOT_SUPPORTED) {
+                atomic_store(&rio->xfer_vmo_unsupported, true);
+                continue;
+            } else if (r < 0) {
+                break;
+            }
+        } else {
+            xfer = (len > FDIO_CHUNK_SIZE) ? FDIO_CHUNK_SIZE : len;
 
-        memset(&msg, 0, ZXRIO_HDR_SZ);
-        msg.op = op;
-        msg.arg = xfer;
-        if (op == ZXRIO_READ_AT)
-            msg.arg2.off = offset;
+            memset(&msg, 0, ZXRIO_HDR_SZ);
+            msg.op = op;
+            msg.arg = xfer;
+            if (op == ZXRIO_READ_AT)
+                msg.arg2.off = offset;
 
-        if ((r = zxrio_txn(rio, &msg)) < 0) {
-            break;
-        }
-        discard_handles(msg.handle, msg.hcount);
+            if ((r = zxrio_txn(rio, &msg)) < 0) {
+                break;
+            }
+            discard_handles(msg.handle, msg.hcount);
 
-        if ((r > (int)msg.datalen) || (r > xfer)) {
-            r = ZX_ERR_IO;
-            break;
+            if ((r > (int)msg.datalen) || (r > xfer)) {
+                r = ZX_ERR_IO;
+                break;
+            }
+            memcpy(data, msg.data, r);
         }
-        memcpy(data, msg.data, r);
         count += r;
         data += r;
         len -= r;
@@ -504,6 +670,9 @@ zx_status_t zxrio_close(fdio_t* io) {
     zx_handle_t h = rio->h;
     rio->h = 0;
     zx_handle_close(h);
+    if ((h = atomic_exchange(&rio->xfer_vmo, ZX_HANDLE_INVALID)) != ZX_HANDLE_INVALID) {
+        zx_handle_close(h);
+    }
     if (rio->h2 > 0) {
         h = rio->h2;
         rio->h2 = 0;
@@ -943,6 +1112,7 @@ zx_status_t zxrio_getobject(zx_handle_t rio_h, uint32_t op, const char* name,
         return ZX_ERR_BAD_PATH;
     }
 
+    flags &= ~FDIO_OPEN_FLAG_PIPELINE;
     if (flags & ZX_FS_FLAG_DESCRIBE) {
         zxrio_msg_t msg;
         memset(&msg, 0, ZXRIO_HDR_SZ);
@@ -970,8 +1140,53 @@ zx_status_t zxrio_getobject(zx_handle_t rio_h, uint32_t op, const char* name,
     }
 }
 
+// Sends an open request with ZX_FS_FLAG_DESCRIBE, returning an object for
+// the new connection straight away and leaving the description to be read
+// by the first request made of it.
+static zx_status_t zxrio_open_pipelined(zx_handle_t h, const char* path, uint32_t flags,
+                                        uint32_t mode, fdio_t** out) {
+    size_t len = strlen(path);
+    if (len >= PATH_MAX) {
+        return ZX_ERR_BAD_PATH;
+    }
+
+    zxrio_msg_t msg;
+    memset(&msg, 0, ZXRIO_HDR_SZ);
+    msg.op = ZXRIO_OPEN;
+    msg.datalen = len;
+    msg.arg = (flags & ~FDIO_OPEN_FLAG_PIPELINE) | ZX_FS_FLAG_DESCRIBE;
+    msg.arg2.mode = mode;
+    memcpy(msg.data, path, len);
+
+    zx_handle_t cnxn;
+    zx_status_t r;
+    if ((r = zx_channel_create(0, &cnxn, &msg.handle[0])) < 0) {
+        return r;
+    }
+    msg.hcount = 1;
+    if ((r = zx_channel_write(h, 0, &msg, ZXRIO_HDR_SZ + msg.datalen, msg.handle, 1)) < 0) {
+        zx_handle_close(msg.handle[0]);
+        zx_handle_close(cnxn);
+        return r;
+    }
+
+    fdio_t* io = fdio_remote_create(cnxn, 0);
+    if (io == NULL) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    atomic_store(&((zxrio_t*)io)->describe_pending, true);
+    *out = io;
+    return ZX_OK;
+}
+
 zx_status_t zxrio_open_handle(zx_handle_t h, const char* path, uint32_t flags,
                               uint32_t mode, fdio_t** out) {
+    if (path == NULL) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (flags & FDIO_OPEN_FLAG_PIPELINE) {
+        return zxrio_open_pipelined(h, path, flags, mode, out);
+    }
     zx_handle_t control_channel;
     zxrio_describe_t info;
     zx_status_t r = zxrio_getobject(h, ZXRIO_OPEN, path, flags, mode, &info, &control_channel);
@@ -1032,6 +1247,10 @@ static zx_status_t zxrio_unwrap(fdio_t* io, zx_handle_t* handles, uint32_t* type
     zxrio_t* rio = (void*)io;
     LOG(1, "fdio: zxrio_unwrap(%p,...)\n");
     zx_status_t r;
+    // Whoever takes the handles must not find the description waiting.
+    if ((r = zxrio_await_describe(rio)) != ZX_OK) {
+        return r;
+    }
     handles[0] = rio->h;
     types[0] = PA_FDIO_REMOTE;
     if (rio->h2 != 0) {
@@ -1046,6 +1265,7 @@ static zx_status_t zxrio_unwrap(fdio_t* io, zx_handle_t* handles, uint32_t* type
 
 static void zxrio_wait_begin(fdio_t* io, uint32_t events, zx_handle_t* handle, zx_signals_t* _signals) {
     zxrio_t* rio = (void*)io;
+    zxrio_await_describe(rio);
     *handle = rio->h2;
 
     zx_signals_t signals = 0;
@@ -571,6 +571,11 @@ void fdio_socket_set_stream_ops(fdio_t* io) {
     rio->io.ops = &fdio_socket_stream_ops;
 }
 
+ssize_t fdio_socket_recvmmsg(fdio_t* io, struct mmsghdr* msgvec, unsigned int vlen,
+                             int flags, zx_time_t deadline) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
 void fdio_socket_set_dgram_ops(fdio_t* io) {
     zxrio_t* rio = (zxrio_t*)io;
     rio->io.ops = &fdio_socket_dgram_ops;
@@ -12,6 +12,7 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/bootfs.c \
+    $(LOCAL_DIR)/cache.c \
     $(LOCAL_DIR)/debug.c \
     $(LOCAL_DIR)/dispatcher.c \
     $(LOCAL_DIR)/get-vmo.c \
@@ -20,6 +21,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/null.c \
     $(LOCAL_DIR)/output.c \
     $(LOCAL_DIR)/pipe.c \
+    $(LOCAL_DIR)/poll.c \
     $(LOCAL_DIR)/remoteio.c \
     $(LOCAL_DIR)/service.c \
     $(LOCAL_DIR)/socketpair.c \
@@ -124,7 +124,24 @@ int sendmmsg(int fd, struct mmsghdr* msgvec, unsigned int vlen, unsigned int fla
 }
 
 int recvmmsg(int fd, struct mmsghdr* msgvec, unsigned int vlen, unsigned int flags, struct timespec* timeout) {
-    return checksocket(fd, ENOTSOCK, ENOSYS);
+    fdio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    if (!(io->ioflag & IOFLAG_SOCKET)) {
+        fdio_release(io);
+        return ERRNO(ENOTSOCK);
+    }
+    zx_time_t deadline = ZX_TIME_INFINITE;
+    if (timeout != NULL) {
+        deadline = zx_deadline_after(ZX_SEC(timeout->tv_sec) + timeout->tv_nsec);
+    }
+    ssize_t r = fdio_socket_recvmmsg(io, msgvec, vlen, flags, deadline);
+    fdio_release(io);
+    if (r == ZX_ERR_NOT_SUPPORTED) {
+        return ERRNO(ENOSYS);
+    }
+    return r < 0 ? STATUS(r) : (int)r;
 }
 
 int sockatmark(int fd) {
@@ -24,6 +24,7 @@
 
 #include <zircon/compiler.h>
 #include <zircon/device/vfs.h>
+#include <zircon/listnode.h>
 #include <zircon/process.h>
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
@@ -353,7 +354,8 @@ zx_status_t __fdio_cleanpath(const char* in, char* out, size_t* outlen, bool* is
     return ZX_OK;
 }
 
-zx_status_t __fdio_open_at(fdio_t** io, int dirfd, const char* path, int flags, uint32_t mode) {
+static zx_status_t fdio_open_at_zxflags(fdio_t** io, int dirfd, const char* path, int flags,
+                                        uint32_t mode, uint32_t zxflags) {
     if (path == NULL) {
         return ZX_ERR_INVALID_ARGS;
     }
@@ -374,11 +376,23 @@ zx_status_t __fdio_open_at(fdio_t** io, int dirfd, const char* path, int flags,
     }
     flags |= (is_dir ? O_DIRECTORY : 0);
 
-    status = iodir->ops->open(iodir, clean, fdio_flags_to_zxio(flags), mode, io);
+    status = iodir->ops->open(iodir, clean, fdio_flags_to_zxio(flags) | zxflags, mode, io);
     fdio_release(iodir);
     return status;
 }
 
+zx_status_t __fdio_open_at(fdio_t** io, int dirfd, const char* path, int flags, uint32_t mode) {
+    return fdio_open_at_zxflags(io, dirfd, path, flags, mode, 0);
+}
+
+// For callers which make a single request of the object they open and report
+// only its result: the open is pipelined with the request, saving a round
+// trip, and a failure to open is reported by the request instead.
+static zx_status_t fdio_open_at_pipelined(fdio_t** io, int dirfd, const char* path, int flags,
+                                          uint32_t mode) {
+    return fdio_open_at_zxflags(io, dirfd, path, flags, mode, FDIO_OPEN_FLAG_PIPELINE);
+}
+
 zx_status_t __fdio_open(fdio_t** io, const char* path, int flags, uint32_t mode) {
     return __fdio_open_at(io, AT_FDCWD, path, flags, mode);
 }
@@ -503,8 +517,11 @@ static zx_status_t __fdio_opendir_containing_at(fdio_t** io, int dirfd, const ch
         clean[1] = 0;
     }
 
+    // Callers only ever make requests of the directory, which report any
+    // failure to open it, so there is no need to wait for the open.
     zx_status_t r = iodir->ops->open(iodir, clean,
-                                     fdio_flags_to_zxio(O_RDONLY | O_DIRECTORY), 0, io);
+                                     fdio_flags_to_zxio(O_RDONLY | O_DIRECTORY) |
+                                     FDIO_OPEN_FLAG_PIPELINE, 0, io);
     fdio_release(iodir);
     return r;
 }
@@ -658,6 +675,8 @@ void __libc_extensions_init(uint32_t handle_count,
     if (fdio_cwd_handle == NULL) {
         fdio_cwd_handle = fdio_null_create();
     }
+
+    __fdio_cache_init();
 }
 
 // Clean up during process teardown. This runs after atexit hooks in
@@ -704,6 +723,8 @@ zx_status_t fdio_ns_install(fdio_ns_t* ns) {
         fdio_close(old_root);
         fdio_release(old_root);
     }
+    // Cached paths were resolved against the old root.
+    __fdio_cache_flush();
     return status;
 }
 
@@ -798,6 +819,20 @@ zx_status_t fdio_wait_fd(int fd, uint32_t events, uint32_t* _pending, zx_time_t
     return status;
 }
 
+static void vnattr_to_stat(const vnattr_t* attr, struct stat* s) {
+    memset(s, 0, sizeof(struct stat));
+    s->st_mode = attr->mode;
+    s->st_ino = attr->inode;
+    s->st_size = attr->size;
+    s->st_blksize = attr->blksize;
+    s->st_blocks = attr->blkcount;
+    s->st_nlink = attr->nlink;
+    s->st_ctim.tv_sec = attr->create_time / ZX_SEC(1);
+    s->st_ctim.tv_nsec = attr->create_time % ZX_SEC(1);
+    s->st_mtim.tv_sec = attr->modify_time / ZX_SEC(1);
+    s->st_mtim.tv_nsec = attr->modify_time % ZX_SEC(1);
+}
+
 int fdio_stat(fdio_t* io, struct stat* s) {
     vnattr_t attr;
     int r = io->ops->misc(io, ZXRIO_STAT, 0, sizeof(attr), &attr, 0);
@@ -807,17 +842,7 @@ int fdio_stat(fdio_t* io, struct stat* s) {
     if (r < (int)sizeof(attr)) {
         return ZX_ERR_IO;
     }
-    memset(s, 0, sizeof(struct stat));
-    s->st_mode = attr.mode;
-    s->st_ino = attr.inode;
-    s->st_size = attr.size;
-    s->st_blksize = attr.blksize;
-    s->st_blocks = attr.blkcount;
-    s->st_nlink = attr.nlink;
-    s->st_ctim.tv_sec = attr.create_time / ZX_SEC(1);
-    s->st_ctim.tv_nsec = attr.create_time % ZX_SEC(1);
-    s->st_mtim.tv_sec = attr.modify_time / ZX_SEC(1);
-    s->st_mtim.tv_nsec = attr.modify_time % ZX_SEC(1);
+    vnattr_to_stat(&attr, s);
     return 0;
 }
 
@@ -875,7 +900,63 @@ int fdio_status_to_errno(zx_status_t status) {
 // The functions from here on provide implementations of fd and path
 // centric posix-y io operations.
 
+// Vectored reads and writes of up to IOVEC_GATHER_MAX bytes go through a
+// single buffer, so that they take one request rather than one per iovec.
+#define IOVEC_GATHER_MAX (1024 * 1024)
+
+// Returns a buffer to gather |iov| into, |local| if it is large enough, or
+// NULL if the iovecs are best moved one at a time.
+static void* iovec_buffer(const struct iovec* iov, int num, void* local, size_t local_len,
+                          size_t* out_len) {
+    if (num < 2) {
+        return NULL;
+    }
+    size_t len = 0;
+    for (int i = 0; i < num; i++) {
+        if (iov[i].iov_len > IOVEC_GATHER_MAX - len) {
+            return NULL;
+        }
+        len += iov[i].iov_len;
+    }
+    *out_len = len;
+    return (len <= local_len) ? local : malloc(len);
+}
+
+static void iovec_buffer_free(void* buf, void* local) {
+    if (buf != local) {
+        free(buf);
+    }
+}
+
+static void iovec_gather(const struct iovec* iov, int num, uint8_t* buf) {
+    for (int i = 0; i < num; i++) {
+        memcpy(buf, iov[i].iov_base, iov[i].iov_len);
+        buf += iov[i].iov_len;
+    }
+}
+
+static void iovec_scatter(const struct iovec* iov, int num, const uint8_t* buf, size_t len) {
+    for (int i = 0; (i < num) && (len > 0); i++) {
+        size_t n = (iov[i].iov_len < len) ? iov[i].iov_len : len;
+        memcpy(iov[i].iov_base, buf, n);
+        buf += n;
+        len -= n;
+    }
+}
+
 ssize_t readv(int fd, const struct iovec* iov, int num) {
+    uint8_t local[FDIO_CHUNK_SIZE];
+    size_t len;
+    void* buf = iovec_buffer(iov, num, local, sizeof(local), &len);
+    if (buf != NULL) {
+        ssize_t r = read(fd, buf, len);
+        if (r > 0) {
+            iovec_scatter(iov, num, buf, r);
+        }
+        iovec_buffer_free(buf, local);
+        return r;
+    }
+
     ssize_t count = 0;
     ssize_t r;
     while (num > 0) {
@@ -896,6 +977,16 @@ ssize_t readv(int fd, const struct iovec* iov, int num) {
 }
 
 ssize_t writev(int fd, const struct iovec* iov, int num) {
+    uint8_t local[FDIO_CHUNK_SIZE];
+    size_t len;
+    void* buf = iovec_buffer(iov, num, local, sizeof(local), &len);
+    if (buf != NULL) {
+        iovec_gather(iov, num, buf);
+        ssize_t r = write(fd, buf, len);
+        iovec_buffer_free(buf, local);
+        return r;
+    }
+
     ssize_t count = 0;
     ssize_t r;
     while (num > 0) {
@@ -915,6 +1006,43 @@ ssize_t writev(int fd, const struct iovec* iov, int num) {
     return count;
 }
 
+// Shared, writable mappings of files, so that msync() can find the file
+// behind an address. Each holds its own connection to the file, which
+// outlives any close() of the descriptor it was mapped through.
+typedef struct fdio_mapping {
+    list_node_t node;
+    uintptr_t addr;
+    size_t len;
+    uint64_t offset;
+    fdio_t* io;
+} fdio_mapping_t;
+
+static mtx_t mapping_lock = MTX_INIT;
+static list_node_t mappings = LIST_INITIAL_VALUE(mappings);
+
+static void mapping_track(fdio_t* io, uintptr_t addr, size_t len, uint64_t offset) {
+    zx_handle_t handles[FDIO_MAX_HANDLES];
+    uint32_t types[FDIO_MAX_HANDLES];
+    zx_status_t r = io->ops->clone(io, handles, types);
+    if (r <= 0) {
+        return;
+    }
+    zx_handle_close_many(&handles[1], r - 1);
+    fdio_mapping_t* m = malloc(sizeof(*m));
+    if (m == NULL || (m->io = fdio_remote_create(handles[0], 0)) == NULL) {
+        // Best effort: without it, msync() of the mapping does nothing and
+        // its changes are written back when the file is next closed.
+        free(m);
+        return;
+    }
+    m->addr = addr;
+    m->len = len;
+    m->offset = offset;
+    mtx_lock(&mapping_lock);
+    list_add_tail(&mappings, &m->node);
+    mtx_unlock(&mapping_lock);
+}
+
 zx_status_t _mmap_file(size_t offset, size_t len, uint32_t zx_flags, int flags, int fd,
                        off_t fd_off, uintptr_t* out) {
     fdio_t* io;
@@ -933,8 +1061,8 @@ zx_status_t _mmap_file(size_t offset, size_t len, uint32_t zx_flags, int flags,
     data.flags = zx_flags | (flags & MAP_PRIVATE ? FDIO_MMAP_FLAG_PRIVATE : 0);
 
     zx_status_t r = io->ops->misc(io, ZXRIO_MMAP, 0, sizeof(data), &data, sizeof(data));
-    fdio_release(io);
     if (r < 0) {
+        fdio_release(io);
         return r;
     }
     zx_handle_t vmo = r;
@@ -944,13 +1072,72 @@ zx_status_t _mmap_file(size_t offset, size_t len, uint32_t zx_flags, int flags,
     zx_handle_close(vmo);
     // TODO: map this as shared if we ever implement forking
     if (r < 0) {
+        fdio_release(io);
         return r;
     }
 
+    if ((flags & MAP_SHARED) && (zx_flags & ZX_VM_FLAG_PERM_WRITE)) {
+        mapping_track(io, ptr, len, fd_off);
+    }
+    fdio_release(io);
     *out = ptr;
     return ZX_OK;
 }
 
+zx_status_t _msync_file(void* addr, size_t len, int flags) {
+    uintptr_t start = (uintptr_t)addr;
+    uintptr_t end = start + len;
+    zx_status_t r = ZX_OK;
+    mtx_lock(&mapping_lock);
+    fdio_mapping_t* m;
+    list_for_every_entry (&mappings, m, fdio_mapping_t, node) {
+        uintptr_t lo = start > m->addr ? start : m->addr;
+        uintptr_t hi = end < m->addr + m->len ? end : m->addr + m->len;
+        if (lo >= hi) {
+            continue;
+        }
+        zxrio_msync_data_t data;
+        data.offset = m->offset + (lo - m->addr);
+        data.length = hi - lo;
+        data.flags = (flags & MS_SYNC) ? FDIO_MSYNC_FLAG_SYNC : 0;
+        zx_status_t status = m->io->ops->misc(m->io, ZXRIO_MSYNC, 0, 0, &data, sizeof(data));
+        if (status != ZX_OK && r == ZX_OK) {
+            r = status;
+        }
+    }
+    mtx_unlock(&mapping_lock);
+    return r;
+}
+
+void _munmap_file(void* addr, size_t len) {
+    uintptr_t start = (uintptr_t)addr;
+    uintptr_t end = start + len;
+    mtx_lock(&mapping_lock);
+    fdio_mapping_t* m;
+    fdio_mapping_t* tmp;
+    list_for_every_entry_safe (&mappings, m, tmp, fdio_mapping_t, node) {
+        uintptr_t m_end = m->addr + m->len;
+        if (end <= m->addr || start >= m_end) {
+            continue;
+        }
+        if (start <= m->addr && end >= m_end) {
+            list_delete(&m->node);
+            m->io->ops->close(m->io);
+            fdio_release(m->io);
+            free(m);
+        } else if (start <= m->addr) {
+            m->offset += end - m->addr;
+            m->len = m_end - end;
+            m->addr = end;
+        } else {
+            // A hole punched in the middle keeps the head, and leaves the
+            // tail without msync() until the file is next closed.
+            m->len = start - m->addr;
+        }
+    }
+    mtx_unlock(&mapping_lock);
+}
+
 int unlinkat(int dirfd, const char* path, int flags) {
     char name[NAME_MAX + 1];
     fdio_t* io;
@@ -1007,6 +1194,18 @@ ssize_t write(int fd, const void* buf, size_t count) {
 }
 
 ssize_t preadv(int fd, const struct iovec* iov, int count, off_t ofs) {
+    uint8_t local[FDIO_CHUNK_SIZE];
+    size_t len;
+    void* buf = iovec_buffer(iov, count, local, sizeof(local), &len);
+    if (buf != NULL) {
+        ssize_t r = pread(fd, buf, len, ofs);
+        if (r > 0) {
+            iovec_scatter(iov, count, buf, r);
+        }
+        iovec_buffer_free(buf, local);
+        return r;
+    }
+
     ssize_t iov_count = 0;
     ssize_t r;
     while (count > 0) {
@@ -1049,6 +1248,16 @@ ssize_t pread(int fd, void* buf, size_t size, off_t ofs) {
 }
 
 ssize_t pwritev(int fd, const struct iovec* iov, int count, off_t ofs) {
+    uint8_t local[FDIO_CHUNK_SIZE];
+    size_t len;
+    void* buf = iovec_buffer(iov, count, local, sizeof(local), &len);
+    if (buf != NULL) {
+        iovec_gather(iov, count, buf);
+        ssize_t r = pwrite(fd, buf, len, ofs);
+        iovec_buffer_free(buf, local);
+        return r;
+    }
+
     ssize_t iov_count = 0;
     ssize_t r;
     while (count > 0) {
@@ -1292,12 +1501,13 @@ static int truncateat(int dirfd, const char* path, off_t len) {
     fdio_t* io;
     zx_status_t r;
 
-    if ((r = __fdio_open_at(&io, dirfd, path, O_WRONLY, 0)) < 0) {
+    if ((r = fdio_open_at_pipelined(&io, dirfd, path, O_WRONLY, 0)) < 0) {
         return ERROR(r);
     }
     r = io->ops->misc(io, ZXRIO_TRUNCATE, len, 0, NULL, 0);
     fdio_close(io);
     fdio_release(io);
+    __fdio_cache_invalidate(dirfd, path);
     return STATUS(r);
 }
 
@@ -1404,10 +1614,16 @@ static int vopenat(int dirfd, const char* path, int flags, va_list args) {
             return ERRNO(EINVAL);
         }
         mode = va_arg(args, uint32_t) & 0777;
+    } else if (__fdio_cache_missing(dirfd, path)) {
+        return ERRNO(ENOENT);
     }
     if ((r = __fdio_open_at(&io, dirfd, path, flags, mode)) < 0) {
         return ERROR(r);
     }
+    if ((flags & O_ACCMODE) != O_RDONLY || (flags & O_TRUNC)) {
+        // Writes through the new fd change the attributes we may have cached.
+        __fdio_cache_invalidate(dirfd, path);
+    }
     if (flags & O_NONBLOCK) {
         io->ioflag |= IOFLAG_NONBLOCK;
     }
@@ -1492,7 +1708,15 @@ int fstatat(int dirfd, const char* fn, struct stat* s, int flags) {
     zx_status_t r;
 
     LOG(1,"fdio: fstatat(%d, '%s',...)\n", dirfd, fn);
-    if ((r = __fdio_open_at(&io, dirfd, fn, O_PATH, 0)) < 0) {
+    vnattr_t attr;
+    if ((r = __fdio_cache_getattr(dirfd, fn, &attr)) != ZX_ERR_NOT_SUPPORTED) {
+        if (r < 0) {
+            return ERROR(r);
+        }
+        vnattr_to_stat(&attr, s);
+        return 0;
+    }
+    if ((r = fdio_open_at_pipelined(&io, dirfd, fn, O_PATH, 0)) < 0) {
         return ERROR(r);
     }
     LOG(1,"fdio: fstatat io=%p\n", io);
@@ -1592,7 +1816,7 @@ int utimensat(int dirfd, const char *fn,
         // symlinks, so don't break utilities (like tar) that use this flag.
     }
 
-    if ((r = __fdio_open_at(&io, dirfd, fn, 0, 0)) < 0) {
+    if ((r = fdio_open_at_pipelined(&io, dirfd, fn, 0, 0)) < 0) {
         return ERROR(r);
     }
 
@@ -1600,6 +1824,7 @@ int utimensat(int dirfd, const char *fn,
 
     fdio_close(io);
     fdio_release(io);
+    __fdio_cache_invalidate(dirfd, fn);
     return STATUS(r);
 }
 
@@ -1663,7 +1888,11 @@ int faccessat(int dirfd, const char* filename, int amode, int flag) {
     // file exists a la fstatat.
     fdio_t* io;
     zx_status_t status;
-    if ((status = __fdio_open_at(&io, dirfd, filename, 0, 0)) < 0) {
+    vnattr_t attr;
+    if ((status = __fdio_cache_getattr(dirfd, filename, &attr)) != ZX_ERR_NOT_SUPPORTED) {
+        return STATUS(status);
+    }
+    if ((status = fdio_open_at_pipelined(&io, dirfd, filename, 0, 0)) < 0) {
         return ERROR(status);
     }
     struct stat s;
@@ -1906,6 +2135,8 @@ int ppoll(struct pollfd* fds, nfds_t n,
     nfds_t nvalid = 0;
 
     zx_wait_item_t items[n];
+    int item_fds[n];
+    fdio_t* item_ios[n];
 
     for (nfds_t i = 0; i < n; i++) {
         struct pollfd* pfd = &fds[i];
@@ -1936,6 +2167,8 @@ int ppoll(struct pollfd* fds, nfds_t n,
         items[nvalid].handle = h;
         items[nvalid].waitfor = sigs;
         items[nvalid].pending = 0;
+        item_fds[nvalid] = pfd->fd;
+        item_ios[nvalid] = io;
         nvalid++;
     }
 
@@ -1951,7 +2184,7 @@ int ppoll(struct pollfd* fds, nfds_t n,
                 tmo = zx_deadline_after(duration);
             }
         }
-        r = zx_object_wait_many(items, nvalid, tmo);
+        r = fdio_pollset_wait(item_fds, item_ios, items, nvalid, tmo);
         // pending signals could be reported on ZX_ERR_TIMED_OUT case as well
         if (r == ZX_OK || r == ZX_ERR_TIMED_OUT) {
             nfds_t j = 0; // j counts up on a valid entry
@@ -2006,6 +2239,8 @@ int select(int n, fd_set* restrict rfds, fd_set* restrict wfds, fd_set* restrict
     int nvalid = 0;
 
     zx_wait_item_t items[n];
+    int item_fds[n];
+    fdio_t* item_ios[n];
 
     for (int fd = 0; fd < n; fd++) {
         ios[fd] = NULL;
@@ -2039,6 +2274,8 @@ int select(int n, fd_set* restrict rfds, fd_set* restrict wfds, fd_set* restrict
         items[nvalid].handle = h;
         items[nvalid].waitfor = sigs;
         items[nvalid].pending = 0;
+        item_fds[nvalid] = fd;
+        item_ios[nvalid] = io;
         nvalid++;
     }
 
@@ -2046,7 +2283,7 @@ int select(int n, fd_set* restrict rfds, fd_set* restrict wfds, fd_set* restrict
     if (r == ZX_OK && nvalid > 0) {
         zx_time_t tmo = (tv == NULL) ? ZX_TIME_INFINITE :
             zx_deadline_after(ZX_SEC(tv->tv_sec) + ZX_USEC(tv->tv_usec));
-        r = zx_object_wait_many(items, nvalid, tmo);
+        r = fdio_pollset_wait(item_fds, item_ios, items, nvalid, tmo);
         // pending signals could be reported on ZX_ERR_TIMED_OUT case as well
         if (r == ZX_OK || r == ZX_ERR_TIMED_OUT) {
             int j = 0; // j counts up on a valid entry
@@ -6,6 +6,8 @@
 
 #include <errno.h>
 #include <fdio/io.h>
+#include <fdio/private.h>
+#include <fdio/vfs.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <sys/types.h>
@@ -20,6 +22,15 @@ fdio_t* __fdio_fd_to_io(int fd);
 zx_status_t __fdio_open_at(fdio_t** io, int dirfd, const char* path, int flags, uint32_t mode);
 zx_status_t __fdio_open(fdio_t** io, const char* path, int flags, uint32_t mode);
 
+// The client-side lookup cache (see fdio/cache.h). __fdio_cache_getattr()
+// returns ZX_ERR_NOT_SUPPORTED when it cannot answer for |path|, leaving the
+// caller to go to the server as usual.
+zx_status_t __fdio_cache_getattr(int dirfd, const char* path, vnattr_t* attr);
+bool __fdio_cache_missing(int dirfd, const char* path);
+void __fdio_cache_invalidate(int dirfd, const char* path);
+void __fdio_cache_flush(void);
+void __fdio_cache_init(void);
+
 int fdio_status_to_errno(zx_status_t status);
 
 // set errno to the closest match for error and return -1
@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include <fidl/internal.h>
+#include <zircon/assert.h>
 
 namespace fidl {
 
@@ -41,4 +42,10 @@ void Builder::Reset(void* buffer, uint32_t capacity) {
     at_ = 0u;
 }
 
+void Builder::Rewind(uint32_t size) {
+    ZX_DEBUG_ASSERT(size <= at_);
+    ZX_DEBUG_ASSERT(FidlAlign(size) == size);
+    at_ = size;
+}
+
 } // namespace fidl
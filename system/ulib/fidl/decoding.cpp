@@ -296,6 +296,13 @@ zx_status_t FidlDecoder::DecodeMessage() {
     // needs to be.
     out_of_line_offset_ = type_->coded_struct.size;
 
+    // A struct without coded fields holds no handles or out-of-line
+    // data, so there is nothing to walk.
+    if (type_->coded_struct.field_count == 0u) {
+        return fidl_decode_fixed(type_->coded_struct.size, bytes_, num_bytes_, num_handles_,
+                                 error_msg_out_);
+    }
+
     Push(Frame::DoneSentinel());
     Push(Frame(type_, 0u));
 
@@ -489,3 +496,25 @@ zx_status_t fidl_decode(const fidl_type_t* type, void* bytes, uint32_t num_bytes
     FidlDecoder decoder(type, bytes, num_bytes, handles, num_handles, error_msg_out);
     return decoder.DecodeMessage();
 }
+
+zx_status_t fidl_decode_fixed(uint32_t size, void* bytes, uint32_t num_bytes,
+                              uint32_t num_handles, const char** error_msg_out) {
+    // These checks, and their order, match what fidl_decode does for a
+    // struct without coded fields.
+    const char* error_msg;
+    if (bytes == nullptr) {
+        error_msg = "Cannot decode null bytes";
+    } else if (size > num_bytes) {
+        error_msg = "Message size is smaller than expected";
+    } else if (size != num_bytes) {
+        error_msg = "message did not decode all provided bytes";
+    } else if (num_handles != 0u) {
+        error_msg = "message did not contain the specified number of handles";
+    } else {
+        return ZX_OK;
+    }
+    if (error_msg_out != nullptr) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
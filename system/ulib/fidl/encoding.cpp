@@ -305,6 +305,13 @@ zx_status_t FidlEncoder::EncodeMessage() {
     // needs to be.
     out_of_line_offset_ = type_->coded_struct.size;
 
+    // A struct without coded fields holds no handles or out-of-line
+    // data, so there is nothing to walk.
+    if (type_->coded_struct.field_count == 0u) {
+        return fidl_encode_fixed(type_->coded_struct.size, bytes_, num_bytes_,
+                                 actual_handles_out_, error_msg_out_);
+    }
+
     Push(Frame::DoneSentinel());
     Push(Frame(type_, 0u));
 
@@ -464,3 +471,26 @@ zx_status_t fidl_encode(const fidl_type_t* type, void* bytes, uint32_t num_bytes
                         error_msg_out);
     return encoder.EncodeMessage();
 }
+
+zx_status_t fidl_encode_fixed(uint32_t size, void* bytes, uint32_t num_bytes,
+                              uint32_t* actual_handles_out, const char** error_msg_out) {
+    // These checks, and their order, match what fidl_encode does for a
+    // struct without coded fields.
+    const char* error_msg;
+    if (bytes == nullptr) {
+        error_msg = "Cannot encode null bytes";
+    } else if (actual_handles_out == nullptr) {
+        error_msg = "Cannot encode with null actual_handles_out";
+    } else if (size > num_bytes) {
+        error_msg = "Message size is smaller than expected";
+    } else if (size != num_bytes) {
+        error_msg = "did not encode the entire provided buffer";
+    } else {
+        *actual_handles_out = 0u;
+        return ZX_OK;
+    }
+    if (error_msg_out != nullptr) {
+        *error_msg_out = error_msg;
+    }
+    return ZX_ERR_INVALID_ARGS;
+}
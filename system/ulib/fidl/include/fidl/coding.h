@@ -31,4 +31,14 @@ zx_status_t fidl_decode(const fidl_type_t* type, void* bytes, uint32_t num_bytes
                         const zx_handle_t* handles, uint32_t num_handles,
                         const char** error_msg_out);
 
+// See
+// https://fuchsia.googlesource.com/zircon/+/HEAD/docs/fidl/c-language-bindings.md#fidl_encode_fixed
+zx_status_t fidl_encode_fixed(uint32_t size, void* bytes, uint32_t num_bytes,
+                              uint32_t* actual_handles_out, const char** error_msg_out);
+
+// See
+// https://fuchsia.googlesource.com/zircon/+/HEAD/docs/fidl/c-language-bindings.md#fidl_decode_fixed
+zx_status_t fidl_decode_fixed(uint32_t size, void* bytes, uint32_t num_bytes,
+                              uint32_t num_handles, const char** error_msg_out);
+
 __END_CDECLS
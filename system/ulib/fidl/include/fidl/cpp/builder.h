@@ -86,6 +86,18 @@ public:
     // next object will be allocated at the start of the buffer.
     void Reset(void* buffer, uint32_t capacity);
 
+    // The number of bytes allocated from the buffer so far, including the
+    // padding needed to keep each object aligned.
+    uint32_t size() const { return at_; }
+
+    // Discards every object allocated after the first |size| bytes of the
+    // buffer, keeping the attached storage.
+    //
+    // |size| is typically a value previously returned by |size()|, which lets
+    // a caller rewind the buffer to a checkpoint (for example, just past a
+    // message header) in one step rather than reattaching the storage.
+    void Rewind(uint32_t size);
+
 protected:
     uint8_t* buffer() const { return buffer_; }
     uint32_t capacity() const { return capacity_; }
@@ -19,6 +19,18 @@ namespace fidl {
 // A Message object does not own the storage for the message parts.
 class Message {
 public:
+    // Encode and decode functions specialized to a single message type, such
+    // as those the FIDL compiler emits for messages without handles or
+    // out-of-line data.  They take the same arguments as fidl_encode() and
+    // fidl_decode(), less the type.
+    using EncodeFunction = zx_status_t (*)(void* bytes, uint32_t num_bytes,
+                                           zx_handle_t* handles, uint32_t max_handles,
+                                           uint32_t* actual_handles_out,
+                                           const char** error_msg_out);
+    using DecodeFunction = zx_status_t (*)(void* bytes, uint32_t num_bytes,
+                                           const zx_handle_t* handles, uint32_t num_handles,
+                                           const char** error_msg_out);
+
     // Creates a message without any storage.
     Message();
 
@@ -98,6 +110,10 @@ public:
     // decoded using the |Decode| method.
     zx_status_t Encode(const fidl_type_t* type, const char** error_msg_out);
 
+    // Encodes the message in-place using a function specialized to its type
+    // rather than walking a coding table.
+    zx_status_t Encode(EncodeFunction encode, const char** error_msg_out);
+
     // Decodes the message in-place.
     //
     // The message must previously have been in an encoded state, for example,
@@ -105,6 +121,14 @@ public:
     // |Encode| method.
     zx_status_t Decode(const fidl_type_t* type, const char** error_msg_out);
 
+    // Decodes the message in-place using a function specialized to its type
+    // rather than walking a coding table.
+    //
+    // On success the message has been checked to be exactly as large as the
+    // decoded type, so GetPayloadAs() may be used without further bounds
+    // checks.
+    zx_status_t Decode(DecodeFunction decode, const char** error_msg_out);
+
     // Read a message from the given channel.
     //
     // The bytes read from the channel are stored in bytes() and the handles
@@ -112,6 +136,17 @@ public:
     // buffers is overwritten.
     zx_status_t Read(zx_handle_t channel, uint32_t flags);
 
+    // Read up to |count| messages from the given channel with a single
+    // syscall, one into each element of |messages|.
+    //
+    // Reading stops early when the channel runs out of messages or the next
+    // message does not fit in the corresponding element's storage.  The number
+    // of messages read is returned in |actual_count|.  |count| is clamped to
+    // ZX_CHANNEL_MAX_MSGS_PER_BATCH.
+    static zx_status_t ReadMany(zx_handle_t channel, uint32_t flags,
+                                Message* messages, uint32_t count,
+                                uint32_t* actual_count);
+
     // Writes a message to the given channel.
     //
     // The bytes stored in bytes() are written to the channel and the handles
@@ -121,6 +156,14 @@ public:
     // consumed by this operation.
     zx_status_t Write(zx_handle_t channel, uint32_t flags);
 
+    // Writes |count| messages to the given channel with a single syscall.
+    //
+    // Either every message is written or, on failure, none of them are.  If
+    // this method returns ZX_OK, the handles() of every message will be empty.
+    // |count| must not exceed ZX_CHANNEL_MAX_MSGS_PER_BATCH.
+    static zx_status_t WriteMany(zx_handle_t channel, uint32_t flags,
+                                 Message* messages, uint32_t count);
+
     // Issues a synchronous send and receive transaction on the given channel.
     //
     // The bytes stored in bytes() are written to the channel and the handles
@@ -8,6 +8,7 @@
 
 #include <fidl/cpp/builder.h>
 #include <fidl/cpp/message.h>
+#include <fidl/cpp/message_buffer_pool.h>
 #include <zircon/fidl.h>
 #include <zircon/types.h>
 
@@ -23,9 +24,20 @@ public:
         uint32_t bytes_capacity = ZX_CHANNEL_MAX_MSG_BYTES,
         uint32_t handles_capacity = ZX_CHANNEL_MAX_MSG_HANDLES);
 
-    // The memory that backs the message is freed by this destructor.
+    // Creates a |MessageBuffer| whose memory comes from |pool|, with the
+    // capacities of the buffers in that pool.
+    //
+    // The memory is returned to |pool| when the |MessageBuffer| is destructed,
+    // so |pool| must outlive this object.
+    explicit MessageBuffer(MessageBufferPool* pool);
+
+    // The memory that backs the message is freed by this destructor, or
+    // returned to the pool it came from.
     ~MessageBuffer();
 
+    MessageBuffer(const MessageBuffer& other) = delete;
+    MessageBuffer& operator=(const MessageBuffer& other) = delete;
+
     // The memory in which bytes can be stored in this buffer.
     uint8_t* bytes() const { return buffer_; }
 
@@ -44,6 +56,12 @@ public:
     Message CreateEmptyMessage();
 
 private:
+    friend class MessageBufferPool;
+
+    // The size of the allocation that backs a buffer of the given capacities.
+    static size_t GetAllocSize(uint32_t bytes_capacity, uint32_t handles_capacity);
+
+    MessageBufferPool* const pool_;
     uint8_t* const buffer_;
     const uint32_t bytes_capacity_;
     const uint32_t handles_capacity_;
@@ -0,0 +1,89 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zircon/types.h>
+
+namespace fidl {
+
+// A cache of the memory that backs |MessageBuffer| objects.
+//
+// A server that creates a |MessageBuffer| (or |MessageBuilder|) for each
+// message it handles otherwise allocates and frees a channel-sized buffer per
+// message. Constructing those objects from a pool instead recycles the memory
+// of buffers that have been destroyed.
+//
+// A |MessageBufferPool| is not thread-safe. The expected use is one pool per
+// thread or per async loop, shared by the handlers that run there. Every
+// buffer taken from the pool must be destroyed before the pool is.
+class MessageBufferPool {
+public:
+    // The number of buffers a pool keeps by default once they are returned.
+    static constexpr uint32_t kDefaultMaxCached = 4u;
+
+    struct Stats {
+        // The number of buffers that were served from the cache.
+        uint64_t hits;
+        // The number of buffers that had to be allocated.
+        uint64_t misses;
+        // The number of returned buffers that were freed because the cache
+        // was already full.
+        uint64_t drops;
+        // The number of buffers currently sitting in the cache.
+        uint32_t cached;
+        // The number of buffers currently in use.
+        uint32_t outstanding;
+    };
+
+    // Creates a pool of buffers for messages of the given capacities, which
+    // keeps at most |max_cached| unused buffers around.
+    explicit MessageBufferPool(
+        uint32_t max_cached = kDefaultMaxCached,
+        uint32_t bytes_capacity = ZX_CHANNEL_MAX_MSG_BYTES,
+        uint32_t handles_capacity = ZX_CHANNEL_MAX_MSG_HANDLES);
+
+    // Frees the cached buffers.
+    ~MessageBufferPool();
+
+    MessageBufferPool(const MessageBufferPool& other) = delete;
+    MessageBufferPool& operator=(const MessageBufferPool& other) = delete;
+
+    // The capacities of the buffers handed out by this pool.
+    uint32_t bytes_capacity() const { return bytes_capacity_; }
+    uint32_t handles_capacity() const { return handles_capacity_; }
+
+    // Counters describing how well the pool is doing.
+    const Stats& stats() const { return stats_; }
+
+    // Frees all the cached buffers, for example once a burst of traffic is
+    // over. Buffers that are in use are unaffected.
+    void Trim();
+
+private:
+    friend class MessageBuffer;
+
+    // Returns memory for one buffer, or nullptr if it cannot be allocated.
+    uint8_t* Acquire();
+
+    // Takes back memory previously returned by |Acquire|.
+    void Release(uint8_t* buffer);
+
+    // The cached buffers are linked through their first bytes.
+    struct FreeBuffer {
+        FreeBuffer* next;
+    };
+
+    const uint32_t max_cached_;
+    const uint32_t bytes_capacity_;
+    const uint32_t handles_capacity_;
+    const size_t alloc_size_;
+    FreeBuffer* free_list_;
+    Stats stats_;
+};
+
+} // namespace fidl
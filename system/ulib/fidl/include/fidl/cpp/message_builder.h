@@ -8,6 +8,7 @@
 
 #include <fidl/cpp/builder.h>
 #include <fidl/cpp/message_buffer.h>
+#include <fidl/cpp/message_buffer_pool.h>
 #include <fidl/cpp/message.h>
 #include <zircon/fidl.h>
 #include <zircon/types.h>
@@ -36,6 +37,10 @@ public:
         uint32_t bytes_capacity = ZX_CHANNEL_MAX_MSG_BYTES,
         uint32_t handles_capacity = ZX_CHANNEL_MAX_MSG_HANDLES);
 
+    // Creates a |MessageBuilder| for the given |type| whose buffers come from
+    // |pool|, and are returned there when the |MessageBuilder| is destructed.
+    MessageBuilder(const fidl_type_t* type, MessageBufferPool* pool);
+
     // The memory that backs the message is freed by this destructor.
     ~MessageBuilder();
 
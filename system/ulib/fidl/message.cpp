@@ -45,6 +45,17 @@ zx_status_t Message::Encode(const fidl_type_t* type,
     return status;
 }
 
+zx_status_t Message::Encode(EncodeFunction encode,
+                            const char** error_msg_out) {
+    uint32_t actual_handles = 0u;
+    zx_status_t status = encode(bytes_.data(), bytes_.actual(),
+                                handles_.data(), handles_.capacity(),
+                                &actual_handles, error_msg_out);
+    if (status == ZX_OK)
+        handles_.set_actual(actual_handles);
+    return status;
+}
+
 zx_status_t Message::Decode(const fidl_type_t* type,
                             const char** error_msg_out) {
     zx_status_t status = fidl_decode(type, bytes_.data(), bytes_.actual(),
@@ -55,6 +66,16 @@ zx_status_t Message::Decode(const fidl_type_t* type,
     return status;
 }
 
+zx_status_t Message::Decode(DecodeFunction decode,
+                            const char** error_msg_out) {
+    zx_status_t status = decode(bytes_.data(), bytes_.actual(),
+                                handles_.data(), handles_.actual(),
+                                error_msg_out);
+    if (status == ZX_OK)
+        ClearHandlesUnsafe();
+    return status;
+}
+
 zx_status_t Message::Read(zx_handle_t channel, uint32_t flags) {
     uint32_t actual_bytes = 0u;
     uint32_t actual_handles = 0u;
@@ -68,6 +89,50 @@ zx_status_t Message::Read(zx_handle_t channel, uint32_t flags) {
     return status;
 }
 
+zx_status_t Message::ReadMany(zx_handle_t channel, uint32_t flags,
+                              Message* messages, uint32_t count,
+                              uint32_t* actual_count) {
+    if (count > ZX_CHANNEL_MAX_MSGS_PER_BATCH)
+        count = ZX_CHANNEL_MAX_MSGS_PER_BATCH;
+    zx_channel_msg_t msgs[ZX_CHANNEL_MAX_MSGS_PER_BATCH];
+    for (uint32_t i = 0; i < count; ++i) {
+        msgs[i].bytes = messages[i].bytes_.data();
+        msgs[i].handles = messages[i].handles_.data();
+        msgs[i].num_bytes = messages[i].bytes_.capacity();
+        msgs[i].num_handles = messages[i].handles_.capacity();
+    }
+    uint32_t actual = 0u;
+    zx_status_t status = zx_channel_read_many(channel, flags, msgs, count, &actual);
+    if (status == ZX_OK) {
+        for (uint32_t i = 0; i < actual; ++i) {
+            messages[i].bytes_.set_actual(msgs[i].num_bytes);
+            messages[i].handles_.set_actual(msgs[i].num_handles);
+        }
+    }
+    if (actual_count)
+        *actual_count = actual;
+    return status;
+}
+
+zx_status_t Message::WriteMany(zx_handle_t channel, uint32_t flags,
+                               Message* messages, uint32_t count) {
+    if (count > ZX_CHANNEL_MAX_MSGS_PER_BATCH)
+        return ZX_ERR_OUT_OF_RANGE;
+    zx_channel_msg_t msgs[ZX_CHANNEL_MAX_MSGS_PER_BATCH];
+    for (uint32_t i = 0; i < count; ++i) {
+        msgs[i].bytes = messages[i].bytes_.data();
+        msgs[i].handles = messages[i].handles_.data();
+        msgs[i].num_bytes = messages[i].bytes_.actual();
+        msgs[i].num_handles = messages[i].handles_.actual();
+    }
+    zx_status_t status = zx_channel_write_many(channel, flags, msgs, count);
+    if (status == ZX_OK) {
+        for (uint32_t i = 0; i < count; ++i)
+            messages[i].ClearHandlesUnsafe();
+    }
+    return status;
+}
+
 zx_status_t Message::Write(zx_handle_t channel, uint32_t flags) {
     zx_status_t status = zx_channel_write(channel, flags, bytes_.data(),
                                           bytes_.actual(), handles_.data(),
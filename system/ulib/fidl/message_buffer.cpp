@@ -14,23 +14,36 @@ uint32_t GetPadding(uint32_t offset) {
     return offset & kMask;
 }
 
-size_t GetAllocSize(uint32_t bytes_capacity, uint32_t handles_capacity) {
+} // namespace
+
+size_t MessageBuffer::GetAllocSize(uint32_t bytes_capacity,
+                                   uint32_t handles_capacity) {
     return bytes_capacity + GetPadding(bytes_capacity) +
         sizeof(zx_handle_t) * handles_capacity;
 }
 
-} // namespace
-
 MessageBuffer::MessageBuffer(uint32_t bytes_capacity,
                              uint32_t handles_capacity)
-    : buffer_(static_cast<uint8_t*>(
+    : pool_(nullptr),
+      buffer_(static_cast<uint8_t*>(
           malloc(GetAllocSize(bytes_capacity, handles_capacity)))),
       bytes_capacity_(bytes_capacity),
       handles_capacity_(handles_capacity) {
 }
 
+MessageBuffer::MessageBuffer(MessageBufferPool* pool)
+    : pool_(pool),
+      buffer_(pool->Acquire()),
+      bytes_capacity_(buffer_ != nullptr ? pool->bytes_capacity() : 0u),
+      handles_capacity_(buffer_ != nullptr ? pool->handles_capacity() : 0u) {
+}
+
 MessageBuffer::~MessageBuffer() {
-    free(buffer_);
+    if (pool_ != nullptr) {
+        pool_->Release(buffer_);
+    } else {
+        free(buffer_);
+    }
 }
 
 zx_handle_t* MessageBuffer::handles() const {
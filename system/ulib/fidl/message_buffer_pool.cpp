@@ -0,0 +1,75 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fidl/cpp/message_buffer_pool.h>
+
+#include <stdlib.h>
+
+#include <fidl/cpp/message_buffer.h>
+#include <zircon/assert.h>
+
+namespace fidl {
+
+constexpr uint32_t MessageBufferPool::kDefaultMaxCached;
+
+MessageBufferPool::MessageBufferPool(uint32_t max_cached,
+                                     uint32_t bytes_capacity,
+                                     uint32_t handles_capacity)
+    : max_cached_(max_cached),
+      bytes_capacity_(bytes_capacity),
+      handles_capacity_(handles_capacity),
+      alloc_size_(MessageBuffer::GetAllocSize(bytes_capacity, handles_capacity)),
+      free_list_(nullptr),
+      stats_{} {
+}
+
+MessageBufferPool::~MessageBufferPool() {
+    ZX_DEBUG_ASSERT(stats_.outstanding == 0u);
+    Trim();
+}
+
+void MessageBufferPool::Trim() {
+    while (free_list_ != nullptr) {
+        FreeBuffer* buffer = free_list_;
+        free_list_ = buffer->next;
+        free(buffer);
+    }
+    stats_.cached = 0u;
+}
+
+uint8_t* MessageBufferPool::Acquire() {
+    uint8_t* buffer;
+    if (free_list_ != nullptr) {
+        buffer = reinterpret_cast<uint8_t*>(free_list_);
+        free_list_ = free_list_->next;
+        --stats_.cached;
+        ++stats_.hits;
+    } else {
+        buffer = static_cast<uint8_t*>(malloc(
+            alloc_size_ < sizeof(FreeBuffer) ? sizeof(FreeBuffer) : alloc_size_));
+        if (buffer == nullptr)
+            return nullptr;
+        ++stats_.misses;
+    }
+    ++stats_.outstanding;
+    return buffer;
+}
+
+void MessageBufferPool::Release(uint8_t* buffer) {
+    if (buffer == nullptr)
+        return;
+    ZX_DEBUG_ASSERT(stats_.outstanding > 0u);
+    --stats_.outstanding;
+    if (stats_.cached >= max_cached_) {
+        ++stats_.drops;
+        free(buffer);
+        return;
+    }
+    FreeBuffer* entry = reinterpret_cast<FreeBuffer*>(buffer);
+    entry->next = free_list_;
+    free_list_ = entry;
+    ++stats_.cached;
+}
+
+} // namespace fidl
@@ -17,6 +17,13 @@ MessageBuilder::MessageBuilder(const fidl_type_t* type,
     Reset();
 }
 
+MessageBuilder::MessageBuilder(const fidl_type_t* type,
+                               MessageBufferPool* pool)
+    : type_(type),
+      buffer_(pool) {
+    Reset();
+}
+
 MessageBuilder::~MessageBuilder() = default;
 
 zx_status_t MessageBuilder::Encode(Message* message_out,
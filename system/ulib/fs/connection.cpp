@@ -18,6 +18,8 @@
 #include <fs/trace.h>
 #include <fs/vnode.h>
 #include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zx/vmo.h>
 
 #define ZXDEBUG 0
 
@@ -32,6 +34,20 @@ void WriteDescribeError(zx::channel channel, zx_status_t status) {
     channel.write(0, &msg, sizeof(zxrio_describe_t), nullptr, 0);
 }
 
+// Maps the first |len| bytes of a vmo sent with READ_VMO or WRITE_VMO.
+zx_status_t MapTransferVmo(const zx::vmo& vmo, size_t len, uint32_t flags, uintptr_t* out) {
+    uint64_t size;
+    zx_status_t status = vmo.get_size(&size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (len > size) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return zx_vmar_map(zx_vmar_root_self(), 0, vmo.get(), 0, len,
+                       flags | ZX_VM_FLAG_MAP_RANGE, out);
+}
+
 void Describe(const fbl::RefPtr<Vnode>& vn, uint32_t flags,
               zxrio_describe_t* response, zx_handle_t* handle) {
     response->op = ZXRIO_ON_OPEN;
@@ -78,6 +94,10 @@ void OpenAt(Vfs* vfs, fbl::RefPtr<Vnode> parent,
     if (describe) {
         // Regardless of the error code, in the 'describe' case, we
         // should respond to the client.
+        //
+        // Clients may queue requests behind the open without waiting for
+        // this description, so it must be written before the channel is
+        // served; they tell it apart from replies by its zero txid.
         if (r != ZX_OK) {
             WriteDescribeError(fbl::move(channel), r);
             return;
@@ -309,6 +329,77 @@ zx_status_t Connection::HandleMessage(zxrio_msg_t* msg) {
         }
         return status;
     }
+    case ZXRIO_READ_VMO: {
+        TRACE_DURATION("vfs", "ZXRIO_READ_VMO");
+        zx::vmo vmo(msg->handle[0]); // take ownership
+        if (!IsReadable(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        }
+        bool seek = msg->arg2.off == ZXRIO_VMO_SEEK_OFFSET;
+        if ((arg <= 0) || (!seek && msg->arg2.off < 0)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        uintptr_t addr;
+        zx_status_t status = MapTransferVmo(vmo, arg, ZX_VM_FLAG_PERM_READ |
+                                            ZX_VM_FLAG_PERM_WRITE, &addr);
+        if (status != ZX_OK) {
+            return status;
+        }
+        size_t actual;
+        status = vnode_->Read(reinterpret_cast<void*>(addr), arg,
+                              seek ? offset_ : msg->arg2.off, &actual);
+        zx_vmar_unmap(zx_vmar_root_self(), addr, arg);
+        if (status != ZX_OK) {
+            return status;
+        }
+        ZX_DEBUG_ASSERT(actual <= static_cast<size_t>(arg));
+        if (seek) {
+            offset_ += actual;
+            msg->arg2.off = offset_;
+        }
+        return static_cast<zx_status_t>(actual);
+    }
+    case ZXRIO_WRITE_VMO: {
+        TRACE_DURATION("vfs", "ZXRIO_WRITE_VMO");
+        zx::vmo vmo(msg->handle[0]); // take ownership
+        if (!IsWritable(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        }
+        bool seek = msg->arg2.off == ZXRIO_VMO_SEEK_OFFSET;
+        if ((arg <= 0) || (!seek && msg->arg2.off < 0)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        uintptr_t addr;
+        zx_status_t status = MapTransferVmo(vmo, arg, ZX_VM_FLAG_PERM_READ, &addr);
+        if (status != ZX_OK) {
+            return status;
+        }
+        const void* data = reinterpret_cast<const void*>(addr);
+        size_t actual;
+        if (!seek) {
+            status = vnode_->Write(data, arg, msg->arg2.off, &actual);
+        } else if (flags_ & ZX_FS_FLAG_APPEND) {
+            size_t end;
+            status = vnode_->Append(data, arg, &end, &actual);
+            if (status == ZX_OK) {
+                offset_ = end;
+            }
+        } else {
+            status = vnode_->Write(data, arg, offset_, &actual);
+            if (status == ZX_OK) {
+                offset_ += actual;
+            }
+        }
+        zx_vmar_unmap(zx_vmar_root_self(), addr, arg);
+        if (status != ZX_OK) {
+            return status;
+        }
+        ZX_DEBUG_ASSERT(actual <= static_cast<size_t>(arg));
+        if (seek) {
+            msg->arg2.off = offset_;
+        }
+        return static_cast<zx_status_t>(actual);
+    }
     case ZXRIO_SEEK: {
         TRACE_DURATION("vfs", "ZXRIO_SEEK");
         if (IsPathOnly(flags_)) {
@@ -602,21 +693,22 @@ zx_status_t Connection::HandleMessage(zxrio_msg_t* msg) {
         if (IsPathOnly(flags_)) {
             return ZX_ERR_BAD_HANDLE;
         }
-        zx_txid_t txid = msg->txid;
-        Vnode::SyncCallback closure([this, txid](zx_status_t status) {
-            zxrio_msg_t msg;
-            memset(&msg, 0, ZXRIO_HDR_SZ);
-            msg.txid = txid;
-            msg.op = ZXRIO_STATUS;
-            msg.arg = status;
-            zxrio_respond(channel_.get(), &msg);
-
-            // Reset the wait object
-            ZX_ASSERT(wait_.Begin(vfs_->async()) == ZX_OK);
-        });
-
-        vnode_->Sync(fbl::move(closure));
-        return ERR_DISPATCHER_ASYNC;
+        return SyncAndRespond(msg->txid);
+    }
+    case ZXRIO_MSYNC: {
+        TRACE_DURATION("vfs", "ZXRIO_MSYNC");
+        if (IsPathOnly(flags_)) {
+            return ZX_ERR_BAD_HANDLE;
+        }
+        if (len != sizeof(zxrio_msync_data_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        zxrio_msync_data_t* data = reinterpret_cast<zxrio_msync_data_t*>(msg->data);
+        zx_status_t status = vnode_->Msync(data->offset, data->length);
+        if (status != ZX_OK || !(data->flags & FDIO_MSYNC_FLAG_SYNC)) {
+            return status;
+        }
+        return SyncAndRespond(msg->txid);
     }
     case ZXRIO_UNLINK: {
         TRACE_DURATION("vfs", "ZXRIO_UNLINK");
@@ -631,4 +723,21 @@ zx_status_t Connection::HandleMessage(zxrio_msg_t* msg) {
     }
 }
 
+zx_status_t Connection::SyncAndRespond(zx_txid_t txid) {
+    Vnode::SyncCallback closure([this, txid](zx_status_t status) {
+        zxrio_msg_t msg;
+        memset(&msg, 0, ZXRIO_HDR_SZ);
+        msg.txid = txid;
+        msg.op = ZXRIO_STATUS;
+        msg.arg = status;
+        zxrio_respond(channel_.get(), &msg);
+
+        // Reset the wait object
+        ZX_ASSERT(wait_.Begin(vfs_->async()) == ZX_OK);
+    });
+
+    vnode_->Sync(fbl::move(closure));
+    return ERR_DISPATCHER_ASYNC;
+}
+
 } // namespace fs
@@ -24,6 +24,11 @@ namespace fs {
 // component of a file descriptor).  The Vnode's methods will be invoked
 // in response to RIO protocol messages received over the channel.
 //
+// A connection handles one message at a time: its wait is only re-armed once
+// the previous message has been handled. The dispatcher may run on several
+// threads, however, in which case messages on different connections are
+// handled concurrently, and Vnodes must guard their own state.
+//
 // This class is thread-safe.
 class Connection : public fbl::DoublyLinkedListable<fbl::unique_ptr<Connection>> {
 public:
@@ -60,6 +65,10 @@ private:
     static zx_status_t HandleMessageThunk(zxrio_msg_t* msg, void* cookie);
     zx_status_t HandleMessage(zxrio_msg_t* msg);
 
+    // Syncs the vnode, replying to the request |txid| once it is done.
+    // Returns ERR_DISPATCHER_ASYNC, for the handler to return.
+    zx_status_t SyncAndRespond(zx_txid_t txid);
+
     bool is_waiting() const { return wait_.object() != ZX_HANDLE_INVALID; }
 
     fs::Vfs* const vfs_;
@@ -9,6 +9,7 @@
 #endif
 
 #include <fbl/intrusive_double_list.h>
+#include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
 #include <fs/connection.h>
 #include <fs/vfs.h>
@@ -30,7 +31,9 @@ protected:
     void UnregisterAndDestroyConnection(Connection* connection) final;
 
 private:
-    fbl::DoublyLinkedList<fbl::unique_ptr<Connection>> connections_;
+    // Connections may come and go on several dispatch threads at once.
+    fbl::Mutex connections_lock_;
+    fbl::DoublyLinkedList<fbl::unique_ptr<Connection>> connections_ __TA_GUARDED(connections_lock_);
 };
 
 } // namespace fs
@@ -23,3 +23,4 @@
 
 #define FS_TRACE_ERROR(fmt...) fprintf(stderr, fmt)
 #define FS_TRACE_WARN(fmt...) fprintf(stderr, fmt)
+#define FS_TRACE_INFO(fmt...) fprintf(stderr, fmt)
@@ -24,8 +24,10 @@
 #include <zx/event.h>
 #include <zx/vmo.h>
 #include <fbl/mutex.h>
+#include <pthread.h>
 #endif // __Fuchsia__
 
+#include <fbl/atomic.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/macros.h>
 #include <fbl/ref_counted.h>
@@ -104,6 +106,12 @@ private:
 //
 // The Vfs object must outlive the Vnodes which it serves.
 //
+// Path operations (lookup, open, create, unlink, rename, link, readdir and
+// mounting) are serialized against one another by the namespace lock. A
+// filesystem whose vnodes guard their own state may opt in to vnode locking,
+// in which case operations confined to one directory only exclude others in
+// the same directory, and only those spanning directories exclude them all.
+//
 // This class is thread-safe.
 class Vfs {
 public:
@@ -125,7 +133,7 @@ public:
                       void* out_buf, size_t out_len, size_t* out_actual) __TA_EXCLUDES(vfs_lock_);
 
     // Sets whether this file system is read-only.
-    void SetReadonly(bool value) __TA_EXCLUDES(vfs_lock_);
+    void SetReadonly(bool value);
 
 #ifdef __Fuchsia__
     void TokenDiscard(zx::event ios_token) __TA_EXCLUDES(vfs_lock_);
@@ -142,6 +150,10 @@ public:
 
     Vfs(async_t* async);
 
+    // Opts in to vnode locking (see above). Must be set before any
+    // connection is served.
+    void SetVnodeLocking(bool value) { vnode_locking_ = value; }
+
     async_t* async() { return async_; }
     void set_async(async_t* async) { async_ = async; }
 
@@ -178,7 +190,35 @@ public:
 
 protected:
     // Whether this file system is read-only.
-    bool ReadonlyLocked() const __TA_REQUIRES(vfs_lock_) { return readonly_; }
+    bool Readonly() const { return readonly_.load(); }
+
+#ifdef __Fuchsia__
+    // Holds the namespace lock for the scope of a path operation. Those
+    // which may span directories pass |exclusive|; without vnode locking,
+    // every operation holds the lock exclusively.
+    class PathLock {
+    public:
+        PathLock(Vfs* vfs, bool exclusive);
+        ~PathLock();
+        DISALLOW_COPY_ASSIGN_AND_MOVE(PathLock);
+
+    private:
+        pthread_rwlock_t* const lock_;
+    };
+
+    // With vnode locking, holds the lock on the entries of directory |vn|
+    // for the scope, under a PathLock. Otherwise this does nothing, since
+    // the PathLock is exclusive.
+    class DirLock {
+    public:
+        DirLock(Vfs* vfs, const Vnode* vn);
+        ~DirLock();
+        DISALLOW_COPY_ASSIGN_AND_MOVE(DirLock);
+
+    private:
+        mtx_t* const lock_;
+    };
+#endif
 
 private:
     // Starting at vnode |vn|, walk the tree described by the path string,
@@ -188,14 +228,17 @@ private:
     // On success,
     // |out| is the vnode at which we stopped searching
     // |pathout| is the reaminer of the path to search
+    //
+    // Called under a PathLock.
     zx_status_t Walk(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out,
-                     fbl::StringPiece path, fbl::StringPiece* pathout) __TA_REQUIRES(vfs_lock_);
+                     fbl::StringPiece path, fbl::StringPiece* pathout);
 
+    // Called under a PathLock.
     zx_status_t OpenLocked(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out,
                            fbl::StringPiece path, fbl::StringPiece* pathout,
-                           uint32_t flags, uint32_t mode) __TA_REQUIRES(vfs_lock_);
+                           uint32_t flags, uint32_t mode);
 
-    bool readonly_{};
+    fbl::atomic<bool> readonly_{};
 
 #ifdef __Fuchsia__
     zx_status_t TokenToVnode(zx::event token, fbl::RefPtr<Vnode>* out) __TA_REQUIRES(vfs_lock_);
@@ -226,8 +269,20 @@ private:
 
     async_t* async_{};
 
+    bool vnode_locking_{};
+
+    // Acquired before vfs_lock_, then any DirLock.
+    pthread_rwlock_t namespace_lock_ = PTHREAD_RWLOCK_INITIALIZER;
+
+    // With vnode locking, directories hash to one of these locks. An
+    // operation never holds more than one of them unless it holds the
+    // namespace lock exclusively, so directories sharing a lock cannot
+    // deadlock.
+    static constexpr size_t kDirLockCount = 64;
+    mtx_t dir_locks_[kDirLockCount]{};
+
 protected:
-    // A lock which should be used to protect lookup and walk operations
+    // Guards the list of remote filesystems and the vnode tokens.
     mtx_t vfs_lock_{};
 
     // Starts tracking the lifetime of the connection.
@@ -140,12 +140,16 @@ public:
 
     // Acquire a vmo from a vnode.
     //
-    // At the moment, mmap can only map files from read-only filesystems,
-    // since (without paging) there is no mechanism to update either
-    // 1) The file by writing to the mapping, or
-    // 2) The mapping by writing to the underlying file.
+    // Filesystems which keep file contents in a vmo may hand out that vmo
+    // itself for shared mappings, so that the mapping and the file stay
+    // coherent; otherwise only read-only or private mappings make sense.
     virtual zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out);
 
+    // Writes back whatever has been changed through shared mappings of
+    // |len| bytes of vn at |offset|. Vnodes whose mappings need no writing
+    // back, or which hand out no writable mappings, do nothing.
+    virtual zx_status_t Msync(size_t offset, size_t len);
+
     // Syncs the vnode with its underlying storage.
     //
     // Returns the result status through a closure.
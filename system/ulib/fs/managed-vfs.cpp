@@ -14,12 +14,17 @@ ManagedVfs::ManagedVfs(async_t* async)
 ManagedVfs::~ManagedVfs() = default;
 
 void ManagedVfs::RegisterConnection(fbl::unique_ptr<Connection> connection) {
+    fbl::AutoLock lock(&connections_lock_);
     connections_.push_back(fbl::move(connection));
 }
 
 void ManagedVfs::UnregisterAndDestroyConnection(Connection* connection) {
-    // We drop the result of |erase| on the floor, effectively destroying the connection.
-    connections_.erase(*connection);
+    // Destroy the connection outside the lock.
+    fbl::unique_ptr<Connection> erased;
+    {
+        fbl::AutoLock lock(&connections_lock_);
+        erased = connections_.erase(*connection);
+    }
 }
 
 } // namespace fs
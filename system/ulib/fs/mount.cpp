@@ -56,6 +56,7 @@ zx_status_t Vfs::InstallRemote(fbl::RefPtr<Vnode> vn, MountChannel h) {
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
+    PathLock path_lock(this, true);
     zx_status_t status = vn->AttachRemote(fbl::move(h));
     if (status != ZX_OK) {
         return status;
@@ -91,6 +92,7 @@ zx_status_t Vfs::InstallRemoteLocked(fbl::RefPtr<Vnode> vn, MountChannel h) {
 
 zx_status_t Vfs::MountMkdir(fbl::RefPtr<Vnode> vn, fbl::StringPiece name, MountChannel h,
                             uint32_t flags) {
+    PathLock path_lock(this, true);
     fbl::AutoLock lock(&vfs_lock_);
     zx_status_t r = OpenLocked(vn, &vn, name, &name, ZX_FS_FLAG_CREATE |
                                ZX_FS_RIGHT_READABLE | ZX_FS_FLAG_DIRECTORY |
@@ -114,19 +116,27 @@ zx_status_t Vfs::MountMkdir(fbl::RefPtr<Vnode> vn, fbl::StringPiece name, MountC
 }
 
 zx_status_t Vfs::UninstallRemote(fbl::RefPtr<Vnode> vn, zx::channel* h) {
+    PathLock path_lock(this, true);
     fbl::AutoLock lock(&vfs_lock_);
     return UninstallRemoteLocked(fbl::move(vn), h);
 }
 
 zx_status_t Vfs::ForwardMessageRemote(fbl::RefPtr<Vnode> vn, zx::channel channel,
                                       zxrio_msg_t* msg) {
-    fbl::AutoLock lock(&vfs_lock_);
-    zx_handle_t h = vn->GetRemote();
-    if (h == ZX_HANDLE_INVALID) {
-        return ZX_ERR_NOT_FOUND;
+    zx_status_t r;
+    {
+        PathLock path_lock(this, false);
+        zx_handle_t h = vn->GetRemote();
+        if (h == ZX_HANDLE_INVALID) {
+            return ZX_ERR_NOT_FOUND;
+        }
+        r = zxrio_txn_handoff(h, channel.release(), msg);
     }
-    zx_status_t r = zxrio_txn_handoff(h, channel.release(), msg);
     if (r == ZX_ERR_PEER_CLOSED) {
+        // Another thread may have unmounted it in the meantime, in which
+        // case this does nothing.
+        PathLock path_lock(this, true);
+        fbl::AutoLock lock(&vfs_lock_);
         zx::channel c;
         UninstallRemoteLocked(fbl::move(vn), &c);
     }
@@ -152,17 +162,18 @@ zx_status_t Vfs::UninstallRemoteLocked(fbl::RefPtr<Vnode> vn, zx::channel* h) {
 // Uninstall all remote filesystems. Acts like 'UninstallRemote' for all
 // known remotes.
 zx_status_t Vfs::UninstallAll(zx_time_t deadline) {
-    fbl::unique_ptr<MountNode> mount_point;
     for (;;) {
+        zx::channel remote;
         {
+            PathLock path_lock(this, true);
             fbl::AutoLock lock(&vfs_lock_);
-            mount_point = remote_list_.pop_front();
-        }
-        if (mount_point) {
-            vfs_unmount_handle(mount_point->ReleaseRemote().release(), deadline);
-        } else {
-            return ZX_OK;
+            fbl::unique_ptr<MountNode> mount_point = remote_list_.pop_front();
+            if (!mount_point) {
+                return ZX_OK;
+            }
+            remote = mount_point->ReleaseRemote();
         }
+        vfs_unmount_handle(remote.release(), deadline);
     }
 }
 
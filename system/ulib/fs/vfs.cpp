@@ -114,13 +114,42 @@ Vfs::~Vfs() = default;
 #ifdef __Fuchsia__
 Vfs::Vfs(async_t* async)
     : async_(async) {}
+
+Vfs::PathLock::PathLock(Vfs* vfs, bool exclusive)
+    : lock_(&vfs->namespace_lock_) {
+    if (exclusive || !vfs->vnode_locking_) {
+        pthread_rwlock_wrlock(lock_);
+    } else {
+        pthread_rwlock_rdlock(lock_);
+    }
+}
+
+Vfs::PathLock::~PathLock() {
+    pthread_rwlock_unlock(lock_);
+}
+
+Vfs::DirLock::DirLock(Vfs* vfs, const Vnode* vn)
+    : lock_(vfs->vnode_locking_ ?
+            &vfs->dir_locks_[(reinterpret_cast<uintptr_t>(vn) / alignof(Vnode)) %
+                             kDirLockCount] :
+            nullptr) {
+    if (lock_ != nullptr) {
+        mtx_lock(lock_);
+    }
+}
+
+Vfs::DirLock::~DirLock() {
+    if (lock_ != nullptr) {
+        mtx_unlock(lock_);
+    }
+}
 #endif
 
 zx_status_t Vfs::Open(fbl::RefPtr<Vnode> vndir, fbl::RefPtr<Vnode>* out,
                       fbl::StringPiece path, fbl::StringPiece* pathout, uint32_t flags,
                       uint32_t mode) {
 #ifdef __Fuchsia__
-    fbl::AutoLock lock(&vfs_lock_);
+    PathLock lock(this, false);
 #endif
     return OpenLocked(fbl::move(vndir), out, path, pathout, flags, mode);
 }
@@ -154,32 +183,36 @@ zx_status_t Vfs::OpenLocked(fbl::RefPtr<Vnode> vndir, fbl::RefPtr<Vnode>* out,
         return ZX_ERR_INVALID_ARGS;
     }
 
-    if (flags & ZX_FS_FLAG_CREATE) {
-        if (must_be_dir && !S_ISDIR(mode)) {
-            return ZX_ERR_INVALID_ARGS;
-        } else if (path == ".") {
-            return ZX_ERR_INVALID_ARGS;
-        } else if (ReadonlyLocked()) {
-            return ZX_ERR_ACCESS_DENIED;
-        }
-        if ((r = vndir->Create(&vn, path, mode)) < 0) {
-            if ((r == ZX_ERR_ALREADY_EXISTS) && (!(flags & ZX_FS_FLAG_EXCLUSIVE))) {
-                goto try_open;
+    bool created = false;
+    {
+#ifdef __Fuchsia__
+        DirLock dir_lock(this, vndir.get());
+#endif
+        if (flags & ZX_FS_FLAG_CREATE) {
+            if (must_be_dir && !S_ISDIR(mode)) {
+                return ZX_ERR_INVALID_ARGS;
+            } else if (path == ".") {
+                return ZX_ERR_INVALID_ARGS;
+            } else if (Readonly()) {
+                return ZX_ERR_ACCESS_DENIED;
             }
-            if (r == ZX_ERR_NOT_SUPPORTED) {
-                // filesystem may not support create (like devfs)
-                // in which case we should still try to open() the file
-                goto try_open;
+            if ((r = vndir->Create(&vn, path, mode)) >= 0) {
+                created = true;
+                vndir->Notify(path, VFS_WATCH_EVT_ADDED);
+            } else if ((r != ZX_ERR_ALREADY_EXISTS || (flags & ZX_FS_FLAG_EXCLUSIVE)) &&
+                       r != ZX_ERR_NOT_SUPPORTED) {
+                // Otherwise, open the existing file. The filesystem may also
+                // not support create (like devfs), in which case we should
+                // still try to open() the file.
+                return r;
             }
-            return r;
         }
-        vndir->Notify(path, VFS_WATCH_EVT_ADDED);
-    } else {
-    try_open:
-        r = vfs_lookup(fbl::move(vndir), &vn, path);
-        if (r < 0) {
+        if (!created && (r = vfs_lookup(vndir, &vn, path)) < 0) {
             return r;
         }
+    }
+
+    if (!created) {
 #ifdef __Fuchsia__
         if (!(flags & ZX_FS_FLAG_NOREMOTE) && vn->IsRemote()) {
             // Opening a mount point: Traverse across remote.
@@ -190,7 +223,7 @@ zx_status_t Vfs::OpenLocked(fbl::RefPtr<Vnode> vndir, fbl::RefPtr<Vnode>* out,
 
         flags |= (must_be_dir ? ZX_FS_FLAG_DIRECTORY : 0);
 #endif
-        if (ReadonlyLocked() && IsWritable(flags)) {
+        if (Readonly() && IsWritable(flags)) {
             return ZX_ERR_ACCESS_DENIED;
         }
         if ((r = vn->ValidateFlags(flags)) != ZX_OK) {
@@ -227,9 +260,10 @@ zx_status_t Vfs::Unlink(fbl::RefPtr<Vnode> vndir, fbl::StringPiece path) {
 
     {
 #ifdef __Fuchsia__
-        fbl::AutoLock lock(&vfs_lock_);
+        PathLock lock(this, false);
+        DirLock dir_lock(this, vndir.get());
 #endif
-        if (ReadonlyLocked()) {
+        if (Readonly()) {
             r = ZX_ERR_ACCESS_DENIED;
         } else {
             r = vndir->Unlink(path, must_be_dir);
@@ -327,16 +361,22 @@ zx_status_t Vfs::Rename(zx::event token, fbl::RefPtr<Vnode> oldparent,
         return ZX_ERR_INVALID_ARGS;
     }
 
+    if (Readonly()) {
+        return ZX_ERR_ACCESS_DENIED;
+    }
     fbl::RefPtr<fs::Vnode> newparent;
     {
         fbl::AutoLock lock(&vfs_lock_);
-        if (ReadonlyLocked()) {
-            return ZX_ERR_ACCESS_DENIED;
-        }
         if ((r = TokenToVnode(fbl::move(token), &newparent)) != ZX_OK) {
             return r;
         }
-
+    }
+    {
+        // Moving an entry between directories must exclude every other path
+        // operation, lest a concurrent rename make a directory its own
+        // ancestor.
+        PathLock lock(this, newparent != oldparent);
+        DirLock dir_lock(this, oldparent.get());
         r = oldparent->Rename(newparent, oldStr, newStr, old_must_be_dir,
                               new_must_be_dir);
     }
@@ -350,22 +390,27 @@ zx_status_t Vfs::Rename(zx::event token, fbl::RefPtr<Vnode> oldparent,
 
 zx_status_t Vfs::Readdir(Vnode* vn, vdircookie_t* cookie,
                          void* dirents, size_t len, size_t* out_actual) {
-    fbl::AutoLock lock(&vfs_lock_);
+    PathLock lock(this, false);
+    DirLock dir_lock(this, vn);
     return vn->Readdir(cookie, dirents, len, out_actual);
 }
 
 zx_status_t Vfs::Link(zx::event token, fbl::RefPtr<Vnode> oldparent,
                       fbl::StringPiece oldStr, fbl::StringPiece newStr) {
-    fbl::AutoLock lock(&vfs_lock_);
     fbl::RefPtr<fs::Vnode> newparent;
     zx_status_t r;
-    if ((r = TokenToVnode(fbl::move(token), &newparent)) != ZX_OK) {
-        return r;
+    {
+        fbl::AutoLock lock(&vfs_lock_);
+        if ((r = TokenToVnode(fbl::move(token), &newparent)) != ZX_OK) {
+            return r;
+        }
     }
+    PathLock lock(this, newparent != oldparent);
+    DirLock dir_lock(this, newparent.get());
     // Local filesystem
     bool old_must_be_dir;
     bool new_must_be_dir;
-    if (ReadonlyLocked()) {
+    if (Readonly()) {
         return ZX_ERR_ACCESS_DENIED;
     } else if ((r = vfs_name_trim(oldStr, &oldStr, &old_must_be_dir)) != ZX_OK) {
         return r;
@@ -401,9 +446,13 @@ zx_status_t Vfs::Link(zx::event token, fbl::RefPtr<Vnode> oldparent,
 zx_status_t Vfs::ServeConnection(fbl::unique_ptr<Connection> connection) {
     ZX_DEBUG_ASSERT(connection);
 
-    zx_status_t status = connection->Serve();
-    if (status == ZX_OK) {
-        RegisterConnection(fbl::move(connection));
+    // Register the connection before serving it; once its wait has begun,
+    // another dispatch thread may close and destroy it at any time.
+    Connection* ptr = connection.get();
+    RegisterConnection(fbl::move(connection));
+    zx_status_t status = ptr->Serve();
+    if (status != ZX_OK) {
+        UnregisterAndDestroyConnection(ptr);
     }
     return status;
 }
@@ -502,10 +551,7 @@ zx_status_t Vfs::Ioctl(fbl::RefPtr<Vnode> vn, uint32_t op, const void* in_buf, s
 }
 
 void Vfs::SetReadonly(bool value) {
-#ifdef __Fuchsia__
-    fbl::AutoLock lock(&vfs_lock_);
-#endif
-    readonly_ = value;
+    readonly_.store(value);
 }
 
 zx_status_t Vfs::Walk(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out,
@@ -552,7 +598,13 @@ zx_status_t Vfs::Walk(fbl::RefPtr<Vnode> vn, fbl::RefPtr<Vnode>* out,
             // traverse to the next segment
             size_t len = nextpath - path;
             nextpath++;
-            if ((r = vfs_lookup(fbl::move(vn), &vn, fbl::StringPiece(path, len))) < 0) {
+            {
+#ifdef __Fuchsia__
+                DirLock dir_lock(this, vn.get());
+#endif
+                r = vfs_lookup(vn, &vn, fbl::StringPiece(path, len));
+            }
+            if (r < 0) {
                 return r;
             }
             path = nextpath;
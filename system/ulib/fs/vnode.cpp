@@ -104,6 +104,10 @@ zx_status_t Vnode::Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) {
     return ZX_ERR_NOT_SUPPORTED;
 }
 
+zx_status_t Vnode::Msync(size_t offset, size_t len) {
+    return ZX_OK;
+}
+
 void Vnode::Sync(SyncCallback closure) {
     closure(ZX_ERR_NOT_SUPPORTED);
 }
@@ -21,7 +21,9 @@ zx_status_t SparseReader::Create(fbl::unique_fd fd, fbl::unique_ptr<SparseReader
     return ZX_OK;
 }
 
-SparseReader::SparseReader(fbl::unique_fd fd) : compressed_(false), fd_(fbl::move(fd)) {}
+SparseReader::SparseReader(fbl::unique_fd fd)
+    : compressed_(false), framed_(false), fd_(fbl::move(fd)), frame_table_(nullptr),
+      frame_count_(0), next_frame_(0) {}
 
 zx_status_t SparseReader::ReadMetadata() {
     // Read sparse image
@@ -29,6 +31,9 @@ zx_status_t SparseReader::ReadMetadata() {
     if (read(fd_.get(), &image, sizeof(fvm::sparse_image_t)) != sizeof(fvm::sparse_image_t)) {
         fprintf(stderr, "failed to read the sparse header\n");
         return ZX_ERR_IO;
+    } else if (image.header_length < sizeof(fvm::sparse_image_t)) {
+        fprintf(stderr, "SparseReader: header too short\n");
+        return ZX_ERR_IO;
     }
 
     fbl::AllocChecker ac;
@@ -50,6 +55,23 @@ zx_status_t SparseReader::ReadMetadata() {
         off += r;
     }
 
+    // Framed images are read a frame at a time, each decompressing on its own
+    if ((image.flags & fvm::kSparseFlagLz4) && (image.flags & fvm::kSparseFlagLz4Frames)) {
+        printf("Found compressed file with independent frames\n");
+        compressed_ = true;
+        framed_ = true;
+        zx_status_t status;
+        if ((status = InitializeBuffer(kSparseFrameLength, &out_buf_)) != ZX_OK) {
+            return status;
+        } else if ((status = InitializeBuffer(MaxCompressedFrameLength(), &in_buf_)) != ZX_OK) {
+            return status;
+        } else if ((image.flags & fvm::kSparseFlagFrameTable) &&
+                   (status = ReadFrameTable()) != ZX_OK) {
+            return status;
+        }
+        return ZX_OK;
+    }
+
     // If image is compressed, additional setup is required
     if (image.flags & fvm::kSparseFlagLz4) {
         printf("Found compressed file\n");
@@ -103,6 +125,59 @@ zx_status_t SparseReader::ReadMetadata() {
     return ZX_OK;
 }
 
+zx_status_t SparseReader::ReadFrameTable() {
+    const fvm::sparse_image_t* image = Image();
+    size_t off = sizeof(fvm::sparse_image_t);
+    for (size_t p = 0; p < image->partition_count; p++) {
+        if (image->header_length - off < sizeof(fvm::partition_descriptor_t)) {
+            fprintf(stderr, "SparseReader: partitions overrun the header\n");
+            return ZX_ERR_IO;
+        }
+        auto pd = reinterpret_cast<const fvm::partition_descriptor_t*>(&metadata_[off]);
+        off += sizeof(fvm::partition_descriptor_t);
+        if ((image->header_length - off) / sizeof(fvm::extent_descriptor_t) < pd->extent_count) {
+            fprintf(stderr, "SparseReader: extents overrun the header\n");
+            return ZX_ERR_IO;
+        }
+        off += pd->extent_count * sizeof(fvm::extent_descriptor_t);
+    }
+
+    // The table ends the header, so that it may be dropped by cutting the header short
+    if (image->header_length - off < sizeof(fvm::frame_table_t)) {
+        fprintf(stderr, "SparseReader: missing frame table\n");
+        return ZX_ERR_IO;
+    }
+    auto table = reinterpret_cast<const fvm::frame_table_t*>(&metadata_[off]);
+    off += sizeof(fvm::frame_table_t);
+    if (table->magic != kFrameTableMagic ||
+        (image->header_length - off) / sizeof(fvm::frame_entry_t) != table->frame_count ||
+        (image->header_length - off) % sizeof(fvm::frame_entry_t) != 0) {
+        fprintf(stderr, "SparseReader: bad frame table\n");
+        return ZX_ERR_IO;
+    }
+
+    // Frames follow one another with no gaps
+    auto entries = reinterpret_cast<const fvm::frame_entry_t*>(&metadata_[off]);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < table->frame_count; i++) {
+        if (entries[i].offset != offset || entries[i].length > kSparseFrameLength ||
+            entries[i].compressed_length > MaxCompressedFrameLength()) {
+            fprintf(stderr, "SparseReader: bad frame table entry %zu\n", i);
+            return ZX_ERR_IO;
+        }
+        offset += sizeof(fvm::frame_descriptor_t) + entries[i].compressed_length;
+    }
+
+    frame_table_ = entries;
+    frame_count_ = table->frame_count;
+    return ZX_OK;
+}
+
+bool SparseReader::MatchesFrameTable(size_t index, const fvm::frame_descriptor_t& desc) const {
+    return index < frame_count_ && desc.length == frame_table_[index].length &&
+           desc.compressed_length == frame_table_[index].compressed_length;
+}
+
 zx_status_t SparseReader::InitializeBuffer(size_t size, buffer_t* out_buf) {
     if (size < LZ4_MAX_BLOCK_SIZE) {
         fprintf(stderr, "Buffer size must be >= %d\n", LZ4_MAX_BLOCK_SIZE);
@@ -125,7 +200,7 @@ zx_status_t SparseReader::InitializeBuffer(size_t size, buffer_t* out_buf) {
 SparseReader::~SparseReader() {
     PrintStats();
 
-    if (compressed_) {
+    if (compressed_ && !framed_) {
         LZ4F_freeDecompressionContext(dctx_);
     }
 }
@@ -145,7 +220,29 @@ zx_status_t SparseReader::ReadData(uint8_t* data, size_t length, size_t* actual)
     zx_time_t start = zx_ticks_get();
 #endif
     size_t total_size = 0;
-    if (compressed_) {
+    if (framed_) {
+        // Read previously decompressed data from buffer if possible
+        out_buf_.read(data, length, &total_size);
+
+        while (total_size < length) {
+            frame_descriptor_t desc;
+            zx_status_t status = ReadFrame(&desc, in_buf_.data.get());
+            if (status == ZX_ERR_OUT_OF_RANGE && total_size > 0) {
+                break;
+            } else if (status != ZX_OK) {
+                return status;
+            }
+            if ((status = DecompressFrame(desc, in_buf_.data.get(),
+                                          out_buf_.data.get())) != ZX_OK) {
+                return status;
+            }
+            out_buf_.size = desc.length;
+
+            size_t cp;
+            out_buf_.read(data + total_size, length - total_size, &cp);
+            total_size += cp;
+        }
+    } else if (compressed_) {
         if (to_read_ == 0) {
             // There is no more to read
             return ZX_ERR_OUT_OF_RANGE;
@@ -215,6 +312,150 @@ zx_status_t SparseReader::ReadData(uint8_t* data, size_t length, size_t* actual)
     return ZX_OK;
 }
 
+size_t SparseReader::MaxCompressedFrameLength() {
+    return LZ4F_compressFrameBound(kSparseFrameLength, nullptr);
+}
+
+zx_status_t SparseReader::ReadFrame(frame_descriptor_t* desc, uint8_t* data) {
+    ZX_ASSERT(framed_);
+    zx_status_t status;
+    size_t actual;
+    if ((status = ReadRaw(reinterpret_cast<uint8_t*>(desc), sizeof(*desc), &actual)) != ZX_OK) {
+        return status;
+    } else if (actual == 0) {
+        if (HasFrameTable() && next_frame_ != frame_count_) {
+            fprintf(stderr, "SparseReader: image ends after %zu of %zu frames\n", next_frame_,
+                    frame_count_);
+            return ZX_ERR_IO;
+        }
+        return ZX_ERR_OUT_OF_RANGE;
+    } else if (actual != sizeof(*desc) || desc->magic != kFrameDescriptorMagic) {
+        fprintf(stderr, "SparseReader: bad frame descriptor\n");
+        return ZX_ERR_IO;
+    } else if (desc->length > kSparseFrameLength ||
+               desc->compressed_length > MaxCompressedFrameLength()) {
+        fprintf(stderr, "SparseReader: frame too large\n");
+        return ZX_ERR_IO;
+    } else if (HasFrameTable() && !MatchesFrameTable(next_frame_, *desc)) {
+        fprintf(stderr, "SparseReader: frame %zu does not match the frame table\n", next_frame_);
+        return ZX_ERR_IO;
+    }
+
+    if ((status = ReadRaw(data, desc->compressed_length, &actual)) != ZX_OK) {
+        return status;
+    } else if (actual != desc->compressed_length) {
+        fprintf(stderr, "SparseReader: truncated frame\n");
+        return ZX_ERR_IO;
+    }
+    next_frame_++;
+    return ZX_OK;
+}
+
+zx_status_t SparseReader::SkipFrames(size_t count) {
+    ZX_ASSERT(framed_);
+    if (!HasFrameTable()) {
+        return ZX_ERR_NOT_SUPPORTED;
+    } else if (count > frame_count_ - next_frame_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    } else if (count == 0) {
+        return ZX_OK;
+    }
+
+    const fvm::frame_entry_t& last = frame_table_[next_frame_ + count - 1];
+    size_t skip = last.offset + sizeof(fvm::frame_descriptor_t) + last.compressed_length -
+                  frame_table_[next_frame_].offset;
+    if (lseek(fd_.get(), skip, SEEK_CUR) < 0) {
+        while (skip > 0) {
+            zx_status_t status;
+            size_t actual;
+            if ((status = ReadRaw(in_buf_.data.get(), fbl::min(skip, in_buf_.max_size),
+                                  &actual)) != ZX_OK) {
+                return status;
+            } else if (actual == 0) {
+                fprintf(stderr, "SparseReader: image ends before the frames skipped\n");
+                return ZX_ERR_IO;
+            }
+            skip -= actual;
+        }
+    }
+    next_frame_ += count;
+    return ZX_OK;
+}
+
+zx_status_t SparseReader::ReadFrameAt(size_t index, frame_descriptor_t* desc,
+                                      uint8_t* data) const {
+    ZX_ASSERT(framed_);
+    if (!HasFrameTable()) {
+        return ZX_ERR_NOT_SUPPORTED;
+    } else if (index >= frame_count_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    auto image = reinterpret_cast<const fvm::sparse_image_t*>(metadata_.get());
+    off_t off = image->header_length + frame_table_[index].offset;
+    ssize_t r = pread(fd_.get(), desc, sizeof(*desc), off);
+    if (r < 0) {
+        return errno == ESPIPE ? ZX_ERR_NOT_SUPPORTED : ZX_ERR_IO;
+    } else if (r != sizeof(*desc) || desc->magic != kFrameDescriptorMagic ||
+               !MatchesFrameTable(index, *desc)) {
+        fprintf(stderr, "SparseReader: frame %zu does not match the frame table\n", index);
+        return ZX_ERR_IO;
+    }
+
+    off += sizeof(*desc);
+    size_t total = 0;
+    while (total < desc->compressed_length) {
+        if ((r = pread(fd_.get(), data + total, desc->compressed_length - total,
+                       off + total)) <= 0) {
+            fprintf(stderr, "SparseReader: truncated frame\n");
+            return ZX_ERR_IO;
+        }
+        total += r;
+    }
+    return ZX_OK;
+}
+
+zx_status_t SparseReader::DecompressFrame(const frame_descriptor_t& desc, const uint8_t* data,
+                                          uint8_t* out) {
+    if (desc.compressed_length == 0) {
+        memset(out, 0, desc.length);
+        return ZX_OK;
+    }
+
+    LZ4F_decompressionContext_t dctx;
+    LZ4F_errorCode_t errc = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    if (LZ4F_isError(errc)) {
+        fprintf(stderr, "SparseReader: could not initialize decompression: %s\n",
+                LZ4F_getErrorName(errc));
+        return ZX_ERR_INTERNAL;
+    }
+    auto cleanup = fbl::MakeAutoCall([dctx]() { LZ4F_freeDecompressionContext(dctx); });
+
+    size_t in_off = 0;
+    size_t out_off = 0;
+    size_t next = 1;
+    while (next != 0 && in_off < desc.compressed_length) {
+        size_t src_sz = desc.compressed_length - in_off;
+        size_t dst_sz = desc.length - out_off;
+        next = LZ4F_decompress(dctx, out + out_off, &dst_sz, data + in_off, &src_sz, NULL);
+        if (LZ4F_isError(next)) {
+            fprintf(stderr, "SparseReader: could not decompress frame: %s\n",
+                    LZ4F_getErrorName(next));
+            return ZX_ERR_IO;
+        } else if (src_sz == 0 && dst_sz == 0) {
+            break;
+        }
+        in_off += src_sz;
+        out_off += dst_sz;
+    }
+
+    if (next != 0 || out_off != desc.length) {
+        fprintf(stderr, "SparseReader: frame does not match its descriptor\n");
+        return ZX_ERR_IO;
+    }
+    return ZX_OK;
+}
+
 zx_status_t SparseReader::ReadRaw(uint8_t* data, size_t length, size_t* actual) {
 #ifdef __Fuchsia__
     zx_time_t start = zx_ticks_get();
@@ -250,7 +491,13 @@ zx_status_t SparseReader::WriteDecompressed(fbl::unique_fd outfd) {
 
     // Update metadata and write to new file.
     fvm::sparse_image_t* image = Image();
-    image->flags &= ~fvm::kSparseFlagLz4;
+    image->flags &= ~(fvm::kSparseFlagLz4 | fvm::kSparseFlagLz4Frames |
+                      fvm::kSparseFlagFrameTable);
+    // The frame table means nothing once decompressed, and ends the header
+    if (HasFrameTable()) {
+        image->header_length = reinterpret_cast<const uint8_t*>(frame_table_) -
+                               metadata_.get() - sizeof(fvm::frame_table_t);
+    }
 
     if (write(outfd.get(), metadata_.get(), image->header_length)
         != static_cast<ssize_t>(image->header_length)) {
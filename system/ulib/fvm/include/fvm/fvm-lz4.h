@@ -37,6 +37,34 @@ public:
 
     // Read requested data from sparse file into buffer
     zx_status_t ReadData(uint8_t* data, size_t length, size_t *actual);
+
+    // True if the data is compressed as independent frames (kSparseFlagLz4Frames), which
+    // may be read with ReadFrame() in place of ReadData().
+    bool IsFramed() const { return framed_; }
+    // Read the descriptor of the next frame into |desc|, and its compressed data into |data|,
+    // which must hold at least MaxCompressedFrameLength() bytes. Returns ZX_ERR_OUT_OF_RANGE
+    // once there are no frames left.
+    zx_status_t ReadFrame(fvm::frame_descriptor_t* desc, uint8_t* data);
+    static size_t MaxCompressedFrameLength();
+    // Decompress a frame read by ReadFrame() into |out|, which must hold |desc.length| bytes.
+    // Does not touch the reader, so may run on any number of threads at once.
+    static zx_status_t DecompressFrame(const fvm::frame_descriptor_t& desc, const uint8_t* data,
+                                       uint8_t* out);
+
+    // True if the header holds a table of every frame (kSparseFlagFrameTable). Frames read by
+    // ReadFrame() are then checked against it, and the following may be used.
+    bool HasFrameTable() const { return frame_table_ != nullptr; }
+    size_t FrameCount() const { return frame_count_; }
+    const fvm::frame_entry_t* FrameTable() const { return frame_table_; }
+    // The index of the frame ReadFrame() reads next.
+    size_t NextFrame() const { return next_frame_; }
+    // Move ReadFrame() on past the next |count| frames without reading them, as when picking up
+    // an interrupted stream. Streams which cannot seek are read through.
+    zx_status_t SkipFrames(size_t count);
+    // Read frame |index| as ReadFrame() would, without moving on the stream. Only for files which
+    // can seek, returning ZX_ERR_NOT_SUPPORTED otherwise; may run on any number of threads at once.
+    zx_status_t ReadFrameAt(size_t index, fvm::frame_descriptor_t* desc, uint8_t* data) const;
+
     // Write decompressed data into new file
     zx_status_t WriteDecompressed(fbl::unique_fd outfd);
 private:
@@ -88,6 +116,10 @@ private:
     SparseReader(fbl::unique_fd fd);
     // Read in header data, prepare buffers and decompression context if necessary
     zx_status_t ReadMetadata();
+    // Find and check the frame table at the end of the header
+    zx_status_t ReadFrameTable();
+    // Check that |desc| is that of frame |index| in the frame table
+    bool MatchesFrameTable(size_t index, const fvm::frame_descriptor_t& desc) const;
     // Initialize buffer with a given |size|
     static zx_status_t InitializeBuffer(size_t size, buffer_t* out_buf);
     // Read |length| bytes of raw data from file directly into |data|. Return |actual| bytes read.
@@ -97,9 +129,15 @@ private:
 
     // True if sparse file is compressed
     bool compressed_;
+    // True if it is compressed as a series of independent frames
+    bool framed_;
 
     fbl::unique_fd fd_;
     fbl::unique_ptr<uint8_t[]> metadata_;
+    // The frame table, within |metadata_|, if the image has one
+    const fvm::frame_entry_t* frame_table_;
+    size_t frame_count_;
+    size_t next_frame_;
     LZ4F_decompressionContext_t dctx_;
     // A hint of the size of the next compressed frame to be decompressed.
     // May be an overestimate, but will not be an underestimate (0 indicates no more data left to
@@ -41,11 +41,31 @@ namespace fvm {
 //   P0, Extent 2
 //   P1, Extent 0
 //   P2, Extent 0
+//
+// With kSparseFlagLz4 alone, DATA is compressed as a single LZ4 frame. With
+// kSparseFlagLz4Frames as well, it is instead cut into pieces of at most
+// kSparseFrameLength bytes, none spanning two extents, each stored as a
+// frame_descriptor_t followed by |compressed_length| bytes holding an LZ4 frame
+// of its own. The descriptors index the stream, so that a reader can hand out
+// frames to be decompressed in parallel. Pieces which are entirely zero are
+// stored as a descriptor alone, with a |compressed_length| of zero.
+//
+// With kSparseFlagFrameTable as well, the header ends in a frame_table_t,
+// after the last extent descriptor, followed by |frame_count| entries of
+// frame_entry_t: one per frame, in order, giving where in DATA its descriptor
+// starts. Readers which do not know of the table skip it along with the rest
+// of the header. Those which do may seek straight to any frame, to read
+// frames out of order or to pick up an interrupted stream part way through.
 
 constexpr uint64_t kSparseFormatMagic = (0x53525053204d5646ull); // 'FVM SPRS'
 constexpr uint64_t kSparseFormatVersion = 0x2;
 
 constexpr uint32_t kSparseFlagLz4 = 0x1;
+constexpr uint32_t kSparseFlagLz4Frames = 0x2;
+constexpr uint32_t kSparseFlagFrameTable = 0x4;
+
+// The most data decompressing from a single frame.
+constexpr size_t kSparseFrameLength = (512 * 1024);
 
 typedef struct sparse_image {
     uint64_t magic;
@@ -75,4 +95,25 @@ typedef struct extent_descriptor {
     uint64_t extent_length; // Unit: bytes. Must be <= slice_count * slice_size.
 } __attribute__((packed)) extent_descriptor_t;
 
+constexpr uint64_t kFrameDescriptorMagic = (0x4c3ba5a6e1f2d7c9ull);
+
+typedef struct frame_descriptor {
+    uint64_t magic;
+    uint32_t length; // Unit: bytes, once decompressed. At most kSparseFrameLength.
+    uint32_t compressed_length; // Unit: bytes. Zero if the frame is all zeroes.
+} __attribute__((packed)) frame_descriptor_t;
+
+constexpr uint64_t kFrameTableMagic = (0x7e2b1d0c9f8a6453ull);
+
+typedef struct frame_table {
+    uint64_t magic;
+    uint64_t frame_count;
+} __attribute__((packed)) frame_table_t;
+
+typedef struct frame_entry {
+    uint64_t offset; // Unit: bytes, from the start of DATA to the frame's descriptor.
+    uint32_t length; // Matches the frame's descriptor.
+    uint32_t compressed_length; // Matches the frame's descriptor.
+} __attribute__((packed)) frame_entry_t;
+
 } // namespace fvm
@@ -214,155 +214,67 @@ void gfx_putchar(gfx_surface* surface, const gfx_font* font, unsigned ch, unsign
     surface->putchar(surface, font, ch, x, y, fg, bg);
 }
 
-static void copyrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint8_t* src = &((const uint8_t*)surface->ptr)[x + y * surface->stride];
-    uint8_t* dest = &((uint8_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+// Copies rows with memmove(), which is much faster than copying pixel by
+// pixel, and handles a source and destination on the same row. Rows are
+// copied top down or bottom up so that an overlapping source isn't
+// overwritten before it is read.
+static void copyrect(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
+    size_t pitch = surface->stride * surface->pixelsize;
+    size_t len = width * surface->pixelsize;
+    const uint8_t* src = (const uint8_t*)surface->ptr + y * pitch + x * surface->pixelsize;
+    uint8_t* dest = (uint8_t*)surface->ptr + y2 * pitch + x2 * surface->pixelsize;
+
+    if (y2 <= y) {
+        for (unsigned i = 0; i < height; i++) {
+            memmove(dest, src, len);
+            dest += pitch;
+            src += pitch;
         }
     } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+        src += (height - 1) * pitch;
+        dest += (height - 1) * pitch;
+        for (unsigned i = 0; i < height; i++) {
+            memmove(dest, src, len);
+            dest -= pitch;
+            src -= pitch;
         }
     }
 }
 
-static void fillrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
-    uint8_t* dest = &((uint8_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    uint8_t color8 = (uint8_t)(surface->translate_color(color));
-
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color8;
-            dest++;
-        }
-        dest += stride_diff;
+// Fills the first row and copies it to the rest.
+static void fillrows(gfx_surface* surface, uint8_t* dest, unsigned width, unsigned height) {
+    size_t pitch = surface->stride * surface->pixelsize;
+    size_t len = width * surface->pixelsize;
+    for (unsigned i = 1; i < height; i++) {
+        memcpy(dest + i * pitch, dest, len);
     }
 }
 
-static void copyrect16(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint16_t* src = &((const uint16_t*)surface->ptr)[x + y * surface->stride];
-    uint16_t* dest = &((uint16_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
-        }
-    } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
+static void fillrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
+    uint8_t* dest = &((uint8_t*)surface->ptr)[x + y * surface->stride];
+    uint8_t color8 = (uint8_t)(surface->translate_color(color));
 
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
-        }
-    }
+    memset(dest, color8, width);
+    fillrows(surface, dest, width, height);
 }
 
 static void fillrect16(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
     uint16_t* dest = &((uint16_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
     uint16_t color16 = (uint16_t)(surface->translate_color(color));
 
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color16;
-            dest++;
-        }
-        dest += stride_diff;
-    }
-}
-
-static void copyrect32(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint32_t* src = &((const uint32_t*)surface->ptr)[x + y * surface->stride];
-    uint32_t* dest = &((uint32_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
-        }
-    } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
-        }
+    for (unsigned j = 0; j < width; j++) {
+        dest[j] = color16;
     }
+    fillrows(surface, (uint8_t*)dest, width, height);
 }
 
 static void fillrect32(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
     uint32_t* dest = &((uint32_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color;
-            dest++;
-        }
-        dest += stride_diff;
+    for (unsigned j = 0; j < width; j++) {
+        dest[j] = color;
     }
+    fillrows(surface, (uint8_t*)dest, width, height);
 }
 
 void gfx_line(gfx_surface* surface, unsigned x1, unsigned y1, unsigned x2, unsigned y2, unsigned color) {
@@ -490,24 +402,20 @@ void gfx_blend(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned
         height = source->height - srcy;
 
     // XXX total hack to deal with various blends
-    if (source->format == ZX_PIXEL_FORMAT_RGB_565 && target->format == ZX_PIXEL_FORMAT_RGB_565) {
-        // 16 bit to 16 bit
-        const uint16_t* src = &((const uint16_t*)source->ptr)[srcx + srcy * source->stride];
-        uint16_t* dest = &((uint16_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+    if ((source->format == ZX_PIXEL_FORMAT_RGB_565 && target->format == ZX_PIXEL_FORMAT_RGB_565) ||
+        (source->format == ZX_PIXEL_FORMAT_RGB_x888 && target->format == ZX_PIXEL_FORMAT_RGB_x888) ||
+        (source->format == ZX_PIXEL_FORMAT_MONO_8 && target->format == ZX_PIXEL_FORMAT_MONO_8)) {
+        // same format, no alpha: copy each row
+        unsigned pixelsize = source->pixelsize;
+        const uint8_t* src = (const uint8_t*)source->ptr + (srcx + srcy * source->stride) * pixelsize;
+        uint8_t* dest = (uint8_t*)target->ptr + (destx + desty * target->stride) * pixelsize;
+
+        xprintf("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
+
+        for (unsigned i = 0; i < height; i++) {
+            memcpy(dest, src, width * pixelsize);
+            dest += target->stride * pixelsize;
+            src += source->stride * pixelsize;
         }
     } else if (source->format == ZX_PIXEL_FORMAT_ARGB_8888 && target->format == ZX_PIXEL_FORMAT_ARGB_8888) {
         // both are 32 bit modes, both alpha
@@ -529,44 +437,6 @@ void gfx_blend(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned
             dest += dest_stride_diff;
             src += source_stride_diff;
         }
-    } else if (source->format == ZX_PIXEL_FORMAT_RGB_x888 && target->format == ZX_PIXEL_FORMAT_RGB_x888) {
-        // both are 32 bit modes, no alpha
-        const uint32_t* src = &((const uint32_t*)source->ptr)[srcx + srcy * source->stride];
-        uint32_t* dest = &((uint32_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
-    } else if (source->format == ZX_PIXEL_FORMAT_MONO_8 && target->format == ZX_PIXEL_FORMAT_MONO_8) {
-        // both are 8 bit modes, no alpha
-        const uint8_t* src = &((const uint8_t*)source->ptr)[srcx + srcy * source->stride];
-        uint8_t* dest = &((uint8_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
     } else {
         xprintf("gfx_surface_blend: unimplemented colorspace combination (source %d target %d)\n", source->format, target->format);
         assert(0);
@@ -644,7 +514,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
     switch (format) {
     case ZX_PIXEL_FORMAT_RGB_565:
         surface->translate_color = &ARGB8888_to_RGB565;
-        surface->copyrect = &copyrect16;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect16;
         surface->putpixel = &putpixel16;
         surface->putchar = &putchar16;
@@ -654,7 +524,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
     case ZX_PIXEL_FORMAT_RGB_x888:
     case ZX_PIXEL_FORMAT_ARGB_8888:
         surface->translate_color = NULL;
-        surface->copyrect = &copyrect32;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect32;
         surface->putpixel = &putpixel32;
         surface->putchar = &putchar32;
@@ -663,7 +533,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case ZX_PIXEL_FORMAT_MONO_8:
         surface->translate_color = &ARGB8888_to_Luma;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
@@ -672,7 +542,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case ZX_PIXEL_FORMAT_RGB_332:
         surface->translate_color = &ARGB8888_to_RGB332;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
@@ -681,7 +551,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case ZX_PIXEL_FORMAT_RGB_2220:
         surface->translate_color = &ARGB8888_to_RGB2220;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
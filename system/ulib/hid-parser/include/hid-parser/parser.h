@@ -202,6 +202,9 @@ struct ReportField {
     NodeType type;
     uint32_t flags;
     Collection* col;
+    // Position of the field's first bit in reports of its id and type,
+    // counting the leading report id byte when reports have one.
+    uint32_t bit_offset;
 };
 
 struct ReportDescriptor {
@@ -240,4 +243,11 @@ ParseResult ParseReportDescriptor(
     const uint8_t* rpt_desc, size_t desc_len,
     DeviceDescriptor** dev_desc);
 
+// Reads the raw value of |field| out of |report|, using its bit_offset and
+// bit_sz, so that clients which keep the parsed descriptor do not have to
+// walk the fields of every report they receive. Returns false if the field
+// is wider than 32 bits or does not fit in |report_len| bytes.
+bool ExtractUint(const uint8_t* report, size_t report_len,
+                 const ReportField& field, uint32_t* value);
+
 }  // namespace hid
@@ -124,6 +124,9 @@ public:
         // refer to collections in the source need to be translated to pointers
         // valid within the destination memory area.
 
+        // When reports have an id it is their first byte, ahead of the fields.
+        const uint32_t first_bit = (report_id_count_ == 0) ? 0u : 8u;
+
         if (report_id_count_ == 0) {
             // The reports don't have an id. This is scenario #1 as
             // explained in the header.
@@ -163,10 +166,14 @@ public:
         size_t ifr = 0u;
         int32_t last_id = -1;
         size_t count = 0;
+        // The size so far of each report, by id and type.
+        uint32_t report_bits[UINT8_MAX + 1][kFeature + 1] = {};
 
         for (const auto& f: fields_) {
             dest_fields[ix] = f;
             dest_fields[ix].col = coll_fixup(f.col);
+            dest_fields[ix].bit_offset = first_bit + report_bits[f.report_id][f.type];
+            report_bits[f.report_id][f.type] += f.attr.bit_sz;
 
             if (static_cast<int32_t>(f.report_id) != last_id) {
                 // New report id. Fill the next ReportDescriptor entry with the address
@@ -259,7 +266,8 @@ public:
                 attributes,
                 type,
                 flags,
-                curr_col
+                curr_col,
+                0u
             };
 
             fbl::AllocChecker ac;
@@ -573,4 +581,26 @@ ParseResult ParseReportDescriptor(
     return state.Finish(device);
 }
 
+bool ExtractUint(const uint8_t* report, size_t report_len,
+                 const ReportField& field, uint32_t* value) {
+    const uint32_t bit_sz = field.attr.bit_sz;
+    if (bit_sz == 0 || bit_sz > 32)
+        return false;
+    const uint64_t end_bit = static_cast<uint64_t>(field.bit_offset) + bit_sz;
+    if (end_bit > static_cast<uint64_t>(report_len) * 8)
+        return false;
+
+    // A field of up to 32 bits spans at most 5 bytes. Fields are packed
+    // least significant bit first.
+    const uint32_t first_byte = field.bit_offset / 8;
+    const uint32_t last_byte = static_cast<uint32_t>((end_bit - 1) / 8);
+    uint64_t bits = 0;
+    for (uint32_t ix = first_byte; ix <= last_byte; ++ix)
+        bits |= static_cast<uint64_t>(report[ix]) << (8 * (ix - first_byte));
+
+    bits >>= field.bit_offset % 8;
+    *value = static_cast<uint32_t>(bits & ((1ull << bit_sz) - 1));
+    return true;
+}
+
 }  // namespace hid
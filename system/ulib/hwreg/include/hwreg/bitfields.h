@@ -52,9 +52,17 @@
 //       AuxControl::Get().ReadFrom(reg_io).set_message_size(1234).set_enabled(1).WriteTo(reg_io);
 //   }
 //
+//   // Several fields may be changed with one read and one write:
+//   void Example3(hwreg::RegisterIo* reg_io) {
+//       AuxControl::Get().Update(reg_io, [](auto& reg) {
+//           reg.set_message_size(1234);
+//           reg.set_enabled(1);
+//       });
+//   }
+//
 //   // It is also possible to write a register without having to read it
 //   // first:
-//   void Example3(hwreg::RegisterIo* reg_io) {
+//   void Example4(hwreg::RegisterIo* reg_io) {
 //       // Start off with a value that is initialized to zero.
 //       auto reg = AuxControl::Get().FromValue(0);
 //       // Fill out fields.
@@ -110,11 +118,15 @@ public:
     const ValueType* reg_value_ptr() const { return &reg_value_; }
     void set_reg_value(IntType value) { reg_value_ = value; }
 
-    SelfType& ReadFrom(RegisterIo* reg_io) {
-        reg_value_ = reg_io->Read<ValueType>(reg_addr_);
+    // |reg_io| may be a RegisterIo or anything else with its Read() and
+    // Write() methods, such as a TracedRegisterIo.
+    template <typename IoType>
+    SelfType& ReadFrom(IoType* reg_io) {
+        reg_value_ = reg_io->template Read<ValueType>(reg_addr_);
         return *static_cast<SelfType*>(this);
     }
-    SelfType& WriteTo(RegisterIo* reg_io) {
+    template <typename IoType>
+    SelfType& WriteTo(IoType* reg_io) {
         reg_io->Write(reg_addr_, static_cast<IntType>(reg_value_ & ~rsvdz_mask_));
         return *static_cast<SelfType*>(this);
     }
@@ -175,13 +187,31 @@ public:
 
     // Instantiate a RegisterBase using the value of the register read from
     // MMIO.
-    RegType ReadFrom(RegisterIo* reg_io) {
+    template <typename IoType>
+    RegType ReadFrom(IoType* reg_io) {
         RegType reg;
         reg.set_reg_addr(reg_addr_);
         reg.ReadFrom(reg_io);
         return reg;
     }
 
+    // Read the register, apply |update| to the snapshot and write it back:
+    // one read and one write however many fields |update| changes.  |update|
+    // is called as update(RegType&).  Returns the value written.
+    //
+    // Example use:
+    //   AuxControl::Get().Update(reg_io, [](auto& reg) {
+    //       reg.set_message_size(1234);
+    //       reg.set_enabled(1);
+    //   });
+    template <typename IoType, typename F>
+    RegType Update(IoType* reg_io, F update) {
+        RegType reg = ReadFrom(reg_io);
+        update(reg);
+        reg.WriteTo(reg_io);
+        return reg;
+    }
+
     // Instantiate a RegisterBase using the given value for the register.
     RegType FromValue(typename RegType::ValueType value) {
         RegType reg;
@@ -196,6 +226,54 @@ private:
     const uint32_t reg_addr_;
 };
 
+// A ShadowedRegister keeps the last value written to a register, so that it
+// can be updated without reading the hardware.  This is needed for write-only
+// registers, and saves the read on registers that only the driver changes.
+// The shadow must be seeded with Reset() (or Load() for readable registers)
+// before the first Update().
+//
+// Example use:
+//   hwreg::ShadowedRegister<AuxControl> aux(AuxControl::Get());
+//   aux.Reset(0);
+//   aux.Update(reg_io, [](auto& reg) { reg.set_enabled(1); });
+template <class RegType> class ShadowedRegister {
+public:
+    explicit ShadowedRegister(RegisterAddr<RegType> addr) : reg_(addr.FromValue(0)) {}
+
+    // The value last written (or loaded).
+    const RegType& value() const { return reg_; }
+
+    // Seed the shadow without touching the hardware.
+    void Reset(typename RegType::ValueType value) { reg_.set_reg_value(value); }
+
+    // Seed the shadow from the hardware.
+    template <typename IoType>
+    const RegType& Load(IoType* reg_io) { return reg_.ReadFrom(reg_io); }
+
+    // Apply |update| to the shadow and write the result, with no read.
+    template <typename IoType, typename F>
+    const RegType& Update(IoType* reg_io, F update) {
+        update(reg_);
+        return reg_.WriteTo(reg_io);
+    }
+
+    // As Update(), but skip the write if |update| left the value unchanged.
+    // Only for registers where writing the same value back has no effect.
+    template <typename IoType, typename F>
+    bool UpdateIfChanged(IoType* reg_io, F update) {
+        typename RegType::ValueType old_value = reg_.reg_value();
+        update(reg_);
+        if (reg_.reg_value() == old_value) {
+            return false;
+        }
+        reg_.WriteTo(reg_io);
+        return true;
+    }
+
+private:
+    RegType reg_;
+};
+
 template <class IntType> class BitfieldRef {
 public:
     BitfieldRef(IntType* value_ptr, uint32_t bit_high_incl, uint32_t bit_low)
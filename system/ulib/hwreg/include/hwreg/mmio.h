@@ -6,6 +6,7 @@
 
 #include <hwreg/internal.h>
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace hwreg {
@@ -41,4 +42,28 @@ private:
     const uintptr_t mmio_;
 };
 
+// A RegisterIo which reports every access to |Tracer|, for debugging drivers.
+// Tracer must provide:
+//   static void OnRead(uintptr_t base, uint32_t offset, uint64_t value, size_t width);
+//   static void OnWrite(uintptr_t base, uint32_t offset, uint64_t value, size_t width);
+// with |width| in bytes.  The hooks are bound at compile time, so drivers which
+// use a plain RegisterIo pay nothing for them.  Registers only see the hooks
+// when handed a TracedRegisterIo* rather than a RegisterIo*.
+template <class Tracer> class TracedRegisterIo : public RegisterIo {
+public:
+    TracedRegisterIo(volatile void* mmio) : RegisterIo(mmio) {
+    }
+
+    template <class IntType> void Write(uint32_t offset, IntType val) {
+        Tracer::OnWrite(base(), offset, val, sizeof(IntType));
+        RegisterIo::Write(offset, val);
+    }
+
+    template <class IntType> IntType Read(uint32_t offset) {
+        IntType val = RegisterIo::Read<IntType>(offset);
+        Tracer::OnRead(base(), offset, val, sizeof(IntType));
+        return val;
+    }
+};
+
 } // namespace hwreg
@@ -8,8 +8,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <zircon/compiler.h>
 #include <zircon/types.h>
 
+__BEGIN_CDECLS
+
 typedef struct mac_addr mac_addr_t;
 typedef union ip6_addr ip6_addr_t;
 typedef struct ip6_hdr ip6_hdr_t;
@@ -20,6 +23,7 @@ typedef struct ndp_n_hdr ndp_n_hdr_t;
 #define ETH_ADDR_LEN 6
 #define ETH_HDR_LEN 14
 #define ETH_MTU 1514
+#define ETH_JUMBO_MTU 9014
 
 #define IP6_ADDR_LEN 16
 #define IP6_U32_LEN 4
@@ -144,8 +148,24 @@ void eth_put_buffer(eth_buffer_t* ethbuf);
 
 zx_status_t eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len);
 
+// As eth_send(), having the device complete the transport checksum at
+// |csum_offset| bytes past |csum_start| in the frame, which must hold the sum
+// of the pseudo-header. Needs ETH_CSUM_HEADROOM bytes of the buffer before
+// |skip|, and may only be used if eth_csum_offload() is true.
+zx_status_t eth_send_csum(eth_buffer_t* ethbuf, size_t skip, size_t len,
+                          size_t csum_start, size_t csum_offset);
+bool eth_csum_offload(void);
+#define ETH_CSUM_HEADROOM 16
+
+// Largest frame, including the ethernet header, that the interface sends
+// and receives: ETH_MTU, or up to ETH_JUMBO_MTU on devices taking jumbo frames.
+size_t eth_frame_size(void);
+
 int eth_add_mcast_filter(const mac_addr_t* addr);
 
+// largest payload udp6_send() will take, given the interface's frame size
+size_t udp6_max_payload(void);
+
 // call to transmit a UDP packet
 zx_status_t udp6_send(const void* data, size_t len,
                       const ip6_addr_t* daddr, uint16_t dport,
@@ -185,3 +205,5 @@ unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length);
 // network stack via eth_send() or, in the event of an error, release
 // via eth_put_buffer().
 //
+
+__END_CDECLS
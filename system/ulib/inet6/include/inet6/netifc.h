@@ -4,8 +4,16 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
 // setup networking
-// if interface != NULL, only use the given topological path for networking
+// if interface != NULL, only use the given topological path for networking,
+// which may then name a wireless or synthetic device
 int netifc_open(const char* interface);
 
 // process inbound packet(s)
@@ -29,3 +37,5 @@ void netifc_recv(void* data, size_t len);
 bool netifc_send_pending(void);
 
 void netifc_get_info(uint8_t* addr, uint16_t* mtu);
+
+__END_CDECLS
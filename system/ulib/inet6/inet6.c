@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -234,6 +235,12 @@ unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length) {
     }
 }
 
+// The sum of the pseudo-header alone, for the device to complete.
+static uint16_t ip6_pseudo_checksum(ip6_hdr_t* ip, unsigned type) {
+    uint16_t sum = checksum(&ip->length, 2, htons(type));
+    return checksum(&ip->src, 32, sum);
+}
+
 static int ip6_setup(ip6_pkt_t* p, const ip6_addr_t* daddr, size_t length, uint8_t type) {
     mac_addr_t dmac;
 
@@ -257,19 +264,26 @@ static int ip6_setup(ip6_pkt_t* p, const ip6_addr_t* daddr, size_t length, uint8
     return 0;
 }
 
-#define UDP6_MAX_PAYLOAD (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN - UDP_HDR_LEN)
+size_t udp6_max_payload(void) {
+    return eth_frame_size() - ETH_HDR_LEN - IP6_HDR_LEN - UDP_HDR_LEN;
+}
 
 zx_status_t udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, uint16_t dport,
                       uint16_t sport, bool block) {
-    if (dlen > UDP6_MAX_PAYLOAD)
+    if (dlen > udp6_max_payload())
         return ZX_ERR_INVALID_ARGS;
     size_t length = dlen + UDP_HDR_LEN;
+    bool offload = eth_csum_offload();
+    size_t headroom = offload ? ETH_CSUM_HEADROOM : 0;
+    uint8_t* buf;
     udp_pkt_t* p;
     eth_buffer_t* ethbuf;
-    zx_status_t status = eth_get_buffer(ETH_MTU + 2, (void**) &p, &ethbuf, block);
+    zx_status_t status = eth_get_buffer(headroom + ETH_HDR_LEN + IP6_HDR_LEN + length + 2,
+                                        (void**) &buf, &ethbuf, block);
     if (status != ZX_OK) {
         return status;
     }
+    p = (void*)(buf + headroom);
     if (ip6_setup((void*)p, daddr, length, HDR_UDP)) {
         eth_put_buffer(ethbuf);
         return ZX_ERR_INVALID_ARGS;
@@ -282,6 +296,11 @@ zx_status_t udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, ui
     p->udp.checksum = 0;
 
     memcpy(p->data, data, dlen);
+    if (offload) {
+        p->udp.checksum = ip6_pseudo_checksum(&p->ip6, HDR_UDP);
+        return eth_send_csum(ethbuf, headroom + 2, ETH_HDR_LEN + IP6_HDR_LEN + length,
+                             ETH_HDR_LEN + IP6_HDR_LEN, offsetof(udp_hdr_t, checksum));
+    }
     p->udp.checksum = ip6_checksum(&p->ip6, HDR_UDP, length);
     return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length);
 }
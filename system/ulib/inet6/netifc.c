@@ -61,12 +61,20 @@ static int netfd = -1;
 static eth_client_t* eth;
 static uint8_t netmac[6];
 static size_t netmtu;
+static bool netcsum;
 
 static zx_handle_t iovmo;
 static void* iobuf;
 
 #define NET_BUFFERS 256
 #define NET_BUFFERSZ 2048
+// Room for a jumbo frame, with its alignment pad and offload header
+#define NET_JUMBO_BUFFERSZ 10240
+
+// Buffer size, fixed by whichever device was opened first, and the largest
+// frame the current device may use within it.
+static size_t net_buffersz;
+static size_t netframe = ETH_MTU;
 
 #define ETH_BUFFER_MAGIC 0x424201020304A7A7UL
 
@@ -139,7 +147,7 @@ static void tx_complete(void* ctx, void* cookie) __TA_REQUIRES(eth_lock) {
 static zx_status_t eth_get_buffer_locked(size_t sz, void** data, eth_buffer_t** out,
                                          uint32_t newstate, bool block) __TA_REQUIRES(eth_lock) {
     eth_buffer_t* buf;
-    if (sz > NET_BUFFERSZ) {
+    if (sz > net_buffersz) {
         return ZX_ERR_INVALID_ARGS;
     }
     if (eth_buffers == NULL) {
@@ -184,7 +192,9 @@ zx_status_t eth_get_buffer(size_t sz, void** data, eth_buffer_t** out, bool bloc
     return r;
 }
 
-zx_status_t eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
+static_assert(sizeof(eth_offload_t) == ETH_CSUM_HEADROOM, "");
+
+static zx_status_t eth_send_flags(eth_buffer_t* ethbuf, void* data, size_t len, uint32_t flags) {
     zx_status_t status;
     mtx_lock(&eth_lock);
 
@@ -208,7 +218,7 @@ zx_status_t eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
     }
 
     ethbuf->state = ETH_BUFFER_TX;
-    status = eth_queue_tx(eth, ethbuf, ethbuf->data + skip, len, 0);
+    status = eth_queue_tx(eth, ethbuf, data, len, flags);
     if (status < 0) {
         printf("eth_fifo_send: queue tx failed: %d\n", status);
         eth_put_buffer_locked(ethbuf, ETH_BUFFER_TX);
@@ -223,6 +233,28 @@ fail:
     return status;
 }
 
+zx_status_t eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
+    return eth_send_flags(ethbuf, ethbuf->data + skip, len, 0);
+}
+
+zx_status_t eth_send_csum(eth_buffer_t* ethbuf, size_t skip, size_t len,
+                          size_t csum_start, size_t csum_offset) {
+    eth_offload_t* offload = ethbuf->data + skip - sizeof(eth_offload_t);
+    memset(offload, 0, sizeof(*offload));
+    offload->flags = ETH_OFFLOAD_CSUM;
+    offload->csum_start = csum_start;
+    offload->csum_offset = csum_offset;
+    return eth_send_flags(ethbuf, offload, sizeof(*offload) + len, ETH_FIFO_TX_OFFLOAD);
+}
+
+bool eth_csum_offload(void) {
+    return netcsum;
+}
+
+size_t eth_frame_size(void) {
+    return netframe;
+}
+
 int eth_add_mcast_filter(const mac_addr_t* addr) {
     return 0;
 }
@@ -284,12 +316,31 @@ static zx_status_t netifc_open_cb(int dirfd, int event, const char* fn, void* co
     if (ioctl_ethernet_get_info(netfd, &info) < 0) {
         goto fail_close_fd;
     }
-    if (info.features & (ETH_FEATURE_WLAN | ETH_FEATURE_SYNTH)) {
-        // Don't run netsvc for wireless or synthetic network devices
+    if ((cookie == NULL) && (info.features & (ETH_FEATURE_WLAN | ETH_FEATURE_SYNTH))) {
+        // Don't run netsvc for wireless or synthetic network devices, unless
+        // one was asked for by name
         goto fail_close_fd;
     }
     memcpy(netmac, info.mac, sizeof(netmac));
     netmtu = info.mtu;
+    netcsum = (info.features & ETH_FEATURE_TX_CSUM) != 0;
+
+    // Drivers variously report their mtu with or without the ethernet header,
+    // so only take it as asking for jumbo frames when it is well beyond either.
+    size_t frame = ETH_MTU;
+    if (info.mtu > NET_BUFFERSZ) {
+        frame = info.mtu + ETH_HDR_LEN;
+        if (frame > ETH_JUMBO_MTU) {
+            frame = ETH_JUMBO_MTU;
+        }
+    }
+    if (net_buffersz == 0) {
+        net_buffersz = (frame > ETH_MTU) ? NET_JUMBO_BUFFERSZ : NET_BUFFERSZ;
+    }
+    if (frame > net_buffersz - ETH_CSUM_HEADROOM - 2) {
+        frame = ETH_MTU;
+    }
+    netframe = frame;
 
     zx_status_t status;
 
@@ -305,7 +356,7 @@ static zx_status_t netifc_open_cb(int dirfd, int event, const char* fn, void* co
     // we only do this the very first time
     if (iobuf == NULL) {
         // allocate shareable ethernet buffer data heap
-        size_t iosize = 2 * NET_BUFFERS * NET_BUFFERSZ;
+        size_t iosize = 2 * NET_BUFFERS * net_buffersz;
         if ((status = zx_vmo_create(iosize, 0, &iovmo)) < 0) {
             goto fail_close_fd;
         }
@@ -320,7 +371,7 @@ static zx_status_t netifc_open_cb(int dirfd, int event, const char* fn, void* co
         // assign data chunks to ethbufs
         for (unsigned n = 0; n < eth_buffer_count; n++) {
             eth_buffer_base[n].magic = ETH_BUFFER_MAGIC;
-            eth_buffer_base[n].data = iobuf + n * NET_BUFFERSZ;
+            eth_buffer_base[n].data = iobuf + n * net_buffersz;
             eth_buffer_base[n].state = ETH_BUFFER_FREE;
             eth_buffer_base[n].reserved = 0;
             eth_put_buffer_locked(eth_buffer_base + n, ETH_BUFFER_FREE);
@@ -344,11 +395,11 @@ static zx_status_t netifc_open_cb(int dirfd, int event, const char* fn, void* co
     for (unsigned n = 0; n < NET_BUFFERS; n++) {
         void* data;
         eth_buffer_t* ethbuf;
-        if (eth_get_buffer_locked(NET_BUFFERSZ, &data, &ethbuf, ETH_BUFFER_RX, false)) {
+        if (eth_get_buffer_locked(net_buffersz, &data, &ethbuf, ETH_BUFFER_RX, false)) {
             printf("netifc: only queued %u buffers (desired: %u)\n", n, NET_BUFFERS);
             break;
         }
-        eth_queue_rx(eth, ethbuf, ethbuf->data, NET_BUFFERSZ, 0);
+        eth_queue_rx(eth, ethbuf, ethbuf->data, net_buffersz, 0);
     }
 
     mtx_unlock(&eth_lock);
@@ -421,7 +472,7 @@ static void rx_complete(void* ctx, void* cookie, size_t len, uint32_t flags) {
     eth_buffer_t* ethbuf = cookie;
     check_ethbuf(ethbuf, ETH_BUFFER_RX);
     netifc_recv(ethbuf->data, len);
-    eth_queue_rx(eth, ethbuf, ethbuf->data, NET_BUFFERSZ, 0);
+    eth_queue_rx(eth, ethbuf, ethbuf->data, net_buffersz, 0);
 }
 
 int netifc_poll(void) {
@@ -354,13 +354,14 @@ void inspector_print_backtrace(FILE* f,
             unw_get_reg(&cursor, UNW_REG_SP, &val);
             sp = val;
         } else {
+            // The saved frame pointer and the return address, in one read.
+            uintptr_t frame[2];
             sp = fp;
-            if (read_mem(process, fp + 8, &pc, sizeof(pc))) {
-                break;
-            }
-            if (read_mem(process, fp, &fp, sizeof(fp))) {
+            if (read_mem(process, fp, frame, sizeof(frame))) {
                 break;
             }
+            fp = frame[0];
+            pc = frame[1];
         }
         btprint(f, &di_cache, n++, pc, sp);
     }
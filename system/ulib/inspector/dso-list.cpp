@@ -19,10 +19,6 @@
 
 #define rdebug_off_lmap offsetof(struct r_debug, r_map)
 
-#define lmap_off_next offsetof(struct link_map, l_next)
-#define lmap_off_name offsetof(struct link_map, l_name)
-#define lmap_off_addr offsetof(struct link_map, l_addr)
-
 using inspector::read_mem;
 using inspector::fetch_string;
 using inspector::fetch_build_id;
@@ -95,28 +91,22 @@ inspector_dsoinfo_t* inspector_dso_fetch_list(zx_handle_t h) {
             return nullptr;
         }
         char dsoname[64];
-        zx_vaddr_t base;
-        uintptr_t next;
-        uintptr_t str;
-        if (read_mem(h, lmap + lmap_off_addr, &base, sizeof(base))) {
-            break;
-        }
-        if (read_mem(h, lmap + lmap_off_next, &next, sizeof(next))) {
-            break;
-        }
-        if (read_mem(h, lmap + lmap_off_name, &str, sizeof(str))) {
+        // Read the whole entry at once, rather than field by field.
+        struct link_map entry;
+        if (read_mem(h, lmap, &entry, sizeof(entry))) {
             break;
         }
-        if (fetch_string(h, str, dsoname, sizeof(dsoname))) {
+        if (fetch_string(h, reinterpret_cast<uintptr_t>(entry.l_name), dsoname,
+                         sizeof(dsoname))) {
             break;
         }
         inspector_dsoinfo_t* dso = dsolist_add(&dsolist,
                                                dsoname[0] ? dsoname : name,
-                                               base);
+                                               entry.l_addr);
         if (dso != nullptr) {
             fetch_build_id(h, dso->base, dso->buildid, sizeof(dso->buildid));
         }
-        lmap = next;
+        lmap = reinterpret_cast<uintptr_t>(entry.l_next);
     }
 
     return dsolist;
@@ -142,6 +132,14 @@ inspector_dsoinfo_t* inspector_dso_lookup(inspector_dsoinfo_t* dso_list,
     return nullptr;
 }
 
+const char* inspector_dso_name(inspector_dsoinfo_t* dso) {
+    return dso->name;
+}
+
+zx_vaddr_t inspector_dso_base(inspector_dsoinfo_t* dso) {
+    return dso->base;
+}
+
 void inspector_dso_print_list(FILE* f, inspector_dsoinfo_t* dso_list) {
     for (inspector_dsoinfo_t* dso = dso_list; dso != nullptr; dso = dso->next) {
         fprintf(f, "dso: id=%s base=%p name=%s\n",
@@ -75,15 +75,23 @@ zx_status_t read_mem(zx_handle_t h, zx_vaddr_t vaddr, void* ptr, size_t len) {
 }
 
 zx_status_t fetch_string(zx_handle_t h, zx_vaddr_t vaddr, char* ptr, size_t max) {
+    // Read up to the end of a page at a time, stopping at the terminating
+    // NUL. The string may be followed by an unmapped page, so don't read
+    // past the page it ends in.
     while (max > 1) {
+        size_t chunk = PAGE_SIZE - (vaddr & (PAGE_SIZE - 1));
+        if (chunk > max - 1)
+            chunk = max - 1;
         zx_status_t status;
-        if ((status = read_mem(h, vaddr, ptr, 1)) < 0) {
+        if ((status = read_mem(h, vaddr, ptr, chunk)) < 0) {
             *ptr = 0;
             return status;
         }
-        ptr++;
-        vaddr++;
-        max--;
+        if (memchr(ptr, 0, chunk) != nullptr)
+            return ZX_OK;
+        ptr += chunk;
+        vaddr += chunk;
+        max -= chunk;
     }
     *ptr = 0;
     return ZX_OK;
@@ -91,112 +99,101 @@ zx_status_t fetch_string(zx_handle_t h, zx_vaddr_t vaddr, char* ptr, size_t max)
 
 #if UINT_MAX == ULONG_MAX
 
-#define ehdr_off_phoff offsetof(Elf32_Ehdr, e_phoff)
-#define ehdr_off_phnum offsetof(Elf32_Ehdr, e_phnum)
-
-#define phdr_off_type offsetof(Elf32_Phdr, p_type)
-#define phdr_off_offset offsetof(Elf32_Phdr, p_offset)
-#define phdr_off_filesz offsetof(Elf32_Phdr, p_filesz)
-
-typedef Elf32_Half elf_half_t;
-typedef Elf32_Off elf_off_t;
-// ELF used "word" for 32 bits, sigh.
-typedef Elf32_Word elf_word_t;
-typedef Elf32_Word elf_native_word_t;
+typedef Elf32_Ehdr elf_ehdr_t;
 typedef Elf32_Phdr elf_phdr_t;
 
 #else
 
-#define ehdr_off_phoff offsetof(Elf64_Ehdr, e_phoff)
-#define ehdr_off_phnum offsetof(Elf64_Ehdr, e_phnum)
-
-#define phdr_off_type offsetof(Elf64_Phdr, p_type)
-#define phdr_off_offset offsetof(Elf64_Phdr, p_offset)
-#define phdr_off_filesz offsetof(Elf64_Phdr, p_filesz)
-
-typedef Elf64_Half elf_half_t;
-typedef Elf64_Off elf_off_t;
-typedef Elf64_Word elf_word_t;
-typedef Elf64_Xword elf_native_word_t;
+typedef Elf64_Ehdr elf_ehdr_t;
 typedef Elf64_Phdr elf_phdr_t;
 
 #endif
 
+// Program headers are read this many at a time.
+constexpr size_t kPhdrBatch = 16;
+
+// Note segments are read this much at a time. They're usually just the
+// build ID, so one read is normally enough.
+constexpr size_t kNoteBatch = 512;
+
+// Looks for the build ID note in |notes|, the first |size| bytes of a note
+// segment. Returns ZX_OK with the build ID written to |buf| if it's there,
+// ZX_ERR_NEXT with |*consumed| set to the size of the notes before it
+// otherwise.
+static zx_status_t find_build_id_note(const uint8_t* notes, size_t size, char* buf,
+                                      size_t buf_size, size_t* consumed) {
+    size_t pos = 0;
+    while (pos + sizeof(Elf32_Nhdr) + sizeof("GNU") < size) {
+        Elf32_Nhdr nhdr;
+        memcpy(&nhdr, notes + pos, sizeof(nhdr));
+        const uint8_t* name = notes + pos + sizeof(nhdr);
+        size_t header_size = sizeof(Elf32_Nhdr) + ((nhdr.n_namesz + 3) & -4);
+        size_t payload_size = (nhdr.n_descsz + 3) & -4;
+        if (nhdr.n_type == NT_GNU_BUILD_ID &&
+            nhdr.n_namesz == sizeof("GNU") &&
+            memcmp(name, "GNU", sizeof("GNU")) == 0) {
+            if (nhdr.n_descsz > MAX_BUILDID_SIZE) {
+                snprintf(buf, buf_size, "build_id_too_large_%u", nhdr.n_descsz);
+                return ZX_OK;
+            }
+            if (header_size + nhdr.n_descsz > size - pos) {
+                // The rest of it is in the next batch.
+                break;
+            }
+            const uint8_t* buildid = notes + pos + header_size;
+            for (uint32_t i = 0; i < nhdr.n_descsz; ++i) {
+                snprintf(&buf[i * 2], 3, "%02x", buildid[i]);
+            }
+            return ZX_OK;
+        }
+        pos += header_size + payload_size;
+    }
+    *consumed = pos;
+    return ZX_ERR_NEXT;
+}
+
 zx_status_t fetch_build_id(zx_handle_t h, zx_vaddr_t base, char* buf, size_t buf_size) {
     zx_vaddr_t vaddr = base;
-    uint8_t tmp[4];
     zx_status_t status;
 
     if (buf_size < MAX_BUILDID_SIZE * 2 + 1)
         return ZX_ERR_INVALID_ARGS;
 
-    status = read_mem(h, vaddr, tmp, 4);
+    elf_ehdr_t ehdr;
+    status = read_mem(h, vaddr, &ehdr, sizeof(ehdr));
     if (status != ZX_OK)
         return status;
-    if (memcmp(tmp, ELFMAG, SELFMAG))
+    if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG))
         return ZX_ERR_WRONG_TYPE;
 
-    elf_off_t phoff;
-    elf_half_t num;
-    status = read_mem(h, vaddr + ehdr_off_phoff, &phoff, sizeof(phoff));
-    if (status != ZX_OK)
-        return status;
-    status = read_mem(h, vaddr + ehdr_off_phnum, &num, sizeof(num));
-    if (status != ZX_OK)
-        return status;
-
-    for (unsigned n = 0; n < num; n++) {
-        zx_vaddr_t phaddr = vaddr + phoff + (n * sizeof(elf_phdr_t));
-        elf_word_t type;
-        status = read_mem(h, phaddr + phdr_off_type, &type, sizeof(type));
+    for (unsigned n = 0; n < ehdr.e_phnum; n += kPhdrBatch) {
+        elf_phdr_t phdrs[kPhdrBatch];
+        size_t count = ehdr.e_phnum - n < kPhdrBatch ? ehdr.e_phnum - n : kPhdrBatch;
+        status = read_mem(h, vaddr + ehdr.e_phoff + n * sizeof(elf_phdr_t), phdrs,
+                          count * sizeof(elf_phdr_t));
         if (status != ZX_OK)
             return status;
-        if (type != PT_NOTE)
-            continue;
 
-        elf_off_t off;
-        elf_native_word_t size;
-        status = read_mem(h, phaddr + phdr_off_offset, &off, sizeof(off));
-        if (status != ZX_OK)
-            return status;
-        status = read_mem(h, phaddr + phdr_off_filesz, &size, sizeof(size));
-        if (status != ZX_OK)
-            return status;
-
-        struct {
-            Elf32_Nhdr hdr;
-            char name[sizeof("GNU")];
-        } hdr;
-        while (size > sizeof(hdr)) {
-            status = read_mem(h, vaddr + off, &hdr, sizeof(hdr));
-            if (status != ZX_OK)
-                return status;
-            size_t header_size =
-                sizeof(Elf32_Nhdr) + ((hdr.hdr.n_namesz + 3) & -4);
-            size_t payload_size = (hdr.hdr.n_descsz + 3) & -4;
-            off += header_size;
-            size -= header_size;
-            zx_vaddr_t payload_vaddr = vaddr + off;
-            off += payload_size;
-            size -= payload_size;
-            if (hdr.hdr.n_type != NT_GNU_BUILD_ID ||
-                hdr.hdr.n_namesz != sizeof("GNU") ||
-                memcmp(hdr.name, "GNU", sizeof("GNU")) != 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (phdrs[i].p_type != PT_NOTE)
                 continue;
-            }
-            if (hdr.hdr.n_descsz > MAX_BUILDID_SIZE) {
-                snprintf(buf, buf_size,
-                         "build_id_too_large_%u", hdr.hdr.n_descsz);
-            } else {
-                uint8_t buildid[MAX_BUILDID_SIZE];
-                status = read_mem(h, payload_vaddr, buildid, hdr.hdr.n_descsz);
+
+            size_t off = phdrs[i].p_offset;
+            size_t size = phdrs[i].p_filesz;
+            while (size > sizeof(Elf32_Nhdr) + sizeof("GNU")) {
+                uint8_t notes[kNoteBatch];
+                size_t chunk = size < sizeof(notes) ? size : sizeof(notes);
+                status = read_mem(h, vaddr + off, notes, chunk);
                 if (status != ZX_OK)
                     return status;
-                for (uint32_t i = 0; i < hdr.hdr.n_descsz; ++i) {
-                    snprintf(&buf[i * 2], 3, "%02x", buildid[i]);
-                }
+                size_t consumed;
+                if (find_build_id_note(notes, chunk, buf, buf_size, &consumed) == ZX_OK)
+                    return ZX_OK;
+                if (consumed == 0 || consumed >= size)
+                    break;
+                off += consumed;
+                size -= consumed;
             }
-            return ZX_OK;
         }
     }
 
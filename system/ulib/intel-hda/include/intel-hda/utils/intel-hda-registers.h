@@ -196,6 +196,13 @@ constexpr uint8_t HDA_REG_RIRBSIZE_CAP_2ENT   = 0x10u;
 constexpr uint8_t HDA_REG_RIRBSIZE_CAP_16ENT  = 0x20u;
 constexpr uint8_t HDA_REG_RIRBSIZE_CAP_256ENT = 0x40u;
 
+/* DMA Position Buffer Lower Base (DPIBLBASE - offset 0x70) */
+constexpr uint32_t HDA_REG_DPIBLBASE_EN = 0x01u;  // DMA Position Buffer Enable
+
+// Each stream's entry in the DMA position buffer holds its LPIB in the first
+// 32 bits of a 64 bit slot.  Entries are ordered by stream descriptor index.
+constexpr uint32_t HDA_DMA_POS_ENTRY_SIZE = 8u;
+
 // Stream Descriptor Control Register bits.
 constexpr uint32_t HDA_SD_REG_CTRL_SRST    = (1u << 0); // Stream Reset
 constexpr uint32_t HDA_SD_REG_CTRL_RUN     = (1u << 1); // Stream Run
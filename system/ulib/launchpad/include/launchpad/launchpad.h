@@ -133,6 +133,34 @@ zx_status_t launchpad_load_from_fd(launchpad_t* lp, int fd);
 zx_status_t launchpad_load_from_vmo(launchpad_t* lp, zx_handle_t vmo);
 
 
+// LAUNCH TEMPLATES
+// A template holds everything launchpad_load_from_vmo works out about an
+// executable before it maps anything: the parsed ELF headers of the
+// executable, of its PT_INTERP dynamic linker and of the vDSO, and the VM
+// objects holding them.  Loading from a template maps the same images
+// without reading or parsing them again, or asking the loader service for
+// the dynamic linker.  Writable segments are copy-on-write clones, as
+// ever.  Relocation is still done by the dynamic linker in each new
+// process once it starts.
+// ---------------------------------------------------------------------
+
+typedef struct launchpad_template launchpad_template_t;
+
+// Create a template for the ELF executable in |vmo|, which is consumed.
+// Its PT_INTERP, if any, is looked up via |loader_svc|, or via this
+// process's own loader service if that is ZX_HANDLE_INVALID; |loader_svc|
+// is not consumed.  Scripts cannot be made into templates.
+zx_status_t launchpad_template_create(zx_handle_t vmo, zx_handle_t loader_svc,
+                                      launchpad_template_t** out);
+
+// Load the executable captured in |tmpl|, as launchpad_load_from_vmo
+// would.  |tmpl| may be used by any number of launchpads at once.
+zx_status_t launchpad_load_from_template(launchpad_t* lp,
+                                         const launchpad_template_t* tmpl);
+
+void launchpad_template_destroy(launchpad_template_t* tmpl);
+
+
 // ADDING ARGUMENTS, ENVIRONMENT, AND HANDLES
 // These functions setup arguments, environment, or handles to be
 // passed to the new process via the processargs protocol.
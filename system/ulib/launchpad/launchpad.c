@@ -103,11 +103,8 @@ const char* launchpad_error_message(launchpad_t* lp) {
 #define lp_vmar(lp) ((lp)->handles[1])
 
 static void close_handles(zx_handle_t* handles, size_t count) {
-    for (size_t i = 0; i < count; ++i) {
-        if (handles[i] != ZX_HANDLE_INVALID) {
-            zx_handle_close(handles[i]);
-        }
-    }
+    // Skips over ZX_HANDLE_INVALID entries.
+    zx_handle_close_many(handles, count);
 }
 
 void launchpad_destroy(launchpad_t* lp) {
@@ -329,9 +326,7 @@ zx_status_t launchpad_add_handles(launchpad_t* lp, size_t n,
             }
         }
     } else {
-        for (size_t i = 0; i < n; i++) {
-            zx_handle_close(h[i]);
-        }
+        zx_handle_close_many(h, n);
     }
     return status;
 }
@@ -941,32 +936,17 @@ static zx_status_t send_loader_message(launchpad_t* lp,
         case HND_SPECIAL_COUNT:;
             // Duplicate the handles for the loader so we can send them in the
             // loader message and still have them later.
-            zx_handle_t proc;
-            status = zx_handle_duplicate(lp_proc(lp), ZX_RIGHT_SAME_RIGHTS, &proc);
-            if (status != ZX_OK) {
-                free(msg);
-                return status;
-            }
-            zx_handle_t vmar;
-            status = zx_handle_duplicate(lp_vmar(lp), ZX_RIGHT_SAME_RIGHTS, &vmar);
+            const zx_handle_t loader_handles[HND_LOADER_COUNT] = {
+                lp_proc(lp), lp_vmar(lp), first_thread,
+            };
+            status = zx_handle_duplicate_many(loader_handles, HND_LOADER_COUNT,
+                                              ZX_RIGHT_SAME_RIGHTS, &handles[nhandles]);
             if (status != ZX_OK) {
-                zx_handle_close(proc);
                 free(msg);
                 return status;
             }
-            zx_handle_t thread;
-            status = zx_handle_duplicate(first_thread, ZX_RIGHT_SAME_RIGHTS, &thread);
-            if (status != ZX_OK) {
-                zx_handle_close(proc);
-                zx_handle_close(vmar);
-                free(msg);
-                return status;
-            }
-            handles[nhandles] = proc;
             msg_handle_info[nhandles] = PA_PROC_SELF;
-            handles[nhandles + 1] = vmar;
             msg_handle_info[nhandles + 1] = PA_VMAR_ROOT;
-            handles[nhandles + 2] = thread;
             msg_handle_info[nhandles + 2] = PA_THREAD_SELF;
             nhandles += HND_LOADER_COUNT;
             continue;
@@ -999,9 +979,7 @@ static zx_status_t send_loader_message(launchpad_t* lp,
     } else {
         // Close the handles we duplicated for the loader.
         // The others remain live in the launchpad.
-        for (int i = 1; i <= HND_LOADER_COUNT; i++) {
-          zx_handle_close(handles[nhandles - i]);
-        }
+        zx_handle_close_many(&handles[nhandles - HND_LOADER_COUNT], HND_LOADER_COUNT);
     }
 
     free(msg);
@@ -1311,3 +1289,123 @@ zx_status_t launchpad_load_from_fd(launchpad_t* lp, int fd) {
 zx_status_t launchpad_load_from_vmo(launchpad_t* lp, zx_handle_t vmo) {
     return launchpad_file_load_with_vdso(lp, vmo);
 }
+
+struct launchpad_template {
+    zx_handle_t exec_vmo;
+    elf_load_info_t* exec_elf;
+    // ZX_HANDLE_INVALID when the executable has no PT_INTERP.
+    zx_handle_t interp_vmo;
+    elf_load_info_t* interp_elf;
+    zx_handle_t vdso_vmo;
+    elf_load_info_t* vdso_elf;
+};
+
+void launchpad_template_destroy(launchpad_template_t* tmpl) {
+    if (tmpl == NULL)
+        return;
+    close_handles(&tmpl->exec_vmo, 1);
+    close_handles(&tmpl->interp_vmo, 1);
+    close_handles(&tmpl->vdso_vmo, 1);
+    if (tmpl->exec_elf)
+        elf_load_destroy(tmpl->exec_elf);
+    if (tmpl->interp_elf)
+        elf_load_destroy(tmpl->interp_elf);
+    if (tmpl->vdso_elf)
+        elf_load_destroy(tmpl->vdso_elf);
+    free(tmpl);
+}
+
+zx_status_t launchpad_template_create(zx_handle_t vmo, zx_handle_t loader_svc,
+                                      launchpad_template_t** out) {
+    if (vmo == ZX_HANDLE_INVALID)
+        return ZX_ERR_INVALID_ARGS;
+    launchpad_template_t* tmpl = calloc(1, sizeof(*tmpl));
+    if (tmpl == NULL) {
+        zx_handle_close(vmo);
+        return ZX_ERR_NO_MEMORY;
+    }
+    tmpl->exec_vmo = vmo;
+
+    char* interp = NULL;
+    size_t interp_len;
+    zx_status_t status = elf_load_start(vmo, NULL, 0, &tmpl->exec_elf);
+    if (status == ZX_OK)
+        status = elf_load_get_interp(tmpl->exec_elf, vmo, &interp, &interp_len);
+    if (status == ZX_OK && interp != NULL) {
+        zx_handle_t svc = loader_svc;
+        if (svc == ZX_HANDLE_INVALID)
+            status = dl_clone_loader_service(&svc);
+        if (status == ZX_OK) {
+            status = loader_svc_rpc(svc, LDMSG_OP_LOAD_OBJECT, interp, interp_len,
+                                    &tmpl->interp_vmo);
+            if (svc != loader_svc)
+                zx_handle_close(svc);
+        }
+        if (status == ZX_OK)
+            status = elf_load_start(tmpl->interp_vmo, NULL, 0, &tmpl->interp_elf);
+    }
+    free(interp);
+    if (status == ZX_OK)
+        status = launchpad_get_vdso_vmo(&tmpl->vdso_vmo);
+    if (status == ZX_OK)
+        status = elf_load_start(tmpl->vdso_vmo, NULL, 0, &tmpl->vdso_elf);
+
+    if (status != ZX_OK) {
+        launchpad_template_destroy(tmpl);
+        return status;
+    }
+    *out = tmpl;
+    return ZX_OK;
+}
+
+// This mirrors launchpad_elf_load_body and handle_interp, followed by
+// launchpad_load_vdso and launchpad_add_vdso_vmo.
+zx_status_t launchpad_load_from_template(launchpad_t* lp,
+                                         const launchpad_template_t* tmpl) {
+    if (lp->error)
+        return lp->error;
+    if (tmpl == NULL)
+        return lp_error(lp, ZX_ERR_INVALID_ARGS, "load_from_template: no template");
+
+    zx_status_t status;
+    zx_handle_t segments_vmar;
+    if (tmpl->interp_vmo == ZX_HANDLE_INVALID) {
+        status = elf_load_finish(lp_vmar(lp), tmpl->exec_elf, tmpl->exec_vmo,
+                                 &segments_vmar, &lp->base, &lp->entry);
+        if (status != ZX_OK)
+            return lp_error(lp, status, "load_from_template: elf_load_finish() failed");
+        check_elf_stack_size(lp, tmpl->exec_elf);
+        lp->loader_message = false;
+        launchpad_add_handle(lp, segments_vmar, PA_HND(PA_VMAR_LOADED, 0));
+    } else {
+        zx_handle_t exec_vmo;
+        if ((status = setup_loader_svc(lp)) != ZX_OK)
+            return lp_error(lp, status, "load_from_template: no loader service");
+        if (lp->fresh_process && (status = reserve_low_address_space(lp)) != ZX_OK)
+            return status;
+        status = elf_load_finish(lp_vmar(lp), tmpl->interp_elf, tmpl->interp_vmo,
+                                 &segments_vmar, &lp->base, &lp->entry);
+        if (status != ZX_OK)
+            return lp_error(lp, status, "load_from_template: elf_load_finish() failed");
+        status = zx_handle_duplicate(tmpl->exec_vmo, ZX_RIGHT_SAME_RIGHTS, &exec_vmo);
+        if (status != ZX_OK) {
+            zx_handle_close(segments_vmar);
+            return lp_error(lp, status, "load_from_template: cannot duplicate vmo");
+        }
+        close_handles(&lp->special_handles[HND_EXEC_VMO], 1);
+        lp->special_handles[HND_EXEC_VMO] = exec_vmo;
+        close_handles(&lp->special_handles[HND_SEGMENTS_VMAR], 1);
+        lp->special_handles[HND_SEGMENTS_VMAR] = segments_vmar;
+        lp->loader_message = true;
+    }
+
+    status = elf_load_finish(lp_vmar(lp), tmpl->vdso_elf, tmpl->vdso_vmo,
+                             NULL, &lp->vdso_base, NULL);
+    if (status != ZX_OK)
+        return lp_error(lp, status, "load_from_template: cannot load vdso");
+    zx_handle_t vdso;
+    if ((status = zx_handle_duplicate(tmpl->vdso_vmo, ZX_RIGHT_SAME_RIGHTS, &vdso)) != ZX_OK)
+        return lp_error(lp, status, "load_from_template: cannot duplicate vdso");
+    // Takes ownership of 'vdso'.
+    return launchpad_add_handle(lp, vdso, PA_HND(PA_VMO_VDSO, 0));
+}
@@ -24,6 +24,10 @@ __BEGIN_CDECLS
 #define LDMSG_OP_DEBUG_PRINT             6u
 #define LDMSG_OP_DEBUG_PUBLISH_DATA_SINK 7u
 #define LDMSG_OP_DEBUG_LOAD_CONFIG       8u
+#define LDMSG_OP_LOAD_OBJECTS            9u
+
+// The most objects a single LDMSG_OP_LOAD_OBJECTS request may name.
+#define LDMSG_LOAD_OBJECTS_MAX 16
 
 // The payload format used for all the requests other than LDMSG_OP_CLONE.
 typedef struct ldmsg_common ldmsg_common_t;
@@ -75,6 +79,19 @@ struct ldmsg_rsp {
     zx_handle_t object;
 };
 
+// The message format used for responses to LDMSG_OP_LOAD_OBJECTS.
+//
+// The request's string holds |count| object names, each followed by a zero
+// byte. |rvs[i]| is the result of loading the i-th of them, and the message
+// carries one handle for each of them that is ZX_OK, in the same order.
+typedef struct ldmsg_rsp_objects ldmsg_rsp_objects_t;
+struct ldmsg_rsp_objects {
+    fidl_message_header_t header;
+    zx_status_t rv;
+    uint32_t count;
+    zx_status_t rvs[LDMSG_LOAD_OBJECTS_MAX];
+};
+
 // Encode the message in |req|.
 //
 // The format of the message will be determined by the ordinal in the message's
@@ -110,7 +127,8 @@ zx_status_t ldmsg_req_decode(ldmsg_req_t* req, size_t req_len,
 // The appropriate size message to send for the given |rsp|.
 //
 // The size of the message depends on the the ordinal in the message's
-// header. If the ordinal is invalid, this function will return 0.
+// header. If the ordinal is invalid, this function will return 0. For
+// LDMSG_OP_LOAD_OBJECTS, |rsp| must point to a ldmsg_rsp_objects_t.
 size_t ldmsg_rsp_get_size(ldmsg_rsp_t* rsp);
 
 __END_CDECLS
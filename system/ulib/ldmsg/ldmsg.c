@@ -26,6 +26,7 @@ zx_status_t ldmsg_req_encode(ldmsg_req_t* req, size_t* req_len_out,
         req->clone.object = FIDL_HANDLE_PRESENT;
         return ZX_OK;
     case LDMSG_OP_LOAD_OBJECT:
+    case LDMSG_OP_LOAD_OBJECTS:
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
     case LDMSG_OP_CONFIG:
     case LDMSG_OP_DEBUG_PRINT:
@@ -70,6 +71,7 @@ zx_status_t ldmsg_req_decode(ldmsg_req_t* req, size_t req_len,
         *len_out = 0;
         return ZX_OK;
     case LDMSG_OP_LOAD_OBJECT:
+    case LDMSG_OP_LOAD_OBJECTS:
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
     case LDMSG_OP_CONFIG:
     case LDMSG_OP_DEBUG_PRINT:
@@ -109,6 +111,8 @@ size_t ldmsg_rsp_get_size(ldmsg_rsp_t* rsp) {
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
     case LDMSG_OP_DEBUG_LOAD_CONFIG:
         return sizeof(ldmsg_rsp_t);
+    case LDMSG_OP_LOAD_OBJECTS:
+        return sizeof(ldmsg_rsp_objects_t);
     case LDMSG_OP_CONFIG:
     case LDMSG_OP_CLONE:
     case LDMSG_OP_DEBUG_PRINT:
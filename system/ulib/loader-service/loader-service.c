@@ -17,15 +17,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <threads.h>
 #include <unistd.h>
 #include <zircon/compiler.h>
 #include <zircon/device/vfs.h>
+#include <zircon/listnode.h>
 #include <zircon/status.h>
 #include <zircon/syscalls.h>
 #include <zircon/types.h>
 
 #define PREFIX_MAX 32
 
+// The most objects kept in a service's cache.
+#define CACHE_MAX 64
+
 struct loader_service {
     atomic_int refcount;
     async_t* async;
@@ -36,8 +41,31 @@ struct loader_service {
 
     char config_prefix[PREFIX_MAX];
     bool config_exclusive;
+
+    // Objects loaded by fs_ops and fd_ops, most recently used first.
+    mtx_t cache_lock;
+    list_node_t cache;
+    size_t cache_count;
+};
+
+// An object loaded from |path|, which is only handed out again while the
+// file there is still the same one. Blobs never change in place, so for
+// blobfs this amounts to keying on the Merkle root in the name.
+typedef struct cache_entry cache_entry_t;
+struct cache_entry {
+    list_node_t node;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    zx_handle_t vmo;
+    char path[];
 };
 
+static void cache_entry_free(cache_entry_t* entry) {
+    zx_handle_close(entry->vmo);
+    free(entry);
+}
+
 static void loader_service_addref(loader_service_t* svc) {
     atomic_fetch_add(&svc->refcount, 1);
 }
@@ -46,10 +74,73 @@ static void loader_service_deref(loader_service_t* svc) {
     if (atomic_fetch_sub(&svc->refcount, 1) == 1) {
         if (svc->ops->finalizer)
             svc->ops->finalizer(svc->ctx);
+        cache_entry_t* entry;
+        while ((entry = list_remove_head_type(&svc->cache, cache_entry_t, node)) != NULL)
+            cache_entry_free(entry);
         free(svc);
     }
 }
 
+// On a hit, |*out| is a new handle to the cached object. A stale entry
+// is dropped.
+static bool cache_lookup(loader_service_t* svc, const char* path,
+                         const struct stat* st, zx_handle_t* out) {
+    bool hit = false;
+    mtx_lock(&svc->cache_lock);
+    cache_entry_t* entry;
+    list_for_every_entry (&svc->cache, entry, cache_entry_t, node) {
+        if (strcmp(entry->path, path) != 0)
+            continue;
+        list_delete(&entry->node);
+        if (entry->ino == st->st_ino && entry->size == st->st_size &&
+            entry->mtime.tv_sec == st->st_mtim.tv_sec &&
+            entry->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+            zx_handle_duplicate(entry->vmo, ZX_RIGHT_SAME_RIGHTS, out) == ZX_OK) {
+            list_add_head(&svc->cache, &entry->node);
+            hit = true;
+        } else {
+            svc->cache_count--;
+            cache_entry_free(entry);
+        }
+        break;
+    }
+    mtx_unlock(&svc->cache_lock);
+    return hit;
+}
+
+// Every client is handed the same object, so none of them may write to it
+// or rename it. Copy-on-write clones of it are still writable. Failing to
+// cache |*vmo| leaves it as it was.
+static void cache_insert(loader_service_t* svc, const char* path,
+                         const struct stat* st, zx_handle_t* vmo) {
+    zx_info_handle_basic_t info;
+    if (zx_object_get_info(*vmo, ZX_INFO_HANDLE_BASIC, &info, sizeof(info),
+                           NULL, NULL) != ZX_OK)
+        return;
+    size_t len = strlen(path) + 1;
+    cache_entry_t* entry = malloc(sizeof(*entry) + len);
+    if (entry == NULL)
+        return;
+    zx_rights_t rights = info.rights & ~(ZX_RIGHT_WRITE | ZX_RIGHT_SET_PROPERTY);
+    if (zx_handle_replace(*vmo, rights, vmo) != ZX_OK ||
+        zx_handle_duplicate(*vmo, ZX_RIGHT_SAME_RIGHTS, &entry->vmo) != ZX_OK) {
+        free(entry);
+        return;
+    }
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime = st->st_mtim;
+    memcpy(entry->path, path, len);
+
+    mtx_lock(&svc->cache_lock);
+    list_add_head(&svc->cache, &entry->node);
+    if (++svc->cache_count > CACHE_MAX) {
+        cache_entry_free(list_remove_tail_type(&svc->cache, cache_entry_t, node));
+        svc->cache_count--;
+    }
+    mtx_unlock(&svc->cache_lock);
+}
+
 static const char* const libpaths[] = {
     "/system/lib",
     "/boot/lib",
@@ -120,36 +211,47 @@ zx_status_t loader_service_publish_data_sink_fs(const char* sink_name, zx_handle
 }
 
 // When loading a library object, search in the hard-coded locations.
-static int open_from_libpath(const char* fn) {
+// |path| is left holding the path opened.
+static int open_from_libpath(const char* fn, char path[PATH_MAX]) {
     int fd = -1;
     for (size_t n = 0; fd < 0 && n < countof(libpaths); ++n) {
-        char path[PATH_MAX];
-        snprintf(path, sizeof(path), "%s/%s", libpaths[n], fn);
+        snprintf(path, PATH_MAX, "%s/%s", libpaths[n], fn);
         fd = open(path, O_RDONLY);
     }
     return fd;
 }
 
-// Always consumes the fd.
-static zx_handle_t load_object_fd(int fd, const char* fn, zx_handle_t* out) {
+// Always consumes the fd, which was opened at |path|.
+static zx_handle_t load_object_fd(loader_service_t* svc, int fd, const char* path,
+                                  const char* fn, zx_handle_t* out) {
+    struct stat st;
+    bool cacheable = fstat(fd, &st) == 0;
+    if (cacheable && cache_lookup(svc, path, &st, out)) {
+        close(fd);
+        return ZX_OK;
+    }
     zx_status_t status = fdio_get_vmo(fd, out);
     close(fd);
-    if (status == ZX_OK)
+    if (status == ZX_OK) {
         zx_object_set_property(*out, ZX_PROP_NAME, fn, strlen(fn));
+        if (cacheable)
+            cache_insert(svc, path, &st, out);
+    }
     return status;
 }
 
 static zx_status_t fs_load_object(void* ctx, const char* name, zx_handle_t* out) {
-    int fd = open_from_libpath(name);
+    char path[PATH_MAX];
+    int fd = open_from_libpath(name, path);
     if (fd >= 0)
-        return load_object_fd(fd, name, out);
+        return load_object_fd(ctx, fd, path, name, out);
     return ZX_ERR_NOT_FOUND;
 }
 
 static zx_status_t fs_load_abspath(void* ctx, const char* path, zx_handle_t* out) {
     int fd = open(path, O_RDONLY);
     if (fd >= 0)
-        return load_object_fd(fd, path, out);
+        return load_object_fd(ctx, fd, path, path, out);
     return ZX_ERR_NOT_FOUND;
 }
 
@@ -166,21 +268,21 @@ static const loader_service_ops_t fs_ops = {
 };
 
 static zx_status_t fd_load_object(void* ctx, const char* name, zx_handle_t* out) {
-    int dirfd = *(int*)ctx;
+    loader_service_t* svc = ctx;
     char path[PATH_MAX];
     if (snprintf(path, sizeof(path), "lib/%s", name) >= PATH_MAX)
         return ZX_ERR_BAD_PATH;
-    int fd = openat(dirfd, path, O_RDONLY);
+    int fd = openat(svc->dirfd, path, O_RDONLY);
     if (fd >= 0)
-        return load_object_fd(fd, name, out);
+        return load_object_fd(svc, fd, path, name, out);
     return ZX_ERR_NOT_FOUND;
 }
 
 static zx_status_t fd_load_abspath(void* ctx, const char* path, zx_handle_t* out) {
-    int dirfd = *(int*)ctx;
-    int fd = openat(dirfd, path, O_RDONLY);
+    loader_service_t* svc = ctx;
+    int fd = openat(svc->dirfd, path, O_RDONLY);
     if (fd >= 0)
-        return load_object_fd(fd, path, out);
+        return load_object_fd(svc, fd, path, path, out);
     return ZX_ERR_NOT_FOUND;
 }
 
@@ -190,8 +292,8 @@ static zx_status_t fd_publish_data_sink(void* ctx, const char* name, zx_handle_t
 }
 
 static zx_status_t fd_finalizer(void* ctx) {
-    int dirfd = *(int*)ctx;
-    close(dirfd);
+    loader_service_t* svc = ctx;
+    close(svc->dirfd);
     return ZX_OK;
 }
 
@@ -202,6 +304,66 @@ static const loader_service_ops_t fd_ops = {
     .finalizer = fd_finalizer,
 };
 
+static zx_status_t load_object(loader_service_t* svc, const char* name, zx_handle_t* out) {
+    // If a prefix is configured, try loading with that prefix first
+    if (svc->config_prefix[0] != '\0') {
+        size_t maxlen = PREFIX_MAX + strlen(name) + 1;
+        char prefixed_name[maxlen];
+        snprintf(prefixed_name, maxlen, "%s%s", svc->config_prefix, name);
+        zx_status_t status = svc->ops->load_object(svc->ctx, prefixed_name, out);
+        if (status == ZX_OK || svc->config_exclusive) {
+            // if loading with prefix succeeds, or loading
+            // with prefix is configured to be exclusive of
+            // non-prefix loading, stop here
+            return status;
+        }
+        // otherwise, if non-exclusive, try loading without the prefix
+    }
+    return svc->ops->load_object(svc->ctx, name, out);
+}
+
+// |names| holds |len| bytes of names, each followed by a zero byte.
+static zx_status_t load_objects_rpc(zx_handle_t h, loader_service_t* svc, uint32_t txid,
+                                    const char* names, size_t len) {
+    ldmsg_rsp_objects_t rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.header.txid = txid;
+    rsp.header.ordinal = LDMSG_OP_LOAD_OBJECTS;
+    zx_handle_t handles[LDMSG_LOAD_OBJECTS_MAX];
+    uint32_t hcount = 0;
+
+    rsp.rv = ZX_OK;
+    if (len == 0 || names[len - 1] != '\0')
+        rsp.rv = ZX_ERR_INVALID_ARGS;
+    for (const char* name = names; rsp.rv == ZX_OK && name < names + len;
+         name += strlen(name) + 1) {
+        if (rsp.count == LDMSG_LOAD_OBJECTS_MAX) {
+            rsp.rv = ZX_ERR_INVALID_ARGS;
+            break;
+        }
+        zx_status_t status = load_object(svc, name, &handles[hcount]);
+        if (status == ZX_OK) {
+            hcount++;
+        } else if (status == ZX_ERR_NOT_FOUND) {
+            fprintf(stderr, "dlsvc: could not open '%s'\n", name);
+        }
+        rsp.rvs[rsp.count++] = status;
+    }
+    if (rsp.rv != ZX_OK) {
+        for (uint32_t i = 0; i < hcount; i++)
+            zx_handle_close(handles[i]);
+        hcount = 0;
+        rsp.count = 0;
+    }
+
+    zx_status_t status = zx_channel_write(h, 0, &rsp, sizeof(rsp), handles, hcount);
+    if (status != ZX_OK) {
+        fprintf(stderr, "dlsvc: msg write error: %d: %s\n", status, zx_status_get_string(status));
+        return status;
+    }
+    return ZX_OK;
+}
+
 static zx_status_t loader_service_rpc(zx_handle_t h, loader_service_t* svc) {
     ldmsg_req_t req;
     uint32_t req_len = sizeof(req);
@@ -247,22 +409,11 @@ static zx_status_t loader_service_rpc(zx_handle_t h, loader_service_t* svc) {
         break;
     }
     case LDMSG_OP_LOAD_OBJECT:
-        // If a prefix is configured, try loading with that prefix first
-        if (svc->config_prefix[0] != '\0') {
-            size_t maxlen = PREFIX_MAX + strlen(data) + 1;
-            char prefixed_name[maxlen];
-            snprintf(prefixed_name, maxlen, "%s%s", svc->config_prefix, data);
-            if (((status = svc->ops->load_object(svc->ctx, prefixed_name, &rsp_handle)) == ZX_OK) ||
-                svc->config_exclusive) {
-                // if loading with prefix succeeds, or loading
-                // with prefix is configured to be exclusive of
-                // non-prefix loading, stop here
-                break;
-            }
-            // otherwise, if non-exclusive, try loading without the prefix
-        }
-        status = svc->ops->load_object(svc->ctx, data, &rsp_handle);
+        status = load_object(svc, data, &rsp_handle);
         break;
+    case LDMSG_OP_LOAD_OBJECTS:
+        zx_handle_close(req_handle);
+        return load_objects_rpc(h, svc, req.header.txid, data, len);
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
     case LDMSG_OP_DEBUG_LOAD_CONFIG:
         // When loading a script interpreter or debug configuration file,
@@ -352,6 +503,8 @@ zx_status_t loader_service_create(async_t* async,
     svc->async = async;
     svc->ops = ops;
     svc->ctx = ctx;
+    mtx_init(&svc->cache_lock, mtx_plain);
+    list_initialize(&svc->cache);
 
     // When we create the loader service, we initialize the refcount to 1, which
     // causes the loader service to stay alive at least until someone calls
@@ -373,7 +526,13 @@ zx_status_t loader_service_release(loader_service_t* svc) {
 
 zx_status_t loader_service_create_fs(async_t* async,
                                      loader_service_t** out) {
-    return loader_service_create(async, &fs_ops, NULL, out);
+    loader_service_t* svc;
+    zx_status_t status = loader_service_create(async, &fs_ops, NULL, &svc);
+    if (status != ZX_OK)
+        return status;
+    svc->ctx = svc;
+    *out = svc;
+    return ZX_OK;
 }
 
 zx_status_t loader_service_create_fd(async_t* async,
@@ -381,10 +540,12 @@ zx_status_t loader_service_create_fd(async_t* async,
                                      loader_service_t** out) {
     loader_service_t* svc;
     zx_status_t status = loader_service_create(async, &fd_ops, NULL, &svc);
+    if (status != ZX_OK)
+        return status;
     svc->dirfd = dirfd;
-    svc->ctx = &svc->dirfd;
+    svc->ctx = svc;
     *out = svc;
-    return status;
+    return ZX_OK;
 }
 
 typedef struct loader_service_wait loader_service_wait_t;
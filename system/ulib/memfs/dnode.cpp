@@ -43,6 +43,7 @@ void Dnode::RemoveFromParent() {
 
     // Detach from parent
     if (parent_) {
+        parent_->child_index_.erase(*this);
         parent_->children_.erase(*this);
         if (IsDirectory()) {
             // '..' no longer references parent.
@@ -85,20 +86,19 @@ void Dnode::AddChild(fbl::RefPtr<Dnode> parent, fbl::RefPtr<Dnode> child) {
     } else {
         child->ordering_token_ = parent->children_.back().ordering_token_ + 1;
     }
+    parent->child_index_.insert(child.get());
     parent->children_.push_back(fbl::move(child));
     parent->vnode_->UpdateModified();
 }
 
 zx_status_t Dnode::Lookup(fbl::StringPiece name, fbl::RefPtr<Dnode>* out) const {
-    auto dn = children_.find_if([&name](const Dnode& elem) -> bool {
-        return elem.NameMatch(name);
-    });
-    if (dn == children_.end()) {
+    auto dn = child_index_.find(name);
+    if (!dn.IsValid()) {
         return ZX_ERR_NOT_FOUND;
     }
 
     if (out != nullptr) {
-        *out = dn.CopyPointer();
+        *out = fbl::RefPtr<Dnode>(dn.CopyPointer());
     }
     return ZX_OK;
 }
@@ -155,8 +155,7 @@ void Dnode::Readdir(fs::DirentFiller* df, void* cookie) const {
             continue;
         }
         uint32_t vtype = dn.IsDirectory() ? V_TYPE_DIR : V_TYPE_FILE;
-        if ((r = df->Next(fbl::StringPiece(dn.name_.get(), dn.NameLen()),
-                          VTYPE_TO_DTYPE(vtype))) != ZX_OK) {
+        if ((r = df->Next(dn.Name(), VTYPE_TO_DTYPE(vtype))) != ZX_OK) {
             return;
         }
         c->order = dn.ordering_token_ + 1;
@@ -192,12 +191,14 @@ Dnode::Dnode(fbl::RefPtr<VnodeMemfs> vn, fbl::unique_ptr<char[]> name, uint32_t
     vnode_(fbl::move(vn)), parent_(nullptr), ordering_token_(0), flags_(flags), name_(fbl::move(name)) {
 };
 
-size_t Dnode::NameLen() const {
-    return flags_ & kDnodeNameMax;
+Dnode::~Dnode() {
+    // The index holds raw pointers, so must let go of any children still
+    // held by the list before they are released along with it.
+    child_index_.clear();
 }
 
-bool Dnode::NameMatch(fbl::StringPiece name) const {
-    return name == fbl::StringPiece(name_.get(), NameLen());
+size_t Dnode::NameLen() const {
+    return flags_ & kDnodeNameMax;
 }
 
 } // namespace memfs
@@ -11,8 +11,10 @@
 #include <fs/vnode.h>
 #include <fdio/vfs.h>
 #include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
+#include <fbl/string_piece.h>
 #include <fbl/unique_ptr.h>
 
 namespace memfs {
@@ -40,8 +42,21 @@ public:
     // vnode appear in multiple locations within "/dev".
     struct TypeDeviceTraits { static NodeState& node_state(Dnode& dn) { return dn.type_device_state_; }};
 
+    // NameTraits is the state used for a Dnode to be found by name among
+    // the children of another dnode.
+    using NameNodeState = fbl::WAVLTreeNodeState<Dnode*>;
+    struct TypeNameTraits { static NameNodeState& node_state(Dnode& dn) { return dn.type_name_state_; }};
+    struct NameKeyTraits {
+        static fbl::StringPiece GetKey(const Dnode& dn) { return dn.Name(); }
+        static bool LessThan(const fbl::StringPiece& a, const fbl::StringPiece& b) { return a < b; }
+        static bool EqualTo(const fbl::StringPiece& a, const fbl::StringPiece& b) { return a == b; }
+    };
+
     using ChildList = fbl::DoublyLinkedList<fbl::RefPtr<Dnode>, Dnode::TypeChildTraits>;
     using DeviceList = fbl::DoublyLinkedList<fbl::RefPtr<Dnode>, Dnode::TypeDeviceTraits>;
+    using ChildIndex = fbl::WAVLTree<fbl::StringPiece, Dnode*, NameKeyTraits, TypeNameTraits>;
+
+    ~Dnode();
 
     // Allocates a dnode, attached to a vnode
     static fbl::RefPtr<Dnode> Create(fbl::StringPiece name, fbl::RefPtr<VnodeMemfs> vn);
@@ -97,19 +112,25 @@ public:
 private:
     friend struct TypeChildTraits;
     friend struct TypeDeviceTraits;
+    friend struct TypeNameTraits;
+    friend struct NameKeyTraits;
 
     Dnode(fbl::RefPtr<VnodeMemfs> vn, fbl::unique_ptr<char[]> name, uint32_t flags);
 
     size_t NameLen() const;
-    bool NameMatch(fbl::StringPiece name) const;
+    fbl::StringPiece Name() const { return fbl::StringPiece(name_.get(), NameLen()); }
 
     NodeState type_child_state_;
     NodeState type_device_state_;
+    NameNodeState type_name_state_;
     fbl::RefPtr<VnodeMemfs> vnode_;
     fbl::RefPtr<Dnode> parent_;
     // Used to impose an absolute order on dnodes within a directory.
     size_t ordering_token_;
+    // Children in the order they were added, for readdir, and by name, for
+    // lookup. A dnode only changes its name while it has no parent.
     ChildList children_;
+    ChildIndex child_index_;
     uint32_t flags_;
     fbl::unique_ptr<char[]> name_;
 };
@@ -23,14 +23,28 @@
 
 namespace memfs {
 
-// Artificially cap the maximum in-memory file size to 512MB.
-constexpr size_t kMemfsMaxFileSize = 512 * 1024 * 1024;
+namespace {
+
+// Whether the page at |data| is all zeros.
+bool IsZeroPage(const uint8_t* data) {
+    return data[0] == 0 && memcmp(data, data + 1, PAGE_SIZE - 1) == 0;
+}
+
+} // namespace
 
 VnodeFile::VnodeFile(Vfs* vfs)
-    : VnodeMemfs(vfs), vmo_(ZX_HANDLE_INVALID), length_(0) {}
+    : VnodeMemfs(vfs), vmo_(ZX_HANDLE_INVALID), length_(0), vmo_size_(0),
+      mapped_writable_(false) {}
 
+// A VMO handed to us may be mapped by whoever made it, so nothing is assumed
+// about what lies past the end of the file.
 VnodeFile::VnodeFile(Vfs* vfs, zx_handle_t vmo, zx_off_t length)
-    : VnodeMemfs(vfs), vmo_(vmo), length_(length) {}
+    : VnodeMemfs(vfs), vmo_(vmo), length_(length), vmo_size_(0), mapped_writable_(true) {
+    uint64_t size;
+    if (zx_vmo_get_size(vmo_, &size) == ZX_OK) {
+        vmo_size_ = size;
+    }
+}
 
 VnodeFile::~VnodeFile() {
     if (vmo_ != ZX_HANDLE_INVALID) {
@@ -45,6 +59,35 @@ zx_status_t VnodeFile::ValidateFlags(uint32_t flags) {
     return ZX_OK;
 }
 
+zx_status_t VnodeFile::GetHandles(uint32_t flags, zx_handle_t* hnd, uint32_t* type,
+                                  zxrio_object_info_t* extra) {
+    // Connections that only read are handed a clone of the VMO to read and map
+    // directly, rather than making a round trip to us for every read. The clone
+    // sees later writes to the file, but not the file growing past its length
+    // at open.
+    if (!fs::IsReadable(flags) || fs::IsWritable(flags) || vmo_ == ZX_HANDLE_INVALID ||
+        length_ == 0) {
+        return Vnode::GetHandles(flags, hnd, type, extra);
+    }
+
+    zx_handle_t clone;
+    zx_status_t status = zx_vmo_clone(vmo_, ZX_VMO_CLONE_COPY_ON_WRITE, 0, length_, &clone);
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = zx_handle_replace(clone,
+                               ZX_RIGHT_READ | ZX_RIGHT_EXECUTE | ZX_RIGHT_MAP |
+                               ZX_RIGHTS_BASIC | ZX_RIGHT_GET_PROPERTY,
+                               hnd);
+    if (status != ZX_OK) {
+        return status;
+    }
+    *type = FDIO_PROTOCOL_VMOFILE;
+    extra->vmofile.offset = 0;
+    extra->vmofile.length = length_;
+    return ZX_OK;
+}
+
 zx_status_t VnodeFile::Read(void* data, size_t len, size_t off, size_t* out_actual) {
     if ((off >= length_) || (vmo_ == ZX_HANDLE_INVALID)) {
         *out_actual = 0;
@@ -56,36 +99,109 @@ zx_status_t VnodeFile::Read(void* data, size_t len, size_t off, size_t* out_actu
     return zx_vmo_read(vmo_, data, off, len, out_actual);
 }
 
-zx_status_t VnodeFile::Write(const void* data, size_t len, size_t offset,
-                             size_t* out_actual) {
+zx_status_t VnodeFile::Reserve(size_t len) {
     zx_status_t status;
-    size_t newlen = offset + len;
-    newlen = newlen > kMemfsMaxFileSize ? kMemfsMaxFileSize : newlen;
-    size_t alignedLen = fbl::round_up(newlen, static_cast<size_t>(PAGE_SIZE));
+    const size_t aligned_len = fbl::round_up(len, static_cast<size_t>(PAGE_SIZE));
 
     if (vmo_ == ZX_HANDLE_INVALID) {
         // First access to the file? Allocate it.
-        if ((status = zx_vmo_create(alignedLen, 0, &vmo_)) != ZX_OK) {
+        if ((status = zx_vmo_create(aligned_len, 0, &vmo_)) != ZX_OK) {
             return status;
         }
-    } else if (newlen > fbl::round_up(length_, static_cast<size_t>(PAGE_SIZE))) {
-        // Accessing beyond the end of the file? Extend it.
-        if ((status = zx_vmo_set_size(vmo_, alignedLen)) != ZX_OK) {
+        vmo_size_ = aligned_len;
+        return ZX_OK;
+    }
+
+    if (aligned_len > vmo_size_) {
+        // Grow the VMO at least twofold, up to the size limit, so that a file
+        // written a little at a time is not resized on every write. Pages past
+        // the end of the file are not committed until they are written.
+        const size_t limit = fbl::round_up(vfs()->max_file_size(), static_cast<size_t>(PAGE_SIZE));
+        const size_t size = fbl::max(aligned_len, fbl::min(vmo_size_ * 2, limit));
+        if ((status = zx_vmo_set_size(vmo_, size)) != ZX_OK) {
+            return status;
+        }
+        vmo_size_ = size;
+    }
+
+    if (mapped_writable_ && len > length_) {
+        // Writes through a mapping may have left data past the end of the file;
+        // make the pages being brought into the file read as zeros again.
+        const size_t start = fbl::round_up(length_, static_cast<size_t>(PAGE_SIZE));
+        if (aligned_len > start) {
+            status = zx_vmo_op_range(vmo_, ZX_VMO_OP_DECOMMIT, start, aligned_len - start,
+                                     nullptr, 0);
+            if (status != ZX_OK) {
+                return status;
+            }
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeFile::WriteSparse(const void* data, size_t len, size_t offset,
+                                   size_t* out_actual) {
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    // |run| is where the bytes not yet written start.
+    size_t run = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        const size_t next = fbl::min(len, fbl::round_up(offset + pos + 1,
+                                                        static_cast<size_t>(PAGE_SIZE)) - offset);
+        if (next - pos == PAGE_SIZE && IsZeroPage(src + pos)) {
+            if (pos > run) {
+                size_t actual;
+                zx_status_t status = zx_vmo_write(vmo_, src + run, offset + run, pos - run,
+                                                  &actual);
+                if (status != ZX_OK) {
+                    return status;
+                }
+            }
+            run = next;
+        }
+        pos = next;
+    }
+    if (len > run) {
+        size_t actual;
+        zx_status_t status = zx_vmo_write(vmo_, src + run, offset + run, len - run, &actual);
+        if (status != ZX_OK) {
             return status;
         }
     }
+    *out_actual = len;
+    return ZX_OK;
+}
+
+zx_status_t VnodeFile::Write(const void* data, size_t len, size_t offset,
+                             size_t* out_actual) {
+    zx_status_t status;
+    const size_t max_file_size = vfs()->max_file_size();
+    if (offset >= max_file_size) {
+        // short write because we're beyond the end of the permissible length
+        *out_actual = 0;
+        return len == 0 ? ZX_OK : ZX_ERR_FILE_BIG;
+    }
+    len = fbl::min(len, max_file_size - offset);
+    const size_t newlen = offset + len;
+
+    if ((status = Reserve(newlen)) != ZX_OK) {
+        return status;
+    }
 
-    if ((status = zx_vmo_write(vmo_, data, offset, len, out_actual)) != ZX_OK) {
+    // Past the last page of the file everything reads as zeros, so pages of
+    // zeros written there need not be committed.
+    if (offset >= fbl::round_up(length_, static_cast<size_t>(PAGE_SIZE))) {
+        status = WriteSparse(data, len, offset, out_actual);
+    } else {
+        status = zx_vmo_write(vmo_, data, offset, len, out_actual);
+    }
+    if (status != ZX_OK) {
         return status;
     }
 
     if (newlen > length_) {
         length_ = newlen;
     }
-    if (*out_actual == 0 && offset >= kMemfsMaxFileSize) {
-        // short write because we're beyond the end of the permissible length
-        return ZX_ERR_FILE_BIG;
-    }
     UpdateModified();
     return ZX_OK;
 }
@@ -104,6 +220,7 @@ zx_status_t VnodeFile::Mmap(int flags, size_t len, size_t* off, zx_handle_t* out
         if ((status = zx_vmo_create(0, 0, &vmo_)) != ZX_OK) {
             return status;
         }
+        vmo_size_ = 0;
     }
 
     zx_rights_t rights = ZX_RIGHT_TRANSFER | ZX_RIGHT_MAP;
@@ -114,6 +231,9 @@ zx_status_t VnodeFile::Mmap(int flags, size_t len, size_t* off, zx_handle_t* out
         return zx_vmo_clone(vmo_, ZX_VMO_CLONE_COPY_ON_WRITE, 0, length_, out);
     }
 
+    if (flags & FDIO_MMAP_FLAG_WRITE) {
+        mapped_writable_ = true;
+    }
     return zx_handle_duplicate(vmo_, rights, out);
 }
 
@@ -132,35 +252,37 @@ zx_status_t VnodeFile::Getattr(vnattr_t* attr) {
 
 zx_status_t VnodeFile::Truncate(size_t len) {
     zx_status_t status;
-    if (len > kMemfsMaxFileSize) {
+    if (len > vfs()->max_file_size()) {
         return ZX_ERR_INVALID_ARGS;
     }
 
-    size_t alignedLen = fbl::round_up(len, static_cast<size_t>(PAGE_SIZE));
-
-    if (vmo_ == ZX_HANDLE_INVALID) {
-        // First access to the file? Allocate it.
-        if ((status = zx_vmo_create(alignedLen, 0, &vmo_)) != ZX_OK) {
+    if (len >= length_) {
+        if ((status = Reserve(len)) != ZX_OK) {
             return status;
         }
-    } else if ((len < length_) && (len % PAGE_SIZE != 0)) {
-        // Currently, if the file is truncated to a 'partial page', an later re-expanded, then the
-        // partial page is *not necessarily* filled with zeroes. As a consequence, we manually must
-        // fill the portion between "len" and the next highest page (or vn->length, whichever
-        // is smaller) with zeroes.
-        char buf[PAGE_SIZE];
-        size_t ppage_size = PAGE_SIZE - (len % PAGE_SIZE);
-        ppage_size = len + ppage_size < length_ ? ppage_size : length_ - len;
-        memset(buf, 0, ppage_size);
-        size_t actual;
-        status = zx_vmo_write(vmo_, buf, len, ppage_size, &actual);
-        if ((status != ZX_OK) || (actual != ppage_size)) {
-            return status != ZX_OK ? ZX_ERR_IO : status;
-        } else if ((status = zx_vmo_set_size(vmo_, alignedLen)) != ZX_OK) {
+    } else {
+        size_t alignedLen = fbl::round_up(len, static_cast<size_t>(PAGE_SIZE));
+
+        if (len % PAGE_SIZE != 0) {
+            // Currently, if the file is truncated to a 'partial page', an later re-expanded, then
+            // the partial page is *not necessarily* filled with zeroes. As a consequence, we
+            // manually must fill the portion between "len" and the next highest page (or
+            // vn->length, whichever is smaller) with zeroes.
+            char buf[PAGE_SIZE];
+            size_t ppage_size = PAGE_SIZE - (len % PAGE_SIZE);
+            ppage_size = len + ppage_size < length_ ? ppage_size : length_ - len;
+            memset(buf, 0, ppage_size);
+            size_t actual;
+            status = zx_vmo_write(vmo_, buf, len, ppage_size, &actual);
+            if ((status != ZX_OK) || (actual != ppage_size)) {
+                return status != ZX_OK ? ZX_ERR_IO : status;
+            }
+        }
+        // Shrinking gives back the pages past the new end of the file.
+        if ((status = zx_vmo_set_size(vmo_, alignedLen)) != ZX_OK) {
             return status;
         }
-    } else if ((status = zx_vmo_set_size(vmo_, alignedLen)) != ZX_OK) {
-        return status;
+        vmo_size_ = alignedLen;
     }
 
     length_ = len;
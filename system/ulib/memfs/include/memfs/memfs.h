@@ -29,4 +29,9 @@ zx_status_t memfs_create_filesystem(async_t* async, memfs_filesystem_t** fs_out,
 // TODO(smklein): Remove this requirement.
 zx_status_t memfs_free_filesystem(memfs_filesystem_t* fs, zx_duration_t timeout);
 
+// Limits the size of the files of a MemFS filesystem to |max_file_size|
+// bytes. Writes and truncations past it fail. Files already larger are
+// left as they are.
+void memfs_set_max_file_size(memfs_filesystem_t* fs, size_t max_file_size);
+
 __END_CDECLS
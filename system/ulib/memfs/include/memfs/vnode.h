@@ -27,6 +27,9 @@ namespace memfs {
 
 constexpr uint64_t kMemfsBlksize = PAGE_SIZE;
 
+// The largest a file may grow to unless the filesystem is configured otherwise.
+constexpr size_t kMemfsDefaultMaxFileSize = 512 * 1024 * 1024;
+
 class Dnode;
 class Vfs;
 
@@ -80,9 +83,23 @@ private:
     zx_status_t Truncate(size_t len) final;
     zx_status_t Getattr(vnattr_t* a) final;
     zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) final;
+    zx_status_t GetHandles(uint32_t flags, zx_handle_t* hnd, uint32_t* type,
+                           zxrio_object_info_t* extra) final;
+
+    // Grows the VMO, if need be, so that the file can be extended to |len|.
+    zx_status_t Reserve(size_t len);
+
+    // Writes to a range of the file that reads as zeros, leaving out whole pages
+    // of zeros so that they are not committed.
+    zx_status_t WriteSparse(const void* data, size_t len, size_t offset, size_t* out_actual);
 
     zx_handle_t vmo_;
     zx_off_t length_;
+    // The size of vmo_, which runs ahead of length_ as the file grows.
+    size_t vmo_size_;
+    // Set once the VMO has been handed out to be mapped writable, after which
+    // the pages past the end of the file may no longer be zero.
+    bool mapped_writable_;
 };
 
 class VnodeDir final : public VnodeMemfs {
@@ -167,6 +184,16 @@ public:
                               zx_off_t len);
 
     void MountSubtree(VnodeDir* parent, fbl::RefPtr<VnodeDir> subtree);
+
+    // The largest a file may grow to. May be changed while the filesystem is
+    // being served.
+    size_t max_file_size() const { return max_file_size_.load(fbl::memory_order_relaxed); }
+    void set_max_file_size(size_t size) {
+        max_file_size_.store(size, fbl::memory_order_relaxed);
+    }
+
+private:
+    fbl::atomic<size_t> max_file_size_{kMemfsDefaultMaxFileSize};
 };
 
 zx_status_t createFilesystem(const char* name, memfs::Vfs* vfs, fbl::RefPtr<VnodeDir>* out);
@@ -29,12 +29,12 @@ namespace memfs {
 zx_status_t Vfs::CreateFromVmo(VnodeDir* parent, bool vmofile, fbl::StringPiece name,
                              zx_handle_t vmo, zx_off_t off,
                              zx_off_t len) {
-    fbl::AutoLock lock(&vfs_lock_);
+    PathLock lock(this, true);
     return parent->CreateFromVmo(vmofile, name, vmo, off, len);
 }
 
 void Vfs::MountSubtree(VnodeDir* parent, fbl::RefPtr<VnodeDir> subtree) {
-    fbl::AutoLock lock(&vfs_lock_);
+    PathLock lock(this, true);
     parent->MountSubtree(fbl::move(subtree));
 }
 
@@ -153,3 +153,8 @@ zx_status_t memfs_free_filesystem(memfs_filesystem_t* fs, zx_duration_t timeout)
     delete fs;
     return status;
 }
+
+void memfs_set_max_file_size(memfs_filesystem_t* fs, size_t max_file_size) {
+    ZX_DEBUG_ASSERT(fs != nullptr);
+    fs->vfs.set_max_file_size(max_file_size);
+}
@@ -9,6 +9,7 @@
 #include <unistd.h>
 
 #include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
 #include <fs/trace.h>
@@ -19,41 +20,199 @@
 
 namespace minfs {
 
-zx_status_t Bcache::Readblk(blk_t bno, void* data) {
+zx_status_t Bcache::ReadRaw(blk_t bno, void* data) {
     off_t off = static_cast<off_t>(bno) * kMinfsBlockSize;
     assert(off / kMinfsBlockSize == bno); // Overflow
 #ifndef __Fuchsia__
     off += offset_;
 #endif
-    if (lseek(fd_.get(), off, SEEK_SET) < 0) {
-        FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
-        return ZX_ERR_IO;
-    }
-    if (read(fd_.get(), data, kMinfsBlockSize) != kMinfsBlockSize) {
+    // Positioned, so that ReadblkUncached() may read outside the cache lock
+    if (pread(fd_.get(), data, kMinfsBlockSize, off) != kMinfsBlockSize) {
         FS_TRACE_ERROR("minfs: cannot read block %u\n", bno);
         return ZX_ERR_IO;
     }
     return ZX_OK;
 }
 
-zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
+zx_status_t Bcache::WriteRaw(blk_t bno, const void* data) {
     off_t off = static_cast<off_t>(bno) * kMinfsBlockSize;
     assert(off / kMinfsBlockSize == bno); // Overflow
 #ifndef __Fuchsia__
     off += offset_;
 #endif
-    if (lseek(fd_.get(), off, SEEK_SET) < 0) {
-        FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
-        return ZX_ERR_IO;
-    }
-    if (write(fd_.get(), data, kMinfsBlockSize) != kMinfsBlockSize) {
+    if (pwrite(fd_.get(), data, kMinfsBlockSize, off) != kMinfsBlockSize) {
         FS_TRACE_ERROR("minfs: cannot write block %u\n", bno);
         return ZX_ERR_IO;
     }
     return ZX_OK;
 }
 
+zx_status_t Bcache::GetEntryLocked(CacheEntry** out) {
+    if (!free_.is_empty()) {
+        *out = free_.pop_front();
+        return ZX_OK;
+    }
+
+    CacheEntry* entry = &lru_.back();
+    if (entry->dirty) {
+        zx_status_t status = WriteRaw(entry->bno, entry->data);
+        if (status != ZX_OK) {
+            return status;
+        }
+        entry->dirty = false;
+        cache_dirty_--;
+        cache_stats_.writebacks++;
+    }
+    lru_.erase(*entry);
+    cache_.erase(*entry);
+    cache_stats_.evictions++;
+    *out = entry;
+    return ZX_OK;
+}
+
+zx_status_t Bcache::Readblk(blk_t bno, void* data) {
+    fbl::AutoLock lock(&cache_lock_);
+    auto iter = cache_.find(bno);
+    if (iter.IsValid()) {
+        cache_stats_.hits++;
+        lru_.erase(*iter);
+        lru_.push_front(&*iter);
+        memcpy(data, iter->data, kMinfsBlockSize);
+        return ZX_OK;
+    }
+
+    cache_stats_.misses++;
+    CacheEntry* entry;
+    zx_status_t status;
+    if ((status = GetEntryLocked(&entry)) != ZX_OK) {
+        return status;
+    }
+    if ((status = ReadRaw(bno, entry->data)) != ZX_OK) {
+        free_.push_front(entry);
+        return status;
+    }
+    entry->bno = bno;
+    cache_.insert(entry);
+    lru_.push_front(entry);
+    memcpy(data, entry->data, kMinfsBlockSize);
+    return ZX_OK;
+}
+
+zx_status_t Bcache::ReadblkUncached(blk_t bno, void* data) {
+    {
+        fbl::AutoLock lock(&cache_lock_);
+        auto iter = cache_.find(bno);
+        if (iter.IsValid()) {
+            cache_stats_.hits++;
+            memcpy(data, iter->data, kMinfsBlockSize);
+            return ZX_OK;
+        }
+    }
+    return ReadRaw(bno, data);
+}
+
+zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
+    fbl::AutoLock lock(&cache_lock_);
+    CacheEntry* entry;
+    auto iter = cache_.find(bno);
+    if (iter.IsValid()) {
+        entry = &*iter;
+        lru_.erase(*entry);
+    } else {
+        zx_status_t status = GetEntryLocked(&entry);
+        if (status != ZX_OK) {
+            return status;
+        }
+        entry->bno = bno;
+        cache_.insert(entry);
+    }
+    lru_.push_front(entry);
+    memcpy(entry->data, data, kMinfsBlockSize);
+    if (!entry->dirty) {
+        entry->dirty = true;
+        cache_dirty_++;
+    }
+    return ZX_OK;
+}
+
+zx_status_t Bcache::FlushLocked() {
+    if (cache_dirty_ == 0) {
+        return ZX_OK;
+    }
+
+    // Write the dirty blocks back in device order.
+    CacheEntry* dirty[kCacheBlocks];
+    size_t count = 0;
+    for (auto& entry : lru_) {
+        if (entry.dirty) {
+            size_t i = count++;
+            while (i > 0 && dirty[i - 1]->bno > entry.bno) {
+                dirty[i] = dirty[i - 1];
+                i--;
+            }
+            dirty[i] = &entry;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        zx_status_t status = WriteRaw(dirty[i]->bno, dirty[i]->data);
+        if (status != ZX_OK) {
+            return status;
+        }
+        dirty[i]->dirty = false;
+        cache_dirty_--;
+        cache_stats_.writebacks++;
+    }
+    return ZX_OK;
+}
+
+zx_status_t Bcache::FlushCache() {
+    fbl::AutoLock lock(&cache_lock_);
+    return FlushLocked();
+}
+
+void Bcache::DropLocked(CacheEntry* entry) {
+    lru_.erase(*entry);
+    if (entry->dirty) {
+        entry->dirty = false;
+        cache_dirty_--;
+    }
+    free_.push_front(entry);
+}
+
+void Bcache::InvalidateLocked(blk_t bno, blk_t count) {
+    // Walk whichever of the range and the cache is smaller.
+    if (count <= cache_.size()) {
+        for (blk_t i = 0; i < count; i++) {
+            CacheEntry* entry = cache_.erase(bno + i);
+            if (entry != nullptr) {
+                DropLocked(entry);
+            }
+        }
+        return;
+    }
+    for (auto iter = lru_.begin(); iter != lru_.end();) {
+        CacheEntry* entry = &*iter++;
+        if (entry->bno >= bno && entry->bno - bno < count) {
+            cache_.erase(*entry);
+            DropLocked(entry);
+        }
+    }
+}
+
+void Bcache::GetCacheStats(CacheStats* out) {
+    fbl::AutoLock lock(&cache_lock_);
+    *out = cache_stats_;
+}
+
 int Bcache::Sync() {
+    zx_status_t status;
+    {
+        fbl::AutoLock lock(&cache_lock_);
+        status = FlushLocked();
+    }
+    if (status != ZX_OK) {
+        return -1;
+    }
     return fsync(fd_.get());
 }
 
@@ -63,6 +222,23 @@ zx_status_t Bcache::Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
+    bc->cache_entries_.reset(new (&ac) CacheEntry[kCacheBlocks]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    bc->cache_data_.reset(new (&ac) uint8_t[kCacheBlocks * kMinfsBlockSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    {
+        fbl::AutoLock lock(&bc->cache_lock_);
+        for (size_t i = 0; i < kCacheBlocks; i++) {
+            CacheEntry* entry = &bc->cache_entries_[i];
+            entry->dirty = false;
+            entry->data = &bc->cache_data_[i * kMinfsBlockSize];
+            bc->free_.push_back(entry);
+        }
+    }
 #ifdef __Fuchsia__
     zx_status_t status;
     zx_handle_t fifo;
@@ -74,13 +250,12 @@ zx_status_t Bcache::Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint
         return ZX_ERR_IO;
     } else if ((r = ioctl_block_get_fifos(bc->fd_.get(), &fifo)) < 0) {
         return static_cast<zx_status_t>(r);
-    } else if (bc->TxnId() == TXNID_INVALID) {
-        zx_handle_close(fifo);
-        return ZX_ERR_NO_RESOURCES;
-    } else if ((status = block_fifo_create_client(fifo, &bc->fifo_client_)) != ZX_OK) {
-        bc->FreeTxnId();
+    } else if ((status = bc->io_loop_.StartThread("minfs-io")) != ZX_OK) {
         zx_handle_close(fifo);
         return status;
+    } else if ((status = block_client::Client::Create(bc->fd_.get(), fifo, bc->io_loop_.async(),
+                                                      &bc->block_client_)) != ZX_OK) {
+        return status;
     }
 #endif
 
@@ -89,6 +264,27 @@ zx_status_t Bcache::Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint
 }
 
 #ifdef __Fuchsia__
+zx_status_t Bcache::Txn(block_fifo_request_t* requests, size_t count) {
+    {
+        fbl::AutoLock lock(&cache_lock_);
+        zx_status_t status = FlushLocked();
+        if (status != ZX_OK) {
+            return status;
+        }
+        const uint32_t kDiskBlocksPerMinfsBlock = kMinfsBlockSize / info_.block_size;
+        for (size_t i = 0; i < count; i++) {
+            if ((requests[i].opcode & BLOCKIO_OP_MASK) != BLOCKIO_WRITE) {
+                continue;
+            }
+            uint64_t start = requests[i].dev_offset / kDiskBlocksPerMinfsBlock;
+            uint64_t end = (requests[i].dev_offset + requests[i].length +
+                            kDiskBlocksPerMinfsBlock - 1) / kDiskBlocksPerMinfsBlock;
+            InvalidateLocked(static_cast<blk_t>(start), static_cast<blk_t>(end - start));
+        }
+    }
+    return block_client_->Transaction(requests, count);
+}
+
 ssize_t Bcache::GetDevicePath(char* out, size_t out_len) {
     return ioctl_device_get_topo_path(fd_.get(), out, out_len);
 }
@@ -112,11 +308,20 @@ Bcache::Bcache(fbl::unique_fd fd, uint32_t blockmax) :
     fd_(fbl::move(fd)), blockmax_(blockmax) {}
 
 Bcache::~Bcache() {
+    {
+        fbl::AutoLock lock(&cache_lock_);
+        if (cache_entries_ != nullptr && FlushLocked() != ZX_OK) {
+            FS_TRACE_ERROR("minfs: lost dirty blocks writing back the block cache\n");
+        }
+        cache_.clear();
+        lru_.clear();
+        free_.clear();
+    }
 #ifdef __Fuchsia__
-    if (fifo_client_ != nullptr) {
-        FreeTxnId();
+    if (block_client_ != nullptr) {
+        io_loop_.Shutdown();
+        block_client_.reset();
         ioctl_block_fifo_close(fd_.get());
-        block_fifo_release_client(fifo_client_);
     }
 #endif
 }
@@ -5,12 +5,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <minfs/format.h>
 #include <minfs/fsck.h>
 #include "minfs-private.h"
 
+#ifdef __Fuchsia__
+#include <threads.h>
+#include <zircon/syscalls.h>
+#endif
+
 // #define DEBUG_PRINTF
 #ifdef DEBUG_PRINTF
 #define xprintf(args...) fprintf(stderr, args)
@@ -19,16 +28,67 @@
 #endif
 
 namespace minfs {
+namespace {
+
+uint64_t MonotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+#ifdef __Fuchsia__
+// Shares of fewer inodes than this are scanned on one thread, as starting a
+// thread would cost more than it saves.
+constexpr uint32_t kMinInodesPerThread = 256;
+constexpr uint32_t kMaxScanThreads = 8;
+#endif
+
+} // namespace
+
+// How a block is referenced by an inode, for reporting.
+enum class BlockRefKind : uint8_t {
+    kData,
+    kIndirect,
+    kDoublyIndirect,
+    kIndirectInDind,
+};
+
+// A block referenced by an inode. References are collected as inodes are
+// scanned, and checked against the block bitmap and against one another
+// once every scan is done.
+struct BlockRef {
+    blk_t bno;
+    ino_t ino;
+    uint32_t n; // File block, or index among the inode's indirect blocks
+    BlockRefKind kind;
+};
+
+// The state of a scan over some of the inodes, one per thread.
+struct InodeScan {
+    fbl::Vector<BlockRef> refs;
+    bool conforming = true;
+    zx_status_t status = ZX_OK;
+
+    blk_t cached_doubly_indirect = 0;
+    blk_t cached_indirect = 0;
+    uint8_t doubly_indirect_cache[kMinfsBlockSize];
+    uint8_t indirect_cache[kMinfsBlockSize];
+};
 
 class MinfsChecker {
 public:
     MinfsChecker();
     zx_status_t Init(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info);
+    // Scans the blocks of every inode marked in use, split across threads,
+    // then checks every block they reference.
+    zx_status_t ScanInodes();
     zx_status_t CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot);
     zx_status_t CheckForUnusedBlocks() const;
     zx_status_t CheckForUnusedInodes() const;
     zx_status_t CheckLinkCounts() const;
     zx_status_t CheckAllocatedCounts() const;
+    // Marks the blocks reserved for the journal as in use.
+    zx_status_t CheckJournal();
 
     // "Set once"-style flag to identify if anything nonconforming
     // was found in the underlying filesystem -- even if it was fixed.
@@ -37,6 +97,19 @@ public:
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(MinfsChecker);
 
+    struct ScanShare {
+        MinfsChecker* checker;
+        ino_t start;
+        ino_t end;
+        uint32_t scanned;
+        InodeScan scan;
+    };
+
+    static int ScanThread(void* arg);
+    void ScanInodeRange(ScanShare* share);
+
+    // Reads |ino| without checking it.
+    zx_status_t LoadInode(minfs_inode_t* inode, ino_t ino);
     zx_status_t GetInode(minfs_inode_t* inode, ino_t ino);
 
     // Returns the nth block within an inode, relative to the start of the
@@ -44,28 +117,35 @@ private:
     // is for performance reasons -- it allows fsck to avoid repeatedly checking
     // the same indirect / doubly indirect blocks with all internal
     // bno unallocated.
-    zx_status_t GetInodeNthBno(minfs_inode_t* inode, blk_t n, blk_t* next_n,
+    zx_status_t GetInodeNthBno(InodeScan* scan, minfs_inode_t* inode, blk_t n, blk_t* next_n,
                                blk_t* bno_out);
     zx_status_t CheckDirectory(minfs_inode_t* inode, ino_t ino,
                                ino_t parent, uint32_t flags);
     const char* CheckDataBlock(blk_t bno);
+    // Checks the blocks of an inode reached from the root, if ScanInodes()
+    // did not already.
     zx_status_t CheckFile(minfs_inode_t* inode, ino_t ino);
+    // Collects the blocks referenced by an inode into |scan|.
+    zx_status_t ScanFile(InodeScan* scan, minfs_inode_t* inode, ino_t ino);
+    // ScanFile for inodes mapped by extents.
+    zx_status_t ScanExtents(InodeScan* scan, minfs_inode_t* inode, ino_t ino);
+    static zx_status_t AddBlockRef(InodeScan* scan, blk_t bno, ino_t ino, uint32_t n,
+                                   BlockRefKind kind);
+    void CheckBlockRefs(const fbl::Vector<BlockRef>& refs);
 
     fbl::RefPtr<Minfs> fs_;
     RawBitmap checked_inodes_;
     RawBitmap checked_blocks_;
+    // Inodes whose blocks ScanInodes() checked; one byte each, so that
+    // threads scanning neighbouring inodes never share a word.
+    fbl::Array<uint8_t> scanned_;
 
     uint32_t alloc_inodes_;
     uint32_t alloc_blocks_;
     fbl::Array<int32_t> links_;
-
-    blk_t cached_doubly_indirect_;
-    blk_t cached_indirect_;
-    uint8_t doubly_indirect_cache_[kMinfsBlockSize];
-    uint8_t indirect_cache_[kMinfsBlockSize];
 };
 
-zx_status_t MinfsChecker::GetInode(minfs_inode_t* inode, ino_t ino) {
+zx_status_t MinfsChecker::LoadInode(minfs_inode_t* inode, ino_t ino) {
     if (ino >= fs_->info_.inode_count) {
         FS_TRACE_ERROR("check: ino %u out of range (>=%u)\n",
               ino, fs_->info_.inode_count);
@@ -87,6 +167,14 @@ zx_status_t MinfsChecker::GetInode(minfs_inode_t* inode, ino_t ino) {
     uintptr_t iaddr = reinterpret_cast<uintptr_t>(data + off_of_ino);
 #endif
     memcpy(inode, reinterpret_cast<void*>(iaddr), kMinfsInodeSize);
+    return ZX_OK;
+}
+
+zx_status_t MinfsChecker::GetInode(minfs_inode_t* inode, ino_t ino) {
+    zx_status_t status;
+    if ((status = LoadInode(inode, ino)) != ZX_OK) {
+        return status;
+    }
     if ((inode->magic != kMinfsMagicFile) && (inode->magic != kMinfsMagicDir)) {
         FS_TRACE_ERROR("check: ino %u has bad magic %#x\n", ino, inode->magic);
         return ZX_ERR_IO_DATA_INTEGRITY;
@@ -97,7 +185,7 @@ zx_status_t MinfsChecker::GetInode(minfs_inode_t* inode, ino_t ino) {
 #define CD_DUMP 1
 #define CD_RECURSE 2
 
-zx_status_t MinfsChecker::GetInodeNthBno(minfs_inode_t* inode, blk_t n,
+zx_status_t MinfsChecker::GetInodeNthBno(InodeScan* scan, minfs_inode_t* inode, blk_t n,
                                          blk_t* next_n, blk_t* bno_out) {
     // The default value for the "next n". It's easier to set it here anyway,
     // since we proceed to modify n in the code below.
@@ -119,15 +207,15 @@ zx_status_t MinfsChecker::GetInodeNthBno(minfs_inode_t* inode, blk_t n,
             return ZX_OK;
         }
 
-        if (cached_indirect_ != ibno) {
+        if (scan->cached_indirect != ibno) {
             zx_status_t status;
-            if ((status = fs_->ReadDat(ibno, indirect_cache_)) != ZX_OK) {
+            if ((status = fs_->ReadDatUncached(ibno, scan->indirect_cache)) != ZX_OK) {
                 return status;
             }
-            cached_indirect_ = ibno;
+            scan->cached_indirect = ibno;
         }
 
-        uint32_t* ientry = reinterpret_cast<uint32_t*>(indirect_cache_);
+        uint32_t* ientry = reinterpret_cast<uint32_t*>(scan->indirect_cache);
         *bno_out = ientry[j];
         return ZX_OK;
     }
@@ -147,15 +235,15 @@ zx_status_t MinfsChecker::GetInodeNthBno(minfs_inode_t* inode, blk_t n,
             return ZX_OK;
         }
 
-        if (cached_doubly_indirect_ != dibno) {
+        if (scan->cached_doubly_indirect != dibno) {
             zx_status_t status;
-            if ((status = fs_->ReadDat(dibno, doubly_indirect_cache_)) != ZX_OK) {
+            if ((status = fs_->ReadDatUncached(dibno, scan->doubly_indirect_cache)) != ZX_OK) {
                 return status;
             }
-            cached_doubly_indirect_ = dibno;
+            scan->cached_doubly_indirect = dibno;
         }
 
-        uint32_t* dientry = reinterpret_cast<uint32_t*>(doubly_indirect_cache_);
+        uint32_t* dientry = reinterpret_cast<uint32_t*>(scan->doubly_indirect_cache);
         blk_t ibno;
         if ((ibno = dientry[j]) == 0) {
             *bno_out = 0;
@@ -164,15 +252,15 @@ zx_status_t MinfsChecker::GetInodeNthBno(minfs_inode_t* inode, blk_t n,
             return ZX_OK;
         }
 
-        if (cached_indirect_ != ibno) {
+        if (scan->cached_indirect != ibno) {
             zx_status_t status;
-            if ((status = fs_->ReadDat(ibno, indirect_cache_)) != ZX_OK) {
+            if ((status = fs_->ReadDatUncached(ibno, scan->indirect_cache)) != ZX_OK) {
                 return status;
             }
-            cached_indirect_ = ibno;
+            scan->cached_indirect = ibno;
         }
 
-        uint32_t* ientry = reinterpret_cast<uint32_t*>(indirect_cache_);
+        uint32_t* ientry = reinterpret_cast<uint32_t*>(scan->indirect_cache);
         *bno_out = ientry[k];
         return ZX_OK;
     }
@@ -193,6 +281,17 @@ zx_status_t MinfsChecker::CheckDirectory(minfs_inode_t* inode, ino_t ino,
         return status;
     }
 
+    // Hashed directories are made of whole buckets, each ending where its last record ends.
+    const uint32_t hash_bits = inode->dir_hash_bits;
+    if (hash_bits > kMinfsDirHashMaxBits) {
+        FS_TRACE_ERROR("check: ino#%u: bad hash bits (%u)\n", ino, hash_bits);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    } else if ((hash_bits != 0) && (inode->size != MinfsDirBucketEnd((1u << hash_bits) - 1))) {
+        FS_TRACE_ERROR("check: ino#%u: size (%u) does not match hash bits (%u)\n", ino,
+                       inode->size, hash_bits);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
     size_t off = 0;
     while (true) {
         uint32_t data[MINFS_DIRENT_SIZE];
@@ -217,6 +316,16 @@ zx_status_t MinfsChecker::CheckDirectory(minfs_inode_t* inode, ino_t ino,
             FS_TRACE_ERROR("check: ino#%u: de[%u]: bad dirent reclen (%u)\n", ino, eno, rlen);
             return ZX_ERR_IO_DATA_INTEGRITY;
         }
+        const uint32_t bucket = static_cast<uint32_t>(off / kMinfsDirBucketSize);
+        if (hash_bits != 0) {
+            bool crosses = is_last ? (bucket != (1u << hash_bits) - 1) :
+                                     (off + rlen > MinfsDirBucketEnd(bucket));
+            if (crosses) {
+                FS_TRACE_ERROR("check: ino#%u: de[%u]: dirent crosses hash bucket %u\n", ino, eno,
+                               bucket);
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+        }
         if (de->ino == 0) {
             if (flags & CD_DUMP) {
                 xprintf("ino#%u: de[%u]: <empty> reclen=%u\n", ino, eno, rlen);
@@ -236,6 +345,11 @@ zx_status_t MinfsChecker::CheckDirectory(minfs_inode_t* inode, ino_t ino,
                 FS_TRACE_ERROR("check: ino#%u: de[%u]: invalid namelen %u\n", ino, eno, de->namelen);
                 return ZX_ERR_IO_DATA_INTEGRITY;
             }
+            if ((hash_bits != 0) && (MinfsDirBucket(hash_bits, de->name, de->namelen) != bucket)) {
+                FS_TRACE_ERROR("check: ino#%u: de[%u]: '%.*s' is not in its hash bucket (%u)\n",
+                               ino, eno, de->namelen, de->name, bucket);
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
             if ((de->namelen == 1) && (de->name[0] == '.')) {
                 if (dot) {
                     FS_TRACE_ERROR("check: ino#%u: multiple '.' entries\n", ino);
@@ -307,7 +421,100 @@ const char* MinfsChecker::CheckDataBlock(blk_t bno) {
     return nullptr;
 }
 
-zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
+zx_status_t MinfsChecker::AddBlockRef(InodeScan* scan, blk_t bno, ino_t ino, uint32_t n,
+                                      BlockRefKind kind) {
+    fbl::AllocChecker ac;
+    scan->refs.push_back({bno, ino, n, kind}, &ac);
+    return ac.check() ? ZX_OK : ZX_ERR_NO_MEMORY;
+}
+
+void MinfsChecker::CheckBlockRefs(const fbl::Vector<BlockRef>& refs) {
+    for (const BlockRef& ref : refs) {
+        const char* msg;
+        if ((msg = CheckDataBlock(ref.bno)) == nullptr) {
+            continue;
+        }
+        switch (ref.kind) {
+        case BlockRefKind::kData:
+            FS_TRACE_WARN("check: ino#%u: block %u(@%u): %s\n", ref.ino, ref.n, ref.bno, msg);
+            break;
+        case BlockRefKind::kIndirect:
+            FS_TRACE_WARN("check: ino#%u: indirect block %u(@%u): %s\n",
+                 ref.ino, ref.n, ref.bno, msg);
+            break;
+        case BlockRefKind::kDoublyIndirect:
+            FS_TRACE_WARN("check: ino#%u: doubly indirect block %u(@%u): %s\n",
+                 ref.ino, ref.n, ref.bno, msg);
+            break;
+        case BlockRefKind::kIndirectInDind:
+            FS_TRACE_WARN("check: ino#%u: indirect block (in dind) %u(@%u): %s\n",
+                ref.ino, ref.n, ref.bno, msg);
+            break;
+        }
+        conforming_ = false;
+    }
+}
+
+zx_status_t MinfsChecker::ScanExtents(InodeScan* scan, minfs_inode_t* inode, ino_t ino) {
+    if (inode->magic != kMinfsMagicFile) {
+        FS_TRACE_WARN("check: ino#%u: directory mapped by extents\n", ino);
+        scan->conforming = false;
+    }
+
+    const minfs_extent_t* extents = MinfsInodeExtents(inode);
+    uint32_t block_count = 0;
+    // The first file block which the next extent may map.
+    uint32_t next_fblock = 0;
+    uint32_t i = 0;
+    zx_status_t status;
+    for (; i < kMinfsInlineExtents && extents[i].count != 0; i++) {
+        const minfs_extent_t& e = extents[i];
+        xprintf(" [%u, +%u)@%u,", e.fblock, e.count, e.start);
+        if (e.fblock < next_fblock) {
+            FS_TRACE_WARN("check: ino#%u: extent %u at block %u overlaps or is out of order\n",
+                          ino, i, e.fblock);
+            scan->conforming = false;
+        }
+        if (e.count > kMinfsMaxFileBlock || e.fblock > kMinfsMaxFileBlock - e.count) {
+            FS_TRACE_WARN("check: ino#%u: extent %u past max file size\n", ino, i);
+            scan->conforming = false;
+        }
+        for (uint32_t j = 0; j < e.count; j++) {
+            if ((status = AddBlockRef(scan, e.start + j, ino, e.fblock + j,
+                                      BlockRefKind::kData)) != ZX_OK) {
+                return status;
+            }
+            block_count++;
+        }
+        next_fblock = e.fblock + e.count;
+    }
+    xprintf(" ...\n");
+
+    for (; i < kMinfsInlineExtents; i++) {
+        if (extents[i].count != 0 || extents[i].fblock != 0 || extents[i].start != 0) {
+            FS_TRACE_WARN("check: ino#%u: extent %u follows the end of the extents\n", ino, i);
+            scan->conforming = false;
+        }
+    }
+
+    if (next_fblock > fbl::round_up(inode->size, kMinfsBlockSize) / kMinfsBlockSize) {
+        FS_TRACE_WARN("check: ino#%u: filesize too small\n", ino);
+        scan->conforming = false;
+    }
+    if (block_count != inode->block_count) {
+        FS_TRACE_WARN("check: ino#%u: block count %u, actual blocks %u\n",
+             ino, inode->block_count, block_count);
+        scan->conforming = false;
+    }
+    return ZX_OK;
+}
+
+zx_status_t MinfsChecker::ScanFile(InodeScan* scan, minfs_inode_t* inode, ino_t ino) {
+    if (inode->flags & kMinfsInodeFlagExtents) {
+        xprintf("Extents: \n");
+        return ScanExtents(scan, inode, ino);
+    }
+
     xprintf("Direct blocks: \n");
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         xprintf(" %d,", inode->dnum[n]);
@@ -315,44 +522,39 @@ zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
     xprintf(" ...\n");
 
     uint32_t block_count = 0;
+    zx_status_t status;
 
-    // count and sanity-check indirect blocks
+    // count indirect blocks
     for (unsigned n = 0; n < kMinfsIndirect; n++) {
         if (inode->inum[n]) {
-            const char* msg;
-            if ((msg = CheckDataBlock(inode->inum[n])) != nullptr) {
-                FS_TRACE_WARN("check: ino#%u: indirect block %u(@%u): %s\n",
-                     ino, n, inode->inum[n], msg);
-                conforming_ = false;
+            if ((status = AddBlockRef(scan, inode->inum[n], ino, n,
+                                      BlockRefKind::kIndirect)) != ZX_OK) {
+                return status;
             }
             block_count++;
         }
     }
 
-    // count and sanity-check doubly indirect blocks
+    // count doubly indirect blocks, and the indirect blocks within them
     for (unsigned n = 0; n < kMinfsDoublyIndirect; n++) {
         if (inode->dinum[n]) {
-            const char* msg;
-            if ((msg = CheckDataBlock(inode->dinum[n])) != nullptr) {
-                FS_TRACE_WARN("check: ino#%u: doubly indirect block %u(@%u): %s\n",
-                     ino, n, inode->dinum[n], msg);
-                conforming_ = false;
+            if ((status = AddBlockRef(scan, inode->dinum[n], ino, n,
+                                      BlockRefKind::kDoublyIndirect)) != ZX_OK) {
+                return status;
             }
             block_count++;
 
             char data[kMinfsBlockSize];
-            zx_status_t status;
-            if ((status = fs_->ReadDat(inode->dinum[n], data)) != ZX_OK) {
+            if ((status = fs_->ReadDatUncached(inode->dinum[n], data)) != ZX_OK) {
                 return status;
             }
             uint32_t* entry = reinterpret_cast<uint32_t*>(data);
 
             for (unsigned m = 0; m < kMinfsDirectPerIndirect; m++) {
                 if (entry[m]) {
-                    if ((msg = CheckDataBlock(entry[m])) != nullptr) {
-                        FS_TRACE_WARN("check: ino#%u: indirect block (in dind) %u(@%u): %s\n",
-                            ino, m, entry[m], msg);
-                        conforming_ = false;
+                    if ((status = AddBlockRef(scan, entry[m], ino, m,
+                                              BlockRefKind::kIndirectInDind)) != ZX_OK) {
+                        return status;
                     }
                     block_count++;
                 }
@@ -360,20 +562,19 @@ zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
         }
     }
 
-    // count and sanity-check data blocks
+    // count data blocks
 
     // The next block which would be allocated if we expand the file size
     // by a single block.
     unsigned next_blk = 0;
-    cached_doubly_indirect_ = 0;
-    cached_indirect_ = 0;
+    scan->cached_doubly_indirect = 0;
+    scan->cached_indirect = 0;
 
     blk_t n = 0;
     while (true) {
-        zx_status_t status;
         blk_t bno;
         blk_t next_n;
-        if ((status = GetInodeNthBno(inode, n, &next_n, &bno)) < 0) {
+        if ((status = GetInodeNthBno(scan, inode, n, &next_n, &bno)) < 0) {
             if (status == ZX_ERR_OUT_OF_RANGE) {
                 break;
             } else {
@@ -384,10 +585,8 @@ zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
         if (bno) {
             next_blk = n + 1;
             block_count++;
-            const char* msg;
-            if ((msg = CheckDataBlock(bno)) != nullptr) {
-                FS_TRACE_WARN("check: ino#%u: block %u(@%u): %s\n", ino, n, bno, msg);
-                conforming_ = false;
+            if ((status = AddBlockRef(scan, bno, ino, n, BlockRefKind::kData)) != ZX_OK) {
+                return status;
             }
         }
         n = next_n;
@@ -396,17 +595,135 @@ zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
         unsigned max_blocks = fbl::round_up(inode->size, kMinfsBlockSize) / kMinfsBlockSize;
         if (next_blk > max_blocks) {
             FS_TRACE_WARN("check: ino#%u: filesize too small\n", ino);
-            conforming_ = false;
+            scan->conforming = false;
         }
     }
     if (block_count != inode->block_count) {
         FS_TRACE_WARN("check: ino#%u: block count %u, actual blocks %u\n",
              ino, inode->block_count, block_count);
-        conforming_ = false;
+        scan->conforming = false;
     }
     return ZX_OK;
 }
 
+zx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, ino_t ino) {
+    if (scanned_[ino]) {
+        return ZX_OK;
+    }
+
+    // Not marked in use, so missed by ScanInodes()
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<InodeScan> scan(new (&ac) InodeScan);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status;
+    if ((status = ScanFile(scan.get(), inode, ino)) != ZX_OK) {
+        return status;
+    }
+    CheckBlockRefs(scan->refs);
+    conforming_ = conforming_ && scan->conforming;
+    scanned_[ino] = true;
+    return ZX_OK;
+}
+
+void MinfsChecker::ScanInodeRange(ScanShare* share) {
+    InodeScan* scan = &share->scan;
+    for (ino_t ino = share->start; ino < share->end; ino++) {
+        if (!fs_->inode_map_.Get(ino, ino + 1)) {
+            continue;
+        }
+        minfs_inode_t inode;
+        if ((scan->status = LoadInode(&inode, ino)) != ZX_OK) {
+            return;
+        }
+        // Inodes with bad magic are reported if they are reached from the root
+        if ((inode.magic != kMinfsMagicFile) && (inode.magic != kMinfsMagicDir)) {
+            continue;
+        }
+        if ((scan->status = ScanFile(scan, &inode, ino)) != ZX_OK) {
+            return;
+        }
+        scanned_[ino] = true;
+        share->scanned++;
+    }
+}
+
+int MinfsChecker::ScanThread(void* arg) {
+    ScanShare* share = static_cast<ScanShare*>(arg);
+    share->checker->ScanInodeRange(share);
+    return 0;
+}
+
+zx_status_t MinfsChecker::ScanInodes() {
+    const uint64_t start_ms = MonotonicMs();
+    const uint32_t inode_count = fs_->info_.inode_count;
+    uint32_t num_threads = 1;
+#ifdef __Fuchsia__
+    num_threads = fbl::max(fbl::min(inode_count / kMinInodesPerThread,
+                                    fbl::min(zx_system_get_num_cpus(), kMaxScanThreads)), 1u);
+#endif
+
+    fbl::AllocChecker ac;
+    fbl::Array<fbl::unique_ptr<ScanShare>> shares(
+        new (&ac) fbl::unique_ptr<ScanShare>[num_threads], num_threads);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    const uint32_t per_thread = fbl::round_up(inode_count, num_threads) / num_threads;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        shares[t].reset(new (&ac) ScanShare);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        shares[t]->checker = this;
+        // Inode zero is never used
+        shares[t]->start = fbl::max(t * per_thread, 1u);
+        shares[t]->end = fbl::min((t + 1) * per_thread, inode_count);
+        shares[t]->scanned = 0;
+    }
+
+#ifdef __Fuchsia__
+    // The first share is scanned on this thread. If a thread can't be
+    // started, its share is scanned here too.
+    thrd_t threads[kMaxScanThreads];
+    bool started[kMaxScanThreads] = {};
+    for (uint32_t t = 1; t < num_threads; t++) {
+        started[t] = thrd_create(&threads[t], ScanThread, shares[t].get()) == thrd_success;
+    }
+    ScanThread(shares[0].get());
+    for (uint32_t t = 1; t < num_threads; t++) {
+        if (started[t]) {
+            thrd_join(threads[t], nullptr);
+        } else {
+            ScanThread(shares[t].get());
+        }
+    }
+#else
+    ScanThread(shares[0].get());
+#endif
+
+    // Shares are merged in inode order, so that a block referenced twice is
+    // blamed on the same inode however the scan was split.
+    uint32_t scanned = 0;
+    size_t refs = 0;
+    for (uint32_t t = 0; t < num_threads; t++) {
+        if (shares[t]->scan.status != ZX_OK) {
+            FS_TRACE_ERROR("check: failed to scan inodes [%u, %u): %d\n", shares[t]->start,
+                           shares[t]->end, shares[t]->scan.status);
+            return shares[t]->scan.status;
+        }
+        CheckBlockRefs(shares[t]->scan.refs);
+        conforming_ = conforming_ && shares[t]->scan.conforming;
+        scanned += shares[t]->scanned;
+        refs += shares[t]->scan.refs.size();
+    }
+    FS_TRACE_INFO("check: scanned %u inodes (%zu blocks) on %u thread%s in %" PRIu64 " ms\n",
+                  scanned, refs, num_threads, num_threads > 1 ? "s" : "",
+                  MonotonicMs() - start_ms);
+    return ZX_OK;
+}
+
 zx_status_t MinfsChecker::CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot) {
     minfs_inode_t inode;
     zx_status_t status;
@@ -511,6 +828,18 @@ zx_status_t MinfsChecker::CheckLinkCounts() const {
     return ZX_OK;
 }
 
+zx_status_t MinfsChecker::CheckJournal() {
+    const minfs_info_t& info = fs_->info_;
+    for (blk_t n = 0; n < info.journal_blocks; n++) {
+        const char* msg;
+        if ((msg = CheckDataBlock(info.journal_block + n)) != nullptr) {
+            FS_TRACE_WARN("check: journal block %u(@%u): %s\n", n, info.journal_block + n, msg);
+            conforming_ = false;
+        }
+    }
+    return ZX_OK;
+}
+
 zx_status_t MinfsChecker::CheckAllocatedCounts() const {
     zx_status_t status = ZX_OK;
     if (alloc_blocks_ != fs_->info_.alloc_block_count) {
@@ -527,14 +856,13 @@ zx_status_t MinfsChecker::CheckAllocatedCounts() const {
 }
 
 MinfsChecker::MinfsChecker()
-    : conforming_(true), fs_(nullptr), alloc_inodes_(0), alloc_blocks_(0), links_() {};
+    : conforming_(true), fs_(nullptr), scanned_(), alloc_inodes_(0), alloc_blocks_(0),
+      links_() {};
 
 zx_status_t MinfsChecker::Init(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info) {
     links_.reset(new int32_t[info->inode_count]{0}, info->inode_count);
     links_[0] = -1;
-
-    cached_doubly_indirect_ = 0;
-    cached_indirect_ = 0;
+    scanned_.reset(new uint8_t[info->inode_count]{0}, info->inode_count);
 
     zx_status_t status;
     if ((status = checked_inodes_.Reset(info->inode_count)) != ZX_OK) {
@@ -569,19 +897,41 @@ zx_status_t minfs_check(fbl::unique_ptr<Bcache> bc) {
         return status;
     }
 
+    // Check the filesystem as mounting would leave it.
+    if ((status = minfs_journal_replay(bc.get(), info)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs_check: journal replay failure: %d\n", status);
+        return status;
+    }
+    if (bc->Readblk(0, data) < 0) {
+        FS_TRACE_ERROR("minfs: could not read info block\n");
+        return ZX_ERR_IO;
+    }
+
+    const uint64_t start_ms = MonotonicMs();
     MinfsChecker chk;
     if ((status = chk.Init(fbl::move(bc), info)) != ZX_OK) {
         FS_TRACE_ERROR("minfs_check: Init failure: %d\n", status);
         return status;
     }
 
+    if ((status = chk.ScanInodes()) != ZX_OK) {
+        FS_TRACE_ERROR("minfs_check: ScanInodes failure: %d\n", status);
+        return status;
+    }
+
     //TODO: check root not a directory
+    const uint64_t tree_ms = MonotonicMs();
     if ((status = chk.CheckInode(1, 1, 0)) != ZX_OK) {
         FS_TRACE_ERROR("minfs_check: CheckInode failure: %d\n", status);
         return status;
     }
+    FS_TRACE_INFO("check: walked the directory tree in %" PRIu64 " ms\n",
+                  MonotonicMs() - tree_ms);
 
     zx_status_t r;
+    if ((r = chk.CheckJournal()) != ZX_OK) {
+        return r;
+    }
 
     // Save an error if it occurs, but check for subsequent errors
     // anyway.
@@ -599,6 +949,8 @@ zx_status_t minfs_check(fbl::unique_ptr<Bcache> bc) {
     //TODO: check unallocated inodes where magic != 0
     status |= (status != ZX_OK) ? 0 : (chk.conforming_ ? ZX_OK : ZX_ERR_BAD_STATE);
 
+    FS_TRACE_INFO("check: %s in %" PRIu64 " ms\n", status == ZX_OK ? "passed" : "failed",
+                  MonotonicMs() - start_ms);
     return status;
 }
 
@@ -10,7 +10,8 @@
 #include <inttypes.h>
 
 #ifdef __Fuchsia__
-#include <block-client/client.h>
+#include <async/cpp/loop.h>
+#include <block-client/cpp/client.h>
 #include <fs/fvm.h>
 #include <zx/vmo.h>
 #else
@@ -18,7 +19,11 @@
 #endif
 
 #include <fbl/algorithm.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_hash_table.h>
+#include <fbl/intrusive_single_list.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
 #include <fbl/unique_fd.h>
 #include <fs/block-txn.h>
@@ -37,10 +42,27 @@ public:
 
     static zx_status_t Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint32_t blockmax);
 
-    // Raw block read functions.
-    // These do not track blocks (or attempt to access the block cache)
+    // Block read and write functions, served from the block cache.
+    // Writes are held dirty in the cache until they are evicted or
+    // flushed by Sync(), so repeated writes to a block are written once.
     zx_status_t Readblk(blk_t bno, void* data);
     zx_status_t Writeblk(blk_t bno, const void* data);
+    // As Readblk(), but a block not already cached is read straight from the
+    // device and left out of the cache, without holding the cache lock, so
+    // that any number of threads may read at once. For readers such as fsck,
+    // which touch each block once and would only churn the cache.
+    zx_status_t ReadblkUncached(blk_t bno, void* data);
+
+    // Write back every dirty block in the cache.
+    zx_status_t FlushCache();
+
+    struct CacheStats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t writebacks; // dirty blocks written to the device
+        uint64_t evictions;
+    };
+    void GetCacheStats(CacheStats* out);
 
     // Returns the maximum number of available blocks,
     // assuming the filesystem is non-resizable.
@@ -52,9 +74,11 @@ public:
 
     ssize_t GetDevicePath(char* out, size_t out_len);
     zx_status_t AttachVmo(zx_handle_t vmo, vmoid_t* out);
-    zx_status_t Txn(block_fifo_request_t* requests, size_t count) {
-        return block_fifo_txn(fifo_client_, requests, count);
-    }
+    // Requests sent here bypass the block cache. Dirty blocks are written
+    // back first, and cached copies of the blocks written are dropped.
+    // Any number of requests may be sent at once; they are kept on the
+    // device together, in as many txn groups as it takes.
+    zx_status_t Txn(block_fifo_request_t* requests, size_t count);
 
     zx_status_t FVMQuery(fvm_info_t* info) {
         ssize_t r = ioctl_block_fvm_query(fd_.get(), info);
@@ -92,29 +116,8 @@ public:
         return fs::fvm_reset_volume_slices(fd_.get());
     }
 
-    // Acquires a Thread-local TxnId that can be used for sending messages
-    // over the block I/O FIFO.
-    txnid_t TxnId() const {
-        ZX_DEBUG_ASSERT(fd_);
-        thread_local txnid_t txnid_ = TXNID_INVALID;
-        if (txnid_ != TXNID_INVALID) {
-            return txnid_;
-        }
-        if (ioctl_block_alloc_txn(fd_.get(), &txnid_) < 0) {
-            return TXNID_INVALID;
-        }
-        return txnid_;
-    }
-
-    // Frees the TxnId allocated for the thread (if one was allocated).
-    // Must be called separately by all threads which access TxnId().
-    void FreeTxnId() {
-        txnid_t tid = TxnId();
-        if (tid == TXNID_INVALID) {
-            return;
-        }
-        ioctl_block_free_txn(fd_.get(), &tid);
-    }
+    // The block client picks the txnid of each request itself.
+    txnid_t TxnId() const { return TXNID_INVALID; }
 
 #else
     // Lengths of each extent (in bytes)
@@ -134,8 +137,48 @@ public:
 private:
     Bcache(fbl::unique_fd fd, uint32_t blockmax);
 
+    // Number of blocks held by the cache.
+    static constexpr size_t kCacheBlocks = 128;
+    static constexpr size_t kCacheBuckets = 61;
+
+    struct CacheEntry : public fbl::SinglyLinkedListable<CacheEntry*>,
+                        public fbl::DoublyLinkedListable<CacheEntry*> {
+        blk_t GetKey() const { return bno; }
+        static size_t GetHash(blk_t bno) { return bno; }
+
+        blk_t bno;
+        bool dirty;
+        uint8_t* data;
+    };
+
+    zx_status_t ReadRaw(blk_t bno, void* data);
+    zx_status_t WriteRaw(blk_t bno, const void* data);
+
+    // Find a free entry, or evict the least recently used one, writing it
+    // back if it is dirty. The entry returned is in no container.
+    zx_status_t GetEntryLocked(CacheEntry** out) __TA_REQUIRES(cache_lock_);
+    zx_status_t FlushLocked() __TA_REQUIRES(cache_lock_);
+    // Drop the cached copies of [bno, bno + count), dirty or not.
+    void InvalidateLocked(blk_t bno, blk_t count) __TA_REQUIRES(cache_lock_);
+    // Move |entry|, already out of |cache_|, onto the free list.
+    void DropLocked(CacheEntry* entry) __TA_REQUIRES(cache_lock_);
+
+    fbl::Mutex cache_lock_;
+    fbl::unique_ptr<CacheEntry[]> cache_entries_;
+    fbl::unique_ptr<uint8_t[]> cache_data_;
+    size_t cache_dirty_ __TA_GUARDED(cache_lock_) = 0;
+    fbl::HashTable<blk_t, CacheEntry*, fbl::SinglyLinkedList<CacheEntry*>,
+                   size_t, kCacheBuckets> cache_ __TA_GUARDED(cache_lock_);
+    // Most recently used at the front.
+    fbl::DoublyLinkedList<CacheEntry*> lru_ __TA_GUARDED(cache_lock_);
+    // Entries holding no block.
+    fbl::DoublyLinkedList<CacheEntry*> free_ __TA_GUARDED(cache_lock_);
+    CacheStats cache_stats_ __TA_GUARDED(cache_lock_) = {};
+
 #ifdef __Fuchsia__
-    fifo_client_t* fifo_client_{}; // Fast path to interact with block device
+    // Runs the completions of block_client_, on a thread of its own.
+    async::Loop io_loop_;
+    fbl::unique_ptr<block_client::Client> block_client_{}; // Fast path to interact with block device
     block_info_t info_{};
 #else
     off_t offset_{};
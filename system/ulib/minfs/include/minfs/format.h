@@ -19,6 +19,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // clang-format off
@@ -35,7 +36,7 @@ typedef uint32_t ino_t;
 
 constexpr uint64_t kMinfsMagic0         = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1         = (0x385000d3d3d3d304ULL);
-constexpr uint32_t kMinfsVersion        = 0x00000005;
+constexpr uint32_t kMinfsVersion        = 0x00000008;
 
 constexpr ino_t    kMinfsRootIno        = 1;
 constexpr uint32_t kMinfsFlagClean      = 0x00000001; // Currently unused
@@ -97,6 +98,8 @@ typedef struct {
     uint32_t abm_slices;    // Slices allocated to block bitmap
     uint32_t ino_slices;    // Slices allocated to inode table
     uint32_t dat_slices;    // Slices allocated to file data section
+    blk_t journal_block;    // first data block of the metadata journal
+    uint32_t journal_blocks; // length of the metadata journal, 0 if there is none
 } minfs_info_t;
 
 // Notes:
@@ -112,6 +115,46 @@ typedef struct {
 //     ino_block + ino / kMinfsInodesPerBlock
 //   at offset: ino % kMinfsInodesPerBlock
 // - inode 0 is never used, should be marked allocated but ignored
+// - the journal is a run of journal_blocks data blocks, marked allocated
+//   in the abm, starting at journal_block (relative to dat_block)
+
+constexpr uint64_t kMinfsJournalMagic   = (0x6c6e724a53466e4dULL);
+// Journal length mkfs aims for; it is cut down on small volumes.
+constexpr uint32_t kMinfsJournalBlocks  = 256;
+// Volumes whose journal would be smaller than this get none.
+constexpr uint32_t kMinfsJournalMinBlocks = 8;
+
+// Block 0 of the journal.
+typedef struct {
+    uint64_t magic;                 // kMinfsJournalMagic
+    uint64_t sequence;              // sequence number of the entry at |start|
+    uint32_t start;                 // journal block of the oldest entry to replay
+} minfs_journal_info_t;
+
+constexpr uint32_t kMinfsJournalEntryMax = (kMinfsBlockSize - 24) / sizeof(blk_t);
+
+// The first block of a journal entry, followed by |count| blocks to be
+// written to |target|.
+typedef struct {
+    uint64_t magic;                 // kMinfsJournalMagic
+    uint64_t sequence;
+    uint32_t count;
+    uint32_t checksum;              // crc32 of the |count| blocks following the header
+    blk_t target[kMinfsJournalEntryMax]; // absolute blocks, all before dat_block
+} minfs_journal_header_t;
+
+static_assert(sizeof(minfs_journal_header_t) == kMinfsBlockSize,
+              "minfs journal header size is wrong");
+
+// Notes:
+// - only blocks before dat_block (the info block, bitmaps and inode table)
+//   are journaled; blocks in the data region are written in place before
+//   the entry which refers to them
+// - entries follow each other from |start| on, each with the sequence
+//   number after the one before it. Replay stops at the first entry with
+//   the wrong magic, sequence or checksum
+// - an entry never wraps around the end of the journal; the journal is
+//   restarted at block 1 instead, once every entry has been written in place
 
 typedef struct {
     uint32_t magic;
@@ -123,7 +166,9 @@ typedef struct {
     uint32_t seq_num;               // bumped when modified
     uint32_t gen_num;               // bumped when deleted
     uint32_t dirent_count;          // for directories
-    uint32_t rsvd[5];
+    uint32_t dir_hash_bits;         // for directories: log2 of hash buckets, 0 if linear
+    uint32_t flags;                 // kMinfsInodeFlag*
+    uint32_t rsvd[3];
     blk_t dnum[kMinfsDirect];    // direct blocks
     blk_t inum[kMinfsIndirect];  // indirect blocks
     blk_t dinum[kMinfsDoublyIndirect]; // doubly indirect blocks
@@ -132,6 +177,42 @@ typedef struct {
 static_assert(sizeof(minfs_inode_t) == kMinfsInodeSize,
               "minfs inode size is wrong");
 
+// The inode maps its blocks through the extents stored over its
+// dnum/inum/dinum arrays, rather than through those arrays.
+constexpr uint32_t kMinfsInodeFlagExtents = 0x00000001;
+
+// A run of |count| data blocks starting at |start|, holding the file's
+// blocks from |fblock| on.
+typedef struct {
+    uint32_t fblock;
+    blk_t start;
+    uint32_t count;
+} minfs_extent_t;
+
+constexpr uint32_t kMinfsInlineExtents =
+    ((kMinfsDirect + kMinfsIndirect + kMinfsDoublyIndirect) * sizeof(blk_t)) /
+    sizeof(minfs_extent_t);
+
+static_assert(offsetof(minfs_inode_t, dinum) + sizeof(blk_t) * kMinfsDoublyIndirect ==
+              kMinfsInodeSize, "minfs extents must end the inode");
+
+inline minfs_extent_t* MinfsInodeExtents(minfs_inode_t* inode) {
+    return reinterpret_cast<minfs_extent_t*>(inode->dnum);
+}
+
+inline const minfs_extent_t* MinfsInodeExtents(const minfs_inode_t* inode) {
+    return reinterpret_cast<const minfs_extent_t*>(inode->dnum);
+}
+
+// Notes:
+// - new files are mapped by extents, sorted by fblock and packed at the
+//   start of the array, the first extent with a zero count ends it
+// - extents never overlap, and adjacent ones are merged when they are
+//   contiguous on disk as well
+// - a file whose blocks do not fit in kMinfsInlineExtents extents is
+//   converted to the direct/indirect block map, and drops the flag
+// - directories always use the block map
+
 typedef struct {
     ino_t ino;                      // inode number
     uint32_t reclen;                // Low 28 bits: Length of record
@@ -177,6 +258,36 @@ static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
 //   record starts. If the MAX_DIR_SIZE is increased, this 'last' record will
 //   also increase in size.
 
+// Directories holding more than kMinfsDirHashMinEntries entries are hashed:
+// the directory is split into (1 << dir_hash_bits) buckets of
+// kMinfsDirBucketSize bytes, and an entry lives in the bucket picked by the
+// low bits of MinfsDirentHash() of its name. Each bucket is a run of
+// records that ends exactly at the bucket's end, so walking the directory
+// from the start still visits every record; only the last record of the
+// last bucket has "kMinfsReclenLast" set. The last bucket is cut short by
+// kMinfsMaxDirectorySize.
+constexpr uint32_t kMinfsDirBucketSize     = kMinfsBlockSize;
+constexpr uint32_t kMinfsDirHashMaxBits    = 7;
+constexpr uint32_t kMinfsDirHashMinEntries = 512;
+
+inline uint32_t MinfsDirentHash(const char* name, size_t namelen) {
+    return fnv1a32(name, namelen);
+}
+
+// The bucket of a hashed directory holding |name|, and where that bucket starts and ends.
+inline uint32_t MinfsDirBucket(uint32_t hash_bits, const char* name, size_t namelen) {
+    return MinfsDirentHash(name, namelen) & ((1u << hash_bits) - 1);
+}
+
+constexpr size_t MinfsDirBucketStart(uint32_t bucket) {
+    return static_cast<size_t>(bucket) * kMinfsDirBucketSize;
+}
+
+constexpr size_t MinfsDirBucketEnd(uint32_t bucket) {
+    return (MinfsDirBucketStart(bucket) + kMinfsDirBucketSize < kMinfsMaxDirectorySize) ?
+           MinfsDirBucketStart(bucket) + kMinfsDirBucketSize : kMinfsMaxDirectorySize;
+}
+
 
 // blocksize   8K    16K    32K
 // 16 dir =  128K   256K   512K
@@ -11,6 +11,7 @@
 #endif
 
 #include <fbl/algorithm.h>
+#include <fbl/function.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/intrusive_single_list.h>
 #include <fbl/macros.h>
@@ -71,8 +72,14 @@ public:
 
     size_t BlkCount() const;
 
+    // Number of blocks enqueued which lie before |dat_block|, and would be
+    // journaled.
+    size_t MetadataBlkCount(blk_t dat_block) const;
+
 private:
+    friend class Journal;
     friend class WritebackBuffer;
+    friend class WritebackWork;
     Bcache* bc_;
     size_t count_ = 0;
     write_request_t requests_[MAX_TXN_MESSAGES];
@@ -106,13 +113,28 @@ public:
     // consumed.
     size_t Complete(zx_handle_t vmo, vmoid_t vmoid);
 
+    // Signals the closure with |status| once the transaction has been written
+    // out by some other means, such as a journal commit, and resets the
+    // WritebackWork to its initial state.
+    //
+    // Returns the number of blocks of the writeback buffer that have been
+    // consumed.
+    size_t Complete(zx_status_t status);
+
     // Adds a closure to the WritebackWork, such that it will be signalled
     // when the WritebackWork is flushed to disk.
     // If no closure is set, nothing will get signalled.
     //
     // Only one closure may be set for each WritebackWork unit.
+    //
+    // The closure is stored inline, never on the heap. It has room for a
+    // forwarded |fs::Vnode::SyncCallback| plus one pointer, which is what
+    // VnodeMinfs::Sync wraps around its caller's callback.
     using SyncCallback = fs::Vnode::SyncCallback;
-    void SetClosure(SyncCallback closure);
+    static constexpr size_t kClosureSize =
+        fbl::round_up(sizeof(void*), alignof(SyncCallback)) + sizeof(SyncCallback);
+    using Closure = fbl::InlineFunction<void(zx_status_t status), kClosureSize>;
+    void SetClosure(Closure closure);
 #else
     void Complete();
 #endif
@@ -124,7 +146,7 @@ public:
     WriteTxn* txn() { return &txn_; }
 private:
 #ifdef __Fuchsia__
-    SyncCallback closure_; // Optional.
+    Closure closure_; // Optional.
 #endif
     WriteTxn txn_;
     size_t node_count_;
@@ -136,13 +158,91 @@ private:
 
 #ifdef __Fuchsia__
 
+// The metadata journal. WritebackWork is committed to it in groups, after
+// the transactions have been copied to the writeback buffer.
+class Journal {
+public:
+    // Calls constructor, return an error if anything goes wrong.
+    // |info| must describe a journal; the journal must have been replayed.
+    // |buffer| is the writeback buffer which transactions are copied to.
+    static zx_status_t Create(Bcache* bc, const minfs_info_t* info, MappedVmo* buffer,
+                              vmoid_t buffer_vmoid, fbl::unique_ptr<Journal>* out);
+    ~Journal();
+
+    // The most metadata blocks one commit may hold.
+    size_t Capacity() const;
+    // Blocks before this one are metadata, and journaled.
+    blk_t DatBlock() const { return dat_block_; }
+
+    // Writes the transactions of |work| out as a single journal entry:
+    // data blocks are written in place, then the metadata blocks to the
+    // journal, at which point the works are signalled, then the metadata
+    // blocks are written in place. A block written by several works is
+    // only written once, with its latest contents.
+    //
+    // |work| may hold more metadata blocks than |Capacity()| only if it is
+    // a single work; it is written in place without being journaled.
+    //
+    // Returns the number of blocks of the writeback buffer consumed.
+    size_t Commit(fbl::unique_ptr<WritebackWork>* work, size_t count);
+
+    // Marks every entry written so far as written in place, so mounting
+    // replays none of them.
+    zx_status_t Clean();
+
+private:
+    Journal(Bcache* bc, const minfs_info_t* info, MappedVmo* buffer, vmoid_t buffer_vmoid);
+
+    // A block of a transaction: where it goes on disk and where it lies in
+    // the writeback buffer.
+    struct BlockMapping {
+        blk_t dev;
+        blk_t buf;
+        // Order the blocks were enqueued, to pick the latest copy of each.
+        size_t seq;
+    };
+
+    // Gathers the blocks of |work| into |mappings_|, keeping only the latest
+    // copy of each block, sorted by |dev|.
+    size_t CollectBlocks(fbl::unique_ptr<WritebackWork>* work, size_t count);
+    // Writes |count| mappings to their |dev| locations (or to
+    // |dev_override| + index, if it is not zero), all in one transaction.
+    zx_status_t WriteBlocks(const BlockMapping* mappings, size_t count, blk_t dev_override);
+    zx_status_t WriteInfo();
+
+    Bcache* bc_;
+    const blk_t dat_block_;
+    // Absolute location and length of the journal.
+    const blk_t journal_start_;
+    const uint32_t journal_blocks_;
+    MappedVmo* buffer_;
+    const vmoid_t buffer_vmoid_;
+
+    // Holds the journal info block or an entry header.
+    fbl::unique_ptr<MappedVmo> header_{};
+    vmoid_t header_vmoid_ = VMOID_INVALID;
+
+    fbl::unique_ptr<BlockMapping[]> mappings_{};
+    size_t mappings_cap_ = 0;
+    // The requests of WriteBlocks(), one per mapping at most.
+    fbl::unique_ptr<block_fifo_request_t[]> requests_{};
+
+    // Journal block the next entry is written to, and its sequence number.
+    uint32_t head_ = 1;
+    uint64_t sequence_ = 0;
+    // The journal info block, as last written.
+    uint32_t info_start_ = 1;
+    uint64_t info_sequence_ = 0;
+};
+
 // WritebackBuffer which manages a writeback buffer (and background thread,
 // which flushes this buffer out to disk).
 class WritebackBuffer {
 public:
     // Calls constructor, return an error if anything goes wrong.
+    // If |info| describes a journal, metadata is written through it.
     static zx_status_t Create(Bcache* bc, fbl::unique_ptr<MappedVmo> buffer,
-                              fbl::unique_ptr<WritebackBuffer>* out);
+                              const minfs_info_t* info, fbl::unique_ptr<WritebackBuffer>* out);
     ~WritebackBuffer();
 
     // Enqueues work into the writeback buffer.
@@ -177,6 +277,9 @@ private:
 
     static int WritebackThread(void* arg);
 
+    // The most works committed to the journal together.
+    static constexpr size_t kMaxGroupCommit = 64;
+
     // The waiter struct may be used as a stack-allocated queue for producers.
     // It allows them to take turns putting data into the buffer when it is
     // mostly full.
@@ -206,6 +309,8 @@ private:
     bool unmounting_ __TA_GUARDED(writeback_lock_){false};
     fbl::unique_ptr<MappedVmo> buffer_{};
     vmoid_t buffer_vmoid_ = VMOID_INVALID;
+    // Only used by the writeback thread. May be null.
+    fbl::unique_ptr<Journal> journal_{};
     // The units of all the following are "MinFS blocks".
     size_t start_ __TA_GUARDED(writeback_lock_){};
     size_t len_ __TA_GUARDED(writeback_lock_){};
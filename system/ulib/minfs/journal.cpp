@@ -0,0 +1,374 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fs/block-txn.h>
+#include <fs/mapped-vmo.h>
+#include <fs/trace.h>
+#include <lib/cksum.h>
+
+#include "minfs-private.h"
+#include <minfs/writeback.h>
+
+namespace minfs {
+
+namespace {
+
+// The most blocks a single journal entry may hold, for a journal of
+// |journal_blocks| blocks.
+size_t JournalEntryCapacity(uint32_t journal_blocks) {
+    // Leave room for the journal info block and the entry header.
+    return fbl::min(static_cast<size_t>(journal_blocks - 2),
+                    static_cast<size_t>(kMinfsJournalEntryMax));
+}
+
+} // namespace
+
+// |info| must have passed minfs_check_info.
+zx_status_t minfs_journal_replay(Bcache* bc, const minfs_info_t* info) {
+    if (info->journal_blocks == 0) {
+        return ZX_OK;
+    }
+#ifndef __Fuchsia__
+    if (bc->extent_lengths_.size() != 0) {
+        // Sparse images are only written by host tools, which do not
+        // journal, so there is nothing to replay.
+        return ZX_OK;
+    }
+#endif
+    const blk_t journal_start = info->dat_block + info->journal_block;
+    zx_status_t status;
+    minfs_journal_info_t jinfo;
+    {
+        uint8_t blk[kMinfsBlockSize];
+        if ((status = bc->Readblk(journal_start, blk)) != ZX_OK) {
+            FS_TRACE_ERROR("minfs: could not read journal info\n");
+            return status;
+        }
+        memcpy(&jinfo, blk, sizeof(jinfo));
+    }
+    if ((jinfo.magic != kMinfsJournalMagic) || (jinfo.start == 0) ||
+        (jinfo.start >= info->journal_blocks)) {
+        FS_TRACE_ERROR("minfs: bad journal info\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    const size_t capacity = JournalEntryCapacity(info->journal_blocks);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<minfs_journal_header_t> header(new (&ac) minfs_journal_header_t);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::unique_ptr<uint8_t[]> payload(new (&ac) uint8_t[capacity * kMinfsBlockSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    uint32_t pos = jinfo.start;
+    uint64_t sequence = jinfo.sequence;
+    size_t replayed = 0;
+    while (pos + 1 < info->journal_blocks) {
+        if ((status = bc->Readblk(journal_start + pos, header.get())) != ZX_OK) {
+            return status;
+        }
+        const uint32_t count = header->count;
+        if ((header->magic != kMinfsJournalMagic) || (header->sequence != sequence) ||
+            (count == 0) || (count > capacity) || (pos + 1 + count > info->journal_blocks)) {
+            break;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if ((status = bc->Readblk(journal_start + pos + 1 + i,
+                                      &payload[i * kMinfsBlockSize])) != ZX_OK) {
+                return status;
+            }
+        }
+        if (crc32(0, payload.get(), count * kMinfsBlockSize) != header->checksum) {
+            // A torn entry; it was never acknowledged, so drop it.
+            break;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (header->target[i] >= info->dat_block) {
+                FS_TRACE_ERROR("minfs: journal entry %" PRIu64 " writes data block %u\n",
+                               sequence, header->target[i]);
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if ((status = bc->Writeblk(header->target[i], &payload[i * kMinfsBlockSize])) != ZX_OK) {
+                return status;
+            }
+        }
+        pos += 1 + count;
+        sequence++;
+        replayed++;
+    }
+
+    if (replayed == 0) {
+        return ZX_OK;
+    }
+    FS_TRACE_WARN("minfs: replayed %zu journal entries\n", replayed);
+
+    // Nothing before |pos| needs replaying again.
+    uint8_t blk[kMinfsBlockSize];
+    memset(blk, 0, sizeof(blk));
+    jinfo.sequence = sequence;
+    jinfo.start = pos;
+    memcpy(blk, &jinfo, sizeof(jinfo));
+    if ((status = bc->Writeblk(journal_start, blk)) != ZX_OK) {
+        return status;
+    }
+    return bc->Sync() == 0 ? ZX_OK : ZX_ERR_IO;
+}
+
+#ifdef __Fuchsia__
+
+zx_status_t Journal::Create(Bcache* bc, const minfs_info_t* info, MappedVmo* buffer,
+                            vmoid_t buffer_vmoid, fbl::unique_ptr<Journal>* out) {
+    ZX_DEBUG_ASSERT(info->journal_blocks >= kMinfsJournalMinBlocks);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Journal> journal(new (&ac) Journal(bc, info, buffer, buffer_vmoid));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Every block of the writeback buffer may end up in a single commit.
+    journal->mappings_cap_ = buffer->GetSize() / kMinfsBlockSize;
+    journal->mappings_.reset(new (&ac) BlockMapping[journal->mappings_cap_]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    journal->requests_.reset(new (&ac) block_fifo_request_t[journal->mappings_cap_]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    zx_status_t status;
+    if ((status = MappedVmo::Create(kMinfsBlockSize, "minfs-journal",
+                                    &journal->header_)) != ZX_OK) {
+        return status;
+    }
+    if ((status = bc->AttachVmo(journal->header_->GetVmo(), &journal->header_vmoid_)) != ZX_OK) {
+        return status;
+    }
+
+    uint8_t blk[kMinfsBlockSize];
+    if ((status = bc->Readblk(journal->journal_start_, blk)) != ZX_OK) {
+        return status;
+    }
+    const minfs_journal_info_t* jinfo = reinterpret_cast<const minfs_journal_info_t*>(blk);
+    if ((jinfo->magic != kMinfsJournalMagic) || (jinfo->start == 0) ||
+        (jinfo->start >= journal->journal_blocks_)) {
+        FS_TRACE_ERROR("minfs: bad journal info\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    journal->head_ = journal->info_start_ = jinfo->start;
+    journal->sequence_ = journal->info_sequence_ = jinfo->sequence;
+
+    *out = fbl::move(journal);
+    return ZX_OK;
+}
+
+Journal::Journal(Bcache* bc, const minfs_info_t* info, MappedVmo* buffer, vmoid_t buffer_vmoid)
+    : bc_(bc), dat_block_(info->dat_block), journal_start_(info->dat_block + info->journal_block),
+      journal_blocks_(info->journal_blocks), buffer_(buffer), buffer_vmoid_(buffer_vmoid) {}
+
+Journal::~Journal() {
+    if (header_vmoid_ != VMOID_INVALID) {
+        block_fifo_request_t request;
+        request.txnid = bc_->TxnId();
+        request.vmoid = header_vmoid_;
+        request.opcode = BLOCKIO_CLOSE_VMO;
+        bc_->Txn(&request, 1);
+    }
+}
+
+size_t Journal::Capacity() const {
+    return JournalEntryCapacity(journal_blocks_);
+}
+
+size_t Journal::CollectBlocks(fbl::unique_ptr<WritebackWork>* work, size_t count) {
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        const WriteTxn* txn = work[i]->txn();
+        for (size_t r = 0; r < txn->count_; r++) {
+            const write_request_t& req = txn->requests_[r];
+            for (size_t b = 0; b < req.length; b++) {
+                ZX_DEBUG_ASSERT(n < mappings_cap_);
+                mappings_[n].dev = static_cast<blk_t>(req.dev_offset + b);
+                mappings_[n].buf = static_cast<blk_t>(req.vmo_offset + b);
+                mappings_[n].seq = n;
+                n++;
+            }
+        }
+    }
+
+    qsort(mappings_.get(), n, sizeof(BlockMapping), [](const void* a, const void* b) {
+        const BlockMapping* ma = static_cast<const BlockMapping*>(a);
+        const BlockMapping* mb = static_cast<const BlockMapping*>(b);
+        if (ma->dev != mb->dev) {
+            return ma->dev < mb->dev ? -1 : 1;
+        }
+        return ma->seq < mb->seq ? -1 : 1;
+    });
+
+    // Keep the last copy of each block.
+    size_t unique = 0;
+    for (size_t i = 0; i < n; i++) {
+        if ((i + 1 < n) && (mappings_[i + 1].dev == mappings_[i].dev)) {
+            continue;
+        }
+        mappings_[unique++] = mappings_[i];
+    }
+    return unique;
+}
+
+zx_status_t Journal::WriteBlocks(const BlockMapping* mappings, size_t count, blk_t dev_override) {
+    const uint32_t kDiskBlocksPerMinfsBlock = kMinfsBlockSize / bc_->BlockSize();
+    block_fifo_request_t* blk_reqs = requests_.get();
+    size_t req_count = 0;
+    size_t i = 0;
+    while (i < count) {
+        // Coalesce blocks which follow each other both on disk and in the buffer.
+        blk_t dev = dev_override ? static_cast<blk_t>(dev_override + i) : mappings[i].dev;
+        blk_t buf = mappings[i].buf;
+        size_t length = 1;
+        while ((i + length < count) && (mappings[i + length].buf == buf + length) &&
+               (dev_override || (mappings[i + length].dev == dev + length))) {
+            length++;
+        }
+
+        block_fifo_request_t* req = &blk_reqs[req_count++];
+        req->vmoid = buffer_vmoid_;
+        req->opcode = BLOCKIO_WRITE;
+        req->vmo_offset = buf * kDiskBlocksPerMinfsBlock;
+        req->dev_offset = dev * kDiskBlocksPerMinfsBlock;
+        req->length = static_cast<uint32_t>(length * kDiskBlocksPerMinfsBlock);
+        i += length;
+    }
+    // The block client keeps every group of the transaction on the device at
+    // once, rather than waiting out each before sending the next.
+    return bc_->Txn(blk_reqs, req_count);
+}
+
+zx_status_t Journal::WriteInfo() {
+    memset(header_->GetData(), 0, kMinfsBlockSize);
+    minfs_journal_info_t* jinfo = static_cast<minfs_journal_info_t*>(header_->GetData());
+    jinfo->magic = kMinfsJournalMagic;
+    jinfo->sequence = sequence_;
+    jinfo->start = head_;
+
+    block_fifo_request_t request;
+    request.txnid = bc_->TxnId();
+    request.vmoid = header_vmoid_;
+    request.opcode = BLOCKIO_WRITE;
+    request.vmo_offset = 0;
+    request.dev_offset = journal_start_ * (kMinfsBlockSize / bc_->BlockSize());
+    request.length = kMinfsBlockSize / bc_->BlockSize();
+    zx_status_t status = bc_->Txn(&request, 1);
+    if (status == ZX_OK) {
+        info_start_ = head_;
+        info_sequence_ = sequence_;
+    }
+    return status;
+}
+
+zx_status_t Journal::Clean() {
+    if ((info_start_ == head_) && (info_sequence_ == sequence_)) {
+        return ZX_OK;
+    }
+    return WriteInfo();
+}
+
+size_t Journal::Commit(fbl::unique_ptr<WritebackWork>* work, size_t count) {
+    TRACE_DURATION("minfs", "Journal::Commit", "works", count);
+    const size_t total = CollectBlocks(work, count);
+    // Mappings are sorted by |dev|, so the metadata comes first.
+    size_t meta = 0;
+    while ((meta < total) && (mappings_[meta].dev < dat_block_)) {
+        meta++;
+    }
+
+    // Data goes in place first, so no entry refers to data which is not on disk.
+    zx_status_t status = WriteBlocks(&mappings_[meta], total - meta, 0);
+
+    bool journaled = false;
+    if ((status == ZX_OK) && (meta > 0) && (meta <= Capacity())) {
+        if (head_ + 1 + meta > journal_blocks_) {
+            // Every entry has already been written in place.
+            head_ = 1;
+            status = WriteInfo();
+        }
+        if (status == ZX_OK) {
+            minfs_journal_header_t* header =
+                static_cast<minfs_journal_header_t*>(header_->GetData());
+            memset(header, 0, sizeof(*header));
+            header->magic = kMinfsJournalMagic;
+            header->sequence = sequence_;
+            header->count = static_cast<uint32_t>(meta);
+            uint32_t crc = 0;
+            for (size_t i = 0; i < meta; i++) {
+                header->target[i] = mappings_[i].dev;
+                const uint8_t* data = static_cast<const uint8_t*>(buffer_->GetData()) +
+                                      mappings_[i].buf * kMinfsBlockSize;
+                crc = crc32(crc, data, kMinfsBlockSize);
+            }
+            header->checksum = crc;
+            status = WriteBlocks(&mappings_[0], meta, journal_start_ + head_ + 1);
+        }
+        if (status == ZX_OK) {
+            // The header goes last, so it is only found once its blocks are
+            // on disk; the checksum covers a device which reorders writes.
+            block_fifo_request_t request;
+            request.txnid = bc_->TxnId();
+            request.vmoid = header_vmoid_;
+            request.opcode = BLOCKIO_WRITE;
+            request.vmo_offset = 0;
+            request.dev_offset = (journal_start_ + head_) * (kMinfsBlockSize / bc_->BlockSize());
+            request.length = kMinfsBlockSize / bc_->BlockSize();
+            status = bc_->Txn(&request, 1);
+        }
+        if (status == ZX_OK) {
+            head_ += static_cast<uint32_t>(1 + meta);
+            sequence_++;
+            journaled = true;
+        }
+    } else if (meta > Capacity()) {
+        FS_TRACE_WARN("minfs: %zu metadata blocks do not fit in the journal\n", meta);
+    }
+
+    // Once the metadata is journaled, the works are durable, and their
+    // waiters need not wait for it to be written in place.
+    size_t blk_count = 0;
+    if (journaled) {
+        for (size_t i = 0; i < count; i++) {
+            blk_count += work[i]->Complete(ZX_OK);
+        }
+    }
+
+    // Checkpoint. Unjournaled metadata is only written if its data was.
+    zx_status_t checkpoint_status = status;
+    if (journaled || (status == ZX_OK)) {
+        checkpoint_status = WriteBlocks(&mappings_[0], meta, 0);
+    }
+    if (journaled) {
+        if (checkpoint_status != ZX_OK) {
+            // The entry is still in the journal, and is replayed on mount.
+            FS_TRACE_ERROR("minfs: failed to checkpoint journal entry: %d\n", checkpoint_status);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            blk_count += work[i]->Complete(checkpoint_status);
+        }
+    }
+    return blk_count;
+}
+
+#endif  // __Fuchsia__
+
+} // namespace minfs
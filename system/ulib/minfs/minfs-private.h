@@ -10,7 +10,6 @@
 #include <inttypes.h>
 
 #ifdef __Fuchsia__
-#include <fbl/auto_lock.h>
 #include <fs/remote.h>
 #include <fs/watcher.h>
 #include <sync/completion.h>
@@ -18,9 +17,11 @@
 #endif
 
 #include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/intrusive_single_list.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
 
@@ -108,17 +109,18 @@ public:
     void VnodeReleaseLocked(VnodeMinfs* vn) __TA_REQUIRES(hash_lock_);
 
     // Allocate a new data block.
-    zx_status_t BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno);
+    zx_status_t BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno) __TA_EXCLUDES(alloc_lock_);
 
     // free block in block bitmap
-    zx_status_t BlockFree(WriteTxn* txn, blk_t bno);
+    zx_status_t BlockFree(WriteTxn* txn, blk_t bno) __TA_EXCLUDES(alloc_lock_);
 
     // free ino in inode bitmap, release all blocks held by inode
-    zx_status_t InoFree(VnodeMinfs* vn, WriteTxn* txn);
+    zx_status_t InoFree(VnodeMinfs* vn, WriteTxn* txn) __TA_EXCLUDES(alloc_lock_);
 
     // Writes back an inode into the inode table on persistent storage.
     // Does not modify inode bitmap.
-    zx_status_t InodeSync(WriteTxn* txn, ino_t ino, const minfs_inode_t* inode);
+    zx_status_t InodeSync(WriteTxn* txn, ino_t ino,
+                          const minfs_inode_t* inode) __TA_EXCLUDES(alloc_lock_);
 
     void ValidateBno(blk_t bno) const {
         ZX_DEBUG_ASSERT(bno != 0);
@@ -140,7 +142,7 @@ public:
     // Signals the completion object as soon as...
     // (1) A sync probe has entered and exited the writeback queue, and
     // (2) The block cache has sync'd with the underlying block device.
-    void Sync(SyncCallback closure);
+    void Sync(WritebackWork::Closure closure);
 #endif
 
     // The following methods are used to read one block from the specified extent,
@@ -152,6 +154,9 @@ public:
     zx_status_t ReadAbm(blk_t bno, void* data);
     zx_status_t ReadIno(blk_t bno, void* data);
     zx_status_t ReadDat(blk_t bno, void* data);
+    // As ReadDat, by way of Bcache::ReadblkUncached, so may be called from
+    // many threads at once.
+    zx_status_t ReadDatUncached(blk_t bno, void* data);
 
     // TODO(rvargas): Make private.
     fbl::unique_ptr<Bcache> bc_;
@@ -159,6 +164,10 @@ public:
 #ifdef __Fuchsia__
     fbl::Mutex hash_lock_;
 #endif
+    // Guards the inode and block bitmaps, the allocation counts in |info_|,
+    // and the inode table, which vnodes on different threads update at once.
+    // Acquired after any vnode lock, and before the writeback lock.
+    fbl::Mutex alloc_lock_;
 
 private:
     // Fsck can introspect Minfs
@@ -169,14 +178,22 @@ private:
 
     // Find a free inode, allocate it in the inode bitmap, and write it back to disk
     zx_status_t InoNew(WriteTxn* txn, const minfs_inode_t* inode,
-                       ino_t* ino_out);
+                       ino_t* ino_out) __TA_EXCLUDES(alloc_lock_);
+
+    zx_status_t BlockFreeLocked(WriteTxn* txn, blk_t bno) __TA_REQUIRES(alloc_lock_);
+    zx_status_t InodeSyncLocked(WriteTxn* txn, ino_t ino,
+                                const minfs_inode_t* inode) __TA_REQUIRES(alloc_lock_);
 
     // Enqueues an update for allocated inode/block counts
-    zx_status_t CountUpdate(WriteTxn* txn);
+    zx_status_t CountUpdate(WriteTxn* txn) __TA_REQUIRES(alloc_lock_);
 
     // If possible, attempt to resize the MinFS partition.
-    zx_status_t AddInodes();
-    zx_status_t AddBlocks();
+    zx_status_t AddInodes() __TA_REQUIRES(alloc_lock_);
+    zx_status_t AddBlocks() __TA_REQUIRES(alloc_lock_);
+
+    // As VnodeLookup and VnodeInsert, with the hash lock already held.
+    fbl::RefPtr<VnodeMinfs> VnodeLookupLocked(uint32_t ino) __TA_REQUIRES(hash_lock_);
+    void VnodeInsertLocked(VnodeMinfs* vn) __TA_REQUIRES(hash_lock_);
 
     // Creates an unique identifier for this instance. This is to be called only during
     // "construction".
@@ -231,8 +248,9 @@ struct DirArgs {
 };
 
 struct DirectoryOffset {
-    size_t off;      // Offset in directory of current record
-    size_t off_prev; // Offset in directory of previous record
+    size_t off;       // Offset in directory of current record
+    size_t off_prev;  // Offset in directory of previous record
+    size_t off_limit; // End of the records being walked; a hash bucket, or the directory
 };
 
 class VnodeMinfs final : public fs::Vnode,
@@ -316,6 +334,17 @@ private:
     // Lookup which can traverse '..'
     zx_status_t LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece name);
 
+    // Writes back |data| at |offset|, with |lock_| held.
+    zx_status_t WriteLocked(const void* data, size_t len, size_t offset,
+                            size_t* out_actual) __TA_REQUIRES(lock_);
+
+    // Renames with |lock_| of this directory and of |newdir| held. The
+    // renamed vnode, and any vnode it replaces, are locked only while
+    // their own inodes are updated.
+    zx_status_t RenameLocked(fbl::RefPtr<VnodeMinfs> newdir, fbl::StringPiece oldname,
+                             fbl::StringPiece newname, bool src_must_be_dir,
+                             bool dst_must_be_dir);
+
     // Verify that the 'newdir' inode is not a subdirectory of this Vnode.
     // Traces the path from newdir back to the root inode.
     zx_status_t CheckNotSubdirectory(fbl::RefPtr<VnodeMinfs> newdir);
@@ -324,9 +353,19 @@ private:
                                            minfs_dirent_t*, DirArgs*,
                                            DirectoryOffset*);
 
-    // Enumerates directories.
+    // Enumerates directories. In a hashed directory, only the bucket
+    // which would hold |args->name| is walked.
     zx_status_t ForEachDirent(DirArgs* args, const DirentCallback func);
 
+    // Adds a dirent for |args|, hashing the directory once it holds more
+    // than kMinfsDirHashMinEntries entries, and doubling its hash buckets
+    // when the bucket for |args->name| is full.
+    zx_status_t AppendDirent(DirArgs* args);
+
+    // Rewrites the directory as hashed, with (1 << bits) buckets or more
+    // if the entries do not all fit.
+    zx_status_t DirHashRebuild(uint32_t bits);
+
     // Directory callback functions.
     //
     // The following functions are passable to |ForEachDirent|, which reads the parent directory,
@@ -349,6 +388,7 @@ private:
                             minfs_dirent_t* de, DirectoryOffset* offs);
     // Remove the link to a vnode (referring to inodes exclusively).
     // Has no impact on direntries (or parent inode).
+    // Called with lock_ held.
     void RemoveInodeLink(WriteTxn* txn);
 
     // Although file sizes don't need to be block-aligned, the underlying VMO is
@@ -380,6 +420,7 @@ private:
         READ,
         WRITE,
         DELETE,
+        SET,   // Map unmapped blocks to the bnos passed in
     } blk_op_t;
 
     typedef struct bop_params {
@@ -398,6 +439,8 @@ private:
 
         blk_op_t GetOp() const { return op_; }
         blk_t GetBno(blk_t index) const { return array_[index]; }
+        // The bno passed in for |index| by a SET.
+        blk_t GetSetBno(blk_t index) const { return bnos_[index]; }
         void SetBno(blk_t index, blk_t value) {
             ZX_DEBUG_ASSERT(index < GetCount());
 
@@ -495,6 +538,18 @@ private:
     // If 'txn' is non-null, new blocks are allocated for all un-allocated bnos.
     // This can be extended to retrieve multiple contiguous blocks in one call
     zx_status_t BlockGet(WriteTxn* txn, blk_t n, blk_t* bno);
+    // BlockGet through the direct/indirect block map, performing |op| on block 'n'.
+    zx_status_t BlockMapGet(WriteTxn* txn, blk_op_t op, blk_t n, blk_t* bno);
+
+    // BlockGet for files mapped by extents. A new block extends the extent
+    // it follows or precedes when that keeps the extent contiguous.
+    // Returns ZX_ERR_NO_RESOURCES if a new block needs an extent and none is free.
+    zx_status_t ExtentGet(WriteTxn* txn, blk_t n, blk_t* bno);
+    // Deletes the blocks of an extent mapped file from "start" on.
+    zx_status_t ExtentShrink(WriteTxn* txn, blk_t start);
+    // Moves the blocks of an extent mapped file into the block map.
+    zx_status_t ExtentsToBlockMap(WriteTxn* txn);
+    bool HasExtents() const { return (inode_.flags & kMinfsInodeFlagExtents) != 0; }
     // Deletes all blocks (relative to a file) from "start" (inclusive) to the end
     // of the file. Does not update mtime/atime.
     // This can be extended to return indices of deleted bnos, or to delete a specific number of
@@ -513,8 +568,41 @@ private:
 
 #ifdef __Fuchsia__
     void Sync(SyncCallback closure) final;
+    zx_status_t Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) final;
+    zx_status_t Msync(size_t offset, size_t len) final;
     zx_status_t AttachRemote(fs::MountChannel h) final;
+    // Creates vmo_ and loads the file's block map, but none of its data;
+    // blocks are read into vmo_ by PopulateVmo() as they are needed.
     zx_status_t InitVmo();
+    // Reads any blocks in [start, end) which are not yet in vmo_, along with
+    // up to |ahead| blocks past them. Runs of blocks which are contiguous on
+    // disk are read with one request, and all of them in one transaction.
+    zx_status_t PopulateVmo(blk_t start, blk_t end, blk_t ahead = 0);
+    // Notes that blocks [start, end) of vmo_ hold the file's data. Blocks past
+    // those the file had when vmo_ was created always do, as they only ever
+    // hold data written through vmo_.
+    void SetPopulated(blk_t start, blk_t end) {
+        end = fbl::min(end, static_cast<blk_t>(populated_.size()));
+        if (start < end) {
+            populated_.Set(start, end);
+        }
+    }
+    // Returns how many blocks to read ahead for a read of [start, end),
+    // growing the window while reads are sequential.
+    blk_t ReadAheadWindow(blk_t start, blk_t end);
+
+    // Shared writable mappings hand out vmo_ itself, whose pages change
+    // without minfs seeing the writes. To tell which blocks need writing
+    // back, minfs keeps a hash of each block of the mapped range as it was
+    // last written back, and compares it with the block's current contents.
+    //
+    // Starts tracking the blocks of vmo_ below byte |end|.
+    zx_status_t TrackMapping(size_t end) __TA_REQUIRES(lock_);
+    // Returns the hash of block |n| of vmo_, which is zero for a block of
+    // zeroes, or one past the end of the file.
+    uint64_t HashBlock(blk_t n) const __TA_REQUIRES(lock_);
+    // Writes back the tracked blocks in [start, end) which have changed.
+    zx_status_t FlushMapped(blk_t start, blk_t end) __TA_REQUIRES(lock_);
     zx_status_t InitIndirectVmo();
 
     // Loads indirect blocks up to and including the doubly indirect block at |index|.
@@ -558,10 +646,18 @@ private:
 #ifdef __Fuchsia__
     // TODO(smklein): When we have can register MinFS as a pager service, and
     // it can properly handle pages faults on a vnode's contents, then we can
-    // avoid reading the entire file up-front. Until then, read the contents of
-    // a VMO into memory when it is read/written.
+    // avoid reading the file into a VMO on our own. Until then, blocks are
+    // read into the VMO as reads and writes touch them.
     zx::vmo vmo_{};
 
+    // One bit per block the file had when vmo_ was created, set once the
+    // block has been read into vmo_.
+    bitmap::RawBitmapGeneric<bitmap::DefaultStorage> populated_{};
+    // The block after the end of the last read, and the number of blocks to
+    // read ahead of the next one should it start there.
+    blk_t readahead_next_{};
+    blk_t readahead_window_{};
+
     // vmo_indirect_ contains all indirect and doubly indirect blocks in the following order:
     // First kMinfsIndirect blocks                                - initial set of indirect blocks
     // Next kMinfsDoublyIndirect blocks                           - doubly indirect blocks
@@ -574,8 +670,21 @@ private:
 
     fs::RemoteContainer remoter_{};
     fs::WatcherContainer watcher_{};
+
+    // Hashes of blocks [0, mapped_blocks_) of vmo_ as last written back,
+    // kept once the vnode has been mapped shared and writable.
+    fbl::unique_ptr<uint64_t[]> mapped_hashes_{};
+    blk_t mapped_blocks_{};
 #endif
 
+    // Guards the inode, block map and vmos of this vnode. Each connection
+    // issues one operation at a time, but connections are served by several
+    // threads, so operations on one vnode from different connections may
+    // arrive concurrently. Operations which also touch a second vnode only
+    // ever take a directory's lock before that of an entry in it, except
+    // renames between directories, which the Vfs runs alone.
+    fbl::Mutex lock_;
+
     ino_t ino_{};
     minfs_inode_t inode_{};
 
@@ -615,6 +724,10 @@ void minfs_dump_info(const minfs_info_t* info);
 void minfs_dump_inode(const minfs_inode_t* inode, ino_t ino);
 void minfs_dir_init(void* bdata, ino_t ino_self, ino_t ino_parent);
 
+// Writes the entries committed to the journal described by |info| in place,
+// and marks them replayed. Must run before the metadata is read.
+zx_status_t minfs_journal_replay(Bcache* bc, const minfs_info_t* info);
+
 // Given an input bcache, initialize the filesystem and return a reference to the
 // root node.
 zx_status_t minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinfs>* root_out);
@@ -79,6 +79,8 @@ void minfs_dump_info(const minfs_info_t* info) {
     xprintf("minfs: alloc bitmap @ %10u\n", info->abm_block);
     xprintf("minfs: inode table  @ %10u\n", info->ino_block);
     xprintf("minfs: data blocks  @ %10u\n", info->dat_block);
+    xprintf("minfs: journal      @ %10u (%u blocks)\n", info->journal_block,
+            info->journal_blocks);
     xprintf("minfs: FVM-aware: %s\n", (info->flags & kMinfsFlagFVM) ? "YES" : "NO");
 }
 
@@ -232,11 +234,24 @@ zx_status_t minfs_check_info(const minfs_info_t* info, Bcache* bc) {
             return ZX_ERR_INVALID_ARGS;
         }
     }
+    if ((info->journal_blocks != 0) &&
+        ((info->journal_blocks < kMinfsJournalMinBlocks) || (info->journal_block == 0) ||
+         (info->journal_blocks > info->block_count) ||
+         (info->journal_block > info->block_count - info->journal_blocks))) {
+        FS_TRACE_ERROR("minfs: journal %u+%u out of range\n", info->journal_block,
+                       info->journal_blocks);
+        return ZX_ERR_INVALID_ARGS;
+    }
     //TODO: validate layout
     return 0;
 }
 
 zx_status_t Minfs::InodeSync(WriteTxn* txn, ino_t ino, const minfs_inode_t* inode) {
+    fbl::AutoLock lock(&alloc_lock_);
+    return InodeSyncLocked(txn, ino, inode);
+}
+
+zx_status_t Minfs::InodeSyncLocked(WriteTxn* txn, ino_t ino, const minfs_inode_t* inode) {
     // Obtain the offset of the inode within its containing block
     const uint32_t off_of_ino = (ino % kMinfsInodesPerBlock) * kMinfsInodeSize;
     const blk_t inoblock_rel = ino / kMinfsInodesPerBlock;
@@ -259,7 +274,7 @@ zx_status_t Minfs::InodeSync(WriteTxn* txn, ino_t ino, const minfs_inode_t* inod
 }
 
 #ifdef __Fuchsia__
-void Minfs::Sync(SyncCallback closure) {
+void Minfs::Sync(WritebackWork::Closure closure) {
     fbl::unique_ptr<WritebackWork> wb(new WritebackWork(bc_.get()));
     wb->SetClosure(fbl::move(closure));
     EnqueueWork(fbl::move(wb));
@@ -301,6 +316,7 @@ Minfs::~Minfs() {
 
 zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
     TRACE_DURATION("minfs", "Minfs::InoFree", "ino", vn->ino_);
+    fbl::AutoLock lock(&alloc_lock_);
 #ifdef __Fuchsia__
     auto ibm_id = inode_map_.StorageUnsafe()->GetVmo();
 #else
@@ -315,6 +331,21 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
     txn->Enqueue(ibm_id, bitbno, info_.ibm_block + bitbno, 1);
     uint32_t block_count = vn->inode_.block_count;
 
+    if (vn->HasExtents()) {
+        const minfs_extent_t* extents = MinfsInodeExtents(&vn->inode_);
+        for (uint32_t i = 0; i < kMinfsInlineExtents && extents[i].count != 0; i++) {
+            for (uint32_t j = 0; j < extents[i].count; j++) {
+                ValidateBno(extents[i].start + j);
+                block_count--;
+                BlockFreeLocked(txn, extents[i].start + j);
+            }
+        }
+        CountUpdate(txn);
+        ZX_DEBUG_ASSERT(block_count == 0);
+        ZX_DEBUG_ASSERT(vn->IsUnlinked());
+        return ZX_OK;
+    }
+
     // release all direct blocks
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         if (vn->inode_.dnum[n] == 0) {
@@ -322,7 +353,7 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
         }
         ValidateBno(vn->inode_.dnum[n]);
         block_count--;
-        BlockFree(txn, vn->inode_.dnum[n]);
+        BlockFreeLocked(txn, vn->inode_.dnum[n]);
     }
 
 
@@ -351,11 +382,11 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
                 continue;
             }
             block_count--;
-            BlockFree(txn, entry[m]);
+            BlockFreeLocked(txn, entry[m]);
         }
         // release the direct block itself
         block_count--;
-        BlockFree(txn, vn->inode_.inum[n]);
+        BlockFreeLocked(txn, vn->inode_.inum[n]);
     }
 
     // release doubly indirect blocks
@@ -401,16 +432,16 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WriteTxn* txn) {
                 }
 
                 block_count--;
-                BlockFree(txn, entry[k]);
+                BlockFreeLocked(txn, entry[k]);
             }
 
             block_count--;
-            BlockFree(txn, dentry[m]);
+            BlockFreeLocked(txn, dentry[m]);
         }
 
         // release the doubly indirect block itself
         block_count--;
-        BlockFree(txn, vn->inode_.dinum[n]);
+        BlockFreeLocked(txn, vn->inode_.dinum[n]);
     }
 
     CountUpdate(txn);
@@ -574,6 +605,7 @@ zx_status_t Minfs::CreateFsId() {
 #endif
 
 zx_status_t Minfs::InoNew(WriteTxn* txn, const minfs_inode_t* inode, ino_t* ino_out) {
+    fbl::AutoLock lock(&alloc_lock_);
     size_t bitoff_start;
     zx_status_t status = inode_map_.Find(false, 0, inode_map_.size(), 1, &bitoff_start);
     if (status != ZX_OK) {
@@ -603,7 +635,7 @@ zx_status_t Minfs::InoNew(WriteTxn* txn, const minfs_inode_t* inode, ino_t* ino_
     // TODO(smklein): optional sanity check of both blocks
 
     // Write the inode back
-    if ((status = InodeSync(txn, ino, inode)) != ZX_OK) {
+    if ((status = InodeSyncLocked(txn, ino, inode)) != ZX_OK) {
         inode_map_.Clear(ino, ino + 1);
         info_.alloc_inode_count--;
         return status;
@@ -651,6 +683,10 @@ void Minfs::VnodeInsert(VnodeMinfs* vn) {
 #ifdef __Fuchsia__
     fbl::AutoLock lock(&hash_lock_);
 #endif
+    VnodeInsertLocked(vn);
+}
+
+void Minfs::VnodeInsertLocked(VnodeMinfs* vn) {
     ZX_DEBUG_ASSERT_MSG(!vnode_hash_.find(vn->GetKey()).IsValid(), "ino %u already in map\n",
                         vn->GetKey());
     vnode_hash_.insert(vn);
@@ -659,6 +695,12 @@ void Minfs::VnodeInsert(VnodeMinfs* vn) {
 fbl::RefPtr<VnodeMinfs> Minfs::VnodeLookup(uint32_t ino) {
 #ifdef __Fuchsia__
     fbl::AutoLock lock(&hash_lock_);
+#endif
+    return VnodeLookupLocked(ino);
+}
+
+fbl::RefPtr<VnodeMinfs> Minfs::VnodeLookupLocked(uint32_t ino) {
+#ifdef __Fuchsia__
     auto rawVn = vnode_hash_.find(ino);
     if (!rawVn.IsValid()) {
         // Nothing exists in the lookup table
@@ -693,7 +735,12 @@ zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
         return ZX_ERR_OUT_OF_RANGE;
     }
 
-    fbl::RefPtr<VnodeMinfs> vn = VnodeLookup(ino);
+#ifdef __Fuchsia__
+    // Hold the hash lock from the lookup until the insert, so that two
+    // threads looking up the same inode cannot both recreate it.
+    fbl::AutoLock lock(&hash_lock_);
+#endif
+    fbl::RefPtr<VnodeMinfs> vn = VnodeLookupLocked(ino);
     if (vn != nullptr) {
         *out = fbl::move(vn);
         return ZX_OK;
@@ -702,6 +749,7 @@ zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
     // obtain the block of the inode table we need
     uint32_t off_of_ino = (ino % kMinfsInodesPerBlock) * kMinfsInodeSize;
 #ifdef __Fuchsia__
+    fbl::AutoLock alloc_lock(&alloc_lock_);
     void* inodata = (void*)((uintptr_t)(inode_table_->GetData()) +
                             (uintptr_t)((ino / kMinfsInodesPerBlock) * kMinfsBlockSize));
 #else
@@ -715,13 +763,18 @@ zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
         return ZX_ERR_NO_MEMORY;
     }
 
-    VnodeInsert(vn.get());
+    VnodeInsertLocked(vn.get());
 
     *out = fbl::move(vn);
     return ZX_OK;
 }
 
 zx_status_t Minfs::BlockFree(WriteTxn* txn, blk_t bno) {
+    fbl::AutoLock lock(&alloc_lock_);
+    return BlockFreeLocked(txn, bno);
+}
+
+zx_status_t Minfs::BlockFreeLocked(WriteTxn* txn, blk_t bno) {
     ValidateBno(bno);
 
 #ifdef __Fuchsia__
@@ -742,6 +795,7 @@ zx_status_t Minfs::BlockFree(WriteTxn* txn, blk_t bno) {
 // If hint is nonzero it indicates which block number to start the search for
 // free blocks from.
 zx_status_t Minfs::BlockNew(WriteTxn* txn, blk_t hint, blk_t* out_bno) {
+    fbl::AutoLock lock(&alloc_lock_);
     size_t bitoff_start;
     zx_status_t status;
     if ((status = block_map_.Find(false, hint, block_map_.size(), 1, &bitoff_start)) != ZX_OK) {
@@ -916,7 +970,7 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const minfs_info_t* info,
         return status;
     }
 
-    if ((status = WritebackBuffer::Create(fs->bc_.get(), fbl::move(buffer),
+    if ((status = WritebackBuffer::Create(fs->bc_.get(), fbl::move(buffer), &fs->info_,
                                           &fs->writeback_)) != ZX_OK) {
         return status;
     }
@@ -956,6 +1010,20 @@ zx_status_t minfs_mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinf
         return status;
     }
     const minfs_info_t* info = reinterpret_cast<minfs_info_t*>(blk);
+    if ((status = minfs_check_info(info, bc.get())) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: mount failed\n");
+        return status;
+    }
+
+    // Replaying may rewrite the info block itself.
+    if ((status = minfs_journal_replay(bc.get(), info)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not replay journal\n");
+        return status;
+    }
+    if ((status = bc->Readblk(0, &blk)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not read info block\n");
+        return status;
+    }
 
     fbl::RefPtr<Minfs> fs;
     if ((status = Minfs::Create(fbl::move(bc), info, &fs)) != ZX_OK) {
@@ -1112,6 +1180,13 @@ zx_status_t Mkfs(fbl::unique_ptr<Bcache> bc) {
         info.dat_block = kFVMBlockDataStart;
     }
 
+    // Reserve the journal right after the root directory.
+    uint32_t journal_blocks = fbl::min(kMinfsJournalBlocks, info.block_count / 16);
+    if (journal_blocks >= kMinfsJournalMinBlocks) {
+        info.journal_block = 2;
+        info.journal_blocks = journal_blocks;
+    }
+
     minfs_dump_info(&info);
 
     RawBitmap abm;
@@ -1158,6 +1233,21 @@ zx_status_t Mkfs(fbl::unique_ptr<Bcache> bc) {
     abm.Set(0, 2);
     info.alloc_block_count++;
 
+    if (info.journal_blocks != 0) {
+        abm.Set(info.journal_block, info.journal_block + info.journal_blocks);
+        info.alloc_block_count += info.journal_blocks;
+
+        // An empty journal: the info block, and no entry where the first
+        // one would go.
+        memset(blk, 0, sizeof(blk));
+        bc->Writeblk(info.dat_block + info.journal_block + 1, blk);
+        minfs_journal_info_t* jinfo = reinterpret_cast<minfs_journal_info_t*>(blk);
+        jinfo->magic = kMinfsJournalMagic;
+        jinfo->sequence = 1;
+        jinfo->start = 1;
+        bc->Writeblk(info.dat_block + info.journal_block, blk);
+    }
+
     // write allocation bitmap
     for (uint32_t n = 0; n < abmblks; n++) {
         void* bmdata = fs::GetBlock<kMinfsBlockSize>(abm.StorageUnsafe()->GetData(), n);
@@ -1226,6 +1316,20 @@ zx_status_t Minfs::ReadDat(blk_t bno, void* data) {
 #endif
 }
 
+zx_status_t Minfs::ReadDatUncached(blk_t bno, void* data) {
+#ifdef __Fuchsia__
+    return bc_->ReadblkUncached(info_.dat_block + bno, data);
+#else
+    if (bno >= info_.block_count) {
+        return ZX_ERR_OUT_OF_RANGE;
+    } else if (bno >= dat_block_count_) {
+        memset(data, 0, kMinfsBlockSize);
+        return ZX_OK;
+    }
+    return bc_->ReadblkUncached(dat_start_block_ + bno, data);
+#endif
+}
+
 #ifndef __Fuchsia__
 zx_status_t Minfs::ReadBlk(blk_t bno, blk_t start, blk_t soft_max, blk_t hard_max, void* data) {
     if (bno >= hard_max) {
@@ -10,6 +10,7 @@ MODULE_TYPE := userlib
 
 COMMON_SRCS := \
     $(LOCAL_DIR)/bcache.cpp \
+    $(LOCAL_DIR)/journal.cpp \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/vnode.cpp \
     $(LOCAL_DIR)/writeback.cpp \
@@ -25,12 +26,14 @@ MODULE_STATIC_LIBS := \
     system/ulib/async \
     system/ulib/async.loop-cpp \
     system/ulib/async.loop \
+    system/ulib/block-client.cpp \
     system/ulib/block-client \
     system/ulib/trace \
     system/ulib/zx \
     system/ulib/zxcpp \
     system/ulib/fbl \
     system/ulib/sync \
+    third_party/ulib/cksum \
 
 MODULE_LIBS := \
     system/ulib/async.default \
@@ -48,6 +51,7 @@ MODULE_HOST_SRCS := \
     system/ulib/bitmap/raw-bitmap.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/fs/vnode.cpp \
+    third_party/ulib/cksum/crc32.c \
 
 MODULE_HOST_COMPILEFLAGS := \
     -Werror-implicit-function-declaration \
@@ -57,6 +61,7 @@ MODULE_HOST_COMPILEFLAGS := \
     -Isystem/ulib/fdio/include \
     -Isystem/ulib/fbl/include \
     -Isystem/ulib/fs/include \
+    -Ithird_party/ulib/cksum/include \
 
 # host minfs lib
 
@@ -68,6 +73,9 @@ MODULE_SRCS := $(MODULE_HOST_SRCS)
 
 MODULE_COMPILEFLAGS := $(MODULE_HOST_COMPILEFLAGS)
 
+# crc32.c has old-style declarations
+MODULE_CFLAGS := -Wno-strict-prototypes
+
 MODULE_HOST_LIBS := \
     system/ulib/fbl.hostlib
 
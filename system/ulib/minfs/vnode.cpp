@@ -16,6 +16,7 @@
 
 #ifdef __Fuchsia__
 #include <zircon/syscalls.h>
+#include <fdio/remoteio.h>
 #include <fdio/vfs.h>
 #include <fbl/auto_lock.h>
 #endif
@@ -31,6 +32,13 @@
 
 namespace {
 
+#ifdef __Fuchsia__
+// Bounds of the read-ahead window, in blocks. The window starts at the
+// minimum and doubles with each sequential read, up to the maximum.
+constexpr uint32_t kReadAheadMin = 4;
+constexpr uint32_t kReadAheadMax = 64;
+#endif
+
 zx_time_t minfs_gettime_utc() {
     // linux/zircon compatible
     struct timespec ts;
@@ -65,6 +73,86 @@ zx_status_t VnodeMinfs::VmoWriteExact(const void* data, uint64_t offset, size_t
     }
     return ZX_OK;
 }
+
+uint64_t VnodeMinfs::HashBlock(blk_t n) const {
+    uint64_t block[kMinfsBlockSize / sizeof(uint64_t)];
+    if (n >= fbl::round_up(inode_.size, kMinfsBlockSize) / kMinfsBlockSize ||
+        VmoReadExact(block, n * kMinfsBlockSize, kMinfsBlockSize) != ZX_OK) {
+        return 0;
+    }
+    // Not cryptographic; a collision only costs a write back of a block the
+    // mapping changed. A block of zeroes hashes to zero.
+    uint64_t hash = 0;
+    for (size_t i = 0; i < countof(block); i++) {
+        hash = (hash ^ block[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+zx_status_t VnodeMinfs::TrackMapping(size_t end) {
+    const blk_t blocks = static_cast<blk_t>(fbl::round_up(end, kMinfsBlockSize) /
+                                            kMinfsBlockSize);
+    if (blocks <= mapped_blocks_) {
+        return ZX_OK;
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint64_t[]> hashes(new (&ac) uint64_t[blocks]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (blk_t n = 0; n < blocks; n++) {
+        hashes[n] = (n < mapped_blocks_) ? mapped_hashes_[n] : HashBlock(n);
+    }
+    mapped_hashes_ = fbl::move(hashes);
+    mapped_blocks_ = blocks;
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::FlushMapped(blk_t start, blk_t end) {
+    const blk_t file_blocks = static_cast<blk_t>(fbl::round_up(inode_.size, kMinfsBlockSize) /
+                                                 kMinfsBlockSize);
+    end = fbl::min(end, fbl::min(mapped_blocks_, file_blocks));
+    if (start >= end) {
+        return ZX_OK;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(fs_->bc_.get()));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    bool dirty = false;
+    for (blk_t n = start; n < end; n++) {
+        uint64_t hash = HashBlock(n);
+        if (hash == mapped_hashes_[n]) {
+            continue;
+        }
+        zx_status_t status;
+        size_t tail = inode_.size % kMinfsBlockSize;
+        if ((n == file_blocks - 1) && (tail != 0)) {
+            // Anything written through the mapping past the end of the file
+            // is dropped, keeping the tail of vmo_ zeroed.
+            char zeroes[kMinfsBlockSize] = {};
+            if ((status = VmoWriteExact(zeroes, inode_.size, kMinfsBlockSize - tail)) != ZX_OK) {
+                return status;
+            }
+            hash = HashBlock(n);
+        }
+        blk_t bno;
+        if ((status = BlockGet(wb->txn(), n, &bno)) != ZX_OK) {
+            return status;
+        }
+        wb->txn()->Enqueue(vmo_.get(), n, bno + fs_->info_.dat_block, 1);
+        mapped_hashes_[n] = hash;
+        dirty = true;
+    }
+    if (dirty) {
+        InodeSync(wb->txn(), kMxFsSyncMtime);
+        wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
+        fs_->EnqueueWork(fbl::move(wb));
+    }
+    return ZX_OK;
+}
 #endif
 
 void VnodeMinfs::SetIno(ino_t ino) {
@@ -92,6 +180,9 @@ void VnodeMinfs::InodeSync(WriteTxn* txn, uint32_t flags) {
 // the file. Does not update mtime/atime.
 zx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, blk_t start) {
     ZX_DEBUG_ASSERT(txn != nullptr);
+    if (HasExtents()) {
+        return ExtentShrink(txn, start);
+    }
     bop_params_t boparams(start, static_cast<blk_t>(kMinfsMaxFileBlock - start), nullptr);
     zx_status_t status;
     if ((status = BlockOp(txn, DELETE, &boparams)) != ZX_OK) {
@@ -200,12 +291,9 @@ zx_status_t VnodeMinfs::InitIndirectVmo() {
 }
 
 // Since we cannot yet register the filesystem as a paging service (and cleanly
-// fault on pages when they are actually needed), we currently read an entire
-// file to a VMO when a file's data block are accessed.
-//
-// TODO(smklein): Even this hack can be optimized; a bitmap could be used to
-// track all 'empty/read/dirty' blocks for each vnode, rather than reading
-// the entire file.
+// fault on pages when they are actually needed), a file's data is read into a
+// VMO as it is accessed. InitVmo only sets up the VMO and the block map; the
+// data blocks are read in by PopulateVmo.
 zx_status_t VnodeMinfs::InitVmo() {
     if (vmo_.is_valid()) {
         return ZX_OK;
@@ -213,6 +301,9 @@ zx_status_t VnodeMinfs::InitVmo() {
 
     zx_status_t status;
     const size_t vmo_size = fbl::round_up(inode_.size, kMinfsBlockSize);
+    if ((status = populated_.Reset(vmo_size / kMinfsBlockSize)) != ZX_OK) {
+        return status;
+    }
     if ((status = zx::vmo::create(vmo_size, 0, &vmo_)) != ZX_OK) {
         FS_TRACE_ERROR("Failed to initialize vmo; error: %d\n", status);
         return status;
@@ -224,88 +315,93 @@ zx_status_t VnodeMinfs::InitVmo() {
         vmo_.reset();
         return status;
     }
-    ReadTxn txn(fs_->bc_.get());
+    readahead_next_ = 0;
+    readahead_window_ = 0;
 
-    // Initialize all direct blocks
-    blk_t bno;
-    for (uint32_t d = 0; d < kMinfsDirect; d++) {
-        if ((bno = inode_.dnum[d]) != 0) {
-            fs_->ValidateBno(bno);
-            txn.Enqueue(vmoid_, d, bno + fs_->info_.dat_block, 1);
-        }
+    if (HasExtents()) {
+        // The extents are all in the inode.
+        ValidateVmoTail();
+        return ZX_OK;
     }
 
-    // Initialize all indirect blocks
+    // Load the indirect blocks, and those within the doubly indirect blocks,
+    // so that lookups in the block map can be made without reading more.
     for (uint32_t i = 0; i < kMinfsIndirect; i++) {
-        blk_t ibno;
-        if ((ibno = inode_.inum[i]) != 0) {
-            fs_->ValidateBno(ibno);
+        if (inode_.inum[i] != 0) {
+            fs_->ValidateBno(inode_.inum[i]);
 
             // Only initialize the indirect vmo if it is being used.
             if ((status = InitIndirectVmo()) != ZX_OK) {
                 vmo_.reset();
                 return status;
             }
-
-            uint32_t* ientry;
-            ReadIndirectVmoBlock(i, &ientry);
-
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                if ((bno = ientry[j]) != 0) {
-                    fs_->ValidateBno(bno);
-                    uint32_t n = kMinfsDirect + i * kMinfsDirectPerIndirect + j;
-                    txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
-                }
-            }
+            break;
         }
     }
 
-    // Initialize all doubly indirect blocks
     for (uint32_t i = 0; i < kMinfsDoublyIndirect; i++) {
-        blk_t dibno;
-
-        if ((dibno = inode_.dinum[i]) != 0) {
-            fs_->ValidateBno(dibno);
+        if (inode_.dinum[i] != 0) {
+            fs_->ValidateBno(inode_.dinum[i]);
 
             // Only initialize the doubly indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != ZX_OK) {
+            if ((status = InitIndirectVmo()) != ZX_OK ||
+                (status = LoadIndirectWithinDoublyIndirect(i)) != ZX_OK) {
                 vmo_.reset();
                 return status;
             }
+        }
+    }
 
-            uint32_t* dientry;
-            ReadIndirectVmoBlock(GetVmoOffsetForDoublyIndirect(i), &dientry);
-
-            for (uint32_t j = 0; j < kMinfsDirectPerIndirect; j++) {
-                blk_t ibno;
-                if ((ibno = dientry[j]) != 0) {
-                    fs_->ValidateBno(ibno);
-
-                    // Only initialize the indirect vmo if it is being used.
-                    if ((status = LoadIndirectWithinDoublyIndirect(i)) != ZX_OK) {
-                        vmo_.reset();
-                        return status;
-                    }
+    ValidateVmoTail();
+    return ZX_OK;
+}
 
-                    uint32_t* ientry;
-                    ReadIndirectVmoBlock(GetVmoOffsetForIndirect(i) + j, &ientry);
+zx_status_t VnodeMinfs::PopulateVmo(blk_t start, blk_t end, blk_t ahead) {
+    const blk_t limit = static_cast<blk_t>(populated_.size());
+    end = fbl::min(end, limit);
+    if (start >= end || populated_.Get(start, end)) {
+        return ZX_OK;
+    }
+    end = static_cast<blk_t>(fbl::min(static_cast<size_t>(end) + ahead,
+                                      static_cast<size_t>(limit)));
 
-                    for (uint32_t k = 0; k < kMinfsDirectPerIndirect; k++) {
-                        if ((bno = ientry[k]) != 0) {
-                            fs_->ValidateBno(bno);
-                            uint32_t n = kMinfsDirect + kMinfsIndirect * kMinfsDirectPerIndirect
-                                         + j * kMinfsDirectPerIndirect + k;
-                            txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
-                        }
-                    }
-                }
+    zx_status_t status;
+    ReadTxn txn(fs_->bc_.get());
+    size_t n = populated_.Scan(start, end, true);
+    while (n < end) {
+        // [n, run_end) is a run of blocks which have not been read in yet.
+        size_t run_end = populated_.Scan(n, end, false);
+        for (; n < run_end; n++) {
+            blk_t bno;
+            if ((status = BlockGet(nullptr, static_cast<blk_t>(n), &bno)) != ZX_OK) {
+                return status;
+            }
+            // Unallocated blocks read as the zeroes already in vmo_.
+            if (bno != 0) {
+                fs_->ValidateBno(bno);
+                txn.Enqueue(vmoid_, n, bno + fs_->info_.dat_block, 1);
             }
         }
+        n = populated_.Scan(run_end, end, true);
     }
 
-    status = txn.Flush();
-    ValidateVmoTail();
-    return status;
+    if ((status = txn.Flush()) != ZX_OK) {
+        return status;
+    }
+    populated_.Set(start, end);
+    return ZX_OK;
+}
+
+blk_t VnodeMinfs::ReadAheadWindow(blk_t start, blk_t end) {
+    if (start <= readahead_next_ && readahead_next_ <= end) {
+        // This read picks up where the last one left off.
+        readahead_window_ = (readahead_window_ == 0) ? kReadAheadMin :
+                            fbl::min(readahead_window_ * 2, kReadAheadMax);
+    } else {
+        readahead_window_ = 0;
+    }
+    readahead_next_ = end;
+    return readahead_window_;
 }
 #endif
 
@@ -364,6 +460,13 @@ zx_status_t VnodeMinfs::BlockOpDirect(WriteTxn *txn, DirectArgs* params) {
                 params->SetBno(i, bno);
                 break;
             }
+            case SET: {
+                ZX_DEBUG_ASSERT(txn != nullptr);
+                ZX_DEBUG_ASSERT(bno == 0);
+                fs_->ValidateBno(params->GetSetBno(i));
+                params->SetBno(i, params->GetSetBno(i));
+                break;
+            }
             default: {
                 return ZX_ERR_NOT_SUPPORTED;
             }
@@ -378,7 +481,7 @@ zx_status_t VnodeMinfs::BlockOpIndirect(WriteTxn* txn, IndirectArgs* params) {
     zx_status_t status;
 
 #ifdef __Fuchsia__
-    if (params->GetOp() == READ || params->GetOp() == WRITE) {
+    if (params->GetOp() == READ || params->GetOp() == WRITE || params->GetOp() == SET) {
         validate_vmo_size(vmo_indirect_->GetVmo(), params->GetOffset() + params->GetCount());
     }
 #endif
@@ -392,6 +495,7 @@ zx_status_t VnodeMinfs::BlockOpIndirect(WriteTxn* txn, IndirectArgs* params) {
             case READ:
                 return ZX_OK;
             case WRITE:
+            case SET:
                 if ((status = AllocateIndirect(txn, i, params)) != ZX_OK) {
                     return status;
                 }
@@ -443,7 +547,7 @@ zx_status_t VnodeMinfs::BlockOpDindirect(WriteTxn* txn, DindirectArgs* params) {
     zx_status_t status;
 
 #ifdef __Fuchsia__
-    if (params->GetOp() == READ || params->GetOp() == WRITE) {
+    if (params->GetOp() == READ || params->GetOp() == WRITE || params->GetOp() == SET) {
         validate_vmo_size(vmo_indirect_->GetVmo(), params->GetOffset() + params->GetCount());
     }
 #endif
@@ -458,6 +562,7 @@ zx_status_t VnodeMinfs::BlockOpDindirect(WriteTxn* txn, DindirectArgs* params) {
             case READ:
                 return ZX_OK;
             case WRITE:
+            case SET:
                 if ((status = AllocateIndirect(txn, i, params)) != ZX_OK) {
                     return status;
                 }
@@ -635,6 +740,20 @@ zx_status_t VnodeMinfs::BlockOp(WriteTxn* txn, blk_op_t op, bop_params_t* bopara
 }
 
 zx_status_t VnodeMinfs::BlockGet(WriteTxn* txn, blk_t n, blk_t* bno) {
+    if (HasExtents()) {
+        zx_status_t status = ExtentGet(txn, n, bno);
+        if (status != ZX_ERR_NO_RESOURCES) {
+            return status;
+        }
+        // Too fragmented for the inline extents; use the block map from now on.
+        if ((status = ExtentsToBlockMap(txn)) != ZX_OK) {
+            return status;
+        }
+    }
+    return BlockMapGet(txn, txn ? WRITE : READ, n, bno);
+}
+
+zx_status_t VnodeMinfs::BlockMapGet(WriteTxn* txn, blk_op_t op, blk_t n, blk_t* bno) {
 #ifdef __Fuchsia__
     if (n >= kMinfsDirect) {
         zx_status_t status;
@@ -661,7 +780,120 @@ zx_status_t VnodeMinfs::BlockGet(WriteTxn* txn, blk_t n, blk_t* bno) {
 #endif
 
     bop_params_t boparams(n, 1, bno);
-    return BlockOp(txn, txn ? WRITE : READ, &boparams);
+    return BlockOp(txn, op, &boparams);
+}
+
+zx_status_t VnodeMinfs::ExtentGet(WriteTxn* txn, blk_t n, blk_t* bno) {
+    minfs_extent_t* extents = MinfsInodeExtents(&inode_);
+    uint32_t used = 0;
+    uint32_t next = kMinfsInlineExtents;
+    for (; used < kMinfsInlineExtents && extents[used].count != 0; used++) {
+        const minfs_extent_t& e = extents[used];
+        if (n >= e.fblock && n - e.fblock < e.count) {
+            *bno = e.start + (n - e.fblock);
+            return ZX_OK;
+        } else if (e.fblock > n && next == kMinfsInlineExtents) {
+            next = used;
+        }
+    }
+    if (txn == nullptr) {
+        *bno = 0;
+        return ZX_OK;
+    }
+    if (next == kMinfsInlineExtents) {
+        next = used;
+    }
+
+    // Ask for the block where it would be if the file was contiguous on
+    // disk since the extent before it, so sequential writes grow one extent.
+    minfs_extent_t* prev = (next > 0) ? &extents[next - 1] : nullptr;
+    blk_t hint = (prev != nullptr) ? prev->start + (n - prev->fblock) : 0;
+    if (hint >= fs_->info_.block_count) {
+        hint = 0;
+    }
+    blk_t new_bno;
+    zx_status_t status;
+    if ((status = fs_->BlockNew(txn, hint, &new_bno)) != ZX_OK) {
+        return status;
+    }
+
+    minfs_extent_t* after = (next < used) ? &extents[next] : nullptr;
+    if ((prev != nullptr) && (prev->fblock + prev->count == n) &&
+        (prev->start + prev->count == new_bno)) {
+        prev->count++;
+        if ((after != nullptr) && (after->fblock == n + 1) && (after->start == new_bno + 1)) {
+            // The new block joins two extents.
+            prev->count += after->count;
+            memmove(after, after + 1, (used - next - 1) * sizeof(minfs_extent_t));
+            memset(&extents[used - 1], 0, sizeof(minfs_extent_t));
+        }
+    } else if ((after != nullptr) && (after->fblock == n + 1) && (after->start == new_bno + 1)) {
+        after->fblock--;
+        after->start--;
+        after->count++;
+    } else if (used < kMinfsInlineExtents) {
+        memmove(&extents[next + 1], &extents[next], (used - next) * sizeof(minfs_extent_t));
+        extents[next].fblock = n;
+        extents[next].start = new_bno;
+        extents[next].count = 1;
+    } else {
+        fs_->BlockFree(txn, new_bno);
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    inode_.block_count++;
+    InodeSync(txn, kMxFsSyncDefault);
+    *bno = new_bno;
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentShrink(WriteTxn* txn, blk_t start) {
+    minfs_extent_t* extents = MinfsInodeExtents(&inode_);
+    bool dirty = false;
+    for (uint32_t i = 0; i < kMinfsInlineExtents && extents[i].count != 0; i++) {
+        minfs_extent_t* e = &extents[i];
+        if (e->fblock + e->count <= start) {
+            continue;
+        }
+        // Extents are sorted, so every one from here on ends past |start|.
+        uint32_t keep = (e->fblock < start) ? start - e->fblock : 0;
+        for (uint32_t j = keep; j < e->count; j++) {
+            fs_->ValidateBno(e->start + j);
+            fs_->BlockFree(txn, e->start + j);
+            inode_.block_count--;
+        }
+        if (keep == 0) {
+            memset(e, 0, sizeof(*e));
+        } else {
+            e->count = keep;
+        }
+        dirty = true;
+    }
+    if (dirty) {
+        InodeSync(txn, kMxFsSyncDefault);
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::ExtentsToBlockMap(WriteTxn* txn) {
+    ZX_DEBUG_ASSERT(txn != nullptr);
+    TRACE_DURATION("minfs", "VnodeMinfs::ExtentsToBlockMap", "ino", ino_);
+    minfs_extent_t extents[kMinfsInlineExtents];
+    memcpy(extents, MinfsInodeExtents(&inode_), sizeof(extents));
+    memset(inode_.dnum, 0, sizeof(extents));
+    inode_.flags &= ~kMinfsInodeFlagExtents;
+
+    for (uint32_t i = 0; i < kMinfsInlineExtents && extents[i].count != 0; i++) {
+        for (uint32_t j = 0; j < extents[i].count; j++) {
+            blk_t bno = extents[i].start + j;
+            zx_status_t status;
+            if ((status = BlockMapGet(txn, SET, extents[i].fblock + j, &bno)) != ZX_OK) {
+                return status;
+            }
+        }
+    }
+    InodeSync(txn, kMxFsSyncDefault);
+    return ZX_OK;
 }
 
 // Immediately stop iterating over the directory.
@@ -762,8 +994,8 @@ zx_status_t VnodeMinfs::UnlinkChild(WritebackWork* wb,
     // Verify they are free and small enough to merge.
     size_t coalesced_size = MinfsReclen(de, off);
     // Coalesce with "next" first, so the kMinfsReclenLast bit can easily flow
-    // back to "de" and "de_prev".
-    if (!(de->reclen & kMinfsReclenLast)) {
+    // back to "de" and "de_prev". Records never merge across hash buckets.
+    if (!(de->reclen & kMinfsReclenLast) && (off_next < offs->off_limit)) {
         size_t len = MINFS_DIRENT_SIZE;
         if ((status = ReadExactInternal(&de_next, len, off_next)) != ZX_OK) {
             FS_TRACE_ERROR("unlink: Failed to read next dirent\n");
@@ -805,7 +1037,7 @@ zx_status_t VnodeMinfs::UnlinkChild(WritebackWork* wb,
         return status;
     }
 
-    if (de->reclen & kMinfsReclenLast) {
+    if ((de->reclen & kMinfsReclenLast) && (inode_.dir_hash_bits == 0)) {
         // Truncating the directory merely removed unused space; if it fails,
         // the directory contents are still valid.
         TruncateInternal(wb->txn(), off + MINFS_DIRENT_SIZE);
@@ -859,6 +1091,9 @@ zx_status_t VnodeMinfs::DirentCallbackUnlink(fbl::RefPtr<VnodeMinfs> vndir, minf
     if ((args->type == kMinfsTypeDir) && !vn->IsDirectory()) {
         return ZX_ERR_NOT_DIR;
     }
+    // Hold the child's lock from checking that it is empty until it is
+    // unlinked, so nothing can be created in it meanwhile.
+    fbl::AutoLock lock(&vn->lock_);
     if ((status = vn->CanUnlink()) != ZX_OK) {
         return status;
     }
@@ -877,6 +1112,7 @@ zx_status_t VnodeMinfs::DirentCallbackForceUnlink(fbl::RefPtr<VnodeMinfs> vndir,
     if ((status = vndir->fs_->VnodeGet(&vn, de->ino)) < 0) {
         return status;
     }
+    fbl::AutoLock lock(&vn->lock_);
     return vndir->UnlinkChild(args->wb, fbl::move(vn), de, offs);
 }
 
@@ -900,13 +1136,16 @@ zx_status_t VnodeMinfs::DirentCallbackAttemptRename(fbl::RefPtr<VnodeMinfs> vndi
     zx_status_t status;
     if ((status = vndir->fs_->VnodeGet(&vn, de->ino)) < 0) {
         return status;
-    } else if (args->ino == vn->ino_) {
+    }
+    if (args->ino == vn->ino_) {
         // cannot rename node to itself
         return ZX_ERR_BAD_STATE;
     } else if (args->type != de->type) {
         // cannot rename directory to file (or vice versa)
         return ZX_ERR_BAD_STATE;
-    } else if ((status = vn->CanUnlink()) != ZX_OK) {
+    }
+    fbl::AutoLock lock(&vn->lock_);
+    if ((status = vn->CanUnlink()) != ZX_OK) {
         // if we cannot unlink the target, we cannot rename the target
         return status;
     }
@@ -968,7 +1207,9 @@ zx_status_t VnodeMinfs::DirentCallbackAppend(fbl::RefPtr<VnodeMinfs> vndir, minf
         return DIR_CB_SAVE_SYNC;
     };
 
-    uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, offs->off));
+    // The last record of a hashed directory reaches past its bucket.
+    uint32_t reclen = static_cast<uint32_t>(fbl::min<size_t>(MinfsReclen(de, offs->off),
+                                                             offs->off_limit - offs->off));
     if (de->ino == 0) {
         // empty entry, do we fit?
         if (args->reclen > reclen) {
@@ -1022,8 +1263,16 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     DirectoryOffset offs = {
         .off = 0,
         .off_prev = 0,
+        .off_limit = kMinfsMaxDirectorySize,
     };
-    while (offs.off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
+    if (inode_.dir_hash_bits != 0) {
+        uint32_t bucket = MinfsDirBucket(inode_.dir_hash_bits, args->name.data(),
+                                         args->name.length());
+        offs.off = MinfsDirBucketStart(bucket);
+        offs.off_prev = offs.off;
+        offs.off_limit = MinfsDirBucketEnd(bucket);
+    }
+    while (offs.off + MINFS_DIRENT_SIZE < offs.off_limit) {
         xprintf("Reading dirent at offset %zd\n", offs.off);
         size_t r;
         zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, offs.off, &r);
@@ -1031,6 +1280,10 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
             return status;
         } else if ((status = validate_dirent(de, r, offs.off)) != ZX_OK) {
             return status;
+        } else if (!(de->reclen & kMinfsReclenLast) &&
+                   (offs.off + MinfsReclen(de, offs.off) > offs.off_limit)) {
+            FS_TRACE_ERROR("vn_dir: dirent at offset %zd crosses its hash bucket\n", offs.off);
+            return ZX_ERR_IO;
         }
 
         switch ((status = func(fbl::RefPtr<VnodeMinfs>(this), de, args, &offs))) {
@@ -1049,6 +1302,134 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     return ZX_ERR_NOT_FOUND;
 }
 
+zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
+    if ((inode_.dir_hash_bits == 0) && (inode_.dirent_count > kMinfsDirHashMinEntries)) {
+        // If the entries cannot be hashed, the directory stays linear.
+        DirHashRebuild(1);
+    }
+
+    zx_status_t status;
+    while (((status = ForEachDirent(args, DirentCallbackAppend)) == ZX_ERR_NOT_FOUND) &&
+           (inode_.dir_hash_bits != 0) && (inode_.dir_hash_bits < kMinfsDirHashMaxBits)) {
+        // The bucket for this name is full.
+        if ((status = DirHashRebuild(inode_.dir_hash_bits + 1)) != ZX_OK) {
+            return status;
+        }
+    }
+    return status;
+}
+
+zx_status_t VnodeMinfs::DirHashRebuild(uint32_t bits) {
+    TRACE_DURATION("minfs", "VnodeMinfs::DirHashRebuild", "ino", ino_, "bits", bits);
+    fbl::AllocChecker ac;
+    const size_t old_size = inode_.size;
+    fbl::unique_ptr<uint8_t[]> old_data(new (&ac) uint8_t[old_size]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status;
+    if ((status = ReadExactInternal(old_data.get(), old_size, 0)) != ZX_OK) {
+        return status;
+    }
+
+    // Lay the live entries out in as few buckets as they fit in.
+    constexpr size_t kNoRecord = SIZE_MAX;
+    size_t fill[1 << kMinfsDirHashMaxBits];
+    size_t last[1 << kMinfsDirHashMaxBits];
+    fbl::unique_ptr<uint8_t[]> new_data;
+    size_t new_size = 0;
+    for (; bits <= kMinfsDirHashMaxBits; bits++) {
+        const uint32_t buckets = 1u << bits;
+        new_size = MinfsDirBucketEnd(buckets - 1);
+        new_data.reset(new (&ac) uint8_t[new_size]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        memset(new_data.get(), 0, new_size);
+        for (uint32_t b = 0; b < buckets; b++) {
+            fill[b] = MinfsDirBucketStart(b);
+            last[b] = kNoRecord;
+        }
+
+        bool fits = true;
+        size_t off = 0;
+        while (off + MINFS_DIRENT_SIZE <= old_size) {
+            minfs_dirent_t* de = reinterpret_cast<minfs_dirent_t*>(&old_data[off]);
+            if ((status = validate_dirent(de, old_size - off, off)) != ZX_OK) {
+                return status;
+            }
+            if (de->ino != 0) {
+                uint32_t size = DirentSize(de->namelen);
+                uint32_t b = MinfsDirBucket(bits, de->name, de->namelen);
+                if ((off + size > old_size) || (size > MinfsReclen(de, off))) {
+                    return ZX_ERR_IO;
+                } else if (fill[b] + size > MinfsDirBucketEnd(b)) {
+                    fits = false;
+                    break;
+                }
+                memcpy(&new_data[fill[b]], de, size);
+                reinterpret_cast<minfs_dirent_t*>(&new_data[fill[b]])->reclen = size;
+                last[b] = fill[b];
+                fill[b] += size;
+            }
+            if (de->reclen & kMinfsReclenLast) {
+                break;
+            }
+            off += MinfsReclen(de, off);
+        }
+        if (!fits) {
+            continue;
+        }
+
+        // Stretch the last record of each bucket to the end of the bucket,
+        // leaving an empty record in buckets with no entries.
+        for (uint32_t b = 0; b < buckets; b++) {
+            if (last[b] == kNoRecord) {
+                last[b] = MinfsDirBucketStart(b);
+            }
+            minfs_dirent_t* de = reinterpret_cast<minfs_dirent_t*>(&new_data[last[b]]);
+            de->reclen = static_cast<uint32_t>(MinfsDirBucketEnd(b) - last[b]);
+        }
+        reinterpret_cast<minfs_dirent_t*>(&new_data[last[buckets - 1]])->reclen |=
+            kMinfsReclenLast;
+        break;
+    }
+    if (bits > kMinfsDirHashMaxBits) {
+        return ZX_ERR_NO_SPACE;
+    }
+
+    // Write the directory out a few blocks per transaction, remembering the
+    // new layout in the inode last. Like other multi-block updates, a crash
+    // partway through leaves the directory for fsck to report.
+    constexpr size_t kRebuildChunk = 4 * kMinfsBlockSize;
+    for (size_t off = 0; off < new_size; off += kRebuildChunk) {
+        fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(fs_->bc_.get()));
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        size_t len = fbl::min(kRebuildChunk, new_size - off);
+        if ((status = WriteExactInternal(wb->txn(), &new_data[off], len, off)) != ZX_OK) {
+            return status;
+        }
+        wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
+        fs_->EnqueueWork(fbl::move(wb));
+    }
+
+    fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(fs_->bc_.get()));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    if (old_size > new_size) {
+        TruncateInternal(wb->txn(), new_size);
+    }
+    inode_.dir_hash_bits = bits;
+    inode_.seq_num++;
+    InodeSync(wb->txn(), kMxFsSyncMtime);
+    wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
+    fs_->EnqueueWork(fbl::move(wb));
+    return ZX_OK;
+}
+
 void VnodeMinfs::fbl_recycle() {
     if (fd_count_ != 0 || !IsUnlinked()) {
         // If this node has not been purged already, remove it from the
@@ -1100,6 +1481,7 @@ zx_status_t VnodeMinfs::ValidateFlags(uint32_t flags) {
 }
 
 zx_status_t VnodeMinfs::Open(uint32_t flags, fbl::RefPtr<Vnode>* out_redirect) {
+    fbl::AutoLock lock(&lock_);
     fd_count_++;
     return ZX_OK;
 }
@@ -1113,7 +1495,8 @@ void VnodeMinfs::Purge(WriteTxn* txn) {
         fs_->VnodeReleaseLocked(this);
     }
     // TODO(smklein): Only init indirect vmo if it's needed
-    if (InitIndirectVmo() == ZX_OK) {
+    // The block map of an extent mapped file holds extents, not indirect blocks.
+    if (HasExtents() || InitIndirectVmo() == ZX_OK) {
         fs_->InoFree(this, txn);
     } else {
         fprintf(stderr, "minfs: Failed to Init Indirect VMO while purging %u\n", ino_);
@@ -1125,9 +1508,18 @@ void VnodeMinfs::Purge(WriteTxn* txn) {
 }
 
 zx_status_t VnodeMinfs::Close() {
+    fbl::AutoLock lock(&lock_);
     ZX_DEBUG_ASSERT_MSG(fd_count_ > 0, "Closing ino with no fds open");
     fd_count_--;
 
+#ifdef __Fuchsia__
+    if (fd_count_ == 0 && !IsUnlinked()) {
+        // Mappings may outlive the last connection; write back what they
+        // have changed so far.
+        FlushMapped(0, mapped_blocks_);
+    }
+#endif
+
     if (fd_count_ == 0 && IsUnlinked()) {
         fbl::unique_ptr<WritebackWork> wb(new WritebackWork(fs_->bc_.get()));
         Purge(wb->txn());
@@ -1138,6 +1530,7 @@ zx_status_t VnodeMinfs::Close() {
 
 zx_status_t VnodeMinfs::Read(void* data, size_t len, size_t off, size_t* out_actual) {
     TRACE_DURATION("minfs", "VnodeMinfs::Read", "ino", ino_, "len", len, "off", off);
+    fbl::AutoLock lock(&lock_);
     ZX_DEBUG_ASSERT_MSG(fd_count_ > 0, "Reading from ino with no fds open");
     xprintf("minfs_read() vn=%p(#%u) len=%zd off=%zd\n", this, ino_, len, off);
     if (IsDirectory()) {
@@ -1165,6 +1558,12 @@ zx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
 #ifdef __Fuchsia__
     if ((status = InitVmo()) != ZX_OK) {
         return status;
+    }
+    const blk_t start = static_cast<blk_t>(off / kMinfsBlockSize);
+    const blk_t end = static_cast<blk_t>(fbl::round_up(off + len, kMinfsBlockSize) /
+                                         kMinfsBlockSize);
+    if ((status = PopulateVmo(start, end, ReadAheadWindow(start, end))) != ZX_OK) {
+        return status;
     } else if ((status = vmo_.read(data, off, len, actual)) != ZX_OK) {
         return status;
     }
@@ -1208,6 +1607,12 @@ zx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
 
 zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset,
                               size_t* out_actual) {
+    fbl::AutoLock lock(&lock_);
+    return WriteLocked(data, len, offset, out_actual);
+}
+
+zx_status_t VnodeMinfs::WriteLocked(const void* data, size_t len, size_t offset,
+                                    size_t* out_actual) {
     TRACE_DURATION("minfs", "VnodeMinfs::Write", "ino", ino_, "len", len, "off", offset);
     ZX_DEBUG_ASSERT_MSG(fd_count_ > 0, "Writing to ino with no fds open");
     xprintf("minfs_write() vn=%p(#%u) len=%zd off=%zd\n", this, ino_, len, offset);
@@ -1234,7 +1639,10 @@ zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset,
 
 zx_status_t VnodeMinfs::Append(const void* data, size_t len, size_t* out_end,
                                size_t* out_actual) {
-    zx_status_t status = Write(data, len, inode_.size, out_actual);
+    // Hold the lock across the write so the end of file cannot move
+    // underneath an append.
+    fbl::AutoLock lock(&lock_);
+    zx_status_t status = WriteLocked(data, len, inode_.size, out_actual);
     *out_end = inode_.size;
     return status;
 }
@@ -1252,6 +1660,20 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
     if ((status = InitVmo()) != ZX_OK) {
         return status;
     }
+    // Blocks go back to disk whole, so those which are only partly
+    // overwritten must be read in first.
+    if (off % kMinfsBlockSize != 0) {
+        blk_t first = static_cast<blk_t>(off / kMinfsBlockSize);
+        if ((status = PopulateVmo(first, first + 1)) != ZX_OK) {
+            return status;
+        }
+    }
+    if ((off + len) % kMinfsBlockSize != 0 && off + len < kMinfsMaxFileSize) {
+        blk_t last = static_cast<blk_t>((off + len) / kMinfsBlockSize);
+        if ((status = PopulateVmo(last, last + 1)) != ZX_OK) {
+            return status;
+        }
+    }
 #else
     size_t max_size = off + len;
 #endif
@@ -1281,6 +1703,7 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
         if ((status = VmoWriteExact(data, xfer_off, xfer)) != ZX_OK) {
             goto done;
         }
+        SetPopulated(n, n + 1);
 
         // Update this block on-disk
         blk_t bno;
@@ -1289,6 +1712,10 @@ zx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
         }
         ZX_DEBUG_ASSERT(bno != 0);
         txn->Enqueue(vmo_.get(), n, bno + fs_->info_.dat_block, 1);
+        if (n < mapped_blocks_) {
+            // The whole block goes back, with any changes from mappings.
+            mapped_hashes_[n] = HashBlock(n);
+        }
 #else
         blk_t bno;
         if ((status = BlockGet(txn, n, &bno))) {
@@ -1344,6 +1771,7 @@ zx_status_t VnodeMinfs::Lookup(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    fbl::AutoLock lock(&lock_);
     return LookupInternal(out, name);
 }
 
@@ -1364,6 +1792,7 @@ zx_status_t VnodeMinfs::LookupInternal(fbl::RefPtr<fs::Vnode>* out, fbl::StringP
 
 zx_status_t VnodeMinfs::Getattr(vnattr_t* a) {
     xprintf("minfs_getattr() vn=%p(#%u)\n", this, ino_);
+    fbl::AutoLock lock(&lock_);
     a->mode = DTYPE_TO_VTYPE(MinfsMagicType(inode_.magic)) |
             V_IRUSR | V_IWUSR | V_IRGRP | V_IROTH;
     a->inode = ino_;
@@ -1382,6 +1811,7 @@ zx_status_t VnodeMinfs::Setattr(const vnattr_t* a) {
     if ((a->valid & ~(ATTR_CTIME|ATTR_MTIME)) != 0) {
         return ZX_ERR_NOT_SUPPORTED;
     }
+    fbl::AutoLock lock(&lock_);
     if ((a->valid & ATTR_CTIME) != 0) {
         inode_.create_time = a->create_time;
         dirty = 1;
@@ -1424,6 +1854,7 @@ zx_status_t VnodeMinfs::Readdir(fs::vdircookie_t* cookie, void* dirents, size_t
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    fbl::AutoLock lock(&lock_);
     size_t off = dc->off;
     size_t r;
     char data[kMinfsMaxDirentSize];
@@ -1510,6 +1941,9 @@ zx_status_t VnodeMinfs::Allocate(Minfs* fs, uint32_t type, fbl::RefPtr<VnodeMinf
     (*out)->inode_.magic = MinfsMagic(type);
     (*out)->inode_.create_time = (*out)->inode_.modify_time = minfs_gettime_utc();
     (*out)->inode_.link_count = (type == kMinfsTypeDir ? 2 : 1);
+    if (type == kMinfsTypeFile) {
+        (*out)->inode_.flags = kMinfsInodeFlagExtents;
+    }
     return ZX_OK;
 }
 
@@ -1532,6 +1966,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     if (!IsDirectory()) {
         return ZX_ERR_NOT_SUPPORTED;
     }
+    fbl::AutoLock lock(&lock_);
     if (IsUnlinked()) {
         return ZX_ERR_BAD_STATE;
     }
@@ -1576,7 +2011,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
     args.wb = wb.get();
-    if ((status = ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
@@ -1607,6 +2042,7 @@ zx_status_t VnodeMinfs::Ioctl(uint32_t op, const void* in_buf, size_t in_len, vo
 #ifdef __Fuchsia__
             info->fs_id = fs_->GetFsId();
 #endif
+            fbl::AutoLock lock(&fs_->alloc_lock_);
             info->total_bytes = fs_->info_.block_count * fs_->info_.block_size;
             info->used_bytes = fs_->info_.alloc_block_count * fs_->info_.block_size;
             info->total_nodes = fs_->info_.inode_count;
@@ -1661,6 +2097,7 @@ zx_status_t VnodeMinfs::Unlink(fbl::StringPiece name, bool must_be_dir) {
     if (!IsDirectory()) {
         return ZX_ERR_NOT_SUPPORTED;
     }
+    fbl::AutoLock lock(&lock_);
     fbl::AllocChecker ac;
     fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(fs_->bc_.get()));
     if (!ac.check()) {
@@ -1683,6 +2120,7 @@ zx_status_t VnodeMinfs::Truncate(size_t len) {
     if (IsDirectory()) {
         return ZX_ERR_NOT_FILE;
     }
+    fbl::AutoLock lock(&lock_);
 
     fbl::AllocChecker ac;
     fbl::unique_ptr<WritebackWork> wb(new (&ac) WritebackWork(fs_->bc_.get()));
@@ -1702,8 +2140,7 @@ zx_status_t VnodeMinfs::Truncate(size_t len) {
 zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
     zx_status_t r = 0;
 #ifdef __Fuchsia__
-    // TODO(smklein): We should only init up to 'len'; no need
-    // to read in the portion of a large file we plan on deleting.
+    // Only the block holding the new end of file is read in, below.
     if (InitVmo() != ZX_OK) {
         return ZX_ERR_IO;
     }
@@ -1737,6 +2174,9 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
             if (bno != 0) {
                 size_t adjust = len % kMinfsBlockSize;
 #ifdef __Fuchsia__
+                if ((r = PopulateVmo(rel_bno, rel_bno + 1)) != ZX_OK) {
+                    return r;
+                }
                 if ((r = VmoReadExact(bdata, len - adjust, adjust)) != ZX_OK) {
                     return ZX_ERR_IO;
                 }
@@ -1771,6 +2211,15 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
     if ((r = vmo_.set_size(fbl::round_up(len, kMinfsBlockSize))) != ZX_OK) {
         return r;
     }
+    // Blocks past the new end are gone from disk; should the file grow again
+    // they hold zeroes, as vmo_ does.
+    SetPopulated(static_cast<blk_t>(fbl::round_up(len, kMinfsBlockSize) / kMinfsBlockSize),
+                 static_cast<blk_t>(populated_.size()));
+    // Mapped blocks past the new end read as zeroes, should the file grow
+    // again, and the new last block has just been written back.
+    for (blk_t n = static_cast<blk_t>(len / kMinfsBlockSize); n < mapped_blocks_; n++) {
+        mapped_hashes_[n] = HashBlock(n);
+    }
 #endif
 
     ValidateVmoTail();
@@ -1778,6 +2227,9 @@ zx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
 }
 
 // Verify that the 'newdir' inode is not a subdirectory of the source.
+// This reads the '..' entries of the ancestors of 'newdir' without their
+// locks, so it must only be called while the Vfs excludes other path
+// operations, as it does for renames between directories.
 zx_status_t VnodeMinfs::CheckNotSubdirectory(fbl::RefPtr<VnodeMinfs> newdir) {
     fbl::RefPtr<VnodeMinfs> vn = newdir;
     zx_status_t status = ZX_OK;
@@ -1808,6 +2260,18 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     if (!(IsDirectory() && newdir->IsDirectory()))
         return ZX_ERR_NOT_SUPPORTED;
 
+    fbl::AutoLock lock(&lock_);
+    if (newdir.get() == this) {
+        return RenameLocked(fbl::move(newdir), oldname, newname, src_must_be_dir,
+                            dst_must_be_dir);
+    }
+    fbl::AutoLock newdir_lock(&newdir->lock_);
+    return RenameLocked(fbl::move(newdir), oldname, newname, src_must_be_dir, dst_must_be_dir);
+}
+
+zx_status_t VnodeMinfs::RenameLocked(fbl::RefPtr<VnodeMinfs> newdir, fbl::StringPiece oldname,
+                                     fbl::StringPiece newname, bool src_must_be_dir,
+                                     bool dst_must_be_dir) {
     zx_status_t status;
     fbl::RefPtr<VnodeMinfs> oldvn = nullptr;
     // acquire the 'oldname' node (it must exist)
@@ -1817,7 +2281,8 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
         return status;
     } else if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
         return status;
-    } else if ((status = oldvn->CheckNotSubdirectory(newdir)) < 0) {
+    } else if (newdir.get() != this && (status = oldvn->CheckNotSubdirectory(newdir)) < 0) {
+        // Within one directory, an entry cannot become its own ancestor.
         return status;
     }
 
@@ -1837,6 +2302,14 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
+    if (oldvn->IsDirectory() && newdir.get() != this) {
+        // The source directory could be the entry being replaced; it is not
+        // empty, and its lock is already held.
+        fbl::RefPtr<fs::Vnode> target;
+        if (newdir->LookupInternal(&target, newname) == ZX_OK && target.get() == this) {
+            return ZX_ERR_NOT_EMPTY;
+        }
+    }
     args.wb = wb.get();
     args.name = newname;
     args.ino = oldvn->ino_;
@@ -1845,7 +2318,7 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     if (status == ZX_ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newname.length())));
-        if ((status = newdir->ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+        if ((status = newdir->AppendDirent(&args)) < 0) {
             return status;
         }
     } else if (status != ZX_OK) {
@@ -1856,12 +2329,13 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     // moved to a new directory
     if ((args.type == kMinfsTypeDir) && (ino_ != newdir->ino_)) {
         fbl::RefPtr<fs::Vnode> vn_fs;
-        if ((status = newdir->Lookup(&vn_fs, newname)) < 0) {
+        if ((status = newdir->LookupInternal(&vn_fs, newname)) < 0) {
             return status;
         }
         auto vn = fbl::RefPtr<VnodeMinfs>::Downcast(vn_fs);
         args.name = "..";
         args.ino = newdir->ino_;
+        fbl::AutoLock vn_lock(&vn->lock_);
         if ((status = vn->ForEachDirent(&args, DirentCallbackUpdateInode)) < 0) {
             return status;
         }
@@ -1869,7 +2343,10 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
 
     // at this point, the oldvn exists with multiple names (or the same name in
     // different directories)
-    oldvn->inode_.link_count++;
+    {
+        fbl::AutoLock oldvn_lock(&oldvn->lock_);
+        oldvn->inode_.link_count++;
+    }
 
     // finally, remove oldname from its original position
     args.name = oldname;
@@ -1895,6 +2372,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
         // The target must not be a directory
         return ZX_ERR_NOT_FILE;
     }
+    fbl::AutoLock lock(&lock_);
 
     // The destination should not exist
     DirArgs args = DirArgs();
@@ -1913,13 +2391,16 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
     args.wb = wb.get();
-    if ((status = ForEachDirent(&args, DirentCallbackAppend)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
     // We have successfully added the vn to a new location. Increment the link count.
-    target->inode_.link_count++;
-    target->InodeSync(wb->txn(), kMxFsSyncDefault);
+    {
+        fbl::AutoLock target_lock(&target->lock_);
+        target->inode_.link_count++;
+        target->InodeSync(wb->txn(), kMxFsSyncDefault);
+    }
     wb->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
     wb->PinVnode(target);
     fs_->EnqueueWork(fbl::move(wb));
@@ -1927,8 +2408,62 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
 }
 
 #ifdef __Fuchsia__
+zx_status_t VnodeMinfs::Mmap(int flags, size_t len, size_t* off, zx_handle_t* out) {
+    TRACE_DURATION("minfs", "VnodeMinfs::Mmap");
+    if (IsDirectory()) {
+        return ZX_ERR_ACCESS_DENIED;
+    }
+    if ((len > kMinfsMaxFileSize) || (*off > kMinfsMaxFileSize - len)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    fbl::AutoLock lock(&lock_);
+    zx_status_t status;
+    if ((status = InitVmo()) != ZX_OK) {
+        return status;
+    }
+    // Mappings fault on vmo_ directly, so all of the file must be read in.
+    if ((status = PopulateVmo(0, static_cast<blk_t>(populated_.size()))) != ZX_OK) {
+        return status;
+    }
+
+    if (flags & FDIO_MMAP_FLAG_PRIVATE) {
+        return zx_vmo_clone(vmo_.get(), ZX_VMO_CLONE_COPY_ON_WRITE, 0,
+                            fbl::round_up(inode_.size, kMinfsBlockSize), out);
+    }
+
+    // Shared mappings are of vmo_ itself, which read and write go through
+    // too, so that all of them see the same pages.
+    zx_rights_t rights = ZX_RIGHT_TRANSFER | ZX_RIGHT_MAP;
+    rights |= (flags & FDIO_MMAP_FLAG_READ) ? ZX_RIGHT_READ : 0;
+    rights |= (flags & FDIO_MMAP_FLAG_WRITE) ? ZX_RIGHT_WRITE : 0;
+    rights |= (flags & FDIO_MMAP_FLAG_EXEC) ? ZX_RIGHT_EXECUTE : 0;
+    if ((flags & FDIO_MMAP_FLAG_WRITE) && (status = TrackMapping(*off + len)) != ZX_OK) {
+        return status;
+    }
+    return vmo_.duplicate(rights, reinterpret_cast<zx::vmo*>(out));
+}
+
+zx_status_t VnodeMinfs::Msync(size_t offset, size_t len) {
+    TRACE_DURATION("minfs", "VnodeMinfs::Msync", "ino", ino_, "len", len, "off", offset);
+    if ((len > kMinfsMaxFileSize) || (offset > kMinfsMaxFileSize - len)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    fbl::AutoLock lock(&lock_);
+    return FlushMapped(static_cast<blk_t>(offset / kMinfsBlockSize),
+                       static_cast<blk_t>(fbl::round_up(offset + len, kMinfsBlockSize) /
+                                          kMinfsBlockSize));
+}
+
 void VnodeMinfs::Sync(SyncCallback closure) {
     TRACE_DURATION("minfs", "VnodeMinfs::Sync");
+    {
+        fbl::AutoLock lock(&lock_);
+        zx_status_t status = FlushMapped(0, mapped_blocks_);
+        if (status != ZX_OK) {
+            closure(status);
+            return;
+        }
+    }
     fs_->Sync([this, cb = fbl::move(closure)](zx_status_t status) {
         if (status != ZX_OK) {
             cb(status);
@@ -94,6 +94,17 @@ size_t WriteTxn::BlkCount() const {
     return blocks_needed;
 }
 
+size_t WriteTxn::MetadataBlkCount(blk_t dat_block) const {
+    size_t blocks_needed = 0;
+    for (size_t i = 0; i < count_; i++) {
+        if (requests_[i].dev_offset < dat_block) {
+            blocks_needed += fbl::min(requests_[i].length,
+                                      static_cast<size_t>(dat_block - requests_[i].dev_offset));
+        }
+    }
+    return blocks_needed;
+}
+
 #endif  // __Fuchsia__
 
 WritebackWork::WritebackWork(Bcache* bc) :
@@ -125,7 +136,17 @@ size_t WritebackWork::Complete(zx_handle_t vmo, vmoid_t vmoid) {
     return blk_count;
 }
 
-void WritebackWork::SetClosure(SyncCallback closure) {
+size_t WritebackWork::Complete(zx_status_t status) {
+    size_t blk_count = txn_.BlkCount();
+    txn_.count_ = 0;
+    if (closure_) {
+        closure_(status);
+    }
+    Reset();
+    return blk_count;
+}
+
+void WritebackWork::SetClosure(Closure closure) {
     ZX_DEBUG_ASSERT(!closure_);
     closure_ = fbl::move(closure);
 }
@@ -152,6 +173,7 @@ void WritebackWork::PinVnode(fbl::RefPtr<VnodeMinfs> vn) {
 #ifdef __Fuchsia__
 
 zx_status_t WritebackBuffer::Create(Bcache* bc, fbl::unique_ptr<MappedVmo> buffer,
+                                    const minfs_info_t* info,
                                     fbl::unique_ptr<WritebackBuffer>* out) {
     fbl::unique_ptr<WritebackBuffer> wb(new WritebackBuffer(bc, fbl::move(buffer)));
     if (wb->buffer_->GetSize() % kMinfsBlockSize != 0) {
@@ -160,15 +182,21 @@ zx_status_t WritebackBuffer::Create(Bcache* bc, fbl::unique_ptr<MappedVmo> buffe
         return ZX_ERR_NO_RESOURCES;
     } else if (cnd_init(&wb->producer_cvar_) != thrd_success) {
         return ZX_ERR_NO_RESOURCES;
-    } else if (thrd_create_with_name(&wb->writeback_thrd_,
-                                     WritebackBuffer::WritebackThread, wb.get(),
-                                     "minfs-writeback") != thrd_success) {
-        return ZX_ERR_NO_RESOURCES;
     }
     zx_status_t status = wb->bc_->AttachVmo(wb->buffer_->GetVmo(), &wb->buffer_vmoid_);
     if (status != ZX_OK) {
         return status;
     }
+    if (info->journal_blocks != 0) {
+        if ((status = Journal::Create(bc, info, wb->buffer_.get(), wb->buffer_vmoid_,
+                                      &wb->journal_)) != ZX_OK) {
+            return status;
+        }
+    }
+    if (thrd_create_with_name(&wb->writeback_thrd_, WritebackBuffer::WritebackThread, wb.get(),
+                              "minfs-writeback") != thrd_success) {
+        return ZX_ERR_NO_RESOURCES;
+    }
 
     *out = fbl::move(wb);
     return ZX_OK;
@@ -187,6 +215,7 @@ WritebackBuffer::~WritebackBuffer() {
     }
     int r;
     thrd_join(writeback_thrd_, &r);
+    journal_.reset();
 
     if (buffer_vmoid_ != VMOID_INVALID) {
         block_fifo_request_t request;
@@ -320,6 +349,39 @@ int WritebackBuffer::WritebackThread(void* arg) {
 
     b->writeback_lock_.Acquire();
     while (true) {
+        while (b->journal_ != nullptr && !b->work_queue_.is_empty()) {
+            TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread");
+            // Group commit: take as much queued work as one journal entry
+            // holds, and at least one work.
+            fbl::unique_ptr<WritebackWork> batch[kMaxGroupCommit];
+            size_t count = 0;
+            size_t meta = 0;
+            const blk_t dat_block = b->journal_->DatBlock();
+            while (!b->work_queue_.is_empty() && count < kMaxGroupCommit) {
+                size_t work_meta = b->work_queue_.front().txn()->MetadataBlkCount(dat_block);
+                if (count > 0 && meta + work_meta > b->journal_->Capacity()) {
+                    break;
+                }
+                meta += work_meta;
+                batch[count++] = b->work_queue_.pop();
+            }
+
+            // Stay unlocked while processing the batch
+            b->writeback_lock_.Release();
+            size_t blks_consumed = b->journal_->Commit(batch, count);
+            for (size_t i = 0; i < count; i++) {
+                TRACE_FLOW_END("minfs", "writeback",
+                               reinterpret_cast<trace_flow_id_t>(batch[i].get()));
+                batch[i] = nullptr;
+            }
+
+            // Relock before checking the state of the queue
+            b->writeback_lock_.Acquire();
+            b->start_ = (b->start_ + blks_consumed) % b->cap_;
+            b->len_ -= blks_consumed;
+            cnd_signal(&b->producer_cvar_);
+        }
+
         while (!b->work_queue_.is_empty()) {
             auto work = b->work_queue_.pop();
             TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread");
@@ -344,7 +406,10 @@ int WritebackBuffer::WritebackThread(void* arg) {
         // Before waiting, we should check if we're unmounting.
         if (b->unmounting_) {
             b->writeback_lock_.Release();
-            b->bc_->FreeTxnId();
+            if (b->journal_ != nullptr) {
+                // Everything has been written in place; leave nothing to replay.
+                b->journal_->Clean();
+            }
             return 0;
         }
         cnd_wait(&b->consumer_cvar_, b->writeback_lock_.GetInternal());
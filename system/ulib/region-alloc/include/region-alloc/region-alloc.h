@@ -87,6 +87,17 @@
 // RegionPools also hold their own mutex which may be obtained by an Allocator
 // while holding the Allocator's Mutex.
 //
+// == Region Cache ==
+// Users which repeatedly allocate and release regions of the same few
+// power-of-two sizes may ask an allocator to keep a number of released
+// regions of each such size aside (see SetCacheDepth).  A sized request which
+// a cached region satisfies is then handed that region without touching the
+// available region trees or the RegionPool, and without the splitting and
+// merging the trees would otherwise do.  Cached regions stay out of the
+// available set until they are flushed back into it, which happens whenever
+// an allocation would otherwise fail, and before regions are added or
+// subtracted.
+//
 // == Simple Usage Example ==
 //
 // /* Create a pool and assign it to a stack allocated allocator.  Limit the
@@ -166,6 +177,7 @@ void        ralloc_release_pool(ralloc_pool_t* pool);
 // ++ Create
 // ++ SetRegionPool
 // ++ Reset (destroys all regions which are available for allocation and returns them to the pool)
+// ++ SetCacheDepth (keeps released regions of power-of-two sizes aside for reuse)
 // ++ Destroy
 // ++ AddRegion (adds a region to the set of regions available for allocation)
 // ++ SubtractRegion (subtracts a region from the set of regions available for allocation)
@@ -175,6 +187,7 @@ void        ralloc_release_pool(ralloc_pool_t* pool);
 zx_status_t ralloc_create_allocator(ralloc_allocator_t** out_allocator);
 zx_status_t ralloc_set_region_pool(ralloc_allocator_t* allocator, ralloc_pool_t* pool);
 void ralloc_reset_allocator(ralloc_allocator_t* allocator);
+void ralloc_set_cache_depth(ralloc_allocator_t* allocator, size_t depth);
 void ralloc_destroy_allocator(ralloc_allocator_t* allocator);
 zx_status_t ralloc_add_region(ralloc_allocator_t* allocator,
                               const ralloc_region_t* region,
@@ -261,6 +274,12 @@ public:
             static WAVLTreeNodeState& node_state(Region& r) { return r.ns_tree_sort_by_size_; }
         };
 
+        struct CacheListTraits {
+            static fbl::SinglyLinkedListNodeState<Region*>& node_state(Region& r) {
+                return r.ns_cache_;
+            }
+        };
+
         struct KeyTraitsSortBySize {
             static const ralloc_region_t& GetKey(const Region& r) { return r; }
 
@@ -279,6 +298,7 @@ public:
         using WAVLTreeSortBySize = fbl::WAVLTree<ralloc_region_t, Region*,
                                                   KeyTraitsSortBySize,
                                                   WAVLTreeNodeTraitsSortBySize>;
+        using CacheList = fbl::SinglyLinkedList<Region*, CacheListTraits>;
 
         // Used by SortByBase key traits
         uint64_t GetKey() const { return base; }
@@ -292,6 +312,7 @@ public:
         friend struct KeyTraitsSortBySize;
         friend struct WAVLTreeNodeTraitsSortByBase;
         friend struct WAVLTreeNodeTraitsSortBySize;
+        friend struct CacheListTraits;
 
         // Regions can only be placement new'ed by the RegionPool slab
         // allocator.  They cannot be copied, assigned, or deleted.  Externally,
@@ -314,6 +335,7 @@ public:
         RegionAllocator* owner_;
         WAVLTreeNodeState ns_tree_sort_by_base_;
         WAVLTreeNodeState ns_tree_sort_by_size_;
+        fbl::SinglyLinkedListNodeState<Region*> ns_cache_;
     };
 
     class RegionPool : public fbl::RefCounted<RegionPool>,
@@ -367,6 +389,14 @@ public:
     // Has no effect on currently allocated regions.
     void Reset();
 
+    // Set the number of released regions of each power-of-two size, up to
+    // 2^(CACHE_SIZE_CLASSES - 1), which the allocator keeps aside to satisfy
+    // later requests of the same size (see "Region Cache" above).  The
+    // default depth of zero disables the cache.  Lowering the depth flushes
+    // every cached region back into the set of available regions.
+    static constexpr size_t CACHE_SIZE_CLASSES = 32;
+    void SetCacheDepth(size_t depth);
+
     // Add a region to the set of allocatable regions.
     //
     // If allow_overlap is false, the added region may not overlap with any
@@ -463,19 +493,24 @@ public:
         return ret;
     }
 
+    // Cached regions count as available, not allocated.
     size_t AllocatedRegionCount() const {
         fbl::AutoLock alloc_lock(&alloc_lock_);
-        return allocated_regions_by_base_.size();
+        return allocated_regions_by_base_.size() - cached_region_count_;
     }
 
     size_t AvailableRegionCount() const {
         fbl::AutoLock alloc_lock(&alloc_lock_);
-        return avail_regions_by_base_.size();
+        return avail_regions_by_base_.size() + cached_region_count_;
     }
 
 private:
+    zx_status_t GetRegionLocked(uint64_t size, uint64_t alignment, Region::UPtr& out_region);
+    zx_status_t GetRegionLocked(const ralloc_region_t& requested_region,
+                                Region::UPtr& out_region);
     zx_status_t AddSubtractSanityCheckLocked(const ralloc_region_t& region);
     void ReleaseRegion(Region* region);
+    bool FlushCacheLocked();
     void AddRegionToAvailLocked(Region* region, bool allow_overlap = false);
 
     zx_status_t AllocFromAvailLocked(Region::WAVLTreeSortBySize::iterator source,
@@ -495,12 +530,20 @@ private:
      * The alloc_lock_ may be held while calling into a RegionAllocator's
      * assigned RegionPool, but code from the RegionPool will never call into
      * the RegionAllocator.
+     *
+     * Cached regions remain in the allocated index, so that nothing can be
+     * added or subtracted over them, and are also on the cache list of their
+     * size class.
      */
     mutable fbl::Mutex alloc_lock_;
     Region::WAVLTreeSortByBase allocated_regions_by_base_;
     Region::WAVLTreeSortByBase avail_regions_by_base_;
     Region::WAVLTreeSortBySize avail_regions_by_size_;
     RegionPool::RefPtr region_pool_;
+    Region::CacheList cached_regions_[CACHE_SIZE_CLASSES];
+    size_t cached_region_counts_[CACHE_SIZE_CLASSES] = { };
+    size_t cached_region_count_ = 0;
+    size_t cache_depth_ = 0;
 };
 
 // If this is C++, clear out this pre-processor constant.  People can get to the
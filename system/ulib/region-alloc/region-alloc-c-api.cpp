@@ -67,6 +67,11 @@ void ralloc_reset_allocator(ralloc_allocator_t* allocator) {
     reinterpret_cast<RegionAllocator*>(allocator)->Reset();
 }
 
+void ralloc_set_cache_depth(ralloc_allocator_t* allocator, size_t depth) {
+    ZX_DEBUG_ASSERT(allocator);
+    reinterpret_cast<RegionAllocator*>(allocator)->SetCacheDepth(depth);
+}
+
 void ralloc_destroy_allocator(ralloc_allocator_t* allocator) {
     ZX_DEBUG_ASSERT(allocator);
 
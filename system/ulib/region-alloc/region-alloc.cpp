@@ -6,6 +6,19 @@
 #include <region-alloc/region-alloc.h>
 #include <string.h>
 
+// Finds the cache size class of regions of |size|, if they have one.
+static bool CacheSizeClass(uint64_t size, size_t* out_class) {
+    if (!fbl::is_pow2(size))
+        return false;
+
+    size_t size_class = __builtin_ctzll(size);
+    if (size_class >= RegionAllocator::CACHE_SIZE_CLASSES)
+        return false;
+
+    *out_class = size_class;
+    return true;
+}
+
 // Support for Pool allocated bookkeeping
 RegionAllocator::RegionPool::RefPtr RegionAllocator::RegionPool::Create(size_t max_memory) {
     // Sanity check our allocation arguments.
@@ -16,6 +29,9 @@ RegionAllocator::RegionPool::RefPtr RegionAllocator::RegionPool::Create(size_t m
 }
 
 RegionAllocator::~RegionAllocator() {
+    // Cached regions are not in flight; put them back with the others.
+    FlushCacheLocked();
+
     // No one should be destroying us while we have allocations in flight.
     ZX_DEBUG_ASSERT(allocated_regions_by_base_.is_empty());
 
@@ -38,6 +54,7 @@ RegionAllocator::~RegionAllocator() {
 void RegionAllocator::Reset() {
     fbl::AutoLock alloc_lock(&alloc_lock_);
 
+    FlushCacheLocked();
     ZX_DEBUG_ASSERT((region_pool_ != nullptr) || avail_regions_by_base_.is_empty());
 
     Region* removed;
@@ -50,6 +67,14 @@ void RegionAllocator::Reset() {
     ZX_DEBUG_ASSERT(avail_regions_by_size_.is_empty());
 }
 
+void RegionAllocator::SetCacheDepth(size_t depth) {
+    fbl::AutoLock alloc_lock(&alloc_lock_);
+
+    if (depth < cache_depth_)
+        FlushCacheLocked();
+    cache_depth_ = depth;
+}
+
 zx_status_t RegionAllocator::SetRegionPool(const RegionPool::RefPtr& region_pool) {
     fbl::AutoLock alloc_lock(&alloc_lock_);
 
@@ -63,6 +88,9 @@ zx_status_t RegionAllocator::SetRegionPool(const RegionPool::RefPtr& region_pool
 zx_status_t RegionAllocator::AddRegion(const ralloc_region_t& region, bool allow_overlap) {
     fbl::AutoLock alloc_lock(&alloc_lock_);
 
+    // Cached regions would otherwise look like allocations in the way.
+    FlushCacheLocked();
+
     // Start with sanity checks
     zx_status_t ret = AddSubtractSanityCheckLocked(region);
     if (ret != ZX_OK)
@@ -92,6 +120,8 @@ zx_status_t RegionAllocator::SubtractRegion(const ralloc_region_t& to_subtract,
                                             bool allow_incomplete) {
     fbl::AutoLock alloc_lock(&alloc_lock_);
 
+    FlushCacheLocked();
+
     // Start with sanity checks
     zx_status_t ret = AddSubtractSanityCheckLocked(to_subtract);
     if (ret != ZX_OK)
@@ -278,6 +308,27 @@ zx_status_t RegionAllocator::GetRegion(uint64_t size,
                                        Region::UPtr& out_region) {
     fbl::AutoLock alloc_lock(&alloc_lock_);
 
+    // If the request failed, it may be because the space it needs is being
+    // held in the cache.  Flush the cache and try again.
+    zx_status_t ret = GetRegionLocked(size, alignment, out_region);
+    if (((ret == ZX_ERR_NOT_FOUND) || (ret == ZX_ERR_NO_MEMORY)) && FlushCacheLocked())
+        ret = GetRegionLocked(size, alignment, out_region);
+    return ret;
+}
+
+zx_status_t RegionAllocator::GetRegion(const ralloc_region_t& requested_region,
+                                       Region::UPtr& out_region) {
+    fbl::AutoLock alloc_lock(&alloc_lock_);
+
+    zx_status_t ret = GetRegionLocked(requested_region, out_region);
+    if (((ret == ZX_ERR_NOT_FOUND) || (ret == ZX_ERR_NO_MEMORY)) && FlushCacheLocked())
+        ret = GetRegionLocked(requested_region, out_region);
+    return ret;
+}
+
+zx_status_t RegionAllocator::GetRegionLocked(uint64_t size,
+                                             uint64_t alignment,
+                                             Region::UPtr& out_region) {
     // Check our RegionPool
     if (region_pool_ == nullptr)
         return ZX_ERR_BAD_STATE;
@@ -291,6 +342,20 @@ zx_status_t RegionAllocator::GetRegion(uint64_t size,
     uint64_t mask     = alignment - 1;
     uint64_t inv_mask = ~mask;
 
+    // Regions in the cache are already split off and in the allocated index,
+    // so one which is suitably aligned can be handed out as it is.
+    size_t size_class;
+    if (cached_region_count_ && CacheSizeClass(size, &size_class)) {
+        Region* region = cached_regions_[size_class].erase_if(
+            [mask](const Region& r) -> bool { return (r.base & mask) == 0; });
+        if (region != nullptr) {
+            --cached_region_counts_[size_class];
+            --cached_region_count_;
+            out_region.reset(region);
+            return ZX_OK;
+        }
+    }
+
     // Start by using our size index to look up the first available region which
     // is large enough to hold this allocation (if any)
     auto iter = avail_regions_by_size_.lower_bound({ .base = 0, .size = size });
@@ -321,10 +386,8 @@ zx_status_t RegionAllocator::GetRegion(uint64_t size,
     return AllocFromAvailLocked(iter, out_region, aligned_base, size);
 }
 
-zx_status_t RegionAllocator::GetRegion(const ralloc_region_t& requested_region,
-                                       Region::UPtr& out_region) {
-    fbl::AutoLock alloc_lock(&alloc_lock_);
-
+zx_status_t RegionAllocator::GetRegionLocked(const ralloc_region_t& requested_region,
+                                             Region::UPtr& out_region) {
     // Check our RegionPool
     if (region_pool_ == nullptr)
         return ZX_ERR_BAD_STATE;
@@ -401,11 +464,40 @@ void RegionAllocator::ReleaseRegion(Region* region) {
     // bookkeeping and add it back to the available regions.
     ZX_DEBUG_ASSERT(region->ns_tree_sort_by_base_.InContainer());
     ZX_DEBUG_ASSERT(!region->ns_tree_sort_by_size_.InContainer());
+    ZX_DEBUG_ASSERT(!region->ns_cache_.InContainer());
+
+    // Keep the region in the cache, still in the allocated index, if it has
+    // a size class with room.
+    size_t size_class;
+    if (CacheSizeClass(region->size, &size_class) &&
+        (cached_region_counts_[size_class] < cache_depth_)) {
+        cached_regions_[size_class].push_front(region);
+        ++cached_region_counts_[size_class];
+        ++cached_region_count_;
+        return;
+    }
 
     allocated_regions_by_base_.erase(*region);
     AddRegionToAvailLocked(region);
 }
 
+bool RegionAllocator::FlushCacheLocked() {
+    if (!cached_region_count_)
+        return false;
+
+    for (size_t i = 0; i < CACHE_SIZE_CLASSES; ++i) {
+        Region* region;
+        while ((region = cached_regions_[i].pop_front()) != nullptr) {
+            allocated_regions_by_base_.erase(*region);
+            AddRegionToAvailLocked(region);
+        }
+        cached_region_counts_[i] = 0;
+    }
+
+    cached_region_count_ = 0;
+    return true;
+}
+
 zx_status_t RegionAllocator::AllocFromAvailLocked(Region::WAVLTreeSortBySize::iterator source,
                                                   Region::UPtr& out_region,
                                                   uint64_t base,
@@ -14,7 +14,8 @@ __BEGIN_CDECLS
 #pragma GCC visibility push(hidden)
 
 // Define a properly-aligned buffer on the stack for reading a processargs
-// message.  The nbytes parameter should be gotten from zxr_message_size.
+// message.  The nbytes parameter should be gotten from zxr_message_size,
+// or be ZXR_PROCESSARGS_INLINE_BYTES for zxr_processargs_try_read.
 #define ZXR_PROCESSARGS_BUFFER(variable, nbytes) \
     alignas(zx_proc_args_t) uint8_t variable[nbytes]
 
@@ -29,6 +30,25 @@ zx_status_t zxr_processargs_read(zx_handle_t bootstrap,
                                  zx_proc_args_t** pargs,
                                  uint32_t** handle_info);
 
+// Most bootstrap messages fit in a buffer and handle array of these
+// sizes.  Reading into those first with zxr_processargs_try_read saves
+// the separate zxr_message_size call needed to learn the exact sizes.
+#define ZXR_PROCESSARGS_INLINE_BYTES 2048
+#define ZXR_PROCESSARGS_INLINE_HANDLES 32
+
+// This is like zxr_processargs_read, but the message can be smaller
+// than the buffer and handle array provided; its actual sizes are
+// stored in *actual_bytes and *actual_handles.  If it doesn't fit, this
+// returns ZX_ERR_BUFFER_TOO_SMALL with the sizes it needs stored there
+// and leaves the message to be read by zxr_processargs_read.
+zx_status_t zxr_processargs_try_read(zx_handle_t bootstrap,
+                                     void* buffer, uint32_t nbytes,
+                                     zx_handle_t handles[], uint32_t nhandles,
+                                     uint32_t* actual_bytes,
+                                     uint32_t* actual_handles,
+                                     zx_proc_args_t** pargs,
+                                     uint32_t** handle_info);
+
 // This assumes zxr_processargs_read has already succeeded on the same
 // buffer.  It unpacks the argument and environment strings into arrays
 // provided by the caller.  If not NULL, the argv[] array must have
@@ -11,24 +11,10 @@
 // protocol violations?
 #define MALFORMED ZX_ERR_INVALID_ARGS
 
-zx_status_t zxr_processargs_read(zx_handle_t bootstrap,
-                                 void* buffer, uint32_t nbytes,
-                                 zx_handle_t handles[], uint32_t nhandles,
-                                 zx_proc_args_t** pargs,
-                                 uint32_t** handle_info) {
+static zx_status_t validate(void* buffer, uint32_t nbytes, uint32_t nhandles,
+                            zx_proc_args_t** pargs, uint32_t** handle_info) {
     if (nbytes < sizeof(zx_proc_args_t))
-        return ZX_ERR_INVALID_ARGS;
-    if ((uintptr_t)buffer % alignof(zx_proc_args_t) != 0)
-        return ZX_ERR_INVALID_ARGS;
-
-    uint32_t got_bytes = 0;
-    uint32_t got_handles = 0;
-    zx_status_t status = _zx_channel_read(bootstrap, 0, buffer, handles, nbytes,
-                                          nhandles, &got_bytes, &got_handles);
-    if (status != ZX_OK)
-        return status;
-    if (got_bytes != nbytes || got_handles != nhandles)
-        return ZX_ERR_INVALID_ARGS;
+        return MALFORMED;
 
     zx_proc_args_t* const pa = buffer;
 
@@ -57,6 +43,49 @@ zx_status_t zxr_processargs_read(zx_handle_t bootstrap,
     return ZX_OK;
 }
 
+zx_status_t zxr_processargs_read(zx_handle_t bootstrap,
+                                 void* buffer, uint32_t nbytes,
+                                 zx_handle_t handles[], uint32_t nhandles,
+                                 zx_proc_args_t** pargs,
+                                 uint32_t** handle_info) {
+    if (nbytes < sizeof(zx_proc_args_t))
+        return ZX_ERR_INVALID_ARGS;
+    if ((uintptr_t)buffer % alignof(zx_proc_args_t) != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    uint32_t got_bytes = 0;
+    uint32_t got_handles = 0;
+    zx_status_t status = _zx_channel_read(bootstrap, 0, buffer, handles, nbytes,
+                                          nhandles, &got_bytes, &got_handles);
+    if (status != ZX_OK)
+        return status;
+    if (got_bytes != nbytes || got_handles != nhandles)
+        return ZX_ERR_INVALID_ARGS;
+
+    return validate(buffer, nbytes, nhandles, pargs, handle_info);
+}
+
+zx_status_t zxr_processargs_try_read(zx_handle_t bootstrap,
+                                     void* buffer, uint32_t nbytes,
+                                     zx_handle_t handles[], uint32_t nhandles,
+                                     uint32_t* actual_bytes,
+                                     uint32_t* actual_handles,
+                                     zx_proc_args_t** pargs,
+                                     uint32_t** handle_info) {
+    if ((uintptr_t)buffer % alignof(zx_proc_args_t) != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    *actual_bytes = *actual_handles = 0;
+    zx_status_t status = _zx_channel_read(bootstrap, 0, buffer, handles,
+                                          nbytes, nhandles,
+                                          actual_bytes, actual_handles);
+    if (status != ZX_OK)
+        return status;
+
+    return validate(buffer, *actual_bytes, *actual_handles,
+                    pargs, handle_info);
+}
+
 static zx_status_t unpack_strings(char* buffer, uint32_t bytes, char* result[],
                                   uint32_t off, uint32_t num) {
     char* p = &buffer[off];
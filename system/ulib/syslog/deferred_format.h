@@ -0,0 +1,49 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ZIRCON_SYSTEM_ULIB_SYSLOG_DEFERRED_FORMAT_H_
+#define ZIRCON_SYSTEM_ULIB_SYSLOG_DEFERRED_FORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace syslog {
+namespace internal {
+
+// How an argument is passed through varargs and stored in a record word.
+enum class ArgType : uint8_t {
+    kInt,
+    kLong,
+    kLongLong,
+    kIntMax,
+    kSize,
+    kPtrDiff,
+    kDouble,
+    kPointer,
+    kString,
+};
+
+struct Conversion {
+    // Bytes from the '%' through the conversion character.
+    size_t length;
+    // No of '*' width and precision arguments, each an int preceding the
+    // value.
+    uint32_t num_stars;
+    ArgType type;
+    // False for "%%".
+    bool has_arg;
+};
+
+// Max length of a single conversion the reader will format.
+constexpr size_t kMaxConversionLen = 32;
+
+// Parses the conversion at |spec|, which points at a '%'.
+// Returns false for conversions that cannot be deferred, e.g. "%n", wide
+// strings and long double.
+bool ParseConversion(const char* spec, Conversion* out);
+
+} // namespace internal
+} // namespace syslog
+
+#endif // ZIRCON_SYSTEM_ULIB_SYSLOG_DEFERRED_FORMAT_H_
@@ -9,6 +9,7 @@
 #include <syslog/logger.h>
 #include <syslog/wire_format.h>
 
+#include "deferred_format.h"
 #include "fx_logger.h"
 
 namespace {
@@ -88,6 +89,162 @@ zx_status_t fx_logger::VLogWriteToSocket(fx_log_severity_t severity,
     return status;
 }
 
+zx_status_t fx_logger::VLogWriteToRing(fx_log_severity_t severity,
+                                       const char* tag, const char* msg,
+                                       va_list args) {
+    using syslog::internal::ArgType;
+    using syslog::internal::Conversion;
+
+    // Capture the arguments first; a copy of |args| leaves them untouched for
+    // the fallback paths.
+    uint64_t words[FX_LOG_MAX_RECORD_ARGS];
+    const char* strings[FX_LOG_MAX_RECORD_ARGS];
+    bool is_string[FX_LOG_MAX_RECORD_ARGS];
+    size_t num_words = 0;
+    va_list ap;
+    va_copy(ap, args);
+    for (const char* p = msg; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        Conversion conv;
+        if (!syslog::internal::ParseConversion(p, &conv) ||
+            num_words + conv.num_stars + 1 > FX_LOG_MAX_RECORD_ARGS) {
+            va_end(ap);
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        p += conv.length - 1;
+        if (!conv.has_arg) {
+            continue;
+        }
+        for (uint32_t i = 0; i < conv.num_stars; i++) {
+            is_string[num_words] = false;
+            words[num_words++] = static_cast<uint64_t>(va_arg(ap, int));
+        }
+        is_string[num_words] = false;
+        uint64_t word = 0;
+        switch (conv.type) {
+        case ArgType::kInt:
+            word = static_cast<uint64_t>(va_arg(ap, int));
+            break;
+        case ArgType::kLong:
+            word = static_cast<uint64_t>(va_arg(ap, long));
+            break;
+        case ArgType::kLongLong:
+            word = static_cast<uint64_t>(va_arg(ap, long long));
+            break;
+        case ArgType::kIntMax:
+            word = static_cast<uint64_t>(va_arg(ap, intmax_t));
+            break;
+        case ArgType::kSize:
+            word = static_cast<uint64_t>(va_arg(ap, size_t));
+            break;
+        case ArgType::kPtrDiff:
+            word = static_cast<uint64_t>(va_arg(ap, ptrdiff_t));
+            break;
+        case ArgType::kDouble: {
+            double value = va_arg(ap, double);
+            memcpy(&word, &value, sizeof(word));
+            break;
+        }
+        case ArgType::kPointer:
+            word = reinterpret_cast<uintptr_t>(va_arg(ap, void*));
+            break;
+        case ArgType::kString:
+            strings[num_words] = va_arg(ap, const char*);
+            is_string[num_words] = true;
+            break;
+        }
+        words[num_words++] = word;
+    }
+    va_end(ap);
+
+    // Lay out the record: header, argument words, tag, string area.
+    alignas(fx_log_record_t) uint8_t buffer[FX_LOG_MAX_RECORD_LEN];
+    auto record = reinterpret_cast<fx_log_record_t*>(buffer);
+    size_t pos = sizeof(fx_log_record_t) + num_words * sizeof(uint64_t);
+    record->tag_len = 0;
+    if (tag != NULL) {
+        size_t len = fbl::min(strlen(tag), static_cast<size_t>(FX_LOG_MAX_TAG_LEN - 1));
+        if (len > 0) {
+            memcpy(buffer + pos, tag, len);
+            buffer[pos + len] = 0;
+            record->tag_len = static_cast<uint16_t>(len + 1);
+            pos += len + 1;
+        }
+    }
+    const size_t strings_start = pos;
+    for (size_t i = 0; i < num_words; i++) {
+        if (!is_string[i]) {
+            continue;
+        }
+        if (strings[i] == NULL) {
+            words[i] = FX_LOG_RECORD_NULL_STRING;
+            continue;
+        }
+        // Truncate long strings to what is left of the record.
+        size_t avail = sizeof(buffer) - pos;
+        if (avail == 0) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        size_t len = strnlen(strings[i], avail - 1);
+        memcpy(buffer + pos, strings[i], len);
+        buffer[pos + len] = 0;
+        words[i] = (static_cast<uint64_t>(len + 1) << 32) | (pos - strings_start);
+        pos += len + 1;
+    }
+    const size_t total = fbl::round_up(pos, static_cast<size_t>(8));
+    if (total > sizeof(buffer)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    memset(buffer + pos, 0, total - pos);
+    record->severity = severity;
+    record->tid = GetCurrentThreadKoid();
+    record->time = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    record->format = reinterpret_cast<uintptr_t>(msg);
+    record->num_args = static_cast<uint16_t>(num_words);
+    record->string_len = static_cast<uint32_t>(pos - strings_start);
+    memcpy(record->args, words, num_words * sizeof(uint64_t));
+
+    // Reserve space, padding out the end of the ring if the record would
+    // wrap. Acquiring |tail| orders our writes after the reader cleared the
+    // space.
+    const uint64_t mask = ring_size_ - 1;
+    uint8_t* data = reinterpret_cast<uint8_t*>(ring_) + FX_LOG_RING_DATA_OFFSET;
+    uint64_t head = __atomic_load_n(&ring_->head, __ATOMIC_RELAXED);
+    size_t pad;
+    for (;;) {
+        uint64_t tail = __atomic_load_n(&ring_->tail, __ATOMIC_ACQUIRE);
+        size_t offset = head & mask;
+        pad = (ring_size_ - offset < total) ? ring_size_ - offset : 0;
+        if (head + pad + total - tail > ring_size_) {
+            __atomic_fetch_add(&ring_->dropped_logs, 1, __ATOMIC_RELAXED);
+            dropped_logs_.fetch_add(1);
+            return ZX_ERR_SHOULD_WAIT;
+        }
+        if (__atomic_compare_exchange_n(&ring_->head, &head, head + pad + total,
+                                        true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    // Publish by storing the header word last.
+    if (pad > 0) {
+        __atomic_store_n(reinterpret_cast<uint32_t*>(data + (head & mask)),
+                         static_cast<uint32_t>(pad) | FX_LOG_RECORD_PAD | FX_LOG_RECORD_READY,
+                         __ATOMIC_RELEASE);
+        head += pad;
+    }
+    uint8_t* dst = data + (head & mask);
+    memcpy(dst + sizeof(record->header), buffer + sizeof(record->header),
+           total - sizeof(record->header));
+    __atomic_store_n(reinterpret_cast<uint32_t*>(dst),
+                     static_cast<uint32_t>(total) | FX_LOG_RECORD_READY,
+                     __ATOMIC_RELEASE);
+    return ZX_OK;
+}
+
 zx_status_t fx_logger::VLogWriteToConsoleFd(fx_log_severity_t severity,
                                             const char* tag, const char* msg,
                                             va_list args) {
@@ -160,8 +317,13 @@ zx_status_t fx_logger::VLogWrite(fx_log_severity_t severity, const char* tag,
         return ZX_OK;
     }
 
-    zx_status_t status;
-    if (socket_.is_valid()) {
+    zx_status_t status = ZX_ERR_NOT_SUPPORTED;
+    if (ring_ != nullptr) {
+        status = VLogWriteToRing(severity, tag, msg, args);
+    }
+    if (status != ZX_ERR_NOT_SUPPORTED) {
+        // Recorded in the ring, or dropped because it was full.
+    } else if (socket_.is_valid()) {
         status = VLogWriteToSocket(severity, tag, msg, args);
     } else if (console_fd_.get() != -1) {
         status = VLogWriteToConsoleFd(severity, tag, msg, args);
@@ -174,6 +336,48 @@ zx_status_t fx_logger::VLogWrite(fx_log_severity_t severity, const char* tag,
     return status;
 }
 
+// This function is not thread safe
+zx_status_t fx_logger::AttachRing(zx::vmo vmo) {
+    uint64_t vmo_size;
+    zx_status_t status = vmo.get_size(&vmo_size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    // Use the largest power of two that fits after the header.
+    if (vmo_size < FX_LOG_RING_DATA_OFFSET + FX_LOG_MAX_RECORD_LEN) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    uint64_t size = 1;
+    while (size * 2 <= fbl::min<uint64_t>(vmo_size - FX_LOG_RING_DATA_OFFSET, UINT32_MAX)) {
+        size *= 2;
+    }
+    if (size < FX_LOG_MAX_RECORD_LEN) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
+    ring_ = nullptr;
+    ring_mapping_.Unmap();
+    status = ring_mapping_.Map(vmo, FX_LOG_RING_DATA_OFFSET + size,
+                               ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE);
+    if (status != ZX_OK) {
+        return status;
+    }
+    auto ring = static_cast<fx_log_ring_t*>(ring_mapping_.start());
+    if (ring->magic != FX_LOG_RING_MAGIC || ring->size != size || ring->pid != pid_) {
+        memset(ring, 0, sizeof(*ring));
+        ring->size = static_cast<uint32_t>(size);
+        ring->pid = pid_;
+        ring->num_tags = static_cast<uint32_t>(tags_.size());
+        for (size_t i = 0; i < tags_.size(); i++) {
+            memcpy(ring->tags[i], tags_[i].c_str(), tags_[i].length() + 1);
+        }
+        __atomic_store_n(&ring->magic, FX_LOG_RING_MAGIC, __ATOMIC_RELEASE);
+    }
+    ring_size_ = static_cast<uint32_t>(size);
+    ring_ = ring;
+    return ZX_OK;
+}
+
 // This function is not thread safe
 zx_status_t fx_logger::AddTags(const char** tags, size_t ntags) {
     if (ntags > FX_LOG_MAX_TAGS) {
@@ -191,9 +395,9 @@ zx_status_t fx_logger::AddTags(const char** tags, size_t ntags) {
             } else {
                 tagstr_ = fbl::String::Concat({tagstr_, ", ", str});
             }
-        } else {
-            tags_.push_back(str);
         }
+        // Also kept in fd mode for an attached ring.
+        tags_.push_back(str);
     }
     return ZX_OK;
 }
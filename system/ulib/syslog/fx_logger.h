@@ -8,11 +8,14 @@
 #include <fbl/string.h>
 #include <fbl/unique_fd.h>
 #include <fbl/vector.h>
+#include <fbl/vmo_mapper.h>
 #include <zx/process.h>
 #include <zx/socket.h>
 #include <zx/thread.h>
+#include <zx/vmo.h>
 
 #include "syslog/logger.h"
+#include "syslog/wire_format.h"
 
 namespace {
 
@@ -58,7 +61,15 @@ public:
         return severity_.load(fbl::memory_order_relaxed);
     }
 
+    // This function is not thread safe
+    zx_status_t AttachRing(zx::vmo vmo);
+
 private:
+    // Returns ZX_ERR_NOT_SUPPORTED without consuming |args| if the message
+    // cannot be recorded in the ring.
+    zx_status_t VLogWriteToRing(fx_log_severity_t severity, const char* tag,
+                                const char* msg, va_list args);
+
     zx_status_t VLogWriteToSocket(fx_log_severity_t severity, const char* tag,
                                   const char* msg, va_list args);
 
@@ -74,6 +85,13 @@ private:
     zx::socket socket_;
     fbl::Vector<fbl::String> tags_;
 
+    // Deferred-format ring, if attached.
+    fbl::VmoMapper ring_mapping_;
+    fx_log_ring_t* ring_ = nullptr;
+    // Copy of the ring size, which the reader could otherwise change under
+    // us.
+    uint32_t ring_size_ = 0;
+
     // string representation to print in fallback mode
     fbl::String tagstr_;
 };
@@ -0,0 +1,38 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Entry points used by the log service to drain deferred-format rings.
+
+#ifndef ZIRCON_SYSTEM_ULIB_SYSLOG_INCLUDE_SYSLOG_LOG_RING_H_
+#define ZIRCON_SYSTEM_ULIB_SYSLOG_INCLUDE_SYSLOG_LOG_RING_H_
+
+#include "wire_format.h"
+
+__BEGIN_CDECLS
+
+// Copies the oldest record out of a ring mapped at |ring| for |ring_len| bytes
+// into |buffer|, which should be 8 byte aligned, and releases its space to
+// writers. There must be a single reader per ring.
+//
+// Returns ZX_ERR_SHOULD_WAIT if no record is ready, ZX_ERR_BUFFER_TOO_SMALL if
+// |len| is smaller than the record and ZX_ERR_IO_DATA_INTEGRITY if the ring is
+// corrupt.
+zx_status_t fx_log_ring_read(fx_log_ring_t* ring, size_t ring_len,
+                             void* buffer, size_t len, size_t* actual);
+
+// Formats the message of a record read by |fx_log_ring_read|.
+// |format| is the format string found at |record->format| in the writing
+// process. The message is truncated to fit |len| and always null terminated.
+//
+// Returns ZX_ERR_INVALID_ARGS if the record arguments do not match |format|.
+zx_status_t fx_log_record_format(const fx_log_record_t* record, size_t record_len,
+                                 const char* format, char* buffer, size_t len);
+
+// Returns the tag of a record, or NULL if it has none.
+const char* fx_log_record_tag(const fx_log_record_t* record, size_t record_len);
+
+__END_CDECLS
+
+#endif // ZIRCON_SYSTEM_ULIB_SYSLOG_INCLUDE_SYSLOG_LOG_RING_H_
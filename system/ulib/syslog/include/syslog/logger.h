@@ -111,6 +111,20 @@ zx_status_t fx_logger_logvf(fx_logger_t* logger, fx_log_severity_t severity,
 zx_status_t fx_logger_log(fx_logger_t* logger, fx_log_severity_t severity,
                           const char* tag, const char* msg);
 
+// Switches a logger to deferred formatting into the shared-memory ring backed
+// by |ring_vmo|, which should also be handed to the log service.
+// Messages are recorded as a format string address plus raw arguments without
+// any syscall. Messages whose format the ring cannot represent are still
+// written to the logger's socket or console fd. Messages are dropped and
+// counted when the ring is full.
+//
+// The ring header is initialized unless it already carries a valid header.
+// Returns ZX_ERR_BUFFER_TOO_SMALL if |ring_vmo| cannot hold a ring with room
+// for a maximum size record.
+// logger takes ownership of this handle.
+// This function is not thread safe and must not race with writes to |logger|.
+zx_status_t fx_logger_attach_ring(fx_logger_t* logger, zx_handle_t ring_vmo);
+
 __END_CDECLS
 
 #endif // ZIRCON_SYSTEM_ULIB_SYSLOG_INCLUDE_SYSLOG_LOGGER_H_
@@ -33,4 +33,70 @@ typedef struct fx_log_packet {
     char data[FX_LOG_MAX_DATAGRAM_LEN - sizeof(fx_log_metadata_t)];
 } fx_log_packet_t;
 
+// Deferred-format logging.
+//
+// A logger with an attached ring (see |fx_logger_attach_ring|) does not format
+// messages. It records the address of the format string in the writing process
+// along with the raw arguments into a VMO shared with the log service, which
+// resolves the format string and formats the message when it drains the ring.
+//
+// The VMO begins with an |fx_log_ring_t| header. Record data starts at
+// |FX_LOG_RING_DATA_OFFSET| and spans |size| bytes, a power of two. |head| and
+// |tail| are free-running byte counters; writers reserve space by advancing
+// |head| and the reader releases space by advancing |tail|.
+
+#define FX_LOG_RING_MAGIC (0x474e5246) // "FRNG"
+#define FX_LOG_RING_DATA_OFFSET (512)
+
+// Max no of 64-bit argument words in a record, including '*' widths and
+// precisions.
+#define FX_LOG_MAX_RECORD_ARGS (16)
+
+// Max size of a record, including inline tag and string arguments.
+#define FX_LOG_MAX_RECORD_LEN FX_LOG_MAX_DATAGRAM_LEN
+
+typedef struct fx_log_ring {
+    uint32_t magic;
+    // Size of the record area in bytes.
+    uint32_t size;
+    zx_koid_t pid;
+    uint64_t head;
+    uint64_t tail;
+    // Records dropped because the ring was full.
+    uint64_t dropped_logs;
+    // Global tags of the logger, each null terminated.
+    uint32_t num_tags;
+    uint32_t reserved;
+    char tags[FX_LOG_MAX_TAGS][FX_LOG_MAX_TAG_LEN];
+} fx_log_ring_t;
+
+// |header| holds the record size in bytes, always a multiple of 8, and these
+// flags. The writer publishes a record by storing |header| last; the reader
+// zeroes a record before releasing its space.
+#define FX_LOG_RECORD_SIZE_MASK (0x0000ffffu)
+#define FX_LOG_RECORD_READY (0x80000000u)
+// Filler up to the end of the record area. Records never wrap.
+#define FX_LOG_RECORD_PAD (0x40000000u)
+
+// |args| words for "%s" conversions hold the offset of a null terminated copy
+// of the string in the record's string area in the low 32 bits and its length,
+// including the terminator, in the high 32 bits.
+#define FX_LOG_RECORD_NULL_STRING (0xffffffffu)
+
+typedef struct fx_log_record {
+    uint32_t header;
+    fx_log_severity_t severity;
+    zx_koid_t tid;
+    zx_time_t time;
+    // Address of the format string in the writing process.
+    uint64_t format;
+    uint16_t num_args;
+    // Length of the inline tag including its terminator, or 0 if none.
+    uint16_t tag_len;
+    // Length of the string area following the tag.
+    uint32_t string_len;
+    // Followed by |num_args| argument words, the tag and the string area.
+    uint64_t args[];
+} fx_log_record_t;
+
 #endif // ZIRCON_SYSTEM_ULIB_SYSLOG_INCLUDE_SYSLOG_WIRE_FORMAT_H_
@@ -0,0 +1,362 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <syslog/log_ring.h>
+
+#include "deferred_format.h"
+
+namespace syslog {
+namespace internal {
+
+bool ParseConversion(const char* spec, Conversion* out) {
+    const char* p = spec + 1;
+    out->num_stars = 0;
+    if (*p == '%') {
+        out->length = 2;
+        out->has_arg = false;
+        return true;
+    }
+
+    // Flags.
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+        p++;
+    }
+    // Width.
+    if (*p == '*') {
+        out->num_stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+    }
+    // Precision.
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            out->num_stars++;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+    }
+
+    // Length modifier.
+    enum { kNone, kShort, kLong, kLongLong, kIntMax, kSize, kPtrDiff, kLongDouble } modifier;
+    switch (*p) {
+    case 'h':
+        p += (p[1] == 'h') ? 2 : 1;
+        modifier = kShort;
+        break;
+    case 'l':
+        if (p[1] == 'l') {
+            p += 2;
+            modifier = kLongLong;
+        } else {
+            p++;
+            modifier = kLong;
+        }
+        break;
+    case 'j':
+        p++;
+        modifier = kIntMax;
+        break;
+    case 'z':
+        p++;
+        modifier = kSize;
+        break;
+    case 't':
+        p++;
+        modifier = kPtrDiff;
+        break;
+    case 'L':
+        p++;
+        modifier = kLongDouble;
+        break;
+    default:
+        modifier = kNone;
+        break;
+    }
+
+    switch (*p) {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+        switch (modifier) {
+        case kLong:
+            out->type = ArgType::kLong;
+            break;
+        case kLongLong:
+            out->type = ArgType::kLongLong;
+            break;
+        case kIntMax:
+            out->type = ArgType::kIntMax;
+            break;
+        case kSize:
+            out->type = ArgType::kSize;
+            break;
+        case kPtrDiff:
+            out->type = ArgType::kPtrDiff;
+            break;
+        case kLongDouble:
+            return false;
+        default:
+            out->type = ArgType::kInt;
+            break;
+        }
+        break;
+    case 'c':
+        if (modifier != kNone) {
+            return false;
+        }
+        out->type = ArgType::kInt;
+        break;
+    case 'a':
+    case 'A':
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+        if (modifier != kNone && modifier != kLong) {
+            return false;
+        }
+        out->type = ArgType::kDouble;
+        break;
+    case 'p':
+        if (modifier != kNone) {
+            return false;
+        }
+        out->type = ArgType::kPointer;
+        break;
+    case 's':
+        if (modifier != kNone) {
+            return false;
+        }
+        out->type = ArgType::kString;
+        break;
+    default:
+        // "%n", "%C", "%S", and malformed or truncated conversions.
+        return false;
+    }
+
+    out->length = p + 1 - spec;
+    out->has_arg = true;
+    return out->length < kMaxConversionLen;
+}
+
+} // namespace internal
+} // namespace syslog
+
+namespace {
+
+using syslog::internal::ArgType;
+using syslog::internal::Conversion;
+
+uint8_t* RingData(fx_log_ring_t* ring) {
+    return reinterpret_cast<uint8_t*>(ring) + FX_LOG_RING_DATA_OFFSET;
+}
+
+template <typename T>
+int FormatArg(char* out, size_t len, const char* spec, const int* stars,
+              uint32_t num_stars, T value) {
+    switch (num_stars) {
+    case 0:
+        return snprintf(out, len, spec, value);
+    case 1:
+        return snprintf(out, len, spec, stars[0], value);
+    default:
+        return snprintf(out, len, spec, stars[0], stars[1], value);
+    }
+}
+
+} // namespace
+
+zx_status_t fx_log_ring_read(fx_log_ring_t* ring, size_t ring_len,
+                             void* buffer, size_t len, size_t* actual) {
+    // The writer shares the header, so everything in it is validated here
+    // rather than trusted.
+    const uint32_t size = __atomic_load_n(&ring->size, __ATOMIC_RELAXED);
+    if (ring->magic != FX_LOG_RING_MAGIC || size < FX_LOG_MAX_RECORD_LEN ||
+        (size & (size - 1)) != 0 || ring_len < FX_LOG_RING_DATA_OFFSET + size) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    uint8_t* data = RingData(ring);
+
+    // Only the reader moves |tail|.
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        const size_t offset = tail & (size - 1);
+        auto header_ptr = reinterpret_cast<uint32_t*>(data + offset);
+        const uint32_t header = __atomic_load_n(header_ptr, __ATOMIC_ACQUIRE);
+        if (!(header & FX_LOG_RECORD_READY)) {
+            return ZX_ERR_SHOULD_WAIT;
+        }
+        const size_t record_size = header & FX_LOG_RECORD_SIZE_MASK;
+        if (record_size == 0 || record_size % 8 != 0 ||
+            record_size > size - offset) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if (header & FX_LOG_RECORD_PAD) {
+            memset(data + offset, 0, record_size);
+            tail += record_size;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            continue;
+        }
+        if (record_size < sizeof(fx_log_record_t)) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        if (len < record_size) {
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        memcpy(buffer, data + offset, record_size);
+        // Zero the record so a later record starting inside it is not taken
+        // for ready before its writer publishes it.
+        memset(data + offset, 0, record_size);
+        __atomic_store_n(&ring->tail, tail + record_size, __ATOMIC_RELEASE);
+        *actual = record_size;
+        return ZX_OK;
+    }
+}
+
+zx_status_t fx_log_record_format(const fx_log_record_t* record, size_t record_len,
+                                 const char* format, char* buffer, size_t len) {
+    if (len == 0) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    buffer[0] = '\0';
+    if (record_len < sizeof(fx_log_record_t) ||
+        record->num_args > FX_LOG_MAX_RECORD_ARGS) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const size_t strings_offset = sizeof(fx_log_record_t) +
+                                  record->num_args * sizeof(uint64_t) +
+                                  record->tag_len;
+    if (strings_offset + record->string_len > record_len) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const char* strings = reinterpret_cast<const char*>(record) + strings_offset;
+
+    size_t pos = 0;
+    size_t arg = 0;
+    for (const char* p = format; *p != '\0';) {
+        if (*p != '%') {
+            if (pos + 1 < len) {
+                buffer[pos++] = *p;
+            }
+            p++;
+            continue;
+        }
+        Conversion conv;
+        if (!syslog::internal::ParseConversion(p, &conv)) {
+            buffer[pos] = '\0';
+            return ZX_ERR_INVALID_ARGS;
+        }
+        char spec[syslog::internal::kMaxConversionLen];
+        memcpy(spec, p, conv.length);
+        spec[conv.length] = '\0';
+        p += conv.length;
+        if (!conv.has_arg) {
+            if (pos + 1 < len) {
+                buffer[pos++] = '%';
+            }
+            continue;
+        }
+        if (arg + conv.num_stars + 1 > record->num_args) {
+            buffer[pos] = '\0';
+            return ZX_ERR_INVALID_ARGS;
+        }
+        int stars[2];
+        for (uint32_t i = 0; i < conv.num_stars; i++) {
+            stars[i] = static_cast<int>(record->args[arg++]);
+        }
+        const uint64_t word = record->args[arg++];
+
+        char* out = buffer + pos;
+        const size_t avail = len - pos;
+        const uint32_t n = conv.num_stars;
+        int count;
+        switch (conv.type) {
+        case ArgType::kInt:
+            count = FormatArg(out, avail, spec, stars, n, static_cast<int>(word));
+            break;
+        case ArgType::kLong:
+            count = FormatArg(out, avail, spec, stars, n, static_cast<long>(word));
+            break;
+        case ArgType::kLongLong:
+            count = FormatArg(out, avail, spec, stars, n, static_cast<long long>(word));
+            break;
+        case ArgType::kIntMax:
+            count = FormatArg(out, avail, spec, stars, n, static_cast<intmax_t>(word));
+            break;
+        case ArgType::kSize:
+            count = FormatArg(out, avail, spec, stars, n, static_cast<size_t>(word));
+            break;
+        case ArgType::kPtrDiff:
+            count = FormatArg(out, avail, spec, stars, n, static_cast<ptrdiff_t>(word));
+            break;
+        case ArgType::kDouble: {
+            double value;
+            memcpy(&value, &word, sizeof(value));
+            count = FormatArg(out, avail, spec, stars, n, value);
+            break;
+        }
+        case ArgType::kPointer:
+            count = FormatArg(out, avail, spec, stars, n,
+                              reinterpret_cast<void*>(static_cast<uintptr_t>(word)));
+            break;
+        case ArgType::kString: {
+            const uint32_t offset = static_cast<uint32_t>(word);
+            const uint32_t str_len = static_cast<uint32_t>(word >> 32);
+            const char* str;
+            if (offset == FX_LOG_RECORD_NULL_STRING) {
+                str = "(null)";
+            } else if (str_len == 0 || offset > record->string_len ||
+                       str_len > record->string_len - offset ||
+                       strings[offset + str_len - 1] != '\0') {
+                buffer[pos] = '\0';
+                return ZX_ERR_INVALID_ARGS;
+            } else {
+                str = strings + offset;
+            }
+            count = FormatArg(out, avail, spec, stars, n, str);
+            break;
+        }
+        default:
+            count = -1;
+            break;
+        }
+        if (count < 0) {
+            buffer[pos] = '\0';
+            return ZX_ERR_INVALID_ARGS;
+        }
+        pos += fbl::min(static_cast<size_t>(count), avail - 1);
+    }
+    buffer[pos] = '\0';
+    return ZX_OK;
+}
+
+const char* fx_log_record_tag(const fx_log_record_t* record, size_t record_len) {
+    if (record_len < sizeof(fx_log_record_t) || record->tag_len == 0 ||
+        record->num_args > FX_LOG_MAX_RECORD_ARGS) {
+        return nullptr;
+    }
+    const size_t tag_offset = sizeof(fx_log_record_t) +
+                              record->num_args * sizeof(uint64_t);
+    if (tag_offset + record->tag_len > record_len) {
+        return nullptr;
+    }
+    const char* tag = reinterpret_cast<const char*>(record) + tag_offset;
+    return tag[record->tag_len - 1] == '\0' ? tag : nullptr;
+}
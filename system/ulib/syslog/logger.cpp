@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fbl/type_support.h>
 #include <syslog/logger.h>
 
 #include "fx_logger.h"
@@ -66,6 +67,14 @@ zx_status_t fx_logger_create(const fx_logger_config_t* config,
     return ZX_OK;
 }
 
+zx_status_t fx_logger_attach_ring(fx_logger_t* logger, zx_handle_t ring_vmo) {
+    zx::vmo vmo(ring_vmo);
+    if (logger == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+    return logger->AttachRing(fbl::move(vmo));
+}
+
 void fx_logger_destroy(fx_logger_t* logger) {
     delete logger;
 }
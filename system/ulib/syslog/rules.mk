@@ -9,9 +9,11 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := userlib
 
 MODULE_SRCS = \
+    $(LOCAL_DIR)/deferred_format.h \
     $(LOCAL_DIR)/fx_logger.h \
     $(LOCAL_DIR)/fx_logger.cpp \
     $(LOCAL_DIR)/global.cpp \
+    $(LOCAL_DIR)/log_ring.cpp \
     $(LOCAL_DIR)/logger.cpp \
 
 MODULE_EXPORT := so
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <zircon/compiler.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/types.h>
 
 __BEGIN_CDECLS
@@ -48,6 +49,34 @@ zx_status_t walk_root_job_tree(task_callback_t job_callback,
                                task_callback_t thread_callback,
                                void* context);
 
+// Called on each task (job/process/thread) in a snapshot taken by
+// walk_job_tree_snapshot().
+//
+// context: The same value passed to walk_[root_]job_tree_snapshot().
+// node: The task. Its depth and parent_koid are as for task_callback_t,
+//     except that the parent_koid of the root job is that of its own parent.
+//
+// If the callback returns a value other than ZX_OK, the walk will terminate
+// without visiting any other node, and the zx_status_t value will be
+// returned by walk_job_tree_snapshot().
+typedef zx_status_t(task_node_callback_t)(
+    void* context, const zx_info_task_node_t* node);
+
+// Takes a snapshot of the job/process/thread tree rooted in root_job with
+// ZX_INFO_JOB_TREE, and visits the tasks in it in the same order as
+// walk_job_tree(). The snapshot is taken with a single system call and no
+// handles to the tasks, so callers which only need what zx_info_task_node_t
+// holds should prefer this to walk_job_tree().
+// |context| is passed to all callbacks.
+zx_status_t walk_job_tree_snapshot(zx_handle_t root_job,
+                                   task_node_callback_t callback,
+                                   void* context);
+
+// Calls walk_job_tree_snapshot() on the system's root job. Will fail if the
+// calling process does not have the rights to access the root job.
+zx_status_t walk_root_job_tree_snapshot(task_node_callback_t callback,
+                                        void* context);
+
 __END_CDECLS
 
 // C++ interface
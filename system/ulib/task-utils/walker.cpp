@@ -323,30 +323,113 @@ zx_status_t walk_job_tree(zx_handle_t root_job,
         &ctx, root_job, root_job_koid, /* depth */ 1);
 }
 
-zx_status_t walk_root_job_tree(task_callback_t job_callback,
-                               task_callback_t process_callback,
-                               task_callback_t thread_callback,
-                               void* context) {
+// Gets a handle to the system's root job.
+static zx_status_t get_root_job(zx_handle_t* root_job) {
     int fd = open("/dev/misc/sysinfo", O_RDWR);
     if (fd < 0) {
         fprintf(stderr, "task-utils/walker: cannot open sysinfo: %d\n", errno);
         return ZX_ERR_NOT_FOUND;
     }
 
-    zx_handle_t root_job;
-    size_t n = ioctl_sysinfo_get_root_job(fd, &root_job);
+    size_t n = ioctl_sysinfo_get_root_job(fd, root_job);
     close(fd);
-    if (n != sizeof(root_job)) {
+    if (n != sizeof(*root_job)) {
         fprintf(stderr, "task-utils/walker: cannot obtain root job\n");
         return ZX_ERR_NOT_FOUND;
     }
+    return ZX_OK;
+}
+
+zx_status_t walk_root_job_tree(task_callback_t job_callback,
+                               task_callback_t process_callback,
+                               task_callback_t thread_callback,
+                               void* context) {
+    zx_handle_t root_job;
+    zx_status_t s = get_root_job(&root_job);
+    if (s != ZX_OK) {
+        return s;
+    }
 
-    zx_status_t s = walk_job_tree(
+    s = walk_job_tree(
         root_job, job_callback, process_callback, thread_callback, context);
     zx_handle_close(root_job);
     return s;
 }
 
+// best first guess at number of tasks in a snapshot
+static const size_t kNumInitialNodes = 512;
+
+zx_status_t walk_job_tree_snapshot(zx_handle_t root_job,
+                                   task_node_callback_t callback,
+                                   void* context) {
+    zx_info_task_node_t* nodes = nullptr;
+    size_t capacity = kNumInitialNodes;
+    size_t actual = 0;
+    size_t avail = 0;
+    zx_status_t status;
+
+    // tasks come and go between the two passes, so leave room for some to
+    // be added when growing the buffer
+    for (int pass = 0; pass < 2; ++pass) {
+        if (actual < avail) {
+            capacity = avail + avail / 8 + kNumExtraKoids;
+        }
+        zx_info_task_node_t* grown = reinterpret_cast<zx_info_task_node_t*>(
+            realloc(nodes, capacity * sizeof(nodes[0])));
+        if (grown == nullptr) {
+            free(nodes);
+            return ZX_ERR_NO_MEMORY;
+        }
+        nodes = grown;
+        status = zx_object_get_info(root_job, ZX_INFO_JOB_TREE, nodes,
+                                    capacity * sizeof(nodes[0]),
+                                    &actual, &avail);
+        if (status != ZX_OK) {
+            fprintf(stderr,
+                    "ERROR: zx_object_get_info(ZX_INFO_JOB_TREE, ...) "
+                    "failed: %s (%d)\n",
+                    zx_status_get_string(status), status);
+            free(nodes);
+            return status;
+        }
+        if (actual == avail) {
+            break;
+        }
+    }
+
+    // if we're still too small at least warn the user
+    if (actual < avail) {
+        fprintf(stderr,
+                "WARNING: zx_object_get_info(ZX_INFO_JOB_TREE, ...) "
+                "truncated %zu/%zu results\n",
+                avail - actual, avail);
+    }
+
+    for (size_t n = 0; n < actual; n++) {
+        status = callback(context, &nodes[n]);
+        // abort on failure
+        if (status != ZX_OK) {
+            break;
+        }
+    }
+
+    free(nodes);
+    return status;
+}
+
+zx_status_t walk_root_job_tree_snapshot(task_node_callback_t callback,
+                                        void* context) {
+    zx_handle_t root_job;
+    zx_status_t s = get_root_job(&root_job);
+    if (s != ZX_OK) {
+        return s;
+    }
+
+    s = walk_job_tree_snapshot(root_job, callback, context);
+    zx_handle_close(root_job);
+    return s;
+}
+
 // C++ interface
 
 namespace {
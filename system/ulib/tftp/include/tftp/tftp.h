@@ -238,6 +238,13 @@ void tftp_session_set_max_timeouts(tftp_session* session,
 void tftp_session_set_opcode_prefix_use(tftp_session* session,
                                         bool enable);
 
+// Caps the block size negotiated by the session, whatever the remote host
+// asks for or tftp_set_options() specifies. Transports that can carry large
+// frames should raise this as far as their MTU allows, as the block size
+// bounds how much data is in flight per window.
+void tftp_session_set_max_block_size(tftp_session* session,
+                                     uint16_t max_block_size);
+
 // When acting as a server, the options that will be overridden when a
 // value is requested by the client. Note that if the client does not
 // specify a setting, the default will be used regardless of server
@@ -48,6 +48,7 @@ typedef struct tftp_data_msg_t {
 #define DEFAULT_MODE MODE_OCTET
 #define DEFAULT_MAX_TIMEOUTS 5
 #define DEFAULT_USE_OPCODE_PREFIX true
+#define MAX_BLOCKSIZE 65464
 
 typedef struct tftp_options_t {
     // A bitmask of the options that have been set
@@ -172,6 +173,10 @@ struct tftp_session_t {
     // no-no in IPv6). This modification is not RFC-compatible.
     bool use_opcode_prefix;
 
+    // Largest block size we will negotiate, so that a DATA packet fits in a
+    // single frame of the underlying transport
+    uint16_t max_block_size;
+
     // "Negotiated" values
     size_t file_size;
     uint16_t window_size;
@@ -639,6 +639,41 @@ static bool test_tftp_receive_force_wrq_have_overrides(void) {
                               true, true, true);
 }
 
+// Verify that a block size larger than the transport can carry is negotiated down
+static bool test_tftp_receive_wrq_max_blocksize(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 1024, 1500);
+    tftp_file_interface ifc = {dummy_open_read, dummy_open_write, NULL, NULL, NULL};
+    tftp_session_set_file_interface(ts.session, &ifc);
+    constexpr uint16_t kMaxBlockSize = 8192;
+    tftp_session_set_max_block_size(ts.session, kMaxBlockSize);
+
+    char buf[256];
+    buf[0] = 0x00;
+    buf[1] = OPCODE_WRQ;
+    size_t buf_sz = 2;
+    buf_sz += snprintf(&buf[buf_sz], sizeof(buf) - buf_sz,
+                       "%s%cOCTET%cTSIZE%c%d%cBLKSIZE!%c%d",
+                       kRemoteFilename, '\0', '\0', '\0', 1024, '\0', '\0', 65464) + 1;
+    ASSERT_LT(buf_sz, (int)sizeof(buf), "insufficient space for request");
+    auto status = tftp_process_msg(ts.session, buf, buf_sz, ts.out, &ts.outlen, &ts.timeout,
+                                   nullptr);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive write request failed");
+    EXPECT_TRUE(verify_response_opcode(ts, OPCODE_OACK), "bad response");
+
+    char opt_str[256];
+    size_t opt_str_sz = snprintf(opt_str, sizeof(opt_str), "BLKSIZE%c%d",
+                                 '\0', kMaxBlockSize) + 1;
+    EXPECT_TRUE(find_str_in_mem(opt_str, opt_str_sz, static_cast<const char*>(ts.out),
+                                ts.outlen),
+                "block size not capped in oack");
+    EXPECT_EQ(kMaxBlockSize, ts.session->block_size, "bad session: block size");
+
+    END_TEST;
+}
+
 static bool test_tftp_receive_rrq_blocksize(void) {
     constexpr uint8_t kDefaultTimeout = 4;
     constexpr uint16_t kBlocksize = 1024;
@@ -2006,6 +2041,7 @@ RUN_TEST(test_tftp_receive_wrq_windowsize)
 RUN_TEST(test_tftp_receive_wrq_have_overrides)
 RUN_TEST(test_tftp_receive_force_wrq_no_overrides)
 RUN_TEST(test_tftp_receive_force_wrq_have_overrides)
+RUN_TEST(test_tftp_receive_wrq_max_blocksize)
 END_TEST_CASE(tftp_receive_wrq)
 
 BEGIN_TEST_CASE(tftp_receive_rrq)
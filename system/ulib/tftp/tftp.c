@@ -239,6 +239,7 @@ int tftp_init(tftp_session** session, void* buffer, size_t size) {
     s->mode = DEFAULT_MODE;
     s->max_timeouts = DEFAULT_MAX_TIMEOUTS;
     s->use_opcode_prefix = DEFAULT_USE_OPCODE_PREFIX;
+    s->max_block_size = MAX_BLOCKSIZE;
 
     return TFTP_NO_ERROR;
 }
@@ -360,6 +361,9 @@ tftp_status tftp_generate_request(tftp_session* session,
             force_value = false;
             sent_opts->block_size = session->options.block_size;
         }
+        if (sent_opts->block_size > session->max_block_size) {
+            sent_opts->block_size = session->max_block_size;
+        }
         append_option(&body, &left, kBlkSize, force_value, "%"PRIu16, sent_opts->block_size);
         sent_opts->mask |= BLOCKSIZE_OPTION;
     }
@@ -492,8 +496,7 @@ tftp_status tftp_handle_request(tftp_session* session,
             bool force_block_size = (option[kBlkSizeLen] == '!');
             // Valid values range between "8" and "65464" octets, inclusive
             long val = atol(value);
-            // TODO(tkilbourn): with an MTU of 1500, shouldn't be more than 1428
-            if (val < 8 || val > 65464) {
+            if (val < 8 || val > MAX_BLOCKSIZE) {
                 xprintf("invalid block size\n");
                 set_error(session, TFTP_ERR_CODE_BAD_OPTIONS, resp, resp_len, "invalid block size");
                 return TFTP_ERR_INTERNAL;
@@ -505,6 +508,10 @@ tftp_status tftp_handle_request(tftp_session* session,
             } else {
                 session->block_size = override_opts->block_size;
             }
+            // The OACK tells the client if we settled on less than it asked
+            if (session->block_size > session->max_block_size) {
+                session->block_size = session->max_block_size;
+            }
         } else if (!strncasecmp(option, kTimeout, kTimeoutLen)) { // RFC 2349
             bool force_timeout_val = (option[kTimeoutLen] == '!');
             // Valid values range between "1" and "255" seconds inclusive.
@@ -871,14 +878,14 @@ tftp_status tftp_handle_oack(tftp_session* session,
                 set_error(session, TFTP_ERR_CODE_BAD_OPTIONS, resp, resp_len, "no block size");
                 return TFTP_ERR_INTERNAL;
             }
-            // Valid values range between "8" and "65464" octets, inclusive
+            // Valid values range between "8" and "65464" octets, inclusive, and
+            // must also fit within what our transport can carry
             long val = atol(value);
-            if (val < 8 || val > 65464) {
+            if (val < 8 || val > session->max_block_size) {
                 xprintf("invalid block size\n");
                 set_error(session, TFTP_ERR_CODE_BAD_OPTIONS, resp, resp_len, "invalid block size");
                 return TFTP_ERR_INTERNAL;
             }
-            // TODO(tkilbourn): with an MTU of 1500, shouldn't be more than 1428
             session->block_size = val;
         } else if (!strncasecmp(option, kTimeout, kTimeoutLen)) { // RFC 2349
             if (!(session->client_sent_opts.mask & TIMEOUT_OPTION)) {
@@ -1018,6 +1025,11 @@ void tftp_session_set_opcode_prefix_use(tftp_session* session,
     session->use_opcode_prefix = enable;
 }
 
+void tftp_session_set_max_block_size(tftp_session* session,
+                                     uint16_t max_block_size) {
+    session->max_block_size = MIN(max_block_size, MAX_BLOCKSIZE);
+}
+
 tftp_status tftp_timeout(tftp_session* session,
                          void* msg_buf,
                          size_t* msg_len,
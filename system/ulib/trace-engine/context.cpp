@@ -113,6 +113,15 @@ struct ContextCache {
 
     // Storage for the string entries.
     StringEntry string_entries[kMaxStringEntries];
+
+    // The chunk of the trace buffer this thread is filling.
+    // |chunk_current| is where the next record goes, and the space between
+    // it and |chunk_end| is always covered by a padding record.
+    uint64_t* chunk_current{nullptr};
+    uint64_t* chunk_end{nullptr};
+
+    // The chunk epoch of the context when the chunk was claimed.
+    uint32_t chunk_epoch{0u};
 };
 thread_local fbl::unique_ptr<ContextCache> tls_cache{};
 
@@ -130,6 +139,9 @@ ContextCache* GetCurrentContextCache(uint32_t generation) {
     cache->generation = generation;
     cache->thread_ref = trace_make_unknown_thread_ref();
     cache->string_table.clear();
+    cache->chunk_current = nullptr;
+    cache->chunk_end = nullptr;
+    cache->chunk_epoch = 0u;
     return cache;
 }
 
@@ -160,6 +172,52 @@ inline constexpr uint64_t MakeRecordHeader(RecordType type, size_t size) {
            RecordFields::RecordSize::Make(size >> 3);
 }
 
+// The size of the pieces of the buffer claimed by each thread.
+constexpr size_t kChunkSizeBytes = 4096u;
+
+// Larger records are allocated from the shared buffer rather than from the
+// chunks, where they would leave too much space unused.
+constexpr size_t kChunkMaxRecordBytes = kChunkSizeBytes / 4u;
+
+// The size of the record which begins each chunk.
+constexpr size_t kBeginChunkRecordSizeBytes = WordsToBytes(2);
+
+inline constexpr uint64_t MakeBufferChunkRecordHeader(BufferChunkType type, size_t size) {
+    return MakeRecordHeader(RecordType::kBufferChunk, size) |
+           BufferChunkRecordFields::ChunkType::Make(ToUnderlyingType(type));
+}
+
+// Allocates a record from the chunk held by the current thread, claiming a
+// new chunk when that one is full or has been invalidated.
+uint64_t* AllocChunkRecord(trace_context_t* context, ContextCache* cache,
+                           size_t num_bytes) {
+    uint32_t epoch = context->chunk_epoch();
+    if (unlikely(cache->chunk_epoch != epoch ||
+                 num_bytes > WordsToBytes(cache->chunk_end - cache->chunk_current))) {
+        // The rest of the current chunk, if any, is already padded.
+        uint64_t* chunk = reinterpret_cast<uint64_t*>(context->ClaimChunk(kChunkSizeBytes));
+        if (unlikely(!chunk))
+            return nullptr;
+        chunk[0] = MakeBufferChunkRecordHeader(BufferChunkType::kBegin,
+                                               kBeginChunkRecordSizeBytes) |
+                   BeginBufferChunkRecordFields::ChunkSize::Make(
+                       BytesToWords(kChunkSizeBytes));
+        chunk[1] = GetCurrentThreadKoid();
+        cache->chunk_current = chunk + BytesToWords(kBeginChunkRecordSizeBytes);
+        cache->chunk_end = chunk + BytesToWords(kChunkSizeBytes);
+        cache->chunk_epoch = epoch;
+    }
+
+    uint64_t* ptr = cache->chunk_current;
+    cache->chunk_current += BytesToWords(num_bytes);
+    if (cache->chunk_current != cache->chunk_end) {
+        *cache->chunk_current = MakeBufferChunkRecordHeader(
+            BufferChunkType::kPadding,
+            WordsToBytes(cache->chunk_end - cache->chunk_current));
+    }
+    return ptr;
+}
+
 inline constexpr uint64_t MakeArgumentHeader(ArgumentType type, size_t size,
                                              const trace_string_ref_t* name_ref) {
     return ArgumentFields::Type::Make(ToUnderlyingType(type)) |
@@ -226,6 +284,13 @@ public:
     explicit Payload(trace_context_t* context, size_t num_bytes)
         : ptr_(context->AllocRecord(num_bytes)) {}
 
+    // Selects the constructor which allocates a durable record, see
+    // |trace_context::AllocDurableRecord()|.
+    struct Durable {};
+
+    explicit Payload(trace_context_t* context, size_t num_bytes, Durable)
+        : ptr_(context->AllocDurableRecord(num_bytes)) {}
+
     explicit operator bool() const {
         return ptr_ != nullptr;
     }
@@ -461,6 +526,7 @@ void trace_context_register_string_copy(
     trace_string_index_t index;
     if (likely(context->AllocStringIndex(&index))) {
         trace_context_write_string_record(context, index, string, length);
+        context->InvalidateChunks();
         *out_ref = trace_make_indexed_string_ref(index);
     } else {
         *out_ref = trace_make_inline_string_ref(string, length);
@@ -530,6 +596,7 @@ void trace_context_register_thread(
     trace_thread_index_t index;
     if (likely(context->AllocThreadIndex(&index))) {
         trace_context_write_thread_record(context, index, process_koid, thread_koid);
+        context->InvalidateChunks();
         *out_ref = trace_make_indexed_thread_ref(index);
     } else {
         *out_ref = trace_make_inline_thread_ref(process_koid, thread_koid);
@@ -861,7 +928,7 @@ void trace_context_write_initialization_record(
     uint64_t ticks_per_second) {
     const size_t record_size = sizeof(trace::RecordHeader) +
                                trace::WordsToBytes(1);
-    trace::Payload payload(context, record_size);
+    trace::Payload payload(context, record_size, trace::Payload::Durable());
     if (payload) {
         payload
             .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kInitialization, record_size))
@@ -880,7 +947,7 @@ void trace_context_write_string_record(
 
     const size_t record_size = sizeof(trace::RecordHeader) +
                                trace::Pad(length);
-    trace::Payload payload(context, record_size);
+    trace::Payload payload(context, record_size, trace::Payload::Durable());
     if (payload) {
         payload
             .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kString, record_size) |
@@ -900,7 +967,7 @@ void trace_context_write_thread_record(
 
     const size_t record_size = sizeof(trace::RecordHeader) +
                                trace::WordsToBytes(2);
-    trace::Payload payload(context, record_size);
+    trace::Payload payload(context, record_size, trace::Payload::Durable());
     if (payload) {
         payload
             .WriteUint64(trace::MakeRecordHeader(trace::RecordType::kThread, record_size) |
@@ -917,48 +984,229 @@ void* trace_context_alloc_record(trace_context_t* context, size_t num_bytes) {
 /* struct trace_context */
 
 trace_context::trace_context(void* buffer, size_t buffer_num_bytes,
+                             trace_buffering_mode_t buffering_mode,
                              trace_handler_t* handler)
     : generation_(trace::g_next_generation.fetch_add(1u, fbl::memory_order_relaxed) + 1u),
+      buffering_mode_(buffering_mode),
       buffer_start_(static_cast<uint8_t*>(buffer)),
       buffer_end_(buffer_start_ + buffer_num_bytes),
-      buffer_current_(reinterpret_cast<uintptr_t>(buffer_start_)),
-      buffer_full_mark_(0u),
+      header_(buffering_mode == TRACE_BUFFERING_MODE_ONESHOT
+                  ? nullptr
+                  : static_cast<trace_buffer_header_t*>(buffer)),
       handler_(handler) {
     ZX_DEBUG_ASSERT(generation_ != 0u);
+
+    rolling_state_[0].store(kRollingActive, fbl::memory_order_relaxed);
+    rolling_state_[1].store(kRollingFree, fbl::memory_order_relaxed);
+
+    if (!header_) {
+        rolling_[0].Init(buffer_start_, buffer_num_bytes);
+        return;
+    }
+
+    // The durable buffer gets a sixteenth of the space, the rolling buffers
+    // share the rest.
+    ZX_DEBUG_ASSERT(buffer_num_bytes >= kMinRollingModeBufferSize);
+    size_t available = buffer_num_bytes - sizeof(trace_buffer_header_t);
+    size_t durable_size = fbl::round_down(available / 16u, 8u);
+    size_t rolling_size = fbl::round_down((available - durable_size) / 2u, 8u);
+    durable_.Init(buffer_start_ + sizeof(trace_buffer_header_t), durable_size);
+    rolling_[0].Init(durable_.end(), rolling_size);
+    rolling_[1].Init(rolling_[0].end(), rolling_size);
+
+    memset(header_, 0, sizeof(*header_));
+    header_->magic = TRACE_BUFFER_HEADER_MAGIC;
+    header_->version = TRACE_BUFFER_HEADER_VERSION;
+    header_->buffering_mode = static_cast<uint8_t>(buffering_mode_);
+    header_->total_size = buffer_num_bytes;
+    header_->durable_buffer_size = durable_size;
+    header_->rolling_buffer_size = rolling_size;
 }
 
 trace_context::~trace_context() = default;
 
 uint64_t* trace_context::AllocRecord(size_t num_bytes) {
     ZX_DEBUG_ASSERT((num_bytes & 7) == 0);
+    if (likely(num_bytes <= trace::kChunkMaxRecordBytes)) {
+        trace::ContextCache* cache = trace::GetCurrentContextCache(generation_);
+        if (likely(cache)) {
+            uint64_t* ptr = trace::AllocChunkRecord(this, cache, num_bytes);
+            if (likely(ptr))
+                return ptr;
+        }
+    }
+    return AllocSharedRecord(num_bytes);
+}
+
+uint64_t* trace_context::AllocDurableRecord(size_t num_bytes) {
+    ZX_DEBUG_ASSERT((num_bytes & 7) == 0);
+    if (!is_rolling())
+        return AllocRecord(num_bytes);
     if (unlikely(num_bytes > TRACE_ENCODED_RECORD_MAX_LENGTH))
         return nullptr;
 
-    uint8_t* ptr = reinterpret_cast<uint8_t*>(
-        buffer_current_.fetch_add(num_bytes,
-                                  fbl::memory_order_relaxed));
-    if (likely(ptr + num_bytes <= buffer_end_)) {
-        ZX_DEBUG_ASSERT(ptr + num_bytes >= buffer_start_);
-        return reinterpret_cast<uint64_t*>(ptr); // success!
+    bool newly_full;
+    uint8_t* ptr = durable_.Alloc(num_bytes, &newly_full);
+    if (likely(ptr))
+        return reinterpret_cast<uint64_t*>(ptr);
+    RecordDropped();
+    return nullptr;
+}
+
+uint8_t* trace_context::ClaimChunk(size_t num_bytes) {
+    if (!is_rolling())
+        return rolling_[0].Claim(num_bytes);
+
+    for (;;) {
+        uint32_t wrapped_count = wrapped_count_.load(fbl::memory_order_seq_cst);
+        uint8_t* ptr = rolling_[wrapped_count & 1u].Claim(num_bytes);
+        if (likely(ptr))
+            return ptr;
+        if (!SwitchRollingBuffer(wrapped_count))
+            return nullptr;
     }
+}
 
-    // Buffer is full!
-    // Snap to the endpoint to reduce likelihood of pointer wrap-around.
-    buffer_current_.store(reinterpret_cast<uintptr_t>(buffer_end_),
-                          fbl::memory_order_relaxed);
+uint64_t* trace_context::AllocSharedRecord(size_t num_bytes) {
+    if (unlikely(num_bytes > TRACE_ENCODED_RECORD_MAX_LENGTH))
+        return nullptr;
+
+    bool newly_full;
+    if (!is_rolling()) {
+        uint8_t* ptr = rolling_[0].Alloc(num_bytes, &newly_full);
+        if (likely(ptr))
+            return reinterpret_cast<uint64_t*>(ptr); // success!
 
-    // Mark the end point if not already marked.
-    uintptr_t expected_mark = 0u;
-    if (buffer_full_mark_.compare_exchange_strong(&expected_mark,
-                                                  reinterpret_cast<uintptr_t>(ptr),
-                                                  fbl::memory_order_relaxed,
-                                                  fbl::memory_order_relaxed)) {
         // Notify the trace manager so it can notify the user that a record
         // (likely) got dropped.
+        if (newly_full)
+            handler_->ops->buffer_overflow(handler_);
+        return nullptr;
+    }
+
+    // A record which cannot fit in an empty rolling buffer must not make
+    // us discard one.
+    if (unlikely(num_bytes > rolling_[0].size())) {
+        RecordDropped();
+        return nullptr;
+    }
+    for (;;) {
+        uint32_t wrapped_count = wrapped_count_.load(fbl::memory_order_seq_cst);
+        uint8_t* ptr = rolling_[wrapped_count & 1u].Alloc(num_bytes, &newly_full);
+        if (likely(ptr))
+            return reinterpret_cast<uint64_t*>(ptr);
+        if (!SwitchRollingBuffer(wrapped_count)) {
+            RecordDropped();
+            return nullptr;
+        }
+    }
+}
+
+bool trace_context::SwitchRollingBuffer(uint32_t wrapped_count) {
+    // Only the thread which finds the buffer full moves writing along.
+    uint32_t index = wrapped_count & 1u;
+    uint32_t expected = kRollingActive;
+    if (rolling_state_[index].compare_exchange_strong(&expected, kRollingFull,
+                                                      fbl::memory_order_seq_cst,
+                                                      fbl::memory_order_seq_cst)) {
+        // If the other buffer is still waiting to be saved writing stalls
+        // until it is freed, see |FreeRollingBuffer()|.
+        PromoteRollingBuffer(index ^ 1u, wrapped_count);
+        trace::RequestRollingBufferService();
+    }
+    return wrapped_count_.load(fbl::memory_order_seq_cst) != wrapped_count;
+}
+
+void trace_context::PromoteRollingBuffer(uint32_t index, uint32_t wrapped_count) {
+    uint32_t expected = kRollingFree;
+    if (!rolling_state_[index].compare_exchange_strong(&expected, kRollingActive,
+                                                       fbl::memory_order_seq_cst,
+                                                       fbl::memory_order_seq_cst))
+        return;
+
+    // No thread writes into a free buffer, so it can be emptied now.
+    // Threads move over once they see the new wrapped count.
+    rolling_[index].Reset();
+    wrapped_count_.store(wrapped_count + 1u, fbl::memory_order_seq_cst);
+    InvalidateChunks();
+}
+
+void trace_context::FreeRollingBuffer(uint32_t index) {
+    rolling_state_[index].store(kRollingFree, fbl::memory_order_seq_cst);
+
+    // Buffers are freed in the order they filled up, so this is never the
+    // one being written.
+    uint32_t wrapped_count = wrapped_count_.load(fbl::memory_order_seq_cst);
+    ZX_DEBUG_ASSERT(index != (wrapped_count & 1u));
+    if (rolling_state_[index ^ 1u].load(fbl::memory_order_seq_cst) != kRollingActive) {
+        // Writing stalled in the other buffer.
+        PromoteRollingBuffer(index, wrapped_count);
+    }
+}
+
+uint32_t trace_context::RollingBufferWrappedCount(uint32_t index) const {
+    uint32_t wrapped_count = wrapped_count_.load(fbl::memory_order_seq_cst);
+    return (wrapped_count & 1u) == index ? wrapped_count : wrapped_count - 1u;
+}
+
+void trace_context::RecordDropped() {
+    if (num_records_dropped_.fetch_add(1u, fbl::memory_order_relaxed) == 0u)
         handler_->ops->buffer_overflow(handler_);
+}
+
+bool trace_context::HasFullRollingBuffer() const {
+    return rolling_state_[0].load(fbl::memory_order_seq_cst) == kRollingFull ||
+           rolling_state_[1].load(fbl::memory_order_seq_cst) == kRollingFull;
+}
+
+size_t trace_context::RetireFullRollingBuffers(uint32_t out_wrapped_counts[2]) {
+    ZX_DEBUG_ASSERT(is_rolling());
+
+    // Deal with the older buffer first, so that if writing stalled in the
+    // newer one it moves on to the older one.
+    uint32_t newer = wrapped_count_.load(fbl::memory_order_seq_cst) & 1u;
+    uint32_t order[2] = {newer ^ 1u, newer};
+    size_t count = 0u;
+    for (uint32_t index : order) {
+        if (rolling_state_[index].load(fbl::memory_order_seq_cst) != kRollingFull)
+            continue;
+        if (buffering_mode_ == TRACE_BUFFERING_MODE_CIRCULAR) {
+            // Keep the contents, they are the oldest records until the
+            // buffer is written again.
+            FreeRollingBuffer(index);
+        } else {
+            rolling_state_[index].store(kRollingSaving, fbl::memory_order_seq_cst);
+            out_wrapped_counts[count++] = RollingBufferWrappedCount(index);
+        }
     }
+    return count;
+}
 
-    return nullptr;
+zx_status_t trace_context::MarkRollingBufferSaved(uint32_t wrapped_count) {
+    uint32_t index = wrapped_count & 1u;
+    if (!is_rolling() ||
+        rolling_state_[index].load(fbl::memory_order_seq_cst) != kRollingSaving ||
+        RollingBufferWrappedCount(index) != wrapped_count)
+        return ZX_ERR_BAD_STATE;
+
+    // Buffers must be saved in the order they filled up.
+    if (rolling_state_[index ^ 1u].load(fbl::memory_order_seq_cst) == kRollingSaving &&
+        RollingBufferWrappedCount(index ^ 1u) < wrapped_count)
+        return ZX_ERR_BAD_STATE;
+
+    rolling_[index].Reset();
+    FreeRollingBuffer(index);
+    return ZX_OK;
+}
+
+void trace_context::UpdateBufferHeader(size_t durable_data_end) {
+    ZX_DEBUG_ASSERT(header_);
+
+    header_->wrapped_count = wrapped_count_.load(fbl::memory_order_seq_cst);
+    header_->durable_data_end = durable_data_end;
+    header_->rolling_data_end[0] = rolling_[0].bytes_allocated();
+    header_->rolling_data_end[1] = rolling_[1].bytes_allocated();
+    header_->num_records_dropped = num_records_dropped_.load(fbl::memory_order_relaxed);
 }
 
 bool trace_context::AllocThreadIndex(trace_thread_index_t* out_index) {
@@ -984,3 +1232,49 @@ bool trace_context::AllocStringIndex(trace_string_index_t* out_index) {
     *out_index = index;
     return true;
 }
+
+/* class BufferRegion */
+
+namespace trace {
+
+uint8_t* BufferRegion::Alloc(size_t num_bytes, bool* out_newly_full) {
+    uint8_t* ptr = reinterpret_cast<uint8_t*>(
+        current_.fetch_add(num_bytes, fbl::memory_order_relaxed));
+    if (likely(ptr + num_bytes <= end_)) {
+        ZX_DEBUG_ASSERT(ptr + num_bytes >= start_);
+        return ptr; // success!
+    }
+
+    // Region is full!
+    // Snap to the endpoint to reduce likelihood of pointer wrap-around.
+    current_.store(reinterpret_cast<uintptr_t>(end_), fbl::memory_order_relaxed);
+
+    // Mark the end point.  Threads which fail at the same time may get here
+    // in any order: keep the lowest mark, past which nothing was written.
+    uintptr_t mark = fbl::min(reinterpret_cast<uintptr_t>(ptr),
+                              reinterpret_cast<uintptr_t>(end_));
+    uintptr_t expected_mark = 0u;
+    *out_newly_full = false;
+    while (!full_mark_.compare_exchange_weak(&expected_mark, mark,
+                                             fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed)) {
+        if (expected_mark != 0u && expected_mark <= mark)
+            return nullptr;
+    }
+    *out_newly_full = expected_mark == 0u;
+    return nullptr;
+}
+
+uint8_t* BufferRegion::Claim(size_t num_bytes) {
+    uintptr_t current = current_.load(fbl::memory_order_relaxed);
+    do {
+        uint8_t* ptr = reinterpret_cast<uint8_t*>(current);
+        if (ptr > end_ || static_cast<size_t>(end_ - ptr) < num_bytes)
+            return nullptr;
+    } while (!current_.compare_exchange_weak(&current, current + num_bytes,
+                                             fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed));
+    return reinterpret_cast<uint8_t*>(current);
+}
+
+} // namespace trace
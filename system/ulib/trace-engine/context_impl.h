@@ -6,17 +6,94 @@
 
 #include <zircon/assert.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/atomic.h>
 
+#include <trace-engine/buffer.h>
 #include <trace-engine/context.h>
 #include <trace-engine/handler.h>
 
+namespace trace {
+
+// A part of the trace buffer which records are allocated from.
+// Allocation is lock-free; |Reset()| must only be called while no other
+// thread can be allocating from the region.
+class BufferRegion {
+public:
+    void Init(uint8_t* start, size_t num_bytes) {
+        start_ = start;
+        end_ = start + num_bytes;
+        Reset();
+    }
+
+    uint8_t* start() const { return start_; }
+    uint8_t* end() const { return end_; }
+    size_t size() const { return end_ - start_; }
+
+    bool is_full() const {
+        return full_mark_.load(fbl::memory_order_relaxed) != 0u;
+    }
+
+    // The number of bytes at the start of the region which hold records.
+    size_t bytes_allocated() const {
+        uintptr_t tail = full_mark_.load(fbl::memory_order_relaxed);
+        if (!tail) {
+            tail = fbl::min(current_.load(fbl::memory_order_relaxed),
+                            reinterpret_cast<uintptr_t>(end_));
+        }
+        return reinterpret_cast<uint8_t*>(tail) - start_;
+    }
+
+    // Allocates |num_bytes| of the region.
+    // Returns nullptr and marks the region full if there is not enough room
+    // left, setting |*out_newly_full| if it was not full before.
+    uint8_t* Alloc(size_t num_bytes, bool* out_newly_full);
+
+    // Like |Alloc()|, but does not mark the region full on failure: smaller
+    // allocations may still fit.
+    uint8_t* Claim(size_t num_bytes);
+
+    // Discards the contents of the region.
+    void Reset() {
+        current_.store(reinterpret_cast<uintptr_t>(start_), fbl::memory_order_relaxed);
+        full_mark_.store(0u, fbl::memory_order_relaxed);
+    }
+
+private:
+    // Region start and end pointers.
+    uint8_t* start_ = nullptr;
+    uint8_t* end_ = nullptr;
+
+    // Current allocation pointer.
+    // Starts at |start_| and grows from there.
+    // May exceed |end_| when the region is full.
+    fbl::atomic<uintptr_t> current_{0u};
+
+    // Pointer beyond the last successful allocation, or null if not full.
+    fbl::atomic<uintptr_t> full_mark_{0u};
+};
+
+// Asks the engine to deal with the rolling buffers which have filled up.
+// Implemented in engine.cpp.
+void RequestRollingBufferService();
+
+} // namespace trace
+
 // Maintains state for a single trace session.
 // This structure is accessed concurrently from many threads which hold trace
 // context references.
 // Implements the opaque type declared in <trace-engine/context.h>.
+//
+// See <trace-engine/buffer.h> for how the buffer is laid out in each of the
+// buffering modes.
 struct trace_context {
-    trace_context(void* buffer, size_t buffer_num_bytes, trace_handler_t* handler);
+    // Rolling mode buffers must be at least this large, which leaves room
+    // for a few chunks in each rolling buffer.
+    static constexpr size_t kMinRollingModeBufferSize = 64u * 1024u;
+
+    trace_context(void* buffer, size_t buffer_num_bytes,
+                  trace_buffering_mode_t buffering_mode,
+                  trace_handler_t* handler);
 
     ~trace_context();
 
@@ -24,38 +101,148 @@ struct trace_context {
 
     trace_handler_t* handler() const { return handler_; }
 
+    trace_buffering_mode_t buffering_mode() const { return buffering_mode_; }
+
+    bool is_rolling() const {
+        return buffering_mode_ != TRACE_BUFFERING_MODE_ONESHOT;
+    }
+
+    // Returns true if records were dropped for lack of space.
     bool is_buffer_full() const {
-        return buffer_full_mark_.load(fbl::memory_order_relaxed) != 0u;
+        if (!is_rolling())
+            return rolling_[0].is_full();
+        return num_records_dropped_.load(fbl::memory_order_relaxed) != 0u;
     }
 
+    // The number of bytes at the start of the buffer which must be read back.
+    // In rolling modes this is the whole buffer, which is described by its
+    // header.
     size_t bytes_allocated() const {
-        uintptr_t tail = buffer_full_mark_.load(fbl::memory_order_relaxed);
-        if (!tail)
-            tail = buffer_current_.load(fbl::memory_order_relaxed);
-        return reinterpret_cast<uint8_t*>(tail) - buffer_start_;
+        if (!is_rolling())
+            return rolling_[0].bytes_allocated();
+        return buffer_end_ - buffer_start_;
     }
 
+    // Allocates space for a record.
+    // Small records are carved out of a chunk of the buffer which belongs to
+    // the calling thread, so that threads do not contend for the allocation
+    // pointer on every record.
     uint64_t* AllocRecord(size_t num_bytes);
+
+    // Allocates space for a record which other records may refer to, such
+    // as a string or thread record.  In rolling modes these go into the
+    // durable buffer, which is never overwritten.
+    uint64_t* AllocDurableRecord(size_t num_bytes);
+
     bool AllocThreadIndex(trace_thread_index_t* out_index);
     bool AllocStringIndex(trace_string_index_t* out_index);
 
+    // Claims |num_bytes| of the buffer for the exclusive use of one thread.
+    // Returns nullptr if there is not enough room left in the buffer, without
+    // marking it full: smaller records may still fit.
+    uint8_t* ClaimChunk(size_t num_bytes);
+
+    // Incremented whenever threads must stop filling the chunks they hold.
+    uint32_t chunk_epoch() const {
+        return chunk_epoch_.load(fbl::memory_order_seq_cst);
+    }
+
+    // Makes every thread claim a new chunk for its next record.
+    //
+    // A record in a chunk may precede, in the buffer, records written later
+    // by other threads. This is called after writing a string or thread
+    // record whose index may be handed to other threads, so that the records
+    // which refer to it are always placed after it.
+    void InvalidateChunks() {
+        chunk_epoch_.fetch_add(1u, fbl::memory_order_seq_cst);
+    }
+
+    // The following are used by the engine in rolling modes, while holding
+    // the engine lock.
+
+    // The number of bytes of the durable buffer which hold records.
+    size_t durable_bytes_allocated() const {
+        return durable_.bytes_allocated();
+    }
+
+    // Returns true if a rolling buffer has filled up and the engine has not
+    // dealt with it yet.
+    bool HasFullRollingBuffer() const;
+
+    // Deals with the rolling buffers which have filled up.  In circular mode
+    // they are freed for reuse.  In streaming mode they are marked as being
+    // saved, and the wrapped count of each is stored in |out_wrapped_counts|.
+    // Returns the number of buffers to be saved.
+    //
+    // Must only be called once no thread which may have been writing into
+    // the full buffers still holds a reference to the context.
+    size_t RetireFullRollingBuffers(uint32_t out_wrapped_counts[2]);
+
+    // Frees the rolling buffer which was being written at |wrapped_count|,
+    // once the handler has saved it.
+    // Returns |ZX_ERR_BAD_STATE| if that buffer is not being saved.
+    zx_status_t MarkRollingBufferSaved(uint32_t wrapped_count);
+
+    // Brings the buffer header up to date.
+    // |durable_data_end| is the end of the durable records to report.
+    void UpdateBufferHeader(size_t durable_data_end);
+
 private:
+    // The states of a rolling buffer.
+    static constexpr uint32_t kRollingFree = 0u;
+    static constexpr uint32_t kRollingActive = 1u;
+    static constexpr uint32_t kRollingFull = 2u;
+    static constexpr uint32_t kRollingSaving = 3u;
+
+    // Allocates space for a record directly from the shared buffer.
+    uint64_t* AllocSharedRecord(size_t num_bytes);
+
+    // Called when the rolling buffer written at |wrapped_count| has no room
+    // left.  Returns true if writing has moved on to the other buffer.
+    bool SwitchRollingBuffer(uint32_t wrapped_count);
+
+    // Makes the free rolling buffer |index| the one being written, if
+    // writing is still at |wrapped_count|.
+    void PromoteRollingBuffer(uint32_t index, uint32_t wrapped_count);
+
+    // Makes the rolling buffer |index| free, resuming writing if it had
+    // stalled because both buffers were full.
+    void FreeRollingBuffer(uint32_t index);
+
+    // The wrapped count at which the full rolling buffer |index| was written.
+    uint32_t RollingBufferWrappedCount(uint32_t index) const;
+
+    void RecordDropped();
+
     // The generation counter associated with this context to distinguish
     // it from previously created contexts.
     uint32_t const generation_;
 
+    trace_buffering_mode_t const buffering_mode_;
+
     // Buffer start and end pointers.
     uint8_t* const buffer_start_;
     uint8_t* const buffer_end_;
 
-    // Current allocation pointer.
-    // Starts at |buffer_start| and grows from there.
-    // May exceed |buffer_end| when the buffer is full.
-    fbl::atomic<uintptr_t> buffer_current_;
+    // The header at the start of the buffer in rolling modes, else null.
+    trace_buffer_header_t* const header_;
 
-    // Pointer beyond the last successful allocation, or null if not full.
-    // Only ever set to non-null once in the lifetime of the trace context.
-    fbl::atomic<uintptr_t> buffer_full_mark_;
+    // The durable buffer, only used in rolling modes.
+    trace::BufferRegion durable_;
+
+    // The rolling buffers.  In oneshot mode only the first is used, and
+    // spans the whole buffer.
+    trace::BufferRegion rolling_[2];
+
+    // The state of each rolling buffer.
+    fbl::atomic<uint32_t> rolling_state_[2];
+
+    // The number of times writing has moved from one rolling buffer to the
+    // other.  The buffer being written is |wrapped_count_ & 1|.
+    fbl::atomic<uint32_t> wrapped_count_{0u};
+
+    // The number of records dropped for lack of space, in rolling modes.
+    fbl::atomic<uint64_t> num_records_dropped_{0u};
 
     // Handler associated with the trace session.
     trace_handler_t* const handler_;
@@ -67,4 +254,9 @@ private:
     // The next string table index to be assigned.
     fbl::atomic<trace_string_index_t> next_string_index_{
         TRACE_ENCODED_STRING_REF_MIN_INDEX};
+
+    // The current chunk epoch, see |InvalidateChunks()|.
+    // Starts at 1 so that threads which have not claimed a chunk yet (and
+    // have an epoch of 0) claim one.
+    fbl::atomic<uint32_t> chunk_epoch_{1u};
 };
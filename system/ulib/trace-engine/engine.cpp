@@ -70,6 +70,9 @@ fbl::Vector<Observer> g_observers;
 // Rules:
 //   - acquiring a reference acts as an ACQUIRE fence
 //   - releasing a reference acts as a RELEASE fence
+//   - both are sequentially consistent, so that once the engine sees the
+//     count drop to 1 no thread can still be writing into a rolling buffer
+//     which filled up before then
 //   - always 0 when engine stopped
 //   - transition from 0 to 1 only happens when engine is started
 //   - the engine stops when the reference count goes to 0
@@ -82,17 +85,27 @@ fbl::atomic_uint32_t g_context_refs{0u};
 //   - can be accessed outside the lock while holding a context reference
 trace_context_t* g_context{nullptr};
 
-// Event for tracking two things:
+// Event for tracking three things:
 // - when all observers has started
 //   (SIGNAL_ALL_OBSERVERS_STARTED)
 // - when the trace context reference count has dropped to zero
 //   (SIGNAL_CONTEXT_RELEASED)
+// - when a rolling buffer has filled up, and when the reference count drops
+//   to 1 while the engine is waiting to deal with it
+//   (SIGNAL_BUFFER_FULL)
 // Rules:
 //   - can only be modified while holding g_engine_mutex and engine is stopped
 //   - can be read outside the lock while the engine is not stopped
 zx::event g_event;
 constexpr zx_signals_t SIGNAL_ALL_OBSERVERS_STARTED = ZX_USER_SIGNAL_0;
 constexpr zx_signals_t SIGNAL_CONTEXT_RELEASED = ZX_USER_SIGNAL_1;
+constexpr zx_signals_t SIGNAL_BUFFER_FULL = ZX_USER_SIGNAL_2;
+
+// Set while a rolling buffer has filled up and the engine is waiting for the
+// threads which may still be writing into it to release their references.
+// Rules:
+//   - can be read and modified atomically at any time
+fbl::atomic<bool> g_buffer_service_pending{false};
 
 // Asynchronous operations posted to the asynchronous dispatcher while the
 // engine is running.  Use of these structures is guarded by the engine lock.
@@ -132,10 +145,32 @@ zx_status_t trace_start_engine(async_t* async,
                                trace_handler_t* handler,
                                void* buffer,
                                size_t buffer_num_bytes) {
+    return trace_start_engine_with_buffering_mode(
+        async, handler, TRACE_BUFFERING_MODE_ONESHOT, buffer, buffer_num_bytes);
+}
+
+// thread-safe
+zx_status_t trace_start_engine_with_buffering_mode(async_t* async,
+                                                   trace_handler_t* handler,
+                                                   trace_buffering_mode_t buffering_mode,
+                                                   void* buffer,
+                                                   size_t buffer_num_bytes) {
     ZX_DEBUG_ASSERT(async);
     ZX_DEBUG_ASSERT(handler);
     ZX_DEBUG_ASSERT(buffer);
 
+    switch (buffering_mode) {
+    case TRACE_BUFFERING_MODE_ONESHOT:
+        break;
+    case TRACE_BUFFERING_MODE_CIRCULAR:
+    case TRACE_BUFFERING_MODE_STREAMING:
+        if (buffer_num_bytes < trace_context::kMinRollingModeBufferSize)
+            return ZX_ERR_INVALID_ARGS;
+        break;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+
     fbl::AutoLock lock(&g_engine_mutex);
 
     // We must have fully stopped a prior tracing session before starting a new one.
@@ -154,7 +189,8 @@ zx_status_t trace_start_engine(async_t* async,
         .handler = &handle_event,
         .object = event.get(),
         .trigger = (SIGNAL_ALL_OBSERVERS_STARTED |
-                    SIGNAL_CONTEXT_RELEASED),
+                    SIGNAL_CONTEXT_RELEASED |
+                    SIGNAL_BUFFER_FULL),
         .flags = ASYNC_FLAG_HANDLE_SHUTDOWN,
         .reserved = 0};
     status = async_begin_wait(async, &g_event_wait);
@@ -166,8 +202,9 @@ zx_status_t trace_start_engine(async_t* async,
     g_async = async;
     g_handler = handler;
     g_disposition = ZX_OK;
-    g_context = new trace_context(buffer, buffer_num_bytes, handler);
+    g_context = new trace_context(buffer, buffer_num_bytes, buffering_mode, handler);
     g_event = fbl::move(event);
+    g_buffer_service_pending.store(false, fbl::memory_order_relaxed);
 
     // Write the trace initialization record first before allowing clients to
     // get in and write their own trace records.
@@ -288,6 +325,11 @@ void handle_context_released(async_t* async) {
         handler = g_handler;
         buffer_bytes_written = g_context->bytes_allocated();
 
+        // Nothing can be written any more, so the header can describe
+        // everything.
+        if (g_context->is_rolling())
+            g_context->UpdateBufferHeader(g_context->durable_bytes_allocated());
+
         // Tidy up.
         g_async = nullptr;
         g_handler = nullptr;
@@ -307,11 +349,66 @@ void handle_context_released(async_t* async) {
     // to shutdown.
 }
 
+void handle_buffer_full() {
+    // Clear the signal, otherwise we'll keep getting called.
+    g_event.signal(SIGNAL_BUFFER_FULL, 0u);
+
+    trace_handler_t* handler;
+    uint32_t wrapped_counts[2];
+    size_t count;
+    size_t durable_data_end;
+    {
+        fbl::AutoLock lock(&g_engine_mutex);
+
+        // The final state of the buffer is reported when tracing stops.
+        if (g_state.load(fbl::memory_order_relaxed) != TRACE_STARTED)
+            return;
+
+        // Threads which fill up a buffer set the pending flag before
+        // signaling us, so either we see their buffer here or we get
+        // signaled again.
+        g_buffer_service_pending.store(false, fbl::memory_order_seq_cst);
+        if (!g_context->HasFullRollingBuffer())
+            return;
+        g_buffer_service_pending.store(true, fbl::memory_order_seq_cst);
+
+        // Threads may still be writing into the full buffers, and the
+        // records in them may refer to durable records which are still
+        // being written.  Wait for a moment when the engine holds the only
+        // reference: |trace_release_context()| signals us when that happens.
+        //
+        // The durable records allocated before that moment are complete.
+        // Those allocated since we looked are not, and may even be referred
+        // to by the full buffers, so look again.
+        do {
+            durable_data_end = g_context->durable_bytes_allocated();
+            if (g_context_refs.load(fbl::memory_order_seq_cst) != 1u)
+                return;
+        } while (g_context->durable_bytes_allocated() != durable_data_end);
+
+        g_buffer_service_pending.store(false, fbl::memory_order_seq_cst);
+        count = g_context->RetireFullRollingBuffers(wrapped_counts);
+        g_context->UpdateBufferHeader(durable_data_end);
+        handler = g_handler;
+
+        // Another buffer may have filled up in the meantime.
+        if (g_context->HasFullRollingBuffer())
+            g_event.signal(0u, SIGNAL_BUFFER_FULL);
+    }
+
+    // Call the handler outside of the lock since it may well mark the
+    // buffer saved right away.
+    for (size_t i = 0; i < count; i++) {
+        handler->ops->notify_buffer_full(handler, wrapped_counts[i],
+                                         durable_data_end);
+    }
+}
+
 async_wait_result_t handle_event(async_t* async, async_wait_t* wait,
                                  zx_status_t status,
                                  const zx_packet_signal_t* signal) {
-    // Note: This function may get both SIGNAL_ALL_OBSERVERS_STARTED
-    // and SIGNAL_CONTEXT_RELEASED at the same time.
+    // Note: This function may get any of SIGNAL_ALL_OBSERVERS_STARTED,
+    // SIGNAL_BUFFER_FULL and SIGNAL_CONTEXT_RELEASED at the same time.
 
     // Assume we want to wait for the next event.
     async_wait_result_t result = ASYNC_WAIT_AGAIN;
@@ -332,6 +429,11 @@ async_wait_result_t handle_event(async_t* async, async_wait_t* wait,
         handle_all_observers_started();
     }
 
+    if (status == ZX_OK &&
+        (signal->observed & SIGNAL_BUFFER_FULL)) {
+        handle_buffer_full();
+    }
+
     // Also cleanup if async dispatcher is being shut down.
     if (status != ZX_OK ||
         (signal->observed & SIGNAL_CONTEXT_RELEASED)) {
@@ -375,9 +477,10 @@ trace_context_t* trace_acquire_context() {
     // This also acts as a fence for future access to buffer state variables.
     //
     // Note the ACQUIRE fence here since the trace context may have changed
-    // from the perspective of this thread.
+    // from the perspective of this thread.  The ordering is sequentially
+    // consistent for the sake of |handle_buffer_full()|.
     while (!g_context_refs.compare_exchange_weak(&count, count + 1,
-                                                 fbl::memory_order_acquire,
+                                                 fbl::memory_order_seq_cst,
                                                  fbl::memory_order_relaxed)) {
         if (unlikely(count == 0u))
             return nullptr;
@@ -408,13 +511,42 @@ void trace_release_context(trace_context_t* context) {
 
     // Note the RELEASE fence here since the trace context and trace buffer
     // contents may have changes from the perspective of other threads.
-    if (unlikely(g_context_refs.fetch_sub(1u, fbl::memory_order_release) == 1u)) {
-        // Notify the engine that the last reference was released.
-        zx_status_t status = g_event.signal(0u, SIGNAL_CONTEXT_RELEASED);
-        ZX_DEBUG_ASSERT(status == ZX_OK);
+    uint32_t count = g_context_refs.fetch_sub(1u, fbl::memory_order_seq_cst);
+    if (unlikely(count <= 2u)) {
+        if (count == 1u) {
+            // Notify the engine that the last reference was released.
+            zx_status_t status = g_event.signal(0u, SIGNAL_CONTEXT_RELEASED);
+            ZX_DEBUG_ASSERT(status == ZX_OK);
+        } else if (g_buffer_service_pending.load(fbl::memory_order_seq_cst)) {
+            // Only the engine's reference remains: it can deal with the
+            // rolling buffers which filled up.
+            zx_status_t status = g_event.signal(0u, SIGNAL_BUFFER_FULL);
+            ZX_DEBUG_ASSERT(status == ZX_OK);
+        }
     }
 }
 
+// thread-safe
+zx_status_t trace_engine_mark_buffer_saved(uint32_t wrapped_count) {
+    fbl::AutoLock lock(&g_engine_mutex);
+
+    if (g_state.load(fbl::memory_order_relaxed) == TRACE_STOPPED)
+        return ZX_ERR_BAD_STATE;
+    return g_context->MarkRollingBufferSaved(wrapped_count);
+}
+
+namespace trace {
+
+// thread-safe, lock-free
+void RequestRollingBufferService() {
+    // The caller holds a reference to the context, so |g_event| is valid.
+    g_buffer_service_pending.store(true, fbl::memory_order_seq_cst);
+    zx_status_t status = g_event.signal(0u, SIGNAL_BUFFER_FULL);
+    ZX_DEBUG_ASSERT(status == ZX_OK);
+}
+
+} // namespace trace
+
 zx_status_t trace_register_observer(zx_handle_t event) {
     fbl::AutoLock lock(&g_engine_mutex);
 
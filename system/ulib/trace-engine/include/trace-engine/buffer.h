@@ -0,0 +1,91 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Buffering modes and the layout of the trace buffer.
+//
+// In oneshot mode the trace buffer holds nothing but trace records, written
+// from the start of the buffer until it fills up.
+//
+// In the circular and streaming modes the buffer is divided up as follows:
+//
+//   +--------+---------+------------------+------------------+
+//   | header | durable | rolling buffer 0 | rolling buffer 1 |
+//   +--------+---------+------------------+------------------+
+//
+// The header is a |trace_buffer_header_t|.  The durable buffer holds the
+// records which other records refer to (the initialization record, string
+// records and thread records) and is never overwritten.  All other records
+// go into the two rolling buffers, which take turns: when the one being
+// written fills up, writing moves on to the other one.
+//
+// To read the trace, read the durable buffer first, then the rolling
+// buffers from the oldest to the newest.  Each part holds a sequence of
+// records which ends at the offset given by the header.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// How the trace engine fills the trace buffer.
+typedef enum {
+    // Records are written until the buffer is full, then dropped.
+    TRACE_BUFFERING_MODE_ONESHOT = 0,
+    // When a rolling buffer fills up the older one is overwritten, so the
+    // buffer retains the most recent records.
+    TRACE_BUFFERING_MODE_CIRCULAR = 1,
+    // When a rolling buffer fills up it is handed to the trace handler to be
+    // saved, and is reused once the handler reports it has been saved.
+    // Records are dropped if both rolling buffers are waiting to be saved.
+    TRACE_BUFFERING_MODE_STREAMING = 2,
+} trace_buffering_mode_t;
+
+// The value of |trace_buffer_header_t.magic|: "FxTrBufH".
+#define TRACE_BUFFER_HEADER_MAGIC ((uint64_t)0x4846754272547846ull)
+
+// The value of |trace_buffer_header_t.version|.
+#define TRACE_BUFFER_HEADER_VERSION ((uint16_t)0u)
+
+// Written at the start of the trace buffer in the circular and streaming
+// modes.  Offsets are relative to the start of the part of the buffer they
+// describe.
+//
+// The engine updates the header when it hands a rolling buffer to the trace
+// handler and when tracing stops.
+typedef struct trace_buffer_header {
+    uint64_t magic;
+    uint16_t version;
+    // A |trace_buffering_mode_t|.
+    uint8_t buffering_mode;
+    uint8_t reserved1;
+    // The number of times writing has moved from one rolling buffer to the
+    // other.  The rolling buffer being written is |wrapped_count & 1|.
+    uint32_t wrapped_count;
+
+    // The size of the whole trace buffer, including this header.
+    uint64_t total_size;
+    // The size of the durable buffer, which follows this header.
+    uint64_t durable_buffer_size;
+    // The size of each of the two rolling buffers, which follow the durable
+    // buffer.
+    uint64_t rolling_buffer_size;
+
+    // The end of the records in the durable buffer.
+    uint64_t durable_data_end;
+    // The end of the records in each of the rolling buffers.
+    uint64_t rolling_data_end[2];
+
+    // The number of records which were dropped because there was no room
+    // for them.
+    uint64_t num_records_dropped;
+
+    uint64_t reserved[7];
+} trace_buffer_header_t;
+
+__END_CDECLS
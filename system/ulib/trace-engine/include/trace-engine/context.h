@@ -88,6 +88,10 @@ inline trace_string_ref_t trace_context_make_registered_string_copy(
 // Writes a string record into the trace buffer if the string was added to the
 // string table.  If the string table is full, returns an inline string reference.
 //
+// The cache belongs to the calling thread, and so does the returned reference:
+// it must only be used in records written by the calling thread.  Use
+// |trace_context_register_string_copy()| for references shared between threads.
+//
 // |context| must be a valid trace context reference.
 // |string_literal| must be a null-terminated static string constant.
 // |out_ref| points to where the registered string reference should be returned.
@@ -118,6 +122,9 @@ inline trace_string_ref_t trace_context_make_registered_string_literal(
 // Writes a string record into the trace buffer if the category was added to the
 // string table.  If the string table is full, returns an inline string reference.
 //
+// As with |trace_context_register_string_literal()|, the returned reference
+// must only be used in records written by the calling thread.
+//
 // |context| must be a valid trace context reference.
 // |category_literal| must be a null-terminated static string constant.
 // |out_ref| points to where the registered string reference should be returned.
@@ -139,6 +146,9 @@ bool trace_context_register_category_literal(
 //
 // If the thread table is full, returns an inline thread refrence.
 //
+// The returned reference must only be used in records written by the calling
+// thread.
+//
 // |context| must be a valid trace context reference.
 // |out_ref| points to where the registered thread reference should be returned.
 //
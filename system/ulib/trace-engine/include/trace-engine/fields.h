@@ -140,6 +140,14 @@ struct LogRecordFields : RecordFields {
     using ThreadRef = Field<32, 39>;
 };
 
+struct BufferChunkRecordFields : RecordFields {
+    using ChunkType = Field<16, 19>;
+};
+
+struct BeginBufferChunkRecordFields : BufferChunkRecordFields {
+    using ChunkSize = Field<20, 35>;
+};
+
 } // namespace trace
 
 #endif // __cplusplus
@@ -23,6 +23,7 @@
 #include <zircon/types.h>
 
 #include <async/dispatcher.h>
+#include <trace-engine/buffer.h>
 #include <trace-engine/instrumentation.h>
 
 __BEGIN_CDECLS
@@ -63,6 +64,8 @@ struct trace_handler_ops {
     // |disposition| is |ZX_OK| if tracing stopped normally, otherwise indicates
     // that tracing was aborted due to an error.
     // |buffer_bytes_written| is number of bytes which were written to the trace buffer.
+    // In the circular and streaming buffering modes this is the size of the
+    // whole buffer, whose header describes what it holds.
     //
     // Called on an asynchronous dispatch thread.
     void (*trace_stopped)(trace_handler_t* handler, async_t* async,
@@ -73,6 +76,23 @@ struct trace_handler_ops {
     //
     // Called by instrumentation on any thread.  Must be thread-safe.
     void (*buffer_overflow)(trace_handler_t* handler);
+
+    // Called by the trace engine in streaming mode when a rolling buffer has
+    // filled up and is ready to be saved.  Writing continues in the other
+    // rolling buffer.  Once the buffer has been saved the handler must call
+    // |trace_engine_mark_buffer_saved()| so that it can be reused.
+    //
+    // |handler| is the trace handler object itself.
+    // |wrapped_count| identifies the buffer: it is the one at index
+    // |wrapped_count & 1|.
+    // |durable_data_end| is the end of the records in the durable buffer,
+    // which the records in the rolling buffer may refer to.
+    //
+    // The buffer header is up to date when this is called.
+    //
+    // Called on an asynchronous dispatch thread.
+    void (*notify_buffer_full)(trace_handler_t* handler, uint32_t wrapped_count,
+                               uint64_t durable_data_end);
 };
 
 // Asynchronously starts the trace engine.
@@ -109,6 +129,21 @@ zx_status_t trace_start_engine(async_t* async,
                                void* buffer,
                                size_t buffer_num_bytes);
 
+// Asynchronously starts the trace engine in the given buffering mode.
+//
+// |buffering_mode| specifies how the trace buffer is filled, see
+// <trace-engine/buffer.h>.  |trace_start_engine()| uses
+// |TRACE_BUFFERING_MODE_ONESHOT|.
+//
+// Returns |ZX_ERR_INVALID_ARGS| if the mode is not recognized, or if the
+// buffer is too small to be divided up as that mode requires.
+// Otherwise behaves like |trace_start_engine()|.
+zx_status_t trace_start_engine_with_buffering_mode(async_t* async,
+                                                   trace_handler_t* handler,
+                                                   trace_buffering_mode_t buffering_mode,
+                                                   void* buffer,
+                                                   size_t buffer_num_bytes);
+
 // Asynchronously stops the trace engine.
 //
 // The trace handler's |trace_stopped()| method will be invoked asynchronously
@@ -123,4 +158,15 @@ zx_status_t trace_start_engine(async_t* async,
 // This function is thread-safe.
 zx_status_t trace_stop_engine(zx_status_t disposition);
 
+// Reports that the rolling buffer which the trace handler was handed by
+// |trace_handler_ops.notify_buffer_full()| has been saved and may be reused.
+// Buffers must be marked saved in the order they were handed out.
+//
+// Returns |ZX_OK| on success.
+// Returns |ZX_ERR_BAD_STATE| if tracing is stopped, or if the buffer was not
+// waiting to be saved.
+//
+// This function is thread-safe.
+zx_status_t trace_engine_mark_buffer_saved(uint32_t wrapped_count);
+
 __END_CDECLS
@@ -332,6 +332,7 @@ enum class RecordType {
     kKernelObject = 7,
     kContextSwitch = 8,
     kLog = 9,
+    kBufferChunk = 10,
 };
 
 // MetadataType enumerates all known trace metadata types.
@@ -341,6 +342,12 @@ enum class MetadataType {
     kProviderEvent = 3,
 };
 
+// Enumerates all buffer chunk record types.
+enum class BufferChunkType {
+    kBegin = 0,
+    kPadding = 1,
+};
+
 // Enumerates all provider events.
 enum class ProviderEventType {
     kBufferOverflow = 0,
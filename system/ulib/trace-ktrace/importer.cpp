@@ -0,0 +1,363 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <trace-ktrace/importer.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <zircon/ktrace.h>
+#include <zircon/syscalls/object.h>
+
+namespace trace {
+namespace {
+
+// Probe records have this bit set in their event number.
+constexpr uint32_t kProbeEventFlag = 0x800u;
+
+// The kernel's thread states, as reported by context switch records.
+// See <kernel/thread.h>.
+enum KernelThreadState : uint32_t {
+    kInitial = 0,
+    kReady,
+    kRunning,
+    kBlocked,
+    kSleeping,
+    kSuspended,
+    kDeath,
+};
+
+trace_thread_state_t ToThreadState(uint32_t kernel_state) {
+    switch (kernel_state) {
+    case kInitial:
+        return ZX_THREAD_STATE_NEW;
+    case kReady:
+    case kRunning:
+        // The thread was preempted.
+        return ZX_THREAD_STATE_RUNNING;
+    case kSuspended:
+        return ZX_THREAD_STATE_SUSPENDED;
+    case kDeath:
+        return ZX_THREAD_STATE_DEAD;
+    case kBlocked:
+    case kSleeping:
+    default:
+        return ZX_THREAD_STATE_BLOCKED;
+    }
+}
+
+bool IsKernelKoid(zx_koid_t koid) {
+    return koid >= kKernelThreadKoidBase;
+}
+
+} // namespace
+
+KtraceImporter::KtraceImporter(trace_context_t* context)
+    : context_(context) {
+    sched_.enabled = trace_context_register_category_literal(
+        context_, KTRACE_CATEGORY_SCHED, &sched_.ref);
+    syscall_.enabled = trace_context_register_category_literal(
+        context_, KTRACE_CATEGORY_SYSCALL, &syscall_.ref);
+    irq_.enabled = trace_context_register_category_literal(
+        context_, KTRACE_CATEGORY_IRQ, &irq_.ref);
+    vm_.enabled = trace_context_register_category_literal(
+        context_, KTRACE_CATEGORY_VM, &vm_.ref);
+    probe_.enabled = trace_context_register_category_literal(
+        context_, KTRACE_CATEGORY_PROBE, &probe_.ref);
+
+    trace_string_ref_t name_ref = trace_make_inline_c_string_ref("kernel");
+    trace_context_write_process_info_record(context_, ZX_KOID_KERNEL, &name_ref);
+}
+
+KtraceImporter::~KtraceImporter() = default;
+
+uint32_t KtraceImporter::GetGroupMask(trace_context_t* context) {
+    uint32_t groups = 0u;
+    if (trace_context_is_category_enabled(context, KTRACE_CATEGORY_SCHED))
+        groups |= KTRACE_GRP_SCHEDULER;
+    // Syscalls and page faults are in the same group as interrupts.
+    if (trace_context_is_category_enabled(context, KTRACE_CATEGORY_SYSCALL) ||
+        trace_context_is_category_enabled(context, KTRACE_CATEGORY_IRQ) ||
+        trace_context_is_category_enabled(context, KTRACE_CATEGORY_VM))
+        groups |= KTRACE_GRP_IRQ;
+    if (trace_context_is_category_enabled(context, KTRACE_CATEGORY_PROBE))
+        groups |= KTRACE_GRP_PROBE;
+
+    // The names of things, and which process each thread belongs to.
+    if (groups)
+        groups |= KTRACE_GRP_META | KTRACE_GRP_TASKS;
+    return groups;
+}
+
+size_t KtraceImporter::Import(const void* data, size_t num_bytes) {
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    size_t offset = 0u;
+    while (num_bytes - offset >= sizeof(uint32_t)) {
+        uint32_t tag;
+        memcpy(&tag, ptr + offset, sizeof(tag));
+        const size_t size = KTRACE_LEN(tag);
+        if (size == 0u) {
+            // Nothing has been written past here.
+            return num_bytes;
+        }
+        if (num_bytes - offset < size)
+            break;
+        if (size >= KTRACE_HDRSIZE)
+            ImportRecord(ptr + offset, size);
+        offset += size;
+    }
+    return offset;
+}
+
+void KtraceImporter::ImportRecord(const void* record, size_t size) {
+    auto header = static_cast<const ktrace_header_t*>(record);
+    const uint32_t event = KTRACE_EVENT(header->tag);
+
+    if ((KTRACE_GROUP(header->tag) & KTRACE_GRP_PROBE) && (event & kProbeEventFlag)) {
+        ImportProbe(record, size);
+        return;
+    }
+
+    // Records with more than the header.
+    auto rec = static_cast<const ktrace_rec_32b_t*>(record);
+    const bool has_args = size >= sizeof(ktrace_rec_32b_t);
+
+    char buf[ZX_MAX_NAME_LEN];
+    switch (event) {
+    case KTRACE_EVENT(TAG_KTHREAD_NAME):
+    case KTRACE_EVENT(TAG_THREAD_NAME):
+    case KTRACE_EVENT(TAG_PROC_NAME):
+    case KTRACE_EVENT(TAG_SYSCALL_NAME):
+    case KTRACE_EVENT(TAG_IRQ_NAME):
+    case KTRACE_EVENT(TAG_PROBE_NAME):
+        ImportName(event, record, size);
+        break;
+    case KTRACE_EVENT(TAG_IRQ_ENTER):
+    case KTRACE_EVENT(TAG_IRQ_EXIT): {
+        if (!irq_.enabled)
+            break;
+        // The tid field holds (irq << 8) | cpu.
+        const uint32_t cpu = header->tid & 0xff;
+        trace_thread_ref_t thread_ref = GetThreadRef(kCpuThreadKoidBase | cpu);
+        trace_string_ref_t name_ref = GetName(KTRACE_EVENT(TAG_IRQ_NAME), header->tid >> 8,
+                                              "irq", buf, sizeof(buf));
+        WriteDuration(event == KTRACE_EVENT(TAG_IRQ_ENTER), header->ts, thread_ref,
+                      irq_, name_ref, nullptr, 0u);
+        break;
+    }
+    case KTRACE_EVENT(TAG_SYSCALL_ENTER):
+    case KTRACE_EVENT(TAG_SYSCALL_EXIT): {
+        if (!syscall_.enabled)
+            break;
+        // The tid field holds (syscall << 8) | cpu.
+        const uint32_t cpu = header->tid & 0xff;
+        trace_thread_ref_t thread_ref = GetThreadRef(GetCurrentThread(cpu));
+        trace_string_ref_t name_ref = GetName(KTRACE_EVENT(TAG_SYSCALL_NAME), header->tid >> 8,
+                                              "syscall", buf, sizeof(buf));
+        WriteDuration(event == KTRACE_EVENT(TAG_SYSCALL_ENTER), header->ts, thread_ref,
+                      syscall_, name_ref, nullptr, 0u);
+        break;
+    }
+    case KTRACE_EVENT(TAG_PAGE_FAULT):
+    case KTRACE_EVENT(TAG_PAGE_FAULT_EXIT): {
+        if (!vm_.enabled || !has_args)
+            break;
+        trace_thread_ref_t thread_ref = GetThreadRef(GetCurrentThread(rec->d));
+        trace_string_ref_t name_ref = trace_make_inline_c_string_ref("page_fault");
+        const uint64_t vaddr = (static_cast<uint64_t>(rec->a) << 32) | rec->b;
+        trace_arg_t args[] = {
+            trace_make_arg(trace_make_inline_c_string_ref("vaddr"),
+                           trace_make_pointer_arg_value(static_cast<uintptr_t>(vaddr))),
+            trace_make_arg(trace_make_inline_c_string_ref("flags"),
+                           trace_make_uint32_arg_value(rec->c)),
+        };
+        WriteDuration(event == KTRACE_EVENT(TAG_PAGE_FAULT), rec->ts, thread_ref,
+                      vm_, name_ref, args, fbl::count_of(args));
+        break;
+    }
+    case KTRACE_EVENT(TAG_CONTEXT_SWITCH): {
+        if (!has_args)
+            break;
+        // Threads without a tid are kernel threads, which are identified
+        // by their kernel thread ids instead.
+        const zx_koid_t outgoing_koid = rec->tid ? rec->tid : kKernelThreadKoidBase | rec->c;
+        const zx_koid_t incoming_koid = rec->a ? rec->a : kKernelThreadKoidBase | rec->d;
+        const uint32_t cpu = rec->b & 0xffff;
+        if (cpu < kMaxCpus)
+            cpu_threads_[cpu] = incoming_koid;
+        if (!sched_.enabled)
+            break;
+        trace_thread_ref_t outgoing_ref = GetThreadRef(outgoing_koid);
+        trace_thread_ref_t incoming_ref = GetThreadRef(incoming_koid);
+        trace_context_write_context_switch_record(context_, rec->ts, cpu,
+                                                  ToThreadState(rec->b >> 16),
+                                                  &outgoing_ref, &incoming_ref);
+        break;
+    }
+    case KTRACE_EVENT(TAG_THREAD_CREATE):
+    case KTRACE_EVENT(TAG_PROC_START):
+        // tid, pid
+        if (has_args)
+            SetThreadProcess(rec->a, rec->b);
+        break;
+    default:
+        break;
+    }
+}
+
+void KtraceImporter::ImportName(uint32_t event, const void* record, size_t size) {
+    auto rec = static_cast<const ktrace_rec_name_t*>(record);
+    const size_t length = strnlen(rec->name, size - offsetof(ktrace_rec_name_t, name));
+
+    switch (event) {
+    case KTRACE_EVENT(TAG_KTHREAD_NAME): {
+        trace_string_ref_t name_ref = trace_make_inline_string_ref(rec->name, length);
+        trace_context_write_thread_info_record(context_, ZX_KOID_KERNEL,
+                                               kKernelThreadKoidBase | rec->id, &name_ref);
+        break;
+    }
+    case KTRACE_EVENT(TAG_THREAD_NAME): {
+        SetThreadProcess(rec->id, rec->arg);
+        trace_string_ref_t name_ref = trace_make_inline_string_ref(rec->name, length);
+        trace_context_write_thread_info_record(context_, rec->arg, rec->id, &name_ref);
+        break;
+    }
+    case KTRACE_EVENT(TAG_PROC_NAME): {
+        trace_string_ref_t name_ref = trace_make_inline_string_ref(rec->name, length);
+        trace_context_write_process_info_record(context_, rec->id, &name_ref);
+        break;
+    }
+    default: {
+        // Names which events refer to by number.  If the string table is
+        // full the ref would point into |record|, which doesn't last, so
+        // the events go without the name instead.
+        trace_string_ref_t name_ref;
+        trace_context_register_string_copy(context_, rec->name, length, &name_ref);
+        if (!trace_is_indexed_string_ref(&name_ref))
+            break;
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<NameEntry> entry(
+            new (&ac) NameEntry((static_cast<uint64_t>(event) << 32) | rec->id, name_ref));
+        if (ac.check())
+            names_.insert_or_replace(fbl::move(entry));
+        break;
+    }
+    }
+}
+
+void KtraceImporter::ImportProbe(const void* record, size_t size) {
+    if (!probe_.enabled)
+        return;
+
+    auto header = static_cast<const ktrace_header_t*>(record);
+    const uint32_t number = KTRACE_EVENT(header->tag) & ~kProbeEventFlag;
+
+    // Probes hit by kernel threads don't say which one.
+    trace_thread_ref_t thread_ref = GetThreadRef(
+        header->tid ? header->tid : kKernelThreadKoidBase);
+    char buf[ZX_MAX_NAME_LEN];
+    trace_string_ref_t name_ref = GetName(KTRACE_EVENT(TAG_PROBE_NAME), number,
+                                          "probe", buf, sizeof(buf));
+
+    trace_arg_t args[2];
+    size_t num_args = 0u;
+    if (size >= sizeof(ktrace_header_t) + 2 * sizeof(uint32_t)) {
+        uint32_t values[2];
+        memcpy(values, header + 1, sizeof(values));
+        args[0] = trace_make_arg(trace_make_inline_c_string_ref("arg0"),
+                                 trace_make_uint32_arg_value(values[0]));
+        args[1] = trace_make_arg(trace_make_inline_c_string_ref("arg1"),
+                                 trace_make_uint32_arg_value(values[1]));
+        num_args = 2u;
+    }
+    trace_context_write_instant_event_record(context_, header->ts, &thread_ref,
+                                             &probe_.ref, &name_ref, TRACE_SCOPE_THREAD,
+                                             args, num_args);
+}
+
+KtraceImporter::ThreadEntry* KtraceImporter::GetThread(zx_koid_t koid) {
+    auto it = threads_.find(koid);
+    if (it != threads_.end())
+        return &*it;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<ThreadEntry> entry(new (&ac) ThreadEntry(koid));
+    if (!ac.check())
+        return nullptr;
+    if (IsKernelKoid(koid))
+        entry->process_koid = ZX_KOID_KERNEL;
+    ThreadEntry* thread = entry.get();
+    threads_.insert(fbl::move(entry));
+    return thread;
+}
+
+void KtraceImporter::SetThreadProcess(zx_koid_t koid, zx_koid_t process_koid) {
+    ThreadEntry* thread = GetThread(koid);
+    if (thread && thread->process_koid != process_koid) {
+        // Register it again, under its process.
+        thread->process_koid = process_koid;
+        thread->registered = false;
+    }
+}
+
+trace_thread_ref_t KtraceImporter::GetThreadRef(zx_koid_t koid) {
+    ThreadEntry* thread = GetThread(koid);
+    if (!thread) {
+        return trace_make_inline_thread_ref(
+            IsKernelKoid(koid) ? ZX_KOID_KERNEL : ZX_KOID_INVALID, koid);
+    }
+
+    if (!thread->registered) {
+        trace_context_register_thread(context_, thread->process_koid, koid, &thread->ref);
+        thread->registered = true;
+
+        if (koid >= kCpuThreadKoidBase) {
+            char name[ZX_MAX_NAME_LEN];
+            snprintf(name, sizeof(name), "cpu-%u", static_cast<uint32_t>(koid));
+            trace_string_ref_t name_ref = trace_make_inline_c_string_ref(name);
+            trace_context_write_thread_info_record(context_, ZX_KOID_KERNEL, koid, &name_ref);
+        }
+    }
+    return thread->ref;
+}
+
+zx_koid_t KtraceImporter::GetCurrentThread(uint32_t cpu) const {
+    // Until a context switch says otherwise, attribute the cpu's events to
+    // the cpu itself.
+    if (cpu < kMaxCpus && cpu_threads_[cpu] != ZX_KOID_INVALID)
+        return cpu_threads_[cpu];
+    return kCpuThreadKoidBase | cpu;
+}
+
+trace_string_ref_t KtraceImporter::GetName(uint32_t name_event, uint32_t number,
+                                           const char* default_name,
+                                           char* buf, size_t buf_size) const {
+    auto it = names_.find((static_cast<uint64_t>(name_event) << 32) | number);
+    if (it != names_.end())
+        return it->ref;
+
+    snprintf(buf, buf_size, "%s %u", default_name, number);
+    return trace_make_inline_c_string_ref(buf);
+}
+
+void KtraceImporter::WriteDuration(bool begin, uint64_t ts,
+                                   const trace_thread_ref_t& thread_ref,
+                                   const Category& category,
+                                   const trace_string_ref_t& name_ref,
+                                   const trace_arg_t* args, size_t num_args) {
+    if (begin) {
+        trace_context_write_duration_begin_event_record(context_, ts, &thread_ref,
+                                                        &category.ref, &name_ref,
+                                                        args, num_args);
+    } else {
+        trace_context_write_duration_end_event_record(context_, ts, &thread_ref,
+                                                      &category.ref, &name_ref,
+                                                      args, num_args);
+    }
+}
+
+} // namespace trace
@@ -0,0 +1,132 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+//
+// Translates kernel trace (ktrace) records into trace records.
+//
+// Both use the same timebase, and user threads keep their koids, so the
+// kernel's events line up with the events recorded by userspace.
+//
+// Kernel threads have no koid, so they are given one derived from their
+// kernel thread id: |kKernelThreadKoidBase| | id.  Interrupts are recorded
+// on a pseudo-thread per cpu: |kCpuThreadKoidBase| | cpu.  All of these
+// belong to the kernel's process, |ZX_KOID_KERNEL|.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fbl/intrusive_hash_table.h>
+#include <fbl/intrusive_single_list.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <trace-engine/context.h>
+
+// The categories of the events written by the importer.
+#define KTRACE_CATEGORY_SCHED "kernel:sched"
+#define KTRACE_CATEGORY_SYSCALL "kernel:syscall"
+#define KTRACE_CATEGORY_IRQ "kernel:irq"
+#define KTRACE_CATEGORY_VM "kernel:vm"
+#define KTRACE_CATEGORY_PROBE "kernel:probe"
+
+namespace trace {
+
+constexpr zx_koid_t kKernelThreadKoidBase = 1ull << 32;
+constexpr zx_koid_t kCpuThreadKoidBase = 2ull << 32;
+
+// Writes the events described by a stream of ktrace records into a trace
+// context.  Events whose category is not enabled are skipped.
+//
+// Not thread-safe: the importer must only be used from one thread, and the
+// caller must hold a reference to |context| for as long as the importer
+// exists.
+class KtraceImporter final {
+public:
+    explicit KtraceImporter(trace_context_t* context);
+    ~KtraceImporter();
+
+    // Returns the ktrace groups which must be enabled to collect the events
+    // for the currently enabled categories, or 0 if there are none.
+    static uint32_t GetGroupMask(trace_context_t* context);
+
+    // Translates the ktrace records in |data|.
+    //
+    // Returns the number of bytes consumed.  A record which runs past the
+    // end of |data| is left for the next call, which should pass it again.
+    size_t Import(const void* data, size_t num_bytes);
+
+private:
+    struct ThreadEntry : public fbl::SinglyLinkedListable<fbl::unique_ptr<ThreadEntry>> {
+        explicit ThreadEntry(zx_koid_t koid)
+            : koid(koid) {}
+
+        zx_koid_t const koid;
+        zx_koid_t process_koid = ZX_KOID_INVALID;
+        bool registered = false;
+        trace_thread_ref_t ref;
+
+        // Used by the hash table.
+        zx_koid_t GetKey() const { return koid; }
+        static size_t GetHash(zx_koid_t key) { return static_cast<size_t>(key); }
+    };
+
+    // Names of syscalls, interrupts and probes, keyed by
+    // (name record event << 32) | number.
+    struct NameEntry : public fbl::SinglyLinkedListable<fbl::unique_ptr<NameEntry>> {
+        NameEntry(uint64_t key, trace_string_ref_t ref)
+            : key(key), ref(ref) {}
+
+        uint64_t const key;
+        trace_string_ref_t const ref;
+
+        // Used by the hash table.
+        uint64_t GetKey() const { return key; }
+        static size_t GetHash(uint64_t key) { return static_cast<size_t>(key ^ (key >> 32)); }
+    };
+
+    struct Category {
+        bool enabled;
+        trace_string_ref_t ref;
+    };
+
+    static constexpr uint32_t kMaxCpus = 256u;
+
+    void ImportRecord(const void* record, size_t size);
+    void ImportName(uint32_t event, const void* record, size_t size);
+    void ImportProbe(const void* record, size_t size);
+
+    ThreadEntry* GetThread(zx_koid_t koid);
+    void SetThreadProcess(zx_koid_t koid, zx_koid_t process_koid);
+    trace_thread_ref_t GetThreadRef(zx_koid_t koid);
+    zx_koid_t GetCurrentThread(uint32_t cpu) const;
+
+    // Returns the name reported for |number| by the name records of type
+    // |name_event|, or else "|default_name| |number|", formatted into |buf|.
+    trace_string_ref_t GetName(uint32_t name_event, uint32_t number,
+                               const char* default_name, char* buf, size_t buf_size) const;
+
+    void WriteDuration(bool begin, uint64_t ts, const trace_thread_ref_t& thread_ref,
+                       const Category& category, const trace_string_ref_t& name_ref,
+                       const trace_arg_t* args, size_t num_args);
+
+    trace_context_t* const context_;
+
+    Category sched_;
+    Category syscall_;
+    Category irq_;
+    Category vm_;
+    Category probe_;
+
+    // The thread running on each cpu, as of the last context switch.
+    zx_koid_t cpu_threads_[kMaxCpus] = {};
+
+    fbl::HashTable<zx_koid_t, fbl::unique_ptr<ThreadEntry>> threads_;
+    fbl::HashTable<uint64_t, fbl::unique_ptr<NameEntry>> names_;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(KtraceImporter);
+};
+
+} // namespace trace
@@ -38,6 +38,7 @@ TraceHandlerImpl::~TraceHandlerImpl() {
 }
 
 zx_status_t TraceHandlerImpl::StartEngine(async_t* async,
+                                          trace_buffering_mode_t buffering_mode,
                                           zx::vmo buffer, zx::eventpair fence,
                                           fbl::Vector<fbl::String> enabled_categories) {
     ZX_DEBUG_ASSERT(buffer);
@@ -58,8 +59,9 @@ zx_status_t TraceHandlerImpl::StartEngine(async_t* async,
     auto handler = new TraceHandlerImpl(reinterpret_cast<void*>(buffer_ptr),
                                         buffer_num_bytes, fbl::move(fence),
                                         fbl::move(enabled_categories));
-    status = trace_start_engine(async, handler,
-                                handler->buffer_, handler->buffer_num_bytes_);
+    status = trace_start_engine_with_buffering_mode(async, handler, buffering_mode,
+                                                    handler->buffer_,
+                                                    handler->buffer_num_bytes_);
     if (status != ZX_OK) {
         delete handler;
         return status;
@@ -78,6 +80,15 @@ zx_status_t TraceHandlerImpl::StopEngine() {
     return status;
 }
 
+zx_status_t TraceHandlerImpl::MarkBufferSaved(uint32_t wrapped_count) {
+    auto status = trace_engine_mark_buffer_saved(wrapped_count);
+    if (status != ZX_OK) {
+        printf("Failed to mark buffer %u saved, status %s(%d)\n",
+               wrapped_count, zx_status_get_string(status), status);
+    }
+    return status;
+}
+
 bool TraceHandlerImpl::IsCategoryEnabled(const char* category) {
     if (enabled_categories_.size() == 0) {
       // If none are specified, enable all categories.
@@ -105,5 +116,12 @@ void TraceHandlerImpl::BufferOverflow() {
                     status == ZX_ERR_PEER_CLOSED);
 }
 
+void TraceHandlerImpl::NotifyBufferFull(uint32_t wrapped_count, uint64_t durable_data_end) {
+    // The buffer header says which buffer to save and how much of it.
+    auto status = fence_.signal_peer(0u, TRACE_PROVIDER_SIGNAL_BUFFER_FULL);
+    ZX_DEBUG_ASSERT(status == ZX_OK ||
+                    status == ZX_ERR_PEER_CLOSED);
+}
+
 } // namespace internal
 } // namespace trace
@@ -20,10 +20,12 @@ namespace internal {
 
 class TraceHandlerImpl final : public trace::TraceHandler {
 public:
-    static zx_status_t StartEngine(async_t* async, zx::vmo buffer,
-                                   zx::eventpair fence,
+    static zx_status_t StartEngine(async_t* async,
+                                   trace_buffering_mode_t buffering_mode,
+                                   zx::vmo buffer, zx::eventpair fence,
                                    fbl::Vector<fbl::String> enabled_categories);
     static zx_status_t StopEngine();
+    static zx_status_t MarkBufferSaved(uint32_t wrapped_count);
 
 private:
     TraceHandlerImpl(void* buffer, size_t buffer_num_bytes,
@@ -37,6 +39,7 @@ private:
     void TraceStopped(async_t* async,
                       zx_status_t disposition, size_t buffer_bytes_written) override;
     void BufferOverflow() override;
+    void NotifyBufferFull(uint32_t wrapped_count, uint64_t durable_data_end) override;
 
     void* buffer_;
     size_t buffer_num_bytes_;
@@ -12,6 +12,7 @@
 #include <zircon/types.h>
 
 #include <async/dispatcher.h>
+#include <trace-engine/buffer.h>
 
 __BEGIN_CDECLS
 
@@ -23,6 +24,11 @@ __BEGIN_CDECLS
 // Indicate a record was dropped because the trace buffer is full.
 #define TRACE_PROVIDER_SIGNAL_BUFFER_OVERFLOW ZX_USER_SIGNAL_1
 
+// Indicate a rolling buffer is ready to be saved, in streaming mode.
+// The buffer header says which one.  Once it has been saved the tracing
+// system sends |TraceProvider::BufferSaved()| so that it can be reused.
+#define TRACE_PROVIDER_SIGNAL_BUFFER_FULL ZX_USER_SIGNAL_2
+
 // End signals for zx_object_signal_peer(fence).
 
 // Represents a trace provider.
@@ -45,6 +51,12 @@ typedef struct trace_provider trace_provider_t;
 // probably need to pass some extra parameters to the trace provider then.
 trace_provider_t* trace_provider_create(async_t* async);
 
+// Creates a trace provider whose trace engine fills the trace buffer in the
+// given mode, see <trace-engine/buffer.h>.  |trace_provider_create()| uses
+// |TRACE_BUFFERING_MODE_ONESHOT|.
+trace_provider_t* trace_provider_create_with_buffering_mode(
+    async_t* async, trace_buffering_mode_t buffering_mode);
+
 // Destroys the trace provider.
 void trace_provider_destroy(trace_provider_t* provider);
 
@@ -57,8 +69,9 @@ namespace trace {
 class TraceProvider {
 public:
     // Creates a trace provider.
-    TraceProvider(async_t* async)
-        : provider_(trace_provider_create(async)) {}
+    TraceProvider(async_t* async,
+                  trace_buffering_mode_t buffering_mode = TRACE_BUFFERING_MODE_ONESHOT)
+        : provider_(trace_provider_create_with_buffering_mode(async, buffering_mode)) {}
 
     // Destroys a trace provider.
     ~TraceProvider() {
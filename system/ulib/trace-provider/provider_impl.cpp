@@ -42,6 +42,12 @@ struct start : message {
 
 constexpr unsigned kExpectedCategoryArrayHeaderLength = 8;
 
+// TraceProvider::BufferSaved(uint32 wrapped_count)
+struct buffer_saved : message {
+    uint32_t wrapped_count;
+    uint32_t padding;
+};
+
 struct string_entry {
     uint32_t entry_length; // not including any padding
     uint32_t string_length; // Note: there is no trailing NUL
@@ -60,8 +66,10 @@ struct register_trace_provider : message {
 namespace trace {
 namespace internal {
 
-TraceProviderImpl::TraceProviderImpl(async_t* async, zx::channel channel)
-    : async_(async), connection_(this, fbl::move(channel)) {
+TraceProviderImpl::TraceProviderImpl(async_t* async, trace_buffering_mode_t buffering_mode,
+                                     zx::channel channel)
+    : async_(async), buffering_mode_(buffering_mode),
+      connection_(this, fbl::move(channel)) {
 }
 
 TraceProviderImpl::~TraceProviderImpl() = default;
@@ -72,7 +80,7 @@ void TraceProviderImpl::Start(zx::vmo buffer, zx::eventpair fence,
         return;
 
     zx_status_t status = TraceHandlerImpl::StartEngine(
-        async_, fbl::move(buffer), fbl::move(fence),
+        async_, buffering_mode_, fbl::move(buffer), fbl::move(fence),
         fbl::move(enabled_categories));
     if (status == ZX_OK)
         running_ = true;
@@ -86,6 +94,13 @@ void TraceProviderImpl::Stop() {
     TraceHandlerImpl::StopEngine();
 }
 
+void TraceProviderImpl::BufferSaved(uint32_t wrapped_count) {
+    if (!running_)
+        return;
+
+    TraceHandlerImpl::MarkBufferSaved(wrapped_count);
+}
+
 TraceProviderImpl::Connection::Connection(TraceProviderImpl* impl,
                                           zx::channel channel)
     : impl_(impl), channel_(fbl::move(channel)),
@@ -214,6 +229,14 @@ bool TraceProviderImpl::Connection::ReadMessage() {
     case 2:
         // TraceProvider::Dump(handle<socket> output)
         return true; // ignored
+    case 3: {
+        // TraceProvider::BufferSaved(uint32 wrapped_count)
+        if (num_bytes < sizeof(buffer_saved))
+            return false;
+        const buffer_saved* b = static_cast<const buffer_saved*>(m);
+        impl_->BufferSaved(b->wrapped_count);
+        return true;
+    }
     default:
         return false;
     }
@@ -231,6 +254,11 @@ void TraceProviderImpl::Connection::Close() {
 } // namespace trace
 
 trace_provider_t* trace_provider_create(async_t* async) {
+    return trace_provider_create_with_buffering_mode(async, TRACE_BUFFERING_MODE_ONESHOT);
+}
+
+trace_provider_t* trace_provider_create_with_buffering_mode(
+    async_t* async, trace_buffering_mode_t buffering_mode) {
     ZX_DEBUG_ASSERT(async);
 
     // Connect to the trace registry.
@@ -277,7 +305,8 @@ trace_provider_t* trace_provider_create(async_t* async) {
         return nullptr;
     }
 
-    return new trace::internal::TraceProviderImpl(async, fbl::move(provider_service));
+    return new trace::internal::TraceProviderImpl(async, buffering_mode,
+                                                  fbl::move(provider_service));
 }
 
 void trace_provider_destroy(trace_provider_t* provider) {
@@ -21,7 +21,8 @@ namespace internal {
 
 class TraceProviderImpl final : public trace_provider_t {
 public:
-    TraceProviderImpl(async_t* async, zx::channel channel);
+    TraceProviderImpl(async_t* async, trace_buffering_mode_t buffering_mode,
+                      zx::channel channel);
     ~TraceProviderImpl();
 
 private:
@@ -46,8 +47,10 @@ private:
     void Start(zx::vmo buffer, zx::eventpair fence,
                fbl::Vector<fbl::String> enabled_categories);
     void Stop();
+    void BufferSaved(uint32_t wrapped_count);
 
     async_t* const async_;
+    trace_buffering_mode_t const buffering_mode_;
     Connection connection_;
     bool running_ = false;
 
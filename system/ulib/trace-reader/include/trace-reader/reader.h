@@ -54,6 +54,13 @@ public:
     // no such provider.
     fbl::String GetProviderName(ProviderId id) const;
 
+    // Gets the koid of the thread which wrote the buffer chunk that the
+    // current record belongs to.
+    // Returns ZX_KOID_INVALID if the record does not belong to a chunk.
+    // All the records in a chunk come from the same thread, in the order in
+    // which that thread wrote them.
+    zx_koid_t current_chunk_thread_koid() const { return chunk_thread_koid_; }
+
 private:
     bool ReadMetadataRecord(Chunk& record,
                             RecordHeader header);
@@ -69,6 +76,7 @@ private:
     bool ReadContextSwitchRecord(Chunk& record,
                                  RecordHeader header);
     bool ReadLogRecord(Chunk& record, RecordHeader header);
+    bool ReadBufferChunkRecord(Chunk& record, RecordHeader header);
     bool ReadArguments(Chunk& record,
                        size_t count,
                        fbl::Vector<Argument>* out_arguments);
@@ -92,6 +100,11 @@ private:
 
     RecordHeader pending_header_ = 0u;
 
+    // The thread which owns the buffer chunk being read, and the number of
+    // words left in that chunk.
+    zx_koid_t chunk_thread_koid_ = ZX_KOID_INVALID;
+    size_t chunk_words_left_ = 0u;
+
     struct StringTableEntry : public fbl::SinglyLinkedListable<
                                   fbl::unique_ptr<StringTableEntry>> {
         StringTableEntry(trace_string_index_t index,
@@ -82,6 +82,12 @@ bool TraceReader::ReadRecords(Chunk& chunk) {
             }
             break;
         }
+        case RecordType::kBufferChunk: {
+            if (!ReadBufferChunkRecord(record, pending_header_)) {
+                ReportError("Failed to read buffer chunk record");
+            }
+            break;
+        }
         default: {
             // Ignore unknown record types for forward compatibility.
             ReportError(fbl::StringPrintf(
@@ -90,6 +96,12 @@ bool TraceReader::ReadRecords(Chunk& chunk) {
         }
         }
         pending_header_ = 0u;
+
+        if (chunk_words_left_ != 0u) {
+            chunk_words_left_ = size < chunk_words_left_ ? chunk_words_left_ - size : 0u;
+            if (chunk_words_left_ == 0u)
+                chunk_thread_koid_ = ZX_KOID_INVALID;
+        }
     }
 }
 
@@ -149,6 +161,33 @@ bool TraceReader::ReadMetadataRecord(Chunk& record, RecordHeader header) {
     return true;
 }
 
+bool TraceReader::ReadBufferChunkRecord(Chunk& record, RecordHeader header) {
+    auto type = BufferChunkRecordFields::ChunkType::Get<BufferChunkType>(header);
+
+    switch (type) {
+    case BufferChunkType::kBegin: {
+        auto chunk_size = BeginBufferChunkRecordFields::ChunkSize::Get<size_t>(header);
+        zx_koid_t thread_koid;
+        if (!record.ReadUint64(&thread_koid))
+            return false;
+
+        chunk_thread_koid_ = thread_koid;
+        chunk_words_left_ = chunk_size;
+        break;
+    }
+    case BufferChunkType::kPadding:
+        // Unused space at the end of a chunk.
+        break;
+    default: {
+        // Ignore unknown chunk types for forward compatibility.
+        ReportError(fbl::StringPrintf(
+            "Skipping buffer chunk record of unknown type %d", static_cast<uint32_t>(type)));
+        break;
+    }
+    }
+    return true;
+}
+
 bool TraceReader::ReadInitializationRecord(Chunk& record, RecordHeader header) {
     trace_ticks_t ticks_per_second;
     if (!record.ReadUint64(&ticks_per_second) || !ticks_per_second)
@@ -43,7 +43,7 @@ const char* ThreadStateToString(ThreadState state) {
 }
 
 const char* ObjectTypeToString(zx_obj_type_t type) {
-    static_assert(ZX_OBJ_TYPE_LAST == 24, "need to update switch below");
+    static_assert(ZX_OBJ_TYPE_LAST == 25, "need to update switch below");
 
     switch (type) {
     case ZX_OBJ_TYPE_PROCESS:
@@ -84,6 +84,10 @@ const char* ObjectTypeToString(zx_obj_type_t type) {
         return "timer";
     case ZX_OBJ_TYPE_IOMMU:
         return "iommu";
+    case ZX_OBJ_TYPE_PAGER:
+        return "pager";
+    case ZX_OBJ_TYPE_BTI:
+        return "bti";
     default:
         return "???";
     }
@@ -375,6 +379,9 @@ void Record::Destroy() {
     case RecordType::kLog:
         log_.~Log();
         break;
+    case RecordType::kBufferChunk:
+        // Buffer chunk records are consumed by the reader.
+        break;
     }
 }
 
@@ -405,6 +412,8 @@ void Record::MoveFrom(Record&& other) {
     case RecordType::kLog:
         new (&log_) Log(fbl::move(other.log_));
         break;
+    case RecordType::kBufferChunk:
+        break;
     }
 }
 
@@ -448,6 +457,8 @@ fbl::String Record::ToString() const {
         return fbl::StringPrintf("Log(ts: %" PRIu64 ", pt: %s, \"%s\")",
                                   log_.timestamp, log_.process_thread.ToString().c_str(),
                                   log_.message.c_str());
+    case RecordType::kBufferChunk:
+        break;
     }
     ZX_ASSERT(false);
 }
@@ -56,12 +56,21 @@ public:
     // the buffer was full.
     virtual void BufferOverflow() {}
 
+    // Called by the trace engine in streaming mode when the rolling buffer
+    // identified by |wrapped_count| is ready to be saved.  Call
+    // |trace_engine_mark_buffer_saved()| once it has been.
+    //
+    // Called on an asynchronous dispatch thread.
+    virtual void NotifyBufferFull(uint32_t wrapped_count, uint64_t durable_data_end) {}
+
 private:
     static bool CallIsCategoryEnabled(trace_handler_t* handler, const char* category);
     static void CallTraceStarted(trace_handler_t* handler);
     static void CallTraceStopped(trace_handler_t* handler, async_t* async,
                                  zx_status_t disposition, size_t buffer_bytes_written);
     static void CallBufferOverflow(trace_handler_t* handler);
+    static void CallNotifyBufferFull(trace_handler_t* handler, uint32_t wrapped_count,
+                                     uint64_t durable_data_end);
 
     static const trace_handler_ops_t kOps;
 };
@@ -33,6 +33,7 @@
 #define VIRTIO_NET_F_CTRL_MAC_ADDR          (1u << 23)
 
 #define VIRTIO_NET_HDR_F_NEEDS_CSUM 1u
+#define VIRTIO_NET_HDR_F_DATA_VALID 2u
 
 #define VIRTIO_NET_HDR_GSO_NONE     0u
 #define VIRTIO_NET_HDR_GSO_TCPV4    1u
@@ -43,6 +44,14 @@
 #define VIRTIO_NET_S_LINK_UP        1u
 #define VIRTIO_NET_S_ANNOUNCE       2u
 
+#define VIRTIO_NET_OK               0u
+#define VIRTIO_NET_ERR              1u
+
+#define VIRTIO_NET_CTRL_MQ              4u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET 0u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN 1u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MAX 0x8000u
+
 // clang-format on
 
 __BEGIN_CDECLS
@@ -62,4 +71,14 @@ typedef struct virtio_net_hdr {
     uint16_t csum_offset;
 } __PACKED virtio_net_hdr_t;
 
+// Header of a command on the control virtqueue; see section 5.1.6.5 of the spec
+typedef struct virtio_net_ctrl_hdr {
+    uint8_t ctrl_class;
+    uint8_t cmd;
+} __PACKED virtio_net_ctrl_hdr_t;
+
+typedef struct virtio_net_ctrl_mq {
+    uint16_t virtqueue_pairs;
+} __PACKED virtio_net_ctrl_mq_t;
+
 __END_CDECLS
@@ -9,8 +9,10 @@
 
 // This defines the struct shared with the kernel.
 #include <lib/vdso-constants.h>
+#include <lib/vdso-time.h>
 
 extern __LOCAL const struct vdso_constants DATA_CONSTANTS;
+extern __LOCAL const struct vdso_time DATA_TIME;
 
 extern "C" {
 
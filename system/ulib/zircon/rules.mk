@@ -11,12 +11,13 @@ MODULE_TYPE := userlib
 # This library should not depend on libc.
 MODULE_COMPILEFLAGS := -ffreestanding $(NO_SAFESTACK) $(NO_SANITIZERS)
 
-MODULE_HEADER_DEPS := kernel/lib/vdso
+MODULE_HEADER_DEPS := kernel/lib/fixed_point kernel/lib/vdso
 
 MODULE_SRCS := \
     $(LOCAL_DIR)/data.S \
     $(LOCAL_DIR)/zx_cache_flush.cpp \
     $(LOCAL_DIR)/zx_channel_call.cpp \
+    $(LOCAL_DIR)/zx_clock_get.cpp \
     $(LOCAL_DIR)/zx_deadline_after.cpp \
     $(LOCAL_DIR)/zx_status_get_string.cpp \
     $(LOCAL_DIR)/zx_system_get_features.cpp \
@@ -0,0 +1,49 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/syscalls.h>
+
+#include <lib/fixed_point.h>
+
+#include "private.h"
+
+namespace {
+
+// Does the same arithmetic as the kernel's current_time(), so the two
+// always agree.
+zx_time_t monotonic_from_ticks() {
+    const fp_32_64 ns_per_tick = {
+        DATA_TIME.ns_per_tick.l0,
+        DATA_TIME.ns_per_tick.l32,
+        DATA_TIME.ns_per_tick.l64,
+    };
+    return u64_mul_u64_fp32_64(VDSO_zx_ticks_get(), ns_per_tick);
+}
+
+int64_t utc_offset() {
+    uint32_t seq;
+    int64_t offset;
+    do {
+        seq = __atomic_load_n(&DATA_TIME.seq, __ATOMIC_ACQUIRE);
+        offset = __atomic_load_n(&DATA_TIME.utc_offset, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || __atomic_load_n(&DATA_TIME.seq, __ATOMIC_RELAXED) != seq);
+    return offset;
+}
+
+} // namespace
+
+zx_time_t _zx_clock_get(uint32_t clock_id) {
+    if (DATA_TIME.ticks_to_mono_valid) {
+        switch (clock_id) {
+        case ZX_CLOCK_MONOTONIC:
+            return monotonic_from_ticks();
+        case ZX_CLOCK_UTC:
+            return monotonic_from_ticks() + utc_offset();
+        }
+    }
+    return SYSCALL_zx_clock_get_via_kernel(clock_id);
+}
+
+VDSO_INTERFACE_FUNCTION(zx_clock_get);
@@ -46,6 +46,10 @@ public:
     zx_status_t write_state(uint32_t kind, const void* buffer, size_t len) {
         return zx_thread_write_state(get(), kind, buffer, len);
     }
+    zx_status_t resume_from_exception(uint32_t options, uint32_t kind, const void* buffer,
+                                      size_t len) {
+        return zx_thread_resume_from_exception(get(), options, kind, buffer, len);
+    }
 
     static inline const unowned<thread> self() {
         return unowned<thread>(zx_thread_self());
@@ -42,6 +42,14 @@ public:
         return zx_vmar_protect(get(), address, len, prot);
     }
 
+    zx_status_t op_range(uint32_t op, uintptr_t address, size_t len) const {
+        return zx_vmar_op_range(get(), op, address, len);
+    }
+
+    zx_status_t batch(zx_vmar_batch_op_t* ops, size_t count, size_t* actual) const {
+        return zx_vmar_batch(get(), ops, count, actual);
+    }
+
     zx_status_t destroy() const {
         return zx_vmar_destroy(get());
     }
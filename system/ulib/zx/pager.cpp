@@ -0,0 +1,26 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zx/pager.h>
+
+#include <zircon/syscalls.h>
+
+namespace zx {
+
+zx_status_t pager::create(uint32_t options, pager* result) {
+    zx_handle_t h = ZX_HANDLE_INVALID;
+    zx_status_t status = zx_pager_create(options, &h);
+    result->reset(h);
+    return status;
+}
+
+zx_status_t pager::create_vmo(const port& port, uint64_t key, uint64_t size, uint32_t options,
+                              vmo* result) const {
+    zx_handle_t h = ZX_HANDLE_INVALID;
+    zx_status_t status = zx_pager_create_vmo(get(), port.get(), key, size, options, &h);
+    result->reset(h);
+    return status;
+}
+
+} // namespace zx
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdio.h>
 #include <threads.h>
 
 #include <zircon/syscalls.h>
@@ -12,10 +13,12 @@
 #include <async/cpp/wait.h>
 
 #include <zx/event.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/function.h>
 #include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
 #include <unittest/unittest.h>
 
 namespace {
@@ -96,9 +99,26 @@ protected:
     }
 };
 
+class CancelOtherWait : public TestWait {
+public:
+    CancelOtherWait(zx_handle_t object, zx_signals_t trigger)
+        : TestWait(object, trigger) {}
+
+    CancelOtherWait* other = nullptr;
+    zx_status_t cancel_status = ZX_ERR_INTERNAL;
+
+protected:
+    async_wait_result_t Handle(async_t* async, zx_status_t status,
+                               const zx_packet_signal_t* signal) override {
+        TestWait::Handle(async, status, signal);
+        cancel_status = other->op.Cancel(async);
+        return ASYNC_WAIT_FINISHED;
+    }
+};
+
 class TestTask {
 public:
-    TestTask(zx_time_t deadline)
+    TestTask(zx_time_t deadline = ZX_TIME_INFINITE)
         : op(deadline) {
         op.set_handler(fbl::BindMember(this, &TestTask::Handle));
     }
@@ -172,6 +192,25 @@ protected:
     }
 };
 
+// Appends its index to a shared log when it runs.
+class LoggingTask {
+public:
+    LoggingTask() {
+        op.set_handler(fbl::BindMember(this, &LoggingTask::Handle));
+    }
+
+    async::Task op;
+    uint32_t index = 0u;
+    uint32_t* log = nullptr;
+    uint32_t* log_count = nullptr;
+
+private:
+    async_task_result_t Handle(async_t* async, zx_status_t status) {
+        log[(*log_count)++] = index;
+        return ASYNC_TASK_FINISHED;
+    }
+};
+
 class TestReceiver {
 public:
     TestReceiver() {
@@ -388,6 +427,81 @@ bool wait_test() {
     END_TEST;
 }
 
+bool wait_persistent_test() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    zx::event event;
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event), "create event");
+
+    // |wait1| clears its signal each time, |wait2| leaves it asserted and
+    // finishes the first time.
+    CascadeWait wait1(event.get(), ZX_USER_SIGNAL_1,
+                      ZX_USER_SIGNAL_1, 0u, true);
+    CascadeWait wait2(event.get(), ZX_USER_SIGNAL_2,
+                      0u, 0u, false);
+    wait1.op.set_flags(ASYNC_FLAG_PERSISTENT);
+    wait2.op.set_flags(ASYNC_FLAG_PERSISTENT);
+    EXPECT_EQ(ZX_OK, wait1.op.Begin(loop.async()), "wait 1");
+    EXPECT_EQ(ZX_OK, wait2.op.Begin(loop.async()), "wait 2");
+
+    // Each time signal 1 is set |wait1| runs without beginning again.
+    for (uint32_t i = 0; i < 3; i++) {
+        EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_1), "signal 1");
+        EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+        EXPECT_EQ(i + 1u, wait1.run_count, "run count 1");
+        EXPECT_EQ(ZX_OK, wait1.last_status, "status 1");
+        EXPECT_NONNULL(wait1.last_signal);
+        EXPECT_EQ(ZX_USER_SIGNAL_1, wait1.last_signal->observed, "observed 1");
+    }
+
+    // |wait2| finishes, which ends its registration.
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_2), "signal 2");
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(1u, wait2.run_count, "run count 2");
+    EXPECT_EQ(ZX_OK, event.signal(ZX_USER_SIGNAL_2, 0u), "clear 2");
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_2), "signal 2");
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(1u, wait2.run_count, "run count 2");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, wait2.op.Cancel(loop.async()), "cancel 2");
+
+    // Canceling |wait1| ends its registration too.
+    EXPECT_EQ(ZX_OK, wait1.op.Cancel(loop.async()), "cancel 1");
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_1), "signal 1");
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(3u, wait1.run_count, "run count 1");
+
+    END_TEST;
+}
+
+bool wait_cancel_pending_test() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    zx::event event1, event2;
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event1), "create event 1");
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event2), "create event 2");
+
+    // Both completions are queued before the loop runs, so they are
+    // dequeued together.  Whichever handler runs first must be able to
+    // cancel the other even though its packet has left the port.
+    CancelOtherWait wait1(event1.get(), ZX_USER_SIGNAL_0);
+    CancelOtherWait wait2(event2.get(), ZX_USER_SIGNAL_0);
+    wait1.other = &wait2;
+    wait2.other = &wait1;
+    EXPECT_EQ(ZX_OK, wait1.op.Begin(loop.async()), "wait 1");
+    EXPECT_EQ(ZX_OK, wait2.op.Begin(loop.async()), "wait 2");
+    EXPECT_EQ(ZX_OK, event1.signal(0u, ZX_USER_SIGNAL_0), "signal 1");
+    EXPECT_EQ(ZX_OK, event2.signal(0u, ZX_USER_SIGNAL_0), "signal 2");
+
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(1u, wait1.run_count + wait2.run_count, "only one handler ran");
+    CancelOtherWait* ran = wait1.run_count ? &wait1 : &wait2;
+    EXPECT_EQ(ZX_OK, ran->cancel_status, "cancel status");
+
+    END_TEST;
+}
+
 bool wait_invalid_handle_test() {
     BEGIN_TEST;
 
@@ -615,6 +729,92 @@ bool task_shutdown_test() {
     END_TEST;
 }
 
+bool task_ordering_test() {
+    BEGIN_TEST;
+
+    // Tasks run in deadline order, and those with equal deadlines in the
+    // order they were posted, however they were interleaved.
+    constexpr uint32_t kTaskCount = 1000u;
+    constexpr uint32_t kDeadlines = 17u;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<LoggingTask[]> tasks(new (&ac) LoggingTask[kTaskCount]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<uint32_t[]> log(new (&ac) uint32_t[kTaskCount]);
+    ASSERT_TRUE(ac.check());
+    uint32_t log_count = 0u;
+
+    async::Loop loop;
+    zx_time_t start_time = now();
+    for (uint32_t i = 0; i < kTaskCount; i++) {
+        tasks[i].index = i;
+        tasks[i].log = log.get();
+        tasks[i].log_count = &log_count;
+        tasks[i].op.set_deadline(start_time - ZX_MSEC((i * 7u) % kDeadlines));
+        EXPECT_EQ(ZX_OK, tasks[i].op.Post(loop.async()), "post");
+    }
+
+    // Cancel every third task, the head of the queue among them.
+    uint32_t canceled = 0u;
+    for (uint32_t i = 0; i < kTaskCount; i += 3u) {
+        EXPECT_EQ(ZX_OK, tasks[i].op.Cancel(loop.async()), "cancel");
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, tasks[i].op.Cancel(loop.async()), "cancel twice");
+        canceled++;
+    }
+
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    ASSERT_EQ(kTaskCount - canceled, log_count, "tasks run");
+    for (uint32_t i = 1; i < log_count; i++) {
+        const LoggingTask& prev = tasks[log[i - 1]];
+        const LoggingTask& cur = tasks[log[i]];
+        EXPECT_TRUE(prev.op.deadline() < cur.op.deadline() ||
+                        (prev.op.deadline() == cur.op.deadline() && prev.index < cur.index),
+                    "run in order");
+        EXPECT_NE(0u, cur.index % 3u, "canceled task did not run");
+    }
+
+    END_TEST;
+}
+
+// Reports how long posting and canceling many pending timeouts takes, as
+// a service does with one timeout per request in flight.
+bool task_post_cancel_benchmark() {
+    BEGIN_TEST;
+
+    constexpr uint32_t kTaskCount = 20000u;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<TestTask[]> tasks(new (&ac) TestTask[kTaskCount]);
+    ASSERT_TRUE(ac.check());
+
+    async::Loop loop;
+    zx_time_t start_time = now();
+    for (uint32_t i = 0; i < kTaskCount; i++) {
+        // Scatter the deadlines well into the future.
+        tasks[i].op.set_deadline(start_time + ZX_SEC(60) + ZX_USEC((i * 7919u) % kTaskCount));
+    }
+
+    zx_time_t post_start = now();
+    for (uint32_t i = 0; i < kTaskCount; i++) {
+        ASSERT_EQ(ZX_OK, tasks[i].op.Post(loop.async()), "post");
+    }
+    zx_time_t cancel_start = now();
+    for (uint32_t i = 0; i < kTaskCount; i++) {
+        // Cancel in a different order from both posting and deadlines.
+        uint32_t index = (i * 4099u) % kTaskCount;
+        ASSERT_EQ(ZX_OK, tasks[index].op.Cancel(loop.async()), "cancel");
+    }
+    zx_time_t end = now();
+
+    printf("\nBenchmark post %u tasks: %6.1f ns/task, cancel: %6.1f ns/task",
+           kTaskCount,
+           static_cast<double>(cancel_start - post_start) / kTaskCount,
+           static_cast<double>(end - cancel_start) / kTaskCount);
+    for (uint32_t i = 0; i < kTaskCount; i++) {
+        EXPECT_EQ(0u, tasks[i].run_count, "canceled task did not run");
+    }
+
+    END_TEST;
+}
+
 bool receiver_test() {
     const zx_packet_user_t data1{.u64 = {11, 12, 13, 14}};
     const zx_packet_user_t data2{.u64 = {21, 22, 23, 24}};
@@ -906,6 +1106,67 @@ bool threads_tasks_run_sequentially_test() {
     END_TEST;
 }
 
+struct PostTasksArgs {
+    async_t* async;
+    ThreadAssertTask** items;
+    size_t count;
+};
+
+int post_tasks_thread(void* data) {
+    auto args = static_cast<PostTasksArgs*>(data);
+    for (size_t i = 0; i < args->count; i++) {
+        if (args->items[i]->op.Post(args->async) != ZX_OK)
+            return -1;
+    }
+    return 0;
+}
+
+// Tasks may be posted from many threads at once without losing any.
+bool threads_post_tasks_concurrently_test() {
+    const size_t num_threads = 4;
+    const size_t num_posters = 4;
+    const size_t num_items = 100;
+
+    BEGIN_TEST;
+
+    async::Loop loop;
+    for (size_t i = 0; i < num_threads; i++) {
+        EXPECT_EQ(ZX_OK, loop.StartThread(), "start thread");
+    }
+
+    ConcurrencyMeasure measure(num_posters * num_items);
+    ThreadAssertTask* items[num_posters * num_items];
+    zx_time_t start_time = now();
+    for (size_t i = 0; i < num_posters * num_items; i++) {
+        items[i] = new ThreadAssertTask(start_time + ZX_USEC(i % 7u), &measure);
+    }
+
+    thrd_t posters[num_posters];
+    PostTasksArgs args[num_posters];
+    for (size_t i = 0; i < num_posters; i++) {
+        args[i] = {loop.async(), &items[i * num_items], num_items};
+        ASSERT_EQ(thrd_success, thrd_create(&posters[i], post_tasks_thread, &args[i]),
+                  "start poster");
+    }
+    for (size_t i = 0; i < num_posters; i++) {
+        int result;
+        EXPECT_EQ(thrd_success, thrd_join(posters[i], &result), "join poster");
+        EXPECT_EQ(0, result, "post tasks");
+    }
+
+    // Wait until quitted.
+    loop.JoinThreads();
+
+    EXPECT_EQ(num_posters * num_items, measure.count(), "item count");
+    for (size_t i = 0; i < num_posters * num_items; i++) {
+        EXPECT_EQ(1u, items[i]->run_count, "run count");
+        delete items[i];
+    }
+    EXPECT_EQ(1u, measure.max_threads(), "tasks handled sequentially");
+
+    END_TEST;
+}
+
 // The goal here is to schedule a lot of work and see whether it runs
 // on as many threads as we expected it to.
 bool threads_receivers_run_concurrently_test() {
@@ -950,10 +1211,14 @@ RUN_TEST(make_default_true_test)
 RUN_TEST(quit_test)
 RUN_TEST(wait_test)
 RUN_TEST(wait_invalid_handle_test)
+RUN_TEST(wait_cancel_pending_test)
+RUN_TEST(wait_persistent_test)
 RUN_TEST(wait_shutdown_test)
 RUN_TEST(wait_method_test)
 RUN_TEST(task_test)
 RUN_TEST(task_shutdown_test)
+RUN_TEST(task_ordering_test)
+RUN_TEST_PERFORMANCE(task_post_cancel_benchmark)
 RUN_TEST(receiver_test)
 RUN_TEST(receiver_shutdown_test)
 RUN_TEST(threads_have_default_dispatcher)
@@ -962,6 +1227,7 @@ for (int i = 0; i < 3; i++) {
     RUN_TEST(threads_shutdown)
     RUN_TEST(threads_waits_run_concurrently_test)
     RUN_TEST(threads_tasks_run_sequentially_test)
+    RUN_TEST(threads_post_tasks_concurrently_test)
     RUN_TEST(threads_receivers_run_concurrently_test)
 }
 END_TEST_CASE(loop_tests)
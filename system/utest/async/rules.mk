@@ -14,6 +14,8 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/loop_tests.cpp \
     $(LOCAL_DIR)/main.c \
     $(LOCAL_DIR)/receiver_tests.cpp \
+    $(LOCAL_DIR)/sequence_tests.cpp \
+    $(LOCAL_DIR)/strand_tests.cpp \
     $(LOCAL_DIR)/task_tests.cpp \
     $(LOCAL_DIR)/wait_tests.cpp \
     $(LOCAL_DIR)/wait_with_timeout_tests.cpp
@@ -0,0 +1,317 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+
+#include <async/cpp/loop.h>
+#include <async/cpp/sequence.h>
+#include <async/cpp/wait.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/slab_allocator.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+#include <zx/event.h>
+
+#include "async_stub.h"
+
+namespace {
+
+class MockAsync : public AsyncStub {
+public:
+    async_wait_t* last_wait = nullptr;
+    async_task_t* last_task = nullptr;
+    uint32_t cancel_wait_count = 0u;
+    uint32_t cancel_task_count = 0u;
+    zx_status_t next_status = ZX_OK;
+
+    zx_status_t BeginWait(async_wait_t* wait) override {
+        last_wait = wait;
+        return next_status;
+    }
+
+    zx_status_t CancelWait(async_wait_t* wait) override {
+        cancel_wait_count++;
+        return ZX_OK;
+    }
+
+    zx_status_t PostTask(async_task_t* task) override {
+        last_task = task;
+        return ZX_OK;
+    }
+
+    zx_status_t CancelTask(async_task_t* task) override {
+        cancel_task_count++;
+        return ZX_OK;
+    }
+};
+
+class Steps {
+public:
+    void First(async_t* async, zx_status_t status) {
+        run_count++;
+        last_status = status;
+    }
+
+    uint32_t run_count = 0u;
+    zx_status_t last_status = ZX_ERR_INTERNAL;
+    async::Sequence<Steps> seq{this};
+};
+
+bool sequence_signals_test() {
+    const zx_handle_t dummy_handle = static_cast<zx_handle_t>(1);
+    const zx_packet_signal_t dummy_signal{
+        .trigger = ZX_USER_SIGNAL_0,
+        .observed = ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_1,
+        .count = 0u,
+        .reserved0 = 0u,
+        .reserved1 = 0u};
+
+    BEGIN_TEST;
+
+    MockAsync async;
+    Steps steps;
+    EXPECT_FALSE(steps.seq.is_pending(), "not pending");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, steps.seq.Cancel(&async), "cancel nothing");
+
+    EXPECT_EQ(ZX_OK, steps.seq.AwaitSignals(&async, dummy_handle, ZX_USER_SIGNAL_0,
+                                            &Steps::First),
+              "await");
+    EXPECT_TRUE(steps.seq.is_pending(), "pending");
+    ASSERT_NONNULL(async.last_wait, "began wait");
+    EXPECT_EQ(dummy_handle, async.last_wait->object, "object");
+    EXPECT_EQ(ZX_USER_SIGNAL_0, async.last_wait->trigger, "trigger");
+    EXPECT_NULL(async.last_task, "no deadline, no task");
+
+    EXPECT_EQ(ASYNC_WAIT_FINISHED,
+              async.last_wait->handler(&async, async.last_wait, ZX_OK, &dummy_signal),
+              "finished");
+    EXPECT_EQ(1u, steps.run_count, "ran step");
+    EXPECT_EQ(ZX_OK, steps.last_status, "status");
+    EXPECT_EQ(dummy_signal.observed, steps.seq.observed(), "observed");
+    EXPECT_FALSE(steps.seq.is_pending(), "not pending");
+    EXPECT_EQ(0u, async.cancel_task_count, "no task to cancel");
+
+    END_TEST;
+}
+
+bool sequence_signals_deadline_test() {
+    const zx_handle_t dummy_handle = static_cast<zx_handle_t>(1);
+    const zx_packet_signal_t dummy_signal{
+        .trigger = ZX_USER_SIGNAL_0,
+        .observed = ZX_USER_SIGNAL_0,
+        .count = 0u,
+        .reserved0 = 0u,
+        .reserved1 = 0u};
+
+    BEGIN_TEST;
+
+    // The signals arrive first; the deadline is canceled.
+    {
+        MockAsync async;
+        Steps steps;
+        EXPECT_EQ(ZX_OK, steps.seq.AwaitSignals(&async, dummy_handle, ZX_USER_SIGNAL_0,
+                                                &Steps::First, 42),
+                  "await");
+        ASSERT_NONNULL(async.last_wait, "began wait");
+        ASSERT_NONNULL(async.last_task, "posted task");
+        EXPECT_EQ(42, async.last_task->deadline, "deadline");
+
+        async.last_wait->handler(&async, async.last_wait, ZX_OK, &dummy_signal);
+        EXPECT_EQ(1u, steps.run_count, "ran step");
+        EXPECT_EQ(ZX_OK, steps.last_status, "status");
+        EXPECT_EQ(1u, async.cancel_task_count, "canceled task");
+        EXPECT_EQ(0u, async.cancel_wait_count, "did not cancel wait");
+    }
+
+    // The deadline passes first; the wait is canceled.
+    {
+        MockAsync async;
+        Steps steps;
+        EXPECT_EQ(ZX_OK, steps.seq.AwaitReadable(&async, dummy_handle, &Steps::First, 42),
+                  "await");
+        ASSERT_NONNULL(async.last_wait, "began wait");
+        EXPECT_EQ(ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED, async.last_wait->trigger,
+                  "trigger");
+        ASSERT_NONNULL(async.last_task, "posted task");
+
+        EXPECT_EQ(ASYNC_TASK_FINISHED,
+                  async.last_task->handler(&async, async.last_task, ZX_OK), "finished");
+        EXPECT_EQ(1u, steps.run_count, "ran step");
+        EXPECT_EQ(ZX_ERR_TIMED_OUT, steps.last_status, "timed out");
+        EXPECT_EQ(ZX_SIGNAL_NONE, steps.seq.observed(), "observed");
+        EXPECT_EQ(1u, async.cancel_wait_count, "canceled wait");
+        EXPECT_EQ(0u, async.cancel_task_count, "did not cancel task");
+    }
+
+    END_TEST;
+}
+
+bool sequence_deadline_test() {
+    BEGIN_TEST;
+
+    MockAsync async;
+    Steps steps;
+    EXPECT_EQ(ZX_OK, steps.seq.AwaitDeadline(&async, 42, &Steps::First), "await");
+    EXPECT_NULL(async.last_wait, "no wait");
+    ASSERT_NONNULL(async.last_task, "posted task");
+    EXPECT_EQ(42, async.last_task->deadline, "deadline");
+
+    async.last_task->handler(&async, async.last_task, ZX_OK);
+    EXPECT_EQ(1u, steps.run_count, "ran step");
+    EXPECT_EQ(ZX_OK, steps.last_status, "status");
+    EXPECT_FALSE(steps.seq.is_pending(), "not pending");
+
+    END_TEST;
+}
+
+bool sequence_cancel_test() {
+    const zx_handle_t dummy_handle = static_cast<zx_handle_t>(1);
+
+    BEGIN_TEST;
+
+    MockAsync async;
+    Steps steps;
+    EXPECT_EQ(ZX_OK, steps.seq.AwaitSignals(&async, dummy_handle, ZX_USER_SIGNAL_0,
+                                            &Steps::First, 42),
+              "await");
+    EXPECT_EQ(ZX_OK, steps.seq.Cancel(&async), "cancel");
+    EXPECT_EQ(1u, async.cancel_wait_count, "canceled wait");
+    EXPECT_EQ(1u, async.cancel_task_count, "canceled task");
+    EXPECT_FALSE(steps.seq.is_pending(), "not pending");
+    EXPECT_EQ(0u, steps.run_count, "did not run step");
+
+    // A wait which cannot begin leaves nothing pending.
+    async.next_status = ZX_ERR_BAD_STATE;
+    async.last_task = nullptr;
+    EXPECT_EQ(ZX_ERR_BAD_STATE,
+              steps.seq.AwaitSignals(&async, dummy_handle, ZX_USER_SIGNAL_0,
+                                     &Steps::First, 42),
+              "await");
+    EXPECT_FALSE(steps.seq.is_pending(), "not pending");
+    EXPECT_NULL(async.last_task, "no task posted");
+
+    END_TEST;
+}
+
+constexpr uint32_t kStepCount = 20000u;
+
+// Bounces a signal off an event, once per step.
+class Bouncer;
+using BouncerAllocatorTraits = fbl::UnlockedSlabAllocatorTraits<Bouncer*>;
+
+class Bouncer : public fbl::SlabAllocated<BouncerAllocatorTraits> {
+public:
+    Bouncer(async::Loop* loop, zx_handle_t event)
+        : loop_(loop), event_(event) {}
+
+    zx_status_t Start() {
+        return Bounce(loop_->async(), ZX_OK);
+    }
+
+    zx_status_t Bounce(async_t* async, zx_status_t status) {
+        if (status != ZX_OK)
+            return status;
+        zx_object_signal(event_, ZX_USER_SIGNAL_0, ZX_USER_SIGNAL_0);
+        return seq_.AwaitSignals(async, event_, ZX_USER_SIGNAL_0, &Bouncer::Step);
+    }
+
+    void Step(async_t* async, zx_status_t status) {
+        zx_object_signal(event_, ZX_USER_SIGNAL_0, 0u);
+        if (++steps_ == kStepCount || Bounce(async, status) != ZX_OK)
+            loop_->Quit();
+    }
+
+    uint32_t steps() const { return steps_; }
+
+private:
+    async::Loop* const loop_;
+    const zx_handle_t event_;
+    uint32_t steps_ = 0u;
+    async::Sequence<Bouncer> seq_{this};
+};
+
+// The same bounce, chained the way a handler-per-wait design would: every
+// step allocates a fresh wait and handler closure.
+class ChainedBouncer {
+public:
+    ChainedBouncer(async::Loop* loop, zx_handle_t event)
+        : loop_(loop), event_(event) {}
+
+    zx_status_t Bounce(async_t* async) {
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<async::Wait> wait(new (&ac) async::Wait(event_, ZX_USER_SIGNAL_0));
+        if (!ac.check())
+            return ZX_ERR_NO_MEMORY;
+        wait->set_handler([this, wait = wait.get()](async_t* async, zx_status_t status,
+                                                   const zx_packet_signal_t* signal) {
+            fbl::unique_ptr<async::Wait> self(wait);
+            zx_object_signal(event_, ZX_USER_SIGNAL_0, 0u);
+            if (++steps_ == kStepCount || status != ZX_OK || Bounce(async) != ZX_OK)
+                loop_->Quit();
+            return ASYNC_WAIT_FINISHED;
+        });
+        zx_object_signal(event_, ZX_USER_SIGNAL_0, ZX_USER_SIGNAL_0);
+        zx_status_t status = wait->Begin(async);
+        if (status == ZX_OK)
+            wait.release();
+        return status;
+    }
+
+    uint32_t steps() const { return steps_; }
+
+private:
+    async::Loop* const loop_;
+    const zx_handle_t event_;
+    uint32_t steps_ = 0u;
+};
+
+bool sequence_benchmark() {
+    BEGIN_TEST;
+
+    zx::event event;
+    ASSERT_EQ(ZX_OK, zx::event::create(0u, &event), "create event");
+
+    zx_time_t chained_time;
+    {
+        async::Loop loop;
+        ChainedBouncer bouncer(&loop, event.get());
+        zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        ASSERT_EQ(ZX_OK, bouncer.Bounce(loop.async()), "bounce");
+        EXPECT_EQ(ZX_ERR_CANCELED, loop.Run(), "run");
+        chained_time = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+        EXPECT_EQ(kStepCount, bouncer.steps(), "steps");
+    }
+
+    zx_time_t sequence_time;
+    {
+        async::Loop loop;
+        fbl::SlabAllocator<BouncerAllocatorTraits> allocator(1u);
+        Bouncer* bouncer = allocator.New(&loop, event.get());
+        ASSERT_NONNULL(bouncer, "allocate");
+        zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        ASSERT_EQ(ZX_OK, bouncer->Start(), "start");
+        EXPECT_EQ(ZX_ERR_CANCELED, loop.Run(), "run");
+        sequence_time = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+        EXPECT_EQ(kStepCount, bouncer->steps(), "steps");
+        delete bouncer;
+    }
+
+    printf("\nBenchmark %u steps: chained waits %6.1f ns/step, sequence %6.1f ns/step",
+           kStepCount,
+           static_cast<double>(chained_time) / kStepCount,
+           static_cast<double>(sequence_time) / kStepCount);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(sequence_tests)
+RUN_TEST(sequence_signals_test)
+RUN_TEST(sequence_signals_deadline_test)
+RUN_TEST(sequence_deadline_test)
+RUN_TEST(sequence_cancel_test)
+RUN_TEST_PERFORMANCE(sequence_benchmark)
+END_TEST_CASE(sequence_tests)
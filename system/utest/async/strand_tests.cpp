@@ -0,0 +1,157 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <async/cpp/loop.h>
+#include <async/strand.h>
+
+#include <fbl/atomic.h>
+#include <zircon/syscalls.h>
+#include <unittest/unittest.h>
+
+#include "async_stub.h"
+
+namespace {
+
+class MockAsync : public AsyncStub {
+public:
+    uint32_t queued = 0u;
+    zx_status_t next_status = ZX_OK;
+
+    zx_status_t QueuePacket(async_receiver_t* receiver,
+                            const zx_packet_user_t* data) override {
+        if (next_status == ZX_OK)
+            queued++;
+        return next_status;
+    }
+};
+
+// Records the order work ran in, and whether two items of one strand ever
+// ran at once.
+struct StrandState {
+    async_strand_t strand;
+    fbl::atomic<uint32_t> running{0u};
+    bool overlapped = false;
+    fbl::atomic<uint32_t> next{0u};
+    bool in_order = true;
+};
+
+struct Work {
+    async_strand_work_t work;
+    StrandState* state;
+    uint32_t index;
+    uint32_t run_count;
+};
+
+void work_handler(async_t* async, async_strand_work_t* item) {
+    Work* work = reinterpret_cast<Work*>(item);
+    StrandState* state = work->state;
+    if (state->running.fetch_add(1u) != 0u)
+        state->overlapped = true;
+    if (work->index != state->next.load())
+        state->in_order = false;
+    state->next.store(work->index + 1u);
+    work->run_count++;
+    zx_nanosleep(zx_deadline_after(ZX_USEC(10)));
+    state->running.fetch_sub(1u);
+}
+
+bool post_queues_one_packet_test() {
+    BEGIN_TEST;
+
+    MockAsync async;
+    StrandState state;
+    async_strand_init(&state.strand);
+    Work work[3] = {};
+    for (uint32_t i = 0; i < 3u; i++) {
+        work[i].work.handler = work_handler;
+        work[i].state = &state;
+        work[i].index = i;
+        EXPECT_EQ(ZX_OK, async_strand_post(&async, &state.strand, &work[i].work), "post");
+    }
+    EXPECT_EQ(1u, async.queued, "one packet for the strand");
+
+    // Cancel the middle item, then run the strand as the dispatcher would.
+    EXPECT_EQ(ZX_OK, async_strand_cancel(&state.strand, &work[1].work), "cancel");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, async_strand_cancel(&state.strand, &work[1].work), "cancel twice");
+    state.strand.receiver.handler(&async, &state.strand.receiver, ZX_OK, nullptr);
+    EXPECT_EQ(1u, work[0].run_count, "run count 0");
+    EXPECT_EQ(0u, work[1].run_count, "run count 1");
+    EXPECT_EQ(1u, work[2].run_count, "run count 2");
+
+    // Once idle, the strand needs a new packet.
+    EXPECT_EQ(ZX_OK, async_strand_post(&async, &state.strand, &work[1].work), "post again");
+    EXPECT_EQ(2u, async.queued, "second packet");
+
+    END_TEST;
+}
+
+bool post_failure_test() {
+    BEGIN_TEST;
+
+    MockAsync async;
+    async.next_status = ZX_ERR_BAD_STATE;
+    StrandState state;
+    async_strand_init(&state.strand);
+    Work work = {};
+    work.work.handler = work_handler;
+    work.state = &state;
+    EXPECT_EQ(ZX_ERR_BAD_STATE, async_strand_post(&async, &state.strand, &work.work), "post");
+    EXPECT_EQ(ZX_ERR_NOT_FOUND, async_strand_cancel(&state.strand, &work.work), "not queued");
+
+    END_TEST;
+}
+
+bool strands_run_serially_test() {
+    const size_t num_threads = 4;
+    const uint32_t num_items = 200u;
+
+    BEGIN_TEST;
+
+    async::Loop loop;
+    for (size_t i = 0; i < num_threads; i++) {
+        EXPECT_EQ(ZX_OK, loop.StartThread(), "start thread");
+    }
+
+    StrandState states[2];
+    Work work[2][num_items] = {};
+    for (auto& state : states) {
+        async_strand_init(&state.strand);
+    }
+    for (uint32_t i = 0; i < num_items; i++) {
+        for (uint32_t s = 0; s < 2u; s++) {
+            work[s][i].work.handler = work_handler;
+            work[s][i].state = &states[s];
+            work[s][i].index = i;
+            EXPECT_EQ(ZX_OK, async_strand_post(loop.async(), &states[s].strand, &work[s][i].work),
+                      "post");
+        }
+    }
+
+    // Wait for the work to drain, then stop the threads.
+    while (states[0].next.load() != num_items || states[1].next.load() != num_items) {
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+    }
+    loop.Quit();
+    loop.JoinThreads();
+
+    for (auto& state : states) {
+        EXPECT_FALSE(state.overlapped, "work on one strand ran one at a time");
+        EXPECT_TRUE(state.in_order, "work on one strand ran in order");
+    }
+    for (uint32_t s = 0; s < 2u; s++) {
+        for (uint32_t i = 0; i < num_items; i++) {
+            EXPECT_EQ(1u, work[s][i].run_count, "run count");
+        }
+    }
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(strand_tests)
+RUN_TEST(post_queues_one_packet_test)
+RUN_TEST(post_failure_test)
+RUN_TEST(strands_run_serially_test)
+END_TEST_CASE(strand_tests)
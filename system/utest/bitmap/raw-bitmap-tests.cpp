@@ -5,9 +5,12 @@
 #include <bitmap/raw-bitmap.h>
 #include <bitmap/storage.h>
 
+#include <stdio.h>
+
 #include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <unittest/unittest.h>
+#include <zircon/syscalls.h>
 
 namespace bitmap {
 namespace tests {
@@ -245,6 +248,79 @@ static bool FindSimple(void) {
     END_TEST;
 }
 
+// Scans runs which start and end at every offset within a word and span
+// enough whole words to take the unrolled path.
+template <typename RawBitmap>
+static bool ScanLong(void) {
+    BEGIN_TEST;
+
+    const size_t kBits = 1024;
+    RawBitmap bitmap;
+    ASSERT_EQ(bitmap.Reset(kBits), ZX_OK);
+
+    for (size_t start = 0; start < 64; start += 7) {
+        for (size_t len = 1; start + len < kBits; len += 61) {
+            EXPECT_EQ(bitmap.Set(start, start + len), ZX_OK);
+            EXPECT_EQ(bitmap.Scan(start, kBits, true), start + len, "end of set run");
+            EXPECT_EQ(bitmap.Scan(start + len, kBits, false), kBits, "rest unset");
+            EXPECT_EQ(bitmap.Scan(0, kBits, false), start, "start of set run");
+
+            size_t bitoff_start;
+            EXPECT_EQ(bitmap.Find(true, 0, kBits, len, &bitoff_start), ZX_OK);
+            EXPECT_EQ(bitoff_start, start, "find set run");
+            EXPECT_EQ(bitmap.Find(true, 0, kBits, len + 1, &bitoff_start), ZX_ERR_NO_RESOURCES);
+            bitmap.ClearAll();
+        }
+    }
+
+    END_TEST;
+}
+
+// Times finding a free run in an empty bitmap, a full one with a single free
+// bit at the end, and one where every other bit is set, so that no two free
+// bits are adjacent until the end.
+template <typename RawBitmap>
+static bool FindBenchmark(void) {
+    BEGIN_TEST;
+
+    const size_t kBits = 1 << 16;
+    const int kIterations = 100;
+    RawBitmap bitmap;
+    ASSERT_EQ(bitmap.Reset(kBits), ZX_OK);
+
+    struct {
+        const char* name;
+        size_t run_len;
+        size_t expected;
+    } cases[] = {
+        {"empty", 1, 0},
+        {"full", 1, kBits - 1},
+        {"fragmented", 2, kBits - 2},
+    };
+    for (size_t c = 0; c < fbl::count_of(cases); ++c) {
+        if (c == 1) {
+            ASSERT_EQ(bitmap.Set(0, kBits - 1), ZX_OK);
+        } else if (c == 2) {
+            bitmap.ClearAll();
+            for (size_t i = 1; i < kBits - 2; i += 2) {
+                ASSERT_EQ(bitmap.SetOne(i), ZX_OK);
+            }
+        }
+
+        size_t bitoff_start = 0;
+        zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        for (int i = 0; i < kIterations; ++i) {
+            ASSERT_EQ(bitmap.Find(false, 0, kBits, cases[c].run_len, &bitoff_start), ZX_OK);
+        }
+        zx_time_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+        EXPECT_EQ(bitoff_start, cases[c].expected);
+        printf("\nBenchmark find in %zu bits, %s: %9.1f ns", kBits, cases[c].name,
+               static_cast<double>(elapsed) / kIterations);
+    }
+
+    END_TEST;
+}
+
 template <typename RawBitmap>
 static bool ClearAll(void) {
     BEGIN_TEST;
@@ -450,6 +526,7 @@ static bool GrowFailure(void) {
     RUN_TEMPLATIZED_TEST(GetReturnArg, specialization)      \
     RUN_TEMPLATIZED_TEST(SetRange, specialization)          \
     RUN_TEMPLATIZED_TEST(FindSimple, specialization)        \
+    RUN_TEMPLATIZED_TEST(ScanLong, specialization)          \
     RUN_TEMPLATIZED_TEST(ClearSubrange, specialization)     \
     RUN_TEMPLATIZED_TEST(BoundaryArguments, specialization) \
     RUN_TEMPLATIZED_TEST(ClearAll, specialization)          \
@@ -461,6 +538,7 @@ ALL_TESTS(RawBitmapGeneric<VmoStorage>)
 RUN_TEST(GrowAcrossPage<RawBitmapGeneric<VmoStorage>>)
 RUN_TEST(GrowShrink<RawBitmapGeneric<VmoStorage>>)
 RUN_TEST(GrowFailure<RawBitmapGeneric<DefaultStorage>>)
+RUN_TEST_PERFORMANCE(FindBenchmark<RawBitmapGeneric<DefaultStorage>>)
 END_TEST_CASE(raw_bitmap_tests);
 
 } // namespace tests
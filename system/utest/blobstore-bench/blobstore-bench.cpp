@@ -65,7 +65,11 @@ static int GetStartTime() {
 
 // Creates, writes, reads (to verify) and operates on a blob.
 // Returns the result of the post-processing 'func' (true == success).
-static bool GenerateBlob(fbl::unique_ptr<blob_info_t>* out, size_t blob_size) {
+//
+// Compressible blobs repeat every other 16 byte run of random data, which
+// roughly halves their size under LZ4.
+static bool GenerateBlob(fbl::unique_ptr<blob_info_t>* out, size_t blob_size,
+                         bool compressible) {
     // Generate a Blob of random data
     fbl::AllocChecker ac;
     fbl::unique_ptr<blob_info_t> info(new (&ac) blob_info_t);
@@ -74,7 +78,11 @@ static bool GenerateBlob(fbl::unique_ptr<blob_info_t>* out, size_t blob_size) {
     EXPECT_EQ(ac.check(), true);
     unsigned int seed = static_cast<unsigned int>(zx_ticks_get());
     for (size_t i = 0; i < blob_size; i++) {
-        info->data[i] = (char)rand_r(&seed);
+        if (compressible && (i / 16) % 2) {
+            info->data[i] = info->data[i - 16];
+        } else {
+            info->data[i] = (char)rand_r(&seed);
+        }
     }
     info->size_data = blob_size;
 
@@ -119,7 +127,9 @@ static inline int StreamAll(T func, int fd, U* buf, size_t max) {
 }
 
 
-TestData::TestData(size_t blob_size, size_t blob_count, traversal_order_t order) : blob_size(blob_size), blob_count(blob_count), order(order) {
+TestData::TestData(size_t blob_size, size_t blob_count, traversal_order_t order,
+                   bool compressible) : blob_size(blob_size), blob_count(blob_count),
+                                        order(order), compressible(compressible) {
     indices = new size_t[blob_count];
     samples = new zx_time_t*[NAME_COUNT];
     paths = new char*[blob_count];
@@ -236,6 +246,9 @@ void TestData::get_name_str(test_name_t name, char* name_str) {
     case UNLINK:
         strcpy(name_str, "unlink");
         break;
+    case FIRST_BYTE:
+        strcpy(name_str, "firstbyte");
+        break;
     default:
         strcpy(name_str, "unknown");
         break;
@@ -330,7 +343,7 @@ bool TestData::report_test(test_name_t name) {
 
     ASSERT_NONNULL(results, "Failed to open results file");
 
-    fprintf(results, "%lu,%lu,%s,%s,%s,%f,%f,%f,%f,%f,%lu\n", blob_size, blob_count, start_time, test_name, test_order, avg, min, max, stddev, outlier, outlier_count);
+    fprintf(results, "%lu,%lu,%s,%s,%s,%f,%f,%f,%f,%f,%lu,%s\n", blob_size, blob_count, start_time, test_name, test_order, avg, min, max, stddev, outlier, outlier_count, compressible ? "compressible" : "random");
     fclose(results);
 
     test_name[0] = '\0';
@@ -347,7 +360,7 @@ bool TestData::create_blobs() {
         record |= (order == LAST && i >= blob_count - END_COUNT);
 
         fbl::unique_ptr<blob_info_t> info;
-        ASSERT_TRUE(GenerateBlob(&info, blob_size));
+        ASSERT_TRUE(GenerateBlob(&info, blob_size, compressible));
         strcpy(paths[i], info->path);
 
         // create
@@ -392,6 +405,11 @@ bool TestData::read_blobs() {
         sample_end(start, OPEN, i);
         ASSERT_GT(fd, 0, "Failed to open blob");
 
+        // first byte, timed from the start of the open
+        char first;
+        ASSERT_EQ(pread(fd, &first, 1, 0), 1, "Failed to read first byte");
+        sample_end(start, FIRST_BYTE, i);
+
         fbl::AllocChecker ac;
         fbl::unique_ptr<char[]> buf(new (&ac) char[blob_size]);
         EXPECT_EQ(ac.check(), true);
@@ -411,6 +429,7 @@ bool TestData::read_blobs() {
     }
 
     ASSERT_TRUE(report_test(OPEN));
+    ASSERT_TRUE(report_test(FIRST_BYTE));
     ASSERT_TRUE(report_test(READ));
     ASSERT_TRUE(report_test(CLOSE));
     return true;
@@ -479,6 +498,46 @@ static bool benchmark_blob_basic() {
     END_TEST;
 }
 
+// Compare against benchmark_blob_basic with blobstore mounted with and
+// without --compress to see the cost and benefit of compression.
+template <size_t BlobSize, size_t BlobCount, traversal_order_t Order>
+static bool benchmark_blob_compressible() {
+    BEGIN_TEST;
+    ASSERT_TRUE(StartBlobstoreBenchmark(BlobSize, BlobCount, Order));
+    TestData data(BlobSize, BlobCount, Order, true);
+    bool success = data.run_tests();
+    ASSERT_TRUE(EndBlobstoreBenchmark()); //clean up
+    ASSERT_TRUE(success);
+    END_TEST;
+}
+
+// Reports the rate at which the data of large blobs is written, from the first
+// byte handed to blobstore until the last write returns with the blob
+// readable, so that hashing and device writes are both counted.
+template <size_t BlobSize, size_t BlobCount>
+static bool benchmark_blob_write_throughput() {
+    BEGIN_TEST;
+    ASSERT_TRUE(StartBlobstoreBenchmark(BlobSize, BlobCount, DEFAULT));
+    zx_time_t total = 0;
+    for (size_t i = 0; i < BlobCount; i++) {
+        fbl::unique_ptr<blob_info_t> info;
+        ASSERT_TRUE(GenerateBlob(&info, BlobSize, false));
+        int fd = open(info->path, O_CREAT | O_RDWR);
+        ASSERT_GT(fd, 0, "Failed to create blob");
+        ASSERT_EQ(ftruncate(fd, BlobSize), 0, "Failed to truncate blob");
+
+        zx_time_t start = zx_ticks_get();
+        ASSERT_EQ(StreamAll(write, fd, info->data.get(), BlobSize), 0, "Failed to write Data");
+        total += zx_ticks_get() - start;
+        ASSERT_EQ(close(fd), 0, "Failed to close blob");
+    }
+
+    double secs = static_cast<double>(total) / static_cast<double>(zx_ticks_per_second());
+    printf("\nBenchmark %10s: [%4lu] blobs of [%4lu] MB, [%8.2f] MB/s", "writerate",
+           BlobCount, BlobSize / MB, static_cast<double>(BlobSize * BlobCount / MB) / secs);
+    ASSERT_TRUE(EndBlobstoreBenchmark()); //clean up
+    END_TEST;
+}
 
 BEGIN_TEST_CASE(blobstore_benchmarks)
 
@@ -505,6 +564,13 @@ RUN_FOR_ALL_ORDER(benchmark_blob_basic, 512 * KB, 10000);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, MB, 500);
 RUN_FOR_ALL_ORDER(benchmark_blob_basic, MB, 1000);
 
+RUN_FOR_ALL_ORDER(benchmark_blob_compressible, 128 * KB, 500);
+RUN_FOR_ALL_ORDER(benchmark_blob_compressible, 512 * KB, 500);
+RUN_FOR_ALL_ORDER(benchmark_blob_compressible, MB, 500);
+
+RUN_TEST_PERFORMANCE((benchmark_blob_write_throughput<16 * MB, 10>))
+RUN_TEST_PERFORMANCE((benchmark_blob_write_throughput<64 * MB, 4>))
+
 END_TEST_CASE(blobstore_benchmarks)
 
 int main(int argc, char** argv) {
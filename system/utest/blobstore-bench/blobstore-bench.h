@@ -25,6 +25,7 @@ typedef enum {
     READ, // read data from blob
     CLOSE, // close blob fd
     UNLINK, // unlink blob
+    FIRST_BYTE, // open blob and read its first byte
     NAME_COUNT // number of name options
 } test_name_t;
 
@@ -39,7 +40,8 @@ typedef struct blob_info {
 
 class TestData {
 public:
-    TestData(size_t blob_size, size_t blob_count, traversal_order_t order);
+    TestData(size_t blob_size, size_t blob_count, traversal_order_t order,
+             bool compressible = false);
     ~TestData();
     bool run_tests();
 private:
@@ -63,6 +65,7 @@ private:
     size_t blob_size;
     size_t blob_count;
     traversal_order_t order;
+    bool compressible;
     size_t* indices;
     zx_time_t** samples;
     char** paths;
@@ -676,6 +676,127 @@ static bool ReadTooLarge(void) {
     END_TEST;
 }
 
+// Writes a manifest for |infos| followed by their data into a new VMO, as
+// expected by IOCTL_VFS_INSTALL_BATCH.
+static bool MakeInstallBatch(fbl::unique_ptr<blob_info_t>* infos, size_t count,
+                             zx_handle_t* out) {
+    const size_t manifest_size = count * sizeof(vfs_install_entry_t);
+    size_t size = manifest_size;
+    for (size_t i = 0; i < count; i++) {
+        size += infos[i]->size_data;
+    }
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(size, 0, &vmo), ZX_OK);
+
+    uint64_t offset = manifest_size;
+    for (size_t i = 0; i < count; i++) {
+        vfs_install_entry_t entry;
+        Digest digest;
+        const char* name = infos[i]->path + strlen(MOUNT_PATH "/");
+        ASSERT_EQ(digest.Parse(name, strlen(name)), ZX_OK);
+        ASSERT_EQ(digest.CopyTo(entry.digest, sizeof(entry.digest)), ZX_OK);
+        entry.offset = offset;
+        entry.size = infos[i]->size_data;
+
+        size_t actual;
+        ASSERT_EQ(zx_vmo_write(vmo, &entry, i * sizeof(entry), sizeof(entry), &actual), ZX_OK);
+        ASSERT_EQ(zx_vmo_write(vmo, infos[i]->data.get(), offset, entry.size, &actual), ZX_OK);
+        offset += entry.size;
+    }
+    *out = vmo;
+    return true;
+}
+
+template <fs_test_type_t TestType>
+static bool InstallBatch(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    constexpr size_t kBlobCount = 16;
+    fbl::unique_ptr<blob_info_t> infos[kBlobCount];
+    for (size_t i = 0; i < kBlobCount; i++) {
+        ASSERT_TRUE(GenerateBlob(1 << (i + 4), &infos[i]));
+    }
+
+    // One blob of the batch is already present, and is left alone.
+    int fd;
+    ASSERT_TRUE(MakeBlob(infos[3]->path, infos[3]->merkle.get(), infos[3]->size_merkle,
+                         infos[3]->data.get(), infos[3]->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+
+    int dirfd = open(MOUNT_PATH, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(dirfd, 0);
+    vfs_install_batch_t batch;
+    ASSERT_TRUE(MakeInstallBatch(infos, kBlobCount, &batch.vmo));
+    batch.count = kBlobCount;
+    ASSERT_EQ(ioctl_vfs_install_batch(dirfd, &batch), ZX_OK);
+
+    for (size_t i = 0; i < kBlobCount; i++) {
+        fd = open(infos[i]->path, O_RDONLY);
+        ASSERT_GT(fd, 0, "Failed to open installed blob");
+        ASSERT_TRUE(VerifyContents(fd, infos[i]->data.get(), infos[i]->size_data));
+        ASSERT_EQ(close(fd), 0);
+        ASSERT_EQ(unlink(infos[i]->path), 0);
+    }
+
+    // If any blob of a batch fails to verify, none of them are installed.
+    for (size_t i = 0; i < kBlobCount; i++) {
+        ASSERT_TRUE(GenerateBlob(1 << (i + 4), &infos[i]));
+    }
+    infos[kBlobCount - 1]->data[0] ^= 1;
+    ASSERT_TRUE(MakeInstallBatch(infos, kBlobCount, &batch.vmo));
+    ASSERT_LT(ioctl_vfs_install_batch(dirfd, &batch), 0);
+    for (size_t i = 0; i < kBlobCount; i++) {
+        ASSERT_LT(open(infos[i]->path, O_RDONLY), 0, "Blob of a failed batch exists");
+    }
+    ASSERT_EQ(close(dirfd), 0);
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
+template <fs_test_type_t TestType>
+static bool CachedBlobs(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob(1 << 17, &info));
+    int fd;
+    ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                         info->data.get(), info->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+
+    int dirfd = open(MOUNT_PATH, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(dirfd, 0);
+    vfs_blob_cache_info_t before;
+    ASSERT_EQ(ioctl_vfs_query_blob_cache(dirfd, &before), sizeof(before));
+
+    // Reopening a recently closed blob finds its contents still in memory.
+    for (size_t i = 0; i < 3; i++) {
+        fd = open(info->path, O_RDONLY);
+        ASSERT_GT(fd, 0, "Failed to reopen blob");
+        ASSERT_TRUE(VerifyContents(fd, info->data.get(), info->size_data));
+        ASSERT_EQ(close(fd), 0);
+    }
+    vfs_blob_cache_info_t after;
+    ASSERT_EQ(ioctl_vfs_query_blob_cache(dirfd, &after), sizeof(after));
+    ASSERT_EQ(after.hits - before.hits, 3);
+    ASSERT_EQ(after.entries, 1);
+    ASSERT_LE(after.bytes, after.capacity);
+
+    // An unlinked blob is not kept.
+    ASSERT_EQ(unlink(info->path), 0);
+    ASSERT_EQ(ioctl_vfs_query_blob_cache(dirfd, &after), sizeof(after));
+    ASSERT_EQ(after.entries, 0);
+    ASSERT_EQ(close(dirfd), 0);
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
 template <fs_test_type_t TestType>
 static bool BadAllocation(void) {
     BEGIN_TEST;
@@ -1150,6 +1271,64 @@ static bool NoSpace(void) {
     END_TEST;
 }
 
+template <fs_test_type_t TestType>
+static bool FragmentedWrite(void) {
+    BEGIN_TEST;
+    test_info_t test_info;
+    ASSERT_EQ(StartBlobstoreTest<TestType>(&test_info), 0, "Mounting Blobstore");
+
+    // Fill up the blobstore, then unlink every other blob, so that no free
+    // extent is larger than one of them.
+    constexpr size_t kFillSize = 1 << 20;
+    fbl::DoublyLinkedList<fbl::unique_ptr<blob_state_t>> blobs;
+    for (;;) {
+        fbl::unique_ptr<blob_info_t> info;
+        ASSERT_TRUE(GenerateBlob(kFillSize, &info));
+        int fd = open(info->path, O_CREAT | O_RDWR);
+        ASSERT_GT(fd, 0, "Failed to create blob");
+        if (ftruncate(fd, info->size_data) < 0) {
+            ASSERT_EQ(errno, ENOSPC, "Blobstore expected to run out of space");
+            ASSERT_EQ(close(fd), 0);
+            ASSERT_EQ(unlink(info->path), 0);
+            break;
+        }
+        ASSERT_EQ(StreamAll(write, fd, info->data.get(), info->size_data), 0,
+                  "Failed to write Data");
+        ASSERT_EQ(close(fd), 0);
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<blob_state_t> state(new (&ac) blob_state_t(fbl::move(info)));
+        ASSERT_EQ(ac.check(), true);
+        blobs.push_back(fbl::move(state));
+    }
+    ASSERT_GE(blobs.size_slow(), 8);
+    bool unlink_blob = true;
+    for (auto& state : blobs) {
+        if (unlink_blob) {
+            ASSERT_EQ(unlink(state.info->path), 0);
+        }
+        unlink_blob = !unlink_blob;
+    }
+
+    // A blob larger than any free extent is still written, split over many.
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateBlob(3 * kFillSize, &info));
+    int fd;
+    ASSERT_TRUE(MakeBlob(info->path, info->merkle.get(), info->size_merkle,
+                         info->data.get(), info->size_data, &fd));
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(umount(MOUNT_PATH), ZX_OK, "Could not unmount blobstore");
+    ASSERT_EQ(MountBlobstore(test_info.ramdisk_path), 0, "Could not re-mount blobstore");
+    fd = open(info->path, O_RDONLY);
+    ASSERT_GT(fd, 0, "Failed to open fragmented blob");
+    ASSERT_TRUE(VerifyContents(fd, info->data.get(), info->size_data));
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink(info->path), 0);
+
+    ASSERT_EQ(EndBlobstoreTest<TestType>(&test_info), 0, "unmounting blobstore");
+    END_TEST;
+}
+
 static bool check_not_readable(int fd) {
     struct pollfd fds;
     fds.fd = fd;
@@ -1603,6 +1782,8 @@ RUN_TEST_MEDIUM(TestQueryInfo<FS_TEST_FVM>)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, UseAfterUnlink)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, WriteAfterRead)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, ReadTooLarge)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, InstallBatch)
+RUN_TEST_FOR_ALL_TYPES(MEDIUM, CachedBlobs)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, BadAllocation)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, CorruptedBlob)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, CorruptedDigest)
@@ -1617,6 +1798,7 @@ RUN_TEST_FOR_ALL_TYPES(MEDIUM, RootDirectory)
 RUN_TEST_FOR_ALL_TYPES(LARGE, CreateUmountRemountLargeMultithreaded)
 RUN_TEST_FOR_ALL_TYPES(LARGE, CreateUmountRemountLarge)
 RUN_TEST_FOR_ALL_TYPES(LARGE, NoSpace)
+RUN_TEST_FOR_ALL_TYPES(LARGE, FragmentedWrite)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, QueryDevicePath)
 RUN_TEST_FOR_ALL_TYPES(MEDIUM, TestReadOnly)
 RUN_TEST_MEDIUM(ResizePartition<FS_TEST_FVM>)
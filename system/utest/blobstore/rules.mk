@@ -21,7 +21,9 @@ MODULE_STATIC_LIBS := \
     system/ulib/zxcpp \
     system/ulib/fbl \
     system/ulib/blobstore \
+    system/ulib/region-alloc \
     third_party/ulib/uboringssl \
+    third_party/ulib/lz4 \
 
 MODULE_LIBS := \
     system/ulib/fdio \
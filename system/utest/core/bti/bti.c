@@ -0,0 +1,119 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/iommu.h>
+#include <zircon/syscalls/object.h>
+
+extern zx_handle_t get_root_resource(void);
+
+#define PAGE_COUNT 4
+
+static bool create_bti(zx_handle_t* iommu, zx_handle_t* bti) {
+    BEGIN_HELPER;
+
+    zx_iommu_desc_dummy_t desc;
+    ASSERT_EQ(zx_iommu_create(get_root_resource(), ZX_IOMMU_TYPE_DUMMY, &desc, sizeof(desc),
+                              iommu), ZX_OK, "");
+    ASSERT_EQ(zx_bti_create(*iommu, 0, 0, bti), ZX_OK, "");
+
+    END_HELPER;
+}
+
+static bool get_bti_info(zx_handle_t bti, zx_info_bti_t* info) {
+    BEGIN_HELPER;
+    ASSERT_EQ(zx_object_get_info(bti, ZX_INFO_BTI, info, sizeof(*info), NULL, NULL),
+              ZX_OK, "");
+    END_HELPER;
+}
+
+static bool bti_pin_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t iommu, bti, vmo;
+    ASSERT_TRUE(create_bti(&iommu, &bti), "");
+    ASSERT_EQ(zx_vmo_create(PAGE_COUNT * ZX_PAGE_SIZE, 0, &vmo), ZX_OK, "");
+
+    zx_paddr_t addrs[PAGE_COUNT];
+    EXPECT_EQ(zx_bti_pin(bti, 0, vmo, 0, sizeof(addrs) / sizeof(addrs[0]) * ZX_PAGE_SIZE,
+                         addrs, PAGE_COUNT), ZX_ERR_INVALID_ARGS, "no permissions");
+    EXPECT_EQ(zx_bti_pin(bti, ZX_BTI_PERM_READ, vmo, 0, PAGE_COUNT * ZX_PAGE_SIZE,
+                         addrs, PAGE_COUNT - 1), ZX_ERR_INVALID_ARGS, "addrs too short");
+    EXPECT_EQ(zx_bti_pin(bti, ZX_BTI_PERM_READ, vmo, 1, ZX_PAGE_SIZE, addrs, 1),
+              ZX_ERR_INVALID_ARGS, "unaligned");
+
+    ASSERT_EQ(zx_bti_pin(bti, ZX_BTI_PERM_READ | ZX_BTI_PERM_WRITE, vmo, 0,
+                         PAGE_COUNT * ZX_PAGE_SIZE, addrs, PAGE_COUNT), ZX_OK, "");
+    for (int i = 0; i < PAGE_COUNT; i++) {
+        EXPECT_NE(addrs[i], 0u, "");
+    }
+
+    // Pinned pages stay put.
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, ZX_PAGE_SIZE, NULL, 0),
+              ZX_ERR_BAD_STATE, "");
+
+    // A second pin of the range shares the first.
+    zx_paddr_t again[PAGE_COUNT];
+    ASSERT_EQ(zx_bti_pin(bti, ZX_BTI_PERM_READ | ZX_BTI_PERM_WRITE, vmo, 0,
+                         PAGE_COUNT * ZX_PAGE_SIZE, again, PAGE_COUNT), ZX_OK, "");
+    EXPECT_BYTES_EQ((const uint8_t*)again, (const uint8_t*)addrs, sizeof(addrs), "");
+    zx_info_bti_t info;
+    ASSERT_TRUE(get_bti_info(bti, &info), "");
+    EXPECT_EQ(info.pinned, 1u, "");
+
+    EXPECT_EQ(zx_bti_unpin(bti, addrs[0], ZX_PAGE_SIZE), ZX_ERR_INVALID_ARGS, "wrong size");
+    EXPECT_EQ(zx_bti_unpin(bti, addrs[0], PAGE_COUNT * ZX_PAGE_SIZE), ZX_OK, "");
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, ZX_PAGE_SIZE, NULL, 0),
+              ZX_ERR_BAD_STATE, "still pinned once");
+    EXPECT_EQ(zx_bti_unpin(bti, addrs[0], PAGE_COUNT * ZX_PAGE_SIZE), ZX_OK, "");
+    EXPECT_EQ(zx_bti_unpin(bti, addrs[0], PAGE_COUNT * ZX_PAGE_SIZE), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, ZX_PAGE_SIZE, NULL, 0), ZX_OK, "");
+
+    // Closing the BTI gives up whatever is still pinned.
+    ASSERT_EQ(zx_bti_pin(bti, ZX_BTI_PERM_READ, vmo, 0, ZX_PAGE_SIZE, addrs, 1), ZX_OK, "");
+    zx_handle_close(bti);
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, ZX_PAGE_SIZE, NULL, 0), ZX_OK, "");
+
+    zx_handle_close(vmo);
+    zx_handle_close(iommu);
+    END_TEST;
+}
+
+static bool bti_cache_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t iommu, bti, vmo;
+    ASSERT_TRUE(create_bti(&iommu, &bti), "");
+    ASSERT_EQ(zx_vmo_create(PAGE_COUNT * ZX_PAGE_SIZE, 0, &vmo), ZX_OK, "");
+
+    const uint32_t options = ZX_BTI_PERM_READ | ZX_BTI_CACHE;
+    zx_paddr_t addrs[PAGE_COUNT];
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(zx_bti_pin(bti, options, vmo, 0, PAGE_COUNT * ZX_PAGE_SIZE,
+                             addrs, PAGE_COUNT), ZX_OK, "");
+        ASSERT_EQ(zx_bti_unpin(bti, addrs[0], PAGE_COUNT * ZX_PAGE_SIZE), ZX_OK, "");
+    }
+
+    zx_info_bti_t info;
+    ASSERT_TRUE(get_bti_info(bti, &info), "");
+    EXPECT_EQ(info.pinned, 0u, "");
+    EXPECT_EQ(info.cached, 1u, "");
+    EXPECT_EQ(info.cache_hits, 2u, "");
+
+    // A cached range is still pinned.
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, ZX_PAGE_SIZE, NULL, 0),
+              ZX_ERR_BAD_STATE, "");
+    zx_handle_close(bti);
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DECOMMIT, 0, ZX_PAGE_SIZE, NULL, 0), ZX_OK, "");
+
+    zx_handle_close(vmo);
+    zx_handle_close(iommu);
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(bti_tests)
+RUN_TEST(bti_pin_test);
+RUN_TEST(bti_cache_test);
+END_TEST_CASE(bti_tests)
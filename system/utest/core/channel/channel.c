@@ -932,6 +932,70 @@ static bool channel_read_etc(void) {
     END_TEST;
 }
 
+static bool channel_read_write_many(void) {
+    BEGIN_TEST;
+
+    zx_handle_t channel[2];
+    ASSERT_EQ(zx_channel_create(0, &channel[0], &channel[1]), ZX_OK, "");
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK, "");
+
+    uint32_t data[3] = {1u, 2u, 3u};
+    zx_channel_msg_t out[3] = {
+        {&data[0], NULL, sizeof(uint32_t), 0u},
+        {&data[1], &event, sizeof(uint32_t), 1u},
+        {&data[2], NULL, sizeof(uint32_t), 0u},
+    };
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, out, 3u), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(event), ZX_ERR_BAD_HANDLE, "handle should have been sent");
+
+    // A batch that contains a bad handle writes nothing and keeps the good ones.
+    zx_handle_t event2;
+    ASSERT_EQ(zx_event_create(0u, &event2), ZX_OK, "");
+    zx_handle_t bad = ZX_HANDLE_INVALID;
+    zx_channel_msg_t bad_out[2] = {
+        {&data[0], &event2, sizeof(uint32_t), 1u},
+        {&data[1], &bad, sizeof(uint32_t), 1u},
+    };
+    EXPECT_EQ(zx_channel_write_many(channel[0], 0u, bad_out, 2u), ZX_ERR_BAD_HANDLE, "");
+    EXPECT_EQ(zx_object_signal(event2, 0u, ZX_USER_SIGNAL_0), ZX_OK, "handle should be back");
+    EXPECT_EQ(zx_handle_close(event2), ZX_OK, "");
+
+    // The second slot is too small for a handle, so only one message is read.
+    uint32_t recv[3] = {};
+    zx_handle_t recv_handle = ZX_HANDLE_INVALID;
+    zx_channel_msg_t in[3] = {
+        {&recv[0], NULL, sizeof(uint32_t), 0u},
+        {&recv[1], NULL, sizeof(uint32_t), 0u},
+        {&recv[2], NULL, sizeof(uint32_t), 0u},
+    };
+    uint32_t actual = 0u;
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, in, 3u, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 1u, "");
+    EXPECT_EQ(recv[0], 1u, "");
+
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, &in[1], 2u, &actual), ZX_ERR_BUFFER_TOO_SMALL, "");
+    EXPECT_EQ(in[1].num_bytes, sizeof(uint32_t), "");
+    EXPECT_EQ(in[1].num_handles, 1u, "");
+
+    in[1].handles = &recv_handle;
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, &in[1], 2u, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 2u, "");
+    EXPECT_EQ(recv[1], 2u, "");
+    EXPECT_EQ(recv[2], 3u, "");
+    EXPECT_EQ(in[1].num_handles, 1u, "");
+    EXPECT_EQ(in[2].num_handles, 0u, "");
+    EXPECT_EQ(zx_handle_close(recv_handle), ZX_OK, "");
+
+    EXPECT_EQ(zx_channel_read_many(channel[1], 0u, in, 3u, &actual), ZX_ERR_SHOULD_WAIT, "");
+
+    EXPECT_EQ(zx_handle_close(channel[0]), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(channel[1]), ZX_OK, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(channel_tests)
 RUN_TEST(channel_test)
 RUN_TEST(channel_read_error_test)
@@ -946,6 +1010,7 @@ RUN_TEST(bad_channel_call_finish)
 RUN_TEST(channel_nest)
 RUN_TEST(channel_disallow_write_to_self)
 RUN_TEST(channel_read_etc)
+RUN_TEST(channel_read_write_many)
 END_TEST_CASE(channel_tests)
 
 #ifndef BUILD_COMBINED_TESTS
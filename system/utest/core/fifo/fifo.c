@@ -3,12 +3,14 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <threads.h>
 #include <unistd.h>
 
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <unittest/unittest.h>
 
@@ -118,8 +120,71 @@ static bool options_test(void) {
     END_TEST;
 }
 
+static bool shared_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t a, b, vmo;
+    uint64_t n[4] = { 1, 2, 3, 4 };
+    uint32_t actual;
+
+    // plain fifos have no shared rings
+    ASSERT_EQ(zx_fifo_create(4, 8, 0, &a, &b), ZX_OK, "");
+    EXPECT_EQ(zx_fifo_shared_vmo(a, ZX_FIFO_SHARED_READ, &vmo), ZX_ERR_NOT_SUPPORTED, "");
+    zx_handle_close(a);
+    zx_handle_close(b);
+
+    ASSERT_EQ(zx_fifo_create(4, 8, ZX_FIFO_SHARED, &a, &b), ZX_OK, "");
+    EXPECT_EQ(zx_fifo_shared_vmo(a, 2u, &vmo), ZX_ERR_INVALID_ARGS, "");
+
+    // map the ring a writes to
+    ASSERT_EQ(zx_fifo_shared_vmo(a, ZX_FIFO_SHARED_WRITE, &vmo), ZX_OK, "");
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, 2 * PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr), ZX_OK, "");
+    zx_fifo_shared_header_t* hdr = (zx_fifo_shared_header_t*)addr;
+    uint64_t* ring = (uint64_t*)(addr + hdr->data_offset);
+    EXPECT_EQ(hdr->elem_count, 4u, "");
+    EXPECT_EQ(hdr->elem_size, 8u, "");
+
+    // a syscall write shows up in the mapping
+    ASSERT_EQ(zx_fifo_write(a, n, sizeof(n[0]), &actual), ZX_OK, "");
+    EXPECT_EQ(hdr->head, 1u, "");
+    EXPECT_EQ(ring[0], 1u, "");
+
+    // enqueue through the mapping and tell the kernel
+    ring[1] = 2;
+    ring[2] = 3;
+    __atomic_store_n(&hdr->head, 3u, __ATOMIC_RELEASE);
+    ASSERT_EQ(zx_fifo_write(a, NULL, 0, &actual), ZX_OK, "");
+    EXPECT_EQ(actual, 0u, "");
+    EXPECT_SIGNALS(b, ZX_FIFO_READABLE | ZX_FIFO_WRITABLE);
+
+    // fill it, then drain through the mapping
+    ASSERT_EQ(zx_fifo_write(a, n + 3, sizeof(n[0]), &actual), ZX_OK, "");
+    EXPECT_SIGNALS(a, 0u);
+    EXPECT_EQ(ring[3], 4u, "");
+    __atomic_store_n(&hdr->tail, 4u, __ATOMIC_RELEASE);
+    ASSERT_EQ(zx_fifo_read(b, NULL, 0, &actual), ZX_OK, "");
+    EXPECT_SIGNALS(a, ZX_FIFO_WRITABLE);
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE);
+
+    // the kernel refuses to work on a corrupted ring
+    __atomic_store_n(&hdr->head, 100u, __ATOMIC_RELEASE);
+    EXPECT_EQ(zx_fifo_read(b, n, sizeof(n), &actual), ZX_ERR_BAD_STATE, "");
+    EXPECT_EQ(zx_fifo_write(a, n, sizeof(n), &actual), ZX_ERR_BAD_STATE, "");
+
+    zx_vmar_unmap(zx_vmar_root_self(), addr, 2 * PAGE_SIZE);
+    zx_handle_close(vmo);
+    zx_handle_close(a);
+    zx_handle_close(b);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(fifo_tests)
 RUN_TEST(basic_test)
+RUN_TEST(options_test)
+RUN_TEST(shared_test)
 END_TEST_CASE(fifo_tests)
 
 #ifndef BUILD_COMBINED_TESTS
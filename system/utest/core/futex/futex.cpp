@@ -4,6 +4,8 @@
 
 #include <inttypes.h>
 #include <limits.h>
+#include <pthread.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/threads.h>
 #include <unittest/unittest.h>
@@ -526,6 +528,138 @@ static bool test_event_signaling() {
     END_TEST;
 }
 
+static int owner_thread(void* arg) {
+    // Park until the test is done naming this thread as an owner.
+    volatile int* futex_value = (volatile int*)arg;
+    while (*futex_value != 0) {
+        zx_futex_wait((zx_futex_t*)futex_value, *futex_value, ZX_TIME_INFINITE);
+    }
+    return 0;
+}
+
+static bool test_futex_wait_owned() {
+    BEGIN_TEST;
+    volatile int futex_value = 1;
+
+    // A thread cannot wait behind itself, and the owner must be a thread.
+    EXPECT_EQ(zx_futex_wait_owned((zx_futex_t*)&futex_value, 1, zx_thread_self(), 0),
+              ZX_ERR_INVALID_ARGS);
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0u, &event), ZX_OK);
+    EXPECT_EQ(zx_futex_wait_owned((zx_futex_t*)&futex_value, 1, event, 0),
+              ZX_ERR_WRONG_TYPE);
+    zx_handle_close(event);
+
+    // An invalid owner handle is an ordinary wait.
+    EXPECT_EQ(zx_futex_wait_owned((zx_futex_t*)&futex_value, 1, ZX_HANDLE_INVALID, 0),
+              ZX_ERR_TIMED_OUT);
+
+    thrd_t thread;
+    ASSERT_EQ(thrd_create_with_name(&thread, owner_thread, (void*)&futex_value,
+                                    "owner"), thrd_success);
+    zx_handle_t owner = thrd_get_zx_handle(thread);
+    EXPECT_EQ(zx_futex_wait_owned((zx_futex_t*)&futex_value, 2, owner, ZX_TIME_INFINITE),
+              ZX_ERR_BAD_STATE);
+    EXPECT_EQ(zx_futex_wait_owned((zx_futex_t*)&futex_value, 1, owner,
+                                  zx_deadline_after(ZX_MSEC(10))),
+              ZX_ERR_TIMED_OUT);
+
+    futex_value = 0;
+    ASSERT_EQ(zx_futex_wake((zx_futex_t*)&futex_value, UINT32_MAX), ZX_OK);
+    ASSERT_EQ(thrd_join(thread, NULL), thrd_success);
+    END_TEST;
+}
+
+static pthread_mutex_t pi_mutex;
+static volatile int pi_mutex_counter;
+
+static void* pi_mutex_thread(void* arg) {
+    for (int i = 0; i < 1000; ++i) {
+        pthread_mutex_lock(&pi_mutex);
+        pi_mutex_counter = pi_mutex_counter + 1;
+        pthread_mutex_unlock(&pi_mutex);
+    }
+    return NULL;
+}
+
+static bool test_pthread_mutex_prio_inherit() {
+    BEGIN_TEST;
+    pthread_mutexattr_t attr;
+    ASSERT_EQ(pthread_mutexattr_init(&attr), 0);
+    int protocol = -1;
+    ASSERT_EQ(pthread_mutexattr_getprotocol(&attr, &protocol), 0);
+    EXPECT_EQ(protocol, PTHREAD_PRIO_NONE);
+    ASSERT_EQ(pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT), 0);
+    ASSERT_EQ(pthread_mutexattr_getprotocol(&attr, &protocol), 0);
+    EXPECT_EQ(protocol, PTHREAD_PRIO_INHERIT);
+    EXPECT_EQ(pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_PROTECT), ENOTSUP);
+    ASSERT_EQ(pthread_mutex_init(&pi_mutex, &attr), 0);
+
+    // Contend on the mutex so that waiters go through zx_futex_wait_owned().
+    pi_mutex_counter = 0;
+    pthread_t threads[4];
+    for (size_t i = 0; i < countof(threads); ++i) {
+        ASSERT_EQ(pthread_create(&threads[i], NULL, pi_mutex_thread, NULL), 0);
+    }
+    for (size_t i = 0; i < countof(threads); ++i) {
+        ASSERT_EQ(pthread_join(threads[i], NULL), 0);
+    }
+    EXPECT_EQ(pi_mutex_counter, 4000);
+
+    ASSERT_EQ(pthread_mutex_destroy(&pi_mutex), 0);
+    ASSERT_EQ(pthread_mutexattr_destroy(&attr), 0);
+    END_TEST;
+}
+
+// Contention benchmark: pairs of threads ping-pong on their own futexes.
+// No two pairs share a futex, so with a sharded futex table the pairs
+// should mostly proceed independently; the elapsed time is logged for
+// comparison across kernels.
+static constexpr int kContentionPairs = 8;
+static constexpr int kContentionRounds = 2000;
+
+struct PingPong {
+    volatile int turn;
+};
+
+static PingPong ping_pongs[kContentionPairs];
+
+static int ping_pong_thread(void* arg) {
+    PingPong* pp = &ping_pongs[(uintptr_t)arg / 2];
+    int self = (int)((uintptr_t)arg % 2);
+    for (int i = 0; i < kContentionRounds; ++i) {
+        while (pp->turn != self) {
+            zx_futex_wait((zx_futex_t*)&pp->turn, !self, ZX_TIME_INFINITE);
+        }
+        pp->turn = !self;
+        zx_futex_wake((zx_futex_t*)&pp->turn, 1);
+    }
+    return 0;
+}
+
+static bool test_futex_contention() {
+    BEGIN_TEST;
+    thrd_t threads[kContentionPairs * 2];
+    memset(ping_pongs, 0, sizeof(ping_pongs));
+
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (uintptr_t i = 0; i < countof(threads); ++i) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], ping_pong_thread, (void*)i,
+                                        "ping pong"), thrd_success);
+    }
+    for (size_t i = 0; i < countof(threads); ++i) {
+        ASSERT_EQ(thrd_join(threads[i], NULL), thrd_success);
+    }
+    zx_time_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+
+    for (int i = 0; i < kContentionPairs; ++i) {
+        EXPECT_EQ(ping_pongs[i].turn, 0);
+    }
+    unittest_printf("%d futex pairs x %d rounds: %" PRIu64 " us\n",
+                    kContentionPairs, kContentionRounds, elapsed / 1000);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(futex_tests)
 RUN_TEST(test_futex_wait_value_mismatch);
 RUN_TEST(test_futex_wait_timeout);
@@ -545,6 +679,9 @@ RUN_TEST(test_futex_thread_killed);
 RUN_TEST(test_futex_thread_suspended);
 RUN_TEST(test_futex_misaligned);
 RUN_TEST(test_event_signaling);
+RUN_TEST(test_futex_wait_owned);
+RUN_TEST(test_pthread_mutex_prio_inherit);
+RUN_TEST(test_futex_contention);
 END_TEST_CASE(futex_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -144,10 +144,114 @@ static bool handle_rights_test(void) {
     END_TEST;
 }
 
+static bool handle_close_many_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t handles[4];
+    ASSERT_EQ(zx_event_create(0u, &handles[0]), ZX_OK, "");
+    ASSERT_EQ(zx_event_create(0u, &handles[1]), ZX_OK, "");
+    handles[2] = ZX_HANDLE_INVALID;
+    ASSERT_EQ(zx_event_create(0u, &handles[3]), ZX_OK, "");
+
+    ASSERT_EQ(zx_handle_close_many(handles, 4u), ZX_OK, "invalid handles should be skipped");
+    for (size_t i = 0; i < 4u; i++) {
+        EXPECT_EQ(zx_handle_close(handles[i]), i == 2 ? ZX_OK : ZX_ERR_BAD_HANDLE,
+                  "handle should be closed");
+    }
+
+    // A bad handle is reported, but the rest are closed all the same.
+    ASSERT_EQ(zx_event_create(0u, &handles[1]), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close_many(handles, 2u), ZX_ERR_BAD_HANDLE, "");
+    EXPECT_EQ(zx_handle_close(handles[1]), ZX_ERR_BAD_HANDLE, "handle should be closed");
+
+    END_TEST;
+}
+
+static bool handle_duplicate_many_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t events[2];
+    ASSERT_EQ(zx_event_create(0u, &events[0]), ZX_OK, "");
+    ASSERT_EQ(zx_event_create(0u, &events[1]), ZX_OK, "");
+
+    zx_handle_t duped[2];
+    ASSERT_EQ(zx_handle_duplicate_many(events, 2u, ZX_RIGHT_READ, duped), ZX_OK, "");
+    for (size_t i = 0; i < 2u; i++) {
+        zx_info_handle_basic_t original = {};
+        zx_info_handle_basic_t info = {};
+        ASSERT_EQ(zx_object_get_info(events[i], ZX_INFO_HANDLE_BASIC, &original,
+                                     sizeof(original), NULL, NULL), ZX_OK, "");
+        ASSERT_EQ(zx_object_get_info(duped[i], ZX_INFO_HANDLE_BASIC, &info,
+                                     sizeof(info), NULL, NULL), ZX_OK, "");
+        EXPECT_EQ(info.koid, original.koid, "duplicate should refer to the same object");
+        EXPECT_EQ(info.rights, ZX_RIGHT_READ, "wrong set of rights");
+    }
+
+    // The read-only duplicates can't be duplicated, and nothing is created
+    // when any of the handles fails.
+    zx_handle_t h[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
+    zx_handle_t mixed[2] = {events[0], duped[1]};
+    ASSERT_EQ(zx_handle_duplicate_many(mixed, 2u, ZX_RIGHT_SAME_RIGHTS, h),
+              ZX_ERR_ACCESS_DENIED, "should fail rights check");
+    EXPECT_EQ(h[0], ZX_HANDLE_INVALID, "");
+    EXPECT_EQ(h[1], ZX_HANDLE_INVALID, "");
+
+    ASSERT_EQ(zx_handle_duplicate_many(events, 2u, ZX_RIGHT_EXECUTE | ZX_RIGHT_READ, h),
+              ZX_ERR_INVALID_ARGS, "cannot upgrade rights");
+
+    zx_handle_t bad[2] = {events[0], ZX_HANDLE_INVALID};
+    ASSERT_EQ(zx_handle_duplicate_many(bad, 2u, ZX_RIGHT_SAME_RIGHTS, h), ZX_ERR_BAD_HANDLE, "");
+
+    zx_handle_t too_many[ZX_HANDLE_BATCH_MAX + 1];
+    ASSERT_EQ(zx_handle_duplicate_many(events, ZX_HANDLE_BATCH_MAX + 1, ZX_RIGHT_SAME_RIGHTS,
+                                       too_many), ZX_ERR_OUT_OF_RANGE, "");
+
+    ASSERT_EQ(zx_handle_close_many(events, 2u), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close_many(duped, 2u), ZX_OK, "");
+
+    END_TEST;
+}
+
+static bool handle_replace_many_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t events[2];
+    ASSERT_EQ(zx_event_create(0u, &events[0]), ZX_OK, "");
+    ASSERT_EQ(zx_event_create(0u, &events[1]), ZX_OK, "");
+
+    zx_handle_t h[2];
+    zx_handle_t twice[2] = {events[0], events[0]};
+    ASSERT_EQ(zx_handle_replace_many(twice, 2u, ZX_RIGHT_SAME_RIGHTS, h), ZX_ERR_INVALID_ARGS,
+              "a handle can only be replaced once");
+
+    ASSERT_EQ(zx_handle_replace_many(events, 2u, ZX_RIGHT_EXECUTE | ZX_RIGHT_READ, h),
+              ZX_ERR_INVALID_ARGS, "cannot upgrade rights");
+    // A failed replace leaves the originals alone.
+    ASSERT_EQ(zx_object_get_info(events[1], ZX_INFO_HANDLE_VALID, NULL, 0u, NULL, NULL), ZX_OK,
+              "handle should be valid");
+
+    ASSERT_EQ(zx_handle_replace_many(events, 2u, ZX_RIGHT_READ, h), ZX_OK, "");
+    for (size_t i = 0; i < 2u; i++) {
+        zx_info_handle_basic_t info = {};
+        ASSERT_EQ(zx_object_get_info(h[i], ZX_INFO_HANDLE_BASIC, &info, sizeof(info),
+                                     NULL, NULL), ZX_OK, "");
+        EXPECT_EQ(info.rights, ZX_RIGHT_READ, "wrong set of rights");
+    }
+
+    ASSERT_EQ(zx_handle_close_many(events, 2u), ZX_ERR_BAD_HANDLE,
+              "replaced handles should be invalid");
+    ASSERT_EQ(zx_handle_close_many(h, 2u), ZX_OK, "failed to close replacement handles");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(handle_info_tests)
 RUN_TEST(handle_info_test)
 RUN_TEST(handle_related_koid_test)
 RUN_TEST(handle_rights_test)
+RUN_TEST(handle_close_many_test)
+RUN_TEST(handle_duplicate_many_test)
+RUN_TEST(handle_replace_many_test)
 END_TEST_CASE(handle_info_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -14,6 +14,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define LOCAL_TRACE 0
 #define LTRACEF(str, x...)                                  \
@@ -861,6 +862,53 @@ bool job_children_smoke() {
     return jobch_helper_smoke(ZX_INFO_JOB_CHILDREN, kTestJobChildJobs);
 }
 
+bool job_tree_smoke() {
+    BEGIN_TEST;
+    // The test job, its processes and child jobs, and a process and a job
+    // under each child job. The processes haven't been started, so have no
+    // threads.
+    const size_t kExpectedCount =
+        1 + kTestJobChildProcs + kTestJobChildJobs * 3;
+    zx_info_task_node_t nodes[16];
+    size_t actual;
+    size_t avail;
+    ASSERT_EQ(zx_object_get_info(get_test_job(), ZX_INFO_JOB_TREE,
+                                 nodes, sizeof(nodes), &actual, &avail),
+              ZX_OK);
+    EXPECT_EQ(kExpectedCount, actual);
+    EXPECT_EQ(kExpectedCount, avail);
+
+    zx_info_handle_basic_t info;
+    ASSERT_EQ(zx_object_get_info(get_test_job(), ZX_INFO_HANDLE_BASIC,
+                                 &info, sizeof(info), nullptr, nullptr),
+              ZX_OK);
+    EXPECT_EQ(nodes[0].koid, info.koid);
+    EXPECT_EQ(nodes[0].type, ZX_OBJ_TYPE_JOB);
+    EXPECT_EQ(nodes[0].depth, 0u);
+
+    // The processes come before the child jobs, and each child job is
+    // followed by what is under it.
+    size_t i = 1;
+    for (size_t p = 0; p < kTestJobChildProcs && i < actual; p++, i++) {
+        EXPECT_EQ(nodes[i].type, ZX_OBJ_TYPE_PROCESS);
+        EXPECT_EQ(nodes[i].depth, 1u);
+        EXPECT_EQ(nodes[i].parent_koid, info.koid);
+        EXPECT_EQ(strcmp(nodes[i].name, "child"), 0);
+    }
+    for (size_t j = 0; j < kTestJobChildJobs && i + 2 < actual; j++, i += 3) {
+        EXPECT_EQ(nodes[i].type, ZX_OBJ_TYPE_JOB);
+        EXPECT_EQ(nodes[i].depth, 1u);
+        EXPECT_EQ(nodes[i].parent_koid, info.koid);
+        EXPECT_EQ(nodes[i + 1].type, ZX_OBJ_TYPE_PROCESS);
+        EXPECT_EQ(nodes[i + 1].depth, 2u);
+        EXPECT_EQ(nodes[i + 1].parent_koid, nodes[i].koid);
+        EXPECT_EQ(nodes[i + 2].type, ZX_OBJ_TYPE_JOB);
+        EXPECT_EQ(nodes[i + 2].depth, 2u);
+        EXPECT_EQ(nodes[i + 2].parent_koid, nodes[i].koid);
+    }
+    END_TEST;
+}
+
 uint32_t handle_count_or_zero(zx_handle_t handle) {
     zx_info_handle_count_t info;
     if (ZX_OK != zx_object_get_info(
@@ -893,6 +941,34 @@ bool handle_count_valid() {
     return true;
 }
 
+uint32_t process_event_count_or_zero() {
+    zx_info_process_handle_stats_t info;
+    auto status = zx_object_get_info(zx_process_self(), ZX_INFO_PROCESS_HANDLE_STATS,
+                                     &info, sizeof(info), nullptr, nullptr);
+    if (status != ZX_OK)
+        return 0u;
+    return info.handle_count[ZX_OBJ_TYPE_EVENT];
+}
+
+bool process_handle_stats_valid() {
+    // The per-type count for events follows handles as they are created
+    // and closed in this process.
+    BEGIN_TEST;
+    uint32_t base = process_event_count_or_zero();
+
+    zx_handle_t event[4];
+    for (size_t i = 0; i != countof(event); ++i) {
+        ASSERT_EQ(zx_event_create(0u, &event[i]), ZX_OK);
+        EXPECT_EQ(process_event_count_or_zero(), base + i + 1);
+    }
+
+    for (size_t i = countof(event); i != 0; --i) {
+        ASSERT_EQ(zx_handle_close(event[i - 1]), ZX_OK);
+        EXPECT_EQ(process_event_count_or_zero(), base + i - 1);
+    }
+    END_TEST;
+}
+
 } // namespace
 
 // Tests that should pass for any topic. Use the wrappers below instead of
@@ -961,6 +1037,13 @@ RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_CHILDREN, zx_koid_t, zx_thread_sel
 RUN_TEST((missing_rights_fails<ZX_INFO_JOB_CHILDREN, zx_koid_t, get_test_job,
                                ZX_RIGHT_ENUMERATE>));
 
+RUN_TEST(job_tree_smoke);
+RUN_MULTI_ENTRY_TESTS(ZX_INFO_JOB_TREE, zx_info_task_node_t, get_test_job);
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_TREE, zx_info_task_node_t, get_test_process>));
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_TREE, zx_info_task_node_t, zx_thread_self>));
+RUN_TEST((missing_rights_fails<ZX_INFO_JOB_TREE, zx_info_task_node_t, get_test_job,
+                               ZX_RIGHT_ENUMERATE>));
+
 // Basic tests for all other topics.
 
 RUN_SINGLE_ENTRY_TESTS(ZX_INFO_HANDLE_BASIC, zx_info_handle_basic_t, get_test_job);
@@ -987,6 +1070,12 @@ RUN_SINGLE_ENTRY_TESTS(ZX_INFO_THREAD_STATS, zx_info_thread_stats_t, zx_thread_s
 RUN_TEST((wrong_handle_type_fails<ZX_INFO_THREAD_STATS, zx_info_thread_t, get_test_job>));
 RUN_TEST((wrong_handle_type_fails<ZX_INFO_THREAD_STATS, zx_info_thread_t, get_test_process>));
 
+RUN_SINGLE_ENTRY_TESTS(ZX_INFO_TASK_RUNTIME, zx_info_task_runtime_t, zx_thread_self);
+RUN_SINGLE_ENTRY_TESTS(ZX_INFO_TASK_RUNTIME, zx_info_task_runtime_t, get_test_process);
+RUN_SINGLE_ENTRY_TESTS(ZX_INFO_TASK_RUNTIME, zx_info_task_runtime_t, get_test_job);
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_TASK_RUNTIME, zx_info_task_runtime_t,
+                                  zx_vmar_root_self>));
+
 // ZX_INFO_PROCESS_THREADS tests.
 // TODO(dbort): Use RUN_MULTI_ENTRY_TESTS instead. |short_buffer_succeeds| and
 // |partially_unmapped_buffer_fails| currently fail because those tests expect
@@ -1006,9 +1095,16 @@ RUN_TEST((invalid_handle_fails<ZX_INFO_THREAD_EXCEPTION_REPORT, zx_exception_rep
 // TODO(dbort): Test resource topics
 // RUN_MULTI_ENTRY_TESTS(ZX_INFO_CPU_STATS, zx_info_cpu_stats_t, get_root_resource);
 // RUN_SINGLE_ENTRY_TESTS(ZX_INFO_KMEM_STATS, zx_info_kmem_stats_t, get_root_resource);
+// RUN_MULTI_ENTRY_TESTS(ZX_INFO_KERNEL_LOCK_STATS, zx_info_kernel_lock_stats_t, get_root_resource);
 
 RUN_TEST(handle_count_valid);
 
+RUN_TEST(process_handle_stats_valid);
+RUN_SINGLE_ENTRY_TESTS(ZX_INFO_PROCESS_HANDLE_STATS, zx_info_process_handle_stats_t,
+                       zx_process_self);
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_PROCESS_HANDLE_STATS, zx_info_process_handle_stats_t,
+                                  get_test_job>));
+
 END_TEST_CASE(object_info_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -139,6 +139,50 @@ static bool wait_count_invalid_test() {
     END_TEST;
 }
 
+static bool wait_many_test() {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+
+    zx_port_packet_t out[ZX_PORT_WAIT_MANY_MAX] = {};
+    size_t actual = 0u;
+    EXPECT_EQ(zx_port_wait_many(port, 0ull, out, 0u, &actual), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_port_wait_many(port, 0ull, out, ZX_PORT_WAIT_MANY_MAX + 1u, &actual),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_port_wait_many(port, 0ull, out, 1u, &actual), ZX_ERR_TIMED_OUT);
+
+    for (uint64_t key = 0u; key < 5u; ++key) {
+        zx_port_packet_t in = {};
+        in.key = key;
+        ASSERT_EQ(zx_port_queue(port, &in, 1u), ZX_OK);
+    }
+
+    // Packets come back in FIFO order and a short batch leaves the rest queued.
+    ASSERT_EQ(zx_port_wait_many(port, ZX_TIME_INFINITE, out, 3u, &actual), ZX_OK);
+    ASSERT_EQ(actual, 3u);
+    for (uint64_t i = 0u; i < 3u; ++i)
+        EXPECT_EQ(out[i].key, i);
+
+    ASSERT_EQ(zx_port_wait_many(port, ZX_TIME_INFINITE, out, ZX_PORT_WAIT_MANY_MAX, &actual),
+              ZX_OK);
+    ASSERT_EQ(actual, 2u);
+    EXPECT_EQ(out[0].key, 3u);
+    EXPECT_EQ(out[1].key, 4u);
+
+    // |actual| is optional.
+    zx_port_packet_t in = {};
+    ASSERT_EQ(zx_port_queue(port, &in, 1u), ZX_OK);
+    EXPECT_EQ(zx_port_wait_many(port, ZX_TIME_INFINITE, out, 1u, nullptr), ZX_OK);
+
+    EXPECT_EQ(zx_port_wait_many(port, 0ull, out, ZX_PORT_WAIT_MANY_MAX, &actual),
+              ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
 static bool queue_and_close_test(void) {
     BEGIN_TEST;
     zx_status_t status;
@@ -390,6 +434,60 @@ static bool async_wait_event_test_repeat(void) {
     END_TEST;
 }
 
+static bool async_wait_event_test_edge(void) {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    zx_handle_t ev;
+    ASSERT_EQ(zx_event_create(0u, &ev), ZX_OK);
+
+    const uint64_t key0 = 3344ull;
+    zx_port_packet_t out = {};
+
+    // A signal which is already asserted counts as an edge.
+    ASSERT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_0), ZX_OK);
+    ASSERT_EQ(zx_object_wait_async(ev, port, key0, ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_1,
+                                   ZX_WAIT_ASYNC_EDGE), ZX_OK);
+    ASSERT_EQ(zx_port_wait(port, 0ull, &out, 0u), ZX_OK);
+    EXPECT_EQ(out.key, key0);
+    EXPECT_EQ(out.type, ZX_PKT_TYPE_SIGNAL_REP);
+    EXPECT_EQ(out.signal.observed, ZX_USER_SIGNAL_0);
+
+    // Other changes while the signal stays asserted queue nothing, unlike
+    // a repeating wait.
+    ASSERT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_2), ZX_OK);
+    ASSERT_EQ(zx_object_signal(ev, ZX_USER_SIGNAL_2, 0u), ZX_OK);
+    EXPECT_EQ(zx_port_wait(port, 0ull, &out, 0u), ZX_ERR_TIMED_OUT);
+
+    // Edges are coalesced into the packet which is already queued, and
+    // only the newly asserted signals are reported.
+    for (int ix = 0; ix != 3; ++ix) {
+        ASSERT_EQ(zx_object_signal(ev, ZX_USER_SIGNAL_0, 0u), ZX_OK);
+        ASSERT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_0), ZX_OK);
+    }
+    ASSERT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_1), ZX_OK);
+    ASSERT_EQ(zx_port_wait(port, 0ull, &out, 0u), ZX_OK);
+    EXPECT_EQ(out.signal.observed, ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_1);
+    EXPECT_EQ(zx_port_wait(port, 0ull, &out, 0u), ZX_ERR_TIMED_OUT);
+
+    ASSERT_EQ(zx_object_signal(ev, ZX_USER_SIGNAL_1, 0u), ZX_OK);
+    ASSERT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_1), ZX_OK);
+    ASSERT_EQ(zx_port_wait(port, 0ull, &out, 0u), ZX_OK);
+    EXPECT_EQ(out.signal.observed, ZX_USER_SIGNAL_1);
+
+    // The registration lasts until it is canceled.
+    ASSERT_EQ(zx_port_cancel(port, ev, key0), ZX_OK);
+    ASSERT_EQ(zx_object_signal(ev, ZX_USER_SIGNAL_0 | ZX_USER_SIGNAL_1, 0u), ZX_OK);
+    ASSERT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_0), ZX_OK);
+    EXPECT_EQ(zx_port_wait(port, 0ull, &out, 0u), ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_handle_close(ev), ZX_OK);
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
 // Check that zx_object_wait_async() returns an error if it is passed an
 // invalid option.
 static bool async_wait_invalid_option() {
@@ -399,7 +497,7 @@ static bool async_wait_invalid_option() {
     zx_handle_t event;
     ASSERT_EQ(zx_event_create(0u, &event), ZX_OK);
     const uint64_t kKey = 0;
-    const uint32_t kInvalidOption = ZX_WAIT_ASYNC_REPEATING + 1;
+    const uint32_t kInvalidOption = ZX_WAIT_ASYNC_EDGE + 1;
     EXPECT_EQ(zx_object_wait_async(event, port, kKey, ZX_EVENT_SIGNALED,
                                    kInvalidOption), ZX_ERR_INVALID_ARGS);
     ASSERT_EQ(zx_handle_close(event), ZX_OK);
@@ -746,10 +844,12 @@ RUN_TEST(wait_count_valid_test<0u>)
 RUN_TEST(wait_count_valid_test<1u>)
 RUN_TEST(wait_count_invalid_test<2u>)
 RUN_TEST(wait_count_invalid_test<23u>)
+RUN_TEST(wait_many_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(async_wait_channel_test)
 RUN_TEST(async_wait_event_test_single)
 RUN_TEST(async_wait_event_test_repeat)
+RUN_TEST(async_wait_event_test_edge)
 RUN_TEST(async_wait_invalid_option)
 RUN_TEST(async_wait_close_order_1)
 RUN_TEST(async_wait_close_order_2)
@@ -3,11 +3,14 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <limits.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <unittest/unittest.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static zx_signals_t get_satisfied_signals(zx_handle_t handle) {
@@ -543,6 +546,82 @@ static bool socket_datagram(void) {
     END_TEST;
 }
 
+static bool socket_datagram_batch(void) {
+    BEGIN_TEST;
+
+    size_t count;
+    zx_status_t status;
+    zx_handle_t h0, h1;
+    // Three 32 byte slots.
+    char rbuf[3 * 32];
+    const uint32_t options = ZX_SOCKET_DATAGRAM_BATCH | ZX_SOCKET_SLOT_ORDER(5);
+
+    status = zx_socket_create(ZX_SOCKET_DATAGRAM, &h0, &h1);
+    ASSERT_EQ(status, ZX_OK, "");
+
+    status = zx_socket_read(h1, options, rbuf, sizeof(rbuf), &count);
+    EXPECT_EQ(status, ZX_ERR_SHOULD_WAIT, "");
+
+    status = zx_socket_write(h0, 0u, "packet1", 8u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    status = zx_socket_write(h0, 0u, "a packet too long for its slot", 31u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    status = zx_socket_write(h0, 0u, "pkt3", 5u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    status = zx_socket_write(h0, 0u, "pkt4", 5u, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+
+    status = zx_socket_read(h1, options, rbuf, 31u, &count);
+    EXPECT_EQ(status, ZX_ERR_BUFFER_TOO_SMALL, "");
+    status = zx_socket_read(h1, ZX_SOCKET_DATAGRAM_BATCH | ZX_SOCKET_SLOT_ORDER(3),
+                            rbuf, sizeof(rbuf), &count);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS, "");
+
+    status = zx_socket_read(h1, options, rbuf, sizeof(rbuf), &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, sizeof(rbuf), "");
+
+    const zx_socket_datagram_t* header = (const zx_socket_datagram_t*)rbuf;
+    EXPECT_EQ(header->size, 8u, "");
+    EXPECT_EQ(header->actual, 8u, "");
+    EXPECT_EQ(memcmp(header + 1, "packet1", 8u), 0, "");
+
+    header = (const zx_socket_datagram_t*)(rbuf + 32);
+    EXPECT_EQ(header->size, 31u, "");
+    EXPECT_EQ(header->actual, 32u - sizeof(*header), "should be truncated to the slot");
+    EXPECT_EQ(memcmp(header + 1, "a packet too long for its slot", header->actual), 0, "");
+
+    header = (const zx_socket_datagram_t*)(rbuf + 64);
+    EXPECT_EQ(header->size, 5u, "");
+    EXPECT_EQ(header->actual, 5u, "");
+    EXPECT_EQ(memcmp(header + 1, "pkt3", 5u), 0, "");
+
+    // The datagram that did not fit is left for the next read.
+    status = zx_socket_read(h1, options, rbuf, sizeof(rbuf), &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 32u, "");
+    header = (const zx_socket_datagram_t*)rbuf;
+    EXPECT_EQ(header->size, 5u, "");
+    EXPECT_EQ(memcmp(header + 1, "pkt4", 5u), 0, "");
+
+    status = zx_socket_read(h1, 0u, NULL, 0, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, 0u, "");
+
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    // Stream sockets have no datagrams to batch.
+    status = zx_socket_create(ZX_SOCKET_STREAM, &h0, &h1);
+    ASSERT_EQ(status, ZX_OK, "");
+    status = zx_socket_read(h1, options, rbuf, sizeof(rbuf), &count);
+    EXPECT_EQ(status, ZX_ERR_BAD_STATE, "");
+    zx_handle_close(h0);
+    zx_handle_close(h1);
+
+    END_TEST;
+}
+
 static bool socket_datagram_no_short_write(void) {
     BEGIN_TEST;
 
@@ -799,6 +878,97 @@ static bool socket_accept(void) {
     END_TEST;
 }
 
+static bool socket_ring(void) {
+    BEGIN_TEST;
+
+    zx_status_t status;
+    size_t count;
+    zx_handle_t h[2];
+    zx_handle_t vmo;
+
+    // Rings are stream-only and the order needs the ring flag.
+    status = zx_socket_create(ZX_SOCKET_RING | ZX_SOCKET_DATAGRAM, h, h + 1);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS, "");
+    status = zx_socket_create(ZX_SOCKET_RING_ORDER(ZX_SOCKET_RING_MIN_ORDER), h, h + 1);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS, "");
+    status = zx_socket_create(ZX_SOCKET_RING | ZX_SOCKET_RING_ORDER(ZX_SOCKET_RING_MAX_ORDER + 1),
+                              h, h + 1);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS, "");
+
+    status = zx_socket_create(0, h, h + 1);
+    ASSERT_EQ(status, ZX_OK, "");
+    status = zx_socket_ring_vmo(h[1], 0u, &vmo);
+    EXPECT_EQ(status, ZX_ERR_NOT_SUPPORTED, "");
+    zx_handle_close(h[0]);
+    zx_handle_close(h[1]);
+
+    const size_t ring_size = 1u << ZX_SOCKET_RING_MIN_ORDER;
+    status = zx_socket_create(ZX_SOCKET_RING | ZX_SOCKET_RING_ORDER(ZX_SOCKET_RING_MIN_ORDER),
+                              h, h + 1);
+    ASSERT_EQ(status, ZX_OK, "");
+
+    status = zx_socket_ring_vmo(h[1], 0u, &vmo);
+    ASSERT_EQ(status, ZX_OK, "");
+    uintptr_t addr;
+    status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, PAGE_SIZE + ring_size,
+                         ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &addr);
+    ASSERT_EQ(status, ZX_OK, "");
+    zx_socket_ring_header_t* hdr = (zx_socket_ring_header_t*)addr;
+    EXPECT_EQ(hdr->data_offset, PAGE_SIZE, "");
+    EXPECT_EQ(hdr->data_size, ring_size, "");
+    EXPECT_EQ(hdr->write_pos, 0u, "");
+
+    // Fill the ring; the final write is short.
+    char* buf = malloc(ring_size + 1);
+    ASSERT_NONNULL(buf, "");
+    for (size_t i = 0; i < ring_size + 1; i++)
+        buf[i] = (char)i;
+    status = zx_socket_write(h[0], 0u, buf, ring_size + 1, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, ring_size, "");
+    EXPECT_EQ(hdr->write_pos, ring_size, "");
+    EXPECT_EQ(get_satisfied_signals(h[0]) & ZX_SOCKET_WRITABLE, 0u, "");
+    EXPECT_EQ(get_satisfied_signals(h[1]) & ZX_SOCKET_READABLE, ZX_SOCKET_READABLE, "");
+
+    // Consume half through the mapping and publish it with a zero-size read.
+    const char* data = (const char*)(addr + hdr->data_offset);
+    EXPECT_EQ(memcmp(data, buf, ring_size / 2), 0, "");
+    __atomic_store_n(&hdr->read_pos, ring_size / 2, __ATOMIC_RELEASE);
+    size_t outstanding = 0u;
+    status = zx_socket_read(h[1], 0u, NULL, 0, &outstanding);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(outstanding, ring_size / 2, "");
+    EXPECT_EQ(get_satisfied_signals(h[0]) & ZX_SOCKET_WRITABLE, ZX_SOCKET_WRITABLE, "");
+
+    // A bogus read position is ignored.
+    __atomic_store_n(&hdr->read_pos, ring_size * 4, __ATOMIC_RELEASE);
+    status = zx_socket_read(h[1], 0u, NULL, 0, &outstanding);
+    EXPECT_EQ(outstanding, ring_size / 2, "");
+
+    // Write across the wrap point and read everything back with zx_socket_read.
+    status = zx_socket_write(h[0], 0u, buf, ring_size / 4, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, ring_size / 4, "");
+    char* out = malloc(ring_size);
+    ASSERT_NONNULL(out, "");
+    status = zx_socket_read(h[1], 0u, out, ring_size, &count);
+    EXPECT_EQ(status, ZX_OK, "");
+    EXPECT_EQ(count, ring_size / 2 + ring_size / 4, "");
+    EXPECT_EQ(memcmp(out, buf + ring_size / 2, ring_size / 2), 0, "");
+    EXPECT_EQ(memcmp(out + ring_size / 2, buf, ring_size / 4), 0, "");
+    EXPECT_EQ(hdr->read_pos, hdr->write_pos, "");
+    EXPECT_EQ(get_satisfied_signals(h[1]) & ZX_SOCKET_READABLE, 0u, "");
+
+    free(out);
+    free(buf);
+    zx_vmar_unmap(zx_vmar_root_self(), addr, PAGE_SIZE + ring_size);
+    zx_handle_close(vmo);
+    zx_handle_close(h[0]);
+    zx_handle_close(h[1]);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(socket_tests)
 RUN_TEST(socket_basic)
 RUN_TEST(socket_signals)
@@ -810,10 +980,12 @@ RUN_TEST(socket_bytes_outstanding_shutdown_read)
 RUN_TEST(socket_short_write)
 RUN_TEST(socket_datagram)
 RUN_TEST(socket_datagram_no_short_write)
+RUN_TEST(socket_datagram_batch)
 RUN_TEST(socket_control_plane_absent)
 RUN_TEST(socket_control_plane)
 RUN_TEST(socket_control_plane_shutdown)
 RUN_TEST(socket_accept)
+RUN_TEST(socket_ring)
 END_TEST_CASE(socket_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -3,7 +3,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <zircon/process.h>
@@ -970,6 +974,26 @@ static bool test_noncanonical_rip_address(void) {
     END_TEST;
 }
 
+static bool test_set_affinity(void) {
+    BEGIN_TEST;
+
+    uint32_t num_cpus = zx_system_get_num_cpus();
+    uint64_t all_cpus = (num_cpus >= 64) ? ~0ull : ((1ull << num_cpus) - 1);
+
+    // Move ourselves onto each cpu in turn, then let go again.
+    for (uint32_t cpu = 0; cpu < num_cpus && cpu < 64; cpu++) {
+        ASSERT_EQ(zx_thread_set_affinity(zx_thread_self(), 1ull << cpu), ZX_OK, "");
+        zx_nanosleep(0);
+    }
+    ASSERT_EQ(zx_thread_set_affinity(zx_thread_self(), all_cpus), ZX_OK, "");
+
+    EXPECT_EQ(zx_thread_set_affinity(zx_thread_self(), 0), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_thread_set_affinity(zx_thread_self(), 1ull << 63), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_thread_set_affinity(ZX_HANDLE_INVALID, all_cpus), ZX_ERR_BAD_HANDLE, "");
+
+    END_TEST;
+}
+
 // Test that, on ARM64, userland cannot use zx_thread_write_state() to
 // modify flag bits such as I and F (bits 7 and 6), which are the IRQ and
 // FIQ interrupt disable flags.  We don't want userland to be able to set
@@ -1031,6 +1055,36 @@ static bool test_writing_arm_flags_register(void) {
     END_TEST;
 }
 
+static void* dirty_stack_fn(void* arg) {
+    // Scribble over some stack, so a thread given these stacks next would
+    // trip over anything that expected them clean.
+    volatile char buffer[4096];
+    memset((char*)buffer, 0xa5, sizeof(buffer));
+    return buffer[sizeof(buffer) - 1] == (char)0xa5 ? arg : NULL;
+}
+
+// Back to back create/join round trips, the case the kernel and libc stack
+// caches are for. Reports the time per round trip.
+static bool test_create_exit_round_trips(void) {
+    BEGIN_TEST;
+
+    const int kRoundTrips = 1000;
+    const zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kRoundTrips; i++) {
+        pthread_t thread;
+        ASSERT_EQ(pthread_create(&thread, NULL, dirty_stack_fn, (void*)(uintptr_t)i),
+                  0, "");
+        void* result;
+        ASSERT_EQ(pthread_join(thread, &result), 0, "");
+        ASSERT_EQ((uintptr_t)result, (uintptr_t)i, "");
+    }
+    const zx_duration_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+    unittest_printf("%" PRIu64 " ns per thread create/exit round trip\n",
+                    elapsed / kRoundTrips);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(threads_tests)
 RUN_TEST(test_basics)
 RUN_TEST(test_detach)
@@ -1055,6 +1109,8 @@ RUN_TEST(test_reading_register_state)
 RUN_TEST(test_writing_register_state)
 RUN_TEST(test_noncanonical_rip_address)
 RUN_TEST(test_writing_arm_flags_register)
+RUN_TEST(test_set_affinity)
+RUN_TEST(test_create_exit_round_trips)
 END_TEST_CASE(threads_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -25,8 +25,31 @@ static bool elapsed_time_using_ticks(void) {
     END_TEST;
 }
 
+// The vDSO's clock must agree with the kernel's, which decides when a
+// deadline has passed.
+static bool clock_matches_kernel_deadlines(void) {
+    BEGIN_TEST;
+
+    for (int i = 0; i < 10; i++) {
+        zx_time_t deadline = zx_deadline_after(ZX_USEC(100));
+        ASSERT_EQ(zx_nanosleep(deadline), ZX_OK, "");
+        zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        EXPECT_GE(now, deadline, "Woke up before the deadline");
+    }
+
+    zx_time_t mono = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    zx_time_t utc = zx_clock_get(ZX_CLOCK_UTC);
+    EXPECT_GE(zx_clock_get(ZX_CLOCK_MONOTONIC), mono, "Monotonic clock went backwards");
+    EXPECT_GE(zx_clock_get(ZX_CLOCK_UTC), utc, "UTC went backwards");
+    EXPECT_GT(zx_clock_get(ZX_CLOCK_THREAD), 0u, "Thread clock not running");
+    EXPECT_EQ(zx_clock_get(0xffffffff), 0u, "Invalid clock");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(ticks_tests)
 RUN_TEST(elapsed_time_using_ticks)
+RUN_TEST(clock_matches_kernel_deadlines)
 END_TEST_CASE(ticks_tests)
 
 #ifndef BUILD_COMBINED_TESTS
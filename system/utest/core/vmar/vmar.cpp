@@ -1700,6 +1700,158 @@ bool protect_multiple_test() {
     END_TEST;
 }
 
+// Verify that hints are accepted over mapped ranges and never change the
+// contents of memory.
+bool op_range_test() {
+    BEGIN_TEST;
+
+    zx_handle_t vmo;
+    const size_t size = 4 * PAGE_SIZE;
+    ASSERT_EQ(zx_vmo_create(size, 0, &vmo), ZX_OK);
+
+    uintptr_t mapping_addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                          &mapping_addr),
+              ZX_OK);
+
+    volatile uint8_t* target = reinterpret_cast<volatile uint8_t*>(mapping_addr);
+    for (size_t i = 0; i < size; i += PAGE_SIZE) {
+        target[i] = static_cast<uint8_t>(i / PAGE_SIZE + 1);
+    }
+
+    static const uint32_t kOps[] = {
+        ZX_VMAR_OP_DONT_NEED, ZX_VMAR_OP_WILL_NEED, ZX_VMAR_OP_SEQUENTIAL,
+        ZX_VMAR_OP_RANDOM, ZX_VMAR_OP_NORMAL,
+    };
+    for (size_t i = 0; i < fbl::count_of(kOps); ++i) {
+        EXPECT_EQ(zx_vmar_op_range(zx_vmar_root_self(), kOps[i], mapping_addr, size), ZX_OK);
+        EXPECT_EQ(zx_vmar_op_range(zx_vmar_root_self(), kOps[i], mapping_addr + PAGE_SIZE,
+                                   PAGE_SIZE),
+                  ZX_OK);
+        for (size_t j = 0; j < size; j += PAGE_SIZE) {
+            EXPECT_EQ(target[j], j / PAGE_SIZE + 1, "contents changed");
+        }
+    }
+
+    // the same hints straight on the VMO
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DONT_NEED, 0, size, nullptr, 0), ZX_OK);
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_WILL_NEED, 0, size, nullptr, 0), ZX_OK);
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_DONT_NEED, size, PAGE_SIZE, nullptr, 0),
+              ZX_ERR_OUT_OF_RANGE);
+    for (size_t j = 0; j < size; j += PAGE_SIZE) {
+        EXPECT_EQ(target[j], j / PAGE_SIZE + 1, "contents changed");
+    }
+
+    EXPECT_EQ(zx_vmar_op_range(zx_vmar_root_self(), 0, mapping_addr, size),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_vmar_op_range(zx_vmar_root_self(), ZX_VMAR_OP_RANDOM, mapping_addr + 1,
+                               PAGE_SIZE),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_vmar_op_range(zx_vmar_root_self(), ZX_VMAR_OP_RANDOM, mapping_addr, 0),
+              ZX_ERR_INVALID_ARGS);
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), mapping_addr, size), ZX_OK);
+    EXPECT_EQ(zx_vmar_op_range(zx_vmar_root_self(), ZX_VMAR_OP_WILL_NEED, mapping_addr, size),
+              ZX_ERR_NOT_FOUND);
+
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    END_TEST;
+}
+
+// Verify that batched operations run in order, report the addresses of new
+// mappings, and stop at the first one that fails.
+bool batch_test() {
+    BEGIN_TEST;
+
+    zx_handle_t vmar;
+    uintptr_t vmar_base;
+    ASSERT_EQ(zx_vmar_allocate(zx_vmar_root_self(), 0, 8 * PAGE_SIZE,
+                               ZX_VM_FLAG_CAN_MAP_READ | ZX_VM_FLAG_CAN_MAP_WRITE |
+                               ZX_VM_FLAG_CAN_MAP_SPECIFIC,
+                               &vmar, &vmar_base),
+              ZX_OK);
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(4 * PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    const uint32_t kRW = ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE;
+    zx_vmar_batch_op_t ops[] = {
+        {ZX_VMAR_BATCH_MAP, kRW | ZX_VM_FLAG_SPECIFIC, vmo, 0, 0, 0, 4 * PAGE_SIZE},
+        {ZX_VMAR_BATCH_MAP, ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_SPECIFIC, vmo, 0, 0,
+         4 * PAGE_SIZE, 2 * PAGE_SIZE},
+        {ZX_VMAR_BATCH_PROTECT, ZX_VM_FLAG_PERM_READ, ZX_HANDLE_INVALID, 0, 0,
+         vmar_base + PAGE_SIZE, PAGE_SIZE},
+        {ZX_VMAR_BATCH_UNMAP, 0, ZX_HANDLE_INVALID, 0, 0, vmar_base + 3 * PAGE_SIZE, PAGE_SIZE},
+    };
+    size_t actual = 0;
+    ASSERT_EQ(zx_vmar_batch(vmar, ops, fbl::count_of(ops), &actual), ZX_OK);
+    EXPECT_EQ(actual, fbl::count_of(ops));
+    EXPECT_EQ(ops[0].addr, vmar_base);
+    EXPECT_EQ(ops[0].flags, kRW | ZX_VM_FLAG_SPECIFIC, "flags must be left alone");
+    EXPECT_EQ(ops[1].addr, vmar_base + 4 * PAGE_SIZE);
+
+    // The second mapping sees what was written through the first.
+    volatile uint8_t* target = reinterpret_cast<volatile uint8_t*>(vmar_base);
+    target[0] = 42;
+    EXPECT_EQ(target[4 * PAGE_SIZE], 42);
+
+    // The unmapped page is free again, the others are not.
+    uintptr_t addr;
+    EXPECT_EQ(zx_vmar_map(vmar, 3 * PAGE_SIZE, vmo, 0, PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_SPECIFIC, &addr),
+              ZX_OK);
+    EXPECT_EQ(zx_vmar_map(vmar, 2 * PAGE_SIZE, vmo, 0, PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_SPECIFIC, &addr),
+              ZX_ERR_NO_MEMORY);
+
+    // An operation that fails leaves the earlier ones in effect.
+    zx_vmar_batch_op_t partial[] = {
+        {ZX_VMAR_BATCH_MAP, ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_SPECIFIC, vmo, 0, 0,
+         6 * PAGE_SIZE, PAGE_SIZE},
+        {ZX_VMAR_BATCH_PROTECT, ZX_VM_FLAG_PERM_READ, ZX_HANDLE_INVALID, 0, 0,
+         vmar_base + 7 * PAGE_SIZE, PAGE_SIZE},
+        {ZX_VMAR_BATCH_UNMAP, 0, ZX_HANDLE_INVALID, 0, 0, vmar_base, PAGE_SIZE},
+    };
+    EXPECT_EQ(zx_vmar_batch(vmar, partial, fbl::count_of(partial), &actual), ZX_ERR_NOT_FOUND);
+    EXPECT_EQ(actual, 1u);
+    EXPECT_EQ(partial[0].addr, vmar_base + 6 * PAGE_SIZE);
+    EXPECT_EQ(target[0], 42, "later operations must not run");
+
+    // Bad arguments and rights are caught before anything runs.
+    zx_vmar_batch_op_t invalid[] = {
+        {ZX_VMAR_BATCH_UNMAP, 0, ZX_HANDLE_INVALID, 0, 0, vmar_base, PAGE_SIZE},
+        {0, 0, ZX_HANDLE_INVALID, 0, 0, vmar_base, PAGE_SIZE},
+    };
+    EXPECT_EQ(zx_vmar_batch(vmar, invalid, fbl::count_of(invalid), &actual),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(actual, 0u);
+    invalid[1] = {ZX_VMAR_BATCH_PROTECT, kRW | ZX_VM_FLAG_PERM_EXECUTE, ZX_HANDLE_INVALID, 0,
+                  0, vmar_base, PAGE_SIZE};
+    EXPECT_EQ(zx_vmar_batch(vmar, invalid, fbl::count_of(invalid), &actual),
+              ZX_ERR_ACCESS_DENIED);
+    invalid[1] = {ZX_VMAR_BATCH_MAP, ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_MAP_RANGE, vmo, 0, 0,
+                  0, PAGE_SIZE};
+    EXPECT_EQ(zx_vmar_batch(vmar, invalid, fbl::count_of(invalid), &actual),
+              ZX_ERR_INVALID_ARGS);
+    invalid[1] = {ZX_VMAR_BATCH_MAP, ZX_VM_FLAG_PERM_READ, ZX_HANDLE_INVALID, 0, 0,
+                  0, PAGE_SIZE};
+    EXPECT_EQ(zx_vmar_batch(vmar, invalid, fbl::count_of(invalid), &actual),
+              ZX_ERR_BAD_HANDLE);
+    EXPECT_EQ(target[0], 42, "nothing must run");
+
+    zx_vmar_batch_op_t too_many[ZX_VMAR_BATCH_MAX_OPS + 1] = {};
+    EXPECT_EQ(zx_vmar_batch(vmar, too_many, fbl::count_of(too_many), nullptr),
+              ZX_ERR_OUT_OF_RANGE);
+
+    EXPECT_EQ(zx_vmar_destroy(vmar), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmar), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    END_TEST;
+}
+
 // Verify that we can change protections on a demand paged mapping successfully.
 bool protect_over_demand_paged_test() {
     BEGIN_TEST;
@@ -2007,6 +2159,8 @@ RUN_TEST(map_specific_overwrite_test);
 RUN_TEST(protect_split_test);
 RUN_TEST(protect_multiple_test);
 RUN_TEST(protect_over_demand_paged_test);
+RUN_TEST(op_range_test);
+RUN_TEST(batch_test);
 RUN_TEST(protect_large_uncommitted_test);
 RUN_TEST(unmap_large_uncommitted_test);
 RUN_TEST(partial_unmap_and_read);
@@ -2,8 +2,10 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <threads.h>
 #include <time.h>
 
 #include <zircon/syscalls.h>
@@ -63,10 +65,46 @@ bool cprng_test_add_entropy_buf_too_large(void) {
     END_TEST;
 }
 
+#define DRAW_THREADS 8
+#define DRAWS_PER_THREAD 4096
+
+static int draw_thread(void* arg) {
+    uint8_t buf[32];
+    for (int i = 0; i < DRAWS_PER_THREAD; ++i) {
+        size_t sz;
+        if (zx_cprng_draw(buf, sizeof(buf), &sz) != ZX_OK || sz != sizeof(buf)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Draws small buffers from many threads at once, as TLS and ASLR users do, and
+// reports the aggregate throughput.
+bool cprng_test_draw_multithreaded(void) {
+    BEGIN_TEST;
+    thrd_t threads[DRAW_THREADS];
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < DRAW_THREADS; ++i) {
+        ASSERT_EQ(thrd_create(&threads[i], draw_thread, NULL), thrd_success, "");
+    }
+    for (int i = 0; i < DRAW_THREADS; ++i) {
+        int ret;
+        ASSERT_EQ(thrd_join(threads[i], &ret), thrd_success, "");
+        EXPECT_EQ(ret, 0, "draw failed");
+    }
+    zx_time_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+    unittest_printf("%d threads drew %d x 32 bytes each in %" PRIi64 " us (%" PRIi64 " ns/draw)\n",
+                    DRAW_THREADS, DRAWS_PER_THREAD, elapsed / 1000,
+                    elapsed / (DRAW_THREADS * DRAWS_PER_THREAD));
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(cprng_tests)
 RUN_TEST(cprng_test_draw_buf_too_large)
 RUN_TEST(cprng_test_draw_bad_buf)
 RUN_TEST(cprng_test_draw_success)
+RUN_TEST(cprng_test_draw_multithreaded)
 RUN_TEST(cprng_test_add_entropy_buf_too_large)
 RUN_TEST(cprng_test_add_entropy_bad_buf)
 END_TEST_CASE(cprng_tests)
@@ -316,6 +316,69 @@ bool TestDecryptRandomAccess(Cipher::Algorithm cipher) {
 }
 DEFINE_EACH(TestDecryptRandomAccess)
 
+bool TestTransformBatch(Cipher::Algorithm cipher) {
+    BEGIN_TEST;
+    size_t len = PAGE_SIZE;
+    size_t sector_len = len / 8;
+    Bytes key, iv, ptext;
+    ASSERT_OK(GenerateKeyMaterial(cipher, &key, &iv));
+    ASSERT_OK(ptext.InitRandom(len));
+    uint8_t expected[len];
+    uint8_t ctext[len];
+    uint8_t result[len];
+
+    // Encrypt the sectors in a scattered order, both one at a time and as a batch.
+    Cipher::Sector sectors[8];
+    for (size_t i = 0; i < 8; ++i) {
+        size_t j = (i * 5) % 8;
+        sectors[i].in = ptext.get() + j * sector_len;
+        sectors[i].offset = (j * 3 + 1) * sector_len;
+        sectors[i].length = sector_len;
+        sectors[i].out = ctext + j * sector_len;
+    }
+    Cipher encrypt;
+    EXPECT_ZX(encrypt.EncryptBatch(sectors, 8), ZX_ERR_BAD_STATE);
+    ASSERT_OK(encrypt.InitEncrypt(cipher, key, iv, sector_len));
+    for (size_t i = 0; i < 8; ++i) {
+        ASSERT_OK(encrypt.Encrypt(sectors[i].in, sectors[i].offset, sector_len,
+                                  expected + (sectors[i].out - ctext)));
+    }
+
+    // Empty batch
+    EXPECT_OK(encrypt.EncryptBatch(nullptr, 0));
+
+    // Wrong mode
+    EXPECT_ZX(encrypt.DecryptBatch(sectors, 8), ZX_ERR_BAD_STATE);
+
+    // Bad sector; nothing is transformed
+    memset(ctext, 0, len);
+    sectors[7].offset += 1;
+    EXPECT_ZX(encrypt.EncryptBatch(sectors, 8), ZX_ERR_INVALID_ARGS);
+    EXPECT_TRUE(AllEqual(ctext, 0, 0, len));
+    sectors[7].offset -= 1;
+
+    // Valid
+    EXPECT_OK(encrypt.EncryptBatch(sectors, 8));
+    EXPECT_EQ(memcmp(expected, ctext, len), 0);
+
+    // Round trip
+    Cipher decrypt;
+    ASSERT_OK(decrypt.InitDecrypt(cipher, key, iv, sector_len));
+    for (size_t i = 0; i < 8; ++i) {
+        size_t off = sectors[i].out - ctext;
+        sectors[i].in = ctext + off;
+        sectors[i].out = result + off;
+    }
+    EXPECT_OK(decrypt.DecryptBatch(sectors, 8));
+    EXPECT_EQ(memcmp(ptext.get(), result, len), 0);
+
+    // Stream ciphers cannot batch
+    ASSERT_OK(encrypt.InitEncrypt(cipher, key, iv));
+    EXPECT_ZX(encrypt.EncryptBatch(sectors, 8), ZX_ERR_BAD_STATE);
+    END_TEST;
+}
+DEFINE_EACH(TestTransformBatch)
+
 // The following tests are taken from NIST's SP 800-38E.  The non-byte aligned tests vectors are
 // omitted; as they are not supported.  Of those remaining, every tenth is selected up to number 200
 // as a representative sample.
@@ -338,6 +401,20 @@ bool TestSP800_38E_TC(const char* xkey, const char* xiv, const char* xptext, con
     EXPECT_OK(decrypt.InitDecrypt(Cipher::kAES256_XTS, key, iv));
     EXPECT_OK(decrypt.Decrypt(ctext.get(), len, tmp));
     EXPECT_EQ(memcmp(tmp, ptext.get(), len), 0);
+
+    // Random access mode, with the whole vector as the first data unit.  This exercises the
+    // hardware AES path, if present.
+    uint64_t alignment = 1;
+    while (alignment < len) {
+        alignment <<= 1;
+    }
+    EXPECT_OK(encrypt.InitEncrypt(Cipher::kAES256_XTS, key, iv, alignment));
+    EXPECT_OK(encrypt.Encrypt(ptext.get(), 0, len, tmp));
+    EXPECT_EQ(memcmp(tmp, ctext.get(), len), 0);
+
+    EXPECT_OK(decrypt.InitDecrypt(Cipher::kAES256_XTS, key, iv, alignment));
+    EXPECT_OK(decrypt.Decrypt(ctext.get(), 0, len, tmp));
+    EXPECT_EQ(memcmp(tmp, ptext.get(), len), 0);
     END_TEST;
 }
 
@@ -594,6 +671,7 @@ RUN_EACH(TestEncryptStream)
 RUN_EACH(TestEncryptRandomAccess)
 RUN_EACH(TestDecryptStream)
 RUN_EACH(TestDecryptRandomAccess)
+RUN_EACH(TestTransformBatch)
 RUN_TEST(TestSP800_38E_TC010)
 RUN_TEST(TestSP800_38E_TC020)
 RUN_TEST(TestSP800_38E_TC030)
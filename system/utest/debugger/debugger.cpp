@@ -381,6 +381,119 @@ bool debugger_test() {
     END_TEST;
 }
 
+// Like handle_expected_page_fault(), but reads the exception state in one
+// call and fixes the segv and resumes in another.
+// N.B. This runs on the wait-inferior thread.
+
+bool handle_expected_page_fault_fast(zx_handle_t inferior, const zx_port_packet_t* packet,
+                                     fbl::atomic<int>* segv_count) {
+    BEGIN_HELPER;
+
+    zx_handle_t thread = tu_get_thread(inferior, packet->exception.tid);
+
+    zx_thread_state_exception_t state;
+    ASSERT_EQ(zx_thread_read_state(thread, ZX_THREAD_STATE_EXCEPTION, &state, sizeof(state)),
+              ZX_OK, "");
+    EXPECT_EQ(state.report.header.type, static_cast<uint32_t>(ZX_EXCP_FATAL_PAGE_FAULT), "");
+
+    // Verify that the fault is at the PC we expected, and fix the segv as
+    // fix_inferior_segv() does.
+#if defined(__x86_64__)
+    ASSERT_EQ(state.general_regs.rip, state.general_regs.r10, "fault PC does not match r10");
+    state.general_regs.r8 = state.general_regs.rsp;
+#elif defined(__aarch64__)
+    ASSERT_EQ(state.general_regs.pc, state.general_regs.r[10], "fault PC does not match x10");
+    state.general_regs.r[8] = state.general_regs.sp;
+#endif
+
+    test_memory_ops(inferior, thread);
+
+    atomic_fetch_add(segv_count, 1);
+
+    zx_status_t status = zx_thread_resume_from_exception(
+        thread, 0, ZX_THREAD_STATE_GENERAL_REGS, &state.general_regs,
+        sizeof(state.general_regs));
+    tu_handle_close(thread);
+    ASSERT_EQ(status, ZX_OK, "");
+
+    END_HELPER;
+}
+
+// N.B. This runs on the wait-inferior thread.
+
+bool fast_resume_exception_handler(zx_handle_t inferior, const zx_port_packet_t* packet,
+                                   void* handler_arg) {
+    BEGIN_HELPER;
+
+    if (packet->type == ZX_EXCP_FATAL_PAGE_FAULT) {
+        fbl::atomic<int>* segv_count = static_cast<fbl::atomic<int>*>(handler_arg);
+        ASSERT_TRUE(handle_expected_page_fault_fast(inferior, packet, segv_count), "");
+    } else {
+        ASSERT_TRUE(debugger_test_exception_handler(inferior, packet, nullptr), "");
+    }
+
+    END_HELPER;
+}
+
+bool resume_from_exception_test() {
+    BEGIN_TEST;
+
+    launchpad_t* lp;
+    zx_handle_t inferior, channel;
+    if (!setup_inferior(test_inferior_child_name, &lp, &inferior, &channel))
+        return false;
+
+    fbl::atomic<int> segv_count;
+
+    zx_handle_t eport = tu_io_port_create();
+    size_t max_threads = 10;
+    inferior_data_t* inferior_data = attach_inferior(inferior, eport, max_threads);
+    thrd_t wait_inf_thread =
+        start_wait_inf_thread(inferior_data, fast_resume_exception_handler, &segv_count);
+    EXPECT_NE(eport, ZX_HANDLE_INVALID, "");
+
+    if (!start_inferior(lp))
+        return false;
+    if (!verify_inferior_running(channel))
+        return false;
+
+    segv_count.store(0);
+    enum message msg;
+    send_msg(channel, MSG_CRASH_AND_RECOVER_TEST);
+    if (!recv_msg(channel, &msg))
+        return false;
+    EXPECT_EQ(msg, MSG_RECOVERED_FROM_CRASH, "unexpected response from crash");
+    EXPECT_EQ(segv_count.load(), kNumSegvTries, "segv tests terminated prematurely");
+
+    // The debugger exception port is the only one bound to |eport|, and has
+    // seen at least the thread starting and the segvs.
+    zx_info_exception_port_stats_t stats[2];
+    size_t actual, avail;
+    ASSERT_EQ(zx_object_get_info(eport, ZX_INFO_PORT_EXCEPTION_STATS, stats, sizeof(stats),
+                                 &actual, &avail), ZX_OK, "");
+    ASSERT_EQ(actual, 1u, "");
+    EXPECT_EQ(avail, 1u, "");
+    EXPECT_EQ(stats[0].type, ZX_EXCEPTION_PORT_TYPE_DEBUGGER, "");
+    EXPECT_GE(stats[0].responses, static_cast<uint64_t>(kNumSegvTries + 1), "");
+    EXPECT_GE(stats[0].exceptions, stats[0].responses, "");
+    EXPECT_GE(stats[0].total_response_time, stats[0].max_response_time, "");
+    EXPECT_GT(stats[0].max_response_time, 0, "");
+
+    if (!shutdown_inferior(channel, inferior))
+        return false;
+
+    // Stop the waiter thread before closing the eport that it's waiting on.
+    join_wait_inf_thread(wait_inf_thread);
+
+    detach_inferior(inferior_data, false);
+
+    tu_handle_close(eport);
+    tu_handle_close(channel);
+    tu_handle_close(inferior);
+
+    END_TEST;
+}
+
 bool debugger_thread_list_test() {
     BEGIN_TEST;
 
@@ -1241,6 +1354,7 @@ void scan_argv(int argc, char** argv) {
 BEGIN_TEST_CASE(debugger_tests)
 RUN_TEST(debugger_test)
 RUN_TEST(debugger_thread_list_test)
+RUN_TEST(resume_from_exception_test)
 RUN_TEST(property_process_debug_addr_test)
 RUN_TEST(write_text_segment)
 RUN_TEST(suspended_reg_access_test)
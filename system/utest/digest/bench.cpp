@@ -0,0 +1,89 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <digest/digest.h>
+#include <digest/merkle-tree.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <zircon/syscalls.h>
+#include <unittest/unittest.h>
+
+// These microbenchmarks report the throughput of hashing and of building
+// Merkle trees; they only fail if an operation does.
+
+namespace {
+
+using digest::Digest;
+using digest::MerkleTree;
+
+constexpr size_t KB = 1 << 10;
+constexpr size_t MB = 1 << 20;
+
+// Each benchmark hashes at least this much data in total.
+constexpr size_t kBytesPerBenchmark = 64 * MB;
+
+void PrintThroughput(const char* name, size_t len, size_t total, zx_time_t ticks) {
+    double secs = static_cast<double>(ticks) / static_cast<double>(zx_ticks_per_second());
+    printf("\nBenchmark %s (%zu KB): %8.1f MB/s", name, len / KB,
+           static_cast<double>(total) / static_cast<double>(MB) / secs);
+}
+
+bool MakeData(size_t len, fbl::unique_ptr<uint8_t[]>* out) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[len]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = static_cast<uint8_t>(rand());
+    }
+    *out = fbl::move(data);
+    return true;
+}
+
+template <size_t DataLen>
+bool DigestThroughput(void) {
+    BEGIN_TEST;
+    fbl::unique_ptr<uint8_t[]> data;
+    ASSERT_TRUE(MakeData(DataLen, &data));
+    Digest digest;
+    size_t total = 0;
+    zx_time_t start = zx_ticks_get();
+    for (; total < kBytesPerBenchmark; total += DataLen) {
+        digest.Hash(data.get(), DataLen);
+    }
+    PrintThroughput("Digest::Hash", DataLen, total, zx_ticks_get() - start);
+    END_TEST;
+}
+
+template <size_t DataLen>
+bool MerkleTreeCreateThroughput(void) {
+    BEGIN_TEST;
+    fbl::unique_ptr<uint8_t[]> data;
+    ASSERT_TRUE(MakeData(DataLen, &data));
+    size_t tree_len = MerkleTree::GetTreeLength(DataLen);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> tree(new (&ac) uint8_t[tree_len]);
+    ASSERT_TRUE(ac.check());
+    Digest digest;
+    size_t total = 0;
+    zx_time_t start = zx_ticks_get();
+    for (; total < kBytesPerBenchmark; total += DataLen) {
+        ASSERT_EQ(MerkleTree::Create(data.get(), DataLen, tree.get(), tree_len, &digest), ZX_OK);
+    }
+    PrintThroughput("MerkleTree::Create", DataLen, total, zx_ticks_get() - start);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(DigestBenchmarks)
+RUN_TEST_PERFORMANCE(DigestThroughput<64>)
+RUN_TEST_PERFORMANCE(DigestThroughput<8 * KB>)
+RUN_TEST_PERFORMANCE(DigestThroughput<MB>)
+RUN_TEST_PERFORMANCE(MerkleTreeCreateThroughput<64 * KB>)
+RUN_TEST_PERFORMANCE(MerkleTreeCreateThroughput<MB>)
+RUN_TEST_PERFORMANCE(MerkleTreeCreateThroughput<16 * MB>)
+END_TEST_CASE(DigestBenchmarks)
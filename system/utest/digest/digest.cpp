@@ -81,6 +81,27 @@ bool DigestSplit(void) {
     END_TEST;
 }
 
+// Splits enough data into uneven pieces to cover updates which start and end
+// both inside and on the boundaries of SHA-256 blocks.
+bool DigestSplitBlocks(void) {
+    BEGIN_TEST;
+    uint8_t buf[4096];
+    for (size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = static_cast<uint8_t>(rand());
+    }
+    Digest actual, expected;
+    expected.Hash(buf, sizeof(buf));
+    for (size_t step = 1; step < 200; step += 13) {
+        actual.Init();
+        for (size_t i = 0; i < sizeof(buf); i += step) {
+            actual.Update(buf + i, i + step < sizeof(buf) ? step : sizeof(buf) - i);
+        }
+        actual.Final();
+        ASSERT_TRUE(actual == expected, __FUNCTION__);
+    }
+    END_TEST;
+}
+
 bool DigestCWrappers(void) {
     BEGIN_TEST;
     uint8_t buf[Digest::kLength];
@@ -133,6 +154,7 @@ RUN_TEST(DigestStrings)
 RUN_TEST(DigestZero)
 RUN_TEST(DigestSelf)
 RUN_TEST(DigestSplit)
+RUN_TEST(DigestSplitBlocks)
 RUN_TEST(DigestCWrappers)
 RUN_TEST(DigestEquality)
 END_TEST_CASE(DigestTests)
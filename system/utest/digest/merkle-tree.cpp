@@ -5,8 +5,10 @@
 #include <digest/merkle-tree.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <digest/digest.h>
+#include <fbl/algorithm.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
 #include <unittest/unittest.h>
@@ -626,6 +628,29 @@ bool VerifyBadLeaves(void) {
     END_TEST;
 }
 
+// Create builds trees with all the data at hand a level at a time, possibly
+// across threads. Check it matches a tree built a piece at a time.
+bool CreateMatchesCreateUpdate(void) {
+    BEGIN_TEST_WITH_RC;
+    static uint8_t tree[sizeof(gTree)];
+    for (uint64_t i = 0; i < kUnalignedLarge; ++i) {
+        gData[i] = static_cast<uint8_t>(rand());
+    }
+    size_t tree_len = MerkleTree::GetTreeLength(kUnalignedLarge);
+    Digest expected, actual;
+    MerkleTree merkleTree;
+    ASSERT_OK(merkleTree.CreateInit(kUnalignedLarge, tree_len));
+    for (size_t i = 0; i < kUnalignedLarge; i += 1000) {
+        ASSERT_OK(merkleTree.CreateUpdate(
+            gData + i, fbl::min(static_cast<uint64_t>(1000), kUnalignedLarge - i), tree));
+    }
+    ASSERT_OK(merkleTree.CreateFinal(tree, &expected));
+    ASSERT_OK(MerkleTree::Create(gData, kUnalignedLarge, gTree, tree_len, &actual));
+    ASSERT_TRUE(actual == expected);
+    ASSERT_EQ(memcmp(tree, gTree, tree_len), 0);
+    END_TEST;
+}
+
 bool CreateAndVerifyHugePRNGData(void) {
     BEGIN_TEST_WITH_RC;
     Digest digest;
@@ -739,5 +764,6 @@ RUN_TEST(VerifyGoodPartOfBadTree)
 RUN_TEST(VerifyBadTree)
 RUN_TEST(VerifyGoodPartOfBadLeaves)
 RUN_TEST(VerifyBadLeaves)
+RUN_TEST(CreateMatchesCreateUpdate)
 RUN_TEST(CreateAndVerifyHugePRNGData)
 END_TEST_CASE(MerkleTreeTests)
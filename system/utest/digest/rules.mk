@@ -9,6 +9,7 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := usertest
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/bench.cpp \
     $(LOCAL_DIR)/digest.cpp \
     $(LOCAL_DIR)/merkle-tree.cpp \
     $(LOCAL_DIR)/main.c
@@ -167,6 +167,112 @@ bool clone_test(void) {
     END_TEST;
 }
 
+// Sends |names|, |len| bytes of names each followed by a zero byte, in
+// one LDMSG_OP_LOAD_OBJECTS request.
+static zx_status_t load_objects(zx_handle_t h, const char* names, size_t len,
+                                ldmsg_rsp_objects_t* rsp, zx_handle_t* handles,
+                                uint32_t* handle_count) {
+    ldmsg_req_t req;
+    memset(&req.header, 0, sizeof(req.header));
+    req.header.ordinal = LDMSG_OP_LOAD_OBJECTS;
+    size_t req_len;
+    zx_status_t status = ldmsg_req_encode(&req, &req_len, names, len);
+    if (status != ZX_OK)
+        return status;
+
+    zx_channel_call_args_t call = {
+        .wr_bytes = &req,
+        .wr_num_bytes = req_len,
+        .rd_bytes = rsp,
+        .rd_num_bytes = sizeof(*rsp),
+        .rd_handles = handles,
+        .rd_num_handles = LDMSG_LOAD_OBJECTS_MAX,
+    };
+    uint32_t reply_size;
+    zx_status_t read_status;
+    status = zx_channel_call(h, 0, ZX_TIME_INFINITE, &call, &reply_size,
+                             handle_count, &read_status);
+    if (status == ZX_ERR_CALL_FAILED)
+        return read_status;
+    if (status == ZX_OK && reply_size != sizeof(*rsp))
+        return ZX_ERR_INTERNAL;
+    return status;
+}
+
+bool load_objects_test(void) {
+    BEGIN_TEST;
+
+    int dirfd = open("/boot", O_RDONLY | O_DIRECTORY);
+    ASSERT_GE(dirfd, 0, "open /boot");
+    loader_service_t* svc = NULL;
+    ASSERT_EQ(loader_service_create_fd(NULL, dirfd, &svc), ZX_OK, "loader_service_create_fd");
+    zx_handle_t h = ZX_HANDLE_INVALID;
+    ASSERT_EQ(loader_service_connect(svc, &h), ZX_OK, "loader_service_connect");
+
+    // Each name gets a result, and only those found a handle.
+    static const char names[] = "libbogus.so\0" TEST_SONAME "\0";
+    ldmsg_rsp_objects_t rsp;
+    zx_handle_t handles[LDMSG_LOAD_OBJECTS_MAX];
+    uint32_t handle_count = 0;
+    zx_status_t status = load_objects(h, names, sizeof(names) - 1, &rsp, handles, &handle_count);
+    ASSERT_EQ(status, ZX_OK, "load_objects");
+    EXPECT_EQ(rsp.rv, ZX_OK, "");
+    EXPECT_EQ(rsp.count, 2u, "");
+    EXPECT_EQ(rsp.rvs[0], ZX_ERR_NOT_FOUND, "");
+    EXPECT_EQ(rsp.rvs[1], ZX_OK, "");
+    EXPECT_EQ(handle_count, 1u, "");
+    for (uint32_t i = 0; i < handle_count; ++i)
+        zx_handle_close(handles[i]);
+
+    // A name without its terminator is refused.
+    status = load_objects(h, TEST_SONAME, strlen(TEST_SONAME), &rsp, handles, &handle_count);
+    ASSERT_EQ(status, ZX_OK, "load_objects");
+    EXPECT_EQ(rsp.rv, ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(handle_count, 0u, "");
+
+    zx_handle_close(h);
+    loader_service_release(svc);
+
+    END_TEST;
+}
+
+bool loader_cache_test(void) {
+    BEGIN_TEST;
+
+    int dirfd = open("/boot", O_RDONLY | O_DIRECTORY);
+    ASSERT_GE(dirfd, 0, "open /boot");
+    loader_service_t* svc = NULL;
+    ASSERT_EQ(loader_service_create_fd(NULL, dirfd, &svc), ZX_OK, "loader_service_create_fd");
+    zx_handle_t h = ZX_HANDLE_INVALID;
+    ASSERT_EQ(loader_service_connect(svc, &h), ZX_OK, "loader_service_connect");
+
+    // Loading the same object twice hands out the same, read-only, VMO.
+    static const char names[] = TEST_SONAME "\0" TEST_SONAME "\0";
+    ldmsg_rsp_objects_t rsp;
+    zx_handle_t handles[LDMSG_LOAD_OBJECTS_MAX];
+    uint32_t handle_count = 0;
+    zx_status_t status = load_objects(h, names, sizeof(names) - 1, &rsp, handles, &handle_count);
+    ASSERT_EQ(status, ZX_OK, "load_objects");
+    ASSERT_EQ(rsp.rv, ZX_OK, "");
+    ASSERT_EQ(handle_count, 2u, "");
+
+    zx_info_handle_basic_t info[2];
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(zx_object_get_info(handles[i], ZX_INFO_HANDLE_BASIC, &info[i],
+                                     sizeof(info[i]), NULL, NULL), ZX_OK, "");
+        EXPECT_EQ(info[i].rights & ZX_RIGHT_WRITE, 0u, "cached vmo is writable");
+        EXPECT_NE(info[i].rights & ZX_RIGHT_EXECUTE, 0u, "");
+    }
+    EXPECT_EQ(info[0].koid, info[1].koid, "object was not cached");
+
+    zx_handle_close(handles[0]);
+    zx_handle_close(handles[1]);
+    zx_handle_close(h);
+    loader_service_release(svc);
+
+    END_TEST;
+}
+
 int main(int argc, char** argv);
 static bool dladdr_main_test(void) {
     BEGIN_TEST;
@@ -187,6 +293,8 @@ BEGIN_TEST_CASE(dlfcn_tests)
 RUN_TEST(dlopen_vmo_test);
 RUN_TEST(loader_service_test);
 RUN_TEST(clone_test);
+RUN_TEST(load_objects_test);
+RUN_TEST(loader_cache_test);
 RUN_TEST(dladdr_main_test);
 END_TEST_CASE(dlfcn_tests)
 
@@ -0,0 +1,607 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_call.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <fdio/watcher.h>
+#include <inet6/inet6.h>
+#include <inet6/netifc.h>
+#include <unittest/unittest.h>
+#include <zircon/device/device.h>
+#include <zircon/device/ethernet.h>
+#include <zircon/device/ethertap.h>
+#include <zircon/device/sysinfo.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+#include <zx/fifo.h>
+#include <zx/socket.h>
+#include <zx/vmar.h>
+#include <zx/vmo.h>
+
+// Measures packet rates and latency through the ethernet driver, its fifo
+// clients and inet6, against an ethertap device so as to run under QEMU.
+//
+// Every result is also written to RESULT_FILE, as a JSON list of
+// {"label", "test_suite", "unit", "values"} objects for regression tracking.
+
+#define RESULT_FILE "/tmp/ethernet-bench.json"
+#define TEST_SUITE "zircon.ethernet_benchmarks"
+
+namespace {
+
+const char kEthernetDir[] = "/dev/class/ethernet";
+const char kTapctl[] = "/dev/misc/tapctl";
+const char kSysinfo[] = "/dev/misc/sysinfo";
+const uint8_t kTapMac[] = {0x12, 0x20, 0x30, 0x40, 0x50, 0x60};
+const uint8_t kPeerMac[] = {0x12, 0x20, 0x30, 0x40, 0x50, 0x61};
+
+// Largest frame, header included, that the tap device passes.
+constexpr uint32_t kTapMtu = ETH_MTU;
+constexpr uint32_t kHeaderSize = sizeof(ethertap_socket_header_t);
+
+constexpr uint32_t kBufCount = 256;
+constexpr uint32_t kBufSize = 2048;
+
+constexpr uint32_t kPacketCount = 20000;
+constexpr uint32_t kRoundTrips = 2000;
+
+// How long the far side waits for a packet before taking the rest as dropped.
+constexpr zx_duration_t kIdleTimeout = ZX_SEC(1);
+
+struct Result {
+    char label[64];
+    const char* unit;
+    double value;
+};
+
+fbl::Vector<Result> results;
+
+void Report(const char* unit, double value, const char* fmt, ...) __PRINTFLIKE(3, 4);
+
+void Report(const char* unit, double value, const char* fmt, ...) {
+    Result result;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(result.label, sizeof(result.label), fmt, ap);
+    va_end(ap);
+    result.unit = unit;
+    result.value = value;
+    printf("\nBenchmark %-32s: [%12.2f] %s", result.label, value, unit);
+    results.push_back(result);
+}
+
+bool WriteResults(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f == nullptr) {
+        return false;
+    }
+    fprintf(f, "[");
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(f, "%s\n  {\"label\": \"%s\", \"test_suite\": \"%s\", "
+                   "\"unit\": \"%s\", \"values\": [%.3f]}",
+                i ? "," : "", results[i].label, TEST_SUITE, results[i].unit, results[i].value);
+    }
+    fprintf(f, "\n]\n");
+    return fclose(f) == 0;
+}
+
+double Seconds(zx_duration_t duration) {
+    return static_cast<double>(duration) / static_cast<double>(ZX_SEC(1));
+}
+
+// Measures the CPU time spent on every CPU together, from the idle time the
+// kernel keeps for each. This needs the root resource; without it, CPU use
+// goes unreported.
+class CpuMeter {
+public:
+    CpuMeter() {
+        int fd = open(kSysinfo, O_RDWR);
+        if (fd >= 0) {
+            if (ioctl_sysinfo_get_root_resource(fd, &root_) != sizeof(root_)) {
+                root_ = ZX_HANDLE_INVALID;
+            }
+            close(fd);
+        }
+    }
+    ~CpuMeter() { zx_handle_close(root_); }
+
+    bool valid() const { return root_ != ZX_HANDLE_INVALID; }
+
+    void Start() {
+        start_ = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        start_idle_ = Idle(&cpus_);
+    }
+
+    // CPU time spent since Start().
+    zx_duration_t Busy() const {
+        size_t cpus;
+        zx_duration_t idle = Idle(&cpus) - start_idle_;
+        zx_duration_t all = (zx_clock_get(ZX_CLOCK_MONOTONIC) - start_) * cpus_;
+        return (all > idle) ? all - idle : 0;
+    }
+
+private:
+    zx_duration_t Idle(size_t* cpus) const {
+        zx_info_cpu_stats_t stats[32];
+        size_t actual, avail;
+        *cpus = 0;
+        if (!valid() || zx_object_get_info(root_, ZX_INFO_CPU_STATS, stats, sizeof(stats),
+                                           &actual, &avail) != ZX_OK) {
+            return 0;
+        }
+        zx_duration_t idle = 0;
+        for (size_t i = 0; i < actual; i++) {
+            if (stats[i].flags & ZX_INFO_CPU_STATS_FLAG_ONLINE) {
+                idle += stats[i].idle_time;
+                (*cpus)++;
+            }
+        }
+        return idle;
+    }
+
+    zx_handle_t root_ = ZX_HANDLE_INVALID;
+    zx_time_t start_ = 0;
+    zx_duration_t start_idle_ = 0;
+    size_t cpus_ = 0;
+};
+
+// Reports the rate |count| frames of |size| bytes went through at, out of
+// |sent|, and the CPU time each took.
+void ReportRate(const char* path, size_t size, uint32_t count, uint32_t sent,
+                zx_duration_t elapsed, const CpuMeter& cpu, zx_duration_t busy) {
+    double secs = Seconds(elapsed);
+    Report("packets/second", count / secs, "%s/%zu/pps", path, size);
+    Report("Gbits/second", static_cast<double>(count) * size * 8 / secs / 1e9,
+           "%s/%zu/throughput", path, size);
+    Report("packets", sent - count, "%s/%zu/dropped", path, size);
+    if (cpu.valid() && count > 0) {
+        Report("nanoseconds", static_cast<double>(busy) / count, "%s/%zu/cpu_per_packet",
+               path, size);
+    }
+}
+
+zx_status_t WatchCb(int dirfd, int event, const char* fn, void* cookie) {
+    if (event != WATCH_EVENT_ADD_FILE) return ZX_OK;
+    if (!strcmp(fn, ".") || !strcmp(fn, "..")) return ZX_OK;
+
+    int devfd = openat(dirfd, fn, O_RDWR);
+    if (devfd < 0) {
+        return ZX_OK;
+    }
+    eth_info_t info;
+    if (ioctl_ethernet_get_info(devfd, &info) < 0 || !(info.features & ETH_FEATURE_SYNTH) ||
+        memcmp(info.mac, kTapMac, sizeof(kTapMac))) {
+        close(devfd);
+        return ZX_OK;
+    }
+    *reinterpret_cast<int*>(cookie) = devfd;
+    return ZX_ERR_STOP;
+}
+
+// An ethertap device, and a client of the ethernet device it creates.
+class TapClient {
+public:
+    ~TapClient() {
+        if (mapped_ != 0) {
+            zx::vmar::root_self().unmap(mapped_, kBufCount * 2 * kBufSize);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        // Give devmgr time to take the device down before the next one.
+        sock_.reset();
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(200)));
+    }
+
+    // Creates the device. With |client| false, it is left for others to open.
+    bool Init(const char* name, bool client = true) {
+        BEGIN_HELPER;
+        int ctlfd = open(kTapctl, O_RDONLY);
+        ASSERT_GE(ctlfd, 0, "could not open tapctl");
+        ethertap_ioctl_config_t config = {};
+        strlcpy(config.name, name, ETHERTAP_MAX_NAME_LEN);
+        config.mtu = kTapMtu;
+        memcpy(config.mac, kTapMac, sizeof(kTapMac));
+        ssize_t rc = ioctl_ethertap_config(ctlfd, &config, sock_.reset_and_get_address());
+        close(ctlfd);
+        ASSERT_GE(rc, 0, "could not configure ethertap device");
+        ASSERT_EQ(sock_.signal_peer(0, ETHERTAP_SIGNAL_ONLINE), ZX_OK);
+
+        int dirfd = open(kEthernetDir, O_RDONLY);
+        ASSERT_GE(dirfd, 0);
+        zx_status_t status = fdio_watch_directory(dirfd, WatchCb, zx_deadline_after(ZX_SEC(2)),
+                                                  &fd_);
+        close(dirfd);
+        ASSERT_EQ(status, ZX_ERR_STOP, "could not find ethertap device");
+        if (!client) {
+            return true;
+        }
+
+        ASSERT_GE(ioctl_ethernet_set_client_name(fd_, name, strlen(name) + 1), 0);
+        eth_fifos_t fifos;
+        ASSERT_GE(ioctl_ethernet_get_fifos(fd_, &fifos), 0);
+        tx_.reset(fifos.tx_fifo);
+        rx_.reset(fifos.rx_fifo);
+
+        // The first half of the buffers is for rx and the second for tx.
+        zx::vmo vmo;
+        ASSERT_EQ(zx::vmo::create(kBufCount * 2 * kBufSize, 0, &vmo), ZX_OK);
+        ASSERT_EQ(zx::vmar::root_self().map(0, vmo, 0, kBufCount * 2 * kBufSize,
+                                            ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                                            &mapped_),
+                  ZX_OK);
+        zx_handle_t h = vmo.release();
+        ASSERT_GE(ioctl_ethernet_set_iobuf(fd_, &h), 0);
+
+        uint32_t rx_count = fbl::min(kBufCount, fifos.rx_depth);
+        for (uint32_t i = 0; i < rx_count; i++) {
+            eth_fifo_entry_t entry = {i * kBufSize, kBufSize, 0, nullptr};
+            uint32_t actual;
+            ASSERT_EQ(rx_.write(&entry, sizeof(entry), &actual), ZX_OK);
+        }
+        tx_depth_ = fbl::min(kBufCount, fifos.tx_depth);
+        for (uint32_t i = 0; i < tx_depth_; i++) {
+            tx_free_[i] = (kBufCount + i) * kBufSize;
+        }
+        tx_free_count_ = tx_depth_;
+
+        ASSERT_GE(ioctl_ethernet_start(fd_), 0);
+        END_HELPER;
+    }
+
+    zx::socket* sock() { return &sock_; }
+    int fd() const { return fd_; }
+
+    // Queues up to |count| frames of |size| bytes for transmit, waiting for
+    // earlier ones to complete if need be. Returns how many were queued.
+    uint32_t Send(size_t size, uint32_t count) {
+        Reclaim(tx_free_count_ == 0);
+        eth_fifo_entry_t entries[kBufCount];
+        uint32_t n = fbl::min(count, tx_free_count_);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t offset = tx_free_[--tx_free_count_];
+            FillFrame(reinterpret_cast<uint8_t*>(mapped_) + offset, size);
+            entries[i] = {offset, static_cast<uint16_t>(size), 0, nullptr};
+        }
+        uint32_t actual = 0;
+        if (n > 0 && tx_.write(entries, sizeof(entries[0]) * n, &actual) != ZX_OK) {
+            actual = 0;
+        }
+        for (uint32_t i = actual; i < n; i++) {
+            tx_free_[tx_free_count_++] = entries[i].offset;
+        }
+        return actual;
+    }
+
+    // Takes back transmitted buffers, waiting for some if |wait|.
+    void Reclaim(bool wait) {
+        if (wait) {
+            tx_.wait_one(ZX_FIFO_READABLE, zx::deadline_after(zx::duration(kIdleTimeout)),
+                         nullptr);
+        }
+        eth_fifo_entry_t entries[kBufCount];
+        uint32_t actual;
+        if (tx_.read(entries, sizeof(entries), &actual) == ZX_OK) {
+            for (uint32_t i = 0; i < actual; i++) {
+                tx_free_[tx_free_count_++] = entries[i].offset;
+            }
+        }
+    }
+
+    // Waits for received frames, handing their buffers straight back to the
+    // device. Returns how many came in, or 0 once none have for kIdleTimeout.
+    uint32_t Receive() {
+        zx_signals_t pending;
+        if (rx_.wait_one(ZX_FIFO_READABLE, zx::deadline_after(zx::duration(kIdleTimeout)),
+                         &pending) != ZX_OK) {
+            return 0;
+        }
+        eth_fifo_entry_t entries[kBufCount];
+        uint32_t actual;
+        if (rx_.read(entries, sizeof(entries), &actual) != ZX_OK) {
+            return 0;
+        }
+        for (uint32_t i = 0; i < actual; i++) {
+            entries[i].length = kBufSize;
+            entries[i].flags = 0;
+        }
+        uint32_t requeued;
+        rx_.write(entries, sizeof(entries[0]) * actual, &requeued);
+        return actual;
+    }
+
+    // Addresses frames from the peer to the tap device, so that whichever
+    // way they go they pass the driver's filter.
+    static void FillFrame(uint8_t* frame, size_t size) {
+        memcpy(frame, kTapMac, 6);
+        memcpy(frame + 6, kPeerMac, 6);
+        frame[12] = 0x88;
+        frame[13] = 0xb5;
+        memset(frame + ETH_HDR_LEN, 0xa5, size - ETH_HDR_LEN);
+    }
+
+private:
+    zx::socket sock_;
+    int fd_ = -1;
+    zx::fifo tx_;
+    zx::fifo rx_;
+    uintptr_t mapped_ = 0;
+    uint32_t tx_depth_ = 0;
+    uint32_t tx_free_[kBufCount];
+    uint32_t tx_free_count_ = 0;
+};
+
+// Reads frames from the far side of a tap device on a thread of its own,
+// until |expected| have arrived or none have for kIdleTimeout. With |echo|,
+// each frame is written straight back to the device.
+class SocketReader {
+public:
+    SocketReader(zx::socket* sock, uint32_t expected, bool echo = false)
+        : sock_(sock), expected_(expected), echo_(echo) {}
+
+    bool Start() {
+        return thrd_create(&thread_, [](void* arg) {
+            return static_cast<SocketReader*>(arg)->Run();
+        }, this) == thrd_success;
+    }
+
+    // Returns how many frames arrived, and when the last did.
+    uint32_t Join(zx_time_t* last) {
+        thrd_join(thread_, nullptr);
+        *last = last_;
+        return count_;
+    }
+
+private:
+    int Run() {
+        uint8_t buf[kHeaderSize + ETHERTAP_MAX_MTU];
+        while (count_ < expected_) {
+            zx_signals_t pending;
+            if (sock_->wait_one(ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED,
+                                zx::deadline_after(zx::duration(kIdleTimeout)),
+                                &pending) != ZX_OK ||
+                !(pending & ZX_SOCKET_READABLE)) {
+                break;
+            }
+            size_t actual;
+            while (sock_->read(0, buf, sizeof(buf), &actual) == ZX_OK) {
+                auto header = reinterpret_cast<ethertap_socket_header_t*>(buf);
+                if (actual < kHeaderSize || header->type != ETHERTAP_MSG_PACKET) {
+                    continue;
+                }
+                if (echo_) {
+                    sock_->write(0, buf + kHeaderSize, actual - kHeaderSize, nullptr);
+                }
+                count_++;
+                last_ = zx_clock_get(ZX_CLOCK_MONOTONIC);
+            }
+        }
+        return 0;
+    }
+
+    zx::socket* const sock_;
+    const uint32_t expected_;
+    const bool echo_;
+    thrd_t thread_;
+    uint32_t count_ = 0;
+    zx_time_t last_ = 0;
+};
+
+// Writes |count| frames of |size| bytes into the far side of a tap device,
+// waiting whenever its socket is full.
+struct SocketWriter {
+    zx::socket* sock;
+    size_t size;
+    uint32_t count;
+
+    static int Run(void* arg) {
+        auto writer = static_cast<SocketWriter*>(arg);
+        uint8_t frame[ETHERTAP_MAX_MTU];
+        TapClient::FillFrame(frame, writer->size);
+        for (uint32_t i = 0; i < writer->count;) {
+            zx_status_t status = writer->sock->write(0, frame, writer->size, nullptr);
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                writer->sock->wait_one(ZX_SOCKET_WRITABLE, zx::time::infinite(), nullptr);
+            } else if (status != ZX_OK) {
+                return -1;
+            } else {
+                i++;
+            }
+        }
+        return 0;
+    }
+};
+
+// Frames sent by an ethernet client, through the driver, to the device.
+template <size_t FrameSize>
+bool benchmark_eth_tx() {
+    BEGIN_TEST;
+    TapClient tap;
+    ASSERT_TRUE(tap.Init(__func__));
+    SocketReader reader(tap.sock(), kPacketCount);
+    ASSERT_TRUE(reader.Start());
+
+    CpuMeter cpu;
+    cpu.Start();
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (uint32_t sent = 0; sent < kPacketCount;) {
+        sent += tap.Send(FrameSize, kPacketCount - sent);
+    }
+    zx_time_t last;
+    uint32_t count = reader.Join(&last);
+    zx_duration_t busy = cpu.Busy();
+    ASSERT_GT(count, 0u, "no frames reached the device");
+
+    ReportRate("Ethernet/Tx", FrameSize, count, kPacketCount, last - start, cpu, busy);
+    END_TEST;
+}
+
+// Frames from the device, through the driver, to an ethernet client.
+template <size_t FrameSize>
+bool benchmark_eth_rx() {
+    BEGIN_TEST;
+    TapClient tap;
+    ASSERT_TRUE(tap.Init(__func__));
+    SocketWriter writer = {tap.sock(), FrameSize, kPacketCount};
+    thrd_t thread;
+
+    CpuMeter cpu;
+    cpu.Start();
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    ASSERT_EQ(thrd_create(&thread, &SocketWriter::Run, &writer), thrd_success);
+    uint32_t count = 0;
+    zx_time_t last = start;
+    while (count < kPacketCount) {
+        uint32_t n = tap.Receive();
+        if (n == 0) {
+            break;
+        }
+        count += n;
+        last = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    }
+    zx_duration_t busy = cpu.Busy();
+    int result;
+    thrd_join(thread, &result);
+    ASSERT_EQ(result, 0, "could not write frames to the device");
+    ASSERT_GT(count, 0u, "no frames reached the client");
+
+    ReportRate("Ethernet/Rx", FrameSize, count, kPacketCount, last - start, cpu, busy);
+    END_TEST;
+}
+
+// One frame at a time from an ethernet client out to the device, which sends
+// it straight back: the latency of both fifos and the driver in between.
+template <size_t FrameSize>
+bool benchmark_eth_round_trip() {
+    BEGIN_TEST;
+    TapClient tap;
+    ASSERT_TRUE(tap.Init(__func__));
+    SocketReader echo(tap.sock(), kRoundTrips, true);
+    ASSERT_TRUE(echo.Start());
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zx_duration_t[]> samples(new (&ac) zx_duration_t[kRoundTrips]);
+    ASSERT_TRUE(ac.check());
+    uint32_t count = 0;
+    for (; count < kRoundTrips; count++) {
+        zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        if (tap.Send(FrameSize, 1) != 1 || tap.Receive() != 1) {
+            break;
+        }
+        samples[count] = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+        tap.Reclaim(false);
+    }
+    zx_time_t last;
+    echo.Join(&last);
+    ASSERT_EQ(count, kRoundTrips, "frame lost on the round trip");
+
+    qsort(samples.get(), count, sizeof(samples[0]), [](const void* a, const void* b) {
+        zx_duration_t x = *static_cast<const zx_duration_t*>(a);
+        zx_duration_t y = *static_cast<const zx_duration_t*>(b);
+        return (x < y) ? -1 : (x > y) ? 1 : 0;
+    });
+    Report("microseconds", static_cast<double>(samples[0]) / ZX_USEC(1),
+           "Ethernet/RoundTrip/%zu/min", FrameSize);
+    Report("microseconds", static_cast<double>(samples[count / 2]) / ZX_USEC(1),
+           "Ethernet/RoundTrip/%zu/median", FrameSize);
+    Report("microseconds", static_cast<double>(samples[count * 99 / 100]) / ZX_USEC(1),
+           "Ethernet/RoundTrip/%zu/p99", FrameSize);
+    END_TEST;
+}
+
+// UDP datagrams sent through inet6 and its ethernet client, as netsvc sends
+// them, to the device.
+template <size_t PayloadSize>
+bool benchmark_inet6_udp_tx() {
+    BEGIN_TEST;
+    TapClient tap;
+    ASSERT_TRUE(tap.Init(__func__, false));
+    char path[1024];
+    ssize_t rc = ioctl_device_get_topo_path(tap.fd(), path, sizeof(path));
+    ASSERT_GT(rc, 0);
+    ASSERT_EQ(netifc_open(path), 0, "could not open the tap device with netifc");
+    auto cleanup = fbl::MakeAutoCall([]() { netifc_close(); });
+    ASSERT_LE(PayloadSize, udp6_max_payload());
+
+    SocketReader reader(tap.sock(), kPacketCount);
+    ASSERT_TRUE(reader.Start());
+    uint8_t payload[PayloadSize];
+    memset(payload, 0xa5, sizeof(payload));
+
+    CpuMeter cpu;
+    cpu.Start();
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    uint32_t sent = 0;
+    for (; sent < kPacketCount; sent++) {
+        zx_status_t status;
+        while ((status = udp6_send(payload, sizeof(payload), &ip6_ll_all_nodes, 33340, 33340,
+                                   false)) == ZX_ERR_SHOULD_WAIT) {
+            thrd_yield();
+        }
+        if (status != ZX_OK) {
+            break;
+        }
+    }
+    zx_time_t last;
+    uint32_t count = reader.Join(&last);
+    zx_duration_t busy = cpu.Busy();
+    ASSERT_EQ(sent, kPacketCount, "udp6_send failed");
+    ASSERT_GT(count, 0u, "no datagrams reached the device");
+
+    ReportRate("Inet6/UdpTx", PayloadSize, count, kPacketCount, last - start, cpu, busy);
+    END_TEST;
+}
+
+} // namespace
+
+// inet6 hands received packets to its user; nothing is expected here.
+void udp6_recv(void* data, size_t len, const ip6_addr_t* daddr, uint16_t dport,
+               const ip6_addr_t* saddr, uint16_t sport) {}
+
+void netifc_recv(void* data, size_t len) {
+    eth_recv(data, len);
+}
+
+bool netifc_send_pending(void) {
+    return false;
+}
+
+#define RUN_FOR_ALL_FRAME_SIZES(test)          \
+    RUN_TEST_PERFORMANCE((test<60>))           \
+    RUN_TEST_PERFORMANCE((test<128>))          \
+    RUN_TEST_PERFORMANCE((test<512>))          \
+    RUN_TEST_PERFORMANCE((test<1024>))         \
+    RUN_TEST_PERFORMANCE((test<ETH_MTU>))
+
+BEGIN_TEST_CASE(ethernet_benchmarks)
+RUN_FOR_ALL_FRAME_SIZES(benchmark_eth_tx)
+RUN_FOR_ALL_FRAME_SIZES(benchmark_eth_rx)
+RUN_TEST_PERFORMANCE((benchmark_eth_round_trip<60>))
+RUN_TEST_PERFORMANCE((benchmark_eth_round_trip<ETH_MTU>))
+RUN_TEST_PERFORMANCE((benchmark_inet6_udp_tx<64>))
+RUN_TEST_PERFORMANCE((benchmark_inet6_udp_tx<512>))
+RUN_TEST_PERFORMANCE((benchmark_inet6_udp_tx<1452>))
+END_TEST_CASE(ethernet_benchmarks)
+
+int main(int argc, char** argv) {
+    bool success = unittest_run_all_tests(argc, argv);
+    if (!WriteResults(RESULT_FILE)) {
+        fprintf(stderr, "could not write %s\n", RESULT_FILE);
+    }
+    return success ? 0 : -1;
+}
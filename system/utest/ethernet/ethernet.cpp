@@ -268,6 +268,21 @@ public:
         return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
     }
 
+    zx_status_t GetInfo(eth_info_t* info) {
+        ssize_t rc = ioctl_ethernet_get_info(fd_, info);
+        return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
+    }
+
+    zx_status_t GetQueueFifos(uint32_t queue, eth_fifos_t* fifos) {
+        ssize_t rc = ioctl_ethernet_get_queue_fifos(fd_, &queue, fifos);
+        return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
+    }
+
+    zx_status_t GetStats(eth_stats_t* stats) {
+        ssize_t rc = ioctl_ethernet_get_stats(fd_, stats);
+        return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
+    }
+
     zx_status_t SetPromisc(bool on) {
         ssize_t rc = ioctl_ethernet_set_promisc(fd_, &on);
         return rc < 0 ? static_cast<zx_status_t>(rc) : ZX_OK;
@@ -541,6 +556,44 @@ static bool EthernetLinkStatusTest() {
     END_TEST;
 }
 
+static bool EthernetQueueFifosTest() {
+    BEGIN_TEST;
+
+    zx::socket sock;
+    EthernetClient client;
+    EthernetOpenInfo info(__func__);
+    info.online = false;
+    ASSERT_TRUE(OpenFirstClientHelper(&sock, &client, info));
+
+    eth_info_t eth_info;
+    ASSERT_EQ(ZX_OK, client.GetInfo(&eth_info));
+    ASSERT_GE(eth_info.queues, 1u);
+    ASSERT_LE(eth_info.queues, ETH_MAX_QUEUES);
+
+    // Queue 0 belongs to the fifos obtained at registration
+    eth_fifos_t fifos;
+    EXPECT_EQ(ZX_ERR_ALREADY_BOUND, client.GetQueueFifos(0, &fifos));
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, client.GetQueueFifos(eth_info.queues, &fifos));
+
+    if (eth_info.queues > 1) {
+        ASSERT_EQ(ZX_OK, client.GetQueueFifos(1, &fifos));
+        zx::fifo tx(fifos.tx_fifo);
+        zx::fifo rx(fifos.rx_fifo);
+        EXPECT_EQ(client.tx_depth(), fifos.tx_depth);
+        EXPECT_EQ(client.rx_depth(), fifos.rx_depth);
+        EXPECT_EQ(ZX_ERR_ALREADY_BOUND, client.GetQueueFifos(1, &fifos));
+    }
+
+    // Fifos may not be obtained once started
+    EXPECT_EQ(ZX_OK, client.Start());
+    if (eth_info.queues > 2) {
+        EXPECT_EQ(ZX_ERR_BAD_STATE, client.GetQueueFifos(2, &fifos));
+    }
+
+    ASSERT_TRUE(EthernetCleanupHelper(&sock, &client));
+    END_TEST;
+}
+
 static bool EthernetSetPromiscMultiClientTest() {
     BEGIN_TEST;
 
@@ -822,6 +875,71 @@ static bool EthernetDataTest_Send() {
     END_TEST;
 }
 
+static bool EthernetDataTest_SendCsumOffload() {
+    BEGIN_TEST;
+    zx::socket sock;
+    EthernetClient client;
+    EthernetOpenInfo info(__func__);
+    ASSERT_TRUE(OpenFirstClientHelper(&sock, &client, info));
+
+    auto entry = client.GetTxBuffer();
+    ASSERT_TRUE(entry != nullptr);
+
+    // Ask for the checksum of a UDP-like frame, which the ethertap device leaves
+    // to the ethernet driver.
+    constexpr uint16_t kCsumStart = 14;
+    constexpr uint16_t kCsumOffset = 6;
+    uint8_t* buf = static_cast<uint8_t*>(entry->cookie);
+    eth_offload_t offload = {};
+    offload.flags = ETH_OFFLOAD_CSUM;
+    offload.csum_start = kCsumStart;
+    offload.csum_offset = kCsumOffset;
+    memcpy(buf, &offload, sizeof(offload));
+    uint8_t* frame = buf + sizeof(offload);
+    for (int i = 0; i < 33; i++) {
+        frame[i] = static_cast<uint8_t>((i * 7) & 0xff);
+    }
+    frame[kCsumStart + kCsumOffset] = 0;
+    frame[kCsumStart + kCsumOffset + 1] = 0;
+    entry->length = static_cast<uint16_t>(sizeof(offload) + 33);
+    entry->flags = ETH_FIFO_TX_OFFLOAD;
+
+    uint8_t expected[33];
+    memcpy(expected, frame, sizeof(expected));
+    uint32_t sum = 0;
+    for (size_t i = kCsumStart; i < sizeof(expected); i += 2) {
+        sum += static_cast<uint32_t>(expected[i] << 8) |
+               (i + 1 < sizeof(expected) ? expected[i + 1] : 0);
+    }
+    while (sum > 0xffff) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    uint16_t csum = static_cast<uint16_t>(~sum);
+    expected[kCsumStart + kCsumOffset] = static_cast<uint8_t>(csum >> 8);
+    expected[kCsumStart + kCsumOffset + 1] = static_cast<uint8_t>(csum);
+
+    uint32_t actual = 0;
+    ASSERT_EQ(ZX_OK, client.tx_fifo()->write(entry, sizeof(eth_fifo_entry_t), &actual));
+    EXPECT_EQ(1u, actual);
+
+    // Only the frame goes out, checksummed.
+    ExpectPacketRead(&sock, sizeof(expected), expected, "");
+
+    // The entry comes back as it was sent.
+    zx_signals_t obs;
+    EXPECT_EQ(ZX_OK, client.tx_fifo()->wait_one(ZX_FIFO_READABLE, FAIL_TIMEOUT, &obs));
+    eth_fifo_entry_t return_entry;
+    ASSERT_EQ(ZX_OK, client.tx_fifo()->read(&return_entry, sizeof(eth_fifo_entry_t), &actual));
+    EXPECT_EQ(1u, actual);
+    EXPECT_TRUE(return_entry.flags & ETH_FIFO_TX_OK);
+    EXPECT_EQ(entry->offset, return_entry.offset);
+    EXPECT_EQ(entry->length, return_entry.length);
+    client.ReturnTxBuffer(&return_entry);
+
+    ASSERT_TRUE(EthernetCleanupHelper(&sock, &client));
+    END_TEST;
+}
+
 static bool EthernetDataTest_Recv() {
     BEGIN_TEST;
     zx::socket sock;
@@ -865,6 +983,18 @@ static bool EthernetDataTest_Recv() {
     EXPECT_EQ(ZX_OK, client.rx_fifo()->write(&entry, sizeof(eth_fifo_entry_t), &actual_entries));
     EXPECT_EQ(1, actual_entries);
 
+    // The frame was counted on exactly one queue
+    eth_stats_t stats;
+    ASSERT_EQ(ZX_OK, client.GetStats(&stats));
+    uint64_t rx_packets = 0;
+    uint64_t rx_dropped = 0;
+    for (uint32_t i = 0; i < stats.queues; i++) {
+        rx_packets += stats.queue[i].rx_packets;
+        rx_dropped += stats.queue[i].rx_dropped;
+    }
+    EXPECT_EQ(1u, rx_packets);
+    EXPECT_EQ(0u, rx_dropped);
+
     ASSERT_TRUE(EthernetCleanupHelper(&sock, &client));
     END_TEST;
 }
@@ -872,6 +1002,7 @@ static bool EthernetDataTest_Recv() {
 BEGIN_TEST_CASE(EthernetSetupTests)
 RUN_TEST_MEDIUM(EthernetStartTest)
 RUN_TEST_MEDIUM(EthernetLinkStatusTest)
+RUN_TEST_MEDIUM(EthernetQueueFifosTest)
 END_TEST_CASE(EthernetSetupTests)
 
 BEGIN_TEST_CASE(EthernetConfigTests)
@@ -887,6 +1018,7 @@ END_TEST_CASE(EthernetConfigTests)
 
 BEGIN_TEST_CASE(EthernetDataTests)
 RUN_TEST_MEDIUM(EthernetDataTest_Send)
+RUN_TEST_MEDIUM(EthernetDataTest_SendCsumOffload)
 RUN_TEST_MEDIUM(EthernetDataTest_Recv)
 END_TEST_CASE(EthernetDataTests)
 
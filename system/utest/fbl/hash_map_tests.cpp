@@ -0,0 +1,225 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <time.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/hash_map.h>
+#include <fbl/intrusive_hash_table.h>
+#include <fbl/intrusive_single_list.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+
+namespace fbl {
+namespace tests {
+namespace {
+
+// Counts the instances alive, to check that the map destroys what it holds.
+struct Counted {
+    explicit Counted(uint64_t v) : value(v) { ++live; }
+    Counted(Counted&& other) : value(other.value) { ++live; }
+    Counted& operator=(Counted&& other) {
+        value = other.value;
+        return *this;
+    }
+    ~Counted() { --live; }
+
+    uint64_t value;
+    static size_t live;
+};
+size_t Counted::live = 0;
+
+struct FailingAllocatorTraits {
+    static void* Allocate(size_t size) { return nullptr; }
+    static void Deallocate(void* object) { ZX_ASSERT(object == nullptr); }
+};
+
+// A hash which puts every key in the same group, so that lookups have to
+// probe past full groups.
+struct CollidingTraits {
+    static uint64_t Hash(const uint64_t& key) { return 0; }
+    static bool EqualTo(const uint64_t& a, const uint64_t& b) { return a == b; }
+};
+
+template <typename Traits>
+bool insert_find_erase_test() {
+    BEGIN_TEST;
+
+    constexpr uint64_t kCount = 1000;
+    HashMap<uint64_t, uint64_t, Traits> map;
+    EXPECT_TRUE(map.is_empty());
+    EXPECT_NULL(map.find(1));
+    EXPECT_FALSE(map.erase(1));
+
+    for (uint64_t i = 0; i < kCount; ++i) {
+        AllocChecker ac;
+        map.insert(i * 4096, i, &ac);
+        ASSERT_TRUE(ac.check());
+    }
+    EXPECT_EQ(kCount, map.size());
+    for (uint64_t i = 0; i < kCount; ++i) {
+        uint64_t* value = map.find(i * 4096);
+        ASSERT_NONNULL(value);
+        EXPECT_EQ(i, *value);
+        EXPECT_NULL(map.find(i * 4096 + 1));
+    }
+
+    // Inserting an existing key replaces its value.
+    AllocChecker ac;
+    map.insert(4096, 7, &ac);
+    ASSERT_TRUE(ac.check());
+    EXPECT_EQ(kCount, map.size());
+    EXPECT_EQ(7u, *map.find(4096));
+
+    // Erase every other key, and make sure the rest are still reachable.
+    for (uint64_t i = 0; i < kCount; i += 2) {
+        EXPECT_TRUE(map.erase(i * 4096));
+    }
+    EXPECT_EQ(kCount / 2, map.size());
+    for (uint64_t i = 0; i < kCount; ++i) {
+        EXPECT_EQ(i % 2 == 1, map.find(i * 4096) != nullptr);
+    }
+
+    size_t sum = 0;
+    map.for_each([&sum](const uint64_t& key, uint64_t& value) { sum += key / 4096; });
+    EXPECT_EQ((kCount / 2) * (kCount / 2), sum);
+
+    END_TEST;
+}
+
+// Inserting and erasing in a steady state must not keep growing the table.
+bool churn_test() {
+    BEGIN_TEST;
+
+    HashMap<uint64_t, uint64_t> map;
+    for (uint64_t i = 0; i < 100000; ++i) {
+        AllocChecker ac;
+        map.insert(i, i, &ac);
+        ASSERT_TRUE(ac.check());
+        if (i >= 50) {
+            ASSERT_TRUE(map.erase(i - 50));
+        }
+    }
+    EXPECT_EQ(50u, map.size());
+    EXPECT_LE(map.capacity(), 128u);
+    for (uint64_t i = 100000 - 50; i < 100000; ++i) {
+        EXPECT_NONNULL(map.find(i));
+    }
+
+    END_TEST;
+}
+
+bool object_lifetime_test() {
+    BEGIN_TEST;
+
+    {
+        HashMap<uint64_t, Counted> map;
+        for (uint64_t i = 0; i < 100; ++i) {
+            AllocChecker ac;
+            map.insert(i, Counted(i), &ac);
+            ASSERT_TRUE(ac.check());
+        }
+        EXPECT_EQ(100u, Counted::live);
+        EXPECT_TRUE(map.erase(5));
+        EXPECT_EQ(99u, Counted::live);
+
+        HashMap<uint64_t, Counted> other(fbl::move(map));
+        EXPECT_TRUE(map.is_empty());
+        EXPECT_EQ(99u, other.size());
+        EXPECT_EQ(99u, Counted::live);
+        EXPECT_EQ(42u, other.find(42)->value);
+    }
+    EXPECT_EQ(0u, Counted::live);
+
+    END_TEST;
+}
+
+bool allocation_failure_test() {
+    BEGIN_TEST;
+
+    HashMap<uint64_t, uint64_t, DefaultHashMapTraits<uint64_t>, FailingAllocatorTraits> map;
+    AllocChecker ac;
+    map.insert(1, 1, &ac);
+    EXPECT_FALSE(ac.check());
+    EXPECT_TRUE(map.is_empty());
+    map.reserve(100, &ac);
+    EXPECT_FALSE(ac.check());
+    EXPECT_EQ(0u, map.capacity());
+
+    END_TEST;
+}
+
+uint64_t NowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + ts.tv_nsec;
+}
+
+struct Node : public SinglyLinkedListable<unique_ptr<Node>> {
+    explicit Node(uint64_t k) : key(k) {}
+    uint64_t GetKey() const { return key; }
+    static size_t GetHash(uint64_t key) { return key; }
+    uint64_t key;
+};
+
+// Compares lookups of present keys in a HashMap<> with the same lookups in
+// an intrusive HashTable<> with its default number of buckets.
+bool lookup_benchmark() {
+    BEGIN_TEST;
+
+    constexpr uint64_t kCount = 10000;
+    constexpr int kRounds = 20;
+
+    HashMap<uint64_t, uint64_t> map;
+    HashTable<uint64_t, unique_ptr<Node>> table;
+    for (uint64_t i = 0; i < kCount; ++i) {
+        AllocChecker ac;
+        map.insert(i * 4096, i, &ac);
+        ASSERT_TRUE(ac.check());
+        unique_ptr<Node> node(new (&ac) Node(i * 4096));
+        ASSERT_TRUE(ac.check());
+        table.insert(fbl::move(node));
+    }
+
+    uint64_t sum = 0;
+    uint64_t start = NowNs();
+    for (int r = 0; r < kRounds; ++r) {
+        for (uint64_t i = 0; i < kCount; ++i) {
+            sum += *map.find(i * 4096);
+        }
+    }
+    uint64_t map_ns = NowNs() - start;
+
+    start = NowNs();
+    for (int r = 0; r < kRounds; ++r) {
+        for (uint64_t i = 0; i < kCount; ++i) {
+            sum += table.find(i * 4096)->key;
+        }
+    }
+    uint64_t table_ns = NowNs() - start;
+    EXPECT_NE(0u, sum);
+
+    printf("\nBenchmark %lu keys: HashMap %6.1f ns, HashTable %6.1f ns per lookup",
+           static_cast<unsigned long>(kCount),
+           static_cast<double>(map_ns) / (kCount * kRounds),
+           static_cast<double>(table_ns) / (kCount * kRounds));
+    table.clear();
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(hash_map_tests)
+RUN_TEST(insert_find_erase_test<DefaultHashMapTraits<uint64_t>>)
+RUN_TEST(insert_find_erase_test<CollidingTraits>)
+RUN_TEST(churn_test)
+RUN_TEST(object_lifetime_test)
+RUN_TEST(allocation_failure_test)
+RUN_TEST_PERFORMANCE(lookup_benchmark)
+END_TEST_CASE(hash_map_tests)
+
+} // namespace tests
+} // namespace fbl
@@ -0,0 +1,116 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/alloc_checker.h>
+#include <fbl/inline_vector.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+
+namespace fbl {
+namespace tests {
+namespace {
+
+struct FailingAllocatorTraits {
+    static void* Allocate(size_t size) { return nullptr; }
+    static void Deallocate(void* object) { ZX_ASSERT(object == nullptr); }
+};
+
+bool inline_then_heap_test() {
+    BEGIN_TEST;
+
+    InlineVector<size_t, 4> vec;
+    EXPECT_TRUE(vec.is_empty());
+    EXPECT_TRUE(vec.is_inline());
+    EXPECT_EQ(4u, vec.capacity());
+
+    for (size_t i = 0; i < 4; ++i) {
+        AllocChecker ac;
+        vec.push_back(i, &ac);
+        ASSERT_TRUE(ac.check());
+    }
+    EXPECT_TRUE(vec.is_inline());
+
+    for (size_t i = 4; i < 100; ++i) {
+        AllocChecker ac;
+        vec.push_back(i, &ac);
+        ASSERT_TRUE(ac.check());
+    }
+    EXPECT_FALSE(vec.is_inline());
+    EXPECT_EQ(100u, vec.size());
+    for (size_t i = 0; i < 100; ++i) {
+        EXPECT_EQ(i, vec[i]);
+    }
+
+    vec.pop_back();
+    EXPECT_EQ(99u, vec.size());
+    vec.reset();
+    EXPECT_TRUE(vec.is_empty());
+    EXPECT_TRUE(vec.is_inline());
+
+    END_TEST;
+}
+
+template <size_t kCount>
+bool move_test() {
+    BEGIN_TEST;
+
+    InlineVector<unique_ptr<size_t>, 4> vec;
+    for (size_t i = 0; i < kCount; ++i) {
+        AllocChecker ac;
+        unique_ptr<size_t> ptr(new (&ac) size_t(i));
+        ASSERT_TRUE(ac.check());
+        vec.push_back(fbl::move(ptr), &ac);
+        ASSERT_TRUE(ac.check());
+    }
+
+    InlineVector<unique_ptr<size_t>, 4> other(fbl::move(vec));
+    EXPECT_TRUE(vec.is_empty());
+    EXPECT_TRUE(vec.is_inline());
+    ASSERT_EQ(kCount, other.size());
+    size_t i = 0;
+    for (const auto& ptr : other) {
+        EXPECT_EQ(i++, *ptr);
+    }
+
+    vec = fbl::move(other);
+    EXPECT_TRUE(other.is_empty());
+    EXPECT_EQ(kCount, vec.size());
+    EXPECT_EQ(kCount - 1, *vec[kCount - 1]);
+
+    END_TEST;
+}
+
+bool allocation_failure_test() {
+    BEGIN_TEST;
+
+    InlineVector<size_t, 2, FailingAllocatorTraits> vec;
+    AllocChecker ac;
+    vec.push_back(0, &ac);
+    EXPECT_TRUE(ac.check());
+    vec.push_back(1, &ac);
+    EXPECT_TRUE(ac.check());
+
+    // The inline storage is full, and growing fails.
+    vec.push_back(2, &ac);
+    EXPECT_FALSE(ac.check());
+    EXPECT_EQ(2u, vec.size());
+    EXPECT_TRUE(vec.is_inline());
+    vec.reserve(10, &ac);
+    EXPECT_FALSE(ac.check());
+    EXPECT_EQ(2u, vec.capacity());
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(inline_vector_tests)
+RUN_TEST(inline_then_heap_test)
+RUN_TEST(move_test<3>)
+RUN_TEST(move_test<10>)
+RUN_TEST(allocation_failure_test)
+END_TEST_CASE(inline_vector_tests)
+
+} // namespace tests
+} // namespace fbl
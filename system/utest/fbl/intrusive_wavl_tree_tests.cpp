@@ -88,6 +88,8 @@ using RPTE = DEFINE_TEST_THUNK(OrderedAssociative, WAVL, RefPtr);
 //    both insert and erase operations, are obeyed.
 // 3) Sufficient code coverage has been achieved during testing (eg. all of the
 //    rebalancing edge cases have been run over the length of the test).
+// 4) The subtree values kept by an observer (here, the number of nodes in each
+//    subtree) are kept up to date through every insert, erase and rotation.
 class WAVLBalanceTestObserver {
 public:
     struct OpCounts {
@@ -138,6 +140,12 @@ public:
     static void RecordEraseRotation()           { ++op_counts_.erase_rotations_; }
     static void RecordEraseDoubleRotation()     { ++op_counts_.erase_double_rotations_; }
 
+    template <typename RawPtrType>
+    static void OnSubtreeChanged(RawPtrType node, RawPtrType left, RawPtrType right) {
+        node->set_subtree_size(1u + (left ? left->subtree_size() : 0u) +
+                               (right ? right->subtree_size() : 0u));
+    }
+
     template <typename TreeType>
     static bool VerifyRankRule(const TreeType& tree, typename TreeType::RawPtrType node) {
         BEGIN_TEST;
@@ -153,6 +161,14 @@ public:
         const auto& ns = NodeTraits::node_state(*node);
         ASSERT_LE(0, ns.rank_, "All ranks must be non-negative.");
 
+        auto left  = TreeType::left_child(node);
+        auto right = TreeType::right_child(node);
+        ASSERT_TRUE(!left  || (TreeType::parent_node(left)  == node));
+        ASSERT_TRUE(!right || (TreeType::parent_node(right) == node));
+        size_t subtree_size = 1u + (left  ? left->subtree_size()  : 0u)
+                                 + (right ? right->subtree_size() : 0u);
+        ASSERT_EQ(subtree_size, node->subtree_size(), "Stale subtree size!");
+
         if (!PtrTraits::IsValid(ns.left_) && !PtrTraits::IsValid(ns.right_)) {
             ASSERT_EQ(0, ns.rank_, "Leaf nodes must have rank 0!");
         } else {
@@ -261,6 +277,9 @@ public:
 
     bool InContainer() const { return wavl_node_state_.InContainer(); }
 
+    size_t subtree_size() const { return subtree_size_; }
+    void set_subtree_size(size_t size) { subtree_size_ = size; }
+
 private:
     friend DefaultWAVLTreeTraits<BalanceTestObjPtr, int32_t>;
 
@@ -272,6 +291,7 @@ private:
 
     BalanceTestKeyType key_;
     BalanceTestObj* erase_deck_ptr_;
+    size_t subtree_size_ = 0u;
     WAVLTreeNodeState<BalanceTestObjPtr, int32_t> wavl_node_state_;
 };
 
@@ -15,7 +15,9 @@ fbl_common_tests := \
     $(LOCAL_DIR)/auto_call_tests.cpp \
     $(LOCAL_DIR)/forward_tests.cpp \
     $(LOCAL_DIR)/function_tests.cpp \
+    $(LOCAL_DIR)/hash_map_tests.cpp \
     $(LOCAL_DIR)/initializer_list_tests.cpp \
+    $(LOCAL_DIR)/inline_vector_tests.cpp \
     $(LOCAL_DIR)/intrusive_container_tests.cpp \
     $(LOCAL_DIR)/intrusive_doubly_linked_list_tests.cpp \
     $(LOCAL_DIR)/intrusive_hash_table_dll_tests.cpp \
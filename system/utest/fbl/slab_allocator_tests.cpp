@@ -8,6 +8,7 @@
 #include <fbl/ref_ptr.h>
 #include <fbl/slab_allocator.h>
 #include <fbl/unique_ptr.h>
+#include <threads.h>
 #include <unittest/unittest.h>
 
 namespace {
@@ -117,12 +118,17 @@ struct ReleaseHelper<SATraits, typename fbl::enable_if<
 };
 
 // Traits which define the various test flavors.
+// Small magazines, so that the tests below overflow and drain them.
+using TestMagazines = fbl::PerThreadSlabMagazines<4, 8>;
+
 template <typename LockType,
-          fbl::SlabAllocatorFlavor AllocatorFlavor = fbl::SlabAllocatorFlavor::INSTANCED>
+          fbl::SlabAllocatorFlavor AllocatorFlavor = fbl::SlabAllocatorFlavor::INSTANCED,
+          typename MagazinePolicy = fbl::NoSlabMagazines>
 struct UnmanagedTestTraits {
     class ObjType;
     using PtrType       = ObjType*;
-    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType, AllocatorFlavor>;
+    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType, AllocatorFlavor,
+                                                   MagazinePolicy>;
     using AllocatorType = fbl::SlabAllocator<AllocTraits>;
     using RefList       = fbl::DoublyLinkedList<PtrType>;
 
@@ -165,11 +171,13 @@ struct UniquePtrTestTraits {
     static constexpr size_t MaxAllocs(size_t slabs) { return AllocatorType::AllocsPerSlab * slabs; }
 };
 
-template <typename LockType>
+template <typename LockType, typename MagazinePolicy = fbl::NoSlabMagazines>
 struct RefPtrTestTraits {
     class ObjType;
     using PtrType       = fbl::RefPtr<ObjType>;
-    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType>;
+    using AllocTraits   = fbl::SlabAllocatorTraits<PtrType, 1024, LockType,
+                                                   fbl::SlabAllocatorFlavor::INSTANCED,
+                                                   MagazinePolicy>;
     using AllocatorType = fbl::SlabAllocator<AllocTraits>;
     using RefList       = fbl::DoublyLinkedList<PtrType>;
 
@@ -428,6 +436,129 @@ bool static_slab_test() {
 
     END_TEST;
 }
+
+bool magazine_stats_test() {
+    BEGIN_TEST;
+
+    using Traits = UnmanagedTestTraits<fbl::Mutex, fbl::SlabAllocatorFlavor::INSTANCED,
+                                       TestMagazines>;
+    typename Traits::AllocatorType allocator(Traits::MaxSlabs);
+    typename Traits::ObjType* objs[16];
+
+    TestBase::Reset();
+
+    fbl::SlabAllocatorStats stats;
+    allocator.GetStats(&stats);
+    EXPECT_EQ(0u, stats.slab_count);
+    EXPECT_EQ(Traits::MaxSlabs, stats.max_slabs);
+    EXPECT_EQ(0u, stats.central_allocs);
+    EXPECT_EQ(0u, stats.magazine_hits);
+    EXPECT_EQ(0u, stats.magazine_spills);
+
+    // Allocations come from the central allocator in batches of half a
+    // magazine; all but the first of each batch is a magazine hit.
+    for (auto& obj : objs) {
+        obj = allocator.New();
+        ASSERT_NONNULL(obj);
+    }
+    allocator.GetStats(&stats);
+    EXPECT_EQ(1u, stats.slab_count);
+    EXPECT_EQ(fbl::count_of(objs), stats.central_allocs);
+    EXPECT_EQ(fbl::count_of(objs) - fbl::count_of(objs) / 4, stats.magazine_hits);
+    EXPECT_EQ(0u, stats.magazine_spills);
+
+    // Freeing twice a magazine's worth of objects spills it twice.
+    for (auto& obj : objs) {
+        delete obj;
+    }
+    allocator.GetStats(&stats);
+    EXPECT_EQ(2u, stats.magazine_spills);
+
+    // The magazine is half full, and the spilled objects are handed out
+    // again by the central allocator without touching a new slab.
+    for (auto& obj : objs) {
+        obj = allocator.New();
+        ASSERT_NONNULL(obj);
+    }
+    allocator.GetStats(&stats);
+    EXPECT_EQ(1u, stats.slab_count);
+    EXPECT_EQ(fbl::count_of(objs) + 8u, stats.central_allocs);
+
+    for (auto& obj : objs) {
+        delete obj;
+    }
+    EXPECT_EQ(0u, TestBase::allocated_obj_count());
+
+    END_TEST;
+}
+
+// TestBase's bookkeeping is not thread safe, so the threaded test uses an
+// object of its own.
+class MagazineObj;
+using MagazineAllocTraits = fbl::ConcurrentSlabAllocatorTraits<MagazineObj*, TestMagazines, 1024>;
+using MagazineAllocator = fbl::SlabAllocator<MagazineAllocTraits>;
+
+class MagazineObj : public fbl::SlabAllocated<MagazineAllocTraits> {
+public:
+    explicit MagazineObj(size_t val) : val_(val) { }
+    size_t val() const { return val_; }
+
+private:
+    size_t val_;
+};
+
+struct MagazineThreadArgs {
+    MagazineAllocator* allocator;
+    size_t failures;
+};
+
+int magazine_thread(void* ctx) {
+    auto args = static_cast<MagazineThreadArgs*>(ctx);
+    MagazineObj* objs[13];
+
+    for (size_t pass = 0; pass < 1000; ++pass) {
+        for (size_t i = 0; i < fbl::count_of(objs); ++i) {
+            objs[i] = args->allocator->New(i);
+        }
+        for (size_t i = 0; i < fbl::count_of(objs); ++i) {
+            if ((objs[i] == nullptr) || (objs[i]->val() != i)) {
+                args->failures++;
+            }
+            if (objs[i] != nullptr) {
+                delete objs[i];
+            }
+        }
+    }
+    return 0;
+}
+
+bool magazine_threads_test() {
+    BEGIN_TEST;
+
+    // More threads than magazines, and enough slabs for every thread to hold
+    // its objects plus whatever the magazines may park.
+    constexpr size_t kThreads = 8;
+    MagazineAllocator allocator(16);
+    MagazineThreadArgs args[kThreads];
+    thrd_t threads[kThreads];
+
+    for (size_t i = 0; i < kThreads; ++i) {
+        args[i] = { &allocator, 0 };
+        ASSERT_EQ(thrd_success, thrd_create(&threads[i], magazine_thread, &args[i]));
+    }
+    for (size_t i = 0; i < kThreads; ++i) {
+        ASSERT_EQ(thrd_success, thrd_join(threads[i], nullptr));
+        EXPECT_EQ(0u, args[i].failures);
+    }
+
+    // Every object went back; the allocator's destructor asserts as much.
+    fbl::SlabAllocatorStats stats;
+    allocator.GetStats(&stats);
+    EXPECT_LE(stats.slab_count, stats.max_slabs);
+    EXPECT_GT(stats.magazine_hits, 0u);
+
+    END_TEST;
+}
 }  // anon namespace
 
 using MutexLock = ::fbl::Mutex;
@@ -461,6 +592,20 @@ RUN_NAMED_TEST("Manual Delete Unmanaged (mutex)",
 RUN_NAMED_TEST("Manual Delete Unmanaged (unlock)",
               (slab_test<UnmanagedTestTraits<NullLock, fbl::SlabAllocatorFlavor::MANUAL_DELETE>>))
 
+RUN_NAMED_TEST("Unmanaged Single Slab (magazines)",
+              (slab_test<UnmanagedTestTraits<MutexLock, fbl::SlabAllocatorFlavor::INSTANCED,
+                                             TestMagazines>, 1>))
+RUN_NAMED_TEST("Unmanaged Multi Slab  (magazines)",
+              (slab_test<UnmanagedTestTraits<MutexLock, fbl::SlabAllocatorFlavor::INSTANCED,
+                                             TestMagazines>>))
+RUN_NAMED_TEST("RefPtr Multi Slab     (magazines)",
+              (slab_test<RefPtrTestTraits<MutexLock, TestMagazines>>))
+RUN_NAMED_TEST("Manual Delete Unmanaged (magazines)",
+              (slab_test<UnmanagedTestTraits<MutexLock, fbl::SlabAllocatorFlavor::MANUAL_DELETE,
+                                             TestMagazines>>))
+RUN_NAMED_TEST("Magazine stats", magazine_stats_test)
+RUN_NAMED_TEST("Magazine threads", magazine_threads_test)
+
 RUN_NAMED_TEST("Static Unmanaged (unlock)", (static_slab_test<StaticUnmanagedTestTraits<NullLock>>))
 RUN_NAMED_TEST("Static UniquePtr (unlock)", (static_slab_test<StaticUniquePtrTestTraits<NullLock>>))
 RUN_NAMED_TEST("Static RefPtr    (unlock)", (static_slab_test<StaticRefPtrTestTraits<NullLock>>))
@@ -0,0 +1,175 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fdio/cache.h>
+#include <zircon/syscalls.h>
+
+#include <unittest/unittest.h>
+
+// /tmp is a memfs, which supports directory watchers.
+#define CACHE_DIR "/tmp/fdio-cache-test"
+#define CACHE_FILE CACHE_DIR "/file"
+
+static bool cache_setup(size_t max_entries, zx_duration_t lease) {
+    BEGIN_HELPER;
+    ASSERT_EQ(mkdir(CACHE_DIR, 0755), 0, "");
+    ASSERT_EQ(fdio_cache_configure(max_entries, lease), ZX_OK, "");
+    END_HELPER;
+}
+
+static bool cache_teardown(void) {
+    BEGIN_HELPER;
+    ASSERT_EQ(fdio_cache_configure(0, 0), ZX_OK, "");
+    unlink(CACHE_FILE);
+    ASSERT_EQ(rmdir(CACHE_DIR), 0, "");
+    END_HELPER;
+}
+
+static bool create_file(const char* path, size_t len) {
+    BEGIN_HELPER;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0, "");
+    char buf[64] = {};
+    ASSERT_LE(len, sizeof(buf), "");
+    ASSERT_EQ(write(fd, buf, len), (ssize_t)len, "");
+    ASSERT_EQ(close(fd), 0, "");
+    END_HELPER;
+}
+
+bool cache_hit_test(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(cache_setup(64, ZX_SEC(60)), "");
+    ASSERT_TRUE(create_file(CACHE_FILE, 10), "");
+
+    struct stat s;
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    ASSERT_EQ(s.st_size, 10, "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    ASSERT_EQ(s.st_size, 10, "");
+    ASSERT_EQ(access(CACHE_FILE, F_OK), 0, "");
+
+    fdio_cache_stats_t stats;
+    fdio_cache_get_stats(&stats);
+    EXPECT_EQ(stats.misses, 1u, "");
+    EXPECT_EQ(stats.hits, 2u, "");
+    EXPECT_EQ(stats.entries, 1u, "");
+    EXPECT_EQ(stats.dirs, 1u, "");
+
+    // Paths relative to the cwd share the entry.
+    char cwd[PATH_MAX];
+    ASSERT_NONNULL(getcwd(cwd, sizeof(cwd)), "");
+    ASSERT_EQ(chdir(CACHE_DIR), 0, "");
+    ASSERT_EQ(stat("file", &s), 0, "");
+    ASSERT_EQ(chdir(cwd), 0, "");
+    fdio_cache_get_stats(&stats);
+    EXPECT_EQ(stats.hits, 3u, "");
+
+    ASSERT_TRUE(cache_teardown(), "");
+    END_TEST;
+}
+
+bool cache_watcher_test(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(cache_setup(64, ZX_SEC(60)), "");
+
+    struct stat s;
+    ASSERT_EQ(stat(CACHE_FILE, &s), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+    ASSERT_EQ(open(CACHE_FILE, O_RDONLY), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+
+    fdio_cache_stats_t stats;
+    fdio_cache_get_stats(&stats);
+    EXPECT_EQ(stats.misses, 1u, "");
+    EXPECT_EQ(stats.negative_hits, 2u, "");
+
+    // Creating the file must be noticed, as must removing and renaming it.
+    ASSERT_TRUE(create_file(CACHE_FILE, 5), "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    ASSERT_EQ(s.st_size, 5, "");
+    ASSERT_EQ(rename(CACHE_FILE, CACHE_DIR "/other"), 0, "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+    ASSERT_EQ(rename(CACHE_DIR "/other", CACHE_FILE), 0, "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    ASSERT_EQ(unlink(CACHE_FILE), 0, "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+
+    fdio_cache_get_stats(&stats);
+    EXPECT_GE(stats.invalidations, 4u, "");
+
+    ASSERT_TRUE(cache_teardown(), "");
+    END_TEST;
+}
+
+bool cache_lease_test(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(cache_setup(64, 0), "");
+    ASSERT_TRUE(create_file(CACHE_FILE, 10), "");
+
+    // Attributes past their lease are fetched again.
+    struct stat s;
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    int fd = open(CACHE_FILE, O_RDWR);
+    ASSERT_GE(fd, 0, "");
+    ASSERT_EQ(ftruncate(fd, 20), 0, "");
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    ASSERT_EQ(s.st_size, 20, "");
+
+    fdio_cache_stats_t stats;
+    fdio_cache_get_stats(&stats);
+    EXPECT_EQ(stats.hits, 0u, "");
+
+    // As are those of a file opened for writing, whatever the lease.
+    ASSERT_EQ(fdio_cache_configure(64, ZX_SEC(60)), ZX_OK, "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    ASSERT_TRUE(create_file(CACHE_FILE, 30), "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    ASSERT_EQ(s.st_size, 30, "");
+    ASSERT_EQ(truncate(CACHE_FILE, 40), 0, "");
+    ASSERT_EQ(stat(CACHE_FILE, &s), 0, "");
+    ASSERT_EQ(s.st_size, 40, "");
+
+    ASSERT_TRUE(cache_teardown(), "");
+    END_TEST;
+}
+
+bool cache_eviction_test(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(cache_setup(4, ZX_SEC(60)), "");
+
+    struct stat s;
+    for (int i = 0; i < 16; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), CACHE_DIR "/missing-%d", i);
+        ASSERT_EQ(stat(path, &s), -1, "");
+    }
+
+    fdio_cache_stats_t stats;
+    fdio_cache_get_stats(&stats);
+    EXPECT_EQ(stats.entries, 4u, "");
+    EXPECT_EQ(stats.evictions, 12u, "");
+
+    ASSERT_TRUE(cache_teardown(), "");
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(fdio_cache_test)
+RUN_TEST(cache_hit_test);
+RUN_TEST(cache_watcher_test);
+RUN_TEST(cache_lease_test);
+RUN_TEST(cache_eviction_test);
+END_TEST_CASE(fdio_cache_test)
@@ -0,0 +1,111 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fdio/watcher.h>
+#include <zircon/syscalls.h>
+#include <unittest/unittest.h>
+
+#define CLASS_DIR "/dev/class"
+
+static zx_status_t count_until_idle(int dirfd, int event, const char* fn, void* cookie) {
+    if (event == WATCH_EVENT_IDLE) {
+        return ZX_ERR_STOP;
+    }
+    if (event == WATCH_EVENT_ADD_FILE) {
+        (*(size_t*)cookie)++;
+    }
+    return ZX_OK;
+}
+
+// Returns the number of entries |path| has, by readdir and by watching it.
+static bool enumerate_dir(const char* path, size_t* by_readdir, size_t* by_watch) {
+    BEGIN_HELPER;
+
+    DIR* dir = opendir(path);
+    ASSERT_NONNULL(dir, path);
+    *by_readdir = 0;
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+            (*by_readdir)++;
+        }
+    }
+    closedir(dir);
+
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    ASSERT_GE(fd, 0, path);
+    *by_watch = 0;
+    EXPECT_EQ(fdio_watch_directory(fd, count_until_idle, zx_deadline_after(ZX_SEC(5)), by_watch),
+              ZX_ERR_STOP, path);
+    close(fd);
+
+    END_HELPER;
+}
+
+// A watcher is told of every existing entry, many to a message, and
+// then that it is idle.
+bool devfs_watch_existing_test(void) {
+    BEGIN_TEST;
+
+    DIR* dir = opendir(CLASS_DIR);
+    ASSERT_NONNULL(dir, "");
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", CLASS_DIR, de->d_name);
+        size_t by_readdir, by_watch;
+        ASSERT_TRUE(enumerate_dir(path, &by_readdir, &by_watch), "");
+        EXPECT_EQ(by_watch, by_readdir, path);
+    }
+    closedir(dir);
+
+    END_TEST;
+}
+
+// Times enumerating everything under /dev/class.
+bool devfs_enumerate_benchmark(void) {
+    BEGIN_TEST;
+
+    const int kIterations = 100;
+    size_t entries = 0;
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIterations; i++) {
+        DIR* dir = opendir(CLASS_DIR);
+        ASSERT_NONNULL(dir, "");
+        struct dirent* de;
+        entries = 0;
+        while ((de = readdir(dir)) != NULL) {
+            if (de->d_name[0] == '.') {
+                continue;
+            }
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", CLASS_DIR, de->d_name);
+            size_t by_readdir, by_watch;
+            ASSERT_TRUE(enumerate_dir(path, &by_readdir, &by_watch), "");
+            entries += by_readdir;
+        }
+        closedir(dir);
+    }
+    zx_time_t elapsed = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+
+    printf("\nBenchmark %s/*, %zu entries: %7.1f us",
+           CLASS_DIR, entries, (double)elapsed / kIterations / 1000);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(fdio_devfs_test)
+RUN_TEST(devfs_watch_existing_test);
+RUN_TEST_PERFORMANCE(devfs_enumerate_benchmark);
+END_TEST_CASE(fdio_devfs_test)
@@ -0,0 +1,70 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <unittest/unittest.h>
+
+// These calls open the path without waiting for the server to describe
+// it, so a failure to open must come back from the request which follows.
+
+#define PIPE_DIR "/tmp/fdio-pipelined-open-test"
+#define PIPE_FILE PIPE_DIR "/file"
+#define PIPE_MISSING PIPE_DIR "/missing"
+
+bool pipelined_open_missing_test(void) {
+    BEGIN_TEST;
+    ASSERT_EQ(mkdir(PIPE_DIR, 0755), 0, "");
+
+    struct stat s;
+    ASSERT_EQ(stat(PIPE_MISSING, &s), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+    ASSERT_EQ(access(PIPE_MISSING, F_OK), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+    ASSERT_EQ(truncate(PIPE_MISSING, 10), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+    ASSERT_EQ(utimensat(AT_FDCWD, PIPE_MISSING, NULL, 0), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+
+    // Requests of a missing parent directory fail the same way.
+    ASSERT_EQ(unlink(PIPE_MISSING "/file"), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+    ASSERT_EQ(rename(PIPE_MISSING "/file", PIPE_FILE), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+
+    ASSERT_EQ(rmdir(PIPE_DIR), 0, "");
+    END_TEST;
+}
+
+bool pipelined_open_existing_test(void) {
+    BEGIN_TEST;
+    ASSERT_EQ(mkdir(PIPE_DIR, 0755), 0, "");
+    int fd = open(PIPE_FILE, O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GE(fd, 0, "");
+    ASSERT_EQ(close(fd), 0, "");
+
+    struct stat s;
+    ASSERT_EQ(stat(PIPE_DIR, &s), 0, "");
+    ASSERT_TRUE(S_ISDIR(s.st_mode), "");
+    ASSERT_EQ(truncate(PIPE_FILE, 10), 0, "");
+    ASSERT_EQ(stat(PIPE_FILE, &s), 0, "");
+    ASSERT_TRUE(S_ISREG(s.st_mode), "");
+    ASSERT_EQ(s.st_size, 10, "");
+    ASSERT_EQ(access(PIPE_FILE, F_OK), 0, "");
+    ASSERT_EQ(utimensat(AT_FDCWD, PIPE_FILE, NULL, 0), 0, "");
+
+    ASSERT_EQ(rename(PIPE_FILE, PIPE_DIR "/other"), 0, "");
+    ASSERT_EQ(unlink(PIPE_DIR "/other"), 0, "");
+    ASSERT_EQ(rmdir(PIPE_DIR), 0, "");
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(fdio_pipelined_open_test)
+RUN_TEST(pipelined_open_missing_test);
+RUN_TEST(pipelined_open_existing_test);
+END_TEST_CASE(fdio_pipelined_open_test)
@@ -0,0 +1,161 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include <zircon/syscalls.h>
+#include <fdio/io.h>
+#include <unittest/unittest.h>
+
+#define NUM_EVENTS 64
+
+// Creates an event and an fd which is readable when the event has
+// ZX_USER_SIGNAL_0 set.
+static bool make_event_fd(zx_handle_t* event, int* fd) {
+    BEGIN_HELPER;
+
+    ASSERT_EQ(zx_event_create(0u, event), ZX_OK, "");
+    *fd = fdio_handle_fd(*event, ZX_USER_SIGNAL_0, 0u, true);
+    ASSERT_GE(*fd, 0, "fdio_handle_fd() failed");
+
+    END_HELPER;
+}
+
+bool poll_level_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t event;
+    int fd;
+    ASSERT_TRUE(make_event_fd(&event, &fd), "");
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    // The fd stays registered across calls, and is reported for as long as
+    // it is readable, not just when it becomes readable.
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(poll(&pfd, 1, 0), 0, "not readable");
+        EXPECT_EQ(pfd.revents, 0, "");
+
+        ASSERT_EQ(zx_object_signal(event, 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+        EXPECT_EQ(poll(&pfd, 1, 0), 1, "readable");
+        EXPECT_EQ(pfd.revents, POLLIN, "");
+        EXPECT_EQ(poll(&pfd, 1, -1), 1, "still readable");
+        EXPECT_EQ(pfd.revents, POLLIN, "");
+
+        ASSERT_EQ(zx_object_signal(event, ZX_USER_SIGNAL_0, 0u), ZX_OK, "");
+    }
+
+    close(fd);
+    zx_handle_close(event);
+
+    END_TEST;
+}
+
+bool poll_reused_fd_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t event1, event2;
+    int fd1, fd2;
+    ASSERT_TRUE(make_event_fd(&event1, &fd1), "");
+    ASSERT_EQ(zx_object_signal(event1, 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+    struct pollfd pfd = {.fd = fd1, .events = POLLIN};
+    EXPECT_EQ(poll(&pfd, 1, 0), 1, "readable");
+
+    // The next fd is likely to get the same number, but must not inherit
+    // the state of the old one.
+    close(fd1);
+    ASSERT_TRUE(make_event_fd(&event2, &fd2), "");
+    pfd.fd = fd2;
+    EXPECT_EQ(poll(&pfd, 1, 0), 0, "new fd not readable");
+    ASSERT_EQ(zx_object_signal(event2, 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+    EXPECT_EQ(poll(&pfd, 1, 0), 1, "new fd readable");
+
+    close(fd2);
+    zx_handle_close(event1);
+    zx_handle_close(event2);
+
+    END_TEST;
+}
+
+bool select_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t events[2];
+    int fds[2];
+    ASSERT_TRUE(make_event_fd(&events[0], &fds[0]), "");
+    ASSERT_TRUE(make_event_fd(&events[1], &fds[1]), "");
+    int nfds = (fds[0] > fds[1] ? fds[0] : fds[1]) + 1;
+
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(zx_object_signal(events[i], 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(fds[0], &rfds);
+        FD_SET(fds[1], &rfds);
+        struct timeval tv = {};
+        EXPECT_EQ(select(nfds, &rfds, NULL, NULL, &tv), 1, "one readable");
+        EXPECT_EQ(FD_ISSET(fds[i], &rfds) != 0, true, "signaled fd");
+        EXPECT_EQ(FD_ISSET(fds[1 - i], &rfds) != 0, false, "other fd");
+        ASSERT_EQ(zx_object_signal(events[i], ZX_USER_SIGNAL_0, 0u), ZX_OK, "");
+    }
+
+    for (int i = 0; i < 2; i++) {
+        close(fds[i]);
+        zx_handle_close(events[i]);
+    }
+
+    END_TEST;
+}
+
+// Compares poll(), which keeps the registrations of its fds, with
+// zx_object_wait_many() on the same handles, which attaches and detaches
+// an observer for each one on every call.
+bool poll_benchmark(void) {
+    BEGIN_TEST;
+
+    const int kIterations = 10000;
+
+    zx_handle_t events[NUM_EVENTS];
+    struct pollfd pfds[NUM_EVENTS];
+    zx_wait_item_t items[NUM_EVENTS];
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        ASSERT_TRUE(make_event_fd(&events[i], &pfds[i].fd), "");
+        pfds[i].events = POLLIN;
+        items[i].handle = events[i];
+        items[i].waitfor = ZX_USER_SIGNAL_0;
+    }
+    ASSERT_EQ(zx_object_signal(events[NUM_EVENTS - 1], 0u, ZX_USER_SIGNAL_0), ZX_OK, "");
+
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIterations; i++) {
+        ASSERT_EQ(poll(pfds, NUM_EVENTS, -1), 1, "");
+    }
+    zx_time_t poll_time = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+
+    start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < kIterations; i++) {
+        ASSERT_EQ(zx_object_wait_many(items, NUM_EVENTS, ZX_TIME_INFINITE), ZX_OK, "");
+    }
+    zx_time_t wait_many_time = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+
+    printf("\nBenchmark %d fds: poll %7.1f ns, zx_object_wait_many %7.1f ns",
+           NUM_EVENTS, (double)poll_time / kIterations, (double)wait_many_time / kIterations);
+
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        close(pfds[i].fd);
+        zx_handle_close(events[i]);
+    }
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(fdio_poll_test)
+RUN_TEST(poll_level_test);
+RUN_TEST(poll_reused_fd_test);
+RUN_TEST(select_test);
+RUN_TEST_PERFORMANCE(poll_benchmark);
+END_TEST_CASE(fdio_poll_test)
@@ -10,9 +10,13 @@ MODULE_TYPE := usertest
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/main.c \
+    $(LOCAL_DIR)/fdio_cache.c \
+    $(LOCAL_DIR)/fdio_devfs.c \
     $(LOCAL_DIR)/fdio_handle_fd.c \
     $(LOCAL_DIR)/fdio_root.c \
     $(LOCAL_DIR)/fdio_path_canonicalize.c \
+    $(LOCAL_DIR)/fdio_pipelined_open.c \
+    $(LOCAL_DIR)/fdio_poll.c \
     $(LOCAL_DIR)/fdio_socketpair.c
 
 MODULE_NAME := fdio-test
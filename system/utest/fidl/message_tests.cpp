@@ -2,12 +2,16 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdio.h>
+
 #include <fidl/cpp/builder.h>
+#include <fidl/cpp/message_buffer_pool.h>
 #include <fidl/cpp/message_builder.h>
 #include <fidl/cpp/message.h>
 #include <fidl/cpp/string_view.h>
 #include <zx/channel.h>
 #include <zx/event.h>
+#include <zircon/syscalls.h>
 
 #include <unittest/unittest.h>
 
@@ -64,6 +68,55 @@ bool message_test() {
     END_TEST;
 }
 
+bool message_many_test() {
+    BEGIN_TEST;
+
+    constexpr uint32_t kCount = 4u;
+    uint8_t byte_buffers[kCount][64];
+    zx_handle_t handle_buffers[kCount][1];
+
+    zx::channel h1, h2;
+    EXPECT_EQ(zx::channel::create(0, &h1, &h2), ZX_OK);
+
+    fidl::Message out[kCount];
+    for (uint32_t i = 0; i < kCount; ++i) {
+        fidl::Builder builder(byte_buffers[i], sizeof(byte_buffers[i]));
+        fidl_message_header_t* header = builder.New<fidl_message_header_t>();
+        header->txid = i + 1;
+        header->ordinal = 42u;
+        out[i] = fidl::Message(builder.Finalize(), fidl::HandlePart(handle_buffers[i], 1u));
+    }
+    zx_handle_t event;
+    EXPECT_EQ(zx_event_create(0u, &event), ZX_OK);
+    out[2].handles().data()[0] = event;
+    out[2].handles().set_actual(1u);
+
+    EXPECT_EQ(fidl::Message::WriteMany(h1.get(), 0u, out, kCount), ZX_OK);
+    EXPECT_EQ(out[2].handles().actual(), 0u);
+
+    uint8_t read_buffers[kCount][64];
+    zx_handle_t read_handles[kCount][1];
+    fidl::Message in[kCount];
+    for (uint32_t i = 0; i < kCount; ++i) {
+        in[i] = fidl::Message(fidl::BytePart(read_buffers[i], sizeof(read_buffers[i])),
+                              fidl::HandlePart(read_handles[i], 1u));
+    }
+
+    uint32_t actual = 0u;
+    EXPECT_EQ(fidl::Message::ReadMany(h2.get(), 0u, in, kCount, &actual), ZX_OK);
+    EXPECT_EQ(actual, kCount);
+    for (uint32_t i = 0; i < kCount; ++i) {
+        EXPECT_EQ(in[i].txid(), i + 1);
+        EXPECT_EQ(in[i].ordinal(), 42u);
+        EXPECT_EQ(in[i].handles().actual(), i == 2 ? 1u : 0u);
+    }
+
+    EXPECT_EQ(fidl::Message::ReadMany(h2.get(), 0u, in, kCount, &actual), ZX_ERR_SHOULD_WAIT);
+    EXPECT_EQ(actual, 0u);
+
+    END_TEST;
+}
+
 bool message_builder_test() {
     BEGIN_TEST;
 
@@ -90,9 +143,155 @@ bool message_builder_test() {
     END_TEST;
 }
 
+bool builder_rewind_test() {
+    BEGIN_TEST;
+
+    uint64_t byte_buffer[8];
+    fidl::Builder builder(byte_buffer, sizeof(byte_buffer));
+
+    fidl_message_header_t* header = builder.New<fidl_message_header_t>();
+    const uint32_t mark = builder.size();
+    EXPECT_EQ(mark, sizeof(fidl_message_header_t));
+
+    uint64_t* first = builder.New<uint64_t>();
+    *first = 7u;
+    EXPECT_NONNULL(builder.NewArray<uint32_t>(3));
+    EXPECT_EQ(builder.size(), mark + 2 * FIDL_ALIGNMENT);
+
+    // Everything past the header goes at once, and is zeroed again when it
+    // is handed back out.
+    builder.Rewind(mark);
+    EXPECT_EQ(builder.size(), mark);
+    uint64_t* again = builder.New<uint64_t>();
+    EXPECT_EQ(again, first);
+    EXPECT_EQ(*again, 0u);
+    EXPECT_EQ(reinterpret_cast<void*>(header), reinterpret_cast<void*>(byte_buffer));
+
+    END_TEST;
+}
+
+bool message_buffer_pool_test() {
+    BEGIN_TEST;
+
+    fidl::MessageBufferPool pool(2u, 128u, 2u);
+    EXPECT_EQ(pool.bytes_capacity(), 128u);
+    EXPECT_EQ(pool.handles_capacity(), 2u);
+
+    uint8_t* first_bytes = nullptr;
+    {
+        fidl::MessageBuffer buffer(&pool);
+        EXPECT_EQ(buffer.bytes_capacity(), 128u);
+        EXPECT_EQ(buffer.handles_capacity(), 2u);
+        first_bytes = buffer.bytes();
+        EXPECT_NONNULL(first_bytes);
+        EXPECT_EQ(pool.stats().misses, 1u);
+        EXPECT_EQ(pool.stats().outstanding, 1u);
+    }
+    EXPECT_EQ(pool.stats().cached, 1u);
+    EXPECT_EQ(pool.stats().outstanding, 0u);
+
+    {
+        // The memory of the last buffer is handed out again.
+        fidl::MessageBuffer a(&pool);
+        EXPECT_EQ(a.bytes(), first_bytes);
+        EXPECT_EQ(pool.stats().hits, 1u);
+
+        fidl::MessageBuffer b(&pool);
+        fidl::MessageBuffer c(&pool);
+        EXPECT_EQ(pool.stats().misses, 3u);
+        EXPECT_EQ(pool.stats().outstanding, 3u);
+        EXPECT_EQ(pool.stats().cached, 0u);
+    }
+
+    // Only two of the three buffers fit in the cache.
+    EXPECT_EQ(pool.stats().cached, 2u);
+    EXPECT_EQ(pool.stats().drops, 1u);
+
+    pool.Trim();
+    EXPECT_EQ(pool.stats().cached, 0u);
+    EXPECT_EQ(pool.stats().outstanding, 0u);
+
+    END_TEST;
+}
+
+bool message_builder_pool_test() {
+    BEGIN_TEST;
+
+    zx::channel h1, h2;
+    EXPECT_EQ(zx::channel::create(0, &h1, &h2), ZX_OK);
+
+    fidl::MessageBufferPool pool;
+    for (uint32_t i = 0; i < 3u; ++i) {
+        fidl::MessageBuilder builder(&nonnullable_handle_message_type, &pool);
+        builder.header()->txid = i + 1;
+        builder.header()->ordinal = 42u;
+        zx_handle_t* handle = builder.New<zx_handle_t>();
+        EXPECT_EQ(zx_event_create(0u, handle), ZX_OK);
+
+        fidl::Message message;
+        const char* error_msg;
+        EXPECT_EQ(builder.Encode(&message, &error_msg), ZX_OK);
+        EXPECT_EQ(message.Write(h1.get(), 0u), ZX_OK);
+    }
+    EXPECT_EQ(pool.stats().misses, 1u);
+    EXPECT_EQ(pool.stats().hits, 2u);
+
+    // A server draining the channel in batches takes the buffers it reads
+    // into from the same pool.
+    fidl::MessageBuffer b0(&pool), b1(&pool), b2(&pool);
+    fidl::Message in[3] = {
+        b0.CreateEmptyMessage(), b1.CreateEmptyMessage(), b2.CreateEmptyMessage(),
+    };
+    uint32_t actual = 0u;
+    EXPECT_EQ(fidl::Message::ReadMany(h2.get(), 0u, in, 3u, &actual), ZX_OK);
+    EXPECT_EQ(actual, 3u);
+    for (uint32_t i = 0; i < actual; ++i) {
+        EXPECT_EQ(in[i].txid(), i + 1);
+        EXPECT_EQ(in[i].handles().actual(), 1u);
+        zx_handle_close(in[i].handles().data()[0]);
+    }
+    EXPECT_EQ(pool.stats().outstanding, 3u);
+    EXPECT_EQ(pool.stats().misses, 3u);
+
+    END_TEST;
+}
+
+bool message_buffer_pool_benchmark() {
+    BEGIN_TEST;
+
+    constexpr uint32_t kIterations = 10000u;
+
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (uint32_t i = 0; i < kIterations; ++i) {
+        fidl::MessageBuilder builder(&nonnullable_handle_message_type);
+        ASSERT_NONNULL(builder.New<zx_handle_t>());
+    }
+    zx_time_t heap_time = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+
+    fidl::MessageBufferPool pool;
+    start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (uint32_t i = 0; i < kIterations; ++i) {
+        fidl::MessageBuilder builder(&nonnullable_handle_message_type, &pool);
+        ASSERT_NONNULL(builder.New<zx_handle_t>());
+    }
+    zx_time_t pool_time = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+    EXPECT_EQ(pool.stats().hits, kIterations - 1);
+
+    printf("\nBenchmark MessageBuilder: heap %5.1f ns, pooled %5.1f ns",
+           static_cast<double>(heap_time) / kIterations,
+           static_cast<double>(pool_time) / kIterations);
+
+    END_TEST;
+}
+
 }  // namespace
 
 BEGIN_TEST_CASE(message_tests)
 RUN_NAMED_TEST("Message test", message_test)
+RUN_NAMED_TEST("Message batch test", message_many_test)
 RUN_NAMED_TEST("MessageBuilder test", message_builder_test)
+RUN_NAMED_TEST("Builder rewind test", builder_rewind_test)
+RUN_NAMED_TEST("MessageBufferPool test", message_buffer_pool_test)
+RUN_NAMED_TEST("MessageBuilder pool test", message_builder_pool_test)
+RUN_TEST_PERFORMANCE(message_buffer_pool_benchmark)
 END_TEST_CASE(message_tests);
@@ -11,6 +11,8 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <zircon/device/vfs.h>
@@ -106,6 +108,148 @@ bool benchmark_write_read(void) {
     END_TEST;
 }
 
+// As above, but with each operation spread over NumIovecs buffers, as
+// stdio and many network servers do.
+template <size_t IovecSize, size_t NumIovecs, size_t NumOps>
+bool benchmark_vectored_write_read(void) {
+    BEGIN_TEST;
+    int fd = open(MOUNT_POINT "/bigfile", O_CREAT | O_RDWR, 0644);
+    ASSERT_GT(fd, 0, "Cannot create file (FS benchmarks assume mounted FS exists at '/benchmark')");
+    constexpr size_t kOpSize = IovecSize * NumIovecs;
+    printf("\nBenchmarking Vectored Write + Read (%zu x %zu bytes, %zu MB)\n",
+           NumIovecs, IovecSize, (kOpSize * NumOps) / MB);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[kOpSize]);
+    ASSERT_EQ(ac.check(), true);
+    memset(data.get(), kMagicByte, kOpSize);
+    struct iovec iov[NumIovecs];
+    for (size_t i = 0; i < NumIovecs; i++) {
+        iov[i].iov_base = data.get() + i * IovecSize;
+        iov[i].iov_len = IovecSize;
+    }
+
+    uint64_t start;
+    size_t count;
+
+    for (int i = 0; i < kWriteReadCycles; i++) {
+        char str[100];
+        snprintf(str, sizeof(str), "writev %d", i);
+
+        start = zx_ticks_get();
+        count = NumOps;
+        while (count--) {
+            ASSERT_EQ(writev(fd, iov, NumIovecs), static_cast<ssize_t>(kOpSize));
+        }
+        time_end(str, start);
+
+        ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+        snprintf(str, sizeof(str), "readv %d", i);
+
+        start = zx_ticks_get();
+        count = NumOps;
+        while (count--) {
+            ASSERT_EQ(readv(fd, iov, NumIovecs), static_cast<ssize_t>(kOpSize));
+            ASSERT_EQ(data[0], kMagicByte);
+        }
+        time_end(str, start);
+
+        ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    }
+
+    ASSERT_EQ(syncfs(fd), 0);
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink(MOUNT_POINT "/bigfile"), 0);
+
+    END_TEST;
+}
+
+// Appends to a file a little at a time, as build tools writing their output
+// do, then reads it back over a connection opened only for reading.
+template <size_t DataSize, size_t NumOps>
+bool benchmark_append_read(void) {
+    BEGIN_TEST;
+    printf("\nBenchmarking Append + Read Only (%zu x %zu bytes)\n", NumOps, DataSize);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[DataSize]);
+    ASSERT_EQ(ac.check(), true);
+    memset(data.get(), kMagicByte, DataSize);
+
+    int fd = open(MOUNT_POINT "/appendfile", O_CREAT | O_WRONLY | O_APPEND, 0644);
+    ASSERT_GT(fd, 0, "Cannot create file (FS benchmarks assume mounted FS exists at '/benchmark')");
+    uint64_t start = zx_ticks_get();
+    for (size_t i = 0; i < NumOps; i++) {
+        ASSERT_EQ(write(fd, data.get(), DataSize), static_cast<ssize_t>(DataSize));
+    }
+    time_end("append", start);
+    ASSERT_EQ(close(fd), 0);
+
+    fd = open(MOUNT_POINT "/appendfile", O_RDONLY);
+    ASSERT_GT(fd, 0);
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumOps; i++) {
+        ASSERT_EQ(read(fd, data.get(), DataSize), static_cast<ssize_t>(DataSize));
+        ASSERT_EQ(data[0], kMagicByte);
+    }
+    time_end("read only", start);
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(unlink(MOUNT_POINT "/appendfile"), 0);
+    END_TEST;
+}
+
+// Writes a file of NumOps * DataSize bytes, then times reads of it made
+// after the filesystem has dropped its cached state for the file: first of
+// only its last DataSize bytes, as reading the tail of a log does, then of
+// all of it in order, then all of it again once cached.
+template <size_t DataSize, size_t NumOps>
+bool benchmark_cold_read(void) {
+    BEGIN_TEST;
+    constexpr size_t kFileSize = DataSize * NumOps;
+    printf("\nBenchmarking Cold Read (%zu x %zu bytes)\n", NumOps, DataSize);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[DataSize]);
+    ASSERT_EQ(ac.check(), true);
+    memset(data.get(), kMagicByte, DataSize);
+
+    int fd = open(MOUNT_POINT "/coldfile", O_CREAT | O_RDWR, 0644);
+    ASSERT_GT(fd, 0, "Cannot create file (FS benchmarks assume mounted FS exists at '/benchmark')");
+    for (size_t i = 0; i < NumOps; i++) {
+        ASSERT_EQ(write(fd, data.get(), DataSize), static_cast<ssize_t>(DataSize));
+    }
+    ASSERT_EQ(syncfs(fd), 0);
+    ASSERT_EQ(close(fd), 0);
+
+    // With the last connection closed and its writes flushed, the file is
+    // read back from disk.
+    fd = open(MOUNT_POINT "/coldfile", O_RDONLY);
+    ASSERT_GT(fd, 0);
+    uint64_t start = zx_ticks_get();
+    ASSERT_EQ(pread(fd, data.get(), DataSize, kFileSize - DataSize),
+              static_cast<ssize_t>(DataSize));
+    time_end("read tail (cold)", start);
+    ASSERT_EQ(data[0], kMagicByte);
+    ASSERT_EQ(close(fd), 0);
+
+    fd = open(MOUNT_POINT "/coldfile", O_RDONLY);
+    ASSERT_GT(fd, 0);
+    for (int cycle = 0; cycle < 2; cycle++) {
+        start = zx_ticks_get();
+        for (size_t i = 0; i < NumOps; i++) {
+            ASSERT_EQ(read(fd, data.get(), DataSize), static_cast<ssize_t>(DataSize));
+            ASSERT_EQ(data[0], kMagicByte);
+        }
+        time_end(cycle == 0 ? "read (cold)" : "read (cached)", start);
+        ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    }
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(unlink(MOUNT_POINT "/coldfile"), 0);
+    END_TEST;
+}
+
 #define START_STRING "/aaa"
 
 size_t constexpr kComponentLength = fbl::constexpr_strlen(START_STRING);
@@ -186,15 +330,143 @@ bool benchmark_path_walk(void) {
     ASSERT_TRUE(walk_down_path_components<MaxComponents>(path, mkdir_callback));
     time_end("mkdir", start);
 
+    // The first walk after a sync finds the metadata on disk, the second
+    // finds it in the filesystem's caches.
+    int fd = open(MOUNT_POINT, O_DIRECTORY | O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(syncfs(fd), 0);
+    ASSERT_EQ(close(fd), 0);
+
     strcpy(path, MOUNT_POINT);
     start = zx_ticks_get();
     ASSERT_TRUE(walk_down_path_components<MaxComponents>(path, stat_callback));
-    time_end("stat", start);
+    time_end("stat (uncached)", start);
+
+    strcpy(path, MOUNT_POINT);
+    start = zx_ticks_get();
+    ASSERT_TRUE(walk_down_path_components<MaxComponents>(path, stat_callback));
+    time_end("stat (cached)", start);
 
     start = zx_ticks_get();
     ASSERT_TRUE(walk_up_path_components(path, unlink_callback));
     time_end("unlink", start);
 
+    fd = open(MOUNT_POINT, O_DIRECTORY | O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(syncfs(fd), 0);
+    ASSERT_EQ(close(fd), 0);
+    END_TEST;
+}
+
+// Create, look up and unlink every entry of a directory holding NumEntries
+// files, to see how lookups scale with the size of a directory.
+template <size_t NumEntries>
+bool benchmark_large_directory(void) {
+    BEGIN_TEST;
+    printf("\nBenchmarking Large directory (%lu entries)\n", NumEntries);
+    ASSERT_EQ(mkdir(MOUNT_POINT "/bigdir", 0666), 0, "Could not make directory");
+
+    char path[PATH_MAX];
+    uint64_t start;
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumEntries; i++) {
+        snprintf(path, sizeof(path), MOUNT_POINT "/bigdir/file-%08zu", i);
+        int fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0644);
+        ASSERT_GE(fd, 0, "Could not create file");
+        ASSERT_EQ(close(fd), 0);
+    }
+    time_end("create", start);
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumEntries; i++) {
+        snprintf(path, sizeof(path), MOUNT_POINT "/bigdir/file-%08zu", i);
+        struct stat buf;
+        ASSERT_EQ(stat(path, &buf), 0, "Could not stat file");
+    }
+    time_end("stat", start);
+
+    start = zx_ticks_get();
+    for (size_t i = 0; i < NumEntries; i++) {
+        snprintf(path, sizeof(path), MOUNT_POINT "/bigdir/file-%08zu", i);
+        ASSERT_EQ(unlink(path), 0, "Could not unlink file");
+    }
+    time_end("unlink", start);
+
+    ASSERT_EQ(rmdir(MOUNT_POINT "/bigdir"), 0);
+
+    int fd = open(MOUNT_POINT, O_DIRECTORY | O_RDONLY);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(syncfs(fd), 0);
+    ASSERT_EQ(close(fd), 0);
+    END_TEST;
+}
+
+constexpr size_t kConcurrentDataSize = 16 * KB;
+constexpr size_t kConcurrentNumOps = 1024;
+
+// Writes, then reads back, a file of its own. Returns the number of failed
+// operations.
+int concurrent_write_read(void* arg) {
+    const char* path = static_cast<const char*>(arg);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[kConcurrentDataSize]);
+    if (!ac.check()) {
+        return 1;
+    }
+    memset(data.get(), kMagicByte, kConcurrentDataSize);
+    const ssize_t len = static_cast<ssize_t>(kConcurrentDataSize);
+    int fd = open(path, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return 1;
+    }
+    int failures = 0;
+    for (size_t i = 0; i < kConcurrentNumOps; i++) {
+        if (write(fd, data.get(), len) != len) {
+            failures++;
+        }
+    }
+    if (lseek(fd, 0, SEEK_SET) != 0) {
+        failures++;
+    }
+    for (size_t i = 0; i < kConcurrentNumOps; i++) {
+        if (read(fd, data.get(), len) != len || data[0] != kMagicByte) {
+            failures++;
+        }
+    }
+    if (close(fd) != 0) {
+        failures++;
+    }
+    return failures;
+}
+
+// Writes and reads NumThreads files at once, one per thread, each over its
+// own connection. Each thread moves the same amount of data, so the time
+// stays flat as NumThreads grows for as long as the filesystem serves
+// connections in parallel.
+template <size_t NumThreads>
+bool benchmark_concurrent_write_read(void) {
+    BEGIN_TEST;
+    printf("\nBenchmarking Concurrent Write + Read (%zu threads, %zu MB each)\n",
+           NumThreads, (kConcurrentDataSize * kConcurrentNumOps) / MB);
+
+    char paths[NumThreads][PATH_MAX];
+    thrd_t threads[NumThreads];
+    uint64_t start = zx_ticks_get();
+    for (size_t i = 0; i < NumThreads; i++) {
+        snprintf(paths[i], sizeof(paths[i]), MOUNT_POINT "/concurrent-%zu", i);
+        ASSERT_EQ(thrd_create(&threads[i], concurrent_write_read, paths[i]), thrd_success);
+    }
+    for (size_t i = 0; i < NumThreads; i++) {
+        int failures;
+        ASSERT_EQ(thrd_join(threads[i], &failures), thrd_success);
+        ASSERT_EQ(failures, 0);
+    }
+    time_end("write + read", start);
+
+    for (size_t i = 0; i < NumThreads; i++) {
+        ASSERT_EQ(unlink(paths[i]), 0);
+    }
     int fd = open(MOUNT_POINT, O_DIRECTORY | O_RDONLY);
     ASSERT_GE(fd, 0);
     ASSERT_EQ(syncfs(fd), 0);
@@ -208,8 +480,23 @@ RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 2048>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 4096>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 8192>))
 RUN_TEST_PERFORMANCE((benchmark_write_read<16 * KB, 16384>))
+RUN_TEST_PERFORMANCE((benchmark_write_read<1 * MB, 16>))
+RUN_TEST_PERFORMANCE((benchmark_write_read<1 * MB, 64>))
+RUN_TEST_PERFORMANCE((benchmark_write_read<4 * MB, 16>))
+RUN_TEST_PERFORMANCE((benchmark_vectored_write_read<512, 8, 4096>))
+RUN_TEST_PERFORMANCE((benchmark_vectored_write_read<16 * KB, 8, 256>))
+RUN_TEST_PERFORMANCE((benchmark_append_read<128, 65536>))
+RUN_TEST_PERFORMANCE((benchmark_append_read<4 * KB, 4096>))
+RUN_TEST_PERFORMANCE((benchmark_cold_read<16 * KB, 4096>))
+RUN_TEST_PERFORMANCE((benchmark_cold_read<128 * KB, 512>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<125>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<250>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<500>))
 RUN_TEST_PERFORMANCE((benchmark_path_walk<1000>))
+RUN_TEST_PERFORMANCE((benchmark_large_directory<100>))
+RUN_TEST_PERFORMANCE((benchmark_large_directory<1000>))
+RUN_TEST_PERFORMANCE((benchmark_large_directory<10000>))
+RUN_TEST_PERFORMANCE((benchmark_concurrent_write_read<1>))
+RUN_TEST_PERFORMANCE((benchmark_concurrent_write_read<2>))
+RUN_TEST_PERFORMANCE((benchmark_concurrent_write_read<4>))
 END_TEST_CASE(basic_benchmarks)
@@ -25,6 +25,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/test-directory.cpp \
     $(LOCAL_DIR)/test-dot-dot.c \
     $(LOCAL_DIR)/test-fcntl.cpp \
+    $(LOCAL_DIR)/test-large-io.cpp \
     $(LOCAL_DIR)/test-link.c \
     $(LOCAL_DIR)/test-maxfile.cpp \
     $(LOCAL_DIR)/test-minfs.cpp \
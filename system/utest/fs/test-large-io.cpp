@@ -0,0 +1,140 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+
+#include "filesystems.h"
+#include "misc.h"
+
+namespace {
+
+// Large enough to be moved through a vmo, in more than one piece.
+constexpr size_t kLargeSize = (3 << 20) + 4321;
+
+void fill(uint8_t* buf, size_t len, uint8_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = static_cast<uint8_t>(seed + i * 7 + (i >> 12));
+    }
+}
+
+bool check(const uint8_t* buf, size_t len, uint8_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != static_cast<uint8_t>(seed + i * 7 + (i >> 12))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_large_read_write(void) {
+    BEGIN_TEST;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[kLargeSize]);
+    ASSERT_TRUE(ac.check());
+    fill(buf.get(), kLargeSize, 1);
+
+    int fd = open("::large", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(write(fd, buf.get(), kLargeSize), static_cast<ssize_t>(kLargeSize));
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), static_cast<off_t>(kLargeSize));
+
+    memset(buf.get(), 0, kLargeSize);
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(read(fd, buf.get(), kLargeSize), static_cast<ssize_t>(kLargeSize));
+    ASSERT_TRUE(check(buf.get(), kLargeSize, 1));
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), static_cast<off_t>(kLargeSize));
+
+    // Reads past the end come up short.
+    ASSERT_EQ(lseek(fd, kLargeSize - 100, SEEK_SET), static_cast<off_t>(kLargeSize - 100));
+    ASSERT_EQ(read(fd, buf.get(), kLargeSize), 100);
+
+    // As do positioned ones, which leave the seek offset alone.
+    fill(buf.get(), kLargeSize, 2);
+    ASSERT_EQ(pwrite(fd, buf.get(), kLargeSize, 4096), static_cast<ssize_t>(kLargeSize));
+    memset(buf.get(), 0, kLargeSize);
+    ASSERT_EQ(pread(fd, buf.get(), kLargeSize, 4096), static_cast<ssize_t>(kLargeSize));
+    ASSERT_TRUE(check(buf.get(), kLargeSize, 2));
+    ASSERT_EQ(pread(fd, buf.get(), kLargeSize, 8192), static_cast<ssize_t>(kLargeSize - 4096));
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+
+    struct stat st;
+    ASSERT_EQ(fstat(fd, &st), 0);
+    ASSERT_EQ(st.st_size, static_cast<off_t>(kLargeSize + 4096));
+    ASSERT_EQ(close(fd), 0);
+
+    // Appends land at the end, whatever the seek offset.
+    fd = open("::large", O_RDWR | O_APPEND);
+    ASSERT_GT(fd, 0);
+    fill(buf.get(), kLargeSize, 3);
+    ASSERT_EQ(write(fd, buf.get(), kLargeSize), static_cast<ssize_t>(kLargeSize));
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), static_cast<off_t>(2 * kLargeSize + 4096));
+    memset(buf.get(), 0, kLargeSize);
+    ASSERT_EQ(pread(fd, buf.get(), kLargeSize, kLargeSize + 4096),
+              static_cast<ssize_t>(kLargeSize));
+    ASSERT_TRUE(check(buf.get(), kLargeSize, 3));
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(unlink("::large"), 0);
+    END_TEST;
+}
+
+bool test_vectored_read_write(void) {
+    BEGIN_TEST;
+
+    uint8_t a[100], b[5000], c[20000];
+    struct iovec iov[3] = {
+        {a, sizeof(a)},
+        {b, sizeof(b)},
+        {c, sizeof(c)},
+    };
+    const size_t total = sizeof(a) + sizeof(b) + sizeof(c);
+    fill(a, sizeof(a), 4);
+    fill(b, sizeof(b), 5);
+    fill(c, sizeof(c), 6);
+
+    int fd = open("::vectored", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(writev(fd, iov, 3), static_cast<ssize_t>(total));
+    ASSERT_EQ(pwritev(fd, iov, 3, total), static_cast<ssize_t>(total));
+
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    memset(c, 0, sizeof(c));
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(readv(fd, iov, 3), static_cast<ssize_t>(total));
+    ASSERT_TRUE(check(a, sizeof(a), 4));
+    ASSERT_TRUE(check(b, sizeof(b), 5));
+    ASSERT_TRUE(check(c, sizeof(c), 6));
+
+    // A short read fills the iovecs in order.
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    memset(c, 0, sizeof(c));
+    const size_t part = sizeof(a) + 10;
+    ASSERT_EQ(preadv(fd, iov, 3, 2 * total - part), static_cast<ssize_t>(part));
+    ASSERT_TRUE(check(a, sizeof(a), 4));
+    ASSERT_TRUE(check(b, 10, 5));
+    ASSERT_EQ(b[10], 0);
+
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink("::vectored"), 0);
+    END_TEST;
+}
+
+} // namespace
+
+RUN_FOR_ALL_FILESYSTEMS(large_io_tests,
+    RUN_TEST_MEDIUM(test_large_read_write)
+    RUN_TEST_MEDIUM(test_vectored_read_write)
+)
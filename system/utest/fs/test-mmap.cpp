@@ -17,6 +17,7 @@
 #include <unittest/unittest.h>
 
 #include "filesystems.h"
+#include "misc.h"
 
 // Certain filesystems delay creation of internal structures
 // until the file is initially accessed. Test that we can
@@ -281,6 +282,60 @@ bool test_mmap_private(void) {
 
 // Test that mmap fails with appropriate error codes when
 // we expect.
+// Test that changes made through a shared mapping reach storage
+bool test_mmap_msync(void) {
+    BEGIN_TEST;
+    if (!test_info->supports_mmap) {
+        return true;
+    }
+
+    constexpr char kFilename[] = "::mmap_msync";
+    int fd = open(kFilename, O_RDWR | O_CREAT | O_EXCL);
+    ASSERT_GT(fd, 0);
+    ASSERT_EQ(ftruncate(fd, PAGE_SIZE * 3), 0);
+
+    void* addr = mmap(NULL, PAGE_SIZE * 3, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT_NE(addr, MAP_FAILED);
+    char* caddr = reinterpret_cast<char*>(addr);
+    char tmp1[] = "written through the mapping";
+    char tmp2[] = "and a little more, further on";
+    memcpy(caddr, tmp1, sizeof(tmp1));
+    memcpy(caddr + PAGE_SIZE * 2, tmp2, sizeof(tmp2));
+
+    ASSERT_EQ(msync(addr, PAGE_SIZE * 3, MS_ASYNC | MS_SYNC), -1);
+    ASSERT_EQ(errno, EINVAL);
+    errno = 0;
+    ASSERT_EQ(msync(caddr + 1, PAGE_SIZE, MS_SYNC), -1);
+    ASSERT_EQ(errno, EINVAL);
+    errno = 0;
+    ASSERT_EQ(msync(addr, PAGE_SIZE * 3, MS_SYNC), 0);
+
+    // The mapping outlives the descriptor, and a write after the last
+    // msync() is kept too.
+    ASSERT_EQ(close(fd), 0);
+    memcpy(caddr + PAGE_SIZE, tmp1, sizeof(tmp1));
+    ASSERT_EQ(msync(caddr + PAGE_SIZE, PAGE_SIZE, MS_ASYNC), 0);
+    ASSERT_EQ(munmap(addr, PAGE_SIZE * 3), 0);
+
+    if (test_info->can_be_mounted) {
+        ASSERT_TRUE(check_remount(), "Could not remount filesystem");
+    }
+
+    fd = open(kFilename, O_RDONLY);
+    ASSERT_GT(fd, 0);
+    char buf[sizeof(tmp2)];
+    ASSERT_EQ(pread(fd, buf, sizeof(tmp1), 0), sizeof(tmp1));
+    ASSERT_EQ(memcmp(buf, tmp1, sizeof(tmp1)), 0);
+    ASSERT_EQ(pread(fd, buf, sizeof(tmp1), PAGE_SIZE), sizeof(tmp1));
+    ASSERT_EQ(memcmp(buf, tmp1, sizeof(tmp1)), 0);
+    ASSERT_EQ(pread(fd, buf, sizeof(tmp2), PAGE_SIZE * 2), sizeof(tmp2));
+    ASSERT_EQ(memcmp(buf, tmp2, sizeof(tmp2)), 0);
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink(kFilename), 0);
+
+    END_TEST;
+}
+
 bool test_mmap_evil(void) {
     BEGIN_TEST;
     if (!test_info->supports_mmap) {
@@ -446,6 +501,7 @@ RUN_FOR_ALL_FILESYSTEMS(fs_mmap_tests,
     RUN_TEST_MEDIUM(test_mmap_unlinked)
     RUN_TEST_MEDIUM(test_mmap_shared)
     RUN_TEST_MEDIUM(test_mmap_private)
+    RUN_TEST_MEDIUM(test_mmap_msync)
     RUN_TEST_MEDIUM(test_mmap_evil)
     RUN_TEST_ENABLE_CRASH_HANDLER(test_mmap_death)
 )
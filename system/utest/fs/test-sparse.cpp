@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -78,6 +79,42 @@ bool test_sparse(void) {
 constexpr size_t kBlockSize = 8192;
 constexpr size_t kDirectBlocks = 16;
 
+// Writes every other block of a file, leaving it too fragmented to be mapped
+// by a handful of extents, and checks the data survives a reopen and truncate.
+bool test_sparse_fragmented(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kBlocks = 64;
+    int fd = open("::my_file", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0);
+
+    uint8_t buf[kBlockSize];
+    for (size_t i = 0; i < kBlocks; i += 2) {
+        memset(buf, static_cast<int>(i + 1), sizeof(buf));
+        ASSERT_EQ(pwrite(fd, buf, sizeof(buf), i * kBlockSize), sizeof(buf));
+    }
+
+    ASSERT_EQ(close(fd), 0);
+    fd = open("::my_file", O_RDWR, 0644);
+    ASSERT_GT(fd, 0);
+
+    for (size_t i = 0; i < kBlocks - 1; i++) {
+        ASSERT_EQ(pread(fd, buf, sizeof(buf), i * kBlockSize), sizeof(buf));
+        uint8_t expected = (i % 2) ? 0 : static_cast<uint8_t>(i + 1);
+        for (size_t j = 0; j < sizeof(buf); j++) {
+            ASSERT_EQ(buf[j], expected);
+        }
+    }
+
+    ASSERT_EQ(ftruncate(fd, (kBlocks / 2) * kBlockSize + 1), 0);
+    ASSERT_EQ(pread(fd, buf, sizeof(buf), (kBlocks / 2) * kBlockSize), 1);
+    ASSERT_EQ(buf[0], kBlocks / 2 + 1);
+
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(unlink("::my_file"), 0);
+    END_TEST;
+}
+
 RUN_FOR_ALL_FILESYSTEMS(sparse_tests,
     RUN_TEST_MEDIUM((test_sparse<0, 0, kBlockSize>))
     RUN_TEST_MEDIUM((test_sparse<kBlockSize / 2, 0, kBlockSize>))
@@ -97,4 +134,5 @@ RUN_FOR_ALL_FILESYSTEMS(sparse_tests,
     RUN_TEST_MEDIUM((test_sparse<kBlockSize * kDirectBlocks + kBlockSize,
                                  kBlockSize * kDirectBlocks + 2 * kBlockSize,
                                  kBlockSize * 32>))
+    RUN_TEST_MEDIUM(test_sparse_fragmented)
 )
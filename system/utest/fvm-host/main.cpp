@@ -10,6 +10,8 @@
 
 #include <fvm/fvm-lz4.h>
 
+#include <vector>
+
 #define PARTITION_SIZE (1lu << 30)  // 1 gb
 #define CONTAINER_SIZE (4lu << 30)  // 4 gb
 #define SLICE_SIZE (64lu * (1 << 20)) // 64 mb
@@ -162,7 +164,7 @@ bool ReportSparse(bool compress) {
     return ReportContainer(sparse_path, 0);
 }
 
-bool CreateFvm(bool create_before, off_t offset) {
+bool CreateFvm(bool create_before, off_t offset, bool incremental = false) {
     BEGIN_HELPER;
     printf("Creating fvm container: %s\n", fvm_path);
 
@@ -175,6 +177,9 @@ bool CreateFvm(bool create_before, off_t offset) {
     fbl::unique_ptr<FvmContainer> fvmContainer;
     ASSERT_EQ(FvmContainer::Create(fvm_path, SLICE_SIZE, offset, length - offset, &fvmContainer),
               ZX_OK, "Failed to initialize fvm container");
+    if (incremental) {
+        fvmContainer->SetIncremental();
+    }
     if (!create_before) {
         gFileFlags |= kFvm;
     }
@@ -271,7 +276,8 @@ bool PopulateSystem(size_t ndirs, size_t nfiles, size_t max_size) {
     return PopulateMinfs(system_path, ndirs, nfiles, max_size);
 }
 
-bool AddFileBlobstore(blobstore::Blobstore* bs, size_t size) {
+bool AddFileBlobstore(blobstore::Blobstore* bs, size_t size,
+                      blobstore::BlobDigest* digest = nullptr) {
     BEGIN_HELPER;
     char new_file[PATH_MAX];
     GenerateFilename(test_dir, 10, new_file);;
@@ -280,7 +286,8 @@ bool AddFileBlobstore(blobstore::Blobstore* bs, size_t size) {
     fbl::unique_ptr<uint8_t[]> data;
     ASSERT_TRUE(GenerateData(size, &data));
     ASSERT_EQ(write(datafd.get(), data.get(), size), size, "Failed to write data to file");
-    ASSERT_EQ(blobstore::blobstore_add_blob(bs, datafd.get()), ZX_OK, "Failed to add blob");
+    ASSERT_EQ(blobstore::blobstore_add_blob(bs, datafd.get(), digest), ZX_OK,
+              "Failed to add blob");
     ASSERT_EQ(unlink(new_file), 0);
     END_HELPER;
 }
@@ -409,6 +416,100 @@ bool TestPartitions() {
     END_TEST;
 }
 
+// Rebuilds the fvm over the previous image after adding blobs, as an incremental build would.
+bool TestIncrementalFvm() {
+    BEGIN_TEST;
+    ASSERT_TRUE(CreatePartitions());
+    ASSERT_TRUE(PopulatePartitions(10, 100, (1 << 20)));
+    ASSERT_TRUE(CreateFvm(false, 0));
+    ASSERT_TRUE(PopulateBlobstore(10, (1 << 20)));
+    ASSERT_TRUE(CreateFvm(false, 0, true));
+    ASSERT_TRUE(ReportFvm(0));
+    ASSERT_TRUE(DestroyAll());
+    END_TEST;
+}
+
+bool TestPruneBlobstore() {
+    BEGIN_TEST;
+    ASSERT_TRUE(CreateBlobstore());
+    fbl::unique_fd blobfd(open(blobfs_path, O_RDWR, 0755));
+    ASSERT_TRUE(blobfd, "Unable to open blobstore path");
+    fbl::RefPtr<blobstore::Blobstore> bs;
+    ASSERT_EQ(blobstore::blobstore_create(&bs, fbl::move(blobfd)), ZX_OK,
+              "Failed to create blobstore");
+
+    constexpr size_t kBlobCount = 20;
+    std::vector<blobstore::BlobDigest> digests(kBlobCount);
+    for (size_t i = 0; i < kBlobCount; i++) {
+        ASSERT_TRUE(AddFileBlobstore(bs.get(), 1 + (rand() % (1 << 20)), &digests[i]));
+    }
+
+    // Keep every other blob
+    std::vector<blobstore::BlobDigest> keep;
+    for (size_t i = 0; i < kBlobCount; i += 2) {
+        keep.push_back(digests[i]);
+    }
+    size_t removed;
+    ASSERT_EQ(blobstore::blobstore_prune(bs.get(), keep, &removed), ZX_OK);
+    ASSERT_EQ(removed, kBlobCount - keep.size());
+    ASSERT_EQ(blobstore::blobstore_prune(bs.get(), keep, &removed), ZX_OK);
+    ASSERT_EQ(removed, 0);
+    ASSERT_EQ(blobstore::blobstore_check(bs), ZX_OK, "Pruned blobstore is inconsistent");
+
+    ASSERT_TRUE(DestroyAll());
+    END_TEST;
+}
+
+// Reads the frames of a compressed image both in order and through its frame table.
+bool TestSparseFrameTable() {
+    BEGIN_TEST;
+    ASSERT_TRUE(CreatePartitions());
+    ASSERT_TRUE(PopulatePartitions(10, 100, (1 << 20)));
+    ASSERT_TRUE(CreateSparse(LZ4));
+
+    fbl::unique_fd fd(open(sparse_lz4_path, O_RDONLY));
+    ASSERT_TRUE(fd, "Unable to open sparse file");
+    fbl::unique_ptr<fvm::SparseReader> reader;
+    ASSERT_EQ(fvm::SparseReader::Create(fbl::move(fd), &reader), ZX_OK);
+    ASSERT_TRUE(reader->IsFramed());
+    ASSERT_TRUE(reader->HasFrameTable());
+    const size_t count = reader->FrameCount();
+    ASSERT_GT(count, 0);
+
+    size_t max = fvm::SparseReader::MaxCompressedFrameLength();
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[max]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<uint8_t[]> data_at(new (&ac) uint8_t[max]);
+    ASSERT_TRUE(ac.check());
+    fvm::frame_descriptor_t desc, desc_at;
+
+    // Pick up part way through, as an interrupted pave would
+    const size_t skip = count / 2;
+    ASSERT_EQ(reader->SkipFrames(skip), ZX_OK);
+    for (size_t i = skip; i < count; i++) {
+        ASSERT_EQ(reader->NextFrame(), i);
+        ASSERT_EQ(reader->ReadFrame(&desc, data.get()), ZX_OK);
+        ASSERT_EQ(reader->ReadFrameAt(i, &desc_at, data_at.get()), ZX_OK);
+        ASSERT_EQ(memcmp(&desc, &desc_at, sizeof(desc)), 0);
+        ASSERT_EQ(memcmp(data.get(), data_at.get(), desc.compressed_length), 0);
+    }
+    ASSERT_EQ(reader->ReadFrame(&desc, data.get()), ZX_ERR_OUT_OF_RANGE);
+    ASSERT_EQ(reader->ReadFrameAt(count, &desc, data.get()), ZX_ERR_OUT_OF_RANGE);
+
+    // Frames come apart on their own, in any order
+    fbl::unique_ptr<uint8_t[]> out(new (&ac) uint8_t[fvm::kSparseFrameLength]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = count; i-- > 0;) {
+        ASSERT_EQ(reader->ReadFrameAt(i, &desc, data.get()), ZX_OK);
+        ASSERT_EQ(fvm::SparseReader::DecompressFrame(desc, data.get(), out.get()), ZX_OK);
+    }
+
+    reader.reset();
+    ASSERT_TRUE(DestroyAll());
+    END_TEST;
+}
+
 bool Setup() {
     BEGIN_HELPER;
     srand(time(0));
@@ -460,6 +561,9 @@ RUN_TEST_MEDIUM((TestPartitions<SPARSE_LZ4, 10, 100, (1 << 20)>))
 RUN_TEST_MEDIUM((TestPartitions<FVM, 10, 100, (1 << 20)>))
 RUN_TEST_MEDIUM((TestPartitions<FVM_NEW, 10, 100, (1 << 20)>))
 RUN_TEST_MEDIUM((TestPartitions<FVM_OFFSET, 10, 100, (1 << 20)>))
+RUN_TEST_MEDIUM(TestIncrementalFvm)
+RUN_TEST_MEDIUM(TestPruneBlobstore)
+RUN_TEST_MEDIUM(TestSparseFrameTable)
 END_TEST_CASE(fvm_host_tests)
 
 int main(int argc, char** argv) {
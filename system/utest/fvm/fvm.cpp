@@ -932,6 +932,90 @@ static bool TestVPartitionExtendSparse(void) {
     END_TEST;
 }
 
+// Test extending a vpartition by several ranges in one request
+static bool TestVPartitionExtendBatch(void) {
+    BEGIN_TEST;
+    char ramdisk_path[PATH_MAX];
+    char fvm_driver[PATH_MAX];
+    constexpr uint64_t kBlkSize = 512;
+    constexpr uint64_t kBlkCount = 1 << 16;
+    constexpr uint64_t kSliceSize = 16 * kBlkSize;
+    ASSERT_EQ(StartFVMTest(kBlkSize, kBlkCount, kSliceSize, ramdisk_path,
+                           fvm_driver), 0, "error mounting FVM");
+
+    int fd = open(fvm_driver, O_RDWR);
+    ASSERT_GT(fd, 0);
+
+    alloc_req_t request;
+    memset(&request, 0, sizeof(request));
+    request.slice_count = 1;
+    memcpy(request.guid, kTestUniqueGUID, GUID_LEN);
+    strcpy(request.name, kTestPartName1);
+    memcpy(request.type, kTestPartGUIDData, GUID_LEN);
+    int vp_fd = fvm_allocate_partition(fd, &request);
+    ASSERT_GT(vp_fd, 0);
+
+    const size_t kBlocksPerSlice = kSliceSize / kBlkSize;
+    extend_batch_request_t brequest;
+
+    // A batch which touches an allocated slice fails, leaving nothing behind
+    brequest.count = 2;
+    brequest.extents[0].offset = 20;
+    brequest.extents[0].length = 1;
+    brequest.extents[1].offset = 0;
+    brequest.extents[1].length = 1;
+    ASSERT_LT(ioctl_block_fvm_extend_batch(vp_fd, &brequest), 0, "Expected request failure");
+    ASSERT_TRUE(CheckNoAccessBlock(vp_fd, 20 * kBlocksPerSlice, 1));
+
+    // Too many ranges
+    brequest.count = MAX_FVM_EXTEND_REQUESTS + 1;
+    ASSERT_LT(ioctl_block_fvm_extend_batch(vp_fd, &brequest), 0, "Expected request failure");
+
+    brequest.count = 3;
+    brequest.extents[0].offset = 2;
+    brequest.extents[0].length = 2;
+    brequest.extents[1].offset = 10;
+    brequest.extents[1].length = 1;
+    brequest.extents[2].offset = 1;
+    brequest.extents[2].length = 1;
+    ASSERT_EQ(ioctl_block_fvm_extend_batch(vp_fd, &brequest), 0);
+    for (size_t i = 0; i < brequest.count; i++) {
+        ASSERT_TRUE(CheckWriteReadBlock(vp_fd, brequest.extents[i].offset * kBlocksPerSlice,
+                                        brequest.extents[i].length * kBlocksPerSlice));
+    }
+    ASSERT_EQ(close(vp_fd), 0);
+
+    // Rebind twice, so that both copies of the metadata have been read back
+    const partition_entry_t entries[] = {
+        {kTestPartName1, 1},
+    };
+    fd = FVMRebind(fd, ramdisk_path, entries, 1);
+    ASSERT_GT(fd, 0, "Failed to rebind FVM driver");
+    vp_fd = open_partition(kTestUniqueGUID, kTestPartGUIDData, 0, nullptr);
+    ASSERT_GT(vp_fd, 0, "Couldn't re-open Data VPart");
+    brequest.count = 1;
+    brequest.extents[0].offset = 30;
+    brequest.extents[0].length = 1;
+    ASSERT_EQ(ioctl_block_fvm_extend_batch(vp_fd, &brequest), 0);
+    ASSERT_EQ(close(vp_fd), 0);
+
+    fd = FVMRebind(fd, ramdisk_path, entries, 1);
+    ASSERT_GT(fd, 0, "Failed to rebind FVM driver");
+    vp_fd = open_partition(kTestUniqueGUID, kTestPartGUIDData, 0, nullptr);
+    ASSERT_GT(vp_fd, 0, "Couldn't re-open Data VPart");
+    ASSERT_TRUE(CheckWriteReadBlock(vp_fd, 0, 4 * kBlocksPerSlice));
+    ASSERT_TRUE(CheckWriteReadBlock(vp_fd, 10 * kBlocksPerSlice, kBlocksPerSlice));
+    ASSERT_TRUE(CheckWriteReadBlock(vp_fd, 30 * kBlocksPerSlice, kBlocksPerSlice));
+    ASSERT_TRUE(CheckNoAccessBlock(vp_fd, 4 * kBlocksPerSlice, 1));
+    ASSERT_TRUE(CheckNoAccessBlock(vp_fd, 20 * kBlocksPerSlice, 1));
+
+    ASSERT_EQ(close(vp_fd), 0);
+    ASSERT_EQ(close(fd), 0);
+    ASSERT_EQ(FVMCheck(fvm_driver, kSliceSize), 0);
+    ASSERT_EQ(EndFVMTest(ramdisk_path), 0, "unmounting FVM");
+    END_TEST;
+}
+
 // Test removing slices from a VPartition.
 static bool TestVPartitionShrink(void) {
     BEGIN_TEST;
@@ -2799,6 +2883,7 @@ RUN_TEST_MEDIUM(TestReleaseDuringAccess)
 RUN_TEST_MEDIUM(TestDestroyDuringAccess)
 RUN_TEST_MEDIUM(TestVPartitionExtend)
 RUN_TEST_MEDIUM(TestVPartitionExtendSparse)
+RUN_TEST_MEDIUM(TestVPartitionExtendBatch)
 RUN_TEST_MEDIUM(TestVPartitionShrink)
 RUN_TEST_MEDIUM(TestVPartitionSplit)
 RUN_TEST_MEDIUM(TestVPartitionDestroy)
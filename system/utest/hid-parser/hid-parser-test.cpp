@@ -146,6 +146,37 @@ static bool parse_boot_mouse() {
     END_TEST;
 }
 
+static bool extract_boot_mouse() {
+    BEGIN_TEST;
+
+    hid::DeviceDescriptor* dev = nullptr;
+    auto res = hid::ParseReportDescriptor(
+        boot_mouse_r_desc, sizeof(boot_mouse_r_desc), &dev);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+    ASSERT_EQ(dev->report[0].count, 6);
+    const auto fields = dev->report[0].first_field;
+
+    // No report id, so the buttons start at bit 0 and X at the second byte.
+    const uint32_t expected_offsets[] = { 0, 1, 2, 3, 8, 16 };
+    for (uint8_t ix = 0; ix != 6; ++ix)
+        EXPECT_EQ(fields[ix].bit_offset, expected_offsets[ix]);
+
+    // Buttons 1 and 3 down, X = 0x12, Y = 0xfe.
+    const uint8_t report[] = { 0x05, 0x12, 0xfe };
+    const uint32_t expected_values[] = { 1, 0, 1, 0, 0x12, 0xfe };
+    for (uint8_t ix = 0; ix != 6; ++ix) {
+        uint32_t value;
+        ASSERT_TRUE(hid::ExtractUint(report, sizeof(report), fields[ix], &value));
+        EXPECT_EQ(value, expected_values[ix]);
+    }
+
+    // A report too short to hold the field.
+    uint32_t value;
+    EXPECT_FALSE(hid::ExtractUint(report, 2, fields[5], &value));
+
+    END_TEST;
+}
+
 static bool parse_adaf_trinket() {
     BEGIN_TEST;
 
@@ -171,6 +202,10 @@ static bool parse_adaf_trinket() {
         EXPECT_EQ(hid::kScalar & fields[ix].flags, hid::kScalar);
     }
 
+    // The fields follow the report id byte.
+    EXPECT_EQ(fields[0].bit_offset, 8u);
+    EXPECT_EQ(fields[4].bit_offset, 16u);
+
     // First 3 fields are the buttons, with usages 1, 2, 3, in the button page.
     auto expected_flags = hid::kData | hid::kAbsolute;
 
@@ -573,6 +608,7 @@ static bool parse_acer12_touch() {
 BEGIN_TEST_CASE(hidparser_tests)
 RUN_TEST(itemize_acer12_rpt1)
 RUN_TEST(parse_boot_mouse)
+RUN_TEST(extract_boot_mouse)
 RUN_TEST(parse_adaf_trinket)
 RUN_TEST(parse_ps3_controller)
 RUN_TEST(parse_acer12_touch)
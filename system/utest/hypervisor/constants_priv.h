@@ -13,6 +13,7 @@
 #define VMO_SIZE        0x1000000
 #define TRAP_PORT       0x11
 #define TRAP_ADDR       (VMO_SIZE - PAGE_SIZE * 2)
+#define DIRTY_ADDR      (VMO_SIZE - PAGE_SIZE * 3)
 #define EXIT_TEST_ADDR  (VMO_SIZE - PAGE_SIZE)
 
 #if __x86_64__
@@ -11,6 +11,7 @@
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/hypervisor.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 #include <zx/port.h>
@@ -34,8 +35,12 @@ extern const char vcpu_read_write_state_start[];
 extern const char vcpu_read_write_state_end[];
 extern const char guest_set_trap_start[];
 extern const char guest_set_trap_end[];
+extern const char guest_set_trap_with_bells_start[];
+extern const char guest_set_trap_with_bells_end[];
 extern const char guest_set_trap_with_io_start[];
 extern const char guest_set_trap_with_io_end[];
+extern const char guest_get_dirty_pages_start[];
+extern const char guest_get_dirty_pages_end[];
 
 enum {
     X86_PTE_P = 0x01,  // P    Valid
@@ -385,6 +390,58 @@ static bool guest_set_trap_with_bell(void) {
     EXPECT_EQ(packet.type, ZX_PKT_TYPE_GUEST_BELL);
     EXPECT_EQ(packet.guest_bell.addr, TRAP_ADDR);
 
+    // One fault on TRAP_ADDR, and one on EXIT_TEST_ADDR.
+    zx_info_guest_stats_t stats;
+    ASSERT_EQ(zx_object_get_info(test.guest, ZX_INFO_GUEST_STATS, &stats, sizeof(stats),
+                                 nullptr, nullptr),
+              ZX_OK);
+    EXPECT_EQ(stats.trap_faults, 2u);
+
+    ASSERT_TRUE(teardown(&test));
+
+    END_TEST;
+}
+
+static bool guest_set_trap_with_bells(void) {
+    BEGIN_TEST;
+
+    test_t test;
+    ASSERT_TRUE(setup(&test, guest_set_trap_with_bells_start, guest_set_trap_with_bells_end));
+    if (!test.supported) {
+        // The hypervisor isn't supported, so don't run the test.
+        return true;
+    }
+
+    zx::port port;
+    ASSERT_EQ(zx::port::create(0, &port), ZX_OK);
+
+    // Trap on access of TRAP_ADDR.
+    ASSERT_EQ(zx_guest_set_trap(test.guest, ZX_GUEST_TRAP_BELL, TRAP_ADDR, PAGE_SIZE, port.get(),
+                                kTrapKey),
+              ZX_OK);
+
+    // The second access is coalesced with the packet for the first.
+    zx_port_packet_t packet = {};
+    ASSERT_EQ(zx_vcpu_resume(test.vcpu, &packet), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_GUEST_BELL);
+    EXPECT_EQ(packet.guest_bell.addr, EXIT_TEST_ADDR);
+
+    ASSERT_EQ(port.wait(zx::time::infinite(), &packet, 0), ZX_OK);
+    EXPECT_EQ(packet.key, kTrapKey);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_GUEST_BELL);
+    EXPECT_EQ(packet.guest_bell.addr, TRAP_ADDR);
+    EXPECT_EQ(packet.guest_bell.count, 1u);
+    EXPECT_EQ(port.wait(zx::time(), &packet, 0), ZX_ERR_TIMED_OUT);
+
+    // Once the packet has been dequeued, the next access queues another.
+    ASSERT_EQ(zx_vcpu_resume(test.vcpu, &packet), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_GUEST_BELL);
+    EXPECT_EQ(packet.guest_bell.addr, EXIT_TEST_ADDR);
+
+    ASSERT_EQ(port.wait(zx::time::infinite(), &packet, 0), ZX_OK);
+    EXPECT_EQ(packet.guest_bell.addr, TRAP_ADDR);
+    EXPECT_EQ(packet.guest_bell.count, 3u);
+
     ASSERT_TRUE(teardown(&test));
 
     END_TEST;
@@ -422,16 +479,66 @@ static bool guest_set_trap_with_io(void) {
     END_TEST;
 }
 
+static bool page_is_dirty(const uint8_t* bitmap, zx_vaddr_t addr) {
+    size_t page = addr / PAGE_SIZE;
+    return (bitmap[page / 8] & (1u << (page % 8))) != 0;
+}
+
+static bool guest_get_dirty_pages(void) {
+    BEGIN_TEST;
+
+    test_t test;
+    ASSERT_TRUE(setup(&test, guest_get_dirty_pages_start, guest_get_dirty_pages_end));
+    if (!test.supported) {
+        // The hypervisor isn't supported, so don't run the test.
+        return true;
+    }
+
+    // Clear whatever was dirtied by setting up the guest.
+    uint8_t bitmap[VMO_SIZE / PAGE_SIZE / 8];
+    zx_status_t status = zx_guest_get_dirty_pages(test.guest, 0, VMO_SIZE, bitmap,
+                                                  sizeof(bitmap));
+    if (status == ZX_ERR_NOT_SUPPORTED) {
+        // The processor doesn't track dirty pages, so don't run the test.
+        ASSERT_TRUE(teardown(&test));
+        return true;
+    }
+    ASSERT_EQ(status, ZX_OK);
+    EXPECT_EQ(zx_guest_get_dirty_pages(test.guest, 0, VMO_SIZE, bitmap, sizeof(bitmap) - 1),
+              ZX_ERR_BUFFER_TOO_SMALL);
+
+    zx_port_packet_t packet = {};
+    ASSERT_EQ(zx_vcpu_resume(test.vcpu, &packet), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_GUEST_BELL);
+    EXPECT_EQ(packet.guest_bell.addr, EXIT_TEST_ADDR);
+
+    memset(bitmap, 0, sizeof(bitmap));
+    ASSERT_EQ(zx_guest_get_dirty_pages(test.guest, 0, VMO_SIZE, bitmap, sizeof(bitmap)), ZX_OK);
+    EXPECT_TRUE(page_is_dirty(bitmap, DIRTY_ADDR));
+    EXPECT_FALSE(page_is_dirty(bitmap, GUEST_ENTRY));
+
+    // The dirty bits were cleared by the last call.
+    memset(bitmap, 0, sizeof(bitmap));
+    ASSERT_EQ(zx_guest_get_dirty_pages(test.guest, 0, VMO_SIZE, bitmap, sizeof(bitmap)), ZX_OK);
+    EXPECT_FALSE(page_is_dirty(bitmap, DIRTY_ADDR));
+
+    ASSERT_TRUE(teardown(&test));
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(guest)
 RUN_TEST(vcpu_resume)
 RUN_TEST(vcpu_read_write_state)
 RUN_TEST(vcpu_interrupt)
 RUN_TEST(guest_set_trap_with_mem)
 RUN_TEST(guest_set_trap_with_bell)
+RUN_TEST(guest_set_trap_with_bells)
 #if __aarch64__
 RUN_TEST(vcpu_wfi)
 #elif __x86_64__
 RUN_TEST(guest_set_trap_with_io)
+RUN_TEST(guest_get_dirty_pages)
 RUN_TEST(vcpu_hlt)
 #endif
 END_TEST_CASE(guest)
@@ -0,0 +1,87 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fdio/io.h>
+#include <unittest/unittest.h>
+#include <zircon/kcounters.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+bool map_file(const char* path, uintptr_t* addr, uint64_t* size) {
+    BEGIN_HELPER;
+
+    int fd = open(path, O_RDONLY);
+    ASSERT_GE(fd, 0, path);
+    zx_handle_t vmo;
+    ASSERT_EQ(fdio_get_exact_vmo(fd, &vmo), ZX_OK, "");
+    close(fd);
+    ASSERT_EQ(zx_vmo_get_size(vmo, size), ZX_OK, "");
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, *size,
+                          ZX_VM_FLAG_PERM_READ, addr), ZX_OK, "");
+    zx_handle_close(vmo);
+
+    END_HELPER;
+}
+
+uint64_t counter_total(const kcounters_desc_t* desc, const uint64_t* arena, size_t index) {
+    uint64_t sum = 0;
+    for (uint32_t cpu = 0; cpu < desc->max_cpus; ++cpu)
+        sum += __atomic_load_n(&arena[cpu * desc->num_counters + index], __ATOMIC_RELAXED);
+    return sum;
+}
+
+bool counters_are_live() {
+    BEGIN_TEST;
+
+    uintptr_t desc_addr, arena_addr;
+    uint64_t desc_size, arena_size;
+    ASSERT_TRUE(map_file("/boot/kernel/" KCOUNTERS_DESC_VMO_NAME, &desc_addr, &desc_size), "");
+    ASSERT_TRUE(map_file("/boot/kernel/" KCOUNTERS_ARENA_VMO_NAME, &arena_addr, &arena_size), "");
+
+    auto desc = reinterpret_cast<const kcounters_desc_t*>(desc_addr);
+    auto arena = reinterpret_cast<const uint64_t*>(arena_addr);
+    ASSERT_EQ(desc->magic, KCOUNTERS_DESC_MAGIC, "");
+    ASSERT_GE(desc_size, sizeof(*desc) + desc->num_counters * sizeof(kcounters_name_t), "");
+    ASSERT_GE(arena_size, desc->max_cpus * desc->num_counters * sizeof(uint64_t), "");
+
+    size_t index = desc->num_counters;
+    for (size_t i = 0; i < desc->num_counters; ++i) {
+        if (i > 0)
+            EXPECT_LT(strcmp(desc->names[i - 1].name, desc->names[i].name), 0, "sorted");
+        if (!strcmp(desc->names[i].name, "kernel.dispatcher.create"))
+            index = i;
+    }
+    ASSERT_LT(index, desc->num_counters, "kernel.dispatcher.create not found");
+
+    // The mapping sees the kernel's updates without any syscalls to read it.
+    const uint64_t before = counter_total(desc, arena, index);
+    constexpr int kNumEvents = 10;
+    zx_handle_t events[kNumEvents];
+    for (int i = 0; i < kNumEvents; ++i)
+        ASSERT_EQ(zx_event_create(0u, &events[i]), ZX_OK, "");
+    EXPECT_GE(counter_total(desc, arena, index), before + kNumEvents, "");
+    for (int i = 0; i < kNumEvents; ++i)
+        zx_handle_close(events[i]);
+
+    zx_vmar_unmap(zx_vmar_root_self(), desc_addr, desc_size);
+    zx_vmar_unmap(zx_vmar_root_self(), arena_addr, arena_size);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(kcounters_tests)
+RUN_TEST(counters_are_live)
+END_TEST_CASE(kcounters_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -15,6 +15,7 @@
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
+#include <inttypes.h>
 #include <limits.h>
 
 #include <fdio/util.h>
@@ -125,9 +126,67 @@ static bool argument_size_test(void) {
     return ok;
 }
 
+static const char* const true_argv[] = { "/boot/bin/sh", "-c", ":" };
+
+// Runs |true_argv| to completion, loaded from |tmpl| if it's not NULL.
+static bool run_true(launchpad_template_t* tmpl) {
+    BEGIN_HELPER;
+
+    launchpad_t* lp;
+    ASSERT_EQ(launchpad_create(ZX_HANDLE_INVALID, "template test", &lp), ZX_OK, "");
+    EXPECT_EQ(launchpad_set_args(lp, countof(true_argv), true_argv), ZX_OK, "");
+    if (tmpl != NULL) {
+        EXPECT_EQ(launchpad_load_from_template(lp, tmpl), ZX_OK, "");
+    } else {
+        EXPECT_EQ(launchpad_load_from_file(lp, true_argv[0]), ZX_OK, "");
+    }
+
+    zx_handle_t proc = ZX_HANDLE_INVALID;
+    const char* errmsg = "???";
+    ASSERT_EQ(launchpad_go(lp, &proc, &errmsg), ZX_OK, errmsg);
+    EXPECT_EQ(zx_object_wait_one(proc, ZX_PROCESS_TERMINATED,
+                                 ZX_TIME_INFINITE, NULL), ZX_OK, "");
+    zx_info_process_t info;
+    EXPECT_EQ(zx_object_get_info(proc, ZX_INFO_PROCESS,
+                                 &info, sizeof(info), NULL, NULL), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(proc), ZX_OK, "");
+    EXPECT_EQ(info.return_code, 0, "shell exit status");
+
+    END_HELPER;
+}
+
+static bool template_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t vmo;
+    ASSERT_EQ(launchpad_vmo_from_file(true_argv[0], &vmo), ZX_OK, "");
+    launchpad_template_t* tmpl = NULL;
+    ASSERT_EQ(launchpad_template_create(vmo, ZX_HANDLE_INVALID, &tmpl), ZX_OK, "");
+
+    // Spawn latency, from launchpad_create until the process has exited,
+    // loading the executable afresh and from the template.
+    const int kRuns = 50;
+    zx_time_t fresh = 0, templated = 0;
+    for (int i = 0; i < kRuns; ++i) {
+        zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        ASSERT_TRUE(run_true(NULL), "");
+        zx_time_t middle = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        ASSERT_TRUE(run_true(tmpl), "");
+        templated += zx_clock_get(ZX_CLOCK_MONOTONIC) - middle;
+        fresh += middle - start;
+    }
+    unittest_printf("spawn: %" PRIu64 "us loaded, %" PRIu64 "us from template\n",
+                    fresh / kRuns / 1000, templated / kRuns / 1000);
+
+    launchpad_template_destroy(tmpl);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(launchpad_tests)
 RUN_TEST(launchpad_test);
 RUN_TEST(argument_size_test);
+RUN_TEST(template_test);
 END_TEST_CASE(launchpad_tests)
 
 int main(int argc, char **argv)
@@ -471,6 +471,92 @@ static bool set_chaining_test() {
     END_TEST;
 }
 
+// Counts the accesses made through a TracedRegisterIo.
+struct CountingTracer {
+    static unsigned reads;
+    static unsigned writes;
+    static uint64_t last_value;
+
+    static void OnRead(uintptr_t base, uint32_t offset, uint64_t value, size_t width) {
+        reads++;
+        last_value = value;
+    }
+    static void OnWrite(uintptr_t base, uint32_t offset, uint64_t value, size_t width) {
+        writes++;
+        last_value = value;
+    }
+};
+unsigned CountingTracer::reads;
+unsigned CountingTracer::writes;
+uint64_t CountingTracer::last_value;
+
+class UpdateTestReg : public hwreg::RegisterBase<UpdateTestReg, uint32_t> {
+public:
+    DEF_RSVDZ_BIT(31);
+    DEF_FIELD(30, 21, field1);
+    DEF_FIELD(20, 12, field2);
+    DEF_BIT(0, field3);
+
+    static auto Get() { return hwreg::RegisterAddr<UpdateTestReg>(0); }
+};
+
+static bool update_test() {
+    BEGIN_TEST;
+
+    volatile uint32_t fake_reg = ~0u;
+    hwreg::TracedRegisterIo<CountingTracer> mmio(&fake_reg);
+    CountingTracer::reads = CountingTracer::writes = 0;
+
+    auto reg = UpdateTestReg::Get().Update(&mmio, [](auto& reg) {
+        reg.set_field1(0x234);
+        reg.set_field2(0x123);
+        reg.set_field3(0);
+    });
+    EXPECT_EQ(1u, CountingTracer::reads);
+    EXPECT_EQ(1u, CountingTracer::writes);
+
+    // Undefined bits are preserved and RsvdZ bits are cleared.
+    uint32_t expected = (0x234u << 21) | (0x123u << 12) | 0xffeu;
+    EXPECT_EQ(expected, fake_reg);
+    EXPECT_EQ(expected, CountingTracer::last_value);
+    EXPECT_EQ(0x234u, reg.field1());
+
+    END_TEST;
+}
+
+static bool shadowed_register_test() {
+    BEGIN_TEST;
+
+    volatile uint32_t fake_reg = 0;
+    hwreg::TracedRegisterIo<CountingTracer> mmio(&fake_reg);
+    CountingTracer::reads = CountingTracer::writes = 0;
+
+    hwreg::ShadowedRegister<UpdateTestReg> shadow(UpdateTestReg::Get());
+    shadow.Reset(0x2u);
+
+    // Updates go from the shadow, never reading the register.
+    shadow.Update(&mmio, [](auto& reg) { reg.set_field1(0x111); });
+    shadow.Update(&mmio, [](auto& reg) { reg.set_field3(1); });
+    EXPECT_EQ(0u, CountingTracer::reads);
+    EXPECT_EQ(2u, CountingTracer::writes);
+    EXPECT_EQ((0x111u << 21) | 0x3u, fake_reg);
+    EXPECT_EQ(0x111u, shadow.value().field1());
+
+    // Unchanged values are not written again.
+    EXPECT_FALSE(shadow.UpdateIfChanged(&mmio, [](auto& reg) { reg.set_field3(1); }));
+    EXPECT_EQ(2u, CountingTracer::writes);
+    EXPECT_TRUE(shadow.UpdateIfChanged(&mmio, [](auto& reg) { reg.set_field2(0x5); }));
+    EXPECT_EQ(3u, CountingTracer::writes);
+    EXPECT_EQ((0x111u << 21) | (0x5u << 12) | 0x3u, fake_reg);
+
+    // Loading picks up changes made behind the shadow's back.
+    fake_reg = 0x1u;
+    EXPECT_EQ(0u, shadow.Load(&mmio).field1());
+    EXPECT_EQ(1u, CountingTracer::reads);
+
+    END_TEST;
+}
+
 // Compile-time test that not enabling printing functions provides a size reduction
 static void printer_size_reduction() {
     class TestRegWithPrinter : public hwreg::RegisterBase<TestRegWithPrinter, uint64_t,
@@ -496,6 +582,8 @@ RUN_TEST(reg_rsvdz_full_test)
 RUN_TEST(reg_field_test)
 RUN_TEST(print_test)
 RUN_TEST(set_chaining_test)
+RUN_TEST(update_test)
+RUN_TEST(shadowed_register_test)
 END_TEST_CASE(libhwreg_tests)
 
 int main(int argc, char** argv) {
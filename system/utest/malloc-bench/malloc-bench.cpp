@@ -0,0 +1,242 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+// Allocations each thread keeps live at once in the multi-threaded cases,
+// so that frees are not simply undoing the allocation just made.
+constexpr size_t kBatch = 64;
+// Slots in the queue between the producer and the consumer.
+constexpr size_t kQueueSize = 1024;
+
+inline uint64_t ticks_to_ns(uint64_t ticks) {
+    return ticks * 1000000000ull / zx_ticks_per_second();
+}
+
+inline void report(const char* name, uint64_t ticks, size_t ops) {
+    printf("Benchmark %-40s: [%8lu] ns/op\n", name, ticks_to_ns(ticks) / ops);
+}
+
+size_t private_bytes() {
+    zx_info_task_stats_t info;
+    if (zx_object_get_info(zx_process_self(), ZX_INFO_TASK_STATS, &info, sizeof(info),
+                           nullptr, nullptr) != ZX_OK) {
+        return 0;
+    }
+    return info.mem_private_bytes;
+}
+
+// Allocates |kBatch| blocks, touches each, then frees them, until |ops|
+// blocks have been allocated.
+template <size_t Size>
+void alloc_free_loop(size_t ops) {
+    void* ptrs[kBatch];
+    for (size_t i = 0; i < ops; i += kBatch) {
+        for (size_t j = 0; j < kBatch; j++) {
+            ptrs[j] = malloc(Size);
+            static_cast<volatile uint8_t*>(ptrs[j])[0] = 1;
+        }
+        for (size_t j = 0; j < kBatch; j++) {
+            free(ptrs[j]);
+        }
+    }
+}
+
+// The uncontended cost of a malloc and free pair.
+template <size_t Size, size_t Ops>
+bool benchmark_single_thread(void) {
+    BEGIN_TEST;
+    alloc_free_loop<Size>(kBatch);
+
+    uint64_t start = zx_ticks_get();
+    alloc_free_loop<Size>(Ops);
+    uint64_t ticks = zx_ticks_get() - start;
+
+    char name[64];
+    snprintf(name, sizeof(name), "single_thread/%zuB", Size);
+    report(name, ticks, Ops);
+    END_TEST;
+}
+
+struct ThreadArgs {
+    volatile bool* go;
+    size_t ops;
+    uint64_t ticks;
+};
+
+template <size_t Size>
+int alloc_free_thread(void* arg) {
+    ThreadArgs* args = static_cast<ThreadArgs*>(arg);
+    while (!*args->go) {
+    }
+    uint64_t start = zx_ticks_get();
+    alloc_free_loop<Size>(args->ops);
+    args->ticks = zx_ticks_get() - start;
+    return 0;
+}
+
+// |Threads| threads allocating and freeing at once. With a global heap lock
+// the cost per operation grows with the thread count; with per-thread caches
+// it should stay close to the single-threaded case.
+template <size_t Threads, size_t Size, size_t Ops>
+bool benchmark_threads(void) {
+    BEGIN_TEST;
+    volatile bool go = false;
+    ThreadArgs args[Threads];
+    thrd_t threads[Threads];
+    for (size_t i = 0; i < Threads; i++) {
+        args[i] = {&go, Ops, 0};
+        ASSERT_EQ(thrd_create(&threads[i], alloc_free_thread<Size>, &args[i]), thrd_success);
+    }
+    go = true;
+
+    uint64_t ticks = 0;
+    for (size_t i = 0; i < Threads; i++) {
+        ASSERT_EQ(thrd_join(threads[i], nullptr), thrd_success);
+        ticks = fbl::max(ticks, args[i].ticks);
+    }
+
+    // The time for every thread to finish, per operation on one thread.
+    char name[64];
+    snprintf(name, sizeof(name), "threads/%zu/%zuB", Threads, Size);
+    report(name, ticks, Ops);
+    END_TEST;
+}
+
+// A single-producer, single-consumer ring of pointers. A null slot is
+// empty.
+struct Queue {
+    void* volatile slots[kQueueSize];
+    size_t count;
+};
+
+template <size_t Size>
+int consumer_thread(void* arg) {
+    Queue* queue = static_cast<Queue*>(arg);
+    for (size_t i = 0; i < queue->count; i++) {
+        void* volatile& slot = queue->slots[i % kQueueSize];
+        void* ptr;
+        while ((ptr = __atomic_load_n(&slot, __ATOMIC_ACQUIRE)) == nullptr) {
+        }
+        __atomic_store_n(&slot, nullptr, __ATOMIC_RELEASE);
+        free(ptr);
+    }
+    return 0;
+}
+
+// One thread allocates and another frees, as when requests are handed from
+// a dispatcher to a worker. Each free returns memory to the cache or arena
+// of a different thread than the one freeing it.
+template <size_t Size, size_t Ops>
+bool benchmark_producer_consumer(void) {
+    BEGIN_TEST;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Queue> queue(new (&ac) Queue);
+    ASSERT_TRUE(ac.check());
+    memset(const_cast<void**>(queue->slots), 0, sizeof(queue->slots));
+    queue->count = Ops;
+
+    uint64_t start = zx_ticks_get();
+    thrd_t consumer;
+    ASSERT_EQ(thrd_create(&consumer, consumer_thread<Size>, queue.get()), thrd_success);
+    for (size_t i = 0; i < Ops; i++) {
+        void* ptr = malloc(Size);
+        static_cast<volatile uint8_t*>(ptr)[0] = 1;
+        void* volatile& slot = queue->slots[i % kQueueSize];
+        while (__atomic_load_n(&slot, __ATOMIC_ACQUIRE) != nullptr) {
+        }
+        __atomic_store_n(&slot, ptr, __ATOMIC_RELEASE);
+    }
+    ASSERT_EQ(thrd_join(consumer, nullptr), thrd_success);
+    uint64_t ticks = zx_ticks_get() - start;
+
+    char name[64];
+    snprintf(name, sizeof(name), "producer_consumer/%zuB", Size);
+    report(name, ticks, Ops);
+    END_TEST;
+}
+
+// Fills the heap with blocks of random sizes, frees every other one, then
+// allocates blocks too large for the holes left behind. Reports the time
+// taken and how much memory the process holds compared to what is live,
+// both at the peak and once everything has been freed.
+template <size_t Count, size_t MaxSize>
+bool benchmark_fragmentation(void) {
+    BEGIN_TEST;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<void*[]> ptrs(new (&ac) void*[Count]);
+    ASSERT_TRUE(ac.check());
+    fbl::unique_ptr<size_t[]> sizes(new (&ac) size_t[Count]);
+    ASSERT_TRUE(ac.check());
+
+    unsigned int seed = 0x6d616c6c;
+    const size_t base = private_bytes();
+    size_t live = 0;
+
+    uint64_t start = zx_ticks_get();
+    for (size_t i = 0; i < Count; i++) {
+        sizes[i] = 16 + rand_r(&seed) % (MaxSize - 16);
+        ptrs[i] = malloc(sizes[i]);
+        ASSERT_NONNULL(ptrs[i]);
+        memset(ptrs[i], 0xa5, sizes[i]);
+        live += sizes[i];
+    }
+    for (size_t i = 0; i < Count; i += 2) {
+        free(ptrs[i]);
+        live -= sizes[i];
+    }
+    for (size_t i = 0; i < Count; i += 2) {
+        sizes[i] = MaxSize + rand_r(&seed) % MaxSize;
+        ptrs[i] = malloc(sizes[i]);
+        ASSERT_NONNULL(ptrs[i]);
+        memset(ptrs[i], 0x5a, sizes[i]);
+        live += sizes[i];
+    }
+    uint64_t ticks = zx_ticks_get() - start;
+    const size_t peak = fbl::max(private_bytes(), base) - base;
+
+    for (size_t i = 0; i < Count; i++) {
+        free(ptrs[i]);
+    }
+    const size_t after = fbl::max(private_bytes(), base) - base;
+
+    char name[64];
+    snprintf(name, sizeof(name), "fragmentation/%zu/%zuB", Count, MaxSize);
+    report(name, ticks, Count + Count / 2);
+    printf("  live %zu KB, held %zu KB (%.2fx), held after free %zu KB\n", live / 1024,
+           peak / 1024, live != 0 ? static_cast<double>(peak) / live : 0.0, after / 1024);
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(malloc_benchmarks)
+RUN_TEST_PERFORMANCE((benchmark_single_thread<16, 1 << 20>))
+RUN_TEST_PERFORMANCE((benchmark_single_thread<256, 1 << 20>))
+RUN_TEST_PERFORMANCE((benchmark_single_thread<4096, 1 << 18>))
+RUN_TEST_PERFORMANCE((benchmark_single_thread<65536, 1 << 14>))
+RUN_TEST_PERFORMANCE((benchmark_threads<1, 64, 1 << 20>))
+RUN_TEST_PERFORMANCE((benchmark_threads<2, 64, 1 << 20>))
+RUN_TEST_PERFORMANCE((benchmark_threads<4, 64, 1 << 20>))
+RUN_TEST_PERFORMANCE((benchmark_threads<8, 64, 1 << 20>))
+RUN_TEST_PERFORMANCE((benchmark_threads<4, 4096, 1 << 18>))
+RUN_TEST_PERFORMANCE((benchmark_producer_consumer<64, 1 << 20>))
+RUN_TEST_PERFORMANCE((benchmark_producer_consumer<4096, 1 << 18>))
+RUN_TEST_PERFORMANCE((benchmark_fragmentation<1 << 16, 1024>))
+RUN_TEST_PERFORMANCE((benchmark_fragmentation<1 << 12, 65536>))
+END_TEST_CASE(malloc_benchmarks)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
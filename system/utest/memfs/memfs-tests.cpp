@@ -3,8 +3,12 @@
 // found in the LICENSE file.
 
 #include <dirent.h>
+#include <limits.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <threads.h>
 #include <unistd.h>
@@ -130,10 +134,151 @@ bool test_memfs_close_during_access() {
     END_TEST;
 }
 
+// Creates, looks up, renames and unlinks every file of a directory far larger
+// than most, checking that readdir sees each exactly once along the way.
+bool test_memfs_large_directory() {
+    BEGIN_TEST;
+
+    constexpr size_t kFileCount = 20000;
+
+    async::Loop loop;
+    ASSERT_EQ(loop.StartThread(), ZX_OK);
+
+    memfs_filesystem_t* vfs;
+    zx_handle_t root;
+    ASSERT_EQ(memfs_create_filesystem(loop.async(), &vfs, &root), ZX_OK);
+    uint32_t type = PA_FDIO_REMOTE;
+    int fd;
+    ASSERT_EQ(fdio_create_fd(&root, &type, 1, &fd), ZX_OK);
+    DIR* d = fdopendir(fd);
+
+    char name[32];
+    char other[32];
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (size_t i = 0; i < kFileCount; i++) {
+        snprintf(name, sizeof(name), "file-%zu", i);
+        fd = openat(dirfd(d), name, O_CREAT | O_EXCL | O_RDWR);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(close(fd), 0);
+    }
+    zx_time_t created = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (size_t i = 0; i < kFileCount; i++) {
+        snprintf(name, sizeof(name), "file-%zu", i);
+        struct stat st;
+        ASSERT_EQ(fstatat(dirfd(d), name, &st, 0), 0);
+    }
+    zx_time_t looked_up = zx_clock_get(ZX_CLOCK_MONOTONIC);
+
+    size_t count = 0;
+    struct dirent* de;
+    while ((de = readdir(d)) != nullptr) {
+        if (strcmp(de->d_name, ".")) {
+            count++;
+        }
+    }
+    ASSERT_EQ(count, kFileCount);
+
+    // Rename half of the files within the directory, then make sure both the
+    // old and new names resolve as they should.
+    for (size_t i = 0; i < kFileCount; i += 2) {
+        snprintf(name, sizeof(name), "file-%zu", i);
+        snprintf(other, sizeof(other), "renamed-%zu", i);
+        ASSERT_EQ(renameat(dirfd(d), name, dirfd(d), other), 0);
+    }
+    for (size_t i = 0; i < kFileCount; i++) {
+        snprintf(name, sizeof(name), "file-%zu", i);
+        snprintf(other, sizeof(other), "renamed-%zu", i);
+        struct stat st;
+        ASSERT_EQ(fstatat(dirfd(d), name, &st, 0), (i % 2) ? 0 : -1);
+        ASSERT_EQ(fstatat(dirfd(d), other, &st, 0), (i % 2) ? -1 : 0);
+    }
+
+    zx_time_t unlink_start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (size_t i = 0; i < kFileCount; i++) {
+        snprintf(name, sizeof(name), (i % 2) ? "file-%zu" : "renamed-%zu", i);
+        ASSERT_EQ(unlinkat(dirfd(d), name, 0), 0);
+    }
+    zx_time_t unlinked = zx_clock_get(ZX_CLOCK_MONOTONIC);
+
+    rewinddir(d);
+    ASSERT_NONNULL((de = readdir(d)));
+    ASSERT_EQ(strcmp(de->d_name, "."), 0);
+    ASSERT_NULL(readdir(d));
+
+    printf("\nBenchmark %zu files: create [%6lu] ms, lookup [%6lu] ms, unlink [%6lu] ms\n",
+           kFileCount, (created - start) / ZX_MSEC(1), (looked_up - created) / ZX_MSEC(1),
+           (unlinked - unlink_start) / ZX_MSEC(1));
+
+    ASSERT_EQ(closedir(d), 0);
+    loop.Shutdown();
+    ASSERT_EQ(memfs_free_filesystem(vfs, 0), ZX_OK);
+
+    END_TEST;
+}
+
+// Writes far past the end of a file, and past the configured size limit,
+// and reads the file back over a connection opened only for reading.
+bool test_memfs_sparse_file_and_limit() {
+    BEGIN_TEST;
+
+    constexpr size_t kHoleSize = 16 * 1024 * 1024;
+    constexpr size_t kMaxFileSize = 32 * 1024 * 1024;
+
+    async::Loop loop;
+    ASSERT_EQ(loop.StartThread(), ZX_OK);
+
+    memfs_filesystem_t* vfs;
+    zx_handle_t root;
+    ASSERT_EQ(memfs_create_filesystem(loop.async(), &vfs, &root), ZX_OK);
+    memfs_set_max_file_size(vfs, kMaxFileSize);
+    uint32_t type = PA_FDIO_REMOTE;
+    int fd;
+    ASSERT_EQ(fdio_create_fd(&root, &type, 1, &fd), ZX_OK);
+    DIR* d = fdopendir(fd);
+
+    fd = openat(dirfd(d), "sparse", O_CREAT | O_RDWR);
+    ASSERT_GE(fd, 0);
+    const char* data = "hello";
+    const ssize_t datalen = strlen(data);
+    ASSERT_EQ(pwrite(fd, data, datalen, kHoleSize), datalen);
+    // A page of zeros written into the hole reads back the same.
+    static const char zeros[PAGE_SIZE] = {};
+    ASSERT_EQ(pwrite(fd, zeros, sizeof(zeros), kHoleSize + PAGE_SIZE),
+              static_cast<ssize_t>(sizeof(zeros)));
+    ASSERT_EQ(pwrite(fd, data, datalen, kMaxFileSize), -1);
+    ASSERT_EQ(errno, EFBIG);
+    ASSERT_EQ(ftruncate(fd, kMaxFileSize + 1), -1);
+    ASSERT_EQ(close(fd), 0);
+
+    fd = openat(dirfd(d), "sparse", O_RDONLY);
+    ASSERT_GE(fd, 0);
+    struct stat st;
+    ASSERT_EQ(fstat(fd, &st), 0);
+    ASSERT_EQ(st.st_size, static_cast<off_t>(kHoleSize + 2 * PAGE_SIZE));
+    char buf[PAGE_SIZE];
+    ASSERT_EQ(pread(fd, buf, sizeof(buf), kHoleSize / 2), static_cast<ssize_t>(sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, zeros, sizeof(buf)), 0);
+    ASSERT_EQ(pread(fd, buf, datalen, kHoleSize), datalen);
+    ASSERT_EQ(memcmp(buf, data, datalen), 0);
+    ASSERT_EQ(pread(fd, buf, sizeof(buf), kHoleSize + PAGE_SIZE),
+              static_cast<ssize_t>(sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, zeros, sizeof(buf)), 0);
+    ASSERT_EQ(close(fd), 0);
+
+    ASSERT_EQ(unlinkat(dirfd(d), "sparse", 0), 0);
+    ASSERT_EQ(closedir(d), 0);
+    loop.Shutdown();
+    ASSERT_EQ(memfs_free_filesystem(vfs, 0), ZX_OK);
+
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(memfs_tests)
 RUN_TEST(test_memfs_null)
 RUN_TEST(test_memfs_basic)
 RUN_TEST(test_memfs_close_during_access)
+RUN_TEST(test_memfs_sparse_file_and_limit)
+RUN_TEST_PERFORMANCE(test_memfs_large_directory)
 END_TEST_CASE(memfs_tests)
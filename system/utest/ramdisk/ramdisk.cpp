@@ -480,6 +480,78 @@ bool ramdisk_test_fifo_basic(void) {
     END_TEST;
 }
 
+// Ops on the same blocks must take effect in the order they were queued, even
+// though the ramdisk runs ops on several threads.
+bool ramdisk_test_fifo_overlapping_ops(void) {
+    BEGIN_TEST;
+    const size_t kBlockSize = PAGE_SIZE;
+    const size_t kNumOps = 16;
+    int fd = get_ramdisk(kBlockSize, 64);
+    zx_handle_t fifo;
+    ssize_t expected = sizeof(fifo);
+    ASSERT_EQ(ioctl_block_get_fifos(fd, &fifo), expected, "Failed to get FIFO");
+    txnid_t txnid;
+    expected = sizeof(txnid_t);
+    ASSERT_EQ(ioctl_block_alloc_txn(fd, &txnid), expected, "Failed to allocate txn");
+
+    // Block i of the VMO is filled with i, so block 0 is all zeroes.
+    uint64_t vmo_size = kBlockSize * kNumOps;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(vmo_size, 0, &vmo), ZX_OK, "Failed to create VMO");
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[vmo_size]);
+    ASSERT_TRUE(ac.check());
+    for (size_t i = 0; i < kNumOps; i++) {
+        memset(&buf[i * kBlockSize], static_cast<int>(i), kBlockSize);
+    }
+    size_t actual;
+    ASSERT_EQ(zx_vmo_write(vmo, buf.get(), 0, vmo_size, &actual), ZX_OK);
+
+    vmoid_t vmoid;
+    expected = sizeof(vmoid_t);
+    zx_handle_t xfer_vmo;
+    ASSERT_EQ(zx_handle_duplicate(vmo, ZX_RIGHT_SAME_RIGHTS, &xfer_vmo), ZX_OK);
+    ASSERT_EQ(ioctl_block_attach_vmo(fd, &xfer_vmo, &vmoid), expected,
+              "Failed to attach vmo");
+    fifo_client_t* client;
+    ASSERT_EQ(block_fifo_create_client(fifo, &client), ZX_OK);
+
+    // In one batch, write every block of the VMO over device block 0, ending
+    // with the block of zeroes, and write block 5 over device block 1.
+    block_fifo_request_t requests[kNumOps + 1];
+    for (size_t i = 0; i < kNumOps; i++) {
+        requests[i].txnid      = txnid;
+        requests[i].vmoid      = vmoid;
+        requests[i].opcode     = BLOCKIO_WRITE;
+        requests[i].length     = 1;
+        requests[i].vmo_offset = kNumOps - 1 - i;
+        requests[i].dev_offset = 0;
+    }
+    requests[kNumOps] = requests[0];
+    requests[kNumOps].vmo_offset = 5;
+    requests[kNumOps].dev_offset = 1;
+    ASSERT_EQ(block_fifo_txn(client, requests, fbl::count_of(requests)), ZX_OK);
+
+    // Read the device blocks back into the start of the VMO.
+    block_fifo_request_t read = requests[0];
+    read.opcode = BLOCKIO_READ;
+    read.vmo_offset = 0;
+    read.length = 2;
+    ASSERT_EQ(block_fifo_txn(client, &read, 1), ZX_OK);
+    fbl::unique_ptr<uint8_t[]> out(new (&ac) uint8_t[kBlockSize * 2]);
+    ASSERT_TRUE(ac.check());
+    ASSERT_EQ(zx_vmo_read(vmo, out.get(), 0, kBlockSize * 2, &actual), ZX_OK);
+    ASSERT_EQ(memcmp(&out[0], &buf[0], kBlockSize), 0, "Last write of block 0 lost");
+    ASSERT_EQ(memcmp(&out[kBlockSize], &buf[5 * kBlockSize], kBlockSize), 0,
+              "Last write of block 1 lost");
+
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    block_fifo_release_client(client);
+    ASSERT_GE(ioctl_ramdisk_unlink(fd), 0, "Could not unlink ramdisk device");
+    ASSERT_EQ(close(fd), 0);
+    END_TEST;
+}
+
 typedef struct {
     uint64_t vmo_size;
     zx_handle_t vmo;
@@ -1197,6 +1269,7 @@ RUN_TEST_SMALL(ramdisk_test_release_during_fifo_access)
 RUN_TEST_SMALL(ramdisk_test_multiple)
 RUN_TEST_SMALL(ramdisk_test_fifo_no_op)
 RUN_TEST_SMALL(ramdisk_test_fifo_basic)
+RUN_TEST_SMALL(ramdisk_test_fifo_overlapping_ops)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo)
 RUN_TEST_SMALL(ramdisk_test_fifo_multiple_vmo_multithreaded)
 // TODO(smklein): Test ops across different vmos
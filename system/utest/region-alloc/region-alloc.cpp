@@ -237,10 +237,74 @@ static bool ralloc_subtract_test() {
 
 } //namespace
 
+static bool ralloc_cache_test() {
+    BEGIN_TEST;
+
+    RegionAllocator alloc(RegionAllocator::RegionPool::Create(REGION_POOL_MAX_SIZE));
+    alloc.SetCacheDepth(2);
+    ASSERT_EQ(ZX_OK, alloc.AddRegion({ .base = 0x10000, .size = 0x10000 }));
+
+    // Released power-of-two sized regions are held back for reuse, but still
+    // count as available.
+    auto r1 = alloc.GetRegion(0x1000, 0x1000);
+    auto r2 = alloc.GetRegion(0x1000, 0x1000);
+    auto r3 = alloc.GetRegion(0x1000, 0x1000);
+    ASSERT_NONNULL(r1);
+    ASSERT_NONNULL(r2);
+    ASSERT_NONNULL(r3);
+    EXPECT_EQ(0x11000u, r2->base);
+    EXPECT_EQ(0x12000u, r3->base);
+    r3.reset();
+    r2.reset();
+    EXPECT_EQ(1u, alloc.AllocatedRegionCount());
+    EXPECT_EQ(3u, alloc.AvailableRegionCount());
+
+    // The most recently released region comes back first, unless it is not
+    // aligned well enough.
+    auto r4 = alloc.GetRegion(0x1000, 0x2000);
+    ASSERT_NONNULL(r4);
+    EXPECT_EQ(0x12000u, r4->base);
+    auto r5 = alloc.GetRegion(0x1000, 0x1000);
+    ASSERT_NONNULL(r5);
+    EXPECT_EQ(0x11000u, r5->base);
+
+    // Once the cache holds two regions of a size, more are merged back in.
+    r1.reset();
+    r4.reset();
+    r5.reset();
+    EXPECT_EQ(0u, alloc.AllocatedRegionCount());
+
+    // A request which only fits once the cached regions are merged back in
+    // still succeeds.
+    auto all = alloc.GetRegion(0x10000, 0x1000);
+    ASSERT_NONNULL(all);
+    EXPECT_EQ(0x10000u, all->base);
+    all.reset();
+
+    // Adding and subtracting see through the cache.
+    auto r6 = alloc.GetRegion(0x1000, 0x1000);
+    ASSERT_NONNULL(r6);
+    r6.reset();
+    EXPECT_EQ(ZX_OK, alloc.SubtractRegion({ .base = 0x10000, .size = 0x10000 }));
+    EXPECT_EQ(0u, alloc.AvailableRegionCount());
+    EXPECT_EQ(ZX_OK, alloc.AddRegion({ .base = 0x10000, .size = 0x10000 }));
+    EXPECT_EQ(1u, alloc.AvailableRegionCount());
+
+    // Disabling the cache puts everything back.
+    auto r7 = alloc.GetRegion(0x1000, 0x1000);
+    ASSERT_NONNULL(r7);
+    r7.reset();
+    alloc.SetCacheDepth(0);
+    EXPECT_EQ(1u, alloc.AvailableRegionCount());
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(ralloc_tests)
 RUN_NAMED_TEST("Region Pools",   ralloc_region_pools_test)
 RUN_NAMED_TEST("Alloc by size",  ralloc_by_size_test)
 RUN_NAMED_TEST("Alloc specific", ralloc_specific_test)
 RUN_NAMED_TEST("Add/Overlap",    ralloc_add_overlap_test)
 RUN_NAMED_TEST("Subtract",       ralloc_subtract_test)
+RUN_NAMED_TEST("Region cache",   ralloc_cache_test)
 END_TEST_CASE(ralloc_tests)
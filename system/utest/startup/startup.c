@@ -0,0 +1,147 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// These measure how long a process takes from launch to exit when it
+// does nothing else, and check that bootstrap messages too big to be
+// read in one go still arrive intact.
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <launchpad/launchpad.h>
+#include <zircon/process.h>
+#include <zircon/processargs.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+#include <runtime/processargs.h>
+#include <unittest/unittest.h>
+
+// argv[0]
+static const char* program_path;
+
+// The child checks that it got this many arguments of kArgLength
+// characters each, and this many PA_USER0 handles.
+static const char kChildFlag[] = "--startup-child";
+#define kArgLength 100
+
+static char* make_arg(int i) {
+    char* arg = malloc(kArgLength + 1);
+    memset(arg, 'a' + i % 26, kArgLength);
+    arg[kArgLength] = '\0';
+    return arg;
+}
+
+static int child_main(int argc, char** argv) {
+    int nargs = atoi(argv[2]);
+    int nhandles = atoi(argv[3]);
+    if (argc != 4 + nargs)
+        return 1;
+    for (int i = 0; i < nargs; ++i) {
+        char* expected = make_arg(i);
+        bool same = strcmp(argv[4 + i], expected) == 0;
+        free(expected);
+        if (!same)
+            return 2;
+    }
+    for (int i = 0; i < nhandles; ++i) {
+        zx_handle_t h = zx_get_startup_handle(PA_HND(PA_USER0, i));
+        if (h == ZX_HANDLE_INVALID)
+            return 3;
+        zx_handle_close(h);
+    }
+    return 0;
+}
+
+// Runs the child with |nargs| extra arguments and |nhandles| extra
+// handles, adding the time from launch until it has exited to |*total|.
+static bool run_child(int nargs, int nhandles, zx_time_t* total) {
+    BEGIN_HELPER;
+
+    char nargs_str[16], nhandles_str[16];
+    snprintf(nargs_str, sizeof(nargs_str), "%d", nargs);
+    snprintf(nhandles_str, sizeof(nhandles_str), "%d", nhandles);
+    const char* argv[4 + nargs];
+    argv[0] = program_path;
+    argv[1] = kChildFlag;
+    argv[2] = nargs_str;
+    argv[3] = nhandles_str;
+    for (int i = 0; i < nargs; ++i) {
+        argv[4 + i] = make_arg(i);
+    }
+
+    launchpad_t* lp;
+    ASSERT_EQ(launchpad_create(ZX_HANDLE_INVALID, "startup test", &lp), ZX_OK, "");
+    EXPECT_EQ(launchpad_load_from_file(lp, program_path), ZX_OK, "");
+    EXPECT_EQ(launchpad_set_args(lp, countof(argv), argv), ZX_OK, "");
+    for (int i = 0; i < nargs; ++i) {
+        free((void*)argv[4 + i]);
+    }
+    for (int i = 0; i < nhandles; ++i) {
+        zx_handle_t event;
+        ASSERT_EQ(zx_event_create(0, &event), ZX_OK, "");
+        EXPECT_EQ(launchpad_add_handle(lp, event, PA_HND(PA_USER0, i)), ZX_OK, "");
+    }
+
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    zx_handle_t proc = ZX_HANDLE_INVALID;
+    const char* errmsg = "???";
+    ASSERT_EQ(launchpad_go(lp, &proc, &errmsg), ZX_OK, errmsg);
+    EXPECT_EQ(zx_object_wait_one(proc, ZX_PROCESS_TERMINATED,
+                                 ZX_TIME_INFINITE, NULL), ZX_OK, "");
+    *total += zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+
+    zx_info_process_t info;
+    EXPECT_EQ(zx_object_get_info(proc, ZX_INFO_PROCESS,
+                                 &info, sizeof(info), NULL, NULL), ZX_OK, "");
+    EXPECT_EQ(zx_handle_close(proc), ZX_OK, "");
+    EXPECT_EQ(info.return_code, 0, "child exit status");
+
+    END_HELPER;
+}
+
+static bool startup_latency_test(void) {
+    BEGIN_TEST;
+
+    const int kRuns = 50;
+    zx_time_t total = 0;
+    for (int i = 0; i < kRuns; ++i) {
+        ASSERT_TRUE(run_child(0, 0, &total), "");
+    }
+    unittest_printf("startup: %" PRIu64 "us from launch to exit\n",
+                    total / kRuns / 1000);
+
+    END_TEST;
+}
+
+static bool large_bootstrap_message_test(void) {
+    BEGIN_TEST;
+
+    // Enough strings and handles that the bootstrap message doesn't fit
+    // in the buffers startup tries first.
+    const int nargs = 2 * ZXR_PROCESSARGS_INLINE_BYTES / kArgLength;
+    const int nhandles = ZXR_PROCESSARGS_INLINE_HANDLES + 8;
+    zx_time_t total = 0;
+    ASSERT_TRUE(run_child(nargs, 0, &total), "");
+    ASSERT_TRUE(run_child(0, nhandles, &total), "");
+    ASSERT_TRUE(run_child(nargs, nhandles, &total), "");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(startup_tests)
+RUN_TEST(startup_latency_test);
+RUN_TEST(large_bootstrap_message_test);
+END_TEST_CASE(startup_tests)
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && !strcmp(argv[1], kChildFlag))
+        return child_main(argc, argv);
+
+    program_path = argv[0];
+
+    bool success = unittest_run_all_tests(argc, argv);
+    return success ? 0 : -1;
+}
@@ -11,6 +11,7 @@ MODULE_TYPE := usertest
 MODULE_SRCS += \
     $(LOCAL_DIR)/main.c \
     $(LOCAL_DIR)/syslog_tests.c \
+    $(LOCAL_DIR)/syslog_ring_tests.cpp \
     $(LOCAL_DIR)/syslog_socket_tests.cpp \
 
 MODULE_NAME := syslog-test
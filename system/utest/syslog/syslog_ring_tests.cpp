@@ -0,0 +1,182 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/type_support.h>
+#include <fbl/vmo_mapper.h>
+#include <syslog/global.h>
+#include <syslog/log_ring.h>
+#include <unittest/unittest.h>
+#include <zx/socket.h>
+#include <zx/vmo.h>
+
+#include <string.h>
+
+__BEGIN_CDECLS
+
+// This does not come from header file as this function should only be used in
+// tests and is not for general use.
+void fx_log_reset_global(void);
+
+__END_CDECLS
+
+namespace {
+
+class Cleanup {
+public:
+    Cleanup() { fx_log_reset_global(); }
+    ~Cleanup() { fx_log_reset_global(); }
+};
+
+// Sets up the global logger with a socket and a ring of |vmo_size| bytes and
+// maps the ring for reading.
+bool init_ring(size_t vmo_size, zx::socket* local, fbl::VmoMapper* mapping,
+               const char** tags, size_t ntags) {
+    zx::socket remote;
+    ASSERT_EQ(ZX_OK, zx::socket::create(ZX_SOCKET_DATAGRAM, local, &remote), "");
+    fx_logger_config_t config = {.min_severity = FX_LOG_INFO,
+                                 .console_fd = -1,
+                                 .log_service_channel = remote.release(),
+                                 .tags = tags,
+                                 .num_tags = ntags};
+    ASSERT_EQ(ZX_OK, fx_log_init_with_config(&config), "");
+
+    zx::vmo vmo, dup;
+    ASSERT_EQ(ZX_OK, zx::vmo::create(vmo_size, 0, &vmo), "");
+    ASSERT_EQ(ZX_OK, vmo.duplicate(ZX_RIGHT_SAME_RIGHTS, &dup), "");
+    ASSERT_EQ(ZX_OK, fx_logger_attach_ring(fx_log_get_logger(), dup.release()), "");
+    ASSERT_EQ(ZX_OK, mapping->Map(vmo, 0, ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE), "");
+    return true;
+}
+
+fx_log_ring_t* get_ring(const fbl::VmoMapper& mapping) {
+    return static_cast<fx_log_ring_t*>(mapping.start());
+}
+
+// Reads the next record and formats it; the format string lives in this
+// process so its address can be used directly.
+bool read_message(const fbl::VmoMapper& mapping, fx_log_severity_t severity,
+                  const char* tag, const char* expected) {
+    alignas(fx_log_record_t) char record_buffer[FX_LOG_MAX_RECORD_LEN];
+    size_t actual;
+    ASSERT_EQ(ZX_OK, fx_log_ring_read(get_ring(mapping), mapping.size(),
+                                      record_buffer, sizeof(record_buffer), &actual),
+              "");
+    auto record = reinterpret_cast<const fx_log_record_t*>(record_buffer);
+    EXPECT_EQ(severity, record->severity, "");
+    const char* record_tag = fx_log_record_tag(record, actual);
+    if (tag == nullptr) {
+        EXPECT_NULL(record_tag, "");
+    } else {
+        ASSERT_NONNULL(record_tag, "");
+        EXPECT_STR_EQ(tag, record_tag, strlen(tag) + 1, "");
+    }
+    char msg[256];
+    ASSERT_EQ(ZX_OK, fx_log_record_format(record, actual,
+                                          reinterpret_cast<const char*>(record->format),
+                                          msg, sizeof(msg)),
+              "");
+    EXPECT_STR_EQ(expected, msg, strlen(expected) + 1, "");
+    return true;
+}
+
+bool test_ring_write(void) {
+    BEGIN_TEST;
+    Cleanup cleanup;
+    zx::socket local;
+    fbl::VmoMapper mapping;
+    const char* gtags[] = {"gtag"};
+    ASSERT_TRUE(init_ring(PAGE_SIZE, &local, &mapping, gtags, 1), "");
+    EXPECT_EQ(1u, get_ring(mapping)->num_tags, "");
+    EXPECT_STR_EQ("gtag", get_ring(mapping)->tags[0], 5, "");
+
+    FX_LOGF(INFO, "tag", "%d, %s", 10, "just some string");
+    FX_LOGF(WARNING, nullptr, "%5.1f|%-*s|%zu|%s|%%", 2.25, 4, "ab", sizeof(int),
+            static_cast<const char*>(nullptr));
+    FX_LOG(ERROR, nullptr, "plain");
+    FX_LOGF(DEBUG, nullptr, "%d", 1);
+
+    ASSERT_TRUE(read_message(mapping, FX_LOG_INFO, "tag", "10, just some string"), "");
+    ASSERT_TRUE(read_message(mapping, FX_LOG_WARNING, nullptr, "  2.2|ab  |4|(null)|%"), "");
+    ASSERT_TRUE(read_message(mapping, FX_LOG_ERROR, nullptr, "plain"), "");
+
+    char record[FX_LOG_MAX_RECORD_LEN];
+    size_t actual;
+    EXPECT_EQ(ZX_ERR_SHOULD_WAIT,
+              fx_log_ring_read(get_ring(mapping), mapping.size(), record,
+                               sizeof(record), &actual),
+              "");
+
+    // Nothing went through the socket.
+    size_t outstanding_bytes = 10u;
+    ASSERT_EQ(ZX_OK, local.read(0, nullptr, 0, &outstanding_bytes), "");
+    EXPECT_EQ(0u, outstanding_bytes, "");
+    END_TEST;
+}
+
+bool test_ring_fallback(void) {
+    BEGIN_TEST;
+    Cleanup cleanup;
+    zx::socket local;
+    fbl::VmoMapper mapping;
+    ASSERT_TRUE(init_ring(PAGE_SIZE, &local, &mapping, nullptr, 0), "");
+
+    // long double cannot be deferred, so the message is formatted and sent
+    // through the socket.
+    FX_LOGF(INFO, nullptr, "%.1Lf", static_cast<long double>(1.5));
+    fx_log_packet_t packet;
+    ASSERT_EQ(ZX_OK, local.read(0, &packet, sizeof(packet), nullptr), "");
+    EXPECT_STR_EQ("1.5", packet.data + 1, 4, "");
+
+    char record[FX_LOG_MAX_RECORD_LEN];
+    size_t actual;
+    EXPECT_EQ(ZX_ERR_SHOULD_WAIT,
+              fx_log_ring_read(get_ring(mapping), mapping.size(), record,
+                               sizeof(record), &actual),
+              "");
+    END_TEST;
+}
+
+bool test_ring_dropped_and_wrap(void) {
+    BEGIN_TEST;
+    Cleanup cleanup;
+    zx::socket local;
+    fbl::VmoMapper mapping;
+    ASSERT_TRUE(init_ring(PAGE_SIZE, &local, &mapping, nullptr, 0), "");
+    fx_log_ring_t* ring = get_ring(mapping);
+
+    // Fill the ring until a message is dropped.
+    int written = 0;
+    while (ring->dropped_logs == 0) {
+        FX_LOGF(INFO, nullptr, "message %d", written);
+        written++;
+        ASSERT_LT(written, 1000, "");
+    }
+    written--;
+    EXPECT_EQ(1u, ring->dropped_logs, "");
+
+    // Drain and refill repeatedly so records wrap around the end of the ring.
+    int next = 0;
+    for (int round = 0; round < 4; round++) {
+        char expected[32];
+        while (next < written) {
+            snprintf(expected, sizeof(expected), "message %d", next);
+            ASSERT_TRUE(read_message(mapping, FX_LOG_INFO, nullptr, expected), "");
+            next++;
+        }
+        for (int i = 0; i < 7; i++) {
+            FX_LOGF(INFO, nullptr, "message %d", written);
+            written++;
+        }
+    }
+    EXPECT_EQ(1u, ring->dropped_logs, "");
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(syslog_ring_tests)
+RUN_TEST(test_ring_write)
+RUN_TEST(test_ring_fallback)
+RUN_TEST(test_ring_dropped_and_wrap)
+END_TEST_CASE(syslog_ring_tests)
@@ -173,6 +173,68 @@ bool cpp_walk_failure() {
     END_TEST;
 }
 
+struct SnapshotCounts {
+    size_t nodes = 0;
+    int jobs = 0;
+    int processes = 0;
+    int threads = 0;
+};
+
+zx_status_t count_snapshot_node(void* context, const zx_info_task_node_t* node) {
+    auto counts = reinterpret_cast<SnapshotCounts*>(context);
+    EXPECT_NE(node->koid, 0);
+    if (counts->nodes++ == 0) {
+        EXPECT_EQ(node->type, ZX_OBJ_TYPE_JOB, "root job comes first");
+        EXPECT_EQ(node->depth, 0u);
+    } else {
+        EXPECT_GT(node->depth, 0u);
+        EXPECT_NE(node->parent_koid, 0);
+    }
+    switch (node->type) {
+    case ZX_OBJ_TYPE_JOB:
+        counts->jobs++;
+        break;
+    case ZX_OBJ_TYPE_PROCESS:
+        counts->processes++;
+        break;
+    case ZX_OBJ_TYPE_THREAD:
+        EXPECT_GT(node->depth, 1u, "thread depth should always be > 1");
+        counts->threads++;
+        break;
+    default:
+        EXPECT_TRUE(false, "unexpected task type");
+    }
+    return ZX_OK;
+}
+
+bool snapshot_walk() {
+    BEGIN_TEST;
+    SnapshotCounts counts;
+    EXPECT_EQ(walk_root_job_tree_snapshot(count_snapshot_node, &counts), ZX_OK);
+    EXPECT_GT(counts.jobs, 0);
+    EXPECT_GT(counts.processes, 0);
+    EXPECT_GT(counts.threads, 0);
+    END_TEST;
+}
+
+zx_status_t fail_on_first_process(void* context, const zx_info_task_node_t* node) {
+    auto seen = reinterpret_cast<int*>(context);
+    if (node->type == ZX_OBJ_TYPE_PROCESS) {
+        (*seen)++;
+        return ZX_ERR_STOP;
+    }
+    return ZX_OK;
+}
+
+bool snapshot_walk_failure() {
+    BEGIN_TEST;
+    int seen = 0;
+    EXPECT_EQ(walk_root_job_tree_snapshot(fail_on_first_process, &seen),
+              ZX_ERR_STOP);
+    EXPECT_EQ(seen, 1, "walk should stop at the first failure");
+    END_TEST;
+}
+
 } // namespace
 
 // NOTE: Since the C++ API is built on top of the C API, this provides decent
@@ -198,6 +260,9 @@ RUN_TEST((cpp_walk_failure<HAS_ON_JOB, /*PoisonDepth=*/1>))
 RUN_TEST((cpp_walk_failure<HAS_ON_PROCESS, /*PoisonDepth=*/2>))
 RUN_TEST((cpp_walk_failure<HAS_ON_THREAD, /*PoisonDepth=*/2>))
 
+RUN_TEST(snapshot_walk)
+RUN_TEST(snapshot_walk_failure)
+
 END_TEST_CASE(task_utils)
 
 int main(int argc, char** argv) {
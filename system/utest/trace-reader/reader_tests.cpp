@@ -8,6 +8,7 @@
 
 #include <fbl/algorithm.h>
 #include <fbl/vector.h>
+#include <trace-engine/fields.h>
 #include <unittest/unittest.h>
 
 namespace {
@@ -178,6 +179,58 @@ bool empty_buffer_test() {
     END_TEST;
 }
 
+bool buffer_chunk_test() {
+    BEGIN_TEST;
+
+    fbl::Vector<trace::Record> records;
+    fbl::Vector<zx_koid_t> koids;
+    fbl::String error;
+    trace::TraceReader* reader_ptr = nullptr;
+    trace::TraceReader reader(
+        [&records, &koids, &reader_ptr](trace::Record record) {
+            koids.push_back(reader_ptr->current_chunk_thread_koid());
+            records.push_back(fbl::move(record));
+        },
+        MakeErrorHandler(&error));
+    reader_ptr = &reader;
+    EXPECT_EQ(ZX_KOID_INVALID, reader.current_chunk_thread_koid());
+
+    auto header = [](trace::RecordType type, size_t size) {
+        return trace::RecordFields::Type::Make(trace::ToUnderlyingType(type)) |
+               trace::RecordFields::RecordSize::Make(size);
+    };
+    auto chunk_header = [&header](trace::BufferChunkType type, size_t size) {
+        return header(trace::RecordType::kBufferChunk, size) |
+               trace::BufferChunkRecordFields::ChunkType::Make(
+                   trace::ToUnderlyingType(type));
+    };
+
+    const uint64_t kData[] = {
+        // A chunk of 6 words, holding one record followed by padding.
+        chunk_header(trace::BufferChunkType::kBegin, 2) |
+            trace::BeginBufferChunkRecordFields::ChunkSize::Make(6),
+        1234,
+        header(trace::RecordType::kInitialization, 2),
+        1000,
+        chunk_header(trace::BufferChunkType::kPadding, 2),
+        0,
+        // A record which does not belong to any chunk.
+        header(trace::RecordType::kInitialization, 2),
+        2000,
+    };
+
+    trace::Chunk chunk(kData, fbl::count_of(kData));
+    EXPECT_TRUE(reader.ReadRecords(chunk));
+    EXPECT_TRUE(error.empty());
+    ASSERT_EQ(2u, records.size());
+    EXPECT_EQ(1000u, records[0].GetInitialization().ticks_per_second);
+    EXPECT_EQ(1234u, koids[0]);
+    EXPECT_EQ(2000u, records[1].GetInitialization().ticks_per_second);
+    EXPECT_EQ(ZX_KOID_INVALID, koids[1]);
+
+    END_TEST;
+}
+
 // NOTE: Most of the reader is covered by the libtrace tests.
 
 } // namespace
@@ -187,4 +240,5 @@ RUN_TEST(empty_chunk_test)
 RUN_TEST(non_empty_chunk_test)
 RUN_TEST(initial_state_test)
 RUN_TEST(empty_buffer_test)
+RUN_TEST(buffer_chunk_test)
 END_TEST_CASE(reader_tests)
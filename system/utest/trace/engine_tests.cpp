@@ -10,8 +10,10 @@
 #include <fbl/string.h>
 #include <fbl/string_printf.h>
 #include <fbl/vector.h>
+#include <async/cpp/loop.h>
 #include <zx/event.h>
 #include <trace-engine/instrumentation.h>
+#include <trace/handler.h>
 
 namespace {
 int RunClosure(void* arg) {
@@ -387,6 +389,211 @@ bool test_event_with_inline_everything() {
     END_TRACE_TEST;
 }
 
+bool test_string_copy_shared_between_threads() {
+    BEGIN_TRACE_TEST;
+
+    fixture_start_tracing();
+
+    trace_string_ref_t cat = trace_make_inline_c_string_ref("cat");
+    trace_string_ref_t name = trace_make_inline_c_string_ref("name");
+    trace_thread_ref_t thread = trace_make_inline_thread_ref(123, 456);
+
+    // This thread starts filling a chunk of the buffer before the other
+    // thread registers a string.  Its records which use that string must
+    // still land after the string record for them to be decoded.
+    {
+        auto context = trace::TraceContext::Acquire();
+
+        trace_context_write_instant_event_record(context.get(), zx_ticks_get(),
+                                                 &thread, &cat, &name,
+                                                 TRACE_SCOPE_GLOBAL, nullptr, 0u);
+    }
+
+    trace_string_ref_t copied;
+    RunThread([&copied] {
+        auto context = trace::TraceContext::Acquire();
+
+        trace_context_register_string_copy(context.get(), "copied", 6u, &copied);
+    });
+    EXPECT_TRUE(trace_is_indexed_string_ref(&copied));
+
+    {
+        auto context = trace::TraceContext::Acquire();
+
+        trace_context_write_instant_event_record(context.get(), zx_ticks_get(),
+                                                 &thread, &cat, &copied,
+                                                 TRACE_SCOPE_GLOBAL, nullptr, 0u);
+    }
+
+    ASSERT_RECORDS(R"X(Event(ts: <>, pt: <>, category: "cat", name: "name", Instant(scope: global), {})
+String(index: 1, "copied")
+Event(ts: <>, pt: <>, category: "cat", name: "copied", Instant(scope: global), {})
+)X",
+                   "");
+
+    END_TRACE_TEST;
+}
+
+bool test_many_records_from_multiple_threads() {
+    BEGIN_TRACE_TEST;
+
+    fixture_start_tracing();
+
+    // Enough records for each thread to fill several chunks.
+    constexpr size_t kThreads = 4u;
+    constexpr size_t kRecordsPerThread = 1000u;
+    thrd_t threads[kThreads];
+    for (size_t i = 0; i < kThreads; i++) {
+        int result = thrd_create(&threads[i], [](void*) -> int {
+            trace_string_ref_t cat = trace_make_inline_c_string_ref("cat");
+            trace_string_ref_t name = trace_make_inline_c_string_ref("name");
+            trace_thread_ref_t thread = trace_make_inline_thread_ref(123, 456);
+            for (size_t j = 0; j < kRecordsPerThread; j++) {
+                auto context = trace::TraceContext::Acquire();
+                trace_context_write_instant_event_record(context.get(), zx_ticks_get(),
+                                                         &thread, &cat, &name,
+                                                         TRACE_SCOPE_THREAD, nullptr, 0u);
+            }
+            return 0;
+        }, nullptr);
+        ASSERT_EQ(thrd_success, result);
+    }
+    for (size_t i = 0; i < kThreads; i++) {
+        ASSERT_EQ(thrd_success, thrd_join(threads[i], nullptr));
+    }
+
+    fbl::Vector<trace::Record> records;
+    fbl::Vector<fbl::String> errors;
+    EXPECT_TRUE(fixture_read_records(&records, &errors));
+    EXPECT_EQ(kThreads * kRecordsPerThread + 1u, records.size());
+
+    END_TRACE_TEST;
+}
+
+// Writes |count| events, numbered from 0 in their "i" argument.
+void write_numbered_events(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        auto context = trace::TraceContext::Acquire();
+        trace_string_ref_t cat, name, arg_name;
+        trace_thread_ref_t thread;
+        trace_context_register_string_literal(context.get(), "cat", &cat);
+        trace_context_register_string_literal(context.get(), "name", &name);
+        trace_context_register_string_literal(context.get(), "i", &arg_name);
+        trace_context_register_current_thread(context.get(), &thread);
+        trace_arg_t arg = trace_make_arg(arg_name, trace_make_uint64_arg_value(i));
+        trace_context_write_instant_event_record(context.get(), zx_ticks_get(),
+                                                 &thread, &cat, &name,
+                                                 TRACE_SCOPE_THREAD, &arg, 1u);
+    }
+}
+
+// Checks that |records| hold the initialization record followed by events
+// in increasing order, and returns the numbers of the first and last ones.
+bool check_numbered_events(const fbl::Vector<trace::Record>& records,
+                           uint64_t* out_first, uint64_t* out_last) {
+    BEGIN_HELPER;
+
+    ASSERT_GE(records.size(), 2u);
+    EXPECT_EQ(trace::RecordType::kInitialization, records[0].type());
+    for (size_t i = 1; i < records.size(); i++) {
+        ASSERT_EQ(trace::RecordType::kEvent, records[i].type());
+        const auto& event = records[i].GetEvent();
+        ASSERT_EQ(1u, event.arguments.size());
+        uint64_t value = event.arguments[0].value().GetUint64();
+        if (i == 1)
+            *out_first = value;
+        else
+            ASSERT_GT(value, *out_last);
+        *out_last = value;
+    }
+
+    END_HELPER;
+}
+
+bool test_rolling_mode_buffer_too_small() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    trace::TraceHandler handler;
+    uint8_t buffer[1024];
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_start_engine_with_buffering_mode(loop.async(), &handler,
+                                                     TRACE_BUFFERING_MODE_CIRCULAR,
+                                                     buffer, sizeof(buffer)));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              trace_start_engine_with_buffering_mode(loop.async(), &handler,
+                                                     static_cast<trace_buffering_mode_t>(3),
+                                                     buffer, sizeof(buffer)));
+    EXPECT_EQ(TRACE_STOPPED, trace_state());
+
+    END_TEST;
+}
+
+bool test_circular_mode() {
+    BEGIN_TRACE_TEST;
+
+    // Several times what the buffer holds.
+    constexpr size_t kBufferSize = 256u * 1024u;
+    constexpr size_t kEvents = 20000u;
+    fixture_start_tracing_with_buffering_mode(TRACE_BUFFERING_MODE_CIRCULAR, kBufferSize);
+    write_numbered_events(kEvents);
+
+    fbl::Vector<trace::Record> records;
+    fbl::Vector<fbl::String> errors;
+    EXPECT_TRUE(fixture_read_records(&records, &errors));
+
+    // The most recent events are kept, the oldest are gone.
+    uint64_t first = 0u, last = 0u;
+    ASSERT_TRUE(check_numbered_events(records, &first, &last));
+    EXPECT_GT(first, 0u);
+
+    const trace_buffer_header_t* header = fixture_get_buffer_header();
+    EXPECT_EQ(TRACE_BUFFERING_MODE_CIRCULAR, header->buffering_mode);
+    EXPECT_GT(header->wrapped_count, 1u);
+
+    // Events are only dropped if writing got ahead of the engine freeing
+    // buffers, and then the count says so.
+    EXPECT_EQ(header->num_records_dropped ? ZX_ERR_NO_MEMORY : ZX_OK,
+              fixture_get_disposition());
+    if (header->num_records_dropped == 0u) {
+        EXPECT_EQ(kEvents - 1u, last);
+        EXPECT_EQ(last - first + 1u, records.size() - 1u);
+    }
+
+    END_TRACE_TEST;
+}
+
+bool test_streaming_mode() {
+    BEGIN_TRACE_TEST;
+
+    constexpr size_t kBufferSize = 256u * 1024u;
+    constexpr size_t kEvents = 20000u;
+    fixture_start_tracing_with_buffering_mode(TRACE_BUFFERING_MODE_STREAMING, kBufferSize);
+    write_numbered_events(kEvents);
+
+    fbl::Vector<trace::Record> records;
+    fbl::Vector<fbl::String> errors;
+    EXPECT_TRUE(fixture_read_records(&records, &errors));
+    EXPECT_GT(fixture_get_num_buffers_saved(), 0u);
+
+    uint64_t first = 0u, last = 0u;
+    ASSERT_TRUE(check_numbered_events(records, &first, &last));
+
+    // Events are only dropped if the fixture fell behind saving buffers, and
+    // then the count says how many.
+    const trace_buffer_header_t* header = fixture_get_buffer_header();
+    EXPECT_EQ(TRACE_BUFFERING_MODE_STREAMING, header->buffering_mode);
+    EXPECT_EQ(header->num_records_dropped ? ZX_ERR_NO_MEMORY : ZX_OK,
+              fixture_get_disposition());
+    EXPECT_EQ(kEvents, records.size() - 1u + header->num_records_dropped);
+    if (header->num_records_dropped == 0u) {
+        EXPECT_EQ(0u, first);
+        EXPECT_EQ(kEvents - 1u, last);
+    }
+
+    END_TRACE_TEST;
+}
+
 // NOTE: The functions for writing trace records are exercised by other trace tests.
 
 } // namespace
@@ -406,4 +613,9 @@ RUN_TEST(test_register_string_literal_multiple_threads)
 RUN_TEST(test_register_string_literal_table_overflow)
 RUN_TEST(test_maximum_record_length)
 RUN_TEST(test_event_with_inline_everything)
+RUN_TEST(test_string_copy_shared_between_threads)
+RUN_TEST(test_many_records_from_multiple_threads)
+RUN_TEST(test_rolling_mode_buffer_too_small)
+RUN_TEST(test_circular_mode)
+RUN_TEST(test_streaming_mode)
 END_TEST_CASE(engine_tests)
@@ -39,15 +39,22 @@ public:
     }
 
     void StartTracing() {
+        StartTracing(TRACE_BUFFERING_MODE_ONESHOT, kBufferSizeBytes);
+    }
+
+    void StartTracing(trace_buffering_mode_t buffering_mode, size_t buffer_num_bytes) {
         if (trace_running_)
             return;
 
         trace_running_ = true;
+        buffering_mode_ = buffering_mode;
+        if (buffer_num_bytes != buffer_.size())
+            buffer_.reset(new uint8_t[buffer_num_bytes], buffer_num_bytes);
         loop_.StartThread("trace test");
 
         // Asynchronously start the engine.
-        zx_status_t status = trace_start_engine(loop_.async(), this,
-                                                buffer_.get(), buffer_.size());
+        zx_status_t status = trace_start_engine_with_buffering_mode(
+            loop_.async(), this, buffering_mode, buffer_.get(), buffer_.size());
         ZX_DEBUG_ASSERT(status == ZX_OK);
     }
 
@@ -80,26 +87,56 @@ public:
         return disposition_;
     }
 
+    const trace_buffer_header_t* header() const {
+        return reinterpret_cast<const trace_buffer_header_t*>(buffer_.get());
+    }
+
+    size_t num_buffers_saved() const {
+        return num_buffers_saved_;
+    }
+
     bool ReadRecords(fbl::Vector<trace::Record>* out_records,
                      fbl::Vector<fbl::String>* out_errors) {
         trace::TraceReader reader(
             [out_records](trace::Record record) { out_records->push_back(fbl::move(record)); },
             [out_errors](fbl::String error) { out_errors->push_back(fbl::move(error)); });
-        trace::Chunk chunk(reinterpret_cast<uint64_t*>(buffer_.get()),
-                           buffer_bytes_written_ / 8u);
-        if (buffer_bytes_written_ & 7u) {
-            out_errors->push_back(fbl::String("Buffer contains extraneous bytes"));
+        auto read = [&reader, out_errors](const uint8_t* data, size_t num_bytes) {
+            trace::Chunk chunk(reinterpret_cast<const uint64_t*>(data), num_bytes / 8u);
+            if (num_bytes & 7u) {
+                out_errors->push_back(fbl::String("Buffer contains extraneous bytes"));
+            }
+            if (!reader.ReadRecords(chunk)) {
+                out_errors->push_back(fbl::String("Trace data is corrupted"));
+            }
+        };
+
+        if (buffering_mode_ == TRACE_BUFFERING_MODE_ONESHOT) {
+            read(buffer_.get(), buffer_bytes_written_);
+            return out_errors->is_empty();
         }
-        if (!reader.ReadRecords(chunk)) {
-            out_errors->push_back(fbl::String("Trace data is corrupted"));
+
+        // Read the durable records, then the saved buffers, then what is
+        // left in the rolling buffers, oldest first.
+        const trace_buffer_header_t* h = header();
+        if (h->magic != TRACE_BUFFER_HEADER_MAGIC ||
+            buffer_bytes_written_ != h->total_size) {
+            out_errors->push_back(fbl::String("Bad buffer header"));
+            return false;
+        }
+        read(durable_buffer(), h->durable_data_end);
+        read(saved_.get(), saved_.size());
+        for (uint32_t i = 1u; i <= 2u; i++) {
+            uint32_t index = (h->wrapped_count + i) & 1u;
+            read(rolling_buffer(index), h->rolling_data_end[index]);
         }
         return out_errors->is_empty();
     }
 
 private:
     bool IsCategoryEnabled(const char* category) override {
-        // All categories which begin with + are enabled.
-        return category[0] == '+';
+        // All categories which begin with + are enabled, as are the kernel's
+        // categories, for the ktrace importer tests.
+        return category[0] == '+' || strncmp(category, "kernel:", 7) == 0;
     }
 
     void TraceStopped(async_t* async,
@@ -114,8 +151,36 @@ private:
         trace_stopped_.signal(0u, ZX_EVENT_SIGNALED);
     }
 
+    void NotifyBufferFull(uint32_t wrapped_count, uint64_t durable_data_end) override {
+        ZX_DEBUG_ASSERT(durable_data_end == header()->durable_data_end);
+        uint32_t index = wrapped_count & 1u;
+        size_t num_bytes = header()->rolling_data_end[index];
+
+        fbl::Array<uint8_t> saved(new uint8_t[saved_.size() + num_bytes],
+                                  saved_.size() + num_bytes);
+        memcpy(saved.get(), saved_.get(), saved_.size());
+        memcpy(saved.get() + saved_.size(), rolling_buffer(index), num_bytes);
+        saved_ = fbl::move(saved);
+        num_buffers_saved_++;
+
+        zx_status_t status = trace_engine_mark_buffer_saved(wrapped_count);
+        ZX_DEBUG_ASSERT(status == ZX_OK);
+    }
+
+    const uint8_t* durable_buffer() const {
+        return buffer_.get() + sizeof(trace_buffer_header_t);
+    }
+
+    const uint8_t* rolling_buffer(uint32_t index) const {
+        return durable_buffer() + header()->durable_buffer_size +
+               index * header()->rolling_buffer_size;
+    }
+
     async::Loop loop_;
     fbl::Array<uint8_t> buffer_;
+    trace_buffering_mode_t buffering_mode_ = TRACE_BUFFERING_MODE_ONESHOT;
+    fbl::Array<uint8_t> saved_;
+    size_t num_buffers_saved_ = 0u;
     bool trace_running_ = false;
     zx_status_t disposition_ = ZX_ERR_INTERNAL;
     size_t buffer_bytes_written_ = 0u;
@@ -158,6 +223,29 @@ zx_status_t fixture_get_disposition(void) {
     return g_fixture->disposition();
 }
 
+void fixture_start_tracing_with_buffering_mode(trace_buffering_mode_t buffering_mode,
+                                               size_t buffer_num_bytes) {
+    ZX_DEBUG_ASSERT(g_fixture);
+    g_fixture->StartTracing(buffering_mode, buffer_num_bytes);
+}
+
+const trace_buffer_header_t* fixture_get_buffer_header() {
+    ZX_DEBUG_ASSERT(g_fixture);
+    return g_fixture->header();
+}
+
+size_t fixture_get_num_buffers_saved() {
+    ZX_DEBUG_ASSERT(g_fixture);
+    return g_fixture->num_buffers_saved();
+}
+
+bool fixture_read_records(fbl::Vector<trace::Record>* out_records,
+                          fbl::Vector<fbl::String>* out_errors) {
+    ZX_DEBUG_ASSERT(g_fixture);
+    g_fixture->StopTracing(false);
+    return g_fixture->ReadRecords(out_records, out_errors);
+}
+
 bool fixture_compare_records(const char* expected) {
     ZX_DEBUG_ASSERT(g_fixture);
     BEGIN_HELPER;
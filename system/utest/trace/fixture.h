@@ -49,3 +49,29 @@ inline void fixture_scope_cleanup(bool* scope) {
 #endif // NTRACE
 
 __END_CDECLS
+
+#ifdef __cplusplus
+#include <fbl/string.h>
+#include <fbl/vector.h>
+#include <trace-engine/buffer.h>
+#include <trace-reader/records.h>
+
+// Starts tracing with a buffer of |buffer_num_bytes| filled in
+// |buffering_mode|.  In streaming mode the fixture saves each rolling buffer
+// as soon as it is notified, and reads the saved buffers back along with the
+// rest of the trace.
+void fixture_start_tracing_with_buffering_mode(trace_buffering_mode_t buffering_mode,
+                                               size_t buffer_num_bytes);
+
+// Returns the buffer header as of when tracing stopped.
+// Only valid in rolling buffering modes.
+const trace_buffer_header_t* fixture_get_buffer_header();
+
+// Returns the number of rolling buffers saved in streaming mode.
+size_t fixture_get_num_buffers_saved();
+
+// Stops tracing and reads back every record in the buffer, including the
+// initialization record.  Returns false if any errors were encountered.
+bool fixture_read_records(fbl::Vector<trace::Record>* out_records,
+                          fbl::Vector<fbl::String>* out_errors);
+#endif // __cplusplus
@@ -0,0 +1,215 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "fixture.h"
+
+#include <string.h>
+
+#include <fbl/vector.h>
+#include <trace-engine/instrumentation.h>
+#include <trace-ktrace/importer.h>
+#include <zircon/ktrace.h>
+
+namespace {
+
+constexpr uint32_t kCpu = 1u;
+constexpr zx_koid_t kProcessKoid = 1000u;
+constexpr zx_koid_t kThreadKoid = 2000u;
+constexpr uint32_t kIdleThread = 0x1234u;
+constexpr uint32_t kSyscall = 5u;
+constexpr uint32_t kIrq = 33u;
+
+// Builds a stream of ktrace records, the way the kernel writes them.
+class KtraceBuffer {
+public:
+    void AddName(uint32_t tag, uint32_t id, uint32_t arg, const char* name) {
+        const size_t length = strlen(name);
+        const uint32_t words[] = {
+            (tag & 0xFFFFFFF0) | static_cast<uint32_t>((KTRACE_NAMESIZE + length + 1 + 7) >> 3),
+            id, arg};
+        Append(words, sizeof(words));
+        Append(name, length);
+        Pad();
+    }
+
+    void AddTiny(uint32_t tag, uint32_t arg, uint64_t ts) {
+        ktrace_header_t header = {(tag & 0xFFFFFFF0) | 2u, arg, ts};
+        Append(&header, sizeof(header));
+    }
+
+    void Add32B(uint32_t tag, uint32_t tid, uint64_t ts,
+                uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+        ktrace_rec_32b_t rec = {tag, tid, ts, a, b, c, d};
+        Append(&rec, sizeof(rec));
+    }
+
+    const uint8_t* data() const { return bytes_.get(); }
+    size_t size() const { return bytes_.size(); }
+
+private:
+    void Append(const void* data, size_t size) {
+        auto ptr = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+            bytes_.push_back(ptr[i]);
+    }
+
+    void Pad() {
+        do {
+            bytes_.push_back(0u);
+        } while (bytes_.size() % 8u);
+    }
+
+    fbl::Vector<uint8_t> bytes_;
+};
+
+bool check_event(const trace::Record& record, trace::EventType type, trace_ticks_t ts,
+                 zx_koid_t process_koid, zx_koid_t thread_koid,
+                 const char* category, const char* name) {
+    BEGIN_HELPER;
+
+    ASSERT_EQ(trace::RecordType::kEvent, record.type());
+    const trace::Record::Event& event = record.GetEvent();
+    EXPECT_EQ(type, event.type());
+    EXPECT_EQ(ts, event.timestamp);
+    EXPECT_EQ(process_koid, event.process_thread.process_koid());
+    EXPECT_EQ(thread_koid, event.process_thread.thread_koid());
+    EXPECT_STR_EQ(category, event.category.c_str(), strlen(category) + 1u, "category");
+    EXPECT_STR_EQ(name, event.name.c_str(), strlen(name) + 1u, "name");
+
+    END_HELPER;
+}
+
+bool test_import_kernel_events() {
+    BEGIN_TRACE_TEST;
+
+    fixture_start_tracing();
+
+    KtraceBuffer buffer;
+    buffer.AddName(TAG_SYSCALL_NAME, kSyscall, 0u, "channel_call");
+    buffer.AddName(TAG_THREAD_NAME, kThreadKoid, kProcessKoid, "worker");
+    buffer.AddName(TAG_KTHREAD_NAME, kIdleThread, 0u, "idle");
+    // The idle thread switches to the worker, which makes a syscall and
+    // takes a page fault, then an interrupt comes in.
+    buffer.Add32B(TAG_CONTEXT_SWITCH, 0u, 100u, kThreadKoid, kCpu | (4u << 16),
+                  kIdleThread, 0x5678u);
+    buffer.AddTiny(TAG_SYSCALL_ENTER, (kSyscall << 8) | kCpu, 110u);
+    buffer.Add32B(TAG_PAGE_FAULT, kThreadKoid, 115u, 0x1u, 0x2000u, 3u, kCpu);
+    buffer.Add32B(TAG_PAGE_FAULT_EXIT, kThreadKoid, 116u, 0x1u, 0x2000u, 3u, kCpu);
+    buffer.AddTiny(TAG_SYSCALL_EXIT, (kSyscall << 8) | kCpu, 120u);
+    buffer.AddTiny(TAG_IRQ_ENTER, (kIrq << 8) | kCpu, 130u);
+    buffer.AddTiny(TAG_IRQ_EXIT, (kIrq << 8) | kCpu, 131u);
+
+    {
+        auto context = trace::TraceContext::Acquire();
+        ASSERT_NONNULL(context.get());
+        EXPECT_EQ(KTRACE_GRP_META | KTRACE_GRP_TASKS | KTRACE_GRP_SCHEDULER |
+                      KTRACE_GRP_IRQ | KTRACE_GRP_PROBE,
+                  trace::KtraceImporter::GetGroupMask(context.get()));
+
+        trace::KtraceImporter importer(context.get());
+        EXPECT_EQ(buffer.size(), importer.Import(buffer.data(), buffer.size()));
+    }
+
+    fbl::Vector<trace::Record> records;
+    fbl::Vector<fbl::String> errors;
+    ASSERT_TRUE(fixture_read_records(&records, &errors));
+
+    // Skip the string and thread records.
+    fbl::Vector<const trace::Record*> events;
+    const trace::Record* context_switch = nullptr;
+    bool found_worker = false;
+    for (const auto& record : records) {
+        if (record.type() == trace::RecordType::kEvent) {
+            events.push_back(&record);
+        } else if (record.type() == trace::RecordType::kContextSwitch) {
+            context_switch = &record;
+        } else if (record.type() == trace::RecordType::kKernelObject &&
+                   record.GetKernelObject().koid == kThreadKoid) {
+            EXPECT_STR_EQ("worker", record.GetKernelObject().name.c_str(), 7u, "name");
+            found_worker = true;
+        }
+    }
+    EXPECT_TRUE(found_worker);
+
+    ASSERT_NONNULL(context_switch);
+    const trace::Record::ContextSwitch& cs = context_switch->GetContextSwitch();
+    EXPECT_EQ(100u, cs.timestamp);
+    EXPECT_EQ(kCpu, cs.cpu_number);
+    EXPECT_EQ(trace::ThreadState::kBlocked, cs.outgoing_thread_state);
+    EXPECT_EQ(ZX_KOID_KERNEL, cs.outgoing_thread.process_koid());
+    EXPECT_EQ(trace::kKernelThreadKoidBase | kIdleThread, cs.outgoing_thread.thread_koid());
+    EXPECT_EQ(kProcessKoid, cs.incoming_thread.process_koid());
+    EXPECT_EQ(kThreadKoid, cs.incoming_thread.thread_koid());
+
+    // Syscalls and page faults are on the thread the cpu is running,
+    // interrupts on the cpu.
+    ASSERT_EQ(6u, events.size());
+    EXPECT_TRUE(check_event(*events[0], trace::EventType::kDurationBegin, 110u,
+                            kProcessKoid, kThreadKoid, "kernel:syscall", "channel_call"));
+    EXPECT_TRUE(check_event(*events[1], trace::EventType::kDurationBegin, 115u,
+                            kProcessKoid, kThreadKoid, "kernel:vm", "page_fault"));
+    ASSERT_EQ(2u, events[1]->GetEvent().arguments.size());
+    EXPECT_EQ(0x100002000u, events[1]->GetEvent().arguments[0].value().GetPointer());
+    EXPECT_EQ(3u, events[1]->GetEvent().arguments[1].value().GetUint32());
+    EXPECT_TRUE(check_event(*events[2], trace::EventType::kDurationEnd, 116u,
+                            kProcessKoid, kThreadKoid, "kernel:vm", "page_fault"));
+    EXPECT_TRUE(check_event(*events[3], trace::EventType::kDurationEnd, 120u,
+                            kProcessKoid, kThreadKoid, "kernel:syscall", "channel_call"));
+    EXPECT_TRUE(check_event(*events[4], trace::EventType::kDurationBegin, 130u,
+                            ZX_KOID_KERNEL, trace::kCpuThreadKoidBase | kCpu,
+                            "kernel:irq", "irq 33"));
+    EXPECT_TRUE(check_event(*events[5], trace::EventType::kDurationEnd, 131u,
+                            ZX_KOID_KERNEL, trace::kCpuThreadKoidBase | kCpu,
+                            "kernel:irq", "irq 33"));
+
+    END_TRACE_TEST;
+}
+
+bool test_import_partial_record() {
+    BEGIN_TRACE_TEST;
+
+    fixture_start_tracing();
+
+    KtraceBuffer buffer;
+    buffer.Add32B(TAG_CONTEXT_SWITCH, 0u, 100u, kThreadKoid, kCpu, kIdleThread, 0x5678u);
+    buffer.Add32B(TAG_CONTEXT_SWITCH, kThreadKoid, 200u, 0u, kCpu, 0x5678u, kIdleThread);
+    ASSERT_EQ(2 * sizeof(ktrace_rec_32b_t), buffer.size());
+
+    {
+        auto context = trace::TraceContext::Acquire();
+        ASSERT_NONNULL(context.get());
+        trace::KtraceImporter importer(context.get());
+
+        // The second record is cut short, so it is left for the next call.
+        const size_t size = buffer.size() - 8u;
+        EXPECT_EQ(sizeof(ktrace_rec_32b_t), importer.Import(buffer.data(), size));
+        EXPECT_EQ(sizeof(ktrace_rec_32b_t),
+                  importer.Import(buffer.data() + sizeof(ktrace_rec_32b_t),
+                                  sizeof(ktrace_rec_32b_t)));
+
+        // Nothing is written after the end of the records.
+        const uint8_t zeroes[sizeof(ktrace_rec_32b_t)] = {};
+        EXPECT_EQ(sizeof(zeroes), importer.Import(zeroes, sizeof(zeroes)));
+    }
+
+    fbl::Vector<trace::Record> records;
+    fbl::Vector<fbl::String> errors;
+    ASSERT_TRUE(fixture_read_records(&records, &errors));
+
+    size_t num_context_switches = 0u;
+    for (const auto& record : records) {
+        if (record.type() == trace::RecordType::kContextSwitch)
+            num_context_switches++;
+    }
+    EXPECT_EQ(2u, num_context_switches);
+
+    END_TRACE_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(ktrace_importer_tests)
+RUN_TEST(test_import_kernel_events)
+RUN_TEST(test_import_partial_record)
+END_TEST_CASE(ktrace_importer_tests)
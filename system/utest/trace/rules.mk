@@ -16,12 +16,14 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/event_tests.cpp \
     $(LOCAL_DIR)/fields_tests.cpp \
     $(LOCAL_DIR)/fixture.cpp \
+    $(LOCAL_DIR)/ktrace_importer_tests.cpp \
     $(LOCAL_DIR)/main.c
 
 MODULE_NAME := trace-test
 
 MODULE_STATIC_LIBS := \
     system/ulib/trace \
+    system/ulib/trace-ktrace \
     system/ulib/trace-reader \
     system/ulib/async.cpp \
     system/ulib/async \
@@ -188,6 +188,42 @@ int vmo_run_benchmark() {
 
     zx_handle_close(vmo);
 
+    // read fault in the end of a chain of clones of a committed vmo, once with every clone in
+    // the chain kept open and once with the ones in the middle closed, which lets them collapse
+    const size_t chain_size = 4*1024*1024;
+    static const size_t depths[] = {1, 4, 16, 32};
+    static const bool keeps[] = {true, false};
+    for (size_t depth : depths) {
+        for (bool keep : keeps) {
+            zx_handle_t chain[33];
+            zx_vmo_create(chain_size, 0, &chain[0]);
+            zx_vmo_op_range(chain[0], ZX_VMO_OP_COMMIT, 0, chain_size, nullptr, 0);
+            size_t open = 1;
+            for (size_t i = 0; i < depth; i++) {
+                zx_handle_t clone;
+                zx_vmo_clone(chain[open - 1], ZX_VMO_CLONE_COPY_ON_WRITE, 0, chain_size, &clone);
+                if (!keep && open > 1)
+                    zx_handle_close(chain[--open]);
+                chain[open++] = clone;
+            }
+
+            zx_vmar_map(zx_vmar_root_self(), 0, chain[open - 1], 0, chain_size, ZX_VM_FLAG_PERM_READ, &ptr);
+
+            t = time_it([&](){
+                for (size_t i = 0; i < chain_size; i += PAGE_SIZE) {
+                    __UNUSED char a = ((volatile char *)ptr)[i];
+                }
+            });
+            printf("\ttook %" PRIu64 " nsecs (%" PRIu64 " per page) to read fault in a clone %zu deep%s\n",
+                   t, t / (chain_size / PAGE_SIZE), depth, keep ? "" : " with the middle closed");
+
+            zx_vmar_unmap(zx_vmar_root_self(), ptr, chain_size);
+            for (size_t i = 0; i < open; i++) {
+                zx_handle_close(chain[i]);
+            }
+        }
+    }
+
     printf("done with benchmark\n");
 
     return 0;
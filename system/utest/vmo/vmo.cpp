@@ -1068,6 +1068,82 @@ bool vmo_clone_decommit_test() {
     END_TEST;
 }
 
+// Reads the first word of page |page| of |vmo|.
+static uint32_t vmo_clone_chain_read(zx_handle_t vmo, size_t page) {
+    uint32_t value = 0;
+    size_t actual;
+    zx_vmo_read(vmo, &value, page * PAGE_SIZE, sizeof(value), &actual);
+    return value;
+}
+
+static zx_status_t vmo_clone_chain_write(zx_handle_t vmo, size_t page, uint32_t value) {
+    size_t actual;
+    return zx_vmo_write(vmo, &value, page * PAGE_SIZE, sizeof(value), &actual);
+}
+
+// verify clones keep their contents when the clones between them and the
+// original are closed, and that chains of open clones are capped
+bool vmo_clone_chain_test() {
+    BEGIN_TEST;
+
+    const size_t size = PAGE_SIZE * 4;
+    zx_handle_t vmo;
+    EXPECT_EQ(ZX_OK, zx_vmo_create(size, 0, &vmo), "vm_object_create");
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_EQ(ZX_OK, vmo_clone_chain_write(vmo, i, static_cast<uint32_t>(i + 1)), "write");
+    }
+
+    zx_handle_t clone1;
+    EXPECT_EQ(ZX_OK, zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &clone1), "vm_clone");
+    EXPECT_EQ(ZX_OK, vmo_clone_chain_write(clone1, 1, 100), "write");
+
+    // clone the clone and close the one in the middle
+    zx_handle_t clone = clone1;
+    for (int i = 0; i < 64; i++) {
+        zx_handle_t next;
+        EXPECT_EQ(ZX_OK, zx_vmo_clone(clone, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &next),
+                  "vm_clone");
+        EXPECT_EQ(ZX_OK, zx_handle_close(clone), "handle_close");
+        clone = next;
+    }
+    EXPECT_EQ(ZX_OK, vmo_clone_chain_write(clone, 2, 200), "write");
+
+    EXPECT_EQ(1u, vmo_clone_chain_read(clone, 0), "original page");
+    EXPECT_EQ(100u, vmo_clone_chain_read(clone, 1), "page copied by a closed clone");
+    EXPECT_EQ(200u, vmo_clone_chain_read(clone, 2), "own page");
+    EXPECT_EQ(4u, vmo_clone_chain_read(clone, 3), "original page");
+
+    // the original still shows through where no clone has its own copy
+    EXPECT_EQ(ZX_OK, vmo_clone_chain_write(vmo, 0, 50), "write");
+    EXPECT_EQ(ZX_OK, vmo_clone_chain_write(vmo, 1, 60), "write");
+    EXPECT_EQ(50u, vmo_clone_chain_read(clone, 0), "original page");
+    EXPECT_EQ(100u, vmo_clone_chain_read(clone, 1), "page copied by a closed clone");
+    EXPECT_EQ(60u, vmo_clone_chain_read(vmo, 1), "original unaffected");
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(clone), "handle_close");
+
+    // clones that stay open make the chain longer every time
+    zx_handle_t chain[33];
+    zx_handle_t parent = vmo;
+    size_t count = 0;
+    zx_status_t status = ZX_OK;
+    for (; count < fbl::count_of(chain); count++) {
+        status = zx_vmo_clone(parent, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &chain[count]);
+        if (status != ZX_OK)
+            break;
+        parent = chain[count];
+    }
+    EXPECT_EQ(ZX_ERR_NO_RESOURCES, status, "chain too deep");
+    EXPECT_EQ(32u, count, "chain depth");
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(ZX_OK, zx_handle_close(chain[i]), "handle_close");
+    }
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "handle_close");
+
+    END_TEST;
+}
+
 // verify the affect of commit on a clone
 bool vmo_clone_commit_test() {
     BEGIN_TEST;
@@ -1520,6 +1596,7 @@ RUN_TEST(vmo_clone_test_3);
 RUN_TEST(vmo_clone_test_4);
 RUN_TEST(vmo_clone_decommit_test);
 RUN_TEST(vmo_clone_commit_test);
+RUN_TEST(vmo_clone_chain_test);
 RUN_TEST(vmo_clone_rights_test);
 RUN_TEST_LARGE(vmo_unmap_coherency);
 END_TEST_CASE(vmo_tests)
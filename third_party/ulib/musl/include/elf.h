@@ -274,7 +274,8 @@ typedef struct {
 #define SHT_PREINIT_ARRAY 16
 #define SHT_GROUP 17
 #define SHT_SYMTAB_SHNDX 18
-#define SHT_NUM 19
+#define SHT_RELR 19
+#define SHT_NUM 20
 #define SHT_LOOS 0x60000000
 #define SHT_GNU_ATTRIBUTES 0x6ffffff5
 #define SHT_GNU_HASH 0x6ffffff6
@@ -417,6 +418,9 @@ typedef struct {
     Elf64_Sxword r_addend;
 } Elf64_Rela;
 
+typedef Elf32_Word Elf32_Relr;
+typedef Elf64_Xword Elf64_Relr;
+
 #define ELF32_R_SYM(val) ((val) >> 8)
 #define ELF32_R_TYPE(val) ((val)&0xff)
 #define ELF32_R_INFO(sym, type) (((sym) << 8) + ((type)&0xff))
@@ -569,7 +573,11 @@ typedef struct {
 #define DT_ENCODING 32
 #define DT_PREINIT_ARRAY 32
 #define DT_PREINIT_ARRAYSZ 33
-#define DT_NUM 34
+#define DT_SYMTAB_SHNDX 34
+#define DT_RELRSZ 35
+#define DT_RELR 36
+#define DT_RELRENT 37
+#define DT_NUM 38
 #define DT_LOOS 0x6000000d
 #define DT_HIOS 0x6ffff000
 #define DT_LOPROC 0x70000000
@@ -21,7 +21,8 @@ __LOCAL __NO_SAFESTACK NO_ASAN dl_start_return_t _dl_start(void* start_arg,
     ElfW(Addr) base = (uintptr_t)__ehdr_start;
     const ElfW(Rel)* rel = NULL;
     const ElfW(Rela)* rela = NULL;
-    size_t relcount = 0, relacount = 0;
+    const ElfW(Relr)* relr = NULL;
+    size_t relcount = 0, relacount = 0, relrsz = 0;
 
     // We rely on having been linked with -z combreloc so we get
     // the DT_REL(A)COUNT tag and relocs are sorted with all the
@@ -41,6 +42,12 @@ __LOCAL __NO_SAFESTACK NO_ASAN dl_start_return_t _dl_start(void* start_arg,
         case DT_RELACOUNT:
             relacount = d->d_un.d_val;
             break;
+        case DT_RELR:
+            relr = (const void*)(base + d->d_un.d_ptr);
+            break;
+        case DT_RELRSZ:
+            relrsz = d->d_un.d_val;
+            break;
         }
     }
 
@@ -56,6 +63,23 @@ __LOCAL __NO_SAFESTACK NO_ASAN dl_start_return_t _dl_start(void* start_arg,
         *addr = base + rela[i].r_addend;
     }
 
+    // DT_RELR packs more relative relocations: an even entry is the
+    // address of the next one and each odd entry is a bitmap of which
+    // of the words following it need one too.
+    ElfW(Addr)* where = NULL;
+    for (size_t i = 0; i < relrsz / sizeof(relr[0]); ++i) {
+        if ((relr[i] & 1) == 0) {
+            where = (ElfW(Addr)*)(base + relr[i]);
+            *where++ += base;
+        } else {
+            for (size_t bits = relr[i] >> 1, j = 0; bits; bits >>= 1, ++j) {
+                if (bits & 1)
+                    where[j] += base;
+            }
+            where += 8 * sizeof(relr[0]) - 1;
+        }
+    }
+
     // Make sure all the relocations have landed before calling __dls2,
     // which relies on them.
     atomic_signal_fence(memory_order_seq_cst);
@@ -408,10 +408,42 @@ static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
     return def;
 }
 
+// Most symbols a module refers to are named by more than one of its
+// relocations (e.g. a GOT slot and a PLT slot), so reloc_all keeps the
+// results of the last few lookups made on behalf of each module.
+#define SYMDEF_CACHE_SIZE 64
+struct symdef_cache_entry {
+    int sym_index;
+    int need_def;
+    struct symdef def;
+};
+struct symdef_cache {
+    struct symdef_cache_entry entries[SYMDEF_CACHE_SIZE];
+    size_t lookups, hits;
+};
+
+__NO_SAFESTACK NO_ASAN
+static struct symdef find_sym_cached(struct symdef_cache* cache,
+                                     struct dso* ctx, const char* name,
+                                     int sym_index, int need_def) {
+    struct symdef_cache_entry* e =
+        &cache->entries[sym_index % SYMDEF_CACHE_SIZE];
+    ++cache->lookups;
+    if (e->sym_index == sym_index && e->need_def == need_def) {
+        ++cache->hits;
+        return e->def;
+    }
+    e->sym_index = sym_index;
+    e->need_def = need_def;
+    e->def = find_sym(ctx, name, need_def);
+    return e->def;
+}
+
 __attribute__((__visibility__("hidden"))) ptrdiff_t __tlsdesc_static(void), __tlsdesc_dynamic(void);
 
 __NO_SAFESTACK NO_ASAN static void do_relocs(struct dso* dso, size_t* rel,
-                                             size_t rel_size, size_t stride) {
+                                             size_t rel_size, size_t stride,
+                                             struct symdef_cache* cache) {
     ElfW(Addr) base = dso->l_map.l_addr;
     Sym* syms = dso->syms;
     char* strings = dso->strings;
@@ -445,9 +477,17 @@ __NO_SAFESTACK NO_ASAN static void do_relocs(struct dso* dso, size_t* rel,
         if (sym_index) {
             sym = syms + sym_index;
             name = strings + sym->st_name;
-            ctx = type == REL_COPY ? dso_next(head) : head;
-            def = (sym->st_info & 0xf) == STT_SECTION ? (struct symdef){.dso = dso, .sym = sym}
-                                                      : find_sym(ctx, name, type == REL_PLT);
+            if ((sym->st_info & 0xf) == STT_SECTION) {
+                def = (struct symdef){.dso = dso, .sym = sym};
+            } else if (type == REL_COPY) {
+                // Copy relocations search past the module itself.
+                ctx = dso_next(head);
+                def = find_sym(ctx, name, 0);
+            } else {
+                ctx = head;
+                def = find_sym_cached(cache, ctx, name, sym_index,
+                                      type == REL_PLT);
+            }
             if (!def.sym && (sym->st_shndx != SHN_UNDEF || sym->st_info >> 4 != STB_WEAK)) {
                 error("Error relocating %s: %s: symbol not found", dso->l_map.l_name, name);
                 if (runtime)
@@ -695,6 +735,16 @@ __NO_SAFESTACK NO_ASAN static zx_status_t map_library(zx_handle_t vmo,
     size_t tls_image = 0;
     size_t i;
 
+    // All the segments are mapped with a single zx_vmar_batch() call.
+    // Each PT_LOAD phdr makes one mapping, so the ops always fit.
+    _Static_assert(countof(buf.phdrs) <= ZX_VMAR_BATCH_MAX_OPS,
+                   "too many phdrs for one batch");
+    zx_vmar_batch_op_t maps[countof(buf.phdrs)];
+    // Where the zero fill of each mapping's final partial page of file
+    // data starts, or 0 if there is none.
+    uintptr_t zero_start[countof(buf.phdrs)];
+    size_t nmaps = 0;
+
     size_t l;
     zx_status_t status = _zx_vmo_read(vmo, &buf, 0, sizeof(buf), &l);
     if (status != ZX_OK)
@@ -854,22 +904,35 @@ __NO_SAFESTACK NO_ASAN static zx_status_t map_library(zx_handle_t vmo,
             goto noexec;
         }
 
-        status = _zx_vmar_map(dso->vmar, mapaddr - vmar_base, map_vmo,
-                              off_start, map_size, zx_flags, &mapaddr);
-        if (map_vmo != vmo)
-            _zx_handle_close(map_vmo);
-        if (status != ZX_OK)
-            goto error;
-
-        if (ph->p_memsz > ph->p_filesz) {
-            // The final partial page of data from the file is followed by
-            // whatever the file's contents there are, but in the memory
-            // image that partial page should be all zero.
-            uintptr_t file_end = (uintptr_t)base + ph->p_vaddr + ph->p_filesz;
-            uintptr_t map_end = mapaddr + map_size;
-            if (map_end > file_end)
-                memset((void*)file_end, 0, map_end - file_end);
-        }
+        maps[nmaps] = (zx_vmar_batch_op_t){
+            .op = ZX_VMAR_BATCH_MAP,
+            .flags = zx_flags,
+            .vmo = map_vmo,
+            .vmo_offset = off_start,
+            .addr = mapaddr - vmar_base,
+            .len = map_size,
+        };
+        // The final partial page of data from the file is followed by
+        // whatever the file's contents there are, but in the memory
+        // image that partial page should be all zero.
+        zero_start[nmaps++] = ph->p_memsz > ph->p_filesz ?
+            (uintptr_t)base + ph->p_vaddr + ph->p_filesz : 0;
+    }
+
+    status = _zx_vmar_batch(dso->vmar, maps, nmaps, NULL);
+    for (i = 0; i < nmaps; i++) {
+        if (maps[i].vmo != vmo)
+            _zx_handle_close(maps[i].vmo);
+    }
+    if (status != ZX_OK) {
+        nmaps = 0;
+        goto error;
+    }
+    for (i = 0; i < nmaps; i++) {
+        // On success each addr is the address of the mapping.
+        uintptr_t map_end = maps[i].addr + maps[i].len;
+        if (zero_start[i] != 0 && map_end > zero_start[i])
+            memset((void*)zero_start[i], 0, map_end - zero_start[i]);
     }
 
     dso->l_map.l_addr = (uintptr_t)base;
@@ -887,6 +950,10 @@ noexec:
     // We overload this to translate into ENOEXEC later.
     status = ZX_ERR_WRONG_TYPE;
 error:
+    for (i = 0; i < nmaps; i++) {
+        if (maps[i].vmo != vmo)
+            _zx_handle_close(maps[i].vmo);
+    }
     if (map != MAP_FAILED)
         unmap_library(dso);
     if (dso->vmar != ZX_HANDLE_INVALID)
@@ -1237,28 +1304,47 @@ __NO_SAFESTACK static zx_status_t load_library(const char* name, int rtld_mode,
     return status;
 }
 
+static void prefetch_deps(struct dso* first, struct dso* last);
+static void drop_prefetched(void);
+
+__NO_SAFESTACK static void load_dso_deps(struct dso* p) {
+    struct dso** deps = NULL;
+    // The two preallocated DSOs don't get space allocated for ->deps.
+    if (runtime && p->deps == NULL && p != &ldso && p != &vdso)
+        deps = p->deps = p->buf;
+    for (size_t i = 0; p->l_map.l_ld[i].d_tag; i++) {
+        if (p->l_map.l_ld[i].d_tag != DT_NEEDED)
+            continue;
+        const char* name = p->strings + p->l_map.l_ld[i].d_un.d_val;
+        struct dso* dep;
+        zx_status_t status = load_library(name, 0, p, &dep);
+        if (status != ZX_OK) {
+            error("Error loading shared library %s: %s (needed by %s)",
+                  name, _zx_status_get_string(status), p->l_map.l_name);
+            if (runtime)
+                longjmp(*rtld_fail, 1);
+        } else if (deps != NULL) {
+            *deps++ = dep;
+        }
+    }
+}
+
 __NO_SAFESTACK static void load_deps(struct dso* p) {
-    for (; p; p = dso_next(p)) {
-        struct dso** deps = NULL;
-        // The two preallocated DSOs don't get space allocated for ->deps.
-        if (runtime && p->deps == NULL && p != &ldso && p != &vdso)
-            deps = p->deps = p->buf;
-        for (size_t i = 0; p->l_map.l_ld[i].d_tag; i++) {
-            if (p->l_map.l_ld[i].d_tag != DT_NEEDED)
-                continue;
-            const char* name = p->strings + p->l_map.l_ld[i].d_un.d_val;
-            struct dso* dep;
-            zx_status_t status = load_library(name, 0, p, &dep);
-            if (status != ZX_OK) {
-                error("Error loading shared library %s: %s (needed by %s)",
-                      name, _zx_status_get_string(status), p->l_map.l_name);
-                if (runtime)
-                    longjmp(*rtld_fail, 1);
-            } else if (deps != NULL) {
-                *deps++ = dep;
-            }
+    // The list is walked breadth first: everything from |p| to the
+    // current tail is one level, whose dependencies are all asked of the
+    // loader service together before any of them is loaded.
+    while (p) {
+        struct dso* last = tail;
+        prefetch_deps(p, last);
+        for (;;) {
+            load_dso_deps(p);
+            if (p == last)
+                break;
+            p = dso_next(p);
         }
+        p = dso_next(last);
     }
+    drop_prefetched();
 }
 
 __NO_SAFESTACK static void load_preload(char* s) {
@@ -1277,15 +1363,53 @@ __NO_SAFESTACK static void load_preload(char* s) {
     }
 }
 
+// DT_RELR is a compact encoding of relative relocations: an even entry
+// is the address of the next one, and each odd entry is a bitmap of
+// which of the words following the last one also need relocating.
+__NO_SAFESTACK NO_ASAN static void do_relr_relocs(struct dso* dso,
+                                                  const size_t* relr,
+                                                  size_t relr_size) {
+    ElfW(Addr) base = dso->l_map.l_addr;
+    size_t* where = NULL;
+    for (; relr_size; ++relr, relr_size -= sizeof(size_t)) {
+        if ((*relr & 1) == 0) {
+            where = laddr(dso, *relr);
+            *where++ += base;
+        } else {
+            size_t i = 0;
+            for (size_t bits = *relr >> 1; bits; bits >>= 1, ++i) {
+                if (bits & 1)
+                    where[i] += base;
+            }
+            where += 8 * sizeof(size_t) - 1;
+        }
+    }
+}
+
 __NO_SAFESTACK NO_ASAN static void reloc_all(struct dso* p) {
     size_t dyn[DYN_CNT];
     for (; p; p = dso_next(p)) {
         if (p->relocated)
             continue;
+        uint64_t start = log_libs ? _zx_ticks_get() : 0;
+        struct symdef_cache cache = {};
         decode_vec(p->l_map.l_ld, dyn, DYN_CNT);
-        do_relocs(p, laddr(p, dyn[DT_JMPREL]), dyn[DT_PLTRELSZ], 2 + (dyn[DT_PLTREL] == DT_RELA));
-        do_relocs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2);
-        do_relocs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3);
+        // The dynamic linker's own relative relocations were all
+        // applied by _dl_start, RELR included.
+        if (p != &ldso)
+            do_relr_relocs(p, laddr(p, dyn[DT_RELR]), dyn[DT_RELRSZ]);
+        do_relocs(p, laddr(p, dyn[DT_JMPREL]), dyn[DT_PLTRELSZ],
+                  2 + (dyn[DT_PLTREL] == DT_RELA), &cache);
+        do_relocs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2, &cache);
+        do_relocs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3, &cache);
+        if (log_libs) {
+            uint64_t ticks = _zx_ticks_get() - start;
+            debugmsg("%s: relocated in %" PRIu64 "us"
+                     " (%zu symbol lookups, %zu cached)\n",
+                     p->l_map.l_name,
+                     ticks * 1000000 / _zx_ticks_per_second(),
+                     cache.lookups, cache.hits);
+        }
 
         if (head != &ldso && p->relro_start != p->relro_end) {
             zx_status_t status =
@@ -1742,22 +1866,29 @@ __NO_SAFESTACK static void* dls3(zx_handle_t exec_vmo, int argc, char** argv) {
 __NO_SAFESTACK NO_ASAN static dl_start_return_t __dls3(void* start_arg) {
     zx_handle_t bootstrap = (uintptr_t)start_arg;
 
+    // Try to read the whole message in one go, as __libc_start_main does.
     uint32_t nbytes, nhandles;
-    zx_status_t status = zxr_message_size(bootstrap, &nbytes, &nhandles);
-    if (status != ZX_OK) {
-        error("zxr_message_size bootstrap handle %#x failed: %d (%s)",
-              bootstrap, status, _zx_status_get_string(status));
-        nbytes = nhandles = 0;
-    }
-
-    ZXR_PROCESSARGS_BUFFER(buffer, nbytes);
-    zx_handle_t handles[nhandles];
+    ZXR_PROCESSARGS_BUFFER(inline_buffer, ZXR_PROCESSARGS_INLINE_BYTES);
+    zx_handle_t inline_handles[ZXR_PROCESSARGS_INLINE_HANDLES];
     zx_proc_args_t* procargs;
     uint32_t* handle_info;
-    if (status == ZX_OK)
+    zx_status_t status =
+        zxr_processargs_try_read(bootstrap,
+                                 inline_buffer, sizeof(inline_buffer),
+                                 inline_handles, countof(inline_handles),
+                                 &nbytes, &nhandles, &procargs, &handle_info);
+    const bool too_big = status == ZX_ERR_BUFFER_TOO_SMALL;
+    ZXR_PROCESSARGS_BUFFER(big_buffer, too_big ? nbytes : 0);
+    zx_handle_t big_handles[too_big ? nhandles : 0];
+    uint8_t* buffer = inline_buffer;
+    zx_handle_t* handles = inline_handles;
+    if (too_big) {
+        buffer = big_buffer;
+        handles = big_handles;
         status = zxr_processargs_read(bootstrap, buffer, nbytes,
                                       handles, nhandles,
                                       &procargs, &handle_info);
+    }
     if (status != ZX_OK) {
         error("bad message of %u bytes, %u handles"
               " from bootstrap handle %#x: %d (%s)",
@@ -2034,7 +2165,10 @@ static bool find_sym_for_dlsym(struct dso* p,
     if (p->ghashtab != NULL) {
         if (*name_gnu_hash == 0)
             *name_gnu_hash = gnu_hash(name);
-        sym = gnu_lookup(*name_gnu_hash, p->ghashtab, p, name);
+        const int maskbits = 8 * sizeof(size_t);
+        sym = gnu_lookup_filtered(*name_gnu_hash, p->ghashtab, p, name,
+                                  *name_gnu_hash / maskbits,
+                                  1ul << *name_gnu_hash % maskbits);
     } else {
         if (*name_sysv_hash == 0)
             *name_sysv_hash = sysv_hash(name);
@@ -2272,8 +2406,167 @@ __NO_SAFESTACK static void loader_svc_config(const char* config) {
                  config, _zx_status_get_string(status));
 }
 
+// Objects already fetched by prefetch_deps, which get_library_vmo hands
+// out before asking the loader service for anything. A taken entry has
+// a NULL name.
+#define PREFETCH_MAX (4 * LDMSG_LOAD_OBJECTS_MAX)
+static struct {
+    const char* name;
+    zx_status_t status;
+    zx_handle_t vmo;
+} prefetched[PREFETCH_MAX];
+static size_t prefetched_count;
+
+// Set once the loader service turns down LDMSG_OP_LOAD_OBJECTS.
+static bool loader_svc_no_batch;
+
+__NO_SAFESTACK static void drop_prefetched(void) {
+    for (size_t i = 0; i < prefetched_count; ++i)
+        _zx_handle_close(prefetched[i].vmo);
+    prefetched_count = 0;
+}
+
+__NO_SAFESTACK static bool is_prefetched(const char* name) {
+    for (size_t i = 0; i < prefetched_count; ++i) {
+        if (prefetched[i].name != NULL && !strcmp(prefetched[i].name, name))
+            return true;
+    }
+    return false;
+}
+
+// Ask for prefetched[first] up to prefetched_count in one request.
+__NO_SAFESTACK static zx_status_t loader_svc_load_objects(size_t first) {
+    char names[LDMSG_MAX_PAYLOAD];
+    size_t len = 0;
+    for (size_t i = first; i < prefetched_count; ++i) {
+        size_t n = strlen(prefetched[i].name) + 1;
+        memcpy(&names[len], prefetched[i].name, n);
+        len += n;
+    }
+
+    ldmsg_req_t req;
+    memset(&req.header, 0, sizeof(req.header));
+    req.header.ordinal = LDMSG_OP_LOAD_OBJECTS;
+    size_t req_len;
+    zx_status_t status = ldmsg_req_encode(&req, &req_len, names, len);
+    if (status != ZX_OK)
+        return status;
+    req.header.txid = atomic_fetch_add(&loader_svc_txid, 1);
+
+    ldmsg_rsp_objects_t rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    zx_handle_t handles[LDMSG_LOAD_OBJECTS_MAX];
+    zx_channel_call_args_t call = {
+        .wr_bytes = &req,
+        .wr_num_bytes = req_len,
+        .rd_bytes = &rsp,
+        .rd_num_bytes = sizeof(rsp),
+        .rd_handles = handles,
+        .rd_num_handles = LDMSG_LOAD_OBJECTS_MAX,
+    };
+    uint32_t reply_size;
+    uint32_t handle_count;
+    zx_status_t read_status = ZX_OK;
+    loader_svc_rpc_in_progress = true;
+    status = _zx_channel_call(loader_svc, 0, ZX_TIME_INFINITE,
+                              &call, &reply_size, &handle_count,
+                              &read_status);
+    loader_svc_rpc_in_progress = false;
+    if (status != ZX_OK)
+        return status == ZX_ERR_CALL_FAILED ? read_status : status;
+
+    size_t count = prefetched_count - first;
+    if (reply_size != sizeof(rsp) ||
+        rsp.header.ordinal != LDMSG_OP_LOAD_OBJECTS) {
+        status = ZX_ERR_INVALID_ARGS;
+    } else if ((status = rsp.rv) == ZX_OK) {
+        uint32_t expected = 0;
+        for (size_t i = 0; i < count && i < rsp.count; ++i)
+            expected += rsp.rvs[i] == ZX_OK;
+        if (rsp.count != count || handle_count != expected)
+            status = ZX_ERR_INVALID_ARGS;
+    }
+    if (status != ZX_OK) {
+        for (uint32_t i = 0; i < handle_count; ++i)
+            _zx_handle_close(handles[i]);
+        return status;
+    }
+
+    for (size_t i = 0, h = 0; i < count; ++i) {
+        prefetched[first + i].status = rsp.rvs[i];
+        prefetched[first + i].vmo =
+            rsp.rvs[i] == ZX_OK ? handles[h++] : ZX_HANDLE_INVALID;
+    }
+    return ZX_OK;
+}
+
+// On failure, whatever was to come of this batch is loaded one at a time.
+__NO_SAFESTACK static bool prefetch_batch(size_t first) {
+    if (first == prefetched_count)
+        return true;
+    zx_status_t status = loader_svc_load_objects(first);
+    if (status != ZX_OK) {
+        prefetched_count = first;
+        if (status == ZX_ERR_NOT_SUPPORTED) {
+            loader_svc_no_batch = true;
+        } else {
+            debugmsg("LDMSG_OP_LOAD_OBJECTS: %s\n",
+                     _zx_status_get_string(status));
+        }
+        return false;
+    }
+    return true;
+}
+
+// Fetch the objects needed by |first| through |last| that are not loaded
+// yet, in as few requests as will hold their names.
+__NO_SAFESTACK static void prefetch_deps(struct dso* first, struct dso* last) {
+    drop_prefetched();
+    if (loader_svc == ZX_HANDLE_INVALID || loader_svc_no_batch)
+        return;
+
+    // Room for the string header, and the terminator the service adds.
+    const size_t max_len = LDMSG_MAX_PAYLOAD - sizeof(fidl_string_t) - 1;
+    size_t batch = 0;
+    size_t len = 0;
+    for (struct dso* p = first;; p = dso_next(p)) {
+        for (size_t i = 0; p->l_map.l_ld[i].d_tag; i++) {
+            if (p->l_map.l_ld[i].d_tag != DT_NEEDED)
+                continue;
+            const char* name = p->strings + p->l_map.l_ld[i].d_un.d_val;
+            size_t n = strlen(name) + 1;
+            if (n == 1 || n > max_len || find_library(name) != NULL ||
+                is_prefetched(name))
+                continue;
+            if (prefetched_count - batch == LDMSG_LOAD_OBJECTS_MAX ||
+                len + n > max_len || prefetched_count == PREFETCH_MAX) {
+                if (!prefetch_batch(batch) || prefetched_count == PREFETCH_MAX)
+                    return;
+                batch = prefetched_count;
+                len = 0;
+            }
+            prefetched[prefetched_count].name = name;
+            prefetched[prefetched_count].status = ZX_ERR_INTERNAL;
+            prefetched[prefetched_count].vmo = ZX_HANDLE_INVALID;
+            prefetched_count++;
+            len += n;
+        }
+        if (p == last)
+            break;
+    }
+    prefetch_batch(batch);
+}
+
 __NO_SAFESTACK static zx_status_t get_library_vmo(const char* name,
                                                   zx_handle_t* result) {
+    for (size_t i = 0; i < prefetched_count; ++i) {
+        if (prefetched[i].name != NULL && !strcmp(prefetched[i].name, name)) {
+            prefetched[i].name = NULL;
+            *result = prefetched[i].vmo;
+            prefetched[i].vmo = ZX_HANDLE_INVALID;
+            return prefetched[i].status;
+        }
+    }
     if (loader_svc == ZX_HANDLE_INVALID) {
         error("cannot look up \"%s\" with no loader service", name);
         return ZX_ERR_UNAVAILABLE;
@@ -4,6 +4,7 @@
 
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -24,6 +25,79 @@ void __thread_allocation_release(void) {
     pthread_rwlock_unlock(&allocation_lock);
 }
 
+// Creating a thread's stacks means a VMO and two VMARs, and unmapping
+// them again on exit. Threads come and go often enough that the stacks
+// of exited threads are kept, still mapped and faulted in, for new
+// threads with the same stack and guard sizes.
+#define STACK_CACHE_SIZE 8
+
+struct thread_stacks {
+    struct iovec safe_stack, safe_stack_region;
+    struct iovec unsafe_stack, unsafe_stack_region;
+};
+
+enum { SLOT_EMPTY, SLOT_BUSY, SLOT_FULL };
+
+// Each slot is claimed by moving it to SLOT_BUSY, so exiting threads can
+// use the cache without taking a lock.
+static struct {
+    atomic_int state;
+    struct thread_stacks stacks;
+} stack_cache[STACK_CACHE_SIZE];
+
+__NO_SAFESTACK static bool take_cached_stacks(size_t stack_size,
+                                               size_t guard_size,
+                                               struct thread_stacks* out) {
+    for (size_t i = 0; i < STACK_CACHE_SIZE; ++i) {
+        int state = SLOT_FULL;
+        if (!atomic_compare_exchange_strong(&stack_cache[i].state, &state,
+                                            SLOT_BUSY))
+            continue;
+        const struct thread_stacks* stacks = &stack_cache[i].stacks;
+        bool match = stacks->safe_stack.iov_len == stack_size &&
+                     stacks->safe_stack_region.iov_len ==
+                         stack_size + guard_size;
+        if (match)
+            *out = *stacks;
+        atomic_store(&stack_cache[i].state, match ? SLOT_EMPTY : SLOT_FULL);
+        if (match)
+            return true;
+    }
+    return false;
+}
+
+__NO_SAFESTACK NO_ASAN static void release_stacks(
+    const struct thread_stacks* stacks) {
+#if !__has_feature(address_sanitizer)
+    // The sanitizer runtime tracks stacks by thread, so it gets fresh ones.
+    for (size_t i = 0; i < STACK_CACHE_SIZE; ++i) {
+        int state = SLOT_EMPTY;
+        if (atomic_compare_exchange_strong(&stack_cache[i].state, &state,
+                                           SLOT_BUSY)) {
+            stack_cache[i].stacks = *stacks;
+            atomic_store(&stack_cache[i].state, SLOT_FULL);
+            return;
+        }
+    }
+#endif
+    _zx_vmar_unmap(_zx_vmar_root_self(),
+                   (uintptr_t)stacks->safe_stack_region.iov_base,
+                   stacks->safe_stack_region.iov_len);
+    _zx_vmar_unmap(_zx_vmar_root_self(),
+                   (uintptr_t)stacks->unsafe_stack_region.iov_base,
+                   stacks->unsafe_stack_region.iov_len);
+}
+
+__NO_SAFESTACK NO_ASAN void __release_thread_stacks(pthread_t thread) {
+    const struct thread_stacks stacks = {
+        .safe_stack = thread->safe_stack,
+        .safe_stack_region = thread->safe_stack_region,
+        .unsafe_stack = thread->unsafe_stack,
+        .unsafe_stack_region = thread->unsafe_stack_region,
+    };
+    release_stacks(&stacks);
+}
+
 static inline size_t round_up_to_page(size_t sz) {
     return (sz + PAGE_SIZE - 1) & -PAGE_SIZE;
 }
@@ -127,11 +201,16 @@ __NO_SAFESTACK pthread_t __allocate_thread(
     const size_t tls_size = libc.tls_size;
     const size_t tcb_size = round_up_to_page(tls_size);
 
-    const size_t vmo_size = tcb_size + stack_size * 2;
+    struct thread_stacks cached;
+    const bool have_stacks = take_cached_stacks(stack_size, guard_size, &cached);
+
+    const size_t vmo_size = tcb_size + (have_stacks ? 0 : stack_size * 2);
     zx_handle_t vmo;
     zx_status_t status = _zx_vmo_create(vmo_size, 0, &vmo);
     if (status != ZX_OK) {
         __thread_allocation_release();
+        if (have_stacks)
+            release_stacks(&cached);
         return NULL;
     }
     struct iovec tcb, tcb_region;
@@ -139,6 +218,8 @@ __NO_SAFESTACK pthread_t __allocate_thread(
                   &tcb, &tcb_region)) {
         __thread_allocation_release();
         _zx_handle_close(vmo);
+        if (have_stacks)
+            release_stacks(&cached);
         return NULL;
     }
 
@@ -164,16 +245,22 @@ __NO_SAFESTACK pthread_t __allocate_thread(
     _zx_object_set_property(vmo, ZX_PROP_NAME,
                             thread_name, strlen(thread_name));
 
-    if (map_block(_zx_vmar_root_self(), vmo,
-                  tcb_size, stack_size, guard_size, 0,
-                  &td->safe_stack, &td->safe_stack_region)) {
+    if (have_stacks) {
+        td->safe_stack = cached.safe_stack;
+        td->safe_stack_region = cached.safe_stack_region;
+        td->unsafe_stack = cached.unsafe_stack;
+        td->unsafe_stack_region = cached.unsafe_stack_region;
+    } else if (map_block(_zx_vmar_root_self(), vmo,
+                         tcb_size, stack_size, guard_size, 0,
+                         &td->safe_stack, &td->safe_stack_region)) {
         _zx_vmar_unmap(_zx_vmar_root_self(),
                        (uintptr_t)tcb_region.iov_base, tcb_region.iov_len);
         _zx_handle_close(vmo);
         return NULL;
     }
 
-    if (map_block(_zx_vmar_root_self(), vmo,
+    if (!have_stacks &&
+        map_block(_zx_vmar_root_self(), vmo,
                   tcb_size + stack_size, stack_size, guard_size, 0,
                   &td->unsafe_stack, &td->unsafe_stack_region)) {
         _zx_vmar_unmap(_zx_vmar_root_self(),
@@ -100,8 +100,7 @@ int __pthread_create(pthread_t* restrict res, const pthread_attr_t* restrict att
         status == ZX_ERR_ACCESS_DENIED ? thrd_error : thrd_nomem);
 
 fail_after_alloc:
-    deallocate_region(&new->safe_stack_region);
-    deallocate_region(&new->unsafe_stack_region);
+    __release_thread_stacks(new);
     deallocate_region(&new->tcb_region);
     return status == ZX_ERR_ACCESS_DENIED ? EPERM : EAGAIN;
 }
@@ -110,8 +109,9 @@ static _Noreturn void final_exit(pthread_t self)
     __asm__("final_exit") __attribute__((used));
 
 static __NO_SAFESTACK NO_ASAN void final_exit(pthread_t self) {
-    deallocate_region(&self->safe_stack_region);
-    deallocate_region(&self->unsafe_stack_region);
+    // We are on the temporary stack in the TCB region now, so another
+    // thread can be given these as soon as they are released.
+    __release_thread_stacks(self);
 
     // This deallocates the TCB region too for the detached case.
     // If not detached, pthread_join will deallocate it.
@@ -1,7 +1,7 @@
 #include "pthread_impl.h"
 
 int pthread_mutex_timedlock(pthread_mutex_t* restrict m, const struct timespec* restrict at) {
-    if ((m->_m_type & PTHREAD_MUTEX_MASK) == PTHREAD_MUTEX_NORMAL &&
+    if (m->_m_type == PTHREAD_MUTEX_NORMAL &&
         !a_cas_shim(&m->_m_lock, 0, EBUSY))
         return 0;
 
@@ -22,10 +22,18 @@ int pthread_mutex_timedlock(pthread_mutex_t* restrict m, const struct timespec*
             (r & PTHREAD_MUTEX_OWNED_LOCK_MASK) == __thread_get_tid())
             return EDEADLK;
 
+        // A priority-inheriting mutex lends our priority to its owner
+        // while we wait. A normal mutex relocked by its owner just
+        // deadlocks, as it would without inheritance.
+        zx_handle_t owner = ZX_HANDLE_INVALID;
+        if ((m->_m_type & PTHREAD_MUTEX_PRIO_INHERIT) &&
+            (r & PTHREAD_MUTEX_OWNED_LOCK_MASK) != __thread_get_tid())
+            owner = r & PTHREAD_MUTEX_OWNED_LOCK_MASK;
+
         atomic_fetch_add(&m->_m_waiters, 1);
         t = r | PTHREAD_MUTEX_OWNED_LOCK_BIT;
         a_cas_shim(&m->_m_lock, r, t);
-        r = __timedwait(&m->_m_lock, t, CLOCK_REALTIME, at);
+        r = __timedwait_owned(&m->_m_lock, t, owner, CLOCK_REALTIME, at);
         atomic_fetch_sub(&m->_m_waiters, 1);
         if (r)
             break;
@@ -76,20 +76,33 @@ __NO_SAFESTACK _Noreturn void __libc_start_main(
     // extract process startup information from channel in arg
     zx_handle_t bootstrap = (uintptr_t)arg;
 
+    // Usually the message fits in the inline buffers and is read with a
+    // single system call.  If not, it's still waiting in the channel and
+    // we know exactly how big a buffer it needs.
     struct start_params p = { .main = main };
     uint32_t nbytes;
-    status = zxr_message_size(bootstrap, &nbytes, &p.nhandles);
-    if (status != ZX_OK)
-        nbytes = p.nhandles = 0;
-
-    ZXR_PROCESSARGS_BUFFER(buffer, nbytes);
-    zx_handle_t handles[p.nhandles];
-    p.handles = handles;
+    ZXR_PROCESSARGS_BUFFER(inline_buffer, ZXR_PROCESSARGS_INLINE_BYTES);
+    zx_handle_t inline_handles[ZXR_PROCESSARGS_INLINE_HANDLES];
     zx_proc_args_t* procargs = NULL;
-    if (status == ZX_OK)
+    status = zxr_processargs_try_read(bootstrap,
+                                      inline_buffer, sizeof(inline_buffer),
+                                      inline_handles, countof(inline_handles),
+                                      &nbytes, &p.nhandles,
+                                      &procargs, &p.handle_info);
+    const bool too_big = status == ZX_ERR_BUFFER_TOO_SMALL;
+    ZXR_PROCESSARGS_BUFFER(big_buffer, too_big ? nbytes : 0);
+    zx_handle_t big_handles[too_big ? p.nhandles : 0];
+    uint8_t* buffer = inline_buffer;
+    p.handles = inline_handles;
+    if (too_big) {
+        buffer = big_buffer;
+        p.handles = big_handles;
         status = zxr_processargs_read(bootstrap, buffer, nbytes,
-                                      handles, p.nhandles,
+                                      p.handles, p.nhandles,
                                       &procargs, &p.handle_info);
+    }
+    if (status != ZX_OK)
+        nbytes = p.nhandles = 0;
 
     uint32_t envc = 0;
     if (status == ZX_OK) {
@@ -133,8 +146,8 @@ __NO_SAFESTACK _Noreturn void __libc_start_main(
             // just for cleanliness switch to the "main" one.
             if (__zircon_process_self != ZX_HANDLE_INVALID)
                 _zx_handle_close(__zircon_process_self);
-            __zircon_process_self = handles[i];
-            handles[i] = ZX_HANDLE_INVALID;
+            __zircon_process_self = p.handles[i];
+            p.handles[i] = ZX_HANDLE_INVALID;
             p.handle_info[i] = 0;
             break;
 
@@ -145,8 +158,8 @@ __NO_SAFESTACK _Noreturn void __libc_start_main(
             // be provided at all.
             if (__zircon_job_default != ZX_HANDLE_INVALID)
                 _zx_handle_close(__zircon_job_default);
-            __zircon_job_default = handles[i];
-            handles[i] = ZX_HANDLE_INVALID;
+            __zircon_job_default = p.handles[i];
+            p.handles[i] = ZX_HANDLE_INVALID;
             p.handle_info[i] = 0;
             break;
 
@@ -154,14 +167,14 @@ __NO_SAFESTACK _Noreturn void __libc_start_main(
             // As above for PROC_SELF
             if (__zircon_vmar_root_self != ZX_HANDLE_INVALID)
                 _zx_handle_close(__zircon_vmar_root_self);
-            __zircon_vmar_root_self = handles[i];
-            handles[i] = ZX_HANDLE_INVALID;
+            __zircon_vmar_root_self = p.handles[i];
+            p.handles[i] = ZX_HANDLE_INVALID;
             p.handle_info[i] = 0;
             break;
 
         case PA_THREAD_SELF:
-            main_thread_handle = handles[i];
-            handles[i] = ZX_HANDLE_INVALID;
+            main_thread_handle = p.handles[i];
+            p.handles[i] = ZX_HANDLE_INVALID;
             p.handle_info[i] = 0;
             break;
         }
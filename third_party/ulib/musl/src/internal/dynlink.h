@@ -39,7 +39,7 @@ enum {
 #define DT_DEBUG_INDIRECT 0
 #endif
 
-#define DYN_CNT 32
+#define DYN_CNT 37
 
 // This is the return value of the dynamic linker startup functions.
 // They return all the way back to _start so as to pop their stack
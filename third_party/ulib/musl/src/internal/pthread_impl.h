@@ -125,6 +125,9 @@ static inline struct pthread* tp_to_pthread(void* tp) {
 // The bit used in the recursive and errorchecking cases, which track thread owners.
 #define PTHREAD_MUTEX_OWNED_LOCK_BIT 0x80000000
 #define PTHREAD_MUTEX_OWNED_LOCK_MASK 0x7fffffff
+// Set in _m_type for PTHREAD_PRIO_INHERIT mutexes. These always track their
+// owner, so that waiters can name it to zx_futex_wait_owned().
+#define PTHREAD_MUTEX_PRIO_INHERIT 4
 
 extern void* __pthread_tsd_main[];
 extern volatile size_t __pthread_tsd_size;
@@ -166,6 +169,11 @@ int __pthread_key_delete(tss_t k) ATTR_LIBC_VISIBILITY;
 int __timedwait(atomic_int*, int, clockid_t, const struct timespec*)
     ATTR_LIBC_VISIBILITY;
 
+// Like __timedwait, but lends the caller's priority to |owner| while
+// waiting.  Also guaranteed to only return 0, EINVAL, or ETIMEDOUT.
+int __timedwait_owned(atomic_int*, int, zx_handle_t owner, clockid_t,
+                      const struct timespec*) ATTR_LIBC_VISIBILITY;
+
 // Loading a library can introduce more thread_local variables. Thread
 // allocation bases bookkeeping decisions based on the current state
 // of thread_locals in the program, so thread creation needs to be
@@ -187,6 +195,10 @@ pthread_t __allocate_thread(const pthread_attr_t* attr,
                             char default_name[ZX_MAX_NAME_LEN])
     __attribute__((nonnull(1,2))) ATTR_LIBC_VISIBILITY;
 
+// Keeps the stacks of a thread that will not run on them again for
+// __allocate_thread to hand to a new thread, or unmaps them.
+void __release_thread_stacks(pthread_t thread) ATTR_LIBC_VISIBILITY;
+
 pthread_t __init_main_thread(zx_handle_t thread_self) ATTR_LIBC_VISIBILITY;
 
 int __pthread_once(pthread_once_t*, void (*)(void)) ATTR_LIBC_VISIBILITY;
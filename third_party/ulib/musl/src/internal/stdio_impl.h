@@ -63,6 +63,8 @@ int __towrite(FILE*) ATTR_LIBC_VISIBILITY;
 
 zx_status_t _mmap_file(size_t offset, size_t len, uint32_t zx_flags, int flags, int fd,
                        off_t fd_off, uintptr_t* out);
+zx_status_t _msync_file(void* addr, size_t len, int flags);
+void _munmap_file(void* addr, size_t len);
 
 #if defined(__PIC__) && (100 * __GNUC__ + __GNUC_MINOR__ >= 303)
 __attribute__((visibility("protected")))
@@ -1,9 +1,50 @@
+#define _GNU_SOURCE
 #include "libc.h"
+#include "zircon_impl.h"
+#include <errno.h>
 #include <sys/mman.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/types.h>
 
 int __madvise(void* addr, size_t len, int advice) {
-    // TODO(kulakowski) Implement more mmap
-    return 0;
+    uint32_t op;
+    switch (advice) {
+    case MADV_NORMAL:
+        op = ZX_VMAR_OP_NORMAL;
+        break;
+    case MADV_RANDOM:
+        op = ZX_VMAR_OP_RANDOM;
+        break;
+    case MADV_SEQUENTIAL:
+        op = ZX_VMAR_OP_SEQUENTIAL;
+        break;
+    case MADV_WILLNEED:
+        op = ZX_VMAR_OP_WILL_NEED;
+        break;
+    case MADV_DONTNEED:
+    case MADV_FREE:
+        // the contents are kept, which is allowed for both
+        op = ZX_VMAR_OP_DONT_NEED;
+        break;
+    default:
+        // TODO(kulakowski) Implement more mmap
+        return 0;
+    }
+
+    zx_status_t status = _zx_vmar_op_range(_zx_vmar_root_self(), op, (uintptr_t)addr, len);
+    if (!status)
+        return 0;
+
+    switch (status) {
+    case ZX_ERR_NOT_FOUND:
+        errno = ENOMEM;
+        break;
+    default:
+        errno = EINVAL;
+        break;
+    }
+    return -1;
 }
 
 weak_alias(__madvise, madvise);
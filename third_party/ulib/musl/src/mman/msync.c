@@ -1,7 +1,23 @@
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <sys/mman.h>
 
+#include "stdio_impl.h"
+
 int msync(void* start, size_t len, int flags) {
-    errno = ENOSYS;
-    return -1;
+    if (((uintptr_t)start & (PAGE_SIZE - 1)) ||
+        (flags & ~(MS_ASYNC | MS_SYNC | MS_INVALIDATE)) ||
+        ((flags & MS_ASYNC) && (flags & MS_SYNC))) {
+        errno = EINVAL;
+        return -1;
+    }
+    // Shared mappings of files are of the file's own pages, so there is
+    // nothing to invalidate; only writing back remains.
+    zx_status_t status = _msync_file(start, len, flags);
+    if (status != ZX_OK) {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
 }
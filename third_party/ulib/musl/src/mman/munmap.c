@@ -5,6 +5,8 @@
 #include <zircon/syscalls.h>
 #include <sys/mman.h>
 
+#include "stdio_impl.h"
+
 int __munmap(void* start, size_t len) {
     uintptr_t ptr = (uintptr_t)start;
     zx_status_t status = _zx_vmar_unmap(_zx_vmar_root_self(), ptr, len);
@@ -12,6 +14,7 @@ int __munmap(void* start, size_t len) {
         errno = EINVAL;
         return -1;
     }
+    _munmap_file(start, len);
     return 0;
 }
 
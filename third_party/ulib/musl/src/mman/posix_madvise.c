@@ -2,9 +2,24 @@
 #include <errno.h>
 #include <sys/mman.h>
 
+int __madvise(void* addr, size_t len, int advice);
+
 int posix_madvise(void* addr, size_t len, int advice) {
-    if (advice == MADV_DONTNEED)
-        return 0;
-    errno = ENOSYS;
-    return -1;
+    switch (advice) {
+    case POSIX_MADV_NORMAL:
+    case POSIX_MADV_RANDOM:
+    case POSIX_MADV_SEQUENTIAL:
+    case POSIX_MADV_WILLNEED:
+    case POSIX_MADV_DONTNEED:
+        break;
+    default:
+        return EINVAL;
+    }
+
+    // the POSIX_MADV_* values match MADV_*, but errors are returned rather than
+    // left in errno
+    int saved_errno = errno;
+    int ret = __madvise(addr, len, advice) ? errno : 0;
+    errno = saved_errno;
+    return ret;
 }
@@ -5,6 +5,11 @@
 #include <time.h>
 
 int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec* at) {
+    return __timedwait_owned(futex, val, ZX_HANDLE_INVALID, clk, at);
+}
+
+int __timedwait_owned(atomic_int* futex, int val, zx_handle_t owner,
+                      clockid_t clk, const struct timespec* at) {
     zx_time_t deadline = ZX_TIME_INFINITE;
 
     if (at) {
@@ -17,7 +22,10 @@ int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec
     // races with this call. But this is indistinguishable from
     // otherwise being woken up just before someone else changes the
     // value. Therefore this functions returns 0 in that case.
-    switch (_zx_futex_wait(futex, val, deadline)) {
+    zx_status_t status = owner == ZX_HANDLE_INVALID ?
+        _zx_futex_wait(futex, val, deadline) :
+        _zx_futex_wait_owned(futex, val, owner, deadline);
+    switch (status) {
     case ZX_OK:
     case ZX_ERR_BAD_STATE:
         return 0;
@@ -30,6 +30,14 @@ static zx_status_t stub_mmap_file(size_t offset, size_t len, uint32_t zx_flags,
 }
 weak_alias(stub_mmap_file, _mmap_file);
 
+static zx_status_t stub_msync_file(void* addr, size_t len, int flags) {
+    return ZX_OK;
+}
+weak_alias(stub_msync_file, _msync_file);
+
+static void stub_munmap_file(void* addr, size_t len) {}
+weak_alias(stub_munmap_file, _munmap_file);
+
 static int stub_close(int fd) {
     errno = ENOSYS;
     return -1;
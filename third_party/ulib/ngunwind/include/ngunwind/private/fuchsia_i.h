@@ -32,6 +32,22 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "libunwind_i.h"
 
+// Remote memory is read, and cached, this much at a time. This is the
+// smallest page size of the architectures we support.
+#define UNW_FUCHSIA_PAGE_SIZE 4096
+
+// The number of pages of remote memory to keep.
+#define UNW_FUCHSIA_NUM_CACHED_PAGES 8
+
+// The number of DSOs to keep unwind info for.
+#define UNW_FUCHSIA_NUM_CACHED_DSOS 4
+
+struct unw_fuchsia_page {
+    bool valid;
+    zx_vaddr_t addr;
+    uint8_t data[UNW_FUCHSIA_PAGE_SIZE];
+};
+
 struct unw_fuchsia_info {
 #if 0
     struct _Unwind_Context context; // must be first
@@ -47,7 +63,19 @@ struct unw_fuchsia_info {
     unw_dso_lookup_func_t* lookup_dso;
 
     uintptr_t segbase;
-    struct as_elf_dyn_info edi;
+
+    // Unwind info of the DSOs most recently unwound through, so that a
+    // backtrace going back and forth between the same few DSOs only reads
+    // and indexes each one's eh_frame_hdr once. |edi| is the one the
+    // current pc is in.
+    struct as_elf_dyn_info edis[UNW_FUCHSIA_NUM_CACHED_DSOS];
+    struct as_elf_dyn_info* edi;
+    unsigned next_edi;
+
+    // Pages of remote memory recently read. The thread being unwound is
+    // stopped, so these can't go stale while we're using them.
+    struct unw_fuchsia_page pages[UNW_FUCHSIA_NUM_CACHED_PAGES];
+    unsigned next_page;
 };
 
 extern const int fuchsia_greg_offset[];
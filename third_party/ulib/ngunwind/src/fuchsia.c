@@ -68,6 +68,70 @@ read_mem (zx_handle_t h, zx_vaddr_t vaddr, void* ptr, size_t len)
   return ZX_OK;
 }
 
+// Reads |len| bytes at |vaddr|, from the eh_frame_hdr of a DSO we've already
+// loaded or from the cache of pages, reading whole pages from the process
+// as needed. Unwinding does lots of small reads: the binary search of the
+// eh_frame_hdr table, the FDEs and CIEs it leads to, and the stack. Each
+// would otherwise be a syscall.
+
+static zx_status_t
+read_mem_cached (unw_fuchsia_info_t* cxt, zx_vaddr_t vaddr, void* ptr, size_t len)
+{
+  for (int i = 0; i < UNW_FUCHSIA_NUM_CACHED_DSOS; ++i)
+  {
+    const struct as_elf_dyn_info* edi = &cxt->edis[i];
+    if (edi->di_cache.format != UNW_INFO_FORMAT_REMOTE_TABLE || edi->eh.data == NULL)
+      continue;
+    zx_vaddr_t eh_start = edi->di_cache.u.rti.segbase;
+    if (vaddr >= eh_start && vaddr - eh_start <= edi->eh.size
+        && len <= edi->eh.size - (vaddr - eh_start))
+    {
+      memcpy (ptr, (const char*) edi->eh.data + (vaddr - eh_start), len);
+      return ZX_OK;
+    }
+  }
+
+  // Big reads are things like loading an eh_frame_hdr, which we keep anyway.
+  if (len > UNW_FUCHSIA_PAGE_SIZE)
+    return read_mem (cxt->process, vaddr, ptr, len);
+
+  char* out = ptr;
+  while (len > 0)
+  {
+    zx_vaddr_t page_addr = vaddr & ~(zx_vaddr_t) (UNW_FUCHSIA_PAGE_SIZE - 1);
+    size_t offset = vaddr - page_addr;
+    size_t chunk = UNW_FUCHSIA_PAGE_SIZE - offset;
+    if (chunk > len)
+      chunk = len;
+
+    struct unw_fuchsia_page* page = NULL;
+    for (int i = 0; i < UNW_FUCHSIA_NUM_CACHED_PAGES; ++i)
+    {
+      if (cxt->pages[i].valid && cxt->pages[i].addr == page_addr)
+      {
+        page = &cxt->pages[i];
+        break;
+      }
+    }
+    if (page == NULL)
+    {
+      page = &cxt->pages[cxt->next_page];
+      page->valid = read_mem (cxt->process, page_addr, page->data,
+                              UNW_FUCHSIA_PAGE_SIZE) == ZX_OK;
+      if (!page->valid)
+        return read_mem (cxt->process, vaddr, out, len);
+      page->addr = page_addr;
+      cxt->next_page = (cxt->next_page + 1) % UNW_FUCHSIA_NUM_CACHED_PAGES;
+    }
+
+    memcpy (out, page->data + offset, chunk);
+    out += chunk;
+    vaddr += chunk;
+    len -= chunk;
+  }
+  return ZX_OK;
+}
+
 static uint32_t
 get_uint32 (const void* buf)
 {
@@ -86,19 +150,36 @@ get_uint64 (const void* buf)
 
 // Subroutine of remote_find_proc_info to simplify it.
 
+static bool
+edi_contains (const struct as_elf_dyn_info* edi, unw_word_t ip)
+{
+  return (edi->di_cache.format != -1
+          && ip >= edi->di_cache.start_ip && ip < edi->di_cache.end_ip)
+      || (edi->di_debug.format != -1
+          && ip >= edi->di_debug.start_ip && ip < edi->di_debug.end_ip);
+}
+
 static int
 get_unwind_info (unw_fuchsia_info_t* cxt, unw_addr_space_t as, unw_word_t ip)
 {
-  struct as_elf_dyn_info* edi = &cxt->edi;
   unsigned long segbase, mapoff;
 
-  // Can we use the previously found info?
-  if ((edi->di_cache.format != -1
-       && ip >= edi->di_cache.start_ip && ip < edi->di_cache.end_ip)
-      || (edi->di_debug.format != -1
-          && ip >= edi->di_debug.start_ip && ip < edi->di_debug.end_ip))
+  // Can we use previously found info?
+  if (cxt->edi != NULL && edi_contains (cxt->edi, ip))
     return 0;
+  for (int i = 0; i < UNW_FUCHSIA_NUM_CACHED_DSOS; ++i)
+  {
+    if (edi_contains (&cxt->edis[i], ip))
+    {
+      cxt->edi = &cxt->edis[i];
+      return 0;
+    }
+  }
 
+  // Replace the oldest entry.
+  struct as_elf_dyn_info* edi = &cxt->edis[cxt->next_edi];
+  cxt->next_edi = (cxt->next_edi + 1) % UNW_FUCHSIA_NUM_CACHED_DSOS;
+  cxt->edi = edi;
   unwi_invalidate_as_edi(edi);
   edi->arg = cxt;
 
@@ -155,11 +236,11 @@ remote_find_proc_info (unw_addr_space_t as, unw_word_t ip, unw_proc_info_t *pi,
   }
 
   ret = -UNW_ENOINFO;
-  if (ret == -UNW_ENOINFO && cxt->edi.di_cache.format != -1)
-    ret = dwarf_search_unwind_table (as, ip, &cxt->edi.di_cache, pi,
+  if (ret == -UNW_ENOINFO && cxt->edi->di_cache.format != -1)
+    ret = dwarf_search_unwind_table (as, ip, &cxt->edi->di_cache, pi,
                                      need_unwind_info, arg);
-  if (ret == -UNW_ENOINFO && cxt->edi.di_debug.format != -1)
-    ret = dwarf_search_unwind_table (as, ip, &cxt->edi.di_debug, pi,
+  if (ret == -UNW_ENOINFO && cxt->edi->di_debug.format != -1)
+    ret = dwarf_search_unwind_table (as, ip, &cxt->edi->di_debug, pi,
                                      need_unwind_info, arg);
 
   Debug (3, "returning %d\n", ret);
@@ -213,13 +294,12 @@ remote_access_mem (unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
 {
   Debug (3, "called, addr 0x%lx\n", (long) addr);
   unw_fuchsia_info_t* cxt = arg;
-  zx_handle_t process = cxt->process;
   if (write)
   {
     Debug (3, "writing to mem\n");
     return -UNW_EINVAL;
   }
-  zx_status_t status = read_mem (process, addr, val, sizeof(*val));
+  zx_status_t status = read_mem_cached (cxt, addr, val, sizeof(*val));
   if (status < 0)
       return -UNW_EINVAL;
   char dump[3 * 8 + 1];
@@ -234,13 +314,12 @@ remote_access_raw_mem (unw_addr_space_t as, unw_word_t addr,
 {
   Debug (3, "called, addr 0x%lx, size %lu\n", (long) addr, (long) size);
   unw_fuchsia_info_t* cxt = arg;
-  zx_handle_t process = cxt->process;
   if (write)
   {
     Debug (3, "writing to mem\n");
     return -UNW_EINVAL;
   }
-  zx_status_t status = read_mem (process, addr, buf, size);
+  zx_status_t status = read_mem_cached (cxt, addr, buf, size);
   if (status < 0)
   {
     Debug (3, "read failed: %d\n", status);
@@ -342,6 +421,8 @@ unw_create_fuchsia(zx_handle_t process, zx_handle_t thread,
     result->thread = thread;
     result->context = context;
     result->lookup_dso = lookup_dso;
+    for (int i = 0; i < UNW_FUCHSIA_NUM_CACHED_DSOS; ++i)
+        unwi_invalidate_as_edi (&result->edis[i]);
 
     return result;
 }
@@ -349,5 +430,9 @@ unw_create_fuchsia(zx_handle_t process, zx_handle_t thread,
 void
 unw_destroy_fuchsia(unw_fuchsia_info_t* info)
 {
+    if (info == NULL)
+        return;
+    for (int i = 0; i < UNW_FUCHSIA_NUM_CACHED_DSOS; ++i)
+        unwi_invalidate_as_edi (&info->edis[i]);
     free (info);
 }